@@ -0,0 +1,754 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audioanalysis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <QDebug>
+#include <QSaveFile>
+#include <QtMath>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/version.h>
+}
+
+// FFmpeg's SIMD transforms, av_tx replaces the older avfft API which newer versions no longer have
+#if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(57, 0, 0)
+#define OLIVE_ANALYSIS_AVTX
+extern "C" {
+#include <libavutil/tx.h>
+}
+#else
+extern "C" {
+#include <libavcodec/avfft.h>
+}
+#endif
+
+namespace olive {
+
+const int AudioAnalysis::kBlocksPerSecond = 10;
+const int AudioAnalysis::kSpectrumBands = 64;
+
+namespace {
+
+// Analysis files are written in native byte order like waveform files
+const quint32 kFileMagic = 0x4F415946;
+const quint32 kFileVersion = 1;
+
+struct FileHeader {
+  quint32 magic;
+  quint32 version;
+  quint32 channels;
+  quint32 sample_rate;
+  quint32 bands;
+  quint32 level_count;
+  qint64 block_count;
+  double integrated_loudness;
+  double loudness_range;
+  float true_peak;
+  quint32 reserved;
+};
+
+struct FileLevel {
+  qint64 rate_num;
+  qint64 rate_den;
+  qint64 offset;
+  qint64 count;
+};
+
+// Transform size and hop for spectra, Hann windows at 50% overlap sum to a constant
+const int kFFTBits = 11;
+const int kFFTSize = 1 << kFFTBits;
+const int kFFTHop = kFFTSize / 2;
+
+// Equivalent noise bandwidth of the Hann window in bins, dividing by it makes a sine read the same
+// whichever band it lands in
+const double kHannNoiseBandwidth = 1.5;
+
+// Lowest and highest band edges
+const double kSpectrumLowFrequency = 20.0;
+const double kSpectrumHighFrequency = 20000.0;
+
+// Each mipmap level has this many times fewer entries than the one before it
+const int kSpectrumMipmapFactor = 10;
+const int kSpectrumMipmapLevels = 3;
+
+// True peak is measured by 4x oversampling with a windowed-sinc interpolator (BS.1770-4 Annex 2)
+const int kTruePeakOversample = 4;
+const int kTruePeakTaps = 12;
+
+// Gating (BS.1770-4 and EBU Tech 3342)
+const double kAbsoluteGate = -70.0;
+const double kIntegratedRelativeGate = -10.0;
+const double kRangeRelativeGate = -20.0;
+
+const int kMomentaryBlocks = 4;
+const int kShortTermBlocks = 30;
+
+/**
+ * @brief Interpolation filter for true peak, phase-major so each phase's taps are contiguous
+ */
+std::vector<float> CreateTruePeakFilter()
+{
+  const int length = kTruePeakOversample * kTruePeakTaps;
+  std::vector<float> coeffs(length);
+
+  for (int p=0; p<kTruePeakOversample; p++) {
+    for (int k=0; k<kTruePeakTaps; k++) {
+      int n = p + k * kTruePeakOversample;
+      double x = (n - (length - 1) * 0.5) / kTruePeakOversample;
+      double sinc = qFuzzyIsNull(x) ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+      double window = 0.5 - 0.5 * std::cos(2.0 * M_PI * (n + 0.5) / length);
+      coeffs[p * kTruePeakTaps + k] = float(sinc * window);
+    }
+  }
+
+  return coeffs;
+}
+
+/**
+ * @brief BS.1770 channel weight for the `index`th channel of a layout, 0 for LFE
+ */
+double ChannelGain(uint64_t layout, int index)
+{
+  uint64_t channel = 0;
+
+  for (int bit=0, found=0; bit<64; bit++) {
+    if (layout & (uint64_t(1) << bit)) {
+      if (found == index) {
+        channel = uint64_t(1) << bit;
+        break;
+      }
+      found++;
+    }
+  }
+
+  if (channel & (AV_CH_LOW_FREQUENCY | AV_CH_LOW_FREQUENCY_2)) {
+    return 0.0;
+  }
+
+  if (channel & (AV_CH_SIDE_LEFT | AV_CH_SIDE_RIGHT | AV_CH_BACK_LEFT | AV_CH_BACK_RIGHT)) {
+    return 1.41;
+  }
+
+  return 1.0;
+}
+
+double BandEdge(int band, int sample_rate)
+{
+  double high = qMin(kSpectrumHighFrequency, sample_rate * 0.5);
+  return kSpectrumLowFrequency * std::pow(high / kSpectrumLowFrequency, double(band) / AudioAnalysis::kSpectrumBands);
+}
+
+double Percentile(QVector<double> values, double p)
+{
+  std::sort(values.begin(), values.end());
+  double pos = p * (values.size() - 1);
+  int lower = qFloor(pos);
+  int upper = qMin(lower + 1, values.size() - 1);
+  return values.at(lower) + (values.at(upper) - values.at(lower)) * (pos - lower);
+}
+
+}
+
+/**
+ * @brief Power spectrum of real input using FFmpeg's transforms
+ */
+class AudioAnalysis::FileWriter::FFT
+{
+public:
+  FFT() :
+    ctx_(nullptr)
+  {
+    buffer_.resize(kFFTSize);
+
+#ifdef OLIVE_ANALYSIS_AVTX
+    output_.resize(kFFTSize);
+    float scale = 1.0f;
+    if (av_tx_init(&ctx_, &fn_, AV_TX_FLOAT_FFT, 0, kFFTSize, &scale, 0) < 0) {
+      ctx_ = nullptr;
+    }
+#else
+    ctx_ = av_fft_init(kFFTBits, 0);
+#endif
+  }
+
+  ~FFT()
+  {
+#ifdef OLIVE_ANALYSIS_AVTX
+    av_tx_uninit(&ctx_);
+#else
+    av_fft_end(ctx_);
+#endif
+  }
+
+  DISABLE_COPY_MOVE(FFT)
+
+  bool is_valid() const
+  {
+    return ctx_;
+  }
+
+  /**
+   * @brief Transform kFFTSize samples, writing the power of bins 0 to kFFTSize/2 into `power`
+   */
+  void PowerSpectrum(const float* input, float* power)
+  {
+    for (int i=0; i<kFFTSize; i++) {
+      buffer_[i].re = input[i];
+      buffer_[i].im = 0.0f;
+    }
+
+#ifdef OLIVE_ANALYSIS_AVTX
+    fn_(ctx_, output_.data(), buffer_.data(), sizeof(AVComplexFloat));
+    const AVComplexFloat* out = output_.data();
+#else
+    av_fft_permute(ctx_, buffer_.data());
+    av_fft_calc(ctx_, buffer_.data());
+    const FFTComplex* out = buffer_.data();
+#endif
+
+    for (int i=0; i<=kFFTSize/2; i++) {
+      power[i] = out[i].re * out[i].re + out[i].im * out[i].im;
+    }
+  }
+
+private:
+#ifdef OLIVE_ANALYSIS_AVTX
+  AVTXContext* ctx_;
+  av_tx_fn fn_;
+  std::vector<AVComplexFloat> buffer_;
+  std::vector<AVComplexFloat> output_;
+#else
+  FFTContext* ctx_;
+  std::vector<FFTComplex> buffer_;
+#endif
+
+};
+
+AudioAnalysis::AudioAnalysis() :
+  channels_(0),
+  sample_rate_(0),
+  integrated_loudness_(-HUGE_VAL),
+  loudness_range_(0),
+  true_peak_(0)
+{
+}
+
+rational AudioAnalysis::length() const
+{
+  return rational(blocks_.size(), kBlocksPerSecond);
+}
+
+float AudioAnalysis::GetTruePeakFromTime(const rational &start, const rational &length) const
+{
+  int start_block = qBound(0, TimeToBlock(start), blocks_.size());
+  int end_block = qBound(start_block, TimeToBlock(start + length), blocks_.size());
+
+  float peak = 0.0f;
+  for (int i=start_block; i<end_block; i++) {
+    peak = qMax(peak, blocks_.at(i).true_peak);
+  }
+
+  return peak;
+}
+
+double AudioAnalysis::GetMomentaryLoudness(const rational &time) const
+{
+  return WindowLoudness(TimeToBlock(time), kMomentaryBlocks);
+}
+
+double AudioAnalysis::GetShortTermLoudness(const rational &time) const
+{
+  return WindowLoudness(TimeToBlock(time), kShortTermBlocks);
+}
+
+QVector<float> AudioAnalysis::GetSpectrumFromTime(const rational &start, const rational &length) const
+{
+  QVector<float> db(kSpectrumBands, -HUGE_VALF);
+
+  if (spectrum_.empty()) {
+    return db;
+  }
+
+  // Coarsest level with a few entries in the range, falling back to the finest one
+  auto level = std::prev(spectrum_.cend());
+  for (auto it=spectrum_.cbegin(); it!=spectrum_.cend(); it++) {
+    if ((length * it->first).toDouble() >= 4.0) {
+      level = it;
+      break;
+    }
+  }
+
+  const QVector<float>& data = level->second;
+  int count = data.size() / kSpectrumBands;
+  double rate = level->first.toDouble();
+  int first = qBound(0, qFloor(start.toDouble() * rate), count);
+  int last = qBound(first, qMax(first + 1, qCeil((start + length).toDouble() * rate)), count);
+
+  if (first == last) {
+    return db;
+  }
+
+  QVector<double> sums(kSpectrumBands, 0.0);
+  for (int i=first; i<last; i++) {
+    const float* entry = data.constData() + i * kSpectrumBands;
+    for (int b=0; b<kSpectrumBands; b++) {
+      sums[b] += entry[b];
+    }
+  }
+
+  for (int b=0; b<kSpectrumBands; b++) {
+    double power = sums.at(b) / (last - first);
+    if (power > 0.0) {
+      db[b] = float(10.0 * std::log10(power));
+    }
+  }
+
+  return db;
+}
+
+double AudioAnalysis::GetBandFrequency(int band) const
+{
+  return std::sqrt(BandEdge(band, sample_rate_) * BandEdge(band + 1, sample_rate_));
+}
+
+bool AudioAnalysis::LoadFromFile(const QString &filename)
+{
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly) || file.size() < qint64(sizeof(FileHeader))) {
+    return false;
+  }
+
+  FileHeader header;
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+  qint64 blocks_size = header.block_count * qint64(sizeof(Block));
+
+  if (header.magic != kFileMagic || header.version != kFileVersion
+      || header.bands != quint32(kSpectrumBands) || header.block_count < 0
+      || file.size() < qint64(sizeof(FileHeader) + sizeof(FileLevel) * header.level_count) + blocks_size) {
+    qWarning() << "Ignoring invalid audio analysis file:" << filename;
+    return false;
+  }
+
+  QVector<FileLevel> levels(header.level_count);
+  file.read(reinterpret_cast<char*>(levels.data()), sizeof(FileLevel) * header.level_count);
+
+  QVector<Block> blocks(header.block_count);
+  file.read(reinterpret_cast<char*>(blocks.data()), blocks_size);
+
+  std::map<rational, QVector<float> > spectrum;
+
+  foreach (const FileLevel& level, levels) {
+    qint64 bytes = level.count * kSpectrumBands * qint64(sizeof(float));
+
+    if (level.count < 0 || level.offset + bytes > file.size() || !file.seek(level.offset)) {
+      qWarning() << "Ignoring invalid audio analysis file:" << filename;
+      return false;
+    }
+
+    QVector<float>& data = spectrum[rational(level.rate_num, level.rate_den)];
+    data.resize(level.count * kSpectrumBands);
+    file.read(reinterpret_cast<char*>(data.data()), bytes);
+  }
+
+  channels_ = header.channels;
+  sample_rate_ = header.sample_rate;
+  integrated_loudness_ = header.integrated_loudness;
+  loudness_range_ = header.loudness_range;
+  true_peak_ = header.true_peak;
+  blocks_ = blocks;
+  spectrum_ = spectrum;
+
+  return true;
+}
+
+void AudioAnalysis::ComputeSummary()
+{
+  true_peak_ = 0.0f;
+  foreach (const Block& b, blocks_) {
+    true_peak_ = qMax(true_peak_, b.true_peak);
+  }
+
+  // Integrated loudness over 400ms gating blocks with 75% overlap
+  QVector<double> gating_blocks;
+  for (int i=kMomentaryBlocks; i<=blocks_.size(); i++) {
+    double z = 0.0;
+    for (int j=i-kMomentaryBlocks; j<i; j++) {
+      z += blocks_.at(j).weighted_mean_square;
+    }
+    gating_blocks.append(z / kMomentaryBlocks);
+  }
+
+  auto gated_mean = [](const QVector<double>& values, double gate, int* count){
+    double sum = 0.0;
+    *count = 0;
+    foreach (double z, values) {
+      if (AudioLevels::MeanSquareToLoudness(z) > gate) {
+        sum += z;
+        (*count)++;
+      }
+    }
+    return *count ? sum / *count : 0.0;
+  };
+
+  int count;
+  double absolute_mean = gated_mean(gating_blocks, kAbsoluteGate, &count);
+  if (count) {
+    double relative_gate = AudioLevels::MeanSquareToLoudness(absolute_mean) + kIntegratedRelativeGate;
+    double relative_mean = gated_mean(gating_blocks, qMax(kAbsoluteGate, relative_gate), &count);
+    integrated_loudness_ = AudioLevels::MeanSquareToLoudness(relative_mean);
+  } else {
+    integrated_loudness_ = -HUGE_VAL;
+  }
+
+  // Loudness range from the distribution of gated short-term loudness
+  QVector<double> short_term;
+  for (int i=kShortTermBlocks; i<=blocks_.size(); i++) {
+    double z = 0.0;
+    for (int j=i-kShortTermBlocks; j<i; j++) {
+      z += blocks_.at(j).weighted_mean_square;
+    }
+    short_term.append(z / kShortTermBlocks);
+  }
+
+  loudness_range_ = 0.0;
+  absolute_mean = gated_mean(short_term, kAbsoluteGate, &count);
+  if (count) {
+    double relative_gate = qMax(kAbsoluteGate, AudioLevels::MeanSquareToLoudness(absolute_mean) + kRangeRelativeGate);
+
+    QVector<double> gated;
+    foreach (double z, short_term) {
+      double l = AudioLevels::MeanSquareToLoudness(z);
+      if (l > relative_gate) {
+        gated.append(l);
+      }
+    }
+
+    if (!gated.isEmpty()) {
+      loudness_range_ = Percentile(gated, 0.95) - Percentile(gated, 0.10);
+    }
+  }
+}
+
+void AudioAnalysis::BuildSpectrumMipmaps()
+{
+  rational rate(kBlocksPerSecond);
+
+  for (int level=1; level<kSpectrumMipmapLevels; level++) {
+    const QVector<float>& finer = spectrum_.at(rate);
+    int finer_count = finer.size() / kSpectrumBands;
+    int count = (finer_count + kSpectrumMipmapFactor - 1) / kSpectrumMipmapFactor;
+
+    rate /= kSpectrumMipmapFactor;
+    QVector<float>& coarser = spectrum_[rate];
+    coarser.resize(count * kSpectrumBands);
+
+    for (int i=0; i<count; i++) {
+      int first = i * kSpectrumMipmapFactor;
+      int last = qMin(first + kSpectrumMipmapFactor, finer_count);
+      float* out = coarser.data() + i * kSpectrumBands;
+
+      for (int b=0; b<kSpectrumBands; b++) {
+        float sum = 0.0f;
+        for (int j=first; j<last; j++) {
+          sum += finer.at(j * kSpectrumBands + b);
+        }
+        out[b] = sum / (last - first);
+      }
+    }
+  }
+}
+
+double AudioAnalysis::WindowLoudness(int end_block, int window) const
+{
+  end_block = qBound(0, end_block, blocks_.size());
+  int start_block = qMax(0, end_block - window);
+
+  if (start_block == end_block) {
+    return AudioLevels::MeanSquareToLoudness(0.0);
+  }
+
+  double z = 0.0;
+  for (int i=start_block; i<end_block; i++) {
+    z += blocks_.at(i).weighted_mean_square;
+  }
+
+  return AudioLevels::MeanSquareToLoudness(z / (end_block - start_block));
+}
+
+int AudioAnalysis::TimeToBlock(const rational &time) const
+{
+  return qFloor(time.toDouble() * kBlocksPerSecond);
+}
+
+AudioAnalysis::FileWriter::FileWriter(const QString &filename, const AudioParams &params) :
+  filename_(filename),
+  open_(false),
+  params_(params)
+{
+}
+
+AudioAnalysis::FileWriter::~FileWriter()
+{
+  close();
+}
+
+bool AudioAnalysis::FileWriter::open()
+{
+  int channels = params_.channel_count();
+  int sample_rate = params_.sample_rate();
+
+  if (channels <= 0 || sample_rate <= 0) {
+    return false;
+  }
+
+  fft_ = std::unique_ptr<FFT>(new FFT());
+  if (!fft_->is_valid()) {
+    qWarning() << "Failed to create FFT for audio analysis";
+    fft_ = nullptr;
+    return false;
+  }
+
+  analysis_ = std::unique_ptr<AudioAnalysis>(new AudioAnalysis());
+  analysis_->channels_ = channels;
+  analysis_->sample_rate_ = sample_rate;
+  analysis_->spectrum_[rational(kBlocksPerSecond)] = QVector<float>();
+
+  block_length_ = qMax(1, sample_rate / kBlocksPerSecond);
+  block_position_ = 0;
+  block_weighted_sum_ = 0.0;
+  block_true_peak_ = 0.0f;
+
+  weighting_.clear();
+  channel_gain_.clear();
+  for (int i=0; i<channels; i++) {
+    weighting_.push_back(AudioLevels::KWeightingFilter(sample_rate));
+    channel_gain_.push_back(ChannelGain(params_.channel_layout(), i));
+  }
+
+  peak_history_.assign(channels, std::vector<float>(kTruePeakTaps, 0.0f));
+
+  fft_input_.assign(kFFTSize, 0.0f);
+  fft_windowed_.resize(kFFTSize);
+  fft_power_.resize(kFFTSize / 2 + 1);
+  fft_position_ = 0;
+
+  window_.resize(kFFTSize);
+  for (int i=0; i<kFFTSize; i++) {
+    window_[i] = float(0.5 - 0.5 * std::cos(2.0 * M_PI * i / kFFTSize));
+  }
+
+  block_spectrum_.assign(kSpectrumBands, 0.0f);
+  block_spectrum_frames_ = 0;
+
+  open_ = true;
+
+  return true;
+}
+
+void AudioAnalysis::FileWriter::write(SampleBufferPtr samples)
+{
+  if (!open_) {
+    return;
+  }
+
+  int channels = analysis_->channels_;
+  int available = qMin(channels, samples->audio_params().channel_count());
+  std::vector<float> frame(channels, 0.0f);
+
+  for (int i=0; i<samples->sample_count(); i++) {
+    for (int c=0; c<available; c++) {
+      frame[c] = samples->data(c)[i];
+    }
+
+    ProcessSample(frame.data());
+  }
+}
+
+bool AudioAnalysis::FileWriter::close()
+{
+  if (!open_) {
+    return false;
+  }
+
+  open_ = false;
+
+  if (block_position_ > 0) {
+    FinishBlock();
+  }
+
+  analysis_->ComputeSummary();
+  analysis_->BuildSpectrumMipmaps();
+
+  QSaveFile file(filename_);
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to open audio analysis file for writing:" << filename_;
+    return false;
+  }
+
+  const AudioAnalysis* a = analysis_.get();
+
+  FileHeader header = {kFileMagic, kFileVersion, quint32(a->channels_), quint32(a->sample_rate_),
+                       quint32(kSpectrumBands), quint32(a->spectrum_.size()), a->blocks_.size(),
+                       a->integrated_loudness_, a->loudness_range_, a->true_peak_, 0};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  qint64 offset = sizeof(FileHeader) + sizeof(FileLevel) * a->spectrum_.size() + sizeof(Block) * a->blocks_.size();
+  for (auto it=a->spectrum_.cbegin(); it!=a->spectrum_.cend(); it++) {
+    qint64 count = it->second.size() / kSpectrumBands;
+    FileLevel level = {it->first.numerator(), it->first.denominator(), offset, count};
+    file.write(reinterpret_cast<const char*>(&level), sizeof(level));
+    offset += it->second.size() * sizeof(float);
+  }
+
+  file.write(reinterpret_cast<const char*>(a->blocks_.constData()), sizeof(Block) * a->blocks_.size());
+
+  for (auto it=a->spectrum_.cbegin(); it!=a->spectrum_.cend(); it++) {
+    file.write(reinterpret_cast<const char*>(it->second.constData()), it->second.size() * sizeof(float));
+  }
+
+  analysis_ = nullptr;
+  fft_ = nullptr;
+
+  return file.commit();
+}
+
+void AudioAnalysis::FileWriter::ProcessSample(const float *frame)
+{
+  static const std::vector<float> peak_filter = CreateTruePeakFilter();
+
+  int channels = analysis_->channels_;
+  float mono = 0.0f;
+
+  for (int c=0; c<channels; c++) {
+    float s = frame[c];
+    float w = weighting_[c].process(s);
+    block_weighted_sum_ += channel_gain_[c] * double(w) * double(w);
+
+    // Shift this sample into the interpolator and measure every oversampled phase
+    std::vector<float>& history = peak_history_[c];
+    std::move(history.begin() + 1, history.end(), history.begin());
+    history.back() = s;
+
+    float peak = std::abs(s);
+    for (int p=0; p<kTruePeakOversample; p++) {
+      const float* taps = peak_filter.data() + p * kTruePeakTaps;
+      float sum = 0.0f;
+      for (int k=0; k<kTruePeakTaps; k++) {
+        sum += taps[k] * history[kTruePeakTaps - 1 - k];
+      }
+      peak = qMax(peak, std::abs(sum));
+    }
+    block_true_peak_ = qMax(block_true_peak_, peak);
+
+    mono += s;
+  }
+
+  fft_input_[fft_position_] = mono / channels;
+  fft_position_++;
+
+  if (fft_position_ == kFFTSize) {
+    AnalyzeSpectrum();
+
+    // Keep the second half for the next overlapping window
+    std::copy(fft_input_.begin() + kFFTHop, fft_input_.end(), fft_input_.begin());
+    fft_position_ = kFFTSize - kFFTHop;
+  }
+
+  block_position_++;
+
+  if (block_position_ == block_length_) {
+    FinishBlock();
+  }
+}
+
+void AudioAnalysis::FileWriter::FinishBlock()
+{
+  Block b;
+  b.weighted_mean_square = float(block_weighted_sum_ / block_position_);
+  b.true_peak = block_true_peak_;
+  analysis_->blocks_.append(b);
+
+  QVector<float>& spectrum = analysis_->spectrum_[rational(kBlocksPerSecond)];
+  int previous = spectrum.size() - kSpectrumBands;
+
+  if (block_spectrum_frames_ > 0) {
+    for (int i=0; i<kSpectrumBands; i++) {
+      spectrum.append(block_spectrum_[i] / block_spectrum_frames_);
+    }
+  } else if (previous >= 0) {
+    // At low sample rates a block can be shorter than the hop, carry the last spectrum forward
+    for (int i=0; i<kSpectrumBands; i++) {
+      spectrum.append(spectrum.at(previous + i));
+    }
+  } else {
+    spectrum.append(QVector<float>(kSpectrumBands, 0.0f));
+  }
+
+  block_position_ = 0;
+  block_weighted_sum_ = 0.0;
+  block_true_peak_ = 0.0f;
+  std::fill(block_spectrum_.begin(), block_spectrum_.end(), 0.0f);
+  block_spectrum_frames_ = 0;
+}
+
+void AudioAnalysis::FileWriter::AnalyzeSpectrum()
+{
+  for (int i=0; i<kFFTSize; i++) {
+    fft_windowed_[i] = fft_input_[i] * window_[i];
+  }
+
+  fft_->PowerSpectrum(fft_windowed_.data(), fft_power_.data());
+
+  // Normalize so a full scale sine sums to 1 across the bins it spreads over
+  const double window_gain = kFFTSize * 0.5;
+  const double norm = 1.0 / (window_gain * window_gain * 0.25 * kHannNoiseBandwidth);
+
+  int sample_rate = analysis_->sample_rate_;
+  double bin_width = double(sample_rate) / kFFTSize;
+
+  for (int b=0; b<kSpectrumBands; b++) {
+    int first = qCeil(BandEdge(b, sample_rate) / bin_width);
+    int last = qMin(kFFTSize / 2, qCeil(BandEdge(b + 1, sample_rate) / bin_width));
+
+    if (last <= first) {
+      // Band narrower than a bin, use the bin its center falls in
+      first = qMin(kFFTSize / 2, qRound(analysis_->GetBandFrequency(b) / bin_width));
+      last = first + 1;
+    }
+
+    double sum = 0.0;
+    for (int i=first; i<last; i++) {
+      sum += fft_power_[i];
+    }
+
+    block_spectrum_[b] += float(sum * norm);
+  }
+
+  block_spectrum_frames_++;
+}
+
+}
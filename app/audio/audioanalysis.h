@@ -0,0 +1,230 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOANALYSIS_H
+#define AUDIOANALYSIS_H
+
+#include <map>
+#include <memory>
+#include <QVector>
+
+#include "audio/audiolevels.h"
+#include "codec/samplebuffer.h"
+
+namespace olive {
+
+/**
+ * @brief Loudness, true-peak and spectrum measurements of a whole piece of audio
+ *
+ * Audio is measured in 100ms blocks (the BS.1770 gating step). For each block the channel-weighted
+ * K-weighted mean square, the true peak (4x oversampled) and a spectrum of kSpectrumBands
+ * log-spaced bands are stored. Integrated loudness (BS.1770-4), loudness range (EBU Tech 3342) and
+ * the overall true peak are derived from the blocks once the audio has been measured.
+ *
+ * Spectra are mipmapped like AudioVisualWaveform so that any range can be summarized by reading a
+ * handful of entries. They're measured on a mono downmix to keep analysis files small.
+ *
+ * Analysis files are written alongside conformed audio by ConformTask, in the same pass that
+ * builds the visual waveform, so loudness-normalizing an export or drawing a spectrum never has to
+ * read the audio again.
+ */
+class AudioAnalysis
+{
+public:
+  AudioAnalysis();
+
+  static const int kBlocksPerSecond;
+
+  static const int kSpectrumBands;
+
+  int channel_count() const
+  {
+    return channels_;
+  }
+
+  int sample_rate() const
+  {
+    return sample_rate_;
+  }
+
+  rational length() const;
+
+  /**
+   * @brief Gated integrated loudness of the whole audio in LUFS, or -HUGE_VAL for silence
+   */
+  double integrated_loudness() const
+  {
+    return integrated_loudness_;
+  }
+
+  /**
+   * @brief Loudness range in LU
+   */
+  double loudness_range() const
+  {
+    return loudness_range_;
+  }
+
+  /**
+   * @brief Highest true peak of any channel as a linear amplitude
+   */
+  float true_peak() const
+  {
+    return true_peak_;
+  }
+
+  /**
+   * @brief Highest true peak of any channel in this range as a linear amplitude
+   */
+  float GetTruePeakFromTime(const rational& start, const rational& length) const;
+
+  /**
+   * @brief Momentary loudness in LUFS over the 400ms ending at `time`
+   */
+  double GetMomentaryLoudness(const rational& time) const;
+
+  /**
+   * @brief Short-term loudness in LUFS over the 3s ending at `time`
+   */
+  double GetShortTermLoudness(const rational& time) const;
+
+  /**
+   * @brief Average power of each spectrum band over a range in decibels (0 dB is a full scale sine)
+   *
+   * Uses the coarsest mipmap that still has several entries in the range.
+   */
+  QVector<float> GetSpectrumFromTime(const rational& start, const rational& length) const;
+
+  /**
+   * @brief Center frequency of spectrum band `band` in Hz
+   */
+  double GetBandFrequency(int band) const;
+
+  /**
+   * @brief Read an analysis file written by FileWriter
+   */
+  bool LoadFromFile(const QString& filename);
+
+  /**
+   * @brief Measures audio in one pass and writes it to an analysis file
+   *
+   * Samples must be written in order from the start. Blocks are measured as soon as they're
+   * complete, so only the measurements themselves are held in memory.
+   */
+  class FileWriter
+  {
+  public:
+    FileWriter(const QString& filename, const AudioParams& params);
+
+    ~FileWriter();
+
+    DISABLE_COPY_MOVE(FileWriter)
+
+    bool open();
+
+    void write(SampleBufferPtr samples);
+
+    bool close();
+
+  private:
+    class FFT;
+
+    void ProcessSample(const float* frame);
+
+    void FinishBlock();
+
+    void AnalyzeSpectrum();
+
+    QString filename_;
+
+    bool open_;
+
+    AudioParams params_;
+
+    std::unique_ptr<AudioAnalysis> analysis_;
+
+    int block_length_;
+
+    int block_position_;
+
+    std::vector<AudioLevels::KWeightingFilter> weighting_;
+
+    std::vector<double> channel_gain_;
+
+    double block_weighted_sum_;
+
+    float block_true_peak_;
+
+    // Recent samples of each channel for the true-peak interpolator, newest last
+    std::vector<std::vector<float> > peak_history_;
+
+    // Mono downmix waiting to be transformed, and the transform itself
+    std::vector<float> fft_input_;
+
+    int fft_position_;
+
+    std::vector<float> fft_windowed_;
+
+    std::vector<float> fft_power_;
+
+    std::unique_ptr<FFT> fft_;
+
+    std::vector<float> window_;
+
+    std::vector<float> block_spectrum_;
+
+    int block_spectrum_frames_;
+
+  };
+
+private:
+  struct Block {
+    float weighted_mean_square;
+    float true_peak;
+  };
+
+  void ComputeSummary();
+
+  void BuildSpectrumMipmaps();
+
+  double WindowLoudness(int end_block, int window) const;
+
+  int TimeToBlock(const rational& time) const;
+
+  int channels_;
+
+  int sample_rate_;
+
+  double integrated_loudness_;
+
+  double loudness_range_;
+
+  float true_peak_;
+
+  QVector<Block> blocks_;
+
+  // Spectrum mipmaps keyed by entries per second, each entry holds kSpectrumBands powers
+  std::map<rational, QVector<float> > spectrum_;
+
+};
+
+}
+
+#endif // AUDIOANALYSIS_H
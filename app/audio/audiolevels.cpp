@@ -0,0 +1,276 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audiolevels.h"
+
+#include <cmath>
+#include <QtMath>
+
+namespace olive {
+
+const int AudioLevels::kBlocksPerSecond = 100;
+
+AudioLevels::AudioLevels() :
+  channels_(0)
+{
+}
+
+void AudioLevels::Save(QDataStream &s) const
+{
+  s << qint32(channels_) << qint32(data_.size());
+
+  foreach (const Level& l, data_) {
+    s << l.peak << l.mean_square << l.weighted_mean_square;
+  }
+}
+
+bool AudioLevels::Load(QDataStream &s)
+{
+  qint32 channels, count;
+  s >> channels >> count;
+
+  if (s.status() != QDataStream::Ok || channels < 0 || count < 0) {
+    return false;
+  }
+
+  // Don't trust the count to allocate up front, a damaged file would stop the loop early anyway
+  QVector<Level> data;
+
+  for (qint32 i=0; i<count && s.status() == QDataStream::Ok; i++) {
+    Level l;
+    s >> l.peak >> l.mean_square >> l.weighted_mean_square;
+    data.append(l);
+  }
+
+  if (s.status() != QDataStream::Ok) {
+    return false;
+  }
+
+  channels_ = channels;
+  data_ = data;
+
+  return true;
+}
+
+rational AudioLevels::length() const
+{
+  return rational(block_count(), kBlocksPerSecond);
+}
+
+void AudioLevels::SetSamples(SampleBufferPtr samples, int sample_rate)
+{
+  data_.clear();
+
+  if (!samples || !samples->is_allocated() || sample_rate <= 0) {
+    return;
+  }
+
+  channels_ = samples->audio_params().channel_count();
+
+  int nb_samples = samples->sample_count();
+  int block_length = qMax(1, sample_rate / kBlocksPerSecond);
+  int nb_blocks = (nb_samples + block_length - 1) / block_length;
+
+  data_.resize(nb_blocks * channels_);
+
+  for (int c=0; c<channels_; c++) {
+    const float* plane = samples->data(c);
+
+    KWeightingFilter filter(sample_rate);
+
+    for (int b=0; b<nb_blocks; b++) {
+      int start = b * block_length;
+      int end = qMin(start + block_length, nb_samples);
+
+      float peak = 0.0f;
+      double sum = 0.0;
+      double weighted_sum = 0.0;
+
+      for (int i=start; i<end; i++) {
+        float s = plane[i];
+        float w = filter.process(s);
+
+        peak = qMax(peak, std::abs(s));
+        sum += double(s) * double(s);
+        weighted_sum += double(w) * double(w);
+      }
+
+      double count = end - start;
+
+      Level& l = data_[b * channels_ + c];
+      l.peak = peak;
+      l.mean_square = float(sum / count);
+      l.weighted_mean_square = float(weighted_sum / count);
+    }
+  }
+}
+
+void AudioLevels::OverwriteLevels(const AudioLevels &levels, const rational &dest, const rational &offset, const rational &length)
+{
+  if (!channels_ || levels.channel_count() != channels_) {
+    return;
+  }
+
+  int our_start = TimeToBlock(dest);
+  int their_start = TimeToBlock(offset);
+
+  int copy_len = levels.block_count() - their_start;
+  if (!length.isNull()) {
+    copy_len = qMin(copy_len, TimeToBlock(dest + length) - our_start);
+  }
+
+  if (copy_len <= 0) {
+    return;
+  }
+
+  int end = our_start + copy_len;
+  if (block_count() < end) {
+    data_.resize(end * channels_);
+  }
+
+  memcpy(data_.data() + our_start * channels_,
+         levels.data_.constData() + their_start * channels_,
+         copy_len * channels_ * sizeof(Level));
+}
+
+void AudioLevels::OverwriteSilence(const rational &start, const rational &length)
+{
+  if (!channels_) {
+    return;
+  }
+
+  int start_block = TimeToBlock(start);
+  int end_block = TimeToBlock(start + length);
+
+  if (end_block <= start_block) {
+    return;
+  }
+
+  if (block_count() < end_block) {
+    data_.resize(end_block * channels_);
+  }
+
+  memset(data_.data() + start_block * channels_, 0, (end_block - start_block) * channels_ * sizeof(Level));
+}
+
+AudioLevels::Summary AudioLevels::GetSummaryFromTime(const rational &start, const rational &length) const
+{
+  Summary s;
+  s.peak.fill(0.0f, channels_);
+  s.rms.fill(0.0f, channels_);
+  s.momentary_loudness = MeanSquareToLoudness(0.0);
+
+  int nb_blocks = block_count();
+  int start_block = qBound(0, TimeToBlock(start), nb_blocks);
+
+  // Always cover at least one block so short repaint intervals still report something
+  int end_block = qBound(start_block, qMax(TimeToBlock(start + length), start_block + 1), nb_blocks);
+
+  if (start_block == end_block) {
+    return s;
+  }
+
+  QVector<double> sums(channels_, 0.0);
+
+  for (int b=start_block; b<end_block; b++) {
+    const Level* l = data_.constData() + b * channels_;
+
+    for (int c=0; c<channels_; c++) {
+      s.peak[c] = qMax(s.peak.at(c), l[c].peak);
+      sums[c] += l[c].mean_square;
+    }
+  }
+
+  for (int c=0; c<channels_; c++) {
+    s.rms[c] = float(std::sqrt(sums.at(c) / (end_block - start_block)));
+  }
+
+  // Momentary loudness uses a fixed 400ms window, summed across channels
+  int window = kBlocksPerSecond * 2 / 5;
+  int window_start = qMax(0, end_block - window);
+  double weighted = 0.0;
+
+  for (int b=window_start; b<end_block; b++) {
+    const Level* l = data_.constData() + b * channels_;
+
+    for (int c=0; c<channels_; c++) {
+      weighted += l[c].weighted_mean_square;
+    }
+  }
+
+  s.momentary_loudness = MeanSquareToLoudness(weighted / (end_block - window_start));
+
+  return s;
+}
+
+AudioLevels::KWeightingFilter::KWeightingFilter(int sample_rate)
+{
+  // Shelving stage, modelling the acoustic effect of the head
+  {
+    const double f0 = 1681.974450955533;
+    const double gain = 3.999843853973347;
+    const double q = 0.7071752369554196;
+
+    double k = std::tan(M_PI * f0 / sample_rate);
+    double vh = std::pow(10.0, gain / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+
+    shelf_.b0 = (vh + vb * k / q + k * k) / a0;
+    shelf_.b1 = 2.0 * (k * k - vh) / a0;
+    shelf_.b2 = (vh - vb * k / q + k * k) / a0;
+    shelf_.a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf_.a2 = (1.0 - k / q + k * k) / a0;
+  }
+
+  // High-pass stage (RLB weighting)
+  {
+    const double f0 = 38.13547087602444;
+    const double q = 0.5003270373238773;
+
+    double k = std::tan(M_PI * f0 / sample_rate);
+    double a0 = 1.0 + k / q + k * k;
+
+    highpass_.b0 = 1.0;
+    highpass_.b1 = -2.0;
+    highpass_.b2 = 1.0;
+    highpass_.a1 = 2.0 * (k * k - 1.0) / a0;
+    highpass_.a2 = (1.0 - k / q + k * k) / a0;
+  }
+
+  shelf_.z1 = shelf_.z2 = 0.0;
+  highpass_.z1 = highpass_.z2 = 0.0;
+}
+
+double AudioLevels::MeanSquareToLoudness(double weighted_mean_square)
+{
+  if (weighted_mean_square <= 0.0) {
+    return -HUGE_VAL;
+  }
+
+  return -0.691 + 10.0 * std::log10(weighted_mean_square);
+}
+
+int AudioLevels::TimeToBlock(const rational &time)
+{
+  return qFloor(time.toDouble() * kBlocksPerSecond);
+}
+
+}
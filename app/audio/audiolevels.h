@@ -0,0 +1,154 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOLEVELS_H
+#define AUDIOLEVELS_H
+
+#include <QDataStream>
+#include <QVector>
+
+#include "codec/samplebuffer.h"
+
+namespace olive {
+
+/**
+ * @brief Precomputed loudness measurements for metering
+ *
+ * Audio is measured in 10ms blocks. For each block and channel the peak, mean square and
+ * K-weighted mean square (ITU-R BS.1770) are stored, so a meter can report peak, RMS and
+ * momentary loudness at any time by combining a handful of blocks rather than re-reading samples.
+ *
+ * Levels are measured on the render side alongside the visual waveform and stored in the
+ * AudioPlaybackCache with the PCM they describe.
+ */
+class AudioLevels
+{
+public:
+  AudioLevels();
+
+  static const int kBlocksPerSecond;
+
+  struct Level {
+    float peak;
+    float mean_square;
+    float weighted_mean_square;
+  };
+
+  struct Summary {
+    QVector<float> peak;
+    QVector<float> rms;
+
+    /// Momentary loudness in LUFS over the 400ms ending at the end of the summarized range
+    double momentary_loudness;
+  };
+
+  int channel_count() const
+  {
+    return channels_;
+  }
+
+  void set_channel_count(int channels)
+  {
+    channels_ = channels;
+  }
+
+  rational length() const;
+
+  /**
+   * @brief Measure `samples` into this object, replacing anything already in it
+   */
+  void SetSamples(SampleBufferPtr samples, int sample_rate);
+
+  /**
+   * @brief Copy `length` of another object's levels from `offset` into this one at `dest`
+   */
+  void OverwriteLevels(const AudioLevels& levels, const rational& dest, const rational& offset, const rational& length);
+
+  void OverwriteSilence(const rational& start, const rational& length);
+
+  Summary GetSummaryFromTime(const rational& start, const rational& length) const;
+
+  static double MeanSquareToLoudness(double weighted_mean_square);
+
+  /**
+   * @brief Streaming BS.1770 K-weighting filter for one channel
+   *
+   * Keeps its state between calls to process(), so a channel can be fed in pieces.
+   */
+  class KWeightingFilter
+  {
+  public:
+    KWeightingFilter(int sample_rate);
+
+    float process(float in)
+    {
+      return highpass_.process(shelf_.process(in));
+    }
+
+  private:
+    /**
+     * @brief Direct form II transposed biquad
+     */
+    struct Biquad {
+      double b0, b1, b2, a1, a2;
+      double z1, z2;
+
+      float process(float in)
+      {
+        double out = b0 * in + z1;
+        z1 = b1 * in - a1 * out + z2;
+        z2 = b2 * in - a2 * out;
+        return float(out);
+      }
+    };
+
+    Biquad shelf_;
+
+    Biquad highpass_;
+
+  };
+
+  void Save(QDataStream& s) const;
+
+  /**
+   * @brief Read levels written by Save(), returning FALSE and leaving this object as-is on failure
+   */
+  bool Load(QDataStream& s);
+
+private:
+  static int TimeToBlock(const rational& time);
+
+  int block_count() const
+  {
+    return channels_ ? data_.size() / channels_ : 0;
+  }
+
+  int channels_;
+
+  // Block-major, each block has one Level per channel
+  QVector<Level> data_;
+
+};
+
+}
+
+Q_DECLARE_METATYPE(olive::AudioLevels)
+
+#endif // AUDIOLEVELS_H
@@ -20,6 +20,7 @@
 
 #include "audiomanager.h"
 
+#include <algorithm>
 #include <QApplication>
 
 #include "config/config.h"
@@ -33,6 +34,10 @@ QString AudioManager::GetAudioBackendName(AudioManager::Backend b)
   switch (b) {
   case kAudioBackendQt:
     return tr("Qt");
+#ifdef USE_PORTAUDIO
+  case kAudioBackendPortAudio:
+    return tr("Native (PortAudio)");
+#endif
   case kAudioBackendCount:
     break;
   }
@@ -40,6 +45,17 @@ QString AudioManager::GetAudioBackendName(AudioManager::Backend b)
   return tr("Unknown");
 }
 
+AudioManager::Backend AudioManager::GetConfiguredBackend()
+{
+  int b = Config::kAudioBackend.Get();
+
+  if (b < 0 || b >= kAudioBackendCount) {
+    return kAudioBackendQt;
+  }
+
+  return static_cast<Backend>(b);
+}
+
 void AudioManager::CreateInstance()
 {
   if (instance_ == nullptr) {
@@ -103,6 +119,7 @@ void AudioManager::StartOutput(AudioPlaybackCache *cache, qint64 offset, int pla
   device->moveToThread(&output_thread_);
 
   // Queue to output manger in other thread
+  output_manager_->ExpectNewDevice();
   QMetaObject::invokeMethod(output_manager_,
                             "PullFromDevice",
                             Qt::QueuedConnection,
@@ -122,6 +139,11 @@ void AudioManager::StopOutput()
   emit Stopped();
 }
 
+qint64 AudioManager::GetOutputPlayedUSecs() const
+{
+  return output_manager_->GetPlayedUSecs();
+}
+
 void AudioManager::SetOutputDevice(const QAudioDeviceInfo &info)
 {
   qInfo() << "Setting output audio device to" << info.deviceName();
@@ -130,6 +152,23 @@ void AudioManager::SetOutputDevice(const QAudioDeviceInfo &info)
 
   output_device_info_ = info;
 
+#ifdef USE_PORTAUDIO
+  if (output_params_.is_valid() && GetConfiguredBackend() == kAudioBackendPortAudio) {
+    // PortAudio negotiates the format itself, the output manager converts to whatever it opens with.
+    // Native device names don't match Qt's, so only a device the user picked is looked up by name.
+    QMetaObject::invokeMethod(output_manager_,
+                              "SetNativeOutputDevice",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, Config::Current()[QStringLiteral("AudioOutput")].toString()),
+                              OLIVE_NS_ARG(AudioParams, output_params_),
+                              Q_ARG(int, Config::Current()[QStringLiteral("AudioOutputLatency")].toInt()),
+                              Q_ARG(int, Config::kAudioBufferFrames.Get()),
+                              Q_ARG(bool, Config::kAudioExclusiveMode.Get()));
+    output_is_set_ = true;
+    return;
+  }
+#endif
+
   if (output_params_.is_valid()) {
     QAudioFormat format;
     format.setSampleRate(output_params_.sample_rate());
@@ -139,12 +178,25 @@ void AudioManager::SetOutputDevice(const QAudioDeviceInfo &info)
     format.setSampleSize(output_params_.bits_per_sample());
     format.setSampleType(AudioParams::GetQtSampleType(output_params_.format()));
 
+    if (!info.isFormatSupported(format)) {
+      // Let the output manager convert to whatever the device can play instead
+      QAudioFormat nearest = info.nearestFormat(format);
+
+      if (AudioParams::GetFormatFromQt(nearest.sampleType(), nearest.sampleSize()) != AudioParams::kFormatInvalid
+          && nearest.byteOrder() == QAudioFormat::LittleEndian
+          && nearest.channelCount() > 0 && nearest.sampleRate() > 0) {
+        qInfo() << "Output format not supported by device, converting to" << nearest;
+        format = nearest;
+      }
+    }
+
     if (info.isFormatSupported(format)) {
       QMetaObject::invokeMethod(output_manager_,
                                 "SetOutputDevice",
                                 Qt::QueuedConnection,
                                 Q_ARG(const QAudioDeviceInfo&, info),
-                                Q_ARG(const QAudioFormat&, format));
+                                Q_ARG(const QAudioFormat&, format),
+                                Q_ARG(int, Config::Current()[QStringLiteral("AudioOutputLatency")].toInt()));
       output_is_set_ = true;
     } else {
       qWarning() << "Output format not supported by device";
@@ -171,8 +223,33 @@ void AudioManager::SetOutputParams(const AudioParams &params)
 
 void AudioManager::SetInputDevice(const QAudioDeviceInfo &info)
 {
-  input_ = std::unique_ptr<QAudioInput>(new QAudioInput(info, QAudioFormat(), this));
   input_device_info_ = info;
+  input_is_set_ = true;
+}
+
+bool AudioManager::StartRecording(const QString &filename)
+{
+  if (!input_is_set_ || input_device_info_.isNull()) {
+    return false;
+  }
+
+  if (!recorder_.Start(input_device_info_, filename)) {
+    return false;
+  }
+
+  emit RecordingStarted(filename);
+  return true;
+}
+
+void AudioManager::StopRecording()
+{
+  if (!recorder_.IsRecording()) {
+    return;
+  }
+
+  recorder_.Stop();
+
+  emit RecordingStopped(recorder_.filename());
 }
 
 const QList<QAudioDeviceInfo> &AudioManager::ListInputDevices()
@@ -188,27 +265,21 @@ const QList<QAudioDeviceInfo> &AudioManager::ListOutputDevices()
 void AudioManager::ReverseBuffer(char *buffer, int buffer_size, int sample_size)
 {
   int half_buffer_sz = buffer_size / 2;
-  char* temp_buffer = new char[sample_size];
 
   for (int src_index=0;src_index<half_buffer_sz;src_index+=sample_size) {
     char* src_ptr = buffer + src_index;
     char* dst_ptr = buffer + buffer_size - sample_size - src_index;
 
-    // Simple swap
-    memcpy(temp_buffer, src_ptr, static_cast<size_t>(sample_size));
-    memcpy(src_ptr, dst_ptr, static_cast<size_t>(sample_size));
-    memcpy(dst_ptr, temp_buffer, static_cast<size_t>(sample_size));
+    // Simple swap, done in place so playback never allocates here
+    std::swap_ranges(src_ptr, src_ptr + sample_size, dst_ptr);
   }
-
-  delete [] temp_buffer;
 }
 
 AudioManager::AudioManager() :
   is_refreshing_inputs_(false),
   is_refreshing_outputs_(false),
   output_is_set_(false),
-  input_(nullptr),
-  input_file_(nullptr)
+  input_is_set_(false)
 {
   RefreshDevices();
 
@@ -221,6 +292,8 @@ AudioManager::AudioManager() :
 
 AudioManager::~AudioManager()
 {
+  recorder_.Stop();
+
   QMetaObject::invokeMethod(output_manager_, "deleteLater", Qt::BlockingQueuedConnection);
   output_thread_.quit();
   output_thread_.wait();
@@ -263,7 +336,7 @@ void AudioManager::InputDevicesRefreshed()
 
   QString preferred_audio_input = Config::Current()["AudioInput"].toString();
 
-  if (input_ == nullptr
+  if (!input_is_set_
       || (!preferred_audio_input.isEmpty() && input_device_info_.deviceName() != preferred_audio_input)) {
     if (preferred_audio_input.isEmpty()) {
       SetInputDevice(QAudioDeviceInfo::defaultInputDevice());
@@ -27,6 +27,8 @@
 #include <QtConcurrent/QtConcurrent>
 #include <QThread>
 
+#include "audiolevels.h"
+#include "audiorecorder.h"
 #include "audiovisualwaveform.h"
 #include "common/define.h"
 #include "outputmanager.h"
@@ -47,11 +49,19 @@ class AudioManager : public QObject
 public:
   enum Backend {
     kAudioBackendQt,
+#ifdef USE_PORTAUDIO
+    kAudioBackendPortAudio,
+#endif
     kAudioBackendCount
   };
 
   static QString GetAudioBackendName(Backend b);
 
+  /**
+   * @brief The backend set in the config, or Qt's if that one isn't available in this build
+   */
+  static Backend GetConfiguredBackend();
+
   static void CreateInstance();
   static void DestroyInstance();
 
@@ -75,12 +85,42 @@ public:
    */
   void StopOutput();
 
+  /**
+   * @brief How much audio from the last StartOutput() has been heard, in microseconds
+   *
+   * Returns -1 if it hasn't started playing yet or output has stopped. This function is
+   * thread-safe.
+   */
+  qint64 GetOutputPlayedUSecs() const;
+
   void SetOutputDevice(const QAudioDeviceInfo& info);
 
   void SetOutputParams(const AudioParams& params);
 
   void SetInputDevice(const QAudioDeviceInfo& info);
 
+  /**
+   * @brief Start recording the current input device to a WAV file
+   *
+   * Returns false if there's no input device or it couldn't be opened.
+   */
+  bool StartRecording(const QString& filename);
+
+  /**
+   * @brief Stop recording, returning once the file is complete
+   */
+  void StopRecording();
+
+  bool IsRecording() const
+  {
+    return recorder_.IsRecording();
+  }
+
+  const AudioRecorder* recorder() const
+  {
+    return &recorder_;
+  }
+
   const QList<QAudioDeviceInfo>& ListInputDevices();
   const QList<QAudioDeviceInfo>& ListOutputDevices();
 
@@ -95,7 +135,7 @@ signals:
 
   void OutputDeviceStarted(AudioPlaybackCache* cache, qint64 offset, int playback_speed);
 
-  void OutputWaveformStarted(const AudioVisualWaveform* waveform, const rational &start, int playback_speed);
+  void OutputWaveformStarted(const AudioVisualWaveform* waveform, const AudioLevels* levels, const rational &start, int playback_speed);
 
   void AudioParamsChanged(const AudioParams& params);
 
@@ -103,6 +143,10 @@ signals:
 
   void Stopped();
 
+  void RecordingStarted(const QString& filename);
+
+  void RecordingStopped(const QString& filename);
+
 private:
   AudioManager();
 
@@ -123,9 +167,9 @@ private:
   QAudioDeviceInfo output_device_info_;
   AudioParams output_params_;
 
-  std::unique_ptr<QAudioInput> input_;
+  bool input_is_set_;
   QAudioDeviceInfo input_device_info_;
-  QIODevice* input_file_;
+  AudioRecorder recorder_;
 
 private slots:
   void OutputDevicesRefreshed();
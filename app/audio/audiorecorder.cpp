@@ -0,0 +1,343 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audiorecorder.h"
+
+#include <cstring>
+#include <QDebug>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+}
+
+namespace olive {
+
+const int AudioRecorder::kRingMilliseconds = 2000;
+
+namespace {
+
+// How long the writer sleeps when the ring is empty
+const int kWriterPollInterval = 10;
+
+// How much audio the WAV header is allowed to lag behind the data, in samples per channel
+const int kHeaderUpdateSeconds = 1;
+
+}
+
+AudioCaptureWorker::AudioCaptureWorker() :
+  sink_(nullptr),
+  input_(nullptr)
+{
+}
+
+bool AudioCaptureWorker::Start(const QAudioDeviceInfo &info, const QAudioFormat &format)
+{
+  Stop();
+
+  input_ = new QAudioInput(info, format, this);
+
+  // Small device buffers keep latency down, the ring absorbs any hiccups on our side
+  input_->setBufferSize(format.bytesForDuration(50000));
+
+  input_->start(sink_);
+
+  if (input_->error() != QAudio::NoError) {
+    qWarning() << "Failed to start audio input:" << input_->error();
+    Stop();
+    return false;
+  }
+
+  return true;
+}
+
+void AudioCaptureWorker::Stop()
+{
+  if (input_) {
+    input_->stop();
+    delete input_;
+    input_ = nullptr;
+  }
+}
+
+AudioRecordWriter::AudioRecordWriter(QObject *parent) :
+  QThread(parent),
+  ring_(nullptr),
+  recorded_samples_(0),
+  stop_(false)
+{
+}
+
+bool AudioRecordWriter::Open(const QString &filename, const AudioParams &params, AudioRingBuffer *ring)
+{
+  output_ = std::unique_ptr<WaveOutput>(new WaveOutput(filename, params));
+
+  if (!output_->open()) {
+    qWarning() << "Failed to open recording file" << filename;
+    output_ = nullptr;
+    return false;
+  }
+
+  params_ = params;
+  ring_ = ring;
+  recorded_samples_.store(0, std::memory_order_release);
+  stop_.store(false, std::memory_order_relaxed);
+
+  // A tenth of a second at a time keeps the waveform lively without writing tiny pieces
+  scratch_.resize(int(params_.samples_to_bytes(params_.sample_rate() / 10)));
+
+  QMutexLocker locker(&waveform_lock_);
+  waveform_ = AudioVisualWaveform();
+  waveform_.set_channel_count(params_.channel_count());
+
+  return true;
+}
+
+void AudioRecordWriter::Stop()
+{
+  stop_.store(true, std::memory_order_release);
+  wait();
+
+  if (output_) {
+    output_->close();
+    output_ = nullptr;
+  }
+}
+
+AudioVisualWaveform AudioRecordWriter::GetWaveform() const
+{
+  QMutexLocker locker(&waveform_lock_);
+  return waveform_;
+}
+
+void AudioRecordWriter::run()
+{
+  qint64 header_samples = 0;
+  int frame_size = params_.samples_to_bytes(1);
+
+  while (true) {
+    // Read whole frames only, the capture side only ever writes whole frames
+    qint64 available = qMin(ring_->readable(), qint64(scratch_.size()));
+    available -= available % frame_size;
+
+    if (available > 0) {
+      ring_->read(scratch_.data(), available);
+      WriteChunk(scratch_.constData(), available);
+
+      if (recorded_samples() - header_samples >= params_.sample_rate() * kHeaderUpdateSeconds) {
+        output_->UpdateHeader();
+        header_samples = recorded_samples();
+      }
+    } else if (stop_.load(std::memory_order_acquire)) {
+      break;
+    } else {
+      msleep(kWriterPollInterval);
+    }
+  }
+}
+
+void AudioRecordWriter::WriteChunk(const char *data, qint64 length)
+{
+  output_->write(data, int(length));
+
+  // Deinterleave into the internal format for the waveform
+  int channels = params_.channel_count();
+  int frames = int(params_.bytes_to_samples(length));
+
+  AudioParams planar_params(params_.sample_rate(), params_.channel_layout(), AudioParams::kInternalFormat);
+  SampleBufferPtr buffer = SampleBuffer::CreateAllocated(planar_params, frames);
+
+  for (int c=0; c<channels; c++) {
+    float* plane = buffer->data(c);
+
+    switch (params_.format()) {
+    case AudioParams::kFormatUnsigned8:
+    {
+      const quint8* src = reinterpret_cast<const quint8*>(data) + c;
+      for (int i=0; i<frames; i++) {
+        plane[i] = (float(src[i * channels]) - 128.0f) / 128.0f;
+      }
+      break;
+    }
+    case AudioParams::kFormatSigned16:
+    {
+      const qint16* src = reinterpret_cast<const qint16*>(data) + c;
+      for (int i=0; i<frames; i++) {
+        plane[i] = float(src[i * channels]) / 32768.0f;
+      }
+      break;
+    }
+    case AudioParams::kFormatSigned32:
+    {
+      const qint32* src = reinterpret_cast<const qint32*>(data) + c;
+      for (int i=0; i<frames; i++) {
+        plane[i] = float(src[i * channels]) / 2147483648.0f;
+      }
+      break;
+    }
+    case AudioParams::kFormatFloat32:
+    {
+      const float* src = reinterpret_cast<const float*>(data) + c;
+      for (int i=0; i<frames; i++) {
+        plane[i] = src[i * channels];
+      }
+      break;
+    }
+    case AudioParams::kFormatSigned64:
+    case AudioParams::kFormatFloat64:
+    case AudioParams::kFormatInvalid:
+    case AudioParams::kFormatCount:
+      // GetCaptureFormat() never picks these
+      memset(plane, 0, frames * sizeof(float));
+      break;
+    }
+  }
+
+  rational start(recorded_samples(), params_.sample_rate());
+
+  {
+    QMutexLocker locker(&waveform_lock_);
+    waveform_.OverwriteSamples(buffer, params_.sample_rate(), start);
+  }
+
+  recorded_samples_.fetch_add(frames, std::memory_order_acq_rel);
+}
+
+AudioRecorder::AudioRecorder(QObject *parent) :
+  QObject(parent),
+  recording_(false)
+{
+  // Needed to hand these to the capture thread
+  qRegisterMetaType<QAudioDeviceInfo>();
+  qRegisterMetaType<QAudioFormat>();
+
+  capture_thread_.start(QThread::TimeCriticalPriority);
+
+  worker_ = new AudioCaptureWorker();
+  worker_->moveToThread(&capture_thread_);
+}
+
+AudioRecorder::~AudioRecorder()
+{
+  Stop();
+
+  QMetaObject::invokeMethod(worker_, "deleteLater", Qt::BlockingQueuedConnection);
+  capture_thread_.quit();
+  capture_thread_.wait();
+}
+
+bool AudioRecorder::Start(const QAudioDeviceInfo &device, const QString &filename)
+{
+  Stop();
+
+  QAudioFormat format = GetCaptureFormat(device);
+  if (!format.isValid()) {
+    qWarning() << "No supported recording format for" << device.deviceName();
+    return false;
+  }
+
+  params_ = AudioParams(format.sampleRate(),
+                        uint64_t(av_get_default_channel_layout(format.channelCount())),
+                        AudioParams::GetFormatFromQt(format.sampleType(), format.sampleSize()));
+
+  ring_.Allocate(params_.samples_to_bytes(params_.sample_rate() * kRingMilliseconds / 1000));
+
+  if (!writer_.Open(filename, params_, &ring_)) {
+    return false;
+  }
+
+  sink_ = std::unique_ptr<AudioRingSink>(new AudioRingSink(&ring_, params_.samples_to_bytes(1)));
+  sink_->open(QIODevice::WriteOnly);
+  worker_->set_sink(sink_.get());
+
+  writer_.start(QThread::HighPriority);
+
+  bool started = false;
+  QMetaObject::invokeMethod(worker_, "Start", Qt::BlockingQueuedConnection,
+                            Q_RETURN_ARG(bool, started),
+                            Q_ARG(const QAudioDeviceInfo&, device),
+                            Q_ARG(const QAudioFormat&, format));
+
+  if (!started) {
+    writer_.Stop();
+    sink_ = nullptr;
+    return false;
+  }
+
+  filename_ = filename;
+  recording_ = true;
+
+  return true;
+}
+
+void AudioRecorder::Stop()
+{
+  if (!recording_) {
+    return;
+  }
+
+  // Stop capturing first so the writer can drain everything that was captured
+  QMetaObject::invokeMethod(worker_, "Stop", Qt::BlockingQueuedConnection);
+  ring_.set_end_of_stream(true);
+  writer_.Stop();
+
+  if (sink_->overrun_count()) {
+    qWarning() << "Recording dropped audio" << sink_->overrun_count() << "times";
+  }
+
+  sink_->close();
+
+  recording_ = false;
+}
+
+rational AudioRecorder::GetRecordedLength() const
+{
+  if (!params_.is_valid()) {
+    return 0;
+  }
+
+  return rational(writer_.recorded_samples(), params_.sample_rate());
+}
+
+QAudioFormat AudioRecorder::GetCaptureFormat(const QAudioDeviceInfo &device)
+{
+  // Prefer float at the device's own rate and channel count so nothing is converted or lost
+  QAudioFormat format = device.preferredFormat();
+  format.setCodec(QStringLiteral("audio/pcm"));
+  format.setByteOrder(QAudioFormat::LittleEndian);
+  format.setSampleType(QAudioFormat::Float);
+  format.setSampleSize(32);
+
+  if (!device.isFormatSupported(format)) {
+    format = device.nearestFormat(format);
+  }
+
+  AudioParams::Format f = AudioParams::GetFormatFromQt(format.sampleType(), format.sampleSize());
+
+  if (!device.isFormatSupported(format)
+      || format.byteOrder() != QAudioFormat::LittleEndian
+      || format.channelCount() <= 0 || format.sampleRate() <= 0
+      || f == AudioParams::kFormatInvalid || f == AudioParams::kFormatSigned64 || f == AudioParams::kFormatFloat64) {
+    return QAudioFormat();
+  }
+
+  return format;
+}
+
+}
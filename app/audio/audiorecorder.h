@@ -0,0 +1,206 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIORECORDER_H
+#define AUDIORECORDER_H
+
+#include <atomic>
+#include <memory>
+#include <QAudioInput>
+#include <QMutex>
+#include <QThread>
+
+#include "audioringbuffer.h"
+#include "audiovisualwaveform.h"
+#include "codec/waveoutput.h"
+#include "render/audioparams.h"
+
+namespace olive {
+
+/**
+ * @brief Owns the QAudioInput of a recording on the capture thread
+ *
+ * The input pushes straight into an AudioRingSink, so capture keeps up however busy the GUI is.
+ */
+class AudioCaptureWorker : public QObject
+{
+  Q_OBJECT
+public:
+  AudioCaptureWorker();
+
+  /**
+   * @brief Set where captured audio goes, only while not capturing
+   */
+  void set_sink(AudioRingSink* sink)
+  {
+    sink_ = sink;
+  }
+
+public slots:
+  bool Start(const QAudioDeviceInfo& info, const QAudioFormat& format);
+
+  void Stop();
+
+private:
+  AudioRingSink* sink_;
+
+  QAudioInput* input_;
+
+};
+
+/**
+ * @brief Thread that drains a recording's ring into a WAV file and its live waveform
+ *
+ * The WAV header is kept up to date as it goes, so the file can be played while it's still being
+ * recorded.
+ */
+class AudioRecordWriter : public QThread
+{
+public:
+  AudioRecordWriter(QObject* parent = nullptr);
+
+  /**
+   * @brief Open the output file, only while the thread isn't running
+   */
+  bool Open(const QString& filename, const AudioParams& params, AudioRingBuffer* ring);
+
+  /**
+   * @brief Write everything left in the ring, close the file and wait for the thread to finish
+   */
+  void Stop();
+
+  /**
+   * @brief Samples per channel written so far, thread-safe
+   */
+  qint64 recorded_samples() const
+  {
+    return recorded_samples_.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Copy of the waveform of everything written so far, thread-safe
+   */
+  AudioVisualWaveform GetWaveform() const;
+
+protected:
+  virtual void run() override;
+
+private:
+  void WriteChunk(const char* data, qint64 length);
+
+  std::unique_ptr<WaveOutput> output_;
+
+  AudioParams params_;
+
+  AudioRingBuffer* ring_;
+
+  QVector<char> scratch_;
+
+  std::atomic<qint64> recorded_samples_;
+
+  std::atomic<bool> stop_;
+
+  mutable QMutex waveform_lock_;
+
+  AudioVisualWaveform waveform_;
+
+};
+
+/**
+ * @brief Records an audio input device to a WAV file
+ *
+ * Capture runs on its own thread and hands audio to the writer thread through a lock-free ring, so
+ * neither the GUI nor disk writes can make the input overrun. The waveform of the recording is built
+ * while it's captured and the file is playable at any point, nothing needs processing afterwards.
+ */
+class AudioRecorder : public QObject
+{
+  Q_OBJECT
+public:
+  AudioRecorder(QObject* parent = nullptr);
+
+  virtual ~AudioRecorder() override;
+
+  /**
+   * @brief Start recording `device` to `filename`, returning false if it couldn't be started
+   */
+  bool Start(const QAudioDeviceInfo& device, const QString& filename);
+
+  void Stop();
+
+  bool IsRecording() const
+  {
+    return recording_;
+  }
+
+  const QString& filename() const
+  {
+    return filename_;
+  }
+
+  const AudioParams& params() const
+  {
+    return params_;
+  }
+
+  rational GetRecordedLength() const;
+
+  AudioVisualWaveform GetWaveform() const
+  {
+    return writer_.GetWaveform();
+  }
+
+  /**
+   * @brief How many times audio had to be dropped because the writer fell behind
+   */
+  int overrun_count() const
+  {
+    return sink_ ? sink_->overrun_count() : 0;
+  }
+
+  /**
+   * @brief How much audio the ring between capture and writer holds, in milliseconds
+   */
+  static const int kRingMilliseconds;
+
+private:
+  static QAudioFormat GetCaptureFormat(const QAudioDeviceInfo& device);
+
+  bool recording_;
+
+  QString filename_;
+
+  AudioParams params_;
+
+  AudioRingBuffer ring_;
+
+  std::unique_ptr<AudioRingSink> sink_;
+
+  QThread capture_thread_;
+
+  AudioCaptureWorker* worker_;
+
+  AudioRecordWriter writer_;
+
+};
+
+}
+
+#endif // AUDIORECORDER_H
@@ -0,0 +1,246 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audioresampler.h"
+
+extern "C" {
+#include <libavutil/opt.h>
+}
+
+#include <QDebug>
+
+#include "common/ffmpegutils.h"
+#include "config/config.h"
+
+namespace olive {
+
+const int AudioResampler::kMaximumPooledPerConversion = 4;
+
+QMutex AudioResampler::pool_lock_;
+
+QHash<AudioResampler::Key, QVector<SwrContext*> > AudioResampler::pool_;
+
+bool AudioResampler::Key::operator==(const Key &rhs) const
+{
+  return in_layout == rhs.in_layout && in_format == rhs.in_format && in_rate == rhs.in_rate
+      && out_layout == rhs.out_layout && out_format == rhs.out_format && out_rate == rhs.out_rate
+      && quality == rhs.quality;
+}
+
+uint qHash(const AudioResampler::Key &k, uint seed)
+{
+  return qHash(k.in_layout, seed) ^ qHash(k.out_layout, seed)
+      ^ qHash((k.in_rate << 8) ^ k.in_format, seed)
+      ^ qHash((k.out_rate << 8) ^ k.out_format ^ (k.quality << 16), seed);
+}
+
+AudioResampler::AudioResampler() :
+  ctx_(nullptr)
+{
+}
+
+AudioResampler::~AudioResampler()
+{
+  Close();
+}
+
+bool AudioResampler::Open(uint64_t in_layout, AVSampleFormat in_format, int in_rate, uint64_t out_layout, AVSampleFormat out_format, int out_rate, Quality quality)
+{
+  Close();
+
+  key_.in_layout = in_layout;
+  key_.in_format = in_format;
+  key_.in_rate = in_rate;
+  key_.out_layout = out_layout;
+  key_.out_format = out_format;
+  key_.out_rate = out_rate;
+  key_.quality = quality;
+
+  {
+    QMutexLocker locker(&pool_lock_);
+
+    auto it = pool_.find(key_);
+    if (it != pool_.end() && !it->isEmpty()) {
+      ctx_ = it->takeLast();
+    }
+  }
+
+  if (ctx_) {
+    // Resampling filters remember the end of the last stream, so start afresh
+    if (in_rate != out_rate && swr_init(ctx_) < 0) {
+      swr_free(&ctx_);
+    }
+  } else {
+    ctx_ = CreateContext(key_);
+  }
+
+  return ctx_;
+}
+
+bool AudioResampler::Open(const AudioParams &in, bool in_planar, const AudioParams &out, bool out_planar, Quality quality)
+{
+  return Open(in.channel_layout(), FFmpegUtils::GetFFmpegSampleFormat(in.format(), in_planar), in.sample_rate(),
+              out.channel_layout(), FFmpegUtils::GetFFmpegSampleFormat(out.format(), out_planar), out.sample_rate(),
+              quality);
+}
+
+void AudioResampler::Close()
+{
+  if (!ctx_) {
+    return;
+  }
+
+  if (key_.in_rate == key_.out_rate) {
+    // Nothing is held back without resampling, but make sure a half-used context isn't handed out
+    swr_drop_output(ctx_, swr_get_out_samples(ctx_, 0));
+  }
+
+  {
+    QMutexLocker locker(&pool_lock_);
+
+    QVector<SwrContext*>& contexts = pool_[key_];
+    if (contexts.size() < kMaximumPooledPerConversion) {
+      contexts.append(ctx_);
+      ctx_ = nullptr;
+    }
+  }
+
+  // Pool is full
+  swr_free(&ctx_);
+}
+
+int AudioResampler::GetOutSamples(int in_count) const
+{
+  return swr_get_out_samples(ctx_, in_count);
+}
+
+int AudioResampler::Convert(uint8_t **out, int out_count, const uint8_t **in, int in_count)
+{
+  return swr_convert(ctx_, out, out_count, in, in_count);
+}
+
+QByteArray AudioResampler::ConvertPacked(const char *in, int in_count, int out_sample_size)
+{
+  QByteArray out;
+
+  int max_out = GetOutSamples(in_count);
+  if (max_out <= 0) {
+    return out;
+  }
+
+  out.resize(max_out * out_sample_size);
+
+  // Packed audio is a single plane
+  uint8_t* out_plane = reinterpret_cast<uint8_t*>(out.data());
+  const uint8_t* in_plane = reinterpret_cast<const uint8_t*>(in);
+
+  int converted = Convert(&out_plane, max_out, in ? &in_plane : nullptr, in_count);
+
+  out.resize(qMax(0, converted) * out_sample_size);
+
+  return out;
+}
+
+bool AudioResampler::IsConversionNeeded(const AudioParams &in, const AudioParams &out)
+{
+  return in.is_valid() && out.is_valid()
+      && (in.format() != out.format()
+          || in.sample_rate() != out.sample_rate()
+          || in.channel_layout() != out.channel_layout());
+}
+
+AudioResampler::Quality AudioResampler::GetDefaultQuality()
+{
+  return static_cast<Quality>(Config::kAudioResampleQuality.Get());
+}
+
+void AudioResampler::ClearPool()
+{
+  QMutexLocker locker(&pool_lock_);
+
+  for (auto it=pool_.begin(); it!=pool_.end(); it++) {
+    for (int i=0; i<it->size(); i++) {
+      swr_free(&(*it)[i]);
+    }
+  }
+
+  pool_.clear();
+}
+
+SwrContext *AudioResampler::CreateContext(const Key &key)
+{
+  bool soxr = (key.quality == kQualityHigh);
+
+  SwrContext* ctx = swr_alloc_set_opts(nullptr,
+                                       static_cast<int64_t>(key.out_layout),
+                                       key.out_format,
+                                       key.out_rate,
+                                       static_cast<int64_t>(key.in_layout),
+                                       key.in_format,
+                                       key.in_rate,
+                                       0,
+                                       nullptr);
+
+  if (!ctx) {
+    return nullptr;
+  }
+
+  ConfigureContext(ctx, key, soxr);
+
+  if (swr_init(ctx) < 0 && soxr) {
+    // libswresample wasn't built with SoXR, use the best the built-in resampler can do
+    ConfigureContext(ctx, key, false);
+
+    if (swr_init(ctx) < 0) {
+      swr_free(&ctx);
+    }
+  }
+
+  if (!ctx) {
+    qCritical() << "Failed to create audio resampler";
+  }
+
+  return ctx;
+}
+
+void AudioResampler::ConfigureContext(SwrContext *ctx, const Key &key, bool soxr)
+{
+  if (key.quality == kQualityHigh) {
+    if (soxr) {
+      av_opt_set_int(ctx, "resampler", SWR_ENGINE_SOXR, 0);
+      av_opt_set_int(ctx, "precision", 28, 0);
+    } else {
+      av_opt_set_int(ctx, "resampler", SWR_ENGINE_SWR, 0);
+      av_opt_set_int(ctx, "filter_size", 64, 0);
+      av_opt_set_int(ctx, "phase_shift", 12, 0);
+      av_opt_set_double(ctx, "cutoff", 0.97, 0);
+    }
+
+    // Matters when reducing bit depth, e.g. exporting to 16-bit
+    av_opt_set_int(ctx, "dither_method", SWR_DITHER_TRIANGULAR_HIGHPASS, 0);
+  } else {
+    av_opt_set_int(ctx, "resampler", SWR_ENGINE_SWR, 0);
+    av_opt_set_int(ctx, "filter_size", 8, 0);
+    av_opt_set_int(ctx, "phase_shift", 8, 0);
+    av_opt_set_int(ctx, "linear_interp", 1, 0);
+  }
+}
+
+}
@@ -0,0 +1,147 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIORESAMPLER_H
+#define AUDIORESAMPLER_H
+
+extern "C" {
+#include <libswresample/swresample.h>
+}
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include "common/define.h"
+#include "render/audioparams.h"
+
+namespace olive {
+
+/**
+ * @brief Converts audio between sample rates, channel layouts and sample formats
+ *
+ * Wraps a libswresample context. Contexts are pooled by the conversion they do, so opening a
+ * resampler for a conversion that has been done before (e.g. conforming another range of the same
+ * footage, or every export from the same sequence) re-uses an existing context rather than
+ * allocating and configuring a new one. Conversions between the same sample rate keep no state,
+ * so those are handed back out without being set up again at all.
+ */
+class AudioResampler
+{
+public:
+  enum Quality {
+    /// Short filters, for realtime output
+    kQualityFast,
+
+    /// SoXR if libswresample was built with it, otherwise long filters with the built-in resampler
+    kQualityHigh
+  };
+
+  AudioResampler();
+
+  ~AudioResampler();
+
+  DISABLE_COPY_MOVE(AudioResampler)
+
+  bool Open(uint64_t in_layout, AVSampleFormat in_format, int in_rate,
+            uint64_t out_layout, AVSampleFormat out_format, int out_rate,
+            Quality quality = GetDefaultQuality());
+
+  bool Open(const AudioParams& in, bool in_planar, const AudioParams& out, bool out_planar,
+            Quality quality = GetDefaultQuality());
+
+  bool IsOpen() const
+  {
+    return ctx_;
+  }
+
+  /**
+   * @brief Hand the context back to the pool
+   */
+  void Close();
+
+  /**
+   * @brief Upper bound of the samples Convert() will output for `in_count` input samples
+   */
+  int GetOutSamples(int in_count) const;
+
+  /**
+   * @brief Convert samples, see swr_convert()
+   *
+   * Pass a null `in` to drain whatever the resampler is still holding.
+   */
+  int Convert(uint8_t** out, int out_count, const uint8_t** in, int in_count);
+
+  /**
+   * @brief Convert `in_count` packed samples to packed samples `out_sample_size` bytes each
+   */
+  QByteArray ConvertPacked(const char* in, int in_count, int out_sample_size);
+
+  /**
+   * @brief Whether packed audio in `in` has to be converted at all to match `out`
+   */
+  static bool IsConversionNeeded(const AudioParams& in, const AudioParams& out);
+
+  /**
+   * @brief The quality set in the preferences, used for everything but realtime output
+   */
+  static Quality GetDefaultQuality();
+
+  /**
+   * @brief Free every pooled context
+   */
+  static void ClearPool();
+
+private:
+  struct Key
+  {
+    uint64_t in_layout;
+    AVSampleFormat in_format;
+    int in_rate;
+    uint64_t out_layout;
+    AVSampleFormat out_format;
+    int out_rate;
+    Quality quality;
+
+    bool operator==(const Key& rhs) const;
+  };
+
+  friend uint qHash(const Key& k, uint seed);
+
+  static SwrContext* CreateContext(const Key& key);
+
+  static void ConfigureContext(SwrContext* ctx, const Key& key, bool soxr);
+
+  static const int kMaximumPooledPerConversion;
+
+  static QMutex pool_lock_;
+
+  static QHash<Key, QVector<SwrContext*> > pool_;
+
+  Key key_;
+
+  SwrContext* ctx_;
+
+};
+
+}
+
+#endif // AUDIORESAMPLER_H
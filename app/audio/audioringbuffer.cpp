@@ -0,0 +1,233 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audioringbuffer.h"
+
+namespace olive {
+
+AudioRingBuffer::AudioRingBuffer() :
+  mask_(0),
+  write_pos_(0),
+  read_pos_(0),
+  end_of_stream_(false)
+{
+}
+
+void AudioRingBuffer::Allocate(qint64 capacity)
+{
+  qint64 size = 1;
+  while (size < capacity) {
+    size <<= 1;
+  }
+
+  if (buffer_.size() != size) {
+    buffer_.resize(int(size));
+  }
+
+  mask_ = size - 1;
+
+  Reset();
+}
+
+void AudioRingBuffer::Reset()
+{
+  write_pos_.store(0, std::memory_order_relaxed);
+  read_pos_.store(0, std::memory_order_relaxed);
+  end_of_stream_.store(false, std::memory_order_release);
+}
+
+qint64 AudioRingBuffer::readable() const
+{
+  return write_pos_.load(std::memory_order_acquire) - read_pos_.load(std::memory_order_acquire);
+}
+
+qint64 AudioRingBuffer::writable() const
+{
+  return capacity() - readable();
+}
+
+qint64 AudioRingBuffer::write(const char *data, qint64 length)
+{
+  qint64 w = write_pos_.load(std::memory_order_relaxed);
+  qint64 r = read_pos_.load(std::memory_order_acquire);
+
+  length = qMin(length, capacity() - (w - r));
+  if (length <= 0) {
+    return 0;
+  }
+
+  // Copy in up to two pieces, the second wrapping around to the start of the buffer
+  qint64 start = w & mask_;
+  qint64 first = qMin(length, capacity() - start);
+
+  memcpy(buffer_.data() + start, data, size_t(first));
+  memcpy(buffer_.data(), data + first, size_t(length - first));
+
+  write_pos_.store(w + length, std::memory_order_release);
+
+  return length;
+}
+
+qint64 AudioRingBuffer::read(char *data, qint64 length)
+{
+  qint64 r = read_pos_.load(std::memory_order_relaxed);
+  qint64 w = write_pos_.load(std::memory_order_acquire);
+
+  length = qMin(length, w - r);
+  if (length <= 0) {
+    return 0;
+  }
+
+  qint64 start = r & mask_;
+  qint64 first = qMin(length, capacity() - start);
+
+  memcpy(data, buffer_.constData() + start, size_t(first));
+  memcpy(data + first, buffer_.constData(), size_t(length - first));
+
+  read_pos_.store(r + length, std::memory_order_release);
+
+  return length;
+}
+
+AudioRingDevice::AudioRingDevice(AudioRingBuffer *ring, QObject *parent) :
+  QIODevice(parent),
+  ring_(ring),
+  underruns_(0)
+{
+}
+
+qint64 AudioRingDevice::bytesAvailable() const
+{
+  return ring_->readable() + QIODevice::bytesAvailable();
+}
+
+qint64 AudioRingDevice::readData(char *data, qint64 maxlen)
+{
+  qint64 read = ring_->read(data, maxlen);
+
+  if (read < maxlen && !ring_->end_of_stream()) {
+    // The feeder fell behind, play silence rather than letting the output stop
+    memset(data + read, 0, size_t(maxlen - read));
+    underruns_.fetch_add(1, std::memory_order_relaxed);
+    read = maxlen;
+  }
+
+  return read;
+}
+
+qint64 AudioRingDevice::writeData(const char *data, qint64 maxSize)
+{
+  Q_UNUSED(data)
+  Q_UNUSED(maxSize)
+
+  return -1;
+}
+
+AudioRingSink::AudioRingSink(AudioRingBuffer *ring, int frame_size, QObject *parent) :
+  QIODevice(parent),
+  ring_(ring),
+  frame_size_(qMax(1, frame_size)),
+  overruns_(0)
+{
+}
+
+qint64 AudioRingSink::readData(char *data, qint64 maxlen)
+{
+  Q_UNUSED(data)
+  Q_UNUSED(maxlen)
+
+  return -1;
+}
+
+qint64 AudioRingSink::writeData(const char *data, qint64 maxSize)
+{
+  // Only whole frames go in so a drop never leaves the channels out of order
+  qint64 fit = qMin(maxSize, ring_->writable());
+  fit -= fit % frame_size_;
+
+  ring_->write(data, fit);
+
+  if (fit < maxSize) {
+    overruns_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // Report everything as written, the input must never wait on us
+  return maxSize;
+}
+
+AudioRingFeeder::AudioRingFeeder(QObject *parent) :
+  QThread(parent),
+  source_(nullptr),
+  ring_(nullptr),
+  poll_interval_(1),
+  stop_(false)
+{
+}
+
+void AudioRingFeeder::SetSource(QIODevice *source, AudioRingBuffer *ring, qint64 chunk, int poll_interval)
+{
+  source_ = source;
+  ring_ = ring;
+  poll_interval_ = qMax(1, poll_interval);
+
+  if (scratch_.size() != chunk) {
+    scratch_.resize(int(chunk));
+  }
+}
+
+bool AudioRingFeeder::Fill()
+{
+  while (ring_->writable() >= scratch_.size()) {
+    qint64 read = source_->read(scratch_.data(), scratch_.size());
+
+    if (read <= 0) {
+      ring_->set_end_of_stream(true);
+      return false;
+    }
+
+    ring_->write(scratch_.constData(), read);
+  }
+
+  return true;
+}
+
+void AudioRingFeeder::Stop()
+{
+  stop_ = true;
+  wait();
+  stop_ = false;
+}
+
+void AudioRingFeeder::run()
+{
+  if (!source_ || !ring_) {
+    return;
+  }
+
+  while (!stop_) {
+    if (!Fill()) {
+      break;
+    }
+
+    QThread::msleep(poll_interval_);
+  }
+}
+
+}
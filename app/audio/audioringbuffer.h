@@ -0,0 +1,214 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIORINGBUFFER_H
+#define AUDIORINGBUFFER_H
+
+#include <atomic>
+#include <QIODevice>
+#include <QThread>
+#include <QVector>
+
+#include "common/define.h"
+
+namespace olive {
+
+/**
+ * @brief Lock-free single-producer/single-consumer ring of audio bytes
+ *
+ * Storage is allocated once by Allocate(). After that, one thread may write() and another may read()
+ * at the same time without locks or allocations, which makes the read side safe to call from an
+ * audio callback. Allocate() and Reset() must only be called while neither side is running.
+ */
+class AudioRingBuffer
+{
+public:
+  AudioRingBuffer();
+
+  DISABLE_COPY_MOVE(AudioRingBuffer)
+
+  /**
+   * @brief Allocate storage for at least `capacity` bytes, rounded up to a power of two
+   */
+  void Allocate(qint64 capacity);
+
+  void Reset();
+
+  qint64 capacity() const
+  {
+    return buffer_.size();
+  }
+
+  qint64 readable() const;
+
+  qint64 writable() const;
+
+  /**
+   * @brief Producer side, writes up to `length` bytes and returns how many were written
+   */
+  qint64 write(const char* data, qint64 length);
+
+  /**
+   * @brief Consumer side, reads up to `length` bytes and returns how many were read
+   */
+  qint64 read(char* data, qint64 length);
+
+  /**
+   * @brief Set by the producer once it has nothing more to write
+   */
+  void set_end_of_stream(bool e)
+  {
+    end_of_stream_.store(e, std::memory_order_release);
+  }
+
+  bool end_of_stream() const
+  {
+    return end_of_stream_.load(std::memory_order_acquire);
+  }
+
+private:
+  QVector<char> buffer_;
+
+  qint64 mask_;
+
+  // Total bytes ever written/read, wrapped into the buffer with `mask_`
+  std::atomic<qint64> write_pos_;
+  std::atomic<qint64> read_pos_;
+
+  std::atomic<bool> end_of_stream_;
+
+};
+
+/**
+ * @brief QIODevice an audio output can pull from that only ever reads from an AudioRingBuffer
+ *
+ * If the ring runs dry before the producer has finished, silence is returned instead so the output
+ * keeps running rather than stalling, and the underrun is counted.
+ */
+class AudioRingDevice : public QIODevice
+{
+public:
+  AudioRingDevice(AudioRingBuffer* ring, QObject* parent = nullptr);
+
+  virtual bool isSequential() const override
+  {
+    return true;
+  }
+
+  virtual qint64 bytesAvailable() const override;
+
+  int underrun_count() const
+  {
+    return underruns_.load(std::memory_order_relaxed);
+  }
+
+protected:
+  virtual qint64 readData(char *data, qint64 maxlen) override;
+
+  virtual qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+  AudioRingBuffer* ring_;
+
+  std::atomic<int> underruns_;
+
+};
+
+/**
+ * @brief QIODevice an audio input can push into that only ever writes to an AudioRingBuffer
+ *
+ * Never blocks or allocates, so it's safe to write to from an audio callback. If the consumer falls
+ * behind and the ring fills up, whole frames that don't fit are dropped and the overrun is counted
+ * so the input keeps running.
+ */
+class AudioRingSink : public QIODevice
+{
+public:
+  AudioRingSink(AudioRingBuffer* ring, int frame_size, QObject* parent = nullptr);
+
+  virtual bool isSequential() const override
+  {
+    return true;
+  }
+
+  int overrun_count() const
+  {
+    return overruns_.load(std::memory_order_relaxed);
+  }
+
+protected:
+  virtual qint64 readData(char *data, qint64 maxlen) override;
+
+  virtual qint64 writeData(const char *data, qint64 maxSize) override;
+
+private:
+  AudioRingBuffer* ring_;
+
+  int frame_size_;
+
+  std::atomic<int> overruns_;
+
+};
+
+/**
+ * @brief Thread that keeps an AudioRingBuffer topped up from a (possibly slow) QIODevice
+ *
+ * Disk reads, tempo processing and anything else the source does happen on this thread, away from
+ * the audio output.
+ */
+class AudioRingFeeder : public QThread
+{
+public:
+  AudioRingFeeder(QObject* parent = nullptr);
+
+  /**
+   * @brief Set the source to read from, only while the thread isn't running
+   *
+   * `chunk` is how many bytes are read from the source at a time and `poll_interval` is how long to
+   * wait (in milliseconds) when the ring is full.
+   */
+  void SetSource(QIODevice* source, AudioRingBuffer* ring, qint64 chunk, int poll_interval);
+
+  /**
+   * @brief Fill as much of the ring as can be filled right now, returns false once the source is exhausted
+   */
+  bool Fill();
+
+  void Stop();
+
+protected:
+  virtual void run() override;
+
+private:
+  QIODevice* source_;
+
+  AudioRingBuffer* ring_;
+
+  QVector<char> scratch_;
+
+  int poll_interval_;
+
+  std::atomic<bool> stop_;
+
+};
+
+}
+
+#endif // AUDIORINGBUFFER_H
@@ -20,13 +20,148 @@
 
 #include "audiovisualwaveform.h"
 
+#include <functional>
 #include <QDebug>
+#include <QSaveFile>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
 
 #include "config/config.h"
 #include "common/functiontimer.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OLIVE_WAVEFORM_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OLIVE_WAVEFORM_NEON
+#include <arm_neon.h>
+#endif
+
 namespace olive {
 
+namespace {
+
+// Number of waveform values below which a mipmap level isn't worth splitting across threads
+const int kParallelThreshold = 65536;
+
+// Waveform files are written in native byte order so they can be mapped and read directly
+const quint32 kFileMagic = 0x4F575646;
+const quint32 kFileVersion = 1;
+
+struct FileHeader {
+  quint32 magic;
+  quint32 version;
+  quint32 channels;
+  quint32 level_count;
+  qint64 length_num;
+  qint64 length_den;
+};
+
+struct FileLevel {
+  qint64 rate_num;
+  qint64 rate_den;
+  qint64 offset;
+  qint64 count;
+};
+
+// The file writer summarizes audio in chunks of this many seconds. It must be a multiple of the lowest mipmap's
+// period so every entry of every level comes from exactly one chunk.
+const int kFileWriterChunkSeconds = 8;
+
+/**
+ * @brief Expands `min` and `max` to include every value in a plane of `count` floats
+ */
+void MinMaxPlane(const float* data, int count, float& min, float& max)
+{
+  int i = 0;
+
+#if defined(OLIVE_WAVEFORM_SSE)
+  if (count >= 4) {
+    __m128 vmin = _mm_set1_ps(min);
+    __m128 vmax = _mm_set1_ps(max);
+
+    for (; i+4<=count; i+=4) {
+      __m128 v = _mm_loadu_ps(data + i);
+      vmin = _mm_min_ps(vmin, v);
+      vmax = _mm_max_ps(vmax, v);
+    }
+
+    // Fold the four lanes down into one
+    vmin = _mm_min_ps(vmin, _mm_shuffle_ps(vmin, vmin, _MM_SHUFFLE(1, 0, 3, 2)));
+    vmin = _mm_min_ps(vmin, _mm_shuffle_ps(vmin, vmin, _MM_SHUFFLE(2, 3, 0, 1)));
+    vmax = _mm_max_ps(vmax, _mm_shuffle_ps(vmax, vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+    vmax = _mm_max_ps(vmax, _mm_shuffle_ps(vmax, vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+    min = _mm_cvtss_f32(vmin);
+    max = _mm_cvtss_f32(vmax);
+  }
+#elif defined(OLIVE_WAVEFORM_NEON)
+  if (count >= 4) {
+    float32x4_t vmin = vdupq_n_f32(min);
+    float32x4_t vmax = vdupq_n_f32(max);
+
+    for (; i+4<=count; i+=4) {
+      float32x4_t v = vld1q_f32(data + i);
+      vmin = vminq_f32(vmin, v);
+      vmax = vmaxq_f32(vmax, v);
+    }
+
+    float32x2_t pmin = vpmin_f32(vget_low_f32(vmin), vget_high_f32(vmin));
+    float32x2_t pmax = vpmax_f32(vget_low_f32(vmax), vget_high_f32(vmax));
+    min = vget_lane_f32(vpmin_f32(pmin, pmin), 0);
+    max = vget_lane_f32(vpmax_f32(pmax, pmax), 0);
+  }
+#endif
+
+  for (; i<count; i++) {
+    if (data[i] < min) {
+      min = data[i];
+    }
+
+    if (data[i] > max) {
+      max = data[i];
+    }
+  }
+}
+
+/**
+ * @brief Runs `func` over [0, length) split into contiguous ranges on the global thread pool
+ *
+ * Range boundaries are always multiples of `step` so a waveform entry's channels are never split between two threads.
+ * Small ranges are run directly on the calling thread.
+ */
+void RunInParallel(int length, int step, const std::function<void(int, int)>& func)
+{
+  int threads = QThread::idealThreadCount();
+
+  if (length < kParallelThreshold || threads < 2) {
+    func(0, length);
+    return;
+  }
+
+  int segment = (length / step + threads - 1) / threads * step;
+
+  QVector< QFuture<void> > futures;
+  futures.reserve(threads);
+
+  for (int start=segment; start<length; start+=segment) {
+    int end = qMin(start + segment, length);
+    futures.append(QtConcurrent::run([&func, start, end]{
+      func(start, end);
+    }));
+  }
+
+  // Do the first range on this thread while the others work
+  func(0, qMin(segment, length));
+
+  foreach (const QFuture<void>& f, futures) {
+    f.waitForFinished();
+  }
+}
+
+}
+
 AudioVisualWaveform::AudioVisualWaveform() :
   channels_(0)
 {
@@ -51,18 +186,18 @@ void AudioVisualWaveform::OverwriteSamplesFromBuffer(SampleBufferPtr samples, in
 
   double chunk_size = double(sample_rate) / double(target_rate);
 
-  for (int i=0; i<samples_length; i+=channels_) {
-    int src_start = qRound((double(i) * chunk_size)) / channels_;
-    int src_end = qMin(qRound((double(i + channels_) * chunk_size)) / channels_, samples->sample_count());
+  const SampleBuffer* src = samples.get();
+  SamplePerChannel* dst = data.data() + start_index;
+  int channels = channels_;
 
-    Sample summary = SumSamples(samples,
-                                src_start,
-                                src_end - src_start);
+  RunInParallel(samples_length, channels_, [src, dst, channels, chunk_size](int start, int end){
+    for (int i=start; i<end; i+=channels) {
+      int src_start = qRound((double(i) * chunk_size)) / channels;
+      int src_end = qMin(qRound((double(i + channels) * chunk_size)) / channels, src->sample_count());
 
-    memcpy(&data.data()[i + start_index],
-        summary.constData(),
-        summary.size() * sizeof(SamplePerChannel));
-  }
+      SumSamplesInto(src, src_start, src_end - src_start, &dst[i]);
+    }
+  });
 }
 
 void AudioVisualWaveform::OverwriteSamplesFromMipmap(const AudioVisualWaveform::Sample &input, double input_sample_rate, int &input_start, int &input_length, const rational &start, double output_rate, AudioVisualWaveform::Sample &output_data)
@@ -78,13 +213,15 @@ void AudioVisualWaveform::OverwriteSamplesFromMipmap(const AudioVisualWaveform::
   // We guarantee mipmaps are powers of two so integer division should be perfectly accurate here
   int chunk_size = input_sample_rate / output_rate;
 
-  for (int i=0; i<samples_length; i+=channels_) {
-    Sample summary = ReSumSamples(&input.constData()[input_start + (i*chunk_size)], chunk_size * channels_, channels_);
+  const SamplePerChannel* src = input.constData() + input_start;
+  SamplePerChannel* dst = output_data.data() + start_index;
+  int channels = channels_;
 
-    memcpy(&output_data.data()[i + start_index],
-        summary.constData(),
-        summary.size() * sizeof(SamplePerChannel));
-  }
+  RunInParallel(samples_length, channels_, [src, dst, channels, chunk_size](int start, int end){
+    for (int i=start; i<end; i+=channels) {
+      ReSumSamplesInto(&src[i*chunk_size], chunk_size * channels, channels, &dst[i]);
+    }
+  });
 
   input_start = start_index;
   input_length = samples_length;
@@ -150,6 +287,10 @@ void AudioVisualWaveform::OverwriteSums(const AudioVisualWaveform &sums, const r
       copy_len = qMin(copy_len, time_to_samples(length, rate_dbl));
     }
 
+    if (copy_len <= 0) {
+      continue;
+    }
+
     // Determine end index of our array
     int end_index = our_start_index + copy_len;
     if (our_arr.size() < end_index) {
@@ -246,12 +387,243 @@ AudioVisualWaveform::Sample AudioVisualWaveform::GetSummaryFromTime(const ration
   return ReSumSamples(&using_mipmap->second.constData()[start_sample], sample_length, channels_);
 }
 
+bool AudioVisualWaveform::SaveToFile(const QString &filename) const
+{
+  QSaveFile file(filename);
+
+  if (!file.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to open waveform file for writing:" << filename;
+    return false;
+  }
+
+  FileHeader header = {kFileMagic, kFileVersion, quint32(channels_), quint32(mipmapped_data_.size()),
+                       length_.numerator(), length_.denominator()};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  qint64 offset = sizeof(FileHeader) + sizeof(FileLevel) * mipmapped_data_.size();
+  for (auto it=mipmapped_data_.cbegin(); it!=mipmapped_data_.cend(); it++) {
+    FileLevel level = {it->first.numerator(), it->first.denominator(), offset, it->second.size()};
+    file.write(reinterpret_cast<const char*>(&level), sizeof(level));
+    offset += it->second.size() * sizeof(SamplePerChannel);
+  }
+
+  for (auto it=mipmapped_data_.cbegin(); it!=mipmapped_data_.cend(); it++) {
+    file.write(reinterpret_cast<const char*>(it->second.constData()), it->second.size() * sizeof(SamplePerChannel));
+  }
+
+  return file.commit();
+}
+
+bool AudioVisualWaveform::LoadFromFile(const QString &filename, const rational &start, const rational &length)
+{
+  QFile file(filename);
+
+  if (!file.open(QFile::ReadOnly) || file.size() < qint64(sizeof(FileHeader))) {
+    return false;
+  }
+
+  const uchar* map = file.map(0, file.size());
+  if (!map) {
+    return false;
+  }
+
+  FileHeader header;
+  memcpy(&header, map, sizeof(header));
+
+  bool valid = (header.magic == kFileMagic && header.version == kFileVersion && header.channels > 0
+                && file.size() >= qint64(sizeof(FileHeader) + sizeof(FileLevel) * header.level_count));
+
+  if (valid) {
+    rational file_length(header.length_num, header.length_den);
+    rational read_length = length.isNull() ? file_length - start : qMin(length, file_length - start);
+
+    channels_ = header.channels;
+    length_ = qMax(rational(0), read_length);
+
+    for (auto it=mipmapped_data_.begin(); it!=mipmapped_data_.end(); it++) {
+      it->second.clear();
+    }
+
+    for (quint32 i=0; i<header.level_count; i++) {
+      FileLevel level;
+      memcpy(&level, map + sizeof(FileHeader) + sizeof(FileLevel) * i, sizeof(level));
+
+      auto it = mipmapped_data_.find(rational(level.rate_num, level.rate_den));
+      if (it == mipmapped_data_.end()
+          || level.offset + level.count * qint64(sizeof(SamplePerChannel)) > file.size()) {
+        continue;
+      }
+
+      double rate_dbl = it->first.toDouble();
+      qint64 first = time_to_samples(start, rate_dbl);
+      qint64 count = qMin(level.count - first, qint64(time_to_samples(length_, rate_dbl)));
+
+      Sample& data = it->second;
+      if (first < 0 || count <= 0) {
+        data.clear();
+        continue;
+      }
+
+      data.resize(count);
+      memcpy(data.data(), map + level.offset + first * sizeof(SamplePerChannel), count * sizeof(SamplePerChannel));
+    }
+  } else {
+    qWarning() << "Ignoring invalid waveform file:" << filename;
+  }
+
+  file.unmap(const_cast<uchar*>(map));
+
+  return valid;
+}
+
+AudioVisualWaveform::FileWriter::FileWriter(const QString &filename, const AudioParams &params, int64_t total_samples) :
+  file_(filename),
+  map_(nullptr),
+  params_(params),
+  channels_(params.channel_count()),
+  sample_rate_(params.sample_rate()),
+  total_samples_(total_samples),
+  written_samples_(0),
+  pending_count_(0)
+{
+}
+
+AudioVisualWaveform::FileWriter::~FileWriter()
+{
+  close();
+}
+
+bool AudioVisualWaveform::FileWriter::open()
+{
+  if (!file_.open(QFile::ReadWrite | QFile::Truncate)) {
+    qWarning() << "Failed to open waveform file for writing:" << file_.fileName();
+    return false;
+  }
+
+  // Every level's size is known up front, so lay out the whole file and map it for writing
+  AudioVisualWaveform layout;
+  layout.set_channel_count(channels_);
+
+  rational length(total_samples_, sample_rate_);
+  qint64 offset = sizeof(FileHeader) + sizeof(FileLevel) * layout.mipmapped_data_.size();
+
+  FileHeader header = {kFileMagic, kFileVersion, quint32(channels_), quint32(layout.mipmapped_data_.size()),
+                       length.numerator(), length.denominator()};
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  for (auto it=layout.mipmapped_data_.cbegin(); it!=layout.mipmapped_data_.cend(); it++) {
+    qint64 count = layout.time_to_samples(length, it->first.toDouble());
+    FileLevel level = {it->first.numerator(), it->first.denominator(), offset, count};
+    file_.write(reinterpret_cast<const char*>(&level), sizeof(level));
+
+    levels_.insert({it->first, qMakePair(offset, count)});
+    offset += count * sizeof(SamplePerChannel);
+  }
+
+  if (!file_.resize(offset) || !(map_ = file_.map(0, offset))) {
+    qWarning() << "Failed to map waveform file:" << file_.fileName();
+    file_.close();
+    return false;
+  }
+
+  pending_ = SampleBuffer::CreateAllocated(params_, sample_rate_ * kFileWriterChunkSeconds);
+  pending_count_ = 0;
+
+  return true;
+}
+
+void AudioVisualWaveform::FileWriter::write(SampleBufferPtr samples)
+{
+  if (!map_) {
+    return;
+  }
+
+  int read = 0;
+
+  while (read < samples->sample_count()) {
+    int copy = qMin(samples->sample_count() - read, pending_->sample_count() - pending_count_);
+
+    for (int i=0; i<qMin(channels_, samples->audio_params().channel_count()); i++) {
+      pending_->set(i, samples->data(i) + read, pending_count_, copy);
+    }
+
+    read += copy;
+    pending_count_ += copy;
+
+    if (pending_count_ == pending_->sample_count()) {
+      FlushPending();
+    }
+  }
+}
+
+bool AudioVisualWaveform::FileWriter::close()
+{
+  if (!file_.isOpen()) {
+    return false;
+  }
+
+  bool ok = (map_ != nullptr);
+
+  if (map_) {
+    FlushPending();
+    file_.unmap(map_);
+    map_ = nullptr;
+  }
+
+  pending_ = nullptr;
+  file_.close();
+
+  return ok;
+}
+
+void AudioVisualWaveform::FileWriter::FlushPending()
+{
+  if (!pending_count_) {
+    return;
+  }
+
+  SampleBufferPtr chunk = pending_;
+
+  if (pending_count_ < pending_->sample_count()) {
+    // Partial final chunk, summarize only what we have
+    chunk = SampleBuffer::CreateAllocated(pending_->audio_params(), pending_count_);
+    for (int i=0; i<channels_; i++) {
+      chunk->set(i, pending_->data(i), pending_count_);
+    }
+  }
+
+  AudioVisualWaveform chunk_waveform;
+  chunk_waveform.set_channel_count(channels_);
+  chunk_waveform.OverwriteSamples(chunk, sample_rate_);
+
+  // Chunks always start on a whole multiple of the lowest level's period, so their entries drop straight into place
+  rational chunk_start(written_samples_, sample_rate_);
+
+  for (auto it=chunk_waveform.mipmapped_data_.cbegin(); it!=chunk_waveform.mipmapped_data_.cend(); it++) {
+    const QPair<qint64, qint64>& level = levels_.at(it->first);
+    qint64 dest = chunk_waveform.time_to_samples(chunk_start, it->first.toDouble());
+    qint64 count = qMin(qint64(it->second.size()), level.second - dest);
+
+    if (count > 0) {
+      memcpy(map_ + level.first + dest * sizeof(SamplePerChannel), it->second.constData(), count * sizeof(SamplePerChannel));
+    }
+  }
+
+  written_samples_ += pending_count_;
+  pending_count_ = 0;
+}
+
 AudioVisualWaveform::Sample AudioVisualWaveform::SumSamples(const float *samples, int nb_samples, int nb_channels)
 {
   AudioVisualWaveform::Sample summed_samples(nb_channels);
+  SamplePerChannel* sums = summed_samples.data();
+
+  for (int i=0;i<nb_samples;i+=nb_channels) {
+    int frame_channels = qMin(nb_channels, nb_samples - i);
 
-  for (int i=0;i<nb_samples;i++) {
-    ExpandMinMax(summed_samples[i%nb_channels], samples[i]);
+    for (int j=0;j<frame_channels;j++) {
+      ExpandMinMax(sums[j], samples[i + j]);
+    }
   }
 
   return summed_samples;
@@ -261,13 +633,7 @@ AudioVisualWaveform::Sample AudioVisualWaveform::SumSamples(SampleBufferPtr samp
 {
   AudioVisualWaveform::Sample summed_samples(samples->audio_params().channel_count());
 
-  int end_index = start_index + length;
-
-  for (int i=start_index; i<end_index; i++) {
-    for (int channel=0; channel<samples->audio_params().channel_count(); channel++) {
-      ExpandMinMax(summed_samples[channel], samples->data(channel)[i]);
-    }
-  }
+  SumSamplesInto(samples.get(), start_index, length, summed_samples.data());
 
   return summed_samples;
 }
@@ -278,24 +644,87 @@ AudioVisualWaveform::Sample AudioVisualWaveform::ReSumSamples(const SamplePerCha
 {
   AudioVisualWaveform::Sample summed_samples(nb_channels);
 
-  for (int i=0;i<nb_samples;i+=nb_channels) {
-    for (int j=0;j<nb_channels;j++) {
+  ReSumSamplesInto(samples, nb_samples, nb_channels, summed_samples.data());
+
+  return summed_samples;
+}
+
+void AudioVisualWaveform::SumSamplesInto(const SampleBuffer *samples, int start_index, int length, SamplePerChannel *out)
+{
+  for (int channel=0; channel<samples->audio_params().channel_count(); channel++) {
+    out[channel] = SamplePerChannel();
+
+    if (length > 0) {
+      MinMaxPlane(samples->data(channel) + start_index, length, out[channel].min, out[channel].max);
+    }
+  }
+}
+
+void AudioVisualWaveform::ReSumSamplesInto(const SamplePerChannel *samples, int nb_samples, int nb_channels, SamplePerChannel *out)
+{
+  for (int j=0;j<nb_channels;j++) {
+    out[j] = SamplePerChannel();
+  }
+
+  int i = 0;
+
+#if defined(OLIVE_WAVEFORM_SSE)
+  // Entries are interleaved min/max pairs, so with one or two channels every group of four floats lines up with the
+  // same channels and we can reduce them in place, only splitting mins from maxes at the end
+  if (nb_channels <= 2 && nb_samples >= 2) {
+    const float* in = reinterpret_cast<const float*>(samples);
+    int nb_floats = nb_samples * 2;
+    __m128 vmin = _mm_setzero_ps();
+    __m128 vmax = _mm_setzero_ps();
+
+    for (; i+4<=nb_floats; i+=4) {
+      __m128 v = _mm_loadu_ps(in + i);
+      vmin = _mm_min_ps(vmin, v);
+      vmax = _mm_max_ps(vmax, v);
+    }
+
+    float mins[4], maxes[4];
+    _mm_storeu_ps(mins, vmin);
+    _mm_storeu_ps(maxes, vmax);
+
+    for (int k=0; k<4; k+=2) {
+      SamplePerChannel& sum = out[(k/2) % nb_channels];
+      sum.min = qMin(sum.min, mins[k]);
+      sum.max = qMax(sum.max, maxes[k+1]);
+    }
+
+    // Continue with the remaining whole entries
+    i /= 2;
+  }
+#endif
+
+  for (;i<nb_samples;i+=nb_channels) {
+    int frame_channels = qMin(nb_channels, nb_samples - i);
+
+    for (int j=0;j<frame_channels;j++) {
       const AudioVisualWaveform::SamplePerChannel& sample = samples[i + j];
 
-      if (sample.min < summed_samples[j].min) {
-        summed_samples[j].min = sample.min;
+      if (sample.min < out[j].min) {
+        out[j].min = sample.min;
       }
 
-      if (sample.max > summed_samples[j].max) {
-        summed_samples[j].max = sample.max;
+      if (sample.max > out[j].max) {
+        out[j].max = sample.max;
       }
     }
   }
-
-  return summed_samples;
 }
 
 void AudioVisualWaveform::DrawSample(QPainter *painter, const Sample& sample, int x, int y, int height, bool rectified)
+{
+  QVector<QLine> lines;
+
+  AppendSampleLines(lines, sample, x, y, height, rectified);
+
+  painter->drawLines(lines);
+}
+
+void AudioVisualWaveform::AppendSampleLines(QVector<QLine> &lines, const Sample &sample, int x, int y, int height, bool rectified)
 {
   if (sample.isEmpty()) {
     return;
@@ -313,19 +742,19 @@ void AudioVisualWaveform::DrawSample(QPainter *painter, const Sample& sample, in
 
       int diff = qRound((max - min) * channel_half_height);
 
-      painter->drawLine(x,
-                        channel_bottom - diff,
-                        x,
-                        channel_bottom);
+      lines.append(QLine(x,
+                         channel_bottom - diff,
+                         x,
+                         channel_bottom));
     } else {
       int channel_mid = y + channel_height * i + channel_half_height;
 
       // We subtract the sample so that positive Y values go up on the screen rather than down,
       // which is how waveforms are usually rendered
-      painter->drawLine(x,
-                        channel_mid - qRound(min * static_cast<float>(channel_half_height)),
-                        x,
-                        channel_mid - qRound(max * static_cast<float>(channel_half_height)));
+      lines.append(QLine(x,
+                         channel_mid - qRound(min * static_cast<float>(channel_half_height)),
+                         x,
+                         channel_mid - qRound(max * static_cast<float>(channel_half_height))));
     }
   }
 }
@@ -348,7 +777,6 @@ void AudioVisualWaveform::DrawWaveform(QPainter *painter, const QRect& rect, con
     return;
   }
 
-  int next_sample_index = start_sample_index;
   int sample_index;
 
   Sample summary;
@@ -360,8 +788,26 @@ void AudioVisualWaveform::DrawWaveform(QPainter *painter, const QRect& rect, con
   int start = qMax(rect.x(), -top_left.x());
   int end = qMin(rect.right(), -top_left.x() + viewport.width());
 
+  if (painter->hasClipping()) {
+    // Only the clipped area will actually be painted, e.g. during a partial repaint
+    QRectF clip = painter->clipBoundingRect();
+    start = qMax(start, qFloor(clip.left()));
+    end = qMin(end, qCeil(clip.right()));
+  }
+
+  if (start >= end) {
+    return;
+  }
+
+  int next_sample_index = qMin(arr.size(),
+                               start_sample_index + qFloor(rate_dbl * static_cast<double>(start - rect.x()) / scale) * samples.channel_count());
+
   bool rectified = Config::Current()[QStringLiteral("RectifiedWaveforms")].toBool();
 
+  // Collect every column and draw them in one call rather than one call per column per channel
+  QVector<QLine> lines;
+  lines.reserve((end - start) * samples.channel_count());
+
   for (int i=start;i<end;i++) {
     sample_index = next_sample_index;
 
@@ -379,8 +825,10 @@ void AudioVisualWaveform::DrawWaveform(QPainter *painter, const QRect& rect, con
       summary_index = sample_index;
     }
 
-    DrawSample(painter, summary, i, rect.y(), rect.height(), rectified);
+    AppendSampleLines(lines, summary, i, rect.y(), rect.height(), rectified);
   }
+
+  painter->drawLines(lines);
 }
 
 int AudioVisualWaveform::time_to_samples(const rational &time, double sample_rate) const
@@ -21,6 +21,7 @@
 #ifndef SUMSAMPLES_H
 #define SUMSAMPLES_H
 
+#include <QFile>
 #include <QPainter>
 #include <QVector>
 
@@ -94,6 +95,66 @@ public:
 
   Sample GetSummaryFromTime(const rational& start, const rational& length) const;
 
+  /**
+   * @brief Write this waveform to a file that can be read back with LoadFromFile()
+   */
+  bool SaveToFile(const QString& filename) const;
+
+  /**
+   * @brief Read part of a waveform file into this waveform
+   *
+   * The file is memory-mapped and only the entries covering `start` to `start + length` are copied out of it, so this
+   * stays cheap even for the waveform of hours of audio. The range is placed at time 0 in this waveform. A null length
+   * reads to the end of the file.
+   */
+  bool LoadFromFile(const QString& filename, const rational& start = 0, const rational& length = 0);
+
+  /**
+   * @brief Builds a waveform file incrementally from audio of a known length
+   *
+   * Only one chunk of audio is summarized in memory at a time, so no full set of mipmaps is ever held for the whole
+   * file. Samples must be written in order from the start.
+   */
+  class FileWriter
+  {
+  public:
+    FileWriter(const QString& filename, const AudioParams& params, int64_t total_samples);
+
+    ~FileWriter();
+
+    DISABLE_COPY_MOVE(FileWriter)
+
+    bool open();
+
+    void write(SampleBufferPtr samples);
+
+    bool close();
+
+  private:
+    void FlushPending();
+
+    QFile file_;
+
+    uchar* map_;
+
+    AudioParams params_;
+
+    int channels_;
+
+    int sample_rate_;
+
+    int64_t total_samples_;
+
+    int64_t written_samples_;
+
+    SampleBufferPtr pending_;
+
+    int pending_count_;
+
+    std::map<rational, QPair<qint64, qint64> > levels_;
+
+  };
+
   static Sample SumSamples(const float* samples, int nb_samples, int nb_channels);
   static Sample SumSamples(SampleBufferPtr samples, int start_index, int length);
 
@@ -101,11 +162,20 @@ public:
 
   static void DrawSample(QPainter* painter, const Sample &sample, int x, int y, int height, bool rectified);
 
+  /**
+   * @brief Same as DrawSample() but appends the lines to `lines` so many samples can be drawn at once
+   */
+  static void AppendSampleLines(QVector<QLine>& lines, const Sample &sample, int x, int y, int height, bool rectified);
+
   static void DrawWaveform(QPainter* painter, const QRect &rect, const double &scale, const AudioVisualWaveform& samples, const rational &start_time);
 
 private:
   static void ExpandMinMax(SamplePerChannel &sum, float value);
 
+  static void SumSamplesInto(const SampleBuffer* samples, int start_index, int length, SamplePerChannel* out);
+
+  static void ReSumSamplesInto(const SamplePerChannel* samples, int nb_samples, int nb_channels, SamplePerChannel* out);
+
   void OverwriteSamplesFromBuffer(SampleBufferPtr samples, int sample_rate, const rational& start, double target_rate, Sample &data, int &start_index, int &samples_length);
 
   void OverwriteSamplesFromMipmap(const Sample& input, double input_sample_rate, int &input_start, int &input_length, const rational& start, double output_rate, Sample &output_data);
@@ -33,6 +33,13 @@ AudioOutputDeviceProxy::AudioOutputDeviceProxy(QObject *parent) :
 void AudioOutputDeviceProxy::SetParameters(const AudioParams &params)
 {
   params_ = params;
+  ResetConversion();
+}
+
+void AudioOutputDeviceProxy::SetDeviceParameters(const AudioParams &params)
+{
+  device_params_ = params;
+  ResetConversion();
 }
 
 void AudioOutputDeviceProxy::SetDevice(QIODevice* device, qint64 offset, int playback_speed)
@@ -55,8 +62,14 @@ void AudioOutputDeviceProxy::SetDevice(QIODevice* device, qint64 offset, int pla
 
   playback_speed_ = playback_speed;
 
+  // Don't carry anything over from the last device
+  ResetConversion();
+
   if (qAbs(playback_speed_) != 1) {
+    // Changes speed in place if the processor is already running
     tempo_processor_.Open(params_, qAbs(playback_speed_));
+  } else if (tempo_processor_.IsOpen()) {
+    tempo_processor_.Close();
   }
 }
 
@@ -78,6 +91,36 @@ qint64 AudioOutputDeviceProxy::readData(char *data, qint64 maxlen)
     return 0;
   }
 
+  if (!resampler_.IsOpen()) {
+    return ReadSamples(data, maxlen);
+  }
+
+  // Read in our own format and convert until there's enough for the device
+  int device_sample_size = device_params_.samples_to_bytes(1);
+
+  while (converted_.size() < maxlen) {
+    qint64 samples_needed = device_params_.bytes_to_samples(maxlen - converted_.size());
+    read_buffer_.resize(int(params_.samples_to_bytes(qMax(qint64(1), samples_needed))));
+
+    qint64 read_count = ReadSamples(read_buffer_.data(), read_buffer_.size());
+    if (read_count <= 0) {
+      break;
+    }
+
+    converted_.append(resampler_.ConvertPacked(read_buffer_.constData(),
+                                               int(params_.bytes_to_samples(read_count)),
+                                               device_sample_size));
+  }
+
+  qint64 copy_count = qMin(maxlen, qint64(converted_.size()));
+  memcpy(data, converted_.constData(), size_t(copy_count));
+  converted_.remove(0, int(copy_count));
+
+  return copy_count;
+}
+
+qint64 AudioOutputDeviceProxy::ReadSamples(char *data, qint64 maxlen)
+{
   qint64 read_count;
 
   if (tempo_processor_.IsOpen()) {
@@ -137,4 +180,15 @@ qint64 AudioOutputDeviceProxy::ReverseAwareRead(char *data, qint64 maxlen)
   return read_count;
 }
 
+void AudioOutputDeviceProxy::ResetConversion()
+{
+  converted_.clear();
+  resampler_.Close();
+
+  if (AudioResampler::IsConversionNeeded(params_, device_params_)) {
+    // Realtime, so favor speed over quality
+    resampler_.Open(params_, false, device_params_, false, AudioResampler::kQualityFast);
+  }
+}
+
 }
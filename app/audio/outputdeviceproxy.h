@@ -23,6 +23,7 @@
 
 #include <QFile>
 
+#include "audioresampler.h"
 #include "common/define.h"
 #include "tempoprocessor.h"
 
@@ -39,6 +40,11 @@ public:
 
   void SetParameters(const AudioParams& params);
 
+  /**
+   * @brief Set the format the output device plays, if it differs from SetParameters() samples are converted to it
+   */
+  void SetDeviceParameters(const AudioParams& params);
+
   void SetDevice(QIODevice *device, qint64 offset, int playback_speed);
 
   virtual void close() override;
@@ -49,14 +55,30 @@ protected:
   virtual qint64 writeData(const char *data, qint64 maxSize) override;
 
 private:
+  /**
+   * @brief Read samples in the format set with SetParameters(), with speed and reverse applied
+   */
+  qint64 ReadSamples(char *data, qint64 maxlen);
+
   qint64 ReverseAwareRead(char* data, qint64 maxlen);
 
+  void ResetConversion();
+
   QIODevice* device_;
 
   TempoProcessor tempo_processor_;
 
   AudioParams params_;
 
+  AudioParams device_params_;
+
+  AudioResampler resampler_;
+
+  // Samples converted to the device's format that haven't been read yet
+  QByteArray converted_;
+
+  QByteArray read_buffer_;
+
   int playback_speed_;
 
 };
@@ -25,14 +25,33 @@
 
 #include <QFile>
 
+#include "common/channellayout.h"
+
 namespace olive {
 
 AudioOutputManager::AudioOutputManager(QObject *parent) :
   QObject(parent),
   output_(nullptr),
   push_device_(nullptr),
-  device_proxy_(this)
+  device_proxy_(this),
+  ring_device_(&ring_, this),
+  feeder_(this),
+#ifdef USE_PORTAUDIO
+  native_pulling_(false),
+  native_push_timer_(this),
+#endif
+  latency_(0),
+  played_usecs_(-1),
+  played_updated_(0),
+  native_played_(false),
+  pending_devices_(0)
 {
+  played_clock_.start();
+
+#ifdef USE_PORTAUDIO
+  native_push_timer_.setSingleShot(true);
+  connect(&native_push_timer_, &QTimer::timeout, this, &AudioOutputManager::PushMoreSamples);
+#endif
 }
 
 AudioOutputManager::~AudioOutputManager()
@@ -46,7 +65,13 @@ void AudioOutputManager::Push(const QByteArray& samples)
   QMutexLocker lock(&push_sample_lock_);
 
   // Replace sample buffer with this one
-  push_samples_ = samples;
+  if (push_resampler_.IsOpen()) {
+    push_samples_ = push_resampler_.ConvertPacked(samples.constData(),
+                                                  int(params_.bytes_to_samples(samples.size())),
+                                                  device_params_.samples_to_bytes(1));
+  } else {
+    push_samples_ = samples;
+  }
   push_sample_index_ = 0;
 
   // If we had another device connected, disconnect it now
@@ -56,13 +81,54 @@ void AudioOutputManager::Push(const QByteArray& samples)
   QMetaObject::invokeMethod(this, "PushMoreSamples", Qt::QueuedConnection);
 }
 
+qint64 AudioOutputManager::GetPlayedUSecs() const
+{
+  if (pending_devices_ > 0) {
+    return -1;
+  }
+
+  QMutexLocker locker(&played_lock_);
+
+#ifdef USE_PORTAUDIO
+  if (native_played_) {
+    // Stamped by the device's own callback, there's nothing to extrapolate
+    return native_.GetPlayedUSecs();
+  }
+#endif
+
+  if (played_usecs_ < 0) {
+    return -1;
+  }
+
+  // Don't run far ahead if the output has stopped notifying us, e.g. because it underran
+  qint64 since_update = qMin((played_clock_.nsecsElapsed() - played_updated_) / 1000, qint64(100000));
+
+  return played_usecs_ + since_update;
+}
+
+void AudioOutputManager::ExpectNewDevice()
+{
+  pending_devices_++;
+}
+
 void AudioOutputManager::ResetToPushMode()
 {
+#ifdef USE_PORTAUDIO
+  if (native_pulling_) {
+    // The native output stays open, it just goes back to reading pushed samples from the ring
+    native_.Stop();
+    StopPulling();
+    native_pulling_ = false;
+    native_.Start();
+    return;
+  }
+#endif
+
   // If we have a null push device, then we currently have the output in pull mode. We restore it to push mode here.
   if (output_ && !push_device_) {
     output_->stop();
 
-    device_proxy_.close();
+    StopPulling();
 
     // Put QAudioOutput back into push mode
     push_device_ = output_->start();
@@ -71,19 +137,37 @@ void AudioOutputManager::ResetToPushMode()
 
 void AudioOutputManager::SetParameters(AudioParams params)
 {
-  device_proxy_.SetParameters(params);
+  // Whatever is being pulled was made for the old parameters
+  ResetToPushMode();
+
+  {
+    QMutexLocker locker(&push_sample_lock_);
+    params_ = params;
+  }
+
+  UpdateConversion();
 }
 
 void AudioOutputManager::Close()
 {
+#ifdef USE_PORTAUDIO
+  if (native_.IsOpen()) {
+    native_push_timer_.stop();
+    native_.Stop();
+    native_pulling_ = false;
+
+    StopPulling();
+
+    native_.Close();
+  }
+#endif
+
   if (output_) {
     output_->stop();
 
     push_device_ = nullptr;
 
-    if (device_proxy_.isOpen()) {
-      device_proxy_.close();
-    }
+    StopPulling();
 
     delete output_;
     output_ = nullptr;
@@ -92,6 +176,36 @@ void AudioOutputManager::Close()
 
 void AudioOutputManager::PullFromDevice(QIODevice *device, qint64 offset, int playback_speed)
 {
+  // Nothing from the previous device can be reported after this, since notifications are handled
+  // on this thread too
+  ResetPlayedPosition();
+  pending_devices_--;
+
+#ifdef USE_PORTAUDIO
+  if (native_.IsOpen()) {
+    native_push_timer_.stop();
+    native_.Stop();
+    push_samples_.clear();
+
+    StopPulling();
+
+    device_proxy_.SetDevice(device, offset, playback_speed);
+    device_proxy_.open(QIODevice::ReadOnly);
+
+    PrepareRing();
+
+    feeder_.Fill();
+    feeder_.start(QThread::HighPriority);
+
+    native_pulling_ = true;
+    native_.Start();
+
+    QMutexLocker locker(&played_lock_);
+    native_played_ = true;
+    return;
+  }
+#endif
+
   if (!output_) {
     return;
   }
@@ -101,16 +215,102 @@ void AudioOutputManager::PullFromDevice(QIODevice *device, qint64 offset, int pl
   push_device_ = nullptr;
   push_samples_.clear();
 
-  // Pull from the device
+  StopPulling();
+
+  // Read the device through the proxy (for speed and reverse) on the feeder thread
   device_proxy_.SetDevice(device, offset, playback_speed);
   device_proxy_.open(QIODevice::ReadOnly);
-  output_->start(&device_proxy_);
+
+  PrepareRing();
+
+  // Fill the ring before starting so playback doesn't begin with an underrun
+  feeder_.Fill();
+  feeder_.start(QThread::HighPriority);
+
+  ring_device_.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+  output_->start(&ring_device_);
+}
+
+void AudioOutputManager::StopPulling()
+{
+  if (feeder_.isRunning()) {
+    feeder_.Stop();
+  }
+
+  if (ring_device_.isOpen()) {
+    ring_device_.close();
+  }
+
+  if (device_proxy_.isOpen()) {
+    device_proxy_.close();
+  }
+
+  ring_.Reset();
+
+  ResetPlayedPosition();
+}
+
+void AudioOutputManager::PrepareRing()
+{
+  qint64 device_buffer = device_params_.samples_to_bytes(qint64(device_params_.sample_rate()) * latency_ / 1000);
+  qint64 frame_size = qMax(qint64(1), device_params_.samples_to_bytes(1));
+
+  // Read a quarter of the device buffer at a time, whole frames only
+  qint64 chunk = qMax(frame_size, device_buffer / 4 / frame_size * frame_size);
+  ring_.Allocate(qMax(device_buffer * 4, chunk * 8));
+  feeder_.SetSource(&device_proxy_, &ring_, chunk, qMax(1, latency_ / 4));
+}
+
+void AudioOutputManager::UpdateConversion()
+{
+  QMutexLocker locker(&push_sample_lock_);
+
+  device_proxy_.SetParameters(params_);
+  device_proxy_.SetDeviceParameters(device_params_);
+
+  push_resampler_.Close();
+
+  if (AudioResampler::IsConversionNeeded(params_, device_params_)) {
+    // Realtime, so favor speed over quality
+    push_resampler_.Open(params_, false, device_params_, false, AudioResampler::kQualityFast);
+  }
+}
+
+void AudioOutputManager::ResetPlayedPosition()
+{
+  QMutexLocker locker(&played_lock_);
+  played_usecs_ = -1;
+  native_played_ = false;
 }
 
 void AudioOutputManager::PushMoreSamples()
 {
   QMutexLocker lock(&push_sample_lock_);
 
+#ifdef USE_PORTAUDIO
+  if (native_.IsOpen()) {
+    if (native_pulling_ || push_samples_.isEmpty()) {
+      return;
+    }
+
+    // Whole frames only, the callback reads the ring a frame at a time
+    qint64 frame_size = qMax(qint64(1), device_params_.samples_to_bytes(1));
+    qint64 fit = qMin(qint64(push_samples_.size() - push_sample_index_), ring_.writable());
+    fit -= fit % frame_size;
+
+    push_sample_index_ += int(ring_.write(push_samples_.constData() + push_sample_index_, fit));
+
+    if (push_sample_index_ == push_samples_.size()) {
+      push_samples_.clear();
+    } else {
+      // There are no notifications to wait for, check back once the callback has made some room
+      native_push_timer_.start(qMax(1, latency_ / 4));
+    }
+
+    return;
+  }
+#endif
+
   // Check if we're currently in push mode and if we have samples to push
   if (!push_device_ || push_samples_.isEmpty()) {
     return;
@@ -131,23 +331,78 @@ void AudioOutputManager::PushMoreSamples()
   }
 }
 
-void AudioOutputManager::SetOutputDevice(QAudioDeviceInfo info, QAudioFormat format)
+void AudioOutputManager::SetOutputDevice(QAudioDeviceInfo info, QAudioFormat format, int latency)
 {
   // Whatever the output is doing right now, stop it
   Close();
 
+  latency_ = qMax(1, latency);
+
   // Create a new output device and start it in push mode
   output_ = new QAudioOutput(info, format, this);
-  output_->setBufferSize(16384);
+  output_->setBufferSize(format.bytesForDuration(qint64(latency_) * 1000));
   output_->setNotifyInterval(1);
   push_device_ = output_->start();
   connect(output_, &QAudioOutput::notify, this, &AudioOutputManager::PushMoreSamples);
   connect(output_, &QAudioOutput::notify, this, &AudioOutputManager::OutputNotified);
+  connect(output_, &QAudioOutput::notify, this, &AudioOutputManager::UpdatePlayedPosition);
+
+  {
+    QMutexLocker locker(&push_sample_lock_);
+    device_params_ = AudioParams(format.sampleRate(),
+                                 uint64_t(av_get_default_channel_layout(format.channelCount())),
+                                 AudioParams::GetFormatFromQt(format.sampleType(), format.sampleSize()));
+  }
+
+  UpdateConversion();
 
   // Un-comment this to get debug information about what the audio output is doing
   //connect(output_, &QAudioOutput::stateChanged, this, &AudioOutputManager::OutputStateChanged);
 }
 
+#ifdef USE_PORTAUDIO
+void AudioOutputManager::SetNativeOutputDevice(QString device_name, AudioParams params, int latency,
+                                               int buffer_frames, bool exclusive)
+{
+  // Whatever the output is doing right now, stop it
+  Close();
+
+  latency_ = qMax(1, latency);
+
+  AudioParams opened = native_.Open(device_name, params, buffer_frames, latency_, exclusive, &ring_);
+  if (!opened.is_valid()) {
+    return;
+  }
+
+  {
+    QMutexLocker locker(&push_sample_lock_);
+    device_params_ = opened;
+  }
+
+  UpdateConversion();
+
+  // Start in push mode
+  PrepareRing();
+  native_.Start();
+}
+#endif
+
+void AudioOutputManager::UpdatePlayedPosition()
+{
+  // Only pulled devices correspond to a playback position
+  if (!ring_device_.isOpen() || output_->state() != QAudio::ActiveState) {
+    return;
+  }
+
+  // Whatever is still in the output's buffer hasn't been heard yet
+  qint64 buffered = output_->format().durationForBytes(qMax(0, output_->bufferSize() - output_->bytesFree()));
+  qint64 played = qMax(qint64(0), output_->processedUSecs() - buffered);
+
+  QMutexLocker locker(&played_lock_);
+  played_usecs_ = played;
+  played_updated_ = played_clock_.nsecsElapsed();
+}
+
 void AudioOutputManager::OutputStateChanged(QAudio::State state)
 {
   qDebug() << state << output_->error();
@@ -21,14 +21,20 @@
 #ifndef AUDIOHYBRIDDEVICE_H
 #define AUDIOHYBRIDDEVICE_H
 
+#include <atomic>
 #include <memory>
 #include <QAudioOutput>
 #include <QBuffer>
+#include <QElapsedTimer>
 #include <QIODevice>
 #include <QMutex>
 #include <QThread>
+#include <QTimer>
 
+#include "audioresampler.h"
+#include "audioringbuffer.h"
 #include "outputdeviceproxy.h"
+#include "portaudiooutput.h"
 
 namespace olive {
 
@@ -43,9 +49,46 @@ public:
   // Thread-safe
   void Push(const QByteArray &samples);
 
+  /**
+   * @brief How much of the device being pulled from has actually been heard, in microseconds
+   *
+   * Returns -1 if nothing is being pulled or the output hasn't started playing it yet. Native outputs
+   * report it exactly, otherwise it's extrapolated from the last of the output's notifications.
+   */
+  // Thread-safe
+  qint64 GetPlayedUSecs() const;
+
+  /**
+   * @brief Stop reporting a played position until the next PullFromDevice() has run
+   *
+   * Call before queueing PullFromDevice() so the previous device's position isn't mistaken for the
+   * new one's in the meantime.
+   */
+  // Thread-safe
+  void ExpectNewDevice();
+
 public slots:
+  /**
+   * @brief Open an output device
+   *
+   * `latency` is how much audio (in milliseconds) the output device buffers. The ring between the
+   * playback cache and the device holds a few times that.
+   */
   // Queued
-  void SetOutputDevice(QAudioDeviceInfo info, QAudioFormat format);
+  void SetOutputDevice(QAudioDeviceInfo info, QAudioFormat format, int latency);
+
+#ifdef USE_PORTAUDIO
+  /**
+   * @brief Open a native output device through PortAudio instead of QAudioOutput
+   *
+   * `device_name` is matched against the native device names, falling back to the default device.
+   * `buffer_frames` is how many frames the device asks for at a time, 0 leaves it up to the host API.
+   * If the device can't play `params`, audio is converted to something it can.
+   */
+  // Queued
+  void SetNativeOutputDevice(QString device_name, olive::AudioParams params, int latency,
+                             int buffer_frames, bool exclusive);
+#endif
 
   /**
    * @brief Connect a QIODevice (e.g. QFile) to start sending to the audio output
@@ -75,11 +118,55 @@ private:
   QByteArray push_samples_;
   int push_sample_index_;
 
+  // Pushed samples are converted to the device's format as they arrive
+  AudioParams params_;
+  AudioParams device_params_;
+  AudioResampler push_resampler_;
+
   AudioOutputDeviceProxy device_proxy_;
 
+  // During playback the proxy is read on the feeder thread into the ring, and the output only ever
+  // reads from the ring
+  AudioRingBuffer ring_;
+  AudioRingDevice ring_device_;
+  AudioRingFeeder feeder_;
+
+#ifdef USE_PORTAUDIO
+  // Reads the ring from its callback in push mode too, pushed samples are written into the ring
+  PortAudioOutput native_;
+  bool native_pulling_;
+  QTimer native_push_timer_;
+#endif
+
+  int latency_;
+
+  mutable QMutex played_lock_;
+  QElapsedTimer played_clock_;
+  qint64 played_usecs_;
+  qint64 played_updated_;
+  bool native_played_;
+
+  std::atomic_int pending_devices_;
+
+  void StopPulling();
+
+  /**
+   * @brief Size the ring for `latency_` of the device's audio and the feeder to match
+   */
+  void PrepareRing();
+
+  /**
+   * @brief Set up converting from the sequence's format to the output device's
+   */
+  void UpdateConversion();
+
+  void ResetPlayedPosition();
+
 private slots:
   void PushMoreSamples();
 
+  void UpdatePlayedPosition();
+
   void OutputStateChanged(QAudio::State state);
 
 };
@@ -0,0 +1,339 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "portaudiooutput.h"
+
+#ifdef USE_PORTAUDIO
+
+#include <cstring>
+#include <QDebug>
+
+#ifdef Q_OS_WINDOWS
+#include <pa_win_wasapi.h>
+#endif
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+}
+
+namespace olive {
+
+PortAudioOutput::PortAudioOutput() :
+  stream_(nullptr),
+  ring_(nullptr),
+  frame_size_(1),
+  output_latency_(0.0),
+  frames_read_(0),
+  sequence_(0),
+  anchor_frame_(0),
+  anchor_length_(0),
+  anchor_time_(0.0),
+  underruns_(0)
+{
+  // PortAudio counts initializations, so every instance can do its own
+  PaError err = Pa_Initialize();
+  initialized_ = (err == paNoError);
+
+  if (!initialized_) {
+    qWarning() << "Failed to initialize PortAudio:" << Pa_GetErrorText(err);
+  }
+}
+
+PortAudioOutput::~PortAudioOutput()
+{
+  Close();
+
+  if (initialized_) {
+    Pa_Terminate();
+  }
+}
+
+AudioParams PortAudioOutput::Open(const QString &device_name, const AudioParams &params, int buffer_frames,
+                                  int latency, bool exclusive, AudioRingBuffer *ring)
+{
+  Close();
+
+  if (!initialized_ || !params.is_valid()) {
+    return AudioParams();
+  }
+
+  PaDeviceIndex device = FindDevice(device_name);
+  if (device == paNoDevice) {
+    qWarning() << "No PortAudio output device available";
+    return AudioParams();
+  }
+
+  const PaDeviceInfo* device_info = Pa_GetDeviceInfo(device);
+
+  // Formats PortAudio can't take are played as float, the output manager converts to that
+  AudioParams::Format format = params.format();
+  if (GetSampleFormat(format) == 0) {
+    format = AudioParams::kFormatFloat32;
+  }
+
+  int channels = params.channel_count();
+  uint64_t layout = params.channel_layout();
+  if (channels > device_info->maxOutputChannels) {
+    channels = device_info->maxOutputChannels;
+    layout = uint64_t(av_get_default_channel_layout(channels));
+  }
+
+  PaStreamParameters output_params;
+  memset(&output_params, 0, sizeof(output_params));
+  output_params.device = device;
+  output_params.channelCount = channels;
+  output_params.sampleFormat = GetSampleFormat(format);
+  output_params.suggestedLatency = qMax(device_info->defaultLowOutputLatency, latency * 0.001);
+
+#ifdef Q_OS_WINDOWS
+  PaWasapiStreamInfo wasapi_info;
+  if (exclusive && Pa_GetHostApiInfo(device_info->hostApi)->type == paWASAPI) {
+    memset(&wasapi_info, 0, sizeof(wasapi_info));
+    wasapi_info.size = sizeof(PaWasapiStreamInfo);
+    wasapi_info.hostApiType = paWASAPI;
+    wasapi_info.version = 1;
+    wasapi_info.flags = paWinWasapiExclusive | paWinWasapiThreadPriority;
+    wasapi_info.threadPriority = eThreadPriorityProAudio;
+    output_params.hostApiSpecificStreamInfo = &wasapi_info;
+  }
+#else
+  Q_UNUSED(exclusive)
+#endif
+
+  double sample_rate = params.sample_rate();
+  if (Pa_IsFormatSupported(nullptr, &output_params, sample_rate) != paFormatIsSupported) {
+    // JACK and exclusive WASAPI only run at the device's own rate, resample to that instead
+    sample_rate = device_info->defaultSampleRate;
+  }
+
+  unsigned long frames_per_buffer = buffer_frames > 0 ? static_cast<unsigned long>(buffer_frames) : paFramesPerBufferUnspecified;
+
+  PaError err = Pa_OpenStream(&stream_, nullptr, &output_params, sample_rate, frames_per_buffer,
+                              paClipOff | paDitherOff, &PortAudioOutput::Callback, this);
+
+  if (err != paNoError && output_params.hostApiSpecificStreamInfo) {
+    qWarning() << "Failed to open exclusive output, falling back to shared:" << Pa_GetErrorText(err);
+    output_params.hostApiSpecificStreamInfo = nullptr;
+    err = Pa_OpenStream(&stream_, nullptr, &output_params, sample_rate, frames_per_buffer,
+                        paClipOff | paDitherOff, &PortAudioOutput::Callback, this);
+  }
+
+  if (err != paNoError) {
+    qWarning() << "Failed to open PortAudio output:" << Pa_GetErrorText(err);
+    stream_ = nullptr;
+    return AudioParams();
+  }
+
+  const PaStreamInfo* stream_info = Pa_GetStreamInfo(stream_);
+  output_latency_ = stream_info->outputLatency;
+
+  params_ = AudioParams(int(stream_info->sampleRate), layout, format);
+  frame_size_ = int(params_.samples_to_bytes(1));
+  ring_ = ring;
+
+  qInfo() << "Opened" << device_info->name << "through" << Pa_GetHostApiInfo(device_info->hostApi)->name
+          << "with" << output_latency_ * 1000.0 << "ms output latency";
+
+  return params_;
+}
+
+void PortAudioOutput::Close()
+{
+  if (stream_) {
+    Stop();
+    Pa_CloseStream(stream_);
+    stream_ = nullptr;
+  }
+}
+
+bool PortAudioOutput::Start()
+{
+  if (!stream_) {
+    return false;
+  }
+
+  Stop();
+
+  frames_read_ = 0;
+  sequence_.store(0);
+
+  PaError err = Pa_StartStream(stream_);
+  if (err != paNoError) {
+    qWarning() << "Failed to start PortAudio output:" << Pa_GetErrorText(err);
+    return false;
+  }
+
+  return true;
+}
+
+void PortAudioOutput::Stop()
+{
+  if (stream_ && Pa_IsStreamActive(stream_) == 1) {
+    // Abort rather than stop, there's no reason to wait for what's buffered to play out
+    Pa_AbortStream(stream_);
+  }
+}
+
+qint64 PortAudioOutput::GetPlayedUSecs() const
+{
+  if (!stream_) {
+    return -1;
+  }
+
+  unsigned seq;
+  qint64 frame, length;
+  double time;
+
+  do {
+    seq = sequence_.load();
+    frame = anchor_frame_.load();
+    length = anchor_length_.load();
+    time = anchor_time_.load();
+  } while ((seq & 1) || seq != sequence_.load());
+
+  if (seq == 0) {
+    return -1;
+  }
+
+  // Count on from the start of the last buffer, but never past what it actually contained
+  double since_anchor = Pa_GetStreamTime(stream_) - time;
+  qint64 played = frame + qint64(since_anchor * params_.sample_rate());
+  played = qBound(qint64(0), played, frame + length);
+
+  return played * 1000000 / params_.sample_rate();
+}
+
+int PortAudioOutput::Callback(const void *input, void *output, unsigned long frames,
+                              const PaStreamCallbackTimeInfo *time_info, PaStreamCallbackFlags status,
+                              void *user_data)
+{
+  Q_UNUSED(input)
+  Q_UNUSED(status)
+
+  return static_cast<PortAudioOutput*>(user_data)->Process(static_cast<char*>(output), qint64(frames), time_info);
+}
+
+int PortAudioOutput::Process(char *output, qint64 frames, const PaStreamCallbackTimeInfo *time_info)
+{
+  qint64 length = frames * frame_size_;
+  qint64 read = ring_->read(output, length);
+
+  if (read < length) {
+    // Play silence rather than stopping, only counting it if more audio was expected
+    memset(output + read, 0, size_t(length - read));
+
+    if (!ring_->end_of_stream()) {
+      underruns_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Some host APIs don't know when the buffer will be heard, estimate it from the stream's latency
+  double dac_time = time_info->outputBufferDacTime;
+  if (dac_time <= 0.0) {
+    dac_time = time_info->currentTime + output_latency_;
+  }
+
+  sequence_.fetch_add(1);
+  anchor_frame_.store(frames_read_);
+  anchor_length_.store(read / frame_size_);
+  anchor_time_.store(dac_time);
+  sequence_.fetch_add(1);
+
+  frames_read_ += read / frame_size_;
+
+  return paContinue;
+}
+
+PaHostApiIndex PortAudioOutput::GetPreferredHostApi()
+{
+#if defined(Q_OS_WINDOWS)
+  const PaHostApiTypeId preferred[] = {paWASAPI};
+#elif defined(Q_OS_MAC)
+  const PaHostApiTypeId preferred[] = {paCoreAudio};
+#else
+  // PipeWire serves JACK clients too, so JACK is used whenever either server is running
+  const PaHostApiTypeId preferred[] = {paJACK, paALSA};
+#endif
+
+  for (PaHostApiTypeId type : preferred) {
+    PaHostApiIndex index = Pa_HostApiTypeIdToHostApiIndex(type);
+
+    if (index >= 0 && Pa_GetHostApiInfo(index)->defaultOutputDevice != paNoDevice) {
+      return index;
+    }
+  }
+
+  return Pa_GetDefaultHostApi();
+}
+
+PaDeviceIndex PortAudioOutput::FindDevice(const QString &name)
+{
+  PaHostApiIndex host_api = GetPreferredHostApi();
+  if (host_api < 0) {
+    return Pa_GetDefaultOutputDevice();
+  }
+
+  const PaHostApiInfo* host_api_info = Pa_GetHostApiInfo(host_api);
+
+  if (!name.isEmpty()) {
+    // Device names aren't the same as Qt's on every platform, so settle for one containing the other
+    for (int i=0; i<host_api_info->deviceCount; i++) {
+      PaDeviceIndex device = Pa_HostApiDeviceIndexToDeviceIndex(host_api, i);
+      const PaDeviceInfo* info = Pa_GetDeviceInfo(device);
+      QString device_name = QString::fromUtf8(info->name);
+
+      if (info->maxOutputChannels > 0
+          && (device_name.contains(name, Qt::CaseInsensitive) || name.contains(device_name, Qt::CaseInsensitive))) {
+        return device;
+      }
+    }
+  }
+
+  if (host_api_info->defaultOutputDevice != paNoDevice) {
+    return host_api_info->defaultOutputDevice;
+  }
+
+  return Pa_GetDefaultOutputDevice();
+}
+
+PaSampleFormat PortAudioOutput::GetSampleFormat(AudioParams::Format format)
+{
+  switch (format) {
+  case AudioParams::kFormatUnsigned8:
+    return paUInt8;
+  case AudioParams::kFormatSigned16:
+    return paInt16;
+  case AudioParams::kFormatSigned32:
+    return paInt32;
+  case AudioParams::kFormatFloat32:
+    return paFloat32;
+  case AudioParams::kFormatSigned64:
+  case AudioParams::kFormatFloat64:
+  case AudioParams::kFormatInvalid:
+  case AudioParams::kFormatCount:
+    break;
+  }
+
+  return 0;
+}
+
+}
+
+#endif // USE_PORTAUDIO
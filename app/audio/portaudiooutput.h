@@ -0,0 +1,140 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PORTAUDIOOUTPUT_H
+#define PORTAUDIOOUTPUT_H
+
+#ifdef USE_PORTAUDIO
+
+#include <atomic>
+#include <portaudio.h>
+#include <QString>
+
+#include "audioringbuffer.h"
+#include "common/define.h"
+#include "render/audioparams.h"
+
+namespace olive {
+
+/**
+ * @brief Callback-driven audio output through PortAudio
+ *
+ * The stream's callback reads straight from an AudioRingBuffer, so nothing sits between the feeder
+ * and the hardware except what the host API itself buffers. The host API is WASAPI (optionally in
+ * exclusive mode) on Windows, CoreAudio on macOS and JACK (which PipeWire also serves) or ALSA on
+ * Linux.
+ *
+ * Every callback is stamped with when its buffer will reach the DAC, so the played position is
+ * sample-accurate rather than extrapolated from notifications.
+ */
+class PortAudioOutput
+{
+public:
+  PortAudioOutput();
+
+  ~PortAudioOutput();
+
+  DISABLE_COPY_MOVE(PortAudioOutput)
+
+  /**
+   * @brief Open a stream that will read `ring`
+   *
+   * Plays on the output device called `device_name`, or the host API's default if there isn't one.
+   * `buffer_frames` is how many frames each callback asks for (0 leaves it up to the host API) and
+   * `latency` is how much the host API should buffer, in milliseconds.
+   *
+   * Returns the (packed) parameters the device was opened with, which may differ from `params` if the
+   * device couldn't play those. Returns invalid parameters if nothing could be opened.
+   */
+  AudioParams Open(const QString& device_name, const AudioParams& params, int buffer_frames,
+                   int latency, bool exclusive, AudioRingBuffer* ring);
+
+  void Close();
+
+  bool IsOpen() const
+  {
+    return stream_;
+  }
+
+  /**
+   * @brief Start calling back, resetting the played position to the start of the ring
+   *
+   * The ring can only be reset or reallocated while the stream is stopped.
+   */
+  bool Start();
+
+  void Stop();
+
+  /**
+   * @brief How much of what's been read from the ring has actually been heard, in microseconds
+   *
+   * Returns -1 before the first callback since Start(). Thread-safe while the stream is open.
+   */
+  qint64 GetPlayedUSecs() const;
+
+  int underrun_count() const
+  {
+    return underruns_.load(std::memory_order_relaxed);
+  }
+
+private:
+  static int Callback(const void* input, void* output, unsigned long frames,
+                      const PaStreamCallbackTimeInfo* time_info, PaStreamCallbackFlags status,
+                      void* user_data);
+
+  int Process(char* output, qint64 frames, const PaStreamCallbackTimeInfo* time_info);
+
+  static PaHostApiIndex GetPreferredHostApi();
+
+  static PaDeviceIndex FindDevice(const QString& name);
+
+  static PaSampleFormat GetSampleFormat(AudioParams::Format format);
+
+  bool initialized_;
+
+  PaStream* stream_;
+
+  AudioRingBuffer* ring_;
+
+  AudioParams params_;
+
+  int frame_size_;
+
+  double output_latency_;
+
+  // Only touched by the callback while running
+  qint64 frames_read_;
+
+  // Where the most recent callback's buffer sits in the ring and when it'll be heard, published with
+  // a sequence lock since the callback must never wait
+  std::atomic<unsigned> sequence_;
+  std::atomic<qint64> anchor_frame_;
+  std::atomic<qint64> anchor_length_;
+  std::atomic<double> anchor_time_;
+
+  std::atomic<int> underruns_;
+
+};
+
+}
+
+#endif // USE_PORTAUDIO
+
+#endif // PORTAUDIOOUTPUT_H
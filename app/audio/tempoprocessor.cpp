@@ -20,24 +20,16 @@
 
 #include "tempoprocessor.h"
 
-extern "C" {
-#include <libavfilter/buffersink.h>
-#include <libavfilter/buffersrc.h>
-#include <libavutil/opt.h>
-}
-
+#include <cmath>
 #include <QDebug>
-
-#include "common/ffmpegutils.h"
+#include <QtMath>
 
 namespace olive {
 
 TempoProcessor::TempoProcessor() :
-  filter_graph_(nullptr),
-  buffersrc_ctx_(nullptr),
-  buffersink_ctx_(nullptr),
-  processed_frame_(nullptr),
-  open_(false)
+  speed_(1.0),
+  open_(false),
+  flushed_(false)
 {
 
 }
@@ -52,92 +44,60 @@ const double &TempoProcessor::GetSpeed() const
   return speed_;
 }
 
+void TempoProcessor::SetSpeed(const double &speed)
+{
+  if (speed > 0.0) {
+    speed_ = speed;
+  }
+}
+
 bool TempoProcessor::Open(const AudioParams &params, const double& speed)
 {
   if (open_) {
+    SetSpeed(speed);
     return true;
   }
 
-  params_ = params;
-  speed_ = speed;
-
-  // Create AVFilterGraph instance
-  filter_graph_ = avfilter_graph_alloc();
-  if (!filter_graph_) {
-    qCritical() << "Failed to create AVFilterGraph";
-    Close();
+  if (!params.is_valid() || params.format() != AudioParams::kFormatFloat32) {
+    qCritical() << "TempoProcessor only supports packed 32-bit float audio";
     return false;
   }
 
-  // Set up audio buffer args
-  char filter_args[200];
-  snprintf(filter_args, 200, "time_base=%d/%d:sample_rate=%d:sample_fmt=%d:channel_layout=0x%" PRIx64,
-           1,
-           params_.sample_rate(),
-           params_.sample_rate(),
-           FFmpegUtils::GetFFmpegSampleFormat(params_.format()),
-           params.channel_layout());
-
-  // Create buffer and buffersink
-  if (avfilter_graph_create_filter(&buffersrc_ctx_, avfilter_get_by_name("abuffer"), "in", filter_args, nullptr, filter_graph_) < 0) {
-    qCritical() << "Failed to create audio buffer source";
-    Close();
-    return false;
-  }
-
-  if (avfilter_graph_create_filter(&buffersink_ctx_, avfilter_get_by_name("abuffersink"), "out", nullptr, nullptr, filter_graph_) < 0) {
-    qCritical() << "Failed to create audio buffer sink";
-    Close();
-    return false;
-  }
-
-  // Create audio tempo filters: FFmpeg's atempo can only be set between 0.5 and 2.0. If the requested speed is outside
-  // those boundaries, we need to daisychain more than one together.
-  double base = (speed_ > 1.0) ? 2.0 : 0.5;
-  double speed_log = log(speed_) / log(base);
-
-  // This is the number of how many 0.5 or 2.0 tempos we need to daisychain
-  int whole = qFloor(speed_log);
-
-  // Set speed_log to the remainder
-  speed_log -= whole;
-
-  AVFilterContext* previous_filter = buffersrc_ctx_;
-
-  for (int i=0;i<=whole;i++) {
-    double filter_tempo = (i == whole) ? qPow(base, speed_log) : base;
-
-    if (qFuzzyCompare(filter_tempo, 1.0)) {
-      // This filter would do nothing
-      continue;
-    }
-
-    previous_filter = CreateTempoFilter(filter_graph_,
-                                        previous_filter,
-                                        filter_tempo);
-
-    if (!previous_filter) {
-      qCritical() << "Failed to create audio tempo filter";
-      Close();
-      return false;
-    }
+  params_ = params;
+  speed_ = 1.0;
+  SetSpeed(speed);
+
+  // 20ms segments crossfaded over 10ms, each allowed to shift up to 8ms to find the best match.
+  // These are kept short so shuttle audio responds quickly.
+  int sample_rate = params_.sample_rate();
+  segment_length_ = qMax(2, sample_rate / 50);
+  overlap_length_ = qMax(1, sample_rate / 100);
+  search_length_ = qMax(1, sample_rate / 125);
+
+  int channels = params_.channel_count();
+
+  // Reuse any allocations from a previous session
+  input_.resize(channels);
+  overlap_.resize(channels);
+  for (int i=0; i<channels; i++) {
+    input_[i].clear();
+    overlap_[i].assign(overlap_length_, 0.0f);
   }
+  overlap_mix_.assign(overlap_length_, 0.0f);
 
-  // Link the last filter to the buffersink
-  if (avfilter_link(previous_filter, 0, buffersink_ctx_, 0) != 0) {
-    qCritical() << "Failed to link final filter and buffer sink";
-    Close();
-    return false;
+  // Raised cosine so the crossfade stays close to constant power on correlated material
+  fade_.resize(overlap_length_);
+  for (int i=0; i<overlap_length_; i++) {
+    fade_[i] = 0.5f - 0.5f * std::cos(float(M_PI) * float(i + 1) / float(overlap_length_ + 1));
   }
 
-  // Config graph
-  if (avfilter_graph_config(filter_graph_, nullptr) < 0) {
-    qCritical() << "Failed to configure filter graph";
-    Close();
-    return false;
-  }
+  output_.clear();
+  output_read_index_ = 0;
 
-  timestamp_ = 0;
+  input_start_ = 0;
+  analysis_pos_ = 0.0;
+  has_overlap_ = false;
+  overlap_energy_ = 0.0;
 
   open_ = true;
 
@@ -155,123 +115,204 @@ void TempoProcessor::Push(const char *data, int length)
     return;
   }
 
-  AVFrame* src_frame;
-
   if (length == 0) {
-    // No audio data, flush the last out of the filter graph
-    src_frame = nullptr;
+    // No more audio data, pad with silence so the last of the input can be synthesized
     flushed_ = true;
-  } else {
-    src_frame = av_frame_alloc();
 
-    if (!src_frame) {
-      qCritical() << "Failed to allocate source frame";
-      return;
+    for (size_t i=0; i<input_.size(); i++) {
+      input_[i].resize(input_[i].size() + segment_length_ + overlap_length_ + search_length_, 0.0f);
     }
-
-    // Allocate a buffer for the number of samples we got
-    src_frame->sample_rate = params_.sample_rate();
-    src_frame->format = FFmpegUtils::GetFFmpegSampleFormat(params_.format());
-    src_frame->channel_layout = params_.channel_layout();
-    src_frame->nb_samples = params_.bytes_to_samples(length);
-    src_frame->pts = timestamp_;
-    timestamp_ += src_frame->nb_samples;
-
-    if (av_frame_get_buffer(src_frame, 0) < 0) {
-      qCritical() << "Failed to allocate buffer for source frame";
-      av_frame_free(&src_frame);
-      return;
+  } else {
+    int channels = params_.channel_count();
+    int samples = params_.bytes_to_samples(length);
+    const float* packed = reinterpret_cast<const float*>(data);
+
+    for (int i=0; i<channels; i++) {
+      std::vector<float>& plane = input_[i];
+      size_t start = plane.size();
+      plane.resize(start + samples);
+
+      const float* src = packed + i;
+      float* dst = plane.data() + start;
+      for (int j=0; j<samples; j++) {
+        dst[j] = src[j * channels];
+      }
     }
+  }
 
-    // Copy buffer from data array to frame
-    memcpy(src_frame->data[0], data, static_cast<size_t>(length));
+  Process();
+}
+
+int TempoProcessor::Pull(char *data, int max_length)
+{
+  if (output_read_index_ >= output_.size()) {
+    return 0;
   }
 
-  int ret = av_buffersrc_add_frame_flags(buffersrc_ctx_, src_frame, AV_BUFFERSRC_FLAG_KEEP_REF);
+  size_t available = output_.size() - output_read_index_;
 
-  if (ret < 0) {
-    qCritical() << "Failed to feed buffer source" << ret;
+  // Only hand out whole samples
+  size_t copy_count = qMin(available, size_t(params_.bytes_to_samples(max_length) * params_.channel_count()));
+
+  if (copy_count == 0) {
+    return 0;
   }
 
-  if (src_frame) {
-    av_frame_free(&src_frame);
+  memcpy(data, output_.data() + output_read_index_, copy_count * sizeof(float));
+  output_read_index_ += copy_count;
+
+  if (output_read_index_ == output_.size()) {
+    output_.clear();
+    output_read_index_ = 0;
   }
+
+  return static_cast<int>(copy_count * sizeof(float));
 }
 
-int TempoProcessor::Pull(char *data, int max_length)
+void TempoProcessor::Close()
 {
-  if (!processed_frame_) {
-    processed_frame_ = av_frame_alloc();
+  open_ = false;
 
-    // Try to pull samples from the buffersink
-    int ret = av_buffersink_get_frame(buffersink_ctx_, processed_frame_);
+  // Keep the allocations around so re-opening (e.g. on every shuttle speed change) is cheap
+  for (size_t i=0; i<input_.size(); i++) {
+    input_[i].clear();
+  }
+  output_.clear();
+  output_read_index_ = 0;
+}
 
-    if (ret < 0) {
-      // We couldn't pull for some reason, if the error was EAGAIN, we just need to send more samples. Otherwise the
-      // error might be fatal...
-      if (ret != AVERROR(EAGAIN)) {
-        qCritical() << "Failed to pull from buffersink" << ret;
-      }
+void TempoProcessor::Process()
+{
+  int channels = params_.channel_count();
 
-      av_frame_free(&processed_frame_);
+  // A segment may start up to search_length_ past its target and reads one overlap past its end
+  while (true) {
+    int64_t target = qRound64(analysis_pos_);
+    int64_t needed = target + search_length_ + segment_length_ + overlap_length_;
 
-      return 0;
+    if (input_.empty() || needed > input_start_ + int64_t(input_.front().size())) {
+      break;
     }
 
-    processed_frame_byte_index_ = 0;
-    processed_frame_max_bytes_ = params_.samples_to_bytes(processed_frame_->nb_samples);
-  }
+    int64_t start = has_overlap_ ? FindBestOffset(target) : target;
+    size_t local = size_t(start - input_start_);
+
+    // Emit one segment, crossfading its head with the previous segment's continuation
+    size_t out_index = output_.size();
+    output_.resize(out_index + size_t(segment_length_) * channels);
+    float* out = output_.data() + out_index;
+
+    for (int c=0; c<channels; c++) {
+      const float* src = input_[c].data() + local;
+      const float* prev = overlap_[c].data();
+      float* dst = out + c;
 
-  // Determine how many bytes we should copy into the data array
-  int copy_length = qMin(max_length, processed_frame_max_bytes_ - processed_frame_byte_index_);
+      int j = 0;
+      if (has_overlap_) {
+        for (; j<overlap_length_; j++) {
+          dst[j * channels] = prev[j] + (src[j] - prev[j]) * fade_[j];
+        }
+      }
+      for (; j<segment_length_; j++) {
+        dst[j * channels] = src[j];
+      }
 
-  // Copy the bytes
-  memcpy(data, processed_frame_->data[0] + processed_frame_byte_index_, static_cast<size_t>(copy_length));
+      // Store what would have followed this segment to align the next one against
+      memcpy(overlap_[c].data(), src + segment_length_, overlap_length_ * sizeof(float));
+    }
+
+    // Mono mix of the new overlap and its energy for the next search
+    overlap_energy_ = 0.0;
+    for (int j=0; j<overlap_length_; j++) {
+      float s = 0.0f;
+      for (int c=0; c<channels; c++) {
+        s += overlap_[c][j];
+      }
+      overlap_mix_[j] = s;
+      overlap_energy_ += double(s) * double(s);
+    }
 
-  // Add the copied amount to the current index
-  processed_frame_byte_index_ += copy_length;
+    has_overlap_ = true;
 
-  // If the index has reached the limit of this processed frame, we can dispose of the frame now
-  if (processed_frame_byte_index_ == processed_frame_max_bytes_) {
-    av_frame_free(&processed_frame_);
-    processed_frame_ = nullptr;
+    // Advance through the input according to the current speed, so speed changes apply at once
+    analysis_pos_ += segment_length_ * speed_;
   }
 
-  return copy_length;
+  DiscardConsumedInput();
 }
 
-void TempoProcessor::Close()
+int64_t TempoProcessor::FindBestOffset(int64_t target) const
 {
-  open_ = false;
+  int channels = params_.channel_count();
+
+  int64_t lowest = qMax(input_start_, target - search_length_);
+  int64_t highest = target + search_length_;
+
+  if (overlap_energy_ <= 0.0) {
+    // Silence matches anything equally well
+    return target;
+  }
+
+  auto score = [&](int64_t pos) {
+    size_t local = size_t(pos - input_start_);
+    double corr = 0.0;
+    double energy = 0.0;
+
+    for (int j=0; j<overlap_length_; j++) {
+      float s = 0.0f;
+      for (int c=0; c<channels; c++) {
+        s += input_[c][local + j];
+      }
+      corr += double(s) * double(overlap_mix_[j]);
+      energy += double(s) * double(s);
+    }
 
-  if (filter_graph_) {
-    avfilter_graph_free(&filter_graph_);
-    filter_graph_ = nullptr;
+    return (energy > 0.0) ? corr / std::sqrt(energy) : 0.0;
+  };
+
+  // Coarse search on every other offset, then refine around the best candidate
+  int64_t best = target;
+  double best_score = score(target);
+
+  for (int64_t pos=lowest; pos<=highest; pos+=2) {
+    double s = score(pos);
+    if (s > best_score) {
+      best_score = s;
+      best = pos;
+    }
   }
 
-  if (processed_frame_) {
-    av_frame_free(&processed_frame_);
-    processed_frame_ = nullptr;
+  for (int64_t pos=qMax(lowest, best-1); pos<=qMin(highest, best+1); pos++) {
+    double s = score(pos);
+    if (s > best_score) {
+      best_score = s;
+      best = pos;
+    }
   }
 
-  buffersrc_ctx_ = nullptr;
-  buffersink_ctx_ = nullptr;
+  return best;
 }
 
-AVFilterContext *TempoProcessor::CreateTempoFilter(AVFilterGraph* graph, AVFilterContext* link, const double &tempo)
+void TempoProcessor::DiscardConsumedInput()
 {
-  // Set up tempo param, which is taken as a C string
-  char speed_param[20];
-  snprintf(speed_param, 20, "%f", tempo);
+  if (input_.empty()) {
+    return;
+  }
+
+  // Nothing before the earliest position the next search can reach will be read again
+  int64_t keep_from = qRound64(analysis_pos_) - search_length_;
+  int64_t discard = qMin(keep_from - input_start_, int64_t(input_.front().size()));
 
-  AVFilterContext* tempo_ctx = nullptr;
+  // Erase in batches to avoid shifting the buffer on every push
+  if (discard < segment_length_ * 4) {
+    return;
+  }
 
-  if (avfilter_graph_create_filter(&tempo_ctx, avfilter_get_by_name("atempo"), "atempo", speed_param, nullptr, graph) >= 0
-      && avfilter_link(link, 0, tempo_ctx, 0) == 0) {
-    return tempo_ctx;
+  for (size_t i=0; i<input_.size(); i++) {
+    input_[i].erase(input_[i].begin(), input_[i].begin() + discard);
   }
 
-  return nullptr;
+  input_start_ += discard;
 }
 
 }
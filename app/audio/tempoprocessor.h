@@ -21,22 +21,24 @@
 #ifndef TEMPOPROCESSOR_H
 #define TEMPOPROCESSOR_H
 
-#ifdef __MINGW32__
-#ifndef __USE_MINGW_ANSI_STDIO
-#define __USE_MINGW_ANSI_STDIO
-#endif
-#endif
-
-#include <inttypes.h>
-
-extern "C" {
-#include <libavfilter/avfilter.h>
-}
+#include <vector>
 
 #include "render/audioparams.h"
 
 namespace olive {
 
+/**
+ * @brief Time-stretches packed float audio without changing its pitch
+ *
+ * Uses WSOLA (waveform similarity overlap-add): the output is built from short input segments
+ * spaced according to the speed, each shifted within a small tolerance so that it lines up with
+ * the natural continuation of the previous segment before the two are crossfaded. Internally audio
+ * is kept as planar floats.
+ *
+ * The speed can be changed at any time with SetSpeed() and takes effect from the next segment,
+ * so nothing has to be rebuilt or flushed when shuttling between speeds. Latency is a single
+ * segment (~20ms) plus the search tolerance.
+ */
 class TempoProcessor
 {
 public:
@@ -46,6 +48,8 @@ public:
 
   const double& GetSpeed() const;
 
+  void SetSpeed(const double& speed);
+
   bool Open(const AudioParams& params, const double &speed);
 
   void Push(const char *data, int length);
@@ -55,27 +59,53 @@ public:
   void Close();
 
 private:
-  static AVFilterContext* CreateTempoFilter(AVFilterGraph *graph, AVFilterContext *link, const double& tempo);
+  /**
+   * @brief Synthesize as many output segments as the buffered input allows
+   */
+  void Process();
 
-  AVFilterGraph* filter_graph_;
+  /**
+   * @brief Find the offset within the search tolerance whose input best matches overlap_
+   */
+  int64_t FindBestOffset(int64_t target) const;
 
-  AVFilterContext* buffersrc_ctx_;
-
-  AVFilterContext* buffersink_ctx_;
-
-  AVFrame* processed_frame_;
-  int processed_frame_byte_index_;
-  int processed_frame_max_bytes_;
+  void DiscardConsumedInput();
 
   AudioParams params_;
 
-  int64_t timestamp_;
-
   double speed_;
 
   bool open_;
 
   bool flushed_;
+
+  // Segment parameters in samples
+  int segment_length_;
+  int overlap_length_;
+  int search_length_;
+
+  // Planar input, input_start_ is the stream position of the first sample held
+  std::vector< std::vector<float> > input_;
+  int64_t input_start_;
+
+  // Stream position the next segment should be taken from before alignment
+  double analysis_pos_;
+
+  // Natural continuation of the last segment that the next segment will be crossfaded with
+  std::vector< std::vector<float> > overlap_;
+  bool has_overlap_;
+
+  // Mono mix of overlap_ used for the similarity search
+  std::vector<float> overlap_mix_;
+  double overlap_energy_;
+
+  // Crossfade curve, overlap_length_ samples long
+  std::vector<float> fade_;
+
+  // Packed output waiting to be pulled
+  std::vector<float> output_;
+  size_t output_read_index_;
+
 };
 
 }
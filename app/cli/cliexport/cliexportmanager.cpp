@@ -20,11 +20,517 @@
 
 #include "cliexportmanager.h"
 
+#include <iostream>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include "common/timecodefunctions.h"
+#include "node/color/colormanager/colormanager.h"
+#include "render/diskmanager.h"
+#include "task/project/load/load.h"
+
 namespace olive {
 
-CLIExportManager::CLIExportManager()
+CLIExportManager::CLIExportManager(const QString &project_filename, QObject *parent) :
+  QObject(parent),
+  project_filename_(project_filename),
+  machine_readable_(false),
+  progress_bar_(nullptr),
+  last_progress_(-1)
+{
+}
+
+bool CLIExportManager::Run()
+{
+  if (project_filename_.isEmpty()) {
+    ReportError(tr("You must specify a project file to export"));
+    return false;
+  }
+
+  if (!QFileInfo::exists(project_filename_)) {
+    ReportError(tr("Specified project does not exist"));
+    return false;
+  }
+
+  QJsonObject spec;
+  if (!LoadSpec(&spec)) {
+    return false;
+  }
+
+  ProjectLoadTask load_task(project_filename_);
+
+  if (!RunTask(&load_task)) {
+    ReportError(tr("Project failed to load: %1").arg(load_task.GetError()));
+    return false;
+  }
+
+  std::unique_ptr<Project> project(load_task.GetLoadedProject());
+
+  QString sequence_name = sequence_name_.isEmpty() ? spec.value(QStringLiteral("sequence")).toString() : sequence_name_;
+  Sequence* sequence = FindSequence(project.get(), sequence_name);
+  if (!sequence) {
+    return false;
+  }
+
+  if (!output_filename_.isEmpty()) {
+    spec.insert(QStringLiteral("filename"), output_filename_);
+  }
+
+  ExportParams params;
+  if (!GenerateParams(spec, sequence, project->color_manager(), &params)) {
+    return false;
+  }
+
+  QVector<ExportParams> deliverables;
+  QJsonValue frame_rate = spec.value(QStringLiteral("video")).toObject().value(QStringLiteral("frame_rate"));
+
+  foreach (const QJsonValue& v, spec.value(QStringLiteral("deliverables")).toArray()) {
+    QJsonObject deliverable_spec = v.toObject();
+
+    // Deliverables are rendered along with the export, so they share its range and frame rate
+    deliverable_spec.insert(QStringLiteral("range"), spec.value(QStringLiteral("range")));
+
+    if (!frame_rate.isUndefined()) {
+      QJsonObject video = deliverable_spec.value(QStringLiteral("video")).toObject();
+      video.insert(QStringLiteral("frame_rate"), frame_rate);
+      deliverable_spec.insert(QStringLiteral("video"), video);
+    }
+
+    ExportParams deliverable_params;
+    if (!GenerateParams(deliverable_spec, sequence, project->color_manager(), &deliverable_params)) {
+      return false;
+    }
+
+    deliverables.append(deliverable_params);
+  }
+
+  QString shared_cache_path;
+  ExportTask::SharedCacheRole shared_cache_role;
+  if (!GetSharedCache(spec, &shared_cache_path, &shared_cache_role)) {
+    return false;
+  }
+
+  // Opening the folder registers its codec and sharing so frames are read and written correctly
+  std::unique_ptr<DiskCacheFolder> shared_cache;
+  if (shared_cache_role != ExportTask::kSharedCacheNone) {
+    shared_cache.reset(new DiskCacheFolder(shared_cache_path));
+
+    if (!shared_cache->IsShared()) {
+      ReportError(tr("Cache folder \"%1\" must be marked as shared to split an export").arg(shared_cache_path));
+      return false;
+    }
+  }
+
+  QJsonObject start_info;
+  start_info.insert(QStringLiteral("project"), project_filename_);
+  start_info.insert(QStringLiteral("sequence"), sequence->GetLabel());
+  start_info.insert(QStringLiteral("filename"), params.filename());
+  ReportEvent(QStringLiteral("started"), start_info);
+
+  ExportTask export_task(sequence, project->color_manager(), params);
+  export_task.SetSharedCache(shared_cache_path, shared_cache_role);
+
+  foreach (const ExportParams& p, deliverables) {
+    export_task.AddDeliverable(p);
+  }
+
+  if (!RunTask(&export_task)) {
+    ReportError(tr("Export failed: %1").arg(export_task.GetError()));
+    return false;
+  }
+
+  QJsonObject finish_info;
+  finish_info.insert(QStringLiteral("filename"), params.filename());
+  ReportEvent(QStringLiteral("finished"), finish_info);
+
+  if (!machine_readable_) {
+    qInfo().noquote() << tr("Export succeeded");
+  }
+
+  return true;
+}
+
+bool CLIExportManager::LoadSpec(QJsonObject *spec)
+{
+  if (spec_filename_.isEmpty()) {
+    // Everything will come from the sequence and the command line
+    return true;
+  }
+
+  QFile spec_file(spec_filename_);
+  if (!spec_file.open(QFile::ReadOnly)) {
+    ReportError(tr("Failed to open export spec \"%1\"").arg(spec_filename_));
+    return false;
+  }
+
+  QJsonParseError error;
+  QJsonDocument doc = QJsonDocument::fromJson(spec_file.readAll(), &error);
+
+  if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+    ReportError(tr("Failed to parse export spec: %1").arg(error.errorString()));
+    return false;
+  }
+
+  *spec = doc.object();
+  return true;
+}
+
+Sequence *CLIExportManager::FindSequence(Project *project, const QString &name)
+{
+  QVector<Sequence*> sequences;
+
+  foreach (Node* n, project->nodes()) {
+    if (Sequence* s = dynamic_cast<Sequence*>(n)) {
+      if (!name.isEmpty() && s->GetLabel() == name) {
+        return s;
+      }
+
+      sequences.append(s);
+    }
+  }
+
+  if (name.isEmpty() && sequences.size() == 1) {
+    return sequences.first();
+  }
+
+  // Render nodes can't answer a prompt, so list what's available and fail instead
+  QStringList labels;
+  foreach (Sequence* s, sequences) {
+    labels.append(s->GetLabel());
+  }
+
+  if (sequences.isEmpty()) {
+    ReportError(tr("Project contains no sequences, nothing to export"));
+  } else if (name.isEmpty()) {
+    ReportError(tr("Project has multiple sequences, specify one of: %1").arg(labels.join(QStringLiteral(", "))));
+  } else {
+    ReportError(tr("Project has no sequence named \"%1\", specify one of: %2").arg(name, labels.join(QStringLiteral(", "))));
+  }
+
+  return nullptr;
+}
+
+bool CLIExportManager::GenerateParams(const QJsonObject &spec, Sequence *sequence, ColorManager *color_manager, ExportParams *params)
+{
+  QString filename = spec.value(QStringLiteral("filename")).toString();
+
+  if (filename.isEmpty()) {
+    ReportError(tr("No output filename was specified"));
+    return false;
+  }
+
+  ExportFormat::Format format;
+  QString format_name = spec.value(QStringLiteral("format")).toString(QFileInfo(filename).suffix());
+
+  if (!FindFormat(format_name, &format)) {
+    ReportError(tr("Unknown export format \"%1\"").arg(format_name));
+    return false;
+  }
+
+  params->set_encoder(Encoder::GetTypeFromFormat(format));
+  params->SetFilename(filename);
+  params->SetExportLength(sequence->GetLength());
+
+  QJsonObject video = spec.value(QStringLiteral("video")).toObject();
+  QJsonObject audio = spec.value(QStringLiteral("audio")).toObject();
+  QJsonObject subtitles = spec.value(QStringLiteral("subtitles")).toObject();
+
+  VideoParams sequence_video = sequence->GetVideoParams();
+  AudioParams sequence_audio = sequence->GetAudioParams();
+
+  rational timebase = sequence_video.time_base();
+  if (video.contains(QStringLiteral("frame_rate"))) {
+    bool ok;
+    rational frame_rate = rational::fromString(video.value(QStringLiteral("frame_rate")).toString(), &ok);
+
+    if (!ok || frame_rate.isNull()) {
+      ReportError(tr("Invalid frame rate \"%1\"").arg(video.value(QStringLiteral("frame_rate")).toString()));
+      return false;
+    }
+
+    timebase = frame_rate.flipped();
+  }
+
+  QList<ExportCodec::Codec> video_codecs = ExportFormat::GetVideoCodecs(format);
+  ExportCodec::Codec video_codec = ExportCodec::kCodecCount;
+  bool video_enabled = !video_codecs.isEmpty() && sequence_video.enabled()
+      && video.value(QStringLiteral("enabled")).toBool(true);
+
+  if (video_enabled && !FindCodec(video.value(QStringLiteral("codec")).toString(), video_codecs, &video_codec)) {
+    ReportError(tr("Format does not support video codec \"%1\"").arg(video.value(QStringLiteral("codec")).toString()));
+    return false;
+  }
+
+  bool image_sequence = video.value(QStringLiteral("image_sequence")).toBool(false);
+
+  if (spec.contains(QStringLiteral("range"))) {
+    QJsonObject range = spec.value(QStringLiteral("range")).toObject();
+    int64_t in = range.value(QStringLiteral("in")).toVariant().toLongLong();
+    int64_t out = range.value(QStringLiteral("out")).toVariant().toLongLong();
+
+    params->set_custom_range(TimeRange(Timecode::timestamp_to_time(in, timebase),
+                                       Timecode::timestamp_to_time(out, timebase)));
+  } else if (video_enabled && ExportCodec::IsCodecAStillImage(video_codec) && !image_sequence) {
+    // Exporting a still image without a range, export the first frame just like the dialog would
+    params->set_custom_range(TimeRange(0, 0));
+  }
+
+  if (video_enabled) {
+    VideoParams video_render_params(video.value(QStringLiteral("width")).toInt(sequence_video.width()),
+                                    video.value(QStringLiteral("height")).toInt(sequence_video.height()),
+                                    timebase,
+                                    sequence_video.format(),
+                                    VideoParams::kInternalChannelCount,
+                                    sequence_video.pixel_aspect_ratio(),
+                                    sequence_video.interlacing(),
+                                    1);
+
+    params->EnableVideo(video_render_params, video_codec);
+
+    params->set_video_threads(video.value(QStringLiteral("threads")).toInt(0));
+    params->set_video_segments(video.value(QStringLiteral("segments")).toInt(1));
+    params->set_video_smart_render(video.value(QStringLiteral("smart_render")).toBool(false));
+    params->set_video_is_image_sequence(image_sequence);
+
+    QString scaling = video.value(QStringLiteral("scaling")).toString();
+    if (scaling == QStringLiteral("fit")) {
+      params->set_video_scaling_method(ExportParams::kFit);
+    } else if (scaling == QStringLiteral("crop")) {
+      params->set_video_scaling_method(ExportParams::kCrop);
+    } else if (scaling.isEmpty() || scaling == QStringLiteral("stretch")) {
+      params->set_video_scaling_method(ExportParams::kStretch);
+    } else {
+      ReportError(tr("Unknown scaling method \"%1\"").arg(scaling));
+      return false;
+    }
+
+    QStringList pix_fmts = ExportFormat::GetPixelFormatsForCodec(format, video_codec);
+    QString pix_fmt = video.value(QStringLiteral("pix_fmt")).toString();
+    if (pix_fmt.isEmpty()) {
+      if (!pix_fmts.isEmpty()) {
+        pix_fmt = pix_fmts.first();
+      }
+    } else if (!pix_fmts.contains(pix_fmt)) {
+      ReportError(tr("Codec does not support pixel format \"%1\"").arg(pix_fmt));
+      return false;
+    }
+    params->set_video_pix_fmt(pix_fmt);
+
+    params->set_video_bit_rate(video.value(QStringLiteral("bit_rate")).toVariant().toLongLong());
+    params->set_video_min_bit_rate(video.value(QStringLiteral("min_bit_rate")).toVariant().toLongLong());
+    params->set_video_max_bit_rate(video.value(QStringLiteral("max_bit_rate")).toVariant().toLongLong());
+    params->set_video_buffer_size(video.value(QStringLiteral("buffer_size")).toVariant().toLongLong());
+
+    QJsonObject opts = video.value(QStringLiteral("options")).toObject();
+    for (auto it=opts.constBegin(); it!=opts.constEnd(); it++) {
+      params->set_video_option(it.key(), it.value().toVariant().toString());
+    }
+
+    params->set_color_transform(color_manager->GetCompliantColorSpace(video.value(QStringLiteral("colorspace")).toString()));
+  }
+
+  QList<ExportCodec::Codec> audio_codecs = ExportFormat::GetAudioCodecs(format);
+  if (!audio_codecs.isEmpty() && sequence_audio.enabled() && audio.value(QStringLiteral("enabled")).toBool(true)) {
+    ExportCodec::Codec audio_codec;
+
+    if (!FindCodec(audio.value(QStringLiteral("codec")).toString(), audio_codecs, &audio_codec)) {
+      ReportError(tr("Format does not support audio codec \"%1\"").arg(audio.value(QStringLiteral("codec")).toString()));
+      return false;
+    }
+
+    AudioParams audio_render_params(audio.value(QStringLiteral("sample_rate")).toInt(sequence_audio.sample_rate()),
+                                    sequence_audio.channel_layout(),
+                                    AudioParams::kInternalFormat);
+
+    params->EnableAudio(audio_render_params, audio_codec);
+    params->set_audio_bit_rate(audio.value(QStringLiteral("bit_rate")).toVariant().toLongLong());
+  }
+
+  QList<ExportCodec::Codec> subtitle_codecs = ExportFormat::GetSubtitleCodecs(format);
+  if (!subtitle_codecs.isEmpty() && subtitles.value(QStringLiteral("enabled")).toBool(false)) {
+    ExportCodec::Codec subtitle_codec;
+
+    if (!FindCodec(subtitles.value(QStringLiteral("codec")).toString(), subtitle_codecs, &subtitle_codec)) {
+      ReportError(tr("Format does not support subtitle codec \"%1\"").arg(subtitles.value(QStringLiteral("codec")).toString()));
+      return false;
+    }
+
+    params->EnableSubtitles(subtitle_codec);
+  }
+
+  if (!params->video_enabled() && !params->audio_enabled() && !params->subtitles_enabled()) {
+    ReportError(tr("Nothing to export with these settings"));
+    return false;
+  }
+
+  return true;
+}
+
+bool CLIExportManager::GetSharedCache(const QJsonObject &spec, QString *path, ExportTask::SharedCacheRole *role)
+{
+  QJsonObject shared = spec.value(QStringLiteral("shared_cache")).toObject();
+
+  *path = shared_cache_path_.isEmpty() ? shared.value(QStringLiteral("path")).toString() : shared_cache_path_;
+  QString role_name = shared_cache_role_.isEmpty() ? shared.value(QStringLiteral("role")).toString() : shared_cache_role_;
+
+  if (path->isEmpty()) {
+    *role = ExportTask::kSharedCacheNone;
+
+    if (!role_name.isEmpty()) {
+      ReportError(tr("A shared cache role was set without a shared cache folder"));
+      return false;
+    }
+
+    return true;
+  }
+
+  if (role_name == QStringLiteral("worker")) {
+    *role = ExportTask::kSharedCacheWorker;
+  } else if (role_name == QStringLiteral("assembler")) {
+    *role = ExportTask::kSharedCacheAssembler;
+  } else {
+    ReportError(tr("Unknown shared cache role \"%1\", expected \"worker\" or \"assembler\"").arg(role_name));
+    return false;
+  }
+
+  return true;
+}
+
+bool CLIExportManager::RunTask(Task *task)
+{
+  current_task_ = task->GetTitle();
+  last_progress_ = -1;
+
+  // Tasks report progress from whichever thread they're working on, and we're blocked in Run()
+  // until they finish, so this can't rely on our own event loop
+  connect(task, &Task::ProgressChanged, this, &CLIExportManager::TaskProgressChanged, Qt::DirectConnection);
+
+  if (!machine_readable_) {
+    progress_bar_ = new CLIProgressDialog(current_task_, this);
+  }
+
+  bool ret = task->Start();
+
+  disconnect(task, &Task::ProgressChanged, this, &CLIExportManager::TaskProgressChanged);
+
+  QMutexLocker locker(&output_lock_);
+  delete progress_bar_;
+  progress_bar_ = nullptr;
+
+  return ret;
+}
+
+void CLIExportManager::TaskProgressChanged(double p)
+{
+  QMutexLocker locker(&output_lock_);
+
+  if (progress_bar_) {
+    progress_bar_->SetProgress(p);
+    return;
+  }
+
+  // Don't flood whatever is parsing us, a tenth of a percent is plenty
+  if (qAbs(p - last_progress_) < 0.001 && p < 1.0) {
+    return;
+  }
+
+  last_progress_ = p;
+
+  locker.unlock();
+
+  QJsonObject data;
+  data.insert(QStringLiteral("task"), current_task_);
+  data.insert(QStringLiteral("progress"), p);
+  ReportEvent(QStringLiteral("progress"), data);
+}
+
+void CLIExportManager::ReportEvent(const QString &event, QJsonObject data)
+{
+  if (!machine_readable_) {
+    return;
+  }
+
+  data.insert(QStringLiteral("event"), event);
+
+  QMutexLocker locker(&output_lock_);
+  std::cout << QJsonDocument(data).toJson(QJsonDocument::Compact).constData() << std::endl << std::flush;
+}
+
+void CLIExportManager::ReportError(const QString &message)
+{
+  if (machine_readable_) {
+    QJsonObject data;
+    data.insert(QStringLiteral("message"), message);
+    ReportEvent(QStringLiteral("error"), data);
+  } else {
+    qCritical().noquote() << message;
+  }
+}
+
+QString CLIExportManager::SimplifyName(const QString &s)
 {
+  // Lets "h264", "H.264" and "h-264" all refer to the same codec
+  QString simple;
+
+  foreach (const QChar& c, s) {
+    if (c.isLetterOrNumber()) {
+      simple.append(c.toLower());
+    }
+  }
+
+  return simple;
+}
+
+bool CLIExportManager::FindFormat(const QString &name, ExportFormat::Format *format)
+{
+  QString simple = SimplifyName(name);
+
+  // Check names first since some formats share an extension (e.g. QuickTime and DNxHD)
+  for (int i=0; i<ExportFormat::kFormatCount; i++) {
+    ExportFormat::Format f = static_cast<ExportFormat::Format>(i);
+
+    if (SimplifyName(ExportFormat::GetName(f)) == simple) {
+      *format = f;
+      return true;
+    }
+  }
+
+  for (int i=0; i<ExportFormat::kFormatCount; i++) {
+    ExportFormat::Format f = static_cast<ExportFormat::Format>(i);
+
+    if (SimplifyName(ExportFormat::GetExtension(f)) == simple) {
+      *format = f;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool CLIExportManager::FindCodec(const QString &name, const QList<ExportCodec::Codec> &codecs, ExportCodec::Codec *codec)
+{
+  if (codecs.isEmpty()) {
+    return false;
+  }
+
+  if (name.isEmpty()) {
+    // Use the format's default codec
+    *codec = codecs.first();
+    return true;
+  }
+
+  QString simple = SimplifyName(name);
+
+  foreach (ExportCodec::Codec c, codecs) {
+    if (SimplifyName(ExportCodec::GetCodecName(c)) == simple) {
+      *codec = c;
+      return true;
+    }
+  }
 
+  return false;
 }
 
 }
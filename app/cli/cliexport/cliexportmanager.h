@@ -21,14 +21,143 @@
 #ifndef CLIEXPORTMANAGER_H
 #define CLIEXPORTMANAGER_H
 
+#include <QJsonObject>
+#include <QMutex>
+
+#include "cli/cliprogress/cliprogressdialog.h"
+#include "node/project/project.h"
+#include "node/project/sequence/sequence.h"
 #include "task/export/export.h"
 
 namespace olive {
 
+/**
+ * @brief Loads a project and exports one of its sequences without any GUI
+ *
+ * The export is described by a JSON spec, any member of which may be omitted to use the
+ * sequence's own settings:
+ *
+ *     {
+ *       "sequence": "Sequence 1",
+ *       "filename": "/renders/shot010.mp4",
+ *       "format": "mp4",
+ *       "range": {"in": 0, "out": 240},
+ *       "video": {"codec": "h264", "width": 1920, "height": 1080, "frame_rate": "24000/1001",
+ *                 "pix_fmt": "yuv420p", "threads": 0, "segments": 1, "bit_rate": 0,
+ *                 "scaling": "fit", "colorspace": "sRGB OETF", "image_sequence": false,
+ *                 "smart_render": false, "options": {"crf": "18"}},
+ *       "audio": {"codec": "aac", "sample_rate": 48000, "bit_rate": 320000},
+ *       "subtitles": {"enabled": false},
+ *       "shared_cache": {"path": "/mnt/farm/cache", "role": "worker"},
+ *       "deliverables": [{"filename": "/renders/shot010_proxy.mov", "format": "mov",
+ *                         "video": {"codec": "prores", "width": 960, "height": 540}}]
+ *     }
+ *
+ * "format" may be a format name or extension and defaults to the filename's extension. Ranges are
+ * in frames of the export frame rate. Setting "enabled" to false in "video" or "audio" disables
+ * that stream. The sequence, filename and spec can all be set from the command line, so a render
+ * node can be handed one shared spec and a per-job sequence and output.
+ *
+ * Each of "deliverables" is another output described the same way, encoded from the same render
+ * as the main one (see ExportTask::AddDeliverable()). They always use the main output's range and
+ * frame rate.
+ *
+ * With "shared_cache" set, any number of "worker" processes split the video between them through
+ * the folder and one "assembler" encodes the result (see ExportTask::SharedCacheRole). The folder
+ * must be marked as shared.
+ *
+ * With machine-readable progress enabled, one JSON object per line is written to stdout instead of
+ * a progress bar, e.g. `{"event":"progress","task":"Export","progress":0.5}`, finishing with
+ * either `{"event":"finished","filename":...}` or `{"event":"error","message":...}`.
+ */
 class CLIExportManager : public QObject
 {
+  Q_OBJECT
 public:
-  CLIExportManager();
+  CLIExportManager(const QString& project_filename, QObject* parent = nullptr);
+
+  void SetSpecFilename(const QString& s)
+  {
+    spec_filename_ = s;
+  }
+
+  void SetSequenceName(const QString& s)
+  {
+    sequence_name_ = s;
+  }
+
+  void SetOutputFilename(const QString& s)
+  {
+    output_filename_ = s;
+  }
+
+  /**
+   * @brief Override the spec's shared cache settings, empty strings keep the spec's
+   */
+  void SetSharedCache(const QString& path, const QString& role)
+  {
+    shared_cache_path_ = path;
+    shared_cache_role_ = role;
+  }
+
+  void SetMachineReadableProgress(bool e)
+  {
+    machine_readable_ = e;
+  }
+
+  /**
+   * @brief Loads the project and runs the export, blocking until it finishes
+   *
+   * @return True if the export succeeded
+   */
+  bool Run();
+
+private:
+  bool LoadSpec(QJsonObject* spec);
+
+  Sequence* FindSequence(Project* project, const QString& name);
+
+  bool GenerateParams(const QJsonObject& spec, Sequence* sequence, ColorManager* color_manager, ExportParams* params);
+
+  bool GetSharedCache(const QJsonObject& spec, QString* path, ExportTask::SharedCacheRole* role);
+
+  bool RunTask(Task* task);
+
+  void ReportEvent(const QString& event, QJsonObject data = QJsonObject());
+
+  void ReportError(const QString& message);
+
+  static QString SimplifyName(const QString& s);
+
+  static bool FindFormat(const QString& name, ExportFormat::Format* format);
+
+  static bool FindCodec(const QString& name, const QList<ExportCodec::Codec>& codecs, ExportCodec::Codec* codec);
+
+  QString project_filename_;
+
+  QString spec_filename_;
+
+  QString sequence_name_;
+
+  QString output_filename_;
+
+  QString shared_cache_path_;
+
+  QString shared_cache_role_;
+
+  bool machine_readable_;
+
+  QMutex output_lock_;
+
+  CLIProgressDialog* progress_bar_;
+
+  QString current_task_;
+
+  double last_progress_;
+
+private slots:
+  void TaskProgressChanged(double p);
+
 };
 
 }
@@ -6,9 +6,12 @@
 
 namespace olive {
 
+const rational ConformManager::kChunkLength = rational(30);
+const int ConformManager::kMaximumChunkTasks = 2;
+
 ConformManager *ConformManager::instance_ = nullptr;
 
-ConformManager::Conform ConformManager::GetConformState(const QString &decoder_id, const QString &cache_path, const Decoder::CodecStream &stream, const AudioParams &params, bool wait)
+ConformManager::Conform ConformManager::GetConformState(const QString &decoder_id, const QString &cache_path, const Decoder::CodecStream &stream, const AudioParams &params, bool wait, const QVector<int> &sibling_streams)
 {
   // Mutex because we'll need to check the status of a conform task
   QMutexLocker locker(&mutex_);
@@ -22,7 +25,7 @@ ConformManager::Conform ConformManager::GetConformState(const QString &decoder_i
   ConformTask *conforming_task = nullptr;
 
   foreach (const ConformData &data, conforming_) {
-    if (data.stream == stream && data.params == params) {
+    if (data.chunk < 0 && data.stream == stream && data.params == params) {
       // Already creating conform in a task
       conforming_task = data.task;
       break;
@@ -37,12 +40,35 @@ ConformManager::Conform ConformManager::GetConformState(const QString &decoder_i
     QString working_fn = filename;
     working_fn.append(QStringLiteral(".working"));
 
-    conforming_task = new ConformTask(decoder_id, stream, params, working_fn);
+    QVector<Decoder::ConformOutput> outputs = {{stream.stream(), working_fn}};
+    QVector<ConformData> data = {{stream, params, nullptr, working_fn, filename, -1}};
+
+    // Conform any other streams in this file that will need it at the same time, demuxing a file
+    // once for all of them is much cheaper than once per stream
+    foreach (int sibling, sibling_streams) {
+      Decoder::CodecStream sibling_stream(stream.filename(), sibling);
+      QString sibling_fn = GetConformedFilename(cache_path, sibling_stream, params);
+
+      if (QFileInfo::exists(sibling_fn) || IsConforming(sibling_stream, params)) {
+        continue;
+      }
+
+      QString sibling_working_fn = sibling_fn;
+      sibling_working_fn.append(QStringLiteral(".working"));
+
+      outputs.append({sibling, sibling_working_fn});
+      data.append({sibling_stream, params, nullptr, sibling_working_fn, sibling_fn, -1});
+    }
+
+    conforming_task = new ConformTask(decoder_id, stream, params, outputs);
     connect(conforming_task, &ConformTask::Finished, this, &ConformManager::ConformTaskFinished);
     conforming_task->moveToThread(TaskManager::instance()->thread());
     QMetaObject::invokeMethod(TaskManager::instance(), "AddTask", Qt::QueuedConnection, Q_ARG(Task *, conforming_task));
 
-    conforming_.append({stream, params, conforming_task, working_fn, filename});
+    for (ConformData &d : data) {
+      d.task = conforming_task;
+      conforming_.append(d);
+    }
   }
 
   if (wait) {
@@ -55,6 +81,59 @@ ConformManager::Conform ConformManager::GetConformState(const QString &decoder_i
   return {kConformGenerating, QString(), conforming_task};
 }
 
+QString ConformManager::GetConformChunk(const QString &decoder_id, const QString &cache_path, const Decoder::CodecStream &stream, const AudioParams &params, int64_t index)
+{
+  QMutexLocker locker(&mutex_);
+
+  QString filename = GetChunkFilename(GetConformedFilename(cache_path, stream, params), index);
+  if (QFileInfo::exists(filename)) {
+    return filename;
+  }
+
+  int chunk_tasks = 0;
+
+  foreach (const ConformData &data, conforming_) {
+    if (data.chunk >= 0) {
+      if (data.chunk == index && data.stream == stream && data.params == params) {
+        // Already conforming this chunk
+        return QString();
+      }
+
+      chunk_tasks++;
+    }
+  }
+
+  if (chunk_tasks >= kMaximumChunkTasks) {
+    // The cacher asks again for everything still waiting whenever a conform finishes
+    return QString();
+  }
+
+  QString working_fn = filename;
+  working_fn.append(QStringLiteral(".working"));
+
+  rational start = kChunkLength * rational(index);
+
+  ConformTask *task = new ConformTask(decoder_id, stream, params, {{stream.stream(), working_fn}}, TimeRange(start, start + kChunkLength));
+  connect(task, &ConformTask::Finished, this, &ConformManager::ConformTaskFinished);
+  task->moveToThread(TaskManager::instance()->thread());
+  QMetaObject::invokeMethod(TaskManager::instance(), "AddTask", Qt::QueuedConnection, Q_ARG(Task *, task));
+
+  conforming_.append({stream, params, task, working_fn, filename, index});
+
+  return QString();
+}
+
+QString ConformManager::GetExistingConform(const QString &cache_path, const Decoder::CodecStream &stream, const AudioParams &params)
+{
+  QString filename = GetConformedFilename(cache_path, stream, params);
+
+  if (QFileInfo::exists(filename)) {
+    return filename;
+  }
+
+  return QString();
+}
+
 QString ConformManager::GetConformedFilename(const QString &cache_path, const Decoder::CodecStream &stream, const AudioParams &params)
 {
   QString index_fn = QStringLiteral("%1.%2:%3").arg(FileFunctions::GetUniqueFileIdentifier(stream.filename()),
@@ -69,6 +148,9 @@ QString ConformManager::GetConformedFilename(const QString &cache_path, const De
   index_fn.append('.');
   index_fn.append(QString::number(params.channel_layout()));
 
+  // Conforms are stored as planar float, distinguish them from the interleaved WAV files older versions wrote
+  index_fn.append(QStringLiteral(".planar"));
+
   return index_fn;
 }
 
@@ -76,30 +158,65 @@ void ConformManager::ConformTaskFinished(Task *task, bool succeeded)
 {
   QMutexLocker locker(&mutex_);
 
-  ConformData data;
+  // Remove conform data from list, a task may have been conforming several streams
+  QVector<ConformData> finished;
 
-  // Remove conform data from list
   for (int i=0; i<conforming_.size(); i++) {
-    const ConformData &c = conforming_.at(i);
-    if (c.task == task) {
-      data = c;
-      conforming_.removeAt(i);
-      break;
+    if (conforming_.at(i).task == task) {
+      finished.append(conforming_.takeAt(i));
+      i--;
     }
   }
 
-  if (succeeded) {
-    // Move file to standard conform name, making it clear this conform is ready for use
-    QFile::remove(data.finished_filename);
-    QFile::rename(data.working_filename, data.finished_filename);
+  foreach (const ConformData &data, finished) {
+    if (data.chunk >= 0) {
+      QString full_filename = data.finished_filename.left(data.finished_filename.lastIndexOf(QStringLiteral(".chunk")));
+
+      if (succeeded && !QFileInfo::exists(full_filename)) {
+        QFile::rename(data.working_filename, data.finished_filename);
+      } else {
+        // Failed, or the full conform finished first and this chunk isn't needed anymore
+        QFile::remove(data.working_filename);
+      }
+    } else if (succeeded) {
+      // Move file to standard conform name, making it clear this conform is ready for use
+      QFile::remove(data.finished_filename);
+      QFile::remove(GetWaveformFilename(data.finished_filename));
+      QFile::rename(GetWaveformFilename(data.working_filename), GetWaveformFilename(data.finished_filename));
+      QFile::remove(GetAnalysisFilename(data.finished_filename));
+      QFile::rename(GetAnalysisFilename(data.working_filename), GetAnalysisFilename(data.finished_filename));
+      QFile::rename(data.working_filename, data.finished_filename);
+
+      // Chunks conformed while this was running aren't needed anymore
+      QFileInfo finished_info(data.finished_filename);
+      QDir cache_dir = finished_info.dir();
+      foreach (const QString &chunk, cache_dir.entryList({finished_info.fileName() + QStringLiteral(".chunk*")}, QDir::Files)) {
+        cache_dir.remove(chunk);
+      }
+    } else {
+      // Failed, just delete the working filename if exists
+      QFile::remove(data.working_filename);
+      QFile::remove(GetWaveformFilename(data.working_filename));
+      QFile::remove(GetAnalysisFilename(data.working_filename));
+    }
+  }
 
+  if (succeeded) {
     conform_done_condition_.wakeAll();
     locker.unlock();
     emit ConformReady();
-  } else {
-    // Failed, just delete the working filename if exists
-    QFile::remove(data.working_filename);
   }
 }
 
+bool ConformManager::IsConforming(const Decoder::CodecStream &stream, const AudioParams &params) const
+{
+  foreach (const ConformData &data, conforming_) {
+    if (data.chunk < 0 && data.stream == stream && data.params == params) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 }
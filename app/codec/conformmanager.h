@@ -45,9 +45,54 @@ public:
   /**
    * @brief Get conform state, and start conforming if no conform exists
    *
+   * If a conform has to be started, any of `sibling_streams` (other streams in the same file) that
+   * aren't conformed or conforming yet are conformed by the same task, sharing one demux pass.
+   *
+   * Thread-safe.
+   */
+  Conform GetConformState(const QString &decoder_id, const QString &cache_path, const Decoder::CodecStream &stream, const AudioParams &params, bool wait, const QVector<int> &sibling_streams = QVector<int>());
+
+  /**
+   * @brief Length of the pieces of a stream that are conformed ahead of the whole thing
+   */
+  static const rational kChunkLength;
+
+  /**
+   * @brief Get a piece of a stream that's conformed ahead of the full conform so it can play sooner
+   *
+   * Chunk `index` covers kChunkLength of audio from `index * kChunkLength`. Returns the chunk's
+   * filename if it's ready. Otherwise starts conforming it if there's room to, and returns an
+   * empty string. ConformReady() is emitted when it finishes.
+   *
    * Thread-safe.
    */
-  Conform GetConformState(const QString &decoder_id, const QString &cache_path, const Decoder::CodecStream &stream, const AudioParams &params, bool wait);
+  QString GetConformChunk(const QString &decoder_id, const QString &cache_path, const Decoder::CodecStream &stream, const AudioParams &params, int64_t index);
+
+  /**
+   * @brief Get the filename of the visual waveform stored alongside a conformed audio file
+   */
+  static QString GetWaveformFilename(const QString &conform_filename)
+  {
+    return conform_filename + QStringLiteral(".waveform");
+  }
+
+  /**
+   * @brief Get the filename of the loudness and spectrum analysis stored alongside a conformed audio file
+   *
+   * \see AudioAnalysis
+   */
+  static QString GetAnalysisFilename(const QString &conform_filename)
+  {
+    return conform_filename + QStringLiteral(".analysis");
+  }
+
+  /**
+   * @brief Get the filename of a finished conform, or an empty string if there isn't one yet
+   *
+   * Unlike GetConformState(), this never starts conforming, for callers that would rather go
+   * without than wait.
+   */
+  static QString GetExistingConform(const QString &cache_path, const Decoder::CodecStream &stream, const AudioParams &params);
 
 signals:
   void ConformReady();
@@ -67,8 +112,19 @@ private:
     ConformTask *task;
     QString working_filename;
     QString finished_filename;
+
+    // Chunk index if this is conforming a chunk rather than the whole stream, otherwise -1
+    int64_t chunk;
   };
 
+  /**
+   * @brief Maximum number of chunks conforming at once
+   *
+   * Chunks are requested for everything waiting on a conform, this keeps the first ones requested
+   * (closest to the playhead) from competing with the rest.
+   */
+  static const int kMaximumChunkTasks;
+
   QVector<ConformData> conforming_;
 
   /**
@@ -76,6 +132,16 @@ private:
    */
   static QString GetConformedFilename(const QString &cache_path, const Decoder::CodecStream &stream, const AudioParams &params);
 
+  static QString GetChunkFilename(const QString &conform_filename, int64_t index)
+  {
+    return conform_filename + QStringLiteral(".chunk") + QString::number(index);
+  }
+
+  /**
+   * @brief Whether a task is already conforming this stream to these parameters, mutex must be held
+   */
+  bool IsConforming(const Decoder::CodecStream &stream, const AudioParams &params) const;
+
 private slots:
   void ConformTaskFinished(Task *task, bool succeeded);
 
@@ -20,16 +20,20 @@
 
 #include "decoder.h"
 
+#include <algorithm>
+#include <cmath>
 #include <QCoreApplication>
 #include <QDebug>
+#include <QFile>
+#include <QFileInfo>
 
 #include "codec/ffmpeg/ffmpegdecoder.h"
 #include "codec/oiio/oiiodecoder.h"
-#include "codec/waveinput.h"
-#include "codec/waveoutput.h"
+#include "codec/planaraudiofile.h"
 #include "common/ffmpegutils.h"
 #include "common/filefunctions.h"
 #include "common/timecodefunctions.h"
+#include "common/tracing.h"
 #include "conformmanager.h"
 #include "node/project/project.h"
 #include "task/taskmanager.h"
@@ -89,6 +93,8 @@ bool Decoder::Open(const CodecStream &stream)
 
 FramePtr Decoder::RetrieveVideo(const rational &timecode, const RetrieveVideoParams &divider)
 {
+  TRACE_SCOPE("decode", "Decoder::RetrieveVideo");
+
   QMutexLocker locker(&mutex_);
 
   UpdateLastAccessed();
@@ -108,6 +114,8 @@ FramePtr Decoder::RetrieveVideo(const rational &timecode, const RetrieveVideoPar
 
 Decoder::RetrieveAudioData Decoder::RetrieveAudio(const TimeRange &range, const AudioParams &params, const QString& cache_path, Footage::LoopMode loop_mode, RenderMode::Mode mode)
 {
+  TRACE_SCOPE("decode", "Decoder::RetrieveAudio");
+
   QMutexLocker locker(&mutex_);
 
   UpdateLastAccessed();
@@ -123,15 +131,24 @@ Decoder::RetrieveAudioData Decoder::RetrieveAudio(const TimeRange &range, const
   }
 
   // Get conform state from ConformManager
-  ConformManager::Conform conform = ConformManager::instance()->GetConformState(id(), cache_path, stream_, params, (mode == RenderMode::kOnline));
+  ConformManager::Conform conform = ConformManager::instance()->GetConformState(id(), cache_path, stream_, params, (mode == RenderMode::kOnline), GetConformSiblingStreams());
   if (conform.state == ConformManager::kConformGenerating) {
+    // Chunks are conformed ahead of the whole file so the part being played doesn't have to wait
+    // for it, though looping needs the full length to wrap around
+    if (loop_mode != Footage::kLoopModeLoop) {
+      SampleBufferPtr chunked = RetrieveAudioFromConformChunks(cache_path, range, params);
+      if (chunked) {
+        return {kOK, chunked, nullptr};
+      }
+    }
+
     return {kWaitingForConform, nullptr, conform.task};
   }
 
   // See if we got the conform
   SampleBufferPtr out_buffer = RetrieveAudioFromConform(conform.filename, range, loop_mode);
 
-  return {kOK, out_buffer, nullptr};
+  return {kOK, out_buffer, nullptr, ConformManager::GetWaveformFilename(conform.filename)};
 }
 
 qint64 Decoder::GetLastAccessedTime()
@@ -154,9 +171,9 @@ void Decoder::Close()
   }
 }
 
-bool Decoder::ConformAudio(const QString &output_filename, const AudioParams &params, const QAtomicInt *cancelled)
+bool Decoder::ConformAudio(const QVector<ConformOutput> &outputs, const AudioParams &params, const QAtomicInt *cancelled, const TimeRange &range)
 {
-  return ConformAudioInternal(output_filename, params, cancelled);
+  return ConformAudioInternal(outputs, params, range, cancelled);
 }
 
 /*
@@ -175,6 +192,63 @@ QVector<DecoderPtr> Decoder::ReceiveListOfAllDecoders()
   return decoders;
 }
 
+bool Decoder::IsLikelyMediaContainer(const QString &filename, bool read_magic)
+{
+  QFile f(filename);
+
+  if (read_magic && f.open(QFile::ReadOnly)) {
+    QByteArray magic = f.read(12);
+
+    if (magic.size() >= 4) {
+      // ISO media brands that are still images (HEIF/AVIF)
+      QByteArray brand = magic.mid(8, 4);
+      bool image_brand = (brand == "heic" || brand == "heix" || brand == "mif1" || brand == "avif");
+
+      if ((magic.mid(4, 4) == "ftyp" && !image_brand)                 // MP4/MOV/M4A
+          || (magic.startsWith("RIFF") && magic.mid(8, 4) != "WEBP")  // WAV/AVI
+          || magic.startsWith("\x1A\x45\xDF\xA3")                     // Matroska/WebM
+          || magic.startsWith("OggS")
+          || magic.startsWith("fLaC")
+          || magic.startsWith("ID3")                                  // MP3
+          || magic.startsWith("FORM")                                 // AIFF
+          || magic.startsWith("\x06\x0E\x2B\x34")                     // MXF
+          || magic.startsWith(QByteArray("\x00\x00\x01\xBA", 4))      // MPEG-PS
+          || (magic.at(0) == 0x47 && f.size() % 188 == 0)) {          // MPEG-TS
+        return true;
+      }
+
+      if (magic.startsWith("\x89PNG") || magic.startsWith("\xFF\xD8\xFF")) {
+        // Common image formats, no need to check the extension
+        return false;
+      }
+    }
+  }
+
+  static const QStringList kMediaExtensions = {
+    QStringLiteral("mp4"), QStringLiteral("mov"), QStringLiteral("m4v"), QStringLiteral("mkv"),
+    QStringLiteral("webm"), QStringLiteral("avi"), QStringLiteral("mxf"), QStringLiteral("mts"),
+    QStringLiteral("m2ts"), QStringLiteral("ts"), QStringLiteral("mpg"), QStringLiteral("mpeg"),
+    QStringLiteral("wmv"), QStringLiteral("flv"), QStringLiteral("wav"), QStringLiteral("mp3"),
+    QStringLiteral("aac"), QStringLiteral("m4a"), QStringLiteral("flac"), QStringLiteral("ogg"),
+    QStringLiteral("opus"), QStringLiteral("aif"), QStringLiteral("aiff")
+  };
+
+  return kMediaExtensions.contains(QFileInfo(filename).suffix(), Qt::CaseInsensitive);
+}
+
+QVector<DecoderPtr> Decoder::ReceiveListOfAllDecoders(const QString &filename)
+{
+  QVector<DecoderPtr> decoders = ReceiveListOfAllDecoders();
+
+  if (IsLikelyMediaContainer(filename)) {
+    std::stable_partition(decoders.begin(), decoders.end(), [](DecoderPtr d){
+      return d->id() == QStringLiteral("ffmpeg");
+    });
+  }
+
+  return decoders;
+}
+
 DecoderPtr Decoder::CreateFromID(const QString &id)
 {
   if (id.isEmpty()) {
@@ -257,34 +331,42 @@ FramePtr Decoder::RetrieveVideoInternal(const rational &timecode, const Retrieve
   return nullptr;
 }
 
-bool Decoder::ConformAudioInternal(const QString& filename, const AudioParams &params, const QAtomicInt* cancelled)
+bool Decoder::ConformAudioInternal(const QVector<ConformOutput>& outputs, const AudioParams &params, const TimeRange &range, const QAtomicInt* cancelled)
 {
-  Q_UNUSED(filename)
+  Q_UNUSED(outputs)
   Q_UNUSED(cancelled)
   Q_UNUSED(params)
+  Q_UNUSED(range)
   return false;
 }
 
+QVector<int> Decoder::GetConformSiblingStreams()
+{
+  return QVector<int>();
+}
+
 SampleBufferPtr Decoder::RetrieveAudioFromConform(const QString &conform_filename, const TimeRange& range, Footage::LoopMode loop_mode)
 {
-  WaveInput input(conform_filename);
+  PlanarAudioInput input(conform_filename);
 
   if (input.open()) {
     const AudioParams& input_params = input.params();
 
-    QByteArray packed_data(input_params.time_to_bytes(range.length()), Qt::Uninitialized);
+    SampleBufferPtr sample_buffer = SampleBuffer::CreateAllocated(input_params, range.length());
 
-    qint64 read_index = input_params.time_to_bytes(range.in());
+    // Conforms are mapped and planar, so each run of samples is a straight copy from the file
+    qint64 read_index = input_params.time_to_samples(range.in());
     qint64 write_index = 0;
+    qint64 input_length = input.sample_count();
 
-    while (write_index < packed_data.size()) {
-      if (loop_mode == Footage::kLoopModeLoop) {
-        while (read_index >= input.data_length()) {
-          read_index -= input.data_length();
+    while (write_index < sample_buffer->sample_count()) {
+      if (loop_mode == Footage::kLoopModeLoop && input_length > 0) {
+        while (read_index >= input_length) {
+          read_index -= input_length;
         }
 
         while (read_index < 0) {
-          read_index += input.data_length();
+          read_index += input_length;
         }
       }
 
@@ -292,15 +374,18 @@ SampleBufferPtr Decoder::RetrieveAudioFromConform(const QString &conform_filenam
 
       if (read_index < 0) {
         // Reading before 0, write silence here until audio data would actually start
-        write_count = qMin(-read_index, qint64(packed_data.size()));
-        memset(packed_data.data() + write_index, 0, write_count);
-      } else if (read_index >= input.data_length()) {
+        write_count = qMin(-read_index, sample_buffer->sample_count() - write_index);
+        sample_buffer->fill(0, write_index, write_index + write_count);
+      } else if (read_index >= input_length) {
         // Reading after data length, write silence until the end of the buffer
-        write_count = packed_data.size() - write_index;
-        memset(packed_data.data() + write_index, 0, write_count);
+        write_count = sample_buffer->sample_count() - write_index;
+        sample_buffer->fill(0, write_index, write_index + write_count);
       } else {
-        write_count = qMin(input.data_length() - read_index, packed_data.size() - write_index);
-        input.read(read_index, packed_data.data() + write_index, write_count);
+        write_count = qMin(input_length - read_index, sample_buffer->sample_count() - write_index);
+
+        for (int i=0; i<input_params.channel_count(); i++) {
+          sample_buffer->set(i, input.data(i) + read_index, write_index, write_count);
+        }
       }
 
       read_index += write_count;
@@ -309,15 +394,68 @@ SampleBufferPtr Decoder::RetrieveAudioFromConform(const QString &conform_filenam
 
     input.close();
 
-    // Create sample buffer
-    SampleBufferPtr sample_buffer = SampleBuffer::CreateFromPackedData(input_params, packed_data);
-
     return sample_buffer;
   }
 
   return nullptr;
 }
 
+SampleBufferPtr Decoder::RetrieveAudioFromConformChunks(const QString &cache_path, const TimeRange &range, const AudioParams &params)
+{
+  const rational &chunk_length = ConformManager::kChunkLength;
+
+  // Audio before the start of the file is silence that the first chunk will fill in
+  int64_t first = qMax<int64_t>(0, std::floor((range.in() / chunk_length).toDouble()));
+  int64_t last = qMax(first, int64_t(std::ceil((range.out() / chunk_length).toDouble())) - 1);
+
+  // Request every chunk before reading any so they're all queued at once
+  QStringList chunks;
+  bool ready = true;
+
+  for (int64_t i=first; i<=last; i++) {
+    QString fn = ConformManager::instance()->GetConformChunk(id(), cache_path, stream_, params, i);
+    if (fn.isEmpty()) {
+      ready = false;
+    }
+    chunks.append(fn);
+  }
+
+  if (!ready) {
+    return nullptr;
+  }
+
+  SampleBufferPtr out;
+  int write_index = 0;
+
+  for (int64_t i=first; i<=last; i++) {
+    rational chunk_start = chunk_length * rational(i);
+    rational in = (i == first) ? range.in() : chunk_start;
+    rational out_time = (i == last) ? range.out() : chunk_start + chunk_length;
+
+    SampleBufferPtr part = RetrieveAudioFromConform(chunks.at(int(i - first)), TimeRange(in - chunk_start, out_time - chunk_start), Footage::kLoopModeOff);
+    if (!part) {
+      return nullptr;
+    }
+
+    if (!out) {
+      out = SampleBuffer::CreateAllocated(part->audio_params(), range.length());
+    }
+
+    int count = qMin(part->sample_count(), out->sample_count() - write_index);
+    for (int j=0; j<out->audio_params().channel_count(); j++) {
+      out->set(j, part->data(j), write_index, count);
+    }
+    write_index += count;
+  }
+
+  if (out && write_index < out->sample_count()) {
+    // Rounding between chunks may leave a sample or so at the end
+    out->fill(0, write_index, out->sample_count());
+  }
+
+  return out;
+}
+
 void Decoder::UpdateLastAccessed()
 {
   last_accessed_ = QDateTime::currentMSecsSinceEpoch();
@@ -153,12 +153,28 @@ public:
       divider = 1;
       src_interlacing = VideoParams::kInterlaceNone;
       dst_interlacing = VideoParams::kInterlaceNone;
+      keyframes_only = false;
+      planar_yuv = false;
     }
 
     int divider;
     VideoParams::Interlacing src_interlacing;
     VideoParams::Interlacing dst_interlacing;
 
+    // Name of the hardware device to decode with, or empty for software decoding. Decoders that
+    // don't support hardware decoding are free to ignore this.
+    QString hw_device;
+
+    // Return the nearest keyframe at or before the requested time rather than the exact frame,
+    // for fast scrubbing through long-GOP footage. Decoders without keyframes ignore this. It
+    // doesn't change how frames are converted, so it isn't compared below.
+    bool keyframes_only;
+
+    // Allow returning frames in planar YUV (see Frame::planar_yuv()) rather than RGB(A) when the
+    // footage is already in a layout the renderer can convert on the GPU. Decoders that always
+    // produce RGB(A) ignore this.
+    bool planar_yuv;
+
     void reset()
     {
       *this = RetrieveVideoParams();
@@ -166,7 +182,8 @@ public:
 
     bool operator==(const RetrieveVideoParams& rhs) const
     {
-      return divider == rhs.divider && src_interlacing == rhs.src_interlacing && dst_interlacing == rhs.dst_interlacing;
+      return divider == rhs.divider && src_interlacing == rhs.src_interlacing && dst_interlacing == rhs.dst_interlacing
+          && hw_device == rhs.hw_device && planar_yuv == rhs.planar_yuv;
     }
 
     bool operator!=(const RetrieveVideoParams& rhs) const
@@ -187,6 +204,21 @@ public:
    */
   FramePtr RetrieveVideo(const rational& timecode, const RetrieveVideoParams& divider);
 
+  /**
+   * @brief Start reading files that are likely to be requested soon in the background
+   *
+   * Used for image sequences, where every frame is its own file and per-file latency (e.g. on
+   * network storage) would otherwise stall playback. Prefetched files are picked up by later
+   * decoders opening them. The default implementation does nothing.
+   *
+   * This function is thread safe and doesn't require the decoder to be open.
+   */
+  virtual void PrefetchFiles(const QStringList& filenames, const RetrieveVideoParams& divider)
+  {
+    Q_UNUSED(filenames)
+    Q_UNUSED(divider)
+  }
+
   enum RetrieveAudioStatus {
     kInvalid = -1,
     kOK,
@@ -197,6 +229,9 @@ public:
     RetrieveAudioStatus status;
     SampleBufferPtr samples;
     Task *task;
+
+    // Visual waveform stored alongside the conform these samples came from, may not exist
+    QString waveform_filename;
   };
 
   /**
@@ -234,10 +269,22 @@ public:
    */
   void Close();
 
+  struct ConformOutput {
+    int stream;
+    QString filename;
+  };
+
   /**
-   * @brief Conform audio stream
+   * @brief Conform audio streams of the open file
+   *
+   * The first output is always the stream this decoder was opened with. Any others come from
+   * GetConformSiblingStreams() and are conformed in the same pass so the container only has to be
+   * demuxed once.
+   *
+   * If `range` has a length, only that part of the streams is conformed, so it can be played
+   * before the rest of the file has been read.
    */
-  bool ConformAudio(const QString &output_filename, const AudioParams &params, const QAtomicInt *cancelled = nullptr);
+  bool ConformAudio(const QVector<ConformOutput> &outputs, const AudioParams &params, const QAtomicInt *cancelled = nullptr, const TimeRange &range = TimeRange());
 
   /**
    * @brief Create a Decoder instance using a Decoder ID
@@ -256,6 +303,23 @@ public:
 
   static QVector<DecoderPtr> ReceiveListOfAllDecoders();
 
+  /**
+   * @brief Same as ReceiveListOfAllDecoders() but ordered by which decoder is likely to probe
+   * `filename` successfully
+   *
+   * The file's magic bytes (falling back to its extension) are used to recognize audio/video
+   * containers, which are tried with FFmpeg first rather than letting image libraries try every
+   * plugin on them. Anything unrecognized uses the default priority.
+   */
+  static QVector<DecoderPtr> ReceiveListOfAllDecoders(const QString& filename);
+
+  /**
+   * @brief Heuristically determine whether a file is an audio/video container rather than an image
+   *
+   * If `read_magic` is false, only the file extension is checked, which avoids opening the file.
+   */
+  static bool IsLikelyMediaContainer(const QString& filename, bool read_magic = true);
+
 protected:
   /**
    * @brief Internal open function
@@ -287,7 +351,14 @@ protected:
    */
   virtual FramePtr RetrieveVideoInternal(const rational& timecode, const RetrieveVideoParams& divider);
 
-  virtual bool ConformAudioInternal(const QString& filename, const AudioParams &params, const QAtomicInt* cancelled);
+  virtual bool ConformAudioInternal(const QVector<ConformOutput>& outputs, const AudioParams &params, const TimeRange &range, const QAtomicInt* cancelled);
+
+  /**
+   * @brief Other audio streams in the open file that ConformAudioInternal() can conform alongside this one
+   *
+   * Function is already mutexed. Returns nothing by default.
+   */
+  virtual QVector<int> GetConformSiblingStreams();
 
   void SignalProcessingProgress(int64_t ts, int64_t duration);
 
@@ -303,6 +374,17 @@ protected:
 
   static int64_t GetTimeInTimebaseUnits(const rational& time, const rational& timebase, int64_t start_time);
 
+  /**
+   * @brief Mutex guarding this decoder's state
+   *
+   * The public functions already hold this while calling the internal ones. Sub-classes only need
+   * it for work they do on their own threads.
+   */
+  QMutex* mutex()
+  {
+    return &mutex_;
+  }
+
 signals:
   /**
    * @brief While indexing, this signal will provide progress as a percentage (0-100 inclusive) if
@@ -315,6 +397,13 @@ private:
 
   SampleBufferPtr RetrieveAudioFromConform(const QString& conform_filename, const TimeRange &range, Footage::LoopMode loop_mode);
 
+  /**
+   * @brief Assemble a range from the chunks ConformManager conforms ahead of a full conform
+   *
+   * Returns nullptr if any chunk the range needs isn't ready yet, in which case it's been queued.
+   */
+  SampleBufferPtr RetrieveAudioFromConformChunks(const QString &cache_path, const TimeRange &range, const AudioParams &params);
+
   CodecStream stream_;
 
   QMutex mutex_;
@@ -90,6 +90,8 @@ EncodingParams::EncodingParams() :
   video_buffer_size_(0),
   video_threads_(0),
   video_is_image_sequence_(false),
+  video_segments_(1),
+  video_smart_render_(false),
   audio_enabled_(false),
   audio_bit_rate_(0),
   subtitles_enabled_(false)
@@ -121,6 +123,21 @@ void EncodingParams::EnableSubtitles(const ExportCodec::Codec &scodec)
   subtitles_codec_ = scodec;
 }
 
+void EncodingParams::DisableVideo()
+{
+  video_enabled_ = false;
+}
+
+void EncodingParams::DisableAudio()
+{
+  audio_enabled_ = false;
+}
+
+void EncodingParams::DisableSubtitles()
+{
+  subtitles_enabled_ = false;
+}
+
 void EncodingParams::set_video_option(const QString &key, const QString &value)
 {
   video_opts_.insert(key, value);
@@ -246,7 +263,7 @@ void EncodingParams::SetExportLength(const rational &export_length)
   export_length_ = export_length;
 }
 
-void EncodingParams::Save(QXmlStreamWriter *writer) const
+void EncodingParams::Save(XMLWriter *writer) const
 {
   writer->writeTextElement(QStringLiteral("filename"), filename_);
 
@@ -266,6 +283,8 @@ void EncodingParams::Save(QXmlStreamWriter *writer) const
     writer->writeTextElement(QStringLiteral("maxbitrate"), QString::number(video_max_bit_rate_));
     writer->writeTextElement(QStringLiteral("bufsize"), QString::number(video_buffer_size_));
     writer->writeTextElement(QStringLiteral("threads"), QString::number(video_threads_));
+    writer->writeTextElement(QStringLiteral("segments"), QString::number(video_segments_));
+    writer->writeTextElement(QStringLiteral("smartrender"), QString::number(video_smart_render_));
 
     if (!video_opts_.isEmpty()) {
       writer->writeStartElement(QStringLiteral("opts"));
@@ -24,13 +24,13 @@
 #include <memory>
 #include <QRegularExpression>
 #include <QString>
-#include <QXmlStreamWriter>
 
 #include "codec/exportcodec.h"
 #include "codec/exportformat.h"
 #include "codec/frame.h"
 #include "codec/samplebuffer.h"
 #include "common/timerange.h"
+#include "common/xmlstream.h"
 #include "node/block/subtitle/subtitle.h"
 #include "render/audioparams.h"
 #include "render/subtitleparams.h"
@@ -51,6 +51,10 @@ public:
   void EnableAudio(const AudioParams& audio_params, const ExportCodec::Codec &acodec);
   void EnableSubtitles(const ExportCodec::Codec &scodec);
 
+  void DisableVideo();
+  void DisableAudio();
+  void DisableSubtitles();
+
   void set_video_option(const QString& key, const QString& value);
   void set_video_bit_rate(const int64_t& rate);
   void set_video_min_bit_rate(const int64_t& rate);
@@ -63,6 +67,29 @@ public:
     video_is_image_sequence_ = s;
   }
 
+  /**
+   * @brief Number of segments to split the video into, each encoded in parallel
+   *
+   * Only used for codecs where segments can be joined without re-encoding (see
+   * ExportCodec::IsCodecIntraOnly()). 1 encodes the whole range with a single encoder.
+   */
+  void set_video_segments(int s)
+  {
+    video_segments_ = s;
+  }
+
+  /**
+   * @brief Copy frames that are untouched footage straight from their source file
+   *
+   * Only used for codecs where every frame can be copied on its own (see
+   * ExportCodec::IsCodecIntraOnly()) and when the source stream matches the export's codec, pixel
+   * format and dimensions. All other frames are rendered and encoded as usual.
+   */
+  void set_video_smart_render(bool e)
+  {
+    video_smart_render_ = e;
+  }
+
   const QString& filename() const;
 
   bool video_enabled() const;
@@ -79,6 +106,14 @@ public:
   {
     return video_is_image_sequence_;
   }
+  int video_segments() const
+  {
+    return video_segments_;
+  }
+  bool video_smart_render() const
+  {
+    return video_smart_render_;
+  }
 
   bool audio_enabled() const;
   const ExportCodec::Codec &audio_codec() const;
@@ -100,7 +135,7 @@ public:
   const rational& GetExportLength() const;
   void SetExportLength(const rational& GetExportLength);
 
-  virtual void Save(QXmlStreamWriter* writer) const;
+  virtual void Save(XMLWriter* writer) const;
 
 private:
   QString filename_;
@@ -116,6 +151,8 @@ private:
   int video_threads_;
   QString video_pix_fmt_;
   bool video_is_image_sequence_;
+  int video_segments_;
+  bool video_smart_render_;
 
   bool audio_enabled_;
   ExportCodec::Codec audio_codec_;
@@ -163,6 +200,56 @@ public:
     return VideoParams::kFormatInvalid;
   }
 
+  /**
+   * @brief Planar YUV layout this encoder can take frames in directly, if any
+   *
+   * If valid, frames may be packed on the GPU (see Frame::planar_yuv()) instead of being converted
+   * by the encoder. Encoders must still accept regular RGB(A) frames either way.
+   */
+  virtual PlanarYUV GetDesiredPlanarYUV() const
+  {
+    return PlanarYUV();
+  }
+
+  /**
+   * @brief Whether WriteFrame() can be called for any frame, in any order, from several threads at once
+   *
+   * True for encoders that write every frame to its own file with no shared state, in which case
+   * exports don't need to wait for frames to arrive in order.
+   */
+  virtual bool WritesFramesIndependently() const
+  {
+    return false;
+  }
+
+  /**
+   * @brief Whether compressed frames from a stream in another file can be copied into this video
+   *
+   * If true, WritePassthroughFrame() can be used for frames of this stream instead of rendering
+   * and encoding them.
+   */
+  virtual bool CanPassthrough(const QString& filename, int stream)
+  {
+    Q_UNUSED(filename)
+    Q_UNUSED(stream)
+    return false;
+  }
+
+  /**
+   * @brief Copy the compressed frame at `source_time` in a stream into the video at `time`
+   *
+   * Only valid for streams CanPassthrough() accepted. Like WriteFrame(), frames must be given in
+   * order, and the two can be mixed freely.
+   */
+  virtual bool WritePassthroughFrame(const QString& filename, int stream, const rational& source_time, const rational& time)
+  {
+    Q_UNUSED(filename)
+    Q_UNUSED(stream)
+    Q_UNUSED(source_time)
+    Q_UNUSED(time)
+    return false;
+  }
+
   const QString& GetError() const
   {
     return error_;
@@ -183,7 +270,7 @@ public slots:
 
   virtual bool WriteFrame(olive::FramePtr frame, olive::rational time) = 0;
   virtual bool WriteAudio(olive::SampleBufferPtr audio) = 0;
-  virtual bool WriteSubtitle(const SubtitleBlock *sub_block) = 0;
+  virtual bool WriteSubtitle(const SubtitleCue &cue) = 0;
 
   virtual void Close() = 0;
 
@@ -62,6 +62,22 @@ QString ExportCodec::GetCodecName(ExportCodec::Codec c)
     return tr("VP9");
   case kCodecSRT:
     return tr("SubRip SRT");
+  case kCodecH264NVENC:
+    return tr("H.264 (NVENC)");
+  case kCodecH265NVENC:
+    return tr("H.265 (NVENC)");
+  case kCodecH264QSV:
+    return tr("H.264 (Quick Sync)");
+  case kCodecH265QSV:
+    return tr("H.265 (Quick Sync)");
+  case kCodecH264VAAPI:
+    return tr("H.264 (VA-API)");
+  case kCodecH265VAAPI:
+    return tr("H.265 (VA-API)");
+  case kCodecH264VideoToolbox:
+    return tr("H.264 (VideoToolbox)");
+  case kCodecH265VideoToolbox:
+    return tr("H.265 (VideoToolbox)");
   case kCodecCount:
     break;
   }
@@ -85,6 +101,14 @@ bool ExportCodec::IsCodecAStillImage(ExportCodec::Codec c)
   case kCodecFLAC:
   case kCodecVP9:
   case kCodecSRT:
+  case kCodecH264NVENC:
+  case kCodecH265NVENC:
+  case kCodecH264QSV:
+  case kCodecH265QSV:
+  case kCodecH264VAAPI:
+  case kCodecH265VAAPI:
+  case kCodecH264VideoToolbox:
+  case kCodecH265VideoToolbox:
     return false;
   case kCodecOpenEXR:
   case kCodecPNG:
@@ -97,4 +121,75 @@ bool ExportCodec::IsCodecAStillImage(ExportCodec::Codec c)
   return false;
 }
 
+bool ExportCodec::IsCodecIntraOnly(ExportCodec::Codec c)
+{
+  switch (c) {
+  case kCodecDNxHD:
+  case kCodecProRes:
+  case kCodecOpenEXR:
+  case kCodecPNG:
+  case kCodecTIFF:
+    return true;
+  default:
+    break;
+  }
+
+  return false;
+}
+
+const char *ExportCodec::GetHardwareEncoderName(ExportCodec::Codec c)
+{
+  switch (c) {
+  case kCodecH264NVENC:
+    return "h264_nvenc";
+  case kCodecH265NVENC:
+    return "hevc_nvenc";
+  case kCodecH264QSV:
+    return "h264_qsv";
+  case kCodecH265QSV:
+    return "hevc_qsv";
+  case kCodecH264VAAPI:
+    return "h264_vaapi";
+  case kCodecH265VAAPI:
+    return "hevc_vaapi";
+  case kCodecH264VideoToolbox:
+    return "h264_videotoolbox";
+  case kCodecH265VideoToolbox:
+    return "hevc_videotoolbox";
+  default:
+    break;
+  }
+
+  return nullptr;
+}
+
+ExportCodec::Codec ExportCodec::GetBaseCodec(ExportCodec::Codec c)
+{
+  switch (c) {
+  case kCodecH264NVENC:
+  case kCodecH264QSV:
+  case kCodecH264VAAPI:
+  case kCodecH264VideoToolbox:
+    return kCodecH264;
+  case kCodecH265NVENC:
+  case kCodecH265QSV:
+  case kCodecH265VAAPI:
+  case kCodecH265VideoToolbox:
+    return kCodecH265;
+  default:
+    break;
+  }
+
+  return c;
+}
+
+bool ExportCodec::IsCodecAvailable(ExportCodec::Codec c)
+{
+  const char* hw_name = GetHardwareEncoderName(c);
+
+  // Software codecs are always assumed available, hardware ones depend on how FFmpeg was built.
+  // NOTE: This doesn't guarantee a device is present, that's only known once the encoder opens.
+  return !hw_name || avcodec_find_encoder_by_name(hw_name);
+}
+
 }
@@ -56,6 +56,16 @@ public:
     // Subtitle codecs
     kCodecSRT,
 
+    // Hardware video codecs (kept at the end so saved codec indices remain valid)
+    kCodecH264NVENC,
+    kCodecH265NVENC,
+    kCodecH264QSV,
+    kCodecH265QSV,
+    kCodecH264VAAPI,
+    kCodecH265VAAPI,
+    kCodecH264VideoToolbox,
+    kCodecH265VideoToolbox,
+
     kCodecCount
   };
 
@@ -63,6 +73,30 @@ public:
 
   static bool IsCodecAStillImage(Codec c);
 
+  /**
+   * @brief Returns true if every frame of this codec is independently decodable
+   *
+   * Separately encoded runs of these codecs can be joined with a plain stream copy.
+   */
+  static bool IsCodecIntraOnly(Codec c);
+
+  /**
+   * @brief Returns the FFmpeg encoder name for hardware codecs, or nullptr for software codecs
+   */
+  static const char* GetHardwareEncoderName(Codec c);
+
+  /**
+   * @brief Returns the software codec that a hardware codec encodes to (e.g. H.264 for NVENC H.264)
+   *
+   * Software codecs are returned unchanged.
+   */
+  static Codec GetBaseCodec(Codec c);
+
+  /**
+   * @brief Returns false if this is a hardware codec that the linked FFmpeg wasn't built with
+   */
+  static bool IsCodecAvailable(Codec c);
+
 };
 
 }
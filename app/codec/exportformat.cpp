@@ -107,9 +107,9 @@ QList<ExportCodec::Codec> ExportFormat::GetVideoCodecs(ExportFormat::Format f)
   case kFormatDNxHD:
     return {ExportCodec::kCodecDNxHD};
   case kFormatMatroska:
-    return {ExportCodec::kCodecH264, ExportCodec::kCodecH265};
+    return AddHardwareCodecs({ExportCodec::kCodecH264, ExportCodec::kCodecH265});
   case kFormatMPEG4:
-    return {ExportCodec::kCodecH264, ExportCodec::kCodecH265};
+    return AddHardwareCodecs({ExportCodec::kCodecH264, ExportCodec::kCodecH265});
   case kFormatOpenEXR:
     return {ExportCodec::kCodecOpenEXR};
   case kFormatPNG:
@@ -117,7 +117,7 @@ QList<ExportCodec::Codec> ExportFormat::GetVideoCodecs(ExportFormat::Format f)
   case kFormatTIFF:
     return {ExportCodec::kCodecTIFF};
   case kFormatQuickTime:
-    return {ExportCodec::kCodecH264, ExportCodec::kCodecH265, ExportCodec::kCodecProRes};
+    return AddHardwareCodecs({ExportCodec::kCodecH264, ExportCodec::kCodecH265, ExportCodec::kCodecProRes});
   case kFormatWebM:
     return {ExportCodec::kCodecVP9};
   case kFormatOgg:
@@ -211,4 +211,26 @@ QStringList ExportFormat::GetPixelFormatsForCodec(ExportFormat::Format f, Export
   return list;
 }
 
+QList<ExportCodec::Codec> ExportFormat::AddHardwareCodecs(QList<ExportCodec::Codec> codecs)
+{
+  static const ExportCodec::Codec hw_codecs[] = {
+    ExportCodec::kCodecH264NVENC,
+    ExportCodec::kCodecH265NVENC,
+    ExportCodec::kCodecH264QSV,
+    ExportCodec::kCodecH265QSV,
+    ExportCodec::kCodecH264VAAPI,
+    ExportCodec::kCodecH265VAAPI,
+    ExportCodec::kCodecH264VideoToolbox,
+    ExportCodec::kCodecH265VideoToolbox
+  };
+
+  for (ExportCodec::Codec c : hw_codecs) {
+    if (ExportCodec::IsCodecAvailable(c)) {
+      codecs.append(c);
+    }
+  }
+
+  return codecs;
+}
+
 }
@@ -60,6 +60,12 @@ public:
 
   static QStringList GetPixelFormatsForCodec(Format f, ExportCodec::Codec c);
 
+private:
+  /**
+   * @brief Appends the hardware H.264/H.265 codecs that this FFmpeg build provides
+   */
+  static QList<ExportCodec::Codec> AddHardwareCodecs(QList<ExportCodec::Codec> codecs);
+
 };
 
 }
@@ -25,6 +25,7 @@ extern "C" {
 #include <libavfilter/buffersink.h>
 #include <libavfilter/buffersrc.h>
 #include <libavformat/avformat.h>
+#include <libavutil/hwcontext.h>
 #include <libavutil/imgutils.h>
 #include <libavutil/pixdesc.h>
 }
@@ -38,14 +39,19 @@ extern "C" {
 #include <QThread>
 #include <QtConcurrent/QtConcurrent>
 
-#include "codec/waveinput.h"
+#include "audio/audioresampler.h"
+#include "codec/planaraudiofile.h"
 #include "common/define.h"
 #include "common/ffmpegutils.h"
 #include "common/filefunctions.h"
 #include "common/functiontimer.h"
 #include "common/timecodefunctions.h"
+#include "common/tracing.h"
+#include "config/config.h"
 #include "render/framehashcache.h"
 #include "render/diskmanager.h"
+#include "render/hardwareprofile.h"
+#include "render/memorygovernor.h"
 
 namespace olive {
 
@@ -53,13 +59,25 @@ FFmpegDecoder::FFmpegDecoder() :
   filter_graph_(nullptr),
   buffersrc_ctx_(nullptr),
   buffersink_ctx_(nullptr),
-  pool_(QThread::idealThreadCount()*2),
+  pool_(HardwareProfile::GetRenderThreadCount()*2),
   is_working_(false),
   cache_at_zero_(false),
-  cache_at_eof_(false)
+  cache_at_eof_(false),
+  decoder_at_cache_end_(true),
+  max_cached_frames_(HardwareProfile::GetRenderThreadCount()),
+  cache_hits_(0),
+  cache_misses_(0),
+  last_requested_ts_(AV_NOPTS_VALUE),
+  sequential_requests_(0),
+  use_keyframe_index_(false),
+  instance_lowres_(0)
 {
 }
 
+const int FFmpegDecoder::kReadaheadTrigger = 3;
+
+const int FFmpegDecoder::kReadaheadLockTimeout = 10;
+
 bool FFmpegDecoder::OpenInternal()
 {
   if (instance_.Open(stream().filename().toUtf8(), stream().stream())) {
@@ -82,6 +100,14 @@ bool FFmpegDecoder::OpenInternal()
         qDebug() << "Failed to find valid native pixel format for" << ideal_pix_fmt_;
         return false;
       }
+
+      // Random access into long-GOP video is much cheaper knowing exactly where the keyframes are.
+      // If the index isn't built yet, this starts building it for next time.
+      const AVCodecDescriptor* desc = avcodec_descriptor_get(s->codecpar->codec_id);
+      use_keyframe_index_ = (!desc || !(desc->props & AV_CODEC_PROP_INTRA_ONLY));
+      if (use_keyframe_index_) {
+        keyframe_index_ = FFmpegKeyframeIndex::Get(stream().filename(), stream().stream());
+      }
     }
 
     return true;
@@ -148,30 +174,64 @@ bool FFmpegDecoder::OpenInternal()
 
 FramePtr FFmpegDecoder::RetrieveVideoInternal(const rational &timecode, const RetrieveVideoParams &params)
 {
+  // Codecs that can decode at a fraction of their size save us decoding pixels only for the
+  // scaler to throw them away
+  int lowres = params.hw_device.isEmpty() ? GetLowresForDivider(params.divider) : 0;
+
+  if ((params.hw_device != instance_hw_device_ || lowres != instance_lowres_)
+      && !ReopenInstance(params.hw_device, lowres)) {
+    return nullptr;
+  }
+
   if (!InitScaler(params)) {
     return nullptr;
   }
 
   AVStream* s = instance_.avstream();
 
-  // Retrieve frame
-  FFmpegFramePool::ElementPtr return_frame = RetrieveFrame(timecode);
+  // Retrieve frame. Keyframes can't be picked out of the fields deinterlacing splits them into.
+  FFmpegFramePool::ElementPtr return_frame;
+  if (params.keyframes_only && params.src_interlacing == VideoParams::kInterlaceNone && use_keyframe_index_) {
+    return_frame = RetrieveKeyframe(timecode);
+  } else {
+    return_frame = RetrieveFrame(timecode);
+  }
+
+  // If we're being read sequentially (i.e. playback), start decoding ahead of the requests so
+  // render threads don't have to wait on the decoder
+  if (sequential_requests_ >= kReadaheadTrigger && !readahead_future_.isRunning()) {
+    readahead_future_ = QtConcurrent::run(GetReadaheadThreadPool(), [this]{
+      Readahead();
+    });
+  }
 
   // We found the frame, we'll return a copy
   if (return_frame) {
     FramePtr copy = Frame::Create();
-    copy->set_video_params(VideoParams(s->codecpar->width,
-                                       s->codecpar->height,
-                                       native_pix_fmt_,
-                                       native_channel_count_,
-                                       av_guess_sample_aspect_ratio(instance_.fmt_ctx(), s, nullptr), // May be incorrect,
-                                       VideoParams::kInterlaceNone,
-                                       filter_params_.divider));
+    if (frame_yuv_.IsValid()) {
+      // Packed planes are described at the size they were decoded to, like frames packed for export
+      copy->set_video_params(VideoParams(pool_.width(),
+                                         pool_.height(),
+                                         frame_yuv_.format(),
+                                         1,
+                                         av_guess_sample_aspect_ratio(instance_.fmt_ctx(), s, nullptr),
+                                         VideoParams::kInterlaceNone,
+                                         1));
+      copy->set_planar_yuv(frame_yuv_);
+    } else {
+      copy->set_video_params(VideoParams(s->codecpar->width,
+                                         s->codecpar->height,
+                                         native_pix_fmt_,
+                                         native_channel_count_,
+                                         av_guess_sample_aspect_ratio(instance_.fmt_ctx(), s, nullptr), // May be incorrect,
+                                         VideoParams::kInterlaceNone,
+                                         filter_params_.divider));
+    }
     copy->set_timestamp(timecode);
-    copy->allocate();
 
-    // This data will already match the frame
-    memcpy(copy->data(), return_frame->data(), copy->allocated_size());
+    // This data will already match the frame, so rather than copying it, the frame just refers to
+    // the cached one. Keeping the element alive means it won't go back to the pool while it's used.
+    copy->set_external_data(reinterpret_cast<char*>(return_frame->data()), return_frame);
 
     return copy;
   }
@@ -181,9 +241,27 @@ FramePtr FFmpegDecoder::RetrieveVideoInternal(const rational &timecode, const Re
 
 void FFmpegDecoder::CloseInternal()
 {
+  // Readahead gives up waiting for the lock once cancelled, so this can't deadlock
+  readahead_cancelled_ = 1;
+  readahead_future_.waitForFinished();
+  readahead_cancelled_ = 0;
+
+  last_requested_ts_ = AV_NOPTS_VALUE;
+  sequential_requests_ = 0;
+
+  if (cache_hits_ || cache_misses_) {
+    qDebug() << "Frame cache for" << stream().filename() << "had" << cache_hits_ << "hits and"
+             << cache_misses_ << "misses";
+  }
+
   ClearFrameCache();
 
   instance_.Close();
+  instance_hw_device_.clear();
+  instance_lowres_ = 0;
+
+  use_keyframe_index_ = false;
+  keyframe_index_.reset();
 }
 
 int FFmpegDecoder::GetFilteredFrame(AVPacket* packet, AVFrame* output_frame)
@@ -438,103 +516,479 @@ QString FFmpegDecoder::FFmpegError(int error_code)
   return QStringLiteral("%1 %2").arg(QString::number(error_code), err);
 }
 
-bool FFmpegDecoder::ConformAudioInternal(const QString &filename, const AudioParams &params, const QAtomicInt *cancelled)
+class FFmpegDecoder::AudioConformer
 {
-  // Iterate through each audio frame and extract the PCM data
+public:
+  AudioConformer(AVStream* stream, uint64_t channel_layout, const QString& filename, const AudioParams& params) :
+    stream_(stream),
+    channel_layout_(channel_layout),
+    codec_ctx_(nullptr),
+    frame_(av_frame_alloc()),
+    output_(filename, params),
+    params_(params),
+    planes_(params.channel_count()),
+    ended_(false),
+    failed_(false),
+    ranged_(false),
+    positioned_(false),
+    range_start_(0),
+    range_end_(0),
+    position_(0)
+  {
+  }
 
-  // Seek to starting point
-  instance_.Seek(0);
+  ~AudioConformer()
+  {
+    foreach (AVPacket* p, queue_) {
+      av_packet_free(&p);
+    }
 
-  // Handle NULL channel layout
-  uint64_t channel_layout = ValidateChannelLayout(instance_.avstream());
-  if (!channel_layout) {
-    qCritical() << "Failed to determine channel layout of audio file, could not conform";
-    return false;
+    avcodec_free_context(&codec_ctx_);
+    av_frame_free(&frame_);
   }
 
-  // Create resampling context
-  SwrContext* resampler = swr_alloc_set_opts(nullptr,
-                                             params.channel_layout(),
-                                             FFmpegUtils::GetFFmpegSampleFormat(params.format()),
-                                             params.sample_rate(),
-                                             channel_layout,
-                                             static_cast<AVSampleFormat>(instance_.avstream()->codecpar->format),
-                                             instance_.avstream()->codecpar->sample_rate,
-                                             0,
-                                             nullptr);
+  DISABLE_COPY_MOVE(AudioConformer)
 
-  swr_init(resampler);
+  int index() const
+  {
+    return stream_->index;
+  }
 
-  WaveOutput wave_out(filename, params);
+  /**
+   * @brief Only write output samples in [start, end) rather than the whole stream
+   *
+   * Where the output starts is taken from the first decoded frame's timestamp, so this works after
+   * seeking anywhere in the file. If that frame starts after `start`, the gap is filled with silence.
+   */
+  void SetRange(int64_t start, int64_t end)
+  {
+    ranged_ = true;
+    range_start_ = start;
+    range_end_ = end;
+  }
 
-  AVPacket* pkt = av_packet_alloc();
-  AVFrame* frame = av_frame_alloc();
-  int ret;
+  /**
+   * @brief Whether everything in the range set with SetRange() has been written
+   */
+  bool IsFinished() const
+  {
+    return ranged_ && positioned_ && position_ >= range_end_;
+  }
 
-  bool success = false;
+  bool Open()
+  {
+    AVCodec* codec = avcodec_find_decoder(stream_->codecpar->codec_id);
+    if (!codec) {
+      qCritical() << "Failed to find decoder for conforming stream" << stream_->index;
+      return false;
+    }
 
-  if (wave_out.open()) {
-    while (true) {
-      // Check if we have a `cancelled` ptr and its value
-      if (cancelled && *cancelled) {
-        break;
+    codec_ctx_ = avcodec_alloc_context3(codec);
+    if (!codec_ctx_
+        || avcodec_parameters_to_context(codec_ctx_, stream_->codecpar) < 0
+        || avcodec_open2(codec_ctx_, codec, nullptr) < 0) {
+      qCritical() << "Failed to open decoder for conforming stream" << stream_->index;
+      return false;
+    }
+
+    // Conforms are always stored as planar float
+    if (!resampler_.Open(channel_layout_,
+                         static_cast<AVSampleFormat>(stream_->codecpar->format),
+                         stream_->codecpar->sample_rate,
+                         params_.channel_layout(),
+                         AV_SAMPLE_FMT_FLTP,
+                         params_.sample_rate())) {
+      qCritical() << "Failed to create resampler for conforming stream" << stream_->index;
+      return false;
+    }
+
+    if (!output_.open()) {
+      qWarning() << "Failed to open conform output for indexing";
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * @brief Decode a packet and write whatever frames it produces, or flush everything if `pkt` is null
+   */
+  bool Decode(AVPacket* pkt)
+  {
+    int ret = avcodec_send_packet(codec_ctx_, pkt);
+    if (ret < 0 && ret != AVERROR_EOF) {
+      qWarning() << "Failed to conform:" << FFmpegError(ret);
+      return false;
+    }
+
+    while ((ret = avcodec_receive_frame(codec_ctx_, frame_)) >= 0) {
+      if (ranged_ && !positioned_) {
+        PositionAt(frame_);
+      }
+
+      bool ok = Resample(const_cast<const uint8_t**>(frame_->data), frame_->nb_samples);
+      av_frame_unref(frame_);
+      if (!ok) {
+        return false;
       }
+    }
 
-      ret = instance_.GetFrame(pkt, frame);
+    if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF) {
+      qWarning() << "Failed to conform:" << FFmpegError(ret);
+      return false;
+    }
 
-      if (ret < 0) {
+    if (!pkt) {
+      // Drain whatever the resampler is still holding
+      return Resample(nullptr, 0);
+    }
 
-        if (ret == AVERROR_EOF) {
-          success = true;
-        } else {
-          char err_str[512];
-          av_strerror(ret, err_str, 512);
-          qWarning() << "Failed to conform:" << ret << err_str;
+    return true;
+  }
+
+  bool Close()
+  {
+    return output_.close() && !failed_;
+  }
+
+  /**
+   * @brief Queue a packet for Run(), taking ownership of it, or signal the end of the stream with null
+   *
+   * Blocks while the queue is full so a slow stream can't make the demuxer buffer the whole file.
+   */
+  void Push(AVPacket* pkt)
+  {
+    const int kMaxQueuedPackets = 256;
+
+    QMutexLocker locker(&lock_);
+
+    while (queue_.size() >= kMaxQueuedPackets && !failed_) {
+      cond_.wait(&lock_);
+    }
+
+    if (pkt) {
+      if (failed_) {
+        av_packet_free(&pkt);
+      } else {
+        queue_.append(pkt);
+      }
+    } else {
+      ended_ = true;
+    }
+
+    cond_.wakeAll();
+  }
+
+  /**
+   * @brief Decode queued packets until the end of the stream
+   */
+  void Run()
+  {
+    while (true) {
+      AVPacket* pkt = nullptr;
+
+      {
+        QMutexLocker locker(&lock_);
+
+        while (queue_.isEmpty() && !ended_) {
+          cond_.wait(&lock_);
+        }
+
+        if (queue_.isEmpty()) {
+          break;
         }
-        break;
 
+        pkt = queue_.takeFirst();
+        cond_.wakeAll();
       }
 
-      // Allocate buffers
-      int nb_samples = swr_get_out_samples(resampler, frame->nb_samples);
-      char* data = new char[params.samples_to_bytes(nb_samples)];
-
-      // Resample audio to our destination parameters
-      nb_samples = swr_convert(resampler,
-                               reinterpret_cast<uint8_t**>(&data),
-                               nb_samples,
-                               const_cast<const uint8_t**>(frame->data),
-                               frame->nb_samples);
-
-      if (nb_samples < 0) {
-        char err_str[512];
-        av_strerror(nb_samples, err_str, 512);
-        qWarning() << "libswresample failed with error:" << nb_samples << err_str;
-        break;
+      bool ok = failed_ || Decode(pkt);
+      av_packet_free(&pkt);
+
+      if (!ok) {
+        QMutexLocker locker(&lock_);
+        failed_ = true;
+        cond_.wakeAll();
       }
+    }
+
+    if (!failed_ && !Decode(nullptr)) {
+      failed_ = true;
+    }
+  }
 
-      // Write packed WAV data to the disk cache
-      wave_out.write(data, params.samples_to_bytes(nb_samples));
+private:
+  /**
+   * @brief Find where in the output the first frame decoded after seeking belongs
+   */
+  void PositionAt(AVFrame* frame)
+  {
+    int64_t ts = frame->best_effort_timestamp;
+    int64_t start_time = (stream_->start_time == AV_NOPTS_VALUE) ? 0 : stream_->start_time;
+
+    if (ts == AV_NOPTS_VALUE) {
+      position_ = range_start_;
+    } else {
+      position_ = av_rescale_q(ts - start_time, stream_->time_base, AVRational{1, params_.sample_rate()});
+    }
+
+    positioned_ = true;
+
+    // Audio starts later than requested, pad the start of the range so it still lines up
+    int64_t silence = qMin(position_, range_end_) - range_start_;
+    if (silence <= 0) {
+      return;
+    }
+
+    const int kSilenceChunk = 4096;
+    buffer_.fill(0.0f, kSilenceChunk * params_.channel_count());
+    for (int i=0; i<planes_.size(); i++) {
+      planes_[i] = buffer_.data() + i * kSilenceChunk;
+    }
+
+    for (int64_t i=0; i<silence; i+=kSilenceChunk) {
+      output_.write(planes_.constData(), int(qMin<int64_t>(kSilenceChunk, silence - i)));
+    }
+  }
+
+  bool Resample(const uint8_t** in, int in_count)
+  {
+    int nb_samples = resampler_.GetOutSamples(in_count);
+    if (nb_samples <= 0) {
+      return true;
+    }
+
+    if (buffer_.size() < nb_samples * params_.channel_count()) {
+      buffer_.resize(nb_samples * params_.channel_count());
+    }
+    for (int i=0; i<planes_.size(); i++) {
+      planes_[i] = buffer_.data() + i * nb_samples;
+    }
+
+    nb_samples = resampler_.Convert(reinterpret_cast<uint8_t**>(planes_.data()), nb_samples, in, in_count);
+
+    if (nb_samples < 0) {
+      qWarning() << "libswresample failed with error:" << FFmpegError(nb_samples);
+      return false;
+    }
+
+    if (ranged_) {
+      // Trim whatever falls outside the range
+      int64_t skip = qBound<int64_t>(0, range_start_ - position_, nb_samples);
+      int64_t end = qBound<int64_t>(0, range_end_ - position_, nb_samples);
+
+      position_ += nb_samples;
+
+      if (end <= skip) {
+        return true;
+      }
 
-      // If we allocated an output for the resampler, delete it here
-      if (data != reinterpret_cast<char*>(frame->data[0])) {
-        delete [] data;
+      for (int i=0; i<planes_.size(); i++) {
+        planes_[i] += skip;
       }
 
-      SignalProcessingProgress(frame->pts, instance_.avstream()->duration);
+      nb_samples = int(end - skip);
     }
 
-    wave_out.close();
+    output_.write(planes_.constData(), nb_samples);
+
+    return true;
+  }
+
+  AVStream* stream_;
+
+  uint64_t channel_layout_;
+
+  AVCodecContext* codec_ctx_;
+
+  AudioResampler resampler_;
+
+  AVFrame* frame_;
+
+  PlanarAudioOutput output_;
+
+  AudioParams params_;
+
+  QVector<float> buffer_;
+
+  QVector<float*> planes_;
+
+  QMutex lock_;
+
+  QWaitCondition cond_;
+
+  QList<AVPacket*> queue_;
+
+  bool ended_;
+
+  bool failed_;
+
+  bool ranged_;
+
+  bool positioned_;
+
+  int64_t range_start_;
+
+  int64_t range_end_;
+
+  // Output sample that the next resampled sample belongs at, only tracked when ranged
+  int64_t position_;
+
+};
+
+bool FFmpegDecoder::ConformAudioInternal(const QVector<ConformOutput> &outputs, const AudioParams &params, const TimeRange &range, const QAtomicInt *cancelled)
+{
+  bool ranged = !range.length().isNull();
+
+  // Set up a decoder, resampler and output for every stream we're conforming
+  std::vector< std::unique_ptr<AudioConformer> > conformers;
+  QHash<int, AudioConformer*> conformer_for_stream;
+
+  foreach (const ConformOutput& output, outputs) {
+    if (output.stream < 0 || output.stream >= int(instance_.fmt_ctx()->nb_streams)) {
+      continue;
+    }
+
+    AVStream* stream = instance_.fmt_ctx()->streams[output.stream];
+
+    // Handle NULL channel layout
+    uint64_t channel_layout = ValidateChannelLayout(stream);
+    if (!channel_layout) {
+      qCritical() << "Failed to determine channel layout of audio file, could not conform";
+      return false;
+    }
+
+    conformers.emplace_back(new AudioConformer(stream, channel_layout, output.filename, params));
+    if (!conformers.back()->Open()) {
+      return false;
+    }
+
+    if (ranged) {
+      conformers.back()->SetRange(params.time_to_samples(range.in()), params.time_to_samples(range.out()));
+    }
+
+    conformer_for_stream.insert(output.stream, conformers.back().get());
+  }
+
+  if (conformers.empty()) {
+    return false;
+  }
+
+  // Seek to starting point
+  if (ranged) {
+    instance_.Seek(GetTimeInTimebaseUnits(range.in(), instance_.avstream()->time_base, instance_.avstream()->start_time));
   } else {
-    qWarning() << "Failed to open WAVE output for indexing";
+    instance_.Seek(0);
   }
 
-  swr_free(&resampler);
+  // With more than one stream, each one decodes and resamples on its own thread while this one only
+  // demuxes, so the file is read once no matter how many streams it has
+  bool threaded = (conformers.size() > 1);
+  QThreadPool conform_pool;
+  QVector< QFuture<void> > workers;
+
+  if (threaded) {
+    conform_pool.setMaxThreadCount(int(conformers.size()));
+
+    for (const std::unique_ptr<AudioConformer>& c : conformers) {
+      AudioConformer* conformer = c.get();
+      workers.append(QtConcurrent::run(&conform_pool, [conformer]{
+        conformer->Run();
+      }));
+    }
+  }
+
+  AVPacket* pkt = av_packet_alloc();
+  int primary_index = instance_.avstream()->index;
+  bool success = false;
+  bool ok = true;
+
+  while (ok) {
+    // Check if we have a `cancelled` ptr and its value
+    if (cancelled && *cancelled) {
+      break;
+    }
+
+    int ret = av_read_frame(instance_.fmt_ctx(), pkt);
+
+    if (ret < 0) {
+      if (ret == AVERROR_EOF) {
+        success = true;
+      } else {
+        qWarning() << "Failed to conform:" << FFmpegError(ret);
+      }
+      break;
+    }
+
+    AudioConformer* conformer = conformer_for_stream.value(pkt->stream_index);
+
+    if (conformer) {
+      if (pkt->stream_index == primary_index) {
+        SignalProcessingProgress(pkt->pts, instance_.avstream()->duration);
+      }
+
+      if (threaded) {
+        AVPacket* queued = av_packet_alloc();
+        av_packet_move_ref(queued, pkt);
+        conformer->Push(queued);
+      } else {
+        ok = conformer->Decode(pkt);
+
+        if (ok && conformer->IsFinished()) {
+          // Range is done, no need to read the rest of the file
+          av_packet_unref(pkt);
+          success = true;
+          break;
+        }
+      }
+    }
+
+    av_packet_unref(pkt);
+  }
 
-  av_frame_free(&frame);
   av_packet_free(&pkt);
 
-  return success;
+  if (threaded) {
+    for (const std::unique_ptr<AudioConformer>& c : conformers) {
+      c->Push(nullptr);
+    }
+
+    foreach (const QFuture<void>& f, workers) {
+      f.waitForFinished();
+    }
+  } else if (success) {
+    success = conformers.front()->Decode(nullptr);
+  }
+
+  for (const std::unique_ptr<AudioConformer>& c : conformers) {
+    if (!c->Close()) {
+      success = false;
+    }
+  }
+
+  return success && ok;
+}
+
+QVector<int> FFmpegDecoder::GetConformSiblingStreams()
+{
+  QVector<int> siblings;
+
+  AVFormatContext* fmt_ctx = instance_.fmt_ctx();
+  if (!fmt_ctx || !instance_.avstream()) {
+    return siblings;
+  }
+
+  for (unsigned int i=0; i<fmt_ctx->nb_streams; i++) {
+    AVStream* s = fmt_ctx->streams[i];
+
+    if (s != instance_.avstream()
+        && s->codecpar->codec_type == AVMEDIA_TYPE_AUDIO
+        && !(s->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+      siblings.append(s->index);
+    }
+  }
+
+  return siblings;
 }
 
 VideoParams::Format FFmpegDecoder::GetNativePixelFormat(AVPixelFormat pix_fmt)
@@ -565,6 +1019,137 @@ int FFmpegDecoder::GetNativeChannelCount(AVPixelFormat pix_fmt)
   }
 }
 
+PlanarYUV FFmpegDecoder::GetPlanarYUV(AVPixelFormat pix_fmt, AVColorSpace colorspace, AVColorRange range, int height)
+{
+  PlanarYUV::Subsampling subsampling;
+  int bit_depth;
+  bool full_range = (range == AVCOL_RANGE_JPEG);
+
+  switch (pix_fmt) {
+  case AV_PIX_FMT_YUVJ420P:
+    full_range = true;
+    /* fall through */
+  case AV_PIX_FMT_YUV420P:
+  case AV_PIX_FMT_NV12:
+    subsampling = PlanarYUV::k420;
+    bit_depth = 8;
+    break;
+  case AV_PIX_FMT_YUVJ422P:
+    full_range = true;
+    /* fall through */
+  case AV_PIX_FMT_YUV422P:
+    subsampling = PlanarYUV::k422;
+    bit_depth = 8;
+    break;
+  case AV_PIX_FMT_YUV420P10LE:
+    subsampling = PlanarYUV::k420;
+    bit_depth = 10;
+    break;
+  case AV_PIX_FMT_YUV422P10LE:
+    subsampling = PlanarYUV::k422;
+    bit_depth = 10;
+    break;
+  case AV_PIX_FMT_YUV420P12LE:
+    subsampling = PlanarYUV::k420;
+    bit_depth = 12;
+    break;
+  case AV_PIX_FMT_YUV422P12LE:
+    subsampling = PlanarYUV::k422;
+    bit_depth = 12;
+    break;
+#ifdef AV_PIX_FMT_P010
+  case AV_PIX_FMT_P010LE:
+#endif
+#ifdef AV_PIX_FMT_P016
+  case AV_PIX_FMT_P016LE:
+#endif
+    // Samples are in the high bits, which reads the same as 16-bit code values
+    subsampling = PlanarYUV::k420;
+    bit_depth = 16;
+    break;
+#ifdef AV_PIX_FMT_P216
+  case AV_PIX_FMT_P210LE:
+  case AV_PIX_FMT_P216LE:
+    subsampling = PlanarYUV::k422;
+    bit_depth = 16;
+    break;
+#endif
+  default:
+    return PlanarYUV();
+  }
+
+  PlanarYUV::Matrix matrix;
+
+  switch (colorspace) {
+  case AVCOL_SPC_BT709:
+    matrix = PlanarYUV::kRec709;
+    break;
+  case AVCOL_SPC_BT470BG:
+  case AVCOL_SPC_SMPTE170M:
+  case AVCOL_SPC_SMPTE240M:
+    matrix = PlanarYUV::kRec601;
+    break;
+  case AVCOL_SPC_BT2020_NCL:
+    matrix = PlanarYUV::kRec2020;
+    break;
+  case AVCOL_SPC_UNSPECIFIED:
+    // Same guess the encoder makes when writing
+    matrix = (height > 576) ? PlanarYUV::kRec709 : PlanarYUV::kRec601;
+    break;
+  default:
+    // Constant luminance and the more exotic matrices are left to libavfilter
+    return PlanarYUV();
+  }
+
+  return PlanarYUV(matrix, subsampling, bit_depth, full_range);
+}
+
+void FFmpegDecoder::CopyToPlanarYUV(const AVFrame *frame, const PlanarYUV &yuv, uint8_t *dst, int linesize)
+{
+  int bytes_per_sample = (yuv.format() == VideoParams::kFormatUnsigned16) ? 2 : 1;
+  int chroma_width = yuv.chroma_width(frame->width);
+  int chroma_height = yuv.chroma_height(frame->height);
+  int chroma_row_bytes = chroma_width * bytes_per_sample;
+
+  // Luma
+  av_image_copy_plane(dst, linesize, frame->data[0], frame->linesize[0],
+                      frame->width * bytes_per_sample, frame->height);
+
+  uint8_t* chroma_dst = dst + linesize * frame->height;
+
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+
+  if (desc->comp[1].plane == desc->comp[2].plane) {
+    // Semi-planar, Cb and Cr are interleaved in one plane and have to be pulled apart
+    for (int y=0; y<chroma_height; y++) {
+      const uint8_t* src = frame->data[1] + frame->linesize[1] * y;
+      uint8_t* cb = chroma_dst + linesize * y;
+      uint8_t* cr = cb + chroma_row_bytes;
+
+      if (bytes_per_sample == 2) {
+        const uint16_t* src16 = reinterpret_cast<const uint16_t*>(src);
+        uint16_t* cb16 = reinterpret_cast<uint16_t*>(cb);
+        uint16_t* cr16 = reinterpret_cast<uint16_t*>(cr);
+
+        for (int x=0; x<chroma_width; x++) {
+          cb16[x] = src16[x*2];
+          cr16[x] = src16[x*2+1];
+        }
+      } else {
+        for (int x=0; x<chroma_width; x++) {
+          cb[x] = src[x*2];
+          cr[x] = src[x*2+1];
+        }
+      }
+    }
+  } else {
+    av_image_copy_plane(chroma_dst, linesize, frame->data[1], frame->linesize[1],
+                        chroma_row_bytes, chroma_height);
+    av_image_copy_plane(chroma_dst + chroma_row_bytes, linesize, frame->data[2], frame->linesize[2],
+                        chroma_row_bytes, chroma_height);
+  }
+}
+
 uint64_t FFmpegDecoder::ValidateChannelLayout(AVStream* stream)
 {
   if (stream->codecpar->channel_layout) {
@@ -644,8 +1229,10 @@ void FFmpegDecoder::ClearFrameCache()
 {
   if (!cached_frames_.isEmpty()) {
     cached_frames_.clear();
+    cached_keyframes_.clear();
     cache_at_eof_ = false;
     cache_at_zero_ = false;
+    decoder_at_cache_end_ = true;
 
     // Filter graph may rely on "continuous" video frames, so we free the scaler here
     FreeScaler();
@@ -653,6 +1240,16 @@ void FFmpegDecoder::ClearFrameCache()
   }
 }
 
+int64_t FFmpegDecoder::GetSeekTimestamp(int64_t ts)
+{
+  if (!keyframe_index_ && use_keyframe_index_) {
+    // The index may have finished building since we opened
+    keyframe_index_ = FFmpegKeyframeIndex::Get(stream().filename(), stream().stream());
+  }
+
+  return keyframe_index_ ? keyframe_index_->GetSeekTimestamp(ts) : ts;
+}
+
 FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const rational& time)
 {
   int64_t target_ts = GetTimeInTimebaseUnits(time, instance_.avstream()->time_base, instance_.avstream()->start_time);
@@ -661,6 +1258,12 @@ FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const rational& time)
   int64_t seek_ts = target_ts;
   bool still_seeking = false;
 
+  // Frames that come after the GOP we're about to decode when stepping backwards. These are
+  // re-attached to the end of the cache once decoding catches up with them.
+  QList<FFmpegFramePool::ElementPtr> backward_tail;
+  QSet<int64_t> backward_tail_keyframes;
+  bool backward_tail_at_eof = false;
+
   if (filter_params_.src_interlacing != VideoParams::kInterlaceNone) {
     // If we are de-interlacing, the timebase is doubled because we get one frame per field, so we
     // double the target timestamp too
@@ -668,26 +1271,52 @@ FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const rational& time)
   }
 
   if (time != kAnyTimecode) {
-    // If the frame wasn't in the frame cache, see if this frame cache is too old to use
-    if (cached_frames_.isEmpty()
-        || (target_ts < cached_frames_.first()->timestamp() || target_ts > cached_frames_.last()->timestamp() + 2*second_ts_)) {
+    // Track whether requests are stepping forward a little at a time, which is what playback looks
+    // like. A quarter second of tolerance allows for frames skipped by a slow render.
+    if (last_requested_ts_ != AV_NOPTS_VALUE
+        && target_ts > last_requested_ts_
+        && target_ts - last_requested_ts_ <= second_ts_ / 4) {
+      sequential_requests_++;
+    } else {
+      sequential_requests_ = 0;
+    }
+    last_requested_ts_ = target_ts;
+
+    if (!cached_frames_.isEmpty()
+        && target_ts >= cached_frames_.first()->timestamp()
+        && (target_ts <= cached_frames_.last()->timestamp() || decoder_at_cache_end_)
+        && target_ts <= cached_frames_.last()->timestamp() + 2*second_ts_) {
+      // Search cache for frame
+      FFmpegFramePool::ElementPtr cached_frame = GetFrameFromCache(target_ts);
+      if (cached_frame) {
+        cache_hits_++;
+        return cached_frame;
+      }
+    } else {
+      if (!cached_frames_.isEmpty()
+          && target_ts < cached_frames_.first()->timestamp()
+          && target_ts >= cached_frames_.first()->timestamp() - 2*second_ts_) {
+        // We're stepping backwards, keep the GOPs we already have so that stepping further back
+        // through them doesn't require decoding them again
+        backward_tail = cached_frames_;
+        backward_tail_keyframes = cached_keyframes_;
+        backward_tail_at_eof = cache_at_eof_;
+      }
+
       ClearFrameCache();
+      cached_keyframes_ = backward_tail_keyframes;
 
-      instance_.Seek(seek_ts);
+      instance_.Seek(GetSeekTimestamp(seek_ts));
       if (seek_ts == min_seek) {
         cache_at_zero_ = true;
       }
 
       still_seeking = true;
-    } else {
-      // Search cache for frame
-      FFmpegFramePool::ElementPtr cached_frame = GetFrameFromCache(target_ts);
-      if (cached_frame) {
-        return cached_frame;
-      }
     }
   }
 
+  cache_misses_++;
+
   int ret;
   AVPacket* pkt = av_packet_alloc();
   FFmpegFramePool::ElementPtr return_frame = nullptr;
@@ -713,7 +1342,7 @@ FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const rational& time)
       if (!cache_at_zero_ && (ret == AVERROR_EOF || working_frame->pts > target_ts)) {
 
         seek_ts = qMax(min_seek, seek_ts - second_ts_);
-        instance_.Seek(seek_ts);
+        instance_.Seek(GetSeekTimestamp(seek_ts));
         if (seek_ts == min_seek) {
           cache_at_zero_ = true;
         }
@@ -726,6 +1355,19 @@ FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const rational& time)
       }
     }
 
+    if (!backward_tail.isEmpty()
+        && (ret == AVERROR_EOF || working_frame->pts >= backward_tail.first()->timestamp())) {
+      // We've caught up with the frames we already had, join them back onto the cache. The
+      // decoder is now positioned in the middle of the cache rather than at its end.
+      cached_frames_.append(backward_tail);
+      cache_at_eof_ = backward_tail_at_eof;
+      decoder_at_cache_end_ = false;
+
+      if (!return_frame) {
+        return_frame = GetFrameFromCache(target_ts);
+      }
+      break;
+    }
 
     if (ret == AVERROR_EOF) {
 
@@ -742,27 +1384,17 @@ FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const rational& time)
 
     } else {
 
-      // Cut down to thread count - 1 before we acquire a new frame
-      if (cached_frames_.size() == QThread::idealThreadCount()) {
-        RemoveFirstFrame();
-      }
-
-      FFmpegFramePool::ElementPtr cached = pool_.Get();
-
-      if (!cached) {
-        qCritical() << "Frame pool failed to return a valid frame - out of memory?";
-        break;
+      // Make room for the new frame within our memory budget. When stepping backwards, the frames
+      // furthest from the playhead are at the end of the tail so we drop from there instead.
+      while (cached_frames_.size() + backward_tail.size() >= max_cached_frames_) {
+        if (backward_tail.isEmpty()) {
+          RemoveFirstGOP();
+        } else {
+          RemoveLastGOP(backward_tail);
+          backward_tail_at_eof = false;
+        }
       }
 
-      // Store in queue, converting to native format
-      uint8_t* destination_data = cached->data();
-      int destination_linesize = Frame::generate_linesize_bytes(working_frame->width, native_pix_fmt_, native_channel_count_);
-
-      av_image_copy(&destination_data, &destination_linesize, const_cast<const uint8_t**>(working_frame->data), working_frame->linesize, static_cast<AVPixelFormat>(working_frame->format), working_frame->width, working_frame->height);
-
-      // Set timestamp so this frame can be identified later
-      cached->set_timestamp(working_frame->pts);
-
       // Store frame before just in case
       FFmpegFramePool::ElementPtr previous;
       if (cached_frames_.isEmpty()) {
@@ -771,22 +1403,35 @@ FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const rational& time)
         previous = cached_frames_.last();
       }
 
-      // Append this frame and signal to other threads that a new frame has arrived
-      cached_frames_.append(cached);
+      FFmpegFramePool::ElementPtr cached = CacheDecodedFrame(working_frame);
+
+      if (!cached) {
+        break;
+      }
+
+      if (return_frame) {
+        // Already found our frame, we're only decoding to reach the backward tail (which may
+        // have been evicted entirely in the meantime)
+        if (backward_tail.isEmpty()) {
+          break;
+        }
+        continue;
+      }
 
       // If this is a valid frame, see if this or the frame before it are the one we need
       if (cached->timestamp() == target_ts || time == kAnyTimecode) {
         return_frame = cached;
-        break;
       } else if (cached->timestamp() > target_ts) {
         if (!previous && cache_at_zero_) {
           return_frame = cached;
-          break;
         } else {
           return_frame = previous;
-          break;
         }
       }
+
+      if (return_frame && backward_tail.isEmpty()) {
+        break;
+      }
     }
   }
 
@@ -796,6 +1441,165 @@ FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveFrame(const rational& time)
   return return_frame;
 }
 
+FFmpegFramePool::ElementPtr FFmpegDecoder::RetrieveKeyframe(const rational &time)
+{
+  int64_t target_ts = GetTimeInTimebaseUnits(time, instance_.avstream()->time_base, instance_.avstream()->start_time);
+
+  // Anything we already have decoded around this time is at least as close as a keyframe would be
+  if (!cached_frames_.isEmpty()
+      && target_ts >= cached_frames_.first()->timestamp()
+      && target_ts <= cached_frames_.last()->timestamp()) {
+    FFmpegFramePool::ElementPtr cached_frame = GetFrameFromCache(target_ts);
+    if (cached_frame) {
+      cache_hits_++;
+      return cached_frame;
+    }
+  }
+
+  cache_misses_++;
+
+  // Scrubbing isn't sequential, don't let readahead start on the back of this
+  last_requested_ts_ = AV_NOPTS_VALUE;
+  sequential_requests_ = 0;
+
+  ClearFrameCache();
+
+  instance_.SetKeyframesOnly(true);
+  instance_.Seek(GetSeekTimestamp(target_ts));
+
+  AVPacket* pkt = av_packet_alloc();
+  AVFrame* working_frame = av_frame_alloc();
+  FFmpegFramePool::ElementPtr return_frame = nullptr;
+
+  int ret = GetFilteredFrame(pkt, working_frame);
+  if (ret >= 0) {
+    return_frame = CacheDecodedFrame(working_frame);
+  } else if (ret != AVERROR_EOF) {
+    qCritical() << "Failed to retrieve keyframe:" << ret;
+  }
+
+  av_frame_free(&working_frame);
+  av_packet_free(&pkt);
+
+  instance_.SetKeyframesOnly(false);
+
+  // The codec skipped frames to get here, so nothing can be decoded on from this point. Dropping
+  // the cache makes the next exact request seek again.
+  ClearFrameCache();
+
+  return return_frame;
+}
+
+FFmpegFramePool::ElementPtr FFmpegDecoder::CacheDecodedFrame(AVFrame *working_frame)
+{
+  FFmpegFramePool::ElementPtr cached = pool_.Get();
+
+  if (!cached) {
+    qCritical() << "Frame pool failed to return a valid frame - out of memory?";
+    return nullptr;
+  }
+
+  // Store in queue, converting to native format
+  uint8_t* destination_data = cached->data();
+
+  if (frame_yuv_.IsValid()) {
+    CopyToPlanarYUV(working_frame, frame_yuv_, destination_data,
+                    Frame::generate_linesize_bytes(working_frame->width, frame_yuv_.format(), 1));
+  } else {
+    int destination_linesize = Frame::generate_linesize_bytes(working_frame->width, native_pix_fmt_, native_channel_count_);
+
+    av_image_copy(&destination_data, &destination_linesize, const_cast<const uint8_t**>(working_frame->data), working_frame->linesize, static_cast<AVPixelFormat>(working_frame->format), working_frame->width, working_frame->height);
+  }
+
+  // Set timestamp so this frame can be identified later
+  cached->set_timestamp(working_frame->pts);
+
+  // Remember GOP boundaries so eviction can drop whole GOPs at a time
+  if (working_frame->key_frame) {
+    cached_keyframes_.insert(working_frame->pts);
+  }
+
+  cached_frames_.append(cached);
+
+  return cached;
+}
+
+bool FFmpegDecoder::ReadaheadFrame()
+{
+  // We can only extend the cache if the decoder is sitting at the end of it
+  if (cached_frames_.isEmpty() || !decoder_at_cache_end_ || cache_at_eof_) {
+    return false;
+  }
+
+  // Keep half the cache for frames behind the playhead so stepping backwards still hits
+  int frames_ahead = 0;
+  for (int i=cached_frames_.size()-1; i>=0 && cached_frames_.at(i)->timestamp() > last_requested_ts_; i--) {
+    frames_ahead++;
+  }
+
+  if (frames_ahead >= max_cached_frames_ / 2) {
+    return false;
+  }
+
+  AVPacket* pkt = av_packet_alloc();
+  AVFrame* working_frame = av_frame_alloc();
+
+  int ret = GetFilteredFrame(pkt, working_frame);
+
+  bool success = false;
+
+  if (ret == AVERROR_EOF) {
+    cache_at_eof_ = true;
+  } else if (ret < 0) {
+    qWarning() << "Readahead failed to retrieve frame:" << ret;
+  } else {
+    while (cached_frames_.size() >= max_cached_frames_) {
+      RemoveFirstGOP();
+    }
+
+    success = CacheDecodedFrame(working_frame) != nullptr;
+  }
+
+  av_frame_free(&working_frame);
+  av_packet_free(&pkt);
+
+  return success;
+}
+
+void FFmpegDecoder::Readahead()
+{
+  while (!readahead_cancelled_.load()) {
+    // Wait for the lock in short intervals so that Close() can cancel us while holding it
+    if (!mutex()->tryLock(kReadaheadLockTimeout)) {
+      continue;
+    }
+
+    // Stop as soon as access stops looking sequential or we've filled our share of the cache.
+    // Render threads get the lock between every frame.
+    bool keep_going = (sequential_requests_ >= kReadaheadTrigger && ReadaheadFrame());
+
+    mutex()->unlock();
+
+    if (!keep_going) {
+      break;
+    }
+  }
+}
+
+QThreadPool *FFmpegDecoder::GetReadaheadThreadPool()
+{
+  // Readahead is mostly blocked on I/O and the codec, so it gets its own threads rather than
+  // competing with render jobs in the global pool
+  static QThreadPool pool;
+  static const bool initialized = [](){
+    pool.setMaxThreadCount(HardwareProfile::GetDecodeThreadCount());
+    return true;
+  }();
+  Q_UNUSED(initialized)
+
+  return &pool;
+}
+
 bool FFmpegDecoder::InitScaler(const RetrieveVideoParams& params)
 {
   if (params == filter_params_ && filter_graph_) {
@@ -818,8 +1622,9 @@ bool FFmpegDecoder::InitScaler(const RetrieveVideoParams& params)
 
   AVStream* s = instance_.avstream();
 
-  int src_width = s->codecpar->width;
-  int src_height = s->codecpar->height;
+  // The decoder may already be producing reduced size frames
+  int src_width = instance_.width();
+  int src_height = instance_.height();
 
   // Define filter parameters
   static const int kFilterArgSz = 1024;
@@ -827,7 +1632,7 @@ bool FFmpegDecoder::InitScaler(const RetrieveVideoParams& params)
   snprintf(filter_args, kFilterArgSz, "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
            src_width,
            src_height,
-           s->codecpar->format,
+           instance_.pix_fmt(),
            s->time_base.num,
            s->time_base.den,
            s->codecpar->sample_aspect_ratio.num,
@@ -854,12 +1659,11 @@ bool FFmpegDecoder::InitScaler(const RetrieveVideoParams& params)
   }
 
   // Add scale filter if necessary
-  int dst_width, dst_height;
-  if (filter_params_.divider > 1) {
-    AVFilterContext* scale_filter;
+  int dst_width = VideoParams::GetScaledDimension(s->codecpar->width, filter_params_.divider);
+  int dst_height = VideoParams::GetScaledDimension(s->codecpar->height, filter_params_.divider);
 
-    dst_width = VideoParams::GetScaledDimension(src_width, filter_params_.divider);
-    dst_height = VideoParams::GetScaledDimension(src_height, filter_params_.divider);
+  if (dst_width != src_width || dst_height != src_height) {
+    AVFilterContext* scale_filter;
 
     snprintf(filter_args, kFilterArgSz, "w=%d:h=%d:flags=fast_bilinear:interl=%d",
              dst_width,
@@ -870,16 +1674,26 @@ bool FFmpegDecoder::InitScaler(const RetrieveVideoParams& params)
 
     avfilter_link(last_filter, 0, scale_filter, 0);
     last_filter = scale_filter;
-  } else {
-    dst_width = src_width;
-    dst_height = src_height;
   }
 
+  // Footage already in a YUV layout the renderer understands stays that way, saving the RGB
+  // conversion here and uploading a fraction of the data
+  frame_yuv_ = PlanarYUV();
+  if (params.planar_yuv) {
+    frame_yuv_ = GetPlanarYUV(instance_.pix_fmt(), s->codecpar->color_space, s->codecpar->color_range, s->codecpar->height);
+
+    if (!frame_yuv_.SupportsSize(dst_width, dst_height)) {
+      frame_yuv_ = PlanarYUV();
+    }
+  }
+
+  AVPixelFormat output_pix_fmt = frame_yuv_.IsValid() ? instance_.pix_fmt() : ideal_pix_fmt_;
+
   // Add format filter if necessary
-  if (ideal_pix_fmt_ != s->codecpar->format) {
+  if (output_pix_fmt != instance_.pix_fmt()) {
     AVFilterContext* format_filter;
 
-    snprintf(filter_args, kFilterArgSz, "pix_fmts=%u", ideal_pix_fmt_);
+    snprintf(filter_args, kFilterArgSz, "pix_fmts=%u", output_pix_fmt);
 
     avfilter_graph_create_filter(&format_filter, avfilter_get_by_name("format"), "format", filter_args, nullptr, filter_graph_);
 
@@ -897,11 +1711,25 @@ bool FFmpegDecoder::InitScaler(const RetrieveVideoParams& params)
   }
 
   // Configure frame pool
-  if (pool_.width() != dst_width || pool_.height() != dst_height) {
-    // Set new frame pool parameters
-    pool_.SetParameters(dst_width, dst_height, native_pix_fmt_, native_channel_count_);
+  VideoParams::Format pool_format = native_pix_fmt_;
+  int pool_channels = native_channel_count_;
+  int pool_height = dst_height;
+
+  if (frame_yuv_.IsValid()) {
+    pool_format = frame_yuv_.format();
+    pool_channels = 1;
+    pool_height = frame_yuv_.packed_height(dst_height);
   }
 
+  // Always reset, the layout may have changed without the size changing
+  pool_.SetParameters(dst_width, pool_height, pool_format, pool_channels);
+
+  // Size the frame cache by its share of the memory budget, but always keep enough frames for every
+  // render thread to have one in flight
+  qint64 frame_sz = qint64(Frame::generate_linesize_bytes(dst_width, pool_format, pool_channels)) * pool_height;
+  qint64 budget = MemoryGovernor::GetLimit(QStringLiteral("DecoderCacheSize"));
+  max_cached_frames_ = qMax(HardwareProfile::GetRenderThreadCount(), int(budget / qMax(frame_sz, qint64(1))));
+
   return true;
 }
 
@@ -950,20 +1778,87 @@ FFmpegFramePool::ElementPtr FFmpegDecoder::GetFrameFromCache(const int64_t &t) c
   return nullptr;
 }
 
-void FFmpegDecoder::RemoveFirstFrame()
+void FFmpegDecoder::RemoveFirstGOP()
+{
+  // Remove frames from the front until the next keyframe is at the front. If the cache only
+  // contains one GOP, this falls back to removing a single frame.
+  do {
+    cached_keyframes_.remove(cached_frames_.first()->timestamp());
+    cached_frames_.removeFirst();
+  } while (!cached_frames_.isEmpty()
+           && !cached_keyframes_.isEmpty()
+           && !cached_keyframes_.contains(cached_frames_.first()->timestamp()));
+
+  cache_at_zero_ = false;
+}
+
+void FFmpegDecoder::RemoveLastGOP(QList<FFmpegFramePool::ElementPtr> &frames)
+{
+  // Remove frames from the back up to and including the last keyframe
+  while (!frames.isEmpty()) {
+    int64_t ts = frames.last()->timestamp();
+    frames.removeLast();
+
+    if (cached_keyframes_.remove(ts)) {
+      break;
+    }
+  }
+}
+
+bool FFmpegDecoder::ReopenInstance(const QString &hw_device, int lowres)
 {
-  cached_frames_.removeFirst();
+  // Both the frame cache and the filter graph belong to the current instance
+  cached_frames_.clear();
+  cached_keyframes_.clear();
+  cache_at_eof_ = false;
   cache_at_zero_ = false;
+  decoder_at_cache_end_ = true;
+  FreeScaler();
+
+  instance_.Close();
+
+  // Store these even if the device fails so we don't retry it on every frame
+  instance_hw_device_ = hw_device;
+  instance_lowres_ = lowres;
+
+  QByteArray filename = stream().filename().toUtf8();
+
+  if (!hw_device.isEmpty()) {
+    if (instance_.Open(filename, stream().stream(), hw_device)) {
+      return true;
+    }
+
+    qWarning() << "Falling back to software decoding for" << stream().filename();
+    instance_.Close();
+  }
+
+  return instance_.Open(filename, stream().stream(), QString(), lowres);
+}
+
+int FFmpegDecoder::GetLowresForDivider(int divider)
+{
+  // Each lowres level halves the size, so only use levels that divide evenly into the divider
+  int lowres = 0;
+
+  while (divider % (2 << lowres) == 0) {
+    lowres++;
+  }
+
+  return lowres;
 }
 
 FFmpegDecoder::Instance::Instance() :
   fmt_ctx_(nullptr),
   codec_ctx_(nullptr),
-  opts_(nullptr)
+  opts_(nullptr),
+  hw_device_ctx_(nullptr),
+  hw_pix_fmt_(AV_PIX_FMT_NONE),
+  pix_fmt_(AV_PIX_FMT_NONE),
+  lowres_(0)
 {
 }
 
-bool FFmpegDecoder::Instance::Open(const char *filename, int stream_index)
+bool FFmpegDecoder::Instance::Open(const char *filename, int stream_index, const QString &hw_device, int lowres)
 {
   // Open file in a format context
   int error_code = avformat_open_input(&fmt_ctx_, filename, nullptr, nullptr);
@@ -1014,6 +1909,19 @@ bool FFmpegDecoder::Instance::Open(const char *filename, int stream_index)
     return false;
   }
 
+  pix_fmt_ = static_cast<AVPixelFormat>(avstream_->codecpar->format);
+
+  if (hw_device.isEmpty() && avstream_->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+    lowres_ = qMin(lowres, int(codec->max_lowres));
+    codec_ctx_->lowres = lowres_;
+  }
+
+  if (!hw_device.isEmpty()
+      && avstream_->codecpar->codec_type == AVMEDIA_TYPE_VIDEO
+      && !InitHardwareDevice(codec, hw_device)) {
+    return false;
+  }
+
   // Set multithreading setting
   error_code = av_dict_set(&opts_, "threads", "auto", 0);
 
@@ -1031,6 +1939,79 @@ bool FFmpegDecoder::Instance::Open(const char *filename, int stream_index)
     return false;
   }
 
+  if (hw_device_ctx_) {
+    // Devices transfer frames back in their own layout, so decode one frame to find out what the
+    // filter graph will receive
+    AVPacket* pkt = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+
+    error_code = GetFrame(pkt, frame);
+    if (error_code >= 0) {
+      pix_fmt_ = static_cast<AVPixelFormat>(frame->format);
+    }
+
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+
+    if (error_code < 0) {
+      qWarning() << "Failed to decode with hardware device" << hw_device << FFmpegError(error_code);
+      return false;
+    }
+
+    Seek(0);
+  }
+
+  return true;
+}
+
+AVPixelFormat FFmpegDecoder::Instance::GetHardwarePixelFormat(AVCodecContext *ctx, const AVPixelFormat *pix_fmts)
+{
+  Instance* instance = static_cast<Instance*>(ctx->opaque);
+
+  for (const AVPixelFormat* p = pix_fmts; *p != AV_PIX_FMT_NONE; p++) {
+    if (*p == instance->hw_pix_fmt_) {
+      return *p;
+    }
+  }
+
+  // The device can't handle this stream (e.g. an unsupported profile), let FFmpeg choose instead.
+  // GetFrame() only transfers frames that actually came from the device.
+  return avcodec_default_get_format(ctx, pix_fmts);
+}
+
+bool FFmpegDecoder::Instance::InitHardwareDevice(const AVCodec *codec, const QString &hw_device)
+{
+  AVHWDeviceType type = av_hwdevice_find_type_by_name(hw_device.toUtf8().constData());
+  if (type == AV_HWDEVICE_TYPE_NONE) {
+    qWarning() << "Unknown hardware device type:" << hw_device;
+    return false;
+  }
+
+  for (int i=0; ; i++) {
+    const AVCodecHWConfig* config = avcodec_get_hw_config(codec, i);
+
+    if (!config) {
+      qWarning() << "Codec" << codec->name << "does not support hardware device" << hw_device;
+      return false;
+    }
+
+    if ((config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX) && config->device_type == type) {
+      hw_pix_fmt_ = config->pix_fmt;
+      break;
+    }
+  }
+
+  int error_code = av_hwdevice_ctx_create(&hw_device_ctx_, type, nullptr, nullptr, 0);
+  if (error_code < 0) {
+    qWarning() << "Failed to create hardware device" << hw_device << FFmpegError(error_code);
+    hw_device_ctx_ = nullptr;
+    return false;
+  }
+
+  codec_ctx_->hw_device_ctx = av_buffer_ref(hw_device_ctx_);
+  codec_ctx_->opaque = this;
+  codec_ctx_->get_format = GetHardwarePixelFormat;
+
   return true;
 }
 
@@ -1046,6 +2027,14 @@ void FFmpegDecoder::Instance::Close()
     codec_ctx_ = nullptr;
   }
 
+  if (hw_device_ctx_) {
+    av_buffer_unref(&hw_device_ctx_);
+    hw_device_ctx_ = nullptr;
+  }
+
+  hw_pix_fmt_ = AV_PIX_FMT_NONE;
+  lowres_ = 0;
+
   if (fmt_ctx_) {
     avformat_close_input(&fmt_ctx_);
     fmt_ctx_ = nullptr;
@@ -1094,13 +2083,34 @@ int FFmpegDecoder::Instance::GetFrame(AVPacket *pkt, AVFrame *frame)
     }
   }
 
+  if (ret >= 0 && frame->hw_frames_ctx) {
+    // Frame is still in device memory, download it
+    AVFrame* sw_frame = av_frame_alloc();
+
+    ret = av_hwframe_transfer_data(sw_frame, frame, 0);
+    if (ret >= 0) {
+      av_frame_copy_props(sw_frame, frame);
+      av_frame_unref(frame);
+      av_frame_move_ref(frame, sw_frame);
+    }
+
+    av_frame_free(&sw_frame);
+  }
+
   return ret;
 }
 
 void FFmpegDecoder::Instance::Seek(int64_t timestamp)
 {
+  TRACE_SCOPE("decode", "FFmpegDecoder::Seek");
+
   avcodec_flush_buffers(codec_ctx_);
   av_seek_frame(fmt_ctx_, avstream_->index, timestamp, AVSEEK_FLAG_BACKWARD);
 }
 
+void FFmpegDecoder::Instance::SetKeyframesOnly(bool e)
+{
+  codec_ctx_->skip_frame = e ? AVDISCARD_NONKEY : AVDISCARD_DEFAULT;
+}
+
 }
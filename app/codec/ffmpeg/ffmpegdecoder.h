@@ -32,13 +32,18 @@ extern "C" {
 }
 
 #include <QAtomicInt>
+#include <QFuture>
+#include <QSet>
+#include <QThreadPool>
 #include <QTimer>
 #include <QVector>
 #include <QWaitCondition>
 
 #include "codec/decoder.h"
-#include "codec/waveoutput.h"
+#include "codec/planaraudiofile.h"
 #include "ffmpegframepool.h"
+#include "ffmpegkeyframeindex.h"
+#include "render/planaryuv.h"
 
 namespace olive {
 
@@ -62,13 +67,35 @@ public:
 
   virtual FootageDescription Probe(const QString &filename, const QAtomicInt *cancelled) const override;
 
+  /**
+   * @brief Number of video frame requests served from the decoded frame cache
+   */
+  qint64 GetCacheHits() const
+  {
+    return cache_hits_;
+  }
+
+  /**
+   * @brief Number of video frame requests that required decoding
+   */
+  qint64 GetCacheMisses() const
+  {
+    return cache_misses_;
+  }
+
 protected:
   virtual bool OpenInternal() override;
   virtual FramePtr RetrieveVideoInternal(const rational &timecode, const RetrieveVideoParams& params) override;
-  virtual bool ConformAudioInternal(const QString& filename, const AudioParams &params, const QAtomicInt* cancelled) override;
+  virtual bool ConformAudioInternal(const QVector<ConformOutput>& outputs, const AudioParams &params, const TimeRange &range, const QAtomicInt* cancelled) override;
+  virtual QVector<int> GetConformSiblingStreams() override;
   virtual void CloseInternal() override;
 
 private:
+  /**
+   * @brief Decodes, resamples and writes one stream of a conform, defined in the source file
+   */
+  class AudioConformer;
+
   class Instance
   {
   public:
@@ -79,7 +106,20 @@ private:
       Close();
     }
 
-    bool Open(const char* filename, int stream_index);
+    /**
+     * @brief Open a stream for decoding
+     *
+     * If `hw_device` is not empty, the decoder will attempt to decode on that FFmpeg hardware
+     * device type (e.g. "vaapi", "cuda", "videotoolbox", "d3d11va"). Decoded frames are always
+     * transferred back to system memory, so GetFrame() returns software frames either way. Returns
+     * false if hardware decoding was requested but isn't available for this stream, in which case
+     * the caller can retry without a device.
+     *
+     * `lowres` asks codecs that can decode at a reduced size (e.g. JPEG, JPEG 2000) to decode at
+     * 1/2^lowres of the stream's resolution. It's clamped to what the codec supports and ignored
+     * when decoding on a hardware device. \see width() and height() for the resulting size.
+     */
+    bool Open(const char* filename, int stream_index, const QString& hw_device = QString(), int lowres = 0);
 
     void Close();
 
@@ -94,6 +134,11 @@ private:
 
     void Seek(int64_t timestamp);
 
+    /**
+     * @brief Have the codec skip everything but keyframes
+     */
+    void SetKeyframesOnly(bool e);
+
     AVFormatContext* fmt_ctx() const
     {
       return fmt_ctx_;
@@ -104,12 +149,45 @@ private:
       return avstream_;
     }
 
+    /**
+     * @brief Pixel format of frames returned by GetFrame()
+     *
+     * Usually the same as the stream's format, but hardware devices will usually transfer frames
+     * in their own layout (e.g. NV12 or P010).
+     */
+    AVPixelFormat pix_fmt() const
+    {
+      return pix_fmt_;
+    }
+
+    /**
+     * @brief Dimensions of frames returned by GetFrame()
+     */
+    int width() const
+    {
+      return AV_CEIL_RSHIFT(avstream_->codecpar->width, lowres_);
+    }
+
+    int height() const
+    {
+      return AV_CEIL_RSHIFT(avstream_->codecpar->height, lowres_);
+    }
+
   private:
+    static AVPixelFormat GetHardwarePixelFormat(AVCodecContext* ctx, const AVPixelFormat* pix_fmts);
+
+    bool InitHardwareDevice(const AVCodec* codec, const QString& hw_device);
+
     AVFormatContext* fmt_ctx_;
     AVCodecContext* codec_ctx_;
     AVStream* avstream_;
     AVDictionary* opts_;
 
+    AVBufferRef* hw_device_ctx_;
+    AVPixelFormat hw_pix_fmt_;
+    AVPixelFormat pix_fmt_;
+    int lowres_;
+
   };
 
   int GetFilteredFrame(AVPacket *packet, AVFrame *frame);
@@ -130,6 +208,17 @@ private:
   static VideoParams::Format GetNativePixelFormat(AVPixelFormat pix_fmt);
   static int GetNativeChannelCount(AVPixelFormat pix_fmt);
 
+  /**
+   * @brief Get the PlanarYUV layout frames of this format can be copied into, or an invalid one
+   * if the renderer can't convert it
+   */
+  static PlanarYUV GetPlanarYUV(AVPixelFormat pix_fmt, AVColorSpace colorspace, AVColorRange range, int height);
+
+  /**
+   * @brief Copy a planar or semi-planar YUV frame into a single buffer laid out as `yuv` describes
+   */
+  static void CopyToPlanarYUV(const AVFrame* frame, const PlanarYUV& yuv, uint8_t* dst, int linesize);
+
   static uint64_t ValidateChannelLayout(AVStream *stream);
 
   static const char* GetInterlacingModeInFFmpeg(VideoParams::Interlacing interlacing);
@@ -140,7 +229,37 @@ private:
 
   FFmpegFramePool::ElementPtr RetrieveFrame(const rational &time);
 
-  void RemoveFirstFrame();
+  /**
+   * @brief Decode only the keyframe at or before `time`
+   *
+   * Much cheaper than RetrieveFrame() when the request is far from anything cached, since none of
+   * the frames between the keyframe and `time` are decoded.
+   */
+  FFmpegFramePool::ElementPtr RetrieveKeyframe(const rational &time);
+
+  /**
+   * @brief Get the timestamp to seek to for the frame at `ts`, using the keyframe index if it's ready
+   */
+  int64_t GetSeekTimestamp(int64_t ts);
+
+  FFmpegFramePool::ElementPtr CacheDecodedFrame(AVFrame* working_frame);
+
+  bool ReadaheadFrame();
+
+  void Readahead();
+
+  static QThreadPool* GetReadaheadThreadPool();
+
+  void RemoveFirstGOP();
+
+  void RemoveLastGOP(QList<FFmpegFramePool::ElementPtr>& frames);
+
+  bool ReopenInstance(const QString& hw_device, int lowres);
+
+  /**
+   * @brief Get the codec lowres level that decodes closest to, without going under, a divider
+   */
+  static int GetLowresForDivider(int divider);
 
   RetrieveVideoParams filter_params_;
   AVFilterGraph* filter_graph_;
@@ -150,19 +269,45 @@ private:
   VideoParams::Format native_pix_fmt_;
   int native_channel_count_;
 
+  // Layout of cached frames if the filter graph is leaving them in YUV, invalid if it produces
+  // ideal_pix_fmt_
+  PlanarYUV frame_yuv_;
+
   FFmpegFramePool pool_;
 
   int64_t second_ts_;
 
   QList<FFmpegFramePool::ElementPtr> cached_frames_;
+  QSet<int64_t> cached_keyframes_;
 
   bool is_working_;
   QMutex is_working_mutex_;
 
   bool cache_at_zero_;
   bool cache_at_eof_;
+  bool decoder_at_cache_end_;
+
+  int max_cached_frames_;
+
+  qint64 cache_hits_;
+  qint64 cache_misses_;
+
+  static const int kReadaheadTrigger;
+  static const int kReadaheadLockTimeout;
+
+  int64_t last_requested_ts_;
+  int sequential_requests_;
+
+  QFuture<void> readahead_future_;
+  QAtomicInt readahead_cancelled_;
+
+  // Only long-GOP video is indexed, every frame is a keyframe otherwise
+  bool use_keyframe_index_;
+  FFmpegKeyframeIndexPtr keyframe_index_;
 
   Instance instance_;
+  QString instance_hw_device_;
+  int instance_lowres_;
 
 };
 
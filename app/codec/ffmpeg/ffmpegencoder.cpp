@@ -21,13 +21,17 @@
 #include "ffmpegencoder.h"
 
 extern "C" {
+#include <libavutil/hwcontext.h>
+#include <libavutil/imgutils.h>
 #include <libavutil/pixdesc.h>
 }
 
 #include <QFile>
+#include <QtConcurrent/QtConcurrent>
 
 #include "common/ffmpegutils.h"
 #include "common/timecodefunctions.h"
+#include "common/tracing.h"
 
 namespace olive {
 
@@ -36,11 +40,13 @@ FFmpegEncoder::FFmpegEncoder(const EncodingParams &params) :
   fmt_ctx_(nullptr),
   video_stream_(nullptr),
   video_codec_ctx_(nullptr),
-  video_alpha_scale_ctx_(nullptr),
-  video_noalpha_scale_ctx_(nullptr),
+  video_sw_pix_fmt_(AV_PIX_FMT_NONE),
+  video_src_alpha_pix_fmt_(AV_PIX_FMT_NONE),
+  video_src_noalpha_pix_fmt_(AV_PIX_FMT_NONE),
+  video_frames_sent_(0),
+  video_packets_written_(0),
   audio_stream_(nullptr),
   audio_codec_ctx_(nullptr),
-  audio_resample_ctx_(nullptr),
   audio_frame_(nullptr),
   open_(false)
 {
@@ -77,6 +83,16 @@ QStringList FFmpegEncoder::GetPixelFormatsForCodec(ExportCodec::Codec c) const
   case ExportCodec::kCodecTIFF:
     codec_info = avcodec_find_encoder(AV_CODEC_ID_TIFF);
     break;
+  case ExportCodec::kCodecH264NVENC:
+  case ExportCodec::kCodecH265NVENC:
+  case ExportCodec::kCodecH264QSV:
+  case ExportCodec::kCodecH265QSV:
+  case ExportCodec::kCodecH264VAAPI:
+  case ExportCodec::kCodecH265VAAPI:
+  case ExportCodec::kCodecH264VideoToolbox:
+  case ExportCodec::kCodecH265VideoToolbox:
+    codec_info = avcodec_find_encoder_by_name(ExportCodec::GetHardwareEncoderName(c));
+    break;
   case ExportCodec::kCodecMP2:
   case ExportCodec::kCodecMP3:
   case ExportCodec::kCodecAAC:
@@ -92,9 +108,22 @@ QStringList FFmpegEncoder::GetPixelFormatsForCodec(ExportCodec::Codec c) const
 
   if (codec_info) {
     for (int i=0; codec_info->pix_fmts[i]!=-1; i++) {
+      // Device formats aren't user selectable, frames are uploaded to them from a software format
+      if (av_pix_fmt_desc_get(codec_info->pix_fmts[i])->flags & AV_PIX_FMT_FLAG_HWACCEL) {
+        continue;
+      }
+
       const char* pix_fmt_name = av_get_pix_fmt_name(codec_info->pix_fmts[i]);
       pix_fmts.append(pix_fmt_name);
     }
+
+    if (pix_fmts.isEmpty() && ExportCodec::GetHardwareEncoderName(c)) {
+      // This encoder only takes device frames (e.g. VA-API), offer the formats we can upload from
+      pix_fmts.append(QStringLiteral("nv12"));
+      if (ExportCodec::GetBaseCodec(c) == ExportCodec::kCodecH265) {
+        pix_fmts.append(QStringLiteral("p010le"));
+      }
+    }
   }
 
   return pix_fmts;
@@ -145,32 +174,15 @@ bool FFmpegEncoder::Open()
       return false;
     }
 
-    // This is the pixel format the encoder wants to encode to
-    AVPixelFormat encoder_pix_fmt = video_codec_ctx_->pix_fmt;
+    video_src_alpha_pix_fmt_ = src_alpha_pix_fmt;
+    video_src_noalpha_pix_fmt_ = src_noalpha_pix_fmt;
 
-    // Set up a scaling context - if the native pixel format is not equal to the encoder's, we'll need to convert it
+    // Set up a scaling context for each kind of input up front - if the native pixel format is not
+    // equal to the encoder's (or the device encoder's upload format), we'll need to convert it
     // before encoding. Even if we don't, this may be useful for converting between linesizes, etc.
-    video_alpha_scale_ctx_ = sws_getContext(params().video_params().width(),
-                                            params().video_params().height(),
-                                            src_alpha_pix_fmt,
-                                            params().video_params().width(),
-                                            params().video_params().height(),
-                                            encoder_pix_fmt,
-                                            0,
-                                            nullptr,
-                                            nullptr,
-                                            nullptr);
-
-    video_noalpha_scale_ctx_ = sws_getContext(params().video_params().width(),
-                                              params().video_params().height(),
-                                              src_noalpha_pix_fmt,
-                                              params().video_params().width(),
-                                              params().video_params().height(),
-                                              encoder_pix_fmt,
-                                              0,
-                                              nullptr,
-                                              nullptr,
-                                              nullptr);
+    // More are created as needed when frames are converted in parallel.
+    ReleaseScaleContext(true, AcquireScaleContext(true));
+    ReleaseScaleContext(false, AcquireScaleContext(false));
   }
 
   // Initialize an audio stream if it's enabled
@@ -209,18 +221,48 @@ bool FFmpegEncoder::Open()
 
 bool FFmpegEncoder::WriteFrame(FramePtr frame, rational time)
 {
-  bool success = false;
+  TRACE_SCOPE("encode", "FFmpegEncoder::WriteFrame");
+
+  // Don't let conversions run further ahead of the encoder than the pool can keep busy
+  while (int(video_conversions_.size()) >= video_convert_pool_.maxThreadCount() * 2) {
+    if (!EncodeNextConvertedFrame()) {
+      return false;
+    }
+  }
 
-  AVFrame* encoded_frame = av_frame_alloc();
+  video_conversions_.push_back(QtConcurrent::run(&video_convert_pool_, [this, frame, time]{
+    return ConvertFrame(frame, time);
+  }));
+
+  // Encode anything that's ready now so the codec isn't left waiting
+  while (!video_conversions_.empty() && video_conversions_.front().isFinished()) {
+    if (!EncodeNextConvertedFrame()) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+FFmpegEncoder::ConvertedFrame FFmpegEncoder::ConvertFrame(FramePtr frame, const rational &time)
+{
+  TRACE_SCOPE("encode", "FFmpegEncoder::ConvertFrame");
+
+  ConvertedFrame converted;
+  converted.frame = av_frame_alloc();
+  converted.error_code = 0;
+
+  AVFrame* encoded_frame = converted.frame;
 
-  int error_code;
   const char* input_data;
   int input_linesize;
+  bool alpha;
+  SwsContext* scale_ctx;
 
   // Frame must be video
   encoded_frame->width = frame->width();
-  encoded_frame->height = frame->height();
-  encoded_frame->format = video_codec_ctx_->pix_fmt;
+  encoded_frame->height = frame->planar_yuv().IsValid() ? frame->planar_yuv().picture_height(frame->height()) : frame->height();
+  encoded_frame->format = video_sw_pix_fmt_;
 
   // Set interlacing
   if (frame->video_params().interlacing() != VideoParams::kInterlaceNone) {
@@ -233,12 +275,40 @@ bool FFmpegEncoder::WriteFrame(FramePtr frame, rational time)
     }
   }
 
-  error_code = av_frame_get_buffer(encoded_frame, 0);
-  if (error_code < 0) {
-    FFmpegError(tr("Failed to create AVFrame buffer"), error_code);
+  converted.error_code = av_frame_get_buffer(encoded_frame, 0);
+  if (converted.error_code < 0) {
+    converted.error_context = tr("Failed to create AVFrame buffer");
     goto fail;
   }
 
+  if (frame->planar_yuv().IsValid()) {
+    // Already converted on the GPU, just copy the planes out of the packed buffer
+    const PlanarYUV& yuv = frame->planar_yuv();
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(frame->const_data());
+    int src_linesize = frame->linesize_bytes();
+    int bytes_per_sample = VideoParams::GetBytesPerChannel(yuv.format());
+    int chroma_width = yuv.chroma_width(encoded_frame->width);
+    int chroma_height = yuv.chroma_height(encoded_frame->height);
+
+    av_image_copy_plane(encoded_frame->data[0], encoded_frame->linesize[0],
+                        src, src_linesize,
+                        encoded_frame->width * bytes_per_sample, encoded_frame->height);
+
+    src += src_linesize * encoded_frame->height;
+
+    av_image_copy_plane(encoded_frame->data[1], encoded_frame->linesize[1],
+                        src, src_linesize,
+                        chroma_width * bytes_per_sample, chroma_height);
+
+    av_image_copy_plane(encoded_frame->data[2], encoded_frame->linesize[2],
+                        src + chroma_width * bytes_per_sample, src_linesize,
+                        chroma_width * bytes_per_sample, chroma_height);
+
+    encoded_frame->pts = qRound64(time.toDouble() / av_q2d(video_codec_ctx_->time_base));
+
+    return converted;
+  }
+
   // We may need to convert this frame to a frame that swscale will understand
   if (frame->format() != video_conversion_fmt_) {
     frame = frame->convert(video_conversion_fmt_);
@@ -248,32 +318,323 @@ bool FFmpegEncoder::WriteFrame(FramePtr frame, rational time)
   input_data = frame->const_data();
   input_linesize = frame->linesize_bytes();
 
-  error_code = sws_scale((frame->channel_count() == VideoParams::kRGBAChannelCount) ? video_alpha_scale_ctx_ : video_noalpha_scale_ctx_,
-                         reinterpret_cast<const uint8_t**>(&input_data),
-                         &input_linesize,
-                         0,
-                         frame->height(),
-                         encoded_frame->data,
-                         encoded_frame->linesize);
+  alpha = (frame->channel_count() == VideoParams::kRGBAChannelCount);
+  scale_ctx = AcquireScaleContext(alpha);
+  if (!scale_ctx) {
+    converted.error_code = AVERROR(ENOMEM);
+    converted.error_context = tr("Failed to create scaling context");
+    goto fail;
+  }
 
+  converted.error_code = sws_scale(scale_ctx,
+                                   reinterpret_cast<const uint8_t**>(&input_data),
+                                   &input_linesize,
+                                   0,
+                                   frame->height(),
+                                   encoded_frame->data,
+                                   encoded_frame->linesize);
 
-  if (error_code < 0) {
-    FFmpegError(tr("Failed to scale frame"), error_code);
+  ReleaseScaleContext(alpha, scale_ctx);
+
+  if (converted.error_code < 0) {
+    converted.error_context = tr("Failed to scale frame");
     goto fail;
   }
 
   encoded_frame->pts = qRound64(time.toDouble() / av_q2d(video_codec_ctx_->time_base));
 
-  success = WriteAVFrame(encoded_frame, video_codec_ctx_, video_stream_);
+  return converted;
 
 fail:
+  av_frame_free(&converted.frame);
+
+  return converted;
+}
+
+bool FFmpegEncoder::EncodeNextConvertedFrame()
+{
+  ConvertedFrame converted = video_conversions_.front().result();
+  video_conversions_.pop_front();
+
+  if (!converted.frame) {
+    FFmpegError(converted.error_context, converted.error_code);
+    return false;
+  }
+
+  AVFrame* encoded_frame = converted.frame;
+
+  if (video_codec_ctx_->hw_frames_ctx) {
+    // Encoder only takes device frames, upload the converted frame
+    AVFrame* hw_frame = av_frame_alloc();
+
+    int error_code = av_hwframe_get_buffer(video_codec_ctx_->hw_frames_ctx, hw_frame, 0);
+    if (error_code >= 0) {
+      error_code = av_hwframe_transfer_data(hw_frame, encoded_frame, 0);
+    }
+
+    if (error_code < 0) {
+      av_frame_free(&hw_frame);
+      av_frame_free(&encoded_frame);
+      FFmpegError(tr("Failed to upload frame to hardware encoder"), error_code);
+      return false;
+    }
+
+    av_frame_copy_props(hw_frame, encoded_frame);
+    av_frame_free(&encoded_frame);
+    encoded_frame = hw_frame;
+  }
+
+  bool success = WriteAVFrame(encoded_frame, video_codec_ctx_, video_stream_);
+
   av_frame_free(&encoded_frame);
 
   return success;
 }
 
+PlanarYUV FFmpegEncoder::GetDesiredPlanarYUV() const
+{
+  // Interlaced chroma has to be subsampled per field, which the packing shader doesn't do
+  if (!video_codec_ctx_ || params().video_params().interlacing() != VideoParams::kInterlaceNone) {
+    return PlanarYUV();
+  }
+
+  switch (video_sw_pix_fmt_) {
+  case AV_PIX_FMT_YUV420P:
+    return PlanarYUV(GetYUVMatrix(), PlanarYUV::k420, 8);
+  case AV_PIX_FMT_YUV422P:
+    return PlanarYUV(GetYUVMatrix(), PlanarYUV::k422, 8);
+  case AV_PIX_FMT_YUV420P10:
+    return PlanarYUV(GetYUVMatrix(), PlanarYUV::k420, 10);
+  case AV_PIX_FMT_YUV422P10:
+    return PlanarYUV(GetYUVMatrix(), PlanarYUV::k422, 10);
+  default:
+    return PlanarYUV();
+  }
+}
+
+bool FFmpegEncoder::IsEncodingYUV() const
+{
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(video_sw_pix_fmt_);
+
+  return desc && !(desc->flags & AV_PIX_FMT_FLAG_RGB) && desc->nb_components >= 3;
+}
+
+PlanarYUV::Matrix FFmpegEncoder::GetYUVMatrix() const
+{
+  return (params().video_params().height() > 576) ? PlanarYUV::kRec709 : PlanarYUV::kRec601;
+}
+
+SwsContext *FFmpegEncoder::AcquireScaleContext(bool alpha)
+{
+  {
+    QMutexLocker locker(&video_scale_ctx_lock_);
+
+    QVector<SwsContext*>& idle = alpha ? video_alpha_scale_ctxs_ : video_noalpha_scale_ctxs_;
+    if (!idle.isEmpty()) {
+      return idle.takeLast();
+    }
+  }
+
+  // Contexts can't be shared between threads, so every concurrent conversion needs its own
+  SwsContext* ctx = sws_getContext(params().video_params().width(),
+                                   params().video_params().height(),
+                                   alpha ? video_src_alpha_pix_fmt_ : video_src_noalpha_pix_fmt_,
+                                   params().video_params().width(),
+                                   params().video_params().height(),
+                                   video_sw_pix_fmt_,
+                                   0,
+                                   nullptr,
+                                   nullptr,
+                                   nullptr);
+
+  if (ctx && IsEncodingYUV()) {
+    // Match the matrix the stream is tagged with (and that GPU packed frames use)
+    int colorspace = (GetYUVMatrix() == PlanarYUV::kRec709) ? SWS_CS_ITU709 : SWS_CS_ITU601;
+    sws_setColorspaceDetails(ctx,
+                             sws_getCoefficients(SWS_CS_DEFAULT), 1,
+                             sws_getCoefficients(colorspace), 0,
+                             0, 1 << 16, 1 << 16);
+  }
+
+  return ctx;
+}
+
+void FFmpegEncoder::ReleaseScaleContext(bool alpha, SwsContext *ctx)
+{
+  QMutexLocker locker(&video_scale_ctx_lock_);
+
+  (alpha ? video_alpha_scale_ctxs_ : video_noalpha_scale_ctxs_).append(ctx);
+}
+
+bool FFmpegEncoder::CanPassthrough(const QString &filename, int stream)
+{
+  PassthroughSource* source = GetPassthroughSource(filename, stream);
+
+  return source && source->compatible;
+}
+
+bool FFmpegEncoder::WritePassthroughFrame(const QString &filename, int stream, const rational &source_time, const rational &time)
+{
+  TRACE_SCOPE("encode", "FFmpegEncoder::WritePassthroughFrame");
+
+  // Frames still being converted come before this one
+  while (!video_conversions_.empty()) {
+    if (!EncodeNextConvertedFrame()) {
+      return false;
+    }
+  }
+
+  PassthroughSource* source = GetPassthroughSource(filename, stream);
+
+  if (!source || !source->compatible || !ReadPassthroughPacket(source, stream, source_time)) {
+    SetError(tr("Failed to copy frame from \"%1\"").arg(filename));
+    return false;
+  }
+
+  AVPacket* pkt = av_packet_clone(source->packet);
+
+  pkt->stream_index = video_stream_->index;
+  pkt->pts = qRound64(time.toDouble() / av_q2d(video_codec_ctx_->time_base));
+  pkt->dts = pkt->pts;
+  pkt->duration = qRound64(params().video_params().frame_rate_as_time_base().toDouble() / av_q2d(video_codec_ctx_->time_base));
+  pkt->pos = -1;
+  pkt->flags |= AV_PKT_FLAG_KEY;
+
+  av_packet_rescale_ts(pkt, video_codec_ctx_->time_base, video_stream_->time_base);
+
+  passthrough_queue_.push_back({pkt, video_frames_sent_});
+
+  return WriteQueuedPassthroughPackets(false);
+}
+
+FFmpegEncoder::PassthroughSource *FFmpegEncoder::GetPassthroughSource(const QString &filename, int stream)
+{
+  QPair<QString, int> key(filename, stream);
+
+  auto it = passthrough_sources_.find(key);
+  if (it != passthrough_sources_.end()) {
+    return &it.value();
+  }
+
+  if (!video_codec_ctx_ || !ExportCodec::IsCodecIntraOnly(params().video_codec())) {
+    return nullptr;
+  }
+
+  PassthroughSource source;
+  source.fmt_ctx = nullptr;
+  source.compatible = false;
+  source.packet = nullptr;
+
+  QByteArray filename_bytes = filename.toUtf8();
+
+  if (avformat_open_input(&source.fmt_ctx, filename_bytes.constData(), nullptr, nullptr) >= 0
+      && avformat_find_stream_info(source.fmt_ctx, nullptr) >= 0
+      && stream >= 0 && stream < int(source.fmt_ctx->nb_streams)) {
+    // Every frame of an intra-only codec decodes on its own, so frames can be copied one by one as
+    // long as they're exactly what the encoder would have produced a stream of
+    AVCodecParameters* codecpar = source.fmt_ctx->streams[stream]->codecpar;
+
+    source.compatible = codecpar->codec_type == AVMEDIA_TYPE_VIDEO
+        && codecpar->codec_id == video_codec_ctx_->codec_id
+        && codecpar->format == video_sw_pix_fmt_
+        && codecpar->width == video_codec_ctx_->width
+        && codecpar->height == video_codec_ctx_->height;
+  }
+
+  if (!source.compatible && source.fmt_ctx) {
+    // No need to keep the file open
+    avformat_close_input(&source.fmt_ctx);
+  }
+
+  return &passthrough_sources_.insert(key, source).value();
+}
+
+bool FFmpegEncoder::ReadPassthroughPacket(PassthroughSource *source, int stream, const rational &time)
+{
+  AVStream* s = source->fmt_ctx->streams[stream];
+
+  int64_t start_time = (s->start_time == AV_NOPTS_VALUE) ? 0 : s->start_time;
+  int64_t target = Timecode::time_to_timestamp(time, s->time_base) + start_time;
+
+  if (source->packet) {
+    int64_t pts = source->packet->pts;
+
+    if (target >= pts && target < pts + qMax(source->packet->duration, int64_t(1))) {
+      // Same frame as last time, e.g. a hold or a slowed down clip
+      return true;
+    }
+
+    av_packet_free(&source->packet);
+
+    // Reading forward is cheaper than seeking as long as the frame is close, seek otherwise
+    if (target < pts || target - pts > av_rescale_q(1, AVRational{1, 1}, s->time_base)) {
+      av_seek_frame(source->fmt_ctx, stream, target, AVSEEK_FLAG_BACKWARD);
+    }
+  } else {
+    av_seek_frame(source->fmt_ctx, stream, target, AVSEEK_FLAG_BACKWARD);
+  }
+
+  AVPacket* pkt = av_packet_alloc();
+
+  while (av_read_frame(source->fmt_ctx, pkt) >= 0) {
+    if (pkt->stream_index == stream) {
+      if (pkt->pts == AV_NOPTS_VALUE) {
+        pkt->pts = pkt->dts;
+      }
+
+      // Take the packet showing at the target, or the first one after it if there's a gap
+      if (pkt->pts + qMax(pkt->duration, int64_t(1)) > target) {
+        source->packet = pkt;
+        return true;
+      }
+    }
+
+    av_packet_unref(pkt);
+  }
+
+  av_packet_free(&pkt);
+
+  return false;
+}
+
+bool FFmpegEncoder::WriteQueuedPassthroughPackets(bool flush)
+{
+  while (!passthrough_queue_.empty()
+         && (flush || passthrough_queue_.front().frames_before <= video_packets_written_)) {
+    AVPacket* pkt = passthrough_queue_.front().packet;
+    passthrough_queue_.pop_front();
+
+    int error_code = av_interleaved_write_frame(fmt_ctx_, pkt);
+    av_packet_free(&pkt);
+
+    if (error_code < 0) {
+      FFmpegError(tr("Failed to write interleaved packet"), error_code);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void FFmpegEncoder::ClosePassthroughSources()
+{
+  foreach (const QueuedPassthroughPacket& queued, passthrough_queue_) {
+    AVPacket* pkt = queued.packet;
+    av_packet_free(&pkt);
+  }
+  passthrough_queue_.clear();
+
+  for (auto it=passthrough_sources_.begin(); it!=passthrough_sources_.end(); it++) {
+    av_packet_free(&it->packet);
+    avformat_close_input(&it->fmt_ctx);
+  }
+  passthrough_sources_.clear();
+}
+
 bool FFmpegEncoder::WriteAudio(SampleBufferPtr audio)
 {
+  TRACE_SCOPE("encode", "FFmpegEncoder::WriteAudio");
+
   if (!InitializeResampleContext(audio)) {
     qCritical() << "Failed to initialize resample context";
     return false;
@@ -297,14 +658,14 @@ bool FFmpegEncoder::WriteAudio(SampleBufferPtr audio)
   }
 
   // Create output buffer
-  int output_sample_count = input_sample_count ? swr_get_out_samples(audio_resample_ctx_, input_sample_count) : 102400;
+  int output_sample_count = input_sample_count ? audio_resampler_.GetOutSamples(input_sample_count) : 102400;
   uint8_t** output_data = nullptr;
   int output_linesize;
   av_samples_alloc_array_and_samples(&output_data, &output_linesize, audio_stream_->codecpar->channels,
                                      output_sample_count, static_cast<AVSampleFormat>(audio_stream_->codecpar->format), 0);
 
   // Perform conversion
-  int converted = swr_convert(audio_resample_ctx_, output_data, output_sample_count, const_cast<const uint8_t**>(input_data), input_sample_count);
+  int converted = audio_resampler_.Convert(output_data, output_sample_count, const_cast<const uint8_t**>(input_data), input_sample_count);
   if (converted > 0) {
     // Split sample buffer into frames
     for (int i=0; i<converted; ) {
@@ -371,7 +732,7 @@ QString GetAssTime(const rational &time)
       );
 }
 
-bool FFmpegEncoder::WriteSubtitle(const SubtitleBlock *sub_block)
+bool FFmpegEncoder::WriteSubtitle(const SubtitleCue &cue)
 {
   AVSubtitle subtitle;
   memset(&subtitle, 0, sizeof(subtitle));
@@ -380,12 +741,12 @@ bool FFmpegEncoder::WriteSubtitle(const SubtitleBlock *sub_block)
   memset(&rect, 0, sizeof(rect));
 
   QString ass_line = QStringLiteral("Dialogue: 0,%1,%2,Default,,0,0,0,,%3").arg(
-        GetAssTime(sub_block->in()),
-        GetAssTime(sub_block->out()),
-        sub_block->GetText()
+        GetAssTime(cue.time().in()),
+        GetAssTime(cue.time().out()),
+        cue.text()
       );
 
-  QByteArray utf8_sub = sub_block->GetText().toUtf8();
+  QByteArray utf8_sub = cue.text().toUtf8();
   QByteArray utf8_ass = ass_line.toUtf8();
 
   rect.type = SUBTITLE_ASS;
@@ -396,8 +757,8 @@ bool FFmpegEncoder::WriteSubtitle(const SubtitleBlock *sub_block)
   subtitle.num_rects = 1;
   subtitle.rects = &rect_array;
 
-  subtitle.pts = Timecode::time_to_timestamp(sub_block->in(), av_get_time_base_q(), true);
-  subtitle.end_display_time = qRound64(sub_block->length().toDouble() * 1000);
+  subtitle.pts = Timecode::time_to_timestamp(cue.time().in(), av_get_time_base_q(), true);
+  subtitle.end_display_time = qRound64(cue.time().length().toDouble() * 1000);
 
   QVector<uint8_t> out_buf(1024 * 1024);
 
@@ -491,6 +852,11 @@ void FFmpegEncoder::WriteAudio(AudioParams pcm_info, QIODevice* file)
 
 void FFmpegEncoder::Close()
 {
+  // Encode frames still in the conversion pipeline
+  while (!video_conversions_.empty()) {
+    EncodeNextConvertedFrame();
+  }
+
   if (open_) {
     // Flush encoders
     FlushEncoders();
@@ -502,25 +868,24 @@ void FFmpegEncoder::Close()
     open_ = false;
   }
 
-  if (audio_resample_ctx_) {
-    swr_init(audio_resample_ctx_);
-    audio_resample_ctx_ = nullptr;
-  }
+  audio_resampler_.Close();
 
   if (audio_frame_) {
     av_frame_free(&audio_frame_);
     audio_frame_ = nullptr;
   }
 
-  if (video_alpha_scale_ctx_) {
-    sws_freeContext(video_alpha_scale_ctx_);
-    video_alpha_scale_ctx_ = nullptr;
+  ClosePassthroughSources();
+
+  foreach (SwsContext* ctx, video_alpha_scale_ctxs_) {
+    sws_freeContext(ctx);
   }
+  video_alpha_scale_ctxs_.clear();
 
-  if (video_noalpha_scale_ctx_) {
-    sws_freeContext(video_noalpha_scale_ctx_);
-    video_noalpha_scale_ctx_ = nullptr;
+  foreach (SwsContext* ctx, video_noalpha_scale_ctxs_) {
+    sws_freeContext(ctx);
   }
+  video_noalpha_scale_ctxs_.clear();
 
   if (video_codec_ctx_) {
     avcodec_free_context(&video_codec_ctx_);
@@ -541,6 +906,211 @@ void FFmpegEncoder::Close()
   }
 }
 
+bool FFmpegEncoder::ConcatenateSegments(const QStringList &segments, const QString &extra_streams, const QString &output, QString *error)
+{
+  AVFormatContext* out_ctx = nullptr;
+  AVFormatContext* video_ctx = nullptr;
+  AVFormatContext* extra_ctx = nullptr;
+  AVStream* out_video_stream = nullptr;
+  QVector<AVStream*> out_extra_streams;
+  AVPacket* video_pkt = av_packet_alloc();
+  AVPacket* extra_pkt = av_packet_alloc();
+  bool have_video_pkt = false;
+  bool have_extra_pkt = false;
+  int video_index = -1;
+  int segment = 0;
+  int64_t segment_offset = 0;
+  int64_t segment_end = 0;
+  int64_t frame_duration = 0;
+  bool success = false;
+  int error_code;
+  QByteArray output_bytes = output.toUtf8();
+
+  error->clear();
+
+  // Opens the next segment, returning false when there are none left
+  auto open_segment = [&]() -> bool {
+    if (video_ctx) {
+      avformat_close_input(&video_ctx);
+    }
+
+    if (segment == segments.size()) {
+      return false;
+    }
+
+    QByteArray segment_bytes = segments.at(segment).toUtf8();
+    segment++;
+
+    if (avformat_open_input(&video_ctx, segment_bytes.constData(), nullptr, nullptr) < 0
+        || avformat_find_stream_info(video_ctx, nullptr) < 0) {
+      *error = tr("Failed to open segment \"%1\"").arg(segments.at(segment - 1));
+      return false;
+    }
+
+    video_index = av_find_best_stream(video_ctx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (video_index < 0) {
+      *error = tr("Segment \"%1\" has no video").arg(segments.at(segment - 1));
+      return false;
+    }
+
+    return true;
+  };
+
+  // Reads the next video packet, moving on to the next segment when this one runs out
+  auto read_video = [&]() -> bool {
+    while (video_ctx) {
+      if (av_read_frame(video_ctx, video_pkt) < 0) {
+        // This segment is done, continue the next one where it ended
+        segment_offset = segment_end;
+
+        if (!open_segment()) {
+          return false;
+        }
+
+        continue;
+      }
+
+      if (video_pkt->stream_index != video_index) {
+        av_packet_unref(video_pkt);
+        continue;
+      }
+
+      av_packet_rescale_ts(video_pkt, video_ctx->streams[video_index]->time_base, out_video_stream->time_base);
+
+      if (video_pkt->duration <= 0) {
+        video_pkt->duration = frame_duration;
+      }
+
+      video_pkt->pts += segment_offset;
+      video_pkt->dts += segment_offset;
+      video_pkt->stream_index = out_video_stream->index;
+      segment_end = qMax(segment_end, video_pkt->pts + video_pkt->duration);
+      return true;
+    }
+
+    return false;
+  };
+
+  auto read_extra = [&]() -> bool {
+    if (!extra_ctx || av_read_frame(extra_ctx, extra_pkt) < 0) {
+      return false;
+    }
+
+    AVStream* out_stream = out_extra_streams.at(extra_pkt->stream_index);
+    av_packet_rescale_ts(extra_pkt, extra_ctx->streams[extra_pkt->stream_index]->time_base, out_stream->time_base);
+    extra_pkt->stream_index = out_stream->index;
+    return true;
+  };
+
+  error_code = avformat_alloc_output_context2(&out_ctx, nullptr, nullptr, output_bytes.constData());
+  if (error_code < 0) {
+    *error = tr("Failed to allocate output context");
+    goto fail;
+  }
+
+  // Use the first segment to set up the output video stream
+  if (!open_segment()) {
+    goto fail;
+  }
+
+  {
+    AVStream* in_stream = video_ctx->streams[video_index];
+
+    out_video_stream = avformat_new_stream(out_ctx, nullptr);
+    avcodec_parameters_copy(out_video_stream->codecpar, in_stream->codecpar);
+    out_video_stream->codecpar->codec_tag = 0;
+    out_video_stream->time_base = in_stream->time_base;
+    out_video_stream->avg_frame_rate = in_stream->avg_frame_rate;
+    out_video_stream->sample_aspect_ratio = in_stream->sample_aspect_ratio;
+  }
+
+  if (!extra_streams.isEmpty()) {
+    QByteArray extra_bytes = extra_streams.toUtf8();
+
+    if (avformat_open_input(&extra_ctx, extra_bytes.constData(), nullptr, nullptr) < 0
+        || avformat_find_stream_info(extra_ctx, nullptr) < 0) {
+      *error = tr("Failed to open \"%1\"").arg(extra_streams);
+      goto fail;
+    }
+
+    for (unsigned int i=0; i<extra_ctx->nb_streams; i++) {
+      AVStream* in_stream = extra_ctx->streams[i];
+      AVStream* out_stream = avformat_new_stream(out_ctx, nullptr);
+      avcodec_parameters_copy(out_stream->codecpar, in_stream->codecpar);
+      out_stream->codecpar->codec_tag = 0;
+      out_stream->time_base = in_stream->time_base;
+      out_extra_streams.append(out_stream);
+    }
+  }
+
+  error_code = avio_open(&out_ctx->pb, output_bytes.constData(), AVIO_FLAG_WRITE);
+  if (error_code < 0) {
+    *error = tr("Failed to open \"%1\" for writing").arg(output);
+    goto fail;
+  }
+
+  error_code = avformat_write_header(out_ctx, nullptr);
+  if (error_code < 0) {
+    *error = tr("Failed to write format header");
+    goto fail;
+  }
+
+  // Muxer may have changed the stream's time base
+  frame_duration = av_rescale_q(1, av_inv_q(video_ctx->streams[video_index]->avg_frame_rate), out_video_stream->time_base);
+
+  have_video_pkt = read_video();
+  have_extra_pkt = read_extra();
+
+  while (have_video_pkt || have_extra_pkt) {
+    // Write whichever is due first so the muxer doesn't need to buffer very much
+    bool write_video = have_video_pkt
+        && (!have_extra_pkt
+            || av_compare_ts(video_pkt->dts, out_video_stream->time_base,
+                             extra_pkt->dts, out_ctx->streams[extra_pkt->stream_index]->time_base) <= 0);
+
+    error_code = av_interleaved_write_frame(out_ctx, write_video ? video_pkt : extra_pkt);
+    if (error_code < 0) {
+      *error = tr("Failed to write interleaved packet");
+      goto fail;
+    }
+
+    if (write_video) {
+      have_video_pkt = read_video();
+    } else {
+      have_extra_pkt = read_extra();
+    }
+  }
+
+  if (!error->isEmpty()) {
+    // A segment failed to open partway through
+    goto fail;
+  }
+
+  av_write_trailer(out_ctx);
+  success = true;
+
+fail:
+  av_packet_free(&video_pkt);
+  av_packet_free(&extra_pkt);
+
+  if (video_ctx) {
+    avformat_close_input(&video_ctx);
+  }
+
+  if (extra_ctx) {
+    avformat_close_input(&extra_ctx);
+  }
+
+  if (out_ctx) {
+    if (out_ctx->pb) {
+      avio_closep(&out_ctx->pb);
+    }
+    avformat_free_context(out_ctx);
+  }
+
+  return success;
+}
+
 void FFmpegEncoder::FFmpegError(const QString& context, int error_code)
 {
   char err[1024];
@@ -560,6 +1130,10 @@ bool FFmpegEncoder::WriteAVFrame(AVFrame *frame, AVCodecContext* codec_ctx, AVSt
     return false;
   }
 
+  if (codec_ctx == video_codec_ctx_) {
+    video_frames_sent_++;
+  }
+
   bool succeeded = false;
 
   AVPacket* pkt = av_packet_alloc();
@@ -590,6 +1164,14 @@ bool FFmpegEncoder::WriteAVFrame(AVFrame *frame, AVCodecContext* codec_ctx, AVSt
 
     // Unref packet in case we're getting another
     av_packet_unref(pkt);
+
+    if (codec_ctx == video_codec_ctx_) {
+      video_packets_written_++;
+
+      if (!WriteQueuedPassthroughPackets(false)) {
+        goto fail;
+      }
+    }
   }
 
   succeeded = true;
@@ -624,9 +1206,17 @@ bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AV
     codec_id = AV_CODEC_ID_MP3;
     break;
   case ExportCodec::kCodecH264:
+  case ExportCodec::kCodecH264NVENC:
+  case ExportCodec::kCodecH264QSV:
+  case ExportCodec::kCodecH264VAAPI:
+  case ExportCodec::kCodecH264VideoToolbox:
     codec_id = AV_CODEC_ID_H264;
     break;
   case ExportCodec::kCodecH265:
+  case ExportCodec::kCodecH265NVENC:
+  case ExportCodec::kCodecH265QSV:
+  case ExportCodec::kCodecH265VAAPI:
+  case ExportCodec::kCodecH265VideoToolbox:
     codec_id = AV_CODEC_ID_HEVC;
     break;
   case ExportCodec::kCodecOpenEXR:
@@ -668,8 +1258,9 @@ bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AV
     return false;
   }
 
-  // Find encoder with this name
-  AVCodec* encoder = avcodec_find_encoder(codec_id);
+  // Find encoder with this name, hardware codecs are separate FFmpeg encoders for the same codec ID
+  const char* hw_encoder_name = ExportCodec::GetHardwareEncoderName(codec);
+  AVCodec* encoder = hw_encoder_name ? avcodec_find_encoder_by_name(hw_encoder_name) : avcodec_find_encoder(codec_id);
 
   if (!encoder) {
     SetError(tr("Failed to find codec for %1").arg(codec));
@@ -695,6 +1286,16 @@ bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AV
     codec_ctx->sample_aspect_ratio = params().video_params().pixel_aspect_ratio().toAVRational();
     codec_ctx->time_base = params().video_params().frame_rate_as_time_base().toAVRational();
     codec_ctx->pix_fmt = av_get_pix_fmt(params().video_pix_fmt().toUtf8());
+    video_sw_pix_fmt_ = codec_ctx->pix_fmt;
+
+    if (IsEncodingYUV()) {
+      codec_ctx->colorspace = (GetYUVMatrix() == PlanarYUV::kRec709) ? AVCOL_SPC_BT709 : AVCOL_SPC_SMPTE170M;
+      codec_ctx->color_range = AVCOL_RANGE_MPEG;
+    }
+
+    if (hw_encoder_name && !InitializeHardwareFrames(codec_ctx, encoder)) {
+      return false;
+    }
 
     if (params().video_params().interlacing() != VideoParams::kInterlaceNone) {
       // FIXME: I actually don't know what these flags do, the documentation helpfully doesn't
@@ -707,7 +1308,7 @@ bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AV
       } else {
         codec_ctx->field_order = AV_FIELD_BB;
 
-        if (codec_id == AV_CODEC_ID_H264) {
+        if (codec == ExportCodec::kCodecH264) {
           // For some reason, FFmpeg doesn't set libx264's bff flag so we have to do it ourselves
           av_opt_set(codec_ctx->priv_data, "x264opts", "bff=1", AV_OPT_SEARCH_CHILDREN);
         }
@@ -717,6 +1318,12 @@ bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AV
     // Set custom options
     {
       for (auto i=params().video_opts().begin();i!=params().video_opts().end();i++) {
+        if (hw_encoder_name && i.key() == QStringLiteral("crf")) {
+          // Hardware encoders don't have CRF, map it to their nearest constant quality mode
+          SetHardwareConstantQuality(codec_ctx, codec, i.value().toInt());
+          continue;
+        }
+
         av_opt_set(codec_ctx->priv_data, i.key().toUtf8(), i.value().toUtf8(), AV_OPT_SEARCH_CHILDREN);
       }
 
@@ -768,6 +1375,93 @@ bool FFmpegEncoder::InitializeStream(AVMediaType type, AVStream** stream_ptr, AV
   return true;
 }
 
+bool FFmpegEncoder::InitializeHardwareFrames(AVCodecContext *codec_ctx, AVCodec *encoder)
+{
+  // Most hardware encoders (NVENC, QSV, VideoToolbox) accept system memory frames directly
+  for (int i=0; encoder->pix_fmts && encoder->pix_fmts[i] != AV_PIX_FMT_NONE; i++) {
+    if (encoder->pix_fmts[i] == video_sw_pix_fmt_) {
+      return true;
+    }
+  }
+
+  // Otherwise, we'll need a device to upload frames to
+  const AVCodecHWConfig* config = nullptr;
+  for (int i=0; (config = avcodec_get_hw_config(encoder, i)); i++) {
+    if (config->methods & AV_CODEC_HW_CONFIG_METHOD_HW_FRAMES_CTX) {
+      break;
+    }
+  }
+
+  if (!config) {
+    SetError(tr("Encoder %1 does not support pixel format %2").arg(encoder->name, params().video_pix_fmt()));
+    return false;
+  }
+
+  AVBufferRef* device_ctx = nullptr;
+  int error_code = av_hwdevice_ctx_create(&device_ctx, config->device_type, nullptr, nullptr, 0);
+  if (error_code < 0) {
+    FFmpegError(tr("Failed to create hardware device"), error_code);
+    return false;
+  }
+
+  AVBufferRef* frames_ref = av_hwframe_ctx_alloc(device_ctx);
+  av_buffer_unref(&device_ctx);
+  if (!frames_ref) {
+    SetError(tr("Failed to allocate hardware frame context"));
+    return false;
+  }
+
+  AVHWFramesContext* frames_ctx = reinterpret_cast<AVHWFramesContext*>(frames_ref->data);
+  frames_ctx->format = config->pix_fmt;
+  frames_ctx->sw_format = video_sw_pix_fmt_;
+  frames_ctx->width = codec_ctx->width;
+  frames_ctx->height = codec_ctx->height;
+  frames_ctx->initial_pool_size = 20;
+
+  error_code = av_hwframe_ctx_init(frames_ref);
+  if (error_code < 0) {
+    av_buffer_unref(&frames_ref);
+    FFmpegError(tr("Failed to initialize hardware frame context"), error_code);
+    return false;
+  }
+
+  // Codec context takes its own reference, which keeps the device alive too
+  codec_ctx->hw_frames_ctx = av_buffer_ref(frames_ref);
+  codec_ctx->pix_fmt = config->pix_fmt;
+  av_buffer_unref(&frames_ref);
+
+  return true;
+}
+
+void FFmpegEncoder::SetHardwareConstantQuality(AVCodecContext *codec_ctx, ExportCodec::Codec codec, int quality)
+{
+  if (quality < 0) {
+    // CRF was disabled in favor of a bit rate, nothing to do
+    return;
+  }
+
+  switch (codec) {
+  case ExportCodec::kCodecH264NVENC:
+  case ExportCodec::kCodecH265NVENC:
+    av_opt_set(codec_ctx->priv_data, "rc", "vbr", 0);
+    av_opt_set_int(codec_ctx->priv_data, "cq", quality, 0);
+    break;
+  case ExportCodec::kCodecH264QSV:
+  case ExportCodec::kCodecH265QSV:
+    // QSV switches to ICQ when global_quality is set without a bit rate
+    codec_ctx->global_quality = quality;
+    break;
+  case ExportCodec::kCodecH264VAAPI:
+  case ExportCodec::kCodecH265VAAPI:
+    av_opt_set(codec_ctx->priv_data, "rc_mode", "CQP", 0);
+    av_opt_set_int(codec_ctx->priv_data, "qp", quality, 0);
+    break;
+  default:
+    // VideoToolbox only offers constant quality on some hardware, leave it on its own rate control
+    break;
+  }
+}
+
 bool FFmpegEncoder::InitializeCodecContext(AVStream **stream, AVCodecContext **codec_ctx, AVCodec* codec)
 {
   *stream = avformat_new_stream(fmt_ctx_, nullptr);
@@ -825,6 +1519,9 @@ void FFmpegEncoder::FlushEncoders()
 {
   if (video_codec_ctx_) {
     FlushCodecCtx(video_codec_ctx_, video_stream_);
+
+    // Encoder is empty, nothing can come before the remaining copied frames anymore
+    WriteQueuedPassthroughPackets(true);
   }
 
   if (audio_codec_ctx_) {
@@ -864,6 +1561,11 @@ void FFmpegEncoder::FlushCodecCtx(AVCodecContext *codec_ctx, AVStream* stream)
       break;
     }
     av_packet_unref(pkt);
+
+    if (codec_ctx == video_codec_ctx_) {
+      video_packets_written_++;
+      WriteQueuedPassthroughPackets(false);
+    }
   } while (error_code >= 0);
 
   av_packet_free(&pkt);
@@ -871,27 +1573,18 @@ void FFmpegEncoder::FlushCodecCtx(AVCodecContext *codec_ctx, AVStream* stream)
 
 bool FFmpegEncoder::InitializeResampleContext(SampleBufferPtr audio)
 {
-  if (audio_resample_ctx_) {
+  if (audio_resampler_.IsOpen()) {
     return true;
   }
 
   // Create resample context
-  audio_resample_ctx_ = swr_alloc_set_opts(nullptr,
-                                           static_cast<int64_t>(audio_codec_ctx_->channel_layout),
-                                           audio_codec_ctx_->sample_fmt,
-                                           audio_codec_ctx_->sample_rate,
-                                           static_cast<int64_t>(audio->audio_params().channel_layout()),
-                                           FFmpegUtils::GetFFmpegSampleFormat(audio->audio_params().format(), true),
-                                           audio->audio_params().sample_rate(),
-                                           0,
-                                           nullptr);
-  if (!audio_resample_ctx_) {
-    return false;
-  }
-
-  int err = swr_init(audio_resample_ctx_);
-  if (err < 0) {
-    FFmpegError(tr("Failed to create resampling context"), err);
+  if (!audio_resampler_.Open(audio->audio_params().channel_layout(),
+                             FFmpegUtils::GetFFmpegSampleFormat(audio->audio_params().format(), true),
+                             audio->audio_params().sample_rate(),
+                             static_cast<uint64_t>(audio_codec_ctx_->channel_layout),
+                             audio_codec_ctx_->sample_fmt,
+                             audio_codec_ctx_->sample_rate)) {
+    SetError(tr("Failed to create resampling context"));
     return false;
   }
 
@@ -28,6 +28,13 @@ extern "C" {
 #include <libavutil/opt.h>
 }
 
+#include <list>
+#include <QFuture>
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+
+#include "audio/audioresampler.h"
 #include "codec/encoder.h"
 
 namespace olive {
@@ -46,7 +53,7 @@ public:
 
   virtual bool WriteAudio(olive::SampleBufferPtr audio) override;
 
-  virtual bool WriteSubtitle(const SubtitleBlock *sub_block) override;
+  virtual bool WriteSubtitle(const SubtitleCue &cue) override;
 
   virtual void Close() override;
 
@@ -55,6 +62,24 @@ public:
     return video_conversion_fmt_;
   }
 
+  virtual PlanarYUV GetDesiredPlanarYUV() const override;
+
+  virtual bool CanPassthrough(const QString& filename, int stream) override;
+
+  virtual bool WritePassthroughFrame(const QString& filename, int stream, const rational& source_time, const rational& time) override;
+
+  /**
+   * @brief Join separately encoded video segments into one file without re-encoding
+   *
+   * Video packets are copied from each file in `segments` in order, with timestamps offset so
+   * each segment continues from the end of the last. If `extra_streams` isn't empty, every stream
+   * in that file (e.g. audio or subtitles encoded alongside the segments) is copied in as well.
+   *
+   * @return True on success. On failure, `error` is set to a readable description.
+   */
+  static bool ConcatenateSegments(const QStringList& segments, const QString& extra_streams,
+                                  const QString& output, QString* error);
+
 private:
   /**
    * @brief Handle an FFmpeg error code
@@ -66,12 +91,83 @@ private:
    */
   void FFmpegError(const QString &context, int error_code);
 
+  /**
+   * @brief Result of converting a frame to the encoder's pixel format
+   *
+   * `frame` is nullptr if the conversion failed, in which case the error fields describe why.
+   */
+  struct ConvertedFrame
+  {
+    AVFrame* frame;
+    int error_code;
+    QString error_context;
+  };
+
+  /**
+   * @brief Convert a frame into an AVFrame ready to send to the encoder
+   *
+   * Runs on video_convert_pool_, so this must not touch any state besides the scaling contexts.
+   */
+  ConvertedFrame ConvertFrame(FramePtr frame, const rational& time);
+
+  /**
+   * @brief Wait for the oldest queued conversion and send it to the encoder
+   */
+  bool EncodeNextConvertedFrame();
+
+  bool IsEncodingYUV() const;
+
+  PlanarYUV::Matrix GetYUVMatrix() const;
+
+  SwsContext* AcquireScaleContext(bool alpha);
+
+  void ReleaseScaleContext(bool alpha, SwsContext* ctx);
+
   bool WriteAVFrame(AVFrame* frame, AVCodecContext *codec_ctx, AVStream *stream);
 
+  /**
+   * @brief A stream in a footage file that smart rendering copies compressed frames from
+   */
+  struct PassthroughSource
+  {
+    AVFormatContext* fmt_ctx;
+    bool compatible;
+
+    // Most recently read packet of the stream, so sequential frames don't need a seek
+    AVPacket* packet;
+  };
+
+  PassthroughSource* GetPassthroughSource(const QString& filename, int stream);
+
+  /**
+   * @brief Read the packet of `stream` that's showing at `time`
+   *
+   * On success, the packet is left in `source->packet`.
+   */
+  bool ReadPassthroughPacket(PassthroughSource* source, int stream, const rational& time);
+
+  /**
+   * @brief Write copied packets that no longer have encoded frames ahead of them
+   *
+   * Frame threaded encoders return packets a few frames late, so copied packets are held back
+   * until every frame sent to the encoder before them has been written. If `flush` is true, the
+   * encoder has been drained and everything is written.
+   */
+  bool WriteQueuedPassthroughPackets(bool flush);
+
+  void ClosePassthroughSources();
+
   bool InitializeStream(enum AVMediaType type, AVStream** stream, AVCodecContext** codec_ctx, const ExportCodec::Codec &codec);
   bool InitializeCodecContext(AVStream** stream, AVCodecContext** codec_ctx, AVCodec* codec);
   bool SetupCodecContext(AVStream *stream, AVCodecContext *codec_ctx, AVCodec *codec);
 
+  /**
+   * @brief Set up device frame upload for hardware encoders that don't accept system memory frames
+   */
+  bool InitializeHardwareFrames(AVCodecContext* codec_ctx, AVCodec* encoder);
+
+  static void SetHardwareConstantQuality(AVCodecContext* codec_ctx, ExportCodec::Codec codec, int quality);
+
   void FlushEncoders();
   void FlushCodecCtx(AVCodecContext* codec_ctx, AVStream *stream);
 
@@ -81,13 +177,36 @@ private:
 
   AVStream* video_stream_;
   AVCodecContext* video_codec_ctx_;
-  SwsContext* video_alpha_scale_ctx_;
-  SwsContext* video_noalpha_scale_ctx_;
   VideoParams::Format video_conversion_fmt_;
+  AVPixelFormat video_sw_pix_fmt_;
+  AVPixelFormat video_src_alpha_pix_fmt_;
+  AVPixelFormat video_src_noalpha_pix_fmt_;
+
+  // Idle scaling contexts, one is taken for each conversion running in parallel
+  QVector<SwsContext*> video_alpha_scale_ctxs_;
+  QVector<SwsContext*> video_noalpha_scale_ctxs_;
+  QMutex video_scale_ctx_lock_;
+
+  QThreadPool video_convert_pool_;
+  std::list< QFuture<ConvertedFrame> > video_conversions_;
+
+  QHash<QPair<QString, int>, PassthroughSource> passthrough_sources_;
+
+  struct QueuedPassthroughPacket
+  {
+    AVPacket* packet;
+
+    // Number of frames sent to the encoder before this packet
+    int64_t frames_before;
+  };
+
+  std::list<QueuedPassthroughPacket> passthrough_queue_;
+  int64_t video_frames_sent_;
+  int64_t video_packets_written_;
 
   AVStream* audio_stream_;
   AVCodecContext* audio_codec_ctx_;
-  SwrContext* audio_resample_ctx_;
+  AudioResampler audio_resampler_;
   AVFrame* audio_frame_;
   int audio_max_samples_;
   int audio_frame_offset_;
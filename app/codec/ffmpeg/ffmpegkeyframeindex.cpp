@@ -0,0 +1,227 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "ffmpegkeyframeindex.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <algorithm>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+
+#include "common/filefunctions.h"
+#include "node/project/footage/footageprobecache.h"
+
+namespace olive {
+
+QMutex FFmpegKeyframeIndex::mutex_;
+QHash<QString, FFmpegKeyframeIndexPtr> FFmpegKeyframeIndex::loaded_;
+QSet<QString> FFmpegKeyframeIndex::building_;
+QAtomicInt FFmpegKeyframeIndex::cancelled_;
+
+// Identifies index files and their version, bump if the format changes
+static const quint32 kIndexMagic = 0x4F4B4931;
+
+static QThreadPool* GetBuildThreadPool()
+{
+  // Indexing is bound by disk reads, so several at once would only compete with each other
+  static QThreadPool pool;
+  pool.setMaxThreadCount(1);
+  return &pool;
+}
+
+FFmpegKeyframeIndexPtr FFmpegKeyframeIndex::Get(const QString &filename, int stream)
+{
+  QString index_filename = GetIndexFilename(filename, stream);
+
+  QMutexLocker locker(&mutex_);
+
+  FFmpegKeyframeIndexPtr index = loaded_.value(index_filename);
+
+  if (!index && !building_.contains(index_filename)) {
+    std::shared_ptr<FFmpegKeyframeIndex> from_disk = std::make_shared<FFmpegKeyframeIndex>();
+
+    if (from_disk->Load(index_filename)) {
+      index = from_disk;
+      loaded_.insert(index_filename, index);
+    } else {
+      // Stays in `building_` if building fails, so we don't keep trying files that can't be indexed
+      building_.insert(index_filename);
+      QtConcurrent::run(GetBuildThreadPool(), &FFmpegKeyframeIndex::Build, filename, stream, index_filename);
+    }
+  }
+
+  return index;
+}
+
+void FFmpegKeyframeIndex::CancelBuilds()
+{
+  cancelled_ = 1;
+  GetBuildThreadPool()->clear();
+  GetBuildThreadPool()->waitForDone();
+}
+
+int64_t FFmpegKeyframeIndex::GetSeekTimestamp(int64_t pts) const
+{
+  auto it = std::upper_bound(keyframes_.cbegin(), keyframes_.cend(), pts, [](int64_t t, const Keyframe& k){
+    return t < k.pts;
+  });
+
+  if (it == keyframes_.cbegin()) {
+    return pts;
+  }
+
+  it--;
+
+  return it->dts;
+}
+
+QString FFmpegKeyframeIndex::GetIndexFilename(const QString &filename, int stream)
+{
+  QString identity = FootageProbeCache::GetFileIdentity(QFileInfo(filename));
+
+  return QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation))
+      .filePath(QStringLiteral("%1.%2.keyframes").arg(identity, QString::number(stream)));
+}
+
+void FFmpegKeyframeIndex::Build(QString filename, int stream, QString index_filename)
+{
+  std::shared_ptr<FFmpegKeyframeIndex> index = std::make_shared<FFmpegKeyframeIndex>();
+  bool success = false;
+
+  AVFormatContext* fmt_ctx = nullptr;
+
+  if (avformat_open_input(&fmt_ctx, filename.toUtf8(), nullptr, nullptr) >= 0) {
+    if (stream >= 0 && stream < int(fmt_ctx->nb_streams)) {
+      // Only the packets of this stream need reading
+      for (unsigned int i=0; i<fmt_ctx->nb_streams; i++) {
+        fmt_ctx->streams[i]->discard = (int(i) == stream) ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+      }
+
+      AVPacket* pkt = av_packet_alloc();
+      int ret = 0;
+
+      while (!cancelled_ && (ret = av_read_frame(fmt_ctx, pkt)) >= 0) {
+        if (pkt->stream_index == stream && (pkt->flags & AV_PKT_FLAG_KEY)) {
+          int64_t pts = (pkt->pts == AV_NOPTS_VALUE) ? pkt->dts : pkt->pts;
+          int64_t dts = (pkt->dts == AV_NOPTS_VALUE) ? pts : pkt->dts;
+
+          if (pts != AV_NOPTS_VALUE) {
+            index->keyframes_.push_back({pts, dts});
+          }
+        }
+
+        av_packet_unref(pkt);
+      }
+
+      av_packet_free(&pkt);
+
+      if (!cancelled_ && ret == AVERROR_EOF && !index->keyframes_.empty()) {
+        std::sort(index->keyframes_.begin(), index->keyframes_.end(), [](const Keyframe& a, const Keyframe& b){
+          return a.pts < b.pts;
+        });
+
+        success = true;
+      }
+    }
+
+    avformat_close_input(&fmt_ctx);
+  }
+
+  if (success) {
+    // Write to a temporary file first so a decoder opening this file never sees a partial index
+    QDir().mkpath(QFileInfo(index_filename).absolutePath());
+
+    QString temp_file = FileFunctions::GetSafeTemporaryFilename(index_filename);
+    if (!index->Save(temp_file) || !FileFunctions::RenameFileAllowOverwrite(temp_file, index_filename)) {
+      QFile::remove(temp_file);
+      qWarning() << "Failed to save keyframe index for" << filename;
+    }
+  }
+
+  QMutexLocker locker(&mutex_);
+
+  if (success) {
+    loaded_.insert(index_filename, index);
+    building_.remove(index_filename);
+  } else if (cancelled_) {
+    building_.remove(index_filename);
+  }
+}
+
+bool FFmpegKeyframeIndex::Load(const QString &index_filename)
+{
+  QFile f(index_filename);
+  if (!f.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream ds(&f);
+
+  quint32 magic, count;
+  ds >> magic >> count;
+
+  // Each keyframe takes 16 bytes, don't trust a count the file is too small for
+  if (magic != kIndexMagic || ds.status() != QDataStream::Ok || qint64(count) * 16 > f.size()) {
+    return false;
+  }
+
+  keyframes_.resize(count);
+
+  for (quint32 i=0; i<count; i++) {
+    qint64 pts, dts;
+    ds >> pts >> dts;
+    keyframes_[i] = {pts, dts};
+  }
+
+  if (ds.status() != QDataStream::Ok) {
+    keyframes_.clear();
+    return false;
+  }
+
+  return true;
+}
+
+bool FFmpegKeyframeIndex::Save(const QString &index_filename) const
+{
+  QFile f(index_filename);
+  if (!f.open(QFile::WriteOnly)) {
+    return false;
+  }
+
+  QDataStream ds(&f);
+
+  ds << kIndexMagic << quint32(keyframes_.size());
+
+  for (const Keyframe& k : keyframes_) {
+    ds << qint64(k.pts) << qint64(k.dts);
+  }
+
+  return ds.status() == QDataStream::Ok;
+}
+
+}
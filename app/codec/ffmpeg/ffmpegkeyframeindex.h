@@ -0,0 +1,104 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FFMPEGKEYFRAMEINDEX_H
+#define FFMPEGKEYFRAMEINDEX_H
+
+#include <memory>
+#include <QAtomicInt>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <stdint.h>
+#include <vector>
+
+namespace olive {
+
+class FFmpegKeyframeIndex;
+using FFmpegKeyframeIndexPtr = std::shared_ptr<const FFmpegKeyframeIndex>;
+
+/**
+ * @brief List of every keyframe in a video stream
+ *
+ * Containers that are poorly indexed (or not indexed at all) and variable frame rate footage often
+ * make FFmpeg's own seeking land far from the keyframe before the requested frame, which means
+ * decoding seconds of frames for a single random access. With this index, the decoder can always
+ * seek straight to the right keyframe.
+ *
+ * Indexes are built by demuxing (not decoding) the whole stream once in the background, and are
+ * stored in the user's cache directory alongside the footage probe cache.
+ */
+class FFmpegKeyframeIndex
+{
+public:
+  FFmpegKeyframeIndex() = default;
+
+  /**
+   * @brief Get the index for a stream
+   *
+   * Returns nullptr if it hasn't been built yet, in which case building it is started in the
+   * background. Thread-safe.
+   */
+  static FFmpegKeyframeIndexPtr Get(const QString& filename, int stream);
+
+  /**
+   * @brief Stop any indexes being built in the background, e.g. when the application is closing
+   */
+  static void CancelBuilds();
+
+  /**
+   * @brief Get the timestamp to seek to in order to decode the frame at `pts`
+   *
+   * This is the last keyframe at or before `pts`, returned in the same units as the demuxer's own
+   * index so that it can be passed to av_seek_frame(). Returns `pts` itself if it comes before the
+   * first keyframe.
+   */
+  int64_t GetSeekTimestamp(int64_t pts) const;
+
+private:
+  struct Keyframe {
+    int64_t pts;
+    int64_t dts;
+  };
+
+  static QString GetIndexFilename(const QString& filename, int stream);
+
+  static void Build(QString filename, int stream, QString index_filename);
+
+  bool Load(const QString& index_filename);
+
+  bool Save(const QString& index_filename) const;
+
+  std::vector<Keyframe> keyframes_;
+
+  static QMutex mutex_;
+
+  static QHash<QString, FFmpegKeyframeIndexPtr> loaded_;
+
+  static QSet<QString> building_;
+
+  static QAtomicInt cancelled_;
+
+};
+
+}
+
+#endif // FFMPEGKEYFRAMEINDEX_H
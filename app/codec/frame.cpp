@@ -30,6 +30,8 @@
 
 namespace olive {
 
+const int Frame::kLinesizeAlignment = 64;
+
 Frame::Frame() :
   data_(nullptr),
   data_size_(0),
@@ -86,8 +88,13 @@ FramePtr Frame::Interlace(FramePtr top, FramePtr bottom)
 
 int Frame::generate_linesize_bytes(int width, VideoParams::Format format, int channel_count)
 {
-  // Align to 32 bytes (not sure if this is necessary?)
-  return VideoParams::GetBytesPerPixel(format, channel_count) * ((width + 31) & ~31);
+  int bpp = VideoParams::GetBytesPerPixel(format, channel_count);
+
+  // Smallest pixel count whose byte size is a multiple of the alignment. Since the alignment is a
+  // power of two, its GCD with the pixel size is the largest power of two dividing the pixel size.
+  int pixel_alignment = kLinesizeAlignment / qMin(kLinesizeAlignment, bpp & -bpp);
+
+  return bpp * ((width + pixel_alignment - 1) / pixel_alignment * pixel_alignment);
 }
 
 Color Frame::get_pixel(int x, int y) const
@@ -117,6 +124,41 @@ void Frame::set_pixel(int x, int y, const Color &c)
   c.toData(reinterpret_cast<char*>(data_ + byte_offset), video_params().format(), video_params().channel_count());
 }
 
+void Frame::fill_coverage(const QImage &coverage, const QPoint &offset, const Color &color)
+{
+  memset(data_, 0, data_size_);
+
+  if (coverage.isNull()) {
+    return;
+  }
+
+  // Every pixel is one of 256 colors, so convert each to our format only once
+  int bpp = video_params().GetBytesPerPixel();
+  QVector<char> pixels(256 * bpp);
+  for (int i=0; i<256; i++) {
+    float alpha = float(i) / 255.0f;
+
+    Color(color.red() * alpha, color.green() * alpha, color.blue() * alpha, alpha).toData(pixels.data() + i * bpp,
+                                                                                          format(),
+                                                                                          channel_count());
+  }
+
+  QRect area = QRect(offset, coverage.size()) & QRect(0, 0, width(), height());
+
+  for (int y=area.top(); y<=area.bottom(); y++) {
+    const uchar* src = coverage.constScanLine(y - offset.y());
+    char* dst = data_ + y * linesize_bytes();
+
+    for (int x=area.left(); x<=area.right(); x++) {
+      uchar c = src[x - offset.x()];
+
+      if (c) {
+        memcpy(dst + x * bpp, pixels.constData() + c * bpp, bpp);
+      }
+    }
+  }
+}
+
 bool Frame::allocate()
 {
   // Assume this frame is intended to be a video frame
@@ -136,10 +178,23 @@ bool Frame::allocate()
   return true;
 }
 
+void Frame::set_external_data(char *data, std::shared_ptr<void> owner)
+{
+  destroy();
+
+  data_ = data;
+  data_size_ = linesize_ * height();
+  external_owner_ = owner;
+}
+
 void Frame::destroy()
 {
   if (is_allocated()) {
-    FrameManager::Deallocate(data_size_, data_);
+    if (external_owner_) {
+      external_owner_ = nullptr;
+    } else {
+      FrameManager::Deallocate(data_size_, data_);
+    }
 
     data_size_ = 0;
     data_ = nullptr;
@@ -22,11 +22,13 @@
 #define FRAME_H
 
 #include <memory>
+#include <QImage>
 #include <QVector>
 
 #include "common/define.h"
 #include "common/rational.h"
 #include "render/color.h"
+#include "render/planaryuv.h"
 #include "render/videoparams.h"
 
 namespace olive {
@@ -53,6 +55,20 @@ public:
 
   static FramePtr Interlace(FramePtr top, FramePtr bottom);
 
+  /**
+   * @brief Alignment in bytes of every row of a frame
+   *
+   * Matches FrameManager's buffer alignment so each row starts on a boundary that SIMD loads and
+   * stores can use directly.
+   */
+  static const int kLinesizeAlignment;
+
+  /**
+   * @brief Stride in bytes of a frame of this width
+   *
+   * Rows are padded to a multiple of kLinesizeAlignment bytes while remaining a whole number of
+   * pixels, since strides are also handed to OpenGL in pixels.
+   */
   static int generate_linesize_bytes(int width, VideoParams::Format format, int channel_count);
 
   int linesize_pixels() const
@@ -89,6 +105,14 @@ public:
   bool contains_pixel(int x, int y) const;
   void set_pixel(int x, int y, const Color& c);
 
+  /**
+   * @brief Fill the frame with `color` weighted by 8-bit coverage
+   *
+   * `coverage` is a Format_Grayscale8 image placed at `offset`. Every pixel it doesn't cover is set
+   * to transparent, so generators only need to rasterize the area they draw into.
+   */
+  void fill_coverage(const QImage& coverage, const QPoint& offset, const Color& color);
+
   /**
    * @brief Get frame's timestamp.
    *
@@ -129,6 +153,16 @@ public:
    */
   bool allocate();
 
+  /**
+   * @brief Point this frame at an existing buffer rather than allocating one
+   *
+   * This avoids copying data that's already laid out the way this frame expects it, e.g. a
+   * decoder's cached frame. `owner` is kept alive for as long as this frame refers to the buffer,
+   * which must be at least linesize_bytes() * height() bytes. Since the buffer may be shared with
+   * whatever it came from, it should be treated as read-only.
+   */
+  void set_external_data(char* data, std::shared_ptr<void> owner);
+
   /**
    * @brief Return whether the frame is allocated or not
    */
@@ -154,12 +188,33 @@ public:
 
   FramePtr convert(VideoParams::Format format) const;
 
+  /**
+   * @brief If valid, this frame holds planar YUV packed as described by PlanarYUV rather than RGB(A)
+   *
+   * video_params() then describe the single channel buffer holding every plane, so height() is the
+   * packed height rather than the picture's.
+   */
+  const PlanarYUV& planar_yuv() const
+  {
+    return planar_yuv_;
+  }
+
+  void set_planar_yuv(const PlanarYUV& yuv)
+  {
+    planar_yuv_ = yuv;
+  }
+
 private:
   VideoParams params_;
 
+  PlanarYUV planar_yuv_;
+
   char* data_;
   int data_size_;
 
+  // Set if data_ belongs to someone else, see set_external_data()
+  std::shared_ptr<void> external_owner_;
+
   rational timestamp_;
 
   int linesize_;
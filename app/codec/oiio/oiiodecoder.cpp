@@ -25,6 +25,7 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QMessageBox>
+#include <QtConcurrent/QtConcurrent>
 
 #include "common/define.h"
 #include "common/oiioutils.h"
@@ -35,9 +36,19 @@ namespace olive {
 
 QStringList OIIODecoder::supported_formats_;
 
+QHash<QString, QDateTime> OIIODecoder::file_modified_times_;
+
+QMutex OIIODecoder::file_modified_times_lock_;
+
+QSet<QString> OIIODecoder::prefetching_;
+
+QMutex OIIODecoder::prefetching_lock_;
+
+QThreadPool OIIODecoder::prefetch_pool_;
+
 OIIODecoder::OIIODecoder() :
-  image_(nullptr),
-  buffer_(nullptr)
+  pix_fmt_(VideoParams::kFormatInvalid),
+  channel_count_(0)
 {
 }
 
@@ -95,6 +106,24 @@ FootageDescription OIIODecoder::Probe(const QString &filename, const QAtomicInt*
   return desc;
 }
 
+void OIIODecoder::PrefetchFiles(const QStringList &filenames, const RetrieveVideoParams &divider)
+{
+  // Reading is mostly waiting on storage, so use as many threads as files we're asked to read ahead
+  prefetch_pool_.setMaxThreadCount(qMax(prefetch_pool_.maxThreadCount(), filenames.size()));
+
+  QMutexLocker locker(&prefetching_lock_);
+
+  foreach (const QString& fn, filenames) {
+    if (prefetching_.contains(fn)) {
+      continue;
+    }
+
+    prefetching_.insert(fn);
+
+    QtConcurrent::run(&prefetch_pool_, &OIIODecoder::ReadIntoCache, fn, divider.divider);
+  }
+}
+
 bool OIIODecoder::OpenInternal()
 {
   // If we can open the filename provided, assume everything is working
@@ -107,25 +136,31 @@ FramePtr OIIODecoder::RetrieveVideoInternal(const rational &timecode, const Retr
 
   FramePtr frame = Frame::Create();
 
-  frame->set_video_params(VideoParams(buffer_->spec().width,
-                                      buffer_->spec().height,
+  frame->set_video_params(VideoParams(spec_.width,
+                                      spec_.height,
                                       pix_fmt_,
                                       channel_count_,
-                                      OIIOUtils::GetPixelAspectRatioFromOIIO(buffer_->spec()),
+                                      OIIOUtils::GetPixelAspectRatioFromOIIO(spec_),
                                       VideoParams::kInterlaceNone, // FIXME: Does OIIO deinterlace for us?
                                       divider.divider));
   frame->allocate();
 
-  if (divider.divider == 1) {
+  // Only the tiles of the MIP level we read from are loaded, so MIP-mapped images load in
+  // proportion to the size they're displayed at
+  int mip_level = GetBestMipLevel(filename_, frame->width(), frame->height());
 
-    OIIOUtils::BufferToFrame(buffer_, frame.get());
+  OIIO::ImageBuf src(filename_.string(), 0, mip_level, GetImageCache());
+
+  if (src.spec().width == frame->width() && src.spec().height == frame->height()) {
+
+    OIIOUtils::BufferToFrame(&src, frame.get());
 
   } else {
 
     // Will need to resize the image
-    OIIO::ImageBuf dst(OIIO::ImageSpec(frame->width(), frame->height(), buffer_->spec().nchannels, buffer_->spec().format));
+    OIIO::ImageBuf dst(OIIO::ImageSpec(frame->width(), frame->height(), channel_count_, src.spec().format));
 
-    if (!OIIO::ImageBufAlgo::resample(dst, *buffer_)) {
+    if (!OIIO::ImageBufAlgo::resample(dst, src)) {
       qWarning() << "OIIO resize failed";
     }
 
@@ -133,6 +168,11 @@ FramePtr OIIODecoder::RetrieveVideoInternal(const rational &timecode, const Retr
 
   }
 
+  if (src.has_error()) {
+    qWarning() << "OIIO read failed:" << QString::fromStdString(src.geterror());
+    return nullptr;
+  }
+
   return frame;
 }
 
@@ -166,54 +206,108 @@ bool OIIODecoder::FileTypeIsSupported(const QString& fn)
   return true;
 }
 
-bool OIIODecoder::OpenImageHandler(const QString &fn)
+OIIO::ImageCache *OIIODecoder::GetImageCache()
 {
-  image_ = OIIO::ImageInput::open(fn.toStdString());
+  static OIIO::ImageCache* cache = [](){
+    OIIO::ImageCache* c = OIIO::ImageCache::create(true);
 
-  if (!image_) {
-    return false;
+    c->attribute("max_memory_MB", float(Config::Current()[QStringLiteral("ImageCacheSize")].toInt()));
+
+    // Read untiled images in strips on demand rather than whole
+    c->attribute("autotile", 256);
+    c->attribute("autoscanline", 1);
+
+    return c;
+  }();
+
+  return cache;
+}
+
+int OIIODecoder::GetBestMipLevel(OIIO::ustring filename, int width, int height)
+{
+  int best = 0;
+  OIIO::ImageSpec level_spec;
+
+  for (int i=1; GetImageCache()->get_imagespec(filename, level_spec, 0, i); i++) {
+    if (level_spec.width < width || level_spec.height < height) {
+      break;
+    }
+
+    best = i;
   }
 
-  // Check if we can work with this pixel format
-  const OIIO::ImageSpec& spec = image_->spec();
+  return best;
+}
 
-  // Store channel count
-  channel_count_ = spec.nchannels;
+void OIIODecoder::ReadIntoCache(const QString &filename, int divider)
+{
+  OIIO::ustring fn(filename.toStdString());
+  OIIO::ImageSpec spec;
 
-  // We use RGBA frames because that tends to be the native format of GPUs
-  pix_fmt_ = OIIOUtils::GetFormatFromOIIOBasetype(static_cast<OIIO::TypeDesc::BASETYPE>(spec.format.basetype));
+  if (QFileInfo::exists(filename) && GetImageCache()->get_imagespec(fn, spec)) {
+    int mip_level = GetBestMipLevel(fn,
+                                    VideoParams::GetScaledDimension(spec.width, divider),
+                                    VideoParams::GetScaledDimension(spec.height, divider));
 
-  if (pix_fmt_ == VideoParams::kFormatInvalid) {
-    qWarning() << "Failed to convert OIIO::ImageDesc to native pixel format";
-    return false;
+    GetImageCache()->get_imagespec(fn, spec, 0, mip_level);
+
+    // The pixels themselves are discarded, reading them is only to get them into the cache
+    std::vector<char> discard(spec.image_bytes());
+    GetImageCache()->get_pixels(fn, 0, mip_level, 0, spec.width, 0, spec.height, 0, 1,
+                                spec.format, discard.data());
+  } else {
+    GetImageCache()->geterror();
   }
 
-  OIIO::TypeDesc::BASETYPE type = OIIOUtils::GetOIIOBaseTypeFromFormat(pix_fmt_);
+  QMutexLocker locker(&prefetching_lock_);
+  prefetching_.remove(filename);
+}
+
+bool OIIODecoder::OpenImageHandler(const QString &fn)
+{
+  filename_ = OIIO::ustring(fn.toStdString());
+
+  OIIO::ImageCache* cache = GetImageCache();
 
-  if (type == OIIO::TypeDesc::UNKNOWN) {
-    qCritical() << "Failed to determine appropriate OIIO basetype from native format";
+  {
+    // The cache keeps serving what it read before, so drop it if the file has been replaced since
+    // (e.g. an image sequence being re-rendered)
+    QDateTime modified = QFileInfo(fn).lastModified();
+
+    QMutexLocker locker(&file_modified_times_lock_);
+
+    auto it = file_modified_times_.find(fn);
+    if (it == file_modified_times_.end()) {
+      file_modified_times_.insert(fn, modified);
+    } else if (it.value() != modified) {
+      cache->invalidate(filename_);
+      it.value() = modified;
+    }
+  }
+
+  if (!cache->get_imagespec(filename_, spec_)) {
+    // Clear the error so it isn't reported with the next failure
+    cache->geterror();
     return false;
   }
 
-  buffer_ = new OIIO::ImageBuf(OIIO::ImageSpec(spec.width, spec.height, spec.nchannels, type),
-                               OIIO::InitializePixels::No);
+  // Store channel count
+  channel_count_ = spec_.nchannels;
+
+  pix_fmt_ = OIIOUtils::GetFormatFromOIIOBasetype(static_cast<OIIO::TypeDesc::BASETYPE>(spec_.format.basetype));
 
-  image_->read_image(type, buffer_->localpixels());
+  if (pix_fmt_ == VideoParams::kFormatInvalid) {
+    qWarning() << "Failed to convert OIIO::ImageDesc to native pixel format";
+    return false;
+  }
 
   return true;
 }
 
 void OIIODecoder::CloseImageHandle()
 {
-  if (image_) {
-    image_->close();
-    image_ = nullptr;
-  }
-
-  if (buffer_) {
-    delete buffer_;
-    buffer_ = nullptr;
-  }
+  // Pixels stay in the shared image cache for the next decoder that opens this file
+  filename_ = OIIO::ustring();
 }
 
 }
@@ -21,8 +21,13 @@
 #ifndef OIIODECODER_H
 #define OIIODECODER_H
 
+#include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/imagebuf.h>
+#include <QDateTime>
+#include <QHash>
+#include <QSet>
+#include <QThreadPool>
 
 #include "codec/decoder.h"
 
@@ -42,28 +47,63 @@ public:
 
   virtual FootageDescription Probe(const QString& filename, const QAtomicInt* cancelled) const override;
 
+  virtual void PrefetchFiles(const QStringList& filenames, const RetrieveVideoParams& divider) override;
+
 protected:
   virtual bool OpenInternal() override;
   virtual FramePtr RetrieveVideoInternal(const rational &timecode, const RetrieveVideoParams& divider) override;
   virtual void CloseInternal() override;
 
 private:
-  std::unique_ptr<OIIO::ImageInput> image_;
-
   static bool FileTypeIsSupported(const QString& fn);
 
+  /**
+   * @brief Process-wide cache that all OIIO decoders read pixels through
+   *
+   * Images are read in tiles on demand and only as much as the "ImageCacheSize" config entry
+   * allows is kept in memory, so large stills don't need to be loaded whole and frequently used
+   * ones don't need to be read from disk again.
+   */
+  static OIIO::ImageCache* GetImageCache();
+
+  /**
+   * @brief Find the smallest MIP level of the image that's at least `width` x `height`
+   *
+   * Returns 0 for images that aren't MIP-mapped.
+   */
+  static int GetBestMipLevel(OIIO::ustring filename, int width, int height);
+
+  /**
+   * @brief Read an image into the image cache at the size it'll be requested at
+   */
+  static void ReadIntoCache(const QString& filename, int divider);
+
   bool OpenImageHandler(const QString& fn);
 
   void CloseImageHandle();
 
+  OIIO::ustring filename_;
+
+  OIIO::ImageSpec spec_;
+
   VideoParams::Format pix_fmt_;
 
   int channel_count_;
 
-  OIIO::ImageBuf* buffer_;
-
   static QStringList supported_formats_;
 
+  static QHash<QString, QDateTime> file_modified_times_;
+
+  static QMutex file_modified_times_lock_;
+
+  // Files currently being prefetched, so repeated requests for the same lookahead don't queue them
+  // again
+  static QSet<QString> prefetching_;
+
+  static QMutex prefetching_lock_;
+
+  static QThreadPool prefetch_pool_;
+
 };
 
 }
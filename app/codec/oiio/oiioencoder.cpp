@@ -21,6 +21,7 @@
 #include "oiioencoder.h"
 
 #include "common/oiioutils.h"
+#include "common/tracing.h"
 
 namespace olive {
 
@@ -37,6 +38,8 @@ bool OIIOEncoder::Open()
 
 bool OIIOEncoder::WriteFrame(FramePtr frame, rational time)
 {
+  TRACE_SCOPE("encode", "OIIOEncoder::WriteFrame");
+
   std::string filename = GetFilenameForFrame(time).toStdString();
 
   auto output = OIIO::ImageOutput::create(filename);
@@ -68,8 +71,10 @@ bool OIIOEncoder::WriteAudio(SampleBufferPtr audio)
   return false;
 }
 
-bool OIIOEncoder::WriteSubtitle(const SubtitleBlock *sub_block)
+bool OIIOEncoder::WriteSubtitle(const SubtitleCue &cue)
 {
+  Q_UNUSED(cue)
+
   return false;
 }
 
@@ -31,12 +31,17 @@ class OIIOEncoder : public Encoder
 public:
   OIIOEncoder(const EncodingParams &params);
 
+  virtual bool WritesFramesIndependently() const override
+  {
+    return true;
+  }
+
 public slots:
   virtual bool Open() override;
 
   virtual bool WriteFrame(olive::FramePtr frame, olive::rational time) override;
   virtual bool WriteAudio(SampleBufferPtr audio) override;
-  virtual bool WriteSubtitle(const SubtitleBlock *sub_block) override;
+  virtual bool WriteSubtitle(const SubtitleCue &cue) override;
 
   virtual void Close() override;
 
@@ -0,0 +1,202 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "planaraudiofile.h"
+
+#include <QDebug>
+
+namespace olive {
+
+namespace {
+
+// Files are written in native byte order, they're only a cache and are read back by mapping them directly
+const quint32 kPlanarMagic = 0x4F504146;
+const quint32 kPlanarVersion = 1;
+
+// Header is padded to this size so planes start on an aligned offset
+const qint64 kPlanarDataOffset = 64;
+
+struct PlanarHeader {
+  quint32 magic;
+  quint32 version;
+  qint32 sample_rate;
+  qint32 channel_count;
+  quint64 channel_layout;
+  qint64 sample_count;
+  qint64 data_offset;
+};
+
+}
+
+PlanarAudioOutput::PlanarAudioOutput(const QString &f, const AudioParams &params) :
+  file_(f),
+  params_(params),
+  sample_count_(0)
+{
+  Q_ASSERT(params_.is_valid());
+}
+
+PlanarAudioOutput::~PlanarAudioOutput()
+{
+  close();
+}
+
+bool PlanarAudioOutput::open()
+{
+  sample_count_ = 0;
+
+  if (!file_.open(QFile::WriteOnly | QFile::Truncate)) {
+    qWarning() << "Failed to open conform output" << file_.fileName();
+    return false;
+  }
+
+  // Write a blank header, the real one is written once we know how many samples there are
+  QByteArray blank(kPlanarDataOffset, 0);
+  file_.write(blank);
+
+  for (int i=1; i<params_.channel_count(); i++) {
+    QFile* plane = new QFile(GetPlaneFilename(i));
+
+    if (!plane->open(QFile::ReadWrite | QFile::Truncate)) {
+      qWarning() << "Failed to open conform plane" << plane->fileName();
+      delete plane;
+      close();
+      return false;
+    }
+
+    extra_planes_.append(plane);
+  }
+
+  return true;
+}
+
+void PlanarAudioOutput::write(const float * const *planes, int nb_samples)
+{
+  if (!file_.isOpen() || nb_samples <= 0) {
+    return;
+  }
+
+  qint64 plane_bytes = nb_samples * sizeof(float);
+
+  file_.write(reinterpret_cast<const char*>(planes[0]), plane_bytes);
+
+  for (int i=0; i<extra_planes_.size(); i++) {
+    extra_planes_.at(i)->write(reinterpret_cast<const char*>(planes[i+1]), plane_bytes);
+  }
+
+  sample_count_ += nb_samples;
+}
+
+bool PlanarAudioOutput::close()
+{
+  if (!file_.isOpen()) {
+    return false;
+  }
+
+  bool ok = (extra_planes_.size() == params_.channel_count() - 1);
+
+  // Join the rest of the planes onto the first
+  const qint64 kCopyBlock = 1048576;
+
+  foreach (QFile* plane, extra_planes_) {
+    plane->seek(0);
+
+    while (ok && !plane->atEnd()) {
+      QByteArray block = plane->read(kCopyBlock);
+      ok = (file_.write(block) == block.size());
+    }
+
+    plane->close();
+    plane->remove();
+    delete plane;
+  }
+  extra_planes_.clear();
+
+  PlanarHeader header = {kPlanarMagic, kPlanarVersion, params_.sample_rate(), params_.channel_count(),
+                         params_.channel_layout(), sample_count_, kPlanarDataOffset};
+  file_.seek(0);
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  file_.close();
+
+  return ok;
+}
+
+QString PlanarAudioOutput::GetPlaneFilename(int channel) const
+{
+  return QStringLiteral("%1.plane%2").arg(file_.fileName(), QString::number(channel));
+}
+
+PlanarAudioInput::PlanarAudioInput(const QString &f) :
+  file_(f),
+  map_(nullptr),
+  sample_count_(0),
+  data_offset_(0)
+{
+}
+
+PlanarAudioInput::~PlanarAudioInput()
+{
+  close();
+}
+
+bool PlanarAudioInput::open()
+{
+  if (!file_.open(QFile::ReadOnly) || file_.size() < kPlanarDataOffset) {
+    file_.close();
+    return false;
+  }
+
+  PlanarHeader header;
+  file_.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+  if (header.magic != kPlanarMagic || header.version != kPlanarVersion || header.channel_count <= 0
+      || file_.size() < header.data_offset + header.sample_count * header.channel_count * qint64(sizeof(float))) {
+    qWarning() << "Invalid conform file" << file_.fileName();
+    file_.close();
+    return false;
+  }
+
+  params_ = AudioParams(header.sample_rate, header.channel_layout, AudioParams::kFormatFloat32);
+  sample_count_ = header.sample_count;
+  data_offset_ = header.data_offset;
+
+  map_ = file_.map(0, file_.size());
+
+  if (!map_) {
+    qWarning() << "Failed to map conform file" << file_.fileName();
+    file_.close();
+    return false;
+  }
+
+  return true;
+}
+
+void PlanarAudioInput::close()
+{
+  if (map_) {
+    file_.unmap(map_);
+    map_ = nullptr;
+  }
+
+  file_.close();
+}
+
+}
@@ -0,0 +1,131 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PLANARAUDIOFILE_H
+#define PLANARAUDIOFILE_H
+
+#include <QFile>
+#include <QVector>
+
+#include "render/audioparams.h"
+
+namespace olive {
+
+/**
+ * @brief Writes 32-bit float audio into a planar container that PlanarAudioInput can memory-map
+ *
+ * Each channel is stored as one contiguous plane after a small header, so any range of any channel can later be
+ * read as a plain pointer offset. Since the total length isn't known until writing finishes, every channel after the
+ * first is written to its own temporary file and joined onto the end of the main file in close().
+ */
+class PlanarAudioOutput
+{
+public:
+  PlanarAudioOutput(const QString& f, const AudioParams& params);
+
+  ~PlanarAudioOutput();
+
+  DISABLE_COPY_MOVE(PlanarAudioOutput)
+
+  bool open();
+
+  /**
+   * @brief Append `nb_samples` samples from each of `planes`, one plane per channel
+   */
+  void write(const float* const* planes, int nb_samples);
+
+  bool close();
+
+  qint64 sample_count() const
+  {
+    return sample_count_;
+  }
+
+private:
+  QString GetPlaneFilename(int channel) const;
+
+  QFile file_;
+
+  QVector<QFile*> extra_planes_;
+
+  AudioParams params_;
+
+  qint64 sample_count_;
+
+};
+
+/**
+ * @brief Memory-maps a file written by PlanarAudioOutput
+ */
+class PlanarAudioInput
+{
+public:
+  PlanarAudioInput(const QString& f);
+
+  ~PlanarAudioInput();
+
+  DISABLE_COPY_MOVE(PlanarAudioInput)
+
+  bool open();
+
+  bool is_open() const
+  {
+    return map_ != nullptr;
+  }
+
+  void close();
+
+  /**
+   * @brief Parameters of the stored audio, always 32-bit float
+   */
+  const AudioParams& params() const
+  {
+    return params_;
+  }
+
+  qint64 sample_count() const
+  {
+    return sample_count_;
+  }
+
+  /**
+   * @brief Pointer to the start of a channel's samples, valid until close()
+   */
+  const float* data(int channel) const
+  {
+    return reinterpret_cast<const float*>(map_ + data_offset_) + channel * sample_count_;
+  }
+
+private:
+  QFile file_;
+
+  uchar* map_;
+
+  AudioParams params_;
+
+  qint64 sample_count_;
+
+  qint64 data_offset_;
+
+};
+
+}
+
+#endif // PLANARAUDIOFILE_H
@@ -0,0 +1,97 @@
+#include "proxymanager.h"
+
+#include <QDir>
+
+#include "common/filefunctions.h"
+#include "task/taskmanager.h"
+
+namespace olive {
+
+ProxyManager *ProxyManager::instance_ = nullptr;
+
+const int ProxyManager::kMinimumProxySourceWidth = 1920;
+
+QString ProxyManager::GetProxy(const QString &decoder_id, const QString &cache_path, const Decoder::CodecStream &stream, const VideoParams &params, int divider)
+{
+  QMutexLocker locker(&mutex_);
+
+  // Return existing proxy if exists
+  QString filename = GetProxyFilename(cache_path, stream, divider);
+  if (QFileInfo::exists(filename)) {
+    return filename;
+  }
+
+  if (failed_.contains(filename)) {
+    return QString();
+  }
+
+  foreach (const ProxyData &data, generating_) {
+    if (data.finished_filename == filename) {
+      // Already generating this proxy in a task
+      return QString();
+    }
+  }
+
+  // Like conforms, proxies go to a different filename until they're done so a partial proxy is
+  // never mistaken for a finished one, even across sessions
+  QString working_fn = filename;
+  working_fn.append(QStringLiteral(".working"));
+
+  ProxyTask *task = new ProxyTask(decoder_id, stream, params, divider, working_fn);
+  connect(task, &ProxyTask::Finished, this, &ProxyManager::ProxyTaskFinished);
+  task->moveToThread(TaskManager::instance()->thread());
+  QMetaObject::invokeMethod(TaskManager::instance(), "AddTask", Qt::QueuedConnection, Q_ARG(Task *, task));
+
+  generating_.append({task, working_fn, filename});
+
+  return QString();
+}
+
+QString ProxyManager::GetProxyFilename(const QString &cache_path, const Decoder::CodecStream &stream, int divider)
+{
+  QString proxy_fn = QStringLiteral("%1.%2").arg(FileFunctions::GetUniqueFileIdentifier(stream.filename()),
+                                                 QString::number(stream.stream()));
+
+  proxy_fn = QDir(cache_path).filePath(proxy_fn);
+
+  proxy_fn.append(QStringLiteral(".proxy"));
+  proxy_fn.append(QString::number(divider));
+  proxy_fn.append(QStringLiteral(".mov"));
+
+  return proxy_fn;
+}
+
+void ProxyManager::ProxyTaskFinished(Task *task, bool succeeded)
+{
+  QMutexLocker locker(&mutex_);
+
+  ProxyData data;
+
+  // Remove proxy data from list
+  for (int i=0; i<generating_.size(); i++) {
+    const ProxyData &p = generating_.at(i);
+    if (p.task == task) {
+      data = p;
+      generating_.removeAt(i);
+      break;
+    }
+  }
+
+  if (succeeded) {
+    // Move file to standard proxy name, making it clear this proxy is ready for use
+    QFile::remove(data.finished_filename);
+    QFile::rename(data.working_filename, data.finished_filename);
+
+    locker.unlock();
+    emit ProxyReady();
+  } else {
+    // Failed, just delete the working filename if exists
+    QFile::remove(data.working_filename);
+
+    if (!task->IsCancelled()) {
+      failed_.insert(data.finished_filename);
+    }
+  }
+}
+
+}
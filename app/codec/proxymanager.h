@@ -0,0 +1,89 @@
+#ifndef PROXYMANAGER_H
+#define PROXYMANAGER_H
+
+#include <QMutex>
+#include <QObject>
+#include <QSet>
+
+#include "decoder.h"
+#include "task/proxy/proxy.h"
+
+namespace olive {
+
+class ProxyManager : public QObject
+{
+  Q_OBJECT
+public:
+  static void CreateInstance()
+  {
+    if (!instance_) {
+      instance_ = new ProxyManager();
+    }
+  }
+
+  static void DestroyInstance()
+  {
+    delete instance_;
+    instance_ = nullptr;
+  }
+
+  static ProxyManager *instance()
+  {
+    return instance_;
+  }
+
+  /**
+   * @brief Get the filename of a stream's proxy, and start generating one if none exists
+   *
+   * Returns an empty string if the proxy isn't ready yet, in which case the original should be
+   * used. Streams whose proxies failed to generate aren't retried this session.
+   *
+   * Thread-safe.
+   */
+  QString GetProxy(const QString &decoder_id, const QString &cache_path, const Decoder::CodecStream &stream, const VideoParams &params, int divider);
+
+  /**
+   * @brief Whether a stream of this size is worth proxying at all
+   *
+   * Decoding HD and smaller footage is cheap enough that a transcode wouldn't pay for itself.
+   */
+  static bool IsProxyWorthwhile(const VideoParams &params)
+  {
+    return params.width() > kMinimumProxySourceWidth;
+  }
+
+  static const int kMinimumProxySourceWidth;
+
+signals:
+  void ProxyReady();
+
+private:
+  ProxyManager() = default;
+
+  static ProxyManager *instance_;
+
+  QMutex mutex_;
+
+  struct ProxyData {
+    ProxyTask *task;
+    QString working_filename;
+    QString finished_filename;
+  };
+
+  QVector<ProxyData> generating_;
+
+  QSet<QString> failed_;
+
+  /**
+   * @brief Get the destination filename of a stream's proxy at a certain divider
+   */
+  static QString GetProxyFilename(const QString &cache_path, const Decoder::CodecStream &stream, int divider);
+
+private slots:
+  void ProxyTaskFinished(Task *task, bool succeeded);
+
+};
+
+}
+
+#endif // PROXYMANAGER_H
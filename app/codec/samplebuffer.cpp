@@ -20,8 +20,345 @@
 
 #include "samplebuffer.h"
 
+#include <algorithm>
+
+#include "samplebufferpool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OLIVE_SAMPLEBUFFER_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(OLIVE_SAMPLEBUFFER_SSE) && (defined(__GNUC__) || defined(__clang__))
+// GCC and Clang can compile individual functions for AVX, which we only call if the CPU supports it
+#define OLIVE_SAMPLEBUFFER_AVX
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define OLIVE_SAMPLEBUFFER_NEON
+#include <arm_neon.h>
+#endif
+
 namespace olive {
 
+namespace {
+
+/**
+ * @brief Table of per-channel kernels used by SampleBuffer
+ *
+ * All kernels operate on a single plane of `count` floats. The widest implementation the CPU supports is chosen once
+ * in GetKernels() and used from then on.
+ */
+struct SampleKernels {
+  void (*scale)(float* data, int count, float gain);
+  void (*mix)(float* dst, const float* src, int count, float gain);
+  void (*reverse)(float* data, int count);
+  void (*offset)(float* data, int count, float value);
+  void (*multiply)(float* dst, const float* src, int count);
+  void (*divide)(float* dst, const float* src, int count);
+};
+
+void ScaleScalar(float* data, int count, float gain)
+{
+  for (int i=0; i<count; i++) {
+    data[i] *= gain;
+  }
+}
+
+void MixScalar(float* dst, const float* src, int count, float gain)
+{
+  for (int i=0; i<count; i++) {
+    dst[i] += src[i] * gain;
+  }
+}
+
+void ReverseScalar(float* data, int count)
+{
+  std::reverse(data, data + count);
+}
+
+void OffsetScalar(float* data, int count, float value)
+{
+  for (int i=0; i<count; i++) {
+    data[i] += value;
+  }
+}
+
+void MultiplyScalar(float* dst, const float* src, int count)
+{
+  for (int i=0; i<count; i++) {
+    dst[i] *= src[i];
+  }
+}
+
+void DivideScalar(float* dst, const float* src, int count)
+{
+  for (int i=0; i<count; i++) {
+    dst[i] /= src[i];
+  }
+}
+
+#if defined(OLIVE_SAMPLEBUFFER_SSE)
+void ScaleSSE(float* data, int count, float gain)
+{
+  __m128 g = _mm_set1_ps(gain);
+  int i = 0;
+
+  for (; i+4<=count; i+=4) {
+    _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), g));
+  }
+
+  ScaleScalar(data + i, count - i, gain);
+}
+
+void MixSSE(float* dst, const float* src, int count, float gain)
+{
+  __m128 g = _mm_set1_ps(gain);
+  int i = 0;
+
+  for (; i+4<=count; i+=4) {
+    __m128 s = _mm_mul_ps(_mm_loadu_ps(src + i), g);
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), s));
+  }
+
+  MixScalar(dst + i, src + i, count - i, gain);
+}
+
+void ReverseSSE(float* data, int count)
+{
+  // Swap mirrored blocks of 4 from both ends, reversing each block on the way, then finish the middle
+  int front = 0;
+  int back = count - 4;
+
+  for (; front+4<=back; front+=4, back-=4) {
+    __m128 a = _mm_loadu_ps(data + front);
+    __m128 b = _mm_loadu_ps(data + back);
+    _mm_storeu_ps(data + front, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 1, 2, 3)));
+    _mm_storeu_ps(data + back, _mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 1, 2, 3)));
+  }
+
+  ReverseScalar(data + front, back + 4 - front);
+}
+
+void OffsetSSE(float* data, int count, float value)
+{
+  __m128 v = _mm_set1_ps(value);
+  int i = 0;
+
+  for (; i+4<=count; i+=4) {
+    _mm_storeu_ps(data + i, _mm_add_ps(_mm_loadu_ps(data + i), v));
+  }
+
+  OffsetScalar(data + i, count - i, value);
+}
+
+void MultiplySSE(float* dst, const float* src, int count)
+{
+  int i = 0;
+
+  for (; i+4<=count; i+=4) {
+    _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+  }
+
+  MultiplyScalar(dst + i, src + i, count - i);
+}
+
+void DivideSSE(float* dst, const float* src, int count)
+{
+  int i = 0;
+
+  for (; i+4<=count; i+=4) {
+    _mm_storeu_ps(dst + i, _mm_div_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(src + i)));
+  }
+
+  DivideScalar(dst + i, src + i, count - i);
+}
+#endif
+
+#if defined(OLIVE_SAMPLEBUFFER_AVX)
+__attribute__((target("avx"))) void ScaleAVX(float* data, int count, float gain)
+{
+  __m256 g = _mm256_set1_ps(gain);
+  int i = 0;
+
+  for (; i+8<=count; i+=8) {
+    _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), g));
+  }
+
+  ScaleScalar(data + i, count - i, gain);
+}
+
+__attribute__((target("avx"))) void MixAVX(float* dst, const float* src, int count, float gain)
+{
+  // Multiply and add separately rather than FMA so results match the SSE and scalar paths exactly
+  __m256 g = _mm256_set1_ps(gain);
+  int i = 0;
+
+  for (; i+8<=count; i+=8) {
+    __m256 s = _mm256_mul_ps(_mm256_loadu_ps(src + i), g);
+    _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), s));
+  }
+
+  MixScalar(dst + i, src + i, count - i, gain);
+}
+
+__attribute__((target("avx"))) void OffsetAVX(float* data, int count, float value)
+{
+  __m256 v = _mm256_set1_ps(value);
+  int i = 0;
+
+  for (; i+8<=count; i+=8) {
+    _mm256_storeu_ps(data + i, _mm256_add_ps(_mm256_loadu_ps(data + i), v));
+  }
+
+  OffsetScalar(data + i, count - i, value);
+}
+
+__attribute__((target("avx"))) void MultiplyAVX(float* dst, const float* src, int count)
+{
+  int i = 0;
+
+  for (; i+8<=count; i+=8) {
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(src + i)));
+  }
+
+  MultiplyScalar(dst + i, src + i, count - i);
+}
+
+__attribute__((target("avx"))) void DivideAVX(float* dst, const float* src, int count)
+{
+  int i = 0;
+
+  for (; i+8<=count; i+=8) {
+    _mm256_storeu_ps(dst + i, _mm256_div_ps(_mm256_loadu_ps(dst + i), _mm256_loadu_ps(src + i)));
+  }
+
+  DivideScalar(dst + i, src + i, count - i);
+}
+#endif
+
+#if defined(OLIVE_SAMPLEBUFFER_NEON)
+float32x4_t ReverseNEONVector(float32x4_t v)
+{
+  float32x4_t r = vrev64q_f32(v);
+  return vcombine_f32(vget_high_f32(r), vget_low_f32(r));
+}
+
+void ScaleNEON(float* data, int count, float gain)
+{
+  float32x4_t g = vdupq_n_f32(gain);
+  int i = 0;
+
+  for (; i+4<=count; i+=4) {
+    vst1q_f32(data + i, vmulq_f32(vld1q_f32(data + i), g));
+  }
+
+  ScaleScalar(data + i, count - i, gain);
+}
+
+void MixNEON(float* dst, const float* src, int count, float gain)
+{
+  float32x4_t g = vdupq_n_f32(gain);
+  int i = 0;
+
+  for (; i+4<=count; i+=4) {
+    float32x4_t s = vmulq_f32(vld1q_f32(src + i), g);
+    vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i), s));
+  }
+
+  MixScalar(dst + i, src + i, count - i, gain);
+}
+
+void ReverseNEON(float* data, int count)
+{
+  int front = 0;
+  int back = count - 4;
+
+  for (; front+4<=back; front+=4, back-=4) {
+    float32x4_t a = vld1q_f32(data + front);
+    float32x4_t b = vld1q_f32(data + back);
+    vst1q_f32(data + front, ReverseNEONVector(b));
+    vst1q_f32(data + back, ReverseNEONVector(a));
+  }
+
+  ReverseScalar(data + front, back + 4 - front);
+}
+
+void OffsetNEON(float* data, int count, float value)
+{
+  float32x4_t v = vdupq_n_f32(value);
+  int i = 0;
+
+  for (; i+4<=count; i+=4) {
+    vst1q_f32(data + i, vaddq_f32(vld1q_f32(data + i), v));
+  }
+
+  OffsetScalar(data + i, count - i, value);
+}
+
+void MultiplyNEON(float* dst, const float* src, int count)
+{
+  int i = 0;
+
+  for (; i+4<=count; i+=4) {
+    vst1q_f32(dst + i, vmulq_f32(vld1q_f32(dst + i), vld1q_f32(src + i)));
+  }
+
+  MultiplyScalar(dst + i, src + i, count - i);
+}
+
+#if defined(__aarch64__)
+void DivideNEON(float* dst, const float* src, int count)
+{
+  int i = 0;
+
+  for (; i+4<=count; i+=4) {
+    vst1q_f32(dst + i, vdivq_f32(vld1q_f32(dst + i), vld1q_f32(src + i)));
+  }
+
+  DivideScalar(dst + i, src + i, count - i);
+}
+#else
+void DivideNEON(float* dst, const float* src, int count)
+{
+  // 32-bit NEON only has a reciprocal estimate, which wouldn't match the other paths
+  DivideScalar(dst, src, count);
+}
+#endif
+#endif
+
+SampleKernels CreateKernels()
+{
+#if defined(OLIVE_SAMPLEBUFFER_NEON)
+  return {ScaleNEON, MixNEON, ReverseNEON, OffsetNEON, MultiplyNEON, DivideNEON};
+#elif defined(OLIVE_SAMPLEBUFFER_SSE)
+  SampleKernels k = {ScaleSSE, MixSSE, ReverseSSE, OffsetSSE, MultiplySSE, DivideSSE};
+
+#if defined(OLIVE_SAMPLEBUFFER_AVX)
+  if (__builtin_cpu_supports("avx")) {
+    k.scale = ScaleAVX;
+    k.mix = MixAVX;
+    k.offset = OffsetAVX;
+    k.multiply = MultiplyAVX;
+    k.divide = DivideAVX;
+  }
+#endif
+
+  return k;
+#else
+  return {ScaleScalar, MixScalar, ReverseScalar, OffsetScalar, MultiplyScalar, DivideScalar};
+#endif
+}
+
+const SampleKernels& GetKernels()
+{
+  static const SampleKernels kernels = CreateKernels();
+  return kernels;
+}
+
+}
+
 SampleBuffer::SampleBuffer() :
   sample_count_per_channel_(0)
 {
@@ -39,6 +376,12 @@ SampleBufferPtr SampleBuffer::CreateAllocated(const AudioParams &audio_params, c
 
 SampleBufferPtr SampleBuffer::CreateAllocated(const AudioParams &audio_params, int samples_per_channel)
 {
+  // Re-use a buffer if this thread is rendering fixed-size blocks
+  SampleBufferPool* pool = SampleBufferPool::ActiveForCurrentThread();
+  if (pool && audio_params.is_valid() && samples_per_channel > 0) {
+    return pool->Get(audio_params, samples_per_channel);
+  }
+
   SampleBufferPtr buffer = Create();
 
   buffer->set_audio_params(audio_params);
@@ -58,15 +401,16 @@ SampleBufferPtr SampleBuffer::CreateFromPackedData(const AudioParams &audio_para
   int samples_per_channel = audio_params.bytes_to_samples(bytes.size());
   SampleBufferPtr buffer = CreateAllocated(audio_params, samples_per_channel);
 
-  int total_samples = samples_per_channel * audio_params.channel_count();
-
   const float* packed_data = reinterpret_cast<const float*>(bytes.constData());
+  int channel_count = audio_params.channel_count();
 
-  for (int i=0;i<total_samples;i++) {
-    int channel = i % audio_params.channel_count();
-    int index = i / audio_params.channel_count();
+  for (int i=0;i<channel_count;i++) {
+    float* plane = buffer->data(i);
+    const float* src = packed_data + i;
 
-    buffer->data_[channel][index] = packed_data[i];
+    for (int j=0;j<samples_per_channel;j++) {
+      plane[j] = src[j * channel_count];
+    }
   }
 
   return buffer;
@@ -142,14 +486,8 @@ void SampleBuffer::reverse()
     return;
   }
 
-  int half_nb_sample = sample_count_per_channel_ / 2;
-
-  for (int i=0;i<half_nb_sample;i++) {
-    int opposite_ind = sample_count_per_channel_ - i - 1;
-
-    for (int j=0;j<audio_params_.channel_count();j++) {
-      std::swap(data_[j][i], data_[j][opposite_ind]);
-    }
+  for (int i=0;i<audio_params_.channel_count();i++) {
+    GetKernels().reverse(data(i), sample_count_per_channel_);
   }
 }
 
@@ -169,11 +507,12 @@ void SampleBuffer::speed(double speed)
     output_data[i].resize(sample_count_per_channel_);
   }
 
-  for (int i=0;i<sample_count_per_channel_;i++) {
-    int input_index = qFloor(static_cast<double>(i) * speed);
+  for (int i=0;i<audio_params_.channel_count();i++) {
+    const float* src = data_.at(i).constData();
+    float* dst = output_data[i].data();
 
-    for (int j=0;j<audio_params_.channel_count();j++) {
-      output_data[j][i] = data_[j][input_index];
+    for (int j=0;j<sample_count_per_channel_;j++) {
+      dst[j] = src[qFloor(static_cast<double>(j) * speed)];
     }
   }
 
@@ -182,18 +521,18 @@ void SampleBuffer::speed(double speed)
 
 void SampleBuffer::transform_volume(float f)
 {
+  if (!is_allocated()) {
+    return;
+  }
+
   for (int i=0;i<audio_params().channel_count();i++) {
-    for (int j=0;j<sample_count_per_channel_;j++) {
-      data_[i][j] *= f;
-    }
+    GetKernels().scale(data(i), sample_count_per_channel_, f);
   }
 }
 
 void SampleBuffer::transform_volume_for_channel(int channel, float volume)
 {
-  for (int i=0;i<sample_count_per_channel_;i++) {
-    data_[channel][i] *= volume;
-  }
+  GetKernels().scale(data(channel), sample_count_per_channel_, volume);
 }
 
 void SampleBuffer::transform_volume_for_sample(int sample_index, float volume)
@@ -208,6 +547,50 @@ void SampleBuffer::transform_volume_for_sample_on_channel(int sample_index, int
   data_[channel][sample_index] *= volume;
 }
 
+void SampleBuffer::transform_volume_per_sample(const float *volumes)
+{
+  if (!is_allocated()) {
+    return;
+  }
+
+  for (int i=0;i<audio_params().channel_count();i++) {
+    GetKernels().multiply(data(i), volumes, sample_count_per_channel_);
+  }
+}
+
+void SampleBuffer::divide_per_sample(const float *divisors)
+{
+  if (!is_allocated()) {
+    return;
+  }
+
+  for (int i=0;i<audio_params().channel_count();i++) {
+    GetKernels().divide(data(i), divisors, sample_count_per_channel_);
+  }
+}
+
+void SampleBuffer::offset(float f)
+{
+  if (!is_allocated()) {
+    return;
+  }
+
+  for (int i=0;i<audio_params().channel_count();i++) {
+    GetKernels().offset(data(i), sample_count_per_channel_, f);
+  }
+}
+
+void SampleBuffer::offset_per_sample(const float *offsets, float gain)
+{
+  if (!is_allocated()) {
+    return;
+  }
+
+  for (int i=0;i<audio_params().channel_count();i++) {
+    GetKernels().mix(data(i), offsets, sample_count_per_channel_, gain);
+  }
+}
+
 void SampleBuffer::fill(const float &f)
 {
   fill(f, 0, sample_count_per_channel_);
@@ -221,9 +604,57 @@ void SampleBuffer::fill(const float &f, int start_sample, int end_sample)
   }
 
   for (int i=0;i<audio_params().channel_count();i++) {
-    for (int j=start_sample;j<end_sample;j++) {
-      data_[i][j] = f;
-    }
+    float* plane = data(i);
+    std::fill(plane + start_sample, plane + end_sample, f);
+  }
+}
+
+void SampleBuffer::mix(const SampleBuffer *source, float gain, int sample_offset)
+{
+  if (!is_allocated() || !source->is_allocated()) {
+    qWarning() << "Tried to mix an unallocated sample buffer";
+    return;
+  }
+
+  int count = qMin(source->sample_count(), sample_count_per_channel_ - sample_offset);
+  int channels = qMin(source->audio_params().channel_count(), audio_params_.channel_count());
+
+  if (count <= 0 || qIsNull(gain)) {
+    return;
+  }
+
+  for (int i=0;i<channels;i++) {
+    GetKernels().mix(data(i) + sample_offset, source->data(i), count, gain);
+  }
+}
+
+void SampleBuffer::multiply(const SampleBuffer *source)
+{
+  if (!is_allocated() || !source->is_allocated()) {
+    qWarning() << "Tried to multiply an unallocated sample buffer";
+    return;
+  }
+
+  int count = qMin(source->sample_count(), sample_count_per_channel_);
+  int channels = qMin(source->audio_params().channel_count(), audio_params_.channel_count());
+
+  for (int i=0;i<channels;i++) {
+    GetKernels().multiply(data(i), source->data(i), count);
+  }
+}
+
+void SampleBuffer::divide(const SampleBuffer *source)
+{
+  if (!is_allocated() || !source->is_allocated()) {
+    qWarning() << "Tried to divide an unallocated sample buffer";
+    return;
+  }
+
+  int count = qMin(source->sample_count(), sample_count_per_channel_);
+  int channels = qMin(source->audio_params().channel_count(), audio_params_.channel_count());
+
+  for (int i=0;i<channels;i++) {
+    GetKernels().divide(data(i), source->data(i), count);
   }
 }
 
@@ -246,13 +677,14 @@ QByteArray SampleBuffer::toPackedData() const
 
     float* output_data = reinterpret_cast<float*>(packed_data.data());
 
-    int output_index = 0;
+    int channel_count = audio_params_.channel_count();
 
-    for (int j=0;j<sample_count_per_channel_;j++) {
-      for (int i=0;i<audio_params_.channel_count();i++) {
-        output_data[output_index] = data_[i][j];
+    for (int i=0;i<channel_count;i++) {
+      const float* plane = data(i);
+      float* dst = output_data + i;
 
-        output_index++;
+      for (int j=0;j<sample_count_per_channel_;j++) {
+        dst[j * channel_count] = plane[j];
       }
     }
   }
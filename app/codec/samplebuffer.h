@@ -77,9 +77,49 @@ public:
   void transform_volume_for_sample(int sample_index, float volume);
   void transform_volume_for_sample_on_channel(int sample_index, int channel, float volume);
 
+  /**
+   * @brief Multiply every channel by `volumes`, which holds one value per sample
+   */
+  void transform_volume_per_sample(const float* volumes);
+
+  /**
+   * @brief Divide every channel by `divisors`, which holds one value per sample
+   */
+  void divide_per_sample(const float* divisors);
+
+  /**
+   * @brief Add `f` to every sample
+   */
+  void offset(float f);
+
+  /**
+   * @brief Add `offsets` multiplied by `gain` to every channel, `offsets` holding one value per sample
+   */
+  void offset_per_sample(const float* offsets, float gain = 1.0f);
+
   void fill(const float& f);
   void fill(const float& f, int start_sample, int end_sample);
 
+  /**
+   * @brief Add another buffer's samples multiplied by `gain` into this one
+   *
+   * Samples are mixed starting at `sample_offset` in this buffer. Anything in `source` that would fall past the end of
+   * this buffer is ignored, as are any channels this buffer doesn't have.
+   */
+  void mix(const SampleBuffer* source, float gain = 1.0f, int sample_offset = 0);
+
+  /**
+   * @brief Multiply this buffer by another one sample for sample
+   *
+   * Only samples and channels both buffers have are multiplied, the rest are left as they are.
+   */
+  void multiply(const SampleBuffer* source);
+
+  /**
+   * @brief Divide this buffer by another one sample for sample, like multiply()
+   */
+  void divide(const SampleBuffer* source);
+
   void set(int channel, const float* data, int sample_offset, int sample_length);
   void set(int channel, const float* data, int sample_length)
   {
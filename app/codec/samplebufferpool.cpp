@@ -0,0 +1,138 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "samplebufferpool.h"
+
+namespace olive {
+
+// Enough for every node in a deep audio graph to hold a buffer or two of the same block size
+const size_t SampleBufferPool::kMaximumPooledBuffers = 128;
+QThreadStorage<SampleBufferPool*> SampleBufferPool::pools_;
+
+SampleBufferPool::SampleBufferPool() :
+  shared_(std::make_shared<Shared>()),
+  active_(0),
+  allocations_(0)
+{
+}
+
+SampleBufferPool::~SampleBufferPool()
+{
+  // Anything still in use will be deleted on release instead of returning here
+  QMutexLocker locker(&shared_->mutex);
+
+  shared_->closed = true;
+
+  for (SampleBuffer* b : shared_->buffers) {
+    delete b;
+  }
+  shared_->buffers.clear();
+}
+
+SampleBufferPool *SampleBufferPool::ForCurrentThread()
+{
+  if (!pools_.hasLocalData()) {
+    pools_.setLocalData(new SampleBufferPool());
+  }
+
+  return pools_.localData();
+}
+
+SampleBufferPool *SampleBufferPool::ActiveForCurrentThread()
+{
+  if (pools_.hasLocalData() && pools_.localData()->active_ > 0) {
+    return pools_.localData();
+  }
+
+  return nullptr;
+}
+
+SampleBufferPtr SampleBufferPool::Get(const AudioParams &params, int samples_per_channel)
+{
+  SampleBuffer* buffer = nullptr;
+
+  {
+    QMutexLocker locker(&shared_->mutex);
+
+    std::vector<SampleBuffer*>& list = shared_->buffers;
+
+    for (size_t i=0; i<list.size(); i++) {
+      if (list[i]->sample_count() == samples_per_channel && list[i]->audio_params() == params) {
+        buffer = list[i];
+        list[i] = list.back();
+        list.pop_back();
+        break;
+      }
+    }
+  }
+
+  if (buffer) {
+    // Match the zeroed contents of a fresh allocation
+    buffer->fill(0);
+  } else {
+    buffer = new SampleBuffer();
+    buffer->set_audio_params(params);
+    buffer->set_sample_count(samples_per_channel);
+    buffer->allocate();
+
+    allocations_++;
+  }
+
+  std::shared_ptr<Shared> shared = shared_;
+
+  return SampleBufferPtr(buffer, [shared](SampleBuffer* b){
+    Release(shared, b);
+  });
+}
+
+void SampleBufferPool::Release(const std::shared_ptr<Shared> &shared, SampleBuffer *buffer)
+{
+  // Buffers resized or destroyed after being handed out still match by their current shape
+  if (buffer->is_allocated()) {
+    QMutexLocker locker(&shared->mutex);
+
+    if (!shared->closed && shared->buffers.size() < kMaximumPooledBuffers) {
+      shared->buffers.push_back(buffer);
+      return;
+    }
+  }
+
+  delete buffer;
+}
+
+SampleBufferPool::Shared::~Shared()
+{
+  for (SampleBuffer* b : buffers) {
+    delete b;
+  }
+}
+
+SampleBufferPool::Scope::Scope(SampleBufferPool *pool) :
+  pool_(pool)
+{
+  pool_->active_++;
+}
+
+SampleBufferPool::Scope::~Scope()
+{
+  pool_->active_--;
+}
+
+}
@@ -0,0 +1,124 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SAMPLEBUFFERPOOL_H
+#define SAMPLEBUFFERPOOL_H
+
+#include <QMutex>
+#include <QThreadStorage>
+#include <vector>
+
+#include "samplebuffer.h"
+
+namespace olive {
+
+/**
+ * @brief Per-thread cache of SampleBuffers so fixed-size audio blocks don't allocate
+ *
+ * Each thread has at most one pool (see ForCurrentThread()). While it's activated with a Scope,
+ * SampleBuffer::CreateAllocated() on that thread hands out a previously released buffer of the
+ * same parameters and length if there is one, zeroed just like a fresh allocation. Buffers return
+ * to the pool when their last reference is dropped, from whichever thread that happens on.
+ *
+ * Buffers that outlive the pool (or its thread) are simply deleted when released.
+ */
+class SampleBufferPool
+{
+public:
+  ~SampleBufferPool();
+
+  DISABLE_COPY_MOVE(SampleBufferPool)
+
+  /**
+   * @brief Get the calling thread's pool, creating it if necessary
+   */
+  static SampleBufferPool* ForCurrentThread();
+
+  /**
+   * @brief Get the calling thread's pool if one exists and is currently active, nullptr otherwise
+   */
+  static SampleBufferPool* ActiveForCurrentThread();
+
+  SampleBufferPtr Get(const AudioParams& params, int samples_per_channel);
+
+  /**
+   * @brief Number of buffers this pool has had to allocate rather than re-use
+   */
+  qint64 allocation_count() const
+  {
+    return allocations_;
+  }
+
+  /**
+   * @brief Activates a pool for the lifetime of this object
+   */
+  class Scope
+  {
+  public:
+    Scope(SampleBufferPool* pool);
+
+    ~Scope();
+
+    DISABLE_COPY_MOVE(Scope)
+
+  private:
+    SampleBufferPool* pool_;
+
+  };
+
+private:
+  SampleBufferPool();
+
+  static const size_t kMaximumPooledBuffers;
+
+  /**
+   * @brief State shared with the deleters of buffers handed out, so they can tell if the pool is gone
+   */
+  struct Shared
+  {
+    Shared() :
+      closed(false)
+    {
+    }
+
+    ~Shared();
+
+    QMutex mutex;
+
+    bool closed;
+
+    std::vector<SampleBuffer*> buffers;
+  };
+
+  static void Release(const std::shared_ptr<Shared>& shared, SampleBuffer* buffer);
+
+  static QThreadStorage<SampleBufferPool*> pools_;
+
+  std::shared_ptr<Shared> shared_;
+
+  int active_;
+
+  qint64 allocations_;
+
+};
+
+}
+
+#endif // SAMPLEBUFFERPOOL_H
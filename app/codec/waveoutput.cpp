@@ -124,9 +124,10 @@ void WaveOutput::write(const char *bytes, int length)
   }
 }
 
-void WaveOutput::close()
+void WaveOutput::UpdateHeader()
 {
   if (file_.isOpen()) {
+    qint64 end = file_.pos();
 
     // Write file sizes
     file_.seek(4);
@@ -135,6 +136,16 @@ void WaveOutput::close()
     file_.seek(40);
     write_int<int32_t>(&file_, data_length_);
 
+    file_.seek(end);
+    file_.flush();
+  }
+}
+
+void WaveOutput::close()
+{
+  if (file_.isOpen()) {
+    UpdateHeader();
+
     file_.close();
   }
 }
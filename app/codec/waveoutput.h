@@ -43,6 +43,11 @@ public:
   void write(const QByteArray& bytes);
   void write(const char* bytes, int length);
 
+  /**
+   * @brief Write the current data length into the header so the file is readable before it's closed
+   */
+  void UpdateHeader();
+
   void close();
 
   const int& data_length() const;
@@ -20,6 +20,10 @@
 
 #include "common/ffmpegutils.h"
 
+extern "C" {
+#include <libavutil/hwcontext.h>
+}
+
 namespace olive {
 
 AVPixelFormat FFmpegUtils::GetCompatiblePixelFormat(const AVPixelFormat &pix_fmt)
@@ -138,4 +142,16 @@ VideoParams::Format FFmpegUtils::GetCompatiblePixelFormat(const VideoParams::For
   return VideoParams::kFormatInvalid;
 }
 
+QStringList FFmpegUtils::GetHardwareDeviceTypes()
+{
+  QStringList types;
+
+  AVHWDeviceType type = AV_HWDEVICE_TYPE_NONE;
+  while ((type = av_hwdevice_iterate_types(type)) != AV_HWDEVICE_TYPE_NONE) {
+    types.append(QString::fromUtf8(av_hwdevice_get_type_name(type)));
+  }
+
+  return types;
+}
+
 }
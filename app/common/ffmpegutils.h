@@ -25,6 +25,8 @@ extern "C" {
 #include <libavformat/avformat.h>
 }
 
+#include <QStringList>
+
 #include "render/audioparams.h"
 #include "render/videoparams.h"
 
@@ -56,6 +58,13 @@ public:
    * @brief Returns an FFmpeg sample format type for a given native type
    */
   static AVSampleFormat GetFFmpegSampleFormat(const AudioParams::Format &smp_fmt, bool planar = false);
+
+  /**
+   * @brief Returns the names of all hardware device types this FFmpeg build was compiled with
+   *
+   * Names are suitable for passing to av_hwdevice_find_type_by_name().
+   */
+  static QStringList GetHardwareDeviceTypes();
 };
 
 }
@@ -0,0 +1,239 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "hasher.h"
+
+#include <cstring>
+
+#include "render/color.h"
+
+namespace olive {
+
+const quint32 Hasher::kVersion = 1;
+
+namespace {
+
+const uint64_t kC1 = 0x87c37b91114253d5ULL;
+const uint64_t kC2 = 0x4cf5ad432745937fULL;
+
+inline uint64_t rotl64(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix64(uint64_t k)
+{
+  k ^= k >> 33;
+  k *= 0xff51afd7ed558ccdULL;
+  k ^= k >> 33;
+  k *= 0xc4ceb9fe1a85ec53ULL;
+  k ^= k >> 33;
+  return k;
+}
+
+inline uint64_t MixK1(uint64_t k1)
+{
+  k1 *= kC1;
+  k1 = rotl64(k1, 31);
+  k1 *= kC2;
+  return k1;
+}
+
+inline uint64_t MixK2(uint64_t k2)
+{
+  k2 *= kC2;
+  k2 = rotl64(k2, 33);
+  k2 *= kC1;
+  return k2;
+}
+
+}
+
+Hasher::Hasher() :
+  h1_(kVersion),
+  h2_(kVersion),
+  buffer_len_(0),
+  total_len_(0)
+{
+}
+
+void Hasher::addData(const char *data, int length)
+{
+  const uchar* bytes = reinterpret_cast<const uchar*>(data);
+  total_len_ += length;
+
+  // Complete a previously buffered block first
+  if (buffer_len_ > 0) {
+    int copy = qMin(length, 16 - buffer_len_);
+    memcpy(buffer_ + buffer_len_, bytes, copy);
+    buffer_len_ += copy;
+    bytes += copy;
+    length -= copy;
+
+    if (buffer_len_ < 16) {
+      return;
+    }
+
+    ProcessBlock(buffer_);
+    buffer_len_ = 0;
+  }
+
+  // Process whole blocks straight from the input
+  while (length >= 16) {
+    ProcessBlock(bytes);
+    bytes += 16;
+    length -= 16;
+  }
+
+  // Keep any remainder for later
+  if (length > 0) {
+    memcpy(buffer_, bytes, length);
+    buffer_len_ = length;
+  }
+}
+
+void Hasher::add(float f)
+{
+  // Treat -0.0 and 0.0 as the same value
+  if (f == 0.0f) {
+    f = 0.0f;
+  }
+  addRaw(f);
+}
+
+void Hasher::add(double d)
+{
+  // Treat -0.0 and 0.0 as the same value
+  if (d == 0.0) {
+    d = 0.0;
+  }
+  addRaw(d);
+}
+
+void Hasher::add(const rational &r)
+{
+  addRaw(r.numerator());
+  addRaw(r.denominator());
+}
+
+void Hasher::add(const QString &s)
+{
+  // Add the length too so consecutive strings can't run into each other
+  add(s.size());
+  addData(reinterpret_cast<const char*>(s.constData()), s.size() * int(sizeof(QChar)));
+}
+
+void Hasher::add(const QVector2D &v)
+{
+  add(v.x());
+  add(v.y());
+}
+
+void Hasher::add(const QVector3D &v)
+{
+  add(v.x());
+  add(v.y());
+  add(v.z());
+}
+
+void Hasher::add(const QVector4D &v)
+{
+  add(v.x());
+  add(v.y());
+  add(v.z());
+  add(v.w());
+}
+
+void Hasher::add(const QMatrix4x4 &m)
+{
+  const float* d = m.constData();
+  for (int i=0; i<16; i++) {
+    add(d[i]);
+  }
+}
+
+void Hasher::add(const Color &c)
+{
+  add(c.red());
+  add(c.green());
+  add(c.blue());
+  add(c.alpha());
+}
+
+QByteArray Hasher::result() const
+{
+  uint64_t h1 = h1_;
+  uint64_t h2 = h2_;
+
+  // Tail, as in MurmurHash3's reference implementation
+  uint64_t k1 = 0;
+  uint64_t k2 = 0;
+
+  for (int i=buffer_len_-1; i>=8; i--) {
+    k2 ^= uint64_t(buffer_[i]) << ((i - 8) * 8);
+  }
+  if (buffer_len_ > 8) {
+    h2 ^= MixK2(k2);
+  }
+
+  for (int i=qMin(buffer_len_, 8)-1; i>=0; i--) {
+    k1 ^= uint64_t(buffer_[i]) << (i * 8);
+  }
+  if (buffer_len_ > 0) {
+    h1 ^= MixK1(k1);
+  }
+
+  // Finalization
+  h1 ^= total_len_;
+  h2 ^= total_len_;
+
+  h1 += h2;
+  h2 += h1;
+
+  h1 = fmix64(h1);
+  h2 = fmix64(h2);
+
+  h1 += h2;
+  h2 += h1;
+
+  QByteArray out(kResultSize, Qt::Uninitialized);
+  memcpy(out.data(), &h1, sizeof(h1));
+  memcpy(out.data() + sizeof(h1), &h2, sizeof(h2));
+  return out;
+}
+
+void Hasher::ProcessBlock(const uchar *block)
+{
+  uint64_t k1, k2;
+  memcpy(&k1, block, sizeof(k1));
+  memcpy(&k2, block + sizeof(k1), sizeof(k2));
+
+  h1_ ^= MixK1(k1);
+  h1_ = rotl64(h1_, 27);
+  h1_ += h2_;
+  h1_ = h1_ * 5 + 0x52dce729;
+
+  h2_ ^= MixK2(k2);
+  h2_ = rotl64(h2_, 31);
+  h2_ += h1_;
+  h2_ = h2_ * 5 + 0x38495ab5;
+}
+
+}
@@ -0,0 +1,113 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef HASHER_H
+#define HASHER_H
+
+#include <type_traits>
+#include <QByteArray>
+#include <QMatrix4x4>
+#include <QString>
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector4D>
+
+#include "common/rational.h"
+
+namespace olive {
+
+class Color;
+
+/**
+ * @brief Fast non-cryptographic 128-bit streaming hash
+ *
+ * Used for frame hashes, where QCryptographicHash's strength isn't needed and its cost adds up
+ * over every input of every node of every frame. Based on MurmurHash3 (x64, 128-bit), buffering
+ * partial blocks so data can be fed in any number of pieces without allocating.
+ *
+ * The typed add() functions feed values directly rather than serializing them to a QByteArray
+ * first.
+ */
+class Hasher
+{
+public:
+  Hasher();
+
+  /**
+   * @brief Version of the hash algorithm and the way values are fed to it
+   *
+   * Mixed into every hash, so bumping this changes every frame hash and therefore invalidates
+   * existing disk caches rather than letting them return stale frames.
+   */
+  static const quint32 kVersion;
+
+  void addData(const char* data, int length);
+  void addData(const QByteArray& data)
+  {
+    addData(data.constData(), data.size());
+  }
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type add(T v)
+  {
+    addRaw(v);
+  }
+
+  void add(float f);
+  void add(double d);
+  void add(const rational& r);
+  void add(const QString& s);
+  void add(const QVector2D& v);
+  void add(const QVector3D& v);
+  void add(const QVector4D& v);
+  void add(const QMatrix4x4& m);
+  void add(const Color& c);
+
+  /**
+   * @brief Return the hash of all data added so far
+   *
+   * Doesn't modify the hasher, so more data can still be added after.
+   */
+  QByteArray result() const;
+
+  static const int kResultSize = 16;
+
+private:
+  template <typename T>
+  void addRaw(const T& v)
+  {
+    addData(reinterpret_cast<const char*>(&v), sizeof(T));
+  }
+
+  void ProcessBlock(const uchar* block);
+
+  uint64_t h1_;
+  uint64_t h2_;
+
+  uchar buffer_[16];
+  int buffer_len_;
+
+  uint64_t total_len_;
+
+};
+
+}
+
+#endif // HASHER_H
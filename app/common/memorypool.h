@@ -21,16 +21,19 @@
 #ifndef MEMORYPOOL_H
 #define MEMORYPOOL_H
 
+#include <atomic>
 #include <memory>
 #include <QApplication>
 #include <QDateTime>
 #include <QDebug>
 #include <QLinkedList>
 #include <QMutex>
+#include <QReadWriteLock>
 #include <QTimer>
 #include <stdint.h>
 
 #include "common/define.h"
+#include "common/metrics.h"
 
 namespace olive {
 
@@ -84,13 +87,12 @@ public:
   /**
    * @brief Clears all arenas, freeing all of their memory
    *
-   * Note that this function is not safe, any elements that are still out there will be invalid
-   * and accessing them will cause a crash. You'll need to make sure all elements are already
-   * relinquished before then.
+   * Elements that are still out there keep their arena alive, so its memory is only freed once the
+   * last of them is released.
    */
   void Clear()
   {
-    qDeleteAll(arenas_);
+    QWriteLocker locker(&lock_);
     arenas_.clear();
   }
 
@@ -126,7 +128,7 @@ public:
      *
      * There is no need to use this outside of the memory pool's internal functions.
      */
-    Element(Arena* parent, uint8_t* data)
+    Element(std::shared_ptr<Arena> parent, uint8_t* data)
     {
       parent_ = parent;
       data_ = data;
@@ -193,7 +195,7 @@ public:
     }
 
   private:
-    Arena* parent_;
+    std::shared_ptr<Arena> parent_;
 
     uint8_t* data_;
 
@@ -212,74 +214,83 @@ public:
    * an arena becoming full with no more memory to lend. A pool can automatically allocate another arena and continue
    * providing memory (and freeing arenas when they're no longer in use).
    */
-  class Arena {
+  class Arena : public std::enable_shared_from_this<Arena> {
   public:
-    Arena(MemoryPool* parent)
+    Arena()
     {
-      parent_ = parent;
       data_ = nullptr;
       allocated_sz_ = 0;
+      element_count_ = 0;
+      lent_count_ = 0;
+      free_head_ = kEndOfList;
       empty_time_ = QDateTime::currentMSecsSinceEpoch();
     }
 
     ~Arena()
     {
-      std::list<Element*> copy = lent_elements_;
-      foreach (Element* e, copy) {
-        e->release();
+      if (data_) {
+        GetArenaCountMetric()->Add(-1);
+        GetArenaBytesMetric()->Add(-qint64(allocated_sz_));
       }
 
-      delete [] data_;
+      // Every element holds a reference to its arena, so none can still be lent out here
+      qFreeAligned(data_);
     }
 
     DISABLE_COPY_MOVE(Arena)
 
     /**
      * @brief Returns an element if there is free memory to do so
+     *
+     * Lock-free, free elements are kept in a singly linked list of indices that's popped from here
+     * and pushed to in Release().
      */
     ElementPtr Get()
     {
-      QMutexLocker locker(&lock_);
+      uint64_t head = free_head_.load(std::memory_order_acquire);
+      uint32_t index;
 
-      for (int i=0;i<available_.size();i++) {
-        if (available_.at(i)) {
-          // This buffer is available
-          available_.replace(i, false);
+      do {
+        index = uint32_t(head);
 
-          ElementPtr e = std::make_shared<Element>(this,
-                                                   reinterpret_cast<uint8_t*>(data_ + i * element_sz_));
-          lent_elements_.push_back(e.get());
-
-          return e;
+        if (index == kEndOfList) {
+          // Arena is full
+          return nullptr;
         }
-      }
+      } while (!free_head_.compare_exchange_weak(head, MakeHead(head, next_free_[index].load(std::memory_order_relaxed)),
+                                                 std::memory_order_acquire, std::memory_order_acquire));
 
-      return nullptr;
+      lent_count_.fetch_add(1, std::memory_order_relaxed);
+
+      return std::make_shared<Element>(shared_from_this(), data_ + index * element_sz_);
     }
 
     /**
      * @brief Releases an element back into the pool for use elsewhere
+     *
+     * Lock-free.
      */
     void Release(Element* e)
     {
-      QMutexLocker locker(&lock_);
       quintptr diff = reinterpret_cast<quintptr>(e->data()) - reinterpret_cast<quintptr>(data_);
 
-      int index = diff / element_sz_;
+      uint32_t index = uint32_t(diff / element_sz_);
 
-      available_.replace(index, true);
+      uint64_t head = free_head_.load(std::memory_order_relaxed);
 
-      lent_elements_.remove(e);
+      do {
+        next_free_[index].store(uint32_t(head), std::memory_order_relaxed);
+      } while (!free_head_.compare_exchange_weak(head, MakeHead(head, index),
+                                                 std::memory_order_release, std::memory_order_relaxed));
 
-      if (lent_elements_.empty()) {
-        empty_time_ = QDateTime::currentMSecsSinceEpoch();
+      if (lent_count_.fetch_sub(1, std::memory_order_relaxed) == 1) {
+        empty_time_.store(QDateTime::currentMSecsSinceEpoch(), std::memory_order_relaxed);
       }
     }
 
-    int GetUsageCount()
+    int GetUsageCount() const
     {
-      QMutexLocker locker(&lock_);
-      return lent_elements_.size();
+      return lent_count_.load(std::memory_order_relaxed);
     }
 
     bool Allocate(size_t ele_sz, size_t nb_elements)
@@ -292,21 +303,29 @@ public:
 
       allocated_sz_ = element_sz_ * nb_elements;
 
-      if ((data_ = new uint8_t[allocated_sz_])) {
-        available_.resize(nb_elements);
-        available_.fill(true);
+      // Align the arena like FrameManager's buffers, elements sized in whole aligned rows stay aligned
+      if ((data_ = static_cast<uint8_t*>(qMallocAligned(allocated_sz_, kArenaAlignment)))) {
+        element_count_ = int(nb_elements);
+
+        // Chain every element into the free list in order
+        next_free_.reset(new std::atomic<uint32_t>[nb_elements]);
+        for (size_t i=0; i<nb_elements; i++) {
+          next_free_[i].store((i + 1 < nb_elements) ? uint32_t(i + 1) : kEndOfList, std::memory_order_relaxed);
+        }
+        free_head_.store(0, std::memory_order_release);
+
+        GetArenaCountMetric()->Increment();
+        GetArenaBytesMetric()->Add(qint64(allocated_sz_));
 
         return true;
       } else {
-        available_.clear();
-
         return false;
       }
     }
 
     inline int GetElementCount() const
     {
-      return available_.size();
+      return element_count_;
     }
 
     inline bool IsAllocated() const
@@ -314,28 +333,43 @@ public:
       return data_;
     }
 
-    inline qint64 GetTimeArenaWasMadeEmpty()
+    inline qint64 GetTimeArenaWasMadeEmpty() const
     {
-      QMutexLocker locker(&lock_);
-      return empty_time_;
+      return empty_time_.load(std::memory_order_relaxed);
     }
 
   private:
-    MemoryPool* parent_;
+    static const uint32_t kEndOfList = 0xFFFFFFFF;
+
+    static const size_t kArenaAlignment = 64;
+
+    /**
+     * @brief Build a new list head pointing at `index`
+     *
+     * The upper half of the head counts every change made to it, so a thread that read the head,
+     * stalled, and then finds the same index there again after others popped and pushed it can't
+     * mistake the list for unchanged (the ABA problem).
+     */
+    static inline uint64_t MakeHead(uint64_t old_head, uint32_t index)
+    {
+      return (((old_head >> 32) + 1) << 32) | index;
+    }
 
     uint8_t* data_;
 
     size_t allocated_sz_;
 
-    QVector<bool> available_;
+    size_t element_sz_;
 
-    QMutex lock_;
+    int element_count_;
 
-    size_t element_sz_;
+    std::unique_ptr< std::atomic<uint32_t>[] > next_free_;
 
-    std::list<Element*> lent_elements_;
+    std::atomic<uint64_t> free_head_;
 
-    qint64 empty_time_;
+    std::atomic<int> lent_count_;
+
+    std::atomic<qint64> empty_time_;
 
   };
 
@@ -344,10 +378,24 @@ public:
    */
   ElementPtr Get()
   {
-    QMutexLocker locker(&lock_);
+    {
+      // The list of arenas rarely changes, so threads only need to share it to get an element
+      QReadLocker locker(&lock_);
 
-    // Attempt to get an element from an arena
-    foreach (Arena* a, arenas_) {
+      // Attempt to get an element from an arena
+      foreach (const ArenaPtr& a, arenas_) {
+        ElementPtr e = a->Get();
+
+        if (e) {
+          return e;
+        }
+      }
+    }
+
+    QWriteLocker locker(&lock_);
+
+    // Another thread may have added an arena while we were waiting for the lock
+    foreach (const ArenaPtr& a, arenas_) {
       ElementPtr e = a->Get();
 
       if (e) {
@@ -374,10 +422,9 @@ public:
       return nullptr;
     }
 
-    Arena* a = new Arena(this);
+    ArenaPtr a = std::make_shared<Arena>();
     if (!a->Allocate(ele_sz, element_count_)) {
       qCritical() << "Failed to create arena, allocation failed. Out of memory?";
-      delete a;
       return nullptr;
     }
 
@@ -399,27 +446,42 @@ protected:
 private:
   int element_count_;
 
-  std::list<Arena*> arenas_;
+  using ArenaPtr = std::shared_ptr<Arena>;
+
+  std::list<ArenaPtr> arenas_;
 
-  QMutex lock_;
+  QReadWriteLock lock_;
 
   QTimer *clear_timer_;
 
   static const qint64 kMaxEmptyArenaLife = 5000;
 
+  static Metric* GetArenaCountMetric()
+  {
+    static Metric* m = MetricsRegistry::Gauge(QStringLiteral("olive_frame_pool_arenas"),
+                                              QStringLiteral("Arenas allocated by decoder frame pools"));
+    return m;
+  }
+
+  static Metric* GetArenaBytesMetric()
+  {
+    static Metric* m = MetricsRegistry::Gauge(QStringLiteral("olive_frame_pool_bytes"),
+                                              QStringLiteral("Memory allocated by decoder frame pools"));
+    return m;
+  }
+
 private slots:
   void ClearEmptyArenas()
   {
-    QMutexLocker locker(&lock_);
+    QWriteLocker locker(&lock_);
 
     const qint64 min_time = QDateTime::currentMSecsSinceEpoch() - kMaxEmptyArenaLife;
 
     for (auto it=arenas_.begin(); it!=arenas_.end(); ) {
-      Arena* arena = (*it);
+      const ArenaPtr& arena = (*it);
 
       if (arena->GetUsageCount() == 0 && arena->GetTimeArenaWasMadeEmpty() <= min_time) {
         qDebug() << "Removing an empty arena";
-        delete arena;
         it = arenas_.erase(it);
       } else {
         it++;
@@ -0,0 +1,124 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "metrics.h"
+
+#include <QMap>
+#include <QMutex>
+
+namespace olive {
+
+namespace {
+
+struct MetricsRegistryData {
+  QMutex lock;
+
+  // Sorted by name, which is also the order they're displayed in
+  QMap<QString, Metric*> metrics;
+
+  QMap<int, std::function<void()> > collectors;
+
+  int next_collector = 0;
+};
+
+MetricsRegistryData* GetData()
+{
+  static MetricsRegistryData data;
+  return &data;
+}
+
+}
+
+Metric *MetricsRegistry::Counter(const QString &name, const QString &help)
+{
+  return GetOrCreate(name, help, Metric::kCounter);
+}
+
+Metric *MetricsRegistry::Gauge(const QString &name, const QString &help)
+{
+  return GetOrCreate(name, help, Metric::kGauge);
+}
+
+int MetricsRegistry::AddCollector(const std::function<void ()> &collector)
+{
+  MetricsRegistryData* d = GetData();
+  QMutexLocker locker(&d->lock);
+
+  int id = d->next_collector++;
+  d->collectors.insert(id, collector);
+  return id;
+}
+
+void MetricsRegistry::RemoveCollector(int id)
+{
+  MetricsRegistryData* d = GetData();
+  QMutexLocker locker(&d->lock);
+
+  d->collectors.remove(id);
+}
+
+QVector<Metric *> MetricsRegistry::Collect()
+{
+  MetricsRegistryData* d = GetData();
+  QMutexLocker locker(&d->lock);
+
+  // Collectors may look up metrics themselves, so they can't be run with the lock held
+  QList<std::function<void()> > collectors = d->collectors.values();
+  locker.unlock();
+
+  for (const std::function<void()>& c : collectors) {
+    c();
+  }
+
+  locker.relock();
+
+  return d->metrics.values().toVector();
+}
+
+QByteArray MetricsRegistry::ToPrometheusText()
+{
+  QByteArray text;
+
+  foreach (Metric* m, Collect()) {
+    QByteArray name = m->name().toUtf8();
+
+    text.append("# HELP ").append(name).append(' ').append(m->help().toUtf8()).append('\n');
+    text.append("# TYPE ").append(name).append((m->type() == Metric::kCounter) ? " counter\n" : " gauge\n");
+    text.append(name).append(' ').append(QByteArray::number(m->value())).append('\n');
+  }
+
+  return text;
+}
+
+Metric *MetricsRegistry::GetOrCreate(const QString &name, const QString &help, Metric::Type type)
+{
+  MetricsRegistryData* d = GetData();
+  QMutexLocker locker(&d->lock);
+
+  Metric*& m = d->metrics[name];
+
+  if (!m) {
+    m = new Metric(name, help, type);
+  }
+
+  return m;
+}
+
+}
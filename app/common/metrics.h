@@ -0,0 +1,147 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <functional>
+#include <QString>
+#include <QVector>
+
+namespace olive {
+
+/**
+ * @brief A single named value published into the MetricsRegistry
+ *
+ * Setting and reading are lock-free, so subsystems can publish from any thread including hot paths.
+ */
+class Metric
+{
+public:
+  enum Type {
+    /// Only ever goes up (e.g. cache hits), consumers show its rate of change
+    kCounter,
+
+    /// Goes up and down (e.g. queue length, bytes in use)
+    kGauge
+  };
+
+  const QString& name() const
+  {
+    return name_;
+  }
+
+  const QString& help() const
+  {
+    return help_;
+  }
+
+  Type type() const
+  {
+    return type_;
+  }
+
+  qint64 value() const
+  {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+  void Set(qint64 v)
+  {
+    value_.store(v, std::memory_order_relaxed);
+  }
+
+  void Add(qint64 d)
+  {
+    value_.fetch_add(d, std::memory_order_relaxed);
+  }
+
+  void Increment()
+  {
+    Add(1);
+  }
+
+private:
+  friend class MetricsRegistry;
+
+  Metric(const QString& name, const QString& help, Type type) :
+    name_(name),
+    help_(help),
+    type_(type),
+    value_(0)
+  {
+  }
+
+  QString name_;
+
+  QString help_;
+
+  Type type_;
+
+  std::atomic<qint64> value_;
+
+};
+
+/**
+ * @brief Process-wide registry of counters and gauges for tuning cache sizes and thread counts
+ *
+ * Subsystems look up their metrics once (usually into a static) and update them as they work.
+ * Metrics are never removed, so the returned pointers stay valid for the life of the process.
+ * Names follow Prometheus conventions (olive_ prefix, snake_case, _bytes/_total suffixes) so they
+ * can be served as-is.
+ */
+class MetricsRegistry
+{
+public:
+  static Metric* Counter(const QString& name, const QString& help);
+
+  static Metric* Gauge(const QString& name, const QString& help);
+
+  /**
+   * @brief Register a function that updates metrics that are cheaper to poll than to publish
+   *
+   * Collectors are run from the main thread just before metrics are read. Returns an ID for
+   * RemoveCollector().
+   */
+  static int AddCollector(const std::function<void()>& collector);
+
+  static void RemoveCollector(int id);
+
+  /**
+   * @brief Run collectors and get every metric, sorted by name
+   *
+   * Must be called from the main thread.
+   */
+  static QVector<Metric*> Collect();
+
+  /**
+   * @brief Collect() formatted in the Prometheus text exposition format
+   */
+  static QByteArray ToPrometheusText();
+
+private:
+  static Metric* GetOrCreate(const QString& name, const QString& help, Metric::Type type);
+
+};
+
+}
+
+#endif // METRICS_H
@@ -0,0 +1,127 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "metricsserver.h"
+
+#include <QDebug>
+
+#ifdef USE_METRICS_SERVER
+#include <QTcpServer>
+#include <QTcpSocket>
+#endif
+
+#include "metrics.h"
+
+namespace olive {
+
+MetricsServer* MetricsServer::instance_ = nullptr;
+
+bool MetricsServer::CreateInstance(quint16 port)
+{
+#ifdef USE_METRICS_SERVER
+  DestroyInstance();
+
+  instance_ = new MetricsServer();
+
+  if (!instance_->server_->listen(QHostAddress::Any, port)) {
+    qCritical() << "Failed to serve metrics on port" << port << ":" << instance_->server_->errorString();
+    DestroyInstance();
+    return false;
+  }
+
+  QObject::connect(instance_->server_, &QTcpServer::newConnection, [] {
+    while (QTcpSocket* socket = instance_->server_->nextPendingConnection()) {
+      QObject::connect(socket, &QTcpSocket::readyRead, socket, [socket] { HandleConnection(socket); });
+      QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    }
+  });
+
+  qInfo() << "Serving metrics on port" << port;
+
+  return true;
+#else
+  Q_UNUSED(port)
+  qCritical() << "This build of Olive can't serve metrics, it was compiled without Qt Network";
+  return false;
+#endif
+}
+
+void MetricsServer::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+MetricsServer::MetricsServer()
+{
+#ifdef USE_METRICS_SERVER
+  server_ = new QTcpServer();
+#else
+  server_ = nullptr;
+#endif
+}
+
+MetricsServer::~MetricsServer()
+{
+#ifdef USE_METRICS_SERVER
+  // Also deletes any connections still open since sockets are children of the server
+  delete server_;
+#endif
+}
+
+void MetricsServer::HandleConnection(QTcpSocket *socket)
+{
+#ifdef USE_METRICS_SERVER
+  // Wait for the end of the request headers, we don't care what they contain
+  if (!socket->canReadLine() || !socket->peek(socket->bytesAvailable()).contains("\r\n\r\n")) {
+    if (socket->bytesAvailable() > 8192) {
+      socket->abort();
+    }
+    return;
+  }
+
+  QByteArray request_line = socket->readLine();
+  socket->readAll();
+
+  QByteArray response;
+
+  if (request_line.startsWith("GET ")) {
+    QByteArray body = MetricsRegistry::ToPrometheusText();
+
+    response = "HTTP/1.1 200 OK\r\n"
+               "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+               "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+               "Connection: close\r\n"
+               "\r\n" + body;
+  } else {
+    response = "HTTP/1.1 405 Method Not Allowed\r\n"
+               "Content-Length: 0\r\n"
+               "Connection: close\r\n"
+               "\r\n";
+  }
+
+  socket->write(response);
+  socket->disconnectFromHost();
+#else
+  Q_UNUSED(socket)
+#endif
+}
+
+}
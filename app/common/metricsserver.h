@@ -0,0 +1,64 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QtGlobal>
+
+class QTcpServer;
+class QTcpSocket;
+
+namespace olive {
+
+/**
+ * @brief Serves the MetricsRegistry over HTTP in the Prometheus text format
+ *
+ * Meant for render nodes running headless, where there's no panel to look at. Any GET request is
+ * answered with the current metrics. Only available if Olive was built with Qt Network.
+ */
+class MetricsServer
+{
+public:
+  /**
+   * @brief Start serving on `port` on all network interfaces
+   *
+   * Returns false if the port couldn't be bound or this build has no network support.
+   */
+  static bool CreateInstance(quint16 port);
+
+  static void DestroyInstance();
+
+private:
+  MetricsServer();
+
+  ~MetricsServer();
+
+  static void HandleConnection(QTcpSocket* socket);
+
+  static MetricsServer* instance_;
+
+  QTcpServer* server_;
+
+};
+
+}
+
+#endif // METRICSSERVER_H
@@ -3,8 +3,82 @@
 
 #include "rational.h"
 
+#include <utility>
+
 namespace olive {
 
+namespace {
+
+template <typename T>
+T BinaryGcd(T u, T v)
+{
+  // Stein's algorithm, only shifts and subtractions so it avoids the slow integer division that
+  // Euclid's needs at every step. Both values must be non-negative.
+  if (u == 0) {
+    return v;
+  }
+  if (v == 0) {
+    return u;
+  }
+
+  int shift = 0;
+  while (((u | v) & 1) == 0) {
+    u >>= 1;
+    v >>= 1;
+    shift++;
+  }
+
+  while ((u & 1) == 0) {
+    u >>= 1;
+  }
+
+  do {
+    while ((v & 1) == 0) {
+      v >>= 1;
+    }
+
+    if (u > v) {
+      std::swap(u, v);
+    }
+
+    v -= u;
+  } while (v != 0);
+
+  return u << shift;
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+template <>
+intType BinaryGcd(intType u, intType v)
+{
+  if (u == 0) {
+    return v;
+  }
+  if (v == 0) {
+    return u;
+  }
+
+  // Count trailing zeroes in one instruction rather than shifting one bit at a time
+  uint64_t a = u, b = v;
+  int shift = __builtin_ctzll(a | b);
+  a >>= __builtin_ctzll(a);
+
+  do {
+    b >>= __builtin_ctzll(b);
+
+    if (a > b) {
+      std::swap(a, b);
+    }
+
+    b -= a;
+  } while (b != 0);
+
+  return intType(a << shift);
+}
+#endif
+
+}
+
 const rational rational::NaN = rational(0, 0);
 
 rational rational::fromDouble(const double &flt, bool* ok)
@@ -72,22 +146,14 @@ void rational::fix_signs()
 
 void rational::reduce()
 {
-  if (!isNull()) {
-    // Euclidean often fails if numbers are negative, we abs it and re-neg it later if necessary
-    bool neg = numer_ < 0;
-
-    numer_ = qAbs(numer_);
-
-    intType d = gcd(numer_, denom_);
+  if (!isNull() && denom_ != 1) {
+    // Only the magnitude matters for the divisor, the sign stays on the numerator
+    intType d = gcd(qAbs(numer_), denom_);
 
     if (d > 1) {
       numer_ /= d;
       denom_ /= d;
     }
-
-    if (neg) {
-      numer_ = -numer_;
-    }
   }
 }
 
@@ -95,11 +161,35 @@ void rational::reduce()
 
 intType rational::gcd(const intType &x, const intType &y)
 {
-  if (y == 0) {
-    return x;
-  } else {
-    return gcd(y, x % y);
+  return BinaryGcd(x, y);
+}
+
+void rational::set_reduced(const wideType &n, const wideType &d)
+{
+  if (d == 0) {
+    numer_ = 0;
+    denom_ = 0;
+    return;
+  }
+
+  if (n == 0) {
+    numer_ = 0;
+    denom_ = 1;
+    return;
   }
+
+  bool neg = (n < 0) != (d < 0);
+  wideType abs_n = (n < 0) ? -n : n;
+  wideType abs_d = (d < 0) ? -d : d;
+
+  wideType g = BinaryGcd(abs_n, abs_d);
+  if (g > 1) {
+    abs_n /= g;
+    abs_d /= g;
+  }
+
+  numer_ = static_cast<intType>(neg ? -abs_n : abs_n);
+  denom_ = static_cast<intType>(abs_d);
 }
 
 //Function: convert to double
@@ -195,11 +285,12 @@ const rational& rational::operator+=(const rational &rhs)
       if (isNull()) {
         numer_ = rhs.numer_;
         denom_ = rhs.denom_;
+      } else if (denom_ == rhs.denom_) {
+        // Same denominator, common when adding times in the same timebase
+        set_reduced(wideType(numer_) + rhs.numer_, denom_);
       } else {
-        numer_ = (numer_ * rhs.denom_) + (rhs.numer_ * denom_);
-        denom_ = denom_ * rhs.denom_;
-        fix_signs();
-        reduce();
+        set_reduced(wideType(numer_) * rhs.denom_ + wideType(rhs.numer_) * denom_,
+                    wideType(denom_) * rhs.denom_);
       }
     }
   }
@@ -218,11 +309,11 @@ const rational& rational::operator-=(const rational &rhs)
       if (isNull()) {
         numer_ = -rhs.numer_;
         denom_ = rhs.denom_;
+      } else if (denom_ == rhs.denom_) {
+        set_reduced(wideType(numer_) - rhs.numer_, denom_);
       } else {
-        numer_ = (numer_ * rhs.denom_) - (rhs.numer_ * denom_);
-        denom_ = denom_ * rhs.denom_;
-        fix_signs();
-        reduce();
+        set_reduced(wideType(numer_) * rhs.denom_ - wideType(rhs.numer_) * denom_,
+                    wideType(denom_) * rhs.denom_);
       }
     }
   }
@@ -238,10 +329,7 @@ const rational& rational::operator/=(const rational &rhs)
       denom_ = 0;
       fix_signs();
     } else {
-      numer_ = numer_ * rhs.denom_;
-      denom_ = denom_ * rhs.numer_;
-      fix_signs();
-      reduce();
+      set_reduced(wideType(numer_) * rhs.denom_, wideType(denom_) * rhs.numer_);
     }
   }
 
@@ -254,11 +342,10 @@ const rational& rational::operator*=(const rational &rhs)
     if (rhs.isNaN()) {
       denom_ = 0;
       fix_signs();
+    } else if (rhs.denom_ == 1 && denom_ == 1) {
+      numer_ *= rhs.numer_;
     } else {
-      numer_ = numer_ * rhs.numer_;
-      denom_ = denom_ * rhs.denom_;
-      fix_signs();
-      reduce();
+      set_reduced(wideType(numer_) * rhs.numer_, wideType(denom_) * rhs.denom_);
     }
   }
 
@@ -303,31 +390,13 @@ bool rational::operator<(const rational &rhs) const
     return false;
   }
 
-  if (isNull() && rhs.isNull()) {
-    return false;
+  // Both sides are always in lowest terms with a positive denominator, so neither needs to be
+  // normalized and a shared denominator only needs the numerators compared
+  if (denom_ == rhs.denom_) {
+    return numer_ < rhs.numer_;
   }
 
-  if (rhs == RATIONAL_MAX
-      || *this == RATIONAL_MIN) {
-    // We will always wither be LESS THAN (true) or EQUAL (false)
-    return (*this != rhs);
-  }
-
-  if (*this == RATIONAL_MAX
-      || rhs == RATIONAL_MIN) {
-    // We will always be GREATER THAN (false) or EQUAL (false)
-    return false;
-  }
-
-  if (!isNull() && rhs.isNull()) {
-    return (numer_ * denom_ < intType(0));
-  }
-
-  if (isNull() && !rhs.isNull()) {
-    return !(rhs.numer_ * rhs.denom_ < intType(0));
-  }
-
-  return ((numer_ * rhs.denom_) < (denom_ * rhs.numer_));
+  return wideType(numer_) * rhs.denom_ < wideType(rhs.numer_) * denom_;
 }
 
 bool rational::operator<=(const rational &rhs) const
@@ -336,31 +405,11 @@ bool rational::operator<=(const rational &rhs) const
     return false;
   }
 
-  if (isNull() && rhs.isNull()) {
-    return true;
-  }
-
-  if (rhs == RATIONAL_MAX
-      || *this == RATIONAL_MIN) {
-    // We will always wither be LESS THAN (true) or EQUAL (true)
-    return true;
-  }
-
-  if (*this == RATIONAL_MAX
-      || rhs == RATIONAL_MIN) {
-    // We will always be GREATER THAN (false) or EQUAL (true)
-    return rhs == *this;
-  }
-
-  if (!isNull() && rhs.isNull()) {
-    return (numer_ * denom_ < intType(0));
-  }
-
-  if (isNull() && !rhs.isNull()) {
-    return !(rhs.numer_ * rhs.denom_ < intType(0));
+  if (denom_ == rhs.denom_) {
+    return numer_ <= rhs.numer_;
   }
 
-  return ((numer_ * rhs.denom_) <= (denom_ * rhs.numer_));
+  return wideType(numer_) * rhs.denom_ <= wideType(rhs.numer_) * denom_;
 }
 
 bool rational::operator>(const rational &rhs) const
@@ -438,7 +487,8 @@ std::istream& operator>>(std::istream &in, rational &value)
 
 uint qHash(const rational &r, uint seed)
 {
-  return ::qHash(r.toDouble(), seed);
+  // Rationals are always in lowest terms, so equal values have equal members
+  return ::qHash(qMakePair(r.numerator(), r.denominator()), seed);
 }
 
 }
@@ -120,6 +120,14 @@ public:
   QString toString() const;
 
 private:
+  // Products of two 64-bit values are done at double width so that cross-multiplying doesn't
+  // overflow before the result has had a chance to be reduced
+#ifdef __SIZEOF_INT128__
+  __extension__ typedef __int128 wideType;
+#else
+  typedef intType wideType;
+#endif
+
   //numerator and denominator
   intType numer_;
   intType denom_;
@@ -130,6 +138,8 @@ private:
   void reduce();
   //Function: finds greatest common denominator
   static intType gcd(const intType &x, const intType &y);
+  //Function: sets this to n/d in lowest form with the sign on the numerator
+  void set_reduced(const wideType &n, const wideType &d);
 };
 
 #define RATIONAL_MIN rational(INT64_MIN, 1)
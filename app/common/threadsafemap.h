@@ -1,26 +1,103 @@
 #ifndef THREADSAFEMAP_H
 #define THREADSAFEMAP_H
 
-#include <QMap>
+#include <memory>
+#include <QHash>
 #include <QMutex>
 
+/**
+ * @brief Hash map for lookups from many threads that rarely change
+ *
+ * Readers take a snapshot of the current map without locking anything, so they never wait on each
+ * other or on a writer. Writers copy the map, change the copy and publish it in place of the old
+ * one, so every write costs a full copy. Only use this where writes stop soon after warm-up.
+ */
 template <typename K, typename V>
 class ThreadSafeMap
 {
 public:
-  ThreadSafeMap() = default;
+  ThreadSafeMap() :
+    map_(std::make_shared< const QHash<K, V> >())
+  {
+  }
+
+  V value(const K& key) const
+  {
+    return snapshot()->value(key);
+  }
+
+  bool contains(const K& key) const
+  {
+    return snapshot()->contains(key);
+  }
+
+  /**
+   * @brief Current contents of the map, which stay valid even if the map changes afterwards
+   */
+  std::shared_ptr< const QHash<K, V> > snapshot() const
+  {
+    return std::atomic_load(&map_);
+  }
 
   void insert(K key, V value)
   {
-    mutex_.lock();
-    map_.insert(key, value);
-    mutex_.unlock();
+    QMutexLocker locker(&write_lock_);
+
+    std::shared_ptr< QHash<K, V> > copy = std::make_shared< QHash<K, V> >(*snapshot());
+    copy->insert(key, value);
+    std::atomic_store(&map_, std::shared_ptr< const QHash<K, V> >(copy));
+  }
+
+  /**
+   * @brief Insert `value` unless something was inserted under `key` first
+   *
+   * Returns whatever is in the map under `key` afterwards. `inserted` is set to whether that's
+   * `value`, e.g. so a caller can free a value that lost the race.
+   */
+  V insertIfMissing(const K& key, const V& value, bool* inserted = nullptr)
+  {
+    QMutexLocker locker(&write_lock_);
+
+    std::shared_ptr< const QHash<K, V> > current = snapshot();
+    auto it = current->constFind(key);
+
+    if (it != current->constEnd()) {
+      if (inserted) {
+        *inserted = false;
+      }
+      return it.value();
+    }
+
+    std::shared_ptr< QHash<K, V> > copy = std::make_shared< QHash<K, V> >(*current);
+    copy->insert(key, value);
+    std::atomic_store(&map_, std::shared_ptr< const QHash<K, V> >(copy));
+
+    if (inserted) {
+      *inserted = true;
+    }
+    return value;
+  }
+
+  void remove(const K& key)
+  {
+    QMutexLocker locker(&write_lock_);
+
+    std::shared_ptr< QHash<K, V> > copy = std::make_shared< QHash<K, V> >(*snapshot());
+    copy->remove(key);
+    std::atomic_store(&map_, std::shared_ptr< const QHash<K, V> >(copy));
+  }
+
+  void clear()
+  {
+    QMutexLocker locker(&write_lock_);
+
+    std::atomic_store(&map_, std::make_shared< const QHash<K, V> >());
   }
 
 private:
-  QMutex mutex_;
+  std::shared_ptr< const QHash<K, V> > map_;
 
-  QMap<K, V> map_;
+  QMutex write_lock_;
 
 };
 
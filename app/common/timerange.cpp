@@ -20,6 +20,7 @@
 
 #include "timerange.h"
 
+#include <algorithm>
 #include <QtMath>
 #include <utility>
 
@@ -178,62 +179,165 @@ void TimeRange::normalize()
 
 void TimeRangeList::insert(TimeRange range_to_add)
 {
-  // See if list contains this range
-  if (contains(range_to_add)) {
+  // First range that ends at or after the new one starts, anything before it is unaffected
+  auto first = std::lower_bound(array_.begin(), array_.end(), range_to_add.in(),
+                                [](const TimeRange& r, const rational& t){ return r.out() < t; });
+
+  // First range that starts after the new one ends, anything from here on is unaffected
+  auto last = std::upper_bound(first, array_.end(), range_to_add.out(),
+                               [](const rational& t, const TimeRange& r){ return t < r.in(); });
+
+  if (first == last) {
+    array_.insert(first, range_to_add);
     return;
   }
 
-  // Does not contain range, so we'll almost certainly be adding it in some way
-  for (int i=0;i<size();i++) {
-    const TimeRange& compare = array_.at(i);
+  // Everything in between overlaps or touches the new range, so they all become one
+  TimeRange combined(qMin(range_to_add.in(), first->in()),
+                     qMax(range_to_add.out(), (last - 1)->out()));
+
+  *first = combined;
+  array_.erase(first + 1, last);
+}
+
+void TimeRangeList::remove(const TimeRange &remove)
+{
+  auto first = std::lower_bound(array_.begin(), array_.end(), remove.in(),
+                                [](const TimeRange& r, const rational& t){ return r.out() < t; });
+
+  auto last = std::upper_bound(first, array_.end(), remove.out(),
+                               [](const rational& t, const TimeRange& r){ return t < r.in(); });
+
+  if (first == last) {
+    return;
+  }
+
+  // Only the first and last affected ranges can stick out either side of the removed range
+  QVector<TimeRange> remaining;
+
+  if (first->in() < remove.in()) {
+    remaining.append(TimeRange(first->in(), remove.in()));
+  }
+
+  if ((last - 1)->out() > remove.out()) {
+    TimeRange after(remove.out(), (last - 1)->out());
 
-    if (compare.OverlapsWith(range_to_add)) {
-      range_to_add = TimeRange::Combine(range_to_add, compare);
-      array_.removeAt(i);
-      i--;
+    if (!remaining.isEmpty() && remaining.first().out() >= after.in()) {
+      // Removing an empty range from the middle of one doesn't split it
+      remaining.first().set_out(after.out());
+    } else {
+      remaining.append(after);
     }
   }
 
-  array_.append(range_to_add);
+  int index = first - array_.begin();
+  array_.erase(first, last);
+
+  for (int i=0; i<remaining.size(); i++) {
+    array_.insert(index + i, remaining.at(i));
+  }
 }
 
-void TimeRangeList::remove(const TimeRange &remove)
+void TimeRangeList::merge(const TimeRangeList &other)
+{
+  if (other.isEmpty()) {
+    return;
+  }
+
+  if (isEmpty()) {
+    array_ = other.array_;
+    return;
+  }
+
+  QVector<TimeRange> merged;
+  merged.reserve(array_.size() + other.array_.size());
+
+  auto a = array_.constBegin();
+  auto b = other.array_.constBegin();
+
+  while (a != array_.constEnd() || b != other.array_.constEnd()) {
+    // Take whichever range starts first
+    const TimeRange* next;
+    if (b == other.array_.constEnd() || (a != array_.constEnd() && a->in() <= b->in())) {
+      next = &*a;
+      a++;
+    } else {
+      next = &*b;
+      b++;
+    }
+
+    if (!merged.isEmpty() && merged.last().out() >= next->in()) {
+      if (next->out() > merged.last().out()) {
+        merged.last().set_out(next->out());
+      }
+    } else {
+      merged.append(*next);
+    }
+  }
+
+  array_ = merged;
+}
+
+void TimeRangeList::subtract(const TimeRangeList &other)
 {
-  int sz = this->size();
-
-  for (int i=0;i<sz;i++) {
-    TimeRange& compare = array_[i];
-
-    if (remove.Contains(compare)) {
-      // This element is entirely encompassed in this range, remove it
-      array_.removeAt(i);
-      i--;
-      sz--;
-    } else if (compare.Contains(remove, false, false)) {
-      // The remove range is within this element, only choice is to split the element into two
-      TimeRange new_range(remove.out(), compare.out());
-      compare.set_out(remove.in());
-      insert(new_range);
-      break;
-    } else if (compare.in() < remove.in() && compare.out() > remove.in()) {
-      // This element's out point overlaps the range's in, we'll trim it
-      compare.set_out(remove.in());
-    } else if (compare.in() < remove.out() && compare.out() > remove.out()) {
-      // This element's in point overlaps the range's out, we'll trim it
-      compare.set_in(remove.out());
+  if (isEmpty() || other.isEmpty()) {
+    return;
+  }
+
+  QVector<TimeRange> result;
+  result.reserve(array_.size() + other.array_.size());
+
+  auto b = other.array_.constBegin();
+
+  foreach (TimeRange r, array_) {
+    // Skip removals that end before this range starts, they can't affect any later range either
+    while (b != other.array_.constEnd() && b->out() < r.in()) {
+      b++;
+    }
+
+    bool keep = true;
+
+    // Cut out every removal that reaches into this range
+    for (auto it=b; it!=other.array_.constEnd() && it->in() <= r.out(); it++) {
+      if (it->in() > r.in() && it->out() < r.out() && it->in() != it->out()) {
+        // Removal is strictly inside, keep the part before it and continue with the part after
+        result.append(TimeRange(r.in(), it->in()));
+        r.set_in(it->out());
+      } else if (it->in() <= r.in() && it->out() >= r.out()) {
+        // Removal covers the rest of the range
+        keep = false;
+        break;
+      } else if (it->in() <= r.in()) {
+        // Removal covers the start of the range
+        if (it->out() > r.in()) {
+          r.set_in(it->out());
+        }
+      } else if (it->in() < r.out()) {
+        // Removal covers the end of the range, which also means it's the last one to affect it
+        r.set_out(it->in());
+        break;
+      }
+    }
+
+    if (keep) {
+      result.append(r);
     }
   }
+
+  array_ = result;
 }
 
 bool TimeRangeList::contains(const TimeRange &range, bool in_inclusive, bool out_inclusive) const
 {
-  for (int i=0;i<size();i++) {
-    if (array_.at(i).Contains(range, in_inclusive, out_inclusive)) {
-      return true;
-    }
+  // Ranges don't overlap, so the only one that could contain this is the last one starting before it
+  auto it = std::upper_bound(array_.cbegin(), array_.cend(), range.in(),
+                             [](const rational& t, const TimeRange& r){ return t < r.in(); });
+
+  if (it == array_.cbegin()) {
+    return false;
   }
 
-  return false;
+  return (it - 1)->Contains(range, in_inclusive, out_inclusive);
 }
 
 void TimeRangeList::shift(const rational &diff)
@@ -273,19 +377,14 @@ TimeRangeList TimeRangeList::Intersects(const TimeRange &range) const
 {
   TimeRangeList intersect_list;
 
-  for (int i=0;i<size();i++) {
-    const TimeRange& compare = array_.at(i);
+  // First range that ends after this one starts
+  auto it = std::upper_bound(array_.cbegin(), array_.cend(), range.in(),
+                             [](const rational& t, const TimeRange& r){ return t < r.out(); });
 
-    if (compare.out() <= range.in() || compare.in() >= range.out()) {
-      // No intersect
-      continue;
-    } else {
-      // Crop the time range to the range and add it to the list
-      TimeRange cropped(qMax(range.in(), compare.in()),
-                        qMin(range.out(), compare.out()));
-
-      intersect_list.insert(cropped);
-    }
+  for (; it!=array_.cend() && it->in() < range.out(); it++) {
+    // Crop the time range to the range, which keeps them sorted and apart
+    intersect_list.array_.append(TimeRange(qMax(range.in(), it->in()),
+                                           qMin(range.out(), it->out())));
   }
 
   return intersect_list;
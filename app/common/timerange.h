@@ -67,19 +67,38 @@ private:
 
 };
 
+/**
+ * @brief A set of times stored as sorted, non-overlapping ranges
+ *
+ * Ranges that overlap or touch are coalesced, so the list is always as short as possible and every
+ * range ends strictly before the next one starts. This lets lookups, insertions and removals find
+ * their place with a binary search rather than scanning the whole list.
+ */
 class TimeRangeList {
 public:
   TimeRangeList() = default;
 
-  TimeRangeList(std::initializer_list<TimeRange> r) :
-    array_(r)
+  TimeRangeList(std::initializer_list<TimeRange> r)
   {
+    for (const TimeRange& range : r) {
+      insert(range);
+    }
   }
 
   void insert(TimeRange range_to_add);
 
   void remove(const TimeRange& remove);
 
+  /**
+   * @brief Insert every range in `other`, in time linear to the size of both lists
+   */
+  void merge(const TimeRangeList& other);
+
+  /**
+   * @brief Remove every range in `other`, in time linear to the size of both lists
+   */
+  void subtract(const TimeRangeList& other);
+
   bool contains(const TimeRange& range, bool in_inclusive = true, bool out_inclusive = true) const;
 
   bool isEmpty() const
@@ -0,0 +1,259 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "tracing.h"
+
+#include <chrono>
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutex>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <vector>
+
+namespace olive {
+
+std::atomic_bool Tracer::enabled_(false);
+
+namespace {
+
+struct TraceEvent {
+  const char* category;
+  const char* name;
+  qint64 start;
+
+  // For counters this is the counter's value instead
+  qint64 end;
+
+  int thread;
+  bool counter;
+};
+
+// 32k spans per thread is a few seconds of a busy render thread, which is the window that matters
+// when looking at a slow frame
+const int kTraceBufferSize = 32768;
+
+struct TraceBuffer {
+  QMutex lock;
+  QVector<TraceEvent> events;
+  int next = 0;
+  bool retired = false;
+  int thread = 0;
+};
+
+struct TraceRegistry {
+  QMutex lock;
+
+  // Buffers are never freed so spans from threads that have since exited can still be written out.
+  // Instead, retired buffers are handed to new threads, which keeps thread pool churn bounded.
+  std::vector<TraceBuffer*> buffers;
+
+  QVector<QPair<int, QString> > thread_names;
+
+  int next_thread = 1;
+};
+
+TraceRegistry* GetRegistry()
+{
+  static TraceRegistry registry;
+  return &registry;
+}
+
+struct ThreadTraceBuffer {
+  TraceBuffer* buffer = nullptr;
+
+  ~ThreadTraceBuffer()
+  {
+    if (buffer) {
+      QMutexLocker locker(&buffer->lock);
+      buffer->retired = true;
+    }
+  }
+};
+
+thread_local ThreadTraceBuffer thread_buffer;
+
+TraceBuffer* ClaimBuffer()
+{
+  TraceRegistry* registry = GetRegistry();
+  QMutexLocker locker(&registry->lock);
+
+  TraceBuffer* buffer = nullptr;
+
+  for (TraceBuffer* b : registry->buffers) {
+    QMutexLocker buffer_locker(&b->lock);
+    if (b->retired) {
+      b->retired = false;
+      buffer = b;
+      break;
+    }
+  }
+
+  if (!buffer) {
+    buffer = new TraceBuffer();
+    buffer->events.resize(kTraceBufferSize);
+    registry->buffers.push_back(buffer);
+  }
+
+  // Events keep the ID of the thread that recorded them, so a reused buffer can hold several
+  buffer->thread = registry->next_thread++;
+
+  QString name = QThread::currentThread()->objectName();
+  if (name.isEmpty() && QCoreApplication::instance() && QThread::currentThread() == QCoreApplication::instance()->thread()) {
+    name = QStringLiteral("Main");
+  }
+  if (!name.isEmpty()) {
+    registry->thread_names.append({buffer->thread, name});
+  }
+
+  return buffer;
+}
+
+void RecordInternal(const char *category, const char *name, qint64 start, qint64 end, bool counter)
+{
+  if (!thread_buffer.buffer) {
+    thread_buffer.buffer = ClaimBuffer();
+  }
+
+  TraceBuffer* b = thread_buffer.buffer;
+
+  // Only ever contended while a trace is being written out
+  QMutexLocker locker(&b->lock);
+
+  b->events[b->next] = {category, name, start, end, b->thread, counter};
+  b->next = (b->next + 1) % kTraceBufferSize;
+}
+
+QString EscapeJson(const char* s)
+{
+  QString str = QString::fromUtf8(s);
+  str.replace('\\', QStringLiteral("\\\\"));
+  str.replace('"', QStringLiteral("\\\""));
+  return str;
+}
+
+}
+
+void Tracer::SetEnabled(bool e)
+{
+  enabled_.store(e, std::memory_order_relaxed);
+}
+
+void Tracer::Clear()
+{
+  TraceRegistry* registry = GetRegistry();
+  QMutexLocker locker(&registry->lock);
+
+  for (TraceBuffer* b : registry->buffers) {
+    QMutexLocker buffer_locker(&b->lock);
+    for (TraceEvent& e : b->events) {
+      e.name = nullptr;
+    }
+    b->next = 0;
+  }
+}
+
+qint64 Tracer::Now()
+{
+  static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Tracer::Record(const char *category, const char *name, qint64 start, qint64 end)
+{
+  RecordInternal(category, name, start, end, false);
+}
+
+void Tracer::RecordCounter(const char *category, const char *name, qint64 value)
+{
+  RecordInternal(category, name, Now(), value, true);
+}
+
+bool Tracer::WriteChromeTrace(const QString &filename)
+{
+  QFile f(filename);
+  if (!f.open(QFile::WriteOnly | QFile::Text)) {
+    return false;
+  }
+
+  QTextStream ts(&f);
+  qint64 pid = QCoreApplication::applicationPid();
+
+  ts << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+  bool first = true;
+
+  TraceRegistry* registry = GetRegistry();
+  QMutexLocker locker(&registry->lock);
+
+  for (const QPair<int, QString>& thread : qAsConst(registry->thread_names)) {
+    if (!first) {
+      ts << ',';
+    }
+    first = false;
+
+    ts << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+       << ",\"tid\":" << thread.first
+       << ",\"args\":{\"name\":\"" << EscapeJson(thread.second.toUtf8().constData()) << "\"}}";
+  }
+
+  for (TraceBuffer* b : registry->buffers) {
+    // Copy out so the recording threads are only blocked briefly
+    QVector<TraceEvent> events;
+    {
+      QMutexLocker buffer_locker(&b->lock);
+      events = b->events;
+    }
+
+    for (const TraceEvent& e : qAsConst(events)) {
+      if (!e.name) {
+        continue;
+      }
+
+      if (!first) {
+        ts << ',';
+      }
+      first = false;
+
+      // Chrome trace timestamps are in microseconds
+      ts << "\n{\"name\":\"" << EscapeJson(e.name)
+         << "\",\"cat\":\"" << EscapeJson(e.category)
+         << "\",\"ts\":" << QString::number(e.start / 1000.0, 'f', 3)
+         << ",\"pid\":" << pid
+         << ",\"tid\":" << e.thread;
+
+      if (e.counter) {
+        ts << ",\"ph\":\"C\",\"args\":{\"value\":" << e.end << "}}";
+      } else {
+        ts << ",\"ph\":\"X\",\"dur\":" << QString::number((e.end - e.start) / 1000.0, 'f', 3) << '}';
+      }
+    }
+  }
+
+  ts << "\n]}\n";
+
+  ts.flush();
+
+  return f.error() == QFile::NoError;
+}
+
+}
@@ -0,0 +1,123 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TRACING_H
+#define TRACING_H
+
+#include <atomic>
+#include <QString>
+
+#define OLIVE_TRACE_CONCAT_INTERNAL(a, b) a##b
+#define OLIVE_TRACE_CONCAT(a, b) OLIVE_TRACE_CONCAT_INTERNAL(a, b)
+
+/**
+ * @brief Record the rest of the enclosing scope as a span named `name` in `category`
+ *
+ * Both must be string literals (or otherwise outlive the trace) since only the pointers are kept.
+ */
+#define TRACE_SCOPE(category, name) olive::TraceSpan OLIVE_TRACE_CONCAT(__trace_span_, __LINE__)(category, name)
+
+#define TRACE_THIS_FUNCTION(category) TRACE_SCOPE(category, __FUNCTION__)
+
+/**
+ * @brief Record the current value of a counter (e.g. a queue's length), shown as a graph over time
+ */
+#define TRACE_COUNTER(category, name, value) \
+  do { if (olive::Tracer::IsEnabled()) olive::Tracer::RecordCounter(category, name, value); } while (0)
+
+namespace olive {
+
+/**
+ * @brief Low-overhead recorder of timed spans for finding where time goes across threads
+ *
+ * Each thread records into its own fixed-size ring buffer, so when the buffer fills up the oldest
+ * spans are overwritten rather than memory growing unbounded. While disabled, a span costs a
+ * single atomic load. The recording can be written out as Chrome trace JSON, which can be opened
+ * in chrome://tracing or https://ui.perfetto.dev.
+ */
+class Tracer
+{
+public:
+  static bool IsEnabled()
+  {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  static void SetEnabled(bool e);
+
+  /**
+   * @brief Discard everything recorded so far
+   */
+  static void Clear();
+
+  /**
+   * @brief Nanoseconds since the tracer's epoch, which is shared by all threads
+   */
+  static qint64 Now();
+
+  static void Record(const char* category, const char* name, qint64 start, qint64 end);
+
+  static void RecordCounter(const char* category, const char* name, qint64 value);
+
+  /**
+   * @brief Write everything recorded so far to `filename` in Chrome trace event format
+   */
+  static bool WriteChromeTrace(const QString& filename);
+
+private:
+  static std::atomic_bool enabled_;
+
+};
+
+/**
+ * @brief RAII helper that records its lifetime as a span, use TRACE_SCOPE() rather than this directly
+ */
+class TraceSpan
+{
+public:
+  TraceSpan(const char* category, const char* name) :
+    category_(category),
+    name_(name),
+    start_(Tracer::IsEnabled() ? Tracer::Now() : -1)
+  {
+  }
+
+  ~TraceSpan()
+  {
+    if (start_ >= 0) {
+      Tracer::Record(category_, name_, start_, Tracer::Now());
+    }
+  }
+
+  TraceSpan(const TraceSpan&) = delete;
+  TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+  const char* category_;
+
+  const char* name_;
+
+  qint64 start_;
+
+};
+
+}
+
+#endif // TRACING_H
@@ -0,0 +1,641 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "xmlstream.h"
+
+#include <QCoreApplication>
+
+namespace olive {
+
+namespace {
+
+const char kBinarySignature[] = {'O', 'L', 'V', 'B'};
+const quint32 kBinaryVersion = 1;
+const int kBinaryHeaderSize = 8;
+
+// Buffered binary output is written to the device in chunks of about this size
+const int kBinaryFlushSize = 1048576;
+
+enum BinaryToken : uchar {
+  /// Adds a name to the string table: string
+  kTokenName = 1,
+
+  /// Opens an element: name index, attribute count, [name index, string] per attribute
+  kTokenStartElement,
+
+  /// Closes the most recently opened element
+  kTokenEndElement,
+
+  /// Text inside the current element: string
+  kTokenCharacters,
+
+  /// Element containing only text, equivalent to start, characters and end: name index, string
+  kTokenTextElement
+};
+
+}
+
+XMLReader::XMLReader(QIODevice *device) :
+  binary_(false)
+{
+  if (IsBinary(device)) {
+    InitBinary(device->readAll());
+  } else {
+    xml_.setDevice(device);
+  }
+}
+
+XMLReader::XMLReader(const QString &xml) :
+  binary_(false),
+  xml_(xml)
+{
+}
+
+XMLReader::XMLReader(const QByteArray &data) :
+  binary_(false)
+{
+  if (data.startsWith(QByteArray(kBinarySignature, sizeof(kBinarySignature)))) {
+    InitBinary(data);
+  } else {
+    xml_.addData(data);
+  }
+}
+
+bool XMLReader::IsBinary(QIODevice *device)
+{
+  return device->peek(sizeof(kBinarySignature)) == QByteArray(kBinarySignature, sizeof(kBinarySignature));
+}
+
+void XMLReader::InitBinary(const QByteArray &data)
+{
+  binary_ = true;
+  data_ = data;
+  pos_ = data_.constData();
+  end_ = pos_ + data_.size();
+  token_ = QXmlStreamReader::NoToken;
+  current_name_ = -1;
+  text_element_state_ = kTextElementNone;
+
+  if (data_.size() < kBinaryHeaderSize) {
+    SetBinaryError(QCoreApplication::translate("XMLReader", "File is too short to be a binary project."));
+    return;
+  }
+
+  quint32 version = quint32(uchar(pos_[4]))
+      | (quint32(uchar(pos_[5])) << 8)
+      | (quint32(uchar(pos_[6])) << 16)
+      | (quint32(uchar(pos_[7])) << 24);
+
+  if (version > kBinaryVersion) {
+    SetBinaryError(QCoreApplication::translate("XMLReader", "Binary container version %1 is not supported.").arg(version));
+    return;
+  }
+
+  pos_ += kBinaryHeaderSize;
+}
+
+void XMLReader::SetBinaryError(const QString &s)
+{
+  error_ = s;
+  token_ = QXmlStreamReader::Invalid;
+}
+
+bool XMLReader::ReadVarInt(quint64 *v)
+{
+  quint64 result = 0;
+  int shift = 0;
+
+  while (pos_ < end_ && shift < 64) {
+    uchar b = uchar(*pos_);
+    pos_++;
+
+    result |= quint64(b & 0x7F) << shift;
+
+    if (!(b & 0x80)) {
+      *v = result;
+      return true;
+    }
+
+    shift += 7;
+  }
+
+  SetBinaryError(QCoreApplication::translate("XMLReader", "Unexpected end of binary data."));
+  return false;
+}
+
+bool XMLReader::ReadString(QString *s)
+{
+  quint64 length;
+
+  if (!ReadVarInt(&length)) {
+    return false;
+  }
+
+  if (length > quint64(end_ - pos_)) {
+    SetBinaryError(QCoreApplication::translate("XMLReader", "Unexpected end of binary data."));
+    return false;
+  }
+
+  *s = QString::fromUtf8(pos_, int(length));
+  pos_ += length;
+
+  return true;
+}
+
+bool XMLReader::ReadNameIndex(int *index)
+{
+  quint64 v;
+
+  if (!ReadVarInt(&v)) {
+    return false;
+  }
+
+  if (v >= names_.size()) {
+    SetBinaryError(QCoreApplication::translate("XMLReader", "Invalid name in binary data."));
+    return false;
+  }
+
+  *index = int(v);
+  return true;
+}
+
+QXmlStreamReader::TokenType XMLReader::readNext()
+{
+  if (!binary_) {
+    return xml_.readNext();
+  }
+
+  if (token_ == QXmlStreamReader::Invalid || token_ == QXmlStreamReader::EndDocument) {
+    return token_;
+  }
+
+  // Report the rest of a text element
+  if (text_element_state_ == kTextElementCharacters) {
+    text_element_state_ = kTextElementEnd;
+
+    if (!text_.isEmpty()) {
+      token_ = QXmlStreamReader::Characters;
+      return token_;
+    }
+  }
+
+  if (text_element_state_ == kTextElementEnd) {
+    text_element_state_ = kTextElementNone;
+    attributes_.clear();
+    current_name_ = element_stack_.takeLast();
+    token_ = QXmlStreamReader::EndElement;
+    return token_;
+  }
+
+  attributes_.clear();
+
+  while (pos_ < end_) {
+    uchar t = uchar(*pos_);
+    pos_++;
+
+    switch (t) {
+    case kTokenName:
+    {
+      QString s;
+      if (!ReadString(&s)) {
+        return token_;
+      }
+      names_.push_back(s);
+      break;
+    }
+    case kTokenStartElement:
+    {
+      int name;
+      quint64 attribute_count;
+
+      if (!ReadNameIndex(&name) || !ReadVarInt(&attribute_count)) {
+        return token_;
+      }
+
+      for (quint64 i=0; i<attribute_count; i++) {
+        int attr_name;
+        QString value;
+
+        if (!ReadNameIndex(&attr_name) || !ReadString(&value)) {
+          return token_;
+        }
+
+        attributes_.append(names_[attr_name], value);
+      }
+
+      current_name_ = name;
+      element_stack_.append(name);
+      token_ = QXmlStreamReader::StartElement;
+      return token_;
+    }
+    case kTokenEndElement:
+      if (element_stack_.isEmpty()) {
+        SetBinaryError(QCoreApplication::translate("XMLReader", "Unbalanced element in binary data."));
+        return token_;
+      }
+
+      current_name_ = element_stack_.takeLast();
+      token_ = QXmlStreamReader::EndElement;
+      return token_;
+    case kTokenCharacters:
+      if (!ReadString(&text_)) {
+        return token_;
+      }
+
+      token_ = QXmlStreamReader::Characters;
+      return token_;
+    case kTokenTextElement:
+    {
+      int name;
+
+      if (!ReadNameIndex(&name) || !ReadString(&text_)) {
+        return token_;
+      }
+
+      current_name_ = name;
+      element_stack_.append(name);
+      text_element_state_ = kTextElementCharacters;
+      token_ = QXmlStreamReader::StartElement;
+      return token_;
+    }
+    default:
+      SetBinaryError(QCoreApplication::translate("XMLReader", "Invalid token in binary data."));
+      return token_;
+    }
+  }
+
+  if (element_stack_.isEmpty()) {
+    token_ = QXmlStreamReader::EndDocument;
+  } else {
+    SetBinaryError(QCoreApplication::translate("XMLReader", "Premature end of document."));
+  }
+
+  return token_;
+}
+
+QXmlStreamReader::TokenType XMLReader::tokenType() const
+{
+  return binary_ ? token_ : xml_.tokenType();
+}
+
+bool XMLReader::atEnd() const
+{
+  if (binary_) {
+    return token_ == QXmlStreamReader::EndDocument || token_ == QXmlStreamReader::Invalid;
+  }
+
+  return xml_.atEnd();
+}
+
+QStringRef XMLReader::name() const
+{
+  if (!binary_) {
+    return xml_.name();
+  }
+
+  if ((token_ == QXmlStreamReader::StartElement || token_ == QXmlStreamReader::EndElement)
+      && current_name_ >= 0) {
+    return QStringRef(&names_[current_name_]);
+  }
+
+  return QStringRef();
+}
+
+QXmlStreamAttributes XMLReader::attributes() const
+{
+  if (!binary_) {
+    return xml_.attributes();
+  }
+
+  return (token_ == QXmlStreamReader::StartElement) ? attributes_ : QXmlStreamAttributes();
+}
+
+QStringRef XMLReader::text() const
+{
+  if (!binary_) {
+    return xml_.text();
+  }
+
+  return (token_ == QXmlStreamReader::Characters) ? QStringRef(&text_) : QStringRef();
+}
+
+QString XMLReader::readElementText()
+{
+  if (!binary_) {
+    return xml_.readElementText();
+  }
+
+  if (token_ != QXmlStreamReader::StartElement) {
+    return QString();
+  }
+
+  if (text_element_state_ != kTextElementNone) {
+    // Fast path, the whole element is already in memory
+    text_element_state_ = kTextElementNone;
+    attributes_.clear();
+    current_name_ = element_stack_.takeLast();
+    token_ = QXmlStreamReader::EndElement;
+    return text_;
+  }
+
+  QString result;
+
+  while (true) {
+    switch (readNext()) {
+    case QXmlStreamReader::Characters:
+      result.append(text_);
+      break;
+    case QXmlStreamReader::StartElement:
+      // Only text is expected, ignore anything nested
+      skipCurrentElement();
+      break;
+    case QXmlStreamReader::EndElement:
+    case QXmlStreamReader::EndDocument:
+    case QXmlStreamReader::Invalid:
+      return result;
+    default:
+      break;
+    }
+  }
+}
+
+void XMLReader::skipCurrentElement()
+{
+  if (!binary_) {
+    xml_.skipCurrentElement();
+    return;
+  }
+
+  int depth = 1;
+
+  while (depth > 0) {
+    switch (readNext()) {
+    case QXmlStreamReader::StartElement:
+      depth++;
+      break;
+    case QXmlStreamReader::EndElement:
+      depth--;
+      break;
+    case QXmlStreamReader::EndDocument:
+    case QXmlStreamReader::Invalid:
+      return;
+    default:
+      break;
+    }
+  }
+}
+
+bool XMLReader::hasError() const
+{
+  return binary_ ? !error_.isEmpty() : xml_.hasError();
+}
+
+QString XMLReader::errorString() const
+{
+  return binary_ ? error_ : xml_.errorString();
+}
+
+XMLWriter::XMLWriter(QIODevice *device, Format format) :
+  format_(format),
+  xml_(nullptr),
+  device_(device),
+  open_elements_(0),
+  error_(false),
+  start_pending_(false)
+{
+  if (format_ == kXML) {
+    xml_ = new QXmlStreamWriter(device);
+  }
+}
+
+XMLWriter::XMLWriter(QString *string) :
+  format_(kXML),
+  xml_(new QXmlStreamWriter(string)),
+  device_(nullptr),
+  open_elements_(0),
+  error_(false),
+  start_pending_(false)
+{
+}
+
+XMLWriter::~XMLWriter()
+{
+  if (format_ == kBinary) {
+    FlushStartElement();
+    FlushBuffer();
+  }
+
+  delete xml_;
+}
+
+void XMLWriter::setAutoFormatting(bool e)
+{
+  if (xml_) {
+    xml_->setAutoFormatting(e);
+  }
+}
+
+void XMLWriter::writeStartDocument()
+{
+  if (xml_) {
+    xml_->writeStartDocument();
+    return;
+  }
+
+  buffer_.append(kBinarySignature, sizeof(kBinarySignature));
+
+  for (int i=0; i<4; i++) {
+    buffer_.append(char((kBinaryVersion >> (i * 8)) & 0xFF));
+  }
+}
+
+void XMLWriter::writeEndDocument()
+{
+  if (xml_) {
+    xml_->writeEndDocument();
+    return;
+  }
+
+  FlushStartElement();
+
+  // Close anything left open, as QXmlStreamWriter does
+  while (open_elements_ > 0) {
+    buffer_.append(char(kTokenEndElement));
+    open_elements_--;
+  }
+
+  FlushBuffer();
+}
+
+void XMLWriter::writeStartElement(const QString &name)
+{
+  if (xml_) {
+    xml_->writeStartElement(name);
+    return;
+  }
+
+  FlushStartElement();
+
+  // Attributes follow, so the element itself is written once we know them all
+  pending_name_ = GetNameIndex(name);
+  pending_attributes_.clear();
+  start_pending_ = true;
+}
+
+void XMLWriter::writeAttribute(const QString &name, const QString &value)
+{
+  if (xml_) {
+    xml_->writeAttribute(name, value);
+    return;
+  }
+
+  if (start_pending_) {
+    pending_attributes_.append({GetNameIndex(name), value});
+  }
+}
+
+void XMLWriter::writeTextElement(const QString &name, const QString &text)
+{
+  if (xml_) {
+    xml_->writeTextElement(name, text);
+    return;
+  }
+
+  FlushStartElement();
+
+  int index = GetNameIndex(name);
+
+  buffer_.append(char(kTokenTextElement));
+  WriteVarInt(quint64(index));
+  WriteString(text);
+
+  if (buffer_.size() >= kBinaryFlushSize) {
+    FlushBuffer();
+  }
+}
+
+void XMLWriter::writeCharacters(const QString &text)
+{
+  if (xml_) {
+    xml_->writeCharacters(text);
+    return;
+  }
+
+  FlushStartElement();
+
+  buffer_.append(char(kTokenCharacters));
+  WriteString(text);
+}
+
+void XMLWriter::writeEndElement()
+{
+  if (xml_) {
+    xml_->writeEndElement();
+    return;
+  }
+
+  FlushStartElement();
+
+  if (open_elements_ > 0) {
+    buffer_.append(char(kTokenEndElement));
+    open_elements_--;
+  }
+}
+
+bool XMLWriter::hasError() const
+{
+  return xml_ ? xml_->hasError() : error_;
+}
+
+int XMLWriter::GetNameIndex(const QString &name)
+{
+  auto it = name_indices_.constFind(name);
+  if (it != name_indices_.constEnd()) {
+    return it.value();
+  }
+
+  int index = name_indices_.size();
+  name_indices_.insert(name, index);
+
+  buffer_.append(char(kTokenName));
+  WriteString(name);
+
+  return index;
+}
+
+void XMLWriter::FlushStartElement()
+{
+  if (!start_pending_) {
+    return;
+  }
+
+  buffer_.append(char(kTokenStartElement));
+  WriteVarInt(quint64(pending_name_));
+  WriteVarInt(quint64(pending_attributes_.size()));
+
+  for (const QPair<int, QString>& a : pending_attributes_) {
+    WriteVarInt(quint64(a.first));
+    WriteString(a.second);
+  }
+
+  open_elements_++;
+  start_pending_ = false;
+
+  if (buffer_.size() >= kBinaryFlushSize) {
+    FlushBuffer();
+  }
+}
+
+void XMLWriter::FlushBuffer()
+{
+  if (buffer_.isEmpty() || !device_) {
+    return;
+  }
+
+  if (device_->write(buffer_) != buffer_.size()) {
+    error_ = true;
+  }
+
+  buffer_.resize(0);
+}
+
+void XMLWriter::WriteVarInt(quint64 v)
+{
+  do {
+    uchar b = uchar(v & 0x7F);
+    v >>= 7;
+
+    if (v) {
+      b |= 0x80;
+    }
+
+    buffer_.append(char(b));
+  } while (v);
+}
+
+void XMLWriter::WriteString(const QString &s)
+{
+  QByteArray utf8 = s.toUtf8();
+
+  WriteVarInt(quint64(utf8.size()));
+  buffer_.append(utf8);
+}
+
+}
@@ -0,0 +1,212 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef XMLSTREAM_H
+#define XMLSTREAM_H
+
+#include <deque>
+#include <QHash>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+
+#include "common/define.h"
+
+namespace olive {
+
+/**
+ * @brief Reads an element tree either from XML or from Olive's binary container
+ *
+ * Exposes the subset of QXmlStreamReader that project, preset and config loading use, so code
+ * written against it doesn't need to know which format it's reading. When constructed from a
+ * device, the format is detected from the first bytes.
+ *
+ * The binary container holds exactly the same element tree as the XML (see XMLWriter), stored
+ * as tagged tokens with element and attribute names interned in a string table. Reading it is a
+ * linear walk over length-prefixed data with no tokenizing, escaping or whitespace handling.
+ */
+class XMLReader
+{
+public:
+  XMLReader(QIODevice* device);
+  XMLReader(const QString& xml);
+  XMLReader(const QByteArray& data);
+
+  DISABLE_COPY_MOVE(XMLReader)
+
+  /**
+   * @brief Returns TRUE if `device` starts with the binary container's signature
+   */
+  static bool IsBinary(QIODevice* device);
+
+  bool is_binary() const
+  {
+    return binary_;
+  }
+
+  QXmlStreamReader::TokenType readNext();
+
+  QXmlStreamReader::TokenType tokenType() const;
+
+  bool isStartElement() const
+  {
+    return tokenType() == QXmlStreamReader::StartElement;
+  }
+
+  bool isEndElement() const
+  {
+    return tokenType() == QXmlStreamReader::EndElement;
+  }
+
+  bool atEnd() const;
+
+  QStringRef name() const;
+
+  QXmlStreamAttributes attributes() const;
+
+  QStringRef text() const;
+
+  QString readElementText();
+
+  void skipCurrentElement();
+
+  bool hasError() const;
+
+  QString errorString() const;
+
+private:
+  void InitBinary(const QByteArray& data);
+
+  void SetBinaryError(const QString& s);
+
+  bool ReadVarInt(quint64* v);
+
+  bool ReadString(QString* s);
+
+  bool ReadNameIndex(int* index);
+
+  bool binary_;
+
+  QXmlStreamReader xml_;
+
+  // Binary state
+  QByteArray data_;
+  const char* pos_;
+  const char* end_;
+
+  // deque so that references given out by name() stay valid as more names are read
+  std::deque<QString> names_;
+
+  QVector<int> element_stack_;
+
+  QXmlStreamReader::TokenType token_;
+  int current_name_;
+  QXmlStreamAttributes attributes_;
+  QString text_;
+
+  // Text element tokens are reported as start, characters and end, this tracks which is next
+  enum TextElementState {
+    kTextElementNone,
+    kTextElementCharacters,
+    kTextElementEnd
+  };
+
+  TextElementState text_element_state_;
+
+  QString error_;
+
+};
+
+/**
+ * @brief Writes an element tree as XML or as Olive's binary container
+ *
+ * Exposes the subset of QXmlStreamWriter used for saving projects, presets and config. Anything
+ * written in one format can be read back through XMLReader and will produce exactly the same
+ * sequence of elements, attributes and text as the other.
+ */
+class XMLWriter
+{
+public:
+  enum Format {
+    kXML,
+    kBinary
+  };
+
+  XMLWriter(QIODevice* device, Format format = kXML);
+  XMLWriter(QString* string);
+
+  ~XMLWriter();
+
+  DISABLE_COPY_MOVE(XMLWriter)
+
+  Format format() const
+  {
+    return format_;
+  }
+
+  void setAutoFormatting(bool e);
+
+  void writeStartDocument();
+
+  void writeEndDocument();
+
+  void writeStartElement(const QString& name);
+
+  void writeAttribute(const QString& name, const QString& value);
+
+  void writeTextElement(const QString& name, const QString& text);
+
+  void writeCharacters(const QString& text);
+
+  void writeEndElement();
+
+  bool hasError() const;
+
+private:
+  int GetNameIndex(const QString& name);
+
+  void FlushStartElement();
+
+  void FlushBuffer();
+
+  void WriteVarInt(quint64 v);
+
+  void WriteString(const QString& s);
+
+  Format format_;
+
+  // Only used for XML output
+  QXmlStreamWriter* xml_;
+
+  // Binary state
+  QIODevice* device_;
+  QByteArray buffer_;
+  QHash<QString, int> name_indices_;
+  int open_elements_;
+  bool error_;
+
+  bool start_pending_;
+  int pending_name_;
+  QVector< QPair<int, QString> > pending_attributes_;
+
+};
+
+}
+
+#endif // XMLSTREAM_H
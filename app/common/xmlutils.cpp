@@ -20,6 +20,8 @@
 
 #include "xmlutils.h"
 
+#include <QBuffer>
+
 #include "node/block/block.h"
 #include "node/factory.h"
 #include "widget/nodeview/nodeviewundo.h"
@@ -41,7 +43,7 @@ void XMLConnectNodes(const XMLNodeData &xml_node_data, MultiUndoCommand *command
   }
 }
 
-bool XMLReadNextStartElement(QXmlStreamReader *reader)
+bool XMLReadNextStartElement(XMLReader *reader)
 {
   QXmlStreamReader::TokenType token;
 
@@ -57,6 +59,54 @@ bool XMLReadNextStartElement(QXmlStreamReader *reader)
   return false;
 }
 
+void XMLCopyElement(XMLReader *reader, XMLWriter *writer)
+{
+  int depth = 0;
+
+  do {
+    if (reader->isStartElement()) {
+      writer->writeStartElement(reader->name().toString());
+
+      foreach (const QXmlStreamAttribute& attr, reader->attributes()) {
+        writer->writeAttribute(attr.name().toString(), attr.value().toString());
+      }
+
+      depth++;
+    } else if (reader->isEndElement()) {
+      writer->writeEndElement();
+      depth--;
+    } else if (reader->tokenType() == QXmlStreamReader::Characters) {
+      writer->writeCharacters(reader->text().toString());
+    }
+  } while (depth > 0 && reader->readNext() != QXmlStreamReader::Invalid
+           && reader->tokenType() != QXmlStreamReader::EndDocument);
+}
+
+QByteArray XMLCaptureElement(XMLReader *reader)
+{
+  QByteArray data;
+  QBuffer buffer(&data);
+  buffer.open(QBuffer::WriteOnly);
+
+  {
+    XMLWriter writer(&buffer, XMLWriter::kBinary);
+    writer.writeStartDocument();
+    XMLCopyElement(reader, &writer);
+    writer.writeEndDocument();
+  }
+
+  return data;
+}
+
+void XMLWriteCapturedElement(XMLWriter *writer, const QByteArray &data)
+{
+  XMLReader reader(data);
+
+  if (XMLReadNextStartElement(&reader)) {
+    XMLCopyElement(&reader, writer);
+  }
+}
+
 void XMLLinkBlocks(const XMLNodeData &xml_node_data)
 {
   foreach (const XMLNodeData::BlockLink& l, xml_node_data.block_links) {
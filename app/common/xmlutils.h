@@ -21,8 +21,7 @@
 #ifndef XMLREADLOOP_H
 #define XMLREADLOOP_H
 
-#include <QXmlStreamReader>
-
+#include "common/xmlstream.h"
 #include "node/param.h"
 #include "undo/undocommand.h"
 
@@ -64,10 +63,32 @@ void XMLConnectNodes(const XMLNodeData& xml_node_data, MultiUndoCommand *command
  *
  * See also: https://stackoverflow.com/questions/46346450/qt-qxmlstreamreader-always-returns-premature-end-of-document-error
  */
-bool XMLReadNextStartElement(QXmlStreamReader* reader);
+bool XMLReadNextStartElement(XMLReader* reader);
 
 void XMLLinkBlocks(const XMLNodeData& xml_node_data);
 
+/**
+ * @brief Copy the current element out of `reader` into a standalone binary document
+ *
+ * The reader must be positioned on a start element, and is left on its matching end element. The
+ * returned data can be read with its own XMLReader, where the first XMLReadNextStartElement()
+ * lands on the copied element. This lets element contents be parsed independently, e.g. on
+ * another thread.
+ */
+QByteArray XMLCaptureElement(XMLReader* reader);
+
+/**
+ * @brief Write the element at the reader's position and everything inside it to `writer`
+ *
+ * The reader is left on the element's matching end element.
+ */
+void XMLCopyElement(XMLReader* reader, XMLWriter* writer);
+
+/**
+ * @brief Write an element previously captured with XMLCaptureElement() to `writer`
+ */
+void XMLWriteCapturedElement(XMLWriter* writer, const QByteArray& data);
+
 }
 
 #endif // XMLREADLOOP_H
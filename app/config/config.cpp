@@ -25,10 +25,11 @@
 #include <QDir>
 #include <QMessageBox>
 #include <QStandardPaths>
-#include <QXmlStreamWriter>
 
+#include "audio/audioresampler.h"
 #include "common/autoscroll.h"
 #include "common/filefunctions.h"
+#include "common/xmlstream.h"
 #include "common/xmlutils.h"
 #include "core.h"
 #include "ui/style/style.h"
@@ -36,8 +37,42 @@
 
 namespace olive {
 
+// Handles must be defined before current_config_ so they exist when its defaults are set
+const ConfigKey<bool> Config::kLoop("Loop");
+const ConfigKey<bool> Config::kAudioScrubbing("AudioScrubbing");
+const ConfigKey<int> Config::kOfflinePixelFormat("OfflinePixelFormat");
+const ConfigKey<rational> Config::kDiskCacheAhead("DiskCacheAhead");
+const ConfigKey<rational> Config::kDiskCacheBehind("DiskCacheBehind");
+const ConfigKey<bool> Config::kAutoCacheSkipRealtimeFrames("AutoCacheSkipRealtimeFrames");
+const ConfigKey<bool> Config::kProxyEnabled("ProxyEnabled");
+const ConfigKey<int> Config::kProxyDivider("ProxyDivider");
+const ConfigKey<int> Config::kAudioRenderBlockSize("AudioRenderBlockSize");
+const ConfigKey<int> Config::kAudioResampleQuality("AudioResampleQuality");
+const ConfigKey<int> Config::kImageSequenceReadAhead("ImageSequenceReadAhead");
+const ConfigKey<bool> Config::kGPUDeinterlace("GPUDeinterlace");
+const ConfigKey<int> Config::kAudioBackend("AudioBackend");
+const ConfigKey<int> Config::kAudioBufferFrames("AudioBufferFrames");
+const ConfigKey<bool> Config::kAudioExclusiveMode("AudioExclusiveMode");
+
 Config Config::current_config_;
 
+ConfigKeyBase::ConfigKeyBase(const QString &name) :
+  name_(name)
+{
+  Registry().insert(name_, this);
+}
+
+ConfigKeyBase::~ConfigKeyBase()
+{
+  Registry().remove(name_);
+}
+
+QHash<QString, ConfigKeyBase *> &ConfigKeyBase::Registry()
+{
+  static QHash<QString, ConfigKeyBase*> registry;
+  return registry;
+}
+
 Config::Config()
 {
   SetDefaults();
@@ -46,6 +81,15 @@ Config::Config()
 void Config::SetEntryInternal(const QString &key, NodeValue::Type type, const QVariant &data)
 {
   config_map_[key] = {type, data};
+  UpdateKeyHandle(key, data);
+}
+
+void Config::UpdateKeyHandle(const QString &key, const QVariant &data)
+{
+  ConfigKeyBase* handle = ConfigKeyBase::Registry().value(key);
+  if (handle) {
+    handle->Update(data);
+  }
 }
 
 QString Config::GetConfigFilePath()
@@ -69,6 +113,8 @@ void Config::SetDefaults()
   SetEntryInternal(QStringLiteral("AutorecoveryEnabled"), NodeValue::kBoolean, true);
   SetEntryInternal(QStringLiteral("AutorecoveryInterval"), NodeValue::kInt, 1);
   SetEntryInternal(QStringLiteral("AutorecoveryMaximum"), NodeValue::kInt, 20);
+  SetEntryInternal(QStringLiteral("BinaryProjectFiles"), NodeValue::kBoolean, false);
+  SetEntryInternal(QStringLiteral("LazyLoadSequences"), NodeValue::kBoolean, true);
   SetEntryInternal(QStringLiteral("DiskCacheSaveInterval"), NodeValue::kInt, 10000);
   SetEntryInternal(QStringLiteral("Language"), NodeValue::kText, QString());
   SetEntryInternal(QStringLiteral("ScrollZooms"), NodeValue::kBoolean, false);
@@ -98,6 +144,7 @@ void Config::SetDefaults()
 
   SetEntryInternal(QStringLiteral("AutoCacheEnabled"), NodeValue::kBoolean, true);
   SetEntryInternal(QStringLiteral("AutoCacheDelay"), NodeValue::kInt, 1000);
+  SetEntryInternal(QStringLiteral("AutoCacheSkipRealtimeFrames"), NodeValue::kBoolean, true);
 
   SetEntryInternal(QStringLiteral("CatColor0"), NodeValue::kInt, 0);
   SetEntryInternal(QStringLiteral("CatColor1"), NodeValue::kInt, 1);
@@ -114,9 +161,48 @@ void Config::SetDefaults()
 
   SetEntryInternal(QStringLiteral("AudioOutput"), NodeValue::kText, QString());
   SetEntryInternal(QStringLiteral("AudioInput"), NodeValue::kText, QString());
+  SetEntryInternal(QStringLiteral("AudioOutputLatency"), NodeValue::kInt, 40);
+  SetEntryInternal(QStringLiteral("AudioBackend"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("AudioBufferFrames"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("AudioExclusiveMode"), NodeValue::kBoolean, false);
+  SetEntryInternal(QStringLiteral("AudioRenderBlockSize"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("AudioResampleQuality"), NodeValue::kInt, AudioResampler::kQualityHigh);
 
   SetEntryInternal(QStringLiteral("DiskCacheBehind"), NodeValue::kRational, QVariant::fromValue(rational(1)));
   SetEntryInternal(QStringLiteral("DiskCacheAhead"), NodeValue::kRational, QVariant::fromValue(rational(5)));
+  SetEntryInternal(QStringLiteral("GPUCacheSize"), NodeValue::kInt, 1024);
+  SetEntryInternal(QStringLiteral("StillImageCacheSize"), NodeValue::kInt, 1024);
+  SetEntryInternal(QStringLiteral("ImageCacheSize"), NodeValue::kInt, 1024);
+  SetEntryInternal(QStringLiteral("ImageSequenceReadAhead"), NodeValue::kInt, 8);
+  SetEntryInternal(QStringLiteral("RenderContextCount"), NodeValue::kInt, 1);
+  SetEntryInternal(QStringLiteral("TexturePoolSize"), NodeValue::kInt, 2048);
+  SetEntryInternal(QStringLiteral("ExportBufferSize"), NodeValue::kInt, 2048);
+  SetEntryInternal(QStringLiteral("ExportCheckpointInterval"), NodeValue::kInt, 60);
+  SetEntryInternal(QStringLiteral("NodeValueCacheSize"), NodeValue::kInt, 256);
+  SetEntryInternal(QStringLiteral("FrameMemoryCacheSize"), NodeValue::kInt, 1024);
+  SetEntryInternal(QStringLiteral("UndoMemoryLimit"), NodeValue::kInt, 512);
+  SetEntryInternal(QStringLiteral("HardwareDecoding"), NodeValue::kText, QString());
+  SetEntryInternal(QStringLiteral("DecoderCacheSize"), NodeValue::kInt, 512);
+  SetEntryInternal(QStringLiteral("RAMBudget"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("VRAMBudget"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("ScopeSampleLines"), NodeValue::kInt, 256);
+  SetEntryInternal(QStringLiteral("AdaptivePlaybackResolution"), NodeValue::kBoolean, false);
+  SetEntryInternal(QStringLiteral("ProxyEnabled"), NodeValue::kBoolean, true);
+  SetEntryInternal(QStringLiteral("ProxyDivider"), NodeValue::kInt, 4);
+  SetEntryInternal(QStringLiteral("GPUDeinterlace"), NodeValue::kBoolean, true);
+
+  // Thread counts and queue depths, 0 uses the values HardwareProfile calibrated for this computer
+  SetEntryInternal(QStringLiteral("RenderThreads"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("DecodeThreads"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("RenderFramesInFlight"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("CacheWriteThreads"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("CalibratedHardware"), NodeValue::kText, QString());
+  SetEntryInternal(QStringLiteral("CalibratedRenderThreads"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("CalibratedDecodeThreads"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("CalibratedFramesInFlight"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("CalibratedCacheWriteThreads"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("CalibratedDiskWriteSpeed"), NodeValue::kInt, 0);
+  SetEntryInternal(QStringLiteral("CalibratedGPUTransferSpeed"), NodeValue::kInt, 0);
 
   SetEntryInternal(QStringLiteral("DefaultSequenceWidth"), NodeValue::kInt, 1920);
   SetEntryInternal(QStringLiteral("DefaultSequenceHeight"), NodeValue::kInt, 1080);
@@ -147,7 +233,7 @@ void Config::Load()
   // Reset to defaults
   current_config_.SetDefaults();
 
-  QXmlStreamReader reader(&config_file);
+  XMLReader reader(&config_file);
 
   QString config_version;
 
@@ -186,9 +272,9 @@ void Config::Load()
 
           qDebug() << "  CONFIG: Closest match was" << match.toDouble();
 
-          current_config_[key] = QVariant::fromValue(match.flipped());
+          current_config_.Set(key, QVariant::fromValue(match.flipped()));
         } else {
-          current_config_[key] = NodeValue::StringToValue(current_config_.GetConfigEntryType(key), value, false);
+          current_config_.Set(key, NodeValue::StringToValue(current_config_.GetConfigEntryType(key), value, false));
         }
       }
 
@@ -226,7 +312,7 @@ void Config::Save()
     return;
   }
 
-  QXmlStreamWriter writer(&config_file);
+  XMLWriter writer(&config_file);
   writer.setAutoFormatting(true);
 
   writer.writeStartDocument();
@@ -266,9 +352,11 @@ QVariant Config::operator[](const QString &key) const
   return config_map_[key].data;
 }
 
-QVariant &Config::operator[](const QString &key)
+void Config::Set(const QString &key, const QVariant &value)
 {
-  return config_map_[key].data;
+  config_map_[key].data = value;
+  UpdateKeyHandle(key, value);
+  emit ValueChanged(key);
 }
 
 NodeValue::Type Config::GetConfigEntryType(const QString &key) const
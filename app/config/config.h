@@ -21,16 +21,130 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <atomic>
+#include <QHash>
 #include <QMap>
+#include <QMutex>
+#include <QObject>
 #include <QString>
 #include <QVariant>
+#include <type_traits>
 
 #include "common/timecodefunctions.h"
 #include "node/value.h"
 
 namespace olive {
 
-class Config {
+/**
+ * @brief Untyped base of ConfigKey, lets Config push new values into every handle by name
+ */
+class ConfigKeyBase
+{
+public:
+  ConfigKeyBase(const QString& name);
+
+  virtual ~ConfigKeyBase();
+
+  const QString& name() const
+  {
+    return name_;
+  }
+
+protected:
+  virtual void Update(const QVariant& value) = 0;
+
+private:
+  static QHash<QString, ConfigKeyBase*>& Registry();
+
+  QString name_;
+
+  friend class Config;
+
+};
+
+/**
+ * @brief Typed handle to a single config entry with its value cached
+ *
+ * Reading a handle skips the string lookup and QVariant unboxing of Config::operator[], which makes
+ * it suitable for code that reads settings every frame or from render threads. The cache is
+ * updated whenever the entry is set through Config. Integral values are held in an atomic, other
+ * types behind a mutex.
+ */
+template <typename T>
+class ConfigKey : public ConfigKeyBase
+{
+public:
+  ConfigKey(const char* name) :
+    ConfigKeyBase(QString::fromLatin1(name))
+  {
+  }
+
+  T Get() const
+  {
+    return value_.Load();
+  }
+
+  operator T() const
+  {
+    return Get();
+  }
+
+protected:
+  virtual void Update(const QVariant& value) override
+  {
+    value_.Store(value.value<T>());
+  }
+
+private:
+  template <typename U, typename = void>
+  class Storage
+  {
+  public:
+    U Load() const
+    {
+      QMutexLocker locker(&lock_);
+      return value_;
+    }
+
+    void Store(const U& v)
+    {
+      QMutexLocker locker(&lock_);
+      value_ = v;
+    }
+
+  private:
+    mutable QMutex lock_;
+
+    U value_ = U();
+
+  };
+
+  template <typename U>
+  class Storage<U, typename std::enable_if<std::is_integral<U>::value>::type>
+  {
+  public:
+    U Load() const
+    {
+      return value_.load(std::memory_order_relaxed);
+    }
+
+    void Store(const U& v)
+    {
+      value_.store(v, std::memory_order_relaxed);
+    }
+
+  private:
+    std::atomic<U> value_{U()};
+
+  };
+
+  Storage<T> value_;
+
+};
+
+class Config : public QObject
+{
+  Q_OBJECT
 public:
   static Config& Current();
 
@@ -42,10 +156,33 @@ public:
 
   QVariant operator[](const QString&) const;
 
-  QVariant& operator[](const QString&);
+  /**
+   * @brief Set an entry, updating its ConfigKey handle if it has one and emitting ValueChanged()
+   */
+  void Set(const QString& key, const QVariant& value);
 
   NodeValue::Type GetConfigEntryType(const QString& key) const;
 
+  // Handles for entries that are read on hot paths
+  static const ConfigKey<bool> kLoop;
+  static const ConfigKey<bool> kAudioScrubbing;
+  static const ConfigKey<int> kOfflinePixelFormat;
+  static const ConfigKey<rational> kDiskCacheAhead;
+  static const ConfigKey<rational> kDiskCacheBehind;
+  static const ConfigKey<bool> kAutoCacheSkipRealtimeFrames;
+  static const ConfigKey<bool> kProxyEnabled;
+  static const ConfigKey<int> kProxyDivider;
+  static const ConfigKey<int> kAudioRenderBlockSize;
+  static const ConfigKey<int> kAudioResampleQuality;
+  static const ConfigKey<int> kImageSequenceReadAhead;
+  static const ConfigKey<bool> kGPUDeinterlace;
+  static const ConfigKey<int> kAudioBackend;
+  static const ConfigKey<int> kAudioBufferFrames;
+  static const ConfigKey<bool> kAudioExclusiveMode;
+
+signals:
+  void ValueChanged(const QString& key);
+
 private:
   Config();
 
@@ -56,6 +193,8 @@ private:
 
   void SetEntryInternal(const QString& key, NodeValue::Type type, const QVariant& data);
 
+  static void UpdateKeyHandle(const QString& key, const QVariant& data);
+
   QMap<QString, ConfigEntry> config_map_;
 
   static Config current_config_;
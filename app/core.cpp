@@ -27,16 +27,22 @@
 #include <QFileInfo>
 #include <QHBoxLayout>
 #include <QInputDialog>
+#include <QJsonDocument>
 #include <QMessageBox>
 #include <QStyleFactory>
+#include <QtConcurrent/QtConcurrent>
 #ifdef Q_OS_WINDOWS
 #include <QtPlatformHeaders/QWindowsWindowFunctions>
 #endif
 
 #include "audio/audiomanager.h"
-#include "cli/clitask/clitaskdialog.h"
+#include "cli/cliexport/cliexportmanager.h"
 #include "codec/conformmanager.h"
+#include "codec/ffmpeg/ffmpegkeyframeindex.h"
+#include "codec/proxymanager.h"
 #include "common/filefunctions.h"
+#include "common/metricsserver.h"
+#include "common/tracing.h"
 #include "common/xmlutils.h"
 #include "config/config.h"
 #include "dialog/about/about.h"
@@ -48,11 +54,17 @@
 #include "dialog/preferences/preferences.h"
 #include "node/color/colormanager/colormanager.h"
 #include "node/factory.h"
+#include "node/project/projectsnapshot.h"
 #include "panel/panelmanager.h"
 #include "panel/project/project.h"
 #include "panel/viewer/viewer.h"
 #include "render/diskmanager.h"
+#include "render/framehashcache.h"
 #include "render/framemanager.h"
+#include "render/hardwareprofile.h"
+#include "render/memorygovernor.h"
+#include "render/opengl/openglprogramcache.h"
+#include "render/projectcachestate.h"
 #include "render/rendermanager.h"
 #ifdef USE_OTIO
 #include "task/project/loadotio/loadotio.h"
@@ -110,6 +122,7 @@ void Core::DeclareTypesForQt()
   qRegisterMetaType<olive::TimeRange>();
   qRegisterMetaType<Color>();
   qRegisterMetaType<olive::AudioVisualWaveform>();
+  qRegisterMetaType<olive::AudioLevels>();
   qRegisterMetaType<olive::SampleJob>();
   qRegisterMetaType<olive::ShaderJob>();
   qRegisterMetaType<olive::GenerateJob>();
@@ -121,33 +134,58 @@ void Core::DeclareTypesForQt()
 
 void Core::Start()
 {
+  // Start tracing before anything else so startup is included
+  if (!core_params_.trace_filename().isEmpty()) {
+    Tracer::SetEnabled(true);
+  }
+
+  if (core_params_.metrics_port() > 0) {
+    MetricsServer::CreateInstance(core_params_.metrics_port());
+  }
+
   // Load application config
   Config::Load();
 
   // Set locale based on either startup arg, config, or auto-detect
   SetStartupLocale();
 
+  // On first run or new hardware, measure this computer before any thread pools are sized
+  HardwareProfile::Calibrate();
+
+  // Start parsing the default OCIO config in the background, it's needed when the first project
+  // is created
+  ColorManager::SetUpDefaultConfig();
+
+  // Likewise, read cached shader binaries so effects don't have to be compiled on first use
+  OpenGLProgramCache::Preload();
+
   // Declare custom types for Qt signal/slot system
   DeclareTypesForQt();
 
   // Set up node factory/library
   NodeFactory::Initialize();
 
-  // Set up color manager's default config
-  ColorManager::SetUpDefaultConfig();
-
   // Initialize task manager
   TaskManager::CreateInstance();
 
+  // Initialize MemoryGovernor, which the caches below register with
+  MemoryGovernor::CreateInstance();
+
   // Initialize RenderManager
   RenderManager::CreateInstance();
 
+  // Likewise for the GPU, which can only be measured once there's a render context
+  HardwareProfile::CalibrateGPU();
+
   // Initialize FrameManager
   FrameManager::CreateInstance();
 
   // Initialize ConformManager
   ConformManager::CreateInstance();
 
+  // Initialize ProxyManager
+  ProxyManager::CreateInstance();
+
   //
   // Start application
   //
@@ -163,11 +201,17 @@ void Core::Start()
     QMetaObject::invokeMethod(this, "OpenStartupProject", Qt::QueuedConnection);
     break;
   case CoreParams::kHeadlessExport:
-    qInfo() << "Headless export is not fully implemented yet";
+    QMetaObject::invokeMethod(this, "StartHeadlessExport", Qt::QueuedConnection);
     break;
   case CoreParams::kHeadlessPreCache:
     qInfo() << "Headless pre-cache is not fully implemented yet";
     break;
+  case CoreParams::kPlaybackBenchmark:
+    // Playback has to go through a real viewer to be worth measuring
+    StartGUI(core_params_.fullscreen());
+
+    QMetaObject::invokeMethod(this, "StartPlaybackBenchmark", Qt::QueuedConnection);
+    break;
   }
 }
 
@@ -192,12 +236,32 @@ void Core::Stop()
     }
   }
 
+  ProxyManager::DestroyInstance();
+
   ConformManager::DestroyInstance();
 
+  FFmpegKeyframeIndex::CancelBuilds();
+
   FrameManager::DestroyInstance();
 
   RenderManager::DestroyInstance();
 
+  // Finish writing any auto-recoveries in progress
+  autorecovery_future_.waitForFinished();
+
+  // Finish writing any frames still queued for the disk cache
+  FrameHashCache::WaitForPendingWrites();
+
+  if (!core_params_.trace_filename().isEmpty()) {
+    Tracer::SetEnabled(false);
+
+    if (!Tracer::WriteChromeTrace(core_params_.trace_filename())) {
+      qCritical() << "Failed to write trace to" << core_params_.trace_filename();
+    }
+  }
+
+  MetricsServer::DestroyInstance();
+
   MenuShared::DestroyInstance();
 
   TaskManager::DestroyInstance();
@@ -208,6 +272,8 @@ void Core::Stop()
 
   DiskManager::DestroyInstance();
 
+  MemoryGovernor::DestroyInstance();
+
   NodeFactory::Destroy();
 
   delete main_window_;
@@ -468,7 +534,14 @@ bool Core::AddOpenProjectFromTask(Task *task)
   Project* project = load_task->GetLoadedProject();
   MainWindowLayoutInfo layout = load_task->GetLoadedLayout();
 
-  if (ValidateFootageInLoadedProject(project, load_task->GetFilenameProjectWasSavedAs())) {
+  bool relinked;
+
+  if (ValidateFootageInLoadedProject(project, load_task->GetFilenameProjectWasSavedAs(), &relinked)) {
+    if (!relinked) {
+      // Caches saved against the old footage files are stale
+      ProjectCacheState::Restore(project);
+    }
+
     AddOpenProject(project);
     main_window_->LoadLayout(layout);
 
@@ -530,92 +603,124 @@ void Core::ProjectWasModified(bool e)
   }
 }
 
-bool Core::StartHeadlessExport()
+void Core::StartHeadlessExport()
 {
-  const QString& startup_project = core_params_.startup_project();
+  CLIExportManager manager(core_params_.startup_project());
 
-  if (startup_project.isEmpty()) {
-    qCritical().noquote() << tr("You must specify a project file to export");
-    return false;
-  }
+  manager.SetSpecFilename(core_params_.export_spec());
+  manager.SetSequenceName(core_params_.export_sequence());
+  manager.SetOutputFilename(core_params_.export_filename());
+  manager.SetSharedCache(core_params_.export_shared_cache(), core_params_.export_shared_cache_role());
+  manager.SetMachineReadableProgress(core_params_.machine_readable_progress());
 
-  if (!QFileInfo::exists(startup_project)) {
-    qCritical().noquote() << tr("Specified project does not exist");
-    return false;
+  // Exit with a status a render farm scheduler can act on
+  QCoreApplication::exit(manager.Run() ? 0 : 1);
+}
+
+void Core::StartPlaybackBenchmark()
+{
+  const QString& project_filename = core_params_.startup_project();
+
+  if (project_filename.isEmpty() || !QFileInfo::exists(project_filename)) {
+    qCritical().noquote() << tr("You must specify an existing project file to benchmark");
+    QCoreApplication::exit(1);
+    return;
   }
 
-  // Start a load task and try running it
-  ProjectLoadTask plm(startup_project);
-  CLITaskDialog task_dialog(&plm);
+  ProjectLoadTask load_task(project_filename);
 
-  /*
-  if (task_dialog.Run()) {
-    std::unique_ptr<Project> p = std::unique_ptr<Project>(plm.GetLoadedProject());
-    QVector<Item*> items = p->get_items_of_type(Item::kSequence);
+  if (!load_task.Start()) {
+    qCritical().noquote() << tr("Project failed to load: %1").arg(load_task.GetError());
+    QCoreApplication::exit(1);
+    return;
+  }
 
-    // Check if this project contains sequences
-    if (items.isEmpty()) {
-      qCritical().noquote() << tr("Project contains no sequences, nothing to export");
-      return false;
-    }
+  if (!AddOpenProjectFromTask(&load_task)) {
+    // User declined to relink missing footage
+    QCoreApplication::exit(1);
+    return;
+  }
 
-    Sequence* sequence = nullptr;
+  Sequence* sequence = nullptr;
+  QStringList labels;
 
-    // Check if this project contains multiple sequences
-    if (items.size() > 1) {
-      qInfo().noquote() << tr("This project has multiple sequences. Which do you wish to export?");
-      for (int i=0;i<items.size();i++) {
-        std::cout << "[" << i << "] " << items.at(i)->GetLabel().toStdString();
+  foreach (Node* n, load_task.GetLoadedProject()->nodes()) {
+    if (Sequence* s = dynamic_cast<Sequence*>(n)) {
+      if (core_params_.benchmark_sequence().isEmpty() || s->GetLabel() == core_params_.benchmark_sequence()) {
+        sequence = s;
+        break;
       }
 
-      QTextStream stream(stdin);
-      QString sequence_read;
-      int sequence_index = -1;
-      QString quit_code = QStringLiteral("q");
-      std::string prompt = tr("Enter number (or %1 to cancel): ").arg(quit_code).toStdString();
-      forever {
-        std::cout << prompt;
-
-        stream.readLineInto(&sequence_read);
+      labels.append(s->GetLabel());
+    }
+  }
 
-        if (!QString::compare(sequence_read, quit_code, Qt::CaseInsensitive)) {
-          return false;
-        }
+  if (!sequence) {
+    qCritical().noquote() << tr("Project has no sequence named \"%1\", specify one of: %2")
+                             .arg(core_params_.benchmark_sequence(), labels.join(QStringLiteral(", ")));
+    QCoreApplication::exit(1);
+    return;
+  }
 
-        bool ok;
-        sequence_index = sequence_read.toInt(&ok);
+  // Range is given in frames as "in-out", an empty range plays the whole sequence
+  TimeRange range;
 
-        if (ok && sequence_index >= 0 && sequence_index < items.size()) {
-          break;
-        } else {
-          qCritical().noquote() << tr("Invalid sequence number");
-        }
-      }
+  if (!core_params_.benchmark_range().isEmpty()) {
+    QStringList in_out = core_params_.benchmark_range().split('-');
+    bool in_ok = false, out_ok = false;
+    int64_t in, out;
 
-      sequence = static_cast<Sequence*>(items.at(sequence_index));
-    } else {
-      sequence = static_cast<Sequence*>(items.first());
+    if (in_out.size() == 2) {
+      in = in_out.at(0).toLongLong(&in_ok);
+      out = in_out.at(1).toLongLong(&out_ok);
     }
 
-    ExportParams params;
-    ExportTask export_task(sequence->viewer_output(), p->color_manager(), params);
-    CLITaskDialog export_dialog(&export_task);
-    if (export_dialog.Run()) {
-      qInfo().noquote() << tr("Export succeeded");
-      return true;
-    } else {
-      qInfo().noquote() << tr("Export failed: %1").arg(export_task.GetError());
-      return false;
+    if (!in_ok || !out_ok || out <= in) {
+      qCritical().noquote() << tr("Invalid benchmark range \"%1\", expected \"in-out\" in frames")
+                               .arg(core_params_.benchmark_range());
+      QCoreApplication::exit(1);
+      return;
     }
-  } else {
-    qCritical().noquote() << tr("Project failed to load: %1").arg(plm.GetError());
-    return false;
+
+    rational timebase = sequence->GetVideoParams().frame_rate_as_time_base();
+    range = TimeRange(Timecode::timestamp_to_time(in, timebase),
+                      Timecode::timestamp_to_time(out, timebase));
   }
-  */
 
+  main_window_->OpenSequence(sequence);
 
+  SequenceViewerPanel* viewer = main_window_->sequence_viewer_panel();
+  connect(viewer, &SequenceViewerPanel::PlaybackBenchmarkFinished, this, &Core::PlaybackBenchmarkFinished);
 
-  return false;
+  if (!viewer->StartPlaybackBenchmark(range)) {
+    qCritical().noquote() << tr("Nothing to play in sequence \"%1\"").arg(sequence->GetLabel());
+    QCoreApplication::exit(1);
+  }
+}
+
+void Core::PlaybackBenchmarkFinished(const QJsonObject &results)
+{
+  QJsonObject report = results;
+  report.insert(QStringLiteral("project"), core_params_.startup_project());
+  report.insert(QStringLiteral("sequence"), main_window_->sequence_viewer_panel()->GetConnectedViewer()->GetLabel());
+  report.insert(QStringLiteral("version"), QCoreApplication::applicationVersion());
+
+  QByteArray json = QJsonDocument(report).toJson();
+
+  if (core_params_.benchmark_output().isEmpty()) {
+    fputs(json.constData(), stdout);
+    fflush(stdout);
+  } else {
+    QFile f(core_params_.benchmark_output());
+    if (!f.open(QFile::WriteOnly) || f.write(json) != json.size()) {
+      qCritical().noquote() << tr("Failed to write benchmark results to \"%1\"").arg(f.fileName());
+      QCoreApplication::exit(1);
+      return;
+    }
+  }
+
+  // A run that never showed a frame didn't measure anything a script should trust
+  QCoreApplication::exit(results.value(QStringLiteral("frames_shown")).toInt() > 0 ? 0 : 1);
 }
 
 void Core::OpenStartupProject()
@@ -733,6 +838,9 @@ void Core::SaveProjectInternal(Project* project, const QString& override_filenam
 
   if (project->filename().endsWith(QStringLiteral(".otio"), Qt::CaseInsensitive)) {
 #ifdef USE_OTIO
+    // OTIO is written from the timelines themselves, so every sequence must be loaded
+    project->LoadAllDeferredSequences();
+
     psm = new SaveOTIOTask(project);
 #else
     QMessageBox::critical(main_window_,
@@ -835,13 +943,27 @@ void Core::SaveUnrecoveredList()
 void Core::SaveAutorecovery()
 {
   if (Config::Current()[QStringLiteral("AutorecoveryEnabled")].toBool()) {
+    if (autorecovery_future_.isRunning()) {
+      // Still writing the last set of recoveries, try again next time
+      return;
+    }
+
+    // Snapshots are taken here since they read the project, but only re-serialize what changed.
+    // Writing them to disk happens in the background.
+    QVector<AutorecoveryJob> jobs;
+
     foreach (Project* p, open_projects_) {
       if (!p->has_autorecovery_been_saved()) {
         QDir project_autorecovery_dir(QDir(FileFunctions::GetAutoRecoveryRoot()).filePath(p->GetUuid().toString()));
         if (project_autorecovery_dir.mkpath(QStringLiteral("."))) {
-          QString this_autorecovery_path = project_autorecovery_dir.filePath(QStringLiteral("%1.ove").arg(QString::number(QDateTime::currentSecsSinceEpoch())));
+          AutorecoveryJob job;
+
+          job.snapshot = p->autorecovery_snapshot()->Take();
+          job.directory = project_autorecovery_dir.absolutePath();
+          job.filename = project_autorecovery_dir.filePath(QStringLiteral("%1.ove").arg(QString::number(QDateTime::currentSecsSinceEpoch())));
+          job.realname = p->pretty_filename();
 
-          SaveProjectInternal(p, this_autorecovery_path);
+          jobs.append(job);
 
           p->set_autorecovery_saved(true);
 
@@ -849,45 +971,6 @@ void Core::SaveAutorecovery()
           if (!autorecovered_projects_.contains(p->GetUuid())) {
             autorecovered_projects_.append(p->GetUuid());
           }
-
-          qDebug() << "Saved auto-recovery to:" << this_autorecovery_path;
-
-          // Write human-readable real name so it's not just a UUID
-          {
-            QFile realname_file(project_autorecovery_dir.filePath(QStringLiteral("realname.txt")));
-            realname_file.open(QFile::WriteOnly);
-            realname_file.write(p->pretty_filename().toUtf8());
-            realname_file.close();
-          }
-
-          int64_t max_recoveries_per_file = Config::Current()[QStringLiteral("AutorecoveryMaximum")].toLongLong();
-
-          // Since we write an extra file, increment total allowed files by 1
-          max_recoveries_per_file++;
-
-          // Delete old entries
-          QStringList recovery_files = project_autorecovery_dir.entryList(QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
-          while (recovery_files.size() > max_recoveries_per_file) {
-            bool deleted = false;
-            for (int i=0; i<recovery_files.size(); i++) {
-              const QString& f = recovery_files.at(i);
-
-              if (f.endsWith(QStringLiteral(".ove"), Qt::CaseInsensitive)) {
-                QString delete_full_path = project_autorecovery_dir.filePath(f);
-                qDebug() << "Deleted old recovery:" << delete_full_path;
-                QFile::remove(delete_full_path);
-                recovery_files.removeAt(i);
-                deleted = true;
-                break;
-              }
-            }
-
-            if (!deleted) {
-              // For some reason none of the files were deletable. Break so we don't end up in
-              // an infinite loop.
-              break;
-            }
-          }
         } else {
           QMessageBox::critical(main_window_, tr("Auto-Recovery Error"),
                                 tr("Failed to save auto-recovery to \"%1\". "
@@ -897,11 +980,66 @@ void Core::SaveAutorecovery()
       }
     }
 
+    if (!jobs.isEmpty()) {
+      int64_t max_recoveries_per_file = Config::Current()[QStringLiteral("AutorecoveryMaximum")].toLongLong();
+
+      autorecovery_future_ = QtConcurrent::run(&Core::WriteAutorecoveries, jobs, max_recoveries_per_file);
+    }
+
     // Save index
     SaveUnrecoveredList();
   }
 }
 
+void Core::WriteAutorecoveries(const QVector<AutorecoveryJob> &jobs, int64_t max_recoveries_per_file)
+{
+  foreach (const AutorecoveryJob& job, jobs) {
+    if (!ProjectSnapshot::Write(job.snapshot, job.filename)) {
+      qWarning() << "Failed to write auto-recovery to:" << job.filename;
+      continue;
+    }
+
+    qDebug() << "Saved auto-recovery to:" << job.filename;
+
+    QDir project_autorecovery_dir(job.directory);
+
+    // Write human-readable real name so it's not just a UUID
+    {
+      QFile realname_file(project_autorecovery_dir.filePath(QStringLiteral("realname.txt")));
+      realname_file.open(QFile::WriteOnly);
+      realname_file.write(job.realname.toUtf8());
+      realname_file.close();
+    }
+
+    // Since we write an extra file, increment total allowed files by 1
+    int64_t max_files = max_recoveries_per_file + 1;
+
+    // Delete old entries
+    QStringList recovery_files = project_autorecovery_dir.entryList(QDir::Files | QDir::NoDotAndDotDot, QDir::Name);
+    while (recovery_files.size() > max_files) {
+      bool deleted = false;
+      for (int i=0; i<recovery_files.size(); i++) {
+        const QString& f = recovery_files.at(i);
+
+        if (f.endsWith(QStringLiteral(".ove"), Qt::CaseInsensitive)) {
+          QString delete_full_path = project_autorecovery_dir.filePath(f);
+          qDebug() << "Deleted old recovery:" << delete_full_path;
+          QFile::remove(delete_full_path);
+          recovery_files.removeAt(i);
+          deleted = true;
+          break;
+        }
+      }
+
+      if (!deleted) {
+        // For some reason none of the files were deletable. Break so we don't end up in
+        // an infinite loop.
+        break;
+      }
+    }
+  }
+}
+
 void Core::ProjectSaveSucceeded(Task* task)
 {
   Project* p = static_cast<ProjectSaveTask*>(task)->GetProject();
@@ -954,7 +1092,7 @@ Timecode::Display Core::GetTimecodeDisplay() const
 
 void Core::SetTimecodeDisplay(Timecode::Display d)
 {
-  Config::Current()["TimecodeDisplay"] = d;
+  Config::Current().Set("TimecodeDisplay", d);
 
   emit TimecodeDisplayChanged(d);
 }
@@ -1265,7 +1403,7 @@ QVariant Core::GetPreferenceForRenderMode(RenderMode::Mode mode, const QString &
 
 void Core::SetPreferenceForRenderMode(RenderMode::Mode mode, const QString &preference, const QVariant &value)
 {
-  Config::Current()[GetRenderModePreferencePrefix(mode, preference)] = value;
+  Config::Current().Set(GetRenderModePreferencePrefix(mode, preference), value);
 }
 
 void Core::LabelNodes(const QVector<Node *> &nodes)
@@ -1410,6 +1548,8 @@ bool Core::CloseProject(Project* p, bool auto_open_new, CloseProjectBehavior &co
       // For safety, the undo stack is cleared so no commands try to affect a freed project
       undo_stack_.clear();
 
+      ProjectCacheState::Save(p);
+
       disconnect(p, &Project::ModifiedChanged, this, &Core::ProjectWasModified);
       emit ProjectClosed(p);
       open_projects_.removeAt(i);
@@ -1497,11 +1637,15 @@ void Core::CacheActiveSequence(bool in_out_only)
   }
 }
 
-bool Core::ValidateFootageInLoadedProject(Project* project, const QString& project_saved_url)
+bool Core::ValidateFootageInLoadedProject(Project* project, const QString& project_saved_url, bool *relinked)
 {
   QVector<Footage*> project_footage = project->root()->ListChildrenOfType<Footage>();
   QVector<Footage*> footage_we_couldnt_validate;
 
+  if (relinked) {
+    *relinked = false;
+  }
+
   foreach (Footage* footage, project_footage) {
     if (!QFileInfo::exists(footage->filename()) && !project_saved_url.isEmpty()) {
       // If the footage doesn't exist, it might have moved with the project
@@ -1519,6 +1663,10 @@ bool Core::ValidateFootageInLoadedProject(Project* project, const QString& proje
           // Use this file instead
           qInfo() << "Resolved" << footage->filename() << "relatively to" << transformed_abs_filename;
           footage->set_filename(transformed_abs_filename);
+
+          if (relinked) {
+            *relinked = true;
+          }
         }
       }
     }
@@ -1536,6 +1684,10 @@ bool Core::ValidateFootageInLoadedProject(Project* project, const QString& proje
     if (frd.exec() == QDialog::Rejected) {
       return false;
     }
+
+    if (relinked) {
+      *relinked = true;
+    }
   }
 
   return true;
@@ -1572,6 +1724,8 @@ void Core::OpenProject()
 
 Core::CoreParams::CoreParams() :
   mode_(kRunNormal),
+  metrics_port_(0),
+  machine_readable_progress_(false),
   run_fullscreen_(false)
 {
 }
@@ -22,6 +22,8 @@
 #define CORE_H
 
 #include <QFileInfoList>
+#include <QFuture>
+#include <QJsonObject>
 #include <QList>
 #include <QTimer>
 #include <QTranslator>
@@ -30,6 +32,7 @@
 #include "common/timecodefunctions.h"
 #include "node/project/footage/footage.h"
 #include "node/project/project.h"
+#include "node/project/projectsnapshot.h"
 #include "node/project/projectviewmodel.h"
 #include "node/project/sequence/sequence.h"
 #include "task/task.h"
@@ -61,7 +64,8 @@ public:
     enum RunMode {
       kRunNormal,
       kHeadlessExport,
-      kHeadlessPreCache
+      kHeadlessPreCache,
+      kPlaybackBenchmark
     };
 
     bool fullscreen() const
@@ -104,6 +108,131 @@ public:
       startup_language_ = s;
     }
 
+    /**
+     * @brief JSON file describing a headless export (see CLIExportManager)
+     */
+    const QString& export_spec() const
+    {
+      return export_spec_;
+    }
+
+    void set_export_spec(const QString& s)
+    {
+      export_spec_ = s;
+    }
+
+    const QString& export_sequence() const
+    {
+      return export_sequence_;
+    }
+
+    void set_export_sequence(const QString& s)
+    {
+      export_sequence_ = s;
+    }
+
+    const QString& export_filename() const
+    {
+      return export_filename_;
+    }
+
+    void set_export_filename(const QString& s)
+    {
+      export_filename_ = s;
+    }
+
+    /**
+     * @brief Shared cache folder and role for splitting a headless export across processes
+     */
+    const QString& export_shared_cache() const
+    {
+      return export_shared_cache_;
+    }
+
+    void set_export_shared_cache(const QString& s)
+    {
+      export_shared_cache_ = s;
+    }
+
+    const QString& export_shared_cache_role() const
+    {
+      return export_shared_cache_role_;
+    }
+
+    void set_export_shared_cache_role(const QString& s)
+    {
+      export_shared_cache_role_ = s;
+    }
+
+    /**
+     * @brief Sequence, frame range ("in-out") and results file for a playback benchmark
+     */
+    const QString& benchmark_sequence() const
+    {
+      return benchmark_sequence_;
+    }
+
+    void set_benchmark_sequence(const QString& s)
+    {
+      benchmark_sequence_ = s;
+    }
+
+    const QString& benchmark_range() const
+    {
+      return benchmark_range_;
+    }
+
+    void set_benchmark_range(const QString& s)
+    {
+      benchmark_range_ = s;
+    }
+
+    const QString& benchmark_output() const
+    {
+      return benchmark_output_;
+    }
+
+    void set_benchmark_output(const QString& s)
+    {
+      benchmark_output_ = s;
+    }
+
+    /**
+     * @brief File to write a Chrome trace of the whole session to on exit
+     */
+    const QString& trace_filename() const
+    {
+      return trace_filename_;
+    }
+
+    void set_trace_filename(const QString& s)
+    {
+      trace_filename_ = s;
+    }
+
+    /**
+     * @brief Port to serve render metrics on over HTTP, or 0 to not serve them
+     */
+    int metrics_port() const
+    {
+      return metrics_port_;
+    }
+
+    void set_metrics_port(int p)
+    {
+      metrics_port_ = p;
+    }
+
+    bool machine_readable_progress() const
+    {
+      return machine_readable_progress_;
+    }
+
+    void set_machine_readable_progress(bool e)
+    {
+      machine_readable_progress_ = e;
+    }
+
   private:
     RunMode mode_;
 
@@ -111,6 +240,28 @@ public:
 
     QString startup_language_;
 
+    QString export_spec_;
+
+    QString export_sequence_;
+
+    QString export_filename_;
+
+    QString export_shared_cache_;
+
+    QString export_shared_cache_role_;
+
+    QString benchmark_sequence_;
+
+    QString benchmark_range_;
+
+    QString benchmark_output_;
+
+    QString trace_filename_;
+
+    int metrics_port_;
+
+    bool machine_readable_progress_;
+
     bool run_fullscreen_;
 
   };
@@ -278,8 +429,10 @@ public:
 
   /**
    * @brief Check each footage object for whether it still exists or has changed
+   *
+   * If `relinked` is set, it's set to TRUE if any footage now points at a different file.
    */
-  bool ValidateFootageInLoadedProject(Project* project, const QString &project_saved_url);
+  bool ValidateFootageInLoadedProject(Project* project, const QString &project_saved_url, bool* relinked = nullptr);
 
   /**
    * @brief Changes the current language
@@ -571,6 +724,20 @@ private:
    */
   QVector<QUuid> autorecovered_projects_;
 
+  struct AutorecoveryJob {
+    ProjectSnapshot::Data snapshot;
+    QString directory;
+    QString filename;
+    QString realname;
+  };
+
+  static void WriteAutorecoveries(const QVector<AutorecoveryJob>& jobs, int64_t max_recoveries_per_file);
+
+  /**
+   * @brief Background write of the most recent auto-recoveries
+   */
+  QFuture<void> autorecovery_future_;
+
 private slots:
   void SaveAutorecovery();
 
@@ -589,7 +756,11 @@ private slots:
 
   void ProjectWasModified(bool e);
 
-  bool StartHeadlessExport();
+  void StartHeadlessExport();
+
+  void StartPlaybackBenchmark();
+
+  void PlaybackBenchmarkFinished(const QJsonObject& results);
 
   void OpenStartupProject();
 
@@ -25,6 +25,7 @@
 #include <QLabel>
 #include <QMessageBox>
 
+#include "common/filefunctions.h"
 #include "config/config.h"
 
 namespace olive {
@@ -52,6 +53,26 @@ DiskCacheDialog::DiskCacheDialog(DiskCacheFolder *folder, QWidget* parent) :
 
   row++;
 
+  layout->addWidget(new QLabel(tr("Frame Format:")), row, 0);
+
+  codec_combo_ = new QComboBox();
+  for (int i=0; i<DiskCacheFolder::kCodecCount; i++) {
+    codec_combo_->addItem(DiskCacheFolder::GetCodecName(static_cast<DiskCacheFolder::Codec>(i)), i);
+  }
+  codec_combo_->setCurrentIndex(folder->GetCodec());
+  layout->addWidget(codec_combo_, row, 1);
+
+  row++;
+
+  layout->addWidget(new QLabel(tr("Overflow Folder:")), row, 0);
+
+  overflow_path_ = new PathWidget(folder->GetOverflowPath());
+  overflow_path_->setToolTip(tr("Frames evicted from this disk cache are moved here instead of being deleted, "
+                                "and moved back when they're used again. Leave empty to delete them."));
+  layout->addWidget(overflow_path_, row, 1);
+
+  row++;
+
   clear_cache_btn_ = new QPushButton(tr("Clear Disk Cache"));
   connect(clear_cache_btn_, &QPushButton::clicked, this, &DiskCacheDialog::ClearDiskCache);
   layout->addWidget(clear_cache_btn_, row, 1);
@@ -64,6 +85,13 @@ DiskCacheDialog::DiskCacheDialog(DiskCacheFolder *folder, QWidget* parent) :
 
   row++;
 
+  shared_cache_ = new QCheckBox(tr("Share disk cache with other users of this folder"));
+  shared_cache_->setToolTip(tr("Frames rendered by anyone sharing this folder are reused instead of being rendered again."));
+  shared_cache_->setChecked(folder->IsShared());
+  layout->addWidget(shared_cache_, row, 1);
+
+  row++;
+
   QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
   connect(buttons, &QDialogButtonBox::accepted, this, &DiskCacheDialog::accept);
   connect(buttons, &QDialogButtonBox::rejected, this, &DiskCacheDialog::reject);
@@ -72,6 +100,23 @@ DiskCacheDialog::DiskCacheDialog(DiskCacheFolder *folder, QWidget* parent) :
 
 void DiskCacheDialog::accept()
 {
+  QString overflow_path = overflow_path_->text();
+
+  if (overflow_path != folder_->GetOverflowPath()) {
+    if (!overflow_path.isEmpty() && !FileFunctions::DirectoryIsValid(overflow_path, true)) {
+      QMessageBox::critical(this, tr("Disk Cache Error"),
+                            tr("Failed to open overflow folder at \"%1\". Try a different folder.").arg(overflow_path));
+      return;
+    }
+
+    folder_->SetOverflowPath(overflow_path);
+
+    if (!overflow_path.isEmpty()) {
+      // Make sure the overflow folder is tracking what it receives
+      DiskManager::instance()->GetOpenFolder(overflow_path);
+    }
+  }
+
   qint64 new_disk_cache_limit = qRound64(maximum_cache_slider_->GetValue() * kBytesInGigabyte);
   if (new_disk_cache_limit != folder_->GetLimit()) {
     folder_->SetLimit(new_disk_cache_limit);
@@ -81,6 +126,24 @@ void DiskCacheDialog::accept()
     folder_->SetClearOnClose(clear_disk_cache_->isChecked());
   }
 
+  // Frames already cached stay readable, only new frames use the new codec
+  DiskCacheFolder::Codec codec = static_cast<DiskCacheFolder::Codec>(codec_combo_->currentData().toInt());
+  if (folder_->GetCodec() != codec) {
+    folder_->SetCodec(codec);
+  }
+
+  if (folder_->IsShared() != shared_cache_->isChecked()) {
+    if (QMessageBox::question(this,
+                              tr("Disk Cache"),
+                              tr("Changing whether this disk cache is shared will clear your frames from it. "
+                                 "Would you like to continue?"),
+                              QMessageBox::Ok | QMessageBox::Cancel) != QMessageBox::Ok) {
+      return;
+    }
+
+    folder_->SetShared(shared_cache_->isChecked());
+  }
+
   QDialog::accept();
 }
 
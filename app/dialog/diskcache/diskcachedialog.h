@@ -22,10 +22,12 @@
 #define DISKCACHEDIALOG_H
 
 #include <QCheckBox>
+#include <QComboBox>
 #include <QDialog>
 #include <QPushButton>
 
 #include "render/diskmanager.h"
+#include "widget/path/pathwidget.h"
 #include "widget/slider/floatslider.h"
 
 namespace olive {
@@ -46,6 +48,12 @@ private:
 
   QCheckBox* clear_disk_cache_;
 
+  QCheckBox* shared_cache_;
+
+  QComboBox* codec_combo_;
+
+  PathWidget* overflow_path_;
+
   QPushButton* clear_cache_btn_;
 
 private slots:
@@ -338,7 +338,8 @@ void ExportDialog::StartExport()
 
   // Validate video resolution
   if (video_enabled_->isChecked()
-      && (video_tab_->GetSelectedCodec() == ExportCodec::kCodecH264 || video_tab_->GetSelectedCodec() == ExportCodec::kCodecH265)
+      && (ExportCodec::GetBaseCodec(video_tab_->GetSelectedCodec()) == ExportCodec::kCodecH264
+          || ExportCodec::GetBaseCodec(video_tab_->GetSelectedCodec()) == ExportCodec::kCodecH265)
       && (video_tab_->width_slider()->GetValue()%2 != 0 || video_tab_->height_slider()->GetValue()%2 != 0)) {
     QtUtils::MessageBox(this, QMessageBox::Critical, tr("Invalid Parameters"),
                         tr("Width and height must be multiples of 2."));
@@ -543,6 +544,8 @@ ExportParams ExportDialog::GenerateParams() const
     params.EnableVideo(video_render_params, video_codec);
 
     params.set_video_threads(video_tab_->threads());
+    params.set_video_segments(video_tab_->segments());
+    params.set_video_smart_render(video_tab_->smart_render());
 
     if (video_tab_->isVisible()) {
       video_tab_->GetCodecSection()->AddOpts(&params);
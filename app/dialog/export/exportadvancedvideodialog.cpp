@@ -51,6 +51,27 @@ ExportAdvancedVideoDialog::ExportAdvancedVideoDialog(const QList<QString> &pix_f
     performance_layout->addWidget(thread_slider_, row, 1);
 
     row++;
+
+    QLabel* segment_lbl = new QLabel(tr("Parallel Segments:"));
+    segment_lbl->setToolTip(tr("Splits the export into segments that are encoded simultaneously. "
+                               "Only used by intra-frame codecs such as ProRes, DNxHD and image sequences."));
+    performance_layout->addWidget(segment_lbl, row, 0);
+
+    segment_slider_ = new IntegerSlider();
+    segment_slider_->SetMinimum(1);
+    segment_slider_->SetMaximum(32);
+    segment_slider_->SetDefaultValue(1);
+    performance_layout->addWidget(segment_slider_, row, 1);
+
+    row++;
+
+    smart_render_checkbox_ = new QCheckBox(tr("Smart Render"));
+    smart_render_checkbox_->setToolTip(tr("Copies frames that are unedited footage straight from the source file instead of "
+                                          "re-encoding them. Only used by intra-frame codecs when the source uses the same "
+                                          "codec, pixel format and resolution as the export."));
+    performance_layout->addWidget(smart_render_checkbox_, row, 0, 1, 2);
+
+    row++;
   }
 
   QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
@@ -1,6 +1,7 @@
 #ifndef EXPORTADVANCEDVIDEODIALOG_H
 #define EXPORTADVANCEDVIDEODIALOG_H
 
+#include <QCheckBox>
 #include <QComboBox>
 #include <QDialog>
 
@@ -25,6 +26,26 @@ public:
     thread_slider_->SetValue(t);
   }
 
+  int segments() const
+  {
+    return static_cast<int>(segment_slider_->GetValue());
+  }
+
+  void set_segments(int s)
+  {
+    segment_slider_->SetValue(s);
+  }
+
+  bool smart_render() const
+  {
+    return smart_render_checkbox_->isChecked();
+  }
+
+  void set_smart_render(bool e)
+  {
+    smart_render_checkbox_->setChecked(e);
+  }
+
   QString pix_fmt() const
   {
     return pixel_format_combobox_->currentText();
@@ -38,6 +59,10 @@ public:
 private:
   IntegerSlider* thread_slider_;
 
+  IntegerSlider* segment_slider_;
+
+  QCheckBox* smart_render_checkbox_;
+
   QComboBox* pixel_format_combobox_;
 
 };
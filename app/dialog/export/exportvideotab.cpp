@@ -36,7 +36,9 @@ namespace olive {
 ExportVideoTab::ExportVideoTab(ColorManager* color_manager, QWidget *parent) :
   QWidget(parent),
   color_manager_(color_manager),
-  threads_(0)
+  threads_(0),
+  segments_(1),
+  smart_render_(false)
 {
   QVBoxLayout* outer_layout = new QVBoxLayout(this);
 
@@ -207,10 +209,14 @@ void ExportVideoTab::OpenAdvancedDialog()
   ExportAdvancedVideoDialog d(pixel_formats, this);
 
   d.set_threads(threads_);
+  d.set_segments(segments_);
+  d.set_smart_render(smart_render_);
   d.set_pix_fmt(pix_fmt_);
 
   if (d.exec() == QDialog::Accepted) {
     threads_ = d.threads();
+    segments_ = d.segments();
+    smart_render_ = d.smart_render();
     pix_fmt_ = d.pix_fmt();
   }
 }
@@ -231,10 +237,11 @@ void ExportVideoTab::UpdateFrameRate(rational r)
 void ExportVideoTab::VideoCodecChanged()
 {
   ExportCodec::Codec codec = GetSelectedCodec();
+  ExportCodec::Codec base_codec = ExportCodec::GetBaseCodec(codec);
 
-  if (codec == ExportCodec::kCodecH264) {
+  if (base_codec == ExportCodec::kCodecH264) {
     SetCodecSection(h264_section_);
-  } else if (codec == ExportCodec::kCodecH265) {
+  } else if (base_codec == ExportCodec::kCodecH265) {
     SetCodecSection(h265_section_);
   } else if (ExportCodec::IsCodecAStillImage(codec)) {
     SetCodecSection(image_section_);
@@ -131,6 +131,16 @@ public:
     return threads_;
   }
 
+  const int& segments() const
+  {
+    return segments_;
+  }
+
+  bool smart_render() const
+  {
+    return smart_render_;
+  }
+
   const QString& pix_fmt() const {
     return pix_fmt_;
   }
@@ -173,6 +183,10 @@ private:
 
   int threads_;
 
+  int segments_;
+
+  bool smart_render_;
+
   QString pix_fmt_;
 
   ExportFormat::Format format_;
@@ -29,6 +29,9 @@
 #include <QScrollBar>
 #include <QVBoxLayout>
 
+#include "dialog/task/task.h"
+#include "task/project/relink/relink.h"
+
 namespace olive {
 
 FootageRelinkDialog::FootageRelinkDialog(const QVector<Footage *> &footage, QWidget* parent) :
@@ -76,13 +79,13 @@ FootageRelinkDialog::FootageRelinkDialog(const QVector<Footage *> &footage, QWid
   layout->addWidget(table_);
 
   QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+  QPushButton* search_btn = buttons->addButton(tr("Search Folder..."), QDialogButtonBox::ActionRole);
+  connect(search_btn, &QPushButton::clicked, this, &FootageRelinkDialog::SearchFolder);
   connect(buttons, &QDialogButtonBox::accepted, this, &FootageRelinkDialog::accept);
   connect(buttons, &QDialogButtonBox::rejected, this, &FootageRelinkDialog::reject);
   layout->addWidget(buttons);
 
   setWindowTitle(tr("Relink Footage"));
-
-
 }
 
 void FootageRelinkDialog::UpdateFootageItem(int index)
@@ -143,6 +146,11 @@ void FootageRelinkDialog::BrowseForFootage()
     }
   }
 
+  SelectNextInvalidFootage();
+}
+
+void FootageRelinkDialog::SelectNextInvalidFootage()
+{
   // Check where the next invalid footage is. If there is none, accept automatically. Otherwise,
   // jump to that footage so the user knows where it is.
   int next_invalid = -1;
@@ -166,4 +174,57 @@ void FootageRelinkDialog::BrowseForFootage()
   }
 }
 
+void FootageRelinkDialog::SearchFolder()
+{
+  QString start_dir;
+  if (!footage_.isEmpty()) {
+    start_dir = QFileInfo(footage_.first()->filename()).absolutePath();
+  }
+
+  QString dir = QFileDialog::getExistingDirectory(this, tr("Search Folder"), start_dir);
+
+  if (dir.isEmpty()) {
+    return;
+  }
+
+  // Search for everything that's still offline in one pass
+  QVector<Footage*> offline;
+  searching_.clear();
+  for (int i=0; i<footage_.size(); i++) {
+    if (!footage_.at(i)->IsValid()) {
+      offline.append(footage_.at(i));
+      searching_.append(i);
+    }
+  }
+
+  if (offline.isEmpty()) {
+    return;
+  }
+
+  ProjectRelinkTask* task = new ProjectRelinkTask(offline, {dir});
+  TaskDialog* task_dialog = new TaskDialog(task, tr("Relink Footage"), this);
+  connect(task_dialog, &TaskDialog::TaskSucceeded, this, &FootageRelinkDialog::SearchFinished);
+  task_dialog->open();
+}
+
+void FootageRelinkDialog::SearchFinished(Task *task)
+{
+  const QStringList& matches = static_cast<ProjectRelinkTask*>(task)->GetMatches();
+
+  for (int i=0; i<matches.size(); i++) {
+    if (!matches.at(i).isEmpty()) {
+      int index = searching_.at(i);
+      Footage* f = footage_.at(index);
+
+      // The search already probed this file, so this won't need to open it again
+      f->set_filename(matches.at(i));
+      f->SetValid();
+
+      UpdateFootageItem(index);
+    }
+  }
+
+  SelectNextInvalidFootage();
+}
+
 }
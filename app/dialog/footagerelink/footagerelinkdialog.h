@@ -25,6 +25,7 @@
 #include <QTreeWidget>
 
 #include "node/project/footage/footage.h"
+#include "task/task.h"
 
 namespace olive {
 
@@ -37,13 +38,22 @@ public:
 private:
   void UpdateFootageItem(int index);
 
+  void SelectNextInvalidFootage();
+
   QTreeWidget* table_;
 
   QVector<Footage*> footage_;
 
+  // Indexes into `footage_` of what the current folder search is looking for
+  QVector<int> searching_;
+
 private slots:
   void BrowseForFootage();
 
+  void SearchFolder();
+
+  void SearchFinished(Task* task);
+
 };
 
 }
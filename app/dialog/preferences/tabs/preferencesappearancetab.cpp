@@ -93,11 +93,11 @@ void PreferencesAppearanceTab::Accept(MultiUndoCommand *command)
 
   if (style_path != StyleManager::GetStyle()) {
     StyleManager::SetStyle(style_path);
-    Config::Current()[QStringLiteral("Style")] = style_path;
+    Config::Current().Set(QStringLiteral("Style"), style_path);
   }
 
   for (int i=0; i<color_btns_.size(); i++) {
-    Config::Current()[QStringLiteral("CatColor%1").arg(i)] = color_btns_.at(i)->GetSelectedColor();
+    Config::Current().Set(QStringLiteral("CatColor%1").arg(i), color_btns_.at(i)->GetSelectedColor());
   }
 }
 
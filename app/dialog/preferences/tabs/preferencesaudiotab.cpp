@@ -25,6 +25,7 @@
 #include <QLabel>
 
 #include "audio/audiomanager.h"
+#include "audio/audioresampler.h"
 #include "config/config.h"
 
 namespace olive {
@@ -46,8 +47,19 @@ PreferencesAudioTab::PreferencesAudioTab()
     for (int i=0; i<AudioManager::kAudioBackendCount; i++) {
       audio_backend_combobox_->addItem(AudioManager::GetAudioBackendName(static_cast<AudioManager::Backend>(i)));
     }
+    audio_backend_combobox_->setCurrentIndex(AudioManager::GetConfiguredBackend());
     main_layout->addWidget(audio_backend_combobox_, row, 1);
 
+    row++;
+
+    main_layout->addWidget(new QLabel(tr("Resampling:")), row, 0);
+
+    resample_quality_combobox_ = new QComboBox();
+    resample_quality_combobox_->addItem(tr("Fast"), AudioResampler::kQualityFast);
+    resample_quality_combobox_->addItem(tr("High Quality"), AudioResampler::kQualityHigh);
+    resample_quality_combobox_->setCurrentIndex(resample_quality_combobox_->findData(Config::kAudioResampleQuality.Get()));
+    main_layout->addWidget(resample_quality_combobox_, row, 1);
+
     audio_tab_layout->addLayout(main_layout);
   }
 
@@ -72,6 +84,42 @@ PreferencesAudioTab::PreferencesAudioTab()
 
       audio_output_devices_ = new QComboBox();
       qt_output_layout->addWidget(audio_output_devices_, row, 1);
+
+      row++;
+
+      qt_output_layout->addWidget(new QLabel(tr("Latency:")), row, 0);
+
+      output_latency_slider_ = new IntegerSlider();
+      output_latency_slider_->SetMinimum(2);
+      output_latency_slider_->SetMaximum(500);
+      output_latency_slider_->SetFormat(tr("%1 ms"));
+      output_latency_slider_->SetValue(Config::Current()[QStringLiteral("AudioOutputLatency")].toLongLong());
+      qt_output_layout->addWidget(output_latency_slider_, row, 1);
+
+#ifdef USE_PORTAUDIO
+      row++;
+
+      qt_output_layout->addWidget(new QLabel(tr("Buffer Size:")), row, 0);
+
+      output_buffer_frames_combobox_ = new QComboBox();
+      output_buffer_frames_combobox_->addItem(tr("Automatic"), 0);
+      for (int frames=32; frames<=4096; frames*=2) {
+        output_buffer_frames_combobox_->addItem(tr("%1 samples").arg(frames), frames);
+      }
+      output_buffer_frames_combobox_->setCurrentIndex(qMax(0, output_buffer_frames_combobox_->findData(Config::kAudioBufferFrames.Get())));
+      output_buffer_frames_combobox_->setToolTip(tr("Only used by the native backend."));
+      qt_output_layout->addWidget(output_buffer_frames_combobox_, row, 1);
+
+#ifdef Q_OS_WINDOWS
+      row++;
+
+      output_exclusive_checkbox_ = new QCheckBox(tr("Exclusive Mode"));
+      output_exclusive_checkbox_->setChecked(Config::kAudioExclusiveMode.Get());
+      output_exclusive_checkbox_->setToolTip(tr("Take exclusive control of the device for the lowest latency. "
+                                                "Only used by the native backend."));
+      qt_output_layout->addWidget(output_exclusive_checkbox_, row, 1);
+#endif
+#endif
     }
 
     row = 0;
@@ -119,6 +167,22 @@ void PreferencesAudioTab::Accept(MultiUndoCommand *command)
 {
   Q_UNUSED(command)
 
+  Config::Current().Set(QStringLiteral("AudioResampleQuality"), resample_quality_combobox_->currentData());
+
+  // Any change to how the output is driven means reopening it
+  bool output_changed = (AudioManager::GetConfiguredBackend() != audio_backend_combobox_->currentIndex());
+  Config::Current().Set(QStringLiteral("AudioBackend"), audio_backend_combobox_->currentIndex());
+
+#ifdef USE_PORTAUDIO
+  output_changed |= (Config::kAudioBufferFrames.Get() != output_buffer_frames_combobox_->currentData().toInt());
+  Config::Current().Set(QStringLiteral("AudioBufferFrames"), output_buffer_frames_combobox_->currentData());
+
+#ifdef Q_OS_WINDOWS
+  output_changed |= (Config::kAudioExclusiveMode.Get() != output_exclusive_checkbox_->isChecked());
+  Config::Current().Set(QStringLiteral("AudioExclusiveMode"), output_exclusive_checkbox_->isChecked());
+#endif
+#endif
+
   // FIXME: Qt documentation states that QAudioDeviceInfo::deviceName() is a "unique identifiers", which would make them
   //        ideal for saving in preferences, but in practice they don't actually appear to be unique.
   //        See: https://bugreports.qt.io/browse/QTBUG-16841
@@ -137,9 +201,12 @@ void PreferencesAudioTab::Accept(MultiUndoCommand *command)
       selected_output_name = selected_output.deviceName();
     }
 
+    bool latency_changed = (Config::Current()["AudioOutputLatency"].toLongLong() != output_latency_slider_->GetValue());
+    Config::Current().Set("AudioOutputLatency", QVariant::fromValue(int(output_latency_slider_->GetValue())));
+
     // Save it in the global application preferences
-    if (Config::Current()["AudioOutput"] != selected_output_name) {
-      Config::Current()["AudioOutput"] = selected_output_name;
+    if (Config::Current()["AudioOutput"] != selected_output_name || latency_changed || output_changed) {
+      Config::Current().Set("AudioOutput", selected_output_name);
       AudioManager::instance()->SetOutputDevice(selected_output);
     }
   }
@@ -157,7 +224,7 @@ void PreferencesAudioTab::Accept(MultiUndoCommand *command)
     }
 
     if (Config::Current()["AudioInput"] != selected_input_name) {
-      Config::Current()["AudioInput"] = selected_input_name;
+      Config::Current().Set("AudioInput", selected_input_name);
       AudioManager::instance()->SetInputDevice(selected_input);
     }
   }
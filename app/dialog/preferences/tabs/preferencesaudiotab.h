@@ -22,10 +22,12 @@
 #define PREFERENCESAUDIOTAB_H
 
 #include <QAudioDeviceInfo>
+#include <QCheckBox>
 #include <QComboBox>
 #include <QPushButton>
 
 #include "dialog/configbase/configdialogbase.h"
+#include "widget/slider/integerslider.h"
 
 namespace olive {
 
@@ -40,11 +42,35 @@ public:
 private:
   QComboBox* audio_backend_combobox_;
 
+  /**
+   * @brief UI widget for the quality audio is resampled at when conforming and exporting
+   */
+  QComboBox* resample_quality_combobox_;
+
   /**
    * @brief UI widget for selecting the output audio device
    */
   QComboBox* audio_output_devices_;
 
+  /**
+   * @brief UI widget for how much audio the output device buffers
+   */
+  IntegerSlider* output_latency_slider_;
+
+#ifdef USE_PORTAUDIO
+  /**
+   * @brief UI widget for how many frames a native output asks for at a time
+   */
+  QComboBox* output_buffer_frames_combobox_;
+
+#ifdef Q_OS_WINDOWS
+  /**
+   * @brief UI widget for whether a native output takes exclusive control of the device
+   */
+  QCheckBox* output_exclusive_checkbox_;
+#endif
+#endif
+
   /**
    * @brief UI widget for selecting the input audio device
    */
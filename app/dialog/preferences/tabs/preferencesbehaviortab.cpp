@@ -111,7 +111,7 @@ void PreferencesBehaviorTab::Accept(MultiUndoCommand *command)
   QMap<QTreeWidgetItem*, QString>::const_iterator iterator;
 
   for (iterator=config_map_.begin();iterator!=config_map_.end();iterator++) {
-    Config::Current()[iterator.value()] = (iterator.key()->checkState(0) == Qt::Checked);
+    Config::Current().Set(iterator.value(), (iterator.key()->checkState(0) == Qt::Checked));
   }
 }
 
@@ -20,6 +20,7 @@
 
 #include "preferencesdisktab.h"
 
+#include <QApplication>
 #include <QDir>
 #include <QFileDialog>
 #include <QGridLayout>
@@ -28,6 +29,9 @@
 #include <QMessageBox>
 
 #include "common/filefunctions.h"
+#include "render/framemanager.h"
+#include "render/hardwareprofile.h"
+#include "render/rendermanager.h"
 
 namespace olive {
 
@@ -82,6 +86,206 @@ PreferencesDiskTab::PreferencesDiskTab()
   cache_behind_slider_->SetValue(Config::Current()["DiskCacheBehind"].value<rational>().toDouble());
   cache_behavior_layout->addWidget(cache_behind_slider_, row, 3);
 
+  row++;
+
+  cache_behavior_layout->addWidget(new QLabel(tr("GPU Cache:")), row, 0);
+
+  gpu_cache_slider_ = new IntegerSlider();
+  gpu_cache_slider_->SetMinimum(0);
+  gpu_cache_slider_->SetFormat(tr("%1 MB"));
+  gpu_cache_slider_->SetValue(Config::Current()["GPUCacheSize"].toLongLong());
+  cache_behavior_layout->addWidget(gpu_cache_slider_, row, 1);
+
+  cache_behavior_layout->addWidget(new QLabel(tr("Export Frame Buffer:")), row, 2);
+
+  export_buffer_slider_ = new IntegerSlider();
+  export_buffer_slider_->SetMinimum(64);
+  export_buffer_slider_->SetFormat(tr("%1 MB"));
+  export_buffer_slider_->SetValue(Config::Current()["ExportBufferSize"].toLongLong());
+  cache_behavior_layout->addWidget(export_buffer_slider_, row, 3);
+
+  row++;
+
+  cache_behavior_layout->addWidget(new QLabel(tr("Node Value Cache:")), row, 0);
+
+  value_cache_slider_ = new IntegerSlider();
+  value_cache_slider_->SetMinimum(0);
+  value_cache_slider_->SetFormat(tr("%1 MB"));
+  value_cache_slider_->SetValue(Config::Current()["NodeValueCacheSize"].toLongLong());
+  cache_behavior_layout->addWidget(value_cache_slider_, row, 1);
+
+  cache_behavior_layout->addWidget(new QLabel(tr("GPU Texture Pool:")), row, 2);
+
+  texture_pool_slider_ = new IntegerSlider();
+  texture_pool_slider_->SetMinimum(0);
+  texture_pool_slider_->SetFormat(tr("%1 MB"));
+  texture_pool_slider_->SetValue(Config::Current()["TexturePoolSize"].toLongLong());
+  cache_behavior_layout->addWidget(texture_pool_slider_, row, 3);
+
+  row++;
+
+  cache_behavior_layout->addWidget(new QLabel(tr("Frame Memory Cache:")), row, 0);
+
+  memory_cache_slider_ = new IntegerSlider();
+  memory_cache_slider_->SetMinimum(0);
+  memory_cache_slider_->SetFormat(tr("%1 MB"));
+  memory_cache_slider_->SetValue(Config::Current()["FrameMemoryCacheSize"].toLongLong());
+  cache_behavior_layout->addWidget(memory_cache_slider_, row, 1);
+
+  cache_behavior_layout->addWidget(new QLabel(tr("GPU Render Contexts:")), row, 2);
+
+  render_contexts_slider_ = new IntegerSlider();
+  render_contexts_slider_->SetMinimum(1);
+  render_contexts_slider_->SetMaximum(8);
+  render_contexts_slider_->setToolTip(tr("Workstations with several GPUs can render in the background on all of "
+                                         "them by using one context per GPU. Takes effect after restarting."));
+  render_contexts_slider_->SetValue(Config::Current()["RenderContextCount"].toLongLong());
+  cache_behavior_layout->addWidget(render_contexts_slider_, row, 3);
+
+  row++;
+
+  cache_behavior_layout->addWidget(new QLabel(tr("Footage Image Cache:")), row, 0);
+
+  still_cache_slider_ = new IntegerSlider();
+  still_cache_slider_->SetMinimum(0);
+  still_cache_slider_->SetFormat(tr("%1 MB"));
+  still_cache_slider_->setToolTip(tr("GPU memory for decoded stills and footage frames, so timelines that "
+                                     "keep returning to the same images don't decode them again."));
+  still_cache_slider_->SetValue(Config::Current()["StillImageCacheSize"].toLongLong());
+  cache_behavior_layout->addWidget(still_cache_slider_, row, 1);
+
+  cache_behavior_layout->addWidget(new QLabel(tr("RAM Budget:")), row, 2);
+
+  ram_budget_slider_ = new IntegerSlider();
+  ram_budget_slider_->SetMinimum(0);
+  ram_budget_slider_->SetFormat(tr("%1 MB"));
+  ram_budget_slider_->setToolTip(tr("Total system memory the caches above may use between them. When they ask "
+                                    "for more, it's shared out by priority. Set to 0 to use half of this "
+                                    "computer's memory."));
+  ram_budget_slider_->SetValue(Config::Current()["RAMBudget"].toLongLong());
+  cache_behavior_layout->addWidget(ram_budget_slider_, row, 3);
+
+  row++;
+
+  cache_behavior_layout->addWidget(new QLabel(tr("Export Checkpoints:")), row, 0);
+
+  export_checkpoint_slider_ = new IntegerSlider();
+  export_checkpoint_slider_->SetMinimum(0);
+  export_checkpoint_slider_->SetFormat(tr("%1 seconds"));
+  export_checkpoint_slider_->setToolTip(tr("Long exports to intra-only codecs are written in chunks of this length "
+                                           "that are kept if the export is interrupted, so exporting again picks "
+                                           "up where it left off. Set to 0 to disable."));
+  export_checkpoint_slider_->SetValue(Config::Current()["ExportCheckpointInterval"].toLongLong());
+  cache_behavior_layout->addWidget(export_checkpoint_slider_, row, 1);
+
+  cache_behavior_layout->addWidget(new QLabel(tr("VRAM Budget:")), row, 2);
+
+  vram_budget_slider_ = new IntegerSlider();
+  vram_budget_slider_->SetMinimum(0);
+  vram_budget_slider_->SetFormat(tr("%1 MB"));
+  vram_budget_slider_->setToolTip(tr("Total GPU memory the caches above may use between them. When they ask "
+                                     "for more, it's shared out by priority. Set to 0 for no limit."));
+  vram_budget_slider_->SetValue(Config::Current()["VRAMBudget"].toLongLong());
+  cache_behavior_layout->addWidget(vram_budget_slider_, row, 3);
+
+  row++;
+
+  skip_realtime_box_ = new QCheckBox(tr("Only cache frames that are too slow to render during playback"));
+  skip_realtime_box_->setChecked(Config::Current()["AutoCacheSkipRealtimeFrames"].toBool());
+  cache_behavior_layout->addWidget(skip_realtime_box_, row, 0, 1, 4);
+
+  row++;
+
+  Renderer::TexturePoolStats pool_stats = RenderManager::instance()->GetTexturePoolStats();
+  QLabel* pool_stats_lbl = new QLabel(tr("Textures: %1 MB allocated, %2 MB pooled (%3 textures, %4% reused)")
+                                      .arg(QString::number(pool_stats.allocated_bytes / 1024 / 1024),
+                                           QString::number(pool_stats.pooled_bytes / 1024 / 1024),
+                                           QString::number(pool_stats.pooled_textures),
+                                           QString::number(pool_stats.hits + pool_stats.misses > 0
+                                                           ? pool_stats.hits * 100 / (pool_stats.hits + pool_stats.misses)
+                                                           : 0)));
+  cache_behavior_layout->addWidget(pool_stats_lbl, row, 0, 1, 4);
+
+  row++;
+
+  FrameManager::Stats frame_stats = FrameManager::GetStats();
+  QLabel* frame_stats_lbl = new QLabel(tr("Frames: %1 MB allocated, %2 MB pooled (%3% reused, %4% without locking)")
+                                       .arg(QString::number(frame_stats.allocated_bytes / 1024 / 1024),
+                                            QString::number(frame_stats.pooled_bytes / 1024 / 1024),
+                                            QString::number(frame_stats.allocations > 0
+                                                            ? (frame_stats.thread_hits + frame_stats.shared_hits) * 100 / frame_stats.allocations
+                                                            : 0),
+                                            QString::number(frame_stats.allocations > 0
+                                                            ? frame_stats.thread_hits * 100 / frame_stats.allocations
+                                                            : 0)));
+  cache_behavior_layout->addWidget(frame_stats_lbl, row, 0, 1, 4);
+
+  QGroupBox* performance_group = new QGroupBox(tr("Performance"));
+  outer_layout->addWidget(performance_group);
+  QGridLayout* performance_layout = new QGridLayout(performance_group);
+
+  row = 0;
+
+  performance_layout->addWidget(new QLabel(tr("Render Threads:")), row, 0);
+
+  render_threads_slider_ = CreateTuningSlider(QStringLiteral("RenderThreads"));
+  performance_layout->addWidget(render_threads_slider_, row, 1);
+
+  performance_layout->addWidget(new QLabel(tr("Decode Threads:")), row, 2);
+
+  decode_threads_slider_ = CreateTuningSlider(QStringLiteral("DecodeThreads"));
+  performance_layout->addWidget(decode_threads_slider_, row, 3);
+
+  row++;
+
+  performance_layout->addWidget(new QLabel(tr("Export Frames In Flight:")), row, 0);
+
+  frames_in_flight_slider_ = CreateTuningSlider(QStringLiteral("RenderFramesInFlight"));
+  performance_layout->addWidget(frames_in_flight_slider_, row, 1);
+
+  performance_layout->addWidget(new QLabel(tr("Cache Write Threads:")), row, 2);
+
+  cache_write_threads_slider_ = CreateTuningSlider(QStringLiteral("CacheWriteThreads"));
+  performance_layout->addWidget(cache_write_threads_slider_, row, 3);
+
+  row++;
+
+  calibration_lbl_ = new QLabel();
+  calibration_lbl_->setWordWrap(true);
+  performance_layout->addWidget(calibration_lbl_, row, 0, 1, 3);
+
+  QPushButton* recalibrate_btn = new QPushButton(tr("Recalibrate"));
+  recalibrate_btn->setToolTip(tr("Measure this computer again. Takes a few seconds."));
+  connect(recalibrate_btn, &QPushButton::clicked, this, [this](){
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    HardwareProfile::Calibrate(true);
+    HardwareProfile::CalibrateGPU(true);
+    QApplication::restoreOverrideCursor();
+
+    UpdateCalibrationLabel();
+  });
+  performance_layout->addWidget(recalibrate_btn, row, 3);
+
+  UpdateCalibrationLabel();
+
+  QGroupBox* proxy_group = new QGroupBox(tr("Proxies"));
+  outer_layout->addWidget(proxy_group);
+  QGridLayout* proxy_layout = new QGridLayout(proxy_group);
+
+  row = 0;
+
+  proxy_enabled_box_ = new QCheckBox(tr("Generate and use proxies for large footage in previews"));
+  proxy_enabled_box_->setChecked(Config::Current()["ProxyEnabled"].toBool());
+  proxy_layout->addWidget(proxy_enabled_box_, row, 0, 1, 2);
+
+  row++;
+
+  proxy_layout->addWidget(new QLabel(tr("Proxy Resolution:")), row, 0);
+
+  proxy_divider_combo_ = new VideoDividerComboBox();
+  proxy_divider_combo_->SetDivider(Config::Current()["ProxyDivider"].toInt());
+  proxy_layout->addWidget(proxy_divider_combo_, row, 1);
+
   outer_layout->addStretch();
 }
 
@@ -115,8 +319,63 @@ void PreferencesDiskTab::Accept(MultiUndoCommand *command)
     default_disk_cache_folder_->SetPath(disk_cache_location_->text());
   }
 
-  Config::Current()["DiskCacheBehind"] = QVariant::fromValue(rational::fromDouble(cache_behind_slider_->GetValue()));
-  Config::Current()["DiskCacheAhead"] = QVariant::fromValue(rational::fromDouble(cache_ahead_slider_->GetValue()));
+  Config::Current().Set("DiskCacheBehind", QVariant::fromValue(rational::fromDouble(cache_behind_slider_->GetValue())));
+  Config::Current().Set("DiskCacheAhead", QVariant::fromValue(rational::fromDouble(cache_ahead_slider_->GetValue())));
+
+  // Caches are resized by the MemoryGovernor as these change
+  Config::Current().Set("GPUCacheSize", QVariant::fromValue(int(gpu_cache_slider_->GetValue())));
+
+  Config::Current().Set("ExportBufferSize", QVariant::fromValue(int(export_buffer_slider_->GetValue())));
+
+  Config::Current().Set("ExportCheckpointInterval", QVariant::fromValue(int(export_checkpoint_slider_->GetValue())));
+
+  Config::Current().Set("NodeValueCacheSize", QVariant::fromValue(int(value_cache_slider_->GetValue())));
+
+  Config::Current().Set("FrameMemoryCacheSize", QVariant::fromValue(int(memory_cache_slider_->GetValue())));
+
+  Config::Current().Set("StillImageCacheSize", QVariant::fromValue(int(still_cache_slider_->GetValue())));
+
+  Config::Current().Set("RAMBudget", QVariant::fromValue(int(ram_budget_slider_->GetValue())));
+  Config::Current().Set("VRAMBudget", QVariant::fromValue(int(vram_budget_slider_->GetValue())));
+
+  Config::Current().Set("AutoCacheSkipRealtimeFrames", skip_realtime_box_->isChecked());
+
+  // Contexts are only created at startup
+  Config::Current().Set("RenderContextCount", QVariant::fromValue(int(render_contexts_slider_->GetValue())));
+
+  // Renderers pick this up on their next garbage collection
+  Config::Current().Set("TexturePoolSize", QVariant::fromValue(int(texture_pool_slider_->GetValue())));
+
+  // Pools are sized when they're created, so these mostly take effect after restarting
+  Config::Current().Set("RenderThreads", QVariant::fromValue(int(render_threads_slider_->GetValue())));
+  Config::Current().Set("DecodeThreads", QVariant::fromValue(int(decode_threads_slider_->GetValue())));
+  Config::Current().Set("RenderFramesInFlight", QVariant::fromValue(int(frames_in_flight_slider_->GetValue())));
+  Config::Current().Set("CacheWriteThreads", QVariant::fromValue(int(cache_write_threads_slider_->GetValue())));
+
+  Config::Current().Set("ProxyEnabled", proxy_enabled_box_->isChecked());
+  Config::Current().Set("ProxyDivider", proxy_divider_combo_->GetDivider());
+}
+
+IntegerSlider *PreferencesDiskTab::CreateTuningSlider(const QString &key)
+{
+  IntegerSlider* slider = new IntegerSlider();
+  slider->SetMinimum(0);
+  slider->SetMaximum(256);
+  slider->setToolTip(tr("Set to 0 to use the value calibrated for this computer. Takes effect after restarting."));
+  slider->SetValue(Config::Current()[key].toLongLong());
+  return slider;
+}
+
+void PreferencesDiskTab::UpdateCalibrationLabel()
+{
+  calibration_lbl_->setText(tr("Calibrated for this computer: %1 render threads, %2 decode threads, %3 frames in flight, "
+                               "%4 cache write threads (disk cache writes %5 MB/s, GPU transfers %6 MB/s)")
+                            .arg(QString::number(Config::Current()["CalibratedRenderThreads"].toInt()),
+                                 QString::number(Config::Current()["CalibratedDecodeThreads"].toInt()),
+                                 QString::number(Config::Current()["CalibratedFramesInFlight"].toInt()),
+                                 QString::number(Config::Current()["CalibratedCacheWriteThreads"].toInt()),
+                                 QString::number(Config::Current()["CalibratedDiskWriteSpeed"].toInt()),
+                                 QString::number(Config::Current()["CalibratedGPUTransferSpeed"].toInt())));
 }
 
 }
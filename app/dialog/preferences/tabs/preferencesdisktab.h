@@ -22,12 +22,15 @@
 #define PREFERENCESDISKTAB_H
 
 #include <QCheckBox>
+#include <QLabel>
 #include <QLineEdit>
 #include <QPushButton>
 
 #include "dialog/configbase/configdialogbase.h"
 #include "render/diskmanager.h"
 #include "widget/slider/floatslider.h"
+#include "widget/slider/integerslider.h"
+#include "widget/standardcombos/videodividercombobox.h"
 #include "widget/path/pathwidget.h"
 
 namespace olive {
@@ -43,12 +46,55 @@ public:
   virtual void Accept(MultiUndoCommand* command) override;
 
 private:
+  /**
+   * @brief Create a slider for one of HardwareProfile's overrides, where 0 means calibrated
+   */
+  IntegerSlider* CreateTuningSlider(const QString& key);
+
+  void UpdateCalibrationLabel();
+
   PathWidget* disk_cache_location_;
 
   FloatSlider* cache_ahead_slider_;
 
   FloatSlider* cache_behind_slider_;
 
+  IntegerSlider* gpu_cache_slider_;
+
+  IntegerSlider* export_buffer_slider_;
+
+  IntegerSlider* export_checkpoint_slider_;
+
+  IntegerSlider* value_cache_slider_;
+
+  IntegerSlider* texture_pool_slider_;
+
+  IntegerSlider* memory_cache_slider_;
+
+  IntegerSlider* render_contexts_slider_;
+
+  IntegerSlider* still_cache_slider_;
+
+  IntegerSlider* ram_budget_slider_;
+
+  IntegerSlider* vram_budget_slider_;
+
+  QCheckBox* skip_realtime_box_;
+
+  IntegerSlider* render_threads_slider_;
+
+  IntegerSlider* decode_threads_slider_;
+
+  IntegerSlider* frames_in_flight_slider_;
+
+  IntegerSlider* cache_write_threads_slider_;
+
+  QLabel* calibration_lbl_;
+
+  QCheckBox* proxy_enabled_box_;
+
+  VideoDividerComboBox* proxy_divider_combo_;
+
   DiskCacheFolder* default_disk_cache_folder_;
 
 };
@@ -26,6 +26,7 @@
 #include <QPushButton>
 
 #include "common/autoscroll.h"
+#include "common/ffmpegutils.h"
 #include "core.h"
 #include "dialog/sequence/sequence.h"
 #include "node/project/sequence/sequence.h"
@@ -150,6 +151,76 @@ PreferencesGeneralTab::PreferencesGeneralTab()
     autorecovery_layout->addWidget(browse_autorecoveries, row, 1);
   }
 
+  {
+    QGroupBox* project_groupbox = new QGroupBox(tr("Project Files"));
+    QGridLayout* project_layout = new QGridLayout(project_groupbox);
+    layout->addWidget(project_groupbox);
+
+    project_layout->addWidget(new QLabel(tr("Save In Binary Format:")), 0, 0);
+
+    binary_project_files_ = new QCheckBox();
+    binary_project_files_->setToolTip(tr("Binary projects open and save faster, but can't be read "
+                                         "by versions of Olive that predate the format."));
+    binary_project_files_->setChecked(Config::Current()[QStringLiteral("BinaryProjectFiles")].toBool());
+    project_layout->addWidget(binary_project_files_, 0, 1);
+
+    project_layout->addWidget(new QLabel(tr("Load Sequences On Demand:")), 1, 0);
+
+    lazy_load_sequences_ = new QCheckBox();
+    lazy_load_sequences_->setToolTip(tr("Only load the contents of a sequence when it's first "
+                                        "opened, making large projects open faster."));
+    lazy_load_sequences_->setChecked(Config::Current()[QStringLiteral("LazyLoadSequences")].toBool());
+    project_layout->addWidget(lazy_load_sequences_, 1, 1);
+  }
+
+  {
+    QGroupBox* decoding_groupbox = new QGroupBox(tr("Decoding"));
+    QGridLayout* decoding_layout = new QGridLayout(decoding_groupbox);
+    layout->addWidget(decoding_groupbox);
+
+    int row = 0;
+
+    decoding_layout->addWidget(new QLabel(tr("Hardware Decoding:")), row, 0);
+
+    // Item data is the FFmpeg device type name, or an empty string for software decoding
+    hardware_decoding_combobox_ = new QComboBox();
+    hardware_decoding_combobox_->addItem(tr("Disabled"), QString());
+    foreach (const QString& type, FFmpegUtils::GetHardwareDeviceTypes()) {
+      hardware_decoding_combobox_->addItem(type, type);
+    }
+
+    int hw_index = hardware_decoding_combobox_->findData(Config::Current()[QStringLiteral("HardwareDecoding")].toString());
+    hardware_decoding_combobox_->setCurrentIndex(qMax(0, hw_index));
+    decoding_layout->addWidget(hardware_decoding_combobox_, row, 1);
+
+    row++;
+
+    decoding_layout->addWidget(new QLabel(tr("Decoded Frame Cache:")), row, 0);
+
+    decoder_cache_slider_ = new IntegerSlider();
+    decoder_cache_slider_->SetMinimum(16);
+    decoder_cache_slider_->SetMaximum(8192);
+    decoder_cache_slider_->SetFormat(tr("%1 MB"));
+    decoder_cache_slider_->SetValue(Config::Current()[QStringLiteral("DecoderCacheSize")].toLongLong());
+    decoding_layout->addWidget(decoder_cache_slider_, row, 1);
+  }
+
+  {
+    QGroupBox* scopes_groupbox = new QGroupBox(tr("Scopes"));
+    QGridLayout* scopes_layout = new QGridLayout(scopes_groupbox);
+    layout->addWidget(scopes_groupbox);
+
+    scopes_layout->addWidget(new QLabel(tr("Sampled Lines:")), 0, 0);
+
+    scope_sample_lines_slider_ = new IntegerSlider();
+    scope_sample_lines_slider_->setToolTip(tr("Frames are scaled down to this many lines before being "
+                                              "measured. Higher values are more accurate but slower."));
+    scope_sample_lines_slider_->SetMinimum(32);
+    scope_sample_lines_slider_->SetMaximum(2160);
+    scope_sample_lines_slider_->SetValue(Config::Current()[QStringLiteral("ScopeSampleLines")].toLongLong());
+    scopes_layout->addWidget(scope_sample_lines_slider_, 0, 1);
+  }
+
   layout->addStretch();
 }
 
@@ -157,11 +228,11 @@ void PreferencesGeneralTab::Accept(MultiUndoCommand *command)
 {
   Q_UNUSED(command)
 
-  Config::Current()[QStringLiteral("RectifiedWaveforms")] = rectified_waveforms_->isChecked();
+  Config::Current().Set(QStringLiteral("RectifiedWaveforms"), rectified_waveforms_->isChecked());
 
-  Config::Current()[QStringLiteral("Autoscroll")] = autoscroll_method_->currentData();
+  Config::Current().Set(QStringLiteral("Autoscroll"), autoscroll_method_->currentData());
 
-  Config::Current()[QStringLiteral("DefaultStillLength")] = QVariant::fromValue(default_still_length_->GetValue());
+  Config::Current().Set(QStringLiteral("DefaultStillLength"), QVariant::fromValue(default_still_length_->GetValue()));
 
   QString set_language = language_combobox_->currentData().toString();
   if (QLocale::system().name() == set_language) {
@@ -171,14 +242,21 @@ void PreferencesGeneralTab::Accept(MultiUndoCommand *command)
 
   // If the language has changed, set it now
   if (Config::Current()[QStringLiteral("Language")].toString() != set_language) {
-    Config::Current()[QStringLiteral("Language")] = set_language;
+    Config::Current().Set(QStringLiteral("Language"), set_language);
     Core::instance()->SetLanguage(set_language.isEmpty() ? QLocale::system().name() : set_language);
   }
 
-  Config::Current()[QStringLiteral("AutorecoveryEnabled")] = autorecovery_enabled_->isChecked();
-  Config::Current()[QStringLiteral("AutorecoveryInterval")] = QVariant::fromValue(autorecovery_interval_->GetValue());
-  Config::Current()[QStringLiteral("AutorecoveryMaximum")] = QVariant::fromValue(autorecovery_maximum_->GetValue());
+  Config::Current().Set(QStringLiteral("AutorecoveryEnabled"), autorecovery_enabled_->isChecked());
+  Config::Current().Set(QStringLiteral("AutorecoveryInterval"), QVariant::fromValue(autorecovery_interval_->GetValue()));
+  Config::Current().Set(QStringLiteral("AutorecoveryMaximum"), QVariant::fromValue(autorecovery_maximum_->GetValue()));
+  Config::Current().Set(QStringLiteral("BinaryProjectFiles"), binary_project_files_->isChecked());
+
+  Config::Current().Set(QStringLiteral("LazyLoadSequences"), lazy_load_sequences_->isChecked());
   Core::instance()->SetAutorecoveryInterval(autorecovery_interval_->GetValue());
+
+  Config::Current().Set(QStringLiteral("HardwareDecoding"), hardware_decoding_combobox_->currentData());
+  Config::Current().Set(QStringLiteral("DecoderCacheSize"), QVariant::fromValue(int(decoder_cache_slider_->GetValue())));
+  Config::Current().Set(QStringLiteral("ScopeSampleLines"), QVariant::fromValue(int(scope_sample_lines_slider_->GetValue())));
 }
 
 void PreferencesGeneralTab::AddLanguage(const QString &locale_name)
@@ -57,6 +57,16 @@ private:
 
   IntegerSlider* autorecovery_maximum_;
 
+  QCheckBox* binary_project_files_;
+
+  QCheckBox* lazy_load_sequences_;
+
+  QComboBox* hardware_decoding_combobox_;
+
+  IntegerSlider* decoder_cache_slider_;
+
+  IntegerSlider* scope_sample_lines_slider_;
+
 };
 
 }
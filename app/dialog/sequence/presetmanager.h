@@ -28,11 +28,10 @@
 #include <QInputDialog>
 #include <QMessageBox>
 #include <QObject>
-#include <QXmlStreamReader>
-#include <QXmlStreamWriter>
 
 #include "common/define.h"
 #include "common/filefunctions.h"
+#include "common/xmlstream.h"
 #include "common/xmlutils.h"
 
 namespace olive {
@@ -54,9 +53,9 @@ public:
     name_ = s;
   }
 
-  virtual void Load(QXmlStreamReader* reader) = 0;
+  virtual void Load(XMLReader* reader) = 0;
 
-  virtual void Save(QXmlStreamWriter* writer) const = 0;
+  virtual void Save(XMLWriter* writer) const = 0;
 
 private:
   QString name_;
@@ -74,7 +73,7 @@ public:
     // Load custom preset data from file
     QFile preset_file(GetCustomPresetFilename());
     if (preset_file.open(QFile::ReadOnly)) {
-      QXmlStreamReader reader(&preset_file);
+      XMLReader reader(&preset_file);
 
       while (XMLReadNextStartElement(&reader)) {
         if (reader.name() == QStringLiteral("presets")) {
@@ -103,7 +102,7 @@ public:
     // Save custom presets to disk
     QFile preset_file(GetCustomPresetFilename());
     if (preset_file.open(QFile::WriteOnly)) {
-      QXmlStreamWriter writer(&preset_file);
+      XMLWriter writer(&preset_file);
       writer.setAutoFormatting(true);
 
       writer.writeStartDocument();
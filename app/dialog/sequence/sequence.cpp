@@ -146,13 +146,13 @@ void SequenceDialog::SetAsDefaultClicked()
                           tr("Are you sure you want to set the current parameters as defaults?"),
                           QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
     // Maybe replace with Preset system
-    Config::Current()[QStringLiteral("DefaultSequenceWidth")] = parameter_tab_->GetSelectedVideoWidth();
-    Config::Current()[QStringLiteral("DefaultSequenceHeight")] = parameter_tab_->GetSelectedVideoHeight();
-    Config::Current()[QStringLiteral("DefaultSequencePixelAspect")] = QVariant::fromValue(parameter_tab_->GetSelectedVideoPixelAspect());
-    Config::Current()[QStringLiteral("DefaultSequenceFrameRate")] = QVariant::fromValue(parameter_tab_->GetSelectedVideoFrameRate().flipped());
-    Config::Current()[QStringLiteral("DefaultSequenceInterlacing")] = parameter_tab_->GetSelectedVideoInterlacingMode();
-    Config::Current()[QStringLiteral("DefaultSequenceAudioFrequency")] = parameter_tab_->GetSelectedAudioSampleRate();
-    Config::Current()[QStringLiteral("DefaultSequenceAudioLayout")] = QVariant::fromValue(parameter_tab_->GetSelectedAudioChannelLayout());
+    Config::Current().Set(QStringLiteral("DefaultSequenceWidth"), parameter_tab_->GetSelectedVideoWidth());
+    Config::Current().Set(QStringLiteral("DefaultSequenceHeight"), parameter_tab_->GetSelectedVideoHeight());
+    Config::Current().Set(QStringLiteral("DefaultSequencePixelAspect"), QVariant::fromValue(parameter_tab_->GetSelectedVideoPixelAspect()));
+    Config::Current().Set(QStringLiteral("DefaultSequenceFrameRate"), QVariant::fromValue(parameter_tab_->GetSelectedVideoFrameRate().flipped()));
+    Config::Current().Set(QStringLiteral("DefaultSequenceInterlacing"), parameter_tab_->GetSelectedVideoInterlacingMode());
+    Config::Current().Set(QStringLiteral("DefaultSequenceAudioFrequency"), parameter_tab_->GetSelectedAudioSampleRate());
+    Config::Current().Set(QStringLiteral("DefaultSequenceAudioLayout"), QVariant::fromValue(parameter_tab_->GetSelectedAudioChannelLayout()));
   }
 }
 
@@ -27,9 +27,9 @@
 #include <QVBoxLayout>
 #include <QSplitter>
 #include <QTreeWidgetItem>
-#include <QXmlStreamWriter>
 
 #include "common/filefunctions.h"
+#include "common/xmlstream.h"
 #include "config/config.h"
 #include "render/videoparams.h"
 #include "ui/icons/icons.h"
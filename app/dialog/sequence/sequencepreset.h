@@ -21,9 +21,8 @@
 #ifndef SEQUENCEPARAM_H
 #define SEQUENCEPARAM_H
 
-#include <QXmlStreamWriter>
-
 #include "common/rational.h"
+#include "common/xmlstream.h"
 #include "common/xmlutils.h"
 #include "dialog/sequence/presetmanager.h"
 #include "render/videoparams.h"
@@ -73,7 +72,7 @@ public:
                               preview_divider, preview_format);
   }
 
-  virtual void Load(QXmlStreamReader* reader) override
+  virtual void Load(XMLReader* reader) override
   {
     while (XMLReadNextStartElement(reader)) {
       if (reader->name() == QStringLiteral("name")) {
@@ -102,7 +101,7 @@ public:
     }
   }
 
-  virtual void Save(QXmlStreamWriter* writer) const override
+  virtual void Save(XMLWriter* writer) const override
   {
     writer->writeTextElement(QStringLiteral("name"), GetName());
     writer->writeTextElement(QStringLiteral("width"), QString::number(width_));
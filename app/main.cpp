@@ -94,6 +94,74 @@ int main(int argc, char *argv[])
       parser.AddOption({QStringLiteral("x"), QStringLiteral("-export")},
                        QCoreApplication::translate("main", "Export only (No GUI)"));
 
+  auto export_spec_option =
+      parser.AddOption({QStringLiteral("-export-spec")},
+                       QCoreApplication::translate("main", "Export using settings from a JSON file (implies --export)"),
+                       true,
+                       QCoreApplication::translate("main", "json-file"));
+
+  auto export_sequence_option =
+      parser.AddOption({QStringLiteral("-export-sequence")},
+                       QCoreApplication::translate("main", "Name of the sequence to export"),
+                       true,
+                       QCoreApplication::translate("main", "name"));
+
+  auto export_output_option =
+      parser.AddOption({QStringLiteral("-export-output")},
+                       QCoreApplication::translate("main", "File to export to"),
+                       true,
+                       QCoreApplication::translate("main", "file"));
+
+  auto shared_cache_option =
+      parser.AddOption({QStringLiteral("-export-shared-cache")},
+                       QCoreApplication::translate("main", "Split the export between processes through a shared cache folder"),
+                       true,
+                       QCoreApplication::translate("main", "folder"));
+
+  auto shared_cache_role_option =
+      parser.AddOption({QStringLiteral("-export-shared-cache-role")},
+                       QCoreApplication::translate("main", "Role in a shared cache export (\"worker\" or \"assembler\")"),
+                       true,
+                       QCoreApplication::translate("main", "role"));
+
+  auto json_progress_option =
+      parser.AddOption({QStringLiteral("-json-progress")},
+                       QCoreApplication::translate("main", "Report export progress as one JSON object per line"));
+
+  auto benchmark_option =
+      parser.AddOption({QStringLiteral("-benchmark-playback")},
+                       QCoreApplication::translate("main", "Play a sequence and report how well playback kept up"));
+
+  auto benchmark_sequence_option =
+      parser.AddOption({QStringLiteral("-benchmark-sequence")},
+                       QCoreApplication::translate("main", "Name of the sequence to benchmark"),
+                       true,
+                       QCoreApplication::translate("main", "name"));
+
+  auto benchmark_range_option =
+      parser.AddOption({QStringLiteral("-benchmark-range")},
+                       QCoreApplication::translate("main", "Frames to play in a benchmark (default is the whole sequence)"),
+                       true,
+                       QCoreApplication::translate("main", "in-out"));
+
+  auto benchmark_output_option =
+      parser.AddOption({QStringLiteral("-benchmark-output")},
+                       QCoreApplication::translate("main", "Write benchmark results to a JSON file instead of stdout"),
+                       true,
+                       QCoreApplication::translate("main", "file"));
+
+  auto trace_option =
+      parser.AddOption({QStringLiteral("-trace")},
+                       QCoreApplication::translate("main", "Record where time is spent and write it as a Chrome trace on exit"),
+                       true,
+                       QCoreApplication::translate("main", "json-file"));
+
+  auto metrics_port_option =
+      parser.AddOption({QStringLiteral("-metrics-port")},
+                       QCoreApplication::translate("main", "Serve render metrics for Prometheus over HTTP on this port (all interfaces)"),
+                       true,
+                       QCoreApplication::translate("main", "port"));
+
   auto ts_option =
       parser.AddOption({QStringLiteral("-ts")},
                        QCoreApplication::translate("main", "Override language with file"),
@@ -108,7 +176,7 @@ int main(int argc, char *argv[])
   //
   // Because we don't use QCommandLineParser, we must filter out Qt's arguments ourselves. Here,
   // we create them so they're recognized, but never use and also hide them in the "help" text.
-  parser.AddOption({QStringLiteral("platform")}, QString(), true, QString(), true);
+  auto platform_option = parser.AddOption({QStringLiteral("platform")}, QString(), true, QString(), true);
   parser.AddOption({QStringLiteral("platformpluginpath")}, QString(), true, QString(), true);
   parser.AddOption({QStringLiteral("platformtheme")}, QString(), true, QString(), true);
   parser.AddOption({QStringLiteral("plugin")}, QString(), true, QString(), true);
@@ -136,8 +204,33 @@ int main(int argc, char *argv[])
     return 0;
   }
 
-  if (export_option->IsSet()) {
+  if (export_option->IsSet() || export_spec_option->IsSet()) {
     startup_params.set_run_mode(olive::Core::CoreParams::kHeadlessExport);
+    startup_params.set_export_spec(export_spec_option->GetSetting());
+    startup_params.set_export_sequence(export_sequence_option->GetSetting());
+    startup_params.set_export_filename(export_output_option->GetSetting());
+    startup_params.set_export_shared_cache(shared_cache_option->GetSetting());
+    startup_params.set_export_shared_cache_role(shared_cache_role_option->GetSetting());
+    startup_params.set_machine_readable_progress(json_progress_option->IsSet());
+  } else if (benchmark_option->IsSet()) {
+    startup_params.set_run_mode(olive::Core::CoreParams::kPlaybackBenchmark);
+    startup_params.set_benchmark_sequence(benchmark_sequence_option->GetSetting());
+    startup_params.set_benchmark_range(benchmark_range_option->GetSetting());
+    startup_params.set_benchmark_output(benchmark_output_option->GetSetting());
+  }
+
+  startup_params.set_trace_filename(trace_option->GetSetting());
+
+  if (metrics_port_option->IsSet()) {
+    bool ok;
+    int port = metrics_port_option->GetSetting().toInt(&ok);
+
+    if (!ok || port <= 0 || port > 65535) {
+      qCritical() << "--metrics-port must be a port number between 1 and 65535";
+      return 1;
+    }
+
+    startup_params.set_metrics_port(port);
   }
 
   if (ts_option->IsSet()) {
@@ -177,8 +270,26 @@ int main(int argc, char *argv[])
   // Create application instance
   std::unique_ptr<QCoreApplication> a;
 
-  if (startup_params.run_mode() == olive::Core::CoreParams::kRunNormal) {
+  if (startup_params.run_mode() == olive::Core::CoreParams::kRunNormal
+      || startup_params.run_mode() == olive::Core::CoreParams::kPlaybackBenchmark) {
     a.reset(new QApplication(argc, argv));
+  } else if (startup_params.run_mode() == olive::Core::CoreParams::kHeadlessExport) {
+#ifdef Q_OS_LINUX
+    // Rendering still needs an OpenGL context, which needs a QGuiApplication. Render nodes usually
+    // have no display server, so unless told otherwise use a platform that doesn't need one. The
+    // renderer only ever draws to offscreen surfaces, so this also works with e.g. EGL's
+    // surfaceless platform by setting QT_QPA_PLATFORM=eglfs.
+    if (!platform_option->IsSet()
+        && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")
+        && qEnvironmentVariableIsEmpty("DISPLAY")
+        && qEnvironmentVariableIsEmpty("WAYLAND_DISPLAY")) {
+      qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+#else
+    Q_UNUSED(platform_option)
+#endif
+
+    a.reset(new QGuiApplication(argc, argv));
   } else {
     a.reset(new QCoreApplication(argc, argv));
   }
@@ -79,6 +79,11 @@ void VolumeNode::ProcessSamples(NodeValueDatabase &values, const SampleBufferPtr
   return ProcessSamplesInternal(values, kOpMultiply, kSamplesInput, kVolumeInput, input, output, index);
 }
 
+bool VolumeNode::ProcessSampleBlock(const QHash<QString, QVector<QVariant> > &values, const SampleBufferPtr input, SampleBufferPtr output) const
+{
+  return ProcessSampleBlockInternal(values, kOpMultiply, kSamplesInput, kVolumeInput, input, output);
+}
+
 void VolumeNode::Retranslate()
 {
   SetInputName(kSamplesInput, tr("Samples"));
@@ -44,6 +44,8 @@ public:
 
   virtual void ProcessSamples(NodeValueDatabase &values, const SampleBufferPtr input, SampleBufferPtr output, int index) const override;
 
+  virtual bool ProcessSampleBlock(const QHash<QString, QVector<QVariant> >& values, const SampleBufferPtr input, SampleBufferPtr output) const override;
+
   virtual void Retranslate() override;
 
   static const QString kSamplesInput;
@@ -25,11 +25,22 @@ namespace olive {
 #define super Block
 
 const QString ClipBlock::kBufferIn = QStringLiteral("buffer_in");
+const QString ClipBlock::kFlattenedSourceIn = QStringLiteral("flattened_source_in");
+const QString ClipBlock::kFlattenedOffsetInput = QStringLiteral("flattened_offset_in");
 
 ClipBlock::ClipBlock(bool create_buffer_in)
 {
   if (create_buffer_in) {
     AddInput(kBufferIn, NodeValue::kNone, InputFlags(kInputFlagNotKeyframable));
+
+    // Neither of these change what the clip renders
+    AddInput(kFlattenedSourceIn, NodeValue::kNone, InputFlags(kInputFlagNotKeyframable));
+    IgnoreInvalidationsFrom(kFlattenedSourceIn);
+
+    // Where the flattened render starts in the original source's media time
+    AddInput(kFlattenedOffsetInput, NodeValue::kRational, QVariant::fromValue(rational(0)), InputFlags(kInputFlagNotKeyframable));
+    IgnoreInvalidationsFrom(kFlattenedOffsetInput);
+    IgnoreHashingFrom(kFlattenedOffsetInput);
   }
 }
 
@@ -38,6 +49,14 @@ Node *ClipBlock::copy() const
   return new ClipBlock();
 }
 
+QVector<QString> ClipBlock::inputs_for_output(const QString &output) const
+{
+  // The original graph of a flattened clip is only kept so it can be restored, never rendered
+  QVector<QString> inputs = super::inputs_for_output(output);
+  inputs.removeOne(kFlattenedSourceIn);
+  return inputs;
+}
+
 QString ClipBlock::Name() const
 {
   return tr("Clip");
@@ -112,10 +131,12 @@ void ClipBlock::Retranslate()
 
   if (HasInputWithID(kBufferIn)) {
     SetInputName(kBufferIn, tr("Buffer"));
+    SetInputName(kFlattenedSourceIn, tr("Flattened Source"));
+    SetInputName(kFlattenedOffsetInput, tr("Flattened Offset"));
   }
 }
 
-void ClipBlock::Hash(const QString &out, QCryptographicHash &hash, const rational &time, const VideoParams &video_params) const
+void ClipBlock::Hash(const QString &out, Hasher &hash, const rational &time, const VideoParams &video_params) const
 {
   Q_UNUSED(out)
 
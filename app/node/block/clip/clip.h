@@ -38,6 +38,8 @@ public:
 
   virtual Node* copy() const override;
 
+  virtual QVector<QString> inputs_for_output(const QString& output) const override;
+
   virtual QString Name() const override;
   virtual QString id() const override;
   virtual QString Description() const override;
@@ -52,9 +54,22 @@ public:
 
   virtual void Retranslate() override;
 
-  virtual void Hash(const QString& output, QCryptographicHash &hash, const rational &time, const VideoParams& video_params) const override;
+  virtual void Hash(const QString& output, Hasher &hash, const rational &time, const VideoParams& video_params) const override;
+
+  /**
+   * @brief Returns true if this clip has been rendered in place (see RenderInPlaceTask)
+   *
+   * A flattened clip's buffer is connected to footage of its original output, which is kept
+   * connected to kFlattenedSourceIn so it can be restored. Nothing connected there is rendered.
+   */
+  bool IsFlattened() const
+  {
+    return IsInputConnected(kFlattenedSourceIn);
+  }
 
   static const QString kBufferIn;
+  static const QString kFlattenedSourceIn;
+  static const QString kFlattenedOffsetInput;
 
 };
 
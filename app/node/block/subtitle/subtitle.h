@@ -22,6 +22,7 @@
 #define SUBTITLEBLOCK_H
 
 #include "node/block/clip/clip.h"
+#include "render/subtitleparams.h"
 
 namespace olive {
 
@@ -53,6 +54,11 @@ public:
     SetStandardValue(kTextIn, text);
   }
 
+  SubtitleCue GetCue() const
+  {
+    return SubtitleCue(TimeRange(in(), out()), GetText());
+  }
+
 };
 
 }
@@ -64,6 +64,27 @@ void CrossDissolveTransition::ShaderJobEvent(NodeValueDatabase &value, ShaderJob
   Q_UNUSED(value)
 
   job.SetAlphaChannelRequired(GenerateJob::kAlphaForceOn);
+
+  // Dissolving between solids is just a weighted sum of their colors
+  TexturePtr out_tex = job.GetValue(kOutBlockInput).data().value<TexturePtr>();
+  TexturePtr in_tex = job.GetValue(kInBlockInput).data().value<TexturePtr>();
+
+  if ((out_tex || in_tex)
+      && (!out_tex || out_tex->IsConstantColor())
+      && (!in_tex || in_tex->IsConstantColor())) {
+    double progress = job.GetValue(QStringLiteral("ove_tprog_all")).data().toDouble();
+    Color composite(0.0, 0.0, 0.0, 0.0);
+
+    if (out_tex) {
+      composite += out_tex->GetConstantColor() * TransformCurve(1.0 - progress);
+    }
+
+    if (in_tex) {
+      composite += in_tex->GetConstantColor() * TransformCurve(progress);
+    }
+
+    job.SetConstantColor(composite);
+  }
 }
 
 void CrossDissolveTransition::SampleJobEvent(SampleBufferPtr from_samples, SampleBufferPtr to_samples, SampleBufferPtr out_samples, double time_in) const
@@ -64,6 +64,40 @@ ShaderCode DipToColorTransition::GetShaderCode(const QString &shader_id) const
 void DipToColorTransition::ShaderJobEvent(NodeValueDatabase &value, ShaderJob &job) const
 {
   job.InsertValue(this, kColorInput, value);
+
+  // Dipping between solids (or from a solid to nothing) produces another solid
+  TexturePtr out_tex = job.GetValue(kOutBlockInput).data().value<TexturePtr>();
+  TexturePtr in_tex = job.GetValue(kInBlockInput).data().value<TexturePtr>();
+
+  if ((out_tex && !out_tex->IsConstantColor()) || (in_tex && !in_tex->IsConstantColor())) {
+    return;
+  }
+
+  Color color = job.GetValue(kColorInput).data().value<Color>();
+  Color composite(0.0, 0.0, 0.0, 0.0);
+
+  if (out_tex && in_tex) {
+    double out_progress = job.GetValue(QStringLiteral("ove_tprog_out")).data().toDouble();
+    double in_progress = job.GetValue(QStringLiteral("ove_tprog_in")).data().toDouble();
+
+    composite = Mix(out_tex->GetConstantColor(), color, out_progress)
+        + Mix(in_tex->GetConstantColor(), color, 1.0 - in_progress);
+  } else if (out_tex || in_tex) {
+    double progress = job.GetValue(QStringLiteral("ove_tprog_all")).data().toDouble();
+
+    if (out_tex) {
+      composite = Mix(out_tex->GetConstantColor(), color, progress);
+    } else {
+      composite = Mix(in_tex->GetConstantColor(), color, 1.0 - progress);
+    }
+  }
+
+  job.SetConstantColor(composite);
+}
+
+Color DipToColorTransition::Mix(const Color &a, const Color &b, double t)
+{
+  return a * (1.0 - t) + b * t;
 }
 
 }
@@ -47,6 +47,9 @@ public:
 protected:
   virtual void ShaderJobEvent(NodeValueDatabase &value, ShaderJob& job) const override;
 
+private:
+  static Color Mix(const Color& a, const Color& b, double t);
+
 };
 
 }
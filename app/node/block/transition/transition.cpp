@@ -118,7 +118,7 @@ double TransitionBlock::GetInProgress(const double &time) const
   return clamp((GetInternalTransitionTime(time) - out_offset().toDouble()) / in_offset().toDouble(), 0.0, 1.0);
 }
 
-void TransitionBlock::Hash(const QString &output, QCryptographicHash &hash, const rational &time, const VideoParams &video_params) const
+void TransitionBlock::Hash(const QString &output, Hasher &hash, const rational &time, const VideoParams &video_params) const
 {
   Node::Hash(output, hash, time, video_params);
 
@@ -127,9 +127,18 @@ void TransitionBlock::Hash(const QString &output, QCryptographicHash &hash, cons
   double in_prog = GetInProgress(time_dbl);
   double out_prog = GetOutProgress(time_dbl);
 
-  hash.addData(reinterpret_cast<const char*>(&all_prog), sizeof(double));
-  hash.addData(reinterpret_cast<const char*>(&in_prog), sizeof(double));
-  hash.addData(reinterpret_cast<const char*>(&out_prog), sizeof(double));
+  hash.add(all_prog);
+  hash.add(in_prog);
+  hash.add(out_prog);
+}
+
+QVector<TimeRange> TransitionBlock::GetConstantRanges(const QString &output, const TimeRange &range) const
+{
+  Q_UNUSED(output)
+  Q_UNUSED(range)
+
+  // Transition progress changes on every frame
+  return QVector<TimeRange>();
 }
 
 double TransitionBlock::GetInternalTransitionTime(const double &time) const
@@ -45,7 +45,9 @@ public:
   double GetOutProgress(const double &time) const;
   double GetInProgress(const double &time) const;
 
-  virtual void Hash(const QString& output, QCryptographicHash& hash, const rational &time, const VideoParams& video_params) const override;
+  virtual void Hash(const QString& output, Hasher& hash, const rational &time, const VideoParams& video_params) const override;
+
+  virtual QVector<TimeRange> GetConstantRanges(const QString& output, const TimeRange& range) const override;
 
   virtual NodeValueTable Value(const QString& output, NodeValueDatabase &value) const override;
 
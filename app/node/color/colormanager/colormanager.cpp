@@ -22,6 +22,7 @@
 
 #include <QDir>
 #include <QStandardPaths>
+#include <QtConcurrent/QtConcurrent>
 
 #include "common/define.h"
 #include "common/filefunctions.h"
@@ -35,6 +36,7 @@ const QString ColorManager::kDefaultColorspaceIn = QStringLiteral("default_input
 const QString ColorManager::kReferenceSpaceIn = QStringLiteral("reference_space");
 
 OCIO::ConstConfigRcPtr ColorManager::default_config_ = nullptr;
+QFuture<void> ColorManager::default_config_future_;
 
 ColorManager::ColorManager() :
   config_(nullptr)
@@ -72,10 +74,19 @@ QString ColorManager::GetConfigFilename() const
 
 OCIO::ConstConfigRcPtr ColorManager::GetDefaultConfig()
 {
+  default_config_future_.waitForFinished();
+
   return default_config_;
 }
 
 void ColorManager::SetUpDefaultConfig()
+{
+  // The C locale set while parsing is process-wide, but anything else that parses a config needs a
+  // ColorManager first, which waits for this
+  default_config_future_ = QtConcurrent::run(&ColorManager::SetUpDefaultConfigInternal);
+}
+
+void ColorManager::SetUpDefaultConfigInternal()
 {
   if (!qgetenv("OCIO").isEmpty()) {
     // Attempt to set config from "OCIO" environment variable
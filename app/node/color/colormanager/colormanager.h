@@ -22,6 +22,7 @@
 #define COLORSERVICE_H
 
 #include <memory>
+#include <QFuture>
 #include <QMutex>
 
 #include "codec/frame.h"
@@ -69,8 +70,17 @@ public:
 
   QString GetConfigFilename() const;
 
+  /**
+   * @brief Get the built-in config, waiting for SetUpDefaultConfig() to finish if necessary
+   */
   static OCIO::ConstConfigRcPtr GetDefaultConfig();
 
+  /**
+   * @brief Start loading the built-in config in the background
+   *
+   * Parsing it is one of the slower parts of startup, so it runs alongside the rest of it until the
+   * first ColorManager needs it.
+   */
   static void SetUpDefaultConfig();
 
   void SetConfigFilename(const QString& filename);
@@ -140,8 +150,12 @@ private:
 
   QMutex mutex_;
 
+  static void SetUpDefaultConfigInternal();
+
   static OCIO::ConstConfigRcPtr default_config_;
 
+  static QFuture<void> default_config_future_;
+
 };
 
 }
@@ -21,6 +21,7 @@
 #include "transformdistortnode.h"
 
 #include <QGuiApplication>
+#include <QtMath>
 
 #include "common/range.h"
 #include "node/traverser.h"
@@ -31,13 +32,16 @@ const QString TransformDistortNode::kTextureInput = QStringLiteral("tex_in");
 const QString TransformDistortNode::kAutoscaleInput = QStringLiteral("autoscale_in");
 const QString TransformDistortNode::kInterpolationInput = QStringLiteral("interpolation_in");
 
+const int TransformDistortNode::kInterpolationAutomatic = Texture::kMipmappedLinear + 1;
+const double TransformDistortNode::kAutomaticMinimumUnfilteredScale = 0.9;
+
 #define super Node
 
 TransformDistortNode::TransformDistortNode()
 {
   AddInput(kAutoscaleInput, NodeValue::kCombo, 0);
 
-  AddInput(kInterpolationInput, NodeValue::kCombo, 2);
+  AddInput(kInterpolationInput, NodeValue::kCombo, kInterpolationAutomatic);
 
   AddInput(kTextureInput, NodeValue::kTexture, InputFlags(kInputFlagNotKeyframable));
 }
@@ -51,7 +55,7 @@ void TransformDistortNode::Retranslate()
   SetInputName(kInterpolationInput, tr("Interpolation"));
 
   SetComboBoxStrings(kAutoscaleInput, {tr("None"), tr("Fit"), tr("Fill"), tr("Stretch")});
-  SetComboBoxStrings(kInterpolationInput, {tr("Nearest Neighbor"), tr("Bilinear"), tr("Mipmapped Bilinear")});
+  SetComboBoxStrings(kInterpolationInput, {tr("Nearest Neighbor"), tr("Bilinear"), tr("Mipmapped Bilinear"), tr("Automatic")});
 }
 
 NodeValueTable TransformDistortNode::Value(const QString &output, NodeValueDatabase &value) const
@@ -81,7 +85,37 @@ NodeValueTable TransformDistortNode::Value(const QString &output, NodeValueDatab
       ShaderJob job;
       job.InsertValue(QStringLiteral("ove_maintex"), NodeValue(NodeValue::kTexture, QVariant::fromValue(texture), this));
       job.InsertValue(QStringLiteral("ove_mvpmat"), NodeValue(NodeValue::kMatrix, real_matrix, this));
-      job.SetInterpolation(QStringLiteral("ove_maintex"), static_cast<Texture::Interpolation>(value[kInterpolationInput].Get(NodeValue::kCombo).toInt()));
+
+      int interpolation = value[kInterpolationInput].Get(NodeValue::kCombo).toInt();
+
+      if (interpolation == kInterpolationAutomatic) {
+        // Find how many destination pixels each texel covers along both of the texture's axes
+        QVector2D sequence_res = value[QStringLiteral("global")].Get(NodeValue::kVec2, QStringLiteral("resolution")).value<QVector2D>();
+        QVector2D texture_res(texture->params().width(), texture->params().height());
+        QVector2D scale(QVector2D(real_matrix(0, 0) * sequence_res.x(), real_matrix(1, 0) * sequence_res.y()).length() / texture_res.x(),
+                        QVector2D(real_matrix(0, 1) * sequence_res.x(), real_matrix(1, 1) * sequence_res.y()).length() / texture_res.y());
+
+        if (qMin(scale.x(), scale.y()) >= kAutomaticMinimumUnfilteredScale) {
+          // Close to 1:1 or enlarging, mipmaps would only blur
+          job.SetInterpolation(QStringLiteral("ove_maintex"), Texture::kLinear);
+        } else {
+          job.SetInterpolation(QStringLiteral("ove_maintex"), Texture::kMipmappedLinear);
+
+          RenderMode::Mode mode = static_cast<RenderMode::Mode>(value[QStringLiteral("global")].Get(NodeValue::kInt, QStringLiteral("render_mode")).toInt());
+
+          if (mode == RenderMode::kOnline) {
+            // Mipmaps alone alias and blur when shrinking, so exports resample with Lanczos
+            job.SetShaderID(QStringLiteral("lanczos"));
+            job.InsertValue(QStringLiteral("resolution_in"), NodeValue(NodeValue::kVec2, texture_res, this));
+            job.InsertValue(QStringLiteral("footprint_in"), NodeValue(NodeValue::kVec2, QVector2D(qMax(1.0f, 1.0f / scale.x()), qMax(1.0f, 1.0f / scale.y())), this));
+
+            // Outermost taps are 1.5 destination pixels out and each reads a mipmap level that size
+            job.SetSamplingFootprint(qCeil(2.0f * qMax(1.0f, 1.0f / qMin(scale.x(), scale.y()))) + 1);
+          }
+        }
+      } else {
+        job.SetInterpolation(QStringLiteral("ove_maintex"), static_cast<Texture::Interpolation>(interpolation));
+      }
 
       // FIXME: This should be optimized, we can use matrix math to determine if this operation will
       //        end up with gaps in the screen that will require an alpha channel.
@@ -96,7 +130,9 @@ NodeValueTable TransformDistortNode::Value(const QString &output, NodeValueDatab
 
 ShaderCode TransformDistortNode::GetShaderCode(const QString &shader_id) const
 {
-  Q_UNUSED(shader_id);
+  if (shader_id == QStringLiteral("lanczos")) {
+    return ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/lanczos.frag")));
+  }
 
   // Returns default frag and vert shader
   return ShaderCode();
@@ -314,7 +350,7 @@ void TransformDistortNode::GizmoRelease()
   gizmo_drag_ = nullptr;
 }
 
-void TransformDistortNode::Hash(const QString &output, QCryptographicHash &hash, const rational &time, const VideoParams &video_params) const
+void TransformDistortNode::Hash(const QString &output, Hasher &hash, const rational &time, const VideoParams &video_params) const
 {
   // If not connected to output, this will produce nothing
   NodeOutput out = GetConnectedOutput(kTextureInput);
@@ -335,8 +371,8 @@ void TransformDistortNode::Hash(const QString &output, QCryptographicHash &hash,
 
     if (!matrix.isIdentity()) {
       // Add fingerprint
-      hash.addData(id().toUtf8());
-      hash.addData(reinterpret_cast<const char*>(&matrix), sizeof(matrix));
+      hash.add(id());
+      hash.add(matrix);
     }
   }
 
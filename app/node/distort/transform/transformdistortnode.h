@@ -80,7 +80,7 @@ public:
   virtual void GizmoMove(const QPointF &p, const rational &time) override;
   virtual void GizmoRelease() override;
 
-  virtual void Hash(const QString& output, QCryptographicHash& hash, const rational &time, const VideoParams& video_params) const override;
+  virtual void Hash(const QString& output, Hasher& hash, const rational &time, const VideoParams& video_params) const override;
 
   enum AutoScaleType {
     kAutoScaleNone,
@@ -99,6 +99,16 @@ public:
   static const QString kInterpolationInput;
 
 private:
+  /**
+   * @brief Interpolation option that picks the sampling from the scale each frame is drawn at
+   */
+  static const int kInterpolationAutomatic;
+
+  /**
+   * @brief Scale (in destination pixels per texel) below which automatic interpolation filters
+   */
+  static const double kAutomaticMinimumUnfilteredScale;
+
   static QPointF CreateScalePoint(double x, double y, const QPointF& half_res, const QMatrix4x4& mat);
 
   QMatrix4x4 GenerateAutoScaledMatrix(const QMatrix4x4 &generated_matrix, NodeValueDatabase &db, const VideoParams &texture_params) const;
@@ -21,6 +21,7 @@
 #include "factory.h"
 
 #include <QCoreApplication>
+#include <QThread>
 
 #include "audio/pan/pan.h"
 #include "audio/volume/volume.h"
@@ -38,11 +39,13 @@
 #include "filter/blur/blur.h"
 #include "filter/mosaic/mosaicfilternode.h"
 #include "filter/stroke/stroke.h"
+#include "input/multicam/multicamnode.h"
 #include "input/time/timeinput.h"
 #include "input/value/valuenode.h"
 #include "math/math/math.h"
 #include "math/merge/merge.h"
 #include "math/trigonometry/trigonometry.h"
+#include "openfx/openfxnode.h"
 #include "output/track/track.h"
 #include "output/viewer/viewer.h"
 #include "project/folder/folder.h"
@@ -52,27 +55,29 @@
 
 namespace olive {
 QList<Node*> NodeFactory::library_;
+std::atomic_bool NodeFactory::library_ready_(false);
+QMutex NodeFactory::library_lock_;
 
 void NodeFactory::Initialize()
 {
   Destroy();
 
-  // Add internal types
-  for (int i=0;i<kInternalNodeCount;i++) {
-    Node* created_node = CreateFromFactoryIndex(static_cast<InternalID>(i));
-
-    library_.append(created_node);
-
-    if (created_node->outputs().isEmpty()) {
-      qWarning() << "Node" << created_node->id() << "has no outputs";
-    }
-  }
+  // Prototypes are created by GetLibrary() the first time they're needed, which is usually well
+  // after the main window has appeared
 }
 
 void NodeFactory::Destroy()
 {
+  QMutexLocker locker(&library_lock_);
+
   qDeleteAll(library_);
   library_.clear();
+  library_ready_ = false;
+
+#ifdef USE_OPENFX
+  // Plugins are only unloaded once their prototypes are gone
+  OpenFXHost::Destroy();
+#endif
 }
 
 Menu *NodeFactory::CreateMenu(QWidget* parent, bool create_none_item, Node::CategoryID restrict_to)
@@ -80,8 +85,10 @@ Menu *NodeFactory::CreateMenu(QWidget* parent, bool create_none_item, Node::Cate
   Menu* menu = new Menu(parent);
   menu->setToolTipsVisible(true);
 
-  for (int i=0;i<library_.size();i++) {
-    Node* n = library_.at(i);
+  const QList<Node*>& library = GetLibrary();
+
+  for (int i=0;i<library.size();i++) {
+    Node* n = library.at(i);
 
     if (restrict_to != Node::kCategoryUnknown && !n->Category().contains(restrict_to)) {
       // Skip this node
@@ -144,7 +151,7 @@ Node* NodeFactory::CreateFromMenuAction(QAction *action)
     return nullptr;
   }
 
-  return library_.at(index)->copy();
+  return GetLibrary().at(index)->copy();
 }
 
 QString NodeFactory::GetIDFromMenuAction(QAction *action)
@@ -155,13 +162,13 @@ QString NodeFactory::GetIDFromMenuAction(QAction *action)
     return QString();
   }
 
-  return library_.at(action->data().toInt())->id();
+  return GetLibrary().at(action->data().toInt())->id();
 }
 
 QString NodeFactory::GetNameFromID(const QString &id)
 {
   if (!id.isEmpty()) {
-    foreach (Node* n, library_) {
+    foreach (Node* n, GetLibrary()) {
       if (n->id() == id) {
         return n->Name();
       }
@@ -173,7 +180,7 @@ QString NodeFactory::GetNameFromID(const QString &id)
 
 Node *NodeFactory::CreateFromID(const QString &id)
 {
-  foreach (Node* n, library_) {
+  foreach (Node* n, GetLibrary()) {
     if (n->id() == id) {
       return n->copy();
     }
@@ -182,6 +189,17 @@ Node *NodeFactory::CreateFromID(const QString &id)
   return nullptr;
 }
 
+const Node *NodeFactory::GetLibraryNodeFromID(const QString &id)
+{
+  foreach (Node* n, GetLibrary()) {
+    if (n->id() == id) {
+      return n;
+    }
+  }
+
+  return nullptr;
+}
+
 Node *NodeFactory::CreateFromFactoryIndex(const NodeFactory::InternalID &id)
 {
   switch (id) {
@@ -239,6 +257,8 @@ Node *NodeFactory::CreateFromFactoryIndex(const NodeFactory::InternalID &id)
     return new TimeRemapNode();
   case kSubtitleBlock:
     return new SubtitleBlock();
+  case kMultiCamNode:
+    return new MultiCamNode();
 
   case kInternalNodeCount:
     break;
@@ -248,4 +268,49 @@ Node *NodeFactory::CreateFromFactoryIndex(const NodeFactory::InternalID &id)
   abort();
 }
 
+const QList<Node *> &NodeFactory::GetLibrary()
+{
+  if (!library_ready_.load(std::memory_order_acquire)) {
+    QMutexLocker locker(&library_lock_);
+
+    if (!library_ready_.load(std::memory_order_relaxed)) {
+      QThread* main_thread = QCoreApplication::instance() ? QCoreApplication::instance()->thread() : nullptr;
+
+      for (int i=0;i<kInternalNodeCount;i++) {
+        Node* created_node = CreateFromFactoryIndex(static_cast<InternalID>(i));
+
+        // The first use may be a project loading in the background, but prototypes live for good
+        if (main_thread && created_node->thread() != main_thread) {
+          created_node->moveToThread(main_thread);
+        }
+
+        library_.append(created_node);
+
+        if (created_node->outputs().isEmpty()) {
+          qWarning() << "Node" << created_node->id() << "has no outputs";
+        }
+      }
+
+#ifdef USE_OPENFX
+      // Every OpenFX plugin found is a node type of its own
+      OpenFXHost::Initialize();
+
+      foreach (OpenFXPlugin* plugin, OpenFXHost::plugins()) {
+        Node* created_node = new OpenFXNode(plugin);
+
+        if (main_thread && created_node->thread() != main_thread) {
+          created_node->moveToThread(main_thread);
+        }
+
+        library_.append(created_node);
+      }
+#endif
+
+      library_ready_.store(true, std::memory_order_release);
+    }
+  }
+
+  return library_;
+}
+
 }
@@ -21,7 +21,9 @@
 #ifndef NODEFACTORY_H
 #define NODEFACTORY_H
 
+#include <atomic>
 #include <QList>
+#include <QMutex>
 
 #include "node.h"
 #include "widget/menu/menu.h"
@@ -59,6 +61,7 @@ public:
     kValueNode,
     kTimeRemapNode,
     kSubtitleBlock,
+    kMultiCamNode,
 
     // Count value
     kInternalNodeCount
@@ -80,11 +83,30 @@ public:
 
   static Node* CreateFromID(const QString& id);
 
+  /**
+   * @brief Returns the library's instance of the node with this ID without creating a new one
+   *
+   * Useful for querying properties of a node type (e.g. IsItem()). Returns nullptr if no node with
+   * this ID exists.
+   */
+  static const Node* GetLibraryNodeFromID(const QString& id);
+
   static Node* CreateFromFactoryIndex(const InternalID& id);
 
 private:
+  /**
+   * @brief Get a prototype of every node type, creating them on first use
+   *
+   * Thread-safe, since projects may be loaded in the background.
+   */
+  static const QList<Node*>& GetLibrary();
+
   static QList<Node*> library_;
 
+  static std::atomic_bool library_ready_;
+
+  static QMutex library_lock_;
+
 };
 
 }
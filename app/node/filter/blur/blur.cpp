@@ -20,6 +20,9 @@
 
 #include "blur.h"
 
+#include <cmath>
+#include <QtMath>
+
 namespace olive {
 
 const QString BlurFilterNode::kTextureInput = QStringLiteral("tex_in");
@@ -29,6 +32,9 @@ const QString BlurFilterNode::kHorizInput = QStringLiteral("horiz_in");
 const QString BlurFilterNode::kVertInput = QStringLiteral("vert_in");
 const QString BlurFilterNode::kRepeatEdgePixelsInput = QStringLiteral("repeat_edge_pixels_in");
 
+const double BlurFilterNode::kPyramidMinimumRadius = 8.0;
+const int BlurFilterNode::kPyramidMaximumLevels = 8;
+
 BlurFilterNode::BlurFilterNode()
 {
   AddInput(kTextureInput, NodeValue::kTexture, InputFlags(kInputFlagNotKeyframable));
@@ -83,7 +89,10 @@ void BlurFilterNode::Retranslate()
 
 ShaderCode BlurFilterNode::GetShaderCode(const QString &shader_id) const
 {
-  Q_UNUSED(shader_id)
+  if (shader_id == QStringLiteral("pyramid")) {
+    return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/blurpyramid.frag"));
+  }
+
   return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/blur.frag"));
 }
 
@@ -111,11 +120,47 @@ NodeValueTable BlurFilterNode::Value(const QString &output, NodeValueDatabase &v
     if ((job.GetValue(kHorizInput).data().toBool() || job.GetValue(kVertInput).data().toBool())
         && job.GetValue(kRadiusInput).data().toDouble() > 0.0) {
 
-      // Set iteration count to 2 if we're blurring both horizontally and vertically
-      if (job.GetValue(kHorizInput).data().toBool() && job.GetValue(kVertInput).data().toBool()) {
-        job.SetIterations(2, kTextureInput);
+      double sigma = qCeil(job.GetValue(kRadiusInput).data().toDouble());
+      RenderMode::Mode mode = static_cast<RenderMode::Mode>(value[QStringLiteral("global")].Get(NodeValue::kInt, QStringLiteral("render_mode")).toInt());
+
+      if (mode == RenderMode::kOffline
+          && job.GetValue(kMethodInput).data().toInt() == 1
+          && job.GetValue(kHorizInput).data().toBool() && job.GetValue(kVertInput).data().toBool()
+          && sigma >= kPyramidMinimumRadius) {
+        // The exact kernel's cost grows with the radius, so large previews downsample the image,
+        // blur the small version and scale it back up instead, which costs about the same at any
+        // radius. Each halving is picked so that the smallest level still has a couple of pixels
+        // of blur left to hide the upscale.
+        int levels = qMin(kPyramidMaximumLevels, qFloor(std::log2(sigma / 2.0)));
+
+        // Going down and back up blurs the image a little already, so subtract that
+        double pyramid_variance = (std::pow(4.0, levels) - 1.0) * (1.0 / 12.0 + 2.0 / 9.0);
+        double level_sigma = std::sqrt(qMax(1.0, sigma * sigma - pyramid_variance)) / std::pow(2.0, levels);
+
+        job.SetShaderID(QStringLiteral("pyramid"));
+        job.InsertValue(QStringLiteral("pyramid_levels"), NodeValue(NodeValue::kInt, levels, this));
+        job.InsertValue(QStringLiteral("level_sigma"), NodeValue(NodeValue::kFloat, level_sigma, this));
+        job.SetIterations(levels * 2 + 2, kTextureInput);
+
+        // Levels are read with plain linear filtering, mipmaps would only be wasted work
+        job.SetInterpolation(kTextureInput, Texture::kLinear);
+
+        // Levels are stored in a corner of the whole frame's texture
+        job.SetSamplingFootprint(ShaderJob::kFootprintWholeFrame);
+      } else {
+        if (job.GetValue(kHorizInput).data().toBool() && job.GetValue(kVertInput).data().toBool()) {
+          // Set iteration count to 2 if we're blurring both horizontally and vertically
+          job.SetIterations(2, kTextureInput);
+        }
+
+        // Gaussian kernels reach three standard deviations, and every sample reads two pixels
+        int reach = (job.GetValue(kMethodInput).data().toInt() == 1) ? int(sigma) * 3 : int(sigma);
+        job.SetSamplingFootprint(reach + 1);
       }
 
+      // Each pass accumulates many weighted samples, so don't lose precision between them
+      job.SetRequiresFullPrecision(true);
+
       // If we're not repeating pixels, expect an alpha channel to appear
       if (!job.GetValue(kRepeatEdgePixelsInput).data().toBool()) {
         job.SetAlphaChannelRequired(GenerateJob::kAlphaForceOn);
@@ -52,6 +52,14 @@ public:
   static const QString kVertInput;
   static const QString kRepeatEdgePixelsInput;
 
+private:
+  /**
+   * @brief Gaussian radius from which previews use the downsampling pyramid instead of the exact kernel
+   */
+  static const double kPyramidMinimumRadius;
+
+  static const int kPyramidMaximumLevels;
+
 };
 
 }
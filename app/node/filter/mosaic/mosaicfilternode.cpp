@@ -20,6 +20,8 @@
 
 #include "mosaicfilternode.h"
 
+#include <QtMath>
+
 namespace olive {
 
 const QString MosaicFilterNode::kTextureInput = QStringLiteral("tex_in");
@@ -65,6 +67,13 @@ NodeValueTable MosaicFilterNode::Value(const QString &output, NodeValueDatabase
     if (texture
         && job.GetValue(kHorizInput).data().toInt() != texture->width()
         && job.GetValue(kVertInput).data().toInt() != texture->height()) {
+      // Every pixel reads the corner of its cell, which can be up to a cell away
+      int horiz = job.GetValue(kHorizInput).data().toInt();
+      int vert = job.GetValue(kVertInput).data().toInt();
+      int cell = qMax(horiz > 0 ? qCeil(double(texture->width()) / horiz) : 0,
+                      vert > 0 ? qCeil(double(texture->height()) / vert) : 0);
+      job.SetSamplingFootprint(cell + 1);
+
       table.Push(NodeValue::kShaderJob, QVariant::fromValue(job), this);
     } else {
       table.Push(job.GetValue(kTextureInput));
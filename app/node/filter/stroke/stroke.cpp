@@ -20,6 +20,9 @@
 
 #include "stroke.h"
 
+#include <cmath>
+#include <QtMath>
+
 #include "render/color.h"
 #include "widget/slider/floatslider.h"
 
@@ -31,6 +34,8 @@ const QString StrokeFilterNode::kRadiusInput = QStringLiteral("radius_in");
 const QString StrokeFilterNode::kOpacityInput = QStringLiteral("opacity_in");
 const QString StrokeFilterNode::kInnerInput = QStringLiteral("inner_in");
 
+const double StrokeFilterNode::kDistanceFieldMinimumRadius = 4.0;
+
 StrokeFilterNode::StrokeFilterNode()
 {
   AddInput(kTextureInput, NodeValue::kTexture, InputFlags(kInputFlagNotKeyframable));
@@ -101,6 +106,32 @@ NodeValueTable StrokeFilterNode::Value(const QString &output, NodeValueDatabase
   if (!job.GetValue(kTextureInput).data().isNull()) {
     if (job.GetValue(kRadiusInput).data().toDouble() > 0.0
         && job.GetValue(kOpacityInput).data().toDouble() > 0.0) {
+      double radius = job.GetValue(kRadiusInput).data().toDouble();
+
+      if (radius > kDistanceFieldMinimumRadius) {
+        // The exact shader's cost grows with the square of the radius, so wide strokes find the
+        // nearest opaque pixel by jump flooding instead. Jumps of 2^n-1 down to 1 pixel reach any
+        // pixel within 2^n-1 pixels, so this costs log2(radius) passes of 9 taps each.
+        int steps = qCeil(std::log2(radius + 1.0));
+
+        job.SetShaderID(QStringLiteral("distance"));
+        job.InsertValue(QStringLiteral("jump_steps"), NodeValue(NodeValue::kInt, steps, this));
+
+        // Every iteration but the last replaces the texture with offsets, so keep the original
+        job.InsertValue(QStringLiteral("src_in"), job.GetValue(kTextureInput));
+        job.SetIterations(steps + 3, kTextureInput);
+
+        // Offsets must be read exactly and stored in more than 8 bits
+        job.SetInterpolation(kTextureInput, Texture::kNearest);
+        job.SetRequiresFullPrecision(true);
+        job.SetAlphaChannelRequired(GenerateJob::kAlphaForceOn);
+
+        // Offsets can be carried as far as all the jumps together
+        job.SetSamplingFootprint((1 << steps) + 1);
+      } else {
+        job.SetSamplingFootprint(qCeil(radius) + 1);
+      }
+
       table.Push(NodeValue::kShaderJob, QVariant::fromValue(job), this);
     } else {
       table.Push(job.GetValue(kTextureInput));
@@ -112,7 +143,9 @@ NodeValueTable StrokeFilterNode::Value(const QString &output, NodeValueDatabase
 
 ShaderCode StrokeFilterNode::GetShaderCode(const QString &shader_id) const
 {
-  Q_UNUSED(shader_id)
+  if (shader_id == QStringLiteral("distance")) {
+    return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/strokedistance.frag"));
+  }
 
   return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/stroke.frag"));
 }
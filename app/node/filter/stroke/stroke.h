@@ -51,6 +51,12 @@ public:
   static const QString kOpacityInput;
   static const QString kInnerInput;
 
+private:
+  /**
+   * @brief Radius above which the stroke is drawn from a distance field instead of sampling the whole disc
+   */
+  static const double kDistanceFieldMinimumRadius;
+
 };
 
 }
@@ -21,6 +21,8 @@
 #include "polygon.h"
 
 #include <QGuiApplication>
+#include <QPainter>
+#include <QPainterPath>
 #include <QVector2D>
 
 namespace olive {
@@ -79,29 +81,53 @@ void PolygonGenerator::Retranslate()
   SetInputName(kColorInput, tr("Color"));
 }
 
-ShaderCode PolygonGenerator::GetShaderCode(const QString &shader_id) const
-{
-  Q_UNUSED(shader_id)
-
-  return ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/polygon.frag")));
-}
-
 NodeValueTable PolygonGenerator::Value(const QString &output, NodeValueDatabase &value) const
 {
   Q_UNUSED(output)
 
-  ShaderJob job;
+  GenerateJob job;
 
   job.InsertValue(this, kPointsInput, value);
   job.InsertValue(this, kColorInput, value);
-  job.InsertValue(QStringLiteral("resolution_in"), value[QStringLiteral("global")].GetWithMeta(NodeValue::kVec2, QStringLiteral("resolution")));
   job.SetAlphaChannelRequired(GenerateJob::kAlphaForceOn);
 
   NodeValueTable table = value.Merge();
-  table.Push(NodeValue::kShaderJob, QVariant::fromValue(job), this);
+  table.Push(NodeValue::kGenerateJob, QVariant::fromValue(job), this);
   return table;
 }
 
+void PolygonGenerator::GenerateFrame(FramePtr frame, const GenerateJob &job) const
+{
+  // Rasterizing the outline only touches the pixels inside the polygon's bounds, and unlike
+  // testing every pixel against every point, it works for any amount of points
+  QVector<NodeValueTable> array_tbl = job.GetValue(kPointsInput).data().value< QVector<NodeValueTable> >();
+
+  QPolygonF polygon(array_tbl.size());
+  for (int i=0; i<array_tbl.size(); i++) {
+    polygon[i] = array_tbl.at(i).Get(NodeValue::kVec2).value<QVector2D>().toPointF() / frame->video_params().divider();
+  }
+
+  QPainterPath path;
+  path.setFillRule(Qt::OddEvenFill);
+  path.addPolygon(polygon);
+
+  QRect bounds = path.boundingRect().toAlignedRect().adjusted(-1, -1, 1, 1) & QRect(0, 0, frame->width(), frame->height());
+
+  QImage coverage;
+
+  if (polygon.size() > 2 && !bounds.isEmpty()) {
+    coverage = QImage(bounds.size(), QImage::Format_Grayscale8);
+    coverage.fill(0);
+
+    QPainter p(&coverage);
+    p.setRenderHint(QPainter::Antialiasing);
+    p.translate(-bounds.topLeft());
+    p.fillPath(path, Qt::white);
+  }
+
+  frame->fill_coverage(coverage, bounds.topLeft(), job.GetValue(kColorInput).data().value<Color>());
+}
+
 bool PolygonGenerator::HasGizmos() const
 {
   return true;
@@ -43,9 +43,10 @@ public:
 
   virtual void Retranslate() override;
 
-  virtual ShaderCode GetShaderCode(const QString& shader_id) const override;
   virtual NodeValueTable Value(const QString& output, NodeValueDatabase &value) const override;
 
+  virtual void GenerateFrame(FramePtr frame, const GenerateJob &job) const override;
+
   virtual bool HasGizmos() const override;
   //virtual void DrawGizmos(NodeValueDatabase& db, QPainter *p) const override;
 
@@ -68,6 +68,7 @@ NodeValueTable SolidGenerator::Value(const QString &output, NodeValueDatabase &v
 
   ShaderJob job;
   job.InsertValue(this, kColorInput, value);
+  job.SetConstantColor(job.GetValue(kColorInput).data().value<Color>());
 
   NodeValueTable table = value.Merge();
   table.Push(NodeValue::kShaderJob, QVariant::fromValue(job), this);
@@ -21,7 +21,9 @@
 #include "text.h"
 
 #include <QAbstractTextDocumentLayout>
+#include <QPainter>
 #include <QTextDocument>
+#include <QtMath>
 
 namespace olive {
 
@@ -38,6 +40,13 @@ const QString TextGenerator::kVAlignInput = QStringLiteral("valign_in");
 const QString TextGenerator::kFontInput = QStringLiteral("font_in");
 const QString TextGenerator::kFontSizeInput = QStringLiteral("font_size_in");
 
+// Measured in bytes of 8-bit coverage
+const int TextGenerator::kMaximumMaskCacheSize = 64 * 1024 * 1024;
+
+QMutex TextGenerator::mask_cache_lock_;
+
+QCache<QString, TextGenerator::TextMask> TextGenerator::mask_cache_(TextGenerator::kMaximumMaskCacheSize);
+
 TextGenerator::TextGenerator()
 {
   AddInput(kTextInput, NodeValue::kText, tr("Sample Text"));
@@ -113,13 +122,47 @@ NodeValueTable TextGenerator::Value(const QString &output, NodeValueDatabase &va
 
 void TextGenerator::GenerateFrame(FramePtr frame, const GenerateJob& job) const
 {
-  // This could probably be more optimized, but for now we use Qt to draw to a QImage.
-  // QImages only support integer pixels and we use float pixels, so what we do here is draw onto
-  // a single-channel QImage (alpha only) and then transplant that alpha channel to our float buffer
-  // with correct float RGB.
-  QImage img(frame->width(), frame->height(), QImage::Format_Grayscale8);
-  img.fill(0);
+  // Qt draws the text as 8-bit coverage, which we then transplant into our float buffer with the
+  // correct float RGB. Only the area the text covers is drawn or transplanted, everything else is
+  // left transparent.
+  TextMask mask = GetMask(job, frame->video_params(), frame->width(), frame->height());
+
+  frame->fill_coverage(mask.image, mask.offset, job.GetValue(kColorInput).data().value<Color>());
+}
+
+TextGenerator::TextMask TextGenerator::GetMask(const GenerateJob &job, const VideoParams &params, int width, int height)
+{
+  QString key = QStringLiteral("%1:%2:%3:%4:%5:%6:%7:%8:%9").arg(QString::number(width),
+                                                                  QString::number(height),
+                                                                  QString::number(params.width()),
+                                                                  QString::number(params.height()),
+                                                                  QString::number(params.divider()),
+                                                                  job.GetValue(kFontInput).data().toString(),
+                                                                  QString::number(job.GetValue(kFontSizeInput).data().toFloat()),
+                                                                  QString::number(job.GetValue(kVAlignInput).data().toInt()),
+                                                                  QString::number(job.GetValue(kHtmlInput).data().toBool()));
+  key.append(QLatin1Char('\n'));
+  key.append(job.GetValue(kTextInput).data().toString());
+
+  {
+    QMutexLocker locker(&mask_cache_lock_);
+
+    if (TextMask* cached = mask_cache_.object(key)) {
+      return *cached;
+    }
+  }
+
+  TextMask* mask = new TextMask(RasterizeMask(job, params, width, height));
+  TextMask copy = *mask;
+
+  QMutexLocker locker(&mask_cache_lock_);
+  mask_cache_.insert(key, mask, qMax(1, mask->image.bytesPerLine() * mask->image.height()));
+
+  return copy;
+}
 
+TextGenerator::TextMask TextGenerator::RasterizeMask(const GenerateJob &job, const VideoParams &params, int width, int height)
+{
   QTextDocument text_doc;
 
   // Set default font
@@ -140,15 +183,14 @@ void TextGenerator::GenerateFrame(FramePtr frame, const GenerateJob& job) const
   }
 
   // Align to 80% width because that's considered the "title safe" area
-  int tenth_of_width = frame->video_params().width() / 10;
+  int tenth_of_width = params.width() / 10;
   text_doc.setTextWidth(tenth_of_width * 8);
 
-  // Draw rich text onto image
-  QPainter p(&img);
-  p.scale(1.0 / frame->video_params().divider(), 1.0 / frame->video_params().divider());
+  QTransform transform;
+  transform.scale(1.0 / params.divider(), 1.0 / params.divider());
 
   // Push 10% inwards to compensate for title safe area
-  p.translate(tenth_of_width, 0);
+  transform.translate(tenth_of_width, 0);
 
   TextVerticalAlign valign = static_cast<TextVerticalAlign>(job.GetValue(kVAlignInput).data().toInt());
   int doc_height = text_doc.size().height();
@@ -156,32 +198,45 @@ void TextGenerator::GenerateFrame(FramePtr frame, const GenerateJob& job) const
   switch (valign) {
   case kVerticalAlignTop:
     // Push 10% inwards for title safe area
-    p.translate(0, frame->video_params().height() / 10);
+    transform.translate(0, params.height() / 10);
     break;
   case kVerticalAlignCenter:
     // Center align
-    p.translate(0, frame->video_params().height() / 2 - doc_height / 2);
+    transform.translate(0, params.height() / 2 - doc_height / 2);
     break;
   case kVerticalAlignBottom:
     // Push 10% inwards for title safe area
-    p.translate(0, frame->video_params().height() - doc_height - frame->video_params().height() / 10);
+    transform.translate(0, params.height() - doc_height - params.height() / 10);
     break;
   }
 
+  // Only draw the area the document covers, padded for glyphs that overhang their line (italics
+  // for example)
+  QRect bounds = transform.mapRect(QRectF(QPointF(0, 0), text_doc.size())).toAlignedRect();
+  int overhang = qCeil(job.GetValue(kFontSizeInput).data().toFloat() / params.divider());
+  bounds.adjust(-overhang, -overhang, overhang, overhang);
+  bounds &= QRect(0, 0, width, height);
+
+  TextMask mask;
+
+  if (bounds.isEmpty()) {
+    return mask;
+  }
+
+  mask.offset = bounds.topLeft();
+  mask.image = QImage(bounds.size(), QImage::Format_Grayscale8);
+  mask.image.fill(0);
+
+  // Draw rich text onto image
+  QPainter p(&mask.image);
+  p.translate(-bounds.topLeft());
+  p.setTransform(transform, true);
+
   QAbstractTextDocumentLayout::PaintContext ctx;
   ctx.palette.setColor(QPalette::Text, Qt::white);
   text_doc.documentLayout()->draw(&p, ctx);
 
-  // Transplant alpha channel to frame
-  Color rgb = job.GetValue(kColorInput).data().value<Color>();
-  for (int x=0; x<frame->width(); x++) {
-    for (int y=0; y<frame->height(); y++) {
-      uchar src_alpha = img.bits()[img.bytesPerLine() * y + x];
-      float alpha = float(src_alpha) / 255.0f;
-
-      frame->set_pixel(x, y, Color(rgb.red() * alpha, rgb.green() * alpha, rgb.blue() * alpha, alpha));
-    }
-  }
+  return mask;
 }
 
 }
@@ -21,6 +21,9 @@
 #ifndef TEXTGENERATOR_H
 #define TEXTGENERATOR_H
 
+#include <QCache>
+#include <QMutex>
+
 #include "node/node.h"
 
 namespace olive {
@@ -53,6 +56,31 @@ public:
   static const QString kFontInput;
   static const QString kFontSizeInput;
 
+private:
+  /**
+   * @brief Coverage of laid out text, covering only the area the text was drawn into
+   */
+  struct TextMask {
+    QImage image;
+    QPoint offset;
+  };
+
+  /**
+   * @brief Returns the coverage mask for this job and frame, rasterizing it only if not cached
+   *
+   * Masks don't depend on the text color, so static text is only laid out and drawn once however
+   * its color is animated.
+   */
+  static TextMask GetMask(const GenerateJob &job, const VideoParams &params, int width, int height);
+
+  static TextMask RasterizeMask(const GenerateJob &job, const VideoParams &params, int width, int height);
+
+  static const int kMaximumMaskCacheSize;
+
+  static QMutex mask_cache_lock_;
+
+  static QCache<QString, TextMask> mask_cache_;
+
 };
 
 }
@@ -26,7 +26,8 @@ namespace olive {
 
 #define super QObject
 
-NodeGraph::NodeGraph()
+NodeGraph::NodeGraph() :
+  batch_depth_(0)
 {
 }
 
@@ -44,6 +45,71 @@ void NodeGraph::Clear()
   }
 }
 
+void NodeGraph::BeginBatch()
+{
+  batch_depth_++;
+}
+
+void NodeGraph::EndBatch()
+{
+  Q_ASSERT(batch_depth_ > 0);
+
+  batch_depth_--;
+
+  if (batch_depth_ > 0) {
+    return;
+  }
+
+  NodeGraphChangeSet changes;
+
+  foreach (const NodeInput& input, batch_inputs_) {
+    const QPair<NodeOutput, NodeOutput>& c = batch_input_connections_.value(input);
+
+    if (!(c.first == c.second)) {
+      if (c.first.IsValid()) {
+        changes.disconnected.append({c.first, input});
+      }
+
+      if (c.second.IsValid()) {
+        changes.connected.append({c.second, input});
+      }
+    }
+  }
+
+  QSet<Node*> gone;
+  foreach (Node* node, batch_nodes_) {
+    const QPair<bool, bool>& p = batch_node_presence_.value(node);
+
+    if (p.first && !p.second) {
+      changes.removed.append(node);
+    } else if (!p.first && p.second) {
+      changes.added.append(node);
+    }
+
+    if (!p.second) {
+      gone.insert(node);
+    }
+  }
+
+  foreach (const NodeInput& input, batch_values_) {
+    // Values of nodes that have left the graph no longer matter to anyone listening
+    if (!gone.contains(input.node())) {
+      changes.values.append(input);
+    }
+  }
+
+  batch_nodes_.clear();
+  batch_node_presence_.clear();
+  batch_inputs_.clear();
+  batch_input_connections_.clear();
+  batch_values_.clear();
+  batch_value_set_.clear();
+
+  if (!changes.isEmpty()) {
+    emit BatchCommitted(changes);
+  }
+}
+
 void NodeGraph::childEvent(QChildEvent *event)
 {
   super::childEvent(event);
@@ -55,12 +121,18 @@ void NodeGraph::childEvent(QChildEvent *event)
 
       node_children_.append(node);
 
-      // Connect signals
-      connect(node, &Node::InputConnected, this, &NodeGraph::InputConnected);
-      connect(node, &Node::InputDisconnected, this, &NodeGraph::InputDisconnected);
-      connect(node, &Node::ValueChanged, this, &NodeGraph::ValueChanged);
+      node->ShareInputSchemas();
 
-      emit NodeAdded(node);
+      // Connect signals
+      connect(node, &Node::InputConnected, this, &NodeGraph::NodeInputConnected);
+      connect(node, &Node::InputDisconnected, this, &NodeGraph::NodeInputDisconnected);
+      connect(node, &Node::ValueChanged, this, &NodeGraph::NodeValueChanged);
+
+      if (IsBatching()) {
+        BatchNodeChanged(node, true);
+      } else {
+        emit NodeAdded(node);
+      }
       emit node->AddedToGraph(this);
 
     } else if (event->type() == QEvent::ChildRemoved) {
@@ -68,15 +140,75 @@ void NodeGraph::childEvent(QChildEvent *event)
       node_children_.removeOne(node);
 
       // Disconnect signals
-      disconnect(node, &Node::InputConnected, this, &NodeGraph::InputConnected);
-      disconnect(node, &Node::InputDisconnected, this, &NodeGraph::InputDisconnected);
-      disconnect(node, &Node::ValueChanged, this, &NodeGraph::ValueChanged);
-
-      emit NodeRemoved(node);
+      disconnect(node, &Node::InputConnected, this, &NodeGraph::NodeInputConnected);
+      disconnect(node, &Node::InputDisconnected, this, &NodeGraph::NodeInputDisconnected);
+      disconnect(node, &Node::ValueChanged, this, &NodeGraph::NodeValueChanged);
+
+      if (IsBatching()) {
+        BatchNodeChanged(node, false);
+      } else {
+        emit NodeRemoved(node);
+      }
       emit node->RemovedFromGraph(this);
 
     }
   }
 }
 
+void NodeGraph::BatchNodeChanged(Node *node, bool added)
+{
+  auto it = batch_node_presence_.find(node);
+
+  if (it == batch_node_presence_.end()) {
+    batch_nodes_.append(node);
+    batch_node_presence_.insert(node, {!added, added});
+  } else {
+    it->second = added;
+  }
+}
+
+void NodeGraph::BatchEdgeChanged(const NodeOutput &output, const NodeInput &input, bool connected)
+{
+  NodeOutput now = connected ? output : NodeOutput();
+
+  auto it = batch_input_connections_.find(input);
+
+  if (it == batch_input_connections_.end()) {
+    batch_inputs_.append(input);
+    batch_input_connections_.insert(input, {connected ? NodeOutput() : output, now});
+  } else {
+    it->second = now;
+  }
+}
+
+void NodeGraph::NodeInputConnected(const NodeOutput &output, const NodeInput &input)
+{
+  if (IsBatching()) {
+    BatchEdgeChanged(output, input, true);
+  } else {
+    emit InputConnected(output, input);
+  }
+}
+
+void NodeGraph::NodeInputDisconnected(const NodeOutput &output, const NodeInput &input)
+{
+  if (IsBatching()) {
+    BatchEdgeChanged(output, input, false);
+  } else {
+    emit InputDisconnected(output, input);
+  }
+}
+
+void NodeGraph::NodeValueChanged(const NodeInput &input)
+{
+  if (IsBatching()) {
+    if (!batch_value_set_.contains(input)) {
+      batch_value_set_.insert(input);
+      batch_values_.append(input);
+    }
+  } else {
+    emit ValueChanged(input);
+  }
+}
+
 }
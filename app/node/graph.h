@@ -25,6 +25,35 @@
 
 namespace olive {
 
+/**
+ * @brief The net result of every change made to a NodeGraph during a batch
+ *
+ * Changes that cancel each other out (e.g. a node added and removed again) are left out. Listeners
+ * should apply them in the order they're declared here: disconnections, removals, additions and
+ * then connections.
+ */
+class NodeGraphChangeSet
+{
+public:
+  typedef QPair<NodeOutput, NodeInput> Edge;
+
+  QVector<Edge> disconnected;
+
+  QVector<Node*> removed;
+
+  QVector<Node*> added;
+
+  QVector<Edge> connected;
+
+  QVector<NodeInput> values;
+
+  bool isEmpty() const
+  {
+    return disconnected.isEmpty() && removed.isEmpty() && added.isEmpty() && connected.isEmpty() && values.isEmpty();
+  }
+
+};
+
 /**
  * @brief A collection of nodes
  *
@@ -63,6 +92,23 @@ public:
     return default_nodes_;
   }
 
+  /**
+   * @brief Start collecting changes to emit them all at once from EndBatch()
+   *
+   * While a batch is open, NodeAdded(), NodeRemoved(), InputConnected(), InputDisconnected() and
+   * ValueChanged() aren't emitted. Instead, EndBatch() emits their net result as one BatchCommitted()
+   * so listeners can update once rather than once per change. Batches can be nested, only the
+   * outermost EndBatch() emits. Nodes must not be destroyed while a batch is open.
+   */
+  void BeginBatch();
+
+  void EndBatch();
+
+  bool IsBatching() const
+  {
+    return batch_depth_ > 0;
+  }
+
 signals:
   /**
    * @brief Signal emitted when a Node is added to the graph
@@ -80,6 +126,11 @@ signals:
 
   void ValueChanged(const NodeInput& input);
 
+  /**
+   * @brief Emitted by EndBatch() with every change made during the batch
+   */
+  void BatchCommitted(const NodeGraphChangeSet& changes);
+
 protected:
   void AddDefaultNode(Node* n)
   {
@@ -89,10 +140,34 @@ protected:
   virtual void childEvent(QChildEvent* event) override;
 
 private:
+  void BatchNodeChanged(Node* node, bool added);
+
+  void BatchEdgeChanged(const NodeOutput& output, const NodeInput& input, bool connected);
+
   QVector<Node*> node_children_;
 
   QVector<Node*> default_nodes_;
 
+  int batch_depth_;
+
+  // Whether each node changed during the batch was in the graph before and after, in order of first change
+  QVector<Node*> batch_nodes_;
+  QHash<Node*, QPair<bool, bool> > batch_node_presence_;
+
+  // What each input changed during the batch was connected to before and after, in order of first change
+  QVector<NodeInput> batch_inputs_;
+  QHash<NodeInput, QPair<NodeOutput, NodeOutput> > batch_input_connections_;
+
+  QVector<NodeInput> batch_values_;
+  QSet<NodeInput> batch_value_set_;
+
+private slots:
+  void NodeInputConnected(const NodeOutput& output, const NodeInput& input);
+
+  void NodeInputDisconnected(const NodeOutput& output, const NodeInput& input);
+
+  void NodeValueChanged(const NodeInput& input);
+
 };
 
 }
@@ -1,6 +1,133 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
 #include "multicamnode.h"
 
+#include <QtMath>
+
+namespace olive {
+
+const QString MultiCamNode::kCurrentInput = QStringLiteral("current_in");
+const QString MultiCamNode::kSourcesInput = QStringLiteral("sources_in");
+
+const QString MultiCamNode::kMultiviewOutput = QStringLiteral("multiview");
+
+const int MultiCamNode::kMaximumMultiviewAngles = 16;
+
+#define super Node
+
 MultiCamNode::MultiCamNode()
 {
+  AddInput(kCurrentInput, NodeValue::kInt, 0);
+
+  AddInput(kSourcesInput, NodeValue::kTexture, InputFlags(kInputFlagArray | kInputFlagNotKeyframable));
+
+  AddOutput(kMultiviewOutput);
+}
+
+Node *MultiCamNode::copy() const
+{
+  return new MultiCamNode();
+}
+
+QString MultiCamNode::Name() const
+{
+  return tr("Multi-Cam");
+}
+
+QString MultiCamNode::id() const
+{
+  return QStringLiteral("org.olivevideoeditor.Olive.multicam");
+}
+
+QVector<Node::CategoryID> MultiCamNode::Category() const
+{
+  return {kCategoryInput};
+}
+
+QString MultiCamNode::Description() const
+{
+  return tr("Switch between multiple camera angles.");
+}
+
+void MultiCamNode::Retranslate()
+{
+  SetInputName(kCurrentInput, tr("Current"));
+  SetInputName(kSourcesInput, tr("Sources"));
+}
+
+bool MultiCamNode::IsInputElementUsed(const QString &output, const QString &input, int element, const rational &time) const
+{
+  if (output == kDefaultOutput && input == kSourcesInput && !IsInputConnected(kCurrentInput)) {
+    // Only the current angle is rendered, every other angle is only needed by the multiview
+    return element == GetValueAtTime(kCurrentInput, time).toInt();
+  }
+
+  return super::IsInputElementUsed(output, input, element, time);
+}
+
+NodeValueTable MultiCamNode::Value(const QString &output, NodeValueDatabase &value) const
+{
+  int current = value[kCurrentInput].Get(NodeValue::kInt).toInt();
+  QVector<NodeValueTable> sources = value[kSourcesInput].Get(NodeValue::kTexture).value< QVector<NodeValueTable> >();
+
+  NodeValueTable table = value.Merge();
+
+  if (output == kMultiviewOutput) {
+    int count = qMin(sources.size(), kMaximumMultiviewAngles);
+
+    if (count > 0) {
+      ShaderJob job;
+
+      for (int i=0; i<count; i++) {
+        QString angle = QStringLiteral("angle_%1").arg(i);
+
+        // Sources are shrunk into their tile and are mostly unchanged between frames, so their
+        // mipmaps are worth building
+        job.InsertValue(angle, sources.at(i).GetWithMeta(NodeValue::kTexture));
+        job.SetInterpolation(angle, Texture::kMipmappedLinear);
+      }
+
+      job.InsertValue(QStringLiteral("angle_count"), NodeValue(NodeValue::kInt, count, this));
+      job.InsertValue(QStringLiteral("grid_size"), NodeValue(NodeValue::kInt, qCeil(qSqrt(count)), this));
+      job.InsertValue(QStringLiteral("current_in"), NodeValue(NodeValue::kInt, current, this));
+      job.InsertValue(QStringLiteral("resolution_in"), value[QStringLiteral("global")].GetWithMeta(NodeValue::kVec2, QStringLiteral("resolution")));
+      job.SetAlphaChannelRequired(GenerateJob::kAlphaForceOn);
+
+      // Every tile of the grid shows a whole source
+      job.SetSamplingFootprint(ShaderJob::kFootprintWholeFrame);
+
+      table.Push(NodeValue::kShaderJob, QVariant::fromValue(job), this);
+    }
+  } else if (current >= 0 && current < sources.size()) {
+    table.Push(sources.at(current).GetWithMeta(NodeValue::kTexture));
+  }
+
+  return table;
+}
+
+ShaderCode MultiCamNode::GetShaderCode(const QString &shader_id) const
+{
+  Q_UNUSED(shader_id)
+
+  return ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/multicam.frag")));
+}
 
 }
@@ -1,11 +1,71 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
 #ifndef MULTICAMNODE_H
 #define MULTICAMNODE_H
 
+#include "node/node.h"
+
+namespace olive {
 
-class MultiCamNode
+/**
+ * @brief Switches between several camera angles of the same scene
+ *
+ * The default output only renders the current angle. The multiview output tiles every angle into
+ * a grid with the current one outlined, for choosing between them while cutting.
+ */
+class MultiCamNode : public Node
 {
+  Q_OBJECT
 public:
   MultiCamNode();
+
+  NODE_DEFAULT_DESTRUCTOR(MultiCamNode)
+
+  virtual Node* copy() const override;
+
+  virtual QString Name() const override;
+  virtual QString id() const override;
+  virtual QVector<CategoryID> Category() const override;
+  virtual QString Description() const override;
+
+  virtual void Retranslate() override;
+
+  virtual bool IsInputElementUsed(const QString& output, const QString& input, int element, const rational& time) const override;
+
+  virtual NodeValueTable Value(const QString& output, NodeValueDatabase& value) const override;
+
+  virtual ShaderCode GetShaderCode(const QString& shader_id) const override;
+
+  static const QString kCurrentInput;
+  static const QString kSourcesInput;
+
+  static const QString kMultiviewOutput;
+
+  /**
+   * @brief Most angles the multiview grid can show, limited by how many textures a shader can bind
+   */
+  static const int kMaximumMultiviewAngles;
+
 };
 
+}
+
 #endif // MULTICAMNODE_H
@@ -66,12 +66,21 @@ NodeValueTable TimeInput::Value(const QString &output, NodeValueDatabase &value)
   return table;
 }
 
-void TimeInput::Hash(const QString &output, QCryptographicHash &hash, const rational &time, const VideoParams &video_params) const
+void TimeInput::Hash(const QString &output, Hasher &hash, const rational &time, const VideoParams &video_params) const
 {
   Node::Hash(output, hash, time, video_params);
 
   // Make sure time is hashed
-  hash.addData(NodeValue::ValueToBytes(NodeValue::kRational, QVariant::fromValue(time)));
+  hash.add(time);
+}
+
+QVector<TimeRange> TimeInput::GetConstantRanges(const QString &output, const TimeRange &range) const
+{
+  Q_UNUSED(output)
+  Q_UNUSED(range)
+
+  // Outputs the time itself, which is never constant
+  return QVector<TimeRange>();
 }
 
 }
@@ -42,7 +42,9 @@ public:
 
   virtual NodeValueTable Value(const QString& output, NodeValueDatabase& value) const override;
 
-  virtual void Hash(const QString& output, QCryptographicHash& hash, const rational& time, const VideoParams& video_params) const override;
+  virtual void Hash(const QString& output, Hasher& hash, const rational& time, const VideoParams& video_params) const override;
+
+  virtual QVector<TimeRange> GetConstantRanges(const QString& output, const TimeRange& range) const override;
 
 };
 
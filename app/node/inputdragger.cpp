@@ -26,6 +26,8 @@
 
 namespace olive {
 
+int NodeInputDragger::input_being_dragged_ = 0;
+
 NodeInputDragger::NodeInputDragger()
 {
 
@@ -44,6 +46,8 @@ void NodeInputDragger::Start(const NodeKeyframeTrackReference &input, const rati
   input_ = input;
   time_ = time;
 
+  input_being_dragged_++;
+
   Node* node = input_.input().node();
 
   // Cache current value
@@ -142,6 +146,8 @@ void NodeInputDragger::End()
 
   input_.Reset();
   created_keys_.clear();
+
+  input_being_dragged_--;
 }
 
 }
@@ -40,6 +40,16 @@ public:
 
   void End();
 
+  /**
+   * @brief Whether the user is currently dragging any input's value
+   *
+   * Renderers use this to favor keeping up with the latest value over finishing every one.
+   */
+  static bool IsInputBeingDragged()
+  {
+    return input_being_dragged_ > 0;
+  }
+
 private:
   NodeKeyframeTrackReference input_;
 
@@ -52,6 +62,8 @@ private:
   NodeKeyframe* dragging_key_;
   QVector<NodeKeyframe*> created_keys_;
 
+  static int input_being_dragged_;
+
 };
 
 }
@@ -20,6 +20,8 @@
 
 #include "inputimmediate.h"
 
+#include <algorithm>
+
 #include "common/bezier.h"
 #include "common/lerp.h"
 #include "common/tohex.h"
@@ -182,6 +184,10 @@ void NodeInputImmediate::set_data_type(NodeValue::Type type)
   keyframe_tracks_.resize(track_size);
   standard_value_.resize(track_size);
 
+  type_ = type;
+  curves_.resize(track_size);
+  curve_dirty_.fill(1, track_size);
+
   set_split_standard_value(default_value_);
 }
 
@@ -225,21 +231,22 @@ void NodeInputImmediate::insert_keyframe(NodeKeyframe* key)
 {
   NodeKeyframeTrack& key_track = keyframe_tracks_[key->track()];
 
-  int insert_index = key_track.size();
-
-  for (int i=0;i<key_track.size();i++) {
-    NodeKeyframe* compare = key_track.at(i);
-
-    // Ensure we aren't trying to insert two keyframes at the same time
-    Q_ASSERT(compare->time() != key->time());
+  int insert_index;
 
-    if (compare->time() > key->time()) {
-      insert_index = i;
-      break;
-    }
+  if (key_track.isEmpty() || key_track.last()->time() < key->time()) {
+    // Imports generally add keyframes in order, so check the end first
+    insert_index = key_track.size();
+  } else {
+    insert_index = std::upper_bound(key_track.cbegin(), key_track.cend(), key->time(), [](const rational& t, const NodeKeyframe* k){
+      return t < k->time();
+    }) - key_track.cbegin();
   }
 
+  // Ensure we aren't trying to insert two keyframes at the same time
+  Q_ASSERT(insert_index == 0 || key_track.at(insert_index-1)->time() != key->time());
+
   key_track.insert(insert_index, key);
+  invalidate_keyframe_curve(key->track());
 
   NodeKeyframe* previous = insert_index > 0 ? key_track.at(insert_index-1) : nullptr;
   NodeKeyframe* next = insert_index < key_track.size()-1 ? key_track.at(insert_index+1) : nullptr;
@@ -270,6 +277,22 @@ void NodeInputImmediate::remove_keyframe(NodeKeyframe *key)
   key->set_next(nullptr);
 
   keyframe_tracks_[key->track()].removeOne(key);
+  invalidate_keyframe_curve(key->track());
+}
+
+const NodeKeyframeCurve &NodeInputImmediate::keyframe_curve(int track) const
+{
+  if (curve_dirty_.at(track).loadAcquire()) {
+    QMutexLocker locker(&curve_lock_);
+
+    // Another thread may have rebuilt it while we were waiting
+    if (curve_dirty_.at(track).loadAcquire()) {
+      curves_[track].Build(keyframe_tracks_.at(track), type_);
+      curve_dirty_[track].storeRelease(0);
+    }
+  }
+
+  return curves_.at(track);
 }
 
 void NodeInputImmediate::delete_all_keyframes(QObject* parent)
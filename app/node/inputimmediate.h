@@ -21,9 +21,12 @@
 #ifndef NODEINPUTIMMEDIATE_H
 #define NODEINPUTIMMEDIATE_H
 
+#include <QMutex>
+
 #include "common/timerange.h"
 #include "common/xmlutils.h"
 #include "node/keyframe.h"
+#include "node/keyframecurve.h"
 #include "node/value.h"
 #include "splitvalue.h"
 
@@ -153,6 +156,22 @@ public:
 
   void set_data_type(NodeValue::Type type);
 
+  /**
+   * @brief Get the compact evaluation copy of a keyframe track, rebuilding it if it's out of date
+   *
+   * Only meaningful for types where NodeValue::type_can_be_interpolated() is true. Safe to call
+   * from several render threads at once.
+   */
+  const NodeKeyframeCurve& keyframe_curve(int track) const;
+
+  /**
+   * @brief Mark the evaluation copy of a track out of date after one of its keyframes changed
+   */
+  void invalidate_keyframe_curve(int track)
+  {
+    curve_dirty_[track].storeRelease(1);
+  }
+
 private:
   /**
    * @brief Non-keyframed value
@@ -176,6 +195,14 @@ private:
    */
   bool keyframing_;
 
+  NodeValue::Type type_;
+
+  mutable QVector<NodeKeyframeCurve> curves_;
+
+  mutable QVector<QAtomicInt> curve_dirty_;
+
+  mutable QMutex curve_lock_;
+
 };
 
 }
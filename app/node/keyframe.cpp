@@ -71,8 +71,9 @@ const rational &NodeKeyframe::time() const
 
 void NodeKeyframe::set_time(const rational &time)
 {
+  rational old_time = time_;
   time_ = time;
-  emit TimeChanged(time_);
+  emit TimeChanged(time_, old_time);
 }
 
 const QVariant &NodeKeyframe::value() const
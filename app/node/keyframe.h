@@ -169,8 +169,11 @@ public:
 signals:
   /**
    * @brief Signal emitted when this keyframe's time is changed
+   *
+   * `old_time` is the time the keyframe was at before this change, which lets receivers work out
+   * exactly which frames were affected by the move.
    */
-  void TimeChanged(const rational& time);
+  void TimeChanged(const rational& time, const rational& old_time);
 
   /**
    * @brief Signal emitted when this keyframe's value is changed
@@ -0,0 +1,108 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "keyframecurve.h"
+
+#include <algorithm>
+
+#include "common/bezier.h"
+#include "common/lerp.h"
+
+namespace olive {
+
+void NodeKeyframeCurve::Build(const NodeKeyframeTrack &track, NodeValue::Type type)
+{
+  int sz = track.size();
+
+  times_.resize(sz);
+  values_.resize(sz);
+  in_x_.resize(sz);
+  in_y_.resize(sz);
+  out_x_.resize(sz);
+  out_y_.resize(sz);
+  types_.resize(sz);
+
+  for (int i=0; i<sz; i++) {
+    NodeKeyframe* key = track.at(i);
+
+    times_[i] = key->time().toDouble();
+
+    if (type == NodeValue::kRational) {
+      values_[i] = key->value().value<rational>().toDouble();
+    } else {
+      values_[i] = key->value().toDouble();
+    }
+
+    // Store handles as absolute positions since that's how they're used
+    QPointF in = key->valid_bezier_control_in();
+    QPointF out = key->valid_bezier_control_out();
+    in_x_[i] = times_.at(i) + in.x();
+    in_y_[i] = values_.at(i) + in.y();
+    out_x_[i] = times_.at(i) + out.x();
+    out_y_[i] = values_.at(i) + out.y();
+
+    types_[i] = static_cast<uint8_t>(key->type());
+  }
+}
+
+int NodeKeyframeCurve::GetIndexAfterTime(double time) const
+{
+  return std::upper_bound(times_.cbegin(), times_.cend(), time) - times_.cbegin();
+}
+
+double NodeKeyframeCurve::GetValue(double time, int after_index) const
+{
+  int before = after_index - 1;
+  int after = after_index;
+
+  NodeKeyframe::Type before_type = type(before);
+  NodeKeyframe::Type after_type = type(after);
+
+  if (before_type == NodeKeyframe::kBezier && after_type == NodeKeyframe::kBezier) {
+    // Perform a cubic bezier with two control points
+    double t = Bezier::CubicXtoT(time, times_.at(before), out_x_.at(before), in_x_.at(after), times_.at(after));
+
+    return Bezier::CubicTtoY(values_.at(before), out_y_.at(before), in_y_.at(after), values_.at(after), t);
+  } else if (before_type == NodeKeyframe::kBezier || after_type == NodeKeyframe::kBezier) {
+    // Perform a quadratic bezier with only one control point
+    double control_point_time, control_point_value;
+
+    if (before_type == NodeKeyframe::kBezier) {
+      control_point_time = out_x_.at(before);
+      control_point_value = out_y_.at(before);
+    } else {
+      control_point_time = in_x_.at(after);
+      control_point_value = in_y_.at(after);
+    }
+
+    // Generate T from time values - used to determine bezier progress
+    double t = Bezier::QuadraticXtoT(time, times_.at(before), control_point_time, times_.at(after));
+
+    // Generate value using T
+    return Bezier::QuadraticTtoY(values_.at(before), control_point_value, values_.at(after), t);
+  } else {
+    // To have arrived here, the keyframes must both be linear
+    double period_progress = (time - times_.at(before)) / (times_.at(after) - times_.at(before));
+
+    return lerp(values_.at(before), values_.at(after), period_progress);
+  }
+}
+
+}
@@ -0,0 +1,90 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEKEYFRAMECURVE_H
+#define NODEKEYFRAMECURVE_H
+
+#include <QVector>
+
+#include "node/keyframe.h"
+#include "node/value.h"
+
+namespace olive {
+
+/**
+ * @brief Compact, unboxed copy of a numeric keyframe track used for evaluating it
+ *
+ * NodeKeyframe objects stay the editable representation, but evaluating through them means
+ * unboxing QVariants, converting rationals and clamping bezier handles for every lookup. This
+ * keeps times, values, valid handles and types in contiguous arrays instead so evaluation only
+ * touches plain doubles. It's rebuilt from the keyframes whenever they change.
+ */
+class NodeKeyframeCurve
+{
+public:
+  NodeKeyframeCurve() = default;
+
+  void Build(const NodeKeyframeTrack& track, NodeValue::Type type);
+
+  int size() const
+  {
+    return times_.size();
+  }
+
+  double time(int index) const
+  {
+    return times_.at(index);
+  }
+
+  NodeKeyframe::Type type(int index) const
+  {
+    return static_cast<NodeKeyframe::Type>(types_.at(index));
+  }
+
+  /**
+   * @brief Binary search for the index of the first keyframe after `time`, or size() if none
+   */
+  int GetIndexAfterTime(double time) const;
+
+  /**
+   * @brief Interpolate between the keyframes at `after_index - 1` and `after_index`
+   *
+   * `after_index` must be a result of GetIndexAfterTime() that's neither 0 nor size().
+   */
+  double GetValue(double time, int after_index) const;
+
+private:
+  QVector<double> times_;
+
+  QVector<double> values_;
+
+  QVector<double> in_x_;
+  QVector<double> in_y_;
+
+  QVector<double> out_x_;
+  QVector<double> out_y_;
+
+  QVector<uint8_t> types_;
+
+};
+
+}
+
+#endif // NODEKEYFRAMECURVE_H
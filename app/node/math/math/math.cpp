@@ -121,4 +121,9 @@ void MathNode::ProcessSamples(NodeValueDatabase &values, const SampleBufferPtr i
   return ProcessSamplesInternal(values, GetOperation(), kParamAIn, kParamBIn, input, output, index);
 }
 
+bool MathNode::ProcessSampleBlock(const QHash<QString, QVector<QVariant> > &values, const SampleBufferPtr input, SampleBufferPtr output) const
+{
+  return ProcessSampleBlockInternal(values, GetOperation(), kParamAIn, kParamBIn, input, output);
+}
+
 }
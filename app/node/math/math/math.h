@@ -58,6 +58,8 @@ public:
 
   virtual void ProcessSamples(NodeValueDatabase &values, const SampleBufferPtr input, SampleBufferPtr output, int index) const override;
 
+  virtual bool ProcessSampleBlock(const QHash<QString, QVector<QVariant> >& values, const SampleBufferPtr input, SampleBufferPtr output) const override;
+
   static const QString kMethodIn;
   static const QString kParamAIn;
   static const QString kParamBIn;
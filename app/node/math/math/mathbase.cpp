@@ -255,23 +255,41 @@ NodeValueTable MathNodeBase::ValueInternal(NodeValueDatabase &value, Operation o
 
     SampleBufferPtr mixed_samples = SampleBuffer::CreateAllocated(samples_a->audio_params(), max_samples);
 
-    for (int i=0;i<mixed_samples->audio_params().channel_count();i++) {
-      // Mix samples that are in both buffers
-      for (int j=0;j<min_samples;j++) {
-        mixed_samples->data(i)[j] = PerformAll<float, float>(operation, samples_a->data(i)[j], samples_b->data(i)[j]);
+    if (operation == kOpAdd || operation == kOpSubtract) {
+      // Addition is by far the most common operation here (it's how tracks are mixed), so use the vectorized mix.
+      // The new buffer is zeroed, so mixing both inputs into it also covers the remainder of the larger one.
+      mixed_samples->mix(samples_a.get());
+      mixed_samples->mix(samples_b.get(), (operation == kOpAdd) ? 1.0f : -1.0f);
+    } else {
+      for (int i=0;i<mixed_samples->audio_params().channel_count();i++) {
+        mixed_samples->set(i, samples_a->data(i), samples_a->sample_count());
       }
-    }
 
-    if (max_samples > min_samples) {
-      // Fill in remainder space with 0s
-      int remainder = max_samples - min_samples;
+      // Operate on samples that are in both buffers
+      if (operation == kOpMultiply) {
+        mixed_samples->multiply(samples_b.get());
+      } else if (operation == kOpDivide) {
+        mixed_samples->divide(samples_b.get());
+      } else {
+        // No vectorized power, so this one stays per sample
+        for (int i=0;i<mixed_samples->audio_params().channel_count();i++) {
+          for (int j=0;j<min_samples;j++) {
+            mixed_samples->data(i)[j] = PerformAll<float, float>(operation, samples_a->data(i)[j], samples_b->data(i)[j]);
+          }
+        }
+      }
 
-      SampleBufferPtr larger_buffer = (max_samples == samples_a->sample_count()) ? samples_a : samples_b;
+      if (max_samples > min_samples) {
+        // Fill in remainder space with 0s
+        int remainder = max_samples - min_samples;
 
-      for (int i=0;i<mixed_samples->audio_params().channel_count();i++) {
-        memcpy(&mixed_samples->data(i)[min_samples],
-               &larger_buffer->data(i)[min_samples],
-               remainder * sizeof(float));
+        SampleBufferPtr larger_buffer = (max_samples == samples_a->sample_count()) ? samples_a : samples_b;
+
+        for (int i=0;i<mixed_samples->audio_params().channel_count();i++) {
+          memcpy(&mixed_samples->data(i)[min_samples],
+                 &larger_buffer->data(i)[min_samples],
+                 remainder * sizeof(float));
+        }
       }
     }
 
@@ -350,11 +368,7 @@ NodeValueTable MathNodeBase::ValueInternal(NodeValueDatabase &value, Operation o
     if (job.HasSamples()) {
       if (IsInputStatic(number_param)) {
         if (!NumberIsNoOp(operation, number)) {
-          for (int i=0;i<job.samples()->audio_params().channel_count();i++) {
-            for (int j=0;j<job.samples()->sample_count();j++) {
-              job.samples()->data(i)[j] = PerformAll(operation, job.samples()->data(i)[j], number);
-            }
-          }
+          PerformSamplesNumber(operation, job.samples().get(), number);
         }
 
         output.Push(NodeValue::kSamples, QVariant::fromValue(job.samples()), this);
@@ -393,6 +407,94 @@ void MathNodeBase::ProcessSamplesInternal(NodeValueDatabase &values, MathNodeBas
   }
 }
 
+bool MathNodeBase::ProcessSampleBlockInternal(const QHash<QString, QVector<QVariant> > &values, MathNodeBase::Operation operation, const QString &param_a_in, const QString &param_b_in, const SampleBufferPtr input, SampleBufferPtr output) const
+{
+  // This function is only used for sample+number pairing
+  const QString& number_param = values.contains(param_a_in) ? param_a_in : param_b_in;
+  auto number_values = values.constFind(number_param);
+
+  if (number_values == values.constEnd() || number_values->size() < output->sample_count()) {
+    return false;
+  }
+
+  NodeValue::Type number_type = GetInputDataType(number_param);
+  QVector<float> numbers(output->sample_count());
+  bool constant = true;
+
+  for (int i=0;i<numbers.size();i++) {
+    numbers[i] = RetrieveNumber(NodeValue(number_type, number_values->at(i)));
+    constant = constant && numbers.at(i) == numbers.first();
+  }
+
+  for (int i=0;i<output->audio_params().channel_count();i++) {
+    output->set(i, input->data(i), output->sample_count());
+  }
+
+  if (constant) {
+    // Values that don't change over this block cost no more than a static one
+    if (!NumberIsNoOp(operation, numbers.first())) {
+      PerformSamplesNumber(operation, output.get(), numbers.first());
+    }
+  } else {
+    PerformSamplesPerSample(operation, output.get(), numbers.constData());
+  }
+
+  return true;
+}
+
+void MathNodeBase::PerformSamplesNumber(MathNodeBase::Operation operation, SampleBuffer *samples, float number)
+{
+  switch (operation) {
+  case kOpAdd:
+    samples->offset(number);
+    break;
+  case kOpSubtract:
+    samples->offset(-number);
+    break;
+  case kOpMultiply:
+    samples->transform_volume(number);
+    break;
+  case kOpDivide:
+  case kOpPower:
+    // Neither has a vectorized form against a single number, but these are rare on audio
+    for (int i=0;i<samples->audio_params().channel_count();i++) {
+      float* plane = samples->data(i);
+
+      for (int j=0;j<samples->sample_count();j++) {
+        plane[j] = PerformAll<float, float>(operation, plane[j], number);
+      }
+    }
+    break;
+  }
+}
+
+void MathNodeBase::PerformSamplesPerSample(MathNodeBase::Operation operation, SampleBuffer *samples, const float *numbers)
+{
+  switch (operation) {
+  case kOpAdd:
+    samples->offset_per_sample(numbers);
+    break;
+  case kOpSubtract:
+    samples->offset_per_sample(numbers, -1.0f);
+    break;
+  case kOpMultiply:
+    samples->transform_volume_per_sample(numbers);
+    break;
+  case kOpDivide:
+    samples->divide_per_sample(numbers);
+    break;
+  case kOpPower:
+    for (int i=0;i<samples->audio_params().channel_count();i++) {
+      float* plane = samples->data(i);
+
+      for (int j=0;j<samples->sample_count();j++) {
+        plane[j] = PerformAll<float, float>(operation, plane[j], numbers[j]);
+      }
+    }
+    break;
+  }
+}
+
 float MathNodeBase::RetrieveNumber(const NodeValue &val)
 {
   if (val.type() == NodeValue::kRational) {
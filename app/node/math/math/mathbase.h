@@ -119,6 +119,18 @@ protected:
 
   void ProcessSamplesInternal(NodeValueDatabase &values, Operation operation, const QString& param_a_in, const QString& param_b_in, const SampleBufferPtr input, SampleBufferPtr output, int index) const;
 
+  bool ProcessSampleBlockInternal(const QHash<QString, QVector<QVariant> >& values, Operation operation, const QString& param_a_in, const QString& param_b_in, const SampleBufferPtr input, SampleBufferPtr output) const;
+
+  /**
+   * @brief Perform `operation` on every sample of `samples` with `number`, in place
+   */
+  static void PerformSamplesNumber(Operation operation, SampleBuffer* samples, float number);
+
+  /**
+   * @brief Perform `operation` on every sample of `samples` with the number for that sample, in place
+   */
+  static void PerformSamplesPerSample(Operation operation, SampleBuffer* samples, const float* numbers);
+
 };
 
 }
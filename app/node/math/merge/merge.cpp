@@ -87,11 +87,12 @@ NodeValueTable MergeNode::Value(const QString &output, NodeValueDatabase &value)
   TexturePtr blend_tex = job.GetValue(kBlendIn).data().value<TexturePtr>();
 
   if (base_tex || blend_tex) {
-    if (!base_tex || (blend_tex && blend_tex->channel_count() < VideoParams::kRGBAChannelCount)) {
-      // We only have a blend texture or the blend texture is RGB only, no need to alpha over
+    if (!base_tex || (blend_tex && blend_tex->GetCoverage() == Texture::kCoverageOpaque)) {
+      // We only have a blend texture or the blend texture completely covers the base, no need to
+      // alpha over
       table.Push(job.GetValue(kBlendIn));
-    } else if (!blend_tex) {
-      // We only have a base texture, no need to alpha over
+    } else if (!blend_tex || blend_tex->GetCoverage() == Texture::kCoverageTransparent) {
+      // We only have a base texture or the blend texture contributes nothing, no need to alpha over
       table.Push(job.GetValue(kBaseIn));
     } else {
       // We have both textures, push the job
@@ -100,6 +101,12 @@ NodeValueTable MergeNode::Value(const QString &output, NodeValueDatabase &value)
         job.SetAlphaChannelRequired(GenerateJob::kAlphaForceOff);
       }
 
+      if (base_tex->IsConstantColor() && blend_tex->IsConstantColor()) {
+        // Two solids merge into another solid, so there's no need to sample either of them
+        const Color& blend_col = blend_tex->GetConstantColor();
+        job.SetConstantColor(base_tex->GetConstantColor() * (1.0 - blend_col.alpha()) + blend_col);
+      }
+
       table.Push(NodeValue::kShaderJob, QVariant::fromValue(job), this);
     }
   }
@@ -107,7 +114,29 @@ NodeValueTable MergeNode::Value(const QString &output, NodeValueDatabase &value)
   return table;
 }
 
-void MergeNode::Hash(const QString &output, QCryptographicHash &hash, const rational &time, const VideoParams &video_params) const
+QVector<QString> MergeNode::GetOccludingInputs(const QString &output) const
+{
+  Q_UNUSED(output)
+
+  return {kBlendIn};
+}
+
+bool MergeNode::IsInputOccluded(const QString &output, const QString &input, NodeValueDatabase &db) const
+{
+  Q_UNUSED(output)
+
+  if (input != kBaseIn) {
+    return false;
+  }
+
+  // Nothing under an opaque layer (i.e. a full frame clip without alpha over another track) will
+  // be seen, so don't render or decode it at all
+  TexturePtr blend_tex = db[kBlendIn].Get(NodeValue::kTexture).value<TexturePtr>();
+
+  return blend_tex && blend_tex->GetCoverage() == Texture::kCoverageOpaque;
+}
+
+void MergeNode::Hash(const QString &output, Hasher &hash, const rational &time, const VideoParams &video_params) const
 {
   NodeTraverser traverser;
   traverser.SetCacheVideoParams(video_params);
@@ -118,12 +147,12 @@ void MergeNode::Hash(const QString &output, QCryptographicHash &hash, const rati
   TexturePtr blend_tex = db[kBlendIn].Get(NodeValue::kTexture).value<TexturePtr>();
 
   if (base_tex || blend_tex) {
-    bool passthrough_base = !blend_tex;
-    bool passthrough_blend = !base_tex || (blend_tex && blend_tex->channel_count() < VideoParams::kRGBAChannelCount);
+    bool passthrough_blend = !base_tex || (blend_tex && blend_tex->GetCoverage() == Texture::kCoverageOpaque);
+    bool passthrough_base = !passthrough_blend && (!blend_tex || blend_tex->GetCoverage() == Texture::kCoverageTransparent);
 
     if (!passthrough_base && !passthrough_blend) {
       // This merge will actually do something so we add a fingerprint
-      hash.addData(id().toUtf8());
+      hash.add(id());
     }
 
     if (!passthrough_base) {
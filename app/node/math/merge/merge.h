@@ -45,10 +45,13 @@ public:
   virtual ShaderCode GetShaderCode(const QString &shader_id) const override;
   virtual NodeValueTable Value(const QString& output, NodeValueDatabase &value) const override;
 
+  virtual QVector<QString> GetOccludingInputs(const QString& output) const override;
+  virtual bool IsInputOccluded(const QString& output, const QString& input, NodeValueDatabase& db) const override;
+
   static const QString kBaseIn;
   static const QString kBlendIn;
 
-  virtual void Hash(const QString& output, QCryptographicHash &hash, const rational &time, const VideoParams& video_params) const override;
+  virtual void Hash(const QString& output, Hasher &hash, const rational &time, const VideoParams& video_params) const override;
 
 private:
   NodeInput* base_in_;
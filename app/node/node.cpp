@@ -20,19 +20,20 @@
 
 #include "node.h"
 
+#include <algorithm>
 #include <QApplication>
 #include <QGuiApplication>
 #include <QDebug>
 #include <QFile>
+#include <QSet>
 
-#include "common/bezier.h"
-#include "common/lerp.h"
 #include "common/timecodefunctions.h"
 #include "common/xmlutils.h"
 #include "core.h"
 #include "config/config.h"
 #include "node/project/footage/footage.h"
 #include "project/project.h"
+#include "render/nodegpuprofiler.h"
 #include "ui/colorcoding.h"
 #include "ui/icons/icons.h"
 #include "widget/nodeview/nodeviewundo.h"
@@ -43,6 +44,11 @@ namespace olive {
 
 const QString Node::kDefaultOutput = QStringLiteral("output");
 
+thread_local Node::InvalidationQueue* Node::invalidation_queue_ = nullptr;
+
+QHash<QString, QHash<QString, QSharedDataPointer<Node::InputSchema> > > Node::shared_input_schemas_;
+QMutex Node::shared_input_schemas_lock_;
+
 Node::Node(bool create_default_output) :
   can_be_deleted_(true),
   override_color_(-1),
@@ -64,6 +70,9 @@ Node::~Node()
   // Remove self from anything while we're still a node rather than a base QObject
   setParent(nullptr);
 
+  // Don't attribute GPU time to whatever node is allocated here next
+  NodeGpuProfiler::RemoveNode(this);
+
   // Remove all immediates
   foreach (NodeInputImmediate* i, standard_immediates_) {
     delete i;
@@ -80,7 +89,7 @@ NodeGraph *Node::parent() const
   return static_cast<NodeGraph*>(QObject::parent());
 }
 
-void Node::Load(QXmlStreamReader *reader, XMLNodeData& xml_node_data, uint version, const QAtomicInt* cancelled)
+void Node::Load(XMLReader *reader, XMLNodeData& xml_node_data, uint version, const QAtomicInt* cancelled)
 {
   while (XMLReadNextStartElement(reader)) {
     if (cancelled && *cancelled) {
@@ -162,7 +171,7 @@ void Node::Load(QXmlStreamReader *reader, XMLNodeData& xml_node_data, uint versi
   }
 }
 
-void Node::Save(QXmlStreamWriter *writer) const
+void Node::Save(XMLWriter *writer) const
 {
   writer->writeTextElement(QStringLiteral("ptr"), QString::number(reinterpret_cast<quintptr>(this)));
 
@@ -278,9 +287,11 @@ void Node::ConnectEdge(const NodeOutput &output, const NodeInput &input)
   // Ensure a connection isn't getting overwritten
   Q_ASSERT(input.node()->input_connections().find(input) == input.node()->input_connections().end());
 
-  // Insert connection on both sides
-  input.node()->input_connections_[input] = output;
-  output.node()->output_connections_.push_back(std::pair<NodeOutput, NodeInput>({output, input}));
+  // Insert connection on both sides, with the input ID interned since connections are looked up
+  // constantly while rendering
+  NodeInput stored_input(input.node(), input.node()->InternInputId(input.input()), input.element());
+  input.node()->input_connections_[stored_input] = output;
+  output.node()->output_connections_.push_back(std::pair<NodeOutput, NodeInput>({output, stored_input}));
 
   // Update change times
   input.node()->UpdateLastChangedTime();
@@ -334,14 +345,14 @@ QString Node::GetInputName(const QString &id) const
   const Input* i = GetInternalInputData(id);
 
   if (i) {
-    return i->human_name;
+    return i->schema->human_name;
   } else {
     ReportInvalidInput("get name of", id);
     return QString();
   }
 }
 
-void Node::LoadInput(QXmlStreamReader *reader, XMLNodeData &xml_node_data, const QAtomicInt *cancelled)
+void Node::LoadInput(XMLReader *reader, XMLNodeData &xml_node_data, const QAtomicInt *cancelled)
 {
   QString param_id;
 
@@ -396,7 +407,7 @@ void Node::LoadInput(QXmlStreamReader *reader, XMLNodeData &xml_node_data, const
   }
 }
 
-void Node::SaveInput(QXmlStreamWriter *writer, const QString &id) const
+void Node::SaveInput(XMLWriter *writer, const QString &id) const
 {
   writer->writeAttribute(QStringLiteral("id"), id);
 
@@ -496,7 +507,7 @@ NodeValue::Type Node::GetInputDataType(const QString &id) const
   const Input* i = GetInternalInputData(id);
 
   if (i) {
-    return i->type;
+    return i->schema->type;
   } else {
     ReportInvalidInput("get data type of", id);
     return NodeValue::kNone;
@@ -508,7 +519,9 @@ void Node::SetInputDataType(const QString &id, const NodeValue::Type &type)
   Input* input_meta = GetInternalInputData(id);
 
   if (input_meta) {
-    input_meta->type = type;
+    if (input_meta->schema.constData()->type != type) {
+      input_meta->schema->type = type;
+    }
 
     int array_sz = InputArraySize(id);
     for (int i=-1; i<array_sz; i++) {
@@ -526,7 +539,7 @@ bool Node::HasInputProperty(const QString &id, const QString &name) const
   const Input* i = GetInternalInputData(id);
 
   if (i) {
-    return i->properties.contains(name);
+    return i->schema->properties.contains(name);
   } else {
     ReportInvalidInput("get property of", id);
     return false;
@@ -538,7 +551,7 @@ QHash<QString, QVariant> Node::GetInputProperties(const QString &id) const
   const Input* i = GetInternalInputData(id);
 
   if (i) {
-    return i->properties;
+    return i->schema->properties;
   } else {
     ReportInvalidInput("get property table of", id);
     return QHash<QString, QVariant>();
@@ -550,7 +563,7 @@ QVariant Node::GetInputProperty(const QString &id, const QString &name) const
   const Input* i = GetInternalInputData(id);
 
   if (i) {
-    return i->properties.value(name);
+    return i->schema->properties.value(name);
   } else {
     ReportInvalidInput("get property of", id);
     return QVariant();
@@ -562,7 +575,13 @@ void Node::SetInputProperty(const QString &id, const QString &name, const QVaria
   Input* i = GetInternalInputData(id);
 
   if (i) {
-    i->properties.insert(name, value);
+    // Only detach from a shared schema if this actually changes it
+    const QHash<QString, QVariant>& properties = i->schema.constData()->properties;
+    auto existing = properties.constFind(name);
+
+    if (existing == properties.constEnd() || existing.value() != value) {
+      i->schema->properties.insert(name, value);
+    }
 
     emit InputPropertyChanged(id, name, value);
   } else {
@@ -591,106 +610,121 @@ QVariant Node::GetSplitValueAtTimeOnTrack(const QString &input, const rational &
 {
   if (!IsUsingStandardValue(input, track, element)) {
     const NodeKeyframeTrack& key_track = GetKeyframeTracks(input, element).at(track);
+    NodeValue::Type type = GetInputDataType(input);
 
-    if (key_track.first()->time() >= time) {
-      // This time precedes any keyframe, so we just return the first value
-      return key_track.first()->value();
-    }
+    if (NodeValue::type_can_be_interpolated(type)) {
+      const NodeKeyframeCurve& curve = GetImmediate(input, element)->keyframe_curve(track);
+      double t = time.toDouble();
 
-    if (key_track.last()->time() <= time) {
-      // This time is after any keyframes so we return the last value
-      return key_track.last()->value();
+      return GetKeyframeCurveValue(key_track, curve, type, t, curve.GetIndexAfterTime(t));
+    } else {
+      // Values that can't be interpolated hold until the next keyframe
+      return key_track.at(qMax(0, GetKeyframeIndexAfterTime(key_track, time) - 1))->value();
     }
+  }
 
-    NodeValue::Type type = GetInputDataType(input);
-
-    // If we're here, the time must be somewhere in between the keyframes
-    for (int i=0;i<key_track.size()-1;i++) {
-      NodeKeyframe* before = key_track.at(i);
-      NodeKeyframe* after = key_track.at(i+1);
+  return GetSplitStandardValueOnTrack(input, track, element);
+}
 
-      if (before->time() == time
-          || ((!NodeValue::type_can_be_interpolated(type) || before->type() == NodeKeyframe::kHold) && after->time() > time)) {
+QVector<QVariant> Node::GetSplitValuesAtTimesOnTrack(const QString &input, const QVector<rational> &times, int track, int element) const
+{
+  if (IsUsingStandardValue(input, track, element)) {
+    return QVector<QVariant>(times.size(), GetSplitStandardValueOnTrack(input, track, element));
+  }
 
-        // Time == keyframe time, so value is precise
-        return before->value();
+  const NodeKeyframeTrack& key_track = GetKeyframeTracks(input, element).at(track);
+  NodeValue::Type type = GetInputDataType(input);
 
-      } else if (after->time() == time) {
+  QVector<QVariant> values(times.size());
 
-        // Time == keyframe time, so value is precise
-        return after->value();
+  if (NodeValue::type_can_be_interpolated(type)) {
+    const NodeKeyframeCurve& curve = GetImmediate(input, element)->keyframe_curve(track);
 
-      } else if (before->time() < time && after->time() > time) {
-        // We must interpolate between these keyframes
+    int after = 0;
+    double last_t = 0;
+    for (int i=0; i<times.size(); i++) {
+      double t = times.at(i).toDouble();
 
-        double before_val, after_val, interpolated;
-        if (type == NodeValue::kRational) {
-          before_val = before->value().value<rational>().toDouble();
-          after_val = after->value().value<rational>().toDouble();
-        } else {
-          before_val = before->value().toDouble();
-          after_val = after->value().toDouble();
+      if (i == 0 || t < last_t) {
+        after = curve.GetIndexAfterTime(t);
+      } else {
+        // Times are usually ascending, in which case we can just walk forward from the last position
+        while (after < curve.size() && curve.time(after) <= t) {
+          after++;
         }
+      }
 
-        if (before->type() == NodeKeyframe::kBezier && after->type() == NodeKeyframe::kBezier) {
-          // Perform a cubic bezier with two control points
+      values[i] = GetKeyframeCurveValue(key_track, curve, type, t, after);
+      last_t = t;
+    }
+  } else {
+    for (int i=0; i<times.size(); i++) {
+      values[i] = key_track.at(qMax(0, GetKeyframeIndexAfterTime(key_track, times.at(i)) - 1))->value();
+    }
+  }
 
-          double t = Bezier::CubicXtoT(time.toDouble(),
-                                       before->time().toDouble(),
-                                       before->time().toDouble() + before->valid_bezier_control_out().x(),
-                                       after->time().toDouble() + after->valid_bezier_control_in().x(),
-                                       after->time().toDouble());
+  return values;
+}
 
-          double y = Bezier::CubicTtoY(before_val,
-                                       before_val + before->valid_bezier_control_out().y(),
-                                       after_val + after->valid_bezier_control_in().y(),
-                                       after_val,
-                                       t);
+QVector<QVariant> Node::GetValuesAtTimes(const QString &input, const QVector<rational> &times, int element) const
+{
+  NodeValue::Type type = GetInputDataType(input);
+  int nb_tracks = GetNumberOfKeyframeTracks(input);
 
-          interpolated = y;
+  QVector< QVector<QVariant> > track_values(nb_tracks);
+  for (int i=0; i<nb_tracks; i++) {
+    track_values[i] = GetSplitValuesAtTimesOnTrack(input, times, i, element);
+  }
 
-        } else if (before->type() == NodeKeyframe::kBezier || after->type() == NodeKeyframe::kBezier) {
-          // Perform a quadratic bezier with only one control point
+  QVector<QVariant> values(times.size());
+  SplitValue split(nb_tracks);
 
-          QPointF control_point;
-          double control_point_time;
-          double control_point_value;
+  for (int j=0; j<times.size(); j++) {
+    for (int i=0; i<nb_tracks; i++) {
+      split[i] = track_values.at(i).at(j);
+    }
 
-          if (before->type() == NodeKeyframe::kBezier) {
-            control_point = before->valid_bezier_control_out();
-            control_point_time = before->time().toDouble() + control_point.x();
-            control_point_value = before_val + control_point.y();
-          } else {
-            control_point = after->valid_bezier_control_in();
-            control_point_time = after->time().toDouble() + control_point.x();
-            control_point_value = after_val + control_point.y();
-          }
+    values[j] = NodeValue::combine_track_values_into_normal_value(type, split);
+  }
 
-          // Generate T from time values - used to determine bezier progress
-          double t = Bezier::QuadraticXtoT(time.toDouble(), before->time().toDouble(), control_point_time, after->time().toDouble());
+  return values;
+}
 
-          // Generate value using T
-          double y = Bezier::QuadraticTtoY(before_val, control_point_value, after_val, t);
+int Node::GetKeyframeIndexAfterTime(const NodeKeyframeTrack &track, const rational &time)
+{
+  // Keyframe tracks are kept sorted by time
+  auto it = std::upper_bound(track.cbegin(), track.cend(), time, [](const rational& t, const NodeKeyframe* key){
+    return t < key->time();
+  });
 
-          interpolated = y;
+  return it - track.cbegin();
+}
 
-        } else {
-          // To have arrived here, the keyframes must both be linear
-          qreal period_progress = (time.toDouble() - before->time().toDouble()) / (after->time().toDouble() - before->time().toDouble());
+QVariant Node::GetKeyframeCurveValue(const NodeKeyframeTrack &track, const NodeKeyframeCurve &curve, NodeValue::Type type, double time, int after_index)
+{
+  if (after_index == 0) {
+    // This time precedes any keyframe, so we just return the first value
+    return track.first()->value();
+  }
 
-          interpolated = lerp(before_val, after_val, period_progress);
-        }
+  if (after_index == curve.size()) {
+    // This time is after any keyframes so we return the last value
+    return track.last()->value();
+  }
 
-        if (type == NodeValue::kRational) {
-          return QVariant::fromValue(rational::fromDouble(interpolated));
-        } else {
-          return interpolated;
-        }
-      }
-    }
+  // If we're here, the time must be somewhere in between these keyframes
+  if (curve.time(after_index - 1) == time || curve.type(after_index - 1) == NodeKeyframe::kHold) {
+    // Time == keyframe time, so value is precise
+    return track.at(after_index - 1)->value();
   }
 
-  return GetSplitStandardValueOnTrack(input, track, element);
+  double interpolated = curve.GetValue(time, after_index);
+
+  if (type == NodeValue::kRational) {
+    return QVariant::fromValue(rational::fromDouble(interpolated));
+  } else {
+    return interpolated;
+  }
 }
 
 QVariant Node::GetDefaultValue(const QString &input) const
@@ -705,7 +739,7 @@ SplitValue Node::GetSplitDefaultValue(const QString &input) const
   const Input* i = GetInternalInputData(input);
 
   if (i) {
-    return i->default_value;
+    return i->schema->default_value;
   } else {
     ReportInvalidInput("retrieve default value of", input);
     return SplitValue();
@@ -1031,7 +1065,7 @@ Node::InputFlags Node::GetInputFlags(const QString &input) const
   const Input* i = GetInternalInputData(input);
 
   if (i) {
-    return i->flags;
+    return i->schema->flags;
   } else {
     ReportInvalidInput("retrieve flags of", input);
     return InputFlags(kInputFlagNormal);
@@ -1077,6 +1111,12 @@ TimeRange Node::OutputTimeAdjustment(const QString &, int, const TimeRange &inpu
   return input_time;
 }
 
+QVector<TimeRange> Node::InputTimeSamples(const QString &, const TimeRange &) const
+{
+  // Default behavior is every input is only needed once
+  return QVector<TimeRange>();
+}
+
 QVector<Node *> Node::CopyDependencyGraph(const QVector<Node *> &nodes, MultiUndoCommand *command)
 {
   int nb_nodes = nodes.size();
@@ -1201,16 +1241,95 @@ Node *Node::CopyNodeInGraph(const Node *node, MultiUndoCommand *command)
 
 void Node::SendInvalidateCache(const TimeRange &range, qint64 job_time)
 {
-  if (GetOperationStack() == 0) {
-    for (const OutputConnection& conn : output_connections_) {
-      // Send clear cache signal to the Node
-      const NodeInput& in = conn.second;
+  if (GetOperationStack() != 0) {
+    return;
+  }
+
+  // Nested calls (from nodes we're invalidating relaying it on) only queue, the outermost call
+  // sends everything once it's been coalesced
+  InvalidationQueue queue;
+  bool outermost = !invalidation_queue_;
+
+  if (outermost) {
+    invalidation_queue_ = &queue;
+    RankDownstreamNodes(this, &queue);
+  }
 
-      in.node()->InvalidateCache(range, in.input(), in.element(), job_time);
+  for (const OutputConnection& conn : output_connections_) {
+    QueueInvalidation(invalidation_queue_, conn.second, range, job_time);
+  }
+
+  if (outermost) {
+    while (!queue.pending.isEmpty()) {
+      // Send clear cache signal to the most upstream nodes first
+      QHash<NodeInput, InvalidationQueue::Pending> next = queue.pending.take(queue.pending.firstKey());
+
+      for (auto it=next.cbegin(); it!=next.cend(); it++) {
+        const NodeInput& in = it.key();
+
+        for (const TimeRange& r : it.value().ranges) {
+          in.node()->InvalidateCache(r, in.input(), in.element(), it.value().job_time);
+        }
+      }
     }
+
+    invalidation_queue_ = nullptr;
   }
 }
 
+void Node::RankDownstreamNodes(const Node *n, InvalidationQueue *queue)
+{
+  // Depth-first post-order, reversed, is a topological order
+  QVector<const Node*> post_order;
+  QVector< QPair<const Node*, int> > stack;
+  QSet<const Node*> visited;
+
+  stack.append({n, 0});
+  visited.insert(n);
+
+  while (!stack.isEmpty()) {
+    const Node* node = stack.last().first;
+    int& next_conn = stack.last().second;
+
+    if (next_conn < int(node->output_connections_.size())) {
+      const Node* child = node->output_connections_.at(next_conn).second.node();
+      next_conn++;
+
+      if (!visited.contains(child) && !queue->rank.contains(child)) {
+        visited.insert(child);
+        stack.append({child, 0});
+      }
+    } else {
+      post_order.append(node);
+      stack.removeLast();
+    }
+  }
+
+  // Nodes found later (i.e. invalidated by something other than a connection) rank after
+  // everything found before them
+  int base = queue->rank.size();
+  for (int i=post_order.size()-1; i>=0; i--) {
+    queue->rank.insert(post_order.at(i), base + post_order.size() - 1 - i);
+  }
+}
+
+void Node::QueueInvalidation(InvalidationQueue *queue, const NodeInput &input, const TimeRange &range, qint64 job_time)
+{
+  if (!queue->rank.contains(input.node())) {
+    RankDownstreamNodes(input.node(), queue);
+  }
+
+  InvalidationQueue::Pending& p = queue->pending[queue->rank.value(input.node())][input];
+
+  if (p.ranges.isEmpty()) {
+    p.job_time = job_time;
+  } else {
+    p.job_time = qMax(p.job_time, job_time);
+  }
+
+  p.ranges.insert(range);
+}
+
 void Node::InvalidateAll(const QString &input, int element)
 {
   InvalidateCache(TimeRange(RATIONAL_MIN, RATIONAL_MAX), input, element);
@@ -1261,6 +1380,24 @@ bool Node::AreLinked(Node *a, Node *b)
   return a->links_.contains(b);
 }
 
+void Node::ShareInputSchemas()
+{
+  QMutexLocker locker(&shared_input_schemas_lock_);
+
+  QHash<QString, QSharedDataPointer<InputSchema> >& schemas = shared_input_schemas_[id()];
+
+  for (int i=0; i<input_ids_.size(); i++) {
+    QSharedDataPointer<InputSchema>& mine = input_data_[i].schema;
+    auto it = schemas.find(input_ids_.at(i));
+
+    if (it == schemas.end()) {
+      schemas.insert(input_ids_.at(i), mine);
+    } else if (it->constData() != mine.constData() && *it->constData() == *mine.constData()) {
+      mine = *it;
+    }
+  }
+}
+
 void Node::InsertInput(const QString &id, NodeValue::Type type, const QVariant &default_value, Node::InputFlags flags, int index)
 {
   if (id.isEmpty()) {
@@ -1275,9 +1412,10 @@ void Node::InsertInput(const QString &id, NodeValue::Type type, const QVariant &
 
   Node::Input i;
 
-  i.type = type;
-  i.default_value = NodeValue::split_normal_value_into_track_values(type, default_value);
-  i.flags = flags;
+  i.schema = new InputSchema();
+  i.schema->type = type;
+  i.schema->default_value = NodeValue::split_normal_value_into_track_values(type, default_value);
+  i.schema->flags = flags;
   i.array_size = 0;
 
   input_ids_.insert(index, id);
@@ -1342,7 +1480,7 @@ NodeInputImmediate *Node::CreateImmediate(const QString &input)
   const Input* i = GetInternalInputData(input);
 
   if (i) {
-    return new NodeInputImmediate(i->type, i->default_value);
+    return new NodeInputImmediate(i->schema->type, i->schema->default_value);
   } else {
     ReportInvalidInput("create immediate", input);
     return nullptr;
@@ -1389,7 +1527,9 @@ void Node::SetInputName(const QString &id, const QString &name)
   Input* i = GetInternalInputData(id);
 
   if (i) {
-    i->human_name = name;
+    if (i->schema.constData()->human_name != name) {
+      i->schema->human_name = name;
+    }
 
     emit InputNameChanged(id, name);
   } else {
@@ -1407,12 +1547,12 @@ void Node::IgnoreHashingFrom(const QString &input_id)
   ignore_when_hashing_.append(input_id);
 }
 
-bool Node::LoadCustom(QXmlStreamReader *, XMLNodeData &, uint, const QAtomicInt*)
+bool Node::LoadCustom(XMLReader *, XMLNodeData &, uint, const QAtomicInt*)
 {
   return false;
 }
 
-void Node::SaveCustom(QXmlStreamWriter *) const
+void Node::SaveCustom(XMLWriter *) const
 {
 }
 
@@ -1452,13 +1592,13 @@ void Node::SetLabel(const QString &s)
   }
 }
 
-void Node::Hash(const QString &output, QCryptographicHash &hash, const rational& time, const VideoParams &video_params) const
+void Node::Hash(const QString &output, Hasher &hash, const rational& time, const VideoParams &video_params) const
 {
   Q_UNUSED(output)
 
   // Add this Node's ID and output being used
-  hash.addData(id().toUtf8());
-  hash.addData(output.toUtf8());
+  hash.add(id());
+  hash.add(output);
 
   auto inputs = inputs_for_output(output);
   foreach (const QString& input, inputs) {
@@ -1469,11 +1609,81 @@ void Node::Hash(const QString &output, QCryptographicHash &hash, const rational&
 
     int arr_sz = InputArraySize(input);
     for (int i=-1; i<arr_sz; i++) {
+      if (i >= 0 && !IsInputElementUsed(output, input, i, time)) {
+        continue;
+      }
+
       HashInputElement(hash, input, i, time, video_params);
     }
   }
 }
 
+QVector<TimeRange> Node::GetConstantRanges(const QString &output, const TimeRange &range) const
+{
+  QVector<TimeRange> constant = {range};
+
+  // Mirror Hash(), any input that contributes to it narrows down where we're constant
+  auto inputs = inputs_for_output(output);
+  foreach (const QString& input, inputs) {
+    if (ignore_when_hashing_.contains(input)) {
+      continue;
+    }
+
+    int arr_sz = InputArraySize(input);
+    for (int i=-1; i<arr_sz; i++) {
+      constant = IntersectConstantRanges(constant, GetInputElementConstantRanges(input, i, range));
+
+      if (constant.isEmpty()) {
+        // Nothing left to narrow down
+        return constant;
+      }
+    }
+  }
+
+  return constant;
+}
+
+Node::TimeVariance Node::GetTimeVariance(const QString &output, const TimeRange &range) const
+{
+  QVector<TimeRange> constant = GetConstantRanges(output, range);
+
+  if (constant.isEmpty()) {
+    return kTimeVarying;
+  } else if (constant.size() == 1 && constant.first() == range) {
+    return kTimeConstant;
+  } else {
+    return kTimeKeyframed;
+  }
+}
+
+QVector<TimeRange> Node::IntersectConstantRanges(const QVector<TimeRange> &a, const QVector<TimeRange> &b)
+{
+  QVector<TimeRange> intersected;
+
+  int i = 0, j = 0;
+
+  while (i < a.size() && j < b.size()) {
+    const TimeRange& ra = a.at(i);
+    const TimeRange& rb = b.at(j);
+
+    // TimeRange normalizes its in/out so check for an overlap before constructing one
+    rational in = qMax(ra.in(), rb.in());
+    rational out = qMin(ra.out(), rb.out());
+
+    if (in < out) {
+      intersected.append(TimeRange(in, out));
+    }
+
+    if (ra.out() < rb.out()) {
+      i++;
+    } else {
+      j++;
+    }
+  }
+
+  return intersected;
+}
+
 void Node::CopyInputs(const Node *source, Node *destination, bool include_connections)
 {
   Q_ASSERT(source->id() == destination->id());
@@ -1592,7 +1802,7 @@ QVector<Node *> Node::GetDependenciesInternal(bool traverse, bool exclusive_only
   return list;
 }
 
-void Node::HashInputElement(QCryptographicHash &hash, const QString& input, int element, const rational &time, const VideoParams& video_params) const
+void Node::HashInputElement(Hasher &hash, const QString& input, int element, const rational &time, const VideoParams& video_params) const
 {
   // Get time adjustment
   // For a single frame, we only care about one of the times
@@ -1606,10 +1816,91 @@ void Node::HashInputElement(QCryptographicHash &hash, const QString& input, int
   } else {
     // Grab the value at this time
     QVariant value = GetValueAtTime(input, input_time, element);
-    hash.addData(NodeValue::ValueToBytes(GetInputDataType(input), value));
+    NodeValue::HashValue(hash, GetInputDataType(input), value);
   }
 }
 
+QVector<TimeRange> Node::GetInputElementConstantRanges(const QString &input, int element, const TimeRange &range) const
+{
+  if (IsInputConnected(input, element)) {
+    // Ask the connected node in its own time, then map its ranges back to ours
+    NodeOutput output = GetConnectedOutput(input, element);
+    TimeRange adjusted_range = InputTimeAdjustment(input, element, range);
+
+    QVector<TimeRange> upstream = output.node()->GetConstantRanges(output.output(), adjusted_range);
+    QVector<TimeRange> mapped;
+
+    foreach (const TimeRange& r, upstream) {
+      TimeRange m = OutputTimeAdjustment(input, element, r);
+
+      rational in = qMax(m.in(), range.in());
+      rational out = qMin(m.out(), range.out());
+
+      if (in < out) {
+        mapped.append(TimeRange(in, out));
+      }
+    }
+
+    return mapped;
+  } else if (IsInputKeyframing(input, element)) {
+    QVector<TimeRange> constant = {range};
+
+    foreach (const NodeKeyframeTrack& track, GetKeyframeTracks(input, element)) {
+      constant = IntersectConstantRanges(constant, GetKeyframeConstantRanges(track, range));
+    }
+
+    return constant;
+  } else {
+    // A static value never changes
+    return {range};
+  }
+}
+
+QVector<TimeRange> Node::GetKeyframeConstantRanges(const NodeKeyframeTrack &track, const TimeRange &range)
+{
+  if (track.isEmpty()) {
+    return {range};
+  }
+
+  NodeKeyframeTrack sorted = track;
+  std::sort(sorted.begin(), sorted.end(), [](NodeKeyframe* a, NodeKeyframe* b){
+    return a->time() < b->time();
+  });
+
+  QVector<TimeRange> constant;
+
+  auto append_clamped = [&constant, &range](const rational& in, const rational& out) {
+    rational clamped_in = qMax(in, range.in());
+    rational clamped_out = qMin(out, range.out());
+
+    if (clamped_in < clamped_out) {
+      constant.append(TimeRange(clamped_in, clamped_out));
+    }
+  };
+
+  // Value holds at the first keyframe's value before it
+  append_clamped(range.in(), sorted.first()->time());
+
+  for (int i=0; i<sorted.size()-1; i++) {
+    NodeKeyframe* key = sorted.at(i);
+    NodeKeyframe* next = sorted.at(i+1);
+
+    // Held keys don't interpolate, and linear interpolation between equal values is a no-op.
+    // Bezier handles can overshoot even between equal values, so those are always assumed to vary.
+    if (key->type() == NodeKeyframe::kHold
+        || (key->type() != NodeKeyframe::kBezier
+            && next->type() != NodeKeyframe::kBezier
+            && key->value() == next->value())) {
+      append_clamped(key->time(), next->time());
+    }
+  }
+
+  // Value holds at the last keyframe's value after it
+  append_clamped(sorted.last()->time(), range.out());
+
+  return constant;
+}
+
 QVector<Node *> Node::GetDependencies() const
 {
   return GetDependenciesInternal(true, false);
@@ -1636,6 +1927,11 @@ void Node::ProcessSamples(NodeValueDatabase &, const SampleBufferPtr, SampleBuff
 {
 }
 
+bool Node::ProcessSampleBlock(const QHash<QString, QVector<QVariant> > &, const SampleBufferPtr, SampleBufferPtr) const
+{
+  return false;
+}
+
 void Node::GenerateFrame(FramePtr frame, const GenerateJob &job) const
 {
   Q_UNUSED(frame)
@@ -1869,7 +2165,7 @@ void Node::ParameterValueChanged(const QString& input, int element, const TimeRa
   InvalidateCache(range, input, element);
 }
 
-void Node::LoadImmediate(QXmlStreamReader *reader, const QString& input, int element, XMLNodeData &xml_node_data, const QAtomicInt *cancelled)
+void Node::LoadImmediate(XMLReader *reader, const QString& input, int element, XMLNodeData &xml_node_data, const QAtomicInt *cancelled)
 {
   Q_UNUSED(xml_node_data)
 
@@ -1986,7 +2282,7 @@ void Node::LoadImmediate(QXmlStreamReader *reader, const QString& input, int ele
   }
 }
 
-void Node::SaveImmediate(QXmlStreamWriter *writer, const QString& input, int element) const
+void Node::SaveImmediate(XMLWriter *writer, const QString& input, int element) const
 {
   if (IsInputKeyframable(input)) {
     writer->writeTextElement(QStringLiteral("keyframing"), QString::number(IsInputKeyframing(input, element)));
@@ -2092,6 +2388,30 @@ TimeRange Node::GetRangeAroundIndex(const QString &input, int index, int track,
   return TimeRange(range_begin, range_end);
 }
 
+TimeRange Node::GetRangeAffectedByKeyframeMove(const NodeKeyframeTrack &track, int index, const rational &time, bool extend_in, bool extend_out)
+{
+  rational range_begin;
+  rational range_end;
+
+  if (index > 0) {
+    const NodeKeyframe* prev = track.at(index - 1);
+
+    // A previous hold key keeps its value right up to this key, so only the frames this key was
+    // moved across change
+    range_begin = (prev->type() == NodeKeyframe::kHold) ? time : prev->time();
+  } else {
+    range_begin = extend_in ? RATIONAL_MIN : time;
+  }
+
+  if (index < track.size() - 1) {
+    range_end = track.at(index + 1)->time();
+  } else {
+    range_end = extend_out ? RATIONAL_MAX : time;
+  }
+
+  return TimeRange(range_begin, range_end);
+}
+
 void Node::ClearElement(const QString& input, int index)
 {
   GetImmediate(input, index)->delete_all_keyframes();
@@ -2207,57 +2527,90 @@ void Node::childEvent(QChildEvent *event)
 void Node::InvalidateFromKeyframeBezierInChange()
 {
   NodeKeyframe* key = static_cast<NodeKeyframe*>(sender());
+  GetImmediate(key->input(), key->element())->invalidate_keyframe_curve(key->track());
   const NodeKeyframeTrack& track = GetTrackFromKeyframe(key);
   int keyframe_index = track.indexOf(key);
 
-  rational start = RATIONAL_MIN;
-  rational end = key->time();
-
-  if (keyframe_index > 0) {
-    start = track.at(keyframe_index - 1)->time();
+  // The in control point only shapes the curve from the previous keyframe, and only if that curve
+  // is actually interpolated with this key's bezier
+  if (keyframe_index == 0
+      || key->type() != NodeKeyframe::kBezier
+      || track.at(keyframe_index - 1)->type() == NodeKeyframe::kHold) {
+    return;
   }
 
-  ParameterValueChanged(key->key_track_ref().input(), TimeRange(start, end));
+  ParameterValueChanged(key->key_track_ref().input(), TimeRange(track.at(keyframe_index - 1)->time(), key->time()));
 }
 
 void Node::InvalidateFromKeyframeBezierOutChange()
 {
   NodeKeyframe* key = static_cast<NodeKeyframe*>(sender());
+  GetImmediate(key->input(), key->element())->invalidate_keyframe_curve(key->track());
   const NodeKeyframeTrack& track = GetTrackFromKeyframe(key);
   int keyframe_index = track.indexOf(key);
 
-  rational start = key->time();
-  rational end = RATIONAL_MAX;
-
-  if (keyframe_index < track.size() - 1) {
-    end = track.at(keyframe_index + 1)->time();
+  // The out control point only shapes the curve to the next keyframe, and only if this key is a
+  // bezier
+  if (keyframe_index == track.size() - 1
+      || key->type() != NodeKeyframe::kBezier) {
+    return;
   }
 
-  ParameterValueChanged(key->key_track_ref().input(), TimeRange(start, end));
+  ParameterValueChanged(key->key_track_ref().input(), TimeRange(key->time(), track.at(keyframe_index + 1)->time()));
 }
 
-void Node::InvalidateFromKeyframeTimeChange()
+void Node::InvalidateFromKeyframeTimeChange(const rational &time, const rational &old_time)
 {
   NodeKeyframe* key = static_cast<NodeKeyframe*>(sender());
   NodeInputImmediate* immediate = GetImmediate(key->input(), key->element());
-  TimeRange original_range = GetRangeAffectedByKeyframe(key);
+  const NodeKeyframeTrack& track = GetTrackFromKeyframe(key);
 
-  TimeRangeList invalidate_range;
-  invalidate_range.insert(original_range);
+  immediate->invalidate_keyframe_curve(key->track());
 
-  if (!(original_range.in() < key->time() && original_range.out() > key->time())) {
+  // Keyframes are still sorted by their old times at this point, so these are the old neighbors
+  int old_index = track.indexOf(key);
+  bool was_first = (old_index == 0);
+  bool was_last = (old_index == track.size() - 1);
+
+  bool needs_resort = (!was_first && track.at(old_index - 1)->time() >= time)
+      || (!was_last && track.at(old_index + 1)->time() <= time);
+
+  TimeRange old_range = GetRangeAffectedByKeyframeMove(track, old_index, old_time, false, false);
+
+  if (needs_resort) {
     // This keyframe needs resorting, store it and remove it from the list
     immediate->remove_keyframe(key);
 
     // Automatically insertion sort
     immediate->insert_keyframe(key);
+  }
+
+  int new_index = track.indexOf(key);
+  bool extend_in = (was_first != (new_index == 0));
+  bool extend_out = (was_last != (new_index == track.size() - 1));
+
+  // If the key became (or stopped being) the first or last keyframe, the value held before or
+  // after the whole track changed too, so those ends have to be opened up
+  if (extend_in) {
+    old_range.set_in(RATIONAL_MIN);
+  }
+  if (extend_out) {
+    old_range.set_out(RATIONAL_MAX);
+  }
+
+  TimeRangeList invalidate_range;
+
+  // Only the spans between the keyframe's old and new neighbors can change value. Anything outside
+  // of them (including the value held past the first/last keyframe) is exactly as it was.
+  TimeRange new_range = GetRangeAffectedByKeyframeMove(track, new_index, time, extend_in, extend_out);
 
-    // Invalidate new area that the keyframe has been moved to
-    invalidate_range.insert(GetRangeAffectedByKeyframe(key));
+  if (old_range.length() != 0) {
+    invalidate_range.insert(old_range);
+  }
+  if (new_range.length() != 0) {
+    invalidate_range.insert(new_range);
   }
 
-  // Invalidate entire area surrounding the keyframe (either where it currently is, or where it used to be before it
-  // was resorted in the if block above)
   foreach (const TimeRange& r, invalidate_range) {
     ParameterValueChanged(key->key_track_ref().input(), r);
   }
@@ -2266,12 +2619,14 @@ void Node::InvalidateFromKeyframeTimeChange()
 void Node::InvalidateFromKeyframeValueChange()
 {
   NodeKeyframe* key = static_cast<NodeKeyframe*>(sender());
+  GetImmediate(key->input(), key->element())->invalidate_keyframe_curve(key->track());
   ParameterValueChanged(key->key_track_ref().input(), GetRangeAffectedByKeyframe(key));
 }
 
 void Node::InvalidateFromKeyframeTypeChanged()
 {
   NodeKeyframe* key = static_cast<NodeKeyframe*>(sender());
+  GetImmediate(key->input(), key->element())->invalidate_keyframe_curve(key->track());
   const NodeKeyframeTrack& track = GetTrackFromKeyframe(key);
 
   if (track.size() == 1) {
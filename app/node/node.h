@@ -22,16 +22,18 @@
 #define NODE_H
 
 #include <map>
-#include <QCryptographicHash>
+#include <QMutex>
 #include <QObject>
 #include <QPainter>
 #include <QPointF>
-#include <QXmlStreamWriter>
+#include <QSharedData>
 
 #include "codec/frame.h"
 #include "codec/samplebuffer.h"
+#include "common/hasher.h"
 #include "common/rational.h"
 #include "common/timerange.h"
+#include "common/xmlstream.h"
 #include "common/xmlutils.h"
 #include "node/keyframe.h"
 #include "node/inputimmediate.h"
@@ -109,12 +111,12 @@ public:
   /**
    * @brief Clear current node variables and replace them with
    */
-  void Load(QXmlStreamReader* reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt *cancelled);
+  void Load(XMLReader* reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt *cancelled);
 
   /**
    * @brief Save this node into a text/XML format
    */
-  void Save(QXmlStreamWriter* writer) const;
+  void Save(XMLWriter* writer) const;
 
   /**
    * @brief Return the name of the node
@@ -252,8 +254,8 @@ public:
 
   QString GetInputName(const QString& id) const;
 
-  void LoadInput(QXmlStreamReader* reader, XMLNodeData &xml_node_data, const QAtomicInt *cancelled);
-  void SaveInput(QXmlStreamWriter* writer, const QString& id) const;
+  void LoadInput(XMLReader* reader, XMLNodeData &xml_node_data, const QAtomicInt *cancelled);
+  void SaveInput(XMLWriter* writer, const QString& id) const;
 
   bool IsInputConnectable(const QString& input) const;
   bool IsInputKeyframable(const QString& input) const;
@@ -343,6 +345,19 @@ public:
     return GetSplitValueAtTimeOnTrack(input.input(), time, input.track());
   }
 
+  /**
+   * @brief Evaluate one keyframe track at several times in one pass
+   *
+   * Equivalent to calling GetSplitValueAtTimeOnTrack() for each time, but when `times` is in
+   * ascending order (e.g. a frame or sample list) the keyframes are only walked once.
+   */
+  QVector<QVariant> GetSplitValuesAtTimesOnTrack(const QString& input, const QVector<rational>& times, int track, int element = -1) const;
+
+  /**
+   * @brief Batch equivalent of GetValueAtTime(), see GetSplitValuesAtTimesOnTrack()
+   */
+  QVector<QVariant> GetValuesAtTimes(const QString& input, const QVector<rational>& times, int element = -1) const;
+
   QVariant GetDefaultValue(const QString& input) const;
   SplitValue GetSplitDefaultValue(const QString& input) const;
   QVariant GetSplitDefaultValueOnTrack(const QString& input, int track) const;
@@ -536,6 +551,15 @@ public:
    */
   virtual void ProcessSamples(NodeValueDatabase &values, const SampleBufferPtr input, SampleBufferPtr output, int index) const;
 
+  /**
+   * @brief Process a whole SampleJob at once rather than calling ProcessSamples() for every sample
+   *
+   * Only used when none of the job's inputs are connected. `values` holds each of them evaluated at
+   * every sample of `input`, so keyframed values can be applied to whole planes at once. Return
+   * FALSE to have ProcessSamples() called for each sample instead, which is the default.
+   */
+  virtual bool ProcessSampleBlock(const QHash<QString, QVector<QVariant> >& values, const SampleBufferPtr input, SampleBufferPtr output) const;
+
   /**
    * @brief If Value() pushes a GenerateJob, override this function for the image to create
    *
@@ -668,6 +692,61 @@ public:
    */
   virtual TimeRange OutputTimeAdjustment(const QString& input, int element, const TimeRange& input_time) const;
 
+  /**
+   * @brief Extra times a connected input is rendered at, on top of InputTimeAdjustment()
+   *
+   * For nodes that need an input at more than one time (i.e. the frames either side of a retimed
+   * frame). Each is inserted into the database under GetInputSampleKey(). Only applies to inputs
+   * that aren't arrays.
+   */
+  virtual QVector<TimeRange> InputTimeSamples(const QString& input, const TimeRange& input_time) const;
+
+  static QString GetInputSampleKey(const QString& input, int index)
+  {
+    return QStringLiteral("%1:sample%2").arg(input, QString::number(index));
+  }
+
+  /**
+   * @brief Returns whether an element of an array input contributes to `output` at `time`
+   *
+   * Elements that don't are neither traversed nor hashed, so a node that picks one of its elements
+   * (i.e. one camera angle of many) only renders the one it uses.
+   */
+  virtual bool IsInputElementUsed(const QString& output, const QString& input, int element, const rational& time) const
+  {
+    Q_UNUSED(output)
+    Q_UNUSED(input)
+    Q_UNUSED(element)
+    Q_UNUSED(time)
+    return true;
+  }
+
+  /**
+   * @brief Inputs that may make others unnecessary once they've been generated
+   *
+   * Traversers generate these before any other input and then ask IsInputOccluded() about the
+   * rest, so a node that layers one input over another (i.e. a merge) never renders, or decodes
+   * footage for, a layer that's completely covered.
+   */
+  virtual QVector<QString> GetOccludingInputs(const QString& output) const
+  {
+    Q_UNUSED(output)
+    return QVector<QString>();
+  }
+
+  /**
+   * @brief Returns whether `input` can't contribute to `output` given the occluding inputs in `db`
+   *
+   * Occluded inputs are left empty in the database passed to Value().
+   */
+  virtual bool IsInputOccluded(const QString& output, const QString& input, NodeValueDatabase& db) const
+  {
+    Q_UNUSED(output)
+    Q_UNUSED(input)
+    Q_UNUSED(db)
+    return false;
+  }
+
   /**
    * @brief Copies inputs from from Node to another including connections
    *
@@ -733,7 +812,43 @@ public:
   const QString& GetLabel() const;
   void SetLabel(const QString& s);
 
-  virtual void Hash(const QString& output, QCryptographicHash& hash, const rational &time, const VideoParams& video_params) const;
+  virtual void Hash(const QString& output, Hasher& hash, const rational &time, const VideoParams& video_params) const;
+
+  enum TimeVariance {
+    /// Output is the same at every time in the range
+    kTimeConstant,
+
+    /// Output only changes in parts of the range (e.g. between keyframes or at block boundaries)
+    kTimeKeyframed,
+
+    /// Output may change at every time in the range
+    kTimeVarying
+  };
+
+  /**
+   * @brief Determine the parts of a range in which this output doesn't change over time
+   *
+   * Returns sorted, non-overlapping ranges within `range`. Within each of them the output (and its
+   * Hash()) is the same at every time, though separate ranges may differ from each other. Times
+   * not covered by any range may change on every frame.
+   *
+   * The default implementation combines the keyframes of this node's inputs with the constant
+   * ranges of connected nodes, mapped through InputTimeAdjustment() and OutputTimeAdjustment().
+   * Nodes whose output depends on time in any other way must override this.
+   */
+  virtual QVector<TimeRange> GetConstantRanges(const QString& output, const TimeRange& range) const;
+
+  /**
+   * @brief Classify an output's dependence on time using GetConstantRanges()
+   */
+  TimeVariance GetTimeVariance(const QString& output, const TimeRange& range) const;
+
+  /**
+   * @brief Intersect two sorted lists of constant ranges
+   *
+   * Unlike a TimeRangeList, adjacent ranges are never merged since they may hold different values.
+   */
+  static QVector<TimeRange> IntersectConstantRanges(const QVector<TimeRange>& a, const QVector<TimeRange>& b);
 
   void InvalidateAll(const QString& input, int element = -1);
 
@@ -751,6 +866,16 @@ public:
   static bool Unlink(Node* a, Node* b);
   static bool AreLinked(Node* a, Node* b);
 
+  /**
+   * @brief Share input descriptions with other instances of this node where they're identical
+   *
+   * Names, types, flags, defaults and properties are normally the same for every instance of a
+   * node, so once a node is fully constructed, any input matching the one recorded for its ID
+   * drops its own copy. The first instance added for each ID is the one recorded. Called by
+   * NodeGraph when the node is added.
+   */
+  void ShareInputSchemas();
+
   void SetFolder(Folder* folder)
   {
     folder_ = folder;
@@ -780,6 +905,11 @@ public:
 
     virtual Project* GetRelevantProject() const override;
 
+    virtual qint64 EstimatedSize() const override
+    {
+      return UndoCommand::EstimatedSize() + EstimateOwnedObjectsSize(&memory_manager_);
+    }
+
   protected:
     virtual void redo() override
     {
@@ -849,6 +979,11 @@ protected:
       return f_ & f;
     }
 
+    bool operator==(const InputFlags& rhs) const
+    {
+      return f_ == rhs.f_;
+    }
+
   private:
     uint64_t f_;
 
@@ -907,9 +1042,9 @@ protected:
     return operation_stack_;
   }
 
-  virtual bool LoadCustom(QXmlStreamReader* reader, XMLNodeData& xml_node_data, uint version, const QAtomicInt* cancelled);
+  virtual bool LoadCustom(XMLReader* reader, XMLNodeData& xml_node_data, uint version, const QAtomicInt* cancelled);
 
-  virtual void SaveCustom(QXmlStreamWriter* writer) const;
+  virtual void SaveCustom(XMLWriter* writer) const;
 
   enum GizmoScaleHandles {
     kGizmoScaleTopLeft,
@@ -1084,12 +1219,27 @@ private:
 
   };
 
-  struct Input {
+  /**
+   * @brief Part of an input that's usually identical across instances, see ShareInputSchemas()
+   *
+   * Copy-on-write, so read it through constData() unless it's actually being changed.
+   */
+  struct InputSchema : public QSharedData {
     NodeValue::Type type;
     InputFlags flags;
     SplitValue default_value;
     QHash<QString, QVariant> properties;
     QString human_name;
+
+    bool operator==(const InputSchema& rhs) const
+    {
+      return type == rhs.type && flags == rhs.flags && default_value == rhs.default_value
+          && properties == rhs.properties && human_name == rhs.human_name;
+    }
+  };
+
+  struct Input {
+    QSharedDataPointer<InputSchema> schema;
     int array_size;
   };
 
@@ -1099,7 +1249,16 @@ private:
 
   int GetInternalInputIndex(const QString& input) const
   {
-    return input_ids_.indexOf(input);
+    return IndexOfInputId(input_ids_, input);
+  }
+
+  /**
+   * @brief Return this node's own copy of an input ID so later lookups with it are interned
+   */
+  QString InternInputId(const QString& input) const
+  {
+    int i = GetInternalInputIndex(input);
+    return (i == -1) ? input : input_ids_.at(i);
   }
 
   InputFlags GetInputFlags(const QString& input) const;
@@ -1145,7 +1304,23 @@ private:
 
   QVector<Node*> GetDependenciesInternal(bool traverse, bool exclusive_only) const;
 
-  void HashInputElement(QCryptographicHash& hash, const QString &input, int element, const rational& time, const VideoParams &video_params) const;
+  void HashInputElement(Hasher& hash, const QString &input, int element, const rational& time, const VideoParams &video_params) const;
+
+  QVector<TimeRange> GetInputElementConstantRanges(const QString &input, int element, const TimeRange& range) const;
+
+  static QVector<TimeRange> GetKeyframeConstantRanges(const NodeKeyframeTrack& track, const TimeRange& range);
+
+  /**
+   * @brief Binary search for the index of the first keyframe after `time`, or the track size if none
+   */
+  static int GetKeyframeIndexAfterTime(const NodeKeyframeTrack& track, const rational& time);
+
+  /**
+   * @brief Get the value of an interpolatable keyframe track at `time`
+   *
+   * `after_index` is the result of NodeKeyframeCurve::GetIndexAfterTime() for this time.
+   */
+  static QVariant GetKeyframeCurveValue(const NodeKeyframeTrack& track, const NodeKeyframeCurve& curve, NodeValue::Type type, double time, int after_index);
 
   void ParameterValueChanged(const QString &input, int element, const olive::TimeRange &range);
   void ParameterValueChanged(const NodeInput& input, const olive::TimeRange &range)
@@ -1153,9 +1328,9 @@ private:
     ParameterValueChanged(input.input(), input.element(), range);
   }
 
-  void LoadImmediate(QXmlStreamReader *reader, const QString& input, int element, XMLNodeData& xml_node_data, const QAtomicInt* cancelled);
+  void LoadImmediate(XMLReader *reader, const QString& input, int element, XMLNodeData& xml_node_data, const QAtomicInt* cancelled);
 
-  void SaveImmediate(QXmlStreamWriter *writer, const QString &input, int element) const;
+  void SaveImmediate(XMLWriter *writer, const QString &input, int element) const;
 
   void UpdateLastChangedTime();
 
@@ -1169,8 +1344,49 @@ private:
    */
   TimeRange GetRangeAroundIndex(const QString& input, int index, int track, int element) const;
 
+  /**
+   * @brief Gets the time range that can change when the keyframe at index is moved from/to time
+   *
+   * Unlike GetRangeAroundIndex(), the open end of the first/last keyframe stops at the keyframe
+   * itself since the value held beyond it doesn't change with its time. Set extend_in/extend_out
+   * when the keyframe's position at either end of the track has changed.
+   */
+  static TimeRange GetRangeAffectedByKeyframeMove(const NodeKeyframeTrack& track, int index, const rational& time, bool extend_in, bool extend_out);
+
   void ClearElement(const QString &input, int index);
 
+  /**
+   * @brief Invalidations waiting to be sent while the outermost SendInvalidateCache() propagates
+   *
+   * Ranges sent to the same input along several paths (i.e. diamonds in the graph) are merged and
+   * sent once, in topological order so every node sees everything upstream of it first.
+   */
+  struct InvalidationQueue
+  {
+    struct Pending
+    {
+      TimeRangeList ranges;
+      qint64 job_time;
+    };
+
+    // Topological rank of every node reached so far, upstream nodes rank lower
+    QHash<const Node*, int> rank;
+
+    QMap<int, QHash<NodeInput, Pending> > pending;
+  };
+
+  static void RankDownstreamNodes(const Node* n, InvalidationQueue* queue);
+
+  static void QueueInvalidation(InvalidationQueue* queue, const NodeInput& input, const TimeRange& range, qint64 job_time);
+
+  static thread_local InvalidationQueue* invalidation_queue_;
+
+  /**
+   * @brief Input schemas recorded by ShareInputSchemas(), by node ID then input ID
+   */
+  static QHash<QString, QHash<QString, QSharedDataPointer<InputSchema> > > shared_input_schemas_;
+  static QMutex shared_input_schemas_lock_;
+
   QVector<QString> ignore_connections_;
 
   QVector<QString> ignore_when_hashing_;
@@ -1227,7 +1443,7 @@ private slots:
   /**
    * @brief Slot when a keyframe's time changes to keep the keyframes correctly sorted by time
    */
-  void InvalidateFromKeyframeTimeChange();
+  void InvalidateFromKeyframeTimeChange(const rational& time, const rational& old_time);
 
   /**
    * @brief Slot when a keyframe's value changes to signal that the cache needs updating
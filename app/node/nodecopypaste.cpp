@@ -20,20 +20,25 @@
 
 #include "nodecopypaste.h"
 
+#include <QBuffer>
 #include <QMessageBox>
 
 #include "core.h"
 #include "node/factory.h"
+#include "node/output/track/track.h"
+#include "node/output/viewer/viewer.h"
 #include "widget/nodeview/nodeviewundo.h"
 #include "window/mainwindow/mainwindow.h"
 
 namespace olive {
 
+NodeCopyPasteService::ClipboardSnapshot NodeCopyPasteService::clipboard_snapshot_;
+
 void NodeCopyPasteService::CopyNodesToClipboard(const QVector<Node *> &nodes, void *userdata)
 {
   QString copy_str;
 
-  QXmlStreamWriter writer(&copy_str);
+  XMLWriter writer(&copy_str);
   writer.setAutoFormatting(true);
 
   writer.writeStartDocument();
@@ -56,6 +61,56 @@ void NodeCopyPasteService::CopyNodesToClipboard(const QVector<Node *> &nodes, vo
   writer.writeEndDocument();
 
   Core::CopyStringToClipboard(copy_str);
+
+  // Keep a snapshot so pasting in this process doesn't have to parse all that back
+  ClearClipboardSnapshot();
+
+  clipboard_snapshot_.clipboard = copy_str;
+
+  foreach (Node* n, nodes) {
+    ClipboardNode cn;
+
+    cn.ptr = reinterpret_cast<quintptr>(n);
+
+    if (CanCloneNode(n)) {
+      // Values are implicitly shared, so this is cheap until either side changes them
+      cn.clone = n->copy();
+      Node::CopyInputs(n, cn.clone, false);
+
+      for (auto it=n->input_connections().cbegin(); it!=n->input_connections().cend(); it++) {
+        cn.connections.append({it->first.input(), it->first.element(), reinterpret_cast<quintptr>(it->second.node()), it->second.output()});
+      }
+
+      foreach (Node* link, n->links()) {
+        cn.links.append(reinterpret_cast<quintptr>(link));
+      }
+    } else {
+      cn.clone = nullptr;
+
+      QBuffer buffer(&cn.data);
+      buffer.open(QBuffer::WriteOnly);
+
+      XMLWriter node_writer(&buffer, XMLWriter::kBinary);
+      node_writer.writeStartDocument();
+      node_writer.writeStartElement(QStringLiteral("node"));
+      node_writer.writeAttribute(QStringLiteral("id"), n->id());
+      n->Save(&node_writer);
+      node_writer.writeEndElement(); // node
+      node_writer.writeEndDocument();
+    }
+
+    clipboard_snapshot_.nodes.append(cn);
+  }
+
+  QBuffer custom_buffer(&clipboard_snapshot_.custom);
+  custom_buffer.open(QBuffer::WriteOnly);
+
+  XMLWriter custom_writer(&custom_buffer, XMLWriter::kBinary);
+  custom_writer.writeStartDocument();
+  custom_writer.writeStartElement(QStringLiteral("custom"));
+  CopyNodesToClipboardInternal(&custom_writer, userdata);
+  custom_writer.writeEndElement(); // custom
+  custom_writer.writeEndDocument();
 }
 
 QVector<Node *> NodeCopyPasteService::PasteNodesFromClipboard(NodeGraph *graph, MultiUndoCommand* command, void *userdata)
@@ -66,12 +121,19 @@ QVector<Node *> NodeCopyPasteService::PasteNodesFromClipboard(NodeGraph *graph,
     return QVector<Node*>();
   }
 
-  QXmlStreamReader reader(clipboard);
-  uint data_version = 0;
-
   QVector<Node*> pasted_nodes;
   XMLNodeData xml_node_data;
 
+  if (clipboard == clipboard_snapshot_.clipboard) {
+    // Clipboard still holds what we last copied, skip the XML
+    pasted_nodes = PasteNodesFromSnapshot(xml_node_data, userdata);
+    AddPastedNodes(graph, command, pasted_nodes, xml_node_data);
+    return pasted_nodes;
+  }
+
+  XMLReader reader(clipboard);
+  uint data_version = 0;
+
   while (XMLReadNextStartElement(&reader)) {
     if (reader.name() == QStringLiteral("olive")) {
       // Default to current version - this may not be desirable?
@@ -136,8 +198,95 @@ QVector<Node *> NodeCopyPasteService::PasteNodesFromClipboard(NodeGraph *graph,
     return QVector<Node*>();
   }
 
+  AddPastedNodes(graph, command, pasted_nodes, xml_node_data);
+
+  return pasted_nodes;
+}
+
+void NodeCopyPasteService::CopyNodesToClipboardInternal(XMLWriter*, void*)
+{
+}
+
+void NodeCopyPasteService::PasteNodesFromClipboardInternal(XMLReader* reader, XMLNodeData &xml_node_data, void*)
+{
+  Q_UNUSED(xml_node_data)
+  reader->skipCurrentElement();
+}
+
+void NodeCopyPasteService::ClearClipboardSnapshot()
+{
+  foreach (const ClipboardNode& cn, clipboard_snapshot_.nodes) {
+    delete cn.clone;
+  }
+
+  clipboard_snapshot_ = ClipboardSnapshot();
+}
+
+bool NodeCopyPasteService::CanCloneNode(const Node *n)
+{
+  // These keep state in SaveCustom() that the clone wouldn't carry over
+  return !n->IsItem() && !dynamic_cast<const Track*>(n) && !dynamic_cast<const ViewerOutput*>(n);
+}
+
+QVector<Node *> NodeCopyPasteService::PasteNodesFromSnapshot(XMLNodeData &xml_node_data, void *userdata)
+{
+  QVector<Node*> pasted_nodes;
+
+  // Fill in the same data loading the XML would have so connections, links, and custom data all
+  // resolve the same way
+  foreach (const ClipboardNode& cn, clipboard_snapshot_.nodes) {
+    Node* node = nullptr;
+
+    if (cn.clone) {
+      node = cn.clone->copy();
+      Node::CopyInputs(cn.clone, node, false);
+
+      xml_node_data.node_ptrs.insert(cn.ptr, node);
+
+      foreach (const ClipboardConnection& c, cn.connections) {
+        xml_node_data.desired_connections.append({NodeInput(node, c.input, c.element), c.output_node, c.output});
+      }
+
+      foreach (quintptr link, cn.links) {
+        xml_node_data.block_links.append({node, link});
+      }
+    } else {
+      XMLReader reader(cn.data);
+
+      if (XMLReadNextStartElement(&reader)) {
+        XMLAttributeLoop((&reader), attr) {
+          if (attr.name() == QStringLiteral("id")) {
+            node = NodeFactory::CreateFromID(attr.value().toString());
+            break;
+          }
+        }
+
+        if (node) {
+          node->Load(&reader, xml_node_data, Core::kProjectVersion, nullptr);
+        }
+      }
+    }
+
+    if (node) {
+      pasted_nodes.append(node);
+    }
+  }
+
+  if (!pasted_nodes.isEmpty()) {
+    XMLReader reader(clipboard_snapshot_.custom);
+
+    if (XMLReadNextStartElement(&reader)) {
+      PasteNodesFromClipboardInternal(&reader, xml_node_data, userdata);
+    }
+  }
+
+  return pasted_nodes;
+}
+
+void NodeCopyPasteService::AddPastedNodes(NodeGraph *graph, MultiUndoCommand *command, const QVector<Node *> &nodes, const XMLNodeData &xml_node_data)
+{
   // Add all nodes to graph
-  foreach (Node* n, pasted_nodes) {
+  foreach (Node* n, nodes) {
     command->add_child(new NodeAddCommand(graph, n));
   }
 
@@ -148,18 +297,6 @@ QVector<Node *> NodeCopyPasteService::PasteNodesFromClipboard(NodeGraph *graph,
 
   // Link blocks
   XMLLinkBlocks(xml_node_data);
-
-  return pasted_nodes;
-}
-
-void NodeCopyPasteService::CopyNodesToClipboardInternal(QXmlStreamWriter*, void*)
-{
-}
-
-void NodeCopyPasteService::PasteNodesFromClipboardInternal(QXmlStreamReader* reader, XMLNodeData &xml_node_data, void*)
-{
-  Q_UNUSED(xml_node_data)
-  reader->skipCurrentElement();
 }
 
 }
@@ -39,9 +39,58 @@ protected:
 
   QVector<Node*> PasteNodesFromClipboard(NodeGraph *graph, MultiUndoCommand *command, void* userdata = nullptr);
 
-  virtual void CopyNodesToClipboardInternal(QXmlStreamWriter *writer, void* userdata);
-
-  virtual void PasteNodesFromClipboardInternal(QXmlStreamReader *reader, XMLNodeData &xml_node_data, void* userdata);
+  virtual void CopyNodesToClipboardInternal(XMLWriter *writer, void* userdata);
+
+  virtual void PasteNodesFromClipboardInternal(XMLReader *reader, XMLNodeData &xml_node_data, void* userdata);
+
+private:
+  struct ClipboardConnection
+  {
+    QString input;
+    int element;
+    quintptr output_node;
+    QString output;
+  };
+
+  struct ClipboardNode
+  {
+    // Address of the copied node, which is what connections and links refer to
+    quintptr ptr;
+
+    // Unconnected clone of the copied node, or nullptr if it's stored in `data` instead
+    Node* clone;
+    QVector<ClipboardConnection> connections;
+    QVector<quintptr> links;
+
+    // Node saved in the binary container, for nodes that can't be cloned
+    QByteArray data;
+  };
+
+  /**
+   * @brief The last nodes copied in this process
+   *
+   * Pasting while the clipboard still holds `clipboard` clones these instead of parsing the XML,
+   * which is kept for pasting into other instances.
+   */
+  struct ClipboardSnapshot
+  {
+    QString clipboard;
+    QVector<ClipboardNode> nodes;
+    QByteArray custom;
+  };
+
+  static void ClearClipboardSnapshot();
+
+  /**
+   * @brief Whether copy() and CopyInputs() capture everything about this node
+   */
+  static bool CanCloneNode(const Node* n);
+
+  QVector<Node*> PasteNodesFromSnapshot(XMLNodeData &xml_node_data, void* userdata);
+
+  static void AddPastedNodes(NodeGraph *graph, MultiUndoCommand *command, const QVector<Node*>& nodes, const XMLNodeData &xml_node_data);
+
+  static ClipboardSnapshot clipboard_snapshot_;
 
 };
 
@@ -0,0 +1,543 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "openfxhost.h"
+
+#ifdef USE_OPENFX
+
+#include <cstdarg>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QtConcurrent/QtConcurrent>
+
+#include "openfximageeffect.h"
+
+namespace olive {
+
+OpenFXPropertySet OpenFXHost::host_properties_;
+OfxHost OpenFXHost::host_;
+QVector<OpenFXPlugin*> OpenFXHost::plugins_;
+QVector<QLibrary*> OpenFXHost::libraries_;
+bool OpenFXHost::initialized_ = false;
+
+namespace {
+
+// Set while a thread is running work handed out by OpenFXHost::RunParallel()
+thread_local bool tls_spawned_thread = false;
+thread_local unsigned int tls_thread_index = 0;
+
+typedef int (*OfxGetNumberOfPluginsFunc)(void);
+typedef OfxPlugin* (*OfxGetPluginFunc)(int nth);
+typedef OfxStatus (*OfxSetHostFunc)(const OfxHost* host);
+
+const char* GetBinaryArchitectureFolder()
+{
+#if defined(Q_OS_WINDOWS)
+#if defined(Q_PROCESSOR_X86_64)
+  return "Win64";
+#else
+  return "Win32";
+#endif
+#elif defined(Q_OS_MAC)
+  return "MacOS";
+#elif defined(Q_PROCESSOR_X86_64)
+  return "Linux-x86-64";
+#elif defined(Q_PROCESSOR_ARM_64)
+  return "Linux-arm64";
+#else
+  return "Linux-x86";
+#endif
+}
+
+}
+
+OpenFXPlugin::OpenFXPlugin(OfxPlugin *plugin) :
+  plugin_(plugin),
+  loaded_(false),
+  descriptor_(nullptr),
+  context_descriptor_(nullptr)
+{
+}
+
+OpenFXPlugin::~OpenFXPlugin()
+{
+  delete context_descriptor_;
+  delete descriptor_;
+
+  if (loaded_) {
+    MainEntry(kOfxActionUnload, nullptr);
+  }
+}
+
+bool OpenFXPlugin::Describe()
+{
+  if (qstrcmp(plugin_->pluginApi, kOfxImageEffectPluginApi) != 0 || plugin_->apiVersion != 1) {
+    // Not an image effect, or a version of the API we don't know
+    return false;
+  }
+
+  plugin_->setHost(OpenFXHost::host());
+
+  OfxStatus status = MainEntry(kOfxActionLoad, nullptr);
+  if (status != kOfxStatOK && status != kOfxStatReplyDefault) {
+    return false;
+  }
+
+  loaded_ = true;
+
+  descriptor_ = new OpenFXImageEffect(this);
+
+  status = MainEntry(kOfxActionDescribe, descriptor_->handle());
+  if (status != kOfxStatOK && status != kOfxStatReplyDefault) {
+    return false;
+  }
+
+  // Filters are preferred since they slot in anywhere a built-in effect would
+  QVector<QByteArray> contexts = descriptor_->properties()->GetStrings(kOfxImageEffectPropSupportedContexts);
+  static const QVector<QByteArray> preferred_contexts = {kOfxImageEffectContextFilter,
+                                                         kOfxImageEffectContextGeneral,
+                                                         kOfxImageEffectContextGenerator};
+  foreach (const QByteArray& c, preferred_contexts) {
+    if (contexts.contains(c)) {
+      context_ = c;
+      break;
+    }
+  }
+
+  if (context_.isEmpty()) {
+    return false;
+  }
+
+  // Each context gets its own descriptor that starts from the plugin's general description
+  context_descriptor_ = new OpenFXImageEffect(this, *descriptor_->properties());
+
+  OpenFXPropertySet in_args;
+  in_args.SetString(kOfxImageEffectPropContext, context_);
+
+  status = MainEntry(kOfxImageEffectActionDescribeInContext, context_descriptor_->handle(), in_args.handle());
+  if (status != kOfxStatOK && status != kOfxStatReplyDefault) {
+    return false;
+  }
+
+  return context_descriptor_->GetClip(kOfxImageEffectOutputClipName) != nullptr;
+}
+
+QString OpenFXPlugin::label() const
+{
+  QByteArray l = context_descriptor_->properties()->GetString(kOfxPropLabel);
+  return l.isEmpty() ? identifier() : QString::fromUtf8(l);
+}
+
+QString OpenFXPlugin::grouping() const
+{
+  return QString::fromUtf8(context_descriptor_->properties()->GetString(kOfxImageEffectPluginPropGrouping));
+}
+
+QString OpenFXPlugin::description() const
+{
+  return QString::fromUtf8(context_descriptor_->properties()->GetString(kOfxPropPluginDescription));
+}
+
+QByteArray OpenFXPlugin::GetPixelDepthForFormat(VideoParams::Format format) const
+{
+  QVector<QByteArray> supported = context_descriptor_->properties()->GetStrings(kOfxImageEffectPropSupportedPixelDepths);
+
+  QByteArray native = OpenFXImageEffect::GetPixelDepthFromFormat(format);
+  if (supported.isEmpty() || supported.contains(native)) {
+    return native;
+  }
+
+  static const QVector<QByteArray> deepest_first = {kOfxBitDepthFloat,
+                                                    kOfxBitDepthHalf,
+                                                    kOfxBitDepthShort,
+                                                    kOfxBitDepthByte};
+  foreach (const QByteArray& d, deepest_first) {
+    if (supported.contains(d)) {
+      return d;
+    }
+  }
+
+  return native;
+}
+
+bool OpenFXPlugin::CanRenderTilesInParallel() const
+{
+  const OpenFXPropertySet* p = context_descriptor_->properties();
+
+  return p->GetString(kOfxImageEffectPluginRenderThreadSafety, 0, kOfxImageEffectRenderInstanceSafe) == kOfxImageEffectRenderFullySafe
+      && p->GetInt(kOfxImageEffectPropSupportsTiles, 0, 1)
+      && p->GetInt(kOfxImageEffectPluginPropHostFrameThreading, 0, 1);
+}
+
+bool OpenFXPlugin::IsRenderUnsafe() const
+{
+  return context_descriptor_->properties()->GetString(kOfxImageEffectPluginRenderThreadSafety, 0, kOfxImageEffectRenderInstanceSafe) == kOfxImageEffectRenderUnsafe;
+}
+
+void OpenFXHost::Initialize()
+{
+  if (initialized_) {
+    return;
+  }
+
+  initialized_ = true;
+
+  host_properties_.SetString(kOfxPropName, "org.olivevideoeditor.Olive");
+  host_properties_.SetString(kOfxPropLabel, "Olive");
+  host_properties_.SetInts(kOfxPropAPIVersion, {1, 4});
+  host_properties_.SetInt(kOfxImageEffectHostPropIsBackground, 0);
+  host_properties_.SetInt(kOfxImageEffectPropSupportsOverlays, 0);
+  host_properties_.SetInt(kOfxImageEffectPropSupportsMultiResolution, 1);
+  host_properties_.SetInt(kOfxImageEffectPropSupportsTiles, 1);
+  host_properties_.SetInt(kOfxImageEffectPropTemporalClipAccess, 0);
+  host_properties_.SetStrings(kOfxImageEffectPropSupportedComponents, {kOfxImageComponentRGBA,
+                                                                       kOfxImageComponentRGB});
+  host_properties_.SetStrings(kOfxImageEffectPropSupportedContexts, {kOfxImageEffectContextFilter,
+                                                                     kOfxImageEffectContextGeneral,
+                                                                     kOfxImageEffectContextGenerator});
+  host_properties_.SetStrings(kOfxImageEffectPropSupportedPixelDepths, {kOfxBitDepthByte,
+                                                                        kOfxBitDepthShort,
+                                                                        kOfxBitDepthHalf,
+                                                                        kOfxBitDepthFloat});
+  host_properties_.SetInt(kOfxImageEffectPropSupportsMultipleClipDepths, 0);
+  host_properties_.SetInt(kOfxImageEffectPropSupportsMultipleClipPARs, 0);
+  host_properties_.SetInt(kOfxImageEffectPropSetableFrameRate, 0);
+  host_properties_.SetInt(kOfxImageEffectPropSetableFielding, 0);
+  host_properties_.SetInt(kOfxImageEffectInstancePropSequentialRender, 0);
+  host_properties_.SetInt(kOfxParamHostPropSupportsCustomInteract, 0);
+  host_properties_.SetInt(kOfxParamHostPropSupportsStringAnimation, 0);
+  host_properties_.SetInt(kOfxParamHostPropSupportsChoiceAnimation, 0);
+  host_properties_.SetInt(kOfxParamHostPropSupportsBooleanAnimation, 0);
+  host_properties_.SetInt(kOfxParamHostPropSupportsCustomAnimation, 0);
+  host_properties_.SetInt(kOfxParamHostPropMaxParameters, -1);
+  host_properties_.SetInt(kOfxParamHostPropMaxPages, 0);
+  host_properties_.SetInts(kOfxParamHostPropPageRowColumnCount, {0, 0});
+
+  host_.host = host_properties_.handle();
+  host_.fetchSuite = FetchSuite;
+
+  foreach (const QString& path, GetPluginSearchPaths()) {
+    QDirIterator it(path, {QStringLiteral("*.ofx.bundle")}, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+
+    while (it.hasNext()) {
+      LoadBundle(it.next());
+    }
+  }
+}
+
+void OpenFXHost::Destroy()
+{
+  qDeleteAll(plugins_);
+  plugins_.clear();
+
+  // Libraries aren't unloaded, since some plugins leave threads or atexit handlers behind
+  qDeleteAll(libraries_);
+  libraries_.clear();
+
+  initialized_ = false;
+}
+
+QThreadPool *OpenFXHost::thread_pool()
+{
+  static QThreadPool pool;
+  return &pool;
+}
+
+void OpenFXHost::RunParallel(const std::function<void (unsigned int, unsigned int)> &func, unsigned int count)
+{
+  if (tls_spawned_thread || count <= 1) {
+    for (unsigned int i=0; i<count; i++) {
+      func(i, count);
+    }
+    return;
+  }
+
+  auto run_index = [func, count](unsigned int index) {
+    bool was_spawned = tls_spawned_thread;
+    unsigned int old_index = tls_thread_index;
+
+    tls_spawned_thread = true;
+    tls_thread_index = index;
+
+    func(index, count);
+
+    tls_spawned_thread = was_spawned;
+    tls_thread_index = old_index;
+  };
+
+  QVector< QFuture<void> > futures;
+  futures.reserve(count - 1);
+
+  for (unsigned int i=0; i<count-1; i++) {
+    futures.append(QtConcurrent::run(thread_pool(), run_index, i));
+  }
+
+  // The last index runs on this thread rather than waiting idle
+  run_index(count - 1);
+
+  foreach (QFuture<void> f, futures) {
+    f.waitForFinished();
+  }
+}
+
+QStringList OpenFXHost::GetPluginSearchPaths()
+{
+  QStringList paths = QString::fromLocal8Bit(qgetenv("OFX_PLUGIN_PATH")).split(QDir::listSeparator());
+  paths.removeAll(QString());
+
+#if defined(Q_OS_WINDOWS)
+  paths.append(QDir::fromNativeSeparators(QString::fromLocal8Bit(qgetenv("CommonProgramFiles"))) + QStringLiteral("/OFX/Plugins"));
+#elif defined(Q_OS_MAC)
+  paths.append(QStringLiteral("/Library/OFX/Plugins"));
+#else
+  paths.append(QStringLiteral("/usr/OFX/Plugins"));
+#endif
+
+  paths.removeDuplicates();
+
+  return paths;
+}
+
+void OpenFXHost::LoadBundle(const QString &bundle_path)
+{
+  // "Name.ofx.bundle/Contents/<arch>/Name.ofx"
+  QString binary_name = QFileInfo(bundle_path).completeBaseName();
+  QString binary_path = QDir(bundle_path).filePath(QStringLiteral("Contents/%1/%2").arg(GetBinaryArchitectureFolder(), binary_name));
+
+  if (!QFileInfo::exists(binary_path)) {
+    return;
+  }
+
+  QLibrary* lib = new QLibrary(binary_path);
+
+  OfxGetNumberOfPluginsFunc get_count = reinterpret_cast<OfxGetNumberOfPluginsFunc>(lib->resolve("OfxGetNumberOfPlugins"));
+  OfxGetPluginFunc get_plugin = reinterpret_cast<OfxGetPluginFunc>(lib->resolve("OfxGetPlugin"));
+
+  if (!get_count || !get_plugin) {
+    qWarning() << "Failed to load OpenFX plugin" << binary_path << lib->errorString();
+    delete lib;
+    return;
+  }
+
+  libraries_.append(lib);
+
+  // Optional in OpenFX 1.4, lets the binary see the host before any plugin is fetched
+  if (OfxSetHostFunc set_host = reinterpret_cast<OfxSetHostFunc>(lib->resolve("OfxSetHost"))) {
+    set_host(&host_);
+  }
+
+  int count = get_count();
+  for (int i=0; i<count; i++) {
+    OfxPlugin* ofx_plugin = get_plugin(i);
+    if (!ofx_plugin) {
+      continue;
+    }
+
+    OpenFXPlugin* plugin = new OpenFXPlugin(ofx_plugin);
+    if (!plugin->Describe()) {
+      qWarning() << "Skipping OpenFX plugin" << plugin->identifier() << "in" << binary_path;
+      delete plugin;
+      continue;
+    }
+
+    // Several bundles may provide the same plugin, only the newest version is kept
+    bool keep = true;
+    for (int j=0; j<plugins_.size(); j++) {
+      OpenFXPlugin* existing = plugins_.at(j);
+
+      if (existing->identifier() == plugin->identifier()) {
+        if (qMakePair(existing->version_major(), existing->version_minor()) < qMakePair(plugin->version_major(), plugin->version_minor())) {
+          delete existing;
+          plugins_.removeAt(j);
+        } else {
+          keep = false;
+        }
+        break;
+      }
+    }
+
+    if (keep) {
+      plugins_.append(plugin);
+    } else {
+      delete plugin;
+    }
+  }
+}
+
+const void *OpenFXHost::FetchSuite(OfxPropertySetHandle host, const char *suite_name, int suite_version)
+{
+  Q_UNUSED(host)
+
+  if (suite_version != 1) {
+    return nullptr;
+  }
+
+  if (!qstrcmp(suite_name, kOfxPropertySuite)) {
+    return OpenFXPropertySet::suite();
+  } else if (!qstrcmp(suite_name, kOfxImageEffectSuite)) {
+    return OpenFXImageEffect::effect_suite();
+  } else if (!qstrcmp(suite_name, kOfxParameterSuite)) {
+    return OpenFXImageEffect::parameter_suite();
+  } else if (!qstrcmp(suite_name, kOfxMemorySuite)) {
+    static const OfxMemorySuiteV1 memory_suite = {
+      MemoryAlloc,
+      MemoryFree
+    };
+    return &memory_suite;
+  } else if (!qstrcmp(suite_name, kOfxMultiThreadSuite)) {
+    static const OfxMultiThreadSuiteV1 thread_suite = {
+      MultiThread,
+      MultiThreadNumCPUs,
+      MultiThreadIndex,
+      MultiThreadIsSpawnedThread,
+      MutexCreate,
+      MutexDestroy,
+      MutexLock,
+      MutexUnLock,
+      MutexTryLock
+    };
+    return &thread_suite;
+  } else if (!qstrcmp(suite_name, kOfxMessageSuite)) {
+    static const OfxMessageSuiteV1 message_suite = {
+      Message
+    };
+    return &message_suite;
+  }
+
+  return nullptr;
+}
+
+OfxStatus OpenFXHost::MemoryAlloc(void *handle, size_t bytes, void **data)
+{
+  Q_UNUSED(handle)
+
+  *data = qMallocAligned(bytes, 64);
+  return *data ? kOfxStatOK : kOfxStatErrMemory;
+}
+
+OfxStatus OpenFXHost::MemoryFree(void *data)
+{
+  qFreeAligned(data);
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXHost::MultiThread(OfxThreadFunctionV1 func, unsigned int thread_count, void *arg)
+{
+  if (tls_spawned_thread) {
+    // Nested calls run once on the calling thread
+    func(0, 1, arg);
+    return kOfxStatOK;
+  }
+
+  if (thread_count == 0) {
+    thread_count = QThread::idealThreadCount();
+  }
+
+  RunParallel([func, arg](unsigned int index, unsigned int max){
+    func(index, max, arg);
+  }, thread_count);
+
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXHost::MultiThreadNumCPUs(unsigned int *count)
+{
+  *count = thread_pool()->maxThreadCount();
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXHost::MultiThreadIndex(unsigned int *index)
+{
+  *index = tls_thread_index;
+  return kOfxStatOK;
+}
+
+int OpenFXHost::MultiThreadIsSpawnedThread()
+{
+  return tls_spawned_thread;
+}
+
+OfxStatus OpenFXHost::MutexCreate(OfxMutexHandle *mutex, int lock_count)
+{
+  QMutex* m = new QMutex(QMutex::Recursive);
+
+  for (int i=0; i<lock_count; i++) {
+    m->lock();
+  }
+
+  *mutex = reinterpret_cast<OfxMutexHandle>(m);
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXHost::MutexDestroy(const OfxMutexHandle mutex)
+{
+  if (!mutex) return kOfxStatErrBadHandle;
+  delete reinterpret_cast<QMutex*>(mutex);
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXHost::MutexLock(const OfxMutexHandle mutex)
+{
+  if (!mutex) return kOfxStatErrBadHandle;
+  reinterpret_cast<QMutex*>(mutex)->lock();
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXHost::MutexUnLock(const OfxMutexHandle mutex)
+{
+  if (!mutex) return kOfxStatErrBadHandle;
+  reinterpret_cast<QMutex*>(mutex)->unlock();
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXHost::MutexTryLock(const OfxMutexHandle mutex)
+{
+  if (!mutex) return kOfxStatErrBadHandle;
+  return reinterpret_cast<QMutex*>(mutex)->tryLock() ? kOfxStatOK : kOfxStatFailed;
+}
+
+OfxStatus OpenFXHost::Message(void *handle, const char *type, const char *id, const char *format, ...)
+{
+  Q_UNUSED(handle)
+  Q_UNUSED(id)
+
+  va_list args;
+  va_start(args, format);
+  QString msg = QString::vasprintf(format, args);
+  va_end(args);
+
+  if (!qstrcmp(type, kOfxMessageQuestion)) {
+    // There's nobody to ask during a render
+    qInfo() << "OpenFX plugin asked:" << msg;
+    return kOfxStatReplyDefault;
+  } else if (!qstrcmp(type, kOfxMessageError) || !qstrcmp(type, kOfxMessageFatal)) {
+    qWarning() << "OpenFX plugin error:" << msg;
+  } else {
+    qInfo() << "OpenFX plugin:" << msg;
+  }
+
+  return kOfxStatOK;
+}
+
+}
+
+#endif // USE_OPENFX
@@ -0,0 +1,235 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OPENFXHOST_H
+#define OPENFXHOST_H
+
+#ifdef USE_OPENFX
+
+#include <functional>
+#include <ofxCore.h>
+#include <ofxImageEffect.h>
+#include <ofxMemory.h>
+#include <ofxMessage.h>
+#include <ofxMultiThread.h>
+#include <QLibrary>
+#include <QMutex>
+#include <QThreadPool>
+#include <QVector>
+
+#include "common/define.h"
+#include "openfxpropertyset.h"
+#include "render/videoparams.h"
+
+namespace olive {
+
+class OpenFXImageEffect;
+
+/**
+ * @brief An image effect plugin loaded from an OpenFX binary and described in one context
+ *
+ * Each plugin becomes one node type (see OpenFXNode). Plugins stay loaded until
+ * OpenFXHost::Destroy().
+ */
+class OpenFXPlugin
+{
+public:
+  OpenFXPlugin(OfxPlugin* plugin);
+
+  ~OpenFXPlugin();
+
+  DISABLE_COPY_MOVE(OpenFXPlugin)
+
+  /**
+   * @brief Run the load and describe actions, returns false if the plugin can't be used
+   */
+  bool Describe();
+
+  OfxStatus MainEntry(const char* action, const void* handle, OfxPropertySetHandle in_args = nullptr, OfxPropertySetHandle out_args = nullptr) const
+  {
+    return plugin_->mainEntry(action, handle, in_args, out_args);
+  }
+
+  QString identifier() const
+  {
+    return QString::fromUtf8(plugin_->pluginIdentifier);
+  }
+
+  unsigned int version_major() const
+  {
+    return plugin_->pluginVersionMajor;
+  }
+
+  unsigned int version_minor() const
+  {
+    return plugin_->pluginVersionMinor;
+  }
+
+  QString label() const;
+
+  QString grouping() const;
+
+  QString description() const;
+
+  /**
+   * @brief The context this plugin was described in, one of kOfxImageEffectContext*
+   */
+  const QByteArray& context() const
+  {
+    return context_;
+  }
+
+  /**
+   * @brief Descriptor from kOfxImageEffectActionDescribeInContext that instances are created from
+   */
+  OpenFXImageEffect* descriptor() const
+  {
+    return context_descriptor_;
+  }
+
+  /**
+   * @brief The OpenFX pixel depth renders of `format` should be handed to this plugin in
+   *
+   * If the plugin doesn't support `format` itself, its deepest supported depth is used and frames
+   * are converted around the render.
+   */
+  QByteArray GetPixelDepthForFormat(VideoParams::Format format) const;
+
+  /**
+   * @brief Whether the host should split single renders into tiles across threads
+   *
+   * Only plugins that are fully thread-safe, support tiles, and leave threading to the host are
+   * split. Others either thread themselves through the multithread suite or can't be split.
+   */
+  bool CanRenderTilesInParallel() const;
+
+  /**
+   * @brief Lock held around renders of plugins that aren't thread-safe at all
+   *
+   * Returns nullptr if the plugin's renders may run concurrently.
+   */
+  QMutex* render_lock()
+  {
+    return IsRenderUnsafe() ? &render_lock_ : nullptr;
+  }
+
+private:
+  bool IsRenderUnsafe() const;
+
+  OfxPlugin* plugin_;
+
+  bool loaded_;
+
+  OpenFXImageEffect* descriptor_;
+
+  OpenFXImageEffect* context_descriptor_;
+
+  QByteArray context_;
+
+  QMutex render_lock_;
+
+};
+
+/**
+ * @brief Finds and loads OpenFX plugins and provides the host suites they call into
+ *
+ * Plugins are searched for in OFX_PLUGIN_PATH and the platform's standard OpenFX folders. Only
+ * image effect plugins are loaded. The OpenGL render suite isn't offered, so every plugin renders
+ * on the CPU into frames downloaded from and uploaded to the renderer.
+ */
+class OpenFXHost
+{
+public:
+  /**
+   * @brief Load every plugin found, does nothing if plugins are already loaded
+   */
+  static void Initialize();
+
+  /**
+   * @brief Unload every plugin
+   *
+   * Every OpenFXNode must be destroyed first.
+   */
+  static void Destroy();
+
+  static const QVector<OpenFXPlugin*>& plugins()
+  {
+    return plugins_;
+  }
+
+  static OfxHost* host()
+  {
+    return &host_;
+  }
+
+  /**
+   * @brief Pool that tiles and multithread suite calls run on
+   *
+   * Kept apart from the global pool so plugin threads can't starve the renderers feeding them.
+   */
+  static QThreadPool* thread_pool();
+
+  /**
+   * @brief Run `func` for every index in [0, count) across the plugin thread pool
+   *
+   * The calling thread takes the last index itself. Calls made from a thread this function spawned
+   * run every index on that thread, as the multithread suite requires.
+   */
+  static void RunParallel(const std::function<void(unsigned int, unsigned int)>& func, unsigned int count);
+
+private:
+  static QStringList GetPluginSearchPaths();
+
+  static void LoadBundle(const QString& bundle_path);
+
+  static const void* FetchSuite(OfxPropertySetHandle host, const char* suite_name, int suite_version);
+
+  static OfxStatus MemoryAlloc(void *handle, size_t bytes, void **data);
+  static OfxStatus MemoryFree(void *data);
+
+  static OfxStatus MultiThread(OfxThreadFunctionV1 func, unsigned int thread_count, void *arg);
+  static OfxStatus MultiThreadNumCPUs(unsigned int *count);
+  static OfxStatus MultiThreadIndex(unsigned int *index);
+  static int MultiThreadIsSpawnedThread();
+  static OfxStatus MutexCreate(OfxMutexHandle *mutex, int lock_count);
+  static OfxStatus MutexDestroy(const OfxMutexHandle mutex);
+  static OfxStatus MutexLock(const OfxMutexHandle mutex);
+  static OfxStatus MutexUnLock(const OfxMutexHandle mutex);
+  static OfxStatus MutexTryLock(const OfxMutexHandle mutex);
+
+  static OfxStatus Message(void *handle, const char *type, const char *id, const char *format, ...);
+
+  static OpenFXPropertySet host_properties_;
+
+  static OfxHost host_;
+
+  static QVector<OpenFXPlugin*> plugins_;
+
+  static QVector<QLibrary*> libraries_;
+
+  static bool initialized_;
+
+};
+
+}
+
+#endif // USE_OPENFX
+
+#endif // OPENFXHOST_H
@@ -0,0 +1,901 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "openfximageeffect.h"
+
+#ifdef USE_OPENFX
+
+#include <QVector2D>
+#include <QVector3D>
+
+#include "node/node.h"
+#include "openfxhost.h"
+
+namespace olive {
+
+const int OpenFXImageEffect::kMinimumRowsPerTile = 64;
+
+namespace {
+
+/**
+ * @brief Image handed out by clipGetImage(), owns a reference to the frame its data points into
+ */
+class OpenFXImage : public OpenFXPropertySet
+{
+public:
+  FramePtr frame;
+};
+
+struct OpenFXImageMemory {
+  void* data;
+};
+
+}
+
+OpenFXClip::OpenFXClip(OpenFXImageEffect *effect, const QByteArray &name, const OpenFXPropertySet &properties) :
+  effect_(effect),
+  name_(name),
+  properties_(properties)
+{
+}
+
+bool OpenFXClip::IsOutput() const
+{
+  return name_ == kOfxImageEffectOutputClipName;
+}
+
+OpenFXParam::OpenFXParam(OpenFXImageEffect *effect, const QByteArray &name, const OpenFXPropertySet &properties) :
+  effect_(effect),
+  name_(name),
+  properties_(properties)
+{
+}
+
+const char *OpenFXParam::StoreString(const QByteArray &s)
+{
+  QMutexLocker locker(&strings_lock_);
+
+  // Values only accumulate, so a pointer handed out earlier is never invalidated
+  auto it = strings_.insert(s);
+  return it->constData();
+}
+
+OpenFXImageEffect::OpenFXImageEffect(OpenFXPlugin *plugin, const OpenFXPropertySet &properties) :
+  plugin_(plugin),
+  is_instance_(false),
+  node_(nullptr),
+  properties_(properties),
+  render_job_(nullptr),
+  render_time_(0),
+  render_frame_rate_(0),
+  render_scale_(1.0),
+  render_pixel_aspect_(1.0)
+{
+  if (!properties_.Contains(kOfxPropType)) {
+    properties_.SetString(kOfxPropType, kOfxTypeImageEffect);
+  }
+}
+
+OpenFXImageEffect::~OpenFXImageEffect()
+{
+  if (is_instance_) {
+    plugin_->MainEntry(kOfxActionDestroyInstance, handle());
+  }
+
+  qDeleteAll(clips_);
+  qDeleteAll(params_);
+}
+
+OpenFXImageEffect *OpenFXImageEffect::CreateInstance(OpenFXPlugin *plugin, const Node *node, const VideoParams &params)
+{
+  OpenFXImageEffect* descriptor = plugin->descriptor();
+  OpenFXImageEffect* instance = new OpenFXImageEffect(plugin, descriptor->properties_);
+
+  instance->node_ = node;
+  instance->properties_.SetString(kOfxPropType, kOfxTypeImageEffectInstance);
+  instance->properties_.SetString(kOfxImageEffectPropContext, plugin->context());
+  instance->properties_.SetInt(kOfxPropIsInteractive, 0);
+  instance->properties_.SetPointer(kOfxPropInstanceData, nullptr);
+  instance->properties_.SetInt(kOfxImageEffectInstancePropSequentialRender, 0);
+  instance->SetProjectProperties(params);
+
+  foreach (OpenFXClip* c, descriptor->clips_) {
+    OpenFXClip* clip = instance->AddClip(c->name(), *c->properties());
+
+    clip->properties()->SetInt(kOfxImageClipPropConnected, 0);
+    clip->properties()->SetString(kOfxImageEffectPropPixelDepth, kOfxBitDepthNone);
+    clip->properties()->SetString(kOfxImageEffectPropComponents, kOfxImageComponentNone);
+    clip->properties()->SetString(kOfxImageClipPropUnmappedPixelDepth, kOfxBitDepthNone);
+    clip->properties()->SetString(kOfxImageClipPropUnmappedComponents, kOfxImageComponentNone);
+    clip->properties()->SetString(kOfxImageEffectPropPreMultiplication, kOfxImagePreMultiplied);
+    clip->properties()->SetString(kOfxImageClipPropFieldOrder, kOfxImageFieldNone);
+    clip->properties()->SetInt(kOfxImageClipPropContinuousSamples, 0);
+  }
+
+  foreach (OpenFXParam* p, descriptor->params_) {
+    instance->AddParam(p->name(), *p->properties());
+  }
+
+  instance->param_set_properties_ = descriptor->param_set_properties_;
+
+  OfxStatus status = plugin->MainEntry(kOfxActionCreateInstance, instance->handle());
+  if (status != kOfxStatOK && status != kOfxStatReplyDefault) {
+    // Never created, so mustn't be destroyed either
+    delete instance;
+    return nullptr;
+  }
+
+  instance->is_instance_ = true;
+
+  return instance;
+}
+
+OpenFXClip *OpenFXImageEffect::GetClip(const char *name) const
+{
+  foreach (OpenFXClip* c, clips_) {
+    if (c->name() == name) {
+      return c;
+    }
+  }
+
+  return nullptr;
+}
+
+OpenFXParam *OpenFXImageEffect::GetParam(const char *name) const
+{
+  foreach (OpenFXParam* p, params_) {
+    if (p->name() == name) {
+      return p;
+    }
+  }
+
+  return nullptr;
+}
+
+bool OpenFXImageEffect::Render(FramePtr output, const GenerateJob &job, double time)
+{
+  const VideoParams& params = output->video_params();
+
+  render_job_ = &job;
+  render_time_ = time;
+  render_frame_rate_ = params.frame_rate().toDouble();
+  render_scale_ = 1.0 / params.divider();
+  render_pixel_aspect_ = params.pixel_aspect_ratio().toDouble();
+  render_depth_ = plugin_->GetPixelDepthForFormat(params.format());
+
+  SetProjectProperties(params);
+
+  // Only convert frames the plugin can't take as they are
+  VideoParams::Format render_format = GetFormatFromPixelDepth(render_depth_);
+
+  FramePtr render_output = output;
+  if (render_format != params.format()) {
+    render_output = CreateConvertedFrame(output.get(), nullptr, render_format, params.channel_count());
+  }
+
+  foreach (OpenFXClip* clip, clips_) {
+    FramePtr f;
+
+    if (clip->IsOutput()) {
+      f = render_output;
+    } else {
+      f = job.GetFrame(QString::fromUtf8(clip->name()));
+
+      if (f) {
+        bool supports_channels = (f->channel_count() == VideoParams::kRGBAChannelCount
+                                  || clip->properties()->GetStrings(kOfxImageEffectPropSupportedComponents).contains(kOfxImageComponentRGB));
+
+        if (f->format() != render_format || !supports_channels) {
+          f = CreateConvertedFrame(f.get(), f.get(), render_format,
+                                   supports_channels ? f->channel_count() : int(VideoParams::kRGBAChannelCount));
+        }
+      }
+    }
+
+    render_frames_.insert(clip, f);
+
+    OpenFXPropertySet* props = clip->properties();
+    props->SetInt(kOfxImageClipPropConnected, f != nullptr);
+
+    if (f) {
+      QByteArray components = (f->channel_count() == VideoParams::kRGBAChannelCount) ? kOfxImageComponentRGBA : kOfxImageComponentRGB;
+
+      props->SetString(kOfxImageEffectPropPixelDepth, render_depth_);
+      props->SetString(kOfxImageEffectPropComponents, components);
+      props->SetString(kOfxImageClipPropUnmappedPixelDepth, render_depth_);
+      props->SetString(kOfxImageClipPropUnmappedComponents, components);
+      props->SetDouble(kOfxImagePropPixelAspectRatio, render_pixel_aspect_);
+      props->SetDouble(kOfxImageEffectPropFrameRate, render_frame_rate_);
+      props->SetDoubles(kOfxImageEffectPropFrameRange, {time, time});
+      props->SetDoubles(kOfxImageEffectPropUnmappedFrameRange, {time, time});
+    }
+  }
+
+  OpenFXPropertySet sequence_args;
+  sequence_args.SetDoubles(kOfxImageEffectPropFrameRange, {time, time});
+  sequence_args.SetDouble(kOfxImageEffectPropFrameStep, 1.0);
+  sequence_args.SetInt(kOfxPropIsInteractive, 0);
+  sequence_args.SetDoubles(kOfxImageEffectPropRenderScale, {render_scale_, render_scale_});
+  sequence_args.SetInt(kOfxImageEffectPropSequentialRenderStatus, 0);
+  sequence_args.SetInt(kOfxImageEffectPropInteractiveRenderStatus, 0);
+
+  OpenFXPropertySet render_args;
+  render_args.SetDouble(kOfxPropTime, time);
+  render_args.SetString(kOfxImageEffectPropFieldToRender, kOfxImageFieldNone);
+  render_args.SetDoubles(kOfxImageEffectPropRenderScale, {render_scale_, render_scale_});
+  render_args.SetInt(kOfxImageEffectPropSequentialRenderStatus, 0);
+  render_args.SetInt(kOfxImageEffectPropInteractiveRenderStatus, 0);
+
+  int width = render_output->width();
+  int height = render_output->height();
+
+  bool success;
+
+  {
+    // Null unless the plugin can't render on several threads at once
+    QMutexLocker locker(plugin_->render_lock());
+
+    plugin_->MainEntry(kOfxImageEffectActionBeginSequenceRender, handle(), sequence_args.handle());
+
+    int tile_count = 1;
+    if (plugin_->CanRenderTilesInParallel()) {
+      tile_count = qMax(1, qMin(OpenFXHost::thread_pool()->maxThreadCount(), height / kMinimumRowsPerTile));
+    }
+
+    int rows_per_tile = (height + tile_count - 1) / tile_count;
+    QAtomicInt failed(0);
+
+    OpenFXHost::RunParallel([this, &render_args, &failed, width, height, rows_per_tile](unsigned int index, unsigned int count){
+      Q_UNUSED(count)
+
+      // Each tile needs its own arguments since they carry its render window
+      OpenFXPropertySet tile_args = render_args;
+      int y1 = int(index) * rows_per_tile;
+      tile_args.SetInts(kOfxImageEffectPropRenderWindow, {0, y1, width, qMin(height, y1 + rows_per_tile)});
+
+      OfxStatus status = plugin_->MainEntry(kOfxImageEffectActionRender, handle(), tile_args.handle());
+      if (status != kOfxStatOK && status != kOfxStatReplyDefault) {
+        failed.storeRelease(1);
+      }
+    }, tile_count);
+
+    plugin_->MainEntry(kOfxImageEffectActionEndSequenceRender, handle(), sequence_args.handle());
+
+    success = !failed.loadAcquire();
+  }
+
+  render_frames_.clear();
+  render_job_ = nullptr;
+
+  if (success && render_output != output) {
+    ConvertPixels(render_output.get(), output.get());
+  }
+
+  return success;
+}
+
+QByteArray OpenFXImageEffect::GetPixelDepthFromFormat(VideoParams::Format format)
+{
+  switch (format) {
+  case VideoParams::kFormatUnsigned8:
+    return kOfxBitDepthByte;
+  case VideoParams::kFormatUnsigned16:
+    return kOfxBitDepthShort;
+  case VideoParams::kFormatFloat16:
+    return kOfxBitDepthHalf;
+  case VideoParams::kFormatFloat32:
+    return kOfxBitDepthFloat;
+  case VideoParams::kFormatInvalid:
+  case VideoParams::kFormatCount:
+    break;
+  }
+
+  return kOfxBitDepthNone;
+}
+
+VideoParams::Format OpenFXImageEffect::GetFormatFromPixelDepth(const QByteArray &depth)
+{
+  if (depth == kOfxBitDepthByte) {
+    return VideoParams::kFormatUnsigned8;
+  } else if (depth == kOfxBitDepthShort) {
+    return VideoParams::kFormatUnsigned16;
+  } else if (depth == kOfxBitDepthHalf) {
+    return VideoParams::kFormatFloat16;
+  } else if (depth == kOfxBitDepthFloat) {
+    return VideoParams::kFormatFloat32;
+  }
+
+  return VideoParams::kFormatInvalid;
+}
+
+QVariant OpenFXImageEffect::GetDefaultValue(const OpenFXParam *param)
+{
+  const OpenFXPropertySet* p = param->properties();
+  QByteArray type = param->type();
+
+  if (type == kOfxParamTypeDouble) {
+    return p->GetDouble(kOfxParamPropDefault);
+  } else if (type == kOfxParamTypeInteger || type == kOfxParamTypeChoice) {
+    return p->GetInt(kOfxParamPropDefault);
+  } else if (type == kOfxParamTypeBoolean) {
+    return bool(p->GetInt(kOfxParamPropDefault));
+  } else if (type == kOfxParamTypeRGBA || type == kOfxParamTypeRGB) {
+    return QVariant::fromValue(Color(p->GetDouble(kOfxParamPropDefault, 0),
+                                     p->GetDouble(kOfxParamPropDefault, 1),
+                                     p->GetDouble(kOfxParamPropDefault, 2),
+                                     p->GetDouble(kOfxParamPropDefault, 3, 1.0)));
+  } else if (type == kOfxParamTypeDouble2D || type == kOfxParamTypeInteger2D) {
+    return QVector2D(p->GetDouble(kOfxParamPropDefault, 0),
+                     p->GetDouble(kOfxParamPropDefault, 1));
+  } else if (type == kOfxParamTypeDouble3D || type == kOfxParamTypeInteger3D) {
+    return QVector3D(p->GetDouble(kOfxParamPropDefault, 0),
+                     p->GetDouble(kOfxParamPropDefault, 1),
+                     p->GetDouble(kOfxParamPropDefault, 2));
+  } else if (type == kOfxParamTypeString) {
+    return QString::fromUtf8(p->GetString(kOfxParamPropDefault));
+  }
+
+  return QVariant();
+}
+
+const OfxImageEffectSuiteV1 *OpenFXImageEffect::effect_suite()
+{
+  static const OfxImageEffectSuiteV1 s = {
+    GetPropertySet,
+    GetParamSet,
+    ClipDefine,
+    ClipGetHandle,
+    ClipGetPropertySet,
+    ClipGetImage,
+    ClipReleaseImage,
+    ClipGetRegionOfDefinition,
+    Abort,
+    ImageMemoryAlloc,
+    ImageMemoryFree,
+    ImageMemoryLock,
+    ImageMemoryUnlock
+  };
+
+  return &s;
+}
+
+const OfxParameterSuiteV1 *OpenFXImageEffect::parameter_suite()
+{
+  static const OfxParameterSuiteV1 s = {
+    ParamDefine,
+    ParamGetHandle,
+    ParamSetGetPropertySet,
+    ParamGetPropertySet,
+    ParamGetValue,
+    ParamGetValueAtTime,
+    ParamGetDerivative,
+    ParamGetIntegral,
+    ParamSetValue,
+    ParamSetValueAtTime,
+    ParamGetNumKeys,
+    ParamGetKeyTime,
+    ParamGetKeyIndex,
+    ParamDeleteKey,
+    ParamDeleteAllKeys,
+    ParamCopy,
+    ParamEditBegin,
+    ParamEditEnd
+  };
+
+  return &s;
+}
+
+OpenFXClip *OpenFXImageEffect::AddClip(const QByteArray &name, const OpenFXPropertySet &properties)
+{
+  OpenFXClip* c = new OpenFXClip(this, name, properties);
+  clips_.append(c);
+  return c;
+}
+
+OpenFXParam *OpenFXImageEffect::AddParam(const QByteArray &name, const OpenFXPropertySet &properties)
+{
+  OpenFXParam* p = new OpenFXParam(this, name, properties);
+  params_.append(p);
+  return p;
+}
+
+QVariant OpenFXImageEffect::GetParamValue(const OpenFXParam *param, double time) const
+{
+  QString input = QString::fromUtf8(param->name());
+
+  // Values at the frame being rendered were already resolved by the traverser
+  if (render_job_ && qFuzzyCompare(time + 1.0, render_time_ + 1.0)) {
+    NodeValue v = render_job_->GetValue(input);
+    if (v.type() != NodeValue::kNone) {
+      return v.data();
+    }
+  }
+
+  if (node_ && node_->HasInputWithID(input)) {
+    double frame_rate = render_job_ ? render_frame_rate_ : properties_.GetDouble(kOfxImageEffectPropFrameRate);
+
+    if (frame_rate > 0) {
+      return node_->GetValueAtTime(input, rational::fromDouble(time / frame_rate));
+    } else {
+      return node_->GetStandardValue(input);
+    }
+  }
+
+  // Secret or unsupported parameters keep their defaults
+  return GetDefaultValue(param);
+}
+
+void OpenFXImageEffect::SetProjectProperties(const VideoParams &params)
+{
+  double par = params.pixel_aspect_ratio().toDouble();
+  QVector<double> size = {params.width() * par, double(params.height())};
+
+  properties_.SetDoubles(kOfxImageEffectPropProjectSize, size);
+  properties_.SetDoubles(kOfxImageEffectPropProjectExtent, size);
+  properties_.SetDoubles(kOfxImageEffectPropProjectOffset, {0.0, 0.0});
+  properties_.SetDouble(kOfxImageEffectPropProjectPixelAspectRatio, par);
+  properties_.SetDouble(kOfxImageEffectPropFrameRate, params.frame_rate().toDouble());
+}
+
+FramePtr OpenFXImageEffect::CreateConvertedFrame(const Frame *like, const Frame *src, VideoParams::Format format, int channel_count)
+{
+  VideoParams p = like->video_params();
+  p.set_format(format);
+  p.set_channel_count(channel_count);
+
+  FramePtr f = Frame::Create();
+  f->set_video_params(p);
+  f->allocate();
+
+  if (src) {
+    ConvertPixels(src, f.get());
+  }
+
+  return f;
+}
+
+void OpenFXImageEffect::ConvertPixels(const Frame *src, Frame *dst)
+{
+  int height = qMin(src->height(), dst->height());
+  int width = qMin(src->width(), dst->width());
+  int band_count = qMax(1, qMin(OpenFXHost::thread_pool()->maxThreadCount(), height / kMinimumRowsPerTile));
+  int rows_per_band = (height + band_count - 1) / band_count;
+
+  OpenFXHost::RunParallel([src, dst, width, height, rows_per_band](unsigned int index, unsigned int count){
+    Q_UNUSED(count)
+
+    int end = qMin(height, int(index + 1) * rows_per_band);
+    for (int y=int(index)*rows_per_band; y<end; y++) {
+      for (int x=0; x<width; x++) {
+        dst->set_pixel(x, y, src->get_pixel(x, y));
+      }
+    }
+  }, band_count);
+}
+
+OfxStatus OpenFXImageEffect::WriteParamValue(OpenFXParam *param, const QVariant &v, va_list args)
+{
+  QByteArray type = param->type();
+
+  if (type == kOfxParamTypeDouble) {
+    *va_arg(args, double*) = v.toDouble();
+  } else if (type == kOfxParamTypeInteger || type == kOfxParamTypeChoice) {
+    *va_arg(args, int*) = v.toInt();
+  } else if (type == kOfxParamTypeBoolean) {
+    *va_arg(args, int*) = v.toBool();
+  } else if (type == kOfxParamTypeRGBA || type == kOfxParamTypeRGB) {
+    Color c = v.value<Color>();
+    *va_arg(args, double*) = c.red();
+    *va_arg(args, double*) = c.green();
+    *va_arg(args, double*) = c.blue();
+    if (type == kOfxParamTypeRGBA) {
+      *va_arg(args, double*) = c.alpha();
+    }
+  } else if (type == kOfxParamTypeDouble2D) {
+    QVector2D vec = v.value<QVector2D>();
+    *va_arg(args, double*) = vec.x();
+    *va_arg(args, double*) = vec.y();
+  } else if (type == kOfxParamTypeInteger2D) {
+    QVector2D vec = v.value<QVector2D>();
+    *va_arg(args, int*) = qRound(vec.x());
+    *va_arg(args, int*) = qRound(vec.y());
+  } else if (type == kOfxParamTypeDouble3D) {
+    QVector3D vec = v.value<QVector3D>();
+    *va_arg(args, double*) = vec.x();
+    *va_arg(args, double*) = vec.y();
+    *va_arg(args, double*) = vec.z();
+  } else if (type == kOfxParamTypeInteger3D) {
+    QVector3D vec = v.value<QVector3D>();
+    *va_arg(args, int*) = qRound(vec.x());
+    *va_arg(args, int*) = qRound(vec.y());
+    *va_arg(args, int*) = qRound(vec.z());
+  } else if (type == kOfxParamTypeString) {
+    *va_arg(args, const char**) = param->StoreString(v.toString().toUtf8());
+  } else {
+    return kOfxStatErrUnsupported;
+  }
+
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::GetPropertySet(OfxImageEffectHandle effect, OfxPropertySetHandle *props)
+{
+  if (!effect) return kOfxStatErrBadHandle;
+  *props = FromHandle(effect)->properties_.handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::GetParamSet(OfxImageEffectHandle effect, OfxParamSetHandle *params)
+{
+  if (!effect) return kOfxStatErrBadHandle;
+
+  // The effect doubles as its own parameter set
+  *params = reinterpret_cast<OfxParamSetHandle>(FromHandle(effect));
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ClipDefine(OfxImageEffectHandle effect, const char *name, OfxPropertySetHandle *props)
+{
+  if (!effect) return kOfxStatErrBadHandle;
+
+  OpenFXImageEffect* e = FromHandle(effect);
+  if (e->is_instance_) return kOfxStatErrBadHandle;
+  if (e->GetClip(name)) return kOfxStatErrExists;
+
+  OpenFXPropertySet p;
+  p.SetString(kOfxPropType, kOfxTypeClip);
+  p.SetString(kOfxPropName, name);
+  p.SetString(kOfxPropLabel, name);
+  p.SetInt(kOfxImageClipPropOptional, 0);
+  p.SetInt(kOfxImageClipPropIsMask, 0);
+  p.SetInt(kOfxImageEffectPropSupportsTiles, 1);
+  p.SetInt(kOfxImageEffectPropTemporalClipAccess, 0);
+  p.SetString(kOfxImageClipPropFieldExtraction, kOfxImageFieldDoubled);
+
+  *props = e->AddClip(name, p)->properties()->handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ClipGetHandle(OfxImageEffectHandle effect, const char *name, OfxImageClipHandle *clip, OfxPropertySetHandle *props)
+{
+  if (!effect) return kOfxStatErrBadHandle;
+
+  OpenFXClip* c = FromHandle(effect)->GetClip(name);
+  if (!c) return kOfxStatErrUnknown;
+
+  *clip = c->handle();
+  if (props) {
+    *props = c->properties()->handle();
+  }
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ClipGetPropertySet(OfxImageClipHandle clip, OfxPropertySetHandle *props)
+{
+  if (!clip) return kOfxStatErrBadHandle;
+  *props = OpenFXClip::FromHandle(clip)->properties()->handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ClipGetImage(OfxImageClipHandle clip, OfxTime time, const OfxRectD *region, OfxPropertySetHandle *image)
+{
+  Q_UNUSED(time)
+  Q_UNUSED(region)
+
+  if (!clip) return kOfxStatErrBadHandle;
+
+  OpenFXClip* c = OpenFXClip::FromHandle(clip);
+  OpenFXImageEffect* e = c->effect();
+
+  // Temporal access isn't offered, so every request gets the frame being rendered. The whole frame
+  // is always available, so the region is ignored too.
+  FramePtr f = e->render_frames_.value(c);
+  if (!f) return kOfxStatFailed;
+
+  OpenFXImage* img = new OpenFXImage();
+  img->frame = f;
+
+  // OpenFX rows go bottom to top, so point at our last row and step backwards
+  int linesize = f->linesize_bytes();
+
+  img->SetString(kOfxPropType, kOfxTypeImage);
+  img->SetString(kOfxImageEffectPropPixelDepth, e->render_depth_);
+  img->SetString(kOfxImageEffectPropComponents, f->channel_count() == VideoParams::kRGBAChannelCount ? kOfxImageComponentRGBA : kOfxImageComponentRGB);
+  img->SetString(kOfxImageEffectPropPreMultiplication, kOfxImagePreMultiplied);
+  img->SetDoubles(kOfxImageEffectPropRenderScale, {e->render_scale_, e->render_scale_});
+  img->SetDouble(kOfxImagePropPixelAspectRatio, e->render_pixel_aspect_);
+  img->SetPointer(kOfxImagePropData, f->data() + (f->height() - 1) * linesize);
+  img->SetInts(kOfxImagePropBounds, {0, 0, f->width(), f->height()});
+  img->SetInts(kOfxImagePropRegionOfDefinition, {0, 0, f->width(), f->height()});
+  img->SetInt(kOfxImagePropRowBytes, -linesize);
+  img->SetString(kOfxImagePropField, kOfxImageFieldNone);
+  img->SetString(kOfxImagePropUniqueIdentifier, QByteArray::number(quintptr(f.get()), 16));
+
+  *image = img->handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ClipReleaseImage(OfxPropertySetHandle image)
+{
+  if (!image) return kOfxStatErrBadHandle;
+  delete static_cast<OpenFXImage*>(OpenFXPropertySet::FromHandle(image));
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ClipGetRegionOfDefinition(OfxImageClipHandle clip, OfxTime time, OfxRectD *bounds)
+{
+  Q_UNUSED(time)
+
+  if (!clip) return kOfxStatErrBadHandle;
+
+  OpenFXClip* c = OpenFXClip::FromHandle(clip);
+  OpenFXImageEffect* e = c->effect();
+  FramePtr f = e->render_frames_.value(c);
+
+  bounds->x1 = 0;
+  bounds->y1 = 0;
+
+  if (f) {
+    // Canonical coordinates are full-resolution and square-pixel
+    bounds->x2 = f->width() / e->render_scale_ * e->render_pixel_aspect_;
+    bounds->y2 = f->height() / e->render_scale_;
+  } else {
+    bounds->x2 = e->properties_.GetDouble(kOfxImageEffectPropProjectSize, 0);
+    bounds->y2 = e->properties_.GetDouble(kOfxImageEffectPropProjectSize, 1);
+  }
+
+  return kOfxStatOK;
+}
+
+int OpenFXImageEffect::Abort(OfxImageEffectHandle effect)
+{
+  Q_UNUSED(effect)
+
+  return 0;
+}
+
+OfxStatus OpenFXImageEffect::ImageMemoryAlloc(OfxImageEffectHandle effect, size_t bytes, OfxImageMemoryHandle *memory)
+{
+  Q_UNUSED(effect)
+
+  void* data = qMallocAligned(bytes, 64);
+  if (!data) return kOfxStatErrMemory;
+
+  *memory = reinterpret_cast<OfxImageMemoryHandle>(new OpenFXImageMemory{data});
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ImageMemoryFree(OfxImageMemoryHandle memory)
+{
+  if (!memory) return kOfxStatErrBadHandle;
+
+  OpenFXImageMemory* m = reinterpret_cast<OpenFXImageMemory*>(memory);
+  qFreeAligned(m->data);
+  delete m;
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ImageMemoryLock(OfxImageMemoryHandle memory, void **data)
+{
+  if (!memory) return kOfxStatErrBadHandle;
+
+  // Memory never moves, locking just hands out the pointer
+  *data = reinterpret_cast<OpenFXImageMemory*>(memory)->data;
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ImageMemoryUnlock(OfxImageMemoryHandle memory)
+{
+  if (!memory) return kOfxStatErrBadHandle;
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ParamDefine(OfxParamSetHandle set, const char *type, const char *name, OfxPropertySetHandle *props)
+{
+  if (!set) return kOfxStatErrBadHandle;
+
+  OpenFXImageEffect* e = reinterpret_cast<OpenFXImageEffect*>(set);
+  if (e->is_instance_) return kOfxStatErrBadHandle;
+  if (e->GetParam(name)) return kOfxStatErrExists;
+
+  bool animates = !qstrcmp(type, kOfxParamTypeDouble)
+      || !qstrcmp(type, kOfxParamTypeInteger)
+      || !qstrcmp(type, kOfxParamTypeRGBA)
+      || !qstrcmp(type, kOfxParamTypeRGB)
+      || !qstrcmp(type, kOfxParamTypeDouble2D)
+      || !qstrcmp(type, kOfxParamTypeInteger2D)
+      || !qstrcmp(type, kOfxParamTypeDouble3D)
+      || !qstrcmp(type, kOfxParamTypeInteger3D);
+
+  OpenFXPropertySet p;
+  p.SetString(kOfxPropType, kOfxTypeParameter);
+  p.SetString(kOfxParamPropType, type);
+  p.SetString(kOfxPropName, name);
+  p.SetString(kOfxPropLabel, name);
+  p.SetInt(kOfxParamPropAnimates, animates);
+  p.SetInt(kOfxParamPropSecret, 0);
+  p.SetInt(kOfxParamPropEnabled, 1);
+  p.SetInt(kOfxParamPropCanUndo, 1);
+
+  *props = e->AddParam(name, p)->properties()->handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ParamGetHandle(OfxParamSetHandle set, const char *name, OfxParamHandle *param, OfxPropertySetHandle *props)
+{
+  if (!set) return kOfxStatErrBadHandle;
+
+  OpenFXParam* p = reinterpret_cast<OpenFXImageEffect*>(set)->GetParam(name);
+  if (!p) return kOfxStatErrUnknown;
+
+  *param = p->handle();
+  if (props) {
+    *props = p->properties()->handle();
+  }
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ParamSetGetPropertySet(OfxParamSetHandle set, OfxPropertySetHandle *props)
+{
+  if (!set) return kOfxStatErrBadHandle;
+  *props = reinterpret_cast<OpenFXImageEffect*>(set)->param_set_properties_.handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ParamGetPropertySet(OfxParamHandle param, OfxPropertySetHandle *props)
+{
+  if (!param) return kOfxStatErrBadHandle;
+  *props = OpenFXParam::FromHandle(param)->properties()->handle();
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ParamGetValue(OfxParamHandle param, ...)
+{
+  if (!param) return kOfxStatErrBadHandle;
+
+  OpenFXParam* p = OpenFXParam::FromHandle(param);
+  const OpenFXImageEffect* e = p->effect();
+
+  va_list args;
+  va_start(args, param);
+  OfxStatus status = WriteParamValue(p, e->GetParamValue(p, e->render_time_), args);
+  va_end(args);
+
+  return status;
+}
+
+OfxStatus OpenFXImageEffect::ParamGetValueAtTime(OfxParamHandle param, OfxTime time, ...)
+{
+  if (!param) return kOfxStatErrBadHandle;
+
+  OpenFXParam* p = OpenFXParam::FromHandle(param);
+
+  va_list args;
+  va_start(args, time);
+  OfxStatus status = WriteParamValue(p, p->effect()->GetParamValue(p, time), args);
+  va_end(args);
+
+  return status;
+}
+
+OfxStatus OpenFXImageEffect::ParamGetDerivative(OfxParamHandle param, OfxTime time, ...)
+{
+  Q_UNUSED(param)
+  Q_UNUSED(time)
+
+  return kOfxStatErrUnsupported;
+}
+
+OfxStatus OpenFXImageEffect::ParamGetIntegral(OfxParamHandle param, OfxTime time1, OfxTime time2, ...)
+{
+  Q_UNUSED(param)
+  Q_UNUSED(time1)
+  Q_UNUSED(time2)
+
+  return kOfxStatErrUnsupported;
+}
+
+OfxStatus OpenFXImageEffect::ParamSetValue(OfxParamHandle param, ...)
+{
+  Q_UNUSED(param)
+
+  // Values belong to the node and are only changed through its undoable inputs
+  return kOfxStatFailed;
+}
+
+OfxStatus OpenFXImageEffect::ParamSetValueAtTime(OfxParamHandle param, OfxTime time, ...)
+{
+  Q_UNUSED(param)
+  Q_UNUSED(time)
+
+  return kOfxStatFailed;
+}
+
+OfxStatus OpenFXImageEffect::ParamGetNumKeys(OfxParamHandle param, unsigned int *count)
+{
+  if (!param) return kOfxStatErrBadHandle;
+
+  // Keyframes stay with the node, plugins sample values through paramGetValueAtTime() instead
+  *count = 0;
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ParamGetKeyTime(OfxParamHandle param, unsigned int nth, OfxTime *time)
+{
+  Q_UNUSED(param)
+  Q_UNUSED(nth)
+  Q_UNUSED(time)
+
+  return kOfxStatErrBadIndex;
+}
+
+OfxStatus OpenFXImageEffect::ParamGetKeyIndex(OfxParamHandle param, OfxTime time, int direction, int *index)
+{
+  Q_UNUSED(param)
+  Q_UNUSED(time)
+  Q_UNUSED(direction)
+  Q_UNUSED(index)
+
+  return kOfxStatFailed;
+}
+
+OfxStatus OpenFXImageEffect::ParamDeleteKey(OfxParamHandle param, OfxTime time)
+{
+  Q_UNUSED(param)
+  Q_UNUSED(time)
+
+  return kOfxStatErrBadIndex;
+}
+
+OfxStatus OpenFXImageEffect::ParamDeleteAllKeys(OfxParamHandle param)
+{
+  Q_UNUSED(param)
+
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ParamCopy(OfxParamHandle to, OfxParamHandle from, OfxTime offset, const OfxRangeD *range)
+{
+  Q_UNUSED(to)
+  Q_UNUSED(from)
+  Q_UNUSED(offset)
+  Q_UNUSED(range)
+
+  return kOfxStatErrUnsupported;
+}
+
+OfxStatus OpenFXImageEffect::ParamEditBegin(OfxParamSetHandle set, const char *name)
+{
+  Q_UNUSED(set)
+  Q_UNUSED(name)
+
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXImageEffect::ParamEditEnd(OfxParamSetHandle set)
+{
+  Q_UNUSED(set)
+
+  return kOfxStatOK;
+}
+
+}
+
+#endif // USE_OPENFX
@@ -0,0 +1,311 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OPENFXIMAGEEFFECT_H
+#define OPENFXIMAGEEFFECT_H
+
+#ifdef USE_OPENFX
+
+#include <cstdarg>
+#include <ofxImageEffect.h>
+#include <ofxParam.h>
+#include <QMutex>
+#include <QSet>
+
+#include "codec/frame.h"
+#include "common/define.h"
+#include "openfxpropertyset.h"
+#include "render/job/generatejob.h"
+
+namespace olive {
+
+class Node;
+class OpenFXImageEffect;
+class OpenFXPlugin;
+
+class OpenFXClip
+{
+public:
+  OpenFXClip(OpenFXImageEffect* effect, const QByteArray& name, const OpenFXPropertySet& properties);
+
+  OfxImageClipHandle handle()
+  {
+    return reinterpret_cast<OfxImageClipHandle>(this);
+  }
+
+  static OpenFXClip* FromHandle(OfxImageClipHandle h)
+  {
+    return reinterpret_cast<OpenFXClip*>(h);
+  }
+
+  OpenFXImageEffect* effect() const
+  {
+    return effect_;
+  }
+
+  const QByteArray& name() const
+  {
+    return name_;
+  }
+
+  OpenFXPropertySet* properties()
+  {
+    return &properties_;
+  }
+
+  const OpenFXPropertySet* properties() const
+  {
+    return &properties_;
+  }
+
+  bool IsOutput() const;
+
+private:
+  OpenFXImageEffect* effect_;
+
+  QByteArray name_;
+
+  OpenFXPropertySet properties_;
+
+};
+
+class OpenFXParam
+{
+public:
+  OpenFXParam(OpenFXImageEffect* effect, const QByteArray& name, const OpenFXPropertySet& properties);
+
+  OfxParamHandle handle()
+  {
+    return reinterpret_cast<OfxParamHandle>(this);
+  }
+
+  static OpenFXParam* FromHandle(OfxParamHandle h)
+  {
+    return reinterpret_cast<OpenFXParam*>(h);
+  }
+
+  OpenFXImageEffect* effect() const
+  {
+    return effect_;
+  }
+
+  const QByteArray& name() const
+  {
+    return name_;
+  }
+
+  QByteArray type() const
+  {
+    return properties_.GetString(kOfxParamPropType);
+  }
+
+  OpenFXPropertySet* properties()
+  {
+    return &properties_;
+  }
+
+  const OpenFXPropertySet* properties() const
+  {
+    return &properties_;
+  }
+
+  /**
+   * @brief Keep a string value alive for as long as the plugin may hold on to it
+   */
+  const char* StoreString(const QByteArray& s);
+
+private:
+  OpenFXImageEffect* effect_;
+
+  QByteArray name_;
+
+  OpenFXPropertySet properties_;
+
+  QMutex strings_lock_;
+
+  QSet<QByteArray> strings_;
+
+};
+
+/**
+ * @brief Backing store for an OpenFX image effect handle, either a descriptor or an instance
+ *
+ * Instances belong to one node and render one frame at a time (see OpenFXNode::GenerateFrame()).
+ * Images handed to the plugin point straight into the frames the renderer downloaded, with a
+ * negative row stride since OpenFX counts rows from the bottom. Frames are only converted when the
+ * plugin doesn't support their pixel depth or channel layout.
+ */
+class OpenFXImageEffect
+{
+public:
+  /**
+   * @brief Create a descriptor
+   */
+  OpenFXImageEffect(OpenFXPlugin* plugin, const OpenFXPropertySet& properties = OpenFXPropertySet());
+
+  ~OpenFXImageEffect();
+
+  DISABLE_COPY_MOVE(OpenFXImageEffect)
+
+  /**
+   * @brief Create an instance of `plugin` whose parameters are read from `node`
+   *
+   * `params` describes the sequence the instance will render for. Returns nullptr if the plugin
+   * fails to create the instance.
+   */
+  static OpenFXImageEffect* CreateInstance(OpenFXPlugin* plugin, const Node* node, const VideoParams& params);
+
+  OfxImageEffectHandle handle()
+  {
+    return reinterpret_cast<OfxImageEffectHandle>(this);
+  }
+
+  static OpenFXImageEffect* FromHandle(OfxImageEffectHandle h)
+  {
+    return reinterpret_cast<OpenFXImageEffect*>(h);
+  }
+
+  OpenFXPropertySet* properties()
+  {
+    return &properties_;
+  }
+
+  const OpenFXPropertySet* properties() const
+  {
+    return &properties_;
+  }
+
+  OpenFXClip* GetClip(const char* name) const;
+
+  const QVector<OpenFXClip*>& clips() const
+  {
+    return clips_;
+  }
+
+  OpenFXParam* GetParam(const char* name) const;
+
+  const QVector<OpenFXParam*>& params() const
+  {
+    return params_;
+  }
+
+  /**
+   * @brief Render into `output` at `time` (in frames) with the inputs and values in `job`
+   */
+  bool Render(FramePtr output, const GenerateJob& job, double time);
+
+  static QByteArray GetPixelDepthFromFormat(VideoParams::Format format);
+
+  static VideoParams::Format GetFormatFromPixelDepth(const QByteArray& depth);
+
+  /**
+   * @brief A parameter's default value in the form OpenFXNode stores it in its input
+   */
+  static QVariant GetDefaultValue(const OpenFXParam* param);
+
+  static const OfxImageEffectSuiteV1* effect_suite();
+
+  static const OfxParameterSuiteV1* parameter_suite();
+
+  static const int kMinimumRowsPerTile;
+
+private:
+  OpenFXClip* AddClip(const QByteArray& name, const OpenFXPropertySet& properties);
+
+  OpenFXParam* AddParam(const QByteArray& name, const OpenFXPropertySet& properties);
+
+  QVariant GetParamValue(const OpenFXParam* param, double time) const;
+
+  void SetProjectProperties(const VideoParams& params);
+
+  /**
+   * @brief Convert `src` into a new frame of `format` and `channel_count`
+   *
+   * Passing a null `src` only allocates the new frame, taking its size from `like`.
+   */
+  static FramePtr CreateConvertedFrame(const Frame* like, const Frame* src, VideoParams::Format format, int channel_count);
+
+  static void ConvertPixels(const Frame* src, Frame* dst);
+
+  static OfxStatus WriteParamValue(OpenFXParam* param, const QVariant& v, va_list args);
+
+  static OfxStatus GetPropertySet(OfxImageEffectHandle effect, OfxPropertySetHandle *props);
+  static OfxStatus GetParamSet(OfxImageEffectHandle effect, OfxParamSetHandle *params);
+  static OfxStatus ClipDefine(OfxImageEffectHandle effect, const char *name, OfxPropertySetHandle *props);
+  static OfxStatus ClipGetHandle(OfxImageEffectHandle effect, const char *name, OfxImageClipHandle *clip, OfxPropertySetHandle *props);
+  static OfxStatus ClipGetPropertySet(OfxImageClipHandle clip, OfxPropertySetHandle *props);
+  static OfxStatus ClipGetImage(OfxImageClipHandle clip, OfxTime time, const OfxRectD *region, OfxPropertySetHandle *image);
+  static OfxStatus ClipReleaseImage(OfxPropertySetHandle image);
+  static OfxStatus ClipGetRegionOfDefinition(OfxImageClipHandle clip, OfxTime time, OfxRectD *bounds);
+  static int Abort(OfxImageEffectHandle effect);
+  static OfxStatus ImageMemoryAlloc(OfxImageEffectHandle effect, size_t bytes, OfxImageMemoryHandle *memory);
+  static OfxStatus ImageMemoryFree(OfxImageMemoryHandle memory);
+  static OfxStatus ImageMemoryLock(OfxImageMemoryHandle memory, void **data);
+  static OfxStatus ImageMemoryUnlock(OfxImageMemoryHandle memory);
+
+  static OfxStatus ParamDefine(OfxParamSetHandle set, const char *type, const char *name, OfxPropertySetHandle *props);
+  static OfxStatus ParamGetHandle(OfxParamSetHandle set, const char *name, OfxParamHandle *param, OfxPropertySetHandle *props);
+  static OfxStatus ParamSetGetPropertySet(OfxParamSetHandle set, OfxPropertySetHandle *props);
+  static OfxStatus ParamGetPropertySet(OfxParamHandle param, OfxPropertySetHandle *props);
+  static OfxStatus ParamGetValue(OfxParamHandle param, ...);
+  static OfxStatus ParamGetValueAtTime(OfxParamHandle param, OfxTime time, ...);
+  static OfxStatus ParamGetDerivative(OfxParamHandle param, OfxTime time, ...);
+  static OfxStatus ParamGetIntegral(OfxParamHandle param, OfxTime time1, OfxTime time2, ...);
+  static OfxStatus ParamSetValue(OfxParamHandle param, ...);
+  static OfxStatus ParamSetValueAtTime(OfxParamHandle param, OfxTime time, ...);
+  static OfxStatus ParamGetNumKeys(OfxParamHandle param, unsigned int *count);
+  static OfxStatus ParamGetKeyTime(OfxParamHandle param, unsigned int nth, OfxTime *time);
+  static OfxStatus ParamGetKeyIndex(OfxParamHandle param, OfxTime time, int direction, int *index);
+  static OfxStatus ParamDeleteKey(OfxParamHandle param, OfxTime time);
+  static OfxStatus ParamDeleteAllKeys(OfxParamHandle param);
+  static OfxStatus ParamCopy(OfxParamHandle to, OfxParamHandle from, OfxTime offset, const OfxRangeD *range);
+  static OfxStatus ParamEditBegin(OfxParamSetHandle set, const char *name);
+  static OfxStatus ParamEditEnd(OfxParamSetHandle set);
+
+  OpenFXPlugin* plugin_;
+
+  bool is_instance_;
+
+  const Node* node_;
+
+  OpenFXPropertySet properties_;
+
+  OpenFXPropertySet param_set_properties_;
+
+  QVector<OpenFXClip*> clips_;
+
+  QVector<OpenFXParam*> params_;
+
+  // Only valid during Render()
+  const GenerateJob* render_job_;
+  double render_time_;
+  double render_frame_rate_;
+  double render_scale_;
+  double render_pixel_aspect_;
+  QByteArray render_depth_;
+  QHash<const OpenFXClip*, FramePtr> render_frames_;
+
+};
+
+}
+
+#endif // USE_OPENFX
+
+#endif // OPENFXIMAGEEFFECT_H
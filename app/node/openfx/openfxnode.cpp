@@ -0,0 +1,238 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "openfxnode.h"
+
+#ifdef USE_OPENFX
+
+#include <cstring>
+#include <QDebug>
+
+namespace olive {
+
+const QString OpenFXNode::kTimeKey = QStringLiteral("ofx:time");
+
+OpenFXNode::OpenFXNode(OpenFXPlugin *plugin) :
+  plugin_(plugin)
+{
+  OpenFXImageEffect* descriptor = plugin_->descriptor();
+
+  foreach (OpenFXClip* clip, descriptor->clips()) {
+    if (!clip->IsOutput()) {
+      AddInput(QString::fromUtf8(clip->name()), NodeValue::kTexture, InputFlags(kInputFlagNotKeyframable));
+    }
+  }
+
+  foreach (OpenFXParam* param, descriptor->params()) {
+    const OpenFXPropertySet* props = param->properties();
+
+    NodeValue::Type type = GetValueTypeForParam(param);
+    if (type == NodeValue::kNone || props->GetInt(kOfxParamPropSecret)) {
+      // Plugins still read these, they just always get the default
+      continue;
+    }
+
+    QString id = QString::fromUtf8(param->name());
+
+    InputFlags flags(props->GetInt(kOfxParamPropAnimates) ? kInputFlagNormal : kInputFlagNotKeyframable);
+
+    AddInput(id, type, OpenFXImageEffect::GetDefaultValue(param), flags);
+
+    if (type == NodeValue::kFloat || type == NodeValue::kInt) {
+      // Plugins commonly leave these at the limits of the type, which would only get in the way
+      static const double kUnboundedLimit = 1e30;
+
+      double min = props->GetDouble(kOfxParamPropMin, 0, -kUnboundedLimit);
+      double max = props->GetDouble(kOfxParamPropMax, 0, kUnboundedLimit);
+
+      if (min > -kUnboundedLimit && min < kUnboundedLimit) {
+        SetInputProperty(id, QStringLiteral("min"), min);
+      }
+      if (max > -kUnboundedLimit && max < kUnboundedLimit) {
+        SetInputProperty(id, QStringLiteral("max"), max);
+      }
+    } else if (type == NodeValue::kCombo) {
+      QStringList options;
+      foreach (const QByteArray& o, props->GetStrings(kOfxParamPropChoiceOption)) {
+        options.append(QString::fromUtf8(o));
+      }
+      SetComboBoxStrings(id, options);
+    }
+  }
+}
+
+OpenFXNode::~OpenFXNode()
+{
+  DisconnectAll();
+
+  qDeleteAll(idle_instances_);
+}
+
+QVector<Node::CategoryID> OpenFXNode::Category() const
+{
+  if (plugin_->context() == kOfxImageEffectContextGenerator) {
+    return {kCategoryGenerator};
+  } else {
+    return {kCategoryFilter};
+  }
+}
+
+QString OpenFXNode::Description() const
+{
+  QString d = plugin_->description();
+  return d.isEmpty() ? plugin_->grouping() : d;
+}
+
+void OpenFXNode::Retranslate()
+{
+  // Plugins only provide one language for their labels
+  OpenFXImageEffect* descriptor = plugin_->descriptor();
+
+  foreach (OpenFXClip* clip, descriptor->clips()) {
+    QString id = QString::fromUtf8(clip->name());
+    if (HasInputWithID(id)) {
+      SetInputName(id, QString::fromUtf8(clip->properties()->GetString(kOfxPropLabel, 0, clip->name())));
+    }
+  }
+
+  foreach (OpenFXParam* param, descriptor->params()) {
+    QString id = QString::fromUtf8(param->name());
+    if (HasInputWithID(id)) {
+      SetInputName(id, QString::fromUtf8(param->properties()->GetString(kOfxPropLabel, 0, param->name())));
+    }
+  }
+}
+
+NodeValueTable OpenFXNode::Value(const QString &output, NodeValueDatabase &value) const
+{
+  Q_UNUSED(output)
+
+  GenerateJob job;
+
+  foreach (const QString& input, inputs()) {
+    job.InsertValue(this, input, value);
+  }
+
+  job.InsertValue(kTimeKey, NodeValue(NodeValue::kFloat,
+                                      value[QStringLiteral("global")].Get(NodeValue::kFloat, QStringLiteral("time_in")),
+                                      this));
+  job.SetAlphaChannelRequired(GenerateJob::kAlphaForceOn);
+  job.SetDownloadTextures(true);
+
+  NodeValueTable table = value.Merge();
+
+  // Nothing to render without the plugin's mandatory inputs
+  foreach (OpenFXClip* clip, plugin_->descriptor()->clips()) {
+    if (!clip->IsOutput()
+        && !clip->properties()->GetInt(kOfxImageClipPropOptional)
+        && !job.GetValue(QString::fromUtf8(clip->name())).data().value<TexturePtr>()) {
+      return table;
+    }
+  }
+
+  table.Push(NodeValue::kGenerateJob, QVariant::fromValue(job), this);
+
+  return table;
+}
+
+void OpenFXNode::GenerateFrame(FramePtr frame, const GenerateJob &job) const
+{
+  // OpenFX counts time in frames
+  double time = job.GetValue(kTimeKey).data().toDouble() * frame->video_params().frame_rate().toDouble();
+
+  OpenFXImageEffect* instance = TakeInstance(frame->video_params());
+
+  if (!instance || !instance->Render(frame, job, time)) {
+    qWarning() << "OpenFX plugin" << plugin_->identifier() << "failed to render";
+    memset(frame->data(), 0, frame->allocated_size());
+  }
+
+  if (instance) {
+    ReturnInstance(instance);
+  }
+}
+
+void OpenFXNode::Hash(const QString &output, Hasher &hash, const rational &time, const VideoParams &video_params) const
+{
+  Node::Hash(output, hash, time, video_params);
+
+  // Plugins may vary over time with the same inputs (e.g. grain), which we can't tell from outside
+  hash.add(time);
+}
+
+QVector<TimeRange> OpenFXNode::GetConstantRanges(const QString &output, const TimeRange &range) const
+{
+  Q_UNUSED(output)
+  Q_UNUSED(range)
+
+  // Mirrors Hash(), which includes the time
+  return QVector<TimeRange>();
+}
+
+NodeValue::Type OpenFXNode::GetValueTypeForParam(const OpenFXParam *param)
+{
+  QByteArray type = param->type();
+
+  if (type == kOfxParamTypeDouble) {
+    return NodeValue::kFloat;
+  } else if (type == kOfxParamTypeInteger) {
+    return NodeValue::kInt;
+  } else if (type == kOfxParamTypeBoolean) {
+    return NodeValue::kBoolean;
+  } else if (type == kOfxParamTypeChoice) {
+    return NodeValue::kCombo;
+  } else if (type == kOfxParamTypeRGBA || type == kOfxParamTypeRGB) {
+    return NodeValue::kColor;
+  } else if (type == kOfxParamTypeDouble2D || type == kOfxParamTypeInteger2D) {
+    return NodeValue::kVec2;
+  } else if (type == kOfxParamTypeDouble3D || type == kOfxParamTypeInteger3D) {
+    return NodeValue::kVec3;
+  } else if (type == kOfxParamTypeString) {
+    return NodeValue::kText;
+  }
+
+  // Groups, pages, buttons and custom parameters have no value we can edit
+  return NodeValue::kNone;
+}
+
+OpenFXImageEffect *OpenFXNode::TakeInstance(const VideoParams &params) const
+{
+  {
+    QMutexLocker locker(&instance_lock_);
+
+    if (!idle_instances_.isEmpty()) {
+      return idle_instances_.takeLast();
+    }
+  }
+
+  // Every render running at once gets its own instance
+  return OpenFXImageEffect::CreateInstance(plugin_, this, params);
+}
+
+void OpenFXNode::ReturnInstance(OpenFXImageEffect *instance) const
+{
+  QMutexLocker locker(&instance_lock_);
+
+  idle_instances_.append(instance);
+}
+
+}
+
+#endif // USE_OPENFX
@@ -0,0 +1,103 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OPENFXNODE_H
+#define OPENFXNODE_H
+
+#ifdef USE_OPENFX
+
+#include <QMutex>
+
+#include "node/node.h"
+#include "openfxhost.h"
+#include "openfximageeffect.h"
+
+namespace olive {
+
+/**
+ * @brief Node that renders an OpenFX image effect plugin
+ *
+ * Every input clip of the plugin becomes a texture input and every supported parameter a value
+ * input. Renders go through a GenerateJob that asks for its textures downloaded, so the plugin
+ * works directly in the downloaded frames.
+ *
+ * Each concurrent render takes its own plugin instance from a pool, so instance-safe plugins render
+ * several frames at once. Fully thread-safe plugins that leave threading to the host additionally
+ * have each frame split into tiles across the OpenFX thread pool.
+ */
+class OpenFXNode : public Node
+{
+  Q_OBJECT
+public:
+  OpenFXNode(OpenFXPlugin* plugin);
+
+  virtual ~OpenFXNode() override;
+
+  virtual Node* copy() const override
+  {
+    return new OpenFXNode(plugin_);
+  }
+
+  virtual QString Name() const override
+  {
+    return plugin_->label();
+  }
+
+  virtual QString id() const override
+  {
+    return QStringLiteral("ofx.%1").arg(plugin_->identifier());
+  }
+
+  virtual QVector<CategoryID> Category() const override;
+
+  virtual QString Description() const override;
+
+  virtual void Retranslate() override;
+
+  virtual NodeValueTable Value(const QString& output, NodeValueDatabase &value) const override;
+
+  virtual void GenerateFrame(FramePtr frame, const GenerateJob &job) const override;
+
+  virtual void Hash(const QString& output, Hasher& hash, const rational& time, const VideoParams& video_params) const override;
+
+  virtual QVector<TimeRange> GetConstantRanges(const QString& output, const TimeRange& range) const override;
+
+private:
+  static NodeValue::Type GetValueTypeForParam(const OpenFXParam* param);
+
+  OpenFXImageEffect* TakeInstance(const VideoParams& params) const;
+
+  void ReturnInstance(OpenFXImageEffect* instance) const;
+
+  OpenFXPlugin* plugin_;
+
+  mutable QMutex instance_lock_;
+
+  mutable QVector<OpenFXImageEffect*> idle_instances_;
+
+  static const QString kTimeKey;
+
+};
+
+}
+
+#endif // USE_OPENFX
+
+#endif // OPENFXNODE_H
@@ -0,0 +1,362 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "openfxpropertyset.h"
+
+#ifdef USE_OPENFX
+
+#include <ofxCore.h>
+
+namespace olive {
+
+void OpenFXPropertySet::SetPointer(const char *name, void *value, int index)
+{
+  Prepare(name, kPointer, index).pointers[index] = value;
+}
+
+void OpenFXPropertySet::SetString(const char *name, const QByteArray &value, int index)
+{
+  Prepare(name, kString, index).strings[index] = value;
+}
+
+void OpenFXPropertySet::SetDouble(const char *name, double value, int index)
+{
+  Prepare(name, kDouble, index).doubles[index] = value;
+}
+
+void OpenFXPropertySet::SetInt(const char *name, int value, int index)
+{
+  Prepare(name, kInt, index).ints[index] = value;
+}
+
+void OpenFXPropertySet::SetStrings(const char *name, const QVector<QByteArray> &values)
+{
+  Property& p = properties_[name];
+  p = Property();
+  p.type = kString;
+  p.strings = values;
+}
+
+void OpenFXPropertySet::SetDoubles(const char *name, const QVector<double> &values)
+{
+  Property& p = properties_[name];
+  p = Property();
+  p.type = kDouble;
+  p.doubles = values;
+}
+
+void OpenFXPropertySet::SetInts(const char *name, const QVector<int> &values)
+{
+  Property& p = properties_[name];
+  p = Property();
+  p.type = kInt;
+  p.ints = values;
+}
+
+int OpenFXPropertySet::Dimension(const char *name) const
+{
+  const Property* p = Find(name);
+  return p ? p->dimension() : 0;
+}
+
+void *OpenFXPropertySet::GetPointer(const char *name, int index, void *default_value) const
+{
+  const Property* p = Find(name);
+  if (p && p->type == kPointer && index < p->pointers.size()) {
+    return p->pointers.at(index);
+  }
+  return default_value;
+}
+
+QByteArray OpenFXPropertySet::GetString(const char *name, int index, const QByteArray &default_value) const
+{
+  const Property* p = Find(name);
+  if (p && p->type == kString && index < p->strings.size()) {
+    return p->strings.at(index);
+  }
+  return default_value;
+}
+
+double OpenFXPropertySet::GetDouble(const char *name, int index, double default_value) const
+{
+  const Property* p = Find(name);
+  if (p) {
+    if (p->type == kDouble && index < p->doubles.size()) {
+      return p->doubles.at(index);
+    } else if (p->type == kInt && index < p->ints.size()) {
+      return p->ints.at(index);
+    }
+  }
+  return default_value;
+}
+
+int OpenFXPropertySet::GetInt(const char *name, int index, int default_value) const
+{
+  const Property* p = Find(name);
+  if (p) {
+    if (p->type == kInt && index < p->ints.size()) {
+      return p->ints.at(index);
+    } else if (p->type == kDouble && index < p->doubles.size()) {
+      return qRound(p->doubles.at(index));
+    }
+  }
+  return default_value;
+}
+
+QVector<QByteArray> OpenFXPropertySet::GetStrings(const char *name) const
+{
+  const Property* p = Find(name);
+  if (p && p->type == kString) {
+    return p->strings;
+  }
+  return QVector<QByteArray>();
+}
+
+QVector<double> OpenFXPropertySet::GetDoubles(const char *name) const
+{
+  QVector<double> v(Dimension(name));
+  for (int i=0; i<v.size(); i++) {
+    v[i] = GetDouble(name, i);
+  }
+  return v;
+}
+
+const OfxPropertySuiteV1 *OpenFXPropertySet::suite()
+{
+  static const OfxPropertySuiteV1 s = {
+    PropSetPointer,
+    PropSetString,
+    PropSetDouble,
+    PropSetInt,
+    PropSetPointerN,
+    PropSetStringN,
+    PropSetDoubleN,
+    PropSetIntN,
+    PropGetPointer,
+    PropGetString,
+    PropGetDouble,
+    PropGetInt,
+    PropGetPointerN,
+    PropGetStringN,
+    PropGetDoubleN,
+    PropGetIntN,
+    PropReset,
+    PropGetDimension
+  };
+
+  return &s;
+}
+
+OpenFXPropertySet::Property &OpenFXPropertySet::Prepare(const char *name, Type type, int index)
+{
+  Property& p = properties_[name];
+
+  if (p.type != type || p.dimension() == 0) {
+    // New property, or the plugin is redefining it with another type
+    p = Property();
+    p.type = type;
+  }
+
+  int size = qMax(p.dimension(), index + 1);
+  p.pointers.resize(type == kPointer ? size : 0);
+  p.strings.resize(type == kString ? size : 0);
+  p.doubles.resize(type == kDouble ? size : 0);
+  p.ints.resize(type == kInt ? size : 0);
+
+  return p;
+}
+
+const OpenFXPropertySet::Property *OpenFXPropertySet::Find(const char *name) const
+{
+  auto it = properties_.constFind(QByteArray::fromRawData(name, int(qstrlen(name))));
+  return it == properties_.cend() ? nullptr : &it.value();
+}
+
+OfxStatus OpenFXPropertySet::PropSetPointer(OfxPropertySetHandle properties, const char *property, int index, void *value)
+{
+  if (!properties) return kOfxStatErrBadHandle;
+  if (index < 0) return kOfxStatErrBadIndex;
+  FromHandle(properties)->SetPointer(property, value, index);
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropSetString(OfxPropertySetHandle properties, const char *property, int index, const char *value)
+{
+  if (!properties) return kOfxStatErrBadHandle;
+  if (index < 0) return kOfxStatErrBadIndex;
+  FromHandle(properties)->SetString(property, QByteArray(value), index);
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropSetDouble(OfxPropertySetHandle properties, const char *property, int index, double value)
+{
+  if (!properties) return kOfxStatErrBadHandle;
+  if (index < 0) return kOfxStatErrBadIndex;
+  FromHandle(properties)->SetDouble(property, value, index);
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropSetInt(OfxPropertySetHandle properties, const char *property, int index, int value)
+{
+  if (!properties) return kOfxStatErrBadHandle;
+  if (index < 0) return kOfxStatErrBadIndex;
+  FromHandle(properties)->SetInt(property, value, index);
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropSetPointerN(OfxPropertySetHandle properties, const char *property, int count, void * const *value)
+{
+  for (int i=0; i<count; i++) {
+    OfxStatus s = PropSetPointer(properties, property, i, value[i]);
+    if (s != kOfxStatOK) return s;
+  }
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropSetStringN(OfxPropertySetHandle properties, const char *property, int count, const char * const *value)
+{
+  for (int i=0; i<count; i++) {
+    OfxStatus s = PropSetString(properties, property, i, value[i]);
+    if (s != kOfxStatOK) return s;
+  }
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropSetDoubleN(OfxPropertySetHandle properties, const char *property, int count, const double *value)
+{
+  for (int i=0; i<count; i++) {
+    OfxStatus s = PropSetDouble(properties, property, i, value[i]);
+    if (s != kOfxStatOK) return s;
+  }
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropSetIntN(OfxPropertySetHandle properties, const char *property, int count, const int *value)
+{
+  for (int i=0; i<count; i++) {
+    OfxStatus s = PropSetInt(properties, property, i, value[i]);
+    if (s != kOfxStatOK) return s;
+  }
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropGetPointer(OfxPropertySetHandle properties, const char *property, int index, void **value)
+{
+  if (!properties) return kOfxStatErrBadHandle;
+  const Property* p = FromHandle(properties)->Find(property);
+  if (!p) return kOfxStatErrUnknown;
+  if (p->type != kPointer) return kOfxStatErrValue;
+  if (index < 0 || index >= p->pointers.size()) return kOfxStatErrBadIndex;
+  *value = p->pointers.at(index);
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropGetString(OfxPropertySetHandle properties, const char *property, int index, char **value)
+{
+  if (!properties) return kOfxStatErrBadHandle;
+  const Property* p = FromHandle(properties)->Find(property);
+  if (!p) return kOfxStatErrUnknown;
+  if (p->type != kString) return kOfxStatErrValue;
+  if (index < 0 || index >= p->strings.size()) return kOfxStatErrBadIndex;
+
+  // Plugins only read the string, and it stays valid until the property is next set
+  *value = const_cast<char*>(p->strings.at(index).constData());
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropGetDouble(OfxPropertySetHandle properties, const char *property, int index, double *value)
+{
+  if (!properties) return kOfxStatErrBadHandle;
+  const Property* p = FromHandle(properties)->Find(property);
+  if (!p) return kOfxStatErrUnknown;
+  if (p->type != kDouble && p->type != kInt) return kOfxStatErrValue;
+  if (index < 0 || index >= p->dimension()) return kOfxStatErrBadIndex;
+  *value = FromHandle(properties)->GetDouble(property, index);
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropGetInt(OfxPropertySetHandle properties, const char *property, int index, int *value)
+{
+  if (!properties) return kOfxStatErrBadHandle;
+  const Property* p = FromHandle(properties)->Find(property);
+  if (!p) return kOfxStatErrUnknown;
+  if (p->type != kDouble && p->type != kInt) return kOfxStatErrValue;
+  if (index < 0 || index >= p->dimension()) return kOfxStatErrBadIndex;
+  *value = FromHandle(properties)->GetInt(property, index);
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropGetPointerN(OfxPropertySetHandle properties, const char *property, int count, void **value)
+{
+  for (int i=0; i<count; i++) {
+    OfxStatus s = PropGetPointer(properties, property, i, &value[i]);
+    if (s != kOfxStatOK) return s;
+  }
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropGetStringN(OfxPropertySetHandle properties, const char *property, int count, char **value)
+{
+  for (int i=0; i<count; i++) {
+    OfxStatus s = PropGetString(properties, property, i, &value[i]);
+    if (s != kOfxStatOK) return s;
+  }
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropGetDoubleN(OfxPropertySetHandle properties, const char *property, int count, double *value)
+{
+  for (int i=0; i<count; i++) {
+    OfxStatus s = PropGetDouble(properties, property, i, &value[i]);
+    if (s != kOfxStatOK) return s;
+  }
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropGetIntN(OfxPropertySetHandle properties, const char *property, int count, int *value)
+{
+  for (int i=0; i<count; i++) {
+    OfxStatus s = PropGetInt(properties, property, i, &value[i]);
+    if (s != kOfxStatOK) return s;
+  }
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropReset(OfxPropertySetHandle properties, const char *property)
+{
+  if (!properties) return kOfxStatErrBadHandle;
+  if (!FromHandle(properties)->Contains(property)) return kOfxStatErrUnknown;
+
+  // We don't keep property defaults, resetting is a no-op
+  return kOfxStatOK;
+}
+
+OfxStatus OpenFXPropertySet::PropGetDimension(OfxPropertySetHandle properties, const char *property, int *count)
+{
+  if (!properties) return kOfxStatErrBadHandle;
+  const Property* p = FromHandle(properties)->Find(property);
+  if (!p) return kOfxStatErrUnknown;
+  *count = p->dimension();
+  return kOfxStatOK;
+}
+
+}
+
+#endif // USE_OPENFX
@@ -0,0 +1,150 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OPENFXPROPERTYSET_H
+#define OPENFXPROPERTYSET_H
+
+#ifdef USE_OPENFX
+
+#include <ofxProperty.h>
+#include <QByteArray>
+#include <QHash>
+#include <QVector>
+
+namespace olive {
+
+/**
+ * @brief Backing store for an OpenFX property set handle
+ *
+ * Plugins create properties simply by setting them, so setters add any property that doesn't exist
+ * yet. Getters never modify the set, which lets render threads read instance properties
+ * concurrently as long as nothing is writing to them.
+ */
+class OpenFXPropertySet
+{
+public:
+  enum Type {
+    kPointer,
+    kString,
+    kDouble,
+    kInt
+  };
+
+  OpenFXPropertySet() = default;
+
+  OfxPropertySetHandle handle()
+  {
+    return reinterpret_cast<OfxPropertySetHandle>(this);
+  }
+
+  static OpenFXPropertySet* FromHandle(OfxPropertySetHandle h)
+  {
+    return reinterpret_cast<OpenFXPropertySet*>(h);
+  }
+
+  void SetPointer(const char* name, void* value, int index = 0);
+  void SetString(const char* name, const QByteArray& value, int index = 0);
+  void SetDouble(const char* name, double value, int index = 0);
+  void SetInt(const char* name, int value, int index = 0);
+
+  void SetStrings(const char* name, const QVector<QByteArray>& values);
+  void SetDoubles(const char* name, const QVector<double>& values);
+  void SetInts(const char* name, const QVector<int>& values);
+
+  bool Contains(const char* name) const
+  {
+    return properties_.contains(name);
+  }
+
+  int Dimension(const char* name) const;
+
+  /**
+   * @brief Convenience getters that return `default_value` if the property is missing
+   */
+  void* GetPointer(const char* name, int index = 0, void* default_value = nullptr) const;
+  QByteArray GetString(const char* name, int index = 0, const QByteArray& default_value = QByteArray()) const;
+  double GetDouble(const char* name, int index = 0, double default_value = 0.0) const;
+  int GetInt(const char* name, int index = 0, int default_value = 0) const;
+
+  QVector<QByteArray> GetStrings(const char* name) const;
+  QVector<double> GetDoubles(const char* name) const;
+
+  /**
+   * @brief Returns the suite handed to plugins for accessing property sets
+   */
+  static const OfxPropertySuiteV1* suite();
+
+private:
+  struct Property {
+    Type type = kPointer;
+    QVector<void*> pointers;
+    QVector<QByteArray> strings;
+    QVector<double> doubles;
+    QVector<int> ints;
+
+    int dimension() const
+    {
+      switch (type) {
+      case kPointer:
+        return pointers.size();
+      case kString:
+        return strings.size();
+      case kDouble:
+        return doubles.size();
+      case kInt:
+        return ints.size();
+      }
+
+      return 0;
+    }
+  };
+
+  Property& Prepare(const char* name, Type type, int index);
+
+  const Property* Find(const char* name) const;
+
+  static OfxStatus PropSetPointer(OfxPropertySetHandle properties, const char *property, int index, void *value);
+  static OfxStatus PropSetString(OfxPropertySetHandle properties, const char *property, int index, const char *value);
+  static OfxStatus PropSetDouble(OfxPropertySetHandle properties, const char *property, int index, double value);
+  static OfxStatus PropSetInt(OfxPropertySetHandle properties, const char *property, int index, int value);
+  static OfxStatus PropSetPointerN(OfxPropertySetHandle properties, const char *property, int count, void *const *value);
+  static OfxStatus PropSetStringN(OfxPropertySetHandle properties, const char *property, int count, const char *const *value);
+  static OfxStatus PropSetDoubleN(OfxPropertySetHandle properties, const char *property, int count, const double *value);
+  static OfxStatus PropSetIntN(OfxPropertySetHandle properties, const char *property, int count, const int *value);
+  static OfxStatus PropGetPointer(OfxPropertySetHandle properties, const char *property, int index, void **value);
+  static OfxStatus PropGetString(OfxPropertySetHandle properties, const char *property, int index, char **value);
+  static OfxStatus PropGetDouble(OfxPropertySetHandle properties, const char *property, int index, double *value);
+  static OfxStatus PropGetInt(OfxPropertySetHandle properties, const char *property, int index, int *value);
+  static OfxStatus PropGetPointerN(OfxPropertySetHandle properties, const char *property, int count, void **value);
+  static OfxStatus PropGetStringN(OfxPropertySetHandle properties, const char *property, int count, char **value);
+  static OfxStatus PropGetDoubleN(OfxPropertySetHandle properties, const char *property, int count, double *value);
+  static OfxStatus PropGetIntN(OfxPropertySetHandle properties, const char *property, int count, int *value);
+  static OfxStatus PropReset(OfxPropertySetHandle properties, const char *property);
+  static OfxStatus PropGetDimension(OfxPropertySetHandle properties, const char *property, int *count);
+
+  QHash<QByteArray, Property> properties_;
+
+};
+
+}
+
+#endif // USE_OPENFX
+
+#endif // OPENFXPROPERTYSET_H
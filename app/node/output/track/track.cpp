@@ -20,6 +20,7 @@
 
 #include "track.h"
 
+#include <algorithm>
 #include <QApplication>
 #include <QDebug>
 #include <QFontMetrics>
@@ -44,7 +45,9 @@ Track::Track() :
   midop_track_length_(0),
   preop_track_length_(0),
   index_(-1),
-  locked_(false)
+  locked_(false),
+  block_batch_depth_(0),
+  block_batch_dirty_index_(-1)
 {
   AddInput(kBlockInput, NodeValue::kNone, InputFlags(kInputFlagArray | kInputFlagNotKeyframable));
 
@@ -143,7 +146,7 @@ void Track::SetTrackHeight(const double &height)
   emit TrackHeightChangedInPixels(GetTrackHeightInPixels());
 }
 
-bool Track::LoadCustom(QXmlStreamReader *reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt* cancelled)
+bool Track::LoadCustom(XMLReader *reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt* cancelled)
 {
   if (reader->name() == QStringLiteral("height")) {
     SetTrackHeight(reader->readElementText().toDouble());
@@ -153,7 +156,7 @@ bool Track::LoadCustom(QXmlStreamReader *reader, XMLNodeData &xml_node_data, uin
   }
 }
 
-void Track::SaveCustom(QXmlStreamWriter *writer) const
+void Track::SaveCustom(XMLWriter *writer) const
 {
   super::SaveCustom(writer);
 
@@ -221,12 +224,19 @@ void Track::InputConnectedEvent(const QString &input, int element, const NodeOut
 
     block->set_track(this);
 
-    // Update ins/outs
-    UpdateInOutFrom(cache_index);
-
     // Connect to the block
     connect(block, &Block::LengthChanged, this, &Track::BlockLengthChanged);
 
+    if (block_batch_depth_ > 0) {
+      // In/outs, signal and invalidation will be handled once the batch ends
+      MarkBlockBatchDirty(cache_index);
+      block_batch_added_.append(block);
+      return;
+    }
+
+    // Update ins/outs
+    UpdateInOutFrom(cache_index);
+
     // Invalidate cache now that block should have an in point
     Node::InvalidateCache(TimeRange(block->in(), track_length()), kBlockInput);
 
@@ -252,11 +262,16 @@ void Track::InputDisconnectedEvent(const QString &input, int element, const Node
 
     emit BlockRemoved(b);
 
-    TimeRange invalidate_range(b->in(), track_length());
-
     // Get cache index
     int cache_index = GetCacheIndexFromArrayIndex(element);
 
+    if (block_batch_depth_ > 0) {
+      // If this block was added in the same batch, it must not be announced anymore
+      block_batch_added_.removeOne(b);
+    }
+
+    TimeRange invalidate_range(b->in(), track_length());
+
     // Remove block here
     blocks_.removeAt(cache_index);
     block_array_indexes_.removeAt(cache_index);
@@ -277,6 +292,14 @@ void Track::InputDisconnectedEvent(const QString &input, int element, const Node
     b->set_next(nullptr);
     b->set_track(nullptr);
 
+    disconnect(b, &Block::LengthChanged, this, &Track::BlockLengthChanged);
+
+    if (block_batch_depth_ > 0) {
+      // Whatever now sits at this block's index inherits its in point
+      MarkBlockBatchDirty(cache_index);
+      return;
+    }
+
     // Update lengths
     if (next) {
       UpdateInOutFrom(blocks_.indexOf(next));
@@ -286,8 +309,6 @@ void Track::InputDisconnectedEvent(const QString &input, int element, const Node
       SetLengthInternal(blocks_.last()->out());
     }
 
-    disconnect(b, &Block::LengthChanged, this, &Track::BlockLengthChanged);
-
     Node::InvalidateCache(invalidate_range, kBlockInput);
   }
 }
@@ -320,12 +341,10 @@ void Track::SetIndex(const int &index)
 
 Block *Track::BlockContainingTime(const rational &time) const
 {
-  foreach (Block* block, blocks_) {
-    if (block->in() < time && block->out() > time) {
-      return block;
-    } else if (block->out() == time) {
-      break;
-    }
+  Block* block = NearestBlockBefore(time);
+
+  if (block && block->in() < time && block->out() > time) {
+    return block;
   }
 
   return nullptr;
@@ -333,50 +352,34 @@ Block *Track::BlockContainingTime(const rational &time) const
 
 Block *Track::NearestBlockBefore(const rational &time) const
 {
-  foreach (Block* block, blocks_) {
-    // Blocks are sorted by time, so the first Block who's out point is at/after this time is the correct Block
-    if (block->out() >= time) {
-      return block;
-    }
-  }
-
-  return nullptr;
+  // Blocks are sorted by time, so the first Block who's out point is at/after this time is the correct Block
+  return BlockFromIterator(std::lower_bound(blocks_.cbegin(), blocks_.cend(), time, [](const Block* b, const rational& t){
+    return b->out() < t;
+  }));
 }
 
 Block *Track::NearestBlockBeforeOrAt(const rational &time) const
 {
-  foreach (Block* block, blocks_) {
-    // Blocks are sorted by time, so the first Block who's out point is at/after this time is the correct Block
-    if (block->out() > time) {
-      return block;
-    }
-  }
-
-  return nullptr;
+  // Blocks are sorted by time, so the first Block who's out point is after this time is the correct Block
+  return BlockFromIterator(std::upper_bound(blocks_.cbegin(), blocks_.cend(), time, [](const rational& t, const Block* b){
+    return t < b->out();
+  }));
 }
 
 Block *Track::NearestBlockAfterOrAt(const rational &time) const
 {
-  foreach (Block* block, blocks_) {
-    // Blocks are sorted by time, so the first Block after this time is the correct Block
-    if (block->in() >= time) {
-      return block;
-    }
-  }
-
-  return nullptr;
+  // Blocks are sorted by time, so the first Block at/after this time is the correct Block
+  return BlockFromIterator(std::lower_bound(blocks_.cbegin(), blocks_.cend(), time, [](const Block* b, const rational& t){
+    return b->in() < t;
+  }));
 }
 
 Block *Track::NearestBlockAfter(const rational &time) const
 {
-  foreach (Block* block, blocks_) {
-    // Blocks are sorted by time, so the first Block after this time is the correct Block
-    if (block->in() > time) {
-      return block;
-    }
-  }
-
-  return nullptr;
+  // Blocks are sorted by time, so the first Block after this time is the correct Block
+  return BlockFromIterator(std::upper_bound(blocks_.cbegin(), blocks_.cend(), time, [](const rational& t, const Block* b){
+    return t < b->in();
+  }));
 }
 
 Block *Track::BlockAtTime(const rational &time) const
@@ -419,11 +422,15 @@ QVector<Block *> Track::BlocksAtTimeRange(const TimeRange &range) const
     return list;
   }
 
-  foreach (Block* block, blocks_) {
-    if (block
-        && block->is_enabled()
-        && block->out() > range.in()
-        && block->in() < range.out()) {
+  // Skip straight to the first block that ends after the range starts
+  auto it = std::upper_bound(blocks_.cbegin(), blocks_.cend(), range.in(), [](const rational& t, const Block* b){
+    return t < b->out();
+  });
+
+  for (; it!=blocks_.cend() && (*it)->in() < range.out(); it++) {
+    Block* block = *it;
+
+    if (block->is_enabled()) {
       list.append(block);
     }
   }
@@ -493,6 +500,10 @@ void Track::PrependBlock(Block *block)
 
   EndOperation();
 
+  if (IsInBlockBatch()) {
+    return;
+  }
+
   // Everything has shifted at this point
   Node::InvalidateCache(TimeRange(0, track_length()), kBlockInput);
 }
@@ -507,6 +518,10 @@ void Track::InsertBlockAtIndex(Block *block, int index)
 
   EndOperation();
 
+  if (IsInBlockBatch()) {
+    return;
+  }
+
   Node::InvalidateCache(TimeRange(block->in(), track_length()), kBlockInput);
 }
 
@@ -519,10 +534,33 @@ void Track::AppendBlock(Block *block)
 
   EndOperation();
 
+  if (IsInBlockBatch()) {
+    return;
+  }
+
   // Invalidate area that block was added to
   Node::InvalidateCache(TimeRange(block->in(), track_length()), kBlockInput);
 }
 
+void Track::AppendBlocks(const QVector<Block *> &blocks)
+{
+  if (blocks.isEmpty()) {
+    return;
+  }
+
+  BeginBlockBatch();
+
+  // Resize once rather than appending per block, each append shifts every existing connection
+  int first_index = InputArraySize(kBlockInput);
+  InputArrayResize(kBlockInput, first_index + blocks.size());
+
+  for (int i=0; i<blocks.size(); i++) {
+    Node::ConnectEdge(blocks.at(i), NodeInput(this, kBlockInput, first_index + i));
+  }
+
+  EndBlockBatch();
+}
+
 void Track::RippleRemoveBlock(Block *block)
 {
   BeginOperation();
@@ -534,6 +572,10 @@ void Track::RippleRemoveBlock(Block *block)
 
   EndOperation();
 
+  if (IsInBlockBatch()) {
+    return;
+  }
+
   Node::InvalidateCache(TimeRange(remove_in, qMax(track_length(), remove_out)), kBlockInput);
 }
 
@@ -549,6 +591,10 @@ void Track::ReplaceBlock(Block *old, Block *replace)
 
   EndOperation();
 
+  if (IsInBlockBatch()) {
+    return;
+  }
+
   if (old->length() == replace->length()) {
     Node::InvalidateCache(TimeRange(replace->in(), replace->out()), kBlockInput);
   } else {
@@ -588,7 +634,7 @@ bool Track::IsLocked() const
   return locked_;
 }
 
-void Track::Hash(const QString &output, QCryptographicHash &hash, const rational &time, const VideoParams &video_params) const
+void Track::Hash(const QString &output, Hasher &hash, const rational &time, const VideoParams &video_params) const
 {
   Q_UNUSED(output)
 
@@ -600,6 +646,38 @@ void Track::Hash(const QString &output, QCryptographicHash &hash, const rational
   }
 }
 
+QVector<TimeRange> Track::GetConstantRanges(const QString &output, const TimeRange &range) const
+{
+  Q_UNUSED(output)
+
+  // Like Hash(), defer to whichever block is active. Block boundaries are kept as range boundaries
+  // since each block's ranges are clamped to the block.
+  QVector<TimeRange> constant;
+  rational last_out = range.in();
+
+  foreach (Block* b, BlocksAtTimeRange(range)) {
+    rational in = qMax(b->in(), range.in());
+    rational out = qMin(b->out(), range.out());
+
+    if (in >= out) {
+      continue;
+    }
+
+    foreach (const TimeRange& r, b->GetConstantRanges(kDefaultOutput, TransformRangeForBlock(b, TimeRange(in, out)))) {
+      constant.append(r + b->in());
+    }
+
+    last_out = out;
+  }
+
+  if (last_out < range.out()) {
+    // Nothing is output past the end of the track
+    constant.append(TimeRange(last_out, range.out()));
+  }
+
+  return constant;
+}
+
 void Track::EndOperation()
 {
   super::EndOperation();
@@ -619,7 +697,7 @@ void Track::SetLocked(bool e)
   locked_ = e;
 }
 
-void Track::UpdateInOutFrom(int index)
+void Track::UpdateInOutFrom(int index, bool invalidate)
 {
   // Find block just before this one to find the last out point
   rational last_out = (index == 0) ? 0 : blocks_.at(index - 1)->out();
@@ -640,7 +718,47 @@ void Track::UpdateInOutFrom(int index)
   emit BlocksRefreshed();
 
   // Update track length
-  SetLengthInternal(last_out);
+  SetLengthInternal(last_out, invalidate);
+}
+
+void Track::BeginBlockBatch()
+{
+  block_batch_depth_++;
+}
+
+void Track::EndBlockBatch()
+{
+  block_batch_depth_--;
+
+  if (block_batch_depth_ > 0) {
+    return;
+  }
+
+  if (block_batch_dirty_index_ >= 0) {
+    int index = qMin(block_batch_dirty_index_, blocks_.size());
+    block_batch_dirty_index_ = -1;
+
+    // Everything before the first dirty index is still correct
+    rational invalidate_in = (index == 0) ? 0 : blocks_.at(index - 1)->out();
+    rational old_length = track_length_;
+
+    UpdateInOutFrom(index, false);
+
+    foreach (Block* b, block_batch_added_) {
+      emit BlockAdded(b);
+    }
+
+    Node::InvalidateCache(TimeRange(invalidate_in, qMax(old_length, midop_track_length_)), kBlockInput);
+  }
+
+  block_batch_added_.clear();
+}
+
+void Track::MarkBlockBatchDirty(int index)
+{
+  if (block_batch_dirty_index_ == -1 || index < block_batch_dirty_index_) {
+    block_batch_dirty_index_ = index;
+  }
 }
 
 int Track::GetArrayIndexFromBlock(Block *block) const
@@ -680,6 +798,11 @@ void Track::BlockLengthChanged()
   // Assumes sender is a Block
   Block* b = static_cast<Block*>(sender());
 
+  if (block_batch_depth_ > 0) {
+    MarkBlockBatchDirty(blocks_.indexOf(b));
+    return;
+  }
+
   rational old_out = b->out();
 
   UpdateInOutFrom(blocks_.indexOf(b));
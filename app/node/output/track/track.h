@@ -318,6 +318,15 @@ public:
    */
   void AppendBlock(Block* block);
 
+  /**
+   * @brief Adds several Blocks at the very end of the Sequence in the order they're provided
+   *
+   * Equivalent to calling AppendBlock() for each Block, but in/out points are only recalculated and
+   * the cache only invalidated once after all Blocks have been connected, so building a long Track
+   * this way is linear rather than quadratic.
+   */
+  void AppendBlocks(const QVector<Block*>& blocks);
+
   /**
    * @brief Removes a Block pushing all subsequent Blocks earlier to take up the space
    */
@@ -330,6 +339,29 @@ public:
    */
   void ReplaceBlock(Block* old, Block* replace);
 
+  /**
+   * @brief Start a batch of block edits
+   *
+   * Until the matching EndBlockBatch(), adding, removing or resizing blocks only updates the block
+   * order. In/out points, BlockAdded signals and cache invalidation are held and applied once
+   * when the batch ends, which keeps edits touching many blocks linear rather than quadratic.
+   *
+   * Block in/out points and the track length are NOT valid inside a batch, so nothing that looks
+   * up blocks by time should be called until it ends. Calls can be nested, only the outermost
+   * EndBlockBatch() applies the held changes.
+   */
+  void BeginBlockBatch();
+
+  /**
+   * @brief End a batch of block edits started with BeginBlockBatch()
+   */
+  void EndBlockBatch();
+
+  bool IsInBlockBatch() const
+  {
+    return block_batch_depth_ > 0;
+  }
+
   const rational& track_length() const;
 
   static QString GetDefaultTrackName(Track::Type type, int index);
@@ -338,7 +370,9 @@ public:
 
   bool IsLocked() const;
 
-  virtual void Hash(const QString& output, QCryptographicHash& hash, const rational &time, const VideoParams& video_params) const override;
+  virtual void Hash(const QString& output, Hasher& hash, const rational &time, const VideoParams& video_params) const override;
+
+  virtual QVector<TimeRange> GetConstantRanges(const QString& output, const TimeRange& range) const override;
 
   AudioVisualWaveform& waveform()
   {
@@ -401,9 +435,9 @@ signals:
   void BlocksRefreshed();
 
 protected:
-  virtual bool LoadCustom(QXmlStreamReader* reader, XMLNodeData& xml_node_data, uint version, const QAtomicInt* cancelled) override;
+  virtual bool LoadCustom(XMLReader* reader, XMLNodeData& xml_node_data, uint version, const QAtomicInt* cancelled) override;
 
-  virtual void SaveCustom(QXmlStreamWriter* writer) const override;
+  virtual void SaveCustom(XMLWriter* writer) const override;
 
   virtual void InputConnectedEvent(const QString& input, int element, const NodeOutput& output) override;
 
@@ -412,7 +446,9 @@ protected:
   virtual void InputValueChangedEvent(const QString& input, int element) override;
 
 private:
-  void UpdateInOutFrom(int index);
+  void UpdateInOutFrom(int index, bool invalidate = true);
+
+  void MarkBlockBatchDirty(int index);
 
   int GetArrayIndexFromBlock(Block* block) const;
 
@@ -420,10 +456,19 @@ private:
 
   int GetCacheIndexFromArrayIndex(int index) const;
 
+  Block* BlockFromIterator(QVector<Block*>::const_iterator it) const
+  {
+    return (it == blocks_.cend()) ? nullptr : *it;
+  }
+
   void SetLengthInternal(const rational& r, bool invalidate = true);
 
   TimeRangeList block_length_pending_invalidations_;
 
+  int block_batch_depth_;
+  int block_batch_dirty_index_;
+  QVector<Block*> block_batch_added_;
+
   QVector<Block*> blocks_;
   QVector<int> block_array_indexes_;
 
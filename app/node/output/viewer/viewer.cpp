@@ -473,7 +473,7 @@ void ViewerOutput::set_parameters_from_footage(const QVector<ViewerOutput *> foo
       SetVideoParams(VideoParams(s.width(),
                                    s.height(),
                                    using_timebase,
-                                   static_cast<VideoParams::Format>(Config::Current()[QStringLiteral("OfflinePixelFormat")].toInt()),
+                                   static_cast<VideoParams::Format>(Config::kOfflinePixelFormat.Get()),
                        VideoParams::kInternalChannelCount,
                        s.pixel_aspect_ratio(),
                        s.interlacing(),
@@ -491,7 +491,7 @@ void ViewerOutput::set_parameters_from_footage(const QVector<ViewerOutput *> foo
   }
 }
 
-bool ViewerOutput::LoadCustom(QXmlStreamReader *reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt *cancelled)
+bool ViewerOutput::LoadCustom(XMLReader *reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt *cancelled)
 {
   if (reader->name() == QStringLiteral("points")) {
     timeline_points_.Load(reader);
@@ -501,7 +501,7 @@ bool ViewerOutput::LoadCustom(QXmlStreamReader *reader, XMLNodeData &xml_node_da
   }
 }
 
-void ViewerOutput::SaveCustom(QXmlStreamWriter *writer) const
+void ViewerOutput::SaveCustom(XMLWriter *writer) const
 {
   super::SaveCustom(writer);
 
@@ -196,9 +196,9 @@ protected:
 
   virtual void InputValueChangedEvent(const QString& input, int element) override;
 
-  virtual bool LoadCustom(QXmlStreamReader* reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt* cancelled) override;
+  virtual bool LoadCustom(XMLReader* reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt* cancelled) override;
 
-  virtual void SaveCustom(QXmlStreamWriter *writer) const override;
+  virtual void SaveCustom(XMLWriter *writer) const override;
 
   int AddStream(Track::Type type, const QVariant &value);
 
@@ -22,6 +22,7 @@
 #define NODEPARAM_H
 
 #include <QString>
+#include <QVector>
 
 #include "common/rational.h"
 #include "value.h"
@@ -31,6 +32,33 @@ namespace olive {
 class Node;
 class NodeKeyframe;
 
+/**
+ * @brief Compare two input IDs, skipping the string comparison if they share storage
+ *
+ * Input IDs are nearly always copies of a node's static ID constants (e.g. kTextureInput), which
+ * Qt's implicit sharing leaves pointing at the same data, so in practice they're interned and
+ * this is a pointer comparison. IDs that came from elsewhere (e.g. a loaded project) still
+ * compare correctly, just through their contents.
+ */
+inline bool InputIdEquals(const QString& a, const QString& b)
+{
+  return a.constData() == b.constData() || a == b;
+}
+
+/**
+ * @brief Index of `id` in `ids` using the same matching as InputIdEquals(), or -1
+ */
+inline int IndexOfInputId(const QVector<QString>& ids, const QString& id)
+{
+  for (int i=0; i<ids.size(); i++) {
+    if (ids.at(i).constData() == id.constData()) {
+      return i;
+    }
+  }
+
+  return ids.indexOf(id);
+}
+
 struct NodeInputPair {
   bool operator==(const NodeInputPair& rhs) const
   {
@@ -107,7 +135,7 @@ public:
 
   bool operator==(const NodeInput& rhs) const
   {
-    return node_ == rhs.node_ && input_ == rhs.input_ && element_ == rhs.element_;
+    return node_ == rhs.node_ && element_ == rhs.element_ && InputIdEquals(input_, rhs.input_);
   }
 
   bool operator!=(const NodeInput& rhs) const
@@ -121,7 +149,7 @@ public:
       return node_ < rhs.node_;
     }
 
-    if (input_ != rhs.input_) {
+    if (!InputIdEquals(input_, rhs.input_)) {
       return input_ < rhs.input_;
     }
 
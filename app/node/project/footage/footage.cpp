@@ -21,8 +21,7 @@
 #include "footage.h"
 
 #include <QApplication>
-#include <QDir>
-#include <QStandardPaths>
+#include <QFileInfo>
 
 #include "codec/decoder.h"
 #include "common/clamp.h"
@@ -30,6 +29,7 @@
 #include "common/xmlutils.h"
 #include "config/config.h"
 #include "core.h"
+#include "footageprobecache.h"
 #include "render/job/footagejob.h"
 #include "ui/icons/icons.h"
 #include "widget/videoparamedit/videoparamedit.h"
@@ -78,7 +78,7 @@ QVector<QString> Footage::inputs_for_output(const QString &output) const
   return {kFilenameInput, kLoopModeInput};
 }
 
-bool Footage::LoadCustom(QXmlStreamReader *reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt* cancelled)
+bool Footage::LoadCustom(XMLReader *reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt* cancelled)
 {
   if (reader->name() == QStringLiteral("timestamp")) {
     set_timestamp(reader->readElementText().toLongLong());
@@ -88,7 +88,7 @@ bool Footage::LoadCustom(QXmlStreamReader *reader, XMLNodeData &xml_node_data, u
   }
 }
 
-void Footage::SaveCustom(QXmlStreamWriter *writer) const
+void Footage::SaveCustom(XMLWriter *writer) const
 {
   super::SaveCustom(writer);
 
@@ -108,34 +108,8 @@ void Footage::InputValueChangedEvent(const QString &input, int element)
       // Grab timestamp
       set_timestamp(info.lastModified().toMSecsSinceEpoch());
 
-      // Determine if we've already cached the metadata of this file
-      QString meta_cache_file = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(FileFunctions::GetUniqueFileIdentifier(filename()));
-
-      FootageDescription footage_info;
-
-      if (QFileInfo::exists(meta_cache_file)) {
-
-        // Load meta cache file
-        footage_info.Load(meta_cache_file);
-
-      } else {
-
-        // Probe and create cache
-        QVector<DecoderPtr> decoder_list = Decoder::ReceiveListOfAllDecoders();
-
-        foreach (DecoderPtr decoder, decoder_list) {
-          footage_info = decoder->Probe(filename(), cancelled_);
-
-          if (footage_info.IsValid()) {
-            break;
-          }
-        }
-
-        if (!footage_info.Save(meta_cache_file)) {
-          qWarning() << "Failed to save stream cache, footage will have to be re-probed";
-        }
-
-      }
+      // Probe file, unless we've already probed it as it is now
+      FootageDescription footage_info = FootageProbeCache::Probe(filename(), cancelled_);
 
       if (footage_info.IsValid()) {
         decoder_ = footage_info.decoder();
@@ -171,6 +145,7 @@ void Footage::InputValueChangedEvent(const QString &input, int element)
           if (vp.video_type() == VideoParams::kVideoTypeVideo) {
             // This is video, ensure that the frame rate does not overwrite the timebase
             video_param_mask |= VideoParamEdit::kFrameRateIsNotTimebase;
+            video_param_mask |= VideoParamEdit::kHardwareDecoding;
           } else {
             // This is not a video, so it's either a still image or an image sequence
             video_param_mask |= VideoParamEdit::kIsImageSequence;
@@ -322,12 +297,12 @@ QString Footage::DescribeAudioStream(const AudioParams &params)
          QString::number(params.sample_rate()));
 }
 
-void Footage::Hash(const QString& output, QCryptographicHash &hash, const rational &time, const VideoParams &video_params) const
+void Footage::Hash(const QString& output, Hasher &hash, const rational &time, const VideoParams &video_params) const
 {
   super::Hash(output, hash, time, video_params);
 
   // Footage last modified date
-  hash.addData(QString::number(timestamp()).toUtf8());
+  hash.add(timestamp());
 
   // Translate output ID to stream
   Track::Reference ref = Track::Reference::FromString(output);
@@ -340,18 +315,18 @@ void Footage::Hash(const QString& output, QCryptographicHash &hash, const ration
       QString fn = filename();
 
       // Footage stream
-      hash.addData(QString::number(ref.index()).toUtf8());
+      hash.add(ref.index());
 
       if (!fn.isEmpty()) {
         // Current color config and space
-        hash.addData(project()->color_manager()->GetConfigFilename().toUtf8());
-        hash.addData(GetColorspaceToUse(params).toUtf8());
+        hash.add(project()->color_manager()->GetConfigFilename());
+        hash.add(GetColorspaceToUse(params));
 
         // Alpha associated setting
-        hash.addData(QString::number(params.premultiplied_alpha()).toUtf8());
+        hash.add(params.premultiplied_alpha());
 
         // Pixel aspect ratio
-        hash.addData(reinterpret_cast<const char*>(&params.pixel_aspect_ratio()), sizeof(params.pixel_aspect_ratio()));
+        hash.add(params.pixel_aspect_ratio());
 
         // Footage timestamp
         if (params.video_type() != VideoParams::kVideoTypeStill) {
@@ -361,18 +336,31 @@ void Footage::Hash(const QString& output, QCryptographicHash &hash, const ration
             int64_t video_ts = Timecode::time_to_timestamp(adjusted_time, params.time_base());
 
             // Add timestamp in units of the video stream's timebase
-            hash.addData(reinterpret_cast<const char*>(&video_ts), sizeof(video_ts));
+            hash.add(video_ts);
           }
 
           // Add start time - used for both image sequences and video streams
           auto start_time = params.start_time();
-          hash.addData(reinterpret_cast<const char*>(&start_time), sizeof(start_time));
+          hash.add(start_time);
         }
       }
     }
   }
 }
 
+QVector<TimeRange> Footage::GetConstantRanges(const QString &output, const TimeRange &range) const
+{
+  Track::Reference ref = Track::Reference::FromString(output);
+
+  // Still images are the only streams that don't change over time
+  if (ref.type() == Track::kVideo
+      && GetVideoParams(ref.index()).video_type() == VideoParams::kVideoTypeStill) {
+    return super::GetConstantRanges(output, range);
+  }
+
+  return QVector<TimeRange>();
+}
+
 NodeValueTable Footage::Value(const QString &output, NodeValueDatabase &value) const
 {
   Track::Reference ref = Track::Reference::FromString(output);
@@ -388,6 +376,7 @@ NodeValueTable Footage::Value(const QString &output, NodeValueDatabase &value) c
   // If the file exists and the reference is valid, push a footage job to the renderer
   if (QFileInfo(file).exists()) {
     FootageJob job(decoder_, filename(), ref.type(), GetLength(), loop_mode);
+    job.set_cache_path(project()->cache_path());
 
     if (ref.type() == Track::kVideo) {
       VideoParams vp = GetVideoParams(ref.index());
@@ -399,7 +388,6 @@ NodeValueTable Footage::Value(const QString &output, NodeValueDatabase &value) c
     } else {
       AudioParams ap = GetAudioParams(ref.index());
       job.set_audio_params(ap);
-      job.set_cache_path(project()->cache_path());
     }
 
     table.Push(NodeValue::kRational, QVariant::fromValue(GetLength()), this, false, QStringLiteral("length"));
@@ -409,6 +397,22 @@ NodeValueTable Footage::Value(const QString &output, NodeValueDatabase &value) c
   return table;
 }
 
+FootageJob Footage::GetVideoJob(int index) const
+{
+  if (index < 0 || index >= GetVideoStreamCount() || !QFileInfo::exists(filename())) {
+    return FootageJob();
+  }
+
+  FootageJob job(decoder_, filename(), Track::kVideo, GetLength(), loop_mode());
+  job.set_cache_path(project()->cache_path());
+
+  VideoParams vp = GetVideoParams(index);
+  vp.set_colorspace(GetColorspaceToUse(vp));
+  job.set_video_params(vp);
+
+  return job;
+}
+
 QString Footage::GetStreamTypeName(Track::Type type)
 {
   switch (type) {
@@ -33,6 +33,8 @@
 
 namespace olive {
 
+class FootageJob;
+
 /**
  * @brief A reference to an external media file with metadata in a project structure
  *
@@ -181,10 +183,19 @@ public:
   static QString DescribeVideoStream(const VideoParams& params);
   static QString DescribeAudioStream(const AudioParams& params);
 
-  virtual void Hash(const QString& output, QCryptographicHash &hash, const rational &time, const VideoParams& video_params) const override;
+  virtual void Hash(const QString& output, Hasher &hash, const rational &time, const VideoParams& video_params) const override;
+
+  virtual QVector<TimeRange> GetConstantRanges(const QString& output, const TimeRange& range) const override;
 
   virtual NodeValueTable Value(const QString &output, NodeValueDatabase& value) const override;
 
+  /**
+   * @brief Get the job Value() pushes for a video stream, for decoding it without traversing a graph
+   *
+   * Returns a job of type Track::kNone if the stream or its file doesn't exist.
+   */
+  FootageJob GetVideoJob(int index) const;
+
   static QString GetStreamTypeName(Track::Type type);
 
   virtual NodeOutput GetConnectedTextureOutput() override;
@@ -200,12 +211,12 @@ protected:
   /**
    * @brief Load function
    */
-  virtual bool LoadCustom(QXmlStreamReader* reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt *cancelled) override;
+  virtual bool LoadCustom(XMLReader* reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt *cancelled) override;
 
   /**
    * @brief Save function
    */
-  virtual void SaveCustom(QXmlStreamWriter *writer) const override;
+  virtual void SaveCustom(XMLWriter *writer) const override;
 
   virtual void InputValueChangedEvent(const QString &input, int element) override;
 
@@ -21,9 +21,8 @@
 #include "footagedescription.h"
 
 #include <QFile>
-#include <QXmlStreamReader>
-#include <QXmlStreamWriter>
 
+#include "common/xmlstream.h"
 #include "common/xmlutils.h"
 
 namespace olive {
@@ -36,7 +35,7 @@ bool FootageDescription::Load(const QString &filename)
   QFile file(filename);
 
   if (file.open(QFile::ReadOnly)) {
-    QXmlStreamReader reader(&file);
+    XMLReader reader(&file);
 
     while (XMLReadNextStartElement(&reader)) {
       if (reader.name() == QStringLiteral("streamcache")) {
@@ -82,7 +81,7 @@ bool FootageDescription::Save(const QString &filename) const
     return false;
   }
 
-  QXmlStreamWriter writer(&file);
+  XMLWriter writer(&file);
 
   writer.writeStartDocument();
 
@@ -0,0 +1,123 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "footageprobecache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QStandardPaths>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+#include "codec/decoder.h"
+#include "common/filefunctions.h"
+
+namespace olive {
+
+const int FootageProbeCache::kMaximumMemoryEntries = 8192;
+QMutex FootageProbeCache::mutex_;
+QHash<QString, FootageDescription> FootageProbeCache::memory_cache_;
+
+FootageDescription FootageProbeCache::Probe(const QString &filename, const QAtomicInt *cancelled)
+{
+  QFileInfo info(filename);
+
+  if (!info.exists()) {
+    return FootageDescription();
+  }
+
+  QString identity = GetFileIdentity(info);
+
+  {
+    QMutexLocker locker(&mutex_);
+
+    auto it = memory_cache_.constFind(identity);
+    if (it != memory_cache_.cend()) {
+      return it.value();
+    }
+  }
+
+  FootageDescription footage_info;
+
+  QString cache_file = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(identity);
+
+  if (!QFileInfo::exists(cache_file) || !footage_info.Load(cache_file)) {
+    // Probe and create cache
+    QVector<DecoderPtr> decoder_list = Decoder::ReceiveListOfAllDecoders(filename);
+
+    foreach (DecoderPtr decoder, decoder_list) {
+      footage_info = decoder->Probe(filename, cancelled);
+
+      if (footage_info.IsValid()) {
+        break;
+      }
+    }
+
+    if (cancelled && *cancelled) {
+      // Don't remember a probe that didn't finish
+      return footage_info;
+    }
+
+    // Write to a temporary file first so concurrent probes of the same file never see a partial
+    // cache entry
+    QString temp_file = FileFunctions::GetSafeTemporaryFilename(cache_file);
+    if (!footage_info.Save(temp_file) || !FileFunctions::RenameFileAllowOverwrite(temp_file, cache_file)) {
+      QFile::remove(temp_file);
+      qWarning() << "Failed to save stream cache, footage will have to be re-probed";
+    }
+  }
+
+  {
+    QMutexLocker locker(&mutex_);
+
+    if (memory_cache_.size() >= kMaximumMemoryEntries) {
+      memory_cache_.clear();
+    }
+
+    memory_cache_.insert(identity, footage_info);
+  }
+
+  return footage_info;
+}
+
+QString FootageProbeCache::GetFileIdentity(const QFileInfo &info)
+{
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  hash.addData(info.absoluteFilePath().toUtf8());
+  hash.addData(QString::number(info.size()).toUtf8());
+  hash.addData(QString::number(info.lastModified().toMSecsSinceEpoch()).toUtf8());
+
+#ifdef Q_OS_UNIX
+  struct stat st;
+  if (stat(QFile::encodeName(info.absoluteFilePath()).constData(), &st) == 0) {
+    hash.addData(QString::number(st.st_dev).toUtf8());
+    hash.addData(QString::number(st.st_ino).toUtf8());
+  }
+#endif
+
+  return QString(hash.result().toHex());
+}
+
+}
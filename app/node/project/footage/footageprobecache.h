@@ -0,0 +1,68 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FOOTAGEPROBECACHE_H
+#define FOOTAGEPROBECACHE_H
+
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+
+#include "footagedescription.h"
+
+namespace olive {
+
+/**
+ * @brief Persistent cache of probe results, keyed by file identity
+ *
+ * A file's identity is its absolute path, size, modification time and (where the platform
+ * provides one) its device and inode, so a replaced or modified file is always probed again while
+ * unchanged files never have to be reopened. Results are kept in memory for the session and on
+ * disk in the user's cache directory.
+ *
+ * All functions are thread-safe.
+ */
+class FootageProbeCache
+{
+public:
+  /**
+   * @brief Returns the description for `filename`, probing it only if it isn't cached
+   *
+   * An invalid description is returned if the file doesn't exist or no decoder could probe it.
+   */
+  static FootageDescription Probe(const QString& filename, const QAtomicInt* cancelled = nullptr);
+
+  /**
+   * @brief Returns a string that changes whenever the file at `info` is modified or replaced
+   */
+  static QString GetFileIdentity(const QFileInfo& info);
+
+private:
+  static const int kMaximumMemoryEntries;
+
+  static QMutex mutex_;
+
+  static QHash<QString, FootageDescription> memory_cache_;
+
+};
+
+}
+
+#endif // FOOTAGEPROBECACHE_H
@@ -20,13 +20,18 @@
 
 #include "project.h"
 
+#include <functional>
 #include <QDir>
 #include <QFileInfo>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
 
 #include "common/xmlutils.h"
+#include "config/config.h"
 #include "core.h"
 #include "dialog/progress/progress.h"
 #include "node/factory.h"
+#include "node/project/projectsnapshot.h"
 #include "render/diskmanager.h"
 #include "window/mainwindow/mainwindow.h"
 
@@ -34,7 +39,9 @@ namespace olive {
 
 Project::Project() :
   is_modified_(false),
-  autorecovery_saved_(true)
+  autorecovery_saved_(true),
+  load_version_(0),
+  autorecovery_snapshot_(nullptr)
 {
   // Generate UUID for this project
   RegenerateUuid();
@@ -63,7 +70,7 @@ Project::Project() :
           this, &Project::ColorManagerValueChanged);
 }
 
-void Project::Load(QXmlStreamReader *reader, MainWindowLayoutInfo* layout, uint version, const QAtomicInt* cancelled)
+void Project::Load(XMLReader *reader, MainWindowLayoutInfo* layout, uint version, const QAtomicInt* cancelled)
 {
   XMLNodeData xml_node_data;
 
@@ -87,6 +94,12 @@ void Project::Load(QXmlStreamReader *reader, MainWindowLayoutInfo* layout, uint
 
     } else if (reader->name() == QStringLiteral("nodes")) {
 
+      // Nodes only reference each other through serialized pointers that are resolved once
+      // everything has loaded, so each one can be parsed independently. The element for every
+      // ordinary node is split out into its own record and loaded on a worker thread. Default
+      // nodes that already exist in this project are loaded here.
+      QVector<NodeRecord> records;
+
       while (XMLReadNextStartElement(reader)) {
         if (reader->name() == QStringLiteral("node")) {
           bool is_root = false;
@@ -110,31 +123,136 @@ void Project::Load(QXmlStreamReader *reader, MainWindowLayoutInfo* layout, uint
 
           if (id.isEmpty()) {
             qWarning() << "Failed to load node with empty ID";
-          } else {
+            reader->skipCurrentElement();
+          } else if (is_root || is_cm || is_settings) {
             Node* node;
 
             if (is_root) {
               node = root_;
             } else if (is_cm) {
               node = color_manager_;
-            } else if (is_settings) {
-              node = settings_;
             } else {
-              node = NodeFactory::CreateFromID(id);
+              node = settings_;
             }
 
-            if (!node) {
-              qWarning() << "Failed to find node with ID" << id;
-            } else {
-              node->Load(reader, xml_node_data, version, cancelled);
-              node->setParent(this);
-            }
+            node->Load(reader, xml_node_data, version, cancelled);
+            node->setParent(this);
+          } else {
+            NodeRecord r;
+            r.id = id;
+            r.record = XMLCaptureElement(reader);
+            ScanNodeRecord(&r);
+            records.append(r);
           }
         } else {
           reader->skipCurrentElement();
         }
       }
 
+      // Determine which nodes belong exclusively to a sequence and can wait until it's opened
+      QVector<int> owners;
+      if (Config::Current()[QStringLiteral("LazyLoadSequences")].toBool()) {
+        owners = FindDeferrableRecords(records, xml_node_data);
+      } else {
+        owners.fill(-1, records.size());
+      }
+
+      QThreadPool pool;
+      QVector< QFuture<LoadedNode> > futures;
+      QThread* target_thread = QThread::currentThread();
+
+      for (int i=0; i<records.size(); i++) {
+        if (owners.at(i) == -1) {
+          const NodeRecord& r = records.at(i);
+
+          futures.append(QtConcurrent::run(&pool, [r, version, cancelled, target_thread]{
+            return LoadNodeRecord(r.id, r.record, version, cancelled, target_thread);
+          }));
+        }
+      }
+
+      // Merge results in file order so the graph is identical to a sequential load
+      foreach (QFuture<LoadedNode> f, futures) {
+        LoadedNode loaded = f.result();
+
+        if (!loaded.node) {
+          continue;
+        }
+
+        loaded.node->setParent(this);
+
+        for (auto it=loaded.data.node_ptrs.cbegin(); it!=loaded.data.node_ptrs.cend(); it++) {
+          xml_node_data.node_ptrs.insert(it.key(), it.value());
+        }
+        xml_node_data.desired_connections.append(loaded.data.desired_connections);
+        xml_node_data.block_links.append(loaded.data.block_links);
+      }
+
+      // Set aside the records of deferred nodes with the sequence they belong to
+      QHash<quintptr, Sequence*> deferred_ptr_owners;
+
+      for (int i=0; i<records.size(); i++) {
+        int owner = owners.at(i);
+
+        if (owner == -1) {
+          continue;
+        }
+
+        Sequence* sequence = dynamic_cast<Sequence*>(xml_node_data.node_ptrs.value(records.at(owner).ptr));
+
+        if (!sequence) {
+          // Should never happen since sequences are always loaded, but don't lose the node
+          LoadedNode loaded = LoadNodeRecord(records.at(i).id, records.at(i).record, version, cancelled, target_thread);
+          if (loaded.node) {
+            loaded.node->setParent(this);
+            xml_node_data.node_ptrs.unite(loaded.data.node_ptrs);
+            xml_node_data.desired_connections.append(loaded.data.desired_connections);
+            xml_node_data.block_links.append(loaded.data.block_links);
+          }
+          continue;
+        }
+
+        deferred_sequences_[sequence].nodes.append(records.at(i));
+        deferred_ptr_owners.insert(records.at(i).ptr, sequence);
+        deferred_tokens_.insert(records.at(i).ptr, (quintptr(deferred_tokens_.size() + 1) << 1) | 1);
+      }
+
+      for (auto it=deferred_sequences_.begin(); it!=deferred_sequences_.end(); it++) {
+        foreach (const NodeRecord& r, it.value().nodes) {
+          foreach (quintptr p, r.inputs) {
+            if (deferred_ptr_owners.value(p) != it.key()) {
+              it.value().external.insert(p);
+            }
+          }
+        }
+
+        it.key()->SetContentDeferred(true);
+      }
+
+      if (!deferred_sequences_.isEmpty()) {
+        // Connections into deferred nodes are made when their sequence is loaded
+        QList<XMLNodeData::SerializedConnection> connections;
+
+        foreach (const XMLNodeData::SerializedConnection& c, xml_node_data.desired_connections) {
+          Sequence* owner = deferred_ptr_owners.value(c.output_node);
+
+          if (owner) {
+            deferred_sequences_[owner].connections.append(c);
+          } else {
+            connections.append(c);
+          }
+        }
+
+        xml_node_data.desired_connections = connections;
+
+        // Keep the pointers of loaded nodes so deferred nodes can connect to them later
+        for (auto it=xml_node_data.node_ptrs.cbegin(); it!=xml_node_data.node_ptrs.cend(); it++) {
+          loaded_ptrs_.insert(it.key(), it.value());
+        }
+      }
+
+      load_version_ = version;
+
     } else {
 
       // Skip this
@@ -150,35 +268,421 @@ void Project::Load(QXmlStreamReader *reader, MainWindowLayoutInfo* layout, uint
   XMLLinkBlocks(xml_node_data);
 }
 
-void Project::Save(QXmlStreamWriter *writer) const
+Project::LoadedNode Project::LoadNodeRecord(const QString &id, const QByteArray &record, uint version, const QAtomicInt *cancelled, QThread *target_thread)
+{
+  LoadedNode loaded;
+
+  loaded.node = NodeFactory::CreateFromID(id);
+
+  if (!loaded.node) {
+    qWarning() << "Failed to find node with ID" << id;
+    return loaded;
+  }
+
+  XMLReader reader(record);
+
+  if (XMLReadNextStartElement(&reader)) {
+    loaded.node->Load(&reader, loaded.data, version, cancelled);
+  }
+
+  // Hand the node back to the loading thread so it can be parented to the project
+  loaded.node->moveToThread(target_thread);
+
+  return loaded;
+}
+
+void Project::ScanNodeRecord(NodeRecord *r)
+{
+  // Only read what's needed to place this node in the graph, everything else is skipped
+  r->ptr = 0;
+
+  XMLReader reader(r->record);
+
+  if (!XMLReadNextStartElement(&reader)) {
+    return;
+  }
+
+  while (XMLReadNextStartElement(&reader)) {
+    if (reader.name() == QStringLiteral("ptr")) {
+      r->ptr = reader.readElementText().toULongLong();
+    } else if (reader.name() == QStringLiteral("links")) {
+      while (XMLReadNextStartElement(&reader)) {
+        if (reader.name() == QStringLiteral("link")) {
+          r->links.append(reader.readElementText().toULongLong());
+        } else {
+          reader.skipCurrentElement();
+        }
+      }
+    } else if (reader.name() == QStringLiteral("connections")) {
+      while (XMLReadNextStartElement(&reader)) {
+        if (reader.name() == QStringLiteral("connection")) {
+          while (XMLReadNextStartElement(&reader)) {
+            if (reader.name() == QStringLiteral("node")) {
+              r->inputs.append(reader.readElementText().toULongLong());
+            } else {
+              reader.skipCurrentElement();
+            }
+          }
+        } else {
+          reader.skipCurrentElement();
+        }
+      }
+    } else {
+      reader.skipCurrentElement();
+    }
+  }
+}
+
+QVector<int> Project::FindDeferrableRecords(const QVector<NodeRecord> &records, const XMLNodeData &loaded_data)
+{
+  // A node can be deferred if everything it outputs to belongs to the same sequence, which makes
+  // it part of that sequence's contents. Items (footage, sequences, folders) are always loaded
+  // since the project explorer shows them. The result is the index of the owning sequence's
+  // record for each record, or -1 if it must be loaded now.
+  const int kLoadedConsumer = -2;
+
+  QVector<int> owners(records.size(), -1);
+
+  QHash<quintptr, int> record_index;
+  for (int i=0; i<records.size(); i++) {
+    record_index.insert(records.at(i).ptr, i);
+  }
+
+  QVector<bool> is_sequence(records.size());
+  QVector<bool> is_folder(records.size());
+  QVector<bool> is_item(records.size());
+  QVector<bool> deferrable(records.size(), false);
+  for (int i=0; i<records.size(); i++) {
+    const Node* n = NodeFactory::GetLibraryNodeFromID(records.at(i).id);
+    is_sequence[i] = (dynamic_cast<const Sequence*>(n) != nullptr);
+    is_folder[i] = (dynamic_cast<const Folder*>(n) != nullptr);
+    is_item[i] = n && n->IsItem();
+    deferrable[i] = is_sequence.at(i);
+  }
+
+  QVector< QVector<int> > consumers(records.size());
+  for (int i=0; i<records.size(); i++) {
+    foreach (quintptr p, records.at(i).inputs) {
+      int u = record_index.value(p, -1);
+      if (u != -1) {
+        consumers[u].append(i);
+      }
+    }
+  }
+  foreach (const XMLNodeData::SerializedConnection& c, loaded_data.desired_connections) {
+    int u = record_index.value(c.output_node, -1);
+    if (u != -1) {
+      consumers[u].append(kLoadedConsumer);
+    }
+  }
+
+  bool changed;
+
+  do {
+    // Resolve owners in dependency order. Upstream nodes are visited after their consumers so
+    // this converges with one pass per level of the graph.
+    QVector<int> state(records.size(), 0);
+    std::function<int(int)> resolve = [&](int i) -> int {
+      if (state.at(i) == 2) {
+        return owners.at(i);
+      }
+
+      if (state.at(i) == 1) {
+        // Cycles shouldn't exist, but never defer anything involved in one
+        return -1;
+      }
+
+      state[i] = 1;
+
+      int owner = -1;
+
+      if (!is_item.at(i) && !consumers.at(i).isEmpty()) {
+        foreach (int c, consumers.at(i)) {
+          int anchor;
+
+          if (c == kLoadedConsumer) {
+            anchor = -1;
+          } else if (is_sequence.at(c)) {
+            anchor = deferrable.at(c) ? c : -1;
+          } else {
+            anchor = resolve(c);
+          }
+
+          if (anchor == -1 || (owner != -1 && owner != anchor)) {
+            owner = -1;
+            break;
+          }
+
+          owner = anchor;
+        }
+      }
+
+      owners[i] = owner;
+      state[i] = 2;
+      return owner;
+    };
+
+    for (int i=0; i<records.size(); i++) {
+      resolve(i);
+    }
+
+    // A sequence can only be deferred if it's just filed in a folder or nested in another
+    // deferred sequence, otherwise something loaded needs its contents immediately
+    changed = false;
+
+    for (int i=0; i<records.size(); i++) {
+      if (deferrable.at(i)) {
+        foreach (int c, consumers.at(i)) {
+          if (!(c == kLoadedConsumer || is_folder.at(c) || owners.at(c) != -1)) {
+            deferrable[i] = false;
+            changed = true;
+            break;
+          }
+        }
+      }
+    }
+  } while (changed);
+
+  // Linked blocks must be loaded together, fall back to loading everything if they wouldn't be
+  for (int i=0; i<records.size(); i++) {
+    foreach (quintptr p, records.at(i).links) {
+      int u = record_index.value(p, -1);
+
+      if (u == -1 ? owners.at(i) != -1 : owners.at(u) != owners.at(i)) {
+        owners.fill(-1);
+        return owners;
+      }
+    }
+  }
+
+  return owners;
+}
+
+quintptr Project::RemapDeferredPointer(quintptr p) const
+{
+  // Loaded nodes are saved with their current address, so references to them must be updated
+  Node* n = loaded_ptrs_.value(p);
+  if (n) {
+    return (n->parent() == this) ? reinterpret_cast<quintptr>(n) : 0;
+  }
+
+  // Deferred nodes get a token that's unique to this project. Tokens are odd numbers, so they
+  // can't collide with the address of a node.
+  return deferred_tokens_.value(p, 0);
+}
+
+void Project::WriteDeferredRecord(XMLWriter *writer, const QByteArray &record) const
+{
+  XMLReader reader(record);
+  QVector<QString> names;
+
+  while (reader.readNext() != QXmlStreamReader::Invalid
+         && reader.tokenType() != QXmlStreamReader::EndDocument) {
+    if (reader.isStartElement()) {
+      names.append(reader.name().toString());
+      writer->writeStartElement(names.last());
+
+      foreach (const QXmlStreamAttribute& attr, reader.attributes()) {
+        writer->writeAttribute(attr.name().toString(), attr.value().toString());
+      }
+    } else if (reader.isEndElement()) {
+      names.removeLast();
+      writer->writeEndElement();
+    } else if (reader.tokenType() == QXmlStreamReader::Characters) {
+      int sz = names.size();
+
+      // Pointers in a node are its own "ptr" and those referenced by its links and connections
+      if ((sz == 2 && names.at(1) == QStringLiteral("ptr"))
+          || (sz >= 3 && names.at(sz-1) == QStringLiteral("link") && names.at(sz-2) == QStringLiteral("links"))
+          || (sz >= 3 && names.at(sz-1) == QStringLiteral("node") && names.at(sz-2) == QStringLiteral("connection"))) {
+        writer->writeCharacters(QString::number(RemapDeferredPointer(reader.text().toULongLong())));
+      } else {
+        writer->writeCharacters(reader.text().toString());
+      }
+    }
+  }
+}
+
+void Project::LoadDeferredSequence(Sequence *sequence)
+{
+  auto it = deferred_sequences_.find(sequence);
+
+  if (it == deferred_sequences_.end()) {
+    return;
+  }
+
+  DeferredSequence deferred = it.value();
+  deferred_sequences_.erase(it);
+
+  QThreadPool pool;
+  QVector< QFuture<LoadedNode> > futures;
+  QThread* target_thread = QThread::currentThread();
+  uint version = load_version_;
+
+  foreach (const NodeRecord& r, deferred.nodes) {
+    futures.append(QtConcurrent::run(&pool, [r, version, target_thread]{
+      return LoadNodeRecord(r.id, r.record, version, nullptr, target_thread);
+    }));
+  }
+
+  // Start from nodes loaded with the project that are still in it
+  XMLNodeData xml_node_data;
+  for (auto jt=loaded_ptrs_.cbegin(); jt!=loaded_ptrs_.cend(); jt++) {
+    if (jt.value() && jt.value()->parent() == this) {
+      xml_node_data.node_ptrs.insert(jt.key(), jt.value());
+    }
+  }
+
+  QVector<Node*> loaded_nodes;
+
+  foreach (QFuture<LoadedNode> f, futures) {
+    LoadedNode loaded = f.result();
+
+    if (!loaded.node) {
+      continue;
+    }
+
+    loaded.node->setParent(this);
+    loaded_nodes.append(loaded.node);
+
+    for (auto jt=loaded.data.node_ptrs.cbegin(); jt!=loaded.data.node_ptrs.cend(); jt++) {
+      xml_node_data.node_ptrs.insert(jt.key(), jt.value());
+    }
+    xml_node_data.desired_connections.append(loaded.data.desired_connections);
+    xml_node_data.block_links.append(loaded.data.block_links);
+  }
+
+  xml_node_data.desired_connections.append(deferred.connections);
+
+  sequence->SetContentDeferred(false);
+
+  XMLConnectNodes(xml_node_data);
+  XMLLinkBlocks(xml_node_data);
+
+  // Sequences nested in this one need their contents too
+  foreach (Node* n, loaded_nodes) {
+    for (auto jt=n->input_connections().cbegin(); jt!=n->input_connections().cend(); jt++) {
+      if (Sequence* nested = dynamic_cast<Sequence*>(jt->second.node())) {
+        LoadDeferredSequence(nested);
+      }
+    }
+  }
+}
+
+void Project::LoadDeferredSequencesUsing(Node *node)
+{
+  if (deferred_sequences_.isEmpty()) {
+    return;
+  }
+
+  QVector<quintptr> ptrs;
+  for (auto it=loaded_ptrs_.cbegin(); it!=loaded_ptrs_.cend(); it++) {
+    if (it.value() == node) {
+      ptrs.append(it.key());
+    }
+  }
+
+  QVector<Sequence*> users;
+  for (auto it=deferred_sequences_.cbegin(); it!=deferred_sequences_.cend(); it++) {
+    foreach (quintptr p, ptrs) {
+      if (it.value().external.contains(p)) {
+        users.append(it.key());
+        break;
+      }
+    }
+  }
+
+  foreach (Sequence* s, users) {
+    LoadDeferredSequence(s);
+  }
+}
+
+void Project::LoadAllDeferredSequences()
+{
+  while (!deferred_sequences_.isEmpty()) {
+    LoadDeferredSequence(deferred_sequences_.begin().key());
+  }
+}
+
+ProjectSnapshot *Project::autorecovery_snapshot()
+{
+  if (!autorecovery_snapshot_) {
+    autorecovery_snapshot_ = new ProjectSnapshot(this);
+  }
+
+  return autorecovery_snapshot_;
+}
+
+void Project::Save(XMLWriter *writer) const
 {
   writer->writeTextElement(QStringLiteral("uuid"), uuid_.toString());
 
   writer->writeStartElement(QStringLiteral("nodes"));
 
   foreach (Node* node, nodes()) {
-    writer->writeStartElement(QStringLiteral("node"));
-
-    if (node == root_) {
-      writer->writeAttribute(QStringLiteral("root"), QStringLiteral("1"));
-    } else if (node == color_manager_) {
-      writer->writeAttribute(QStringLiteral("cm"), QStringLiteral("1"));
-    } else if (node == settings_) {
-      writer->writeAttribute(QStringLiteral("settings"), QStringLiteral("1"));
-    }
+    SaveNode(writer, node);
+  }
 
-    writer->writeAttribute(QStringLiteral("id"), node->id());
+  SaveDeferredNodes(writer);
 
-    node->Save(writer);
+  writer->writeEndElement(); // nodes
 
-    writer->writeEndElement(); // node
+  // Save main window project layout, there's none when saving headless (e.g. from benchmarks)
+  if (Core::instance() && Core::instance()->main_window()) {
+    MainWindowLayoutInfo main_window_info = Core::instance()->main_window()->SaveLayout();
+    main_window_info.toXml(writer);
   }
+}
 
-  writer->writeEndElement(); // nodes
+void Project::SaveNode(XMLWriter *writer, Node *node) const
+{
+  writer->writeStartElement(QStringLiteral("node"));
+
+  if (node == root_) {
+    writer->writeAttribute(QStringLiteral("root"), QStringLiteral("1"));
+  } else if (node == color_manager_) {
+    writer->writeAttribute(QStringLiteral("cm"), QStringLiteral("1"));
+  } else if (node == settings_) {
+    writer->writeAttribute(QStringLiteral("settings"), QStringLiteral("1"));
+  }
+
+  writer->writeAttribute(QStringLiteral("id"), node->id());
+
+  node->Save(writer);
 
-  // Save main window project layout
-  MainWindowLayoutInfo main_window_info = Core::instance()->main_window()->SaveLayout();
-  main_window_info.toXml(writer);
+  if (Sequence* sequence = dynamic_cast<Sequence*>(node)) {
+    // Connections to a deferred sequence's tracks aren't made yet, write them out so they're
+    // loaded again next time
+    auto it = deferred_sequences_.constFind(sequence);
+
+    if (it != deferred_sequences_.cend()) {
+      writer->writeStartElement(QStringLiteral("connections"));
+      foreach (const XMLNodeData::SerializedConnection& c, it.value().connections) {
+        writer->writeStartElement(QStringLiteral("connection"));
+
+        writer->writeAttribute(QStringLiteral("input"), c.input.input());
+        writer->writeAttribute(QStringLiteral("element"), QString::number(c.input.element()));
+
+        writer->writeTextElement(QStringLiteral("node"), QString::number(RemapDeferredPointer(c.output_node)));
+        writer->writeTextElement(QStringLiteral("output"), c.output);
+
+        writer->writeEndElement(); // connection
+      }
+      writer->writeEndElement(); // connections
+    }
+  }
+
+  writer->writeEndElement(); // node
+}
+
+void Project::SaveDeferredNodes(XMLWriter *writer) const
+{
+  // Write the nodes of deferred sequences back out as they were read
+  for (auto it=deferred_sequences_.cbegin(); it!=deferred_sequences_.cend(); it++) {
+    foreach (const NodeRecord& r, it.value().nodes) {
+      WriteDeferredRecord(writer, r.record);
+    }
+  }
 }
 
 Folder *Project::root()
@@ -23,16 +23,20 @@
 
 #include <memory>
 #include <QObject>
+#include <QPointer>
 #include <QUuid>
 
 #include "node/color/colormanager/colormanager.h"
 #include "node/output/viewer/viewer.h"
 #include "node/project/footage/footage.h"
 #include "node/project/projectsettings/projectsettings.h"
+#include "node/project/sequence/sequence.h"
 #include "window/mainwindow/mainwindowlayoutinfo.h"
 
 namespace olive {
 
+class ProjectSnapshot;
+
 /**
  * @brief A project instance containing all the data pertaining to the user's project
  *
@@ -50,9 +54,19 @@ class Project : public NodeGraph
 public:
   Project();
 
-  void Load(QXmlStreamReader* reader, MainWindowLayoutInfo *layout, uint version, const QAtomicInt* cancelled);
+  void Load(XMLReader* reader, MainWindowLayoutInfo *layout, uint version, const QAtomicInt* cancelled);
+
+  void Save(XMLWriter* writer) const;
+
+  /**
+   * @brief Writes a single node's element as it appears in the project's "nodes" section
+   */
+  void SaveNode(XMLWriter* writer, Node* node) const;
 
-  void Save(QXmlStreamWriter* writer) const;
+  /**
+   * @brief Writes the nodes of sequences whose contents are still deferred
+   */
+  void SaveDeferredNodes(XMLWriter* writer) const;
 
   Folder* root();
 
@@ -82,12 +96,73 @@ public:
 
   void RegenerateUuid();
 
+  /**
+   * @brief Loads the tracks and clips of a sequence whose contents were deferred at project load
+   *
+   * Does nothing if the sequence was already fully loaded. Any sequences nested inside it are
+   * loaded too. Must be called from the thread the project lives in.
+   */
+  void LoadDeferredSequence(Sequence* sequence);
+
+  /**
+   * @brief Loads every deferred sequence that contains a connection to `node`
+   *
+   * Used before operations that need to see every user of a node, such as deleting it.
+   */
+  void LoadDeferredSequencesUsing(Node* node);
+
+  /**
+   * @brief Loads every sequence that is still deferred
+   */
+  void LoadAllDeferredSequences();
+
+  /**
+   * @brief Returns the incrementally updated snapshot used to write auto-recoveries
+   *
+   * Created on first use, after which it tracks changes to this project's nodes.
+   */
+  ProjectSnapshot* autorecovery_snapshot();
+
 signals:
   void NameChanged();
 
   void ModifiedChanged(bool e);
 
 private:
+  struct LoadedNode {
+    LoadedNode() :
+      node(nullptr)
+    {
+    }
+
+    Node* node;
+    XMLNodeData data;
+  };
+
+  struct NodeRecord {
+    QString id;
+    QByteArray record;
+    quintptr ptr;
+    QVector<quintptr> inputs;
+    QVector<quintptr> links;
+  };
+
+  struct DeferredSequence {
+    QVector<NodeRecord> nodes;
+    QList<XMLNodeData::SerializedConnection> connections;
+    QSet<quintptr> external;
+  };
+
+  static LoadedNode LoadNodeRecord(const QString& id, const QByteArray& record, uint version, const QAtomicInt* cancelled, QThread* target_thread);
+
+  static void ScanNodeRecord(NodeRecord* r);
+
+  static QVector<int> FindDeferrableRecords(const QVector<NodeRecord>& records, const XMLNodeData& loaded_data);
+
+  quintptr RemapDeferredPointer(quintptr p) const;
+
+  void WriteDeferredRecord(XMLWriter* writer, const QByteArray& record) const;
+
   QUuid uuid_;
 
   Folder* root_;
@@ -102,6 +177,16 @@ private:
 
   bool autorecovery_saved_;
 
+  QHash<Sequence*, DeferredSequence> deferred_sequences_;
+
+  QHash<quintptr, QPointer<Node> > loaded_ptrs_;
+
+  QHash<quintptr, quintptr> deferred_tokens_;
+
+  uint load_version_;
+
+  ProjectSnapshot* autorecovery_snapshot_;
+
 private slots:
   void ColorManagerValueChanged(const NodeInput& input, const TimeRange& range);
 
@@ -0,0 +1,258 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "projectsnapshot.h"
+
+#include <QBuffer>
+#include <QFile>
+
+#include "common/filefunctions.h"
+#include "common/xmlutils.h"
+#include "core.h"
+#include "node/project/project.h"
+#include "window/mainwindow/mainwindow.h"
+
+namespace olive {
+
+const int ProjectSnapshot::kFullSnapshotInterval = 10;
+
+namespace {
+
+template <typename F>
+QByteArray CaptureRecord(F write)
+{
+  QByteArray data;
+  QBuffer buffer(&data);
+  buffer.open(QBuffer::WriteOnly);
+
+  {
+    XMLWriter writer(&buffer, XMLWriter::kBinary);
+    writer.writeStartDocument();
+    write(&writer);
+    writer.writeEndDocument();
+  }
+
+  return data;
+}
+
+}
+
+ProjectSnapshot::ProjectSnapshot(Project *project) :
+  QObject(project),
+  project_(project),
+  deferred_nodes_dirty_(true),
+  snapshots_since_full_(0)
+{
+  connect(project_, &Project::NodeAdded, this, &ProjectSnapshot::NodeAdded);
+  connect(project_, &Project::NodeRemoved, this, &ProjectSnapshot::NodeRemoved);
+  connect(project_, &Project::BatchCommitted, this, &ProjectSnapshot::BatchCommitted);
+
+  foreach (Node* n, project_->nodes()) {
+    ConnectNode(n);
+  }
+}
+
+ProjectSnapshot::Data ProjectSnapshot::Take()
+{
+  snapshots_since_full_++;
+  if (snapshots_since_full_ >= kFullSnapshotInterval) {
+    records_.clear();
+    deferred_nodes_dirty_ = true;
+    snapshots_since_full_ = 0;
+  }
+
+  Data data;
+
+  data.uuid = project_->GetUuid().toString();
+
+  data.nodes.reserve(project_->nodes().size());
+  foreach (Node* n, project_->nodes()) {
+    auto it = records_.find(n);
+
+    if (it == records_.end()) {
+      it = records_.insert(n, CaptureRecord([this, n](XMLWriter* writer){
+        project_->SaveNode(writer, n);
+      }));
+    }
+
+    data.nodes.append(it.value());
+  }
+
+  if (deferred_nodes_dirty_) {
+    deferred_nodes_ = CaptureRecord([this](XMLWriter* writer){
+      writer->writeStartElement(QStringLiteral("nodes"));
+      project_->SaveDeferredNodes(writer);
+      writer->writeEndElement(); // nodes
+    });
+    deferred_nodes_dirty_ = false;
+  }
+  data.deferred_nodes = deferred_nodes_;
+
+  // The layout is small and has no change signals, so it's always captured
+  MainWindowLayoutInfo main_window_info = Core::instance()->main_window()->SaveLayout();
+  data.layout = CaptureRecord([&main_window_info](XMLWriter* writer){
+    main_window_info.toXml(writer);
+  });
+
+  return data;
+}
+
+bool ProjectSnapshot::Write(const Data &data, const QString &filename)
+{
+  QString temp_save = FileFunctions::GetSafeTemporaryFilename(filename);
+
+  QFile file(temp_save);
+
+  if (!file.open(QFile::WriteOnly)) {
+    return false;
+  }
+
+  bool error;
+
+  {
+    XMLWriter writer(&file, XMLWriter::kBinary);
+
+    writer.writeStartDocument();
+
+    writer.writeStartElement(QStringLiteral("olive"));
+
+    writer.writeTextElement(QStringLiteral("version"), QString::number(Core::kProjectVersion));
+
+    writer.writeTextElement(QStringLiteral("url"), filename);
+
+    writer.writeStartElement(QStringLiteral("project"));
+
+    writer.writeTextElement(QStringLiteral("uuid"), data.uuid);
+
+    writer.writeStartElement(QStringLiteral("nodes"));
+
+    foreach (const QByteArray& record, data.nodes) {
+      XMLWriteCapturedElement(&writer, record);
+    }
+
+    {
+      XMLReader reader(data.deferred_nodes);
+
+      if (XMLReadNextStartElement(&reader)) {
+        while (XMLReadNextStartElement(&reader)) {
+          XMLCopyElement(&reader, &writer);
+        }
+      }
+    }
+
+    writer.writeEndElement(); // nodes
+
+    XMLWriteCapturedElement(&writer, data.layout);
+
+    writer.writeEndElement(); // project
+
+    writer.writeEndElement(); // olive
+
+    writer.writeEndDocument();
+
+    error = writer.hasError();
+  }
+
+  file.close();
+
+  if (error) {
+    QFile::remove(temp_save);
+    return false;
+  }
+
+  return FileFunctions::RenameFileAllowOverwrite(temp_save, filename);
+}
+
+void ProjectSnapshot::ConnectNode(Node *node)
+{
+  if (connected_nodes_.contains(node)) {
+    return;
+  }
+
+  connected_nodes_.insert(node);
+
+  auto dirty = [this, node]{ MarkDirty(node); };
+
+  connect(node, &Node::PositionChanged, this, dirty);
+  connect(node, &Node::LabelChanged, this, dirty);
+  connect(node, &Node::ColorChanged, this, dirty);
+  connect(node, &Node::ValueChanged, this, dirty);
+  connect(node, &Node::InputConnected, this, dirty);
+  connect(node, &Node::InputDisconnected, this, dirty);
+  connect(node, &Node::InputPropertyChanged, this, dirty);
+  connect(node, &Node::LinksChanged, this, dirty);
+  connect(node, &Node::InputArraySizeChanged, this, dirty);
+  connect(node, &Node::KeyframeAdded, this, dirty);
+  connect(node, &Node::KeyframeRemoved, this, dirty);
+  connect(node, &Node::KeyframeTimeChanged, this, dirty);
+  connect(node, &Node::KeyframeEnableChanged, this, dirty);
+
+  if (ViewerOutput* viewer = dynamic_cast<ViewerOutput*>(node)) {
+    // Sequences save a summary of their length, and all viewers save their timeline points
+    connect(viewer, &ViewerOutput::LengthChanged, this, dirty);
+    connect(viewer->GetTimelinePoints()->markers(), &TimelineMarkerList::MarkerAdded, this, dirty);
+    connect(viewer->GetTimelinePoints()->markers(), &TimelineMarkerList::MarkerRemoved, this, dirty);
+    connect(viewer->GetTimelinePoints()->workarea(), &TimelineWorkArea::EnabledChanged, this, dirty);
+    connect(viewer->GetTimelinePoints()->workarea(), &TimelineWorkArea::RangeChanged, this, dirty);
+  }
+
+  if (Track* track = dynamic_cast<Track*>(node)) {
+    connect(track, &Track::TrackHeightChangedInPixels, this, dirty);
+  }
+
+  connect(node, &QObject::destroyed, this, [this, node]{
+    connected_nodes_.remove(node);
+    records_.remove(node);
+  });
+}
+
+void ProjectSnapshot::MarkDirty(Node *node)
+{
+  records_.remove(node);
+}
+
+void ProjectSnapshot::NodeAdded(Node *node)
+{
+  ConnectNode(node);
+
+  // Loading a deferred sequence adds nodes and removes them from the deferred set
+  deferred_nodes_dirty_ = true;
+}
+
+void ProjectSnapshot::NodeRemoved(Node *node)
+{
+  records_.remove(node);
+
+  // Deferred nodes that referenced this node will no longer connect to it
+  deferred_nodes_dirty_ = true;
+}
+
+void ProjectSnapshot::BatchCommitted(const NodeGraphChangeSet &changes)
+{
+  foreach (Node* node, changes.removed) {
+    NodeRemoved(node);
+  }
+
+  foreach (Node* node, changes.added) {
+    NodeAdded(node);
+  }
+}
+
+}
@@ -0,0 +1,106 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROJECTSNAPSHOT_H
+#define PROJECTSNAPSHOT_H
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QVector>
+
+#include "node/node.h"
+
+namespace olive {
+
+class NodeGraphChangeSet;
+
+class Project;
+
+/**
+ * @brief Incrementally maintained serialization of a Project, used for auto-recovery
+ *
+ * Each node's element is kept as a captured binary record (see XMLCaptureElement()) and only nodes
+ * that changed since the last snapshot are serialized again, so taking a snapshot costs roughly
+ * what was edited rather than the size of the whole project. The resulting Data holds no
+ * references to the project and can be written to disk from any thread.
+ *
+ * Changes are picked up from node signals. Not every piece of saved state has one (e.g. renaming a
+ * marker), so every kFullSnapshotInterval snapshots all records are rebuilt from scratch, which
+ * bounds how stale a record can get.
+ */
+class ProjectSnapshot : public QObject
+{
+  Q_OBJECT
+public:
+  ProjectSnapshot(Project* project);
+
+  struct Data {
+    QString uuid;
+    QVector<QByteArray> nodes;
+    QByteArray deferred_nodes;
+    QByteArray layout;
+  };
+
+  /**
+   * @brief Bring all records up to date and return them
+   *
+   * Must be called from the thread the project lives in.
+   */
+  Data Take();
+
+  /**
+   * @brief Write a snapshot out as a complete project file
+   *
+   * Safe to call from any thread.
+   */
+  static bool Write(const Data& data, const QString& filename);
+
+  static const int kFullSnapshotInterval;
+
+private:
+  void ConnectNode(Node* node);
+
+  void MarkDirty(Node* node);
+
+  Project* project_;
+
+  QHash<Node*, QByteArray> records_;
+
+  QSet<Node*> connected_nodes_;
+
+  QByteArray deferred_nodes_;
+
+  bool deferred_nodes_dirty_;
+
+  int snapshots_since_full_;
+
+private slots:
+  void NodeAdded(Node* node);
+
+  void NodeRemoved(Node* node);
+
+  void BatchCommitted(const NodeGraphChangeSet& changes);
+
+};
+
+}
+
+#endif // PROJECTSNAPSHOT_H
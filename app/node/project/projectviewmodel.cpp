@@ -22,6 +22,7 @@
 
 #include <QDebug>
 #include <QMimeData>
+#include <QSet>
 #include <QUrl>
 
 #include "core.h"
@@ -30,6 +31,8 @@
 
 namespace olive {
 
+const int ProjectViewModel::kSortRole = Qt::UserRole + 1;
+
 ProjectViewModel::ProjectViewModel(QObject *parent) :
   QAbstractItemModel(parent),
   project_(nullptr)
@@ -54,6 +57,7 @@ void ProjectViewModel::set_project(Project *p)
   }
 
   project_ = p;
+  row_cache_.clear();
 
   if (project_) {
     ConnectItem(project_->root());
@@ -158,6 +162,28 @@ QVariant ProjectViewModel::data(const QModelIndex &index, int role) const
     return internal_item->ToolTip();
   }
 
+  if (role == kSortRole) {
+    ViewerOutput* viewer = dynamic_cast<ViewerOutput*>(internal_item);
+
+    switch (column_type) {
+    case kName:
+      return internal_item->GetLabel();
+    case kDuration:
+      return viewer ? viewer->GetLength().toDouble() : -1.0;
+    case kRate:
+      if (viewer) {
+        VideoParams video = viewer->GetFirstEnabledVideoStream();
+
+        if (video.is_valid() && video.video_type() != VideoParams::kVideoTypeStill) {
+          return video.frame_rate().toDouble();
+        } else if (viewer->HasEnabledAudioStreams()) {
+          return double(viewer->GetFirstEnabledAudioStream().sample_rate());
+        }
+      }
+      return -1.0;
+    }
+  }
+
   return QVariant();
 }
 
@@ -262,7 +288,7 @@ QMimeData *ProjectViewModel::mimeData(const QModelIndexList &indexes) const
 
   // The indexes list includes indexes for each column which we don't use. To make sure each row only gets sent *once*,
   // we keep a list of dragged items
-  QVector<void*> dragged_items;
+  QSet<void*> dragged_items;
 
   foreach (QModelIndex index, indexes) {
     if (index.isValid()) {
@@ -276,7 +302,7 @@ QMimeData *ProjectViewModel::mimeData(const QModelIndexList &indexes) const
 
           stream << streams << reinterpret_cast<quintptr>(footage);
 
-          dragged_items.append(footage);
+          dragged_items.insert(footage);
         }
       }
     }
@@ -389,11 +415,28 @@ int ProjectViewModel::IndexOfChild(Node *item) const
   // Find parent's index within its own parent
   Folder* parent = item->folder();
 
-  if (parent) {
-    return parent->index_of_child(item);
+  if (!parent) {
+    return -1;
+  }
+
+  QHash<Node*, int>::const_iterator cached = row_cache_.constFind(item);
+  if (cached != row_cache_.constEnd()) {
+    return cached.value();
   }
 
-  return -1;
+  // Cache the whole folder at once, the view will likely ask about its siblings next
+  for (int i=0; i<parent->item_child_count(); i++) {
+    row_cache_.insert(parent->item_child(i), i);
+  }
+
+  return row_cache_.value(item, -1);
+}
+
+void ProjectViewModel::InvalidateRowCache(Folder *folder)
+{
+  foreach (Node* c, folder->children()) {
+    row_cache_.remove(c);
+  }
 }
 
 Node *ProjectViewModel::GetItemObjectFromIndex(const QModelIndex &index) const
@@ -458,6 +501,7 @@ void ProjectViewModel::FolderBeginInsertItem(Node *n, int insert_index)
   Folder* folder = static_cast<Folder*>(sender());
 
   ConnectItem(n);
+  InvalidateRowCache(folder);
 
   QModelIndex index;
 
@@ -470,6 +514,10 @@ void ProjectViewModel::FolderBeginInsertItem(Node *n, int insert_index)
 
 void ProjectViewModel::FolderEndInsertItem()
 {
+  // Rows may have been cached again while the views were notified, so invalidate again now that
+  // the item is actually in the folder
+  InvalidateRowCache(static_cast<Folder*>(sender()));
+
   endInsertRows();
 }
 
@@ -478,6 +526,7 @@ void ProjectViewModel::FolderBeginRemoveItem(Node *n, int child_index)
   Folder* folder = static_cast<Folder*>(sender());
 
   DisconnectItem(n);
+  InvalidateRowCache(folder);
 
   QModelIndex index;
 
@@ -490,6 +539,9 @@ void ProjectViewModel::FolderBeginRemoveItem(Node *n, int child_index)
 
 void ProjectViewModel::FolderEndRemoveItem()
 {
+  // The removed item is no longer one of the folder's children, so it must be forgotten separately
+  row_cache_.clear();
+
   endRemoveRows();
 }
 
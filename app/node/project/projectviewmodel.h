@@ -104,6 +104,14 @@ public:
    */
   QModelIndex CreateIndexFromItem(Node *item, int column = 0);
 
+  /**
+   * @brief Role that returns a value to sort each column by
+   *
+   * Cheaper to produce and compare than the display text, e.g. durations are sorted by their length
+   * rather than by formatting and comparing timecode strings.
+   */
+  static const int kSortRole;
+
 private:
   /**
    * @brief Retrieve the index of `item` in its parent
@@ -135,8 +143,21 @@ private:
 
   void DisconnectItem(Node *n);
 
+  /**
+   * @brief Forget cached rows of a folder's children, called whenever the folder's contents change
+   */
+  void InvalidateRowCache(Folder* folder);
+
   Project* project_;
 
+  /**
+   * @brief Row of each item within its folder
+   *
+   * Views look up parents of indexes constantly, so this saves searching the whole folder every
+   * time in bins with many items. Rows are filled in a whole folder at a time.
+   */
+  mutable QHash<Node*, int> row_cache_;
+
   QVector<ColumnType> columns_;
 
 private slots:
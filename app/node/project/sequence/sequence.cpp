@@ -31,10 +31,12 @@ const QString Sequence::kTrackInputFormat = QStringLiteral("track_in_%1");
 
 #define super ViewerOutput
 
-Sequence::Sequence()
+Sequence::Sequence() :
+  content_deferred_(false)
 {
   // Create TrackList instances
   track_lists_.resize(Track::kCount);
+  saved_lengths_.resize(Track::kCount);
 
   for (int i=0;i<Track::kCount;i++) {
     // Create track input
@@ -89,6 +91,14 @@ QVector<Track *> Sequence::GetUnlockedTracks() const
   return tracks;
 }
 
+void Sequence::SetContentDeferred(bool e)
+{
+  if (content_deferred_ != e) {
+    content_deferred_ = e;
+    VerifyLength();
+  }
+}
+
 void Sequence::Retranslate()
 {
   super::Retranslate();
@@ -119,6 +129,10 @@ void Sequence::Retranslate()
 
 rational Sequence::VerifyLengthInternal(Track::Type type) const
 {
+  if (content_deferred_) {
+    return (type >= 0 && type < saved_lengths_.size()) ? saved_lengths_.at(type) : rational(0);
+  }
+
   if (!track_lists_.isEmpty()) {
     switch (type) {
     case Track::kVideo:
@@ -136,6 +150,50 @@ rational Sequence::VerifyLengthInternal(Track::Type type) const
   return 0;
 }
 
+bool Sequence::LoadCustom(XMLReader *reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt *cancelled)
+{
+  if (reader->name() == QStringLiteral("lengths")) {
+    while (XMLReadNextStartElement(reader)) {
+      if (reader->name() == QStringLiteral("length")) {
+        int type = -1;
+
+        XMLAttributeLoop(reader, attr) {
+          if (attr.name() == QStringLiteral("type")) {
+            type = attr.value().toInt();
+          }
+        }
+
+        rational length = rational::fromString(reader->readElementText());
+
+        if (type >= 0 && type < saved_lengths_.size()) {
+          saved_lengths_.replace(type, length);
+        }
+      } else {
+        reader->skipCurrentElement();
+      }
+    }
+    return true;
+  } else {
+    return super::LoadCustom(reader, xml_node_data, version, cancelled);
+  }
+}
+
+void Sequence::SaveCustom(XMLWriter *writer) const
+{
+  super::SaveCustom(writer);
+
+  // Write a summary of the track lengths so this sequence can be described without loading its
+  // contents
+  writer->writeStartElement(QStringLiteral("lengths"));
+  for (int i=0; i<Track::kCount; i++) {
+    writer->writeStartElement(QStringLiteral("length"));
+    writer->writeAttribute(QStringLiteral("type"), QString::number(i));
+    writer->writeCharacters(VerifyLengthInternal(static_cast<Track::Type>(i)).toString());
+    writer->writeEndElement(); // length
+  }
+  writer->writeEndElement(); // lengths
+}
+
 void Sequence::InputConnectedEvent(const QString &input, int element, const NodeOutput &output)
 {
   foreach (TrackList* list, track_lists_) {
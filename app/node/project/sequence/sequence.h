@@ -96,6 +96,20 @@ public:
     return true;
   }
 
+  /**
+   * @brief Returns whether this sequence's tracks and clips have not been loaded yet
+   *
+   * Projects can defer loading the contents of a sequence until it's first opened (see
+   * Project::LoadDeferredSequence). While deferred, the sequence reports the lengths it was saved
+   * with so it can still be summarized in the project explorer.
+   */
+  bool IsContentDeferred() const
+  {
+    return content_deferred_;
+  }
+
+  void SetContentDeferred(bool e);
+
 protected:
   virtual void ShiftAudioEvent(const rational &from, const rational &to) override;
 
@@ -105,6 +119,10 @@ protected:
 
   virtual rational VerifyLengthInternal(Track::Type type) const override;
 
+  virtual bool LoadCustom(XMLReader* reader, XMLNodeData &xml_node_data, uint version, const QAtomicInt* cancelled) override;
+
+  virtual void SaveCustom(XMLWriter *writer) const override;
+
 signals:
   void TrackAdded(Track* track);
   void TrackRemoved(Track* track);
@@ -114,6 +132,10 @@ private:
 
   QVector<Track*> track_cache_;
 
+  bool content_deferred_;
+
+  QVector<rational> saved_lengths_;
+
 private slots:
   void UpdateTrackCache();
 
@@ -20,12 +20,17 @@
 
 #include "timeremap.h"
 
+#include <cmath>
+
 #include "widget/slider/rationalslider.h"
 
 namespace olive {
 
 const QString TimeRemapNode::kTimeInput = QStringLiteral("time_in");
 const QString TimeRemapNode::kInputInput = QStringLiteral("input_in");
+const QString TimeRemapNode::kInterpolationInput = QStringLiteral("interpolation_in");
+
+const int TimeRemapNode::kOpticalFlowPasses = 4;
 
 #define super Node
 
@@ -36,6 +41,8 @@ TimeRemapNode::TimeRemapNode()
   SetInputProperty(kTimeInput, QStringLiteral("viewlock"), true);
 
   AddInput(kInputInput, NodeValue::kNone, InputFlags(kInputFlagNotKeyframable));
+
+  AddInput(kInterpolationInput, NodeValue::kCombo, kInterpolationNearest, InputFlags(kInputFlagNotConnectable | kInputFlagNotKeyframable));
 }
 
 Node *TimeRemapNode::copy() const
@@ -86,10 +93,24 @@ TimeRange TimeRemapNode::OutputTimeAdjustment(const QString &input, int element,
   return super::OutputTimeAdjustment(input, element, input_time);
 }
 
+QVector<TimeRange> TimeRemapNode::InputTimeSamples(const QString &input, const TimeRange &input_time) const
+{
+  if (input == kInputInput && GetBlendFactor(input_time.in(), input_time.length()) > 0.0) {
+    // Blending also needs the frame after the one InputTimeAdjustment() lands on
+    rational next_time = GetRemappedTime(input_time.in()) + input_time.length();
+
+    return {TimeRange(next_time, next_time + input_time.length())};
+  }
+
+  return super::InputTimeSamples(input, input_time);
+}
+
 void TimeRemapNode::Retranslate()
 {
   SetInputName(kTimeInput, QStringLiteral("Time"));
   SetInputName(kInputInput, QStringLiteral("Input"));
+  SetInputName(kInterpolationInput, tr("Interpolation"));
+  SetComboBoxStrings(kInterpolationInput, {tr("Nearest Frame"), tr("Frame Blending"), tr("Optical Flow")});
 }
 
 QVector<QString> TimeRemapNode::inputs_for_output(const QString &output) const
@@ -98,19 +119,118 @@ QVector<QString> TimeRemapNode::inputs_for_output(const QString &output) const
   return {kInputInput};
 }
 
-void TimeRemapNode::Hash(const QString &output, QCryptographicHash &hash, const rational &time, const VideoParams &video_params) const
+void TimeRemapNode::Hash(const QString &output, Hasher &hash, const rational &time, const VideoParams &video_params) const
 {
   // Don't hash anything of our own, just pass-through to the connected node at the remapped tmie
   Q_UNUSED(output)
   if (IsInputConnected(kInputInput)) {
     NodeOutput out = GetConnectedOutput(kInputInput);
     out.node()->Hash(out.output(), hash, GetRemappedTime(time), video_params);
+
+    rational frame_length = video_params.frame_rate_as_time_base();
+    double factor = GetBlendFactor(time, frame_length);
+
+    if (factor > 0.0) {
+      // Blended frames also depend on the next frame and how far between the two they are
+      hash.add(GetStandardValue(kInterpolationInput).toInt());
+      hash.add(factor);
+      out.node()->Hash(out.output(), hash, GetRemappedTime(time) + frame_length, video_params);
+    }
   }
 }
 
+QVector<TimeRange> TimeRemapNode::GetConstantRanges(const QString &output, const TimeRange &range) const
+{
+  Q_UNUSED(output)
+
+  // OutputTimeAdjustment() can't invert an arbitrary remap, so we only handle the case where the
+  // remapped time never changes. That freezes the connected node on a single frame.
+  if (!IsInputConnected(kInputInput) || IsInputStatic(kTimeInput)) {
+    return {range};
+  }
+
+  return QVector<TimeRange>();
+}
+
+NodeValueTable TimeRemapNode::Value(const QString &output, NodeValueDatabase &value) const
+{
+  Q_UNUSED(output)
+
+  QString next_key = GetInputSampleKey(kInputInput, 0);
+  NodeValue next_frame;
+
+  if (value.contains(next_key)) {
+    // Take the next frame so it isn't merged into our output
+    next_frame = value[next_key].GetWithMeta(NodeValue::kTexture);
+    value.Insert(next_key, NodeValueTable());
+  }
+
+  NodeValueTable table = value.Merge();
+
+  if (next_frame.data().value<TexturePtr>() && table.Has(NodeValue::kTexture)) {
+    NodeValue frame = table.TakeWithMeta(NodeValue::kTexture);
+
+    rational time = rational::fromDouble(value[QStringLiteral("global")].Get(NodeValue::kFloat, QStringLiteral("time_in")).toDouble());
+    rational frame_length = rational::fromDouble(value[QStringLiteral("global")].Get(NodeValue::kFloat, QStringLiteral("time_out")).toDouble()) - time;
+
+    ShaderJob job;
+    job.InsertValue(QStringLiteral("frame_a"), frame);
+    job.InsertValue(QStringLiteral("frame_b"), next_frame);
+    job.InsertValue(QStringLiteral("blend_in"), NodeValue(NodeValue::kFloat, GetBlendFactor(time, frame_length), this));
+
+    if (GetStandardValue(kInterpolationInput).toInt() == kInterpolationOpticalFlow) {
+      job.SetShaderID(QStringLiteral("flow"));
+      job.InsertValue(QStringLiteral("resolution_in"), value[QStringLiteral("global")].GetWithMeta(NodeValue::kVec2, QStringLiteral("resolution")));
+      job.InsertValue(QStringLiteral("flow_passes"), NodeValue(NodeValue::kInt, kOpticalFlowPasses, this));
+
+      // Every pass but the last replaces the flow with a refined one, starting from nothing
+      job.InsertValue(QStringLiteral("flow_in"), frame);
+      job.SetIterations(kOpticalFlowPasses + 1, QStringLiteral("flow_in"));
+      job.SetInterpolation(QStringLiteral("flow_in"), Texture::kNearest);
+
+      // Flow is measured in pixels and wouldn't fit 8 bits
+      job.SetRequiresFullPrecision(true);
+
+      // Coarse passes search across the whole frame
+      job.SetSamplingFootprint(ShaderJob::kFootprintWholeFrame);
+    }
+
+    table.Push(NodeValue::kShaderJob, QVariant::fromValue(job), this);
+  }
+
+  return table;
+}
+
+ShaderCode TimeRemapNode::GetShaderCode(const QString &shader_id) const
+{
+  if (shader_id == QStringLiteral("flow")) {
+    return ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/opticalflow.frag")));
+  }
+
+  return ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/frameblend.frag")));
+}
+
 rational TimeRemapNode::GetRemappedTime(const rational &input) const
 {
   return GetValueAtTime(kTimeInput, input).value<rational>();
 }
 
+double TimeRemapNode::GetBlendFactor(const rational &time, const rational &frame_length) const
+{
+  if (GetStandardValue(kInterpolationInput).toInt() == kInterpolationNearest || frame_length <= rational(0)) {
+    return 0.0;
+  }
+
+  double frames = GetRemappedTime(time).toDouble() / frame_length.toDouble();
+  double factor = frames - std::floor(frames);
+
+  // Don't bother blending frames that are (close to) exactly on a frame
+  const double kEpsilon = 0.001;
+  if (factor < kEpsilon || factor > 1.0 - kEpsilon) {
+    return 0.0;
+  }
+
+  return factor;
+}
+
 }
@@ -43,18 +43,45 @@ public:
   virtual TimeRange InputTimeAdjustment(const QString& input, int element, const TimeRange& input_time) const override;
   virtual TimeRange OutputTimeAdjustment(const QString& input, int element, const TimeRange& input_time) const override;
 
+  virtual QVector<TimeRange> InputTimeSamples(const QString& input, const TimeRange& input_time) const override;
+
   virtual void Retranslate() override;
 
   virtual QVector<QString> inputs_for_output(const QString &output) const override;
 
-  virtual void Hash(const QString &output, QCryptographicHash &hash, const rational &time, const VideoParams& video_params) const override;
+  virtual void Hash(const QString &output, Hasher &hash, const rational &time, const VideoParams& video_params) const override;
+
+  virtual QVector<TimeRange> GetConstantRanges(const QString& output, const TimeRange& range) const override;
+
+  virtual NodeValueTable Value(const QString& output, NodeValueDatabase& value) const override;
+
+  virtual ShaderCode GetShaderCode(const QString& shader_id) const override;
+
+  enum Interpolation {
+    kInterpolationNearest,
+    kInterpolationBlend,
+    kInterpolationOpticalFlow
+  };
 
   static const QString kTimeInput;
   static const QString kInputInput;
+  static const QString kInterpolationInput;
 
 private:
   rational GetRemappedTime(const rational& input) const;
 
+  /**
+   * @brief Returns how far the remapped time is between two frames, or 0 if it needs no blending
+   *
+   * The frames either side are assumed to be `frame_length` apart.
+   */
+  double GetBlendFactor(const rational& time, const rational& frame_length) const;
+
+  /**
+   * @brief Lucas-Kanade passes, from coarsest to finest, that build the flow before blending
+   */
+  static const int kOpticalFlowPasses;
+
 };
 
 }
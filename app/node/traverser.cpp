@@ -20,24 +20,68 @@
 
 #include "traverser.h"
 
+#include <QElapsedTimer>
+
 #include "node.h"
 #include "render/job/footagejob.h"
 #include "render/rendermanager.h"
 
 namespace olive {
 
+NodeTraverser::NodeTraverser() :
+  render_mode_(RenderMode::kOffline),
+  value_cache_(nullptr),
+  value_cache_read_only_(false)
+{
+}
+
 NodeValueDatabase NodeTraverser::GenerateDatabase(const Node* node, const QString& output, const TimeRange &range)
 {
   NodeValueDatabase database;
 
   // We need to insert tables into the database for each input
   auto inputs = node->inputs_for_output(output);
+
+  // Generate inputs that can cover others first, so we can skip anything they cover entirely
+  QVector<QString> occluding = node->GetOccludingInputs(output);
+  if (!occluding.isEmpty()) {
+    QVector<QString> ordered;
+    ordered.reserve(inputs.size());
+
+    foreach (const QString& input, inputs) {
+      if (occluding.contains(input)) {
+        ordered.append(input);
+      }
+    }
+
+    foreach (const QString& input, inputs) {
+      if (!occluding.contains(input)) {
+        ordered.append(input);
+      }
+    }
+
+    inputs = ordered;
+  }
+
   foreach (const QString& input, inputs) {
     if (IsCancelled()) {
       return NodeValueDatabase();
     }
 
-    database.Insert(input, ProcessInput(node, input, range));
+    if (!occluding.isEmpty() && !occluding.contains(input) && node->IsInputOccluded(output, input, database)) {
+      database.Insert(input, NodeValueTable());
+      continue;
+    }
+
+    database.Insert(input, ProcessInput(node, input, range, output));
+
+    if (node->IsInputConnected(input) && !node->InputIsArray(input)) {
+      QVector<TimeRange> samples = node->InputTimeSamples(input, range);
+
+      for (int i=0; i<samples.size(); i++) {
+        database.Insert(Node::GetInputSampleKey(input, i), GenerateTable(node->GetConnectedOutput(input), samples.at(i)));
+      }
+    }
   }
 
   AddGlobalsToDatabase(database, range);
@@ -71,7 +115,7 @@ int NodeTraverser::GetChannelCountFromJob(const GenerateJob &job)
   return VideoParams::kRGBAChannelCount;
 }
 
-NodeValueTable NodeTraverser::ProcessInput(const Node* node, const QString& input, const TimeRange& range)
+NodeValueTable NodeTraverser::ProcessInput(const Node* node, const QString& input, const TimeRange& range, const QString &output)
 {
   // If input is connected, retrieve value directly
   if (node->IsInputConnected(input)) {
@@ -96,6 +140,11 @@ NodeValueTable NodeTraverser::ProcessInput(const Node* node, const QString& inpu
         NodeValueTable& sub_tbl = array_tbl[i];
         TimeRange adjusted_range = node->InputTimeAdjustment(input, i, range);
 
+        if (!output.isEmpty() && !node->IsInputElementUsed(output, input, i, range.in())) {
+          // Leave elements this output won't use empty
+          continue;
+        }
+
         if (node->IsInputConnected(input, i)) {
           sub_tbl = GenerateTable(node->GetConnectedOutput(input, i), adjusted_range);
         } else {
@@ -130,7 +179,53 @@ NodeValueTable NodeTraverser::GenerateTable(const Node *n, const QString& output
     return GenerateBlockTable(track, range);
   }
 
-  // FIXME: Cache certain values here if we've already processed them before
+  NodeValueTable prerendered;
+  if (GetPrerenderedTable(n, output, range, &prerendered)) {
+    return prerendered;
+  }
+
+  QByteArray memo_key;
+
+  if (value_cache_) {
+    // See if we've already generated this node's output, either earlier in this traversal or in
+    // another one
+    memo_key = GetValueCacheKey(n, output, range);
+
+    auto memo = value_memo_.constFind(memo_key);
+    if (memo != value_memo_.constEnd()) {
+      return memo.value();
+    }
+
+    NodeValueTable cached;
+    if (value_cache_->Get(memo_key, &cached)) {
+      value_memo_.insert(memo_key, cached);
+      return cached;
+    }
+  }
+
+  // Nodes set to cache their textures stand in for everything behind them once they're cached
+  QByteArray cached_node_hash;
+
+  if (CanCacheFrames() && n->GetCacheTextures()) {
+    cached_node_hash = RenderManager::Hash(n, output, GetCacheVideoParams(), range.in());
+
+    QVariant cached_frame = GetCachedTexture(cached_node_hash);
+    if (!cached_frame.isNull()) {
+      NodeValueTable table;
+      table.Push(NodeValue::kTexture, cached_frame, n);
+
+      if (value_cache_ && !value_cache_read_only_) {
+        value_memo_.insert(memo_key, table);
+      }
+
+      return table;
+    }
+  }
+
+  // Time everything it takes to produce this table, upstream included, so the value cache knows
+  // what it would cost to produce again
+  QElapsedTimer timer;
+  timer.start();
 
   // Generate database of input values of node
   NodeValueDatabase database = GenerateDatabase(n, output, range);
@@ -138,7 +233,18 @@ NodeValueTable NodeTraverser::GenerateTable(const Node *n, const QString& output
   // By this point, the node should have all the inputs it needs to render correctly
   NodeValueTable table = n->Value(output, database);
 
-  PostProcessTable(n, output, range, table);
+  PostProcessTable(n, range, table, cached_node_hash);
+
+  if (value_cache_ && !value_cache_read_only_ && !IsCancelled()) {
+    qint64 cost = timer.nsecsElapsed();
+
+    value_memo_.insert(memo_key, table);
+    value_costs_.insert(memo_key, cost);
+
+    if (IsTableShareable(memo_key, table)) {
+      value_cache_->Insert(memo_key, table, cost);
+    }
+  }
 
   return table;
 }
@@ -182,7 +288,13 @@ QVariant NodeTraverser::ProcessShader(const Node *node, const TimeRange &range,
   // Create dummy texture with sequence params
   VideoParams tex_params = video_params_;
   tex_params.set_channel_count(GetChannelCountFromJob(job));
-  return QVariant::fromValue(std::make_shared<Texture>(tex_params));
+  TexturePtr texture = std::make_shared<Texture>(tex_params);
+
+  if (job.HasConstantColor()) {
+    texture->SetConstantColor(job.GetConstantColor());
+  }
+
+  return QVariant::fromValue(texture);
 }
 
 QVariant NodeTraverser::ProcessSamples(const Node *node, const TimeRange &range, const SampleJob &job)
@@ -218,6 +330,13 @@ QVariant NodeTraverser::GetCachedTexture(const QByteArray& hash)
   return QVariant();
 }
 
+void NodeTraverser::ShareTable(const QByteArray &key, const NodeValueTable &table)
+{
+  if (value_cache_ && !value_cache_read_only_) {
+    value_cache_->Insert(key, table, value_costs_.value(key));
+  }
+}
+
 void NodeTraverser::AddGlobalsToDatabase(NodeValueDatabase &db, const TimeRange& range) const
 {
   // Insert global variables
@@ -225,6 +344,7 @@ void NodeTraverser::AddGlobalsToDatabase(NodeValueDatabase &db, const TimeRange&
   global.Push(NodeValue::kFloat, range.in().toDouble(), nullptr, false, QStringLiteral("time_in"));
   global.Push(NodeValue::kFloat, range.out().toDouble(), nullptr, false, QStringLiteral("time_out"));
   global.Push(NodeValue::kVec2, GenerateResolution(), nullptr, false, QStringLiteral("resolution"));
+  global.Push(NodeValue::kInt, int(render_mode_), nullptr, false, QStringLiteral("render_mode"));
 
   db.Insert(QStringLiteral("global"), global);
 }
@@ -234,25 +354,28 @@ QVector2D NodeTraverser::GenerateResolution() const
   return QVector2D(video_params_.square_pixel_width(), video_params_.height());
 }
 
-void NodeTraverser::PostProcessTable(const Node *node, const QString& output, const TimeRange &range, NodeValueTable &output_params)
+QByteArray NodeTraverser::GetValueCacheKey(const Node *node, const QString &output, const TimeRange &range) const
 {
-  bool got_cached_frame = false;
-  QByteArray cached_node_hash;
+  // The node's hash covers its inputs and anything upstream, including time for nodes whose
+  // output actually varies with it, so static subgraphs produce the same key at every time. We add
+  // the node itself, since tables reference their source node, and the length of the range, since
+  // the same hash over a different length is a different request.
+  QByteArray key = RenderManager::Hash(node, output, GetCacheVideoParams(), range.in());
 
-  // Convert footage to image/sample buffers
-  if (CanCacheFrames() && node->GetCacheTextures()) {
-    // This node is set to cache the result, see if we can retrieved a previously cached version
-    cached_node_hash = RenderManager::Hash(node, output, GetCacheVideoParams(), range.in());
+  key.append(reinterpret_cast<const char*>(&node), sizeof(node));
 
-    QVariant cached_frame = GetCachedTexture(cached_node_hash);
-    if (!cached_frame.isNull()) {
-      output_params.Push(NodeValue::kTexture, cached_frame, node);
+  rational length = range.length();
+  key.append(reinterpret_cast<const char*>(&length.numerator()), sizeof(length.numerator()));
+  key.append(reinterpret_cast<const char*>(&length.denominator()), sizeof(length.denominator()));
 
-      // No more to do here
-      got_cached_frame = true;
-    }
-  }
+  // Nodes may approximate in offline renders, so those tables are not valid for online ones
+  key.append(static_cast<char>(render_mode_));
 
+  return key;
+}
+
+void NodeTraverser::PostProcessTable(const Node *node, const TimeRange &range, NodeValueTable &output_params, const QByteArray &cached_node_hash)
+{
   // Strip out any jobs or footage
   QList<NodeValue> footage_jobs_to_run;
   QList<NodeValue> shader_jobs_to_run;
@@ -279,41 +402,39 @@ void NodeTraverser::PostProcessTable(const Node *node, const QString& output, co
     }
   }
 
-  if (!got_cached_frame) {
-    // Retrieve video frames
-    foreach (const NodeValue& v, footage_jobs_to_run) {
-      // Assume this is a VideoStream, we did a type check earlier in the function
-      FootageJob job = v.data().value<FootageJob>();
+  // Retrieve video frames
+  foreach (const NodeValue& v, footage_jobs_to_run) {
+    // Assume this is a VideoStream, we did a type check earlier in the function
+    FootageJob job = v.data().value<FootageJob>();
 
-      if (job.type() == Track::kVideo) {
-        rational footage_time = Footage::AdjustTimeByLoopMode(range.in(), job.loop_mode(), job.length(), job.video_params().video_type(), job.video_params().frame_rate_as_time_base());
+    if (job.type() == Track::kVideo) {
+      rational footage_time = Footage::AdjustTimeByLoopMode(range.in(), job.loop_mode(), job.length(), job.video_params().video_type(), job.video_params().frame_rate_as_time_base());
 
-        if (!footage_time.isNaN()) {
-          QVariant value = ProcessVideoFootage(job, footage_time);
+      if (!footage_time.isNaN()) {
+        QVariant value = ProcessVideoFootage(job, footage_time);
 
-          if (!value.isNull()) {
-            output_params.Push(NodeValue::kTexture, value, node);
-          }
+        if (!value.isNull()) {
+          output_params.Push(NodeValue::kTexture, value, node);
         }
       }
     }
+  }
 
-    // Run shaders
-    foreach (const NodeValue& v, shader_jobs_to_run) {
-      QVariant value = ProcessShader(node, range, v.data().value<ShaderJob>());
+  // Run shaders
+  foreach (const NodeValue& v, shader_jobs_to_run) {
+    QVariant value = ProcessShader(node, range, v.data().value<ShaderJob>());
 
-      if (!value.isNull()) {
-        output_params.Push(NodeValue::kTexture, value, node);
-      }
+    if (!value.isNull()) {
+      output_params.Push(NodeValue::kTexture, value, node);
     }
+  }
 
-    // Run generate jobs
-    foreach (const NodeValue& v, generate_jobs_to_run) {
-      QVariant value = ProcessFrameGeneration(node, v.data().value<GenerateJob>());
+  // Run generate jobs
+  foreach (const NodeValue& v, generate_jobs_to_run) {
+    QVariant value = ProcessFrameGeneration(node, v.data().value<GenerateJob>());
 
-      if (!value.isNull()) {
-        output_params.Push(NodeValue::kTexture, value, node);
-      }
+    if (!value.isNull()) {
+      output_params.Push(NodeValue::kTexture, value, node);
     }
   }
 
@@ -340,7 +461,7 @@ void NodeTraverser::PostProcessTable(const Node *node, const QString& output, co
     }
   }
 
-  if (CanCacheFrames() && node->GetCacheTextures() && !got_cached_frame) {
+  if (!cached_node_hash.isEmpty() && !IsCancelled()) {
     // Save cached texture
     SaveCachedTexture(cached_node_hash, output_params.Get(NodeValue::kTexture));
   }
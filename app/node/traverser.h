@@ -27,6 +27,8 @@
 #include "common/cancelableobject.h"
 #include "node/output/track/track.h"
 #include "render/job/footagejob.h"
+#include "render/nodevaluecache.h"
+#include "render/rendermodes.h"
 #include "value.h"
 
 namespace olive {
@@ -34,7 +36,7 @@ namespace olive {
 class NodeTraverser : public CancelableObject
 {
 public:
-  NodeTraverser() = default;
+  NodeTraverser();
 
   NodeValueTable GenerateTable(const Node *n, const QString &output, const TimeRange &range);
   NodeValueTable GenerateTable(const NodeOutput& output, const TimeRange &range)
@@ -54,10 +56,45 @@ public:
     video_params_ = params;
   }
 
+  /**
+   * @brief Set whether this traversal is for preview or for a final render
+   *
+   * Nodes can read this from the "render_mode" global to choose faster approximations when
+   * previewing. Defaults to RenderMode::kOffline.
+   */
+  void SetRenderMode(RenderMode::Mode mode)
+  {
+    render_mode_ = mode;
+  }
+
+  /**
+   * @brief Enable memoizing node outputs
+   *
+   * When set, GenerateTable() skips traversing any node whose output has already been generated
+   * for the same key, both earlier in this traversal and (through `cache`) in other traversals.
+   * Only enable this when the tables produced are real renders rather than dummy values. Set to
+   * nullptr to disable (the default).
+   */
+  void SetValueCache(NodeValueCache* cache)
+  {
+    value_cache_ = cache;
+  }
+
+  /**
+   * @brief Look tables up in the value cache without adding any
+   *
+   * For traversals whose tables aren't real renders but that should still skip whatever a real
+   * traversal would skip.
+   */
+  void SetValueCacheReadOnly(bool e)
+  {
+    value_cache_read_only_ = e;
+  }
+
   static int GetChannelCountFromJob(const GenerateJob& job);
 
 protected:
-  NodeValueTable ProcessInput(const Node *node, const QString &input, const TimeRange &range);
+  NodeValueTable ProcessInput(const Node *node, const QString &input, const TimeRange &range, const QString &output = QString());
 
   virtual NodeValueTable GenerateBlockTable(const Track *track, const TimeRange& range);
 
@@ -71,6 +108,21 @@ protected:
 
   virtual QVariant ProcessFrameGeneration(const Node *node, const GenerateJob& job);
 
+  /**
+   * @brief Get a table for `n` without traversing anything behind it, returning TRUE if there is one
+   *
+   * Lets traversers substitute something already rendered, such as a nested sequence's cached
+   * frame, for a whole subgraph. The default never does.
+   */
+  virtual bool GetPrerenderedTable(const Node* n, const QString& output, const TimeRange& range, NodeValueTable* table)
+  {
+    Q_UNUSED(n)
+    Q_UNUSED(output)
+    Q_UNUSED(range)
+    Q_UNUSED(table)
+    return false;
+  }
+
   virtual QVariant GetCachedTexture(const QByteArray& hash);
 
   virtual void SaveCachedTexture(const QByteArray& hash, const QVariant& texture);
@@ -80,15 +132,46 @@ protected:
     return false;
   }
 
+  /**
+   * @brief Whether a table generated by this traverser is valid outside of this traversal
+   *
+   * Tables are only put in the shared value cache if this returns TRUE. Traversers that can only
+   * tell once the traversal has finished may return FALSE and call ShareTable() themselves later.
+   */
+  virtual bool IsTableShareable(const QByteArray& key, const NodeValueTable& table)
+  {
+    Q_UNUSED(key)
+    Q_UNUSED(table)
+    return true;
+  }
+
+  /**
+   * @brief Put a table in the shared value cache, if there is one and it isn't read-only
+   */
+  void ShareTable(const QByteArray& key, const NodeValueTable& table);
+
   void AddGlobalsToDatabase(NodeValueDatabase& db, const TimeRange &range) const;
 
   QVector2D GenerateResolution() const;
 
 private:
-  void PostProcessTable(const Node *node, const QString &output, const TimeRange &range, NodeValueTable &output_params);
+  void PostProcessTable(const Node *node, const TimeRange &range, NodeValueTable &output_params, const QByteArray &cached_node_hash);
+
+  QByteArray GetValueCacheKey(const Node *node, const QString &output, const TimeRange &range) const;
 
   VideoParams video_params_;
 
+  RenderMode::Mode render_mode_;
+
+  NodeValueCache* value_cache_;
+
+  bool value_cache_read_only_;
+
+  QHash<QByteArray, NodeValueTable> value_memo_;
+
+  // Nanoseconds each memoized table took to generate, for tables shared after the fact
+  QHash<QByteArray, qint64> value_costs_;
+
 };
 
 }
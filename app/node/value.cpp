@@ -20,12 +20,14 @@
 
 #include "value.h"
 
+#include <algorithm>
 #include <QCoreApplication>
 #include <QMatrix4x4>
 #include <QVector2D>
 #include <QVector3D>
 #include <QVector4D>
 
+#include "common/hasher.h"
 #include "common/tohex.h"
 #include "render/audioparams.h"
 #include "render/videoparams.h"
@@ -136,6 +138,43 @@ QByteArray NodeValue::ValueToBytes(NodeValue::Type type, const QVariant &value)
   return QByteArray();
 }
 
+void NodeValue::HashValue(Hasher &hasher, NodeValue::Type type, const QVariant &value)
+{
+  switch (type) {
+  case kInt: hasher.add(value.value<int64_t>()); break;
+  case kFloat: hasher.add(value.toDouble()); break;
+  case kColor: hasher.add(value.value<Color>()); break;
+  case kText:
+  case kFont:
+  case kFile:
+    hasher.add(value.toString());
+    break;
+  case kBoolean: hasher.add(value.toBool()); break;
+  case kMatrix: hasher.add(value.value<QMatrix4x4>()); break;
+  case kRational: hasher.add(value.value<rational>()); break;
+  case kVec2: hasher.add(value.value<QVector2D>()); break;
+  case kVec3: hasher.add(value.value<QVector3D>()); break;
+  case kVec4: hasher.add(value.value<QVector4D>()); break;
+  case kCombo: hasher.add(value.toInt()); break;
+
+  // Rarely hashed, just use their byte representation
+  case kVideoParams:
+  case kAudioParams:
+    hasher.addData(ValueToBytes(type, value));
+    break;
+
+  // These types have no persistent input
+  case kNone:
+  case kFootageJob:
+  case kTexture:
+  case kSamples:
+  case kShaderJob:
+  case kSampleJob:
+  case kGenerateJob:
+    break;
+  }
+}
+
 QVector<QVariant> NodeValue::split_normal_value_into_track_values(Type type, const QVariant &value)
 {
   QVector<QVariant> vals(get_number_of_keyframe_tracks(type));
@@ -324,9 +363,9 @@ QString NodeValue::GetPrettyDataTypeName(Type type)
   return QCoreApplication::translate("NodeValue",  "Unknown");
 }
 
-NodeValue NodeValueTable::GetWithMeta(const QVector<NodeValue::Type> &type, const QString &tag) const
+NodeValue NodeValueTable::GetWithMetaInternal(const NodeValue::Type *types, int type_count, const QString &tag) const
 {
-  int value_index = GetInternal(type, tag);
+  int value_index = GetInternal(types, type_count, tag);
 
   if (value_index >= 0) {
     return values_.at(value_index);
@@ -335,12 +374,12 @@ NodeValue NodeValueTable::GetWithMeta(const QVector<NodeValue::Type> &type, cons
   return NodeValue();
 }
 
-NodeValue NodeValueTable::TakeWithMeta(const QVector<NodeValue::Type> &type, const QString &tag)
+NodeValue NodeValueTable::TakeWithMetaInternal(const NodeValue::Type *types, int type_count, const QString &tag)
 {
-  int value_index = GetInternal(type, tag);
+  int value_index = GetInternal(types, type_count, tag);
 
   if (value_index >= 0) {
-    return values_.takeAt(value_index);
+    return TakeAt(value_index);
   }
 
   return NodeValue();
@@ -348,15 +387,7 @@ NodeValue NodeValueTable::TakeWithMeta(const QVector<NodeValue::Type> &type, con
 
 bool NodeValueTable::Has(NodeValue::Type type) const
 {
-  for (int i=values_.size() - 1;i>=0;i--) {
-    const NodeValue& v = values_.at(i);
-
-    if (v.type() & type) {
-      return true;
-    }
-  }
-
-  return false;
+  return type_count_[type] > 0;
 }
 
 void NodeValueTable::Remove(const NodeValue &v)
@@ -365,6 +396,7 @@ void NodeValueTable::Remove(const NodeValue &v)
     const NodeValue& compare = values_.at(i);
 
     if (compare == v) {
+      type_count_[compare.type()]--;
       values_.removeAt(i);
       return;
     }
@@ -407,15 +439,21 @@ NodeValueTable NodeValueTable::Merge(QList<NodeValueTable> tables)
   return merged_table;
 }
 
-int NodeValueTable::GetInternal(const QVector<NodeValue::Type>& types, const QString &tag) const
+int NodeValueTable::GetInternal(const NodeValue::Type *types, int type_count, const QString &tag) const
 {
+  int candidates = 0;
+  for (int i=0; i<type_count; i++) {
+    candidates += type_count_[types[i]];
+  }
+
   int index = -1;
 
-  for (int i=values_.size() - 1;i>=0;i--) {
+  for (int i=values_.size() - 1; i>=0 && candidates>0; i--) {
     const NodeValue& v = values_.at(i);
 
-    if (types.contains(v.type())) {
+    if (std::find(types, types + type_count, v.type()) != types + type_count) {
       index = i;
+      candidates--;
 
       if (tag.isEmpty() || tag == v.tag()) {
         break;
@@ -21,12 +21,15 @@
 #ifndef NODEVALUE_H
 #define NODEVALUE_H
 
+#include <array>
+#include <utility>
 #include <QString>
 #include <QVariant>
 #include <QVector>
 
 namespace olive {
 
+class Hasher;
 class Node;
 
 class NodeValue
@@ -211,11 +214,13 @@ public:
   {
   }
 
-  NodeValue(Type type, const QVariant& data, const Node* from = nullptr, bool array = false, const QString& tag = QString()) :
+  // Data and tag are taken by value so temporaries (e.g. QVariant::fromValue(job)) are moved in
+  // rather than copied
+  NodeValue(Type type, QVariant data, const Node* from = nullptr, bool array = false, QString tag = QString()) :
     type_(type),
-    data_(data),
+    data_(std::move(data)),
     from_(from),
-    tag_(tag),
+    tag_(std::move(tag)),
     array_(array)
   {
   }
@@ -261,6 +266,13 @@ public:
    */
   static QByteArray ValueToBytes(Type type, const QVariant& value);
 
+  /**
+   * @brief Feed a value to a Hasher
+   *
+   * Equivalent to hashing ValueToBytes() but without serializing to a QByteArray first.
+   */
+  static void HashValue(Hasher& hasher, Type type, const QVariant& value);
+
   static QVector<QVariant> split_normal_value_into_track_values(Type type, const QVariant &value);
 
   static QVariant combine_track_values_into_normal_value(Type type, const QVector<QVariant>& split);
@@ -301,15 +313,25 @@ private:
 
 };
 
+}
+
+// A NodeValue is only a QVariant, a QString and plain data, so QVector can relocate it with memmove
+// instead of copy-constructing every value it shifts on Prepend() and TakeAt()
+Q_DECLARE_TYPEINFO(olive::NodeValue, Q_MOVABLE_TYPE);
+
+namespace olive {
+
 class NodeValueTable
 {
 public:
-  NodeValueTable() = default;
+  NodeValueTable() :
+    type_count_{}
+  {
+  }
 
   QVariant Get(NodeValue::Type type, const QString& tag = QString()) const
   {
-    QVector<NodeValue::Type> types = {type};
-    return Get(types, tag);
+    return GetWithMeta(type, tag).data();
   }
 
   QVariant Get(const QVector<NodeValue::Type>& type, const QString& tag = QString()) const
@@ -319,16 +341,17 @@ public:
 
   NodeValue GetWithMeta(NodeValue::Type type, const QString& tag = QString()) const
   {
-    QVector<NodeValue::Type> types = {type};
-    return GetWithMeta(types, tag);
+    return GetWithMetaInternal(&type, 1, tag);
   }
 
-  NodeValue GetWithMeta(const QVector<NodeValue::Type>& type, const QString& tag = QString()) const;
+  NodeValue GetWithMeta(const QVector<NodeValue::Type>& type, const QString& tag = QString()) const
+  {
+    return GetWithMetaInternal(type.constData(), type.size(), tag);
+  }
 
   QVariant Take(NodeValue::Type type, const QString& tag = QString())
   {
-    QVector<NodeValue::Type> types = {type};
-    return Take(types, tag);
+    return TakeWithMeta(type, tag).data();
   }
 
   QVariant Take(const QVector<NodeValue::Type>& type, const QString& tag = QString())
@@ -338,30 +361,46 @@ public:
 
   NodeValue TakeWithMeta(NodeValue::Type type, const QString& tag = QString())
   {
-    QVector<NodeValue::Type> types = {type};
-    return TakeWithMeta(types, tag);
+    return TakeWithMetaInternal(&type, 1, tag);
   }
 
-  NodeValue TakeWithMeta(const QVector<NodeValue::Type>& type, const QString& tag = QString());
+  NodeValue TakeWithMeta(const QVector<NodeValue::Type>& type, const QString& tag = QString())
+  {
+    return TakeWithMetaInternal(type.constData(), type.size(), tag);
+  }
 
   void Push(const NodeValue& value)
   {
     values_.append(value);
+    type_count_[value.type()]++;
+  }
+
+  void Push(NodeValue&& value)
+  {
+    type_count_[value.type()]++;
+    values_.append(std::move(value));
   }
 
-  void Push(NodeValue::Type type, const QVariant& data, const Node *from, bool array = false, const QString& tag = QString())
+  void Push(NodeValue::Type type, QVariant data, const Node *from, bool array = false, QString tag = QString())
   {
-    Push(NodeValue(type, data, from, array, tag));
+    Push(NodeValue(type, std::move(data), from, array, std::move(tag)));
   }
 
   void Prepend(const NodeValue& value)
   {
     values_.prepend(value);
+    type_count_[value.type()]++;
   }
 
-  void Prepend(NodeValue::Type type, const QVariant& data, const Node *from, bool array = false, const QString& tag = QString())
+  void Prepend(NodeValue&& value)
   {
-    Prepend(NodeValue(type, data, from, array, tag));
+    type_count_[value.type()]++;
+    values_.insert(values_.begin(), std::move(value));
+  }
+
+  void Prepend(NodeValue::Type type, QVariant data, const Node *from, bool array = false, QString tag = QString())
+  {
+    Prepend(NodeValue(type, std::move(data), from, array, std::move(tag)));
   }
 
   const NodeValue& at(int index) const
@@ -370,7 +409,11 @@ public:
   }
   NodeValue TakeAt(int index)
   {
-    return values_.takeAt(index);
+    // Move the value out rather than copying it like QVector::takeAt() does
+    NodeValue v = std::move(values_[index]);
+    values_.remove(index);
+    type_count_[v.type()]--;
+    return v;
   }
 
   int Count() const
@@ -389,10 +432,19 @@ public:
   static NodeValueTable Merge(QList<NodeValueTable> tables);
 
 private:
-  int GetInternal(const QVector<NodeValue::Type> &type, const QString& tag) const;
+  NodeValue GetWithMetaInternal(const NodeValue::Type* types, int type_count, const QString& tag) const;
+
+  NodeValue TakeWithMetaInternal(const NodeValue::Type* types, int type_count, const QString& tag);
+
+  int GetInternal(const NodeValue::Type* types, int type_count, const QString& tag) const;
 
   QVector<NodeValue> values_;
 
+  // How many values of each type are in the table, lets lookups for absent types return without
+  // scanning and lets tagged lookups stop once they've seen every candidate
+  static constexpr int kTypeCount = NodeValue::kGenerateJob + 1;
+  std::array<int, kTypeCount> type_count_;
+
 };
 
 }
@@ -24,12 +24,16 @@ namespace olive {
 
 NodeValueTable NodeValueDatabase::Merge() const
 {
-  QHash<QString, NodeValueTable> copy = tables_;
+  QList<NodeValueTable> tables;
 
-  // Kinda hacky, but we don't need this table to slipstream
-  copy.remove(QStringLiteral("global"));
+  for (int i=0; i<keys_.size(); i++) {
+    // Kinda hacky, but we don't need this table to slipstream
+    if (keys_.at(i) != QStringLiteral("global")) {
+      tables.append(tables_.at(i));
+    }
+  }
 
-  return NodeValueTable::Merge(copy.values());
+  return NodeValueTable::Merge(tables);
 }
 
 }
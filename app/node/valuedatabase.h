@@ -26,6 +26,12 @@
 
 namespace olive {
 
+/**
+ * @brief The value tables for each of a node's inputs while it's being rendered
+ *
+ * Holds only a handful of tables, so they're kept in insertion order and looked up linearly with
+ * IndexOfInputId(), which avoids hashing the input IDs entirely.
+ */
 class NodeValueDatabase
 {
 public:
@@ -33,35 +39,101 @@ public:
 
   NodeValueTable& operator[](const QString& input_id)
   {
-    return tables_[input_id];
+    int i = IndexOfInputId(keys_, input_id);
+
+    if (i == -1) {
+      i = keys_.size();
+      keys_.append(input_id);
+      tables_.append(NodeValueTable());
+    }
+
+    return tables_[i];
   }
 
   void Insert(const QString& key, const NodeValueTable &value)
   {
-    tables_.insert(key, value);
+    (*this)[key] = value;
   }
 
   NodeValueTable Merge() const;
 
-  using const_iterator = QHash<QString, NodeValueTable>::const_iterator;
-
-  inline QHash<QString, NodeValueTable>::const_iterator begin() const
+  class const_iterator
+  {
+  public:
+    const_iterator() :
+      db_(nullptr),
+      index_(0)
+    {
+    }
+
+    const_iterator(const NodeValueDatabase* db, int index) :
+      db_(db),
+      index_(index)
+    {
+    }
+
+    const QString& key() const
+    {
+      return db_->keys_.at(index_);
+    }
+
+    const NodeValueTable& value() const
+    {
+      return db_->tables_.at(index_);
+    }
+
+    const NodeValueTable& operator*() const
+    {
+      return value();
+    }
+
+    const_iterator& operator++()
+    {
+      index_++;
+      return *this;
+    }
+
+    const_iterator operator++(int)
+    {
+      const_iterator old = *this;
+      index_++;
+      return old;
+    }
+
+    bool operator==(const const_iterator& rhs) const
+    {
+      return db_ == rhs.db_ && index_ == rhs.index_;
+    }
+
+    bool operator!=(const const_iterator& rhs) const
+    {
+      return !(*this == rhs);
+    }
+
+  private:
+    const NodeValueDatabase* db_;
+    int index_;
+
+  };
+
+  inline const_iterator begin() const
   {
-    return tables_.cbegin();
+    return const_iterator(this, 0);
   }
 
-  inline QHash<QString, NodeValueTable>::const_iterator end() const
+  inline const_iterator end() const
   {
-    return tables_.cend();
+    return const_iterator(this, keys_.size());
   }
 
   inline bool contains(const QString& s) const
   {
-    return tables_.contains(s);
+    return IndexOfInputId(keys_, s) != -1;
   }
 
 private:
-  QHash<QString, NodeValueTable> tables_;
+  QVector<QString> keys_;
+  QVector<NodeValueTable> tables_;
 
 };
 
@@ -0,0 +1,46 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "metrics.h"
+
+#include <QScrollArea>
+
+namespace olive {
+
+MetricsPanel::MetricsPanel(QWidget *parent) :
+  PanelWidget(QStringLiteral("MetricsPanel"), parent)
+{
+  QScrollArea* scroll_area = new QScrollArea(this);
+  scroll_area->setWidgetResizable(true);
+
+  view_ = new MetricsView();
+  scroll_area->setWidget(view_);
+
+  setWidget(scroll_area);
+
+  Retranslate();
+}
+
+void MetricsPanel::Retranslate()
+{
+  SetTitle(tr("Render Statistics"));
+}
+
+}
@@ -0,0 +1,47 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef METRICSPANEL_H
+#define METRICSPANEL_H
+
+#include "widget/metricsview/metricsview.h"
+#include "widget/panel/panel.h"
+
+namespace olive {
+
+/**
+ * @brief A PanelWidget wrapper around a MetricsView widget
+ */
+class MetricsPanel : public PanelWidget
+{
+  Q_OBJECT
+public:
+  MetricsPanel(QWidget* parent);
+
+private:
+  virtual void Retranslate() override;
+
+  MetricsView* view_;
+
+};
+
+}
+
+#endif // METRICSPANEL_H
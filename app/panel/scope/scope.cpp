@@ -60,6 +60,18 @@ ScopePanel::ScopePanel(QWidget* parent) :
   histogram_ = new HistogramScope();
   stack_->addWidget(histogram_);
 
+  // Create RGB parade
+  parade_ = new ParadeScope();
+  stack_->addWidget(parade_);
+
+  // Create vectorscope
+  vectorscope_ = new VectorscopeScope();
+  stack_->addWidget(vectorscope_);
+
+  // Create false color
+  false_color_ = new FalseColorScope();
+  stack_->addWidget(false_color_);
+
   connect(scope_type_combobox_, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged), stack_, &QStackedWidget::setCurrentIndex);
 
   Retranslate();
@@ -77,6 +89,12 @@ QString ScopePanel::TypeToName(ScopePanel::Type t)
     return tr("Waveform");
   case kTypeHistogram:
     return tr("Histogram");
+  case kTypeParade:
+    return tr("RGB Parade");
+  case kTypeVectorscope:
+    return tr("Vectorscope");
+  case kTypeFalseColor:
+    return tr("False Color");
   case kTypeCount:
     break;
   }
@@ -88,12 +106,18 @@ void ScopePanel::SetReferenceBuffer(TexturePtr frame)
 {
   histogram_->SetBuffer(frame);
   waveform_view_->SetBuffer(frame);
+  parade_->SetBuffer(frame);
+  vectorscope_->SetBuffer(frame);
+  false_color_->SetBuffer(frame);
 }
 
 void ScopePanel::SetColorManager(ColorManager *manager)
 {
   histogram_->ConnectColorManager(manager);
   waveform_view_->ConnectColorManager(manager);
+  parade_->ConnectColorManager(manager);
+  vectorscope_->ConnectColorManager(manager);
+  false_color_->ConnectColorManager(manager);
 }
 
 void ScopePanel::Retranslate()
@@ -25,7 +25,10 @@
 #include <QStackedWidget>
 
 #include "widget/panel/panel.h"
+#include "widget/scope/falsecolor/falsecolor.h"
 #include "widget/scope/histogram/histogram.h"
+#include "widget/scope/parade/parade.h"
+#include "widget/scope/vectorscope/vectorscope.h"
 #include "widget/scope/waveform/waveform.h"
 
 namespace olive {
@@ -39,6 +42,9 @@ public:
   enum Type {
     kTypeWaveform,
     kTypeHistogram,
+    kTypeParade,
+    kTypeVectorscope,
+    kTypeFalseColor,
 
     kTypeCount
   };
@@ -68,6 +74,12 @@ private:
 
   HistogramScope* histogram_;
 
+  ParadeScope* parade_;
+
+  VectorscopeScope* vectorscope_;
+
+  FalseColorScope* false_color_;
+
 };
 
 }
@@ -85,6 +85,15 @@ void ViewerPanelBase::SetFullScreen(QScreen *screen)
   static_cast<ViewerWidget*>(GetTimeBasedWidget())->SetFullScreen(screen);
 }
 
+bool ViewerPanelBase::StartPlaybackBenchmark(const TimeRange &range)
+{
+  ViewerWidget* vw = static_cast<ViewerWidget*>(GetTimeBasedWidget());
+
+  connect(vw, &ViewerWidget::PlaybackBenchmarkFinished, this, &ViewerPanelBase::PlaybackBenchmarkFinished, Qt::UniqueConnection);
+
+  return vw->StartPlaybackBenchmark(range);
+}
+
 void ViewerPanelBase::SetGizmos(Node *node)
 {
   static_cast<ViewerWidget*>(GetTimeBasedWidget())->SetGizmos(node);
@@ -54,6 +54,11 @@ public:
    */
   void SetFullScreen(QScreen* screen = nullptr);
 
+  /**
+   * @brief Wrapper for ViewerWidget::StartPlaybackBenchmark()
+   */
+  bool StartPlaybackBenchmark(const TimeRange& range);
+
 public slots:
   void SetGizmos(Node* node);
 
@@ -61,6 +66,9 @@ public slots:
 
   void CacheSequenceInOut();
 
+signals:
+  void PlaybackBenchmarkFinished(const QJsonObject& results);
+
 protected:
   void CreateScopePanel(ScopePanel::Type type);
 
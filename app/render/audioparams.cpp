@@ -94,6 +94,39 @@ QAudioFormat::SampleType AudioParams::GetQtSampleType(AudioParams::Format format
   return QAudioFormat::Unknown;
 }
 
+AudioParams::Format AudioParams::GetFormatFromQt(QAudioFormat::SampleType type, int sample_size)
+{
+  switch (type) {
+  case QAudioFormat::UnSignedInt:
+    if (sample_size == 8) {
+      return kFormatUnsigned8;
+    }
+    break;
+  case QAudioFormat::SignedInt:
+    switch (sample_size) {
+    case 16:
+      return kFormatSigned16;
+    case 32:
+      return kFormatSigned32;
+    case 64:
+      return kFormatSigned64;
+    }
+    break;
+  case QAudioFormat::Float:
+    switch (sample_size) {
+    case 32:
+      return kFormatFloat32;
+    case 64:
+      return kFormatFloat64;
+    }
+    break;
+  case QAudioFormat::Unknown:
+    break;
+  }
+
+  return kFormatInvalid;
+}
+
 qint64 AudioParams::time_to_bytes(const rational &time) const
 {
   return time_to_bytes(time.toDouble());
@@ -190,7 +223,7 @@ QByteArray AudioParams::toBytes() const
   return hasher.result();
 }
 
-void AudioParams::Load(QXmlStreamReader *reader)
+void AudioParams::Load(XMLReader *reader)
 {
   while (XMLReadNextStartElement(reader)) {
     if (reader->name() == QStringLiteral("samplerate")) {
@@ -213,7 +246,7 @@ void AudioParams::Load(QXmlStreamReader *reader)
   }
 }
 
-void AudioParams::Save(QXmlStreamWriter *writer) const
+void AudioParams::Save(XMLWriter *writer) const
 {
   writer->writeTextElement(QStringLiteral("samplerate"), QString::number(sample_rate_));
   writer->writeTextElement(QStringLiteral("channellayout"), QString::number(channel_layout_));
@@ -23,10 +23,9 @@
 
 #include <QAudioFormat>
 #include <QtMath>
-#include <QXmlStreamReader>
-#include <QXmlStreamWriter>
 
 #include "common/rational.h"
+#include "common/xmlstream.h"
 
 namespace olive {
 
@@ -174,15 +173,20 @@ public:
 
   QByteArray toBytes() const;
 
-  void Load(QXmlStreamReader* reader);
+  void Load(XMLReader* reader);
 
-  void Save(QXmlStreamWriter* writer) const;
+  void Save(XMLWriter* writer) const;
 
   bool operator==(const AudioParams& other) const;
   bool operator!=(const AudioParams& other) const;
 
   static QAudioFormat::SampleType GetQtSampleType(Format format);
 
+  /**
+   * @brief Get the format matching a Qt sample type and size, or kFormatInvalid if there isn't one
+   */
+  static Format GetFormatFromQt(QAudioFormat::SampleType type, int sample_size);
+
   static const QVector<uint64_t> kSupportedChannelLayouts;
   static const QVector<int> kSupportedSampleRates;
 
@@ -22,21 +22,36 @@
 
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QUuid>
+#include <QtConcurrent/QtConcurrent>
 
 #include "common/filefunctions.h"
 
 namespace olive {
 
 const qint64 AudioPlaybackCache::kDefaultSegmentSize = 5242880;
+const int AudioPlaybackCache::kCompactionDelay = 2000;
 
 AudioPlaybackCache::AudioPlaybackCache(QObject* parent) :
-  PlaybackCache(parent)
+  PlaybackCache(parent),
+  playlist_generation_(0),
+  compaction_generation_(0)
 {
+  compaction_timer_.setSingleShot(true);
+  compaction_timer_.setInterval(kCompactionDelay);
+  connect(&compaction_timer_, &QTimer::timeout, this, &AudioPlaybackCache::StartCompaction);
+  connect(&compaction_watcher_, &QFutureWatcher<bool>::finished, this, &AudioPlaybackCache::CompactionFinished);
 }
 
 AudioPlaybackCache::~AudioPlaybackCache()
 {
+  // Don't leave a compaction pass writing into the cache directory after we're gone
+  compaction_watcher_.waitForFinished();
+  foreach (const CompactionGroup& g, compaction_groups_) {
+    QFile::remove(g.destination);
+  }
+
   // Segments are volatile, so delete them here
   ClearPlaylist();
 }
@@ -49,6 +64,7 @@ void AudioPlaybackCache::SetParameters(const AudioParams &params)
 
   params_ = params;
   visual_.set_channel_count(params_.channel_count());
+  levels_.set_channel_count(params_.channel_count());
 
   // Restart empty file so there's always "something" to play
   ClearPlaylist();
@@ -56,13 +72,126 @@ void AudioPlaybackCache::SetParameters(const AudioParams &params)
   emit ParametersChanged();
 }
 
-void AudioPlaybackCache::WritePCM(const TimeRange &range, SampleBufferPtr samples, const AudioVisualWaveform *waveform, const qint64 &job_time)
+void AudioPlaybackCache::SaveState(QDataStream &s, const QDir &file_dir)
+{
+  PlaybackCache::SaveState(s, file_dir);
+
+  // A compaction pass would be reading the segments we're about to move
+  compaction_timer_.stop();
+  compaction_watcher_.waitForFinished();
+
+  QString waveform_name = QStringLiteral("%1.waveform").arg(QUuid::createUuid().toString());
+  if (!visual_.SaveToFile(file_dir.filePath(waveform_name))) {
+    waveform_name.clear();
+  }
+
+  s << qint32(params_.sample_rate()) << quint64(params_.channel_layout()) << qint32(params_.format())
+    << waveform_name;
+
+  levels_.Save(s);
+
+  s << qint32(playlist_.size());
+
+  foreach (const Segment& seg, playlist_) {
+    QString name = QFileInfo(seg.filename()).fileName();
+
+    if (!QFile::rename(seg.filename(), file_dir.filePath(name))) {
+      // RestoreState() will find this missing and discard the whole cache
+      QFile::remove(seg.filename());
+    }
+
+    s << name << seg.size();
+  }
+
+  // The segments belong to the saved state now
+  playlist_.clear();
+  PlaylistModified();
+}
+
+bool AudioPlaybackCache::RestoreState(QDataStream &s, const QDir &file_dir)
+{
+  TimeRangeList invalidated;
+
+  if (!ReadState(s, &invalidated)) {
+    return false;
+  }
+
+  qint32 sample_rate, format, count;
+  quint64 channel_layout;
+  QString waveform_name;
+  AudioLevels levels;
+
+  s >> sample_rate >> channel_layout >> format >> waveform_name;
+
+  if (s.status() != QDataStream::Ok
+      || params_ != AudioParams(sample_rate, channel_layout, static_cast<AudioParams::Format>(format))
+      || !levels.Load(s)) {
+    return false;
+  }
+
+  s >> count;
+
+  QVector< QPair<QString, qint64> > segments;
+
+  for (qint32 i=0; i<count && s.status() == QDataStream::Ok; i++) {
+    QString name;
+    qint64 size;
+    s >> name >> size;
+
+    if (QFileInfo(file_dir.filePath(name)).size() < size) {
+      // Segment is missing or incomplete
+      return false;
+    }
+
+    segments.append({name, size});
+  }
+
+  AudioVisualWaveform visual;
+  visual.set_channel_count(params_.channel_count());
+
+  if (s.status() != QDataStream::Ok
+      || (!waveform_name.isEmpty() && !visual.LoadFromFile(file_dir.filePath(waveform_name)))) {
+    return false;
+  }
+
+  // Take the segments back into the cache directory
+  Playlist playlist;
+
+  for (int i=0; i<segments.size(); i++) {
+    Segment seg(segments.at(i).second, GenerateSegmentFilename());
+
+    if (!QFile::rename(file_dir.filePath(segments.at(i).first), seg.filename())) {
+      foreach (const Segment& taken, playlist) {
+        QFile::remove(taken.filename());
+      }
+      return false;
+    }
+
+    playlist.append(seg);
+  }
+
+  ClearPlaylist();
+  playlist_ = playlist;
+  UpdateOffsetsFrom(0);
+
+  visual_ = visual;
+  levels_ = levels;
+
+  ApplyRestoredState(invalidated);
+
+  return true;
+}
+
+void AudioPlaybackCache::WritePCM(const TimeRange &range, SampleBufferPtr samples, const AudioVisualWaveform *waveform, const AudioLevels *levels, const qint64 &job_time)
 {
   QList<TimeRange> valid_ranges = GetValidRanges(range, job_time);
   if (valid_ranges.isEmpty()) {
     return;
   }
 
+  // Any compaction currently running may have already read the data we're about to overwrite
+  PlaylistModified();
+
   // Ensure if we have enough segments to write this data, creating more if not
   qint64 length_diff = params_.time_to_bytes(range.out()) - playlist_.GetLength();
   while (length_diff > 0) {
@@ -147,6 +276,13 @@ void AudioPlaybackCache::WritePCM(const TimeRange &range, SampleBufferPtr sample
     } else {
       visual_.OverwriteSilence(r.in(), r.length());
     }
+
+    // Write meter levels
+    if (levels) {
+      levels_.OverwriteLevels(*levels, r.in(), r.in() - range.in(), r.length());
+    } else {
+      levels_.OverwriteSilence(r.in(), r.length());
+    }
   }
 
   foreach (const TimeRange& v, ranges_we_validated) {
@@ -158,7 +294,7 @@ void AudioPlaybackCache::WriteSilence(const TimeRange &range, qint64 job_time)
 {
   // WritePCM will automatically fill non-existent bytes with silence, so we just have to send
   // it an empty sample buffer
-  WritePCM(range, nullptr, nullptr, job_time);
+  WritePCM(range, nullptr, nullptr, nullptr, job_time);
 }
 
 void AudioPlaybackCache::ShiftEvent(const rational &from_in_time, const rational &to_in_time)
@@ -260,6 +396,11 @@ void AudioPlaybackCache::ShiftEvent(const rational &from_in_time, const rational
 
     UpdateOffsetsFrom(to_seg_index);
   }
+
+  PlaylistModified();
+
+  // Shifting splits and trims segments, merge them back together once editing settles down
+  QueueCompaction();
 }
 
 void AudioPlaybackCache::LengthChangedEvent(const rational& old, const rational& newlen)
@@ -285,6 +426,159 @@ void AudioPlaybackCache::LengthChangedEvent(const rational& old, const rational&
       RemoveSegmentFromArray(playlist_.size() - 1);
     }
   }
+
+  PlaylistModified();
+  QueueCompaction();
+}
+
+void AudioPlaybackCache::QueueCompaction()
+{
+  compaction_timer_.start();
+}
+
+void AudioPlaybackCache::StartCompaction()
+{
+  if (compaction_watcher_.isRunning()) {
+    // CompactionFinished() will queue another pass if the playlist changed in the meantime
+    return;
+  }
+
+  // Find runs of adjacent segments that can be joined without exceeding the default segment size
+  QVector<CompactionGroup> groups;
+  CompactionGroup current;
+  qint64 current_size = 0;
+
+  for (int i=0; i<=playlist_.size(); i++) {
+    bool can_join = (i < playlist_.size()
+                     && playlist_.at(i).size() < kDefaultSegmentSize
+                     && current_size + playlist_.at(i).size() <= kDefaultSegmentSize);
+
+    if (!can_join) {
+      if (current.sources.size() > 1) {
+        groups.append(current);
+      }
+
+      current.sources.clear();
+      current_size = 0;
+
+      if (i == playlist_.size() || playlist_.at(i).size() >= kDefaultSegmentSize) {
+        continue;
+      }
+    }
+
+    if (current.sources.isEmpty()) {
+      current.index = i;
+    }
+
+    current.sources.append(playlist_.at(i));
+    current_size += playlist_.at(i).size();
+  }
+
+  if (groups.isEmpty()) {
+    return;
+  }
+
+  // Reserve destination files here so GenerateSegmentFilename() can't hand them out twice
+  for (int i=0; i<groups.size(); i++) {
+    groups[i].destination = GenerateSegmentFilename();
+
+    QFile f(groups.at(i).destination);
+    if (f.open(QFile::WriteOnly)) {
+      f.close();
+    }
+  }
+
+  compaction_groups_ = groups;
+  compaction_generation_ = playlist_generation_;
+  compaction_watcher_.setFuture(QtConcurrent::run(&AudioPlaybackCache::MergeSegmentFiles, groups));
+}
+
+bool AudioPlaybackCache::MergeSegmentFiles(const QVector<CompactionGroup> &groups)
+{
+  foreach (const CompactionGroup& g, groups) {
+    QFile dst(g.destination);
+
+    if (!dst.open(QFile::WriteOnly)) {
+      return false;
+    }
+
+    foreach (const Segment& s, g.sources) {
+      qint64 written = 0;
+
+      QFile src(s.filename());
+      if (src.open(QFile::ReadOnly)) {
+        // Segment files may be longer than the segment (trimmed out) or shorter (never written)
+        qint64 available = qMin(src.size(), s.size());
+
+        if (available > 0) {
+          uchar* mapped = src.map(0, available);
+
+          if (mapped) {
+            written = dst.write(reinterpret_cast<const char*>(mapped), available);
+            src.unmap(mapped);
+          } else {
+            written = dst.write(src.read(available));
+          }
+        }
+
+        src.close();
+      }
+
+      if (written < 0) {
+        return false;
+      }
+
+      if (written < s.size()) {
+        // Pad with silence so the following segments keep their offsets
+        QByteArray silence(s.size() - written, 0x00);
+        if (dst.write(silence) != silence.size()) {
+          return false;
+        }
+      }
+    }
+
+    dst.close();
+  }
+
+  return true;
+}
+
+void AudioPlaybackCache::CompactionFinished()
+{
+  QVector<CompactionGroup> groups = compaction_groups_;
+  compaction_groups_.clear();
+
+  if (!compaction_watcher_.result() || compaction_generation_ != playlist_generation_) {
+    // The merged files are either incomplete or stale, discard them
+    foreach (const CompactionGroup& g, groups) {
+      QFile::remove(g.destination);
+    }
+
+    if (compaction_generation_ != playlist_generation_) {
+      QueueCompaction();
+    }
+
+    return;
+  }
+
+  // Work backwards so earlier group indices remain valid
+  for (int i=groups.size()-1; i>=0; i--) {
+    const CompactionGroup& g = groups.at(i);
+
+    qint64 merged_size = 0;
+    foreach (const Segment& s, g.sources) {
+      QFile::remove(s.filename());
+      merged_size += s.size();
+    }
+
+    Segment merged(merged_size, g.destination);
+    merged.set_offset(g.sources.first().offset());
+
+    playlist_.remove(g.index, g.sources.size());
+    playlist_.insert(g.index, merged);
+  }
+
+  PlaylistModified();
 }
 
 AudioPlaybackCache::Segment AudioPlaybackCache::CloneSegment(const AudioPlaybackCache::Segment &s) const
@@ -368,6 +662,8 @@ void AudioPlaybackCache::ClearPlaylist()
     QFile::remove(s.filename());
   }
   playlist_.clear();
+
+  PlaylistModified();
 }
 
 void AudioPlaybackCache::UpdateOffsetsFrom(int index)
@@ -421,7 +717,10 @@ AudioPlaybackCache::PlaybackDevice::PlaybackDevice(const AudioPlaybackCache::Pla
   QIODevice(parent),
   playlist_(playlist),
   current_segment_(0),
-  segment_read_index_(0)
+  segment_read_index_(0),
+  mapped_data_(nullptr),
+  mapped_size_(0),
+  mapped_segment_(-1)
 {
 }
 
@@ -430,6 +729,60 @@ AudioPlaybackCache::PlaybackDevice::~PlaybackDevice()
   close();
 }
 
+void AudioPlaybackCache::PlaybackDevice::close()
+{
+  UnmapSegment();
+
+  QIODevice::close();
+}
+
+const uchar *AudioPlaybackCache::PlaybackDevice::MapSegment(int index)
+{
+  if (index == mapped_segment_) {
+    return mapped_data_;
+  }
+
+  UnmapSegment();
+
+  const Segment& s = playlist_.at(index);
+
+  mapped_file_.setFileName(s.filename());
+  mapped_segment_ = index;
+
+  if (mapped_file_.open(QFile::ReadOnly)) {
+    // A segment that was never fully written will be shorter than its acknowledged size, the
+    // remainder is treated as silence
+    mapped_size_ = qMin(mapped_file_.size(), s.size());
+
+    if (mapped_size_ > 0) {
+      mapped_data_ = mapped_file_.map(0, mapped_size_);
+    }
+  } else {
+    qWarning() << "Failed to read data from segment" << s.filename();
+  }
+
+  if (!mapped_data_) {
+    mapped_size_ = 0;
+  }
+
+  return mapped_data_;
+}
+
+void AudioPlaybackCache::PlaybackDevice::UnmapSegment()
+{
+  if (mapped_data_) {
+    mapped_file_.unmap(const_cast<uchar*>(mapped_data_));
+    mapped_data_ = nullptr;
+  }
+
+  if (mapped_file_.isOpen()) {
+    mapped_file_.close();
+  }
+
+  mapped_size_ = 0;
+  mapped_segment_ = -1;
+}
+
 bool AudioPlaybackCache::PlaybackDevice::seek(qint64 pos)
 {
   // Default behavior
@@ -458,37 +811,36 @@ qint64 AudioPlaybackCache::PlaybackDevice::readData(char *data, qint64 maxSize)
          && current_segment_ < playlist_.size()) {
     const Segment& cs = playlist_.at(current_segment_);
     qint64 current_segment_sz = cs.size();
-    QFile segment_file(cs.filename());
 
-    if (segment_file.open(QFile::ReadOnly)) {
-      // Seek to our stored index of this segment
-      segment_file.seek(segment_read_index_);
+    // Segments stay mapped between reads so seeking and reading don't reopen files
+    const uchar* mapped = MapSegment(current_segment_);
 
-      // Determine how many bytes to read
-      qint64 this_read_length = qMin(current_segment_sz - segment_read_index_,
-                                     maxSize - read_size);
+    // Determine how many bytes to read
+    qint64 this_read_length = qMin(current_segment_sz - segment_read_index_,
+                                   maxSize - read_size);
 
-      // Read those bytes
-      segment_file.read(data + read_size, this_read_length);
+    // Copy whatever is backed by the file and fill the rest with silence
+    qint64 available = qBound(qint64(0), mapped_size_ - segment_read_index_, this_read_length);
 
-      // Close the file
-      segment_file.close();
+    if (available > 0) {
+      memcpy(data + read_size, mapped + segment_read_index_, available);
+    }
 
-      // Add to the read index
-      segment_read_index_ += this_read_length;
+    if (available < this_read_length) {
+      memset(data + read_size + available, 0, this_read_length - available);
+    }
 
-      // Add to the read size
-      read_size += this_read_length;
+    // Add to the read index
+    segment_read_index_ += this_read_length;
 
-      // If we've reached the end of this segment, tick the counter over to the next segment
-      if (segment_read_index_ == current_segment_sz) {
-        // Jump to the next file
-        segment_read_index_ = 0;
-        current_segment_++;
-      }
-    } else {
-      qWarning() << "Failed to read data from segment";
-      break;
+    // Add to the read size
+    read_size += this_read_length;
+
+    // If we've reached the end of this segment, tick the counter over to the next segment
+    if (segment_read_index_ == current_segment_sz) {
+      // Jump to the next file
+      segment_read_index_ = 0;
+      current_segment_++;
     }
   }
 
@@ -21,6 +21,11 @@
 #ifndef AUDIOPLAYBACKCACHE_H
 #define AUDIOPLAYBACKCACHE_H
 
+#include <QFile>
+#include <QFutureWatcher>
+#include <QTimer>
+
+#include "audio/audiolevels.h"
 #include "audio/audiovisualwaveform.h"
 #include "common/timerange.h"
 #include "codec/samplebuffer.h"
@@ -66,7 +71,7 @@ public:
 
   void SetParameters(const AudioParams& params);
 
-  void WritePCM(const TimeRange &range, SampleBufferPtr samples, const AudioVisualWaveform *waveform, const qint64& job_time);
+  void WritePCM(const TimeRange &range, SampleBufferPtr samples, const AudioVisualWaveform *waveform, const AudioLevels* levels, const qint64& job_time);
 
   void WriteSilence(const TimeRange &range, qint64 job_time);
 
@@ -152,6 +157,8 @@ public:
       return playlist_.GetLength();
     }
 
+    virtual void close() override;
+
     virtual qint64 readData(char *data, qint64 maxSize) override;
 
     virtual qint64 writeData(const char *data, qint64 maxSize) override
@@ -163,12 +170,29 @@ public:
     }
 
   private:
+    /**
+     * @brief Memory-map the segment at `index`, unmapping whatever was mapped before
+     *
+     * Returns the mapped data or nullptr if the segment couldn't be mapped.
+     */
+    const uchar* MapSegment(int index);
+
+    void UnmapSegment();
+
     Playlist playlist_;
 
     int current_segment_;
 
     qint64 segment_read_index_;
 
+    QFile mapped_file_;
+
+    const uchar* mapped_data_;
+
+    qint64 mapped_size_;
+
+    int mapped_segment_;
+
   };
 
   /**
@@ -187,6 +211,20 @@ public:
     return visual_;
   }
 
+  const AudioLevels &levels() const
+  {
+    return levels_;
+  }
+
+  /**
+   * @brief Also saves the PCM, waveform and levels
+   *
+   * Segment files are moved into `file_dir` rather than copied, which leaves this cache empty.
+   */
+  virtual void SaveState(QDataStream& s, const QDir& file_dir) override;
+
+  virtual bool RestoreState(QDataStream& s, const QDir& file_dir) override;
+
 signals:
   void ParametersChanged();
 
@@ -195,9 +233,41 @@ protected:
 
   virtual void LengthChangedEvent(const rational& old, const rational& newlen) override;
 
+private slots:
+  void CompactionFinished();
+
 private:
   static const qint64 kDefaultSegmentSize;
 
+  static const int kCompactionDelay;
+
+  /**
+   * @brief A run of adjacent segments that will be concatenated into one new segment file
+   */
+  struct CompactionGroup
+  {
+    int index;
+    QVector<Segment> sources;
+    QString destination;
+  };
+
+  /**
+   * @brief Request a compaction pass once the playlist has been left alone for a while
+   */
+  void QueueCompaction();
+
+  /**
+   * @brief Start a background pass merging runs of adjacent segments smaller than kDefaultSegmentSize
+   */
+  void StartCompaction();
+
+  static bool MergeSegmentFiles(const QVector<CompactionGroup>& groups);
+
+  void PlaylistModified()
+  {
+    playlist_generation_++;
+  }
+
   Segment CloneSegment(const Segment& s) const;
 
   Segment CreateSegment(const qint64 &size, const qint64 &offset) const;
@@ -216,10 +286,24 @@ private:
 
   Playlist playlist_;
 
+  // Incremented whenever the playlist's layout or contents change so that a compaction pass
+  // running against an older playlist can be discarded
+  quint64 playlist_generation_;
+
+  QTimer compaction_timer_;
+
+  QFutureWatcher<bool> compaction_watcher_;
+
+  QVector<CompactionGroup> compaction_groups_;
+
+  quint64 compaction_generation_;
+
   AudioParams params_;
 
   AudioVisualWaveform visual_;
 
+  AudioLevels levels_;
+
 };
 
 }
@@ -0,0 +1,249 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "colorbakecache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+
+#include "common/filefunctions.h"
+#include "common/ocioutils.h"
+
+namespace olive {
+
+const quint32 ColorBakeCache::kFileVersion = 1;
+QMutex ColorBakeCache::mutex_;
+QHash<QString, BakedColorTransform> ColorBakeCache::memory_cache_;
+
+BakedColorTransform ColorBakeCache::Get(ColorProcessorPtr processor, const char *function_name)
+{
+  QString key = QStringLiteral("%1:%2").arg(QString::fromUtf8(processor->GetProcessor()->getCacheID()),
+                                            QString::fromUtf8(function_name));
+
+  {
+    QMutexLocker locker(&mutex_);
+
+    auto it = memory_cache_.constFind(key);
+    if (it != memory_cache_.cend()) {
+      return it.value();
+    }
+  }
+
+  QDir cache_dir(QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).filePath(QStringLiteral("ocio")));
+  QString cache_file = cache_dir.filePath(QString(QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Sha1).toHex()));
+
+  BakedColorTransform bake;
+
+  if (!QFileInfo::exists(cache_file) || !Load(cache_file, &bake)) {
+    bake = Bake(processor, function_name);
+
+    if (!bake.IsValid()) {
+      return bake;
+    }
+
+    // Write to a temporary file first so concurrent bakes never see a partial file
+    QString temp_file = FileFunctions::GetSafeTemporaryFilename(cache_file);
+    if (!cache_dir.mkpath(QStringLiteral("."))
+        || !Save(temp_file, bake)
+        || !FileFunctions::RenameFileAllowOverwrite(temp_file, cache_file)) {
+      QFile::remove(temp_file);
+      qWarning() << "Failed to save baked color transform, it will have to be baked again";
+    }
+  }
+
+  QMutexLocker locker(&mutex_);
+  memory_cache_.insert(key, bake);
+
+  return bake;
+}
+
+BakedColorTransform ColorBakeCache::Bake(ColorProcessorPtr processor, const char *function_name)
+{
+  BakedColorTransform bake;
+
+  // Create shader description
+  auto shader_desc = OCIO::GpuShaderDesc::CreateShaderDesc();
+  shader_desc->setLanguage(OCIO::GPU_LANGUAGE_GLSL_1_3);
+  shader_desc->setFunctionName(function_name);
+  shader_desc->setResourcePrefix("ocio_");
+
+  // Generate shader
+  processor->GetProcessor()->getDefaultGPUProcessor()->extractGpuShaderInfo(shader_desc);
+
+  QString shader_text = QString::fromUtf8(shader_desc->getShaderText());
+
+  bake.lut3d.resize(shader_desc->getNum3DTextures());
+  for (unsigned int i=0; i<shader_desc->getNum3DTextures(); i++) {
+    const char* tex_name = nullptr;
+    const char* sampler_name = nullptr;
+    unsigned int edge_len = 0;
+    OCIO::Interpolation interpolation = OCIO::INTERP_LINEAR;
+
+    shader_desc->get3DTexture(i, tex_name, sampler_name, edge_len, interpolation);
+
+    if (!tex_name || !*tex_name
+        || !sampler_name || !*sampler_name
+        || !edge_len) {
+      qCritical() << "3D LUT texture data is corrupted";
+      return BakedColorTransform();
+    }
+
+    const float* values = nullptr;
+    shader_desc->get3DTextureValues(i, values);
+    if (!values) {
+      qCritical() << "3D LUT texture values are missing";
+      return BakedColorTransform();
+    }
+
+    BakedColorTransform::LUT& lut = bake.lut3d[i];
+    lut.sampler_name = QString::fromUtf8(sampler_name);
+    lut.width = edge_len;
+    lut.height = edge_len;
+    lut.depth = edge_len;
+    lut.channel_count = VideoParams::kRGBChannelCount;
+    lut.interpolation = (interpolation == OCIO::INTERP_NEAREST) ? Texture::kNearest : Texture::kLinear;
+
+    int value_count = edge_len * edge_len * edge_len * lut.channel_count;
+    lut.values.resize(value_count);
+    memcpy(lut.values.data(), values, value_count * sizeof(float));
+  }
+
+  bake.lut1d.resize(shader_desc->getNumTextures());
+  for (unsigned int i=0; i<shader_desc->getNumTextures(); i++) {
+    const char* tex_name = nullptr;
+    const char* sampler_name = nullptr;
+    unsigned int width = 0, height = 0;
+    OCIO::GpuShaderDesc::TextureType channel = OCIO::GpuShaderDesc::TEXTURE_RGB_CHANNEL;
+    OCIO::Interpolation interpolation = OCIO::INTERP_LINEAR;
+
+    shader_desc->getTexture(i, tex_name, sampler_name, width, height, channel, interpolation);
+
+    if (!tex_name || !*tex_name
+        || !sampler_name || !*sampler_name
+        || !width) {
+      qCritical() << "1D LUT texture data is corrupted";
+      return BakedColorTransform();
+    }
+
+    const float* values = nullptr;
+    shader_desc->getTextureValues(i, values);
+    if (!values) {
+      qCritical() << "1D LUT texture values are missing";
+      return BakedColorTransform();
+    }
+
+    BakedColorTransform::LUT& lut = bake.lut1d[i];
+    lut.sampler_name = QString::fromUtf8(sampler_name);
+    lut.width = width;
+    lut.height = height;
+    lut.depth = 1;
+    lut.channel_count = (channel == OCIO::GpuShaderDesc::TEXTURE_RED_CHANNEL) ? 1 : VideoParams::kRGBChannelCount;
+    lut.interpolation = (interpolation == OCIO::INTERP_NEAREST) ? Texture::kNearest : Texture::kLinear;
+
+    int value_count = width * height * lut.channel_count;
+    lut.values.resize(value_count);
+    memcpy(lut.values.data(), values, value_count * sizeof(float));
+  }
+
+  // Only set once every LUT is known to be good, this is what makes the bake valid
+  bake.shader_text = shader_text;
+
+  return bake;
+}
+
+bool ColorBakeCache::Load(const QString &filename, BakedColorTransform *bake)
+{
+  QFile f(filename);
+  if (!f.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream ds(&f);
+  ds.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+  quint32 version;
+  ds >> version;
+  if (version != kFileVersion) {
+    return false;
+  }
+
+  BakedColorTransform loaded;
+
+  ds >> loaded.shader_text;
+
+  for (int i=0; i<2; i++) {
+    QVector<BakedColorTransform::LUT>& luts = (i == 0) ? loaded.lut3d : loaded.lut1d;
+
+    qint32 count;
+    ds >> count;
+    if (count < 0) {
+      return false;
+    }
+
+    luts.resize(count);
+    for (BakedColorTransform::LUT& lut : luts) {
+      qint32 interpolation;
+
+      ds >> lut.sampler_name >> lut.width >> lut.height >> lut.depth >> lut.channel_count >> interpolation >> lut.values;
+
+      lut.interpolation = static_cast<Texture::Interpolation>(interpolation);
+    }
+  }
+
+  if (ds.status() != QDataStream::Ok || !loaded.IsValid()) {
+    return false;
+  }
+
+  *bake = loaded;
+
+  return true;
+}
+
+bool ColorBakeCache::Save(const QString &filename, const BakedColorTransform &bake)
+{
+  QFile f(filename);
+  if (!f.open(QFile::WriteOnly)) {
+    return false;
+  }
+
+  QDataStream ds(&f);
+  ds.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+  ds << kFileVersion;
+  ds << bake.shader_text;
+
+  for (int i=0; i<2; i++) {
+    const QVector<BakedColorTransform::LUT>& luts = (i == 0) ? bake.lut3d : bake.lut1d;
+
+    ds << qint32(luts.size());
+
+    foreach (const BakedColorTransform::LUT& lut, luts) {
+      ds << lut.sampler_name << lut.width << lut.height << lut.depth << lut.channel_count << qint32(lut.interpolation) << lut.values;
+    }
+  }
+
+  return ds.status() == QDataStream::Ok;
+}
+
+}
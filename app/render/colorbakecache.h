@@ -0,0 +1,97 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef COLORBAKECACHE_H
+#define COLORBAKECACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include "render/colorprocessor.h"
+#include "render/texture.h"
+
+namespace olive {
+
+/**
+ * @brief A color processor's GPU shader function and LUTs, as baked by OCIO
+ */
+struct BakedColorTransform {
+  struct LUT {
+    QString sampler_name;
+    int width;
+    int height;
+    int depth;
+    int channel_count;
+    Texture::Interpolation interpolation;
+    QVector<float> values;
+  };
+
+  bool IsValid() const
+  {
+    return !shader_text.isEmpty();
+  }
+
+  QString shader_text;
+  QVector<LUT> lut3d;
+  QVector<LUT> lut1d;
+
+};
+
+/**
+ * @brief Process-wide cache of baked color transforms, persisted to disk
+ *
+ * Baking LUTs is the slow part of setting up a color transform on the GPU. Every renderer shares
+ * the same bake, and bakes are kept in the user's cache directory by OCIO's cache ID (which covers
+ * the config's contents) so that opening viewers or switching views after a restart doesn't bake
+ * again. Each renderer still compiles its own shader and uploads its own LUT textures, since those
+ * belong to its context.
+ *
+ * All functions are thread-safe.
+ */
+class ColorBakeCache
+{
+public:
+  /**
+   * @brief Returns the bake for `processor`, baking it only if it isn't cached
+   *
+   * The shader function is named `function_name`. An invalid bake is returned if OCIO returns
+   * corrupted LUTs.
+   */
+  static BakedColorTransform Get(ColorProcessorPtr processor, const char* function_name);
+
+private:
+  static BakedColorTransform Bake(ColorProcessorPtr processor, const char* function_name);
+
+  static bool Load(const QString& filename, BakedColorTransform* bake);
+
+  static bool Save(const QString& filename, const BakedColorTransform& bake);
+
+  static const quint32 kFileVersion;
+
+  static QMutex mutex_;
+
+  static QHash<QString, BakedColorTransform> memory_cache_;
+
+};
+
+}
+
+#endif // COLORBAKECACHE_H
@@ -20,12 +20,16 @@
 
 #include "colorprocessor.h"
 
+#include <QtConcurrent/QtConcurrent>
+
 #include "common/define.h"
 #include "common/ocioutils.h"
 #include "node/color/colormanager/colormanager.h"
 
 namespace olive {
 
+const int ColorProcessor::kMinimumRowsPerBand = 64;
+
 ColorProcessor::ColorProcessor(ColorManager *config, const QString &input, const ColorTransform &transform)
 {
   QMutexLocker locker(config->mutex());
@@ -87,16 +91,47 @@ void ColorProcessor::ConvertFrame(Frame *f)
     return;
   }
 
-  OCIO::PackedImageDesc img(f->data(),
-                            f->width(),
-                            f->height(),
-                            VideoParams::kRGBAChannelCount,
-                            ocio_bit_depth,
-                            OCIO::AutoStride,
-                            OCIO::AutoStride,
-                            f->linesize_bytes());
+  OCIO::ConstCPUProcessorRcPtr cpu = GetCPUProcessor(ocio_bit_depth);
+
+  int channel_count = f->channel_count();
+  int linesize = f->linesize_bytes();
+  int width = f->width();
+
+  auto convert_rows = [cpu, f, channel_count, linesize, width, ocio_bit_depth](int start, int count){
+    OCIO::PackedImageDesc img(f->data() + start * linesize,
+                              width,
+                              count,
+                              channel_count,
+                              ocio_bit_depth,
+                              OCIO::AutoStride,
+                              OCIO::AutoStride,
+                              linesize);
+
+    cpu->apply(img);
+  };
+
+  // Every pixel converts independently, so large frames are split into bands of rows across threads
+  int band_count = qMin(QThread::idealThreadCount(), f->height() / kMinimumRowsPerBand);
+
+  if (band_count <= 1) {
+    convert_rows(0, f->height());
+    return;
+  }
+
+  int rows_per_band = (f->height() + band_count - 1) / band_count;
+  QVector< QFuture<void> > bands;
+
+  // The last band is converted on this thread rather than waiting idle
+  int start = 0;
+  for (; start + rows_per_band < f->height(); start += rows_per_band) {
+    bands.append(QtConcurrent::run(GetConversionThreadPool(), convert_rows, start, rows_per_band));
+  }
+
+  convert_rows(start, f->height() - start);
 
-  cpu_processor_->apply(img);
+  foreach (QFuture<void> band, bands) {
+    band.waitForFinished();
+  }
 }
 
 Color ColorProcessor::ConvertColor(const Color& in)
@@ -128,6 +163,29 @@ OCIO::ConstProcessorRcPtr ColorProcessor::GetProcessor()
   return processor_;
 }
 
+OCIO::ConstCPUProcessorRcPtr ColorProcessor::GetCPUProcessor(OCIO::BitDepth bit_depth)
+{
+  QMutexLocker locker(&cpu_processors_lock_);
+
+  OCIO::ConstCPUProcessorRcPtr& cpu = cpu_processors_[bit_depth];
+
+  if (!cpu) {
+    // Processors optimized for the frame's bit depth skip converting to and from float per pixel
+    OCIO_SET_C_LOCALE_FOR_SCOPE;
+    cpu = processor_->getOptimizedCPUProcessor(bit_depth, bit_depth, OCIO::OPTIMIZATION_DEFAULT);
+  }
+
+  return cpu;
+}
+
+QThreadPool *ColorProcessor::GetConversionThreadPool()
+{
+  // Callers block until their bands are done, so conversions get their own threads rather than
+  // risk waiting on jobs queued behind themselves in the global pool
+  static QThreadPool pool;
+  return &pool;
+}
+
 void ColorProcessor::ConvertFrame(FramePtr f)
 {
   ConvertFrame(f.get());
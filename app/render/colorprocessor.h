@@ -21,6 +21,10 @@
 #ifndef COLORPROCESSOR_H
 #define COLORPROCESSOR_H
 
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+
 #include "codec/frame.h"
 #include "common/ocioutils.h"
 #include "render/color.h"
@@ -62,10 +66,24 @@ public:
   static QString GenerateID(ColorManager* config, const QString& input, const ColorTransform& dest_space);
 
 private:
+  /**
+   * @brief Returns a CPU processor optimized for `bit_depth`, creating it the first time
+   */
+  OCIO::ConstCPUProcessorRcPtr GetCPUProcessor(OCIO::BitDepth bit_depth);
+
+  static QThreadPool* GetConversionThreadPool();
+
+  /// Fewest rows worth handing to another thread
+  static const int kMinimumRowsPerBand;
+
   OCIO::ConstProcessorRcPtr processor_;
 
   OCIO::ConstCPUProcessorRcPtr cpu_processor_;
 
+  QMutex cpu_processors_lock_;
+
+  QHash<int, OCIO::ConstCPUProcessorRcPtr> cpu_processors_;
+
   QString id_;
 
 };
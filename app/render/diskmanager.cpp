@@ -20,17 +20,26 @@
 
 #include "diskmanager.h"
 
+#include <algorithm>
 #include <QDataStream>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QLockFile>
 #include <QMessageBox>
+#include <QSaveFile>
 #include <QStandardPaths>
+#include <QSysInfo>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
 
 #include "common/filefunctions.h"
+#include "common/metrics.h"
 #include "config/config.h"
 #include "core.h"
 #include "dialog/diskcache/diskcachedialog.h"
+#include "framepackstore.h"
+#include "memorygovernor.h"
 
 namespace olive {
 
@@ -38,6 +47,10 @@ DiskManager* DiskManager::instance_ = nullptr;
 
 DiskManager::DiskManager()
 {
+  memory_cache_ = new FrameMemoryCache();
+  MemoryGovernor::instance()->Register(QStringLiteral("FrameMemoryCacheSize"), MemoryGovernor::kSystemMemory, 2.0,
+                                       [this](qint64 limit){ memory_cache_->SetMaximumSize(limit); });
+
   // Add default cache location
   QFile default_disk_cache_file(GetDefaultDiskCacheConfigFile());
   if (default_disk_cache_file.open(QFile::ReadOnly)) {
@@ -73,10 +86,14 @@ DiskManager::DiskManager()
 
     disk_cache_index.close();
   }
+
+  metrics_collector_ = MetricsRegistry::AddCollector([this]{ CollectMetrics(); });
 }
 
 DiskManager::~DiskManager()
 {
+  MetricsRegistry::RemoveCollector(metrics_collector_);
+
   QFile default_disk_cache_file(GetDefaultDiskCacheConfigFile());
   if (default_disk_cache_file.open(QFile::WriteOnly)) {
     if (GetDefaultDiskCachePath() != GetDefaultCachePath()) {
@@ -85,6 +102,40 @@ DiskManager::~DiskManager()
 
     default_disk_cache_file.close();
   }
+
+  // Close folders before their pack stores, since closing may still clear or index them
+  qDeleteAll(open_folders_);
+  open_folders_.clear();
+
+  FramePackStore::CloseAll();
+
+  MemoryGovernor::instance()->Unregister(QStringLiteral("FrameMemoryCacheSize"));
+  delete memory_cache_;
+}
+
+void DiskManager::CollectMetrics()
+{
+  static Metric* bytes = MetricsRegistry::Gauge(QStringLiteral("olive_disk_cache_bytes"),
+                                                QStringLiteral("Disk space used by all open cache folders"));
+  static Metric* limit = MetricsRegistry::Gauge(QStringLiteral("olive_disk_cache_limit_bytes"),
+                                                QStringLiteral("Combined size limit of all open cache folders"));
+  static Metric* frames = MetricsRegistry::Gauge(QStringLiteral("olive_disk_cache_frames"),
+                                                 QStringLiteral("Frames stored in all open cache folders"));
+  static Metric* folders = MetricsRegistry::Gauge(QStringLiteral("olive_disk_cache_folders"),
+                                                  QStringLiteral("Open cache folders"));
+
+  qint64 total_bytes = 0, total_limit = 0, total_frames = 0;
+
+  foreach (DiskCacheFolder* f, open_folders_) {
+    total_bytes += f->GetConsumption();
+    total_limit += f->GetLimit();
+    total_frames += f->GetFrameCount();
+  }
+
+  bytes->Set(total_bytes);
+  limit->Set(total_limit);
+  frames->Set(total_frames);
+  folders->Set(open_folders_.size());
 }
 
 void DiskManager::CreateInstance()
@@ -117,6 +168,43 @@ void DiskManager::CreatedFile(const QString &cache_folder, const QString &file_n
   f->CreatedFile(file_name, hash);
 }
 
+void DiskManager::PromoteFile(const QString &cache_folder, const QString &file_name, const QByteArray &hash)
+{
+  DiskCacheFolder* f = GetOpenFolder(cache_folder);
+
+  f->PromoteFile(file_name, hash);
+}
+
+void DiskManager::FolderDeletedFrames(const QString &path, const QVector<QByteArray> &hashes)
+{
+  QStringList visited;
+  EmitDeletedFrames(path, hashes, &visited);
+}
+
+void DiskManager::EmitDeletedFrames(const QString &path, const QVector<QByteArray> &hashes, QStringList *visited)
+{
+  visited->append(path);
+
+  emit DeletedFrames(path, hashes);
+
+  // Folders that overflow into this one may have been relying on it for these frames
+  foreach (DiskCacheFolder* f, open_folders_) {
+    if (f->GetOverflowPath() == path && !visited->contains(f->GetPath())) {
+      QVector<QByteArray> relied_on;
+
+      foreach (const QByteArray& hash, hashes) {
+        if (!f->HasFrame(hash)) {
+          relied_on.append(hash);
+        }
+      }
+
+      if (!relied_on.isEmpty()) {
+        EmitDeletedFrames(f->GetPath(), relied_on, visited);
+      }
+    }
+  }
+}
+
 bool DiskManager::ClearDiskCache(const QString &cache_folder)
 {
   DiskCacheFolder* f = GetOpenFolder(cache_folder);
@@ -140,9 +228,14 @@ DiskCacheFolder *DiskManager::GetOpenFolder(const QString &path)
 
   // We must have to open this folder
   DiskCacheFolder* f = new DiskCacheFolder(path, this);
-  connect(f, &DiskCacheFolder::DeletedFrame, this, &DiskManager::DeletedFrame);
+  connect(f, &DiskCacheFolder::DeletedFrames, this, &DiskManager::FolderDeletedFrames);
   open_folders_.append(f);
 
+  // Evicting into the overflow folder only works if it's open to track what it's been given
+  if (!f->GetOverflowPath().isEmpty()) {
+    GetOpenFolder(f->GetOverflowPath());
+  }
+
   return f;
 }
 
@@ -184,9 +277,47 @@ void DiskManager::ShowDiskCacheSettingsDialog(const QString &path, QWidget *pare
   ShowDiskCacheSettingsDialog(folder, parent);
 }
 
+QMutex DiskCacheFolder::codecs_by_path_lock_;
+QHash<QString, DiskCacheFolder::Codec> DiskCacheFolder::codecs_by_path_;
+QSet<QString> DiskCacheFolder::shared_paths_;
+QHash<QString, QString> DiskCacheFolder::overflow_paths_;
+
+// Indexes start with the negated version so they can be told apart from the original unversioned
+// format, which started with the (always positive) limit
+const qint64 DiskCacheFolder::kIndexVersion = 4;
+
+const double DiskCacheFolder::kEvictionTarget = 0.9;
+
+namespace {
+
+enum JournalRecord : quint8 {
+  kJournalCreated,
+  kJournalAccessed,
+  kJournalDeleted,
+  kJournalSettings
+};
+
+const quint32 kJournalMagic = 0x4F4A524E; // "OJRN"
+
+// Compaction only happens once the journal is both past this size and larger than a snapshot
+// of the index would be, so it stays rare for both small and large caches
+const qint64 kJournalMinCompactionSize = 4 * 1024 * 1024;
+const qint64 kApproxSnapshotEntrySize = 128;
+
+// Presence of this file in a cache folder marks it as shared between users
+const char* kSharedMarkerName = "shared";
+
+}
+
 DiskCacheFolder::DiskCacheFolder(const QString &path, QObject *parent) :
-  QObject(parent)
+  QObject(parent),
+  generation_(0),
+  settings_changed_(false),
+  index_loaded_(true),
+  shared_(false)
 {
+  connect(&load_watcher_, &QFutureWatcher<LoadedIndex>::finished, this, &DiskCacheFolder::IndexLoaded);
+
   SetPath(path);
 
   save_timer_.setInterval(Config::Current()[QStringLiteral("DiskCacheSaveInterval")].toInt());
@@ -201,16 +332,29 @@ DiskCacheFolder::~DiskCacheFolder()
 
 bool DiskCacheFolder::ClearCache()
 {
+  EnsureIndexLoaded();
+
   bool deleted_files = true;
 
+  QVector<QByteArray> deleted = FramePackStore::Get(path_)->Clear();
+
   auto i = disk_data_.begin();
 
   while (i != disk_data_.end()) {
     // We return a false result if any of the files fail to delete, but still try to delete as many as we can
     const HashTime& ht = i.value();
 
-    if (QFile::remove(ht.file_name) || !QFileInfo::exists(ht.file_name)) {
-      emit DeletedFrame(path_, i.key());
+    if (shared_) {
+      // Other users may still be using this frame, it's only deleted once nobody references it
+      ReleaseFile(i.key(), ht);
+      consumption_ -= ht.file_size;
+      JournalDeleted(i.key());
+      deleted.append(i.key());
+      i = disk_data_.erase(i);
+    } else if (QFile::remove(ht.file_name) || !QFileInfo::exists(ht.file_name)) {
+      consumption_ -= ht.file_size;
+      JournalDeleted(i.key());
+      deleted.append(i.key());
       i = disk_data_.erase(i);
     } else {
       qWarning() << "Failed to delete" << i->file_name;
@@ -219,35 +363,274 @@ bool DiskCacheFolder::ClearCache()
     }
   }
 
+  if (!deleted.isEmpty()) {
+    emit DeletedFrames(path_, deleted);
+  }
+
   return deleted_files;
 }
 
 void DiskCacheFolder::Accessed(const QByteArray &hash)
 {
-  if (!disk_data_.contains(hash)) {
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+  auto it = disk_data_.find(hash);
+
+  if (it != disk_data_.end()) {
+    it->access_time = now;
+  } else if (index_loaded_) {
+    return;
+  } else {
+    // This frame may be in the part of the index that hasn't finished loading yet
+    accesses_while_loading_.insert(hash, now);
+  }
+
+  pending_accesses_.insert(hash, now);
+}
+
+QString DiskCacheFolder::GetCodecName(Codec c)
+{
+  switch (c) {
+  case kCodecEXRDWAA:
+    return tr("EXR (DWAA, Lossy)");
+  case kCodecEXRB44:
+    return tr("EXR (B44, Lossy)");
+  case kCodecEXRZip:
+    return tr("EXR (ZIP, Lossless)");
+  case kCodecEXRUncompressed:
+    return tr("EXR (Uncompressed)");
+  case kCodecRaw:
+    return tr("Raw (Uncompressed)");
+  case kCodecPacked:
+    return tr("Packed Raw (Uncompressed)");
+  case kCodecCount:
+    break;
+  }
+
+  return tr("Unknown");
+}
+
+DiskCacheFolder::Codec DiskCacheFolder::GetCodecForPath(const QString &path)
+{
+  QMutexLocker locker(&codecs_by_path_lock_);
+
+  return codecs_by_path_.value(path, kCodecEXRDWAA);
+}
+
+bool DiskCacheFolder::IsSharedPath(const QString &path)
+{
+  QMutexLocker locker(&codecs_by_path_lock_);
+
+  return shared_paths_.contains(path);
+}
+
+void DiskCacheFolder::SetShared(bool e)
+{
+  if (shared_ == e) {
+    return;
+  }
+
+  ClearCache();
+
+  QString marker = QDir(path_).filePath(QLatin1String(kSharedMarkerName));
+
+  if (e) {
+    QFile marker_file(marker);
+    if (!marker_file.open(QFile::WriteOnly)) {
+      qWarning() << "Failed to mark cache as shared:" << path_;
+      return;
+    }
+    marker_file.close();
+  } else {
+    QFile::remove(marker);
+  }
+
+  // Reopen so the index is read from (and written to) the right place
+  SetPath(path_);
+}
+
+QString DiskCacheFolder::GetOverflowPathForPath(const QString &path)
+{
+  QMutexLocker locker(&codecs_by_path_lock_);
+
+  return overflow_paths_.value(path);
+}
+
+void DiskCacheFolder::SetOverflowPath(const QString &path)
+{
+  overflow_path_ = (path == path_) ? QString() : path;
+
+  {
+    QMutexLocker locker(&codecs_by_path_lock_);
+    overflow_paths_.insert(path_, overflow_path_);
+  }
+
+  JournalSettings();
+}
+
+void DiskCacheFolder::PromoteFile(const QString &file_name, const QByteArray &hash)
+{
+  if (disk_data_.contains(hash) || promoting_.contains(hash)) {
     return;
   }
 
-  disk_data_[hash].access_time = QDateTime::currentMSecsSinceEpoch();
+  promoting_.insert(hash);
+
+  // Keep the same layout of subdirectory and name as the folder it came from
+  QFileInfo info(file_name);
+  QString dest = QDir(path_).filePath(QStringLiteral("%1/%2").arg(info.dir().dirName(), info.fileName()));
+
+  QString cache_path = path_;
+
+  QtConcurrent::run([cache_path, file_name, dest, hash]{
+    if (CopyFrameFile(file_name, dest)) {
+      QMetaObject::invokeMethod(DiskManager::instance(),
+                                "CreatedFile",
+                                Qt::QueuedConnection,
+                                Q_ARG(QString, cache_path),
+                                Q_ARG(QString, dest),
+                                Q_ARG(QByteArray, hash));
+    }
+  });
+}
+
+void DiskCacheFolder::DemoteFile(const QByteArray &hash, const HashTime &ht)
+{
+  QString dest = QDir(overflow_path_).filePath(QDir(path_).relativeFilePath(ht.file_name));
+
+  QString cache_path = path_;
+  QString overflow_path = overflow_path_;
+  QString src = ht.file_name;
+
+  // Overflow folders are usually on slower volumes, so the copy is kept off the UI thread. Until
+  // it's done the frame is still readable from here.
+  QtConcurrent::run([cache_path, overflow_path, src, dest, hash]{
+    bool copied = CopyFrameFile(src, dest);
+
+    QFile::remove(src);
+
+    if (copied) {
+      QMetaObject::invokeMethod(DiskManager::instance(),
+                                "CreatedFile",
+                                Qt::QueuedConnection,
+                                Q_ARG(QString, overflow_path),
+                                Q_ARG(QString, dest),
+                                Q_ARG(QByteArray, hash));
+    } else {
+      qWarning() << "Failed to move cache frame to overflow folder:" << dest;
+      QMetaObject::invokeMethod(DiskManager::instance(),
+                                "DeletedFrame",
+                                Qt::QueuedConnection,
+                                Q_ARG(QString, cache_path),
+                                Q_ARG(QByteArray, hash));
+    }
+  });
+}
+
+bool DiskCacheFolder::CopyFrameFile(const QString &src, const QString &dest)
+{
+  if (QFileInfo::exists(dest)) {
+    return true;
+  }
+
+  QFileInfo(dest).dir().mkpath(QStringLiteral("."));
+
+  QString working = QStringLiteral("%1.%2.working").arg(dest, QString::number(quintptr(QThread::currentThreadId())));
+
+  if (!QFile::copy(src, working)) {
+    return false;
+  }
+
+  if (!QFile::rename(working, dest)) {
+    // Someone else got there first
+    QFile::remove(working);
+  }
+
+  return QFileInfo::exists(dest);
+}
+
+void DiskCacheFolder::SetCodec(Codec c)
+{
+  codec_ = c;
+
+  {
+    QMutexLocker locker(&codecs_by_path_lock_);
+    codecs_by_path_.insert(path_, codec_);
+  }
+
+  JournalSettings();
+
+  if (codec_ == kCodecPacked) {
+    UpdatePackLimit();
+  }
+}
+
+void DiskCacheFolder::SetLimit(qint64 l)
+{
+  limit_ = l;
+
+  JournalSettings();
+
+  if (codec_ == kCodecPacked) {
+    UpdatePackLimit();
+  }
+}
+
+void DiskCacheFolder::SetClearOnClose(bool e)
+{
+  clear_on_close_ = e;
+
+  JournalSettings();
+}
+
+void DiskCacheFolder::UpdatePackLimit()
+{
+  // Packed frames aren't tracked individually, the pack store manages its own space
+  QVector<QByteArray> evicted = FramePackStore::Get(path_)->SetLimit(limit_);
+
+  if (!evicted.isEmpty()) {
+    emit DeletedFrames(path_, evicted);
+  }
 }
 
 void DiskCacheFolder::CreatedFile(const QString &file_name, const QByteArray &hash)
 {
   qint64 file_size = QFile(file_name).size();
 
-  disk_data_.insert(hash, {file_name, file_size, QDateTime::currentMSecsSinceEpoch()});
+  HashTime ht = {file_name, file_size, QDateTime::currentMSecsSinceEpoch(), codec_};
 
-  consumption_ += file_size;
+  promoting_.remove(hash);
 
-  QList<QByteArray> deleted_hashes;
+  auto existing = disk_data_.find(hash);
+  if (existing != disk_data_.end()) {
+    if (shared_) {
+      // Frames in a shared folder are never rewritten, this is just another use of one we have
+      Accessed(hash);
+      return;
+    }
 
-  while (consumption_ > limit_) {
-    deleted_hashes.append(DeleteLeastRecent());
+    consumption_ -= existing->file_size;
+  } else if (shared_) {
+    ReferenceChange& ref = pending_references_[hash];
+    ref.delta++;
+    ref.file_name = file_name;
   }
 
-  foreach (const QByteArray& h, deleted_hashes) {
-    emit DeletedFrame(path_, h);
+  disk_data_.insert(hash, ht);
+  pending_accesses_.remove(hash);
+
+  journal_stream_ << quint8(kJournalCreated) << hash << ht.file_name << ht.file_size
+                  << quint8(ht.codec) << GetJournalTime(ht.access_time);
+
+  consumption_ += file_size;
+
+  // Until the rest of the index has loaded we can't tell which frames are least recent, so
+  // enforcing the limit waits until then
+  if (!index_loaded_) {
+    return;
   }
+
+  EnforceLimit();
 }
 
 void DiskCacheFolder::SetPath(const QString &path)
@@ -257,9 +640,7 @@ void DiskCacheFolder::SetPath(const QString &path)
 
   // Signal that disk cache is gone
   if (!disk_data_.empty()) {
-    for (auto it=disk_data_.cbegin(); it!=disk_data_.cend(); it++) {
-      emit DeletedFrame(path_, it.key());
-    }
+    emit DeletedFrames(path_, disk_data_.keys().toVector());
     disk_data_.clear();
   }
 
@@ -267,6 +648,10 @@ void DiskCacheFolder::SetPath(const QString &path)
   clear_on_close_ = false;
   consumption_ = 0;
   limit_ = 21474836480; // Default to 20 GB
+  codec_ = kCodecEXRDWAA;
+  overflow_path_.clear();
+  generation_ = 0;
+  settings_changed_ = false;
 
   // Set path
   path_ = path;
@@ -275,55 +660,364 @@ void DiskCacheFolder::SetPath(const QString &path)
   QDir path_dir(path_);
   path_dir.mkpath(QStringLiteral("."));
 
-  index_path_ = path_dir.filePath(QStringLiteral("index"));
+  shared_ = QFileInfo::exists(path_dir.filePath(QLatin1String(kSharedMarkerName)));
+
+  // In a shared folder, each user keeps their own index of the frames they're using
+  QDir index_dir = path_dir;
+  if (shared_) {
+    index_dir = QDir(path_dir.filePath(QStringLiteral("participants/%1").arg(GetParticipantName())));
+    index_dir.mkpath(QStringLiteral("."));
+  }
+
+  index_path_ = index_dir.filePath(QStringLiteral("index"));
+  journal_path_ = index_dir.filePath(QStringLiteral("journal"));
+  old_journal_path_ = index_dir.filePath(QStringLiteral("journal.old"));
 
-  // Try to load any current cache index from file
+  // Only the settings at the start of the index are read here, entries can number in the millions
+  // so they're read in the background instead
   QFile cache_index_file(index_path_);
 
   if (cache_index_file.open(QFile::ReadOnly)) {
     QDataStream ds(&cache_index_file);
 
-    ds >> limit_;
-    ds >> clear_on_close_;
+    qint64 version;
+    ReadIndexHeader(ds, &version, &generation_, &limit_, &clear_on_close_, &codec_, &overflow_path_);
+
+    cache_index_file.close();
+  }
+
+  {
+    QMutexLocker locker(&codecs_by_path_lock_);
+    codecs_by_path_.insert(path_, codec_);
+    overflow_paths_.insert(path_, overflow_path_);
+
+    if (shared_) {
+      shared_paths_.insert(path_);
+    } else {
+      shared_paths_.remove(path_);
+    }
+  }
+
+  // Only the journal as it is now belongs to the background load, anything appended after this is
+  // already in memory
+  qint64 journal_size = QFileInfo(journal_path_).size();
+
+  OpenJournal();
+
+  index_loaded_ = false;
+  QString index_path = index_path_;
+  QString old_journal_path = old_journal_path_;
+  QString journal_path = journal_path_;
+  load_watcher_.setFuture(QtConcurrent::run([index_path, old_journal_path, journal_path, journal_size]{
+    return LoadIndex(index_path, old_journal_path, journal_path, journal_size);
+  }));
+
+  if (codec_ == kCodecPacked) {
+    UpdatePackLimit();
+  }
+}
+
+bool DiskCacheFolder::ReadIndexHeader(QDataStream &ds, qint64 *version, qint64 *generation, qint64 *limit, bool *clear_on_close, Codec *codec, QString *overflow_path)
+{
+  ds >> *version;
+
+  if (ds.status() != QDataStream::Ok) {
+    return false;
+  }
+
+  if (*version < 0) {
+    *version = -*version;
+
+    if (*version >= 3) {
+      ds >> *generation;
+    } else {
+      *generation = 0;
+    }
+
+    ds >> *limit;
+  } else {
+    *limit = *version;
+    *version = 1;
+    *generation = 0;
+  }
+
+  ds >> *clear_on_close;
+
+  if (*version >= 2) {
+    int c;
+    ds >> c;
+    *codec = static_cast<Codec>(c);
+  }
+
+  if (*version >= 4) {
+    ds >> *overflow_path;
+  }
+
+  return ds.status() == QDataStream::Ok;
+}
+
+DiskCacheFolder::LoadedIndex DiskCacheFolder::LoadIndex(const QString &index_path, const QString &old_journal_path, const QString &journal_path, qint64 journal_size)
+{
+  LoadedIndex index;
+  index.has_settings = false;
+
+  qint64 generation = 0;
+
+  QFile cache_index_file(index_path);
+
+  if (cache_index_file.open(QFile::ReadOnly)) {
+    QDataStream ds(&cache_index_file);
 
-    while (!cache_index_file.atEnd()) {
-      QByteArray hash;
+    qint64 version;
+    if (ReadIndexHeader(ds, &version, &generation, &index.limit, &index.clear_on_close, &index.codec, &index.overflow_path)) {
+      while (!ds.atEnd()) {
+        QByteArray hash;
+        HashTime h;
+
+        ds >> h.file_name;
+        ds >> hash;
+        ds >> h.file_size;
+        ds >> h.access_time;
+
+        if (version >= 2) {
+          int codec;
+          ds >> codec;
+          h.codec = static_cast<Codec>(codec);
+        } else {
+          // Everything used to be written as DWAA
+          h.codec = kCodecEXRDWAA;
+        }
+
+        if (ds.status() != QDataStream::Ok) {
+          break;
+        }
+
+        // Files aren't checked for here, that would mean touching every one of them. One that has
+        // gone missing just fails to load and gets rendered again.
+        index.data.insert(hash, h);
+      }
+    }
+
+    cache_index_file.close();
+  }
+
+  // The old journal only exists if a compaction was interrupted, in which case it holds changes
+  // the snapshot may not have
+  ReplayJournal(old_journal_path, generation, -1, &index);
+  ReplayJournal(journal_path, generation, journal_size, &index);
+
+  return index;
+}
+
+void DiskCacheFolder::ReplayJournal(const QString &journal_path, qint64 min_generation, qint64 max_size, LoadedIndex *index)
+{
+  QFile f(journal_path);
+
+  if (!f.open(QFile::ReadOnly)) {
+    return;
+  }
+
+  QByteArray data = (max_size >= 0) ? f.read(max_size) : f.readAll();
+  f.close();
+
+  QDataStream ds(data);
+
+  quint32 magic;
+  qint64 generation, epoch;
+  ds >> magic >> generation >> epoch;
+
+  if (ds.status() != QDataStream::Ok || magic != kJournalMagic || generation < min_generation) {
+    // Journals older than the snapshot are already part of it
+    return;
+  }
+
+  while (!ds.atEnd()) {
+    quint8 type;
+    QByteArray hash;
+
+    ds >> type;
+
+    switch (type) {
+    case kJournalCreated:
+    {
       HashTime h;
+      quint8 codec;
+      quint32 time;
+
+      ds >> hash >> h.file_name >> h.file_size >> codec >> time;
+      h.codec = static_cast<Codec>(codec);
+      h.access_time = epoch + qint64(time) * 1000;
+
+      if (ds.status() == QDataStream::Ok) {
+        index->data.insert(hash, h);
+      }
+      break;
+    }
+    case kJournalAccessed:
+    {
+      quint32 time;
+
+      ds >> hash >> time;
 
-      ds >> h.file_name;
+      auto it = index->data.find(hash);
+      if (ds.status() == QDataStream::Ok && it != index->data.end()) {
+        it->access_time = epoch + qint64(time) * 1000;
+      }
+      break;
+    }
+    case kJournalDeleted:
       ds >> hash;
-      ds >> h.file_size;
-      ds >> h.access_time;
 
-      if (QFileInfo::exists(h.file_name)) {
-        consumption_ += h.file_size;
-        disk_data_.insert(hash, h);
+      if (ds.status() == QDataStream::Ok) {
+        index->data.remove(hash);
+      }
+      break;
+    case kJournalSettings:
+    {
+      qint64 limit;
+      bool clear_on_close;
+      quint8 codec;
+      QString overflow_path;
+
+      ds >> limit >> clear_on_close >> codec >> overflow_path;
+
+      if (ds.status() == QDataStream::Ok) {
+        index->has_settings = true;
+        index->limit = limit;
+        index->clear_on_close = clear_on_close;
+        index->codec = static_cast<Codec>(codec);
+        index->overflow_path = overflow_path;
       }
+      break;
+    }
+    default:
+      // Unknown record, nothing after this can be trusted
+      ds.setStatus(QDataStream::ReadCorruptData);
     }
 
-    cache_index_file.close();
+    if (ds.status() != QDataStream::Ok) {
+      // A record cut off by a crash, everything before it is still valid
+      break;
+    }
   }
 }
 
-QByteArray DiskCacheFolder::DeleteLeastRecent()
+void DiskCacheFolder::WriteIndex(const QString &index_path, const QString &old_journal_path, qint64 generation, qint64 limit, bool clear_on_close, Codec codec, const QString &overflow_path, const QMap<QByteArray, HashTime> &data)
 {
-  auto hash_to_delete = disk_data_.begin();
+  // QSaveFile only replaces the existing index once everything has been written, so a crash here
+  // leaves the last snapshot and the old journal intact
+  QSaveFile cache_index_file(index_path);
+
+  if (cache_index_file.open(QFile::WriteOnly)) {
+    QDataStream ds(&cache_index_file);
 
-  for (auto it=disk_data_.begin()+1; it!=disk_data_.end(); it++) {
-    if (it->access_time < hash_to_delete->access_time) {
-      hash_to_delete = it;
+    ds << -kIndexVersion;
+    ds << generation;
+    ds << limit;
+    ds << clear_on_close;
+    ds << int(codec);
+    ds << overflow_path;
+
+    for (auto it=data.cbegin(); it!=data.cend(); it++) {
+      const HashTime& ht = it.value();
+
+      ds << ht.file_name;
+      ds << it.key();
+      ds << ht.file_size;
+      ds << ht.access_time;
+      ds << int(ht.codec);
+    }
+
+    if (cache_index_file.commit()) {
+      QFile::remove(old_journal_path);
+      return;
     }
   }
 
-  QByteArray hash = hash_to_delete.key();
-  HashTime ht = hash_to_delete.value();
-  disk_data_.erase(hash_to_delete);
+  qWarning() << "Failed to write cache index:" << index_path;
+}
 
-  QFile::remove(ht.file_name);
+void DiskCacheFolder::EnforceLimit()
+{
+  if (consumption_ <= limit_ || disk_data_.isEmpty()) {
+    return;
+  }
+
+  // Going further than the limit means the frames written after this don't each need an eviction
+  // of their own
+  qint64 target = qint64(limit_ * kEvictionTarget);
+
+  QVector< QPair<qint64, QByteArray> > by_access;
+  by_access.reserve(disk_data_.size());
+
+  for (auto it=disk_data_.cbegin(); it!=disk_data_.cend(); it++) {
+    by_access.append({it->access_time, it.key()});
+  }
+
+  std::sort(by_access.begin(), by_access.end());
+
+  QVector<QByteArray> deleted;
+  QStringList files;
+
+  for (int i=0; i<by_access.size() && consumption_ > target; i++) {
+    const QByteArray& hash = by_access.at(i).second;
+
+    auto entry = disk_data_.find(hash);
+    HashTime ht = entry.value();
+    disk_data_.erase(entry);
+
+    consumption_ -= ht.file_size;
+
+    JournalDeleted(hash);
+
+    if (shared_) {
+      ReleaseFile(hash, ht);
+      deleted.append(hash);
+    } else if (!overflow_path_.isEmpty()) {
+      // The frame isn't gone, so nothing using it needs to know
+      DemoteFile(hash, ht);
+    } else {
+      files.append(ht.file_name);
+      deleted.append(hash);
+    }
+  }
+
+  if (!files.isEmpty()) {
+    qint64 evicted_at = QDateTime::currentMSecsSinceEpoch();
+
+    eviction_ = QtConcurrent::run(GetEvictionThreadPool(), [files, evicted_at]{
+      RemoveEvictedFiles(files, evicted_at);
+    });
+  }
 
-  consumption_ -= ht.file_size;
+  if (!deleted.isEmpty()) {
+    emit DeletedFrames(path_, deleted);
+  }
+}
 
-  return hash;
+QThreadPool *DiskCacheFolder::GetEvictionThreadPool()
+{
+  // Deletes are bound by the filesystem, so one batch at a time is as fast as several
+  static QThreadPool pool;
+  pool.setMaxThreadCount(1);
+  return &pool;
+}
+
+void DiskCacheFolder::RemoveEvictedFiles(const QStringList &files, qint64 evicted_at)
+{
+  // Allow for filesystems that only store modification times to the second or two
+  const qint64 kModificationTimeSlack = 2000;
+
+  foreach (const QString& f, files) {
+    QFileInfo info(f);
+
+    if (info.exists() && info.lastModified().toMSecsSinceEpoch() > evicted_at - kModificationTimeSlack) {
+      // The frame was rendered again after it was evicted, this is a new file
+      continue;
+    }
+
+    QFile::remove(f);
+  }
 }
 
 void DiskCacheFolder::CloseCacheFolder()
@@ -332,6 +1026,8 @@ void DiskCacheFolder::CloseCacheFolder()
     return;
   }
 
+  EnsureIndexLoaded();
+
   if (clear_on_close_) {
     // If we're not moving to new and we're set to clear on close, clear now or else it'll never
     // get cleared later
@@ -340,30 +1036,279 @@ void DiskCacheFolder::CloseCacheFolder()
 
   // Save current cache index
   SaveDiskCacheIndex();
+
+  eviction_.waitForFinished();
+  compaction_.waitForFinished();
+  reference_update_.waitForFinished();
+  journal_.close();
 }
 
-void DiskCacheFolder::SaveDiskCacheIndex()
+void DiskCacheFolder::EnsureIndexLoaded()
 {
-  QFile cache_index_file(index_path_);
+  if (!index_loaded_) {
+    load_watcher_.waitForFinished();
+    IndexLoaded();
+  }
+}
 
-  if (cache_index_file.open(QFile::WriteOnly)) {
-    QDataStream ds(&cache_index_file);
+void DiskCacheFolder::IndexLoaded()
+{
+  if (index_loaded_) {
+    return;
+  }
 
-    ds << limit_;
-    ds << clear_on_close_;
+  index_loaded_ = true;
 
-    for (auto it=disk_data_.cbegin(); it!=disk_data_.cend(); it++) {
-      const HashTime& ht = it.value();
+  LoadedIndex index = load_watcher_.result();
 
-      ds << ht.file_name;
-      ds << it.key();
-      ds << ht.file_size;
-      ds << ht.access_time;
+  // Anything created since the folder was opened is newer than what was on disk
+  for (auto it=disk_data_.cbegin(); it!=disk_data_.cend(); it++) {
+    if (shared_ && index.data.contains(it.key())) {
+      // We already held a reference to this frame, don't take a second one
+      pending_references_[it.key()].delta--;
     }
 
-    cache_index_file.close();
-  } else {
-    qWarning() << "Failed to write cache index:" << index_path_;
+    index.data.insert(it.key(), it.value());
+  }
+
+  disk_data_ = index.data;
+
+  for (auto it=accesses_while_loading_.cbegin(); it!=accesses_while_loading_.cend(); it++) {
+    auto entry = disk_data_.find(it.key());
+    if (entry != disk_data_.end()) {
+      entry->access_time = it.value();
+    }
+  }
+  accesses_while_loading_.clear();
+
+  consumption_ = 0;
+  for (auto it=disk_data_.cbegin(); it!=disk_data_.cend(); it++) {
+    consumption_ += it->file_size;
+  }
+
+  if (index.has_settings && !settings_changed_) {
+    // The snapshot's settings were superseded before it could be compacted
+    clear_on_close_ = index.clear_on_close;
+    limit_ = index.limit;
+    codec_ = index.codec;
+    overflow_path_ = index.overflow_path;
+
+    {
+      QMutexLocker locker(&codecs_by_path_lock_);
+      codecs_by_path_.insert(path_, codec_);
+      overflow_paths_.insert(path_, overflow_path_);
+    }
+
+    if (codec_ == kCodecPacked) {
+      UpdatePackLimit();
+    }
+  }
+
+  EnforceLimit();
+}
+
+void DiskCacheFolder::OpenJournal()
+{
+  journal_.setFileName(journal_path_);
+
+  if (journal_.open(QFile::ReadOnly)) {
+    QDataStream ds(&journal_);
+
+    quint32 magic;
+    qint64 generation;
+    ds >> magic >> generation >> journal_epoch_;
+
+    journal_.close();
+
+    if (ds.status() == QDataStream::Ok && magic == kJournalMagic && generation >= generation_) {
+      // Continue the existing journal
+      generation_ = generation;
+      journal_.open(QFile::WriteOnly | QFile::Append);
+      journal_stream_.setDevice(&journal_);
+      return;
+    }
+  }
+
+  if (!journal_.open(QFile::WriteOnly | QFile::Truncate)) {
+    qWarning() << "Failed to open cache journal:" << journal_path_;
+  }
+
+  journal_epoch_ = QDateTime::currentMSecsSinceEpoch();
+
+  journal_stream_.setDevice(&journal_);
+  journal_stream_ << kJournalMagic << generation_ << journal_epoch_;
+}
+
+void DiskCacheFolder::FlushJournal()
+{
+  if (!journal_.isOpen()) {
+    return;
+  }
+
+  for (auto it=pending_accesses_.cbegin(); it!=pending_accesses_.cend(); it++) {
+    journal_stream_ << quint8(kJournalAccessed) << it.key() << GetJournalTime(it.value());
+  }
+  pending_accesses_.clear();
+
+  journal_.flush();
+}
+
+void DiskCacheFolder::CompactIndex()
+{
+  // Only one snapshot is written at a time
+  compaction_.waitForFinished();
+
+  FlushJournal();
+  journal_.close();
+
+  // Kept until the new snapshot is safely written, in case we crash before then
+  QFile::remove(old_journal_path_);
+  QFile::rename(journal_path_, old_journal_path_);
+
+  generation_++;
+  OpenJournal();
+
+  settings_changed_ = false;
+
+  // The map is implicitly shared, so copying it here is cheap and the write doesn't hold up the UI
+  QString index_path = index_path_;
+  QString old_journal_path = old_journal_path_;
+  qint64 generation = generation_;
+  qint64 limit = limit_;
+  bool clear_on_close = clear_on_close_;
+  Codec codec = codec_;
+  QString overflow_path = overflow_path_;
+  QMap<QByteArray, HashTime> data = disk_data_;
+  compaction_ = QtConcurrent::run([=]{
+    WriteIndex(index_path, old_journal_path, generation, limit, clear_on_close, codec, overflow_path, data);
+  });
+}
+
+quint32 DiskCacheFolder::GetJournalTime(qint64 msecs) const
+{
+  return quint32(qBound(qint64(0), (msecs - journal_epoch_) / 1000, qint64(0xFFFFFFFF)));
+}
+
+void DiskCacheFolder::JournalSettings()
+{
+  settings_changed_ = true;
+
+  journal_stream_ << quint8(kJournalSettings) << limit_ << clear_on_close_ << quint8(codec_) << overflow_path_;
+}
+
+void DiskCacheFolder::JournalDeleted(const QByteArray &hash)
+{
+  pending_accesses_.remove(hash);
+
+  journal_stream_ << quint8(kJournalDeleted) << hash;
+}
+
+void DiskCacheFolder::ReleaseFile(const QByteArray &hash, const HashTime &ht)
+{
+  ReferenceChange& ref = pending_references_[hash];
+  ref.delta--;
+  ref.file_name = ht.file_name;
+}
+
+void DiskCacheFolder::FlushReferenceChanges()
+{
+  if (pending_references_.isEmpty()) {
+    return;
+  }
+
+  // References are counted in files on the shared volume, so updating them happens off the UI thread
+  reference_update_.waitForFinished();
+
+  QString cache_path = path_;
+  QMap<QByteArray, ReferenceChange> changes = pending_references_;
+  pending_references_.clear();
+
+  reference_update_ = QtConcurrent::run([cache_path, changes]{
+    ApplyReferenceChanges(cache_path, changes);
+  });
+}
+
+void DiskCacheFolder::ApplyReferenceChanges(const QString &cache_path, const QMap<QByteArray, ReferenceChange> &changes)
+{
+  // Counts are kept alongside the frames, one file per subdirectory, so users only contend for a
+  // lock when they're touching frames in the same one
+  auto it = changes.cbegin();
+
+  while (it != changes.cend()) {
+    QByteArray shard = it.key().left(1);
+
+    QDir shard_dir(QDir(cache_path).filePath(QString(shard.toHex())));
+    shard_dir.mkpath(QStringLiteral("."));
+
+    QLockFile lock(shard_dir.filePath(QStringLiteral("refs.lock")));
+    lock.lock();
+
+    QString refs_path = shard_dir.filePath(QStringLiteral("refs"));
+
+    QHash<QByteArray, qint32> counts;
+
+    QFile refs_file(refs_path);
+    if (refs_file.open(QFile::ReadOnly)) {
+      QDataStream ds(&refs_file);
+      ds >> counts;
+      refs_file.close();
+    }
+
+    for (; it != changes.cend() && it.key().startsWith(shard); it++) {
+      if (it->delta == 0) {
+        continue;
+      }
+
+      qint32& count = counts[it.key()];
+      count += it->delta;
+
+      if (count <= 0) {
+        // Nobody is using this frame anymore
+        counts.remove(it.key());
+        QFile::remove(it->file_name);
+      }
+    }
+
+    QSaveFile out(refs_path);
+    if (out.open(QFile::WriteOnly)) {
+      QDataStream ds(&out);
+      ds << counts;
+      out.commit();
+    } else {
+      qWarning() << "Failed to write cache references:" << refs_path;
+    }
+
+    lock.unlock();
+  }
+}
+
+QString DiskCacheFolder::GetParticipantName()
+{
+  QString user = QString::fromLocal8Bit(qgetenv("USER"));
+  if (user.isEmpty()) {
+    user = QString::fromLocal8Bit(qgetenv("USERNAME"));
+  }
+
+  return QStringLiteral("%1-%2").arg(QSysInfo::machineHostName(), user);
+}
+
+void DiskCacheFolder::SaveDiskCacheIndex()
+{
+  if (codec_ == kCodecPacked) {
+    FramePackStore::Get(path_)->SaveIndex();
+  }
+
+  FlushJournal();
+
+  FlushReferenceChanges();
+
+  // Changes are only ever appended, the full index is rewritten once the journal has grown large
+  // enough that replaying it would take longer than reading a fresh snapshot
+  if (index_loaded_
+      && (settings_changed_
+          || (journal_.size() > kJournalMinCompactionSize
+              && journal_.size() > disk_data_.size() * kApproxSnapshotEntrySize))) {
+    CompactIndex();
   }
 }
 
@@ -21,12 +21,19 @@
 #ifndef DISKMANAGER_H
 #define DISKMANAGER_H
 
+#include <QDataStream>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QHash>
 #include <QMap>
 #include <QMutex>
 #include <QObject>
+#include <QSet>
+#include <QThreadPool>
 #include <QTimer>
 
 #include "common/define.h"
+#include "framememorycache.h"
 #include "node/project/project.h"
 
 namespace olive {
@@ -39,6 +46,58 @@ public:
 
   virtual ~DiskCacheFolder() override;
 
+  /**
+   * @brief How frames are stored in this folder
+   *
+   * Frames already on disk stay readable in whatever codec they were written in, so this can be
+   * changed at any time.
+   */
+  enum Codec {
+    /// Lossy EXR, smallest files for previews
+    kCodecEXRDWAA,
+
+    /// Lossy EXR, faster to decode than DWAA
+    kCodecEXRB44,
+
+    /// Lossless EXR
+    kCodecEXRZip,
+
+    /// EXR without compression
+    kCodecEXRUncompressed,
+
+    /// Raw pixel data, memory mapped when read. Largest files, but cheapest to decode.
+    kCodecRaw,
+
+    /// Raw pixel data packed into large segment files rather than a file per frame
+    kCodecPacked,
+
+    kCodecCount
+  };
+
+  static QString GetCodecName(Codec c);
+
+  /**
+   * @brief Get the codec new frames in a cache folder should be written with
+   *
+   * Thread-safe.
+   */
+  static Codec GetCodecForPath(const QString& path);
+
+  /**
+   * @brief Get whether a cache folder is shared with other users
+   *
+   * Frames in a shared folder are only deleted once no user's index references them anymore, and
+   * are written under a temporary name so others never read a partial frame. Thread-safe.
+   */
+  static bool IsSharedPath(const QString& path);
+
+  /**
+   * @brief Get the folder frames evicted from a cache folder are moved to, if any
+   *
+   * Thread-safe.
+   */
+  static QString GetOverflowPathForPath(const QString& path);
+
   bool ClearCache();
 
   void Accessed(const QByteArray& hash);
@@ -57,52 +116,236 @@ public:
     return limit_;
   }
 
+  /**
+   * @brief Bytes currently used by frames in this folder
+   */
+  qint64 GetConsumption() const
+  {
+    return consumption_;
+  }
+
+  int GetFrameCount() const
+  {
+    return disk_data_.size();
+  }
+
   bool GetClearOnClose() const
   {
     return clear_on_close_;
   }
 
-  void SetLimit(qint64 l)
+  void SetLimit(qint64 l);
+
+  void SetClearOnClose(bool e);
+
+  Codec GetCodec() const
   {
-    limit_ = l;
+    return codec_;
   }
 
-  void SetClearOnClose(bool e)
+  void SetCodec(Codec c);
+
+  bool IsShared() const
   {
-    clear_on_close_ = e;
+    return shared_;
   }
 
-signals:
-  void DeletedFrame(const QString& path, const QByteArray& hash);
+  /**
+   * @brief Share this folder with (or stop sharing it from) other users of the same volume
+   *
+   * Frames can't move between a private index and a shared one, so this clears this user's
+   * frames from the folder first.
+   */
+  void SetShared(bool e);
 
-private:
-  QByteArray DeleteLeastRecent();
+  const QString& GetOverflowPath() const
+  {
+    return overflow_path_;
+  }
 
-  void CloseCacheFolder();
+  /**
+   * @brief Set a slower, larger folder to move evicted frames to instead of deleting them
+   *
+   * Frames found there are copied back into this folder when they're used again, so frames being
+   * worked on stay local while the long tail is kept for anyone else using the overflow folder.
+   * Shared folders never move their frames out, since other users may still reference them.
+   */
+  void SetOverflowPath(const QString& path);
 
-  QString path_;
+  bool HasFrame(const QByteArray& hash) const
+  {
+    return disk_data_.contains(hash);
+  }
 
-  QString index_path_;
+  /**
+   * @brief Copy a frame found in an overflow folder back into this one
+   */
+  void PromoteFile(const QString& file_name, const QByteArray& hash);
 
+signals:
+  /**
+   * @brief Frames that are no longer in this folder, sent once per batch rather than per frame
+   */
+  void DeletedFrames(const QString& path, const QVector<QByteArray>& hashes);
+
+private:
   struct HashTime {
     QString file_name;
     qint64 file_size;
     qint64 access_time;
+    Codec codec;
+  };
+
+  /**
+   * @brief Index entries read in the background when a folder is opened
+   */
+  struct LoadedIndex {
+    QMap<QByteArray, HashTime> data;
+
+    /// True if the journal recorded settings newer than the snapshot's
+    bool has_settings;
+    qint64 limit;
+    bool clear_on_close;
+    Codec codec;
+    QString overflow_path;
+  };
+
+  static bool ReadIndexHeader(QDataStream& ds, qint64* version, qint64* generation, qint64* limit, bool* clear_on_close, Codec* codec, QString* overflow_path);
+
+  static LoadedIndex LoadIndex(const QString& index_path, const QString& old_journal_path, const QString& journal_path, qint64 journal_size);
+
+  static void ReplayJournal(const QString& journal_path, qint64 min_generation, qint64 max_size, LoadedIndex* index);
+
+  /**
+   * @brief Change to the number of users referencing a frame in a shared folder
+   */
+  struct ReferenceChange {
+    int delta;
+    QString file_name;
   };
 
+  static void ApplyReferenceChanges(const QString& cache_path, const QMap<QByteArray, ReferenceChange>& changes);
+
+  static QString GetParticipantName();
+
+  static void WriteIndex(const QString& index_path, const QString& old_journal_path, qint64 generation, qint64 limit, bool clear_on_close, Codec codec, const QString& overflow_path, const QMap<QByteArray, HashTime>& data);
+
+  /**
+   * @brief Copy a frame file so that nobody else can see it until it's complete
+   *
+   * Returns TRUE if `dest` exists afterwards, including if someone else already put it there.
+   */
+  static bool CopyFrameFile(const QString& src, const QString& dest);
+
+  /**
+   * @brief If over the limit, evict the least recently used frames until under kEvictionTarget of it
+   *
+   * Frames are taken out of the index straight away, but their files are deleted on a background
+   * thread, so the thread that reported a new frame never waits on the filesystem.
+   */
+  void EnforceLimit();
+
+  static QThreadPool* GetEvictionThreadPool();
+
+  static void RemoveEvictedFiles(const QStringList& files, qint64 evicted_at);
+
+  void CloseCacheFolder();
+
+  void UpdatePackLimit();
+
+  void EnsureIndexLoaded();
+
+  void OpenJournal();
+
+  void FlushJournal();
+
+  void CompactIndex();
+
+  quint32 GetJournalTime(qint64 msecs) const;
+
+  void JournalSettings();
+
+  void JournalDeleted(const QByteArray& hash);
+
+  void ReleaseFile(const QByteArray& hash, const HashTime& ht);
+
+  void DemoteFile(const QByteArray& hash, const HashTime& ht);
+
+  void FlushReferenceChanges();
+
+  QString path_;
+
+  QString index_path_;
+
+  QString journal_path_;
+
+  QString old_journal_path_;
+
   QMap<QByteArray, HashTime> disk_data_;
 
+  QFile journal_;
+
+  QDataStream journal_stream_;
+
+  /// Journal times are stored in seconds relative to this, in ms since epoch
+  qint64 journal_epoch_;
+
+  /// Incremented on each compaction so stale journals can be told apart from current ones
+  qint64 generation_;
+
+  /// Accesses are coalesced per frame and only written to the journal when it's flushed
+  QHash<QByteArray, qint64> pending_accesses_;
+
+  /// Accesses to frames that may still be on their way from the background load
+  QHash<QByteArray, qint64> accesses_while_loading_;
+
+  bool settings_changed_;
+
+  bool index_loaded_;
+
+  QFutureWatcher<LoadedIndex> load_watcher_;
+
+  QFuture<void> compaction_;
+
+  /// Most recent batch of evicted files being deleted, batches run in order
+  QFuture<void> eviction_;
+
+  bool shared_;
+
+  /// References taken and dropped since they were last written to the shared folder
+  QMap<QByteArray, ReferenceChange> pending_references_;
+
+  QFuture<void> reference_update_;
+
+  QString overflow_path_;
+
+  /// Frames currently being copied back from an overflow folder
+  QSet<QByteArray> promoting_;
+
   qint64 consumption_;
 
   qint64 limit_;
 
   bool clear_on_close_;
 
+  Codec codec_;
+
   QTimer save_timer_;
 
+  static QMutex codecs_by_path_lock_;
+  static QHash<QString, Codec> codecs_by_path_;
+  static QSet<QString> shared_paths_;
+  static QHash<QString, QString> overflow_paths_;
+
+  static const qint64 kIndexVersion;
+
+  static const double kEvictionTarget;
+
 private slots:
   void SaveDiskCacheIndex();
 
+  void IndexLoaded();
+
 };
 
 class DiskManager : public QObject
@@ -135,6 +378,11 @@ public:
     return open_folders_;
   }
 
+  FrameMemoryCache* memory_cache() const
+  {
+    return memory_cache_;
+  }
+
   static bool ShowDiskCacheChangeConfirmationDialog(QWidget* parent);
 
   static QString GetDefaultDiskCacheConfigFile();
@@ -149,9 +397,16 @@ public slots:
 
   void CreatedFile(const QString& cache_folder, const QString& file_name, const QByteArray& hash);
 
+  void PromoteFile(const QString& cache_folder, const QString& file_name, const QByteArray& hash);
+
 signals:
   void DeletedFrame(const QString& path, const QByteArray& hash);
 
+  /**
+   * @brief Same as DeletedFrame() for several frames at once, e.g. when a folder evicts a batch
+   */
+  void DeletedFrames(const QString& path, const QVector<QByteArray>& hashes);
+
   void InvalidateProject(Project* p);
 
 private:
@@ -161,8 +416,19 @@ private:
 
   static DiskManager* instance_;
 
+  void EmitDeletedFrames(const QString& path, const QVector<QByteArray>& hashes, QStringList* visited);
+
+  void CollectMetrics();
+
   QVector<DiskCacheFolder*> open_folders_;
 
+  FrameMemoryCache* memory_cache_;
+
+  int metrics_collector_;
+
+private slots:
+  void FolderDeletedFrames(const QString& path, const QVector<QByteArray>& hashes);
+
 };
 
 }
@@ -28,18 +28,49 @@
 #include <OpenEXR/ImfOutputFile.h>
 #include <OpenEXR/ImfChannelList.h>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
 
 #include "codec/frame.h"
 #include "common/filefunctions.h"
 #include "common/timecodefunctions.h"
+#include "common/tracing.h"
 #include "render/diskmanager.h"
+#include "render/framepackstore.h"
+#include "render/hardwareprofile.h"
 
 namespace olive {
 
-QMutex FrameHashCache::currently_saving_frames_mutex_;
-QMap<QByteArray, FramePtr> FrameHashCache::currently_saving_frames_;
-const QString FrameHashCache::kCacheFormatExtension = QStringLiteral(".exr");
+const int FrameHashCache::kSavingShardCount = 16;
+const int FrameHashCache::kWriteQueueSize = 512;
+const QString FrameHashCache::kEXRFormatExtension = QStringLiteral(".exr");
+const QString FrameHashCache::kRawFormatExtension = QStringLiteral(".raw");
+const int FrameHashCache::kMaximumOverflowDepth = 4;
+
+namespace {
+
+/**
+ * @brief Header at the start of every raw cache frame, followed by the pixel data
+ */
+struct RawFrameHeader {
+  char magic[4];
+  qint32 version;
+  qint32 width;
+  qint32 height;
+  qint32 format;
+  qint32 channel_count;
+  qint32 divider;
+  qint32 pixel_aspect_num;
+  qint32 pixel_aspect_den;
+  qint32 linesize_bytes;
+};
+
+const char kRawFrameMagic[4] = {'O', 'R', 'A', 'W'};
+const qint32 kRawFrameVersion = 1;
+
+}
 
 #define super PlaybackCache
 
@@ -48,6 +79,7 @@ FrameHashCache::FrameHashCache(QObject *parent) :
 {
   if (DiskManager::instance()) {
     connect(DiskManager::instance(), &DiskManager::DeletedFrame, this, &FrameHashCache::HashDeleted);
+    connect(DiskManager::instance(), &DiskManager::DeletedFrames, this, &FrameHashCache::HashesDeleted);
     connect(DiskManager::instance(), &DiskManager::InvalidateProject, this, &FrameHashCache::ProjectInvalidated);
   }
 }
@@ -78,6 +110,62 @@ void FrameHashCache::SetHash(const rational &time, const QByteArray &hash, const
   }
 }
 
+void FrameHashCache::SaveState(QDataStream &s, const QDir &file_dir)
+{
+  super::SaveState(s, file_dir);
+
+  QMap<rational, QByteArray> map = time_hash_map_.ToMap();
+
+  s << timebase_.toString() << qint32(map.size());
+
+  for (auto it=map.cbegin(); it!=map.cend(); it++) {
+    s << it.key().toString() << it.value();
+  }
+}
+
+bool FrameHashCache::RestoreState(QDataStream &s, const QDir &)
+{
+  TimeRangeList invalidated;
+  QString timebase;
+  qint32 count;
+
+  if (!ReadState(s, &invalidated)) {
+    return false;
+  }
+
+  s >> timebase >> count;
+
+  if (s.status() != QDataStream::Ok || rational::fromString(timebase) != timebase_ || count < 0) {
+    return false;
+  }
+
+  FrameHashMap map;
+
+  for (qint32 i=0; i<count && s.status() == QDataStream::Ok; i++) {
+    QString time;
+    QByteArray hash;
+    s >> time >> hash;
+
+    rational t = rational::fromString(time);
+
+    if (CacheFrameExists(hash)) {
+      map.insert(t, hash);
+    } else {
+      // Frame has been deleted since, e.g. to keep the disk cache under its limit
+      invalidated.insert(TimeRange(t, t + timebase_));
+    }
+  }
+
+  if (s.status() != QDataStream::Ok) {
+    return false;
+  }
+
+  time_hash_map_ = map;
+  ApplyRestoredState(invalidated);
+
+  return true;
+}
+
 void FrameHashCache::SetTimebase(const rational &tb)
 {
   timebase_ = tb;
@@ -87,46 +175,28 @@ void FrameHashCache::ValidateFramesWithHash(const QByteArray &hash)
 {
   const TimeRangeList& invalidated_ranges = GetInvalidatedRanges();
 
-  for (auto iterator=time_hash_map_.begin();iterator!=time_hash_map_.end();iterator++) {
-    if (iterator.value() == hash) {
-      TimeRange frame_range(iterator.key(), iterator.key() + timebase_);
+  foreach (const rational& time, time_hash_map_.times_with_hash(hash)) {
+    TimeRange frame_range(time, time + timebase_);
 
-      if (invalidated_ranges.contains(frame_range)) {
-        Validate(frame_range);
-      }
+    if (invalidated_ranges.contains(frame_range)) {
+      Validate(frame_range);
     }
   }
 }
 
 QList<rational> FrameHashCache::GetFramesWithHash(const QByteArray &hash)
 {
-  QList<rational> times;
-
-  for (auto iterator=time_hash_map_.begin();iterator!=time_hash_map_.end();iterator++) {
-    if (iterator.value() == hash) {
-      times.append(iterator.key());
-    }
-  }
-
-  return times;
+  return time_hash_map_.times_with_hash(hash);
 }
 
 QList<rational> FrameHashCache::TakeFramesWithHash(const QByteArray &hash)
 {
   TimeRangeList range_to_invalidate;
-  QList<rational> times;
-
-  auto iterator = time_hash_map_.begin();
-
-  while (iterator != time_hash_map_.end()) {
-    if (iterator.value() == hash) {
-      times.append(iterator.key());
-      range_to_invalidate.insert(TimeRange(iterator.key(), iterator.key() + timebase_));
+  QList<rational> times = time_hash_map_.times_with_hash(hash);
 
-      iterator = time_hash_map_.erase(iterator);
-    } else {
-      iterator++;
-    }
+  foreach (const rational& time, times) {
+    range_to_invalidate.insert(TimeRange(time, time + timebase_));
+    time_hash_map_.remove(time);
   }
 
   foreach (const TimeRange& r, range_to_invalidate) {
@@ -140,7 +210,7 @@ QList<rational> FrameHashCache::TakeFramesWithHash(const QByteArray &hash)
 
 QMap<rational, QByteArray> FrameHashCache::time_hash_map()
 {
-  return time_hash_map_;
+  return time_hash_map_.ToMap();
 }
 
 QVector<rational> FrameHashCache::GetFrameListFromTimeRange(TimeRangeList range_list, const rational &timebase)
@@ -192,14 +262,74 @@ bool FrameHashCache::SaveCacheFrame(const QByteArray &hash, FramePtr frame) cons
 
 bool FrameHashCache::SaveCacheFrame(const QString &cache_path, const QByteArray &hash, char *data, const VideoParams &vparam, int linesize_bytes)
 {
+  TRACE_SCOPE("cache", "FrameHashCache::SaveCacheFrame");
+
   if (cache_path.isEmpty()) {
     qWarning() << "Failed to save cache frame with empty path";
     return false;
   }
 
-  QString fn = CachePathName(cache_path, hash);
+  // Always write in the folder's current codec, even if an older copy exists in another one
+  int codec = DiskCacheFolder::GetCodecForPath(cache_path);
+
+  bool shared = DiskCacheFolder::IsSharedPath(cache_path);
+
+  if (shared) {
+    // Another user may have rendered this frame already, hashes are the same across projects so
+    // we can just use theirs
+    QString existing = CachePathName(cache_path, hash);
+
+    if (QFileInfo::exists(existing)) {
+      QMetaObject::invokeMethod(DiskManager::instance(),
+                                "CreatedFile",
+                                Qt::QueuedConnection,
+                                Q_ARG(QString, cache_path),
+                                Q_ARG(QString, existing),
+                                Q_ARG(QByteArray, hash));
+      return true;
+    }
+
+    // Pack segments belong to one process, other users can't read them
+    if (codec == DiskCacheFolder::kCodecPacked) {
+      codec = DiskCacheFolder::kCodecRaw;
+    }
+  }
+
+  if (codec == DiskCacheFolder::kCodecPacked) {
+    QVector<QByteArray> evicted;
+
+    bool ret = FramePackStore::Get(cache_path)->Write(hash, data, vparam, linesize_bytes, &evicted);
+
+    foreach (const QByteArray& h, evicted) {
+      QMetaObject::invokeMethod(DiskManager::instance(),
+                                "DeletedFrame",
+                                Qt::QueuedConnection,
+                                Q_ARG(QString, cache_path),
+                                Q_ARG(QByteArray, h));
+    }
+
+    return ret;
+  }
+  QString fn = CachePathBase(cache_path, hash) + GetCacheFormatExtension(codec);
 
-  if (SaveCacheFrame(fn, data, vparam, linesize_bytes)) {
+  bool saved;
+
+  if (shared) {
+    // Write under a name nobody else will read, so other users never see a partial frame
+    QString working_fn = QStringLiteral("%1.%2.working").arg(fn, QString::number(quintptr(QThread::currentThreadId())));
+
+    saved = SaveCacheFrame(working_fn, data, vparam, linesize_bytes, codec);
+
+    if (saved && !QFile::rename(working_fn, fn)) {
+      // Someone else finished the same frame first, theirs is just as good
+      QFile::remove(working_fn);
+      saved = QFileInfo::exists(fn);
+    }
+  } else {
+    saved = SaveCacheFrame(fn, data, vparam, linesize_bytes, codec);
+  }
+
+  if (saved) {
     // Register frame with the disk manager
     QMetaObject::invokeMethod(DiskManager::instance(),
                               "CreatedFile",
@@ -217,14 +347,16 @@ bool FrameHashCache::SaveCacheFrame(const QString &cache_path, const QByteArray
 bool FrameHashCache::SaveCacheFrame(const QString &cache_path, const QByteArray &hash, FramePtr frame)
 {
   if (frame) {
-    QMutexLocker locker(&currently_saving_frames_mutex_);
-    currently_saving_frames_.insert(hash, frame);
+    SavingShard& shard = GetSavingShard(hash);
+
+    QMutexLocker locker(&shard.mutex);
+    shard.frames.insert(hash, frame);
     locker.unlock();
 
     bool ret = SaveCacheFrame(cache_path, hash, frame->data(), frame->video_params(), frame->linesize_bytes());
 
     locker.relock();
-    currently_saving_frames_.remove(hash);
+    shard.frames.remove(hash);
     locker.unlock();
 
     return ret;
@@ -234,23 +366,190 @@ bool FrameHashCache::SaveCacheFrame(const QString &cache_path, const QByteArray
   }
 }
 
+bool FrameHashCache::SaveCacheFrameAsync(const QString &cache_path, const QByteArray &hash, FramePtr frame)
+{
+  if (!frame) {
+    qWarning() << "Attempted to save a NULL frame to the cache. This may or may not be desirable.";
+    return false;
+  }
+
+  if (cache_path.isEmpty()) {
+    qWarning() << "Failed to save cache frame with empty path";
+    return false;
+  }
+
+  SavingShard& shard = GetSavingShard(hash);
+
+  {
+    QMutexLocker locker(&shard.mutex);
+
+    if (shard.frames.contains(hash)) {
+      // Identical frame is already on its way to disk
+      return true;
+    }
+
+    // Make the frame loadable straight away
+    shard.frames.insert(hash, frame);
+  }
+
+  // Reserve our share of the queue (in MB), waiting here if the disk has fallen too far behind.
+  // Clamp to the whole queue so a single huge frame can't wait forever.
+  int queue_slots = qBound(1, int(frame->allocated_size() / 1024 / 1024), kWriteQueueSize);
+  GetWriteQueueSlots()->acquire(queue_slots);
+
+  QtConcurrent::run(GetWriteThreadPool(), [cache_path, hash, frame, queue_slots](){
+    bool ret = SaveCacheFrame(cache_path, hash, frame->data(), frame->video_params(), frame->linesize_bytes());
+
+    SavingShard& shard = GetSavingShard(hash);
+    shard.mutex.lock();
+    shard.frames.remove(hash);
+    shard.mutex.unlock();
+
+    GetWriteQueueSlots()->release(queue_slots);
+
+    if (ret) {
+      // Most frames are played back soon after they're rendered
+      DiskManager::instance()->memory_cache()->Insert(hash, frame);
+    } else {
+      // Whoever validated this frame when it was queued needs to know it never made it to disk
+      qCritical() << "Failed to write cache frame" << hash.toHex();
+      QMetaObject::invokeMethod(DiskManager::instance(),
+                                "DeletedFrame",
+                                Qt::QueuedConnection,
+                                Q_ARG(QString, cache_path),
+                                Q_ARG(QByteArray, hash));
+    }
+  });
+
+  return true;
+}
+
+void FrameHashCache::WaitForPendingWrites()
+{
+  GetWriteThreadPool()->waitForDone();
+}
+
+FrameHashCache::SavingShard &FrameHashCache::GetSavingShard(const QByteArray &hash)
+{
+  static SavingShard shards[kSavingShardCount];
+
+  // Hashes are already well distributed, so the first byte is enough to pick a shard
+  int index = hash.isEmpty() ? 0 : quint8(hash.at(0)) % kSavingShardCount;
+
+  return shards[index];
+}
+
+QThreadPool *FrameHashCache::GetWriteThreadPool()
+{
+  // EXR compression is CPU-bound enough to benefit from a few threads, but these shouldn't take
+  // threads away from render jobs in the global pool
+  static QThreadPool pool;
+  static const bool initialized = [](){
+    pool.setMaxThreadCount(HardwareProfile::GetCacheWriteThreadCount());
+    return true;
+  }();
+  Q_UNUSED(initialized)
+
+  return &pool;
+}
+
+QSemaphore *FrameHashCache::GetWriteQueueSlots()
+{
+  static QSemaphore queue_slots(kWriteQueueSize);
+
+  return &queue_slots;
+}
+
 FramePtr FrameHashCache::LoadCacheFrame(const QString &cache_path, const QByteArray &hash)
 {
+  TRACE_SCOPE("cache", "FrameHashCache::LoadCacheFrame");
+
   // Minor optimization, we store frames currently being saved just in case something tries to load
   // while we're saving. This should *occasionally* optimize and also prevent scenarios where
   // we try to load a frame that's half way through being saved.
-  QMutexLocker locker(&currently_saving_frames_mutex_);
-  if (currently_saving_frames_.contains(hash)) {
-    return currently_saving_frames_.value(hash);
+  {
+    SavingShard& shard = GetSavingShard(hash);
+    QMutexLocker locker(&shard.mutex);
+    auto it = shard.frames.constFind(hash);
+    if (it != shard.frames.constEnd()) {
+      return it.value();
+    }
   }
-  locker.unlock();
 
   if (cache_path.isEmpty()) {
     qWarning() << "Failed to load cache frame with empty path";
     return nullptr;
   }
 
-  return LoadCacheFrame(CachePathName(cache_path, hash));
+  FrameMemoryCache* memory_cache = DiskManager::instance()->memory_cache();
+
+  if (FramePtr in_memory = memory_cache->Get(hash)) {
+    // Still let the disk cache know this frame is in use so it isn't evicted from there
+    QMetaObject::invokeMethod(DiskManager::instance(),
+                              "Accessed",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, cache_path),
+                              Q_ARG(QByteArray, hash));
+    return in_memory;
+  }
+
+  if (FramePtr packed = FramePackStore::Get(cache_path)->Read(hash)) {
+    memory_cache->Insert(hash, packed);
+    return packed;
+  }
+
+  QString fn = CachePathName(cache_path, hash);
+
+  FramePtr frame = LoadCacheFrame(fn);
+
+  if (!frame) {
+    return nullptr;
+  }
+
+  memory_cache->Insert(hash, frame);
+
+  if (!fn.startsWith(CachePathBase(cache_path, hash))) {
+    // Found in an overflow folder. It's being used again, so bring it back.
+    QMetaObject::invokeMethod(DiskManager::instance(),
+                              "PromoteFile",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, cache_path),
+                              Q_ARG(QString, fn),
+                              Q_ARG(QByteArray, hash));
+  } else if (DiskCacheFolder::IsSharedPath(cache_path)) {
+    // Take a reference so this frame is kept while we're using it, even if another user rendered it
+    QMetaObject::invokeMethod(DiskManager::instance(),
+                              "CreatedFile",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, cache_path),
+                              Q_ARG(QString, fn),
+                              Q_ARG(QByteArray, hash));
+  }
+
+  return frame;
+}
+
+bool FrameHashCache::CacheFrameExists(const QString &cache_path, const QByteArray &hash)
+{
+  {
+    SavingShard& shard = GetSavingShard(hash);
+    QMutexLocker locker(&shard.mutex);
+    if (shard.frames.contains(hash)) {
+      return true;
+    }
+  }
+
+  if (cache_path.isEmpty()) {
+    return false;
+  }
+
+  return FramePackStore::Get(cache_path)->Contains(hash)
+      || QFileInfo::exists(CachePathName(cache_path, hash));
+}
+
+bool FrameHashCache::CacheFrameExists(const QByteArray &hash) const
+{
+  return CacheFrameExists(GetCacheDirectory(), hash);
 }
 
 FramePtr FrameHashCache::LoadCacheFrame(const QByteArray &hash) const
@@ -259,6 +558,15 @@ FramePtr FrameHashCache::LoadCacheFrame(const QByteArray &hash) const
 }
 
 FramePtr FrameHashCache::LoadCacheFrame(const QString &fn)
+{
+  if (fn.endsWith(kRawFormatExtension)) {
+    return LoadRawFrame(fn);
+  } else {
+    return LoadEXRFrame(fn);
+  }
+}
+
+FramePtr FrameHashCache::LoadEXRFrame(const QString &fn)
 {
   FramePtr frame = nullptr;
 
@@ -313,85 +621,93 @@ FramePtr FrameHashCache::LoadCacheFrame(const QString &fn)
   return frame;
 }
 
-void FrameHashCache::LengthChangedEvent(const rational &old, const rational &newlen)
+FramePtr FrameHashCache::LoadRawFrame(const QString &filename)
 {
-  if (newlen < old) {
-    auto i = time_hash_map_.begin();
+  QFile file(filename);
 
-    while (i != time_hash_map_.end()) {
-      if (i.key() >= newlen) {
-        i = time_hash_map_.erase(i);
-      } else {
-        i++;
-      }
-    }
+  if (!file.open(QFile::ReadOnly) || file.size() < qint64(sizeof(RawFrameHeader))) {
+    return nullptr;
   }
-}
 
-struct HashTimePair {
-  rational time;
-  QByteArray hash;
-};
-
-void FrameHashCache::ShiftEvent(const rational &from, const rational &to)
-{
-  auto i = time_hash_map_.begin();
-
-  // POSITIVE if moving forward ->
-  // NEGATIVE if moving backward <-
-  rational diff = to - from;
-  bool diff_is_negative = (diff < 0);
+  // Map rather than read so the only copy is the one into the frame
+  uchar* map = file.map(0, file.size());
+  if (!map) {
+    return nullptr;
+  }
 
-  QList<HashTimePair> shifted_times;
+  FramePtr frame = nullptr;
+  RawFrameHeader header;
+  memcpy(&header, map, sizeof(header));
 
-  while (i != time_hash_map_.end()) {
-    if (diff_is_negative && i.key() >= to && i.key() < from) {
+  if (memcmp(header.magic, kRawFrameMagic, sizeof(kRawFrameMagic)) == 0
+      && header.version == kRawFrameVersion
+      && file.size() >= qint64(sizeof(header)) + qint64(header.linesize_bytes) * header.height) {
+    int div = qMax(1, int(header.divider));
 
-      // This time will be removed in the shift so we just discard it
-      i = time_hash_map_.erase(i);
+    frame = Frame::Create();
+    frame->set_video_params(VideoParams(header.width * div,
+                                        header.height * div,
+                                        static_cast<VideoParams::Format>(header.format),
+                                        header.channel_count,
+                                        rational(header.pixel_aspect_num, header.pixel_aspect_den),
+                                        VideoParams::kInterlaceNone,
+                                        div));
+    frame->allocate();
 
-    } else if (i.key() >= from) {
+    const uchar* src = map + sizeof(header);
+    int copy_sz = qMin(header.linesize_bytes, frame->linesize_bytes());
 
-      // This time is after the from time and must be shifted
-      shifted_times.append({i.key() + diff, i.value()});
-      i = time_hash_map_.erase(i);
+    for (int y=0; y<header.height; y++) {
+      memcpy(frame->data() + y * frame->linesize_bytes(), src + y * header.linesize_bytes, copy_sz);
+    }
+  }
 
-    } else {
+  file.unmap(map);
 
-      // Do nothing
-      i++;
+  return frame;
+}
 
-    }
+void FrameHashCache::LengthChangedEvent(const rational &old, const rational &newlen)
+{
+  if (newlen < old) {
+    time_hash_map_.remove(TimeRange(newlen, RATIONAL_MAX));
   }
+}
 
-  foreach (const HashTimePair& p, shifted_times) {
-    time_hash_map_.insert(p.time, p.hash);
-  }
+void FrameHashCache::ShiftEvent(const rational &from, const rational &to)
+{
+  time_hash_map_.shift(from, to);
 }
 
 void FrameHashCache::InvalidateEvent(const TimeRange &range)
 {
   if (!timebase_.isNull()) {
-    QVector<rational> invalid_frames = GetFrameListFromTimeRange({range});
-
-    foreach (const rational& r, invalid_frames) {
-      time_hash_map_.remove(r);
-    }
+    // Same frames GetFrameListFromTimeRange() would list, without visiting each one
+    time_hash_map_.remove(TimeRange(Timecode::snap_time_to_timebase(range.in(), timebase_, true), range.out()));
   }
 }
 
 void FrameHashCache::HashDeleted(const QString& s, const QByteArray &hash)
+{
+  HashesDeleted(s, {hash});
+}
+
+void FrameHashCache::HashesDeleted(const QString &s, const QVector<QByteArray> &hashes)
 {
   QString cache_dir = GetCacheDirectory();
   if (cache_dir.isEmpty() || s != cache_dir) {
     return;
   }
 
+  QSet<QByteArray> hash_set;
+  hash_set.reserve(hashes.size());
+  foreach (const QByteArray& h, hashes) {
+    hash_set.insert(h);
+  }
+
   TimeRangeList ranges_to_invalidate;
-  for (auto i=time_hash_map_.constBegin(); i!=time_hash_map_.constEnd(); i++) {
-    if (i.value() == hash) {
-      ranges_to_invalidate.insert(TimeRange(i.key(), i.key() + timebase_));
-    }
+  foreach (const rational& time, time_hash_map_.times_with_hashes(hash_set)) {
+    ranges_to_invalidate.insert(TimeRange(time, time + timebase_));
   }
 
   foreach (const TimeRange& range, ranges_to_invalidate) {
@@ -417,9 +733,7 @@ QString FrameHashCache::CachePathName(const QByteArray& hash) const
 
 QString FrameHashCache::CachePathName(const QString &cache_path, const QByteArray &hash)
 {
-  QDir cache_dir(QDir(cache_path).filePath(QString(hash.left(1).toHex())));
-
-  QString filename = QStringLiteral("%1%2").arg(QString(hash.mid(1).toHex()), kCacheFormatExtension);
+  QString base = CachePathBase(cache_path, hash);
 
   // Register that in some way this hash has been accessed
   QMetaObject::invokeMethod(DiskManager::instance(),
@@ -428,10 +742,87 @@ QString FrameHashCache::CachePathName(const QString &cache_path, const QByteArra
                             Q_ARG(QString, cache_path),
                             Q_ARG(QByteArray, hash));
 
-  return cache_dir.filePath(filename);
+  QString filename = base + GetCacheFormatExtension(DiskCacheFolder::GetCodecForPath(cache_path));
+
+  if (!QFileInfo::exists(filename)) {
+    // This frame may have been written before the folder switched containers
+    QString other = base + (filename.endsWith(kRawFormatExtension) ? kEXRFormatExtension : kRawFormatExtension);
+
+    if (QFileInfo::exists(other)) {
+      return other;
+    }
+
+    // Or it may have been moved out to an overflow folder. Limit how far we follow them in case
+    // they've been set up in a loop.
+    QString tier = DiskCacheFolder::GetOverflowPathForPath(cache_path);
+
+    for (int i=0; i<kMaximumOverflowDepth && !tier.isEmpty() && tier != cache_path; i++) {
+      QString tier_base = CachePathBase(tier, hash);
+
+      for (const QString& ext : {kEXRFormatExtension, kRawFormatExtension}) {
+        QString tier_filename = tier_base + ext;
+
+        if (QFileInfo::exists(tier_filename)) {
+          QMetaObject::invokeMethod(DiskManager::instance(),
+                                    "Accessed",
+                                    Qt::QueuedConnection,
+                                    Q_ARG(QString, tier),
+                                    Q_ARG(QByteArray, hash));
+
+          return tier_filename;
+        }
+      }
+
+      tier = DiskCacheFolder::GetOverflowPathForPath(tier);
+    }
+  }
+
+  return filename;
+}
+
+QString FrameHashCache::CachePathBase(const QString &cache_path, const QByteArray &hash)
+{
+  QDir cache_dir(QDir(cache_path).filePath(QString(hash.left(1).toHex())));
+
+  return cache_dir.filePath(QString(hash.mid(1).toHex()));
+}
+
+QString FrameHashCache::GetCacheFormatExtension(int codec)
+{
+  return (codec == DiskCacheFolder::kCodecRaw) ? kRawFormatExtension : kEXRFormatExtension;
 }
 
-bool FrameHashCache::SaveCacheFrame(const QString &filename, char *data, const VideoParams &vparam, int linesize_bytes)
+bool FrameHashCache::SaveRawFrame(const QString &filename, char *data, const VideoParams &vparam, int linesize_bytes)
+{
+  QFile file(filename);
+
+  if (!file.open(QFile::WriteOnly)) {
+    return false;
+  }
+
+  RawFrameHeader header;
+  memcpy(header.magic, kRawFrameMagic, sizeof(kRawFrameMagic));
+  header.version = kRawFrameVersion;
+  header.width = vparam.effective_width();
+  header.height = vparam.effective_height();
+  header.format = vparam.format();
+  header.channel_count = vparam.channel_count();
+  header.divider = vparam.divider();
+  header.pixel_aspect_num = vparam.pixel_aspect_ratio().numerator();
+  header.pixel_aspect_den = vparam.pixel_aspect_ratio().denominator();
+  header.linesize_bytes = linesize_bytes;
+
+  qint64 data_sz = qint64(linesize_bytes) * header.height;
+
+  bool ret = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == qint64(sizeof(header))
+      && file.write(data, data_sz) == data_sz;
+
+  file.close();
+
+  return ret;
+}
+
+bool FrameHashCache::SaveCacheFrame(const QString &filename, char *data, const VideoParams &vparam, int linesize_bytes, int codec)
 {
   if (!VideoParams::FormatIsFloat(vparam.format())) {
     return false;
@@ -443,6 +834,10 @@ bool FrameHashCache::SaveCacheFrame(const QString &filename, char *data, const V
     cache_dir.mkpath(".");
   }
 
+  if (codec == DiskCacheFolder::kCodecRaw) {
+    return SaveRawFrame(filename, data, vparam, linesize_bytes);
+  }
+
   // Floating point types are stored in EXR
   Imf::PixelType pix_type;
 
@@ -461,8 +856,23 @@ bool FrameHashCache::SaveCacheFrame(const QString &filename, char *data, const V
     header.channels().insert("A", Imf::Channel(pix_type));
   }
 
-  header.compression() = Imf::DWAA_COMPRESSION;
-  header.insert("dwaCompressionLevel", Imf::FloatAttribute(200.0f));
+  switch (codec) {
+  case DiskCacheFolder::kCodecEXRB44:
+    // B44 only compresses half channels, full float ones are stored uncompressed
+    header.compression() = Imf::B44_COMPRESSION;
+    break;
+  case DiskCacheFolder::kCodecEXRZip:
+    header.compression() = Imf::ZIPS_COMPRESSION;
+    break;
+  case DiskCacheFolder::kCodecEXRUncompressed:
+    header.compression() = Imf::NO_COMPRESSION;
+    break;
+  case DiskCacheFolder::kCodecEXRDWAA:
+  default:
+    header.compression() = Imf::DWAA_COMPRESSION;
+    header.insert("dwaCompressionLevel", Imf::FloatAttribute(200.0f));
+    break;
+  }
   header.pixelAspectRatio() = vparam.pixel_aspect_ratio().toDouble();
 
   header.insert("oliveDivider", Imf::IntAttribute(vparam.divider()));
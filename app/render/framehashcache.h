@@ -22,10 +22,13 @@
 #define VIDEORENDERFRAMECACHE_H
 
 #include <QMutex>
+#include <QSemaphore>
+#include <QThreadPool>
 
 #include "common/rational.h"
 #include "common/timerange.h"
 #include "codec/frame.h"
+#include "render/framehashmap.h"
 #include "render/playbackcache.h"
 #include "render/videoparams.h"
 
@@ -61,20 +64,55 @@ public:
   QString CachePathName(const QByteArray &hash) const;
   static QString CachePathName(const QString& cache_path, const QByteArray &hash);
 
-  static bool SaveCacheFrame(const QString& filename, char *data, const VideoParams &vparam, int linesize_bytes);
+  /**
+   * @brief Write a frame to a file
+   *
+   * `codec` is a DiskCacheFolder::Codec.
+   */
+  static bool SaveCacheFrame(const QString& filename, char *data, const VideoParams &vparam, int linesize_bytes, int codec);
   bool SaveCacheFrame(const QByteArray& hash, char *data, const VideoParams &vparam, int linesize_bytes) const;
   bool SaveCacheFrame(const QByteArray& hash, FramePtr frame) const;
   static bool SaveCacheFrame(const QString& cache_path, const QByteArray& hash, char *data, const VideoParams &vparam, int linesize_bytes);
   static bool SaveCacheFrame(const QString& cache_path, const QByteArray& hash, FramePtr frame);
+
+  /**
+   * @brief Queue a frame to be written to the cache on a background I/O thread
+   *
+   * Returns as soon as the frame is queued, only blocking if the write-behind queue is full. Until
+   * the write finishes, LoadCacheFrame() returns this frame as-is. If the write fails, the frame is
+   * reported as deleted so any cache that validated it re-renders it.
+   */
+  static bool SaveCacheFrameAsync(const QString& cache_path, const QByteArray& hash, FramePtr frame);
+
+  /**
+   * @brief Block until every frame queued with SaveCacheFrameAsync() has been written
+   */
+  static void WaitForPendingWrites();
   static FramePtr LoadCacheFrame(const QString& cache_path, const QByteArray& hash);
   FramePtr LoadCacheFrame(const QByteArray& hash) const;
   static FramePtr LoadCacheFrame(const QString& fn);
 
+  /**
+   * @brief Whether a frame with this hash can be loaded from the cache, wherever it's stored
+   */
+  static bool CacheFrameExists(const QString& cache_path, const QByteArray& hash);
+  bool CacheFrameExists(const QByteArray& hash) const;
+
   static QVector<rational> GetFrameListFromTimeRange(TimeRangeList range_list, const rational& timebase);
   QVector<rational> GetFrameListFromTimeRange(const TimeRangeList &range);
   QVector<rational> GetInvalidatedFrames();
   QVector<rational> GetInvalidatedFrames(const TimeRange& intersecting);
 
+  /**
+   * @brief Also saves the hash of every frame, so they don't all need hashing again
+   */
+  virtual void SaveState(QDataStream& s, const QDir& file_dir) override;
+
+  /**
+   * @brief Frames whose hash no longer has a cached frame on disk are left invalidated
+   */
+  virtual bool RestoreState(QDataStream& s, const QDir& file_dir) override;
+
 public slots:
   void SetHash(const olive::rational& time, const QByteArray& hash, const qint64 &job_time, bool frame_exists);
 
@@ -86,17 +124,47 @@ protected:
   virtual void InvalidateEvent(const TimeRange& range) override;
 
 private:
-  QMap<rational, QByteArray> time_hash_map_;
+  FrameHashMap time_hash_map_;
 
   rational timebase_;
 
-  static QMutex currently_saving_frames_mutex_;
-  static QMap<QByteArray, FramePtr> currently_saving_frames_;
-  static const QString kCacheFormatExtension;
+  /**
+   * @brief Frames being saved, split by hash so concurrent saves rarely share a lock
+   */
+  struct SavingShard {
+    QMutex mutex;
+    QMap<QByteArray, FramePtr> frames;
+  };
+
+  static SavingShard& GetSavingShard(const QByteArray& hash);
+
+  static QThreadPool* GetWriteThreadPool();
+
+  static QSemaphore* GetWriteQueueSlots();
+
+  static const int kSavingShardCount;
+  static const int kWriteQueueSize;
+
+  static QString CachePathBase(const QString& cache_path, const QByteArray &hash);
+
+  static QString GetCacheFormatExtension(int codec);
+
+  static bool SaveRawFrame(const QString& filename, char *data, const VideoParams &vparam, int linesize_bytes);
+
+  static FramePtr LoadRawFrame(const QString& filename);
+
+  static FramePtr LoadEXRFrame(const QString& filename);
+
+  static const QString kEXRFormatExtension;
+  static const QString kRawFormatExtension;
+
+  static const int kMaximumOverflowDepth;
 
 private slots:
   void HashDeleted(const QString &s, const QByteArray& hash);
 
+  void HashesDeleted(const QString &s, const QVector<QByteArray>& hashes);
+
   void ProjectInvalidated(Project* p);
 
 };
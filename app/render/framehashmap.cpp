@@ -0,0 +1,274 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framehashmap.h"
+
+#include <algorithm>
+
+namespace olive {
+
+const int FrameHashMap::kMaximumSegments = 64;
+
+QByteArray FrameHashMap::value(const rational &time) const
+{
+  int i = FindSegment(time);
+
+  if (i < 0) {
+    return QByteArray();
+  }
+
+  const Segment& s = segments_.at(i);
+  return s.frames.value(time - s.offset);
+}
+
+void FrameHashMap::insert(const rational &time, const QByteArray &hash)
+{
+  if (segments_.isEmpty()) {
+    Segment s;
+    s.offset = 0;
+    s.frames.insert(time, hash);
+    segments_.append(s);
+    return;
+  }
+
+  // Anything before the first segment becomes part of it, anything between two segments becomes
+  // part of the earlier one
+  int i = qMax(0, FindSegment(time));
+
+  Segment& s = segments_[i];
+  s.frames.insert(time - s.offset, hash);
+}
+
+void FrameHashMap::remove(const rational &time)
+{
+  int i = FindSegment(time);
+
+  if (i < 0) {
+    return;
+  }
+
+  Segment& s = segments_[i];
+  s.frames.remove(time - s.offset);
+
+  if (s.frames.isEmpty()) {
+    segments_.removeAt(i);
+  }
+}
+
+void FrameHashMap::remove(const TimeRange &range)
+{
+  // Offsetting the maximum would overflow, so treat it as "to the end"
+  bool to_end = (range.out() == RATIONAL_MAX);
+
+  int i = qMax(0, FindSegment(range.in()));
+
+  while (i < segments_.size() && (to_end || segments_.at(i).first() < range.out())) {
+    Segment& s = segments_[i];
+
+    auto it = s.frames.lowerBound(range.in() - s.offset);
+
+    if (to_end) {
+      while (it != s.frames.end()) {
+        it = s.frames.erase(it);
+      }
+    } else {
+      rational local_out = range.out() - s.offset;
+
+      while (it != s.frames.end() && it.key() < local_out) {
+        it = s.frames.erase(it);
+      }
+    }
+
+    if (s.frames.isEmpty()) {
+      segments_.removeAt(i);
+    } else {
+      i++;
+    }
+  }
+}
+
+void FrameHashMap::shift(const rational &from, const rational &to)
+{
+  if (from == to) {
+    return;
+  }
+
+  if (to < from) {
+    // This region is being spliced out
+    remove(TimeRange(to, from));
+  }
+
+  SplitAt(from);
+
+  // Every segment is now entirely before or entirely after `from`
+  rational diff = to - from;
+
+  for (int i=segments_.size()-1; i>=0 && segments_.at(i).first() >= from; i--) {
+    segments_[i].offset += diff;
+  }
+
+  if (segments_.size() > kMaximumSegments) {
+    Compact();
+  }
+}
+
+int FrameHashMap::size() const
+{
+  int sz = 0;
+
+  foreach (const Segment& s, segments_) {
+    sz += s.frames.size();
+  }
+
+  return sz;
+}
+
+QList<rational> FrameHashMap::times_with_hash(const QByteArray &hash) const
+{
+  QList<rational> times;
+
+  foreach (const Segment& s, segments_) {
+    for (auto it=s.frames.cbegin(); it!=s.frames.cend(); it++) {
+      if (it.value() == hash) {
+        times.append(it.key() + s.offset);
+      }
+    }
+  }
+
+  return times;
+}
+
+QList<rational> FrameHashMap::times_with_hashes(const QSet<QByteArray> &hashes) const
+{
+  QList<rational> times;
+
+  foreach (const Segment& s, segments_) {
+    for (auto it=s.frames.cbegin(); it!=s.frames.cend(); it++) {
+      if (hashes.contains(it.value())) {
+        times.append(it.key() + s.offset);
+      }
+    }
+  }
+
+  return times;
+}
+
+QMap<rational, QByteArray> FrameHashMap::ToMap() const
+{
+  QMap<rational, QByteArray> map;
+
+  foreach (const Segment& s, segments_) {
+    for (auto it=s.frames.cbegin(); it!=s.frames.cend(); it++) {
+      map.insert(it.key() + s.offset, it.value());
+    }
+  }
+
+  return map;
+}
+
+int FrameHashMap::FindSegment(const rational &time) const
+{
+  auto it = std::upper_bound(segments_.cbegin(), segments_.cend(), time, [](const rational& t, const Segment& s){
+    return t < s.first();
+  });
+
+  return int(it - segments_.cbegin()) - 1;
+}
+
+void FrameHashMap::SplitAt(const rational &time)
+{
+  int i = FindSegment(time);
+
+  if (i < 0 || segments_.at(i).first() == time || segments_.at(i).last() < time) {
+    // Already split here
+    return;
+  }
+
+  Segment& s = segments_[i];
+  rational local = time - s.offset;
+  auto split = s.frames.lowerBound(local);
+
+  // Frames are roughly evenly spaced, so the shorter side in time is the cheaper one to move
+  bool move_head = (local - s.frames.firstKey() < s.frames.lastKey() - local);
+
+  Segment moved;
+  moved.offset = s.offset;
+
+  if (move_head) {
+    for (auto it=s.frames.begin(); it!=split; ) {
+      moved.frames.insert(it.key(), it.value());
+      it = s.frames.erase(it);
+    }
+
+    segments_.insert(i, moved);
+  } else {
+    for (auto it=split; it!=s.frames.end(); ) {
+      moved.frames.insert(it.key(), it.value());
+      it = s.frames.erase(it);
+    }
+
+    segments_.insert(i + 1, moved);
+  }
+}
+
+void FrameHashMap::MergeSegments(int src, int dst)
+{
+  const Segment& from = segments_.at(src);
+  Segment& into = segments_[dst];
+
+  rational diff = from.offset - into.offset;
+
+  for (auto it=from.frames.cbegin(); it!=from.frames.cend(); it++) {
+    into.frames.insert(it.key() + diff, it.value());
+  }
+
+  segments_.removeAt(src);
+}
+
+void FrameHashMap::Compact()
+{
+  // Repeatedly fold the smallest segment into its smaller neighbor, so each merge moves as few
+  // frames as possible
+  while (segments_.size() > kMaximumSegments / 2) {
+    int smallest = 0;
+
+    for (int i=1; i<segments_.size(); i++) {
+      if (segments_.at(i).frames.size() < segments_.at(smallest).frames.size()) {
+        smallest = i;
+      }
+    }
+
+    int neighbor;
+
+    if (smallest == 0) {
+      neighbor = 1;
+    } else if (smallest == segments_.size() - 1) {
+      neighbor = smallest - 1;
+    } else if (segments_.at(smallest - 1).frames.size() < segments_.at(smallest + 1).frames.size()) {
+      neighbor = smallest - 1;
+    } else {
+      neighbor = smallest + 1;
+    }
+
+    MergeSegments(smallest, neighbor);
+  }
+}
+
+}
@@ -0,0 +1,134 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMEHASHMAP_H
+#define FRAMEHASHMAP_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QSet>
+#include <QVector>
+
+#include "common/rational.h"
+#include "common/timerange.h"
+
+namespace olive {
+
+/**
+ * @brief Map of frame times to hashes that can shift everything after a time cheaply
+ *
+ * Frames are stored in a short list of segments, each holding its times relative to an offset.
+ * Shifting only has to split the segment `from` falls in (moving whichever side of it is smaller)
+ * and add to the offsets of the segments after it, so rippling at the head of a long sequence
+ * doesn't touch every frame after the edit.
+ *
+ * Segments are merged back together once there are more than kMaximumSegments of them.
+ */
+class FrameHashMap
+{
+public:
+  FrameHashMap() = default;
+
+  QByteArray value(const rational& time) const;
+
+  void insert(const rational& time, const QByteArray& hash);
+
+  void remove(const rational& time);
+
+  /**
+   * @brief Remove every frame from `range.in()` up to but not including `range.out()`
+   */
+  void remove(const TimeRange& range);
+
+  /**
+   * @brief Move every frame at or after `from` by `to - from`
+   *
+   * If `to` is before `from`, frames from `to` up to `from` are removed first.
+   */
+  void shift(const rational& from, const rational& to);
+
+  void clear()
+  {
+    segments_.clear();
+  }
+
+  bool isEmpty() const
+  {
+    return segments_.isEmpty();
+  }
+
+  int size() const;
+
+  /**
+   * @brief Every time that has this hash, in order
+   */
+  QList<rational> times_with_hash(const QByteArray& hash) const;
+
+  /**
+   * @brief Every time that has any of these hashes, in order
+   *
+   * Only goes over the map once, however many hashes there are.
+   */
+  QList<rational> times_with_hashes(const QSet<QByteArray>& hashes) const;
+
+  QMap<rational, QByteArray> ToMap() const;
+
+  static const int kMaximumSegments;
+
+private:
+  struct Segment
+  {
+    rational offset;
+
+    // Keyed by time minus offset, never empty
+    QMap<rational, QByteArray> frames;
+
+    rational first() const
+    {
+      return frames.firstKey() + offset;
+    }
+
+    rational last() const
+    {
+      return frames.lastKey() + offset;
+    }
+  };
+
+  /**
+   * @brief Index of the last segment starting at or before `time`, or -1 if there isn't one
+   */
+  int FindSegment(const rational& time) const;
+
+  /**
+   * @brief Split the segment containing `time` so no segment has frames either side of it
+   */
+  void SplitAt(const rational& time);
+
+  void MergeSegments(int src, int dst);
+
+  void Compact();
+
+  QVector<Segment> segments_;
+
+};
+
+}
+
+#endif // FRAMEHASHMAP_H
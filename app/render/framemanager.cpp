@@ -22,11 +22,23 @@
 
 #include <QDateTime>
 #include <QDebug>
+#include <QtAlgorithms>
+
+#include "memorygovernor.h"
 
 namespace olive {
 
 FrameManager* FrameManager::instance_ = nullptr;
 const int FrameManager::kFrameLifetime = 5000;
+const int FrameManager::kMinimumClassSize = 4096;
+const qint64 FrameManager::kMagazineSize = 64 * 1024 * 1024;
+const int FrameManager::kBufferAlignment = 64;
+QThreadStorage<FrameManager::Magazine*> FrameManager::magazines_;
+std::atomic<qint64> FrameManager::allocations_(0);
+std::atomic<qint64> FrameManager::thread_hits_(0);
+std::atomic<qint64> FrameManager::shared_hits_(0);
+std::atomic<qint64> FrameManager::allocated_bytes_(0);
+std::atomic<qint64> FrameManager::pooled_bytes_(0);
 
 void FrameManager::CreateInstance()
 {
@@ -49,7 +61,8 @@ char *FrameManager::Allocate(int size)
   if (instance()) {
     return instance()->AllocateFromPool(size);
   } else {
-    return new char[size];
+    // Still round up, this buffer may be deallocated into the pool if the manager exists by then
+    return AllocateAligned(GetClassSize(size));
   }
 }
 
@@ -58,8 +71,45 @@ void FrameManager::Deallocate(int size, char *buffer)
   if (instance()) {
     instance()->DeallocateToPool(size, buffer);
   } else {
-    delete [] buffer;
+    FreeAligned(buffer);
+  }
+}
+
+char *FrameManager::AllocateAligned(int size)
+{
+  // Frame rows are padded to this alignment too, so every row of a pooled frame starts aligned
+  return static_cast<char*>(qMallocAligned(size, kBufferAlignment));
+}
+
+void FrameManager::FreeAligned(char *buffer)
+{
+  qFreeAligned(buffer);
+}
+
+FrameManager::Stats FrameManager::GetStats()
+{
+  Stats s;
+
+  s.allocations = allocations_;
+  s.thread_hits = thread_hits_;
+  s.shared_hits = shared_hits_;
+  s.allocated_bytes = allocated_bytes_;
+  s.pooled_bytes = pooled_bytes_;
+
+  return s;
+}
+
+int FrameManager::GetClassSize(int size)
+{
+  if (size <= kMinimumClassSize) {
+    return kMinimumClassSize;
   }
+
+  // Split each power of two into four classes
+  int log2 = 31 - qCountLeadingZeroBits(quint32(size - 1));
+  int step = 1 << (log2 - 2);
+
+  return (size + step - 1) & ~(step - 1);
 }
 
 FrameManager::FrameManager()
@@ -67,33 +117,104 @@ FrameManager::FrameManager()
   clear_timer_.setInterval(kFrameLifetime);
   connect(&clear_timer_, &QTimer::timeout, this, &FrameManager::GarbageCollection);
   clear_timer_.start();
+
+  if (MemoryGovernor::instance()) {
+    connect(MemoryGovernor::instance(), &MemoryGovernor::MemoryPressure, this, &FrameManager::ReleasePool);
+  }
+}
+
+FrameManager::Magazine *FrameManager::GetMagazine()
+{
+  if (!magazines_.hasLocalData()) {
+    magazines_.setLocalData(new Magazine());
+  }
+
+  return magazines_.localData();
+}
+
+FrameManager::Magazine::~Magazine()
+{
+  // Thread is exiting, nothing else is going to re-use these
+  for (auto it=buffers.begin(); it!=buffers.end(); it++) {
+    foreach (char* b, it->second) {
+      FreeAligned(b);
+    }
+
+    allocated_bytes_ -= qint64(it->first) * it->second.size();
+    pooled_bytes_ -= qint64(it->first) * it->second.size();
+  }
 }
 
 char *FrameManager::AllocateFromPool(int size)
 {
-  QMutexLocker locker(&mutex_);
+  int class_size = GetClassSize(size);
 
-  std::list<Buffer>& buffer_list = pool_[size];
-  char* buf = nullptr;
+  allocations_++;
 
-  if (buffer_list.empty()) {
-    buf = new char[size];
-  } else {
-    // Take this buffer from the list
-    buf = buffer_list.front().data;
-    buffer_list.pop_front();
+  // Try this thread's own buffers first, they need no lock and are most likely still in its cache
+  Magazine* m = GetMagazine();
+  std::vector<char*>& local = m->buffers[class_size];
+
+  if (!local.empty()) {
+    char* buf = local.back();
+    local.pop_back();
+    m->bytes -= class_size;
+    pooled_bytes_ -= class_size;
+    thread_hits_++;
+    return buf;
+  }
+
+  {
+    QMutexLocker locker(&mutex_);
+
+    std::list<Buffer>& buffer_list = pool_[class_size];
+
+    if (!buffer_list.empty()) {
+      // Take the most recently returned buffer, the oldest ones are left to be garbage collected
+      char* buf = buffer_list.back().data;
+      buffer_list.pop_back();
+      pooled_bytes_ -= class_size;
+      shared_hits_++;
+      return buf;
+    }
   }
 
-  return buf;
+  allocated_bytes_ += class_size;
+
+  return AllocateAligned(class_size);
 }
 
 void FrameManager::DeallocateToPool(int size, char *buffer)
 {
+  int class_size = GetClassSize(size);
+
+  pooled_bytes_ += class_size;
+
+  Magazine* m = GetMagazine();
+
+  if (m->bytes + class_size <= kMagazineSize) {
+    m->buffers[class_size].push_back(buffer);
+    m->bytes += class_size;
+    return;
+  }
+
+  // This thread is holding as much as it's allowed to, return its buffers of this size to the
+  // shared pool together so the lock is only taken once
+  std::vector<char*>& local = m->buffers[class_size];
+
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+
   QMutexLocker locker(&mutex_);
 
-  std::list<Buffer>& buffer_list = pool_[size];
+  std::list<Buffer>& buffer_list = pool_[class_size];
 
-  buffer_list.push_back({QDateTime::currentMSecsSinceEpoch(), buffer});
+  foreach (char* b, local) {
+    buffer_list.push_back({now, b});
+  }
+  buffer_list.push_back({now, buffer});
+
+  m->bytes -= qint64(class_size) * local.size();
+  local.clear();
 }
 
 void FrameManager::GarbageCollection()
@@ -106,12 +227,33 @@ void FrameManager::GarbageCollection()
     std::list<Buffer>& list = it->second;
 
     while (list.size() > 0 && list.front().time < min_life) {
-      delete [] list.front().data;
+      FreeAligned(list.front().data);
       list.pop_front();
+
+      allocated_bytes_ -= it->first;
+      pooled_bytes_ -= it->first;
     }
   }
 }
 
+void FrameManager::ReleasePool()
+{
+  QMutexLocker locker(&mutex_);
+
+  for (auto it=pool_.begin(); it!=pool_.end(); it++) {
+    std::list<Buffer>& list = it->second;
+
+    for (const Buffer& b : list) {
+      FreeAligned(b.data);
+    }
+
+    allocated_bytes_ -= qint64(it->first) * list.size();
+    pooled_bytes_ -= qint64(it->first) * list.size();
+
+    list.clear();
+  }
+}
+
 FrameManager::~FrameManager()
 {
   QMutexLocker locker(&mutex_);
@@ -119,8 +261,11 @@ FrameManager::~FrameManager()
   for (auto it=pool_.begin(); it!=pool_.end(); it++) {
     std::list<Buffer>& list = it->second;
     for (auto jt=list.begin(); jt!=list.end(); jt++) {
-      delete [] (*jt).data;
+      FreeAligned((*jt).data);
     }
+
+    allocated_bytes_ -= qint64(it->first) * list.size();
+    pooled_bytes_ -= qint64(it->first) * list.size();
   }
 
   pool_.clear();
@@ -21,8 +21,10 @@
 #ifndef FRAMEMANAGER_H
 #define FRAMEMANAGER_H
 
+#include <atomic>
 #include <QMutex>
 #include <QObject>
+#include <QThreadStorage>
 #include <QTimer>
 
 namespace olive {
@@ -41,6 +43,34 @@ public:
 
   static void Deallocate(int size, char* buffer);
 
+  struct Stats {
+    /// Number of calls to Allocate()
+    qint64 allocations;
+
+    /// Allocations served from the calling thread's own buffers
+    qint64 thread_hits;
+
+    /// Allocations served from the pool shared between threads
+    qint64 shared_hits;
+
+    /// Bytes currently allocated from the system, whether in use or pooled
+    qint64 allocated_bytes;
+
+    /// Bytes currently pooled for re-use, in either a thread's buffers or the shared pool
+    qint64 pooled_bytes;
+  };
+
+  static Stats GetStats();
+
+  /**
+   * @brief Get the size actually allocated for a buffer of `size` bytes
+   *
+   * Buffers are pooled by size class rather than exact size, so frames that differ slightly in
+   * size (e.g. at different dividers) can still re-use each other's buffers. Classes are spaced
+   * four to each power of two, so no more than a quarter of a buffer is ever wasted.
+   */
+  static int GetClassSize(int size);
+
 private:
   FrameManager();
 
@@ -66,25 +96,70 @@ private:
    */
   void DeallocateToPool(int size, char* buffer);
 
+  static char* AllocateAligned(int size);
+
+  static void FreeAligned(char* buffer);
+
   static FrameManager* instance_;
 
   static const int kFrameLifetime;
 
+  static const int kMinimumClassSize;
+
+  static const qint64 kMagazineSize;
+
+  static const int kBufferAlignment;
+
   struct Buffer
   {
     qint64 time;
     char* data;
   };
 
+  /**
+   * @brief Buffers a single thread has freed and can re-use without taking any lock
+   *
+   * Besides avoiding contention, this keeps a buffer on the thread that last used it, which on a
+   * first-touch NUMA system also keeps it on that thread's node.
+   */
+  struct Magazine
+  {
+    Magazine() :
+      bytes(0)
+    {
+    }
+
+    ~Magazine();
+
+    std::map< int, std::vector<char*> > buffers;
+
+    qint64 bytes;
+  };
+
+  static Magazine* GetMagazine();
+
+  static QThreadStorage<Magazine*> magazines_;
+
   std::map< int, std::list<Buffer> > pool_;
 
   QMutex mutex_;
 
   QTimer clear_timer_;
 
+  static std::atomic<qint64> allocations_;
+  static std::atomic<qint64> thread_hits_;
+  static std::atomic<qint64> shared_hits_;
+  static std::atomic<qint64> allocated_bytes_;
+  static std::atomic<qint64> pooled_bytes_;
+
 private slots:
   void GarbageCollection();
 
+  /**
+   * @brief Free every buffer in the shared pool, regardless of age
+   */
+  void ReleasePool();
+
 };
 
 }
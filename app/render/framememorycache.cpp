@@ -0,0 +1,114 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framememorycache.h"
+
+namespace olive {
+
+FrameMemoryCache::FrameMemoryCache() :
+  current_size_(0),
+  maximum_size_(0)
+{
+}
+
+FramePtr FrameMemoryCache::Get(const QByteArray &hash)
+{
+  QMutexLocker locker(&mutex_);
+
+  auto it = index_.find(hash);
+  if (it == index_.end()) {
+    return nullptr;
+  }
+
+  // Move to front since it was just used
+  entries_.splice(entries_.begin(), entries_, it.value());
+
+  return entries_.front().frame;
+}
+
+void FrameMemoryCache::Insert(const QByteArray &hash, FramePtr frame)
+{
+  if (hash.isEmpty() || !frame) {
+    return;
+  }
+
+  qint64 sz = frame->allocated_size();
+
+  QMutexLocker locker(&mutex_);
+
+  if (sz > maximum_size_) {
+    // Would never fit, don't bother
+    return;
+  }
+
+  auto existing = index_.find(hash);
+  if (existing != index_.end()) {
+    // Same hash means same frame, just refresh its position
+    entries_.splice(entries_.begin(), entries_, existing.value());
+    return;
+  }
+
+  entries_.push_front({hash, frame, sz});
+  index_.insert(hash, entries_.begin());
+  current_size_ += sz;
+
+  // Frames are freed once the lock is released
+  EntryList evicted = EvictToFit();
+  locker.unlock();
+}
+
+void FrameMemoryCache::Clear()
+{
+  QMutexLocker locker(&mutex_);
+
+  EntryList evicted;
+  evicted.swap(entries_);
+  index_.clear();
+  current_size_ = 0;
+
+  locker.unlock();
+}
+
+void FrameMemoryCache::SetMaximumSize(qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+
+  maximum_size_ = bytes;
+
+  EntryList evicted = EvictToFit();
+  locker.unlock();
+}
+
+FrameMemoryCache::EntryList FrameMemoryCache::EvictToFit()
+{
+  EntryList evicted;
+
+  while (current_size_ > maximum_size_ && !entries_.empty()) {
+    const Entry& e = entries_.back();
+
+    current_size_ -= e.size;
+    index_.remove(e.hash);
+    evicted.splice(evicted.end(), entries_, std::prev(entries_.end()));
+  }
+
+  return evicted;
+}
+
+}
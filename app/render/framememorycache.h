@@ -0,0 +1,87 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMEMEMORYCACHE_H
+#define FRAMEMEMORYCACHE_H
+
+#include <list>
+#include <QHash>
+#include <QMutex>
+
+#include "codec/frame.h"
+
+namespace olive {
+
+/**
+ * @brief Memory tier in front of the disk cache
+ *
+ * Holds recently saved and loaded cache frames keyed by their hash, so frames that are played back
+ * repeatedly don't have to be read and decoded from disk each time. Since hashes are derived from
+ * a frame's content, the same frame is shared between every cache folder it's in. Least recently
+ * used frames are released once the budget is exceeded.
+ *
+ * This class is thread-safe.
+ */
+class FrameMemoryCache
+{
+public:
+  FrameMemoryCache();
+
+  /**
+   * @brief Retrieve the frame for a hash, or nullptr if it isn't held in memory
+   */
+  FramePtr Get(const QByteArray& hash);
+
+  void Insert(const QByteArray& hash, FramePtr frame);
+
+  void Clear();
+
+  /**
+   * @brief Set the budget in bytes, evicting frames if necessary
+   */
+  void SetMaximumSize(qint64 bytes);
+
+private:
+  struct Entry {
+    QByteArray hash;
+    FramePtr frame;
+    qint64 size;
+  };
+
+  using EntryList = std::list<Entry>;
+
+  EntryList EvictToFit();
+
+  // Most recently used entries are at the front
+  EntryList entries_;
+
+  QHash<QByteArray, EntryList::iterator> index_;
+
+  qint64 current_size_;
+
+  qint64 maximum_size_;
+
+  QMutex mutex_;
+
+};
+
+}
+
+#endif // FRAMEMEMORYCACHE_H
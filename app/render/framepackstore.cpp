@@ -0,0 +1,361 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framepackstore.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+
+namespace olive {
+
+QMutex FramePackStore::stores_lock_;
+QHash<QString, FramePackStore*> FramePackStore::stores_;
+
+const qint64 FramePackStore::kSegmentSize = Q_INT64_C(1073741824); // 1 GB
+
+const qint32 FramePackStore::kIndexVersion = 1;
+
+FramePackStore *FramePackStore::Get(const QString &cache_path)
+{
+  QMutexLocker locker(&stores_lock_);
+
+  FramePackStore* store = stores_.value(cache_path);
+
+  if (!store) {
+    store = new FramePackStore(cache_path);
+    stores_.insert(cache_path, store);
+  }
+
+  return store;
+}
+
+void FramePackStore::CloseAll()
+{
+  QMutexLocker locker(&stores_lock_);
+
+  qDeleteAll(stores_);
+  stores_.clear();
+}
+
+FramePackStore::FramePackStore(const QString &cache_path) :
+  segment_count_(2),
+  current_segment_(0),
+  current_offset_(0)
+{
+  QDir dir(QDir(cache_path).filePath(QStringLiteral("pack")));
+  dir.mkpath(QStringLiteral("."));
+  path_ = dir.path();
+
+  // Try to load index from last session
+  QFile index_file(dir.filePath(QStringLiteral("index")));
+
+  if (index_file.open(QFile::ReadOnly)) {
+    QDataStream ds(&index_file);
+
+    qint32 version;
+    ds >> version;
+
+    if (version == kIndexVersion) {
+      ds >> segment_count_;
+      ds >> current_segment_;
+      ds >> current_offset_;
+
+      while (!index_file.atEnd()) {
+        QByteArray hash;
+        Entry e;
+
+        ds >> hash;
+        ds >> e.segment >> e.offset >> e.width >> e.height >> e.format >> e.channel_count
+           >> e.divider >> e.pixel_aspect_num >> e.pixel_aspect_den >> e.linesize_bytes;
+
+        // Frames are only valid while their segment still exists
+        if (QFileInfo::exists(GetSegmentFilename(e.segment))) {
+          index_.insert(hash, e);
+        }
+      }
+    }
+
+    index_file.close();
+  }
+
+  segments_.resize(segment_count_);
+}
+
+FramePackStore::~FramePackStore()
+{
+  SaveIndex();
+
+  CloseSegments();
+}
+
+bool FramePackStore::Write(const QByteArray &hash, const char *data, const VideoParams &params, int linesize_bytes, QVector<QByteArray> *evicted)
+{
+  qint64 sz = qint64(linesize_bytes) * params.effective_height();
+
+  if (sz > kSegmentSize) {
+    qWarning() << "Frame too large for pack store:" << sz;
+    return false;
+  }
+
+  QMutexLocker locker(&mutex_);
+
+  if (current_offset_ + sz > kSegmentSize) {
+    // Move onto the next segment in the ring, reclaiming whatever it held
+    current_segment_ = (current_segment_ + 1) % segment_count_;
+    current_offset_ = 0;
+
+    QVector<QByteArray> reclaimed = ReclaimSegment(current_segment_);
+
+    if (evicted) {
+      evicted->append(reclaimed);
+    }
+  }
+
+  uchar* map = MapSegment(current_segment_);
+
+  if (!map) {
+    return false;
+  }
+
+  memcpy(map + current_offset_, data, sz);
+
+  Entry e;
+  e.segment = current_segment_;
+  e.offset = current_offset_;
+  e.width = params.effective_width();
+  e.height = params.effective_height();
+  e.format = params.format();
+  e.channel_count = params.channel_count();
+  e.divider = params.divider();
+  e.pixel_aspect_num = params.pixel_aspect_ratio().numerator();
+  e.pixel_aspect_den = params.pixel_aspect_ratio().denominator();
+  e.linesize_bytes = linesize_bytes;
+  index_.insert(hash, e);
+
+  current_offset_ += sz;
+
+  return true;
+}
+
+FramePtr FramePackStore::Read(const QByteArray &hash)
+{
+  QMutexLocker locker(&mutex_);
+
+  auto it = index_.constFind(hash);
+
+  if (it == index_.constEnd()) {
+    return nullptr;
+  }
+
+  const Entry& e = it.value();
+
+  uchar* map = MapSegment(e.segment);
+
+  if (!map) {
+    return nullptr;
+  }
+
+  int div = qMax(1, int(e.divider));
+
+  FramePtr frame = Frame::Create();
+  frame->set_video_params(VideoParams(e.width * div,
+                                      e.height * div,
+                                      static_cast<VideoParams::Format>(e.format),
+                                      e.channel_count,
+                                      rational(e.pixel_aspect_num, e.pixel_aspect_den),
+                                      VideoParams::kInterlaceNone,
+                                      div));
+  frame->allocate();
+
+  const uchar* src = map + e.offset;
+
+  if (e.linesize_bytes == frame->linesize_bytes()) {
+    memcpy(frame->data(), src, frame->allocated_size());
+  } else {
+    int copy_sz = qMin(e.linesize_bytes, frame->linesize_bytes());
+
+    for (int y=0; y<e.height; y++) {
+      memcpy(frame->data() + y * frame->linesize_bytes(), src + y * e.linesize_bytes, copy_sz);
+    }
+  }
+
+  return frame;
+}
+
+bool FramePackStore::Contains(const QByteArray &hash)
+{
+  QMutexLocker locker(&mutex_);
+
+  return index_.contains(hash);
+}
+
+QVector<QByteArray> FramePackStore::Clear()
+{
+  QMutexLocker locker(&mutex_);
+
+  QVector<QByteArray> removed = index_.keys().toVector();
+
+  index_.clear();
+  current_segment_ = 0;
+  current_offset_ = 0;
+
+  // Drop segment files entirely so clearing actually frees the disk space
+  CloseSegments();
+  for (int i=0; i<segment_count_; i++) {
+    QFile::remove(GetSegmentFilename(i));
+  }
+
+  return removed;
+}
+
+QVector<QByteArray> FramePackStore::SetLimit(qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+
+  QVector<QByteArray> dropped;
+
+  int count = qMax(2, int(bytes / kSegmentSize));
+
+  if (count == segment_count_) {
+    return dropped;
+  }
+
+  // Segments past the new end of the ring are dropped
+  for (int i=count; i<segment_count_; i++) {
+    dropped.append(ReclaimSegment(i));
+
+    if (segments_.at(i).file) {
+      segments_.at(i).file->unmap(segments_.at(i).map);
+      delete segments_.at(i).file;
+    }
+
+    QFile::remove(GetSegmentFilename(i));
+  }
+
+  segments_.resize(count);
+  segment_count_ = count;
+
+  if (current_segment_ >= segment_count_) {
+    current_segment_ = 0;
+    current_offset_ = 0;
+    dropped.append(ReclaimSegment(0));
+  }
+
+  return dropped;
+}
+
+void FramePackStore::SaveIndex()
+{
+  QMutexLocker locker(&mutex_);
+
+  QFile index_file(QDir(path_).filePath(QStringLiteral("index")));
+
+  if (index_file.open(QFile::WriteOnly)) {
+    QDataStream ds(&index_file);
+
+    ds << kIndexVersion;
+    ds << segment_count_;
+    ds << current_segment_;
+    ds << current_offset_;
+
+    for (auto it=index_.cbegin(); it!=index_.cend(); it++) {
+      const Entry& e = it.value();
+
+      ds << it.key();
+      ds << e.segment << e.offset << e.width << e.height << e.format << e.channel_count
+         << e.divider << e.pixel_aspect_num << e.pixel_aspect_den << e.linesize_bytes;
+    }
+
+    index_file.close();
+  } else {
+    qWarning() << "Failed to write pack store index:" << index_file.fileName();
+  }
+}
+
+uchar *FramePackStore::MapSegment(int index)
+{
+  Segment& s = segments_[index];
+
+  if (!s.file) {
+    QFile* file = new QFile(GetSegmentFilename(index));
+
+    // Preallocate the whole segment up front so writing never has to grow the file
+    if (!file->open(QFile::ReadWrite)
+        || (file->size() != kSegmentSize && !file->resize(kSegmentSize))) {
+      qWarning() << "Failed to open pack segment" << file->fileName();
+      delete file;
+      return nullptr;
+    }
+
+    uchar* map = file->map(0, kSegmentSize);
+
+    if (!map) {
+      qWarning() << "Failed to map pack segment" << file->fileName();
+      delete file;
+      return nullptr;
+    }
+
+    s.file = file;
+    s.map = map;
+  }
+
+  return s.map;
+}
+
+void FramePackStore::CloseSegments()
+{
+  for (int i=0; i<segments_.size(); i++) {
+    Segment& s = segments_[i];
+
+    if (s.file) {
+      s.file->unmap(s.map);
+      delete s.file;
+      s.file = nullptr;
+      s.map = nullptr;
+    }
+  }
+}
+
+QString FramePackStore::GetSegmentFilename(int index) const
+{
+  return QDir(path_).filePath(QStringLiteral("segment%1").arg(index));
+}
+
+QVector<QByteArray> FramePackStore::ReclaimSegment(int index)
+{
+  QVector<QByteArray> reclaimed;
+
+  auto it = index_.begin();
+
+  while (it != index_.end()) {
+    if (it->segment == index) {
+      reclaimed.append(it.key());
+      it = index_.erase(it);
+    } else {
+      it++;
+    }
+  }
+
+  return reclaimed;
+}
+
+}
@@ -0,0 +1,138 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMEPACKSTORE_H
+#define FRAMEPACKSTORE_H
+
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include "codec/frame.h"
+
+namespace olive {
+
+/**
+ * @brief Stores cache frames packed into a ring of large, memory-mapped segment files
+ *
+ * Storing one file per frame means a long precache creates a huge number of small files, and on
+ * some filesystems (especially network shares) the metadata overhead dominates. Instead, frames are
+ * appended to preallocated segment files and found through an in-memory hash index. When the store
+ * is full, the oldest segment is reclaimed as a whole rather than deleting frames one at a time.
+ *
+ * One store exists per cache folder, retrieved with Get(). All functions are thread-safe.
+ */
+class FramePackStore
+{
+public:
+  static FramePackStore* Get(const QString& cache_path);
+
+  /**
+   * @brief Save all open stores' indexes and close them
+   */
+  static void CloseAll();
+
+  /**
+   * @brief Write a frame, replacing any existing one with the same hash
+   *
+   * Hashes whose frames were lost to reclaim a segment are appended to `evicted`.
+   */
+  bool Write(const QByteArray& hash, const char* data, const VideoParams& params, int linesize_bytes, QVector<QByteArray>* evicted);
+
+  /**
+   * @brief Copy a frame out of the store, or return nullptr if it doesn't contain this hash
+   */
+  FramePtr Read(const QByteArray& hash);
+
+  bool Contains(const QByteArray& hash);
+
+  /**
+   * @brief Remove every frame, returning the hashes that were removed
+   */
+  QVector<QByteArray> Clear();
+
+  /**
+   * @brief Set the maximum number of bytes this store can use on disk
+   *
+   * Returns the hashes of any frames dropped because they no longer fit.
+   */
+  QVector<QByteArray> SetLimit(qint64 bytes);
+
+  void SaveIndex();
+
+  static const qint64 kSegmentSize;
+
+private:
+  FramePackStore(const QString& cache_path);
+
+  ~FramePackStore();
+
+  struct Entry {
+    int segment;
+    qint64 offset;
+    qint32 width;
+    qint32 height;
+    qint32 format;
+    qint32 channel_count;
+    qint32 divider;
+    qint32 pixel_aspect_num;
+    qint32 pixel_aspect_den;
+    qint32 linesize_bytes;
+  };
+
+  struct Segment {
+    QFile* file = nullptr;
+    uchar* map = nullptr;
+  };
+
+  uchar* MapSegment(int index);
+
+  void CloseSegments();
+
+  QString GetSegmentFilename(int index) const;
+
+  QVector<QByteArray> ReclaimSegment(int index);
+
+  QString path_;
+
+  QMutex mutex_;
+
+  QHash<QByteArray, Entry> index_;
+
+  QVector<Segment> segments_;
+
+  int segment_count_;
+
+  int current_segment_;
+
+  qint64 current_offset_;
+
+  static QMutex stores_lock_;
+
+  static QHash<QString, FramePackStore*> stores_;
+
+  static const qint32 kIndexVersion;
+
+};
+
+}
+
+#endif // FRAMEPACKSTORE_H
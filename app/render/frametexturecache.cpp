@@ -0,0 +1,163 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "frametexturecache.h"
+
+#include "common/metrics.h"
+
+namespace olive {
+
+namespace {
+
+struct FrameTextureCacheMetrics {
+  Metric* bytes = MetricsRegistry::Gauge(QStringLiteral("olive_texture_cache_bytes"),
+                                         QStringLiteral("VRAM used by frames kept resident on the GPU"));
+
+  Metric* limit = MetricsRegistry::Gauge(QStringLiteral("olive_texture_cache_limit_bytes"),
+                                         QStringLiteral("VRAM budget for frames kept resident on the GPU"));
+
+  Metric* entries = MetricsRegistry::Gauge(QStringLiteral("olive_texture_cache_frames"),
+                                           QStringLiteral("Frames kept resident on the GPU"));
+
+  Metric* hits = MetricsRegistry::Counter(QStringLiteral("olive_texture_cache_hits_total"),
+                                          QStringLiteral("Frames found resident on the GPU"));
+
+  Metric* misses = MetricsRegistry::Counter(QStringLiteral("olive_texture_cache_misses_total"),
+                                            QStringLiteral("Frames looked up that weren't resident on the GPU"));
+};
+
+FrameTextureCacheMetrics* GetMetrics()
+{
+  static FrameTextureCacheMetrics metrics;
+  return &metrics;
+}
+
+}
+
+FrameTextureCache::FrameTextureCache() :
+  current_size_(0),
+  maximum_size_(0)
+{
+}
+
+TexturePtr FrameTextureCache::Get(const QByteArray &hash)
+{
+  QMutexLocker locker(&mutex_);
+
+  auto it = index_.find(hash);
+  if (it == index_.end()) {
+    GetMetrics()->misses->Increment();
+    return nullptr;
+  }
+
+  GetMetrics()->hits->Increment();
+
+  // Move to front since it was just used
+  entries_.splice(entries_.begin(), entries_, it.value());
+
+  return entries_.front().texture;
+}
+
+void FrameTextureCache::Insert(const QByteArray &hash, TexturePtr texture)
+{
+  if (hash.isEmpty() || !texture || texture->IsDummy()) {
+    return;
+  }
+
+  qint64 sz = GetTextureSize(texture.get());
+
+  QMutexLocker locker(&mutex_);
+
+  if (sz > maximum_size_) {
+    // Would never fit, don't bother
+    return;
+  }
+
+  auto existing = index_.find(hash);
+  if (existing != index_.end()) {
+    // Same hash means same image, just refresh its position
+    entries_.splice(entries_.begin(), entries_, existing.value());
+    return;
+  }
+
+  entries_.push_front({hash, texture, sz});
+  index_.insert(hash, entries_.begin());
+  current_size_ += sz;
+
+  // Textures are destroyed once the lock is released, since freeing them may have to wait on the
+  // render thread
+  EntryList evicted = EvictToFit();
+  PublishMetrics();
+  locker.unlock();
+}
+
+void FrameTextureCache::Clear()
+{
+  QMutexLocker locker(&mutex_);
+
+  EntryList evicted;
+  evicted.swap(entries_);
+  index_.clear();
+  current_size_ = 0;
+  PublishMetrics();
+
+  locker.unlock();
+}
+
+void FrameTextureCache::SetMaximumSize(qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+
+  maximum_size_ = bytes;
+
+  EntryList evicted = EvictToFit();
+  PublishMetrics();
+  locker.unlock();
+}
+
+qint64 FrameTextureCache::GetTextureSize(const Texture *texture)
+{
+  return qint64(texture->width()) * qint64(texture->height())
+      * VideoParams::GetBytesPerPixel(texture->format(), texture->channel_count());
+}
+
+FrameTextureCache::EntryList FrameTextureCache::EvictToFit()
+{
+  EntryList evicted;
+
+  while (current_size_ > maximum_size_ && !entries_.empty()) {
+    const Entry& e = entries_.back();
+
+    current_size_ -= e.size;
+    index_.remove(e.hash);
+    evicted.splice(evicted.end(), entries_, std::prev(entries_.end()));
+  }
+
+  return evicted;
+}
+
+void FrameTextureCache::PublishMetrics()
+{
+  GetMetrics()->bytes->Set(current_size_);
+  GetMetrics()->limit->Set(maximum_size_);
+  GetMetrics()->entries->Set(qint64(entries_.size()));
+}
+
+}
@@ -0,0 +1,94 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMETEXTURECACHE_H
+#define FRAMETEXTURECACHE_H
+
+#include <list>
+#include <QHash>
+#include <QMutex>
+
+#include "render/texture.h"
+
+namespace olive {
+
+/**
+ * @brief GPU-resident tier in front of FrameHashCache's disk frames
+ *
+ * Holds recently rendered frames as textures keyed by the same hash FrameHashCache uses, so that
+ * playback over cached ranges can skip the disk read, EXR decode and re-upload entirely. Since a
+ * hash always refers to the same image, entries never need invalidating; the least recently used
+ * ones are simply released once the VRAM budget is exceeded.
+ *
+ * This class is thread-safe.
+ */
+class FrameTextureCache
+{
+public:
+  FrameTextureCache();
+
+  /**
+   * @brief Retrieve the texture for a hash, or nullptr if it isn't resident
+   */
+  TexturePtr Get(const QByteArray& hash);
+
+  void Insert(const QByteArray& hash, TexturePtr texture);
+
+  void Clear();
+
+  /**
+   * @brief Set the VRAM budget in bytes, evicting entries if necessary
+   */
+  void SetMaximumSize(qint64 bytes);
+
+  static qint64 GetTextureSize(const Texture* texture);
+
+private:
+  struct Entry {
+    QByteArray hash;
+    TexturePtr texture;
+    qint64 size;
+  };
+
+  using EntryList = std::list<Entry>;
+
+  EntryList EvictToFit();
+
+  /**
+   * @brief Update the metrics registry with the current occupancy, must be called with the lock held
+   */
+  void PublishMetrics();
+
+  // Most recently used entries are at the front
+  EntryList entries_;
+
+  QHash<QByteArray, EntryList::iterator> index_;
+
+  qint64 current_size_;
+
+  qint64 maximum_size_;
+
+  QMutex mutex_;
+
+};
+
+}
+
+#endif // FRAMETEXTURECACHE_H
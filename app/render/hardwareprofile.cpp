@@ -0,0 +1,280 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "hardwareprofile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent/QtConcurrent>
+
+#include "common/filefunctions.h"
+#include "config/config.h"
+#include "render/diskmanager.h"
+#include "render/memorygovernor.h"
+#include "render/rendermanager.h"
+
+namespace olive {
+
+const int HardwareProfile::kBenchmarkPhaseMs = 100;
+
+const double HardwareProfile::kScalingTolerance = 0.05;
+
+const int HardwareProfile::kDiskBenchmarkSize = 64 * 1024 * 1024;
+
+// Roughly how fast one thread compresses DWAA EXRs, past which another thread would just wait on the disk
+const int HardwareProfile::kCacheWriteSpeedPerThread = 150;
+
+const int HardwareProfile::kGPUBenchmarkIterations = 4;
+
+void HardwareProfile::Calibrate(bool force)
+{
+  QString fingerprint = GetFingerprint();
+
+  if (!force
+      && Config::Current()[QStringLiteral("CalibratedHardware")].toString() == fingerprint
+      && Config::Current()[QStringLiteral("CalibratedRenderThreads")].toInt() > 0) {
+    return;
+  }
+
+  qInfo() << "Calibrating for" << fingerprint;
+
+  int render_threads = MeasureThreadScaling();
+  int disk_speed = MeasureDiskWriteSpeed();
+
+  // Cache writes are mostly compression, so they can use as many threads as the disk keeps up
+  // with, as long as they leave most of the CPU to rendering
+  int write_threads = (disk_speed > 0) ? disk_speed / kCacheWriteSpeedPerThread : 2;
+  write_threads = qBound(2, write_threads, qMax(2, render_threads / 2));
+
+  Config::Current().Set(QStringLiteral("CalibratedHardware"), fingerprint);
+  Config::Current().Set(QStringLiteral("CalibratedRenderThreads"), render_threads);
+  Config::Current().Set(QStringLiteral("CalibratedDecodeThreads"), qMax(1, render_threads / 2));
+  Config::Current().Set(QStringLiteral("CalibratedCacheWriteThreads"), write_threads);
+  Config::Current().Set(QStringLiteral("CalibratedDiskWriteSpeed"), disk_speed);
+
+  // Until the GPU has been measured, keep one frame in flight per render thread
+  Config::Current().Set(QStringLiteral("CalibratedFramesInFlight"), render_threads);
+  Config::Current().Set(QStringLiteral("CalibratedGPUTransferSpeed"), 0);
+
+  qInfo() << "Calibrated" << render_threads << "render threads," << write_threads << "cache write threads,"
+          << "disk cache writes at" << disk_speed << "MB/s";
+}
+
+void HardwareProfile::CalibrateGPU(bool force)
+{
+  if (!RenderManager::instance()
+      || (!force && Config::Current()[QStringLiteral("CalibratedGPUTransferSpeed")].toInt() > 0)) {
+    return;
+  }
+
+  VideoParams params(1920, 1080, VideoParams::kFormatFloat16, VideoParams::kRGBAChannelCount);
+  qint64 elapsed = RenderManager::instance()->MeasureTextureTransfer(params, kGPUBenchmarkIterations);
+
+  if (elapsed <= 0) {
+    return;
+  }
+
+  double round_trip_ms = double(elapsed) / 1000000.0 / kGPUBenchmarkIterations;
+  qint64 frame_sz = qint64(params.width()) * params.height() * params.GetBytesPerPixel();
+  int speed = qMax(1, int(double(frame_sz * 2) / 1048576.0 / (round_trip_ms / 1000.0)));
+
+  // Every 60 FPS frame's worth of transfer time adds a frame in flight, so render threads have
+  // something to start while earlier frames are still being downloaded
+  int render_threads = GetRenderThreadCount();
+  int frames_in_flight = qMin(render_threads * 2, render_threads + int(std::ceil(round_trip_ms / 16.0)));
+
+  Config::Current().Set(QStringLiteral("CalibratedGPUTransferSpeed"), speed);
+  Config::Current().Set(QStringLiteral("CalibratedFramesInFlight"), frames_in_flight);
+
+  qInfo() << "Calibrated" << frames_in_flight << "frames in flight, GPU transfers at" << speed << "MB/s";
+}
+
+int HardwareProfile::GetRenderThreadCount()
+{
+  return GetValue(QStringLiteral("RenderThreads"), QStringLiteral("CalibratedRenderThreads"), QThread::idealThreadCount());
+}
+
+int HardwareProfile::GetDecodeThreadCount()
+{
+  return GetValue(QStringLiteral("DecodeThreads"), QStringLiteral("CalibratedDecodeThreads"), qMax(1, QThread::idealThreadCount() / 2));
+}
+
+int HardwareProfile::GetFramesInFlight()
+{
+  return GetValue(QStringLiteral("RenderFramesInFlight"), QStringLiteral("CalibratedFramesInFlight"), GetRenderThreadCount());
+}
+
+int HardwareProfile::GetCacheWriteThreadCount()
+{
+  return GetValue(QStringLiteral("CacheWriteThreads"), QStringLiteral("CalibratedCacheWriteThreads"), qMax(2, QThread::idealThreadCount() / 2));
+}
+
+QString HardwareProfile::GetFingerprint()
+{
+  qint64 total_memory, available_memory;
+  MemoryGovernor::GetSystemMemory(&total_memory, &available_memory);
+
+  // Round to the nearest GB, the reported total moves slightly with what the kernel reserves
+  return QStringLiteral("%1;%2;%3;%4").arg(QSysInfo::currentCpuArchitecture(),
+                                           QString::number(QThread::idealThreadCount()),
+                                           QString::number((total_memory + 536870912) / 1073741824),
+                                           QSysInfo::kernelType());
+}
+
+int HardwareProfile::MeasureThreadScaling()
+{
+  int max_threads = QThread::idealThreadCount();
+
+  QVector<int> counts;
+  for (int i=1; i<max_threads; i*=2) {
+    counts.append(i);
+  }
+  counts.append(max_threads);
+
+  QVector<double> rates(counts.size());
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(max_threads);
+
+  for (int i=0; i<counts.size(); i++) {
+    std::atomic_bool stop(false);
+    std::atomic<qint64> iterations(0);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int j=0; j<counts.at(i); j++) {
+      QtConcurrent::run(&pool, [&stop, &iterations](){
+        // Converting 8-bit pixels to float is about the mix of memory and arithmetic of decoding
+        // and scaling footage
+        const int kPixels = 65536;
+        QVector<quint8> in(kPixels * 4, 128);
+        QVector<float> out(kPixels * 4);
+        qint64 local = 0;
+
+        while (!stop) {
+          for (int k=0; k<in.size(); k++) {
+            out[k] = in.at(k) * (1.0f / 255.0f);
+          }
+
+          in[local % in.size()] = quint8(out.at(0) * 255.0f + 1.0f);
+          local++;
+        }
+
+        iterations += local;
+      });
+    }
+
+    QThread::msleep(kBenchmarkPhaseMs);
+    stop = true;
+    pool.waitForDone();
+
+    rates[i] = double(iterations) / qMax(qint64(1), timer.elapsed());
+  }
+
+  double best = *std::max_element(rates.cbegin(), rates.cend());
+
+  for (int i=0; i<counts.size(); i++) {
+    if (rates.at(i) >= best * (1.0 - kScalingTolerance)) {
+      return counts.at(i);
+    }
+  }
+
+  return max_threads;
+}
+
+int HardwareProfile::MeasureDiskWriteSpeed()
+{
+  // Measure the folder the disk cache will actually be written to
+  QString cache_path = DiskManager::GetDefaultDiskCachePath();
+
+  QFile default_disk_cache_file(DiskManager::GetDefaultDiskCacheConfigFile());
+  if (default_disk_cache_file.open(QFile::ReadOnly)) {
+    QString custom_path = QString::fromUtf8(default_disk_cache_file.readAll());
+
+    if (!custom_path.isEmpty()) {
+      cache_path = custom_path;
+    }
+  }
+
+  if (!FileFunctions::DirectoryIsValid(cache_path, true)) {
+    return 0;
+  }
+
+  QString filename = QDir(cache_path).filePath(QStringLiteral("calibration"));
+
+  QByteArray block(4 * 1024 * 1024, 0x5A);
+  QElapsedTimer timer;
+  bool written = true;
+
+  {
+    // QSaveFile syncs to disk before committing, so this measures the disk rather than the page cache
+    QSaveFile file(filename);
+
+    if (!file.open(QFile::WriteOnly)) {
+      return 0;
+    }
+
+    timer.start();
+
+    for (int i=0; i<kDiskBenchmarkSize && written; i+=block.size()) {
+      written = (file.write(block) == block.size());
+    }
+
+    written = written && file.commit();
+  }
+
+  qint64 elapsed = timer.elapsed();
+
+  QFile::remove(filename);
+
+  if (!written) {
+    return 0;
+  }
+
+  return qMax(1, int(qint64(kDiskBenchmarkSize / 1048576) * 1000 / qMax(qint64(1), elapsed)));
+}
+
+int HardwareProfile::GetValue(const QString &override_key, const QString &calibrated_key, int fallback)
+{
+  int v = Config::Current()[override_key].toInt();
+
+  if (v <= 0) {
+    v = Config::Current()[calibrated_key].toInt();
+  }
+
+  if (v <= 0) {
+    v = fallback;
+  }
+
+  return v;
+}
+
+}
@@ -0,0 +1,115 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef HARDWAREPROFILE_H
+#define HARDWAREPROFILE_H
+
+#include <QString>
+
+namespace olive {
+
+/**
+ * @brief Thread counts and queue depths tuned to the computer Olive is running on
+ *
+ * Calibrate() runs a short benchmark of CPU scaling and disk cache write speed, and
+ * CalibrateGPU() times texture uploads and downloads once the RenderManager exists. The values
+ * derived from them are kept in the config as "Calibrated*" entries along with a fingerprint of
+ * the hardware, so the benchmark only runs again on first run, when the hardware changes, or when
+ * forced from preferences.
+ *
+ * Each value can be overridden by its own config entry (e.g. "RenderThreads"), where 0 means use
+ * the calibrated value. Until something has been calibrated, the getters fall back to sizes based
+ * on QThread::idealThreadCount().
+ */
+class HardwareProfile
+{
+public:
+  /**
+   * @brief Measure the CPU and disk if the hardware has changed since they were last measured
+   *
+   * Call after the config has been loaded and before any pool sized by this class is created.
+   */
+  static void Calibrate(bool force = false);
+
+  /**
+   * @brief Measure texture transfers on the RenderManager's first context if they haven't been
+   * measured on this hardware yet
+   */
+  static void CalibrateGPU(bool force = false);
+
+  /**
+   * @brief Threads for rendering, and for decoding or mixing on behalf of render threads
+   */
+  static int GetRenderThreadCount();
+
+  /**
+   * @brief Threads for reading footage ahead of playback
+   */
+  static int GetDecodeThreadCount();
+
+  /**
+   * @brief Frames an export may have rendering or waiting for the encoder at once
+   */
+  static int GetFramesInFlight();
+
+  /**
+   * @brief Threads for compressing and writing frames to the disk cache
+   */
+  static int GetCacheWriteThreadCount();
+
+  /**
+   * @brief Identifies the hardware the calibrated values were measured on
+   */
+  static QString GetFingerprint();
+
+private:
+  /**
+   * @brief Find how many threads it takes to reach the CPU's full throughput
+   *
+   * A pixel format conversion standing in for decoding is run on 1, 2, 4... threads up to
+   * QThread::idealThreadCount(), and the fewest threads within kScalingTolerance of the best
+   * throughput is returned. SMT siblings and memory bandwidth often mean that's fewer than the
+   * number of logical cores.
+   */
+  static int MeasureThreadScaling();
+
+  /**
+   * @brief Write a file to the default disk cache folder and return how fast it reached the disk
+   * in MB/s, or 0 if it couldn't be written
+   */
+  static int MeasureDiskWriteSpeed();
+
+  static int GetValue(const QString& override_key, const QString& calibrated_key, int fallback);
+
+  static const int kBenchmarkPhaseMs;
+
+  static const double kScalingTolerance;
+
+  static const int kDiskBenchmarkSize;
+
+  static const int kCacheWriteSpeedPerThread;
+
+  static const int kGPUBenchmarkIterations;
+
+};
+
+}
+
+#endif // HARDWAREPROFILE_H
@@ -0,0 +1,119 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "interlacedframecache.h"
+
+namespace olive {
+
+// Previous, current and next, plus the frame after so stepping forward a field at a time never
+// evicts something that's about to be needed
+const int InterlacedFrameCache::kRingSize = 4;
+
+const int InterlacedFrameCache::kMaximumStreams = 8;
+
+TexturePtr InterlacedFrameCache::Get(const Key &key)
+{
+  QMutexLocker locker(&mutex_);
+
+  for (int i=0; i<rings_.size(); i++) {
+    if (rings_.at(i).stream == key.stream) {
+      foreach (const Entry& e, rings_.at(i).frames) {
+        if (e.key == key) {
+          rings_.move(i, 0);
+          return e.texture;
+        }
+      }
+
+      break;
+    }
+  }
+
+  return nullptr;
+}
+
+void InterlacedFrameCache::Insert(const Key &key, TexturePtr texture)
+{
+  if (!texture) {
+    return;
+  }
+
+  QMutexLocker locker(&mutex_);
+
+  int index = -1;
+
+  for (int i=0; i<rings_.size(); i++) {
+    if (rings_.at(i).stream == key.stream) {
+      index = i;
+      break;
+    }
+  }
+
+  if (index == -1) {
+    Ring r;
+    r.stream = key.stream;
+    rings_.prepend(r);
+  } else {
+    rings_.move(index, 0);
+  }
+
+  QVector<Entry>& frames = rings_.first().frames;
+
+  // Textures are destroyed once the lock is released, since freeing them may have to wait on the
+  // render thread
+  QVector<TexturePtr> evicted;
+
+  for (int i=0; i<frames.size(); i++) {
+    if (frames.at(i).key == key) {
+      // Another thread decoded the same frame at the same time, keep whichever arrived last
+      evicted.append(frames.at(i).texture);
+      frames.removeAt(i);
+      break;
+    }
+  }
+
+  frames.append({key, texture});
+
+  while (frames.size() > kRingSize) {
+    evicted.append(frames.first().texture);
+    frames.removeFirst();
+  }
+
+  while (rings_.size() > kMaximumStreams) {
+    foreach (const Entry& e, rings_.last().frames) {
+      evicted.append(e.texture);
+    }
+
+    rings_.removeLast();
+  }
+
+  locker.unlock();
+}
+
+void InterlacedFrameCache::Clear()
+{
+  QMutexLocker locker(&mutex_);
+
+  QList<Ring> evicted = rings_;
+  rings_.clear();
+
+  locker.unlock();
+}
+
+}
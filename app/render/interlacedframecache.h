@@ -0,0 +1,103 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef INTERLACEDFRAMECACHE_H
+#define INTERLACEDFRAMECACHE_H
+
+#include <QMutex>
+#include <QVector>
+
+#include "codec/decoder.h"
+#include "render/texture.h"
+
+namespace olive {
+
+/**
+ * @brief Small rings of the most recent woven frames of each interlaced stream, kept on the GPU
+ *
+ * The temporal deinterlacer needs the frames either side of the one it's showing. Playback moves a
+ * field at a time, so with the last few frames of each stream kept resident every frame is only
+ * decoded and uploaded once instead of once for each of its neighbors too. Unlike StillImageCache
+ * this doesn't depend on a user-set budget: each stream keeps kRingSize frames, and only the
+ * kMaximumStreams most recently used streams are kept at all.
+ *
+ * This class is thread-safe.
+ */
+class InterlacedFrameCache
+{
+public:
+  struct Key {
+    Decoder::CodecStream stream;
+    QString colorspace;
+    bool alpha_is_associated;
+    int divider;
+    rational time;
+
+    bool operator==(const Key& rhs) const
+    {
+      return stream == rhs.stream
+          && colorspace == rhs.colorspace
+          && alpha_is_associated == rhs.alpha_is_associated
+          && divider == rhs.divider
+          && time == rhs.time;
+    }
+  };
+
+  InterlacedFrameCache() = default;
+
+  /**
+   * @brief Retrieve the woven frame for a key, or nullptr if it isn't resident
+   */
+  TexturePtr Get(const Key& key);
+
+  /**
+   * @brief Add a woven frame, replacing the oldest in its stream's ring if it's full
+   */
+  void Insert(const Key& key, TexturePtr texture);
+
+  void Clear();
+
+  static const int kRingSize;
+
+  static const int kMaximumStreams;
+
+private:
+  struct Entry {
+    Key key;
+    TexturePtr texture;
+  };
+
+  struct Ring {
+    Decoder::CodecStream stream;
+
+    // Oldest first
+    QVector<Entry> frames;
+  };
+
+  // Most recently used streams are at the front
+  QList<Ring> rings_;
+
+  QMutex mutex_;
+
+};
+
+}
+
+#endif // INTERLACEDFRAMECACHE_H
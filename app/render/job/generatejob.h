@@ -22,6 +22,7 @@
 #define GENERATEJOB_H
 
 #include "acceleratedjob.h"
+#include "codec/frame.h"
 
 namespace olive {
 
@@ -36,6 +37,7 @@ public:
   GenerateJob()
   {
     alpha_channel_required_ = kAlphaAuto;
+    download_textures_ = false;
   }
 
   AlphaChannelSetting GetAlphaChannelRequired() const
@@ -48,9 +50,39 @@ public:
     alpha_channel_required_ = e;
   }
 
+  /**
+   * @brief Whether the renderer should download this job's texture inputs for GenerateFrame()
+   *
+   * Only nodes that process their inputs on the CPU need this, since every download stalls on the
+   * GPU. Downloaded inputs are retrieved with GetFrame().
+   */
+  bool GetDownloadTextures() const
+  {
+    return download_textures_;
+  }
+
+  void SetDownloadTextures(bool e)
+  {
+    download_textures_ = e;
+  }
+
+  FramePtr GetFrame(const QString& input) const
+  {
+    return frames_.value(input);
+  }
+
+  void SetFrame(const QString& input, FramePtr frame)
+  {
+    frames_.insert(input, frame);
+  }
+
 private:
   AlphaChannelSetting alpha_channel_required_;
 
+  bool download_textures_;
+
+  QHash<QString, FramePtr> frames_;
+
 };
 
 }
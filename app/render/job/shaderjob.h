@@ -22,6 +22,7 @@
 #define SHADERJOB_H
 
 #include <QMatrix4x4>
+#include <QRectF>
 
 #include "generatejob.h"
 #include "render/texture.h"
@@ -34,6 +35,10 @@ public:
   {
     iterations_ = 1;
     iterative_input_ = nullptr;
+    full_precision_ = false;
+    has_constant_color_ = false;
+    profile_node_ = nullptr;
+    footprint_ = 0;
   }
 
   const QString& GetShaderID() const
@@ -82,6 +87,97 @@ public:
     interpolation_.insert(id, interp);
   }
 
+  /**
+   * @brief Whether this shader's output must be stored at the sequence's full precision
+   *
+   * Offline renders store intermediate textures at half-float precision to save bandwidth. Nodes
+   * whose output error would compound visibly, such as multi-pass accumulations, should set this
+   * to opt out.
+   */
+  bool RequiresFullPrecision() const
+  {
+    return full_precision_;
+  }
+
+  void SetRequiresFullPrecision(bool e)
+  {
+    full_precision_ = e;
+  }
+
+  /**
+   * @brief Whether this shader is known to output GetConstantColor() everywhere
+   *
+   * The renderer clears to the color instead of running the shader, and tags the output texture so
+   * downstream nodes can keep combining constants without sampling them.
+   */
+  bool HasConstantColor() const
+  {
+    return has_constant_color_;
+  }
+
+  const Color& GetConstantColor() const
+  {
+    return constant_color_;
+  }
+
+  void SetConstantColor(const Color& c)
+  {
+    has_constant_color_ = true;
+    constant_color_ = c;
+  }
+
+  /**
+   * @brief Node that GPU time spent running this job is attributed to (see NodeGpuProfiler)
+   */
+  const Node* GetProfileNode() const
+  {
+    return profile_node_;
+  }
+
+  void SetProfileNode(const Node* n)
+  {
+    profile_node_ = n;
+  }
+
+  /**
+   * @brief Region of the destination that needs to be drawn, normalized to 0-1 from the top-left
+   *
+   * Pixels outside the region are cleared rather than shaded. A null rect (the default) draws
+   * everything. Only meaningful for shaders whose output pixels don't depend on their neighbors.
+   */
+  const QRectF& GetScissor() const
+  {
+    return scissor_;
+  }
+
+  void SetScissor(const QRectF& r)
+  {
+    scissor_ = r;
+  }
+
+  /**
+   * @brief How far in pixels from its own texture coordinate this shader may sample its inputs
+   *
+   * Tiled renders use this to work out how much more of each input than the tile itself has to be
+   * rendered. Iterative shaders give the furthest reach of all their iterations together. Shaders
+   * that may sample anywhere, or that use their own texture in a way that only works for the whole
+   * frame, set kFootprintWholeFrame.
+   *
+   * The default of 0 means inputs are only sampled at the shader's own texture coordinate (after
+   * its geometry's transform, which is accounted for separately).
+   */
+  int GetSamplingFootprint() const
+  {
+    return footprint_;
+  }
+
+  void SetSamplingFootprint(int pixels)
+  {
+    footprint_ = pixels;
+  }
+
+  static const int kFootprintWholeFrame = -1;
+
 private:
   QString shader_id_;
 
@@ -91,6 +187,18 @@ private:
 
   QHash<QString, Texture::Interpolation> interpolation_;
 
+  bool full_precision_;
+
+  bool has_constant_color_;
+
+  Color constant_color_;
+
+  const Node* profile_node_;
+
+  QRectF scissor_;
+
+  int footprint_;
+
 };
 
 }
@@ -0,0 +1,317 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "memorygovernor.h"
+
+#include <QDebug>
+#include <QFile>
+
+#if defined(Q_OS_WINDOWS)
+#include <Windows.h>
+#elif defined(Q_OS_LINUX)
+#include <unistd.h>
+#endif
+
+#include "config/config.h"
+
+namespace olive {
+
+MemoryGovernor* MemoryGovernor::instance_ = nullptr;
+
+const int MemoryGovernor::kPollInterval = 2000;
+
+// Fraction of physical memory below which the system is considered short of memory
+const double MemoryGovernor::kPressureThreshold = 0.05;
+
+const int MemoryGovernor::kMaximumPressureLevel = 4;
+
+void MemoryGovernor::CreateInstance()
+{
+  instance_ = new MemoryGovernor();
+}
+
+void MemoryGovernor::DestroyInstance()
+{
+  delete instance_;
+  instance_ = nullptr;
+}
+
+MemoryGovernor *MemoryGovernor::instance()
+{
+  return instance_;
+}
+
+MemoryGovernor::MemoryGovernor() :
+  pressure_level_(0)
+{
+  connect(&Config::Current(), &Config::ValueChanged, this, &MemoryGovernor::ConfigChanged);
+
+  poll_timer_.setInterval(kPollInterval);
+  connect(&poll_timer_, &QTimer::timeout, this, &MemoryGovernor::CheckSystemMemory);
+  poll_timer_.start();
+}
+
+void MemoryGovernor::Register(const QString &key, Pool pool, double weight, LimitFunction set_limit)
+{
+  {
+    QMutexLocker locker(&mutex_);
+
+    // Set to -1 so Rebalance() always sends the first limit
+    consumers_.insert(key, {pool, weight, set_limit, -1});
+  }
+
+  Rebalance();
+}
+
+void MemoryGovernor::Unregister(const QString &key)
+{
+  {
+    QMutexLocker locker(&mutex_);
+
+    consumers_.remove(key);
+  }
+
+  Rebalance();
+}
+
+qint64 MemoryGovernor::GetLimit(const QString &key)
+{
+  if (instance_) {
+    QMutexLocker locker(&instance_->mutex_);
+
+    auto it = instance_->consumers_.constFind(key);
+    if (it != instance_->consumers_.constEnd()) {
+      return it->limit;
+    }
+  }
+
+  return GetPreferredSize(key);
+}
+
+void MemoryGovernor::GetSystemMemory(qint64 *total, qint64 *available)
+{
+  *total = -1;
+  *available = -1;
+
+#if defined(Q_OS_WINDOWS)
+  MEMORYSTATUSEX status;
+  status.dwLength = sizeof(status);
+
+  if (GlobalMemoryStatusEx(&status)) {
+    *total = qint64(status.ullTotalPhys);
+    *available = qint64(status.ullAvailPhys);
+  }
+#elif defined(Q_OS_LINUX)
+  // MemAvailable accounts for page cache that can be reclaimed, unlike sysconf's free pages
+  QFile meminfo(QStringLiteral("/proc/meminfo"));
+
+  if (meminfo.open(QFile::ReadOnly)) {
+    foreach (const QByteArray& line, meminfo.readAll().split('\n')) {
+      QList<QByteArray> fields = line.simplified().split(' ');
+
+      if (fields.size() < 2) {
+        continue;
+      }
+
+      if (fields.at(0) == "MemTotal:") {
+        *total = fields.at(1).toLongLong() * 1024;
+      } else if (fields.at(0) == "MemAvailable:") {
+        *available = fields.at(1).toLongLong() * 1024;
+      }
+    }
+  }
+
+  if (*total < 0) {
+    *total = qint64(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGE_SIZE);
+  }
+#endif
+}
+
+qint64 MemoryGovernor::GetPreferredSize(const QString &key)
+{
+  return Config::Current()[key].toLongLong() * 1024 * 1024;
+}
+
+qint64 MemoryGovernor::GetBudget(Pool pool) const
+{
+  if (pool == kVideoMemory) {
+    return GetPreferredSize(QStringLiteral("VRAMBudget"));
+  }
+
+  qint64 budget = GetPreferredSize(QStringLiteral("RAMBudget"));
+
+  if (budget <= 0) {
+    qint64 total, available;
+    GetSystemMemory(&total, &available);
+
+    if (total > 0) {
+      budget = total / 2;
+    }
+  }
+
+  if (pressure_level_ > 0) {
+    if (budget <= 0) {
+      // No budget to cut, so start from what every consumer asked for
+      for (auto it=consumers_.cbegin(); it!=consumers_.cend(); it++) {
+        if (it->pool == kSystemMemory) {
+          budget += GetPreferredSize(it.key());
+        }
+      }
+    }
+
+    budget >>= pressure_level_;
+  }
+
+  return budget;
+}
+
+void MemoryGovernor::Rebalance()
+{
+  QVector< QPair<LimitFunction, qint64> > changed;
+
+  {
+    QMutexLocker locker(&mutex_);
+
+    for (int p=kSystemMemory; p<=kVideoMemory; p++) {
+      Pool pool = static_cast<Pool>(p);
+
+      qint64 budget = GetBudget(pool);
+
+      QMap<QString, qint64> limits;
+      QStringList unsettled;
+
+      for (auto it=consumers_.cbegin(); it!=consumers_.cend(); it++) {
+        if (it->pool == pool) {
+          limits.insert(it.key(), GetPreferredSize(it.key()));
+          unsettled.append(it.key());
+        }
+      }
+
+      if (budget > 0) {
+        // Consumers that want less than their share get what they want, and what they leave is
+        // shared between the rest, until everyone left wants more than their share
+        qint64 remaining = budget;
+        bool settled_any = true;
+
+        while (settled_any && !unsettled.isEmpty()) {
+          settled_any = false;
+
+          double total_weight = 0;
+          foreach (const QString& key, unsettled) {
+            total_weight += consumers_.value(key).weight;
+          }
+
+          for (int i=0; i<unsettled.size(); ) {
+            const QString& key = unsettled.at(i);
+            qint64 share = qint64(remaining * consumers_.value(key).weight / total_weight);
+
+            if (limits.value(key) <= share) {
+              remaining -= limits.value(key);
+              unsettled.removeAt(i);
+              settled_any = true;
+            } else {
+              i++;
+            }
+          }
+        }
+
+        double total_weight = 0;
+        foreach (const QString& key, unsettled) {
+          total_weight += consumers_.value(key).weight;
+        }
+
+        foreach (const QString& key, unsettled) {
+          limits.insert(key, qint64(remaining * consumers_.value(key).weight / total_weight));
+        }
+      }
+
+      for (auto it=limits.cbegin(); it!=limits.cend(); it++) {
+        Consumer& c = consumers_[it.key()];
+
+        if (c.limit != it.value()) {
+          c.limit = it.value();
+
+          if (c.set_limit) {
+            changed.append({c.set_limit, c.limit});
+          }
+        }
+      }
+    }
+  }
+
+  // Consumers may take their own locks while shrinking, so call them without holding ours
+  for (const QPair<LimitFunction, qint64>& c : changed) {
+    c.first(c.second);
+  }
+}
+
+void MemoryGovernor::ConfigChanged(const QString &key)
+{
+  bool affects_limits;
+
+  {
+    QMutexLocker locker(&mutex_);
+    affects_limits = (key == QStringLiteral("RAMBudget") || key == QStringLiteral("VRAMBudget") || consumers_.contains(key));
+  }
+
+  if (affects_limits) {
+    Rebalance();
+  }
+}
+
+void MemoryGovernor::CheckSystemMemory()
+{
+  qint64 total, available;
+  GetSystemMemory(&total, &available);
+
+  if (total <= 0 || available < 0) {
+    return;
+  }
+
+  int level;
+
+  {
+    QMutexLocker locker(&mutex_);
+
+    level = pressure_level_;
+
+    if (available < total * kPressureThreshold) {
+      level = qMin(level + 1, kMaximumPressureLevel);
+    } else if (available > total * kPressureThreshold * 2) {
+      // Only relax once there's a comfortable margin, so we don't flip back and forth at the edge
+      level = qMax(level - 1, 0);
+    }
+
+    if (level == pressure_level_ && available >= total * kPressureThreshold) {
+      return;
+    }
+
+    pressure_level_ = level;
+  }
+
+  Rebalance();
+
+  if (available < total * kPressureThreshold) {
+    qWarning() << "System is low on memory, shrinking caches";
+    emit MemoryPressure();
+  }
+}
+
+}
@@ -0,0 +1,147 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef MEMORYGOVERNOR_H
+#define MEMORYGOVERNOR_H
+
+#include <functional>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QTimer>
+
+namespace olive {
+
+/**
+ * @brief Shares RAM and VRAM budgets between every cache and pool that registers with it
+ *
+ * The budgets come from the "RAMBudget" and "VRAMBudget" config entries. A RAM budget of 0 means half
+ * of the system's physical memory, and a VRAM budget of 0 means no budget.
+ *
+ * Each consumer is registered under the config key holding the size the user asked for it to use.
+ * While the sizes of every consumer in a pool fit within its budget, each gets exactly that.
+ * Otherwise the budget is split by weight, with any share a consumer doesn't need going to the
+ * others. Consumers are told their limit through a callback, or can look it up with GetLimit().
+ *
+ * The system's available memory is also polled. When it runs low, the RAM budget is halved
+ * (repeatedly if it stays low) and MemoryPressure() is emitted so pools without a limit can let go
+ * of what they're holding. Budgets return to normal once enough memory is free again.
+ */
+class MemoryGovernor : public QObject
+{
+  Q_OBJECT
+public:
+  static void CreateInstance();
+
+  static void DestroyInstance();
+
+  static MemoryGovernor* instance();
+
+  enum Pool {
+    kSystemMemory,
+    kVideoMemory
+  };
+
+  using LimitFunction = std::function<void(qint64)>;
+
+  /**
+   * @brief Add a consumer whose preferred size is the config entry `key`, in megabytes
+   *
+   * `weight` is how much of an oversubscribed budget this consumer gets relative to the others.
+   * `set_limit`, which may be null for consumers that poll GetLimit() instead, is called with
+   * the consumer's limit in bytes straight away and whenever it changes. It's called on the main
+   * thread, so it must be safe to call from there.
+   */
+  void Register(const QString& key, Pool pool, double weight, LimitFunction set_limit);
+
+  void Unregister(const QString& key);
+
+  /**
+   * @brief Get the limit in bytes for the consumer registered under `key`
+   *
+   * If there's no governor or nothing is registered under `key`, this is the config entry's own
+   * size. Thread-safe.
+   */
+  static qint64 GetLimit(const QString& key);
+
+  /**
+   * @brief Get the total and currently available physical memory in bytes
+   *
+   * Either is -1 if this platform doesn't provide it.
+   */
+  static void GetSystemMemory(qint64* total, qint64* available);
+
+signals:
+  /**
+   * @brief Emitted when the system is running out of memory
+   */
+  void MemoryPressure();
+
+private:
+  MemoryGovernor();
+
+  static qint64 GetPreferredSize(const QString& key);
+
+  /**
+   * @brief Get a pool's budget in bytes, or 0 if it's unlimited
+   *
+   * Must be called with the lock held.
+   */
+  qint64 GetBudget(Pool pool) const;
+
+  /**
+   * @brief Recalculate every consumer's limit and send any that changed
+   */
+  void Rebalance();
+
+  static MemoryGovernor* instance_;
+
+  static const int kPollInterval;
+
+  static const double kPressureThreshold;
+
+  static const int kMaximumPressureLevel;
+
+  struct Consumer {
+    Pool pool;
+    double weight;
+    LimitFunction set_limit;
+    qint64 limit;
+  };
+
+  QMap<QString, Consumer> consumers_;
+
+  // Number of times the RAM budget has been halved for memory pressure
+  int pressure_level_;
+
+  QTimer poll_timer_;
+
+  mutable QMutex mutex_;
+
+private slots:
+  void ConfigChanged(const QString& key);
+
+  void CheckSystemMemory();
+
+};
+
+}
+
+#endif // MEMORYGOVERNOR_H
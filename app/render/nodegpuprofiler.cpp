@@ -0,0 +1,113 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "nodegpuprofiler.h"
+
+#include <QByteArray>
+#include <QSet>
+
+#include "common/tracing.h"
+
+namespace olive {
+
+std::atomic_int NodeGpuProfiler::users_(0);
+QMutex NodeGpuProfiler::lock_;
+QHash<const Node*, const Node*> NodeGpuProfiler::sources_;
+QHash<const Node*, double> NodeGpuProfiler::averages_;
+
+// High enough that changing a parameter shows up within a few frames
+const double NodeGpuProfiler::kSampleWeight = 0.2;
+
+bool NodeGpuProfiler::IsEnabled()
+{
+  return users_.load(std::memory_order_relaxed) > 0 || Tracer::IsEnabled();
+}
+
+void NodeGpuProfiler::AddUser()
+{
+  users_++;
+}
+
+void NodeGpuProfiler::RemoveUser()
+{
+  users_--;
+}
+
+void NodeGpuProfiler::SetSourceNode(const Node *copy, const Node *original)
+{
+  QMutexLocker locker(&lock_);
+
+  sources_.insert(copy, original);
+}
+
+void NodeGpuProfiler::RemoveNode(const Node *node)
+{
+  QMutexLocker locker(&lock_);
+
+  sources_.remove(node);
+  averages_.remove(node);
+}
+
+void NodeGpuProfiler::AddSample(const Node *node, const QString &node_id, qint64 nanoseconds)
+{
+  if (Tracer::IsEnabled()) {
+    // Tracer only keeps pointers to names, so intern them. Node IDs are a small, fixed set.
+    static QMutex names_lock;
+    static QSet<QByteArray> names;
+
+    QMutexLocker names_locker(&names_lock);
+    QByteArray name = QByteArrayLiteral("GPU us: ") + node_id.toUtf8();
+    auto it = names.constFind(name);
+    if (it == names.constEnd()) {
+      it = names.insert(name);
+    }
+
+    Tracer::RecordCounter("gpu", it->constData(), nanoseconds / 1000);
+  }
+
+  QMutexLocker locker(&lock_);
+
+  auto source = sources_.constFind(node);
+  if (source == sources_.constEnd()) {
+    return;
+  }
+
+  auto it = averages_.find(source.value());
+
+  if (it == averages_.end()) {
+    averages_.insert(source.value(), nanoseconds);
+  } else {
+    *it = *it * (1.0 - kSampleWeight) + nanoseconds * kSampleWeight;
+  }
+}
+
+double NodeGpuProfiler::GetMilliseconds(const Node *node)
+{
+  QMutexLocker locker(&lock_);
+
+  auto it = averages_.constFind(node);
+  if (it == averages_.constEnd()) {
+    return -1.0;
+  }
+
+  return it.value() / 1000000.0;
+}
+
+}
@@ -0,0 +1,94 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEGPUPROFILER_H
+#define NODEGPUPROFILER_H
+
+#include <atomic>
+#include <QHash>
+#include <QMutex>
+
+namespace olive {
+
+class Node;
+
+/**
+ * @brief Collects how much GPU time each node's shaders take
+ *
+ * Renderers measure their blits asynchronously and report the result with the node that queued
+ * the shader. Renders run on copies of the graph, so whoever makes a copy registers which node it
+ * was copied from and times are attributed to the original the user sees. Times of nodes that
+ * weren't registered are only written to the trace, since by the time a result is available the
+ * node may have been destroyed.
+ *
+ * Timing isn't free, so it only happens while something wants the results (see AddUser()) or a
+ * trace is being recorded.
+ */
+class NodeGpuProfiler
+{
+public:
+  static bool IsEnabled();
+
+  /**
+   * @brief Register/unregister interest in GPU times, timing is enabled while there's at least one
+   */
+  static void AddUser();
+  static void RemoveUser();
+
+  /**
+   * @brief Attribute all times measured for `copy` to `original`
+   */
+  static void SetSourceNode(const Node* copy, const Node* original);
+
+  /**
+   * @brief Forget everything about a node that's being destroyed
+   */
+  static void RemoveNode(const Node* node);
+
+  /**
+   * @brief Report that one of `node`'s shaders took `nanoseconds` of GPU time
+   *
+   * `node` is never dereferenced, `node_id` is its Node::id(). Safe to call from any thread.
+   */
+  static void AddSample(const Node* node, const QString& node_id, qint64 nanoseconds);
+
+  /**
+   * @brief Recent GPU time of a node's shaders per blit, or a negative value if there's none
+   */
+  static double GetMilliseconds(const Node* node);
+
+private:
+  static std::atomic_int users_;
+
+  static QMutex lock_;
+
+  static QHash<const Node*, const Node*> sources_;
+
+  /// Exponential moving average of each node's time in nanoseconds
+  static QHash<const Node*, double> averages_;
+
+  /// Weight of the newest sample in the moving average
+  static const double kSampleWeight;
+
+};
+
+}
+
+#endif // NODEGPUPROFILER_H
@@ -0,0 +1,174 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "nodevaluecache.h"
+
+#include "render/frametexturecache.h"
+
+namespace olive {
+
+const qint64 NodeValueCache::kMinimumTextureCost = 500000;
+
+NodeValueCache::NodeValueCache() :
+  clock_(0),
+  current_size_(0),
+  maximum_size_(0)
+{
+}
+
+bool NodeValueCache::Get(const QByteArray &key, NodeValueTable *table)
+{
+  QMutexLocker locker(&mutex_);
+
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return false;
+  }
+
+  // Re-age since it was just used
+  Entry& e = it.value();
+  queue_.erase(e.position);
+  e.position = queue_.insert(std::make_pair(GetPriority(e), key));
+
+  *table = e.table;
+
+  return true;
+}
+
+void NodeValueCache::Insert(const QByteArray &key, const NodeValueTable &table, qint64 cost)
+{
+  if (key.isEmpty()) {
+    return;
+  }
+
+  bool has_textures;
+  qint64 sz = GetTableSize(table, &has_textures);
+
+  if (has_textures && cost < kMinimumTextureCost) {
+    // Quicker to render again than to spend memory on
+    return;
+  }
+
+  QMutexLocker locker(&mutex_);
+
+  if (sz > maximum_size_) {
+    // Would never fit, don't bother
+    return;
+  }
+
+  auto existing = entries_.find(key);
+  if (existing != entries_.end()) {
+    // Same key means same table, just refresh its priority
+    Entry& e = existing.value();
+    queue_.erase(e.position);
+    e.position = queue_.insert(std::make_pair(GetPriority(e), key));
+    return;
+  }
+
+  Entry e = {table, sz, cost, queue_.end()};
+  e.position = queue_.insert(std::make_pair(GetPriority(e), key));
+  entries_.insert(key, e);
+  current_size_ += sz;
+
+  // Textures are destroyed once the lock is released, since freeing them may have to wait on the
+  // render thread
+  QVector<NodeValueTable> evicted = EvictToFit();
+  locker.unlock();
+}
+
+void NodeValueCache::Clear()
+{
+  QMutexLocker locker(&mutex_);
+
+  QHash<QByteArray, Entry> evicted;
+  evicted.swap(entries_);
+  queue_.clear();
+  clock_ = 0;
+  current_size_ = 0;
+
+  locker.unlock();
+}
+
+void NodeValueCache::SetMaximumSize(qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+
+  maximum_size_ = bytes;
+
+  QVector<NodeValueTable> evicted = EvictToFit();
+  locker.unlock();
+}
+
+qint64 NodeValueCache::GetTableSize(const NodeValueTable &table, bool *has_textures)
+{
+  // Count a small overhead per entry so tables without textures still contribute to the budget
+  qint64 sz = 1024;
+
+  if (has_textures) {
+    *has_textures = false;
+  }
+
+  for (int i=0; i<table.Count(); i++) {
+    const NodeValue& v = table.at(i);
+
+    if (v.type() == NodeValue::kTexture) {
+      TexturePtr tex = v.data().value<TexturePtr>();
+
+      if (tex && !tex->IsDummy()) {
+        sz += FrameTextureCache::GetTextureSize(tex.get());
+
+        if (has_textures) {
+          *has_textures = true;
+        }
+      }
+    }
+  }
+
+  return sz;
+}
+
+double NodeValueCache::GetPriority(const Entry &e) const
+{
+  // Cost per byte, so one expensive frame doesn't outrank many slightly cheaper small ones. Costs
+  // are at least 1 so entries still age in order when they were free to make.
+  return clock_ + double(qMax(e.cost, qint64(1))) / double(e.size);
+}
+
+QVector<NodeValueTable> NodeValueCache::EvictToFit()
+{
+  QVector<NodeValueTable> evicted;
+
+  while (current_size_ > maximum_size_ && !queue_.empty()) {
+    auto lowest = queue_.begin();
+
+    // Everything used from here on has to beat what we just threw away to stay
+    clock_ = lowest->first;
+
+    auto it = entries_.find(lowest->second);
+    current_size_ -= it->size;
+    evicted.append(it->table);
+    entries_.erase(it);
+    queue_.erase(lowest);
+  }
+
+  return evicted;
+}
+
+}
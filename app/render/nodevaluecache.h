@@ -0,0 +1,113 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NODEVALUECACHE_H
+#define NODEVALUECACHE_H
+
+#include <map>
+#include <QHash>
+#include <QMutex>
+#include <QVector>
+
+#include "node/value.h"
+
+namespace olive {
+
+/**
+ * @brief Memo of node outputs shared between render tickets
+ *
+ * Holds the NodeValueTable a node produced, keyed by the node, its output, the length of the range
+ * and the node's hash at that time. Since Node::Hash covers everything a node's value depends on
+ * (including time, for the nodes that actually depend on it), a static subgraph produces the same
+ * key on every frame and only needs to be traversed once, and changing a node late in a chain
+ * leaves everything upstream of it cached.
+ *
+ * Each table is stored with what it cost to generate (including everything upstream of it), so the
+ * budget goes to the outputs that are most expensive to get back per byte. Textures cheaper than
+ * kMinimumTextureCost aren't worth their memory and aren't stored at all. Entries are evicted by
+ * greedy dual-size frequency: cost per byte plus an aging value, so expensive results outlive cheap
+ * ones without staying forever once they stop being used.
+ *
+ * This class is thread-safe.
+ */
+class NodeValueCache
+{
+public:
+  NodeValueCache();
+
+  /**
+   * @brief Nanoseconds a table with textures must have cost to be stored
+   */
+  static const qint64 kMinimumTextureCost;
+
+  /**
+   * @brief Retrieve the table for a key
+   *
+   * Returns TRUE and sets `table` if the key was found.
+   */
+  bool Get(const QByteArray& key, NodeValueTable* table);
+
+  /**
+   * @brief Store a table that took `cost` nanoseconds to generate
+   */
+  void Insert(const QByteArray& key, const NodeValueTable& table, qint64 cost);
+
+  void Clear();
+
+  /**
+   * @brief Set the budget in bytes, evicting entries if necessary
+   */
+  void SetMaximumSize(qint64 bytes);
+
+  static qint64 GetTableSize(const NodeValueTable& table, bool* has_textures = nullptr);
+
+private:
+  // Eviction order, lowest priority first
+  using PriorityQueue = std::multimap<double, QByteArray>;
+
+  struct Entry {
+    NodeValueTable table;
+    qint64 size;
+    qint64 cost;
+    PriorityQueue::iterator position;
+  };
+
+  double GetPriority(const Entry& e) const;
+
+  QVector<NodeValueTable> EvictToFit();
+
+  QHash<QByteArray, Entry> entries_;
+
+  PriorityQueue queue_;
+
+  // Priority of the last evicted entry, which every new or used entry starts from
+  double clock_;
+
+  qint64 current_size_;
+
+  qint64 maximum_size_;
+
+  QMutex mutex_;
+
+};
+
+}
+
+#endif // NODEVALUECACHE_H
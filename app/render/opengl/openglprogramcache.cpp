@@ -0,0 +1,196 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "openglprogramcache.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QOpenGLExtraFunctions>
+#include <QSaveFile>
+#include <QtConcurrent/QtConcurrent>
+
+#include "common/filefunctions.h"
+
+namespace olive {
+
+// Not in every GL header since they're from GL 4.1/ARB_get_program_binary (and ES 3.0)
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+QMutex OpenGLProgramCache::lock_;
+QHash<QByteArray, OpenGLProgramCache::Binary> OpenGLProgramCache::binaries_;
+QFuture<void> OpenGLProgramCache::preload_future_;
+
+void OpenGLProgramCache::Preload()
+{
+  preload_future_ = QtConcurrent::run(&OpenGLProgramCache::PreloadInternal);
+}
+
+bool OpenGLProgramCache::IsSupported(QOpenGLContext *ctx)
+{
+  bool has_binaries = ctx->isOpenGLES()
+      ? ctx->format().version() >= qMakePair(3, 0)
+      : (ctx->format().version() >= qMakePair(4, 1) || ctx->hasExtension(QByteArrayLiteral("GL_ARB_get_program_binary")));
+
+  if (!has_binaries) {
+    return false;
+  }
+
+  // Some drivers expose the functions but don't support any formats
+  GLint format_count = 0;
+  ctx->functions()->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_count);
+
+  return format_count > 0;
+}
+
+QByteArray OpenGLProgramCache::GetKey(QOpenGLContext *ctx, const QString &vert_code, const QString &frag_code)
+{
+  QOpenGLFunctions* f = ctx->functions();
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+
+  hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_VENDOR)));
+  hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_RENDERER)));
+  hash.addData(reinterpret_cast<const char*>(f->glGetString(GL_VERSION)));
+  hash.addData(vert_code.toUtf8());
+  hash.addData(frag_code.toUtf8());
+
+  return hash.result().toHex();
+}
+
+bool OpenGLProgramCache::Load(QOpenGLContext *ctx, GLuint program, const QByteArray &key)
+{
+  // Only waits if a shader is needed before preloading has finished
+  preload_future_.waitForFinished();
+
+  Binary binary;
+
+  {
+    QMutexLocker locker(&lock_);
+
+    auto it = binaries_.constFind(key);
+    if (it == binaries_.constEnd()) {
+      return false;
+    }
+
+    binary = it.value();
+  }
+
+  QOpenGLExtraFunctions* f = ctx->extraFunctions();
+
+  f->glProgramBinary(program, binary.format, binary.data.constData(), binary.data.size());
+
+  GLint linked = GL_FALSE;
+  f->glGetProgramiv(program, GL_LINK_STATUS, &linked);
+
+  if (!linked) {
+    // Rejected by the driver, probably changed in a way our key doesn't capture
+    QMutexLocker locker(&lock_);
+    binaries_.remove(key);
+    QFile::remove(QDir(GetCacheDirectory()).filePath(QString::fromLatin1(key)));
+    return false;
+  }
+
+  return true;
+}
+
+void OpenGLProgramCache::Save(QOpenGLContext *ctx, GLuint program, const QByteArray &key)
+{
+  QOpenGLExtraFunctions* f = ctx->extraFunctions();
+
+  GLint length = 0;
+  f->glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+  if (length <= 0) {
+    return;
+  }
+
+  Binary binary;
+  binary.data.resize(length);
+  f->glGetProgramBinary(program, length, nullptr, &binary.format, binary.data.data());
+
+  {
+    QMutexLocker locker(&lock_);
+    binaries_.insert(key, binary);
+  }
+
+  // Writing doesn't need the context, so keep it off the render thread
+  QtConcurrent::run([key, binary]{
+    QString dir = GetCacheDirectory();
+    QDir().mkpath(dir);
+
+    QSaveFile file(QDir(dir).filePath(QString::fromLatin1(key)));
+
+    if (file.open(QFile::WriteOnly)) {
+      QDataStream stream(&file);
+      stream << quint32(binary.format) << binary.data;
+      file.commit();
+    }
+  });
+}
+
+QString OpenGLProgramCache::GetCacheDirectory()
+{
+  return QDir(FileFunctions::GetConfigurationLocation()).filePath(QStringLiteral("shadercache"));
+}
+
+void OpenGLProgramCache::PreloadInternal()
+{
+  QDir dir(GetCacheDirectory());
+
+  QHash<QByteArray, Binary> loaded;
+
+  foreach (const QFileInfo& info, dir.entryInfoList(QDir::Files)) {
+    QFile file(info.absoluteFilePath());
+
+    if (!file.open(QFile::ReadOnly)) {
+      continue;
+    }
+
+    QDataStream stream(&file);
+    quint32 format;
+    Binary binary;
+    stream >> format >> binary.data;
+
+    if (stream.status() == QDataStream::Ok && !binary.data.isEmpty()) {
+      binary.format = format;
+      loaded.insert(info.fileName().toLatin1(), binary);
+    }
+  }
+
+  // Anything saved while we were reading is newer, so keep it
+  QMutexLocker locker(&lock_);
+  for (auto it=loaded.cbegin(); it!=loaded.cend(); it++) {
+    if (!binaries_.contains(it.key())) {
+      binaries_.insert(it.key(), it.value());
+    }
+  }
+}
+
+}
@@ -0,0 +1,89 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OPENGLPROGRAMCACHE_H
+#define OPENGLPROGRAMCACHE_H
+
+#include <QFuture>
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLContext>
+
+namespace olive {
+
+/**
+ * @brief Keeps linked shader program binaries on disk so they don't have to be compiled again
+ *
+ * Compiling a shader is what makes the first use of an effect hitch, and OCIO's generated shaders
+ * would otherwise be compiled again every launch. Binaries only work with the driver that made
+ * them, so they're keyed by a hash of the driver and GPU strings along with the source code, and a
+ * driver update just causes a miss.
+ */
+class OpenGLProgramCache
+{
+public:
+  /**
+   * @brief Start reading cached binaries into memory in the background
+   */
+  static void Preload();
+
+  /**
+   * @brief Whether `ctx` can load and retrieve program binaries at all
+   */
+  static bool IsSupported(QOpenGLContext* ctx);
+
+  /**
+   * @brief Key identifying a program's binary for the driver `ctx` belongs to
+   */
+  static QByteArray GetKey(QOpenGLContext* ctx, const QString& vert_code, const QString& frag_code);
+
+  /**
+   * @brief Try to load a cached binary into the empty program `program`
+   *
+   * Returns true if the program is now linked, false if it still needs to be compiled.
+   */
+  static bool Load(QOpenGLContext* ctx, GLuint program, const QByteArray& key);
+
+  /**
+   * @brief Retrieve a linked program's binary and write it to disk in the background
+   */
+  static void Save(QOpenGLContext* ctx, GLuint program, const QByteArray& key);
+
+private:
+  struct Binary {
+    GLenum format;
+    QByteArray data;
+  };
+
+  static QString GetCacheDirectory();
+
+  static void PreloadInternal();
+
+  static QMutex lock_;
+
+  static QHash<QByteArray, Binary> binaries_;
+
+  static QFuture<void> preload_future_;
+
+};
+
+}
+
+#endif // OPENGLPROGRAMCACHE_H
@@ -24,9 +24,24 @@
 #include <QDebug>
 #include <QOpenGLExtraFunctions>
 
+#include "common/tracing.h"
+#include "config/config.h"
+#include "openglprogramcache.h"
+#include "render/memorygovernor.h"
+#include "render/nodegpuprofiler.h"
+
 namespace olive {
 
 const int OpenGLRenderer::kTextureCacheMaxSize = 5000;
+const int OpenGLRenderer::kPixelBufferPoolMaxSize = 3;
+
+// Not in every GL header since it's from GL 3.3/ARB_timer_query (and EXT_disjoint_timer_query on ES)
+#ifndef GL_TIME_ELAPSED
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
 
 const QVector<GLfloat> blit_vertices = {
   -1.0f, -1.0f, 0.0f,
@@ -81,11 +96,21 @@ private:
 
 QMutex global_opengl_mutex;
 
+// Fences from SubmitTexture() by texture ID, shared by every context since they're all in one share
+// group. Guarded by global_opengl_mutex.
+QHash<GLuint, GLsync> global_texture_fences;
+
 OpenGLRenderer::OpenGLRenderer(QObject* parent) :
   Renderer(parent),
   cache_timer_(this),
   context_(nullptr),
-  framebuffer_(0)
+  framebuffer_(0),
+  texture_pool_budget_(0),
+  pool_stats_({0, 0, 0, 0, 0}),
+  timer_queries_supported_(false),
+  program_binaries_supported_(false),
+  max_texture_units_(16),
+  max_texture_size_(4096)
 {
   cache_timer_.setInterval(kTextureCacheMaxSize);
   connect(&cache_timer_, &QTimer::timeout, this, &OpenGLRenderer::GarbageCollectTextureCache);
@@ -156,6 +181,17 @@ void OpenGLRenderer::PostInit()
   // Set up framebuffer used for various things
   functions_->glGenFramebuffers(1, &framebuffer_);
 
+  texture_pool_budget_ = MemoryGovernor::GetLimit(QStringLiteral("TexturePoolSize"));
+
+  timer_queries_supported_ = context_->format().version() >= qMakePair(3, 3)
+      || context_->hasExtension(QByteArrayLiteral("GL_ARB_timer_query"))
+      || context_->hasExtension(QByteArrayLiteral("GL_EXT_disjoint_timer_query"));
+
+  program_binaries_supported_ = OpenGLProgramCache::IsSupported(context_);
+
+  functions_->glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &max_texture_units_);
+  functions_->glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size_);
+
   cache_timer_.start();
 }
 
@@ -168,10 +204,49 @@ void OpenGLRenderer::DestroyInternal()
     functions_->glDeleteFramebuffers(1, &framebuffer_);
     framebuffer_ = 0;
 
-    for (auto it=texture_cache_.cbegin(); it!=texture_cache_.cend(); it++) {
-      functions_->glDeleteTextures(1, &it->texture);
+    for (auto it=texture_pool_.cbegin(); it!=texture_pool_.cend(); it++) {
+      foreach (const TextureCacheEntry& entry, it.value()) {
+        DeleteTextureFence(entry.texture);
+        functions_->glDeleteTextures(1, &entry.texture);
+      }
+    }
+    texture_pool_.clear();
+    texture_params_.clear();
+    mipmapped_textures_.clear();
+
+    {
+      QMutexLocker locker(&pool_stats_lock_);
+      pool_stats_ = {0, 0, 0, 0, 0};
+    }
+
+    // Delete pixel buffers, including any downloads that were never collected
+    for (auto it=pending_downloads_.cbegin(); it!=pending_downloads_.cend(); it++) {
+      context_->extraFunctions()->glDeleteSync(it->fence);
+      pixel_buffer_pool_.append(it->pbo);
+    }
+    pending_downloads_.clear();
+
+    for (auto it=pending_pixel_reads_.cbegin(); it!=pending_pixel_reads_.cend(); it++) {
+      context_->extraFunctions()->glDeleteSync(it->download.fence);
+      pixel_buffer_pool_.append(it->download.pbo);
+    }
+    pending_pixel_reads_.clear();
+
+    for (auto it=pixel_buffer_pool_.cbegin(); it!=pixel_buffer_pool_.cend(); it++) {
+      functions_->glDeleteBuffers(1, &it->buffer);
+    }
+    pixel_buffer_pool_.clear();
+
+    // Delete timer queries, discarding any results that never arrived
+    foreach (const PendingTimerQuery& q, pending_timer_queries_) {
+      timer_query_pool_.append(q.query);
+    }
+    pending_timer_queries_.clear();
+
+    if (!timer_query_pool_.isEmpty()) {
+      context_->extraFunctions()->glDeleteQueries(timer_query_pool_.size(), timer_query_pool_.constData());
+      timer_query_pool_.clear();
     }
-    texture_cache_.clear();
 
     // Delete context if it belongs to us
     if (context_->parent() == this) {
@@ -215,7 +290,7 @@ QVariant OpenGLRenderer::CreateNativeTexture3D(int width, int height, int depth,
   bool new_tex = (texture == 0);
   if (new_tex) {
     functions_->glGenTextures(1, &texture);
-    texture_params_.insert(texture, {width, height, depth, format, channel_count});
+    TrackNewTexture(texture, {width, height, depth, format, channel_count});
   }
 
   if (new_tex || data) {
@@ -249,6 +324,8 @@ void OpenGLRenderer::AttachTextureAsDestination(Texture* texture)
 {
   PRINT_GL_ERRORS;
 
+  mipmapped_textures_.remove(texture->id().value<GLuint>());
+
   functions_->glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
   functions_->glFramebufferTexture2D(GL_FRAMEBUFFER,
                                      GL_COLOR_ATTACHMENT0,
@@ -262,15 +339,42 @@ void OpenGLRenderer::DetachTextureAsDestination()
   functions_->glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+void OpenGLRenderer::WaitForTexture(GLuint texture)
+{
+  GLsync fence = global_texture_fences.value(texture, nullptr);
+
+  if (fence) {
+    // Only makes this context's GPU queue wait, the CPU carries on
+    context_->extraFunctions()->glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+  }
+}
+
+void OpenGLRenderer::DeleteTextureFence(GLuint texture)
+{
+  GLsync fence = global_texture_fences.take(texture);
+
+  if (fence) {
+    context_->extraFunctions()->glDeleteSync(fence);
+  }
+}
+
 void OpenGLRenderer::DestroyNativeTexture(QVariant texture)
 {
   GLuint t = texture.value<GLuint>();
 
   if (t > 0) {
+    // Whoever takes this texture from the pool next will replace its contents
+    mipmapped_textures_.remove(t);
+
+    // Textures can be released mid-blit while the GL mutex is held, so we never delete here. If the
+    // pool is over budget, it'll be trimmed by the next allocation or garbage collection.
     TextureCacheKey key = texture_params_.value(t);
-    TextureCacheEntry entry = {key, t, QDateTime::currentMSecsSinceEpoch()};
 
-    texture_cache_.append(entry);
+    texture_pool_[key].append({t, QDateTime::currentMSecsSinceEpoch()});
+
+    QMutexLocker locker(&pool_stats_lock_);
+    pool_stats_.pooled_bytes += key.size();
+    pool_stats_.pooled_textures++;
   }
 }
 
@@ -291,6 +395,19 @@ QVariant OpenGLRenderer::CreateNativeShader(ShaderCode code)
   vert_code.prepend(shader_preamble);
   frag_code.prepend(shader_preamble);
 
+  QByteArray binary_key;
+
+  if (program_binaries_supported_ && program->create()) {
+    binary_key = OpenGLProgramCache::GetKey(context_, vert_code, frag_code);
+
+    // Linking with no shaders attached just picks up the binary's link status
+    if (OpenGLProgramCache::Load(context_, program->programId(), binary_key) && program->link()) {
+      return Node::PtrToValue(program);
+    }
+
+    context_->extraFunctions()->glProgramParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+
   if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex, vert_code)) {
     qCritical() << "Failed to add vertex code to shader";
     goto error;
@@ -306,6 +423,10 @@ QVariant OpenGLRenderer::CreateNativeShader(ShaderCode code)
     goto error;
   }
 
+  if (!binary_key.isEmpty()) {
+    OpenGLProgramCache::Save(context_, program->programId(), binary_key);
+  }
+
   return Node::PtrToValue(program);
 
 error:
@@ -327,6 +448,8 @@ void OpenGLRenderer::UploadToTexture(Texture *texture, const void *data, int lin
   GLuint t = texture->id().value<GLuint>();
   const VideoParams& p = texture->params();
 
+  mipmapped_textures_.remove(t);
+
   GLenum tex_type = texture->type() == Texture::k2D ? GL_TEXTURE_2D : GL_TEXTURE_3D;
   GLenum tex_binding = texture->type() == Texture::k2D ? GL_TEXTURE_BINDING_2D : GL_TEXTURE_BINDING_3D;
 
@@ -361,8 +484,12 @@ void OpenGLRenderer::UploadToTexture(Texture *texture, const void *data, int lin
 
 void OpenGLRenderer::DownloadFromTexture(Texture* texture, void *data, int linesize)
 {
+  TRACE_SCOPE("gpu", "OpenGLRenderer::DownloadFromTexture");
+
   GL_PREAMBLE;
 
+  WaitForTexture(texture->id().value<GLuint>());
+
   const VideoParams& p = texture->params();
 
   GLint current_tex;
@@ -390,11 +517,147 @@ void OpenGLRenderer::DownloadFromTexture(Texture* texture, void *data, int lines
   functions_->glBindTexture(GL_TEXTURE_2D, current_tex);
 }
 
+QVariant OpenGLRenderer::StartDownloadFromTexture(Texture *texture, int linesize)
+{
+  GL_PREAMBLE;
+
+  WaitForTexture(texture->id().value<GLuint>());
+
+  const VideoParams& p = texture->params();
+
+  PixelBuffer pbo = GetPixelBuffer(GLsizeiptr(linesize) * p.GetBytesPerPixel() * p.effective_height());
+
+  GLint current_tex;
+  functions_->glGetIntegerv(GL_TEXTURE_BINDING_2D, &current_tex);
+
+  AttachTextureAsDestination(texture);
+
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo.buffer);
+  functions_->glPixelStorei(GL_PACK_ROW_LENGTH, linesize);
+
+  {
+    PRINT_GL_ERRORS;
+
+    // With a pack buffer bound, this queues the transfer and returns immediately
+    functions_->glReadPixels(0,
+                             0,
+                             p.effective_width(),
+                             p.effective_height(),
+                             GetPixelFormat(p.channel_count()),
+                             GetPixelType(p.format()),
+                             nullptr);
+  }
+
+  functions_->glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  DetachTextureAsDestination();
+
+  functions_->glBindTexture(GL_TEXTURE_2D, current_tex);
+
+  GLsync fence = context_->extraFunctions()->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  // Make sure the commands are actually submitted so the transfer starts now
+  functions_->glFlush();
+
+  pending_downloads_.insert(pbo.buffer, {pbo, fence});
+
+  return pbo.buffer;
+}
+
+void OpenGLRenderer::FinishDownloadFromTexture(QVariant handle, void *data)
+{
+  GL_PREAMBLE;
+
+  PendingDownload download = pending_downloads_.take(handle.value<GLuint>());
+
+  if (!download.pbo.buffer) {
+    qCritical() << "Tried to finish a texture download that was never started";
+    return;
+  }
+
+  QOpenGLExtraFunctions* f = context_->extraFunctions();
+
+  // In most cases the transfer will have completed by now and this returns immediately
+  f->glClientWaitSync(download.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+  f->glDeleteSync(download.fence);
+
+  // Everything queued before the download has finished, so its timings are ready too
+  CollectTimerQueries();
+
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, download.pbo.buffer);
+
+  {
+    PRINT_GL_ERRORS;
+
+    void* mapped = f->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, download.pbo.size, GL_MAP_READ_BIT);
+
+    if (mapped) {
+      memcpy(data, mapped, download.pbo.size);
+      f->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    } else {
+      qCritical() << "Failed to map pixel buffer for texture download";
+    }
+  }
+
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  ReleasePixelBuffer(download.pbo);
+}
+
+OpenGLRenderer::PixelBuffer OpenGLRenderer::GetPixelBuffer(GLsizeiptr size)
+{
+  for (int i=0; i<pixel_buffer_pool_.size(); i++) {
+    if (pixel_buffer_pool_.at(i).size == size) {
+      return pixel_buffer_pool_.takeAt(i);
+    }
+  }
+
+  PixelBuffer pbo;
+  pbo.size = size;
+
+  functions_->glGenBuffers(1, &pbo.buffer);
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo.buffer);
+  functions_->glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  return pbo;
+}
+
+void OpenGLRenderer::ReleasePixelBuffer(const PixelBuffer &pbo)
+{
+  // Keep a few buffers around so consecutive frames of the same size can reuse them
+  if (pixel_buffer_pool_.size() < kPixelBufferPoolMaxSize) {
+    pixel_buffer_pool_.append(pbo);
+  } else {
+    functions_->glDeleteBuffers(1, &pbo.buffer);
+  }
+}
+
 void OpenGLRenderer::Flush()
 {
   GL_PREAMBLE;
 
   functions_->glFinish();
+
+  CollectTimerQueries();
+}
+
+void OpenGLRenderer::SubmitTexture(Texture *texture)
+{
+  GL_PREAMBLE;
+
+  GLuint t = texture->id().value<GLuint>();
+
+  // Replace any fence from an earlier submission, nothing waits on it after this point
+  DeleteTextureFence(t);
+
+  global_texture_fences.insert(t, context_->extraFunctions()->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+
+  // Other contexts can only wait on a fence once it has actually been submitted
+  functions_->glFlush();
+
+  CollectTimerQueries();
 }
 
 Color OpenGLRenderer::GetPixelFromTexture(Texture *texture, const QPointF &pt)
@@ -417,6 +680,82 @@ Color OpenGLRenderer::GetPixelFromTexture(Texture *texture, const QPointF &pt)
   return c;
 }
 
+QVariant OpenGLRenderer::StartPixelFromTexture(Texture *texture, const QPointF &pt)
+{
+  GL_PREAMBLE;
+
+  WaitForTexture(texture->id().value<GLuint>());
+
+  PixelBuffer pbo = GetPixelBuffer(VideoParams::GetBytesPerPixel(texture->format(), texture->channel_count()));
+
+  AttachTextureAsDestination(texture);
+
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo.buffer);
+
+  // With a pack buffer bound, this queues the transfer and returns immediately
+  functions_->glReadPixels(pt.x(), pt.y(), 1, 1, GetPixelFormat(texture->channel_count()), GetPixelType(texture->format()), nullptr);
+
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  DetachTextureAsDestination();
+
+  GLsync fence = context_->extraFunctions()->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  functions_->glFlush();
+
+  pending_pixel_reads_.insert(pbo.buffer, {{pbo, fence}, texture->format(), texture->channel_count()});
+
+  return pbo.buffer;
+}
+
+bool OpenGLRenderer::TryFinishPixelFromTexture(QVariant handle, Color *color)
+{
+  GL_PREAMBLE;
+
+  auto it = pending_pixel_reads_.find(handle.value<GLuint>());
+
+  if (it == pending_pixel_reads_.end()) {
+    qCritical() << "Tried to finish a pixel read that was never started";
+    return false;
+  }
+
+  QOpenGLExtraFunctions* f = context_->extraFunctions();
+
+  // Only poll the fence, the caller will try again later if the GPU hasn't got to it yet
+  GLenum status = f->glClientWaitSync(it->download.fence, 0, 0);
+  if (status == GL_TIMEOUT_EXPIRED) {
+    return false;
+  }
+
+  PendingPixelRead read = *it;
+  pending_pixel_reads_.erase(it);
+
+  f->glDeleteSync(read.download.fence);
+
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, read.download.pbo.buffer);
+
+  void* mapped = f->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, read.download.pbo.size, GL_MAP_READ_BIT);
+
+  if (mapped) {
+    *color = Color::fromData(static_cast<const char*>(mapped), read.format, read.channel_count);
+    f->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+    if (read.channel_count == VideoParams::kRGBChannelCount) {
+      // No alpha channel, set to 1.0
+      color->set_alpha(1.0);
+    }
+  } else {
+    qCritical() << "Failed to map pixel buffer for pixel read";
+    *color = Color();
+  }
+
+  functions_->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  ReleasePixelBuffer(read.download.pbo);
+
+  return true;
+}
+
 struct TextureToBind {
   TexturePtr texture;
   Texture::Interpolation interpolation;
@@ -424,8 +763,14 @@ struct TextureToBind {
 
 void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, VideoParams destination_params, bool clear_destination)
 {
+  TRACE_SCOPE("gpu", "OpenGLRenderer::Blit");
+
   GL_PREAMBLE;
 
+  CollectTimerQueries();
+
+  GLuint timer_query = BeginTimerQuery(job);
+
   // If this node is iterative, we'll pick up which input here
   QString iterative_name;
   GLuint iterative_input = 0;
@@ -508,6 +853,13 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
         shader->setUniformValue(enable_param_location,
                                 tex_id > 0);
       }
+
+      // Tiled shaders need to know which part of the frame this texture holds
+      int tile_param_location = shader->uniformLocation(QStringLiteral("ove_tile_%1").arg(it.key()));
+      if (tile_param_location > -1) {
+        QRectF region = texture ? texture->region() : QRectF(0, 0, 1, 1);
+        shader->setUniformValue(tile_param_location, QVector4D(region.x(), region.y(), region.width(), region.height()));
+      }
       break;
     }
     case NodeValue::kSamples:
@@ -536,15 +888,27 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
     functions_->glActiveTexture(GL_TEXTURE0 + i);
 
     GLenum target = (texture && texture->type() == Texture::k3D) ? GL_TEXTURE_3D : GL_TEXTURE_2D;
+    WaitForTexture(tex_id);
     functions_->glBindTexture(target, tex_id);
 
-    PrepareInputTexture(target, t.interpolation);
+    PrepareInputTexture(target, tex_id, t.interpolation);
   }
 
   // Ensure matrix is set, at least to identity
   shader->setUniformValue("ove_mvpmat",
                           job.GetValue(QStringLiteral("ove_mvpmat")).data().value<QMatrix4x4>());
 
+  // Tiled shaders draw the whole frame, this moves the part the destination holds into the viewport
+  QRectF destination_region = destination ? destination->region() : QRectF(0, 0, 1, 1);
+  int tile_matrix_location = shader->uniformLocation("ove_tilemat");
+  if (tile_matrix_location > -1) {
+    QMatrix4x4 tile_matrix;
+    tile_matrix.translate((1.0 - 2.0 * destination_region.x()) / destination_region.width() - 1.0,
+                          (1.0 - 2.0 * destination_region.y()) / destination_region.height() - 1.0);
+    tile_matrix.scale(1.0 / destination_region.width(), 1.0 / destination_region.height());
+    shader->setUniformValue(tile_matrix_location, tile_matrix);
+  }
+
   // Set the viewport to the "physical" resolution of the destination
   functions_->glViewport(0, 0,
                          destination_params.effective_width(),
@@ -590,6 +954,18 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
   // - If there are more than two iterations, we need to ping pong back and forth between two
   //   textures. We can still use the destination as the last iteration, but we'll need textures
   //   for the iterative process.
+  // Textures are stored top row first, so the normalized region maps to GL's bottom-left origin
+  // without flipping
+  QRect scissor;
+  if (!job.GetScissor().isNull()) {
+    scissor = QRectF(job.GetScissor().x() * destination_params.effective_width(),
+                     job.GetScissor().y() * destination_params.effective_height(),
+                     job.GetScissor().width() * destination_params.effective_width(),
+                     job.GetScissor().height() * destination_params.effective_height()).toAlignedRect();
+    scissor &= QRect(0, 0, destination_params.effective_width(), destination_params.effective_height());
+  }
+  bool scissor_test = !scissor.isNull();
+
   int real_iteration_count;
   if (job.GetIterationCount() > 1 && !job.GetIterativeInput().isEmpty()) {
     real_iteration_count = job.GetIterationCount();
@@ -624,9 +1000,15 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
       }
 
       // Clear the destination if the caller requested it
-      if (clear_destination) {
+      if (clear_destination || scissor_test) {
         ClearDestinationInternal();
       }
+
+      if (scissor_test) {
+        // Only shade the requested region, the rest stays cleared
+        functions_->glEnable(GL_SCISSOR_TEST);
+        functions_->glScissor(scissor.x(), scissor.y(), scissor.width(), scissor.height());
+      }
     } else {
       // Always draw to output_tex, which gets swapped with input_tex every iteration
       AttachTextureAsDestination(output_tex.get());
@@ -639,7 +1021,14 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
       functions_->glBindTexture(GL_TEXTURE_2D, input_tex->id().value<GLuint>());
 
       // At this time, we only support iterating 2D textures
-      PrepareInputTexture(GL_TEXTURE_2D, job.GetInterpolation(iterative_name));
+      PrepareInputTexture(GL_TEXTURE_2D, input_tex->id().value<GLuint>(), job.GetInterpolation(iterative_name));
+
+      // Bounce textures hold the same part of the frame as the destination
+      int tile_param_location = shader->uniformLocation(QStringLiteral("ove_tile_%1").arg(iterative_name));
+      if (tile_param_location > -1) {
+        shader->setUniformValue(tile_param_location, QVector4D(destination_region.x(), destination_region.y(),
+                                                               destination_region.width(), destination_region.height()));
+      }
     }
 
     // Swap so that the next iteration, the texture we draw now will be the input texture next
@@ -652,11 +1041,17 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
     }
   }
 
+  if (scissor_test) {
+    functions_->glDisable(GL_SCISSOR_TEST);
+  }
+
   if (destination) {
     // Reset framebuffer to default if we were drawing to a texture
     DetachTextureAsDestination();
   }
 
+  EndTimerQuery(timer_query, job);
+
   // Release any textures we bound before
   for (int i=textures_to_bind.size()-1; i>=0; i--) {
     TexturePtr texture = textures_to_bind.at(i).texture;
@@ -675,6 +1070,67 @@ void OpenGLRenderer::Blit(QVariant s, ShaderJob job, Texture *destination, Video
   vao_.destroy();
 }
 
+GLuint OpenGLRenderer::BeginTimerQuery(const ShaderJob &job)
+{
+  if (!timer_queries_supported_ || !job.GetProfileNode() || !NodeGpuProfiler::IsEnabled()) {
+    return 0;
+  }
+
+  QOpenGLExtraFunctions* f = context_->extraFunctions();
+
+  GLuint query;
+  if (timer_query_pool_.isEmpty()) {
+    f->glGenQueries(1, &query);
+  } else {
+    query = timer_query_pool_.takeLast();
+  }
+
+  f->glBeginQuery(GL_TIME_ELAPSED, query);
+
+  return query;
+}
+
+void OpenGLRenderer::EndTimerQuery(GLuint query, const ShaderJob &job)
+{
+  if (!query) {
+    return;
+  }
+
+  context_->extraFunctions()->glEndQuery(GL_TIME_ELAPSED);
+
+  // Only the ID is kept since the node may be gone by the time the result arrives
+  const Node* node = job.GetProfileNode();
+  pending_timer_queries_.append({query, node, node->id()});
+}
+
+void OpenGLRenderer::CollectTimerQueries()
+{
+  QOpenGLExtraFunctions* f = context_->extraFunctions();
+
+  int collected = 0;
+
+  for (; collected<pending_timer_queries_.size(); collected++) {
+    const PendingTimerQuery& q = pending_timer_queries_.at(collected);
+
+    GLuint available = GL_FALSE;
+    f->glGetQueryObjectuiv(q.query, GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if (!available) {
+      break;
+    }
+
+    // 32 bits of nanoseconds is over 4 seconds, far more than any single blit
+    GLuint elapsed = 0;
+    f->glGetQueryObjectuiv(q.query, GL_QUERY_RESULT, &elapsed);
+
+    NodeGpuProfiler::AddSample(q.node, q.node_id, elapsed);
+
+    timer_query_pool_.append(q.query);
+  }
+
+  pending_timer_queries_.remove(0, collected);
+}
+
 GLint OpenGLRenderer::GetInternalFormat(VideoParams::Format format, int channel_layout)
 {
   switch (format) {
@@ -768,7 +1224,7 @@ GLenum OpenGLRenderer::GetPixelFormat(int channel_count)
   }
 }
 
-void OpenGLRenderer::PrepareInputTexture(GLenum target, Texture::Interpolation interp)
+void OpenGLRenderer::PrepareInputTexture(GLenum target, GLuint texture, Texture::Interpolation interp)
 {
   switch (interp) {
   case Texture::kNearest:
@@ -780,7 +1236,12 @@ void OpenGLRenderer::PrepareInputTexture(GLenum target, Texture::Interpolation i
     functions_->glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     break;
   case Texture::kMipmappedLinear:
-    functions_->glGenerateMipmap(target);
+    // Sources are often sampled many times between writes (the same footage in several clips or
+    // every iteration of a job), so only regenerate mipmaps after the texture has changed
+    if (texture > 0 && !mipmapped_textures_.contains(texture)) {
+      functions_->glGenerateMipmap(target);
+      mipmapped_textures_.insert(texture);
+    }
     functions_->glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     functions_->glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     break;
@@ -804,7 +1265,7 @@ QVariant OpenGLRenderer::CreateNativeTexture2DInternal(int width, int height, Vi
   bool new_tex = (texture == 0);
   if (new_tex) {
     functions_->glGenTextures(1, &texture);
-    texture_params_.insert(texture, {width, height, 1, format, channel_count});
+    TrackNewTexture(texture, {width, height, 1, format, channel_count});
   }
 
   if (new_tex || data) {
@@ -846,35 +1307,116 @@ GLuint OpenGLRenderer::GetCachedTexture(int width, int height, int depth, VideoP
 {
   TextureCacheKey input_key = {width, height, depth, format, channel_count};
 
-  for (int i=0; i<texture_cache_.size(); i++) {
-    const TextureCacheEntry &entry = texture_cache_.at(i);
+  auto bucket = texture_pool_.find(input_key);
 
-    if (entry.key == input_key) {
-      GLuint t = entry.texture;
+  if (bucket != texture_pool_.end() && !bucket->isEmpty()) {
+    // Take the most recently released texture, it's the most likely to still be resident
+    GLuint t = bucket->takeLast().texture;
 
-      texture_cache_.removeAt(i);
+    QMutexLocker locker(&pool_stats_lock_);
+    pool_stats_.pooled_bytes -= input_key.size();
+    pool_stats_.pooled_textures--;
+    pool_stats_.hits++;
 
-      return t;
-    }
+    return t;
+  }
+
+  {
+    QMutexLocker locker(&pool_stats_lock_);
+    pool_stats_.misses++;
   }
 
+  // Caller will allocate a new texture, make room for it first
+  EvictToFit(input_key.size());
+
   return 0;
 }
 
+void OpenGLRenderer::TrackNewTexture(GLuint texture, const TextureCacheKey &key)
+{
+  texture_params_.insert(texture, key);
+
+  QMutexLocker locker(&pool_stats_lock_);
+  pool_stats_.allocated_bytes += key.size();
+}
+
+void OpenGLRenderer::DeletePooledTexture(const TextureCacheKey &key)
+{
+  auto bucket = texture_pool_.find(key);
+
+  GLuint t = bucket->takeFirst().texture;
+  if (bucket->isEmpty()) {
+    texture_pool_.erase(bucket);
+  }
+
+  texture_params_.remove(t);
+  DeleteTextureFence(t);
+  functions_->glDeleteTextures(1, &t);
+
+  qint64 sz = key.size();
+
+  QMutexLocker locker(&pool_stats_lock_);
+  pool_stats_.allocated_bytes -= sz;
+  pool_stats_.pooled_bytes -= sz;
+  pool_stats_.pooled_textures--;
+}
+
+void OpenGLRenderer::EvictToFit(qint64 size)
+{
+  if (texture_pool_budget_ <= 0) {
+    return;
+  }
+
+  while (true) {
+    {
+      QMutexLocker locker(&pool_stats_lock_);
+      if (pool_stats_.allocated_bytes + size <= texture_pool_budget_ || pool_stats_.pooled_textures == 0) {
+        break;
+      }
+    }
+
+    // Find the bucket holding the oldest texture. Buckets are few compared to textures, and each
+    // one is sorted oldest first, so only their heads need comparing.
+    auto oldest = texture_pool_.end();
+    for (auto it=texture_pool_.begin(); it!=texture_pool_.end(); it++) {
+      if (!it->isEmpty() && (oldest == texture_pool_.end() || it->first().age < oldest->first().age)) {
+        oldest = it;
+      }
+    }
+
+    if (oldest == texture_pool_.end()) {
+      break;
+    }
+
+    DeletePooledTexture(oldest.key());
+  }
+}
+
+OpenGLRenderer::TexturePoolStats OpenGLRenderer::GetTexturePoolStats() const
+{
+  QMutexLocker locker(&pool_stats_lock_);
+  return pool_stats_;
+}
+
 void OpenGLRenderer::GarbageCollectTextureCache()
 {
+  GL_PREAMBLE;
+
+  // Pick up any change to the budget from the preferences or the memory governor
+  texture_pool_budget_ = MemoryGovernor::GetLimit(QStringLiteral("TexturePoolSize"));
+
   qint64 max_age = QDateTime::currentMSecsSinceEpoch() - kTextureCacheMaxSize;
-  for (auto it=texture_cache_.begin(); it!=texture_cache_.end(); ) {
-    if (it->age < max_age) {
-      GL_PREAMBLE;
-      GLuint t = it->texture;
-      texture_params_.remove(t);
-      functions_->glDeleteTextures(1, &t);
-      it = texture_cache_.erase(it);
-    } else {
-      it++;
+
+  QVector<TextureCacheKey> keys = texture_pool_.keys().toVector();
+  foreach (const TextureCacheKey& key, keys) {
+    for (auto bucket=texture_pool_.constFind(key);
+         bucket != texture_pool_.constEnd() && bucket->first().age < max_age;
+         bucket=texture_pool_.constFind(key)) {
+      DeletePooledTexture(key);
     }
   }
+
+  EvictToFit(0);
 }
 
 }
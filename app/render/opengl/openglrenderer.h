@@ -21,11 +21,14 @@
 #ifndef OPENGLCONTEXT_H
 #define OPENGLCONTEXT_H
 
+#include <QMutex>
 #include <QOffscreenSurface>
 #include <QOpenGLBuffer>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLFunctions>
 #include <QOpenGLShader>
 #include <QOpenGLVertexArrayObject>
+#include <QSet>
 #include <QThread>
 #include <QTimer>
 
@@ -67,10 +70,32 @@ public slots:
 
   virtual void DownloadFromTexture(olive::Texture* texture, void* data, int linesize) override;
 
+  virtual QVariant StartDownloadFromTexture(olive::Texture* texture, int linesize) override;
+
+  virtual void FinishDownloadFromTexture(QVariant handle, void* data) override;
+
   virtual void Flush() override;
 
+  virtual void SubmitTexture(olive::Texture* texture) override;
+
   virtual Color GetPixelFromTexture(olive::Texture *texture, const QPointF &pt) override;
 
+  virtual QVariant StartPixelFromTexture(olive::Texture *texture, const QPointF &pt) override;
+
+  virtual bool TryFinishPixelFromTexture(QVariant handle, olive::Color* color) override;
+
+  virtual TexturePoolStats GetTexturePoolStats() const override;
+
+  virtual int GetMaximumTextureUnits() const override
+  {
+    return max_texture_units_;
+  }
+
+  virtual int GetMaximumTextureSize() const override
+  {
+    return max_texture_size_;
+  }
+
 protected slots:
   virtual void Blit(QVariant shader,
                     olive::ShaderJob job,
@@ -89,7 +114,11 @@ private:
 
   void DetachTextureAsDestination();
 
-  void PrepareInputTexture(GLenum target, Texture::Interpolation interp);
+  void WaitForTexture(GLuint texture);
+
+  void DeleteTextureFence(GLuint texture);
+
+  void PrepareInputTexture(GLenum target, GLuint texture, Texture::Interpolation interp);
 
   void ClearDestinationInternal(double r = 0.0, double g = 0.0, double b = 0.0, double a = 0.0);
 
@@ -98,6 +127,20 @@ private:
 
   GLuint GetCachedTexture(int width, int height, int depth, VideoParams::Format format, int channel_count);
 
+  /**
+   * @brief Start timing a blit's GPU work if its node is being profiled, returns 0 if not
+   */
+  GLuint BeginTimerQuery(const ShaderJob& job);
+
+  void EndTimerQuery(GLuint query, const ShaderJob& job);
+
+  /**
+   * @brief Report timer queries whose results have arrived to NodeGpuProfiler
+   *
+   * Results arrive in order, so this stops at the first one that isn't ready rather than stalling.
+   */
+  void CollectTimerQueries();
+
   QTimer cache_timer_;
 
   QOpenGLContext* context_;
@@ -120,20 +163,97 @@ private:
       return width == rhs.width && height == rhs.height && depth == rhs.depth
           && format == rhs.format && channel_count == rhs.channel_count;
     }
+
+    qint64 size() const
+    {
+      return qint64(VideoParams::GetBufferSize(width, height, format, channel_count)) * depth;
+    }
+
+    friend uint qHash(const TextureCacheKey &key, uint seed = 0)
+    {
+      return ::qHash(key.width, seed) ^ ::qHash(key.height, seed << 1) ^ ::qHash(key.depth, seed << 2)
+          ^ ::qHash(int(key.format), seed << 3) ^ ::qHash(key.channel_count, seed << 4);
+    }
   };
 
   struct TextureCacheEntry {
-    TextureCacheKey key;
     GLuint texture;
     qint64 age;
   };
 
-  QVector<TextureCacheEntry> texture_cache_;
+  void TrackNewTexture(GLuint texture, const TextureCacheKey& key);
+
+  void DeletePooledTexture(const TextureCacheKey& key);
+
+  /**
+   * @brief Delete the oldest pooled textures until `size` more bytes fit in the VRAM budget
+   *
+   * Textures that are in use are never touched, so this can't guarantee the budget is met.
+   */
+  void EvictToFit(qint64 size);
+
+  /// Idle textures bucketed by their parameters, oldest first in each bucket
+  QHash<TextureCacheKey, QVector<TextureCacheEntry> > texture_pool_;
+
+  QHash<GLuint, TextureCacheKey> texture_params_;
+
+  /// Textures whose mipmaps match their contents, forgotten whenever a texture is written to
+  QSet<GLuint> mipmapped_textures_;
 
-  QMap<GLuint, TextureCacheKey> texture_params_;
+  qint64 texture_pool_budget_;
+
+  TexturePoolStats pool_stats_;
+
+  mutable QMutex pool_stats_lock_;
 
   static const int kTextureCacheMaxSize;
 
+  struct PixelBuffer {
+    GLuint buffer;
+    GLsizeiptr size;
+  };
+
+  struct PendingDownload {
+    PixelBuffer pbo;
+    GLsync fence;
+  };
+
+  PixelBuffer GetPixelBuffer(GLsizeiptr size);
+
+  void ReleasePixelBuffer(const PixelBuffer& pbo);
+
+  QVector<PixelBuffer> pixel_buffer_pool_;
+
+  QHash<GLuint, PendingDownload> pending_downloads_;
+
+  struct PendingPixelRead {
+    PendingDownload download;
+    VideoParams::Format format;
+    int channel_count;
+  };
+
+  QHash<GLuint, PendingPixelRead> pending_pixel_reads_;
+
+  struct PendingTimerQuery {
+    GLuint query;
+    const Node* node;
+    QString node_id;
+  };
+
+  bool timer_queries_supported_;
+
+  QVector<PendingTimerQuery> pending_timer_queries_;
+
+  QVector<GLuint> timer_query_pool_;
+
+  bool program_binaries_supported_;
+
+  GLint max_texture_units_;
+
+  GLint max_texture_size_;
+
+  static const int kPixelBufferPoolMaxSize;
+
 private slots:
   void GarbageCollectTextureCache();
 
@@ -0,0 +1,179 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PLANARYUV_H
+#define PLANARYUV_H
+
+#include <QMetaType>
+
+#include "render/videoparams.h"
+
+namespace olive {
+
+/**
+ * @brief Describes frames that hold planar YUV rather than RGB(A)
+ *
+ * Renders can pack their output into this layout on the GPU so exports download (and encoders
+ * receive) far less data than full RGBA, and decoders can hand footage over in it so the matrix
+ * conversion happens on the GPU instead. All planes live in one single channel buffer sharing one
+ * linesize: the luma plane's rows first, then rows holding the Cb plane on the left and the Cr plane
+ * directly to its right. Only horizontally subsampled layouts fit side by side, so 4:4:4 isn't
+ * supported.
+ *
+ * Packing always produces limited range, full range is only ever read.
+ */
+class PlanarYUV
+{
+public:
+  enum Matrix {
+    kRec601,
+    kRec709,
+    kRec2020
+  };
+
+  enum Subsampling {
+    kNoLayout,
+    k420,
+    k422
+  };
+
+  PlanarYUV() :
+    matrix_(kRec709),
+    subsampling_(kNoLayout),
+    bit_depth_(8),
+    full_range_(false)
+  {
+  }
+
+  PlanarYUV(Matrix matrix, Subsampling subsampling, int bit_depth, bool full_range = false) :
+    matrix_(matrix),
+    subsampling_(subsampling),
+    bit_depth_(bit_depth),
+    full_range_(full_range)
+  {
+  }
+
+  bool IsValid() const
+  {
+    return subsampling_ != kNoLayout;
+  }
+
+  Matrix matrix() const
+  {
+    return matrix_;
+  }
+
+  Subsampling subsampling() const
+  {
+    return subsampling_;
+  }
+
+  /**
+   * @brief Significant bits per sample, 8 bit samples are stored in bytes and anything higher in
+   * the low bits of 16-bit words
+   *
+   * Samples stored in the high bits (e.g. P010) can be described as 16-bit, since their code values
+   * are just scaled up.
+   */
+  int bit_depth() const
+  {
+    return bit_depth_;
+  }
+
+  /**
+   * @brief Whether code values span the whole sample range rather than broadcast limited range
+   */
+  bool full_range() const
+  {
+    return full_range_;
+  }
+
+  VideoParams::Format format() const
+  {
+    return bit_depth_ > 8 ? VideoParams::kFormatUnsigned16 : VideoParams::kFormatUnsigned8;
+  }
+
+  int chroma_width(int width) const
+  {
+    return width / 2;
+  }
+
+  int chroma_height(int height) const
+  {
+    return subsampling_ == k420 ? height / 2 : height;
+  }
+
+  /**
+   * @brief Whether a frame of this size can be packed, subsampled dimensions must be even
+   */
+  bool SupportsSize(int width, int height) const
+  {
+    return IsValid() && width % 2 == 0 && (subsampling_ != k420 || height % 2 == 0);
+  }
+
+  /**
+   * @brief Height of the single buffer holding every plane
+   */
+  int packed_height(int height) const
+  {
+    return height + chroma_height(height);
+  }
+
+  /**
+   * @brief Height of the picture held in a packed buffer `packed_height` rows high
+   */
+  int picture_height(int packed_height) const
+  {
+    return subsampling_ == k420 ? packed_height * 2 / 3 : packed_height / 2;
+  }
+
+  /**
+   * @brief Luma coefficients of red and blue for this matrix (green is the remainder)
+   */
+  void GetCoefficients(double* kr, double* kb) const
+  {
+    if (matrix_ == kRec601) {
+      *kr = 0.299;
+      *kb = 0.114;
+    } else if (matrix_ == kRec2020) {
+      *kr = 0.2627;
+      *kb = 0.0593;
+    } else {
+      *kr = 0.2126;
+      *kb = 0.0722;
+    }
+  }
+
+private:
+  Matrix matrix_;
+
+  Subsampling subsampling_;
+
+  int bit_depth_;
+
+  bool full_range_;
+
+};
+
+}
+
+Q_DECLARE_METATYPE(olive::PlanarYUV)
+
+#endif // PLANARYUV_H
@@ -27,6 +27,9 @@
 
 namespace olive {
 
+int PlaybackCache::batch_depth_ = 0;
+QVector< QPointer<PlaybackCache> > PlaybackCache::batched_caches_;
+
 void PlaybackCache::Invalidate(const TimeRange &r, qint64 job_time)
 {
   if (r.in() == r.out()) {
@@ -34,6 +37,16 @@ void PlaybackCache::Invalidate(const TimeRange &r, qint64 job_time)
     return;
   }
 
+  if (batch_depth_ > 0) {
+    if (batch_invalidated_.isEmpty()) {
+      batched_caches_.append(this);
+    }
+
+    batch_invalidated_.insert(r);
+    batch_job_time_ = qMax(batch_job_time_, job_time);
+    return;
+  }
+
   invalidated_.insert(r);
 
   RemoveRangeFromJobs(r);
@@ -107,6 +120,25 @@ void PlaybackCache::Shift(rational from, rational to)
 
   qDebug() << "FIXME: 0 job time may cause cache desyncs";
 
+  if (!batch_invalidated_.isEmpty()) {
+    // Held ranges are in pre-shift time, move them the same way the cache is about to move
+    TimeRangeList shifted;
+    rational splice_point = qMin(from, to);
+
+    foreach (const TimeRange& r, batch_invalidated_) {
+      if (r.in() < splice_point) {
+        shifted.insert(TimeRange(r.in(), qMin(r.out(), splice_point)));
+      }
+
+      if (r.out() > from) {
+        shifted.insert(TimeRange(qMax(r.in(), from) + (to - from),
+                                 (r.out() == RATIONAL_MAX) ? RATIONAL_MAX : r.out() + (to - from)));
+      }
+    }
+
+    batch_invalidated_ = shifted;
+  }
+
   // An region between `from` and `to` will be inserted or spliced out
   TimeRangeList ranges_to_shift = invalidated_.Intersects(TimeRange(from, RATIONAL_MAX));
 
@@ -135,6 +167,48 @@ void PlaybackCache::Shift(rational from, rational to)
   emit Shifted(from, to);
 }
 
+void PlaybackCache::BeginBatch()
+{
+  batch_depth_++;
+}
+
+void PlaybackCache::EndBatch()
+{
+  batch_depth_--;
+
+  if (batch_depth_ > 0) {
+    return;
+  }
+
+  QVector< QPointer<PlaybackCache> > caches = batched_caches_;
+  batched_caches_.clear();
+
+  foreach (const QPointer<PlaybackCache>& c, caches) {
+    // Caches may have been deleted by the edit that invalidated them
+    if (c) {
+      c->FlushBatch();
+    }
+  }
+}
+
+void PlaybackCache::FlushBatch()
+{
+  TimeRangeList ranges = batch_invalidated_;
+  qint64 job_time = batch_job_time_;
+
+  batch_invalidated_.clear();
+  batch_job_time_ = 0;
+
+  foreach (const TimeRange& r, ranges) {
+    // The cache may have become shorter since these were sent
+    TimeRange limited(qMax(rational(0), r.in()), qMin(length_, r.out()));
+
+    if (limited.in() < limited.out()) {
+      Invalidate(limited, job_time);
+    }
+  }
+}
+
 void PlaybackCache::Validate(const TimeRange &r)
 {
   invalidated_.remove(r);
@@ -142,6 +216,63 @@ void PlaybackCache::Validate(const TimeRange &r)
   emit Validated(r);
 }
 
+void PlaybackCache::SaveState(QDataStream &s, const QDir &)
+{
+  s << length_.toString() << qint32(invalidated_.size());
+
+  foreach (const TimeRange& r, invalidated_) {
+    s << r.in().toString() << r.out().toString();
+  }
+}
+
+bool PlaybackCache::RestoreState(QDataStream &s, const QDir &)
+{
+  TimeRangeList invalidated;
+
+  if (!ReadState(s, &invalidated)) {
+    return false;
+  }
+
+  ApplyRestoredState(invalidated);
+
+  return true;
+}
+
+bool PlaybackCache::ReadState(QDataStream &s, TimeRangeList *invalidated) const
+{
+  QString length;
+  qint32 count;
+
+  s >> length >> count;
+
+  if (s.status() != QDataStream::Ok || rational::fromString(length) != length_ || count < 0) {
+    return false;
+  }
+
+  for (qint32 i=0; i<count && s.status() == QDataStream::Ok; i++) {
+    QString in, out;
+    s >> in >> out;
+    invalidated->insert(TimeRange(rational::fromString(in), rational::fromString(out)));
+  }
+
+  return s.status() == QDataStream::Ok;
+}
+
+void PlaybackCache::ApplyRestoredState(const TimeRangeList &invalidated)
+{
+  if (length_.isNull()) {
+    return;
+  }
+
+  TimeRangeList valid = {TimeRange(0, length_)};
+  valid.subtract(invalidated);
+
+  foreach (const TimeRange& r, valid) {
+    RemoveRangeFromJobs(r);
+    Validate(r);
+  }
+}
+
 void PlaybackCache::LengthChangedEvent(const rational &, const rational &)
 {
 }
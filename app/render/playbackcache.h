@@ -21,8 +21,11 @@
 #ifndef PLAYBACKCACHE_H
 #define PLAYBACKCACHE_H
 
+#include <QDataStream>
+#include <QDir>
 #include <QMutex>
 #include <QObject>
+#include <QPointer>
 
 #include "common/timerange.h"
 
@@ -36,7 +39,8 @@ class PlaybackCache : public QObject
 public:
   PlaybackCache(QObject* parent = nullptr) :
     QObject(parent),
-    length_(0)
+    length_(0),
+    batch_job_time_(0)
   {
   }
 
@@ -62,6 +66,35 @@ public:
 
   QString GetCacheDirectory() const;
 
+  /**
+   * @brief Hold invalidations of every cache until the outermost EndBatch()
+   *
+   * Edits that touch many tracks (e.g. ripples) invalidate overlapping ranges once per track, each
+   * removing hashes and signalling every listener. While a batch is open, each cache merges what
+   * it's sent and applies it once at the end. Shifts still apply immediately and move the held
+   * ranges with them, so cached frames that only moved are kept.
+   *
+   * Batches are not thread-safe and must only be used from the main thread.
+   */
+  static void BeginBatch();
+  static void EndBatch();
+
+  /**
+   * @brief Write this cache's state so a later session can pick it up with RestoreState()
+   *
+   * Any files the state needs besides what's written to `s` are put in `file_dir`. Caches may move
+   * their own files there, so this should only be called just before the cache is destroyed.
+   */
+  virtual void SaveState(QDataStream& s, const QDir& file_dir);
+
+  /**
+   * @brief Restore state written by SaveState() in an earlier session
+   *
+   * Only valid if whatever this cache renders hasn't changed since. Returns FALSE and leaves the
+   * cache as it was if the state doesn't fit it (e.g. it's a different length now).
+   */
+  virtual bool RestoreState(QDataStream& s, const QDir& file_dir);
+
 public slots:
   void Invalidate(const TimeRange& r, qint64 job_time);
 
@@ -83,6 +116,16 @@ signals:
 protected:
   void Validate(const TimeRange& r);
 
+  /**
+   * @brief Read the state PlaybackCache::SaveState() wrote, returning FALSE if it doesn't fit
+   */
+  bool ReadState(QDataStream& s, TimeRangeList* invalidated) const;
+
+  /**
+   * @brief Validate everything except `invalidated`, used when restoring state
+   */
+  void ApplyRestoredState(const TimeRangeList& invalidated);
+
   virtual void LengthChangedEvent(const rational& old, const rational& newlen);
 
   virtual void InvalidateEvent(const TimeRange& range);
@@ -101,10 +144,18 @@ protected:
 private:
   void RemoveRangeFromJobs(const TimeRange& remove);
 
+  void FlushBatch();
+
   TimeRangeList invalidated_;
 
   rational length_;
 
+  TimeRangeList batch_invalidated_;
+  qint64 batch_job_time_;
+
+  static int batch_depth_;
+  static QVector< QPointer<PlaybackCache> > batched_caches_;
+
 };
 
 }
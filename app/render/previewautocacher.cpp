@@ -4,24 +4,39 @@
 #include <QtConcurrent/QtConcurrent>
 
 #include "codec/conformmanager.h"
+#include "common/metrics.h"
+#include "common/tracing.h"
+#include "node/block/clip/clip.h"
+#include "node/inputdragger.h"
 #include "node/project/project.h"
+#include "node/project/sequence/sequence.h"
+#include "render/nodegpuprofiler.h"
 #include "render/rendermanager.h"
 #include "render/renderprocessor.h"
 
 namespace olive {
 
+const int PreviewAutoCacher::kMaximumSnapshots = 3;
+QHash<ViewerOutput*, PreviewAutoCacher*> PreviewAutoCacher::instances_;
+const rational PreviewAutoCacher::kPredictionRange = rational(2);
+const double PreviewAutoCacher::kRealtimeFraction = 0.5;
+
+const int PreviewAutoCacher::kRenderBatchSize = 4;
+const int PreviewAutoCacher::kMaximumRecordedHashes = 100000;
+
 PreviewAutoCacher::PreviewAutoCacher() :
   viewer_node_(nullptr),
+  current_snapshot_(nullptr),
   has_changed_(false),
   use_custom_range_(false),
-  single_frame_render_(nullptr),
-  last_update_time_(0),
   ignore_next_mouse_button_(false),
-  last_conform_task_(0)
+  last_conform_task_(0),
+  published_hash_tasks_(0),
+  published_video_tasks_(0),
+  published_video_download_tasks_(0)
 {
-  paused_ = !Config::Current()[QStringLiteral("AutoCacheEnabled")].toBool(),
-
-  SetPlayhead(0);
+  // Nothing to cache for until something subscribes
+  paused_ = true;
 
   delayed_requeue_timer_.setInterval(Config::Current()[QStringLiteral("AutoCacheDelay")].toInt());
   delayed_requeue_timer_.setSingleShot(true);
@@ -34,14 +49,66 @@ PreviewAutoCacher::~PreviewAutoCacher()
 {
   // Ensure everything is cleaned up appropriately
   SetViewerNode(nullptr);
+
+  PublishQueueLengths();
 }
 
-RenderTicketPtr PreviewAutoCacher::GetSingleFrame(const rational &t, bool prioritize)
+PreviewAutoCacher *PreviewAutoCacher::Subscribe(ViewerOutput *viewer_node, QObject *subscriber, bool paused)
 {
-  CancelQueuedSingleFrameRender();
+  PreviewAutoCacher* cacher = instances_.value(viewer_node);
+
+  if (!cacher) {
+    cacher = new PreviewAutoCacher();
+    cacher->SetViewerNode(viewer_node);
+    instances_.insert(viewer_node, cacher);
+  }
 
+  Subscriber s;
+  s.playhead = 0;
+  s.paused = paused;
+  s.single_frame_watcher = nullptr;
+  cacher->subscribers_.insert(subscriber, s);
+
+  cacher->SetPlayhead(subscriber, 0);
+
+  return cacher;
+}
+
+void PreviewAutoCacher::Unsubscribe(PreviewAutoCacher *cacher, QObject *subscriber)
+{
+  if (!cacher->subscribers_.contains(subscriber)) {
+    return;
+  }
+
+  if (cacher->subscribers_.size() == 1) {
+    // Last one out, which also cancels everything still queued
+    instances_.remove(cacher->viewer_node_);
+    delete cacher;
+    return;
+  }
+
+  cacher->CancelQueuedSingleFrameRender(&cacher->subscribers_[subscriber]);
+  cacher->ClearSubscriberQueue(subscriber);
+  cacher->subscribers_.remove(subscriber);
+
+  cacher->UpdateCacheRanges();
+  cacher->RequeueFrames();
+}
+
+PreviewAutoCacher *PreviewAutoCacher::Get(ViewerOutput *viewer_node)
+{
+  return instances_.value(viewer_node);
+}
+
+RenderTicketPtr PreviewAutoCacher::GetSingleFrame(QObject *subscriber, const rational &t, bool prioritize, const QRectF &roi, int divider, bool keyframes_only)
+{
+  Subscriber& s = subscribers_[subscriber];
+
+  CancelQueuedSingleFrameRender(&s);
+
+  // A partial or degraded frame can't stand in for the full one, so don't let it near the caches
   QByteArray hash;
-  if (!paused_) {
+  if (!s.paused && roi.isNull() && !divider && !keyframes_only) {
     hash = viewer_node_->video_frame_cache()->GetHash(t);
   }
 
@@ -50,32 +117,88 @@ RenderTicketPtr PreviewAutoCacher::GetSingleFrame(const rational &t, bool priori
   sfr->setProperty("time", QVariant::fromValue(t));
   sfr->setProperty("prioritize", prioritize);
   sfr->setProperty("hash", hash);
+  sfr->setProperty("roi", roi);
+  sfr->setProperty("divider", divider);
+  sfr->setProperty("keyframesonly", keyframes_only);
+  sfr->setProperty("subscriber", QVariant::fromValue(subscriber));
 
   // Attempt to queue
-  single_frame_render_ = sfr;
+  s.single_frame_render = sfr;
   TryRender();
 
   return sfr;
 }
 
-void PreviewAutoCacher::SetPaused(bool paused)
+RenderTicketPtr PreviewAutoCacher::GetThumbnail(Node *node, const rational &time, int height, const QString &cache_file)
+{
+  if (!viewer_node_ || !current_snapshot_ || HasPendingGraphUpdates()) {
+    // Our copy is behind the graph, TryRender() will bring it up to date
+    return nullptr;
+  }
+
+  Node* copy = current_snapshot_->copy_map.value(node);
+  if (!copy) {
+    return nullptr;
+  }
+
+  RenderTicketWatcher* watcher = new RenderTicketWatcher();
+  connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::ThumbnailRendered);
+  thumbnail_tasks_.append(watcher);
+  PinSnapshot(watcher);
+
+  RenderTicketPtr ticket = RenderManager::instance()->RenderThumbnail(current_snapshot_->viewer,
+                                                                      current_snapshot_->color_manager,
+                                                                      copy,
+                                                                      time,
+                                                                      height,
+                                                                      cache_file);
+  watcher->SetTicket(ticket);
+
+  return ticket;
+}
+
+void PreviewAutoCacher::SetPaused(QObject *subscriber, bool paused)
 {
-  paused_ = paused;
+  subscribers_[subscriber].paused = paused;
+
+  UpdateCacheRanges();
 }
 
-void GenerateHashesInternal(ViewerOutput *viewer, FrameHashCache* cache, const QVector<rational> &times, qint64 job_time)
+void GenerateHashesInternal(ViewerOutput *viewer, FrameHashCache* cache, const QVector<rational> &times, const QVector<TimeRange>& constant_ranges, qint64 job_time)
 {
   std::vector<QByteArray> existing_hashes;
 
+  // Hashes of constant ranges we've already hashed once, keyed by their index
+  QHash<int, QByteArray> constant_hashes;
+
   foreach (const rational& time, times) {
+    // Find the constant range this time falls into, if any
+    auto range_it = std::upper_bound(constant_ranges.cbegin(), constant_ranges.cend(), time,
+                                     [](const rational& t, const TimeRange& r){
+      return t < r.in();
+    });
+
+    int constant_index = -1;
+    if (range_it != constant_ranges.cbegin() && (range_it-1)->Contains(time, true, false)) {
+      constant_index = (range_it-1) - constant_ranges.cbegin();
+    }
+
     // See if hash already exists in disk cache
-    QByteArray hash = RenderManager::Hash(viewer->GetConnectedTextureOutput(), viewer->GetVideoParams(), time);
+    QByteArray hash = constant_hashes.value(constant_index);
+
+    if (hash.isEmpty()) {
+      hash = RenderManager::Hash(viewer->GetConnectedTextureOutput(), viewer->GetVideoParams(), time);
+
+      if (constant_index != -1) {
+        constant_hashes.insert(constant_index, hash);
+      }
+    }
 
     // Check memory list since disk checking is slow
     bool hash_exists = (std::find(existing_hashes.begin(), existing_hashes.end(), hash) != existing_hashes.end());
 
     if (!hash_exists) {
-      hash_exists = QFileInfo::exists(cache->CachePathName(hash));
+      hash_exists = cache->CacheFrameExists(hash);
 
       if (hash_exists) {
         existing_hashes.push_back(hash);
@@ -93,6 +216,22 @@ void GenerateHashesInternal(ViewerOutput *viewer, FrameHashCache* cache, const Q
 
 void PreviewAutoCacher::GenerateHashes(ViewerOutput *viewer, FrameHashCache* cache, const QVector<rational> &times, qint64 job_time)
 {
+  TRACE_SCOPE("autocache", "PreviewAutoCacher::GenerateHashes");
+
+  if (times.isEmpty()) {
+    return;
+  }
+
+  // Find the parts of the sequence that don't change over time so each only gets hashed once
+  QVector<TimeRange> constant_ranges;
+  NodeOutput texture_output = viewer->GetConnectedTextureOutput();
+  if (texture_output.IsValid()) {
+    auto minmax = std::minmax_element(times.cbegin(), times.cend());
+    TimeRange hash_range(*minmax.first, *minmax.second + viewer->GetVideoParams().frame_rate_as_time_base());
+
+    constant_ranges = texture_output.node()->GetConstantRanges(texture_output.output(), hash_range);
+  }
+
   // Ensure number of threads doesn't exceed idealThreadCount for maximum concurrency
   int hashes_per_thread = times.size() / qMax(1, QThread::idealThreadCount()-1);
 
@@ -106,11 +245,11 @@ void PreviewAutoCacher::GenerateHashes(ViewerOutput *viewer, FrameHashCache* cac
   // Queue threaded tasks for each
   if (hashes_per_thread >= times.size()) {
     // Don't bother queuing in other thread, just run
-    GenerateHashesInternal(viewer, cache, times, job_time);
+    GenerateHashesInternal(viewer, cache, times, constant_ranges, job_time);
   } else {
     QVector<QFuture<void> > threads;
     for (int i=0; i<times.size(); i+=hashes_per_thread) {
-      threads.append(QtConcurrent::run(GenerateHashesInternal, viewer, cache, times.mid(i, i == times.size() - 1 ? -1 : hashes_per_thread), job_time));
+      threads.append(QtConcurrent::run(GenerateHashesInternal, viewer, cache, times.mid(i, i == times.size() - 1 ? -1 : hashes_per_thread), constant_ranges, job_time));
     }
 
     for (int i=0; i<threads.size(); i++) {
@@ -123,12 +262,15 @@ void PreviewAutoCacher::VideoInvalidated(const TimeRange &range)
 {
   ClearVideoQueue();
 
+  // Keep every range that's invalidated, even mid-drag. Invalidation ranges are precise (e.g. only
+  // the frames a keyframe was actually moved across), so the final change on mouse release won't
+  // necessarily cover what the drag touched along the way.
+  invalidated_video_.insert(range);
+
   // Hash these frames since that should be relatively quick.
   if (ignore_next_mouse_button_ || !(qApp->mouseButtons() & Qt::LeftButton)) {
     ignore_next_mouse_button_ = false;
 
-    invalidated_video_.insert(range);
-
     TryRender();
   }
 }
@@ -147,6 +289,8 @@ void PreviewAutoCacher::HashesProcessed()
 {
   QFutureWatcher<void>* watcher = static_cast<QFutureWatcher<void>*>(sender());
 
+  UnpinSnapshot(watcher);
+
   if (hash_tasks_.contains(watcher)) {
     hash_tasks_.removeOne(watcher);
 
@@ -156,10 +300,12 @@ void PreviewAutoCacher::HashesProcessed()
   }
 
   // The cacher might be waiting for this job to finish
-  if (!graph_update_queue_.isEmpty()) {
+  if (HasPendingGraphUpdates()) {
     TryRender();
   }
 
+  PublishQueueLengths();
+
   delete watcher;
 }
 
@@ -167,15 +313,20 @@ void PreviewAutoCacher::AudioRendered()
 {
   RenderTicketWatcher* watcher = static_cast<RenderTicketWatcher*>(sender());
 
+  // Waveforms are reported with the snapshot's tracks, we'll map them back before unpinning it
+  GraphSnapshot* snapshot = job_snapshots_.value(watcher);
+
   if (audio_tasks_.contains(watcher)) {
     if (watcher->HasResult()) {
       const TimeRange &range = audio_tasks_.value(watcher);
 
       AudioVisualWaveform waveform = watcher->GetTicket()->property("waveform").value<AudioVisualWaveform>();
+      AudioLevels levels = watcher->GetTicket()->property("levels").value<AudioLevels>();
 
       viewer_node_->audio_playback_cache()->WritePCM(range,
                                                      watcher->Get().value<SampleBufferPtr>(),
                                                      &waveform,
+                                                     &levels,
                                                      watcher->GetTicket()->GetJobTime());
 
       bool pcm_is_usable = true;
@@ -191,14 +342,14 @@ void PreviewAutoCacher::AudioRendered()
         }
       }
 
-      if (pcm_is_usable) {
+      if (pcm_is_usable && snapshot) {
         // Retrieve visual waveforms
         QVector<RenderProcessor::RenderedWaveform> waveform_list = watcher->GetTicket()->property("waveforms").value< QVector<RenderProcessor::RenderedWaveform> >();
         foreach (const RenderProcessor::RenderedWaveform& waveform_info, waveform_list) {
           // Find original track
           Track* track = nullptr;
 
-          for (auto it=copy_map_.cbegin(); it!=copy_map_.cend(); it++) {
+          for (auto it=snapshot->copy_map.cbegin(); it!=snapshot->copy_map.cend(); it++) {
             if (it.value() == waveform_info.track) {
               track = static_cast<Track*>(it.key());
               break;
@@ -226,11 +377,15 @@ void PreviewAutoCacher::AudioRendered()
     audio_tasks_.remove(watcher);
   }
 
+  UnpinSnapshot(watcher);
+
   // The cacher might be waiting for this job to finish
-  if (!graph_update_queue_.isEmpty()) {
+  if (HasPendingGraphUpdates()) {
     TryRender();
   }
 
+  PublishQueueLengths();
+
   delete watcher;
 }
 
@@ -238,10 +393,20 @@ void PreviewAutoCacher::VideoRendered()
 {
   RenderTicketWatcher* watcher = static_cast<RenderTicketWatcher*>(sender());
 
+  UnpinSnapshot(watcher);
+
+  for (auto it=subscribers_.begin(); it!=subscribers_.end(); it++) {
+    if (it->single_frame_watcher == watcher) {
+      it->single_frame_watcher = nullptr;
+    }
+  }
+
   if (video_tasks_.contains(watcher)) {
     if (watcher->HasResult()) {
       const QByteArray& hash = video_tasks_.value(watcher);
 
+      RecordRenderTime(hash, watcher->property("time").value<rational>(), watcher->GetTicket()->GetRunTime());
+
       // Download frame in another thread
       if (!hash.isEmpty() && VideoParams::FormatIsFloat(viewer_node_->GetVideoParams().format())) {
         FramePtr frame = watcher->Get().value<FramePtr>();
@@ -252,7 +417,7 @@ void PreviewAutoCacher::VideoRendered()
         w->SetTicket(RenderManager::instance()->SaveFrameToCache(viewer_node_->video_frame_cache(),
                                                                  frame,
                                                                  hash,
-                                                                 true));
+                                                                 RenderManager::kPriorityPlayback));
       }
     }
 
@@ -270,7 +435,41 @@ void PreviewAutoCacher::VideoRendered()
   }
 
   // The cacher might be waiting for this job to finish
-  if (!graph_update_queue_.isEmpty()) {
+  if (HasPendingGraphUpdates() || HasQueuedSingleFrames()) {
+    TryRender();
+  }
+
+  PublishQueueLengths();
+
+  delete watcher;
+}
+
+void PreviewAutoCacher::ThumbnailRendered()
+{
+  RenderTicketWatcher* watcher = static_cast<RenderTicketWatcher*>(sender());
+
+  thumbnail_tasks_.removeOne(watcher);
+  UnpinSnapshot(watcher);
+
+  // The cacher might be waiting for this job to finish
+  if (HasPendingGraphUpdates()) {
+    TryRender();
+  }
+
+  PublishQueueLengths();
+
+  delete watcher;
+}
+
+void PreviewAutoCacher::PrewarmFinished()
+{
+  RenderTicketWatcher* watcher = static_cast<RenderTicketWatcher*>(sender());
+
+  prewarm_tasks_.removeOne(watcher);
+  UnpinSnapshot(watcher);
+
+  // The cacher might be waiting for this job to finish
+  if (HasPendingGraphUpdates()) {
     TryRender();
   }
 
@@ -296,127 +495,319 @@ void PreviewAutoCacher::VideoDownloaded()
   }
 
   // The cacher might be waiting for this job to finish
-  if (!graph_update_queue_.isEmpty()) {
+  if (HasPendingGraphUpdates()) {
     TryRender();
   }
 
+  PublishQueueLengths();
+
   delete watcher;
 }
 
-void PreviewAutoCacher::ProcessUpdateQueue()
+PreviewAutoCacher::GraphSnapshot *PreviewAutoCacher::CreateSnapshot()
 {
-  foreach (const QueuedJob& job, graph_update_queue_) {
+  GraphSnapshot* snapshot = new GraphSnapshot();
+  NodeGraph* graph = viewer_node_->parent();
+
+  // Map the project's default nodes onto our project's, then copy everything else
+  for (int i=0; i<snapshot->project.nodes().size(); i++) {
+    InsertIntoCopyMap(snapshot, graph->nodes().at(i), snapshot->project.nodes().at(i));
+  }
+  for (int i=snapshot->project.nodes().size(); i<graph->nodes().size(); i++) {
+    AddNode(snapshot, graph->nodes().at(i));
+  }
+
+  // Find copied viewer node
+  snapshot->viewer = static_cast<ViewerOutput*>(snapshot->copy_map.value(viewer_node_));
+  snapshot->color_manager = static_cast<ColorManager*>(snapshot->copy_map.value(viewer_node_->project()->color_manager()));
+
+  // Add all connections
+  foreach (Node* node, graph->nodes()) {
+    for (auto it=node->input_connections().cbegin(); it!=node->input_connections().cend(); it++) {
+      AddEdge(snapshot, it->second, it->first);
+    }
+  }
+
+  snapshot->last_update_time = QDateTime::currentMSecsSinceEpoch();
+
+  snapshots_.append(snapshot);
+
+  return snapshot;
+}
+
+void PreviewAutoCacher::ProcessUpdateQueue(GraphSnapshot *snapshot)
+{
+  Q_ASSERT(snapshot->pins == 0);
+
+  foreach (const QueuedJob& job, snapshot->pending) {
     switch (job.type) {
     case QueuedJob::kNodeAdded:
-      AddNode(job.node);
+      AddNode(snapshot, job.node);
       break;
     case QueuedJob::kNodeRemoved:
-      RemoveNode(job.node);
+      RemoveNode(snapshot, job.node);
       break;
     case QueuedJob::kEdgeAdded:
-      AddEdge(job.output, job.input);
+      AddEdge(snapshot, job.output, job.input);
       break;
     case QueuedJob::kEdgeRemoved:
-      RemoveEdge(job.output, job.input);
+      RemoveEdge(snapshot, job.output, job.input);
       break;
     case QueuedJob::kValueChanged:
-      CopyValue(job.input);
+      CopyValue(snapshot, job.input);
       break;
     }
   }
-  graph_update_queue_.clear();
+  snapshot->pending.clear();
+
+  snapshot->last_update_time = QDateTime::currentMSecsSinceEpoch();
+}
+
+bool PreviewAutoCacher::PublishSnapshot()
+{
+  GraphSnapshot* snapshot = nullptr;
+
+  if (current_snapshot_->pins == 0) {
+    // Nothing is reading the current snapshot, we can just update it
+    snapshot = current_snapshot_;
+  } else {
+    // Jobs are still reading the current snapshot, see if there's an idle one we can use instead
+    foreach (GraphSnapshot* s, snapshots_) {
+      if (s->pins == 0) {
+        snapshot = s;
+        break;
+      }
+    }
+
+    if (!snapshot) {
+      if (snapshots_.size() >= kMaximumSnapshots) {
+        // Every snapshot is in use, we'll have to wait for some jobs to finish
+        return false;
+      }
+
+      // Create a fresh copy, which will already be in sync
+      current_snapshot_ = CreateSnapshot();
+      return true;
+    }
+  }
+
+  ProcessUpdateQueue(snapshot);
+  current_snapshot_ = snapshot;
+
+  return true;
+}
+
+void PreviewAutoCacher::QueueGraphUpdate(const QueuedJob &job)
+{
+  QueueGraphUpdates({job});
+}
+
+void PreviewAutoCacher::QueueGraphUpdates(const QVector<QueuedJob> &jobs)
+{
+  foreach (GraphSnapshot* s, snapshots_) {
+    s->pending.append(jobs);
+
+    if (s != current_snapshot_ && s->pins == 0) {
+      // Keep idle spares in sync as we go so publishing them later is cheap
+      ProcessUpdateQueue(s);
+    }
+  }
+}
 
-  UpdateLastSyncedValue();
+void PreviewAutoCacher::PinSnapshot(QObject *job)
+{
+  current_snapshot_->pins++;
+  job_snapshots_.insert(job, current_snapshot_);
 }
 
-bool PreviewAutoCacher::HasActiveJobs() const
+void PreviewAutoCacher::UnpinSnapshot(QObject *job)
 {
-  return !hash_tasks_.isEmpty()
-      || !audio_tasks_.isEmpty()
-      || !video_tasks_.isEmpty();
+  GraphSnapshot* snapshot = job_snapshots_.take(job);
+
+  if (snapshot) {
+    snapshot->pins--;
+
+    if (snapshot != current_snapshot_ && snapshot->pins == 0) {
+      // This snapshot has been retired, only keep one idle spare around
+      bool have_spare = false;
+      foreach (GraphSnapshot* s, snapshots_) {
+        if (s != snapshot && s != current_snapshot_ && s->pins == 0) {
+          have_spare = true;
+          break;
+        }
+      }
+
+      if (have_spare) {
+        snapshots_.removeOne(snapshot);
+        delete snapshot;
+      } else {
+        ProcessUpdateQueue(snapshot);
+      }
+    }
+  }
 }
 
-void PreviewAutoCacher::AddNode(Node *node)
+void PreviewAutoCacher::AddNode(GraphSnapshot *snapshot, Node *node)
 {
   // Copy node
   Node* copy = node->copy();
 
   // Add to project
-  copy->setParent(&copied_project_);
+  copy->setParent(&snapshot->project);
 
   // Insert into map
-  InsertIntoCopyMap(node, copy);
-
-  // Keep track of our nodes
-  created_nodes_.append(copy);
+  InsertIntoCopyMap(snapshot, node, copy);
 }
 
-void PreviewAutoCacher::RemoveNode(Node *node)
+void PreviewAutoCacher::RemoveNode(GraphSnapshot *snapshot, Node *node)
 {
   // Find our copy and remove it
-  Node* copy = copy_map_.take(node);
-
-  // Remove from created list
-  created_nodes_.removeOne(copy);
+  Node* copy = snapshot->copy_map.take(node);
 
   // Delete it
   delete copy;
 }
 
-void PreviewAutoCacher::AddEdge(const NodeOutput &output, const NodeInput &input)
+void PreviewAutoCacher::AddEdge(GraphSnapshot *snapshot, const NodeOutput &output, const NodeInput &input)
 {
-  Node* our_output = copy_map_.value(output.node());
-  Node* our_input = copy_map_.value(input.node());
+  Node* our_output = snapshot->copy_map.value(output.node());
+  Node* our_input = snapshot->copy_map.value(input.node());
 
   Node::ConnectEdge(NodeOutput(our_output, output.output()), NodeInput(our_input, input.input(), input.element()));
 }
 
-void PreviewAutoCacher::RemoveEdge(const NodeOutput &output, const NodeInput &input)
+void PreviewAutoCacher::RemoveEdge(GraphSnapshot *snapshot, const NodeOutput &output, const NodeInput &input)
 {
-  Node* our_output = copy_map_.value(output.node());
-  Node* our_input = copy_map_.value(input.node());
+  Node* our_output = snapshot->copy_map.value(output.node());
+  Node* our_input = snapshot->copy_map.value(input.node());
 
   Node::DisconnectEdge(NodeOutput(our_output, output.output()), NodeInput(our_input, input.input(), input.element()));
 }
 
-void PreviewAutoCacher::CopyValue(const NodeInput &input)
+void PreviewAutoCacher::CopyValue(GraphSnapshot *snapshot, const NodeInput &input)
 {
-  Node* our_input = copy_map_.value(input.node());
+  Node* our_input = snapshot->copy_map.value(input.node());
   Node::CopyValuesOfElement(input.node(), our_input, input.input(), input.element());
 }
 
-void PreviewAutoCacher::InsertIntoCopyMap(Node *node, Node *copy)
+void PreviewAutoCacher::InsertIntoCopyMap(GraphSnapshot *snapshot, Node *node, Node *copy)
 {
   // Insert into map
-  copy_map_.insert(node, copy);
+  snapshot->copy_map.insert(node, copy);
+
+  // Show GPU time spent rendering the copy on the node the user sees
+  NodeGpuProfiler::SetSourceNode(copy, node);
 
   // Copy parameters
   Node::CopyInputs(node, copy, false);
 }
 
-void PreviewAutoCacher::UpdateLastSyncedValue()
+bool PreviewAutoCacher::DropSupersededSingleFrame(QObject *subscriber)
 {
-  last_update_time_ = QDateTime::currentMSecsSinceEpoch();
+  Subscriber& s = subscribers_[subscriber];
+
+  if (!s.single_frame_watcher) {
+    return true;
+  }
+
+  if (IsWaitedOnByOthers(s.single_frame_watcher, subscriber)) {
+    // Someone else still wants this frame, so it can't be dropped
+    return false;
+  }
+
+  RenderTicketPtr ticket = s.single_frame_watcher->GetTicket();
+
+  if (!RenderManager::instance()->RemoveTicket(ticket)) {
+    // Already rendering, the next request will have to wait for it
+    return false;
+  }
+
+  // Never started, so nobody needs it anymore
+  RenderTicketWatcher* watcher = s.single_frame_watcher;
+  s.single_frame_watcher = nullptr;
+
+  disconnect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::VideoRendered);
+  ticket->Finish();
+
+  foreach (RenderTicketPtr t, video_immediate_passthroughs_.take(watcher)) {
+    t->Finish();
+  }
+
+  video_tasks_.remove(watcher);
+  UnpinSnapshot(watcher);
+  delete watcher;
+
+  return true;
+}
+
+bool PreviewAutoCacher::IsWaitedOnByOthers(RenderTicketWatcher *watcher, QObject *subscriber) const
+{
+  foreach (const RenderTicketPtr& t, video_immediate_passthroughs_.value(watcher)) {
+    if (t->property("subscriber").value<QObject*>() != subscriber) {
+      return true;
+    }
+  }
+
+  return false;
 }
 
-void PreviewAutoCacher::CancelQueuedSingleFrameRender()
+void PreviewAutoCacher::CancelQueuedSingleFrameRender(Subscriber *subscriber)
 {
-  if (single_frame_render_) {
+  if (subscriber->single_frame_render) {
     // Signal that this ticket was cancelled with no value
-    single_frame_render_->Finish();
-    single_frame_render_ = nullptr;
+    subscriber->single_frame_render->Finish();
+    subscriber->single_frame_render = nullptr;
+  }
+}
+
+bool PreviewAutoCacher::HasQueuedSingleFrames() const
+{
+  foreach (const Subscriber& s, subscribers_) {
+    if (s.single_frame_render) {
+      return true;
+    }
   }
+
+  return false;
 }
 
-void PreviewAutoCacher::SetPlayhead(const rational &playhead)
+void PreviewAutoCacher::SetPlayhead(QObject *subscriber, const rational &playhead)
 {
-  cache_range_ = TimeRange(playhead - Config::Current()[QStringLiteral("DiskCacheBehind")].value<rational>(),
-      playhead + Config::Current()[QStringLiteral("DiskCacheAhead")].value<rational>());
+  playhead_ = playhead;
+  subscribers_[subscriber].playhead = playhead;
+
+  UpdateCacheRanges();
 
   has_changed_ = true;
   use_custom_range_ = false;
 
   RequeueFrames();
+
+  PrewarmUpcomingDecoders();
+}
+
+void PreviewAutoCacher::UpdateCacheRanges()
+{
+  cache_ranges_.clear();
+  paused_ = true;
+
+  foreach (const Subscriber& s, subscribers_) {
+    if (!s.paused) {
+      cache_ranges_.insert(TimeRange(s.playhead - Config::kDiskCacheBehind.Get(),
+                                     s.playhead + Config::kDiskCacheAhead.Get()));
+      paused_ = false;
+    }
+  }
+}
+
+void PreviewAutoCacher::ClearSubscriberQueue(QObject *subscriber)
+{
+  ClearQueueInternal(video_tasks_, false, &PreviewAutoCacher::VideoRendered, [this, subscriber](RenderTicketWatcher* watcher){
+    return IsWaitedOnByOthers(watcher, subscriber);
+  });
+
+  has_changed_ = true;
+  use_custom_range_ = false;
 }
 
 void PreviewAutoCacher::ClearHashQueue(bool wait)
@@ -454,41 +845,153 @@ void PreviewAutoCacher::ClearVideoDownloadQueue(bool hard)
   ClearQueueInternal(video_download_tasks_, hard, &PreviewAutoCacher::VideoDownloaded);
 }
 
+void PreviewAutoCacher::PrewarmUpcomingDecoders()
+{
+  RenderManager::instance()->SetPlayhead(playhead_);
+
+  // Forget clips we've played past, they'll need opening again if we come back to them
+  for (auto it=prewarmed_times_.begin(); it!=prewarmed_times_.end(); ) {
+    if (*it < playhead_ || *it > playhead_ + RenderManager::kDecoderLookahead) {
+      it = prewarmed_times_.erase(it);
+    } else {
+      it++;
+    }
+  }
+
+  Sequence* sequence = dynamic_cast<Sequence*>(viewer_node_);
+  if (!sequence || !current_snapshot_ || HasPendingGraphUpdates()) {
+    return;
+  }
+
+  rational lookahead_end = playhead_ + RenderManager::kDecoderLookahead;
+
+  foreach (Track* track, sequence->GetTracks()) {
+    if (track->type() != Track::kVideo || track->IsMuted()) {
+      continue;
+    }
+
+    for (Block* b=track->NearestBlockAfter(playhead_); b && b->in() <= lookahead_end; b=b->next()) {
+      if (!dynamic_cast<ClipBlock*>(b) || prewarmed_times_.contains(b->in())) {
+        continue;
+      }
+
+      prewarmed_times_.append(b->in());
+
+      // Renders every track at this time, which also covers clips on other tracks starting here
+      RenderTicketWatcher* watcher = new RenderTicketWatcher();
+      connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::PrewarmFinished);
+      prewarm_tasks_.append(watcher);
+      PinSnapshot(watcher);
+      watcher->SetTicket(RenderManager::instance()->PrewarmDecoders(current_snapshot_->viewer, b->in(), RenderMode::kOffline));
+    }
+  }
+}
+
+void PreviewAutoCacher::ClearPrewarmQueue()
+{
+  foreach (RenderTicketWatcher* watcher, prewarm_tasks_) {
+    disconnect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::PrewarmFinished);
+
+    RenderTicketPtr ticket = watcher->GetTicket();
+
+    if (!RenderManager::instance()->RemoveTicket(ticket)) {
+      // These read from our graph copies, so we have to wait for running ones
+      ticket->WaitForFinished();
+    }
+
+    UnpinSnapshot(watcher);
+    delete watcher;
+  }
+
+  prewarm_tasks_.clear();
+  prewarmed_times_.clear();
+}
+
+void PreviewAutoCacher::ClearThumbnailQueue()
+{
+  foreach (RenderTicketWatcher* watcher, thumbnail_tasks_) {
+    disconnect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::ThumbnailRendered);
+
+    RenderTicketPtr ticket = watcher->GetTicket();
+
+    if (RenderManager::instance()->RemoveTicket(ticket)) {
+      // Let the requester know this won't be coming
+      ticket->Finish();
+    } else {
+      // Thumbnails read from our graph copies, so we have to wait for running ones
+      ticket->WaitForFinished();
+    }
+
+    UnpinSnapshot(watcher);
+    delete watcher;
+  }
+
+  thumbnail_tasks_.clear();
+}
+
 void PreviewAutoCacher::NodeAdded(Node *node)
 {
-  graph_update_queue_.append({QueuedJob::kNodeAdded, node, NodeInput(), NodeOutput()});
+  QueueGraphUpdate({QueuedJob::kNodeAdded, node, NodeInput(), NodeOutput()});
 }
 
 void PreviewAutoCacher::NodeRemoved(Node *node)
 {
-  graph_update_queue_.append({QueuedJob::kNodeRemoved, node, NodeInput(), NodeOutput()});
+  QueueGraphUpdate({QueuedJob::kNodeRemoved, node, NodeInput(), NodeOutput()});
 }
 
 void PreviewAutoCacher::EdgeAdded(const NodeOutput &output, const NodeInput &input)
 {
-  graph_update_queue_.append({QueuedJob::kEdgeAdded, nullptr, input, output});
+  QueueGraphUpdate({QueuedJob::kEdgeAdded, nullptr, input, output});
 }
 
 void PreviewAutoCacher::EdgeRemoved(const NodeOutput &output, const NodeInput &input)
 {
-  graph_update_queue_.append({QueuedJob::kEdgeRemoved, nullptr, input, output});
+  QueueGraphUpdate({QueuedJob::kEdgeRemoved, nullptr, input, output});
 }
 
 void PreviewAutoCacher::ValueChanged(const NodeInput &input)
 {
-  graph_update_queue_.append({QueuedJob::kValueChanged, nullptr, input, NodeOutput()});
+  QueueGraphUpdate({QueuedJob::kValueChanged, nullptr, input, NodeOutput()});
+}
+
+void PreviewAutoCacher::GraphBatchCommitted(const NodeGraphChangeSet &changes)
+{
+  QVector<QueuedJob> jobs;
+  jobs.reserve(changes.disconnected.size() + changes.removed.size() + changes.added.size()
+               + changes.connected.size() + changes.values.size());
+
+  foreach (const NodeGraphChangeSet::Edge& e, changes.disconnected) {
+    jobs.append({QueuedJob::kEdgeRemoved, nullptr, e.second, e.first});
+  }
+
+  foreach (Node* node, changes.removed) {
+    jobs.append({QueuedJob::kNodeRemoved, node, NodeInput(), NodeOutput()});
+  }
+
+  foreach (Node* node, changes.added) {
+    jobs.append({QueuedJob::kNodeAdded, node, NodeInput(), NodeOutput()});
+  }
+
+  foreach (const NodeGraphChangeSet::Edge& e, changes.connected) {
+    jobs.append({QueuedJob::kEdgeAdded, nullptr, e.second, e.first});
+  }
+
+  foreach (const NodeInput& input, changes.values) {
+    jobs.append({QueuedJob::kValueChanged, nullptr, input, NodeOutput()});
+  }
+
+  QueueGraphUpdates(jobs);
 }
 
 void PreviewAutoCacher::TryRender()
 {
-  if (!graph_update_queue_.isEmpty()) {
-    if (HasActiveJobs()) {
+  TRACE_SCOPE("autocache", "PreviewAutoCacher::TryRender");
+
+  if (HasPendingGraphUpdates()) {
+    if (!PublishSnapshot()) {
       // Still waiting for jobs to finish
       return;
     }
-
-    // No jobs are active, we can process the update queue
-    ProcessUpdateQueue();
   }
 
   // If we're here, we must be able to render
@@ -497,70 +1000,221 @@ void PreviewAutoCacher::TryRender()
 
     QFutureWatcher<void>* watcher = new QFutureWatcher<void>();
     hash_tasks_.append(watcher);
+    PinSnapshot(watcher);
     connect(watcher, &QFutureWatcher<void>::finished, this, &PreviewAutoCacher::HashesProcessed);
     watcher->setFuture(QtConcurrent::run(&PreviewAutoCacher::GenerateHashes,
-                                         copied_viewer_node_,
+                                         current_snapshot_->viewer,
                                          viewer_node_->video_frame_cache(),
                                          frames,
-                                         last_update_time_));
+                                         current_snapshot_->last_update_time));
 
     invalidated_video_.clear();
   }
 
   if (!invalidated_audio_.isEmpty()) {
+    std::vector<TimeRange> chunks;
+
     foreach (const TimeRange& range, invalidated_audio_) {
-      std::list<TimeRange> chunks = range.Split(30);
+      std::list<TimeRange> split = range.Split(30);
+      chunks.insert(chunks.end(), split.begin(), split.end());
+    }
 
-      foreach (const TimeRange& r, chunks) {
-        RenderTicketWatcher* watcher = new RenderTicketWatcher();
-        connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::AudioRendered);
-        audio_tasks_.insert(watcher, r);
-        watcher->SetTicket(RenderManager::instance()->RenderAudio(copied_viewer_node_, r, RenderMode::kOffline, true));
-      }
+    // Queue audio around the playhead first, footage that still needs conforming will conform
+    // those parts first too
+    const rational& playhead = playhead_;
+    std::stable_sort(chunks.begin(), chunks.end(), [playhead](const TimeRange& a, const TimeRange& b){
+      return GetDistanceFromTime(a, playhead) < GetDistanceFromTime(b, playhead);
+    });
+
+    foreach (const TimeRange& r, chunks) {
+      RenderTicketWatcher* watcher = new RenderTicketWatcher();
+      connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::AudioRendered);
+      audio_tasks_.insert(watcher, r);
+      PinSnapshot(watcher);
+      watcher->SetTicket(RenderManager::instance()->RenderAudio(current_snapshot_->viewer, r, RenderMode::kOffline, true));
     }
 
     invalidated_audio_.clear();
   }
 
-  if (single_frame_render_) {
-    // Check if already caching this
-    QByteArray hash = single_frame_render_->property("hash").toByteArray();
+  for (auto it=subscribers_.begin(); it!=subscribers_.end(); it++) {
+    RenderTicketPtr single_frame_render = it->single_frame_render;
+
+    if (!single_frame_render) {
+      continue;
+    }
+
+    // Check if already caching this, possibly for another subscriber
+    QByteArray hash = single_frame_render->property("hash").toByteArray();
     RenderTicketWatcher* watcher;
     if (!hash.isEmpty() && (watcher = video_tasks_.key(hash))) {
-      video_immediate_passthroughs_[watcher].append(single_frame_render_);
+      video_immediate_passthroughs_[watcher].append(single_frame_render);
     } else if (!hash.isEmpty() && (watcher = video_download_tasks_.key(hash))) {
-      single_frame_render_->Finish(watcher->property("frame"));
+      single_frame_render->Finish(watcher->property("frame"));
+    } else if (NodeInputDragger::IsInputBeingDragged() && !DropSupersededSingleFrame(it.key())) {
+      // While a value is dragged, every change requests a new frame. Rather than render them all,
+      // keep one frame rendering and only the latest request waiting behind it (GetSingleFrame()
+      // cancels the one it replaces), so the viewer keeps up with the cursor.
+      continue;
     } else {
       watcher = RenderFrame(hash,
-                            single_frame_render_->property("time").value<rational>(),
-                            single_frame_render_->property("prioritize").toBool(),
-                            paused_);
-
-      video_immediate_passthroughs_[watcher].append(single_frame_render_);
+                            single_frame_render->property("time").value<rational>(),
+                            single_frame_render->property("prioritize").toBool() ? RenderManager::kPriorityInteractive : RenderManager::kPriorityPlayback,
+                            it->paused,
+                            single_frame_render->property("roi").toRectF(),
+                            single_frame_render->property("divider").toInt(),
+                            single_frame_render->property("keyframesonly").toBool());
+
+      video_immediate_passthroughs_[watcher].append(single_frame_render);
+      it->single_frame_watcher = watcher;
     }
 
-    single_frame_render_ = nullptr;
+    it->single_frame_render = nullptr;
   }
+
+  PublishQueueLengths();
 }
 
-RenderTicketWatcher* PreviewAutoCacher::RenderFrame(const QByteArray &hash, const rational& time, bool prioritize, bool texture_only)
+RenderTicketWatcher* PreviewAutoCacher::RenderFrame(const QByteArray &hash, const rational& time, ThreadPool::Priority priority, bool texture_only, const QRectF &roi, int divider, bool keyframes_only)
 {
   RenderTicketWatcher* watcher = new RenderTicketWatcher();
   watcher->setProperty("hash", hash);
+  watcher->setProperty("time", QVariant::fromValue(time));
   connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::VideoRendered);
   video_tasks_.insert(watcher, hash);
-  watcher->SetTicket(RenderManager::instance()->RenderFrame(copied_viewer_node_,
-                                                            copied_color_manager_,
+  PinSnapshot(watcher);
+
+  VideoParams video_params = current_snapshot_->viewer->GetVideoParams();
+  if (divider) {
+    video_params.set_divider(divider);
+
+    // Halving bandwidth matters more than accuracy when playback can't keep up
+    if (video_params.format() == VideoParams::kFormatFloat32) {
+      video_params.set_format(VideoParams::kFormatFloat16);
+    }
+  }
+
+  watcher->SetTicket(RenderManager::instance()->RenderFrame(current_snapshot_->viewer,
+                                                            current_snapshot_->color_manager,
                                                             time,
                                                             RenderMode::kOffline,
+                                                            video_params,
+                                                            current_snapshot_->viewer->GetAudioParams(),
+                                                            QSize(0, 0),
+                                                            QMatrix4x4(),
+                                                            VideoParams::kFormatInvalid,
+                                                            nullptr,
                                                             viewer_node_->video_frame_cache(),
-                                                            prioritize,
-                                                            texture_only));
+                                                            priority,
+                                                            texture_only,
+                                                            hash,
+                                                            roi,
+                                                            PlanarYUV(),
+                                                            keyframes_only));
   return watcher;
 }
 
+void PreviewAutoCacher::RenderFrames(const QVector<QByteArray> &hashes, const QVector<rational> &times)
+{
+  QVector<RenderTicketPtr> tickets = RenderManager::instance()->RenderFrames(current_snapshot_->viewer,
+                                                                             current_snapshot_->color_manager,
+                                                                             times,
+                                                                             RenderMode::kOffline,
+                                                                             viewer_node_->video_frame_cache(),
+                                                                             RenderManager::kPriorityBackground,
+                                                                             false,
+                                                                             hashes);
+
+  for (int i=0; i<tickets.size(); i++) {
+    RenderTicketWatcher* watcher = new RenderTicketWatcher();
+    watcher->setProperty("hash", hashes.at(i));
+    watcher->setProperty("time", QVariant::fromValue(times.at(i)));
+    connect(watcher, &RenderTicketWatcher::Finished, this, &PreviewAutoCacher::VideoRendered);
+    video_tasks_.insert(watcher, hashes.at(i));
+    PinSnapshot(watcher);
+    watcher->SetTicket(tickets.at(i));
+  }
+}
+
+void PreviewAutoCacher::PublishQueueLengths()
+{
+  TRACE_COUNTER("autocache", "Hash Jobs", hash_tasks_.size());
+  TRACE_COUNTER("autocache", "Audio Jobs", audio_tasks_.size());
+  TRACE_COUNTER("autocache", "Video Jobs", video_tasks_.size());
+  TRACE_COUNTER("autocache", "Video Download Jobs", video_download_tasks_.size());
+
+  static Metric* hash_metric = MetricsRegistry::Gauge(QStringLiteral("olive_autocache_hash_jobs"),
+                                                      QStringLiteral("Background hashing jobs queued by the auto-cacher"));
+  static Metric* video_metric = MetricsRegistry::Gauge(QStringLiteral("olive_autocache_video_jobs"),
+                                                       QStringLiteral("Frames queued for rendering by the auto-cacher"));
+  static Metric* download_metric = MetricsRegistry::Gauge(QStringLiteral("olive_autocache_download_jobs"),
+                                                          QStringLiteral("Rendered frames waiting to be written to the disk cache"));
+
+  hash_metric->Add(hash_tasks_.size() - published_hash_tasks_);
+  video_metric->Add(video_tasks_.size() - published_video_tasks_);
+  download_metric->Add(video_download_tasks_.size() - published_video_download_tasks_);
+
+  published_hash_tasks_ = hash_tasks_.size();
+  published_video_tasks_ = video_tasks_.size();
+  published_video_download_tasks_ = video_download_tasks_.size();
+}
+
+void PreviewAutoCacher::RecordRenderTime(const QByteArray &hash, const rational &time, qint64 nanoseconds)
+{
+  if (nanoseconds < 0) {
+    return;
+  }
+
+  if (!hash.isEmpty()) {
+    if (hash_render_times_.size() >= kMaximumRecordedHashes) {
+      // Hashes of long-gone edits pile up, start over rather than tracking their age
+      hash_render_times_.clear();
+    }
+
+    hash_render_times_.insert(hash, nanoseconds);
+  }
+
+  time_render_times_.insert(time, nanoseconds);
+}
+
+qint64 PreviewAutoCacher::PredictRenderTime(const QByteArray &hash, const rational &time) const
+{
+  auto hash_it = hash_render_times_.constFind(hash);
+  if (hash_it != hash_render_times_.constEnd()) {
+    return hash_it.value();
+  }
+
+  if (time_render_times_.isEmpty()) {
+    return -1;
+  }
+
+  // Find the closest measured frame on either side
+  auto after = time_render_times_.lowerBound(time);
+  auto nearest = after;
+
+  if (after == time_render_times_.constEnd()) {
+    nearest = std::prev(after);
+  } else if (after != time_render_times_.constBegin()) {
+    auto before = std::prev(after);
+
+    if (time - before.key() < after.key() - time) {
+      nearest = before;
+    }
+  }
+
+  rational distance = (nearest.key() > time) ? nearest.key() - time : time - nearest.key();
+
+  if (distance > kPredictionRange) {
+    return -1;
+  }
+
+  return nearest.value();
+}
+
 void PreviewAutoCacher::RequeueFrames()
 {
+  TRACE_SCOPE("autocache", "PreviewAutoCacher::RequeueFrames");
+
   delayed_requeue_timer_.stop();
 
   if (viewer_node_
@@ -569,31 +1223,64 @@ void PreviewAutoCacher::RequeueFrames()
       && has_changed_
       && VideoParams::FormatIsFloat(viewer_node_->GetVideoParams().format())
       && (!paused_ || use_custom_range_)) {
-    TimeRange using_range;
+    TimeRangeList using_ranges;
 
     if (use_custom_range_) {
-      using_range = custom_autocache_range_;
+      using_ranges.insert(custom_autocache_range_);
       use_custom_range_ = false;
     } else {
-      using_range = cache_range_;
+      using_ranges = cache_ranges_;
+    }
+
+    // Ranges are sorted and don't overlap, so only a frame straddling two of them can repeat
+    QVector<rational> invalidated_ranges;
+    foreach (const TimeRange& r, using_ranges) {
+      foreach (const rational& t, viewer_node_->video_frame_cache()->GetInvalidatedFrames(r)) {
+        if (invalidated_ranges.isEmpty() || invalidated_ranges.last() < t) {
+          invalidated_ranges.append(t);
+        }
+      }
     }
 
-    QVector<rational> invalidated_ranges = viewer_node_->video_frame_cache()->GetInvalidatedFrames(using_range);
+    auto in_using_ranges = [&using_ranges](const rational& t){
+      foreach (const TimeRange& r, using_ranges) {
+        if (t >= r.in() && t < r.out()) {
+          return true;
+        }
+      }
+      return false;
+    };
+
+    struct WantedFrame {
+      rational time;
+      QByteArray hash;
+      qint64 predicted_time;
+    };
+
+    QVector<WantedFrame> wanted;
+
+    // Frames predicted to render faster than this can be left for playback to render live
+    qint64 realtime_budget = -1;
+    if (Config::kAutoCacheSkipRealtimeFrames.Get()) {
+      realtime_budget = qint64(viewer_node_->GetVideoParams().frame_rate_as_time_base().toDouble() * 1000000000.0 * kRealtimeFraction);
+    }
 
     foreach (const rational& t, invalidated_ranges) {
       const QByteArray& hash = viewer_node_->video_frame_cache()->GetHash(t);
 
       RenderTicketWatcher* render_task = video_tasks_.key(hash);
 
-      if (t >= using_range.in()
-          && t < using_range.out()) {
+      if (in_using_ranges(t)) {
         // We want this hash, if we're not already rendering, start render now
         if (!render_task && !video_download_tasks_.key(hash)) {
-          // Don't render any hash more than once
-          RenderFrame(hash, t, false, false);
+          qint64 predicted = PredictRenderTime(hash, t);
+
+          if (predicted < 0 || predicted >= realtime_budget) {
+            wanted.append({t, hash, predicted});
+          }
         }
-      } else if (render_task) {
-        // Cancel this frame unless it's already started
+      } else if (render_task && !video_immediate_passthroughs_.contains(render_task)) {
+        // Cancel this frame unless it's already started or a viewer is waiting on it
         QMutexLocker locker(render_task->GetTicket()->lock());
 
         if (!render_task->GetTicket()->IsRunning(false)) {
@@ -603,8 +1290,57 @@ void PreviewAutoCacher::RequeueFrames()
       }
     }
 
+    // Background render time is limited, so spend it on the frames playback is most likely to drop
+    // first. Frames nobody has measured yet come after, still in time order.
+    std::stable_sort(wanted.begin(), wanted.end(), [](const WantedFrame& a, const WantedFrame& b){
+      return a.predicted_time >= 0 && (b.predicted_time < 0 || a.predicted_time > b.predicted_time);
+    });
+
+    QVector<QByteArray> batch_hashes;
+    QVector<rational> batch_times;
+
+    foreach (const WantedFrame& f, wanted) {
+      // Don't render any hash more than once
+      if (video_tasks_.key(f.hash) || batch_hashes.contains(f.hash)) {
+        continue;
+      }
+
+      if (f.predicted_time >= 0) {
+        // Measured frames are rendered individually so the slowest ones start first in parallel
+        RenderFrame(f.hash, f.time, RenderManager::kPriorityBackground, false);
+      } else {
+        // Unmeasured frames are in time order, so neighbors can share a render thread and its
+        // warmed up decoders
+        batch_hashes.append(f.hash);
+        batch_times.append(f.time);
+
+        if (batch_hashes.size() == kRenderBatchSize) {
+          RenderFrames(batch_hashes, batch_times);
+          batch_hashes.clear();
+          batch_times.clear();
+        }
+      }
+    }
+
+    if (!batch_hashes.isEmpty()) {
+      RenderFrames(batch_hashes, batch_times);
+    }
+
     has_changed_ = false;
   }
+
+  PublishQueueLengths();
+}
+
+rational PreviewAutoCacher::GetDistanceFromTime(const TimeRange &range, const rational &time)
+{
+  if (time < range.in()) {
+    return range.in() - time;
+  } else if (time >= range.out()) {
+    return time - range.out();
+  } else {
+    return 0;
+  }
 }
 
 void PreviewAutoCacher::ConformFinished()
@@ -656,8 +1392,14 @@ void PreviewAutoCacher::SetViewerNode(ViewerOutput *viewer_node)
     // be in the cache for later use.
     ClearVideoDownloadQueue(true);
 
+    // Thumbnails read from our graph copies which are about to be deleted
+    ClearThumbnailQueue();
+    ClearPrewarmQueue();
+
     // Clear any single frame render that might be queued
-    CancelQueuedSingleFrameRender();
+    for (auto it=subscribers_.begin(); it!=subscribers_.end(); it++) {
+      CancelQueuedSingleFrameRender(&*it);
+    }
 
     // No more immediate passthroughts
     video_immediate_passthroughs_.clear();
@@ -665,12 +1407,15 @@ void PreviewAutoCacher::SetViewerNode(ViewerOutput *viewer_node)
     // No more audio conforms
     audio_needing_conform_.clear();
 
-    // Delete all of our copied nodes
-    qDeleteAll(created_nodes_);
-    created_nodes_.clear();
-    copy_map_.clear();
-    copied_viewer_node_ = nullptr;
-    graph_update_queue_.clear();
+    // Render times are specific to this viewer's sequence
+    hash_render_times_.clear();
+    time_render_times_.clear();
+
+    // Delete all of our graph copies
+    qDeleteAll(snapshots_);
+    snapshots_.clear();
+    job_snapshots_.clear();
+    current_snapshot_ = nullptr;
 
     // Disconnect signals for future node additions/deletions
     NodeGraph* graph = viewer_node_->parent();
@@ -680,6 +1425,7 @@ void PreviewAutoCacher::SetViewerNode(ViewerOutput *viewer_node)
     disconnect(graph, &NodeGraph::InputConnected, this, &PreviewAutoCacher::EdgeAdded);
     disconnect(graph, &NodeGraph::InputDisconnected, this, &PreviewAutoCacher::EdgeRemoved);
     disconnect(graph, &NodeGraph::ValueChanged, this, &PreviewAutoCacher::ValueChanged);
+    disconnect(graph, &NodeGraph::BatchCommitted, this, &PreviewAutoCacher::GraphBatchCommitted);
 
     // Disconnect signal (will be a no-op if the signal was never connected)
     disconnect(viewer_node_->video_frame_cache(),
@@ -698,27 +1444,7 @@ void PreviewAutoCacher::SetViewerNode(ViewerOutput *viewer_node)
   if (viewer_node_) {
     // Copy graph
     NodeGraph* graph = viewer_node_->parent();
-
-    // Add all nodes
-    for (int i=0; i<copied_project_.nodes().size(); i++) {
-      InsertIntoCopyMap(graph->nodes().at(i), copied_project_.nodes().at(i));
-    }
-    for (int i=copied_project_.nodes().size(); i<graph->nodes().size(); i++) {
-      AddNode(graph->nodes().at(i));
-    }
-
-    // Find copied viewer node
-    copied_viewer_node_ = static_cast<ViewerOutput*>(copy_map_.value(viewer_node_));
-    copied_color_manager_ = static_cast<ColorManager*>(copy_map_.value(viewer_node_->project()->color_manager()));
-
-    // Add all connections
-    foreach (Node* node, graph->nodes()) {
-      for (auto it=node->input_connections().cbegin(); it!=node->input_connections().cend(); it++) {
-        AddEdge(it->second, it->first);
-      }
-    }
-
-    UpdateLastSyncedValue();
+    current_snapshot_ = CreateSnapshot();
 
     // Connect signals for future node additions/deletions
     connect(graph, &NodeGraph::NodeAdded, this, &PreviewAutoCacher::NodeAdded);
@@ -726,6 +1452,7 @@ void PreviewAutoCacher::SetViewerNode(ViewerOutput *viewer_node)
     connect(graph, &NodeGraph::InputConnected, this, &PreviewAutoCacher::EdgeAdded);
     connect(graph, &NodeGraph::InputDisconnected, this, &PreviewAutoCacher::EdgeRemoved);
     connect(graph, &NodeGraph::ValueChanged, this, &PreviewAutoCacher::ValueChanged);
+    connect(graph, &NodeGraph::BatchCommitted, this, &PreviewAutoCacher::GraphBatchCommitted);
 
     // Copy invalidated ranges - used to determine which frames need hashing
     invalidated_video_ = viewer_node_->video_frame_cache()->GetInvalidatedRanges();
@@ -762,7 +1489,16 @@ RenderTicketWatcher* RetrieveFromQueueIterator(QVector<RenderTicketWatcher*>::it
 
 void PreviewAutoCacher::ClearQueueRemoveEventInternal(QMap<RenderTicketWatcher*, QByteArray>::iterator it)
 {
-  Q_UNUSED(it)
+  for (auto s=subscribers_.begin(); s!=subscribers_.end(); s++) {
+    if (s->single_frame_watcher == it.key()) {
+      s->single_frame_watcher = nullptr;
+    }
+  }
+
+  // Nothing will render these now, so let whoever's waiting on them know
+  foreach (RenderTicketPtr t, video_immediate_passthroughs_.take(it.key())) {
+    t->Finish();
+  }
 }
 
 void PreviewAutoCacher::ClearQueueRemoveEventInternal(QMap<RenderTicketWatcher*, TimeRange>::iterator it)
@@ -777,10 +1513,21 @@ void PreviewAutoCacher::ClearQueueRemoveEventInternal(QVector<RenderTicketWatche
 
 template<typename T, typename Func>
 void PreviewAutoCacher::ClearQueueInternal(T& list, bool hard, Func member)
+{
+  ClearQueueInternal(list, hard, member, [](RenderTicketWatcher*){ return false; });
+}
+
+template<typename T, typename Func, typename Keep>
+void PreviewAutoCacher::ClearQueueInternal(T& list, bool hard, Func member, Keep keep)
 {
   for (auto it=list.begin(); it!=list.end(); ) {
     RenderTicketWatcher* ticket = RetrieveFromQueueIterator(it);
 
+    if (keep(ticket)) {
+      it++;
+      continue;
+    }
+
     QMutexLocker locker(ticket->GetTicket()->lock());
 
     bool ticket_is_running = ticket->GetTicket()->IsRunning(false);
@@ -802,6 +1549,7 @@ void PreviewAutoCacher::ClearQueueInternal(T& list, bool hard, Func member)
 
       // Destroy ticket
       locker.unlock();
+      UnpinSnapshot(ticket);
       delete ticket;
 
       it = list.erase(it);
@@ -9,6 +9,7 @@
 #include "node/node.h"
 #include "node/output/viewer/viewer.h"
 #include "node/project/project.h"
+#include "threading/threadpool.h"
 #include "threading/threadticketwatcher.h"
 
 namespace olive {
@@ -17,21 +18,53 @@ namespace olive {
  * @brief Manager for dynamically caching a sequence in the background
  *
  * Intended to be used with a Viewer to dynamically cache parts of a sequence based on the playhead.
+ *
+ * There's one cacher per sequence, shared by every viewer showing it, so the graph is only copied
+ * once and no frame is queued twice. Each viewer subscribes with its own playhead and can pause
+ * auto-caching on its own; the cacher caches around the playhead of every subscriber that hasn't.
  */
 class PreviewAutoCacher : public QObject
 {
   Q_OBJECT
 public:
-  PreviewAutoCacher();
+  /**
+   * @brief Get the cacher for `viewer_node`, creating it if this is its first subscriber
+   */
+  static PreviewAutoCacher* Subscribe(ViewerOutput* viewer_node, QObject* subscriber, bool paused);
 
-  virtual ~PreviewAutoCacher() override;
+  /**
+   * @brief Stop `subscriber` using `cacher`, which is deleted once nothing is subscribed to it
+   *
+   * Any of the subscriber's frames that haven't started rendering are cancelled.
+   */
+  static void Unsubscribe(PreviewAutoCacher* cacher, QObject* subscriber);
 
-  RenderTicketPtr GetSingleFrame(const rational& t, bool prioritize);
+  /**
+   * @brief Find the cacher for `viewer_node`, or nullptr if no viewer is showing it
+   */
+  static PreviewAutoCacher* Get(ViewerOutput* viewer_node);
 
   /**
-   * @brief Set the viewer node to auto-cache
+   * @brief Render the frame at `t` for immediate display to `subscriber`
+   *
+   * If `roi` is set (normalized to 0-1 from the top-left), only that region of the frame is
+   * guaranteed to be rendered. If `divider` is set, the frame is rendered at that divider and at
+   * reduced precision instead of the sequence's own settings, for playback that can't keep up.
+   * If `keyframes_only` is set, footage shows its nearest keyframe rather than the exact frame (see
+   * RenderManager::RenderFrame()). Such partial or degraded frames are never cached.
    */
-  void SetViewerNode(ViewerOutput *viewer_node);
+  RenderTicketPtr GetSingleFrame(QObject* subscriber, const rational& t, bool prioritize, const QRectF& roi = QRectF(), int divider = 0, bool keyframes_only = false);
+
+  /**
+   * @brief Render a thumbnail of a node in the viewer's graph
+   *
+   * `node` is a node in the original graph, the thumbnail is rendered from the cacher's copy of it.
+   * See RenderManager::RenderThumbnail() for the other parameters.
+   *
+   * Returns nullptr if the copy isn't up to date with the graph yet, in which case the caller
+   * should try again later.
+   */
+  RenderTicketPtr GetThumbnail(Node* node, const rational& time, int height, const QString& cache_file);
 
   /**
    * @brief If the mouse is held during the next cache invalidation, cache anyway
@@ -44,7 +77,7 @@ public:
   void IgnoreNextMouseButton();
 
   /**
-   * @brief Returns whether the auto-cache is currently paused or not
+   * @brief Returns whether every subscriber has paused auto-caching
    */
   bool IsPaused() const
   {
@@ -52,13 +85,12 @@ public:
   }
 
   /**
-   * @brief Sets whether the auto-cache is currently paused or not
-   * @param paused
+   * @brief Sets whether auto-caching around `subscriber`'s playhead is paused
    *
-   * If TRUE, the cache queue is cleared (any frames currently being rendered will be processed as
-   * normal however). If FALSE, any uncached frames in the range will automatically be queued.
+   * Frames for a paused subscriber are rendered without being cached. Auto-caching only stops once
+   * every subscriber has paused it.
    */
-  void SetPaused(bool paused);
+  void SetPaused(QObject* subscriber, bool paused);
 
   /**
    * @brief Force a certain range to be cached
@@ -70,50 +102,98 @@ public:
   void ForceCacheRange(const TimeRange& range);
 
   /**
-   * @brief Updates the range of frames to auto-cache
+   * @brief Moves `subscriber`'s playhead, updating the range of frames to auto-cache
+   */
+  void SetPlayhead(QObject* subscriber, const rational& playhead);
+
+  /**
+   * @brief Cancel queued video frames that no other subscriber is waiting on
+   *
+   * For a subscriber that has jumped elsewhere, since frames around its old playhead are requeued
+   * if they're still in range of another subscriber.
    */
-  void SetPlayhead(const rational& playhead);
+  void ClearSubscriberQueue(QObject* subscriber);
 
   void ClearHashQueue(bool wait = false);
   void ClearVideoQueue(bool wait = false);
   void ClearAudioQueue(bool wait = false);
   void ClearVideoDownloadQueue(bool wait = false);
 
+  /**
+   * @brief Cancels queued thumbnails and waits for running ones to finish
+   *
+   * Cancelled thumbnail tickets are finished without a result.
+   */
+  void ClearThumbnailQueue();
+
 private:
-  static void GenerateHashes(ViewerOutput *viewer, FrameHashCache *cache, const QVector<rational>& times, qint64 job_time);
+  PreviewAutoCacher();
 
-  void TryRender();
+  virtual ~PreviewAutoCacher() override;
+
+  void SetViewerNode(ViewerOutput *viewer_node);
+
+  struct Subscriber {
+    rational playhead;
+    bool paused;
 
-  RenderTicketWatcher *RenderFrame(const QByteArray& hash, const rational &time, bool prioritize, bool texture_only);
+    /// Single frame waiting to be sent to the renderer
+    RenderTicketPtr single_frame_render;
+
+    /// Most recent single frame sent to the renderer, only tracked while it's in video_tasks_
+    RenderTicketWatcher* single_frame_watcher;
+  };
 
   /**
-   * @brief Process all changes to internal NodeGraph copy
+   * @brief Rebuild the cache range and paused state from every subscriber
+   */
+  void UpdateCacheRanges();
+
+  bool HasQueuedSingleFrames() const;
+
+  static void GenerateHashes(ViewerOutput *viewer, FrameHashCache *cache, const QVector<rational>& times, qint64 job_time);
+
+  /**
+   * @brief Open decoders for clips starting shortly after the playhead
    *
-   * PreviewAutoCacher staggers updates to its internal NodeGraph copy, only applying them when the
-   * RenderManager is not reading from it. This function is called when such an opportunity arises.
+   * Opening a file and seeking into it is a lot slower than decoding the next frame of one that's
+   * already open, so playback would otherwise stall at every cut.
    */
-  void ProcessUpdateQueue();
+  void PrewarmUpcomingDecoders();
 
-  bool HasActiveJobs() const;
+  void ClearPrewarmQueue();
 
-  void AddNode(Node* node);
-  void RemoveNode(Node* node);
-  void AddEdge(const NodeOutput& output, const NodeInput& input);
-  void RemoveEdge(const NodeOutput& output, const NodeInput& input);
-  void CopyValue(const NodeInput& input);
+  /**
+   * @brief How far `time` is outside of `range`, or 0 if it's inside
+   */
+  static rational GetDistanceFromTime(const TimeRange& range, const rational& time);
 
-  void InsertIntoCopyMap(Node* node, Node* copy);
+  void TryRender();
+
+  RenderTicketWatcher *RenderFrame(const QByteArray& hash, const rational &time, ThreadPool::Priority priority, bool texture_only, const QRectF& roi = QRectF(), int divider = 0, bool keyframes_only = false);
 
-  void UpdateLastSyncedValue();
+  /**
+   * @brief Queue several background frames as one RenderManager batch, with a watcher for each
+   */
+  void RenderFrames(const QVector<QByteArray>& hashes, const QVector<rational>& times);
 
-  void CancelQueuedSingleFrameRender();
+  /**
+   * @brief Publish the length of each job queue to tracing and the metrics registry
+   */
+  void PublishQueueLengths();
 
-  template <typename T, typename Func>
-  void ClearQueueInternal(T& list, bool hard, Func member);
+  /**
+   * @brief Remember how long a frame took to render for PredictRenderTime()
+   */
+  void RecordRenderTime(const QByteArray& hash, const rational& time, qint64 nanoseconds);
 
-  void ClearQueueRemoveEventInternal(QMap<RenderTicketWatcher*, QByteArray>::iterator it);
-  void ClearQueueRemoveEventInternal(QMap<RenderTicketWatcher*, TimeRange>::iterator it);
-  void ClearQueueRemoveEventInternal(QVector<RenderTicketWatcher*>::iterator it);
+  /**
+   * @brief Guess how long a frame will take to render in nanoseconds, or -1 if there's no idea
+   *
+   * Identical frames are assumed to cost the same. Otherwise, edits rarely change how expensive a
+   * part of the sequence is, so the nearest frame measured since the viewer was set is used.
+   */
+  qint64 PredictRenderTime(const QByteArray& hash, const rational& time) const;
 
   class QueuedJob {
   public:
@@ -131,19 +211,126 @@ private:
     NodeOutput output;
   };
 
+  /**
+   * @brief A private copy of the NodeGraph that render jobs read from
+   *
+   * Every job pins the snapshot that was current when it was queued, and a snapshot is only ever
+   * modified while nothing is pinned to it. When the current snapshot is busy and the graph is
+   * edited, an idle one is brought up to date and published instead, so edits never have to wait
+   * for the render queue to drain.
+   */
+  class GraphSnapshot {
+  public:
+    GraphSnapshot() :
+      viewer(nullptr),
+      color_manager(nullptr),
+      pins(0),
+      last_update_time(0)
+    {
+    }
+
+    Project project;
+    QHash<Node*, Node*> copy_map;
+    ViewerOutput* viewer;
+    ColorManager* color_manager;
+
+    /// Graph changes that haven't been applied to this snapshot yet
+    QVector<QueuedJob> pending;
+
+    /// Number of jobs currently reading from this snapshot
+    int pins;
+
+    qint64 last_update_time;
+  };
+
+  /**
+   * @brief Creates a new snapshot copied from the current state of the viewer's NodeGraph
+   */
+  GraphSnapshot* CreateSnapshot();
+
+  /**
+   * @brief Applies all graph changes queued on a snapshot
+   *
+   * Must only be called on a snapshot that no job is pinned to.
+   */
+  void ProcessUpdateQueue(GraphSnapshot* snapshot);
+
+  /**
+   * @brief Publishes a snapshot that's in sync with the NodeGraph for new jobs to use
+   *
+   * Returns FALSE if every snapshot is busy and the limit has been reached, in which case the
+   * caller will have to wait for jobs to finish.
+   */
+  bool PublishSnapshot();
+
+  bool HasPendingGraphUpdates() const
+  {
+    return current_snapshot_ && !current_snapshot_->pending.isEmpty();
+  }
+
+  void QueueGraphUpdate(const QueuedJob& job);
+
+  /**
+   * @brief Queue several graph changes at once, idle snapshots are only brought up to date once
+   */
+  void QueueGraphUpdates(const QVector<QueuedJob>& jobs);
+
+  void PinSnapshot(QObject* job);
+  void UnpinSnapshot(QObject* job);
+
+  void AddNode(GraphSnapshot* snapshot, Node* node);
+  void RemoveNode(GraphSnapshot* snapshot, Node* node);
+  void AddEdge(GraphSnapshot* snapshot, const NodeOutput& output, const NodeInput& input);
+  void RemoveEdge(GraphSnapshot* snapshot, const NodeOutput& output, const NodeInput& input);
+  void CopyValue(GraphSnapshot* snapshot, const NodeInput& input);
+
+  void InsertIntoCopyMap(GraphSnapshot* snapshot, Node* node, Node* copy);
+
+  void CancelQueuedSingleFrameRender(Subscriber* subscriber);
+
+  /**
+   * @brief Take the subscriber's last single frame out of the render queue if it hasn't started yet
+   *
+   * Returns TRUE if there's no longer a single frame in the way of a newer one.
+   */
+  bool DropSupersededSingleFrame(QObject* subscriber);
+
+  /**
+   * @brief Whether a subscriber besides `subscriber` is waiting on the frame `watcher` renders
+   */
+  bool IsWaitedOnByOthers(RenderTicketWatcher* watcher, QObject* subscriber) const;
+
+  template <typename T, typename Func>
+  void ClearQueueInternal(T& list, bool hard, Func member);
+
+  /**
+   * @brief Clear a queue except for the watchers `keep` returns TRUE for
+   */
+  template <typename T, typename Func, typename Keep>
+  void ClearQueueInternal(T& list, bool hard, Func member, Keep keep);
+
+  void ClearQueueRemoveEventInternal(QMap<RenderTicketWatcher*, QByteArray>::iterator it);
+  void ClearQueueRemoveEventInternal(QMap<RenderTicketWatcher*, TimeRange>::iterator it);
+  void ClearQueueRemoveEventInternal(QVector<RenderTicketWatcher*>::iterator it);
+
+  static const int kMaximumSnapshots;
+
+  static QHash<ViewerOutput*, PreviewAutoCacher*> instances_;
+
   ViewerOutput* viewer_node_;
 
-  Project copied_project_;
+  QHash<QObject*, Subscriber> subscribers_;
 
-  QVector<QueuedJob> graph_update_queue_;
-  QHash<Node*, Node*> copy_map_;
-  ViewerOutput* copied_viewer_node_;
-  ColorManager* copied_color_manager_;
-  QVector<Node*> created_nodes_;
+  QVector<GraphSnapshot*> snapshots_;
+  GraphSnapshot* current_snapshot_;
+  QHash<QObject*, GraphSnapshot*> job_snapshots_;
 
   bool paused_;
 
-  TimeRange cache_range_;
+  // Playhead of whichever subscriber moved last, decoders are prewarmed around it
+  rational playhead_;
+
+  TimeRangeList cache_ranges_;
 
   bool has_changed_;
 
@@ -153,15 +340,16 @@ private:
   TimeRangeList invalidated_video_;
   TimeRangeList invalidated_audio_;
 
-  RenderTicketPtr single_frame_render_;
-
   QList<QFutureWatcher<void>*> hash_tasks_;
   QMap<RenderTicketWatcher*, TimeRange> audio_tasks_;
   QMap<RenderTicketWatcher*, QByteArray> video_tasks_;
   QMap<RenderTicketWatcher*, QByteArray> video_download_tasks_;
   QMap<RenderTicketWatcher*, QVector<RenderTicketPtr> > video_immediate_passthroughs_;
+  QVector<RenderTicketWatcher*> thumbnail_tasks_;
+  QVector<RenderTicketWatcher*> prewarm_tasks_;
 
-  qint64 last_update_time_;
+  // Clip starts that decoders have already been opened for
+  QVector<rational> prewarmed_times_;
 
   bool ignore_next_mouse_button_;
 
@@ -171,6 +359,25 @@ private:
 
   qint64 last_conform_task_;
 
+  QHash<QByteArray, qint64> hash_render_times_;
+  QMap<rational, qint64> time_render_times_;
+
+  /// How far from a measured frame its render time is still used as a prediction
+  static const rational kPredictionRange;
+
+  /// Frames predicted to take less than this fraction of a frame's duration are left to render live
+  static const double kRealtimeFraction;
+
+  static const int kMaximumRecordedHashes;
+
+  /// Most frames rendered together in one batch, small enough that render threads still share the work
+  static const int kRenderBatchSize;
+
+  /// Queue lengths last added to the metrics registry, which totals every cacher's queues
+  int published_hash_tasks_;
+  int published_video_tasks_;
+  int published_video_download_tasks_;
+
 private slots:
   /**
    * @brief Handler for when the NodeGraph reports a video change over a certain time range
@@ -192,6 +399,16 @@ private slots:
    */
   void AudioRendered();
 
+  /**
+   * @brief Handler for when the RenderManager has returned a thumbnail
+   */
+  void ThumbnailRendered();
+
+  /**
+   * @brief Handler for when the RenderManager has opened decoders for upcoming clips
+   */
+  void PrewarmFinished();
+
   /**
    * @brief Handler for when the RenderManager has returned rendered video frames
    */
@@ -212,6 +429,8 @@ private slots:
 
   void ValueChanged(const NodeInput& input);
 
+  void GraphBatchCommitted(const NodeGraphChangeSet& changes);
+
   /**
    * @brief Generic function called whenever the frames to render need to be (re)queued
    */
@@ -0,0 +1,198 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "projectcachestate.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+#include "core.h"
+
+namespace olive {
+
+// Identifies cache state files and their version, bump if the format changes
+const quint32 ProjectCacheState::kStateMagic = 0x4F435331;
+
+void ProjectCacheState::Save(Project *project)
+{
+  // A modified project no longer matches its file, so its caches wouldn't match it either
+  if (project->filename().isEmpty() || project->is_modified()) {
+    return;
+  }
+
+  QByteArray fingerprint = GetFingerprint(project->filename());
+  if (fingerprint.isEmpty()) {
+    return;
+  }
+
+  Discard(project);
+
+  QDir file_dir(GetStateFileDirectory(project));
+  if (!file_dir.mkpath(QStringLiteral("."))) {
+    return;
+  }
+
+  QSaveFile f(GetStateFilename(project));
+  if (!f.open(QFile::WriteOnly)) {
+    return;
+  }
+
+  QDataStream s(&f);
+  s.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+  QVector<ViewerOutput*> viewers = GetViewers(project);
+
+  s << kStateMagic << fingerprint << qint32(viewers.size());
+
+  foreach (ViewerOutput* viewer, viewers) {
+    // Each cache is written in its own block so one that can't be restored doesn't affect the rest
+    QByteArray video, audio;
+
+    Sequence* sequence = dynamic_cast<Sequence*>(viewer);
+    if (!sequence || !sequence->IsContentDeferred()) {
+      QDataStream vs(&video, QIODevice::WriteOnly);
+      vs.setFloatingPointPrecision(QDataStream::SinglePrecision);
+      viewer->video_frame_cache()->SaveState(vs, file_dir);
+
+      QDataStream as(&audio, QIODevice::WriteOnly);
+      as.setFloatingPointPrecision(QDataStream::SinglePrecision);
+      viewer->audio_playback_cache()->SaveState(as, file_dir);
+    }
+
+    s << viewer->id() << viewer->GetLabel() << video << audio;
+  }
+
+  if (s.status() != QDataStream::Ok || !f.commit()) {
+    Discard(project);
+  }
+}
+
+void ProjectCacheState::Restore(Project *project)
+{
+  QFile f(GetStateFilename(project));
+
+  if (project->filename().isEmpty() || !f.open(QFile::ReadOnly)) {
+    return;
+  }
+
+  QDataStream s(&f);
+  s.setFloatingPointPrecision(QDataStream::SinglePrecision);
+
+  quint32 magic;
+  QByteArray fingerprint;
+  qint32 count;
+
+  s >> magic >> fingerprint >> count;
+
+  QVector<ViewerOutput*> viewers = GetViewers(project);
+
+  if (s.status() == QDataStream::Ok
+      && magic == kStateMagic
+      && fingerprint == GetFingerprint(project->filename())
+      && count == viewers.size()) {
+    for (int i=0; i<count && s.status() == QDataStream::Ok; i++) {
+      QString id, label;
+      QByteArray video, audio;
+
+      s >> id >> label >> video >> audio;
+
+      ViewerOutput* viewer = viewers.at(i);
+
+      if (s.status() != QDataStream::Ok || video.isEmpty()
+          || viewer->id() != id || viewer->GetLabel() != label) {
+        continue;
+      }
+
+      if (Sequence* sequence = dynamic_cast<Sequence*>(viewer)) {
+        project->LoadDeferredSequence(sequence);
+      }
+
+      QDir file_dir(GetStateFileDirectory(project));
+
+      QDataStream vs(video);
+      vs.setFloatingPointPrecision(QDataStream::SinglePrecision);
+      viewer->video_frame_cache()->RestoreState(vs, file_dir);
+
+      QDataStream as(audio);
+      as.setFloatingPointPrecision(QDataStream::SinglePrecision);
+      viewer->audio_playback_cache()->RestoreState(as, file_dir);
+    }
+  }
+
+  f.close();
+
+  // The caches will move on from here, so this state will never be valid again
+  Discard(project);
+}
+
+QString ProjectCacheState::GetStateFilename(Project *project)
+{
+  return QDir(project->cache_path()).filePath(QStringLiteral("%1.cachestate").arg(project->GetUuid().toString()));
+}
+
+QString ProjectCacheState::GetStateFileDirectory(Project *project)
+{
+  return QDir(project->cache_path()).filePath(QStringLiteral("%1.cachestate.d").arg(project->GetUuid().toString()));
+}
+
+QByteArray ProjectCacheState::GetFingerprint(const QString &project_filename)
+{
+  QFile f(project_filename);
+
+  if (!f.open(QFile::ReadOnly)) {
+    return QByteArray();
+  }
+
+  // Hashes depend on how this version of Olive renders, so include that too
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(QCoreApplication::applicationVersion().toUtf8());
+  hash.addData(QByteArray::number(Core::kProjectVersion));
+
+  if (!hash.addData(&f)) {
+    return QByteArray();
+  }
+
+  return hash.result();
+}
+
+void ProjectCacheState::Discard(Project *project)
+{
+  QFile::remove(GetStateFilename(project));
+  QDir(GetStateFileDirectory(project)).removeRecursively();
+}
+
+QVector<ViewerOutput *> ProjectCacheState::GetViewers(Project *project)
+{
+  QVector<ViewerOutput*> viewers;
+
+  foreach (Node* n, project->nodes()) {
+    if (ViewerOutput* viewer = dynamic_cast<ViewerOutput*>(n)) {
+      viewers.append(viewer);
+    }
+  }
+
+  return viewers;
+}
+
+}
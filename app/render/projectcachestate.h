@@ -0,0 +1,79 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROJECTCACHESTATE_H
+#define PROJECTCACHESTATE_H
+
+#include "node/project/project.h"
+
+namespace olive {
+
+/**
+ * @brief Keeps a project's playback caches from one session to the next
+ *
+ * Every time a project is opened, its sequences' caches start out empty, and every frame has to
+ * be hashed again before any frame already cached on disk can be found and shown. To avoid that,
+ * the time to hash maps and validated ranges of every cache (and the audio cache's PCM) are saved
+ * to a sidecar file in the project's cache directory when it's closed.
+ *
+ * The sidecar is tagged with a fingerprint of the project file it was saved against, so it's only
+ * restored if the project is opened again unchanged. Since a project can only differ from its file
+ * when it's modified, caches are only saved when an unmodified project is closed, and a sidecar is
+ * always deleted once it's been read.
+ */
+class ProjectCacheState
+{
+public:
+  /**
+   * @brief Save the state of every cache in `project`
+   *
+   * Must only be called just before the project is destroyed, see PlaybackCache::SaveState().
+   */
+  static void Save(Project* project);
+
+  /**
+   * @brief Restore caches saved the last time `project` was closed, if there's nothing stale
+   *
+   * Sequences that had saved caches have their deferred contents loaded, otherwise the caches
+   * would be invalidated as soon as they were.
+   */
+  static void Restore(Project* project);
+
+private:
+  static QString GetStateFilename(Project* project);
+
+  static QString GetStateFileDirectory(Project* project);
+
+  static QByteArray GetFingerprint(const QString& project_filename);
+
+  static void Discard(Project* project);
+
+  /**
+   * @brief Every output with caches, in an order that's the same for an identical project
+   */
+  static QVector<ViewerOutput*> GetViewers(Project* project);
+
+  static const quint32 kStateMagic;
+
+};
+
+}
+
+#endif // PROJECTCACHESTATE_H
@@ -21,21 +21,62 @@
 #ifndef RENDERCACHE_H
 #define RENDERCACHE_H
 
+#include <QHash>
+#include <QMutex>
+
 #include "codec/decoder.h"
+#include "common/threadsafemap.h"
 
 namespace olive {
 
+/**
+ * @brief Hash map split into shards that are each locked separately
+ *
+ * Entries are only ever accessed with their shard's mutex held, but since keys are spread over
+ * kShardCount shards, threads working with different keys rarely wait on each other. Operations
+ * over the whole map go through each shard in turn with shard_mutex() and shard_map().
+ */
 template <typename K, typename V>
-class RenderCache : public QHash<K, V>
+class RenderCache
 {
 public:
-  QMutex *mutex()
+  enum { kShardCount = 16 };
+
+  QMutex *mutex(const K& key)
+  {
+    return &shards_[ShardOf(key)].mutex;
+  }
+
+  /**
+   * @brief The map holding `key`, only access it with mutex(key) held
+   */
+  QHash<K, V>& map(const K& key)
   {
-    return &mutex_;
+    return shards_[ShardOf(key)].map;
+  }
+
+  QMutex *shard_mutex(int shard)
+  {
+    return &shards_[shard].mutex;
+  }
+
+  QHash<K, V>& shard_map(int shard)
+  {
+    return shards_[shard].map;
   }
 
 private:
-  QMutex mutex_;
+  static int ShardOf(const K& key)
+  {
+    return int(qHash(key) % kShardCount);
+  }
+
+  struct Shard {
+    QMutex mutex;
+    QHash<K, V> map;
+  };
+
+  Shard shards_[kShardCount];
 
 };
 
@@ -44,14 +85,36 @@ struct DecoderPair {
   {
     decoder = nullptr;
     last_modified = 0;
+    last_time = 0;
+    playback_time = 0;
+    users = 0;
   }
 
   DecoderPtr decoder;
   qint64 last_modified;
+
+  // Time of the last frame requested from this decoder, used to route new requests to the
+  // instance that's already closest to them
+  rational last_time;
+
+  // Sequence time of the last frame this decoder was used for, decoders furthest from the playhead
+  // are the first to be closed when too many are open
+  rational playback_time;
+
+  // Number of processors currently retrieving from this decoder
+  int users;
 };
 
-using DecoderCache = RenderCache<Decoder::CodecStream, DecoderPair>;
-using ShaderCache = RenderCache<QString, QVariant>;
+/**
+ * @brief Small pool of decoders opened on the same stream
+ *
+ * Multiple instances allow render threads working on different parts of the same footage to
+ * decode concurrently instead of forcing one decoder to seek back and forth between them.
+ */
+using DecoderPool = QVector<DecoderPair>;
+
+using DecoderCache = RenderCache<Decoder::CodecStream, DecoderPool>;
+using ShaderCache = ThreadSafeMap<QString, QVariant>;
 
 }
 
@@ -23,6 +23,7 @@
 #include <QVector2D>
 
 #include "common/ocioutils.h"
+#include "render/colorbakecache.h"
 
 namespace olive {
 
@@ -54,12 +55,17 @@ TexturePtr Renderer::CreateTexture(const VideoParams &params, const void *data,
 
 void Renderer::BlitColorManaged(ColorProcessorPtr color_processor, TexturePtr source, bool source_is_premultiplied, Texture *destination, bool clear_destination, const QMatrix4x4 &matrix, const QMatrix4x4 &crop_matrix)
 {
-  BlitColorManagedInternal(color_processor, source, source_is_premultiplied, destination, destination->params(), clear_destination, matrix, crop_matrix);
+  BlitColorManagedInternal(color_processor, source, source_is_premultiplied, PlanarYUV(), destination, destination->params(), clear_destination, matrix, crop_matrix);
 }
 
 void Renderer::BlitColorManaged(ColorProcessorPtr color_processor, TexturePtr source, bool source_is_premultiplied, VideoParams params, bool clear_destination, const QMatrix4x4& matrix, const QMatrix4x4 &crop_matrix)
 {
-  BlitColorManagedInternal(color_processor, source, source_is_premultiplied, nullptr, params, clear_destination, matrix, crop_matrix);
+  BlitColorManagedInternal(color_processor, source, source_is_premultiplied, PlanarYUV(), nullptr, params, clear_destination, matrix, crop_matrix);
+}
+
+void Renderer::BlitColorManagedPlanarYUV(ColorProcessorPtr color_processor, TexturePtr source, const PlanarYUV &yuv, Texture *destination, bool clear_destination)
+{
+  BlitColorManagedInternal(color_processor, source, false, yuv, destination, destination->params(), clear_destination, QMatrix4x4(), QMatrix4x4());
 }
 
 TexturePtr Renderer::InterlaceTexture(TexturePtr top, TexturePtr bottom, const VideoParams &params)
@@ -82,6 +88,84 @@ TexturePtr Renderer::InterlaceTexture(TexturePtr top, TexturePtr bottom, const V
   return output;
 }
 
+TexturePtr Renderer::DeinterlaceTexture(TexturePtr prev, TexturePtr cur, TexturePtr next, bool second_field, VideoParams::Interlacing field_order)
+{
+  color_cache_mutex_.lock();
+  if (deinterlace_shader_.isNull()) {
+    deinterlace_shader_ = CreateNativeShader(ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/yadif.frag"))));
+  }
+  color_cache_mutex_.unlock();
+
+  // The top field is the first in time unless the footage is bottom first
+  bool top_field = (field_order == VideoParams::kInterlacedBottomFirst) ? second_field : !second_field;
+
+  ShaderJob job;
+  job.InsertValue(QStringLiteral("prev_tex_in"), NodeValue(NodeValue::kTexture, QVariant::fromValue(prev)));
+  job.InsertValue(QStringLiteral("cur_tex_in"), NodeValue(NodeValue::kTexture, QVariant::fromValue(cur)));
+  job.InsertValue(QStringLiteral("next_tex_in"), NodeValue(NodeValue::kTexture, QVariant::fromValue(next)));
+  job.InsertValue(QStringLiteral("resolution_in"), NodeValue(NodeValue::kVec2, QVector2D(cur->width(), cur->height())));
+  job.InsertValue(QStringLiteral("field_in"), NodeValue(NodeValue::kInt, top_field ? 0 : 1));
+  job.InsertValue(QStringLiteral("second_field_in"), NodeValue(NodeValue::kBoolean, second_field));
+
+  // Every sample has to land on an exact line of the right field
+  job.SetInterpolation(QStringLiteral("prev_tex_in"), Texture::kNearest);
+  job.SetInterpolation(QStringLiteral("cur_tex_in"), Texture::kNearest);
+  job.SetInterpolation(QStringLiteral("next_tex_in"), Texture::kNearest);
+
+  VideoParams params = cur->params();
+  params.set_interlacing(VideoParams::kInterlaceNone);
+
+  TexturePtr output = CreateTexture(params);
+
+  BlitToTexture(deinterlace_shader_, job, output.get());
+
+  return output;
+}
+
+TexturePtr Renderer::PackPlanarYUV(TexturePtr source, const PlanarYUV &yuv)
+{
+  color_cache_mutex_.lock();
+  if (yuv_pack_shader_.isNull()) {
+    yuv_pack_shader_ = CreateNativeShader(ShaderCode(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/yuvpack.frag"))));
+  }
+  color_cache_mutex_.unlock();
+
+  const VideoParams& src = source->params();
+  int width = src.effective_width();
+  int height = src.effective_height();
+
+  double kr, kb;
+  yuv.GetCoefficients(&kr, &kb);
+
+  // Code values are defined at 8 bits and shifted up for higher depths, which are stored in the
+  // low bits of 16-bit samples
+  double container_max = (yuv.format() == VideoParams::kFormatUnsigned16) ? 65535.0 : 255.0;
+  double code_scale = double(1 << (yuv.bit_depth() - 8)) / container_max;
+
+  ShaderJob job;
+  job.InsertValue(QStringLiteral("ove_maintex"), NodeValue(NodeValue::kTexture, QVariant::fromValue(source)));
+  job.InsertValue(QStringLiteral("resolution_in"), NodeValue(NodeValue::kVec2, QVector2D(width, height)));
+  job.InsertValue(QStringLiteral("chroma_size_in"), NodeValue(NodeValue::kVec2, QVector2D(yuv.chroma_width(width), yuv.chroma_height(height))));
+  job.InsertValue(QStringLiteral("kr_in"), NodeValue(NodeValue::kFloat, kr));
+  job.InsertValue(QStringLiteral("kb_in"), NodeValue(NodeValue::kFloat, kb));
+  job.InsertValue(QStringLiteral("code_scale_in"), NodeValue(NodeValue::kFloat, code_scale));
+  job.SetInterpolation(QStringLiteral("ove_maintex"), Texture::kLinear);
+
+  VideoParams packed_params = src;
+  packed_params.set_divider(1);
+  packed_params.set_width(width);
+  packed_params.set_height(yuv.packed_height(height));
+  packed_params.set_pixel_aspect_ratio(rational(1));
+  packed_params.set_format(yuv.format());
+  packed_params.set_channel_count(1);
+
+  TexturePtr output = CreateTexture(packed_params);
+
+  BlitToTexture(yuv_pack_shader_, job, output.get());
+
+  return output;
+}
+
 void Renderer::Destroy()
 {
   color_cache_.clear();
@@ -91,6 +175,16 @@ void Renderer::Destroy()
     interlace_texture_.clear();
   }
 
+  if (!deinterlace_shader_.isNull()) {
+    DestroyNativeShader(deinterlace_shader_);
+    deinterlace_shader_.clear();
+  }
+
+  if (!yuv_pack_shader_.isNull()) {
+    DestroyNativeShader(yuv_pack_shader_);
+    yuv_pack_shader_.clear();
+  }
+
   DestroyInternal();
 }
 
@@ -103,25 +197,29 @@ TexturePtr Renderer::CreateTextureFromNativeHandle(const QVariant &v, const Vide
   return std::make_shared<Texture>(this, v, params, type);
 }
 
-bool Renderer::GetColorContext(ColorProcessorPtr color_processor, Renderer::ColorContext *ctx)
+bool Renderer::GetColorContext(ColorProcessorPtr color_processor, bool planar_yuv, Renderer::ColorContext *ctx)
 {
   QMutexLocker locker(&color_cache_mutex_);
 
   ColorContext& color_ctx = *ctx;
 
-  if (color_cache_.contains(color_processor->id())) {
-    color_ctx = color_cache_.value(color_processor->id());
+  // Planar YUV sources need their own variant of the shader that unpacks them first
+  QString cache_id = color_processor->id();
+  if (planar_yuv) {
+    cache_id.append(QStringLiteral(":yuv"));
+  }
+
+  if (color_cache_.contains(cache_id)) {
+    color_ctx = color_cache_.value(cache_id);
     return true;
   } else {
-    // Create shader description
+    // Bakes are shared between renderers and sessions, only our shader and textures are our own
     const char* ocio_func_name = "OCIODisplay";
-    auto shader_desc = OCIO::GpuShaderDesc::CreateShaderDesc();
-    shader_desc->setLanguage(OCIO::GPU_LANGUAGE_GLSL_1_3);
-    shader_desc->setFunctionName(ocio_func_name);
-    shader_desc->setResourcePrefix("ocio_");
+    BakedColorTransform bake = ColorBakeCache::Get(color_processor, ocio_func_name);
 
-    // Generate shader
-    color_processor->GetProcessor()->getDefaultGPUProcessor()->extractGpuShaderInfo(shader_desc);
+    if (!bake.IsValid()) {
+      return false;
+    }
 
     QString shader_frag;
     shader_frag.append(QStringLiteral("// Main texture input\n"
@@ -138,7 +236,11 @@ bool Renderer::GetColorContext(ColorProcessorPtr color_processor, Renderer::Colo
                                       "// Main texture coordinate\n"
                                       "varying vec2 ove_texcoord;\n"
                                       "\n"));
-    shader_frag.append(shader_desc->getShaderText());
+    if (planar_yuv) {
+      shader_frag.append(FileFunctions::ReadFileAsString(QStringLiteral(":/shaders/yuvunpack.frag")));
+      shader_frag.append(QStringLiteral("\n"));
+    }
+    shader_frag.append(bake.shader_text);
     shader_frag.append(QStringLiteral("\n"
                                       "// Alpha association functions\n"
                                       "vec4 assoc(vec4 c) {\n"
@@ -160,7 +262,7 @@ bool Renderer::GetColorContext(ColorProcessorPtr color_processor, Renderer::Colo
                                       "    return;\n"
                                       "  }\n"
                                       "  \n"
-                                      "  vec4 col = texture2D(ove_maintex, cropped_coord);\n"
+                                      "  vec4 col = %2;\n"
                                       "\n"
                                       "  // If alpha is associated, de-associate now\n"
                                       "  if (ove_maintex_alpha == ALPHA_ASSOC) {\n"
@@ -178,7 +280,9 @@ bool Renderer::GetColorContext(ColorProcessorPtr color_processor, Renderer::Colo
                                       "  }\n"
                                       "\n"
                                       "  gl_FragColor = col;\n"
-                                      "}\n").arg(ocio_func_name));
+                                      "}\n").arg(QString(ocio_func_name),
+                                                  planar_yuv ? QStringLiteral("ove_unpack_yuv(ove_maintex, cropped_coord)")
+                                                             : QStringLiteral("texture2D(ove_maintex, cropped_coord)")));
 
     // Try to compile shader
     color_ctx.compiled_shader = CreateNativeShader(ShaderCode(shader_frag,
@@ -188,81 +292,42 @@ bool Renderer::GetColorContext(ColorProcessorPtr color_processor, Renderer::Colo
       return false;
     }
 
-    color_ctx.lut3d_textures.resize(shader_desc->getNum3DTextures());
-    for (unsigned int i=0; i<shader_desc->getNum3DTextures(); i++) {
-      const char* tex_name = nullptr;
-      const char* sampler_name = nullptr;
-      unsigned int edge_len = 0;
-      OCIO::Interpolation interpolation = OCIO::INTERP_LINEAR;
-
-      shader_desc->get3DTexture(i, tex_name, sampler_name, edge_len, interpolation);
-
-      if (!tex_name || !*tex_name
-          || !sampler_name || !*sampler_name
-          || !edge_len) {
-        qCritical() << "3D LUT texture data is corrupted";
-        return false;
-      }
-
-      const float* values = nullptr;
-      shader_desc->get3DTextureValues(i, values);
-      if (!values) {
-        qCritical() << "3D LUT texture values are missing";
-        return false;
-      }
+    color_ctx.lut3d_textures.resize(bake.lut3d.size());
+    for (int i=0; i<bake.lut3d.size(); i++) {
+      const BakedColorTransform::LUT& lut = bake.lut3d.at(i);
 
       // Allocate 3D LUT
-      color_ctx.lut3d_textures[i].texture = CreateTexture(VideoParams(edge_len, edge_len, edge_len, VideoParams::kFormatFloat32, VideoParams::kRGBChannelCount),
-                                                          Texture::k3D, values);
-      color_ctx.lut3d_textures[i].name = sampler_name;
-      color_ctx.lut3d_textures[i].interpolation = (interpolation == OCIO::INTERP_NEAREST) ? Texture::kNearest : Texture::kLinear;
+      color_ctx.lut3d_textures[i].texture = CreateTexture(VideoParams(lut.width, lut.height, lut.depth, VideoParams::kFormatFloat32, lut.channel_count),
+                                                          Texture::k3D, lut.values.constData());
+      color_ctx.lut3d_textures[i].name = lut.sampler_name;
+      color_ctx.lut3d_textures[i].interpolation = lut.interpolation;
     }
 
-    color_ctx.lut1d_textures.resize(shader_desc->getNumTextures());
-    for (unsigned int i=0; i<shader_desc->getNumTextures(); i++) {
-      const char* tex_name = nullptr;
-      const char* sampler_name = nullptr;
-      unsigned int width = 0, height = 0;
-      OCIO::GpuShaderDesc::TextureType channel = OCIO::GpuShaderDesc::TEXTURE_RGB_CHANNEL;
-      OCIO::Interpolation interpolation = OCIO::INTERP_LINEAR;
-
-      shader_desc->getTexture(i, tex_name, sampler_name, width, height, channel, interpolation);
-
-      if (!tex_name || !*tex_name
-          || !sampler_name || !*sampler_name
-          || !width) {
-        qCritical() << "1D LUT texture data is corrupted";
-        return false;
-      }
-
-      const float* values = nullptr;
-      shader_desc->getTextureValues(i, values);
-      if (!values) {
-        qCritical() << "1D LUT texture values are missing";
-        return false;
-      }
+    color_ctx.lut1d_textures.resize(bake.lut1d.size());
+    for (int i=0; i<bake.lut1d.size(); i++) {
+      const BakedColorTransform::LUT& lut = bake.lut1d.at(i);
 
       // Allocate 1D LUT
-      color_ctx.lut1d_textures[i].texture = CreateTexture(VideoParams(width, height, VideoParams::kFormatFloat32, (channel == OCIO::GpuShaderDesc::TEXTURE_RED_CHANNEL) ? 1 : VideoParams::kRGBChannelCount),
+      color_ctx.lut1d_textures[i].texture = CreateTexture(VideoParams(lut.width, lut.height, VideoParams::kFormatFloat32, lut.channel_count),
                                                           Texture::k2D,
-                                                          values);
-      color_ctx.lut1d_textures[i].name = sampler_name;
-      color_ctx.lut1d_textures[i].interpolation = (interpolation == OCIO::INTERP_NEAREST) ? Texture::kNearest : Texture::kLinear;
+                                                          lut.values.constData());
+      color_ctx.lut1d_textures[i].name = lut.sampler_name;
+      color_ctx.lut1d_textures[i].interpolation = lut.interpolation;
     }
 
-    color_cache_.insert(color_processor->id(), color_ctx);
+    color_cache_.insert(cache_id, color_ctx);
 
     return true;
   }
 }
 
 void Renderer::BlitColorManagedInternal(ColorProcessorPtr color_processor, TexturePtr source,
-                                        bool source_is_premultiplied, Texture *destination,
-                                        VideoParams params, bool clear_destination, const QMatrix4x4& matrix,
-                                        const QMatrix4x4& crop_matrix)
+                                        bool source_is_premultiplied, const PlanarYUV &source_yuv,
+                                        Texture *destination, VideoParams params, bool clear_destination,
+                                        const QMatrix4x4& matrix, const QMatrix4x4& crop_matrix)
 {
   ColorContext color_ctx;
-  if (!GetColorContext(color_processor, &color_ctx)) {
+  if (!GetColorContext(color_processor, source_yuv.IsValid(), &color_ctx)) {
     return;
   }
 
@@ -287,6 +352,44 @@ void Renderer::BlitColorManagedInternal(ColorProcessorPtr color_processor, Textu
   }
   job.InsertValue(QStringLiteral("ove_maintex_alpha"), NodeValue(NodeValue::kInt, associated));
 
+  if (source_yuv.IsValid()) {
+    int width = source->width();
+    int height = source_yuv.picture_height(source->height());
+
+    double kr, kb;
+    source_yuv.GetCoefficients(&kr, &kb);
+
+    // Work out where black and neutral chroma sit in the texture's normalized values, and how far
+    // it is from there to white and full saturation
+    double container_max = (source_yuv.format() == VideoParams::kFormatUnsigned16) ? 65535.0 : 255.0;
+    double code_max = double((1 << source_yuv.bit_depth()) - 1);
+    double step = double(1 << (source_yuv.bit_depth() - 8));
+    double luma_offset, luma_range, chroma_range;
+    double chroma_offset = 128.0 * step;
+
+    if (source_yuv.full_range()) {
+      luma_offset = 0;
+      luma_range = code_max;
+      chroma_range = code_max;
+    } else {
+      luma_offset = 16.0 * step;
+      luma_range = 219.0 * step;
+      chroma_range = 224.0 * step;
+    }
+
+    job.InsertValue(QStringLiteral("ove_yuv_resolution"), NodeValue(NodeValue::kVec2, QVector2D(width, height)));
+    job.InsertValue(QStringLiteral("ove_yuv_chroma_size"), NodeValue(NodeValue::kVec2, QVector2D(source_yuv.chroma_width(width), source_yuv.chroma_height(height))));
+    job.InsertValue(QStringLiteral("ove_yuv_kr"), NodeValue(NodeValue::kFloat, kr));
+    job.InsertValue(QStringLiteral("ove_yuv_kb"), NodeValue(NodeValue::kFloat, kb));
+    job.InsertValue(QStringLiteral("ove_yuv_luma_offset"), NodeValue(NodeValue::kFloat, luma_offset / container_max));
+    job.InsertValue(QStringLiteral("ove_yuv_luma_scale"), NodeValue(NodeValue::kFloat, container_max / luma_range));
+    job.InsertValue(QStringLiteral("ove_yuv_chroma_offset"), NodeValue(NodeValue::kFloat, chroma_offset / container_max));
+    job.InsertValue(QStringLiteral("ove_yuv_chroma_scale"), NodeValue(NodeValue::kFloat, container_max / chroma_range));
+
+    // Samples are picked out of each plane exactly, interpolating between planes would mix them
+    job.SetInterpolation(QStringLiteral("ove_maintex"), Texture::kNearest);
+  }
+
   foreach (const ColorContext::LUT& l, color_ctx.lut3d_textures) {
     job.InsertValue(l.name, NodeValue(NodeValue::kTexture, QVariant::fromValue(l.texture)));
     job.SetInterpolation(l.name, l.interpolation);
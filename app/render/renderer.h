@@ -29,6 +29,7 @@
 #include "common/timerange.h"
 #include "node/node.h"
 #include "render/colorprocessor.h"
+#include "render/planaryuv.h"
 #include "render/videoparams.h"
 #include "texture.h"
 
@@ -66,12 +67,81 @@ public:
   void BlitColorManaged(ColorProcessorPtr color_processor, TexturePtr source, bool source_is_premultiplied, Texture* destination, bool clear_destination = true, const QMatrix4x4& matrix = QMatrix4x4(), const QMatrix4x4 &crop_matrix = QMatrix4x4());
   void BlitColorManaged(ColorProcessorPtr color_processor, TexturePtr source, bool source_is_premultiplied, VideoParams params, bool clear_destination = true, const QMatrix4x4& matrix = QMatrix4x4(), const QMatrix4x4 &crop_matrix = QMatrix4x4());
 
+  /**
+   * @brief Color manage a single channel texture holding planar YUV packed as described by `yuv`
+   *
+   * The matrix and range conversion to RGB happens in the same pass as the color transform, so
+   * footage can be uploaded in its native layout.
+   */
+  void BlitColorManagedPlanarYUV(ColorProcessorPtr color_processor, TexturePtr source, const PlanarYUV& yuv, Texture* destination, bool clear_destination = true);
+
   TexturePtr InterlaceTexture(TexturePtr top, TexturePtr bottom, const VideoParams &params);
 
+  /**
+   * @brief Deinterlace one field of `cur` using the woven frames either side of it
+   *
+   * Lines of the field being shown are kept, and the others are interpolated spatially or
+   * temporally depending on how much they're moving. `prev` and `next` may be `cur` itself at either
+   * end of the footage. Returns a progressive texture with the same parameters as `cur`.
+   */
+  TexturePtr DeinterlaceTexture(TexturePtr prev, TexturePtr cur, TexturePtr next, bool second_field, VideoParams::Interlacing field_order);
+
+  /**
+   * @brief Convert an RGB(A) texture to a single channel texture laid out as described by `yuv`
+   *
+   * `source` should already be in the output's color space. Alpha is discarded.
+   */
+  TexturePtr PackPlanarYUV(TexturePtr source, const PlanarYUV& yuv);
+
   void Destroy();
 
   virtual void PostDestroy() = 0;
 
+  struct TexturePoolStats {
+    /// Total size of every texture this renderer has allocated, whether in use or pooled
+    qint64 allocated_bytes;
+
+    /// Size of the textures that are sitting idle in the pool
+    qint64 pooled_bytes;
+
+    int pooled_textures;
+
+    qint64 hits;
+    qint64 misses;
+  };
+
+  /**
+   * @brief Retrieve statistics about the renderer's texture pool
+   *
+   * Safe to call from any thread.
+   */
+  virtual TexturePoolStats GetTexturePoolStats() const
+  {
+    return {0, 0, 0, 0, 0};
+  }
+
+  /**
+   * @brief Number of textures a single shader can sample from at once
+   *
+   * Only valid once the renderer has been initialized. Safe to call from any thread.
+   */
+  virtual int GetMaximumTextureUnits() const
+  {
+    // Minimum guaranteed by OpenGL 2.0
+    return 16;
+  }
+
+  /**
+   * @brief Largest width or height a texture can have
+   *
+   * Only valid once the renderer has been initialized. Safe to call from any thread.
+   */
+  virtual int GetMaximumTextureSize() const
+  {
+    // Supported by practically every GPU still in use
+    return 4096;
+  }
+
 public slots:
   virtual void PostInit() = 0;
 
@@ -92,10 +162,49 @@ public slots:
 
   virtual void DownloadFromTexture(olive::Texture* texture, void* data, int linesize) = 0;
 
+  /**
+   * @brief Begin downloading a texture's contents without waiting for the transfer to complete
+   *
+   * Returns a handle that must be passed to FinishDownloadFromTexture(). Any GPU work submitted in
+   * the meantime (e.g. the next frame's render) can overlap with the transfer.
+   */
+  virtual QVariant StartDownloadFromTexture(olive::Texture* texture, int linesize) = 0;
+
+  /**
+   * @brief Wait for a download started with StartDownloadFromTexture() and copy it into `data`
+   *
+   * `data` must be large enough for the texture's height at the linesize the download was started
+   * with.
+   */
+  virtual void FinishDownloadFromTexture(QVariant handle, void* data) = 0;
+
   virtual void Flush() = 0;
 
+  /**
+   * @brief Submit all queued work so `texture` can be used by renderers on other threads
+   *
+   * Unlike Flush(), this doesn't wait for the GPU. Backends attach a GPU-side fence to the texture
+   * instead, which other renderers wait on before they sample or download it.
+   */
+  virtual void SubmitTexture(olive::Texture* texture) = 0;
+
   virtual Color GetPixelFromTexture(olive::Texture *texture, const QPointF &pt) = 0;
 
+  /**
+   * @brief Begin reading a single pixel without waiting for the GPU
+   *
+   * Returns a handle that must be passed to TryFinishPixelFromTexture() until it succeeds.
+   */
+  virtual QVariant StartPixelFromTexture(olive::Texture *texture, const QPointF &pt) = 0;
+
+  /**
+   * @brief Collect a pixel read started with StartPixelFromTexture() if it has arrived
+   *
+   * Never waits for the GPU. Returns TRUE and sets `color` if the read has completed, at which
+   * point the handle is no longer valid. Otherwise returns FALSE and the read stays pending.
+   */
+  virtual bool TryFinishPixelFromTexture(QVariant handle, olive::Color* color) = 0;
+
 protected slots:
   virtual void Blit(QVariant shader,
                     olive::ShaderJob job,
@@ -126,10 +235,10 @@ private:
     kAlphaAssociated
   };
 
-  bool GetColorContext(ColorProcessorPtr color_processor, ColorContext* ctx);
+  bool GetColorContext(ColorProcessorPtr color_processor, bool planar_yuv, ColorContext* ctx);
 
   void BlitColorManagedInternal(ColorProcessorPtr color_processor, TexturePtr source,
-                                bool source_is_premultiplied,
+                                bool source_is_premultiplied, const PlanarYUV& source_yuv,
                                 Texture* destination, VideoParams params, bool clear_destination,
                                 const QMatrix4x4 &matrix, const QMatrix4x4 &crop_matrix);
 
@@ -139,6 +248,10 @@ private:
 
   QVariant interlace_texture_;
 
+  QVariant deinterlace_shader_;
+
+  QVariant yuv_pack_shader_;
+
 };
 
 }
@@ -151,11 +151,36 @@ void RendererThreadWrapper::DownloadFromTexture(Texture *texture, void *data, in
                             Q_ARG(int, linesize));
 }
 
+QVariant RendererThreadWrapper::StartDownloadFromTexture(Texture *texture, int linesize)
+{
+  QVariant v;
+
+  QMetaObject::invokeMethod(inner_, "StartDownloadFromTexture", Qt::BlockingQueuedConnection,
+                            Q_RETURN_ARG(QVariant, v),
+                            OLIVE_NS_ARG(Texture*, texture),
+                            Q_ARG(int, linesize));
+
+  return v;
+}
+
+void RendererThreadWrapper::FinishDownloadFromTexture(QVariant handle, void *data)
+{
+  QMetaObject::invokeMethod(inner_, "FinishDownloadFromTexture", Qt::BlockingQueuedConnection,
+                            Q_ARG(QVariant, handle),
+                            Q_ARG(void*, data));
+}
+
 void RendererThreadWrapper::Flush()
 {
   QMetaObject::invokeMethod(inner_, "Flush", Qt::BlockingQueuedConnection);
 }
 
+void RendererThreadWrapper::SubmitTexture(Texture *texture)
+{
+  QMetaObject::invokeMethod(inner_, "SubmitTexture", Qt::BlockingQueuedConnection,
+                            OLIVE_NS_ARG(Texture*, texture));
+}
+
 Color RendererThreadWrapper::GetPixelFromTexture(Texture *texture, const QPointF &pt)
 {
   Color c;
@@ -168,6 +193,30 @@ Color RendererThreadWrapper::GetPixelFromTexture(Texture *texture, const QPointF
   return c;
 }
 
+QVariant RendererThreadWrapper::StartPixelFromTexture(Texture *texture, const QPointF &pt)
+{
+  QVariant v;
+
+  QMetaObject::invokeMethod(inner_, "StartPixelFromTexture", Qt::BlockingQueuedConnection,
+                            Q_RETURN_ARG(QVariant, v),
+                            OLIVE_NS_ARG(Texture*, texture),
+                            Q_ARG(QPointF, pt));
+
+  return v;
+}
+
+bool RendererThreadWrapper::TryFinishPixelFromTexture(QVariant handle, Color *color)
+{
+  bool b;
+
+  QMetaObject::invokeMethod(inner_, "TryFinishPixelFromTexture", Qt::BlockingQueuedConnection,
+                            Q_RETURN_ARG(bool, b),
+                            Q_ARG(QVariant, handle),
+                            OLIVE_NS_ARG(Color*, color));
+
+  return b;
+}
+
 void RendererThreadWrapper::Blit(QVariant shader, ShaderJob job, Texture *destination, VideoParams destination_params, bool clear_destination)
 {
   QMetaObject::invokeMethod(inner_, "Blit", Qt::BlockingQueuedConnection,
@@ -43,6 +43,18 @@ public:
 
   virtual void PostDestroy() override {}
 
+  virtual TexturePoolStats GetTexturePoolStats() const override
+  {
+    // Stats are guarded by the inner renderer so there's no need to go through its thread
+    return inner_->GetTexturePoolStats();
+  }
+
+  virtual int GetMaximumTextureUnits() const override
+  {
+    // Only set during initialization so there's no need to go through the inner renderer's thread
+    return inner_->GetMaximumTextureUnits();
+  }
+
 public slots:
   virtual void PostInit() override;
 
@@ -63,10 +75,20 @@ public slots:
 
   virtual void DownloadFromTexture(olive::Texture* texture, void* data, int linesize) override;
 
+  virtual QVariant StartDownloadFromTexture(olive::Texture* texture, int linesize) override;
+
+  virtual void FinishDownloadFromTexture(QVariant handle, void* data) override;
+
   virtual void Flush() override;
 
+  virtual void SubmitTexture(olive::Texture* texture) override;
+
   virtual Color GetPixelFromTexture(olive::Texture *texture, const QPointF &pt) override;
 
+  virtual QVariant StartPixelFromTexture(olive::Texture *texture, const QPointF &pt) override;
+
+  virtual bool TryFinishPixelFromTexture(QVariant handle, olive::Color* color) override;
+
 protected slots:
   virtual void Blit(QVariant shader,
                     olive::ShaderJob job,
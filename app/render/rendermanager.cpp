@@ -20,12 +20,15 @@
 
 #include "rendermanager.h"
 
+#include <algorithm>
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QMatrix4x4>
 #include <QThread>
 
 #include "config/config.h"
 #include "core.h"
+#include "render/memorygovernor.h"
 #include "render/opengl/openglrenderer.h"
 #include "render/rendererthreadwrapper.h"
 #include "renderprocessor.h"
@@ -37,85 +40,371 @@ namespace olive {
 
 RenderManager* RenderManager::instance_ = nullptr;
 const int RenderManager::kDecoderMaximumInactivity = 10000;
+const int RenderManager::kMaximumIdleDecoders = 24;
+const rational RenderManager::kDecoderLookahead = rational(5);
+
+const int RenderManager::kMaximumRenderContexts = 8;
 
 RenderManager::RenderManager(QObject *parent) :
   ThreadPool(QThread::IdlePriority, 0, parent),
   backend_(kOpenGL)
 {
-  Renderer* graphics_renderer = nullptr;
+  // Workstations with several GPUs can spread background rendering across them by using more
+  // than one context, each on its own thread
+  int context_count = qBound(1, Config::Current()[QStringLiteral("RenderContextCount")].toInt(), kMaximumRenderContexts);
 
-  if (backend_ == kOpenGL) {
-    graphics_renderer = new OpenGLRenderer();
-  }
+  for (int i=0; i<context_count; i++) {
+    Renderer* graphics_renderer = nullptr;
+
+    if (backend_ == kOpenGL) {
+      graphics_renderer = new OpenGLRenderer();
+    }
 
-  if (graphics_renderer) {
-    context_ = new RendererThreadWrapper(graphics_renderer, this);
-    context_->Init();
-    context_->PostInit();
+    if (!graphics_renderer) {
+      break;
+    }
+
+    RenderContext* ctx = new RenderContext();
+    ctx->renderer = new RendererThreadWrapper(graphics_renderer, this);
+    ctx->renderer->Init();
+    ctx->renderer->PostInit();
+    ctx->shader_cache = new ShaderCache();
+    ctx->default_shader = ctx->renderer->CreateNativeShader(ShaderCode(QString(), QString()));
+    ctx->active_tickets = 0;
+
+    contexts_.append(ctx);
+  }
 
+  if (!contexts_.isEmpty()) {
     still_cache_ = new StillImageCache();
+    texture_cache_ = new FrameTextureCache();
+    interlaced_cache_ = new InterlacedFrameCache();
+    value_cache_ = new NodeValueCache();
     decoder_cache_ = new DecoderCache();
-    shader_cache_ = new ShaderCache();
-    default_shader_ = context_->CreateNativeShader(ShaderCode(QString(), QString()));
+
+    // Rendered frames are the most expensive to get back, so they're weighted the highest
+    MemoryGovernor* governor = MemoryGovernor::instance();
+    governor->Register(QStringLiteral("GPUCacheSize"), MemoryGovernor::kVideoMemory, 2.0,
+                       [this](qint64 limit){ texture_cache_->SetMaximumSize(limit); });
+    governor->Register(QStringLiteral("StillImageCacheSize"), MemoryGovernor::kVideoMemory, 1.0,
+                       [this](qint64 limit){ still_cache_->SetMaximumSize(limit); });
+    governor->Register(QStringLiteral("NodeValueCacheSize"), MemoryGovernor::kSystemMemory, 1.0,
+                       [this](qint64 limit){ value_cache_->SetMaximumSize(limit); });
+
+    // Renderers and decoders look these up themselves with MemoryGovernor::GetLimit()
+    governor->Register(QStringLiteral("TexturePoolSize"), MemoryGovernor::kVideoMemory, 1.0, nullptr);
+    governor->Register(QStringLiteral("DecoderCacheSize"), MemoryGovernor::kSystemMemory, 1.0, nullptr);
 
     decoder_clear_timer_.setInterval(kDecoderMaximumInactivity);
     connect(&decoder_clear_timer_, &QTimer::timeout, this, &RenderManager::ClearOldDecoders);
     decoder_clear_timer_.start();
   } else {
     qCritical() << "Tried to initialize unknown graphics backend";
-    context_ = nullptr;
     still_cache_ = nullptr;
+    texture_cache_ = nullptr;
+    interlaced_cache_ = nullptr;
+    value_cache_ = nullptr;
     decoder_cache_ = nullptr;
   }
 }
 
 RenderManager::~RenderManager()
 {
-  if (context_) {
-    context_->DestroyNativeShader(default_shader_);
+  if (!contexts_.isEmpty()) {
+    MemoryGovernor* governor = MemoryGovernor::instance();
+    governor->Unregister(QStringLiteral("GPUCacheSize"));
+    governor->Unregister(QStringLiteral("StillImageCacheSize"));
+    governor->Unregister(QStringLiteral("NodeValueCacheSize"));
+    governor->Unregister(QStringLiteral("TexturePoolSize"));
+    governor->Unregister(QStringLiteral("DecoderCacheSize"));
 
-    delete shader_cache_;
     delete decoder_cache_;
+    delete value_cache_;
+    delete interlaced_cache_;
+    delete texture_cache_;
     delete still_cache_;
 
-    context_->Destroy();
-    context_->PostDestroy();
-    delete context_;
+    foreach (RenderContext* ctx, contexts_) {
+      ctx->renderer->DestroyNativeShader(ctx->default_shader);
+      delete ctx->shader_cache;
+
+      ctx->renderer->Destroy();
+      ctx->renderer->PostDestroy();
+      delete ctx->renderer;
+
+      delete ctx;
+    }
   }
 }
 
-void RenderManager::ClearOldDecoders()
+Renderer::TexturePoolStats RenderManager::GetTexturePoolStats() const
 {
-  QMutexLocker locker(decoder_cache_->mutex());
+  Renderer::TexturePoolStats total = {0, 0, 0, 0, 0};
 
-  qint64 min_age = QDateTime::currentMSecsSinceEpoch() - kDecoderMaximumInactivity;
+  foreach (RenderContext* ctx, contexts_) {
+    Renderer::TexturePoolStats s = ctx->renderer->GetTexturePoolStats();
+
+    total.allocated_bytes += s.allocated_bytes;
+    total.pooled_bytes += s.pooled_bytes;
+    total.pooled_textures += s.pooled_textures;
+    total.hits += s.hits;
+    total.misses += s.misses;
+  }
+
+  return total;
+}
+
+qint64 RenderManager::MeasureTextureTransfer(const VideoParams &params, int iterations)
+{
+  if (contexts_.isEmpty()) {
+    return -1;
+  }
+
+  Renderer* renderer = contexts_.first()->renderer;
+
+  FramePtr frame = Frame::Create();
+  frame->set_video_params(params);
+
+  if (!frame->allocate()) {
+    return -1;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+
+  for (int i=0; i<iterations; i++) {
+    TexturePtr texture = renderer->CreateTexture(params, frame->data(), frame->linesize_pixels());
+    renderer->DownloadFromTexture(texture.get(), frame->data(), frame->linesize_pixels());
+  }
 
-  for (auto it=decoder_cache_->begin(); it!=decoder_cache_->end(); ) {
-    DecoderPair decoder = it.value();
+  return timer.nsecsElapsed();
+}
+
+RenderManager::RenderContext *RenderManager::AcquireContext() const
+{
+  RenderContext* least_busy = contexts_.first();
+
+  for (int i=1; i<contexts_.size(); i++) {
+    if (contexts_.at(i)->active_tickets < least_busy->active_tickets) {
+      least_busy = contexts_.at(i);
+    }
+  }
+
+  least_busy->active_tickets++;
+
+  return least_busy;
+}
+
+bool RenderManager::RemoveTicket(RenderTicketPtr ticket)
+{
+  {
+    QMutexLocker locker(&in_flight_lock_);
+
+    QByteArray hash = ticket->property("hash").toByteArray();
+
+    for (auto it=in_flight_frames_.constFind(hash); it!=in_flight_frames_.constEnd() && it.key() == hash; it++) {
+      if (it->requesters > 1 && it->ticket.lock() == ticket) {
+        return false;
+      }
+    }
+  }
 
-    if (decoder.decoder->GetLastAccessedTime() < min_age) {
-      decoder.decoder->Close();
-      it = decoder_cache_->erase(it);
+  return ThreadPool::RemoveTicket(ticket);
+}
+
+bool RenderManager::FrameRequest::operator==(const FrameRequest &rhs) const
+{
+  return mode == rhs.mode
+      && video_params == rhs.video_params
+      && force_size == rhs.force_size
+      && force_matrix == rhs.force_matrix
+      && force_format == rhs.force_format
+      && force_color_output == rhs.force_color_output
+      && color_manager == rhs.color_manager
+      && texture_only == rhs.texture_only
+      && roi == rhs.roi
+      && force_yuv.matrix() == rhs.force_yuv.matrix()
+      && force_yuv.subsampling() == rhs.force_yuv.subsampling()
+      && force_yuv.bit_depth() == rhs.force_yuv.bit_depth()
+      && keyframes_only == rhs.keyframes_only;
+}
+
+RenderTicketPtr RenderManager::FindInFlightFrame(const QByteArray &hash, const FrameRequest &request, Priority priority)
+{
+  for (auto it=in_flight_frames_.find(hash); it!=in_flight_frames_.end() && it.key() == hash; ) {
+    RenderTicketPtr ticket = it->ticket.lock();
+
+    if (!ticket || ticket->GetFinishCount() > 0) {
+      it = in_flight_frames_.erase(it);
+      continue;
+    }
+
+    // Don't leave an urgent request waiting behind background work that hasn't started yet
+    if (it->request == request && (it->priority <= priority || ticket->IsRunning())) {
+      it->requesters++;
+      return ticket;
+    }
+
+    it++;
+  }
+
+  return nullptr;
+}
+
+void RenderManager::AddInFlightFrame(const QByteArray &hash, const FrameRequest &request, const RenderTicketPtr &ticket, Priority priority)
+{
+  InFlightFrame f = {request, ticket, priority, 1};
+  in_flight_frames_.insert(hash, f);
+
+  connect(ticket.get(), &RenderTicket::Finished, this, [this, hash]{
+    RemoveFinishedInFlightFrames(hash);
+  });
+}
+
+void RenderManager::RemoveFinishedInFlightFrames(const QByteArray &hash)
+{
+  QMutexLocker locker(&in_flight_lock_);
+
+  for (auto it=in_flight_frames_.find(hash); it!=in_flight_frames_.end() && it.key() == hash; ) {
+    RenderTicketPtr ticket = it->ticket.lock();
+
+    if (!ticket || ticket->GetFinishCount() > 0) {
+      it = in_flight_frames_.erase(it);
     } else {
       it++;
     }
   }
 }
 
+void RenderManager::ClearOldDecoders()
+{
+  qint64 min_age = QDateTime::currentMSecsSinceEpoch() - kDecoderMaximumInactivity;
+
+  rational playhead = GetPlayhead();
+
+  for (int shard=0; shard<DecoderCache::kShardCount; shard++) {
+    QMutexLocker locker(decoder_cache_->shard_mutex(shard));
+
+    QHash<Decoder::CodecStream, DecoderPool>& decoders = decoder_cache_->shard_map(shard);
+
+    for (auto it=decoders.begin(); it!=decoders.end(); ) {
+      DecoderPool& pool = it.value();
+
+      for (int i=0; i<pool.size(); i++) {
+        const DecoderPair& decoder = pool.at(i);
+
+        // Decoders opened ahead of the playhead may not be used until playback gets there
+        bool upcoming = (decoder.playback_time >= playhead && decoder.playback_time <= playhead + kDecoderLookahead);
+
+        if (decoder.users == 0 && !upcoming && decoder.decoder->GetLastAccessedTime() < min_age) {
+          decoder.decoder->Close();
+          pool.removeAt(i);
+          i--;
+        }
+      }
+
+      if (pool.isEmpty()) {
+        it = decoders.erase(it);
+      } else {
+        it++;
+      }
+    }
+  }
+
+  EvictDistantDecoders();
+}
+
+void RenderManager::EvictDistantDecoders()
+{
+  struct IdleDecoder {
+    Decoder::CodecStream stream;
+    DecoderPtr decoder;
+    rational distance;
+  };
+
+  std::vector<IdleDecoder> idle;
+
+  rational playhead = GetPlayhead();
+
+  for (int shard=0; shard<DecoderCache::kShardCount; shard++) {
+    QMutexLocker locker(decoder_cache_->shard_mutex(shard));
+
+    const QHash<Decoder::CodecStream, DecoderPool>& decoders = decoder_cache_->shard_map(shard);
+
+    for (auto it=decoders.cbegin(); it!=decoders.cend(); it++) {
+      foreach (const DecoderPair& d, it.value()) {
+        if (d.users == 0) {
+          rational distance = (d.playback_time > playhead) ? d.playback_time - playhead : playhead - d.playback_time;
+          idle.push_back({it.key(), d.decoder, distance});
+        }
+      }
+    }
+  }
+
+  if (int(idle.size()) <= kMaximumIdleDecoders) {
+    return;
+  }
+
+  std::sort(idle.begin(), idle.end(), [](const IdleDecoder& a, const IdleDecoder& b){
+    return a.distance > b.distance;
+  });
+
+  for (size_t i=0; i<idle.size()-kMaximumIdleDecoders; i++) {
+    const Decoder::CodecStream& stream = idle.at(i).stream;
+
+    QMutexLocker locker(decoder_cache_->mutex(stream));
+
+    QHash<Decoder::CodecStream, DecoderPool>& decoders = decoder_cache_->map(stream);
+    auto it = decoders.find(stream);
+
+    if (it == decoders.end()) {
+      continue;
+    }
+
+    DecoderPool& pool = it.value();
+
+    for (int j=0; j<pool.size(); j++) {
+      // Shards weren't held in between, so the decoder may have been picked up again since
+      if (pool.at(j).decoder == idle.at(i).decoder && pool.at(j).users == 0) {
+        pool.at(j).decoder->Close();
+        pool.removeAt(j);
+        break;
+      }
+    }
+
+    if (pool.isEmpty()) {
+      decoders.erase(it);
+    }
+  }
+}
+
+void RenderManager::SetPlayhead(const rational &playhead)
+{
+  if (!decoder_cache_) {
+    return;
+  }
+
+  QMutexLocker locker(&playhead_lock_);
+
+  playhead_ = playhead;
+}
+
+rational RenderManager::GetPlayhead()
+{
+  QMutexLocker locker(&playhead_lock_);
+
+  return playhead_;
+}
+
 QByteArray RenderManager::Hash(const Node *n, const QString& output, const VideoParams &params, const rational &time)
 {
-  QCryptographicHash hasher(QCryptographicHash::Sha1);
+  Hasher hasher;
 
   // Embed video parameters into this hash
-  int width = params.effective_width();
-  int height = params.effective_height();
-  VideoParams::Format format = params.format();
-  VideoParams::Interlacing interlacing = params.interlacing();
-
-  hasher.addData(reinterpret_cast<const char*>(&width), sizeof(width));
-  hasher.addData(reinterpret_cast<const char*>(&height), sizeof(height));
-  hasher.addData(reinterpret_cast<const char*>(&format), sizeof(format));
-  hasher.addData(reinterpret_cast<const char*>(&interlacing), sizeof(interlacing));
+  hasher.add(params.effective_width());
+  hasher.add(params.effective_height());
+  hasher.add(params.format());
+  hasher.add(params.interlacing());
 
   if (n) {
     n->Hash(output, hasher, time, params);
@@ -126,7 +415,8 @@ QByteArray RenderManager::Hash(const Node *n, const QString& output, const Video
 
 RenderTicketPtr RenderManager::RenderFrame(ViewerOutput *viewer, ColorManager* color_manager,
                                            const rational& time, RenderMode::Mode mode,
-                                           FrameHashCache* cache, bool prioritize, bool texture_only)
+                                           FrameHashCache* cache, Priority priority, bool texture_only,
+                                           const QByteArray& hash, const QRectF &roi)
 {
   return RenderFrame(viewer,
                      color_manager,
@@ -139,8 +429,10 @@ RenderTicketPtr RenderManager::RenderFrame(ViewerOutput *viewer, ColorManager* c
                      VideoParams::kFormatInvalid,
                      nullptr,
                      cache,
-                     prioritize,
-                     texture_only);
+                     priority,
+                     texture_only,
+                     hash,
+                     roi);
 }
 
 RenderTicketPtr RenderManager::RenderFrame(ViewerOutput *viewer, ColorManager* color_manager,
@@ -149,8 +441,28 @@ RenderTicketPtr RenderManager::RenderFrame(ViewerOutput *viewer, ColorManager* c
                                            const QSize& force_size,
                                            const QMatrix4x4& force_matrix, VideoParams::Format force_format,
                                            ColorProcessorPtr force_color_output,
-                                           FrameHashCache* cache, bool prioritize, bool texture_only)
+                                           FrameHashCache* cache, Priority priority, bool texture_only,
+                                           const QByteArray& hash, const QRectF &roi,
+                                           const PlanarYUV &force_yuv, bool keyframes_only,
+                                           const FrameOutputList &extra_outputs, Node *node)
 {
+  FrameRequest request = {mode, video_params, force_size, force_matrix, force_format, force_color_output,
+                          color_manager, texture_only, roi, force_yuv, keyframes_only};
+
+  // Held until the new ticket is registered so simultaneous requests can't both render it
+  QMutexLocker locker(&in_flight_lock_);
+
+  // Nobody else is waiting for the extra frames, so these can't stand in for a shared ticket
+  bool shareable = !hash.isEmpty() && extra_outputs.isEmpty();
+
+  if (shareable) {
+    RenderTicketPtr existing = FindInFlightFrame(hash, request, priority);
+
+    if (existing) {
+      return existing;
+    }
+  }
+
   // Create ticket
   RenderTicketPtr ticket = std::make_shared<RenderTicket>();
 
@@ -166,6 +478,15 @@ RenderTicketPtr RenderManager::RenderFrame(ViewerOutput *viewer, ColorManager* c
   ticket->setProperty("vparam", QVariant::fromValue(video_params));
   ticket->setProperty("aparam", QVariant::fromValue(audio_params));
   ticket->setProperty("textureonly", texture_only);
+  ticket->setProperty("hash", hash);
+  ticket->setProperty("roi", roi);
+  ticket->setProperty("yuv", QVariant::fromValue(force_yuv));
+  ticket->setProperty("keyframesonly", keyframes_only);
+  ticket->setProperty("extraoutputs", QVariant::fromValue(extra_outputs));
+
+  if (node) {
+    ticket->setProperty("node", Node::PtrToValue(node));
+  }
 
   if (cache) {
     ticket->setProperty("cache", cache->GetCacheDirectory());
@@ -175,20 +496,98 @@ RenderTicketPtr RenderManager::RenderFrame(ViewerOutput *viewer, ColorManager* c
     ticket->moveToThread(this->thread());
   }
 
+  if (shareable) {
+    AddInFlightFrame(hash, request, ticket, priority);
+  }
+
+  locker.unlock();
+
   // Queue appending the ticket and running the next job on our thread to make this function thread-safe
   QMetaObject::invokeMethod(this, "AddTicket", Qt::AutoConnection,
                             OLIVE_NS_ARG(RenderTicketPtr, ticket),
-                            Q_ARG(bool, prioritize));
+                            Q_ARG(int, priority));
 
   return ticket;
 }
 
-RenderTicketPtr RenderManager::RenderAudio(ViewerOutput* viewer, const TimeRange& r, RenderMode::Mode mode, bool generate_waveforms, bool prioritize)
+QVector<RenderTicketPtr> RenderManager::RenderFrames(ViewerOutput *viewer, ColorManager *color_manager,
+                                                     const QVector<rational> &times, RenderMode::Mode mode,
+                                                     FrameHashCache *cache, Priority priority, bool texture_only,
+                                                     const QVector<QByteArray> &hashes)
+{
+  QVector<RenderTicketPtr> frames(times.size());
+  RenderTicketWeakList weak_frames(times.size());
+
+  FrameRequest request = {mode, viewer->GetVideoParams(), QSize(0, 0), QMatrix4x4(), VideoParams::kFormatInvalid,
+                          ColorProcessorPtr(), color_manager, texture_only, QRectF(), PlanarYUV(), false};
+
+  QMutexLocker locker(&in_flight_lock_);
+
+  for (int i=0; i<times.size(); i++) {
+    if (!hashes.isEmpty()) {
+      // Frames rendering elsewhere are left out of the batch, whose expired entries are skipped
+      RenderTicketPtr existing = FindInFlightFrame(hashes.at(i), request, priority);
+
+      if (existing) {
+        frames[i] = existing;
+        continue;
+      }
+    }
+
+    RenderTicketPtr frame = std::make_shared<RenderTicket>();
+
+    frame->setProperty("time", QVariant::fromValue(times.at(i)));
+    frame->setProperty("type", kTypeVideo);
+
+    if (!hashes.isEmpty()) {
+      frame->setProperty("hash", hashes.at(i));
+      AddInFlightFrame(hashes.at(i), request, frame, priority);
+    }
+
+    frames[i] = frame;
+    weak_frames[i] = frame;
+  }
+
+  locker.unlock();
+
+  // Everything that isn't per-frame lives on the batch ticket
+  RenderTicketPtr batch = std::make_shared<RenderTicket>();
+
+  batch->setProperty("viewer", Node::PtrToValue(viewer));
+  batch->setProperty("frames", QVariant::fromValue(weak_frames));
+  batch->setProperty("size", QSize(0, 0));
+  batch->setProperty("matrix", QMatrix4x4());
+  batch->setProperty("format", VideoParams::kFormatInvalid);
+  batch->setProperty("mode", mode);
+  batch->setProperty("type", kTypeVideoBatch);
+  batch->setProperty("colormanager", Node::PtrToValue(color_manager));
+  batch->setProperty("coloroutput", QVariant::fromValue(ColorProcessorPtr()));
+  batch->setProperty("vparam", QVariant::fromValue(viewer->GetVideoParams()));
+  batch->setProperty("aparam", QVariant::fromValue(viewer->GetAudioParams()));
+  batch->setProperty("textureonly", texture_only);
+
+  if (cache) {
+    batch->setProperty("cache", cache->GetCacheDirectory());
+  }
+
+  if (batch->thread() != this->thread()) {
+    batch->moveToThread(this->thread());
+  }
+
+  // Queue appending the ticket and running the next job on our thread to make this function thread-safe
+  QMetaObject::invokeMethod(this, "AddTicket", Qt::AutoConnection,
+                            OLIVE_NS_ARG(RenderTicketPtr, batch),
+                            Q_ARG(int, priority));
+
+  return frames;
+}
+
+RenderTicketPtr RenderManager::RenderAudio(ViewerOutput* viewer, const TimeRange& r, RenderMode::Mode mode, bool generate_waveforms, Priority priority)
 {
-  return RenderAudio(viewer, r, viewer->GetAudioParams(), mode, generate_waveforms, prioritize);
+  return RenderAudio(viewer, r, viewer->GetAudioParams(), mode, generate_waveforms, priority);
 }
 
-RenderTicketPtr RenderManager::RenderAudio(ViewerOutput* viewer, const TimeRange &r, const AudioParams &params, RenderMode::Mode mode, bool generate_waveforms, bool prioritize)
+RenderTicketPtr RenderManager::RenderAudio(ViewerOutput* viewer, const TimeRange &r, const AudioParams &params, RenderMode::Mode mode, bool generate_waveforms, Priority priority)
 {
   // Create ticket
   RenderTicketPtr ticket = std::make_shared<RenderTicket>();
@@ -199,6 +598,7 @@ RenderTicketPtr RenderManager::RenderAudio(ViewerOutput* viewer, const TimeRange
   ticket->setProperty("mode", mode);
   ticket->setProperty("enablewaveforms", generate_waveforms);
   ticket->setProperty("aparam", QVariant::fromValue(params));
+  ticket->setProperty("ablocksize", Config::kAudioRenderBlockSize.Get());
 
   if (ticket->thread() != this->thread()) {
     ticket->moveToThread(this->thread());
@@ -207,12 +607,12 @@ RenderTicketPtr RenderManager::RenderAudio(ViewerOutput* viewer, const TimeRange
   // Queue appending the ticket and running the next job on our thread to make this function thread-safe
   QMetaObject::invokeMethod(this, "AddTicket", Qt::AutoConnection,
                             OLIVE_NS_ARG(RenderTicketPtr, ticket),
-                            Q_ARG(bool, prioritize));
+                            Q_ARG(int, priority));
 
   return ticket;
 }
 
-RenderTicketPtr RenderManager::SaveFrameToCache(FrameHashCache *cache, FramePtr frame, const QByteArray &hash, bool prioritize)
+RenderTicketPtr RenderManager::SaveFrameToCache(FrameHashCache *cache, FramePtr frame, const QByteArray &hash, Priority priority)
 {
   // Create ticket
   RenderTicketPtr ticket = std::make_shared<RenderTicket>();
@@ -229,14 +629,143 @@ RenderTicketPtr RenderManager::SaveFrameToCache(FrameHashCache *cache, FramePtr
   // Queue appending the ticket and running the next job on our thread to make this function thread-safe
   QMetaObject::invokeMethod(this, "AddTicket", Qt::AutoConnection,
                             OLIVE_NS_ARG(RenderTicketPtr, ticket),
-                            Q_ARG(bool, prioritize));
+                            Q_ARG(int, priority));
+
+  return ticket;
+}
+
+RenderTicketPtr RenderManager::PrewarmDecoders(ViewerOutput *viewer, const rational &time, RenderMode::Mode mode, Priority priority)
+{
+  if (decoder_cache_) {
+    // Make room for what this is about to open
+    EvictDistantDecoders();
+  }
+
+  // Create ticket
+  RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+
+  ticket->setProperty("viewer", Node::PtrToValue(viewer));
+  ticket->setProperty("time", QVariant::fromValue(time));
+  ticket->setProperty("mode", mode);
+  ticket->setProperty("type", kTypeVideoPrewarm);
+  ticket->setProperty("vparam", QVariant::fromValue(viewer->GetVideoParams()));
+
+  if (ticket->thread() != this->thread()) {
+    ticket->moveToThread(this->thread());
+  }
+
+  // Queue appending the ticket and running the next job on our thread to make this function thread-safe
+  QMetaObject::invokeMethod(this, "AddTicket", Qt::AutoConnection,
+                            OLIVE_NS_ARG(RenderTicketPtr, ticket),
+                            Q_ARG(int, priority));
+
+  return ticket;
+}
+
+RenderTicketPtr RenderManager::RenderThumbnail(ViewerOutput *viewer, ColorManager *color_manager, Node *node,
+                                               const rational &time, int height, const QString &cache_file,
+                                               Priority priority)
+{
+  VideoParams params = viewer->GetVideoParams();
+
+  // Render at the largest divider that still gives us enough pixels for the image
+  int divider = 1;
+  foreach (int d, VideoParams::kSupportedDividers) {
+    if (VideoParams::GetScaledDimension(params.height(), d) >= height) {
+      divider = d;
+    }
+  }
+  params.set_divider(divider);
+
+  QSize size(qMax(1, qRound(double(height) * params.square_pixel_width() / params.height())), height);
+
+  // An empty display and view use the config's defaults
+  ColorProcessorPtr display_transform = ColorProcessor::Create(color_manager,
+                                                               color_manager->GetReferenceColorSpace(),
+                                                               ColorTransform(QString(), QString(), QString()));
+
+  // Create ticket
+  RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+
+  ticket->setProperty("viewer", Node::PtrToValue(viewer));
+  ticket->setProperty("node", Node::PtrToValue(node));
+  ticket->setProperty("time", QVariant::fromValue(time));
+  ticket->setProperty("size", size);
+  ticket->setProperty("matrix", QMatrix4x4());
+  ticket->setProperty("format", VideoParams::kFormatUnsigned8);
+  ticket->setProperty("mode", RenderMode::kOffline);
+  ticket->setProperty("type", kTypeThumbnail);
+  ticket->setProperty("colormanager", Node::PtrToValue(color_manager));
+  ticket->setProperty("coloroutput", QVariant::fromValue(display_transform));
+  ticket->setProperty("vparam", QVariant::fromValue(params));
+  ticket->setProperty("aparam", QVariant::fromValue(viewer->GetAudioParams()));
+  ticket->setProperty("thumbnailfile", cache_file);
+
+  if (ticket->thread() != this->thread()) {
+    ticket->moveToThread(this->thread());
+  }
+
+  // Queue appending the ticket and running the next job on our thread to make this function thread-safe
+  QMetaObject::invokeMethod(this, "AddTicket", Qt::AutoConnection,
+                            OLIVE_NS_ARG(RenderTicketPtr, ticket),
+                            Q_ARG(int, priority));
+
+  return ticket;
+}
+
+RenderTicketPtr RenderManager::RenderFootagePreview(const FootageJob &job, ColorManager *color_manager,
+                                                   const rational &time, int divider, Priority priority)
+{
+  if (decoder_cache_) {
+    // Make room for what this is about to open
+    EvictDistantDecoders();
+  }
+
+  // Decoded frames are color managed at render precision, whatever the footage's own format
+  VideoParams params = job.video_params();
+  params.set_divider(divider);
+  params.set_format(VideoParams::kFormatFloat16);
+
+  // Create ticket
+  RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+
+  ticket->setProperty("footagejob", QVariant::fromValue(job));
+  ticket->setProperty("time", QVariant::fromValue(time));
+  ticket->setProperty("mode", RenderMode::kOffline);
+  ticket->setProperty("type", kTypeFootagePreview);
+  ticket->setProperty("colormanager", Node::PtrToValue(color_manager));
+  ticket->setProperty("vparam", QVariant::fromValue(params));
+  ticket->setProperty("format", VideoParams::kFormatInvalid);
+
+  if (ticket->thread() != this->thread()) {
+    ticket->moveToThread(this->thread());
+  }
+
+  // Queue appending the ticket and running the next job on our thread to make this function thread-safe
+  QMetaObject::invokeMethod(this, "AddTicket", Qt::AutoConnection,
+                            OLIVE_NS_ARG(RenderTicketPtr, ticket),
+                            Q_ARG(int, priority));
 
   return ticket;
 }
 
 void RenderManager::RunTicket(RenderTicketPtr ticket) const
 {
-  RenderProcessor::Process(ticket, context_, still_cache_, decoder_cache_, shader_cache_, default_shader_);
+  if (contexts_.isEmpty()) {
+    ticket->Finish();
+    return;
+  }
+
+  RenderContext* ctx = AcquireContext();
+
+  RenderProcessor::Process(ticket, ctx->renderer, still_cache_, texture_cache_, interlaced_cache_, value_cache_, decoder_cache_, ctx->shader_cache, ctx->default_shader);
+
+  ctx->active_tickets--;
+}
+
+int RenderManager::GetTicketLane(const RenderTicketPtr &ticket) const
+{
+  return ticket->property("type").value<TicketType>();
 }
 
 }
@@ -21,6 +21,9 @@
 #ifndef RENDERBACKEND_H
 #define RENDERBACKEND_H
 
+#include <atomic>
+#include <QMatrix4x4>
+#include <QMutex>
 #include <QtConcurrent/QtConcurrent>
 
 #include "config/config.h"
@@ -29,13 +32,19 @@
 #include "node/graph.h"
 #include "node/output/viewer/viewer.h"
 #include "node/traverser.h"
+#include "render/planaryuv.h"
 #include "render/renderer.h"
+#include "frametexturecache.h"
+#include "interlacedframecache.h"
+#include "nodevaluecache.h"
 #include "rendercache.h"
 #include "stillimagecache.h"
 #include "threading/threadpool.h"
 
 namespace olive {
 
+using RenderTicketWeakList = QVector< std::weak_ptr<RenderTicket> >;
+
 class RenderManager : public ThreadPool
 {
   Q_OBJECT
@@ -73,49 +82,176 @@ public:
     return Hash(output.node(), output.output(), params, time);
   }
 
+  /**
+   * @brief Another copy of a rendered frame with its own output settings
+   *
+   * Behaves like the `force_*` arguments of RenderFrame().
+   */
+  struct FrameOutput {
+    QSize force_size;
+    QMatrix4x4 force_matrix;
+    VideoParams::Format force_format;
+    ColorProcessorPtr force_color_output;
+    PlanarYUV force_yuv;
+  };
+
+  using FrameOutputList = QVector<FrameOutput>;
+
   /**
    * @brief Asynchronously generate a frame at a given time
    *
    * The ticket from this function will return a FramePtr - the rendered frame in reference color
    * space.
    *
-   * Setting `prioritize` to TRUE puts this ticket at the top of the queue. Leaving it as FALSE
-   * appends it to the bottom.
+   * `priority` sets the quality-of-service class this ticket is queued in (see
+   * ThreadPool::Priority).
+   *
+   * If `hash` is set, the rendered texture is kept in the GPU frame cache under that hash so it can
+   * be displayed again without going through the disk cache.
+   *
+   * If `roi` is set (normalized to 0-1 from the top-left), pixels outside it may be left blank.
+   * Used by viewers zoomed into part of the frame. Don't combine it with `hash`.
+   *
+   * If `force_yuv` is valid and the frame is returned to the CPU, it's packed into that planar YUV
+   * layout on the GPU (see Frame::planar_yuv()) after the output color transform.
+   *
+   * If `keyframes_only` is true, footage is decoded from its nearest keyframe instead of the
+   * exact frame (see Decoder::RetrieveVideoParams), which is much faster for scrubbing long-GOP
+   * media. Such frames bypass the still image cache, so don't pass a hash with them.
+   *
+   * Each of `extra_outputs` is made from the same rendered texture as the main frame, scaled and
+   * converted on the GPU, and downloaded alongside it. They're stored as a QVector<FramePtr> in
+   * the ticket's "extraframes" property, in the same order, by the time it finishes. Tickets with
+   * extra outputs are never shared.
+   *
+   * If `node` is set, its default output is rendered instead of the viewer's texture output, so
+   * `hash` must be that output's hash.
+   *
+   * If `hash` is set and a frame with the same hash and output settings is already queued or
+   * rendering, that frame's ticket is returned rather than rendering it again. A ticket queued at a
+   * lower priority than `priority` is only shared once it has started.
    *
    * This function is thread-safe.
    */
   RenderTicketPtr RenderFrame(ViewerOutput *viewer, ColorManager* color_manager,
                               const rational& time, RenderMode::Mode mode,
-                              FrameHashCache* cache = nullptr, bool prioritize = false, bool texture_only = false);
+                              FrameHashCache* cache = nullptr, Priority priority = kPriorityBackground, bool texture_only = false,
+                              const QByteArray& hash = QByteArray(), const QRectF& roi = QRectF());
   RenderTicketPtr RenderFrame(ViewerOutput* viewer, ColorManager* color_manager,
                               const rational& time, RenderMode::Mode mode,
                               const VideoParams& video_params, const AudioParams& audio_params,
                               const QSize& force_size,
                               const QMatrix4x4& force_matrix, VideoParams::Format force_format,
                               ColorProcessorPtr force_color_output,
-                              FrameHashCache* cache = nullptr, bool prioritize = false, bool texture_only = false);
+                              FrameHashCache* cache = nullptr, Priority priority = kPriorityBackground, bool texture_only = false,
+                              const QByteArray& hash = QByteArray(), const QRectF& roi = QRectF(),
+                              const PlanarYUV& force_yuv = PlanarYUV(), bool keyframes_only = false,
+                              const FrameOutputList& extra_outputs = FrameOutputList(), Node* node = nullptr);
+
+  /**
+   * @brief Asynchronously generate several frames in one job
+   *
+   * Returns one ticket per entry in `times`, each behaving like a ticket from RenderFrame(). The
+   * frames are rendered one after another on a single render thread with one traverser, so
+   * decoders, value caches and GPU state warmed up by the first frame are reused by the rest.
+   * Best suited to runs of neighboring frames.
+   *
+   * The batch only holds weak references to its tickets, so a frame is skipped if every reference
+   * to its ticket is dropped before the batch reaches it.
+   *
+   * `hashes` is either empty or the same size as `times`. Frames already in flight are shared like
+   * they are in RenderFrame() and left out of the batch.
+   *
+   * This function is thread-safe.
+   */
+  QVector<RenderTicketPtr> RenderFrames(ViewerOutput *viewer, ColorManager* color_manager,
+                                        const QVector<rational>& times, RenderMode::Mode mode,
+                                        FrameHashCache* cache = nullptr, Priority priority = kPriorityBackground, bool texture_only = false,
+                                        const QVector<QByteArray>& hashes = QVector<QByteArray>());
 
   /**
    * @brief Asynchronously generate a chunk of audio
    *
    * The ticket from this function will return a SampleBufferPtr - the rendered audio.
    *
-   * Setting `prioritize` to TRUE puts this ticket at the top of the queue. Leaving it as FALSE
-   * appends it to the bottom.
+   * `priority` sets the quality-of-service class this ticket is queued in (see
+   * ThreadPool::Priority).
    *
    * This function is thread-safe.
    */
-  RenderTicketPtr RenderAudio(ViewerOutput* viewer, const TimeRange& r, const AudioParams& params, RenderMode::Mode mode, bool generate_waveforms, bool prioritize = false);
-  RenderTicketPtr RenderAudio(ViewerOutput *viewer, const TimeRange& r, RenderMode::Mode mode, bool generate_waveforms, bool prioritize = false);
+  RenderTicketPtr RenderAudio(ViewerOutput* viewer, const TimeRange& r, const AudioParams& params, RenderMode::Mode mode, bool generate_waveforms, Priority priority = kPriorityBackground);
+  RenderTicketPtr RenderAudio(ViewerOutput *viewer, const TimeRange& r, RenderMode::Mode mode, bool generate_waveforms, Priority priority = kPriorityBackground);
 
-  RenderTicketPtr SaveFrameToCache(FrameHashCache* cache, FramePtr frame, const QByteArray& hash, bool prioritize = false);
+  RenderTicketPtr SaveFrameToCache(FrameHashCache* cache, FramePtr frame, const QByteArray& hash, Priority priority = kPriorityBackground);
+
+  /**
+   * @brief Asynchronously generate a small preview image of a node
+   *
+   * The ticket from this function will return a QImage - `node`'s output at `time` in the display
+   * color space, rendered at a reduced divider and scaled to `height` pixels high.
+   *
+   * If `cache_file` exists, the image is loaded from it instead of being rendered. Otherwise the
+   * rendered image is saved there as a JPEG so it doesn't need to be rendered again.
+   *
+   * This function is thread-safe.
+   */
+  RenderTicketPtr RenderThumbnail(ViewerOutput* viewer, ColorManager* color_manager, Node* node,
+                                  const rational& time, int height, const QString& cache_file,
+                                  Priority priority = kPriorityBackground);
+
+  /**
+   * @brief Asynchronously decode a frame of footage for skimming through it
+   *
+   * Unlike RenderFrame(), no graph is traversed or copied. `job` (see Footage::GetVideoJob()) is
+   * decoded at `time` and `divider` straight through the shared decoder and still image caches and
+   * color managed into `color_manager`'s reference space.
+   *
+   * The ticket from this function will return a FramePtr.
+   *
+   * This function is thread-safe.
+   */
+  RenderTicketPtr RenderFootagePreview(const FootageJob& job, ColorManager* color_manager,
+                                       const rational& time, int divider,
+                                       Priority priority = kPriorityInteractive);
+
+  /**
+   * @brief Asynchronously open the decoders that rendering `viewer` at `time` will need
+   *
+   * Nothing is rendered, the footage at `time` is decoded so its decoders are open and positioned
+   * there by the time playback reaches it. The ticket finishes without a result.
+   *
+   * This function is thread-safe.
+   */
+  RenderTicketPtr PrewarmDecoders(ViewerOutput* viewer, const rational& time, RenderMode::Mode mode,
+                                  Priority priority = kPriorityBackground);
+
+  /**
+   * @brief Set the time playback is at, decoders furthest from it are the first to be closed
+   */
+  void SetPlayhead(const rational& playhead);
+
+  /**
+   * @brief How far ahead of the playhead decoders are opened, and kept open, for upcoming footage
+   */
+  static const rational kDecoderLookahead;
 
   virtual void RunTicket(RenderTicketPtr ticket) const override;
 
+  /**
+   * @brief Same as ThreadPool::RemoveTicket() but fails if another requester shares the ticket
+   *
+   * Shared tickets are treated as if they've already started, since someone still wants them.
+   */
+  bool RemoveTicket(RenderTicketPtr ticket);
+
   enum TicketType {
     kTypeVideo,
     kTypeAudio,
-    kTypeVideoDownload
+    kTypeVideoDownload,
+    kTypeThumbnail,
+    kTypeVideoBatch,
+    kTypeVideoPrewarm,
+    kTypeFootagePreview
   };
 
   Backend backend() const
@@ -123,8 +259,44 @@ public:
     return backend_;
   }
 
+  FrameTextureCache* texture_cache() const
+  {
+    return texture_cache_;
+  }
+
+  StillImageCache* still_image_cache() const
+  {
+    return still_cache_;
+  }
+
+  NodeValueCache* value_cache() const
+  {
+    return value_cache_;
+  }
+
+  /**
+   * @brief Texture pool statistics summed across every render context
+   */
+  Renderer::TexturePoolStats GetTexturePoolStats() const;
+
+  int GetRenderContextCount() const
+  {
+    return contexts_.size();
+  }
+
+  /**
+   * @brief Upload and download a texture with `params` on the first context `iterations` times
+   *
+   * Returns the total time taken in nanoseconds, or -1 if there's no context to measure. Used by
+   * HardwareProfile to calibrate for this GPU.
+   */
+  qint64 MeasureTextureTransfer(const VideoParams& params, int iterations);
+
 signals:
 
+protected:
+  virtual int GetTicketLane(const RenderTicketPtr &ticket) const override;
+
 private:
   RenderManager(QObject* parent = nullptr);
 
@@ -132,22 +304,107 @@ private:
 
   static RenderManager* instance_;
 
-  Renderer* context_;
+  /**
+   * @brief A renderer with its own GPU context and the state that can't be shared between contexts
+   *
+   * Every context is in the same share group, so textures rendered by one can be read by any other
+   * and the driver moves them between devices if needed.
+   */
+  struct RenderContext {
+    Renderer* renderer;
+    ShaderCache* shader_cache;
+    QVariant default_shader;
+
+    /// Tickets currently being run on this context, used to send new tickets to the least busy one
+    std::atomic_int active_tickets;
+  };
+
+  RenderContext* AcquireContext() const;
+
+  /**
+   * @brief Everything besides its hash that a rendered frame depends on
+   */
+  struct FrameRequest {
+    RenderMode::Mode mode;
+    VideoParams video_params;
+    QSize force_size;
+    QMatrix4x4 force_matrix;
+    VideoParams::Format force_format;
+    ColorProcessorPtr force_color_output;
+    ColorManager* color_manager;
+    bool texture_only;
+    QRectF roi;
+    PlanarYUV force_yuv;
+    bool keyframes_only;
+
+    bool operator==(const FrameRequest& rhs) const;
+  };
+
+  struct InFlightFrame {
+    FrameRequest request;
+    std::weak_ptr<RenderTicket> ticket;
+    Priority priority;
+    int requesters;
+  };
+
+  /**
+   * @brief Find a ticket already rendering `hash` with the same settings as `request`
+   *
+   * `in_flight_lock_` must be held. Returns nullptr if there isn't one.
+   */
+  RenderTicketPtr FindInFlightFrame(const QByteArray& hash, const FrameRequest& request, Priority priority);
+
+  /**
+   * @brief Let later requests for `hash` share `ticket` until it finishes
+   *
+   * `in_flight_lock_` must be held.
+   */
+  void AddInFlightFrame(const QByteArray& hash, const FrameRequest& request, const RenderTicketPtr& ticket, Priority priority);
+
+  /**
+   * @brief Forget tickets for `hash` that have finished or been dropped
+   */
+  void RemoveFinishedInFlightFrames(const QByteArray& hash);
+
+  QMultiHash<QByteArray, InFlightFrame> in_flight_frames_;
+
+  QMutex in_flight_lock_;
+
+  QVector<RenderContext*> contexts_;
 
   Backend backend_;
 
   StillImageCache* still_cache_;
 
-  DecoderCache* decoder_cache_;
+  FrameTextureCache* texture_cache_;
 
-  ShaderCache* shader_cache_;
+  InterlacedFrameCache* interlaced_cache_;
 
-  QVariant default_shader_;
+  NodeValueCache* value_cache_;
+
+  DecoderCache* decoder_cache_;
 
   QTimer decoder_clear_timer_;
 
+  rational playhead_;
+
+  QMutex playhead_lock_;
+
+  rational GetPlayhead();
+
+  /**
+   * @brief Close idle decoders furthest from the playhead until there are no more than kMaximumIdleDecoders
+   *
+   * Locks each shard of the decoder cache as it goes, so none may be held by the caller.
+   */
+  void EvictDistantDecoders();
+
   static const int kDecoderMaximumInactivity;
 
+  static const int kMaximumIdleDecoders;
+
+  static const int kMaximumRenderContexts;
+
 private slots:
   void ClearOldDecoders();
 
@@ -156,5 +413,8 @@ private slots:
 }
 
 Q_DECLARE_METATYPE(olive::RenderManager::TicketType)
+Q_DECLARE_METATYPE(olive::RenderTicketWeakList)
+Q_DECLARE_METATYPE(olive::RenderManager::FrameOutputList)
+Q_DECLARE_METATYPE(QVector<olive::FramePtr>)
 
 #endif // RENDERBACKEND_H
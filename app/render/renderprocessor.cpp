@@ -20,53 +20,137 @@
 
 #include "renderprocessor.h"
 
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
 #include <QOpenGLContext>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QtMath>
+#include <QtConcurrent/QtConcurrent>
 #include <QVector2D>
 #include <QVector3D>
 #include <QVector4D>
 
+#include "audio/audiolevels.h"
+#include "codec/proxymanager.h"
+#include "codec/samplebufferpool.h"
+#include "common/metrics.h"
+#include "common/timecodefunctions.h"
+#include "common/tracing.h"
+#include "config/config.h"
 #include "node/project/project.h"
+#include "node/project/sequence/sequence.h"
+#include "render/hardwareprofile.h"
+#include "render/memorygovernor.h"
 #include "rendermanager.h"
+#include "rendermodes.h"
 
 namespace olive {
 
-RenderProcessor::RenderProcessor(RenderTicketPtr ticket, Renderer *render_ctx, StillImageCache* still_image_cache, DecoderCache* decoder_cache, ShaderCache *shader_cache, QVariant default_shader) :
+RenderProcessor::RenderProcessor(RenderTicketPtr ticket, Renderer *render_ctx, StillImageCache* still_image_cache, FrameTextureCache *texture_cache, InterlacedFrameCache *interlaced_cache, NodeValueCache *value_cache, DecoderCache* decoder_cache, ShaderCache *shader_cache, QVariant default_shader) :
   ticket_(ticket),
   render_ctx_(render_ctx),
   still_image_cache_(still_image_cache),
+  texture_cache_(texture_cache),
+  interlaced_cache_(interlaced_cache),
+  value_cache_(value_cache),
   decoder_cache_(decoder_cache),
   shader_cache_(shader_cache),
-  default_shader_(default_shader)
+  default_shader_(default_shader),
+  prewarm_(false),
+  collecting_footage_(false),
+  tiled_(false)
 {
 }
 
+const int RenderProcessor::kMaximumDecodersPerStream = 4;
+
+const rational RenderProcessor::kDecoderAffinityRange = rational(2);
+
+const int RenderProcessor::kTileSize = 2048;
+
+const int RenderProcessor::kTiledIntermediateCount = 4;
+
 TexturePtr RenderProcessor::GenerateTexture(const rational &time, const rational &frame_length)
 {
+  playback_time_ = time;
+
   ViewerOutput* viewer = Node::ValueToPtr<ViewerOutput>(ticket_->property("viewer"));
 
+  // Tickets may ask for a specific node rather than the viewer's output (e.g. thumbnails)
+  Node* node = Node::ValueToPtr<Node>(ticket_->property("node"));
+
   NodeValueTable table;
-  NodeOutput texture_output = viewer->GetConnectedTextureOutput();
+  NodeOutput texture_output = node ? NodeOutput(node, Node::kDefaultOutput) : viewer->GetConnectedTextureOutput();
   if (texture_output.IsValid()) {
-    table = GenerateTable(texture_output.node(), texture_output.output(),
-                          TimeRange(time, time + frame_length));
+    TimeRange range(time, time + frame_length);
+
+    PredecodeFootage(texture_output, range);
+
+    table = GenerateTable(texture_output.node(), texture_output.output(), range);
+
+    predecoded_.clear();
+  }
+
+  TexturePtr texture = table.Get(NodeValue::kTexture).value<TexturePtr>();
+
+  // If only part of the frame will be seen, the final shader chain only needs to be shaded there.
+  // Inlinable shaders only ever sample at their own coordinate, so this is always safe for them.
+  QRectF roi = ticket_->property("roi").toRectF();
+  if (!roi.isNull()) {
+    auto it = deferred_shaders_.find(texture.get());
+    if (it != deferred_shaders_.end() && it->inlinable && !it->result) {
+      it->job.SetScissor(roi);
+    }
+  }
+
+  if (tiled_) {
+    // Rendered a tile at a time by GenerateTiledFrames()
+    return texture;
   }
 
-  return table.Get(NodeValue::kTexture).value<TexturePtr>();
+  // Render whatever's left of the final shader chain
+  return ResolveDeferredTexture(texture);
 }
 
 FramePtr RenderProcessor::GenerateFrame(TexturePtr texture, const rational& time)
+{
+  return GenerateFrame(texture, time, GetTicketFrameOutput());
+}
+
+RenderManager::FrameOutput RenderProcessor::GetTicketFrameOutput() const
+{
+  RenderManager::FrameOutput output;
+
+  output.force_size = ticket_->property("size").value<QSize>();
+  output.force_matrix = ticket_->property("matrix").value<QMatrix4x4>();
+  output.force_format = static_cast<VideoParams::Format>(ticket_->property("format").toInt());
+  output.force_color_output = ticket_->property("coloroutput").value<ColorProcessorPtr>();
+  output.force_yuv = ticket_->property("yuv").value<PlanarYUV>();
+
+  return output;
+}
+
+FramePtr RenderProcessor::GenerateFrame(TexturePtr texture, const rational &time, const RenderManager::FrameOutput &output)
 {
   // Set up output frame parameters
   VideoParams frame_params = GetCacheVideoParams();
 
-  QSize frame_size = ticket_->property("size").value<QSize>();
+  const QSize& frame_size = output.force_size;
   if (!frame_size.isNull()) {
     frame_params.set_width(frame_size.width());
     frame_params.set_height(frame_size.height());
   }
 
-  VideoParams::Format frame_format = static_cast<VideoParams::Format>(ticket_->property("format").toInt());
-  if (frame_format != VideoParams::kFormatInvalid) {
+  PlanarYUV yuv = output.force_yuv;
+  if (!yuv.SupportsSize(frame_params.effective_width(), frame_params.effective_height())) {
+    yuv = PlanarYUV();
+  }
+
+  // If we're packing to YUV, keep the RGB stage at render precision so it's only quantized once
+  VideoParams::Format frame_format = output.force_format;
+  if (frame_format != VideoParams::kFormatInvalid && !yuv.IsValid()) {
     frame_params.set_format(frame_format);
   }
 
@@ -75,14 +159,14 @@ FramePtr RenderProcessor::GenerateFrame(TexturePtr texture, const rational& time
   FramePtr frame = Frame::Create();
   frame->set_timestamp(time);
   frame->set_video_params(frame_params);
-  frame->allocate();
 
   if (!texture) {
     // Blank frame out
+    frame->allocate();
     memset(frame->data(), 0, frame->allocated_size());
   } else {
     // Dump texture contents to frame
-    ColorProcessorPtr output_color_transform = ticket_->property("coloroutput").value<ColorProcessorPtr>();
+    const ColorProcessorPtr& output_color_transform = output.force_color_output;
     const VideoParams& tex_params = texture->params();
 
     if (tex_params.effective_width() != frame_params.effective_width()
@@ -91,7 +175,7 @@ FramePtr RenderProcessor::GenerateFrame(TexturePtr texture, const rational& time
         || output_color_transform) {
       TexturePtr blit_tex = render_ctx_->CreateTexture(frame_params);
 
-      QMatrix4x4 matrix = ticket_->property("matrix").value<QMatrix4x4>();
+      const QMatrix4x4& matrix = output.force_matrix;
 
       if (output_color_transform) {
         // Yes color transform, blit color managed
@@ -109,57 +193,259 @@ FramePtr RenderProcessor::GenerateFrame(TexturePtr texture, const rational& time
       texture = blit_tex;
     }
 
-    render_ctx_->DownloadFromTexture(texture.get(), frame->data(), frame->linesize_pixels());
+    if (yuv.IsValid()) {
+      // Download a fraction of the data and spare the encoder its own conversion
+      texture = render_ctx_->PackPlanarYUV(texture, yuv);
+      frame->set_video_params(texture->params());
+      frame->set_planar_yuv(yuv);
+    }
+
+    // Start the transfer before allocating so the two can overlap
+    QVariant download = render_ctx_->StartDownloadFromTexture(texture.get(), frame->linesize_pixels());
+    frame->allocate();
+    render_ctx_->FinishDownloadFromTexture(download, frame->data());
   }
 
   return frame;
 }
 
+bool RenderProcessor::ShouldRenderTiled(const RenderManager::FrameOutputList &outputs) const
+{
+  const VideoParams& params = GetCacheVideoParams();
+
+  if (ticket_->property("textureonly").toBool()
+      || params.interlacing() != VideoParams::kInterlaceNone
+      || !ticket_->property("roi").toRectF().isNull()) {
+    return false;
+  }
+
+  // Tiles are downloaded straight into place, so nothing can be scaled or moved on the way out
+  foreach (const RenderManager::FrameOutput& output, outputs) {
+    if ((!output.force_size.isNull() && output.force_size != QSize(params.width(), params.height()))
+        || !output.force_matrix.isIdentity()) {
+      return false;
+    }
+  }
+
+  if (qMax(params.effective_width(), params.effective_height()) > render_ctx_->GetMaximumTextureSize()) {
+    return true;
+  }
+
+  qint64 intermediate_size = qint64(params.effective_width()) * qint64(params.effective_height())
+      * VideoParams::GetBytesPerPixel(params.format(), VideoParams::kRGBAChannelCount);
+
+  return intermediate_size * kTiledIntermediateCount > MemoryGovernor::GetLimit(QStringLiteral("TexturePoolSize"));
+}
+
+QVector<FramePtr> RenderProcessor::GenerateTiledFrames(const TexturePtr &texture, const rational &time, const RenderManager::FrameOutputList &outputs)
+{
+  QVector<FramePtr> frames(outputs.size());
+
+  for (int i=0; i<outputs.size(); i++) {
+    VideoParams frame_params = GetCacheVideoParams();
+
+    if (outputs.at(i).force_format != VideoParams::kFormatInvalid) {
+      frame_params.set_format(outputs.at(i).force_format);
+    }
+
+    frame_params.set_channel_count(texture ? texture->channel_count() : VideoParams::kRGBChannelCount);
+
+    FramePtr frame = Frame::Create();
+    frame->set_timestamp(time);
+    frame->set_video_params(frame_params);
+    frame->allocate();
+
+    if (!texture) {
+      // Blank frame out
+      memset(frame->data(), 0, frame->allocated_size());
+    }
+
+    frames[i] = frame;
+  }
+
+  if (!texture) {
+    return frames;
+  }
+
+  // Leave room for what each tile's passes sample around it
+  int tile_size = qMin(kTileSize, render_ctx_->GetMaximumTextureSize() / 2);
+  QRect frame_region = GetFrameRegion();
+
+  for (int y=0; y<frame_region.height() && !IsCancelled(); y+=tile_size) {
+    for (int x=0; x<frame_region.width() && !IsCancelled(); x+=tile_size) {
+      QRect tile = QRect(x, y, tile_size, tile_size) & frame_region;
+      QRectF tile_region = GetNormalizedRegion(tile);
+
+      TexturePtr rendered = ResolveRegion(texture, tile);
+
+      if (!rendered) {
+        continue;
+      }
+
+      if (rendered->region() != tile_region) {
+        // Iterative shaders render a little more than they're asked for, crop it off
+        TexturePtr cropped = render_ctx_->CreateTexture(GetRegionParams(rendered->params(), tile));
+        cropped->set_region(tile_region);
+
+        ShaderJob job;
+        job.InsertValue(QStringLiteral("ove_maintex"), NodeValue(NodeValue::kTexture, QVariant::fromValue(rendered)));
+
+        QVariant crop_shader = GetNativeShader(QStringLiteral("ove_default[tiled]"), GetTiledShaderCode(ShaderCode()));
+        render_ctx_->BlitToTexture(crop_shader, job, cropped.get());
+
+        rendered = cropped;
+      }
+
+      for (int i=0; i<frames.size(); i++) {
+        const FramePtr& frame = frames.at(i);
+        const ColorProcessorPtr& output_color_transform = outputs.at(i).force_color_output;
+        TexturePtr download = rendered;
+
+        if (rendered->params().format() != frame->video_params().format() || output_color_transform) {
+          download = render_ctx_->CreateTexture(GetRegionParams(frame->video_params(), tile));
+
+          if (output_color_transform) {
+            render_ctx_->BlitColorManaged(output_color_transform, rendered, true, download.get());
+          } else {
+            ShaderJob job;
+            job.InsertValue(QStringLiteral("ove_maintex"), NodeValue(NodeValue::kTexture, QVariant::fromValue(rendered)));
+
+            render_ctx_->BlitToTexture(default_shader_, job, download.get());
+          }
+        }
+
+        char* tile_data = frame->data() + tile.y() * frame->linesize_bytes() + tile.x() * frame->video_params().GetBytesPerPixel();
+        render_ctx_->DownloadFromTexture(download.get(), tile_data, frame->linesize_pixels());
+      }
+    }
+  }
+
+  return frames;
+}
+
+QVariant RenderProcessor::RenderVideoFrame(const rational &time, const QByteArray &hash)
+{
+  rational frame_length = GetCacheVideoParams().frame_rate_as_time_base();
+  if (GetCacheVideoParams().interlacing() != VideoParams::kInterlaceNone) {
+    frame_length /= 2;
+  }
+
+  frame_hash_ = hash;
+
+  // Further outputs of the same frame only cost a blit and a download each
+  RenderManager::FrameOutputList extra_outputs = ticket_->property("extraoutputs").value<RenderManager::FrameOutputList>();
+
+  RenderManager::FrameOutputList all_outputs = extra_outputs;
+  all_outputs.prepend(GetTicketFrameOutput());
+
+  tiled_ = ShouldRenderTiled(all_outputs);
+
+  TexturePtr texture = GenerateTexture(time, frame_length);
+
+  if (tiled_) {
+    QVector<FramePtr> frames = GenerateTiledFrames(texture, time, all_outputs);
+
+    tiled_ = false;
+    tiled_frames_.clear();
+
+    if (!extra_outputs.isEmpty()) {
+      ticket_->setProperty("extraframes", QVariant::fromValue(frames.mid(1)));
+    }
+
+    return QVariant::fromValue(frames.first());
+  }
+
+  if (GetCacheVideoParams().interlacing() != VideoParams::kInterlaceNone) {
+    // Get next between frame and interlace it
+    TexturePtr top = texture;
+    TexturePtr bottom = GenerateTexture(time + frame_length, frame_length);
+
+    if (GetCacheVideoParams().interlacing() == VideoParams::kInterlacedBottomFirst) {
+      std::swap(top, bottom);
+    }
+
+    texture = render_ctx_->InterlaceTexture(top, bottom, GetCacheVideoParams());
+  }
+
+  // Keep a GPU-resident copy so the viewer can show this frame again without a disk round trip
+  if (texture && texture_cache_ && !hash.isEmpty()) {
+    texture_cache_->Insert(hash, texture);
+  }
+
+  if (ticket_->property("textureonly").toBool()) {
+    // Return GPU texture
+    if (!texture) {
+      texture = render_ctx_->CreateTexture(GetCacheVideoParams());
+    }
+
+    // Consumers on other contexts wait for it on the GPU, no need to block this thread here
+    render_ctx_->SubmitTexture(texture.get());
+
+    return QVariant::fromValue(texture);
+  } else {
+    if (!extra_outputs.isEmpty()) {
+      QVector<FramePtr> extra_frames(extra_outputs.size());
+
+      for (int i=0; i<extra_outputs.size(); i++) {
+        extra_frames[i] = GenerateFrame(texture, time, extra_outputs.at(i));
+      }
+
+      ticket_->setProperty("extraframes", QVariant::fromValue(extra_frames));
+    }
+
+    // Convert to CPU frame
+    return QVariant::fromValue(GenerateFrame(texture, time));
+  }
+}
+
 void RenderProcessor::Run()
 {
+  TRACE_SCOPE("render", "RenderProcessor::Run");
+
   // Depending on the render ticket type, start a job
   RenderManager::TicketType type = ticket_->property("type").value<RenderManager::TicketType>();
 
+  SetRenderMode(static_cast<RenderMode::Mode>(ticket_->property("mode").toInt()));
+
   switch (type) {
   case RenderManager::kTypeVideo:
   {
     SetCacheVideoParams(ticket_->property("vparam").value<VideoParams>());
-    rational time = ticket_->property("time").value<rational>();
-
-    rational frame_length = GetCacheVideoParams().frame_rate_as_time_base();
-    if (GetCacheVideoParams().interlacing() != VideoParams::kInterlaceNone) {
-      frame_length /= 2;
-    }
 
-    TexturePtr texture = GenerateTexture(time, frame_length);
+    // Static parts of the graph only need to be traversed once across all video tickets
+    SetValueCache(value_cache_);
 
-    if (GetCacheVideoParams().interlacing() != VideoParams::kInterlaceNone) {
-      // Get next between frame and interlace it
-      TexturePtr top = texture;
-      TexturePtr bottom = GenerateTexture(time + frame_length, frame_length);
+    ticket_->Finish(RenderVideoFrame(ticket_->property("time").value<rational>(),
+                                     ticket_->property("hash").toByteArray()));
+    break;
+  }
+  case RenderManager::kTypeVideoBatch:
+  {
+    SetCacheVideoParams(ticket_->property("vparam").value<VideoParams>());
+    SetValueCache(value_cache_);
 
-      if (GetCacheVideoParams().interlacing() == VideoParams::kInterlacedBottomFirst) {
-        std::swap(top, bottom);
-      }
+    RenderTicketWeakList frames = ticket_->property("frames").value<RenderTicketWeakList>();
 
-      texture = render_ctx_->InterlaceTexture(top, bottom, GetCacheVideoParams());
-    }
+    foreach (const std::weak_ptr<RenderTicket>& weak_frame, frames) {
+      RenderTicketPtr frame = weak_frame.lock();
 
-    if (ticket_->property("textureonly").toBool()) {
-      // Return GPU texture
-      if (!texture) {
-        texture = render_ctx_->CreateTexture(GetCacheVideoParams());
+      if (!frame) {
+        // Nothing is waiting for this frame anymore
+        continue;
       }
 
-      render_ctx_->Flush();
-
-      ticket_->Finish(QVariant::fromValue(texture));
-    } else {
-      // Convert to CPU frame
-      FramePtr frame = GenerateFrame(texture, time);
+      frame->Start();
 
-      ticket_->Finish(QVariant::fromValue(frame));
+      if (IsCancelled()) {
+        // Still finish so anything watching the frame hears about it
+        frame->Finish();
+      } else {
+        frame->Finish(RenderVideoFrame(frame->property("time").value<rational>(),
+                                       frame->property("hash").toByteArray()));
+      }
     }
+
+    ticket_->Finish();
     break;
   }
   case RenderManager::kTypeAudio:
@@ -169,29 +455,127 @@ void RenderProcessor::Run()
 
     NodeValueTable table;
     NodeOutput texture_output = viewer->GetConnectedSampleOutput();
+    bool samples_from_footage = texture_output.IsValid() && dynamic_cast<Footage*>(texture_output.node());
+    int block_size = ticket_->property("ablocksize").toInt();
     if (texture_output.IsValid()) {
-      table = GenerateTable(texture_output.node(), texture_output.output(), time);
+      if (block_size > 0) {
+        // Footage waveforms are only loaded for a single slice, so generate one from the samples
+        samples_from_footage = false;
+        ticket_->setProperty("usefootagewaveform", false);
+        table = GenerateAudioInBlocks(texture_output, time, block_size);
+      } else {
+        ticket_->setProperty("usefootagewaveform", samples_from_footage && ticket_->property("enablewaveforms").toBool());
+        PrerenderAudioTracks({time});
+        table = GenerateTable(texture_output.node(), texture_output.output(), time);
+        prerendered_tracks_.clear();
+      }
     }
 
     QVariant sample_variant = table.Get(NodeValue::kSamples);
     SampleBufferPtr samples = sample_variant.value<SampleBufferPtr>();
     if (samples && ticket_->property("enablewaveforms").toBool()) {
-      AudioVisualWaveform vis;
-      vis.set_channel_count(samples->audio_params().channel_count());
-      vis.OverwriteSamples(samples, samples->audio_params().sample_rate());
-      ticket_->setProperty("waveform", QVariant::fromValue(vis));
+      QVariant stored = ticket_->property("footagewaveform");
+
+      if (stored.isValid() && samples_from_footage) {
+        // Samples came straight from footage, so its stored waveform already matches them
+        ticket_->setProperty("waveform", stored);
+      } else {
+        AudioVisualWaveform vis;
+        vis.set_channel_count(samples->audio_params().channel_count());
+        vis.OverwriteSamples(samples, samples->audio_params().sample_rate());
+        ticket_->setProperty("waveform", QVariant::fromValue(vis));
+      }
+
+      // Measure meter levels here too so the GUI never has to look at the samples again
+      AudioLevels levels;
+      levels.SetSamples(samples, samples->audio_params().sample_rate());
+      ticket_->setProperty("levels", QVariant::fromValue(levels));
     }
 
     ticket_->Finish(sample_variant);
     break;
   }
+  case RenderManager::kTypeVideoPrewarm:
+  {
+    SetCacheVideoParams(ticket_->property("vparam").value<VideoParams>());
+
+    // Nothing is rendered, so this mustn't touch the value cache
+    prewarm_ = true;
+
+    ViewerOutput* viewer = Node::ValueToPtr<ViewerOutput>(ticket_->property("viewer"));
+    NodeOutput texture_output = viewer->GetConnectedTextureOutput();
+    playback_time_ = ticket_->property("time").value<rational>();
+
+    if (texture_output.IsValid()) {
+      GenerateTable(texture_output.node(), texture_output.output(),
+                    TimeRange(playback_time_, playback_time_ + GetCacheVideoParams().frame_rate_as_time_base()));
+    }
+
+    ticket_->Finish();
+    break;
+  }
   case RenderManager::kTypeVideoDownload:
   {
     QString cache = ticket_->property("cache").toString();
     FramePtr frame = ticket_->property("frame").value<FramePtr>();
     QByteArray hash = ticket_->property("hash").toByteArray();
 
-    ticket_->Finish(FrameHashCache::SaveCacheFrame(cache, hash, frame));
+    // Writing happens in the background so this thread can move on to the next render
+    ticket_->Finish(FrameHashCache::SaveCacheFrameAsync(cache, hash, frame));
+    break;
+  }
+  case RenderManager::kTypeThumbnail:
+  {
+    QString cache_file = ticket_->property("thumbnailfile").toString();
+    QImage image;
+
+    if (!cache_file.isEmpty() && QFileInfo::exists(cache_file) && image.load(cache_file)) {
+      ticket_->Finish(QVariant::fromValue(image));
+      break;
+    }
+
+    SetCacheVideoParams(ticket_->property("vparam").value<VideoParams>());
+    SetValueCache(value_cache_);
+
+    rational time = ticket_->property("time").value<rational>();
+    FramePtr frame = GenerateFrame(GenerateTexture(time, GetCacheVideoParams().frame_rate_as_time_base()), time);
+
+    // Thumbnails are opaque, so the alpha channel is dropped here
+    image = QImage(reinterpret_cast<const uchar*>(frame->const_data()),
+                   frame->width(),
+                   frame->height(),
+                   frame->linesize_bytes(),
+                   (frame->channel_count() == VideoParams::kRGBAChannelCount) ? QImage::Format_RGBA8888 : QImage::Format_RGB888).convertToFormat(QImage::Format_RGB888);
+
+    if (!cache_file.isEmpty()) {
+      QDir().mkpath(QFileInfo(cache_file).absolutePath());
+
+      QSaveFile file(cache_file);
+      if (file.open(QFile::WriteOnly) && image.save(&file, "JPG", 85)) {
+        file.commit();
+      }
+    }
+
+    ticket_->Finish(QVariant::fromValue(image));
+    break;
+  }
+  case RenderManager::kTypeFootagePreview:
+  {
+    SetCacheVideoParams(ticket_->property("vparam").value<VideoParams>());
+
+    FootageJob job = ticket_->property("footagejob").value<FootageJob>();
+    rational time = ticket_->property("time").value<rational>();
+    const VideoParams& vp = job.video_params();
+
+    // Same adjustment the traverser makes before decoding footage in a graph
+    rational footage_time = Footage::AdjustTimeByLoopMode(time, job.loop_mode(), job.length(), vp.video_type(), vp.frame_rate_as_time_base());
+
+    TexturePtr texture;
+    if (!footage_time.isNaN()) {
+      texture = ProcessVideoFootage(job, footage_time).value<TexturePtr>();
+    }
+
+    ticket_->Finish(QVariant::fromValue(GenerateFrame(texture, time)));
     break;
   }
   default:
@@ -200,81 +584,499 @@ void RenderProcessor::Run()
   }
 }
 
-DecoderPtr RenderProcessor::ResolveDecoderFromInput(const QString& decoder_id, const Decoder::CodecStream &stream)
+NodeValueTable RenderProcessor::GenerateAudioInBlocks(const NodeOutput &output, const TimeRange &range, int block_size)
+{
+  const AudioParams& audio_params = ticket_->property("aparam").value<AudioParams>();
+
+  qint64 total_samples = audio_params.time_to_samples(range.length());
+  if (total_samples <= 0) {
+    return NodeValueTable();
+  }
+
+  // The joined result leaves this thread with the ticket, so don't take it from the pool
+  SampleBufferPtr joined = SampleBuffer::CreateAllocated(audio_params, int(total_samples));
+
+  QVector<TimeRange> blocks;
+  for (qint64 offset=0; offset<total_samples; offset+=block_size) {
+    qint64 block_end = qMin(offset + block_size, total_samples);
+
+    blocks.append(TimeRange(range.in() + audio_params.samples_to_time(offset),
+                            range.in() + audio_params.samples_to_time(block_end)));
+  }
+
+  PrerenderAudioTracks(blocks);
+
+  SampleBufferPool::Scope pool_scope(SampleBufferPool::ForCurrentThread());
+
+  for (int b=0; b<blocks.size() && !IsCancelled(); b++) {
+    const TimeRange& block_range = blocks.at(b);
+    qint64 offset = qint64(b) * block_size;
+    qint64 block_end = qMin(offset + block_size, total_samples);
+
+    NodeValueTable block_table = GenerateTable(output.node(), output.output(), block_range);
+    SampleBufferPtr block_samples = block_table.Get(NodeValue::kSamples).value<SampleBufferPtr>();
+
+    if (block_samples && block_samples->is_allocated()) {
+      int copy_length = qMin(block_samples->sample_count(), int(block_end - offset));
+      int channels = qMin(block_samples->audio_params().channel_count(), audio_params.channel_count());
+
+      for (int i=0; i<channels; i++) {
+        joined->set(i, block_samples->data(i), int(offset), copy_length);
+      }
+    }
+
+    // block_table goes out of scope here, returning its buffers to the pool for the next block
+  }
+
+  prerendered_tracks_.clear();
+
+  NodeValueTable table;
+  table.Push(NodeValue::kSamples, QVariant::fromValue(joined), output.node());
+  return table;
+}
+
+DecoderPtr RenderProcessor::ResolveDecoderFromInput(const QString& decoder_id, const Decoder::CodecStream &stream, const rational &time)
 {
   if (!stream.IsValid()) {
     qWarning() << "Attempted to resolve the decoder of a null stream";
     return nullptr;
   }
 
-  QMutexLocker locker(decoder_cache_->mutex());
+  // Only requests for this stream (or one sharing its shard) wait while a decoder is opened
+  QMutexLocker locker(decoder_cache_->mutex(stream));
 
-  DecoderPair decoder = decoder_cache_->value(stream);
+  QHash<Decoder::CodecStream, DecoderPool>& decoders = decoder_cache_->map(stream);
+  DecoderPool& pool = decoders[stream];
 
   qint64 file_last_modified = QFileInfo(stream.filename()).lastModified().toMSecsSinceEpoch();
 
-  if (!decoder.decoder || decoder.last_modified != file_last_modified) {
-    // No decoder
+  if (!pool.isEmpty() && pool.first().last_modified != file_last_modified) {
+    // File has changed since these decoders were opened, discard them all. Any processor still
+    // using one holds its own reference so it's safe to drop them here.
+    pool.clear();
+  }
+
+  // Find the decoder whose last position is closest to the requested time, preferring ones that
+  // aren't currently in use
+  int nearest_idle = -1;
+  int nearest_any = -1;
+  rational nearest_idle_dist, nearest_any_dist;
+
+  for (int i=0; i<pool.size(); i++) {
+    const DecoderPair& d = pool.at(i);
+
+    rational dist;
+    if (time != Decoder::kAnyTimecode) {
+      dist = (d.last_time > time) ? d.last_time - time : time - d.last_time;
+    }
+
+    if (nearest_any == -1 || dist < nearest_any_dist) {
+      nearest_any = i;
+      nearest_any_dist = dist;
+    }
+
+    if (d.users == 0 && (nearest_idle == -1 || dist < nearest_idle_dist)) {
+      nearest_idle = i;
+      nearest_idle_dist = dist;
+    }
+  }
+
+  int index;
+
+  if (nearest_idle != -1 && nearest_idle_dist <= kDecoderAffinityRange) {
+    // An idle decoder is already near this time, use it
+    index = nearest_idle;
+  } else if (pool.size() < kMaximumDecodersPerStream
+             && (nearest_any == -1 || time != Decoder::kAnyTimecode)) {
+    // Open another instance so this request doesn't have to seek an existing one away
+    DecoderPair decoder;
     decoder.decoder = Decoder::CreateFromID(decoder_id);
     decoder.last_modified = file_last_modified;
 
-    if (decoder.decoder->Open(stream)) {
-      decoder_cache_->insert(stream, decoder);
-    } else {
+    if (!decoder.decoder->Open(stream)) {
       qWarning() << "Failed to open decoder for" << stream.filename()
                  << "::" << stream.stream();
-      return nullptr;
+
+      if (pool.isEmpty()) {
+        decoders.remove(stream);
+        return nullptr;
+      }
+
+      // Fall back to sharing one we already have
+      index = (nearest_idle != -1) ? nearest_idle : nearest_any;
+    } else {
+      pool.append(decoder);
+      index = pool.size() - 1;
     }
+  } else {
+    // Pool is full, share the closest one (the decoder serializes access internally)
+    index = (nearest_idle != -1) ? nearest_idle : nearest_any;
+  }
+
+  DecoderPair& decoder = pool[index];
+
+  decoder.users++;
+  if (time != Decoder::kAnyTimecode) {
+    decoder.last_time = time;
+    decoder.playback_time = playback_time_;
   }
 
   return decoder.decoder;
 }
 
-void RenderProcessor::Process(RenderTicketPtr ticket, Renderer *render_ctx, StillImageCache *still_image_cache, DecoderCache *decoder_cache, ShaderCache *shader_cache, QVariant default_shader)
+void RenderProcessor::ReleaseDecoder(const Decoder::CodecStream &stream, DecoderPtr decoder)
 {
-  RenderProcessor p(ticket, render_ctx, still_image_cache, decoder_cache, shader_cache, default_shader);
-  p.Run();
+  QMutexLocker locker(decoder_cache_->mutex(stream));
+
+  QHash<Decoder::CodecStream, DecoderPool>& decoders = decoder_cache_->map(stream);
+  auto it = decoders.find(stream);
+
+  if (it != decoders.end()) {
+    for (DecoderPair& d : *it) {
+      if (d.decoder == decoder) {
+        d.users--;
+        break;
+      }
+    }
+  }
 }
 
-NodeValueTable RenderProcessor::GenerateBlockTable(const Track *track, const TimeRange &range)
+RenderProcessor::FootageDecode RenderProcessor::PrepareFootageDecode(const FootageJob &stream, const Decoder::CodecStream &codec_stream, const QString &decoder_id, int divider, const rational &input_time, bool keyframes_only) const
 {
-  if (track->type() == Track::kAudio) {
+  const VideoParams& stream_data = stream.video_params();
 
-    const AudioParams& audio_params = ticket_->property("aparam").value<AudioParams>();
+  FootageDecode decode;
 
-    QVector<Block*> active_blocks = track->BlocksAtTimeRange(range);
+  decode.decoder_id = decoder_id;
+  decode.params.divider = divider;
+  decode.params.src_interlacing = stream_data.interlacing();
+  decode.params.dst_interlacing = GetCacheVideoParams().interlacing();
+  decode.params.keyframes_only = keyframes_only;
+  decode.params.planar_yuv = true;
 
-    // All these blocks will need to output to a buffer so we create one here
-    SampleBufferPtr block_range_buffer = SampleBuffer::CreateAllocated(audio_params,
-                                                                       audio_params.time_to_samples(range.length()));
-    block_range_buffer->fill(0);
+  if (stream_data.video_type() == VideoParams::kVideoTypeVideo) {
+    decode.stream = codec_stream;
+    decode.use_decoder_cache = true;
+    decode.time = input_time;
 
-    NodeValueTable merged_table;
+    if (stream_data.hardware_decoding()) {
+      decode.params.hw_device = Config::Current()[QStringLiteral("HardwareDecoding")].toString();
+    }
+  } else {
+    // Since image sequences involve multiple files, we don't engage the decoder cache
+    decode.use_decoder_cache = false;
+    decode.time = Decoder::kAnyTimecode;
 
-    // Loop through active blocks retrieving their audio
-    foreach (Block* b, active_blocks) {
-      TimeRange range_for_block(qMax(b->in(), range.in()),
-                                qMin(b->out(), range.out()));
+    QString frame_filename;
 
-      int destination_offset = audio_params.time_to_samples(range_for_block.in() - range.in());
-      int max_dest_sz = audio_params.time_to_samples(range_for_block.length());
+    if (stream_data.video_type() == VideoParams::kVideoTypeImageSequence) {
+      int64_t frame_number = stream_data.get_time_in_timebase_units(input_time);
+      frame_filename = Decoder::TransformImageSequenceFileName(stream.filename(), frame_number);
 
-      // Destination buffer
-      NodeValueTable table = GenerateTable(b, Track::TransformRangeForBlock(b, range_for_block));
-      SampleBufferPtr samples_from_this_block = table.Take(NodeValue::kSamples).value<SampleBufferPtr>();
+      // Start reading the next files while this one decodes, otherwise playback from slow
+      // storage waits on each file's latency in turn
+      int64_t last_frame = stream_data.start_time() + stream_data.duration() - 1;
 
-      if (!samples_from_this_block) {
-        // If we retrieved no samples from this block, do nothing
-        continue;
+      for (int64_t i=frame_number+1; i<=frame_number+Config::kImageSequenceReadAhead.Get(); i++) {
+        if (stream_data.duration() > 0 && i > last_frame) {
+          break;
+        }
+
+        decode.prefetch.append(Decoder::TransformImageSequenceFileName(stream.filename(), i));
       }
+    } else {
+      frame_filename = stream.filename();
+    }
 
-      double speed_value = b->GetStandardValue(Block::kSpeedInput).toDouble();
+    decode.stream = Decoder::CodecStream(frame_filename, stream_data.stream_index());
+  }
 
-      if (qIsNull(speed_value)) {
-        // Just silence, don't think there's any other practical application of 0 speed audio
-        samples_from_this_block->fill(0);
-      } else if (!qFuzzyCompare(speed_value, 1.0)) {
-        // Multiply time
+  return decode;
+}
+
+FramePtr RenderProcessor::DecodeFootage(FootageDecode decode)
+{
+  DecoderPtr decoder;
+
+  if (decode.use_decoder_cache) {
+    decoder = ResolveDecoderFromInput(decode.decoder_id, decode.stream, decode.time);
+  } else {
+    decoder = Decoder::CreateFromID(decode.decoder_id);
+
+    if (decoder) {
+      if (!decode.prefetch.isEmpty()) {
+        Decoder::RetrieveVideoParams prefetch_params;
+        prefetch_params.divider = decode.params.divider;
+        decoder->PrefetchFiles(decode.prefetch, prefetch_params);
+      }
+
+      // Decoder will close automatically since it's a stream_ptr
+      decoder->Open(decode.stream);
+    }
+  }
+
+  if (!decoder) {
+    return nullptr;
+  }
+
+  FramePtr frame = decoder->RetrieveVideo(decode.time, decode.params);
+
+  if (decode.use_decoder_cache) {
+    ReleaseDecoder(decode.stream, decoder);
+  }
+
+  return frame;
+}
+
+void RenderProcessor::PredecodeFootage(const NodeOutput &output, const TimeRange &range)
+{
+  predecoded_.clear();
+
+  if (GetDecodeThreadPool()->maxThreadCount() < 2) {
+    return;
+  }
+
+  collecting_footage_ = true;
+  SetValueCacheReadOnly(true);
+
+  GenerateTable(output.node(), output.output(), range);
+
+  SetValueCacheReadOnly(false);
+  collecting_footage_ = false;
+
+  if (predecoded_.size() < 2 || IsCancelled()) {
+    // Nothing to overlap, the traversal can decode it as usual
+    predecoded_.clear();
+    return;
+  }
+
+  TRACE_SCOPE("render", "RenderProcessor::PredecodeFootage");
+
+  // Decode the first frame on this thread while the rest decode in the pool
+  QVector<QFuture<FramePtr> > futures(predecoded_.size());
+
+  for (int i=1; i<predecoded_.size(); i++) {
+    futures[i] = QtConcurrent::run(GetDecodeThreadPool(), this, &RenderProcessor::DecodeFootage, predecoded_.at(i));
+  }
+
+  predecoded_[0].frame = DecodeFootage(predecoded_.at(0));
+
+  for (int i=1; i<predecoded_.size(); i++) {
+    predecoded_[i].frame = futures.at(i).result();
+  }
+}
+
+void RenderProcessor::QueuePredecode(const FootageDecode &decode)
+{
+  foreach (const FootageDecode& d, predecoded_) {
+    if (d.IsSameFrame(decode)) {
+      return;
+    }
+  }
+
+  predecoded_.append(decode);
+}
+
+FramePtr RenderProcessor::TakePredecodedFrame(const FootageDecode &decode)
+{
+  for (int i=0; i<predecoded_.size(); i++) {
+    if (predecoded_.at(i).IsSameFrame(decode)) {
+      FramePtr frame = predecoded_.at(i).frame;
+      predecoded_.removeAt(i);
+      return frame;
+    }
+  }
+
+  return nullptr;
+}
+
+QThreadPool *RenderProcessor::GetDecodeThreadPool()
+{
+  // Render threads block on these, so they mustn't share the global pool
+  static QThreadPool pool;
+  static const bool initialized = [](){
+    pool.setMaxThreadCount(HardwareProfile::GetRenderThreadCount());
+    return true;
+  }();
+  Q_UNUSED(initialized)
+
+  return &pool;
+}
+
+void RenderProcessor::PrerenderAudioTracks(const QVector<TimeRange> &blocks)
+{
+  prerendered_tracks_.clear();
+
+  Sequence* sequence = dynamic_cast<Sequence*>(Node::ValueToPtr<ViewerOutput>(ticket_->property("viewer")));
+
+  if (!sequence || blocks.isEmpty() || GetAudioThreadPool()->maxThreadCount() < 2) {
+    return;
+  }
+
+  TimeRange whole_range(blocks.first().in(), blocks.last().out());
+
+  QVector<const Track*> tracks;
+  foreach (Track* t, sequence->track_list(Track::kAudio)->GetTracks()) {
+    if (!t->BlocksAtTimeRange(whole_range).isEmpty()) {
+      tracks.append(t);
+    }
+  }
+
+  // If there are fewer tracks than threads, split each track's blocks up too
+  int runs = qBound(1, GetAudioThreadPool()->maxThreadCount() / qMax(1, tracks.size()), blocks.size());
+
+  if (tracks.size() * runs < 2) {
+    // Nothing to overlap, the traversal can render it as usual
+    return;
+  }
+
+  TRACE_SCOPE("render", "RenderProcessor::PrerenderAudioTracks");
+
+  struct TrackRun {
+    const Track* track;
+    int first;
+    RenderTicketPtr ticket;
+    QFuture<QVector<NodeValueTable> > future;
+  };
+
+  QVector<TrackRun> pieces;
+  pieces.reserve(tracks.size() * runs);
+
+  foreach (const Track* track, tracks) {
+    for (int i=0; i<runs; i++) {
+      int first = blocks.size() * i / runs;
+      int last = blocks.size() * (i + 1) / runs;
+
+      // Each run gets its own ticket to write waveforms and other results to, so runs never touch
+      // the same ticket at once
+      RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+      foreach (const QByteArray& name, ticket_->dynamicPropertyNames()) {
+        ticket->setProperty(name, ticket_->property(name));
+      }
+      ticket->setProperty("waveforms", QVariant());
+
+      TrackRun r;
+      r.track = track;
+      r.first = first;
+      r.ticket = ticket;
+      r.future = QtConcurrent::run(GetAudioThreadPool(), this, &RenderProcessor::RenderAudioTrack,
+                                   ticket, track, blocks.mid(first, last - first));
+      pieces.append(r);
+    }
+  }
+
+  QVector<RenderedWaveform> waveforms = ticket_->property("waveforms").value< QVector<RenderedWaveform> >();
+
+  foreach (const TrackRun& r, pieces) {
+    QVector<NodeValueTable> tables = r.future.result();
+
+    QHash<TimeRange, NodeValueTable>& track_tables = prerendered_tracks_[r.track];
+    for (int i=0; i<tables.size(); i++) {
+      track_tables.insert(blocks.at(r.first + i), tables.at(i));
+    }
+
+    waveforms.append(r.ticket->property("waveforms").value< QVector<RenderedWaveform> >());
+
+    if (r.ticket->property("incomplete").toBool()) {
+      ticket_->setProperty("incomplete", true);
+    }
+  }
+
+  if (ticket_->property("enablewaveforms").toBool()) {
+    ticket_->setProperty("waveforms", QVariant::fromValue(waveforms));
+  }
+}
+
+QVector<NodeValueTable> RenderProcessor::RenderAudioTrack(RenderTicketPtr ticket, const Track *track, const QVector<TimeRange> &blocks)
+{
+  RenderProcessor p(ticket, render_ctx_, still_image_cache_, texture_cache_, interlaced_cache_, value_cache_, decoder_cache_, shader_cache_, default_shader_);
+  p.SetRenderMode(static_cast<RenderMode::Mode>(ticket->property("mode").toInt()));
+
+  SampleBufferPool::Scope pool_scope(SampleBufferPool::ForCurrentThread());
+
+  QVector<NodeValueTable> tables;
+  tables.reserve(blocks.size());
+
+  foreach (const TimeRange& block, blocks) {
+    if (IsCancelled()) {
+      break;
+    }
+
+    tables.append(p.GenerateBlockTable(track, block));
+  }
+
+  return tables;
+}
+
+QThreadPool *RenderProcessor::GetAudioThreadPool()
+{
+  // Kept apart from the decode pool so audio never holds up video decodes, or vice versa
+  static QThreadPool pool;
+  static const bool initialized = [](){
+    pool.setMaxThreadCount(HardwareProfile::GetRenderThreadCount());
+    return true;
+  }();
+  Q_UNUSED(initialized)
+
+  return &pool;
+}
+
+void RenderProcessor::Process(RenderTicketPtr ticket, Renderer *render_ctx, StillImageCache *still_image_cache, FrameTextureCache *texture_cache, InterlacedFrameCache *interlaced_cache, NodeValueCache *value_cache, DecoderCache *decoder_cache, ShaderCache *shader_cache, QVariant default_shader)
+{
+  RenderProcessor p(ticket, render_ctx, still_image_cache, texture_cache, interlaced_cache, value_cache, decoder_cache, shader_cache, default_shader);
+  p.Run();
+}
+
+NodeValueTable RenderProcessor::GenerateBlockTable(const Track *track, const TimeRange &range)
+{
+  if (track->type() == Track::kAudio) {
+
+    auto prerendered = prerendered_tracks_.find(track);
+    if (prerendered != prerendered_tracks_.end()) {
+      auto table = prerendered->find(range);
+      if (table != prerendered->end()) {
+        // Rendered in parallel by PrerenderAudioTracks(), including its waveform
+        NodeValueTable t = table.value();
+        prerendered->erase(table);
+        return t;
+      }
+    }
+
+    const AudioParams& audio_params = ticket_->property("aparam").value<AudioParams>();
+
+    QVector<Block*> active_blocks = track->BlocksAtTimeRange(range);
+
+    // All these blocks will need to output to a buffer so we create one here
+    SampleBufferPtr block_range_buffer = SampleBuffer::CreateAllocated(audio_params,
+                                                                       audio_params.time_to_samples(range.length()));
+    block_range_buffer->fill(0);
+
+    NodeValueTable merged_table;
+
+    // Loop through active blocks retrieving their audio
+    foreach (Block* b, active_blocks) {
+      TimeRange range_for_block(qMax(b->in(), range.in()),
+                                qMin(b->out(), range.out()));
+
+      int destination_offset = audio_params.time_to_samples(range_for_block.in() - range.in());
+      int max_dest_sz = audio_params.time_to_samples(range_for_block.length());
+
+      // Destination buffer
+      NodeValueTable table = GenerateTable(b, Track::TransformRangeForBlock(b, range_for_block));
+      SampleBufferPtr samples_from_this_block = table.Take(NodeValue::kSamples).value<SampleBufferPtr>();
+
+      if (!samples_from_this_block) {
+        // If we retrieved no samples from this block, do nothing
+        continue;
+      }
+
+      double speed_value = b->GetStandardValue(Block::kSpeedInput).toDouble();
+
+      if (qIsNull(speed_value)) {
+        // Just silence, don't think there's any other practical application of 0 speed audio
+        samples_from_this_block->fill(0);
+      } else if (!qFuzzyCompare(speed_value, 1.0)) {
+        // Multiply time
         samples_from_this_block->speed(speed_value);
       }
 
@@ -315,7 +1117,9 @@ NodeValueTable RenderProcessor::GenerateBlockTable(const Track *track, const Tim
 
 QVariant RenderProcessor::ProcessVideoFootage(const FootageJob &stream, const rational &input_time)
 {
-  if (ticket_->property("type").value<RenderManager::TicketType>() != RenderManager::kTypeVideo) {
+  RenderManager::TicketType type = ticket_->property("type").value<RenderManager::TicketType>();
+  if (type != RenderManager::kTypeVideo && type != RenderManager::kTypeVideoBatch && type != RenderManager::kTypeThumbnail
+      && type != RenderManager::kTypeVideoPrewarm && type != RenderManager::kTypeFootagePreview) {
     // Video cannot contribute to audio, so we do nothing here
     return QVariant();
   }
@@ -346,124 +1150,282 @@ QVariant RenderProcessor::ProcessVideoFootage(const FootageJob &stream, const ra
   }
 
   Decoder::CodecStream default_codec_stream(stream.filename(), stream_data.stream_index());
+  QString decoder_id = stream.decoder();
+
+  // Previews at a low enough resolution can decode a proxy instead of the original. Proxies are
+  // the size the original would decode to at their divider, so the rest of the divider still
+  // gives us exactly the size we'd have had without one.
+  int decode_divider = footage_divider;
+  if (stream_data.video_type() == VideoParams::kVideoTypeVideo
+      && static_cast<RenderMode::Mode>(ticket_->property("mode").toInt()) == RenderMode::kOffline
+      && Config::kProxyEnabled.Get()
+      && ProxyManager::IsProxyWorthwhile(stream_data)) {
+    int proxy_divider = Config::kProxyDivider.Get();
+
+    if (proxy_divider > 1 && footage_divider % proxy_divider == 0) {
+      QString proxy = ProxyManager::instance()->GetProxy(decoder_id, stream.cache_path(), default_codec_stream,
+                                                         stream_data, proxy_divider);
+
+      if (!proxy.isEmpty()) {
+        default_codec_stream = Decoder::CodecStream(proxy, 0);
+        decoder_id = QStringLiteral("ffmpeg");
+        decode_divider = footage_divider / proxy_divider;
+      }
+    }
+  }
+
+  if (prewarm_) {
+    // Decode the frame playback will start this footage at, leaving the decoder open and positioned
+    // for when it gets there
+    if (stream_data.video_type() == VideoParams::kVideoTypeVideo) {
+      DecoderPtr decoder = ResolveDecoderFromInput(decoder_id, default_codec_stream, input_time);
+
+      if (decoder) {
+        Decoder::RetrieveVideoParams p;
+        p.divider = decode_divider;
+        p.planar_yuv = true;
+        if (CanDeinterlaceOnGPU(stream_data)) {
+          p.src_interlacing = VideoParams::kInterlaceNone;
+          p.dst_interlacing = stream_data.interlacing();
+        } else {
+          p.src_interlacing = stream_data.interlacing();
+          p.dst_interlacing = GetCacheVideoParams().interlacing();
+        }
+        if (stream_data.hardware_decoding()) {
+          p.hw_device = Config::Current()[QStringLiteral("HardwareDecoding")].toString();
+        }
+
+        decoder->RetrieveVideo(input_time, p);
+
+        ReleaseDecoder(default_codec_stream, decoder);
+      }
+    }
+
+    return QVariant();
+  }
+
+  // Keyframe-only frames are approximations of the frame at this time, so they must not be cached
+  // where an exact render could find them
+  bool keyframes_only = ticket_->property("keyframesonly").toBool()
+      && stream_data.video_type() == VideoParams::kVideoTypeVideo;
+
+  // Keyframe-only frames are too far apart for their neighbors to be any use, so they're left to
+  // the decoder's own deinterlacer
+  if (!keyframes_only && CanDeinterlaceOnGPU(stream_data)) {
+    return QVariant::fromValue(DeinterlaceFootage(stream, default_codec_stream, decoder_id, decode_divider, input_time));
+  }
 
   StillImageCache::EntryPtr want_entry = std::make_shared<StillImageCache::Entry>(
         nullptr,
         default_codec_stream,
         ColorProcessor::GenerateID(color_manager, using_colorspace, color_manager->GetReferenceColorSpace()),
         stream_data.premultiplied_alpha(),
-        footage_divider,
+        decode_divider,
         (stream_data.video_type() == VideoParams::kVideoTypeStill) ? 0 : input_time,
         true);
 
+  if (collecting_footage_) {
+    // Only queue frames the still image cache can't already provide
+    QMutexLocker locker(still_image_cache_->mutex());
+
+    if (keyframes_only || !still_image_cache_->Find(want_entry)) {
+      QueuePredecode(PrepareFootageDecode(stream, default_codec_stream, decoder_id, decode_divider, input_time, keyframes_only));
+    }
+
+    return QVariant();
+  }
+
   bool found_existing = false;
 
   still_image_cache_->mutex()->lock();
 
-  foreach (StillImageCache::EntryPtr e, still_image_cache_->entries()) {
-    if (StillImageCache::CompareEntryMetadata(want_entry, e)) {
-      // Found an exact match of the texture we want in the cache. See if it's working or if it's
-      // ready.
-      want_entry = e;
-      found_existing = true;
+  StillImageCache::EntryPtr existing = keyframes_only ? nullptr : still_image_cache_->Find(want_entry);
 
-      while (want_entry->working) {
-        still_image_cache_->wait_cond()->wait(still_image_cache_->mutex());
-      }
+  if (existing) {
+    // Found an exact match of the texture we want in the cache. See if it's working or if it's
+    // ready.
+    want_entry = existing;
+    found_existing = true;
 
-      value = want_entry->texture;
-      break;
+    while (want_entry->working) {
+      still_image_cache_->wait_cond()->wait(still_image_cache_->mutex());
     }
+
+    value = want_entry->texture;
   }
 
+  static Metric* still_hits = MetricsRegistry::Counter(QStringLiteral("olive_still_image_cache_hits_total"),
+                                                       QStringLiteral("Footage frames reused from the still image cache"));
+  static Metric* still_misses = MetricsRegistry::Counter(QStringLiteral("olive_still_image_cache_misses_total"),
+                                                         QStringLiteral("Footage frames that had to be decoded"));
+
   if (value) {
     // Found the texture, we can release the cache now
     still_image_cache_->mutex()->unlock();
+
+    still_hits->Increment();
   } else {
+    still_misses->Increment();
+
     // Wasn't in still image cache, so we'll have to retrieve it from the decoder
 
     // Let other processors know we're getting this texture (want_entry's `working` field is
     // already set to true in the initializer above)
-    if (!found_existing) {
+    if (!found_existing && !keyframes_only) {
       still_image_cache_->PushEntry(want_entry);
     }
 
     still_image_cache_->mutex()->unlock();
 
-    QString decoder_id = stream.decoder();
+    FootageDecode decode = PrepareFootageDecode(stream, default_codec_stream, decoder_id, decode_divider, input_time, keyframes_only);
 
-    DecoderPtr decoder = nullptr;
+    FramePtr frame = TakePredecodedFrame(decode);
 
-    if (stream_data.video_type() == VideoParams::kVideoTypeVideo) {
-      decoder = ResolveDecoderFromInput(decoder_id, default_codec_stream);
-    } else {
-      // Since image sequences involve multiple files, we don't engage the decoder cache
-      decoder = Decoder::CreateFromID(decoder_id);
+    if (!frame) {
+      frame = DecodeFootage(decode);
+    }
+
+    if (frame) {
+      value = UploadFootageFrame(frame, stream_data, color_manager, using_colorspace);
+    }
 
-      QString frame_filename;
+    // Put this into the image cache, or drop the entry if decoding failed so nothing waits on it
+    if (!keyframes_only) {
+      still_image_cache_->SetEntryTexture(want_entry, value);
+    }
+  }
 
-      if (stream_data.video_type() == VideoParams::kVideoTypeImageSequence) {
-        int64_t frame_number = stream_data.get_time_in_timebase_units(input_time);
-        frame_filename = Decoder::TransformImageSequenceFileName(stream.filename(), frame_number);
-      } else {
-        frame_filename = stream.filename();
-      }
+  return QVariant::fromValue(value);
+}
 
-      // Decoder will close automatically since it's a stream_ptr
-      decoder->Open(Decoder::CodecStream(frame_filename, stream_data.stream_index()));
+bool RenderProcessor::CanDeinterlaceOnGPU(const VideoParams &stream_data)
+{
+  return stream_data.video_type() == VideoParams::kVideoTypeVideo
+      && stream_data.interlacing() != VideoParams::kInterlaceNone
+      && Config::kGPUDeinterlace.Get();
+}
+
+TexturePtr RenderProcessor::UploadFootageFrame(FramePtr frame, const VideoParams &stream_data, ColorManager *color_manager, const QString &colorspace)
+{
+  // Return a texture from the derived class
+  TexturePtr unmanaged_texture = render_ctx_->CreateTexture(frame->video_params(),
+                                                            frame->data(),
+                                                            frame->linesize_pixels());
+
+  // We convert to our rendering pixel format, since that will always be float-based which
+  // is necessary for correct color conversion
+  VideoParams managed_params = frame->video_params();
+  managed_params.set_format(GetCacheVideoParams().format());
+  managed_params.set_pixel_aspect_ratio(stream_data.pixel_aspect_ratio());
+  managed_params.set_interlacing(stream_data.interlacing());
+
+  const PlanarYUV& yuv = frame->planar_yuv();
+  if (yuv.IsValid()) {
+    // The planes unpack to an RGB picture of the luma plane's size
+    managed_params.set_height(yuv.picture_height(managed_params.height()));
+    managed_params.set_channel_count(VideoParams::kRGBChannelCount);
+  }
+
+  TexturePtr managed_texture = render_ctx_->CreateTexture(managed_params);
+
+  ColorProcessorPtr processor = ColorProcessor::Create(color_manager,
+                                                       colorspace,
+                                                       color_manager->GetReferenceColorSpace());
+
+  if (yuv.IsValid()) {
+    // YUV to RGB happens in the same pass as the input transform
+    render_ctx_->BlitColorManagedPlanarYUV(processor, unmanaged_texture, yuv, managed_texture.get());
+  } else {
+    render_ctx_->BlitColorManaged(processor, unmanaged_texture,
+                                  stream_data.premultiplied_alpha(),
+                                  managed_texture.get());
+  }
+
+  return managed_texture;
+}
+
+TexturePtr RenderProcessor::DeinterlaceFootage(const FootageJob &stream, const Decoder::CodecStream &codec_stream, const QString &decoder_id, int divider, const rational &input_time)
+{
+  const VideoParams& stream_data = stream.video_params();
+
+  ColorManager* color_manager = Node::ValueToPtr<ColorManager>(ticket_->property("colormanager"));
+
+  // Work out which field of which frame is showing at this time
+  rational frame_length = stream_data.frame_rate_as_time_base();
+  int64_t frame = Timecode::time_to_timestamp(input_time, frame_length, true);
+  int64_t field = Timecode::time_to_timestamp(input_time, frame_length / 2, true);
+  bool second_field = (field != frame * 2);
+
+  // Previous, current and next woven frames
+  TexturePtr woven[3];
+
+  for (int i=0; i<3; i++) {
+    rational time = Timecode::timestamp_to_time(frame + i - 1, frame_length);
+
+    if (time < 0) {
+      continue;
     }
 
-    if (decoder) {
-      Decoder::RetrieveVideoParams p;
-      p.divider = footage_divider;
-      p.src_interlacing = stream_data.interlacing();
-      p.dst_interlacing = GetCacheVideoParams().interlacing();
+    InterlacedFrameCache::Key key = {codec_stream,
+                                     ColorProcessor::GenerateID(color_manager, stream_data.colorspace(), color_manager->GetReferenceColorSpace()),
+                                     stream_data.premultiplied_alpha(),
+                                     divider,
+                                     time};
 
-      FramePtr frame = decoder->RetrieveVideo((stream_data.video_type() == VideoParams::kVideoTypeVideo) ? input_time : Decoder::kAnyTimecode, p);
+    woven[i] = interlaced_cache_->Get(key);
 
-      if (frame) {
-        // Return a texture from the derived class
-        TexturePtr unmanaged_texture = render_ctx_->CreateTexture(frame->video_params(),
-                                                                  frame->data(),
-                                                                  frame->linesize_pixels());
+    if (woven[i]) {
+      continue;
+    }
 
-        // We convert to our rendering pixel format, since that will always be float-based which
-        // is necessary for correct color conversion
-        VideoParams managed_params = frame->video_params();
-        managed_params.set_format(render_params.format());
-        managed_params.set_pixel_aspect_ratio(stream_data.pixel_aspect_ratio());
-        managed_params.set_interlacing(stream_data.interlacing());
-        value = render_ctx_->CreateTexture(managed_params);
+    // Have the decoder leave the fields woven together, still scaling them separately if it
+    // has to scale at all
+    FootageDecode decode = PrepareFootageDecode(stream, codec_stream, decoder_id, divider, time, false);
+    decode.params.src_interlacing = VideoParams::kInterlaceNone;
+    decode.params.dst_interlacing = stream_data.interlacing();
 
-        ColorProcessorPtr processor = ColorProcessor::Create(color_manager,
-                                                             using_colorspace,
-                                                             color_manager->GetReferenceColorSpace());
+    if (collecting_footage_) {
+      QueuePredecode(decode);
+      continue;
+    }
 
-        render_ctx_->BlitColorManaged(processor, unmanaged_texture,
-                                      stream_data.premultiplied_alpha(),
-                                      value.get());
+    FramePtr f = TakePredecodedFrame(decode);
 
-        still_image_cache_->mutex()->lock();
+    if (!f) {
+      f = DecodeFootage(decode);
+    }
 
-        // Put this into the image cache instead
-        want_entry->texture = value;
-        want_entry->working = false;
+    if (f) {
+      woven[i] = UploadFootageFrame(f, stream_data, color_manager, stream_data.colorspace());
+      interlaced_cache_->Insert(key, woven[i]);
+    }
+  }
 
-        still_image_cache_->wait_cond()->wakeAll();
+  if (collecting_footage_ || !woven[1]) {
+    return nullptr;
+  }
 
-        still_image_cache_->mutex()->unlock();
-      }
+  // At either end of the footage, the current frame stands in for the neighbor that's missing
+  for (int i=0; i<3; i+=2) {
+    if (!woven[i] || woven[i]->params() != woven[1]->params()) {
+      woven[i] = woven[1];
     }
   }
 
-  return QVariant::fromValue(value);
+  return render_ctx_->DeinterlaceTexture(woven[0], woven[1], woven[2], second_field, stream_data.interlacing());
 }
 
 QVariant RenderProcessor::ProcessAudioFootage(const FootageJob &stream, const TimeRange &input_time)
 {
+  if (collecting_footage_) {
+    return QVariant();
+  }
+
   QVariant value;
 
-  DecoderPtr decoder = ResolveDecoderFromInput(stream.decoder(), Decoder::CodecStream(stream.filename(), stream.audio_params().stream_index()));
+  Decoder::CodecStream codec_stream(stream.filename(), stream.audio_params().stream_index());
+
+  DecoderPtr decoder = ResolveDecoderFromInput(stream.decoder(), codec_stream, Decoder::kAnyTimecode);
 
   if (decoder) {
     const AudioParams& audio_params = ticket_->property("aparam").value<AudioParams>();
@@ -473,8 +1435,20 @@ QVariant RenderProcessor::ProcessAudioFootage(const FootageJob &stream, const Ti
                                                                stream.loop_mode(),
                                                                static_cast<RenderMode::Mode>(ticket_->property("mode").toInt()));
 
+    ReleaseDecoder(codec_stream, decoder);
+
     if (status.status == Decoder::kOK && status.samples) {
       value = QVariant::fromValue(status.samples);
+
+      if (ticket_->property("usefootagewaveform").toBool()
+          && stream.loop_mode() == Footage::kLoopModeOff
+          && input_time.in() >= 0) {
+        // If the conform has a stored waveform, read the range we need from it so we don't have to summarize
+        AudioVisualWaveform stored;
+        if (stored.LoadFromFile(status.waveform_filename, input_time.in(), input_time.length())) {
+          ticket_->setProperty("footagewaveform", QVariant::fromValue(stored));
+        }
+      }
     } else if (status.status == Decoder::kWaitingForConform) {
       ticket_->setProperty("incomplete", true);
     }
@@ -487,37 +1461,58 @@ QVariant RenderProcessor::ProcessShader(const Node *node, const TimeRange &range
 {
   Q_UNUSED(range)
 
-  QString full_shader_id = QStringLiteral("%1:%2").arg(node->id(), job.GetShaderID());
+  if (prewarm_ || collecting_footage_) {
+    return QVariant();
+  }
 
-  QMutexLocker locker(shader_cache_->mutex());
+  DeferredShader shader;
+  shader.id = QStringLiteral("%1:%2").arg(node->id(), job.GetShaderID());
+  shader.code = node->GetShaderCode(job.GetShaderID());
+  shader.job = job;
+  shader.job.SetProfileNode(node);
+  shader.channel_count = GetChannelCountFromJob(job);
+
+  // Inline whichever inputs came from shaders we haven't run yet where possible. The rest keep
+  // their placeholders and are rendered before us by ResolveDeferredTexture().
+  bool can_inline = CanInlineIntoShader(shader);
+  int inlined = 0;
+
+  if (can_inline) {
+    for (auto it=job.GetValues().cbegin(); it!=job.GetValues().cend(); it++) {
+      if (it.value().type() != NodeValue::kTexture) {
+        continue;
+      }
 
-  QVariant shader = shader_cache_->value(full_shader_id);
+      TexturePtr texture = it.value().data().value<TexturePtr>();
+      auto deferred = deferred_shaders_.constFind(texture.get());
 
-  if (shader.isNull()) {
-    // Since we have shader code, compile it now
-    shader = render_ctx_->CreateNativeShader(node->GetShaderCode(job.GetShaderID()));
+      if (!texture || deferred == deferred_shaders_.constEnd() || !deferred->inlinable) {
+        continue;
+      }
 
-    if (shader.isNull()) {
-      // Couldn't find or build the shader required
-      return QVariant();
+      if (InlineDeferredShader(&shader, it.key(), deferred.value(), inlined, render_ctx_->GetMaximumTextureUnits())) {
+        inlined++;
+      }
     }
   }
 
-  VideoParams tex_params = GetCacheVideoParams();
+  // Constants may never need to exist as a texture at all if downstream combines them
+  shader.inlinable = CanDeferShader(shader) || shader.job.HasConstantColor();
 
-  tex_params.set_channel_count(GetChannelCountFromJob(job));
+  shader.placeholder = std::make_shared<Texture>(GetIntermediateParams(shader.channel_count, shader.job.RequiresFullPrecision()));
 
-  TexturePtr destination = render_ctx_->CreateTexture(tex_params);
+  if (shader.job.HasConstantColor()) {
+    shader.placeholder->SetConstantColor(shader.job.GetConstantColor());
+  }
 
-  // Run shader
-  render_ctx_->BlitToTexture(shader, job, destination.get());
+  deferred_shaders_.insert(shader.placeholder.get(), shader);
 
-  return QVariant::fromValue(destination);
+  return QVariant::fromValue(shader.placeholder);
 }
 
 QVariant RenderProcessor::ProcessSamples(const Node *node, const TimeRange &range, const SampleJob &job)
 {
-  if (!job.samples() || !job.samples()->is_allocated()) {
+  if (prewarm_ || collecting_footage_ || !job.samples() || !job.samples()->is_allocated()) {
     return QVariant();
   }
 
@@ -526,15 +1521,49 @@ QVariant RenderProcessor::ProcessSamples(const Node *node, const TimeRange &rang
 
   const AudioParams& audio_params = ticket_->property("aparam").value<AudioParams>();
 
-  for (int i=0;i<job.samples()->sample_count();i++) {
+  QVector<rational> sample_times(job.samples()->sample_count());
+  for (int i=0;i<sample_times.size();i++) {
     // Calculate the exact rational time at this sample
     double sample_to_second = static_cast<double>(i) / static_cast<double>(audio_params.sample_rate());
 
-    rational this_sample_time = rational::fromDouble(range.in().toDouble() + sample_to_second);
+    sample_times[i] = rational::fromDouble(range.in().toDouble() + sample_to_second);
+  }
+
+  // Inputs that are just values (not connected or arrays) can be evaluated for every sample in one
+  // pass over their keyframes rather than searching them again for each sample
+  QHash<QString, QVector<QVariant> > batched_values;
+  for (auto j=job.GetValues().constBegin(); j!=job.GetValues().constEnd(); j++) {
+    const QString& input = j.key();
+
+    if (!node->IsInputConnected(input) && !node->InputIsArray(input)) {
+      QVector<rational> adjusted_times(sample_times.size());
+      for (int i=0;i<sample_times.size();i++) {
+        adjusted_times[i] = node->InputTimeAdjustment(input, -1, TimeRange(sample_times.at(i), sample_times.at(i))).in();
+      }
+
+      batched_values.insert(input, node->GetValuesAtTimes(input, adjusted_times));
+    }
+  }
+
+  // With every input already evaluated, nodes can process whole planes rather than sample by sample
+  if (batched_values.size() == job.GetValues().size()
+      && node->ProcessSampleBlock(batched_values, job.samples(), output_buffer)) {
+    return QVariant::fromValue(output_buffer);
+  }
+
+  for (int i=0;i<job.samples()->sample_count();i++) {
+    const rational& this_sample_time = sample_times.at(i);
 
     // Update all non-sample and non-footage inputs
     for (auto j=job.GetValues().constBegin(); j!=job.GetValues().constEnd(); j++) {
-      NodeValueTable value = ProcessInput(node, j.key(), TimeRange(this_sample_time, this_sample_time));
+      NodeValueTable value;
+
+      auto batched = batched_values.constFind(j.key());
+      if (batched == batched_values.constEnd()) {
+        value = ProcessInput(node, j.key(), TimeRange(this_sample_time, this_sample_time));
+      } else {
+        value.Push(node->GetInputDataType(j.key()), batched->at(i), node);
+      }
 
       value_db.Insert(j.key(), value);
     }
@@ -552,6 +1581,10 @@ QVariant RenderProcessor::ProcessSamples(const Node *node, const TimeRange &rang
 
 QVariant RenderProcessor::ProcessFrameGeneration(const Node *node, const GenerateJob &job)
 {
+  if (prewarm_ || collecting_footage_) {
+    return QVariant();
+  }
+
   FramePtr frame = Frame::Create();
 
   VideoParams frame_params = GetCacheVideoParams();
@@ -559,24 +1592,130 @@ QVariant RenderProcessor::ProcessFrameGeneration(const Node *node, const Generat
   frame->set_video_params(frame_params);
   frame->allocate();
 
-  node->GenerateFrame(frame, job);
+  if (job.GetDownloadTextures()) {
+    // Inputs are downloaded straight into the buffers the node reads from
+    GenerateJob job_with_frames = job;
 
-  TexturePtr texture = render_ctx_->CreateTexture(frame->video_params(),
-                                                  frame->data(),
-                                                  frame->linesize_pixels());
+    for (auto it=job.GetValues().cbegin(); it!=job.GetValues().cend(); it++) {
+      if (it.value().type() != NodeValue::kTexture) {
+        continue;
+      }
+
+      TexturePtr input = it.value().data().value<TexturePtr>();
+      if (!input) {
+        continue;
+      }
+
+      // The node needs all of its inputs at once, even in a tiled render
+      if (tiled_) {
+        input = ResolveRegion(input, QRect(0, 0, frame_params.effective_width(), frame_params.effective_height()));
+      } else {
+        input = ResolveDeferredTexture(input);
+      }
+
+      FramePtr input_frame = Frame::Create();
+      input_frame->set_video_params(input->params());
+      input_frame->allocate();
+
+      render_ctx_->DownloadFromTexture(input.get(), input_frame->data(), input_frame->linesize_pixels());
+
+      job_with_frames.SetFrame(it.key(), input_frame);
+    }
+
+    node->GenerateFrame(frame, job_with_frames);
+  } else {
+    node->GenerateFrame(frame, job);
+  }
+
+  if (tiled_) {
+    // Uploaded a tile at a time as ResolveRegion() needs it rather than all at once
+    TiledFrame tiled;
+    tiled.placeholder = std::make_shared<Texture>(frame->video_params());
+    tiled.frame = frame;
+    tiled_frames_.insert(tiled.placeholder.get(), tiled);
+
+    return QVariant::fromValue(tiled.placeholder);
+  }
+
+  TexturePtr texture = render_ctx_->CreateTexture(frame->video_params(),
+                                                  frame->data(),
+                                                  frame->linesize_pixels());
 
   return QVariant::fromValue(texture);
 }
 
+bool RenderProcessor::GetPrerenderedTable(const Node *n, const QString &output, const TimeRange &range, NodeValueTable *table)
+{
+  // Footage is a viewer too, but is cached separately
+  const ViewerOutput* nested = dynamic_cast<const ViewerOutput*>(n);
+  if (!nested || dynamic_cast<const Footage*>(n)
+      || prewarm_
+      || tiled_
+      || !CanCacheFrames()
+      || Track::Reference::TypeFromString(output) != Track::kVideo) {
+    return false;
+  }
+
+  // Cached frames are preview renders, which online renders can't use
+  if (static_cast<RenderMode::Mode>(ticket_->property("mode").toInt()) != RenderMode::kOffline) {
+    return false;
+  }
+
+  NodeOutput texture_output = nested->GetConnectedOutput(ViewerOutput::kTextureInput);
+  if (!texture_output.IsValid()) {
+    return false;
+  }
+
+  // Only matches what the nested viewer cached if we're rendering at the same size and format
+  QByteArray hash = RenderManager::Hash(texture_output, GetCacheVideoParams(), range.in());
+
+  TexturePtr texture;
+  if (texture_cache_) {
+    texture = texture_cache_->Get(hash);
+  }
+
+  QString cache_dir;
+  if (!texture) {
+    cache_dir = const_cast<ViewerOutput*>(nested)->video_frame_cache()->GetCacheDirectory();
+
+    if (!FrameHashCache::CacheFrameExists(cache_dir, hash)) {
+      return false;
+    }
+  }
+
+  if (collecting_footage_) {
+    // Nothing behind the nested sequence will be decoded
+    return true;
+  }
+
+  if (!texture) {
+    FramePtr frame = FrameHashCache::LoadCacheFrame(cache_dir, hash);
+    if (!frame) {
+      return false;
+    }
+
+    texture = render_ctx_->CreateTexture(frame->video_params(), frame->data(), frame->linesize_pixels());
+
+    if (texture_cache_) {
+      texture_cache_->Insert(hash, texture);
+    }
+  }
+
+  table->Push(NodeValue::kTexture, QVariant::fromValue(texture), n);
+  return true;
+}
+
 bool RenderProcessor::CanCacheFrames()
 {
-  return ticket_->property("type").value<RenderManager::TicketType>() == RenderManager::kTypeVideo;
+  RenderManager::TicketType type = ticket_->property("type").value<RenderManager::TicketType>();
+  return type == RenderManager::kTypeVideo || type == RenderManager::kTypeVideoBatch;
 }
 
 QVariant RenderProcessor::GetCachedTexture(const QByteArray& hash)
 {
+  // Cached frames are uploaded whole, which is what a tiled render is avoiding
   QString cache_dir = ticket_->property("cache").toString();
-  if (cache_dir.isEmpty()) {
+  if (cache_dir.isEmpty() || collecting_footage_ || tiled_) {
     return QVariant();
   }
 
@@ -592,23 +1731,735 @@ QVariant RenderProcessor::GetCachedTexture(const QByteArray& hash)
 
 void RenderProcessor::SaveCachedTexture(const QByteArray &hash, const QVariant &tex_var)
 {
-  // FIXME: Temporarily disabled because I don't know how to ensure that the frame saved here is
-  //        not the main frame. If it is, it'll be saved twice which will waste a lot of cycles.
-  //        At least disabled, the frame will still save, and if nothing else alters the hash, it
-  //        will pick up automatically from GetCachedTexture.
-  /*if (!tex_var.isNull()) {
-    QString cache_dir = ticket_->property("cache").toString();
+  TexturePtr texture = tex_var.value<TexturePtr>();
+  if (!texture || texture->IsDummy() || tiled_) {
+    return;
+  }
 
-    if (!cache_dir.isEmpty()) {
-      TexturePtr texture = tex_var.value<TexturePtr>();
-      FramePtr frame = Frame::Create();
-      frame->set_video_params(texture->params());
-      frame->allocate();
-      render_ctx_->DownloadFromTexture(texture.get(), frame->data(), frame->linesize_pixels());
-      FrameHashCache::SaveCacheFrame(cache_dir, hash, frame);
-      qDebug() << "Saved mid-render frame to cache";
+  // The whole frame is saved under this hash once it's finished, no need to save it twice
+  if (hash == frame_hash_) {
+    return;
+  }
+
+  QString cache_dir = ticket_->property("cache").toString();
+  if (cache_dir.isEmpty()) {
+    return;
+  }
+
+  // Caching the node means it's rendered on its own rather than fused into what uses it
+  texture = ResolveDeferredTexture(texture);
+
+  FramePtr frame = Frame::Create();
+  frame->set_video_params(texture->params());
+  frame->allocate();
+  render_ctx_->DownloadFromTexture(texture.get(), frame->data(), frame->linesize_pixels());
+
+  // Loadable from memory straight away, so the next frame can use it before it reaches the disk
+  FrameHashCache::SaveCacheFrameAsync(cache_dir, hash, frame);
+}
+
+VideoParams RenderProcessor::GetIntermediateParams(int channel_count, bool full_precision) const
+{
+  VideoParams params = GetCacheVideoParams();
+
+  params.set_channel_count(channel_count);
+
+  // Previews don't need to be perfect, so halve the bandwidth of float intermediates
+  if (!full_precision
+      && params.format() == VideoParams::kFormatFloat32
+      && static_cast<RenderMode::Mode>(ticket_->property("mode").toInt()) == RenderMode::kOffline) {
+    params.set_format(VideoParams::kFormatFloat16);
+  }
+
+  return params;
+}
+
+bool RenderProcessor::IsTableShareable(const QByteArray &key, const NodeValueTable &table)
+{
+  if (tiled_) {
+    // Nothing is ever rendered whole
+    return false;
+  }
+
+  bool waiting = false;
+
+  for (int i=0; i<table.Count(); i++) {
+    const NodeValue& v = table.at(i);
+
+    if (v.type() != NodeValue::kTexture) {
+      continue;
     }
-  }*/
+
+    auto it = deferred_shaders_.constFind(v.data().value<TexturePtr>().get());
+
+    if (it != deferred_shaders_.constEnd()) {
+      if (it->inlinable) {
+        // Left unrendered so consumers can fuse it, which only means something to this processor
+        return false;
+      }
+
+      waiting = true;
+    }
+  }
+
+  if (waiting) {
+    // Shaders that can't be fused render as they are, so this can be shared once they have
+    pending_shared_tables_.insert(key, table);
+    return false;
+  }
+
+  return true;
+}
+
+bool RenderProcessor::CanInlineIntoShader(const DeferredShader &shader)
+{
+  // Iterative shaders ping-pong between textures and custom vertex shaders may move texture
+  // coordinates, neither of which we can reproduce inside another shader
+  static const QString default_vert_code = ShaderCode().vert_code();
+
+  return shader.job.GetIterationCount() == 1
+      && shader.code.vert_code() == default_vert_code;
+}
+
+bool RenderProcessor::CanDeferShader(const DeferredShader &shader)
+{
+  if (!CanInlineIntoShader(shader)) {
+    return false;
+  }
+
+  // A consumer will sample us at its own texture coordinates, which only matches what we'd have
+  // rendered if we can map those back through our geometry's transform
+  QMatrix4x4 inverse;
+
+  return GetInverseTransform(shader, &inverse);
+}
+
+bool RenderProcessor::GetInverseTransform(const DeferredShader &shader, QMatrix4x4 *inverse)
+{
+  NodeValue value = shader.job.GetValue(QStringLiteral("ove_mvpmat"));
+
+  if (value.type() == NodeValue::kNone) {
+    inverse->setToIdentity();
+    return true;
+  }
+
+  QMatrix4x4 matrix = value.data().value<QMatrix4x4>();
+
+  if (matrix.isIdentity()) {
+    inverse->setToIdentity();
+    return true;
+  }
+
+  // Our quad is flat, so only a transform without perspective maps every output pixel back to
+  // exactly one point on it
+  if (!qFuzzyIsNull(matrix(3, 0)) || !qFuzzyIsNull(matrix(3, 1)) || !qFuzzyCompare(matrix(3, 3), 1.0f)) {
+    return false;
+  }
+
+  // Drop depth, which doesn't affect where anything lands on screen
+  QMatrix4x4 flat(matrix(0, 0), matrix(0, 1), 0.0f, matrix(0, 3),
+                  matrix(1, 0), matrix(1, 1), 0.0f, matrix(1, 3),
+                  0.0f, 0.0f, 1.0f, 0.0f,
+                  0.0f, 0.0f, 0.0f, 1.0f);
+
+  bool invertible;
+  *inverse = flat.inverted(&invertible);
+
+  return invertible;
+}
+
+bool RenderProcessor::InlineDeferredShader(DeferredShader *consumer, const QString &sampler, const DeferredShader &producer, int index, int max_textures)
+{
+  QString consumer_frag = consumer->code.frag_code();
+
+  // We can only inline the producer if the consumer samples it 1:1 at its own texture coordinate
+  QRegularExpression use_regex(QStringLiteral("\\b%1\\b").arg(sampler));
+  QRegularExpression decl_regex(QStringLiteral("^\\s*uniform\\s+sampler2D\\s+%1\\s*;").arg(sampler),
+                                QRegularExpression::MultilineOption);
+  QRegularExpression sample_regex(QStringLiteral("texture2D\\s*\\(\\s*%1\\s*,\\s*ove_texcoord\\s*\\)").arg(sampler));
+
+  int decls = consumer_frag.count(decl_regex);
+  int samples = consumer_frag.count(sample_regex);
+
+  if (decls != 1 || consumer_frag.count(use_regex) != decls + samples) {
+    return false;
+  }
+
+  // Every texture the producer reads gets bound alongside ours, so stop inlining once the hardware
+  // can't bind any more. The producer is rendered on its own instead, chaining passes from there.
+  QRegularExpression texture_decl_regex(QStringLiteral("^\\s*uniform\\s+sampler[23]D\\s+\\w+\\s*;"),
+                                        QRegularExpression::MultilineOption);
+
+  if (consumer_frag.count(texture_decl_regex) - decls + producer.code.frag_code().count(texture_decl_regex) > max_textures) {
+    return false;
+  }
+
+  // Producers that transform their geometry (e.g. a layer that's been moved or scaled) are sampled
+  // by mapping our texture coordinate back onto their quad
+  QMatrix4x4 inverse;
+  if (!GetInverseTransform(producer, &inverse)) {
+    return false;
+  }
+
+  bool transformed = !inverse.isIdentity();
+
+  QString prefix = QStringLiteral("ove_fuse%1_").arg(index);
+  QRegularExpression texcoord_regex(QStringLiteral("^\\s*varying\\s+vec2\\s+ove_texcoord\\s*;"),
+                                    QRegularExpression::MultilineOption);
+
+  // Give everything the producer declares (uniforms, defines, functions and variables) our prefix
+  // so nothing collides with the consumer. Uniforms are renamed in the job values below to match.
+  QString producer_frag = producer.code.frag_code();
+  producer_frag.remove(texcoord_regex);
+
+  QRegularExpression name_regex(QStringLiteral("^\\s*(?:uniform\\s+\\w+|#define|void|bool|int|float|vec[234]|mat[234])\\s+(\\w+)"),
+                                QRegularExpression::MultilineOption);
+  QSet<QString> names;
+  QRegularExpressionMatchIterator name_it = name_regex.globalMatch(producer_frag);
+  while (name_it.hasNext()) {
+    names.insert(name_it.next().captured(1));
+  }
+
+  foreach (const QString& name, names) {
+    producer_frag.replace(QRegularExpression(QStringLiteral("\\b%1\\b").arg(name)), prefix + name);
+  }
+
+  producer_frag.replace(QRegularExpression(QStringLiteral("\\bgl_FragColor\\b")), prefix + QStringLiteral("color"));
+
+  // If the producer would have rendered to an RGB texture, sampling it would have returned opaque
+  bool producer_alpha = (producer.channel_count == VideoParams::kRGBAChannelCount);
+  QString sample_value = producer_alpha
+      ? QStringLiteral("%1color").arg(prefix)
+      : QStringLiteral("vec4(%1color.rgb, 1.0)").arg(prefix);
+
+  QString sample_setup;
+
+  if (transformed) {
+    // The producer runs at the point on its quad that would have been drawn here, and anything off
+    // its quad is left cleared like it would be in its own texture
+    producer_frag.replace(QRegularExpression(QStringLiteral("\\bove_texcoord\\b")), prefix + QStringLiteral("texcoord"));
+    producer_frag.prepend(QStringLiteral("uniform mat4 %1mvpinv;\n"
+                                         "vec2 %1texcoord;\n").arg(prefix));
+
+    sample_setup = QStringLiteral("    vec4 %1position = %1mvpinv * vec4(ove_texcoord * 2.0 - 1.0, 0.0, 1.0);\n"
+                                  "    %1texcoord = (%1position.xy + 1.0) * 0.5;\n"
+                                  "    if (any(lessThan(%1texcoord, vec2(0.0))) || any(greaterThan(%1texcoord, vec2(1.0)))) {\n"
+                                  "        return %2;\n"
+                                  "    }\n").arg(prefix, producer_alpha ? QStringLiteral("vec4(0.0)") : QStringLiteral("vec4(0.0, 0.0, 0.0, 1.0)"));
+
+    consumer->job.InsertValue(prefix + QStringLiteral("mvpinv"), NodeValue(NodeValue::kMatrix, inverse));
+  }
+
+  producer_frag.prepend(QStringLiteral("vec4 %1color;\n").arg(prefix));
+  producer_frag.append(QStringLiteral("\nvec4 %1sample() {\n"
+                                      "%3"
+                                      "    %1color = vec4(0.0);\n"
+                                      "    %1main();\n"
+                                      "    return %2;\n"
+                                      "}\n").arg(prefix, sample_value, sample_setup));
+
+  // Swap the consumer's texture reads for calls to the producer
+  consumer_frag.remove(decl_regex);
+  consumer_frag.remove(QRegularExpression(QStringLiteral("^\\s*uniform\\s+bool\\s+%1_enabled\\s*;").arg(sampler),
+                                          QRegularExpression::MultilineOption));
+  consumer_frag.replace(QRegularExpression(QStringLiteral("\\b%1_enabled\\b").arg(sampler)), QStringLiteral("true"));
+  consumer_frag.replace(sample_regex, QStringLiteral("%1sample()").arg(prefix));
+  consumer_frag.remove(texcoord_regex);
+
+  consumer->code = ShaderCode(QStringLiteral("varying vec2 ove_texcoord;\n\n") + producer_frag + QStringLiteral("\n") + consumer_frag,
+                              consumer->code.vert_code());
+
+  for (auto it=producer.job.GetValues().cbegin(); it!=producer.job.GetValues().cend(); it++) {
+    consumer->job.InsertValue(prefix + it.key(), it.value());
+
+    if (it.value().type() == NodeValue::kTexture) {
+      consumer->job.SetInterpolation(prefix + it.key(), producer.job.GetInterpolation(it.key()));
+    }
+  }
+
+  // Whatever the producer samples around each pixel, we now sample around ours
+  int consumer_footprint = consumer->job.GetSamplingFootprint();
+  int producer_footprint = producer.job.GetSamplingFootprint();
+  if (consumer_footprint == ShaderJob::kFootprintWholeFrame || producer_footprint == ShaderJob::kFootprintWholeFrame) {
+    consumer->job.SetSamplingFootprint(ShaderJob::kFootprintWholeFrame);
+  } else {
+    consumer->job.SetSamplingFootprint(qMax(consumer_footprint, producer_footprint));
+  }
+
+  // The ID fully describes the generated code so fused shaders can be cached like any other
+  consumer->id.append(QStringLiteral("[%1=%2/%3%4]").arg(sampler, producer.id, QString::number(producer.channel_count),
+                                                          transformed ? QStringLiteral("/t") : QString()));
+
+  return true;
+}
+
+QVariant RenderProcessor::GetNativeShader(const QString &id, const ShaderCode &code)
+{
+  QVariant native = shader_cache_->value(id);
+
+  if (native.isNull()) {
+    // Since we have shader code, compile it now
+    native = render_ctx_->CreateNativeShader(code);
+
+    if (native.isNull()) {
+      // Couldn't find or build the shader required
+      qWarning() << "Failed to compile shader" << id;
+      return QVariant();
+    }
+
+    // Another thread may have compiled the same shader in the meantime, use whichever was first
+    bool inserted;
+    QVariant cached = shader_cache_->insertIfMissing(id, native, &inserted);
+
+    if (!inserted) {
+      render_ctx_->DestroyNativeShader(native);
+      native = cached;
+    }
+  }
+
+  return native;
+}
+
+TexturePtr RenderProcessor::RunShader(const DeferredShader &shader, const QRect &region)
+{
+  VideoParams params = GetIntermediateParams(shader.channel_count, shader.job.RequiresFullPrecision());
+  if (!region.isNull()) {
+    params = GetRegionParams(params, region);
+  }
+
+  if (shader.job.HasConstantColor()) {
+    // Clearing is much cheaper than running a shader over every pixel
+    TexturePtr destination = render_ctx_->CreateTexture(params);
+    destination->SetConstantColor(shader.job.GetConstantColor());
+
+    if (!region.isNull()) {
+      destination->set_region(GetNormalizedRegion(region));
+    }
+
+    const Color& c = destination->GetConstantColor();
+    render_ctx_->ClearDestination(destination.get(), c.red(), c.green(), c.blue(), destination->GetConstantColor().alpha());
+
+    return destination;
+  }
+
+  QVariant native;
+
+  if (region.isNull()) {
+    native = GetNativeShader(shader.id, shader.code);
+  } else {
+    native = GetNativeShader(shader.id + QStringLiteral("[tiled]"), GetTiledShaderCode(shader.code));
+  }
+
+  if (native.isNull()) {
+    return nullptr;
+  }
+
+  TexturePtr destination = render_ctx_->CreateTexture(params);
+
+  if (!region.isNull()) {
+    destination->set_region(GetNormalizedRegion(region));
+  }
+
+  // Run shader
+  render_ctx_->BlitToTexture(native, shader.job, destination.get());
+
+  return destination;
+}
+
+ShaderCode RenderProcessor::GetTiledShaderCode(const ShaderCode &code)
+{
+  // Draw the whole frame's quad as usual, then move the part this tile holds into the viewport
+  QString vert_code = code.vert_code();
+  vert_code.replace(QRegularExpression(QStringLiteral("\\bvoid\\s+main\\s*\\(\\s*(?:void\\s*)?\\)")),
+                    QStringLiteral("void ove_untiled_main()"));
+  vert_code.append(QStringLiteral("\n"
+                                  "uniform mat4 ove_tilemat;\n"
+                                  "\n"
+                                  "void main() {\n"
+                                  "    ove_untiled_main();\n"
+                                  "    gl_Position = ove_tilemat * gl_Position;\n"
+                                  "}\n"));
+
+  // Texture coordinates are still the frame's, so map each read into the part its texture holds
+  QString frag_code = code.frag_code();
+  QRegularExpression decl_regex(QStringLiteral("^\\s*uniform\\s+sampler2D\\s+(\\w+)\\s*;"),
+                                QRegularExpression::MultilineOption);
+
+  QStringList samplers;
+  QRegularExpressionMatchIterator decl_it = decl_regex.globalMatch(frag_code);
+  while (decl_it.hasNext()) {
+    samplers.append(decl_it.next().captured(1));
+  }
+
+  foreach (const QString& sampler, samplers) {
+    frag_code.replace(QRegularExpression(QStringLiteral("\\btexture2D\\s*\\(\\s*%1\\s*,").arg(sampler)),
+                      QStringLiteral("ove_tiled_%1(").arg(sampler));
+
+    frag_code.replace(QRegularExpression(QStringLiteral("^(\\s*uniform\\s+sampler2D\\s+%1\\s*;)").arg(sampler),
+                                         QRegularExpression::MultilineOption),
+                      QStringLiteral("\\1\n"
+                                     "uniform vec4 ove_tile_%1;\n"
+                                     "vec4 ove_tiled_%1(vec2 coord) {\n"
+                                     "    return texture2D(%1, (coord - ove_tile_%1.xy) / ove_tile_%1.zw);\n"
+                                     "}").arg(sampler));
+  }
+
+  return ShaderCode(frag_code, vert_code);
+}
+
+TexturePtr RenderProcessor::ResolveDeferredTexture(const TexturePtr &texture)
+{
+  if (!texture || !deferred_shaders_.contains(texture.get())) {
+    return texture;
+  }
+
+  QHash<Texture*, int> uses;
+  CountDeferredUses(texture.get(), &uses);
+
+  // Shaders whose textures are going in the value cache have to outlive this render anyway
+  for (auto it=pending_shared_tables_.cbegin(); it!=pending_shared_tables_.cend(); it++) {
+    for (int i=0; i<it.value().Count(); i++) {
+      const NodeValue& v = it.value().at(i);
+      Texture* t = v.data().value<TexturePtr>().get();
+
+      if (v.type() == NodeValue::kTexture && uses.contains(t)) {
+        uses[t]++;
+      }
+    }
+  }
+
+  TexturePtr result = RunDeferredShader(texture.get(), &uses);
+
+  SharePendingTables();
+
+  return result;
+}
+
+void RenderProcessor::CountDeferredUses(Texture *texture, QHash<Texture *, int> *uses) const
+{
+  const DeferredShader& shader = deferred_shaders_.constFind(texture).value();
+
+  (*uses)[texture]++;
+
+  if (uses->value(texture) > 1 || shader.result) {
+    // Either we've already counted this shader's inputs or it won't need them
+    return;
+  }
+
+  for (auto it=shader.job.GetValues().cbegin(); it!=shader.job.GetValues().cend(); it++) {
+    if (it.value().type() == NodeValue::kTexture) {
+      Texture* input = it.value().data().value<TexturePtr>().get();
+
+      if (input && deferred_shaders_.contains(input)) {
+        CountDeferredUses(input, uses);
+      }
+    }
+  }
+}
+
+TexturePtr RenderProcessor::RunDeferredShader(Texture *texture, QHash<Texture *, int> *uses)
+{
+  auto recorded = deferred_shaders_.constFind(texture);
+
+  // Several consumers may need the same deferred shader, so only render it once
+  if (recorded->result) {
+    return recorded->result;
+  }
+
+  // Swap placeholders for rendered textures in a copy, so the recorded job can be run again if a
+  // later render needs it after we've released it
+  DeferredShader shader = recorded.value();
+  const NodeValueMap values = shader.job.GetValues();
+  QVector<Texture*> inputs;
+
+  for (auto it=values.cbegin(); it!=values.cend(); it++) {
+    const NodeValue& v = it.value();
+
+    if (v.type() != NodeValue::kTexture) {
+      continue;
+    }
+
+    TexturePtr input = v.data().value<TexturePtr>();
+
+    if (input && deferred_shaders_.contains(input.get())) {
+      shader.job.InsertValue(it.key(), NodeValue(v.type(), QVariant::fromValue(RunDeferredShader(input.get(), uses)), v.source(), v.array(), v.tag()));
+      inputs.append(input.get());
+    }
+  }
+
+  TexturePtr result = RunShader(shader);
+  deferred_shaders_[texture].result = result;
+
+  // Now that we've sampled our inputs, any that nothing else needs can go back to the pool
+  shader = DeferredShader();
+
+  foreach (Texture* input, inputs) {
+    int& remaining = (*uses)[input];
+    remaining--;
+
+    if (remaining == 0) {
+      deferred_shaders_[input].result = nullptr;
+    }
+  }
+
+  return result;
+}
+
+void RenderProcessor::SharePendingTables()
+{
+  for (auto it=pending_shared_tables_.cbegin(); it!=pending_shared_tables_.cend(); it++) {
+    NodeValueTable table;
+    bool rendered = true;
+
+    for (int i=0; i<it.value().Count() && rendered; i++) {
+      const NodeValue& v = it.value().at(i);
+      auto deferred = deferred_shaders_.constFind(v.data().value<TexturePtr>().get());
+
+      if (v.type() != NodeValue::kTexture || deferred == deferred_shaders_.constEnd()) {
+        table.Push(v);
+      } else if (deferred->result) {
+        table.Push(v.type(), QVariant::fromValue(deferred->result), v.source(), v.array(), v.tag());
+      } else {
+        // Wasn't needed by this frame, so there's nothing to share
+        rendered = false;
+      }
+    }
+
+    if (rendered) {
+      ShareTable(it.key(), table);
+    }
+  }
+
+  pending_shared_tables_.clear();
+}
+
+TexturePtr RenderProcessor::ResolveRegion(const TexturePtr &texture, const QRect &rect)
+{
+  if (!texture || (!deferred_shaders_.contains(texture.get()) && !tiled_frames_.contains(texture.get()))) {
+    return texture;
+  }
+
+  QVector<Texture*> order;
+  QHash<Texture*, int> uses;
+  SortRegionDependencies(texture.get(), &order, &uses);
+
+  // Work out how much of each texture is needed from the output down, so every consumer has added
+  // what it needs of a texture before that texture's own inputs are worked out
+  QHash<Texture*, QRect> regions;
+  regions.insert(texture.get(), rect);
+
+  for (int i=order.size()-1; i>=0; i--) {
+    Texture* t = order.at(i);
+    auto deferred = deferred_shaders_.constFind(t);
+
+    if (deferred == deferred_shaders_.constEnd() || deferred->result) {
+      continue;
+    }
+
+    QRect region = GetRenderRegion(deferred.value(), regions.value(t));
+    regions.insert(t, region);
+
+    for (auto it=deferred->job.GetValues().cbegin(); it!=deferred->job.GetValues().cend(); it++) {
+      Texture* input = it.value().data().value<TexturePtr>().get();
+
+      if (it.value().type() == NodeValue::kTexture && uses.contains(input)) {
+        regions[input] |= GetInputRegion(deferred.value(), it.key(), region);
+      }
+    }
+  }
+
+  // Render them inputs first, releasing each as soon as its last consumer has run
+  QHash<Texture*, TexturePtr> results;
+
+  foreach (Texture* t, order) {
+    QRect region = regions.value(t);
+    if (region.isEmpty()) {
+      // Only ever sampled outside the frame, so any pixel will do
+      region = QRect(0, 0, 1, 1);
+    }
+
+    auto tiled_frame = tiled_frames_.constFind(t);
+    if (tiled_frame != tiled_frames_.constEnd()) {
+      const FramePtr& frame = tiled_frame->frame;
+      const char* region_data = frame->const_data() + region.y() * frame->linesize_bytes() + region.x() * frame->video_params().GetBytesPerPixel();
+
+      TexturePtr upload = render_ctx_->CreateTexture(GetRegionParams(frame->video_params(), region), region_data, frame->linesize_pixels());
+      upload->set_region(GetNormalizedRegion(region));
+      results.insert(t, upload);
+      continue;
+    }
+
+    const DeferredShader& recorded = deferred_shaders_.constFind(t).value();
+
+    if (recorded.result) {
+      // Already rendered whole
+      results.insert(t, recorded.result);
+      continue;
+    }
+
+    DeferredShader shader = recorded;
+    const NodeValueMap values = shader.job.GetValues();
+    QVector<Texture*> inputs;
+
+    for (auto it=values.cbegin(); it!=values.cend(); it++) {
+      const NodeValue& v = it.value();
+      Texture* input = v.data().value<TexturePtr>().get();
+
+      if (v.type() == NodeValue::kTexture && results.contains(input)) {
+        shader.job.InsertValue(it.key(), NodeValue(v.type(), QVariant::fromValue(results.value(input)), v.source(), v.array(), v.tag()));
+        inputs.append(input);
+      }
+    }
+
+    results.insert(t, RunShader(shader, region));
+
+    foreach (Texture* input, inputs) {
+      int& remaining = uses[input];
+      remaining--;
+
+      if (remaining == 0) {
+        results.remove(input);
+      }
+    }
+  }
+
+  return results.value(texture.get());
+}
+
+void RenderProcessor::SortRegionDependencies(Texture *texture, QVector<Texture *> *order, QHash<Texture *, int> *uses) const
+{
+  (*uses)[texture]++;
+
+  if (uses->value(texture) > 1) {
+    // Already sorted
+    return;
+  }
+
+  auto deferred = deferred_shaders_.constFind(texture);
+
+  if (deferred != deferred_shaders_.constEnd() && !deferred->result) {
+    for (auto it=deferred->job.GetValues().cbegin(); it!=deferred->job.GetValues().cend(); it++) {
+      if (it.value().type() != NodeValue::kTexture) {
+        continue;
+      }
+
+      Texture* input = it.value().data().value<TexturePtr>().get();
+
+      if (input && (deferred_shaders_.contains(input) || tiled_frames_.contains(input))) {
+        SortRegionDependencies(input, order, uses);
+      }
+    }
+  }
+
+  order->append(texture);
+}
+
+QRect RenderProcessor::GetRenderRegion(const DeferredShader &shader, const QRect &needed) const
+{
+  const ShaderJob& job = shader.job;
+
+  if (job.GetIterationCount() > 1 && !job.GetIterativeInput().isEmpty()) {
+    // Every iteration but the last also renders whatever the iterations after it sample
+    if (job.GetSamplingFootprint() == ShaderJob::kFootprintWholeFrame) {
+      return GetFrameRegion();
+    }
+
+    int reach = GetEffectiveFootprint(job.GetSamplingFootprint());
+
+    return needed.adjusted(-reach, -reach, reach, reach) & GetFrameRegion();
+  }
+
+  return needed;
+}
+
+QRect RenderProcessor::GetInputRegion(const DeferredShader &shader, const QString &input, const QRect &region) const
+{
+  QMatrix4x4 inverse;
+
+  if (shader.job.GetSamplingFootprint() == ShaderJob::kFootprintWholeFrame
+      || !GetInverseTransform(shader, &inverse)) {
+    return GetFrameRegion();
+  }
+
+  // Our texture coordinates are on our quad, wherever it's been moved to
+  QRectF area = MapRegion(inverse, GetNormalizedRegion(region));
+
+  // Textures of fused producers are named with each producer's prefix in turn, and sampled through
+  // each producer's transform in the same order
+  QRegularExpression prefix_regex(QStringLiteral("^ove_fuse\\d+_"));
+  QString prefix;
+  QRegularExpressionMatch match;
+
+  while ((match = prefix_regex.match(input.mid(prefix.size()))).hasMatch()) {
+    prefix.append(match.captured());
+
+    NodeValue producer_inverse = shader.job.GetValue(prefix + QStringLiteral("mvpinv"));
+    if (producer_inverse.type() == NodeValue::kMatrix) {
+      area = MapRegion(producer_inverse.data().value<QMatrix4x4>(), area);
+    }
+  }
+
+  // Filtering reads one pixel further than the footprint
+  int reach = GetEffectiveFootprint(shader.job.GetSamplingFootprint()) + 1;
+
+  return GetPixelRegion(area).adjusted(-reach, -reach, reach, reach) & GetFrameRegion();
+}
+
+int RenderProcessor::GetEffectiveFootprint(int footprint) const
+{
+  return qCeil(double(footprint) / double(GetCacheVideoParams().divider()));
+}
+
+QRect RenderProcessor::GetFrameRegion() const
+{
+  return QRect(0, 0, GetCacheVideoParams().effective_width(), GetCacheVideoParams().effective_height());
+}
+
+QRectF RenderProcessor::GetNormalizedRegion(const QRect &rect) const
+{
+  double width = GetCacheVideoParams().effective_width();
+  double height = GetCacheVideoParams().effective_height();
+
+  return QRectF(rect.x() / width, rect.y() / height, rect.width() / width, rect.height() / height);
+}
+
+QRect RenderProcessor::GetPixelRegion(const QRectF &region) const
+{
+  double width = GetCacheVideoParams().effective_width();
+  double height = GetCacheVideoParams().effective_height();
+
+  return QRectF(region.x() * width, region.y() * height, region.width() * width, region.height() * height).toAlignedRect();
+}
+
+QRectF RenderProcessor::MapRegion(const QMatrix4x4 &matrix, const QRectF &region)
+{
+  QPointF corners[] = {region.topLeft(), region.topRight(), region.bottomLeft(), region.bottomRight()};
+  QPointF top_left, bottom_right;
+
+  for (int i=0; i<4; i++) {
+    // Texture coordinates are 0-1, the matrix works in NDC
+    QPointF mapped = matrix.map(corners[i] * 2.0 - QPointF(1.0, 1.0));
+    mapped = (mapped + QPointF(1.0, 1.0)) * 0.5;
+
+    if (i == 0) {
+      top_left = bottom_right = mapped;
+    } else {
+      top_left = QPointF(qMin(top_left.x(), mapped.x()), qMin(top_left.y(), mapped.y()));
+      bottom_right = QPointF(qMax(bottom_right.x(), mapped.x()), qMax(bottom_right.y(), mapped.y()));
+    }
+  }
+
+  return QRectF(top_left, bottom_right);
+}
+
+VideoParams RenderProcessor::GetRegionParams(VideoParams params, const QRect &region)
+{
+  // Sized in the frame's own pixels, whatever its divider
+  params.set_divider(1);
+  params.set_width(region.width());
+  params.set_height(region.height());
+
+  return params;
 }
 
 }
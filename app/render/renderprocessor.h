@@ -21,8 +21,13 @@
 #ifndef RENDERPROCESSOR_H
 #define RENDERPROCESSOR_H
 
+#include <QThreadPool>
+
 #include "node/traverser.h"
 #include "render/renderer.h"
+#include "render/rendermanager.h"
+#include "frametexturecache.h"
+#include "interlacedframecache.h"
 #include "rendercache.h"
 #include "stillimagecache.h"
 #include "threading/threadticket.h"
@@ -32,7 +37,7 @@ namespace olive {
 class RenderProcessor : public NodeTraverser
 {
 public:
-  static void Process(RenderTicketPtr ticket, Renderer* render_ctx, StillImageCache* still_image_cache, DecoderCache* decoder_cache, ShaderCache* shader_cache, QVariant default_shader);
+  static void Process(RenderTicketPtr ticket, Renderer* render_ctx, StillImageCache* still_image_cache, FrameTextureCache* texture_cache, InterlacedFrameCache* interlaced_cache, NodeValueCache* value_cache, DecoderCache* decoder_cache, ShaderCache* shader_cache, QVariant default_shader);
 
   struct RenderedWaveform {
     const Track* track;
@@ -59,16 +64,314 @@ protected:
 
   virtual void SaveCachedTexture(const QByteArray& hash, const QVariant& texture) override;
 
+  virtual bool IsTableShareable(const QByteArray& key, const NodeValueTable& table) override;
+
+  /**
+   * @brief Use a nested sequence's own cached frame instead of traversing it
+   *
+   * A sequence used as a clip renders exactly what it renders in its own viewer whenever its
+   * texture output has the same hash at these video parameters, so a frame already in the GPU
+   * frame cache or the nested sequence's disk cache can stand in for its whole graph.
+   */
+  virtual bool GetPrerenderedTable(const Node* n, const QString& output, const TimeRange& range, NodeValueTable* table) override;
+
 private:
-  RenderProcessor(RenderTicketPtr ticket, Renderer* render_ctx, StillImageCache* still_image_cache, DecoderCache* decoder_cache, ShaderCache* shader_cache, QVariant default_shader);
+  RenderProcessor(RenderTicketPtr ticket, Renderer* render_ctx, StillImageCache* still_image_cache, FrameTextureCache* texture_cache, InterlacedFrameCache* interlaced_cache, NodeValueCache* value_cache, DecoderCache* decoder_cache, ShaderCache* shader_cache, QVariant default_shader);
 
   TexturePtr GenerateTexture(const rational& time, const rational& frame_length);
 
+  /**
+   * @brief Render `range` of `output` in consecutive blocks of `block_size` samples
+   *
+   * Intermediate buffers come from this thread's SampleBufferPool, so once the first block has
+   * been rendered the rest re-use its buffers rather than allocating. Returns a table containing
+   * the joined samples as kSamples.
+   */
+  NodeValueTable GenerateAudioInBlocks(const NodeOutput& output, const TimeRange& range, int block_size);
+
+  /**
+   * @brief Render the sequence's audio tracks for each of `blocks` in parallel
+   *
+   * Tracks don't depend on each other until they're mixed, so each one (and, if there are fewer
+   * tracks than threads, each run of blocks within it) is rendered by its own processor on the
+   * audio pool. The real traversal then only has to mix them, picking each track's table up in
+   * GenerateBlockTable().
+   */
+  void PrerenderAudioTracks(const QVector<TimeRange>& blocks);
+
+  /**
+   * @brief Render `track` over each of `blocks` with a processor of its own, safe to call from any thread
+   */
+  QVector<NodeValueTable> RenderAudioTrack(RenderTicketPtr ticket, const Track* track, const QVector<TimeRange>& blocks);
+
+  static QThreadPool* GetAudioThreadPool();
+
+  /**
+   * @brief Download `texture` with the ticket's output settings
+   */
   FramePtr GenerateFrame(TexturePtr texture, const rational &time);
 
+  FramePtr GenerateFrame(TexturePtr texture, const rational &time, const RenderManager::FrameOutput& output);
+
+  /**
+   * @brief The ticket's own output settings, as used by GenerateFrame()
+   */
+  RenderManager::FrameOutput GetTicketFrameOutput() const;
+
+  /**
+   * @brief Whether the frame should be rendered in tiles rather than in one piece
+   *
+   * Frames are tiled if either side is larger than the GPU's textures can be, or if even a few of
+   * their intermediate textures would go over the texture pool's budget. Tiles are assembled
+   * straight into the frames they're downloaded to, so this is only ever the case if every one of
+   * `outputs` is exactly the frame being rendered.
+   */
+  bool ShouldRenderTiled(const RenderManager::FrameOutputList& outputs) const;
+
+  /**
+   * @brief Render and download `texture` a tile at a time into a frame for each of `outputs`
+   *
+   * Only the part of the graph each tile depends on is rendered for it (see ResolveRegion()), so
+   * neither the GPU's texture size nor the pool's budget bound the size of the frame. Frames are
+   * always downloaded as RGB(A).
+   */
+  QVector<FramePtr> GenerateTiledFrames(const TexturePtr& texture, const rational& time, const RenderManager::FrameOutputList& outputs);
+
+  /**
+   * @brief Render the video frame at `time` using the ticket's settings, returning either a
+   * TexturePtr or a FramePtr depending on whether the ticket asked for textures only
+   */
+  QVariant RenderVideoFrame(const rational& time, const QByteArray& hash);
+
   void Run();
 
-  DecoderPtr ResolveDecoderFromInput(const QString &decoder_id, const Decoder::CodecStream& stream);
+  DecoderPtr ResolveDecoderFromInput(const QString &decoder_id, const Decoder::CodecStream& stream, const rational& time);
+
+  void ReleaseDecoder(const Decoder::CodecStream& stream, DecoderPtr decoder);
+
+  /**
+   * @brief A footage frame to decode, with everything that needs the ticket or config resolved
+   * so the decode itself can run on any thread
+   */
+  struct FootageDecode {
+    QString decoder_id;
+
+    // For video, the stream to get a cached decoder for. Otherwise the file to open.
+    Decoder::CodecStream stream;
+    bool use_decoder_cache;
+
+    rational time;
+    Decoder::RetrieveVideoParams params;
+
+    // Image sequence files to start reading ahead of this one
+    QStringList prefetch;
+
+    FramePtr frame;
+
+    bool IsSameFrame(const FootageDecode& rhs) const
+    {
+      return decoder_id == rhs.decoder_id && stream == rhs.stream && time == rhs.time
+          && params == rhs.params && params.keyframes_only == rhs.params.keyframes_only;
+    }
+  };
+
+  FootageDecode PrepareFootageDecode(const FootageJob &stream, const Decoder::CodecStream& codec_stream, const QString &decoder_id, int divider, const rational& input_time, bool keyframes_only) const;
+
+  /**
+   * @brief Decode a prepared frame, safe to call from any thread
+   */
+  FramePtr DecodeFootage(FootageDecode decode);
+
+  /**
+   * @brief Decode every footage frame `output` needs over `range` at once
+   *
+   * Traverses the graph without rendering anything to find the footage frames it uses, then
+   * decodes them all in parallel, so independent branches (e.g. layered tracks or merges) don't
+   * wait on each other's decodes. The real traversal picks them up with TakePredecodedFrame().
+   */
+  void PredecodeFootage(const NodeOutput& output, const TimeRange& range);
+
+  /**
+   * @brief Add a frame for PredecodeFootage() to decode, unless it's already been added
+   */
+  void QueuePredecode(const FootageDecode& decode);
+
+  FramePtr TakePredecodedFrame(const FootageDecode& decode);
+
+  static QThreadPool* GetDecodeThreadPool();
+
+  /**
+   * @brief Whether interlaced footage should be decoded woven and deinterlaced by DeinterlaceFootage()
+   */
+  static bool CanDeinterlaceOnGPU(const VideoParams& stream_data);
+
+  /**
+   * @brief Upload a decoded frame and convert it to the reference color space
+   */
+  TexturePtr UploadFootageFrame(FramePtr frame, const VideoParams& stream_data, ColorManager* color_manager, const QString& colorspace);
+
+  /**
+   * @brief Deinterlace the field showing at `input_time` with the GPU's temporal deinterlacer
+   *
+   * The frames either side are needed too, and come from the InterlacedFrameCache wherever
+   * possible, so playback only decodes each frame once.
+   */
+  TexturePtr DeinterlaceFootage(const FootageJob &stream, const Decoder::CodecStream& codec_stream, const QString &decoder_id, int divider, const rational& input_time);
+
+  /**
+   * @brief A shader job that hasn't been rendered yet
+   *
+   * ProcessShader() only records jobs, handing out a placeholder texture for each. If the job is
+   * `inlinable` and its consumer only ever samples it at its own texture coordinate, both are
+   * compiled into a single fragment shader and the intermediate texture is never rendered.
+   * Otherwise, the placeholder stays in the consumer's job as an edge to this one, and the whole
+   * graph is rendered at the end by ResolveDeferredTexture().
+   */
+  struct DeferredShader {
+    QString id;
+    ShaderCode code;
+    ShaderJob job;
+    int channel_count;
+    bool inlinable;
+    TexturePtr placeholder;
+    TexturePtr result;
+  };
+
+  static bool CanDeferShader(const DeferredShader& shader);
+
+  static bool CanInlineIntoShader(const DeferredShader& shader);
+
+  /**
+   * @brief Get the transform from output texture coordinates back to the shader's own quad
+   *
+   * Returns FALSE if the shader's geometry is transformed in a way that can't be mapped back per
+   * pixel (e.g. with perspective).
+   */
+  static bool GetInverseTransform(const DeferredShader& shader, QMatrix4x4* inverse);
+
+  /**
+   * @brief Compile `producer` into `consumer` in place of sampling its texture
+   *
+   * Chains of producers, such as every layer of a stack of merged tracks along with their
+   * transforms, end up as one shader pass this way. Returns FALSE if the consumer doesn't sample
+   * the producer 1:1, or if the fused shader would need more than `max_textures` textures.
+   */
+  static bool InlineDeferredShader(DeferredShader* consumer, const QString& sampler, const DeferredShader& producer, int index, int max_textures);
+
+  /**
+   * @brief Parameters for textures that only live within this render
+   *
+   * Half-float is used for offline renders of float sequences unless `full_precision` is set. The
+   * final frame is still produced in the ticket's format.
+   */
+  VideoParams GetIntermediateParams(int channel_count, bool full_precision) const;
+
+  /**
+   * @brief Get `code` compiled from the shader cache, compiling it if nothing has yet
+   */
+  QVariant GetNativeShader(const QString& id, const ShaderCode& code);
+
+  /**
+   * @brief Run `shader`, over the whole frame or only `region` of it
+   *
+   * If `region` is set, the texture returned only holds that part of the frame (see
+   * Texture::region()) and the shader is run through GetTiledShaderCode().
+   */
+  TexturePtr RunShader(const DeferredShader& shader, const QRect& region = QRect());
+
+  /**
+   * @brief Rewrite `code` to render part of the frame into a texture that only holds that part
+   *
+   * The vertex shader still draws the whole frame's quad, which is then moved by `ove_tilemat` so
+   * the part the destination holds fills the viewport. Every 2D texture read in the fragment shader
+   * is mapped through `ove_tile_<sampler>` into the part of the frame that texture holds. Both are
+   * set by the renderer from each texture's region.
+   */
+  static ShaderCode GetTiledShaderCode(const ShaderCode& code);
+
+  /**
+   * @brief Render as much of the deferred shader graph `texture` depends on as `rect` needs
+   *
+   * `rect` is in the frame's pixels. Going from the output down, each shader is rendered only as
+   * large as its consumers need, which is as far as they sample around each pixel (see
+   * ShaderJob::GetSamplingFootprint()) mapped back through any transforms, so a tile never needs
+   * textures much larger than itself. The texture returned holds at least `rect`, its region()
+   * tells exactly what it holds.
+   */
+  TexturePtr ResolveRegion(const TexturePtr& texture, const QRect& rect);
+
+  /**
+   * @brief Order everything `texture` depends on in a tiled render so each comes after its inputs,
+   * counting how many passes sample each one
+   */
+  void SortRegionDependencies(Texture* texture, QVector<Texture*>* order, QHash<Texture*, int>* uses) const;
+
+  /**
+   * @brief Get how much of the frame `shader` has to render for its consumers to have `needed`
+   */
+  QRect GetRenderRegion(const DeferredShader& shader, const QRect& needed) const;
+
+  /**
+   * @brief Get how much of the texture `shader` samples as `input` is needed to render `region`
+   */
+  QRect GetInputRegion(const DeferredShader& shader, const QString& input, const QRect& region) const;
+
+  /**
+   * @brief Convert a sampling footprint from sequence pixels to the frame's pixels
+   */
+  int GetEffectiveFootprint(int footprint) const;
+
+  /**
+   * @brief The whole frame in its own pixels
+   */
+  QRect GetFrameRegion() const;
+
+  QRectF GetNormalizedRegion(const QRect& rect) const;
+
+  /**
+   * @brief Get the frame's pixels that normalized `region` touches, without clipping to the frame
+   */
+  QRect GetPixelRegion(const QRectF& region) const;
+
+  /**
+   * @brief Get the bounds of normalized `region` once mapped through `matrix` in NDC
+   */
+  static QRectF MapRegion(const QMatrix4x4& matrix, const QRectF& region);
+
+  /**
+   * @brief Parameters for a texture that only holds `region` of the frame
+   */
+  static VideoParams GetRegionParams(VideoParams params, const QRect& region);
+
+  /**
+   * @brief Render the deferred shader graph `texture` depends on
+   *
+   * Only the shaders `texture` actually needs are run, each after everything it samples. Every
+   * intermediate texture is released as soon as its last consumer has run, so the renderer's pool
+   * can hand its memory to a later pass and a deep graph never holds more than one branch's worth
+   * of textures at once.
+   */
+  TexturePtr ResolveDeferredTexture(const TexturePtr& texture);
+
+  /**
+   * @brief Count how many passes sample each deferred shader `texture` depends on, itself included
+   */
+  void CountDeferredUses(Texture* texture, QHash<Texture*, int>* uses) const;
+
+  TexturePtr RunDeferredShader(Texture* texture, QHash<Texture*, int>* uses);
+
+  /**
+   * @brief Put tables that were waiting on deferred shaders in the shared value cache
+   */
+  void SharePendingTables();
+
+  static const int kMaximumDecodersPerStream;
+
+  static const rational kDecoderAffinityRange;
+
+  static const int kTileSize;
+
+  static const int kTiledIntermediateCount;
 
   RenderTicketPtr ticket_;
 
@@ -76,12 +379,56 @@ private:
 
   StillImageCache* still_image_cache_;
 
+  FrameTextureCache* texture_cache_;
+
+  InterlacedFrameCache* interlaced_cache_;
+
+  NodeValueCache* value_cache_;
+
   DecoderCache* decoder_cache_;
 
   ShaderCache* shader_cache_;
 
   QVariant default_shader_;
 
+  QHash<Texture*, DeferredShader> deferred_shaders_;
+
+  // Tables that can be shared once the deferred shaders they reference have been rendered
+  QHash<QByteArray, NodeValueTable> pending_shared_tables_;
+
+  // Hash of the frame being rendered, which is saved as a whole rather than by its node
+  QByteArray frame_hash_;
+
+  // Set for kTypeVideoPrewarm tickets, which only open and seek decoders
+  bool prewarm_;
+
+  // Set while PredecodeFootage() is traversing, which only collects footage frames
+  bool collecting_footage_;
+
+  QVector<FootageDecode> predecoded_;
+
+  // Audio track tables rendered by PrerenderAudioTracks(), waiting to be mixed
+  QHash<const Track*, QHash<TimeRange, NodeValueTable> > prerendered_tracks_;
+
+  // Sequence time of the frame currently being rendered
+  rational playback_time_;
+
+  // Set while a frame is rendered in tiles, when shaders are only ever run over part of the frame
+  bool tiled_;
+
+  /**
+   * @brief A frame generated on the CPU during a tiled render
+   *
+   * It's uploaded a tile at a time by ResolveRegion() rather than in one piece, and stands in the
+   * graph as `placeholder` until then.
+   */
+  struct TiledFrame {
+    TexturePtr placeholder;
+    FramePtr frame;
+  };
+
+  QHash<Texture*, TiledFrame> tiled_frames_;
+
 };
 
 }
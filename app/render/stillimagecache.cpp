@@ -0,0 +1,153 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "stillimagecache.h"
+
+#include "common/metrics.h"
+#include "render/frametexturecache.h"
+
+namespace olive {
+
+namespace {
+
+struct StillImageCacheMetrics {
+  Metric* bytes = MetricsRegistry::Gauge(QStringLiteral("olive_still_image_cache_bytes"),
+                                         QStringLiteral("VRAM used by decoded footage frames kept for reuse"));
+
+  Metric* entries = MetricsRegistry::Gauge(QStringLiteral("olive_still_image_cache_frames"),
+                                           QStringLiteral("Decoded footage frames kept on the GPU for reuse"));
+};
+
+StillImageCacheMetrics* GetMetrics()
+{
+  static StillImageCacheMetrics metrics;
+  return &metrics;
+}
+
+}
+
+uint qHash(const StillImageCache::Key &k, uint seed)
+{
+  return qHash(k.stream, seed) ^ qHash(k.colorspace, seed) ^ qHash(k.time, seed)
+      ^ ::qHash(k.divider, seed) ^ ::qHash(k.alpha_is_associated, seed);
+}
+
+StillImageCache::StillImageCache() :
+  current_size_(0),
+  maximum_size_(0)
+{
+}
+
+StillImageCache::EntryPtr StillImageCache::Find(EntryPtr want)
+{
+  auto it = index_.find(GetKey(want.get()));
+  if (it == index_.end()) {
+    return nullptr;
+  }
+
+  // Move to front since it was just used
+  entries_.splice(entries_.begin(), entries_, it.value());
+
+  return entries_.front();
+}
+
+void StillImageCache::PushEntry(EntryPtr e)
+{
+  entries_.push_front(e);
+  index_.insert(GetKey(e.get()), entries_.begin());
+
+  PublishMetrics();
+}
+
+void StillImageCache::SetEntryTexture(EntryPtr e, TexturePtr texture)
+{
+  QMutexLocker locker(&mutex_);
+
+  e->texture = texture;
+  e->working = false;
+
+  EntryList evicted;
+
+  auto it = index_.find(GetKey(e.get()));
+  if (it != index_.end() && *it.value() == e) {
+    if (texture) {
+      e->size = FrameTextureCache::GetTextureSize(texture.get());
+      current_size_ += e->size;
+      evicted = EvictToFit();
+    } else {
+      entries_.erase(it.value());
+      index_.erase(it);
+    }
+  }
+
+  PublishMetrics();
+
+  wait_cond_.wakeAll();
+
+  // Textures are destroyed once the lock is released, since freeing them may have to wait on the
+  // render thread
+  locker.unlock();
+}
+
+void StillImageCache::SetMaximumSize(qint64 bytes)
+{
+  QMutexLocker locker(&mutex_);
+
+  maximum_size_ = bytes;
+
+  EntryList evicted = EvictToFit();
+  PublishMetrics();
+  locker.unlock();
+}
+
+StillImageCache::Key StillImageCache::GetKey(const Entry *e)
+{
+  return {e->stream, e->colorspace, e->alpha_is_associated, e->divider, e->time};
+}
+
+StillImageCache::EntryList StillImageCache::EvictToFit()
+{
+  EntryList evicted;
+
+  // Working entries have no texture yet and other threads are waiting on them, so skip over those
+  auto it = entries_.end();
+  while (current_size_ > maximum_size_ && it != entries_.begin()) {
+    auto e = std::prev(it);
+
+    if ((*e)->working) {
+      it = e;
+      continue;
+    }
+
+    current_size_ -= (*e)->size;
+    index_.remove(GetKey(e->get()));
+    evicted.splice(evicted.end(), entries_, e);
+  }
+
+  return evicted;
+}
+
+void StillImageCache::PublishMetrics()
+{
+  GetMetrics()->bytes->Set(current_size_);
+  GetMetrics()->entries->Set(qint64(entries_.size()));
+}
+
+}
@@ -1,16 +1,27 @@
 #ifndef STILLIMAGECACHE_H
 #define STILLIMAGECACHE_H
 
+#include <list>
 #include <QHash>
+#include <QMutex>
 #include <QWaitCondition>
 
 #include "codec/decoder.h"
 #include "common/rational.h"
-#include "node/project/footage/footage.h"
 #include "render/texture.h"
 
 namespace olive {
 
+/**
+ * @brief Decoded and color managed footage frames kept on the GPU for reuse
+ *
+ * Shared by every render thread. Entries are looked up by hash and evicted least recently used
+ * first once their textures exceed the VRAM budget, so a timeline that cycles through many stills
+ * only decodes each one once as long as they fit.
+ *
+ * While a frame is being decoded its entry is marked `working`. Other threads that want the same
+ * frame wait on wait_cond() rather than decoding it again.
+ */
 class StillImageCache
 {
 public:
@@ -24,6 +35,7 @@ public:
       divider = d;
       time = i;
       working = w;
+      size = 0;
     }
 
     TexturePtr texture;
@@ -33,10 +45,13 @@ public:
     int divider;
     rational time;
     bool working;
+    qint64 size;
   };
 
   using EntryPtr = std::shared_ptr<Entry>;
 
+  StillImageCache();
+
   QMutex* mutex()
   {
     return &mutex_;
@@ -47,35 +62,76 @@ public:
     return &wait_cond_;
   }
 
-  const QVector<EntryPtr>& entries() const
-  {
-    return entries_;
-  }
+  /**
+   * @brief Find an entry with the same metadata as `want`, or nullptr if there isn't one
+   *
+   * The returned entry may still be working. Must be called with mutex() locked.
+   */
+  EntryPtr Find(EntryPtr want);
+
+  /**
+   * @brief Add a working entry so other threads wait for it instead of decoding the same frame
+   *
+   * Must be called with mutex() locked. Call SetEntryTexture() once the frame is ready.
+   */
+  void PushEntry(EntryPtr e);
+
+  /**
+   * @brief Finish a working entry and wake any threads waiting for it
+   *
+   * If `texture` is nullptr (e.g. the decode failed), the entry is removed so the next request
+   * tries again. Must be called with mutex() unlocked.
+   */
+  void SetEntryTexture(EntryPtr e, TexturePtr texture);
+
+  /**
+   * @brief Set the VRAM budget in bytes, evicting entries if necessary
+   */
+  void SetMaximumSize(qint64 bytes);
 
-  static bool CompareEntryMetadata(EntryPtr a, EntryPtr b)
-  {
-    return (a->stream == b->stream
-            && a->colorspace == b->colorspace
-            && a->alpha_is_associated == b->alpha_is_associated
-            && a->divider == b->divider
-            && a->time == b->time);
-  }
-
-  void PushEntry(EntryPtr e)
-  {
-    entries_.prepend(e);
+private:
+  struct Key {
+    Decoder::CodecStream stream;
+    QString colorspace;
+    bool alpha_is_associated;
+    int divider;
+    rational time;
 
-    if (entries_.size() > 8) {
-      entries_.removeLast();
+    bool operator==(const Key& rhs) const
+    {
+      return stream == rhs.stream
+          && colorspace == rhs.colorspace
+          && alpha_is_associated == rhs.alpha_is_associated
+          && divider == rhs.divider
+          && time == rhs.time;
     }
-  }
+  };
+
+  friend uint qHash(const Key& k, uint seed);
+
+  static Key GetKey(const Entry* e);
+
+  using EntryList = std::list<EntryPtr>;
+
+  EntryList EvictToFit();
+
+  /**
+   * @brief Update the metrics registry with the current occupancy, must be called with the lock held
+   */
+  void PublishMetrics();
 
-private:
   QMutex mutex_;
 
   QWaitCondition wait_cond_;
 
-  QVector<EntryPtr> entries_;
+  // Most recently used entries are at the front
+  EntryList entries_;
+
+  QHash<Key, EntryList::iterator> index_;
+
+  qint64 current_size_;
+
+  qint64 maximum_size_;
 
 };
 
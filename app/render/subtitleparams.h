@@ -22,9 +22,47 @@
 #define SUBTITLEPARAMS_H
 
 #include <QString>
+#include <QVector>
+
+#include "common/timerange.h"
 
 namespace olive {
 
+/**
+ * @brief A single subtitle cue, its time and text
+ *
+ * A flat value rather than a node so it can be collected, sorted and handed to encoders without
+ * touching the node graph.
+ */
+class SubtitleCue {
+public:
+  SubtitleCue() = default;
+
+  SubtitleCue(const TimeRange& time, const QString& text) :
+    time_(time),
+    text_(text)
+  {
+  }
+
+  const TimeRange& time() const
+  {
+    return time_;
+  }
+
+  const QString& text() const
+  {
+    return text_;
+  }
+
+private:
+  TimeRange time_;
+
+  QString text_;
+
+};
+
+using SubtitleCueList = QVector<SubtitleCue>;
+
 class SubtitleParams {
 public:
   static QString GenerateASSHeader();
@@ -22,7 +22,9 @@
 #define RENDERTEXTURE_H
 
 #include <memory>
+#include <QRectF>
 
+#include "render/color.h"
 #include "render/videoparams.h"
 
 namespace olive {
@@ -51,7 +53,9 @@ public:
   Texture(const VideoParams& param) :
     renderer_(nullptr),
     params_(param),
-    type_(k2D)
+    type_(k2D),
+    constant_(false),
+    region_(0, 0, 1, 1)
   {
   }
 
@@ -62,7 +66,9 @@ public:
     renderer_(renderer),
     params_(param),
     id_(native),
-    type_(type)
+    type_(type),
+    constant_(false),
+    region_(0, 0, 1, 1)
   {
   }
 
@@ -125,6 +131,83 @@ public:
     return renderer_;
   }
 
+  /**
+   * @brief Whether every pixel of this texture is known to be GetConstantColor()
+   *
+   * Nodes can combine constant textures on the CPU rather than sampling them per pixel. RGB
+   * textures always report an opaque color since that's what sampling them would return.
+   */
+  bool IsConstantColor() const
+  {
+    return constant_;
+  }
+
+  const Color& GetConstantColor() const
+  {
+    return constant_color_;
+  }
+
+  enum Coverage {
+    /// Every pixel is fully transparent
+    kCoverageTransparent,
+
+    /// Some pixels may be transparent or translucent
+    kCoveragePartial,
+
+    /// Every pixel is fully opaque
+    kCoverageOpaque
+  };
+
+  /**
+   * @brief What's known about how much of the frame this texture covers
+   *
+   * Textures always span the whole frame, so RGB textures are opaque. Textures with alpha are only
+   * known to be opaque or transparent if they're a constant color.
+   */
+  Coverage GetCoverage() const
+  {
+    if (params_.channel_count() != VideoParams::kRGBAChannelCount) {
+      return kCoverageOpaque;
+    }
+
+    if (constant_) {
+      if (constant_color_.alpha() >= 1.0) {
+        return kCoverageOpaque;
+      } else if (constant_color_.alpha() <= 0.0) {
+        return kCoverageTransparent;
+      }
+    }
+
+    return kCoveragePartial;
+  }
+
+  void SetConstantColor(const Color& c)
+  {
+    constant_ = true;
+    constant_color_ = c;
+
+    if (params_.channel_count() != VideoParams::kRGBAChannelCount) {
+      constant_color_.set_alpha(1.0);
+    }
+  }
+
+  /**
+   * @brief Part of the frame this texture holds, normalized to 0-1 from the top-left
+   *
+   * Textures hold the whole frame unless they were made by a tiled render, where each only holds
+   * as much of the frame as the tile being rendered needs. Tiled shaders map their texture
+   * coordinates through this to sample them (see RenderProcessor).
+   */
+  const QRectF& region() const
+  {
+    return region_;
+  }
+
+  void set_region(const QRectF& r)
+  {
+    region_ = r;
+  }
+
 private:
   Renderer* renderer_;
 
@@ -134,6 +217,12 @@ private:
 
   Type type_;
 
+  bool constant_;
+
+  Color constant_color_;
+
+  QRectF region_;
+
 };
 
 using TexturePtr = std::shared_ptr<Texture>;
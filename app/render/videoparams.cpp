@@ -255,6 +255,7 @@ void VideoParams::set_defaults_for_footage()
   start_time_ = 0;
   duration_ = 0;
   premultiplied_alpha_ = false;
+  hardware_decoding_ = true;
 }
 
 void VideoParams::calculate_square_pixel_width()
@@ -343,7 +344,7 @@ int64_t VideoParams::get_time_in_timebase_units(const rational &time) const
   return Timecode::time_to_timestamp(time, time_base_) + start_time_;
 }
 
-void VideoParams::Load(QXmlStreamReader *reader)
+void VideoParams::Load(XMLReader *reader)
 {
   while (XMLReadNextStartElement(reader)) {
     if (reader->name() == QStringLiteral("width")) {
@@ -380,13 +381,15 @@ void VideoParams::Load(QXmlStreamReader *reader)
       set_premultiplied_alpha(reader->readElementText().toInt());
     } else if (reader->name() == QStringLiteral("colorspace")) {
       set_colorspace(reader->readElementText());
+    } else if (reader->name() == QStringLiteral("hardwaredecoding")) {
+      set_hardware_decoding(reader->readElementText().toInt());
     } else {
       reader->skipCurrentElement();
     }
   }
 }
 
-void VideoParams::Save(QXmlStreamWriter *writer) const
+void VideoParams::Save(XMLWriter *writer) const
 {
   writer->writeTextElement(QStringLiteral("width"), QString::number(width_));
   writer->writeTextElement(QStringLiteral("height"), QString::number(height_));
@@ -405,6 +408,7 @@ void VideoParams::Save(QXmlStreamWriter *writer) const
   writer->writeTextElement(QStringLiteral("duration"), QString::number(duration_));
   writer->writeTextElement(QStringLiteral("premultipliedalpha"), QString::number(premultiplied_alpha_));
   writer->writeTextElement(QStringLiteral("colorspace"), colorspace_);
+  writer->writeTextElement(QStringLiteral("hardwaredecoding"), QString::number(hardware_decoding_));
 }
 
 }
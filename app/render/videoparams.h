@@ -21,10 +21,8 @@
 #ifndef VIDEOPARAMS_H
 #define VIDEOPARAMS_H
 
-#include <QXmlStreamReader>
-#include <QXmlStreamWriter>
-
 #include "common/rational.h"
+#include "common/xmlstream.h"
 #include "rendermodes.h"
 
 namespace olive {
@@ -343,11 +341,24 @@ public:
     colorspace_ = c;
   }
 
+  /**
+   * @brief Whether this stream may be decoded using the hardware device set in preferences
+   */
+  bool hardware_decoding() const
+  {
+    return hardware_decoding_;
+  }
+
+  void set_hardware_decoding(bool e)
+  {
+    hardware_decoding_ = e;
+  }
+
   int64_t get_time_in_timebase_units(const rational& time) const;
 
-  void Load(QXmlStreamReader* reader);
+  void Load(XMLReader* reader);
 
-  void Save(QXmlStreamWriter* writer) const;
+  void Save(XMLWriter* writer) const;
 
 private:
   void calculate_effective_size();
@@ -387,6 +398,7 @@ private:
   int64_t duration_;
   bool premultiplied_alpha_;
   QString colorspace_;
+  bool hardware_decoding_;
 
 };
 
@@ -0,0 +1,80 @@
+uniform sampler2D tex_in;
+uniform bool repeat_edge_pixels_in;
+uniform vec2 resolution_in;
+uniform int pyramid_levels;
+uniform float level_sigma;
+
+uniform int ove_iteration;
+
+varying vec2 ove_texcoord;
+
+// Each level of the pyramid is stored in the bottom-left corner of the texture, scaled by `scale`.
+// `coord` is in image coordinates (0.0 - 1.0) regardless of level.
+vec4 sample_level(vec2 coord, float scale) {
+    if (repeat_edge_pixels_in) {
+        vec2 half_texel = 0.5 / resolution_in;
+        return texture2D(tex_in, clamp(coord * scale, half_texel, vec2(scale) - half_texel));
+    }
+
+    if (any(lessThan(coord, vec2(0.0))) || any(greaterThanEqual(coord, vec2(1.0)))) {
+        return vec4(0.0);
+    }
+
+    return texture2D(tex_in, coord * scale);
+}
+
+void main(void) {
+    // Iterations first halve the image pyramid_levels times, then blur horizontally and
+    // vertically at the smallest level, then double it back up to full size
+    int in_level, out_level;
+
+    if (ove_iteration < pyramid_levels) {
+        in_level = ove_iteration;
+        out_level = ove_iteration + 1;
+    } else if (ove_iteration < pyramid_levels + 2) {
+        in_level = pyramid_levels;
+        out_level = pyramid_levels;
+    } else {
+        in_level = pyramid_levels - (ove_iteration - pyramid_levels - 2);
+        out_level = in_level - 1;
+    }
+
+    float in_scale = exp2(-float(in_level));
+    float out_scale = exp2(-float(out_level));
+
+    vec2 coord = ove_texcoord / out_scale;
+
+    // Everything outside this level is cleared so that it reads as transparent next iteration
+    if (any(greaterThan(coord, vec2(1.0)))) {
+        gl_FragColor = vec4(0.0);
+        return;
+    }
+
+    if (in_level != out_level) {
+        // A single linear sample is exactly a 2x2 average going down and a bilinear
+        // interpolation coming back up
+        gl_FragColor = sample_level(coord, in_scale);
+        return;
+    }
+
+    vec2 pixel_step;
+    if (ove_iteration == pyramid_levels) {
+        pixel_step = vec2(1.0 / (resolution_in.x * in_scale), 0.0);
+    } else {
+        pixel_step = vec2(0.0, 1.0 / (resolution_in.y * in_scale));
+    }
+
+    float real_radius = ceil(level_sigma * 3.0);
+
+    vec4 composite = vec4(0.0);
+    float divider = 0.0;
+
+    for (float i = -real_radius; i <= real_radius; i += 1.0) {
+        float weight = exp(-0.5 * (i * i) / (level_sigma * level_sigma));
+
+        composite += sample_level(coord + pixel_step * i, in_scale) * weight;
+        divider += weight;
+    }
+
+    gl_FragColor = composite / divider;
+}
@@ -0,0 +1,10 @@
+// Node parameter inputs
+uniform sampler2D frame_a;
+uniform sampler2D frame_b;
+uniform float blend_in;
+
+varying vec2 ove_texcoord;
+
+void main(void) {
+    gl_FragColor = mix(texture2D(frame_a, ove_texcoord), texture2D(frame_b, ove_texcoord), blend_in);
+}
@@ -0,0 +1,44 @@
+#define M_PI 3.1415926535897932384626433832795
+
+uniform sampler2D ove_maintex;
+
+// Size of ove_maintex and how many of its texels fall inside one destination pixel
+uniform vec2 resolution_in;
+uniform vec2 footprint_in;
+
+varying vec2 ove_texcoord;
+
+float lanczos2(float x) {
+    if (x == 0.0) {
+        return 1.0;
+    }
+
+    if (abs(x) >= 2.0) {
+        return 0.0;
+    }
+
+    float px = M_PI * x;
+    return 2.0 * sin(px) * sin(px * 0.5) / (px * px);
+}
+
+void main(void) {
+    // Taps are spaced one destination pixel apart. The texture's mipmaps prefilter each of them to
+    // roughly that size, so 4x4 taps cover the kernel whatever the amount of shrinking.
+    vec2 tap_size = footprint_in / resolution_in;
+
+    vec4 sum = vec4(0.0);
+    float weight_sum = 0.0;
+
+    for (int i=0; i<4; i++) {
+        for (int j=0; j<4; j++) {
+            vec2 pos = vec2(float(i) - 1.5, float(j) - 1.5);
+            float weight = lanczos2(pos.x) * lanczos2(pos.y);
+
+            sum += texture2D(ove_maintex, ove_texcoord + pos * tap_size) * weight;
+            weight_sum += weight;
+        }
+    }
+
+    // Negative lobes can ring below zero around hard edges
+    gl_FragColor = max(sum / weight_sum, vec4(0.0));
+}
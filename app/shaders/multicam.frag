@@ -0,0 +1,88 @@
+// Node parameter inputs
+uniform sampler2D angle_0;
+uniform sampler2D angle_1;
+uniform sampler2D angle_2;
+uniform sampler2D angle_3;
+uniform sampler2D angle_4;
+uniform sampler2D angle_5;
+uniform sampler2D angle_6;
+uniform sampler2D angle_7;
+uniform sampler2D angle_8;
+uniform sampler2D angle_9;
+uniform sampler2D angle_10;
+uniform sampler2D angle_11;
+uniform sampler2D angle_12;
+uniform sampler2D angle_13;
+uniform sampler2D angle_14;
+uniform sampler2D angle_15;
+uniform int angle_count;
+uniform int grid_size;
+uniform int current_in;
+uniform vec2 resolution_in;
+
+varying vec2 ove_texcoord;
+
+vec4 sample_angle(int index, vec2 coord) {
+    // GLSL 1.10 can't index an array of samplers with a variable
+    if (index == 0) {
+        return texture2D(angle_0, coord);
+    } else if (index == 1) {
+        return texture2D(angle_1, coord);
+    } else if (index == 2) {
+        return texture2D(angle_2, coord);
+    } else if (index == 3) {
+        return texture2D(angle_3, coord);
+    } else if (index == 4) {
+        return texture2D(angle_4, coord);
+    } else if (index == 5) {
+        return texture2D(angle_5, coord);
+    } else if (index == 6) {
+        return texture2D(angle_6, coord);
+    } else if (index == 7) {
+        return texture2D(angle_7, coord);
+    } else if (index == 8) {
+        return texture2D(angle_8, coord);
+    } else if (index == 9) {
+        return texture2D(angle_9, coord);
+    } else if (index == 10) {
+        return texture2D(angle_10, coord);
+    } else if (index == 11) {
+        return texture2D(angle_11, coord);
+    } else if (index == 12) {
+        return texture2D(angle_12, coord);
+    } else if (index == 13) {
+        return texture2D(angle_13, coord);
+    } else if (index == 14) {
+        return texture2D(angle_14, coord);
+    } else if (index == 15) {
+        return texture2D(angle_15, coord);
+    }
+
+    return vec4(0.0);
+}
+
+void main(void) {
+    vec2 cell = ove_texcoord * float(grid_size);
+    vec2 tile = floor(cell);
+    vec2 coord = cell - tile;
+
+    int index = int(tile.y) * grid_size + int(tile.x);
+
+    if (index >= angle_count) {
+        gl_FragColor = vec4(0.0);
+        return;
+    }
+
+    // Outline the current angle
+    if (index == current_in) {
+        vec2 border = 4.0 * float(grid_size) / resolution_in;
+
+        if (coord.x < border.x || coord.x > 1.0 - border.x
+            || coord.y < border.y || coord.y > 1.0 - border.y) {
+            gl_FragColor = vec4(1.0, 0.0, 0.0, 1.0);
+            return;
+        }
+    }
+
+    gl_FragColor = sample_angle(index, coord);
+}
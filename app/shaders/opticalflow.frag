@@ -0,0 +1,78 @@
+// Node parameter inputs
+uniform sampler2D frame_a;
+uniform sampler2D frame_b;
+uniform sampler2D flow_in;
+uniform float blend_in;
+uniform vec2 resolution_in;
+uniform int flow_passes;
+
+// Standard inputs
+uniform int ove_iteration;
+
+varying vec2 ove_texcoord;
+
+float luma(sampler2D tex, vec2 coord) {
+    return dot(texture2D(tex, coord).rgb, vec3(0.2126, 0.7152, 0.0722));
+}
+
+// Refines the flow from frame_a to frame_b (in pixels) with one Lucas-Kanade step, measuring
+// gradients `stride` pixels apart so coarse passes can follow larger motion
+vec4 refine(vec2 flow, float stride) {
+    vec2 px = stride / resolution_in;
+    vec2 warp = flow / resolution_in;
+
+    float gxx = 0.0;
+    float gxy = 0.0;
+    float gyy = 0.0;
+    float bx = 0.0;
+    float by = 0.0;
+
+    for (float i=-2.0; i<=2.0; i+=1.0) {
+        for (float j=-2.0; j<=2.0; j+=1.0) {
+            vec2 coord = ove_texcoord + vec2(i, j) * px;
+
+            float ix = (luma(frame_a, coord + vec2(px.x, 0.0)) - luma(frame_a, coord - vec2(px.x, 0.0))) / (2.0 * stride);
+            float iy = (luma(frame_a, coord + vec2(0.0, px.y)) - luma(frame_a, coord - vec2(0.0, px.y))) / (2.0 * stride);
+            float it = luma(frame_b, coord + warp) - luma(frame_a, coord);
+
+            gxx += ix * ix;
+            gxy += ix * iy;
+            gyy += iy * iy;
+            bx -= ix * it;
+            by -= iy * it;
+        }
+    }
+
+    float det = gxx * gyy - gxy * gxy;
+
+    // Flat or edge-only areas can't tell us which way things moved, keep what we had
+    if (abs(det) > 1e-8) {
+        vec2 delta = vec2(gyy * bx - gxy * by, gxx * by - gxy * bx) / det;
+
+        // Each pass can only be trusted for about as far as it measures
+        float len = length(delta);
+        if (len > 2.0 * stride) {
+            delta *= 2.0 * stride / len;
+        }
+
+        flow += delta;
+    }
+
+    return vec4(flow, 0.0, 1.0);
+}
+
+void main(void) {
+    if (ove_iteration < flow_passes) {
+        // Strides halve each pass down to 1 pixel
+        vec2 flow = (ove_iteration == 0) ? vec2(0.0) : texture2D(flow_in, ove_texcoord).xy;
+        gl_FragColor = refine(flow, exp2(float(flow_passes - 1 - ove_iteration)));
+    } else {
+        // Move both frames to where the in-between frame would see them and blend
+        vec2 flow = texture2D(flow_in, ove_texcoord).xy / resolution_in;
+
+        vec4 a = texture2D(frame_a, ove_texcoord - flow * blend_in);
+        vec4 b = texture2D(frame_b, ove_texcoord + flow * (1.0 - blend_in));
+
+        gl_FragColor = mix(a, b, blend_in);
+    }
+}
@@ -0,0 +1,49 @@
+uniform sampler2D ove_maintex;
+
+uniform vec2 viewport;
+uniform float frame_aspect;
+
+varying vec2 ove_texcoord;
+
+void main(void) {
+    // Letterbox the frame into the viewport
+    vec2 size = viewport;
+    if (viewport.x / viewport.y > frame_aspect) {
+        size.x = viewport.y * frame_aspect;
+    } else {
+        size.y = viewport.x / frame_aspect;
+    }
+    vec2 coord = (ove_texcoord * viewport - (viewport - size) * 0.5) / size;
+
+    if (any(lessThan(coord, vec2(0.0))) || any(greaterThan(coord, vec2(1.0)))) {
+        gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    float luma = texture2D(ove_maintex, coord).r;
+
+    // Anything outside a zone is shown as plain grayscale
+    vec3 col = vec3(clamp(luma, 0.0, 1.0));
+
+    if (luma < 0.025) {
+        // Crushed blacks
+        col = vec3(0.5, 0.0, 0.5);
+    } else if (luma < 0.1) {
+        // Shadows
+        col = vec3(0.0, 0.0, 1.0);
+    } else if (luma >= 0.38 && luma < 0.44) {
+        // Mid-gray
+        col = vec3(0.0, 0.8, 0.0);
+    } else if (luma >= 0.52 && luma < 0.62) {
+        // Skin tones
+        col = vec3(1.0, 0.5, 0.6);
+    } else if (luma >= 0.93 && luma <= 0.99) {
+        // Near clipping
+        col = vec3(1.0, 1.0, 0.0);
+    } else if (luma > 0.99) {
+        // Clipped
+        col = vec3(1.0, 0.0, 0.0);
+    }
+
+    gl_FragColor = vec4(col, 1.0);
+}
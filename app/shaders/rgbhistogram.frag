@@ -1,31 +1,19 @@
 uniform sampler2D ove_maintex;
-uniform vec2 viewport;
-uniform float histogram_scale;
+
+uniform float bin_count;
+uniform float histogram_power;
 
 varying vec2 ove_texcoord;
 
 void main(void) {
-    float histogram_width = ceil(histogram_scale * viewport.y);
-    float quantisation = 1.0 / (histogram_width - 1.0);
-    vec3 cur_col = vec3(0.0);
-    vec3 sum = vec3(0.0);
-    float ratio = 0.0;
-
-    for (int i = 0; float(i) < histogram_width; i++) {
-        ratio = float(i) / float(histogram_width - 1.0);
-        cur_col = texture2D(
-            ove_maintex,
-            vec2(ove_texcoord.y, ratio)
-        ).rgb;
+    vec3 fraction = texture2D(
+        ove_maintex,
+        vec2(ove_texcoord.x, 0.5)
+    ).rgb;
 
-        sum += step(vec3(ove_texcoord.x - quantisation), cur_col) *
-            step(cur_col, vec3(ove_texcoord.x + quantisation)) +
-            (
-                // Account for values beyond the upper x limit.
-                step(1.0 - quantisation, ove_texcoord.x) *
-                step(vec3(1.0 - quantisation), cur_col)
-            );
-    }
+    // A perfectly flat histogram reaches a quarter of the way up before the power curve
+    vec3 histogram_ratio = pow(fraction * bin_count * 0.25, vec3(histogram_power));
+    vec3 col = step(vec3(ove_texcoord.y), histogram_ratio);
 
-    gl_FragColor = vec4(sum, 1.0);
+    gl_FragColor = vec4(col, 1.0);
 }
@@ -0,0 +1,16 @@
+uniform sampler2D ove_maintex;
+
+uniform float intensity;
+
+varying vec2 ove_texcoord;
+
+void main(void) {
+    // Split the width into thirds, each showing one channel of the whole frame
+    float third = floor(clamp(ove_texcoord.x * 3.0, 0.0, 2.0));
+    vec2 coord = vec2(ove_texcoord.x * 3.0 - third, ove_texcoord.y);
+
+    vec4 levels = texture2D(ove_maintex, coord) * intensity;
+
+    vec3 mask = vec3(equal(vec3(third), vec3(0.0, 1.0, 2.0)));
+    gl_FragColor = vec4(levels.rgb * mask, 1.0);
+}
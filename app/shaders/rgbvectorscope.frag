@@ -0,0 +1,24 @@
+uniform sampler2D ove_maintex;
+
+uniform vec2 viewport;
+uniform float vectorscope_scale;
+uniform float intensity;
+
+varying vec2 ove_texcoord;
+
+void main(void) {
+    // Fit the chroma plane into a centered square
+    float size = min(viewport.x, viewport.y) * vectorscope_scale;
+    vec2 coord = (ove_texcoord * viewport - (viewport - vec2(size)) * 0.5) / size;
+
+    if (any(lessThan(coord, vec2(0.0))) || any(greaterThan(coord, vec2(1.0)))) {
+        gl_FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+
+    // Square root brings out sparse chroma that would otherwise be invisible
+    float fraction = texture2D(ove_maintex, coord).r;
+    float brightness = clamp(sqrt(fraction * intensity), 0.0, 1.0);
+
+    gl_FragColor = vec4(vec3(brightness), 1.0);
+}
@@ -0,0 +1,115 @@
+// Node parameter inputs
+uniform sampler2D tex_in;
+uniform sampler2D src_in;
+uniform vec4 color_in;
+uniform float radius_in;
+uniform float opacity_in;
+uniform bool inner_in;
+uniform vec2 resolution_in;
+uniform int jump_steps;
+
+// Standard inputs
+uniform int ove_iteration;
+
+varying vec2 ove_texcoord;
+
+// Every iteration but the last stores, for each pixel, the offset in pixels to the nearest pixel
+// the stroke grows from in RG, and whether one has been found yet in A.
+bool is_seed(float alpha) {
+    if (inner_in) {
+        return alpha < 1.0;
+    } else {
+        return alpha > 0.0;
+    }
+}
+
+vec4 seed(void) {
+    if (is_seed(texture2D(src_in, ove_texcoord).a)) {
+        return vec4(0.0, 0.0, 0.0, 1.0);
+    } else {
+        return vec4(0.0);
+    }
+}
+
+vec4 jump(float step_size) {
+    vec4 best = texture2D(tex_in, ove_texcoord);
+    float best_distance = (best.a > 0.0) ? length(best.xy) : -1.0;
+
+    for (float i=-1.0; i<=1.0; i+=1.0) {
+        for (float j=-1.0; j<=1.0; j+=1.0) {
+            vec2 offset = vec2(i, j) * step_size;
+            vec2 coord = ove_texcoord + offset / resolution_in;
+
+            if (coord.x < 0.0 || coord.x >= 1.0 || coord.y < 0.0 || coord.y >= 1.0) {
+                continue;
+            }
+
+            vec4 neighbor = texture2D(tex_in, coord);
+
+            if (neighbor.a > 0.0) {
+                // The neighbor's seed, relative to this pixel
+                vec2 candidate = offset + neighbor.xy;
+                float candidate_distance = length(candidate);
+
+                if (best_distance < 0.0 || candidate_distance < best_distance) {
+                    best = vec4(candidate, 0.0, 1.0);
+                    best_distance = candidate_distance;
+                }
+            }
+        }
+    }
+
+    return best;
+}
+
+vec4 shade(void) {
+    vec4 pixel_here = texture2D(src_in, ove_texcoord);
+
+    // Detect no-op situations
+    if ((inner_in && pixel_here.a == 0.0)
+        || (!inner_in && pixel_here.a == 1.0)) {
+        return pixel_here;
+    }
+
+    vec4 nearest = texture2D(tex_in, ove_texcoord);
+
+    if (nearest.a == 0.0) {
+        return pixel_here;
+    }
+
+    // Fade over the last pixel so the edge is antialiased
+    float stroke_weight = clamp(radius_in - length(nearest.xy), 0.0, 1.0);
+
+    stroke_weight *= opacity_in;
+
+    if (inner_in) {
+        stroke_weight *= pixel_here.a;
+    }
+
+    // Make RGBA color
+    vec4 stroke_col = color_in * stroke_weight;
+
+    if (inner_in) {
+        // Alpha over the stroke over the texture
+        stroke_col = pixel_here * (1.0 - stroke_col.a) + stroke_col;
+    } else {
+        // Alpha over the texture over the stroke
+        stroke_col = stroke_col * (1.0 - pixel_here.a) + pixel_here;
+    }
+
+    return stroke_col;
+}
+
+void main(void) {
+    // Iterations seed, then jump in halving steps down to 1 pixel, then make one more 1 pixel jump
+    // to fix the few pixels the halving misses, then shade
+    if (ove_iteration == 0) {
+        gl_FragColor = seed();
+    } else if (ove_iteration <= jump_steps) {
+        gl_FragColor = jump(exp2(float(jump_steps - ove_iteration)));
+    } else if (ove_iteration == jump_steps + 1) {
+        gl_FragColor = jump(1.0);
+    } else {
+        gl_FragColor = shade();
+    }
+}
@@ -0,0 +1,105 @@
+// Motion adaptive deinterlacer, following FFmpeg's yadif
+
+uniform sampler2D prev_tex_in;
+uniform sampler2D cur_tex_in;
+uniform sampler2D next_tex_in;
+uniform vec2 resolution_in;
+
+// Row parity (0 for top, 1 for bottom) of the field being shown, whose lines are kept as is
+uniform int field_in;
+
+// Whether the field being shown is the later of the current frame's two
+uniform bool second_field_in;
+
+varying vec2 ove_texcoord;
+
+vec4 read_row(sampler2D tex, float offset) {
+    return texture2D(tex, vec2(ove_texcoord.x, ove_texcoord.y + offset / resolution_in.y));
+}
+
+vec4 max3(vec4 a, vec4 b, vec4 c) {
+    return max(max(a, b), c);
+}
+
+vec4 min3(vec4 a, vec4 b, vec4 c) {
+    return min(min(a, b), c);
+}
+
+void main() {
+    float y_pixel = floor(ove_texcoord.y * resolution_in.y);
+
+    if (int(mod(y_pixel, 2.0)) == field_in) {
+        gl_FragColor = texture2D(cur_tex_in, ove_texcoord);
+        return;
+    }
+
+    // The field this line belongs to was captured between the two frames that contain it at the
+    // nearest times, which are the previous and current frame for the first field, and the
+    // current and next frame for the second
+    vec4 prev2_0, prev2_m2, prev2_p2;
+    vec4 next2_0, next2_m2, next2_p2;
+
+    if (second_field_in) {
+        prev2_0 = read_row(cur_tex_in, 0.0);
+        prev2_m2 = read_row(cur_tex_in, -2.0);
+        prev2_p2 = read_row(cur_tex_in, 2.0);
+        next2_0 = read_row(next_tex_in, 0.0);
+        next2_m2 = read_row(next_tex_in, -2.0);
+        next2_p2 = read_row(next_tex_in, 2.0);
+    } else {
+        prev2_0 = read_row(prev_tex_in, 0.0);
+        prev2_m2 = read_row(prev_tex_in, -2.0);
+        prev2_p2 = read_row(prev_tex_in, 2.0);
+        next2_0 = read_row(cur_tex_in, 0.0);
+        next2_m2 = read_row(cur_tex_in, -2.0);
+        next2_p2 = read_row(cur_tex_in, 2.0);
+    }
+
+    // Lines above and below from the field being shown
+    vec4 c = read_row(cur_tex_in, -1.0);
+    vec4 e = read_row(cur_tex_in, 1.0);
+
+    // Temporal prediction and how much this pixel is moving
+    vec4 d = (prev2_0 + next2_0) * 0.5;
+
+    vec4 temporal_diff0 = abs(prev2_0 - next2_0);
+    vec4 temporal_diff1 = (abs(read_row(prev_tex_in, -1.0) - c) + abs(read_row(prev_tex_in, 1.0) - e)) * 0.5;
+    vec4 temporal_diff2 = (abs(read_row(next_tex_in, -1.0) - c) + abs(read_row(next_tex_in, 1.0) - e)) * 0.5;
+
+    vec4 diff = max3(temporal_diff0 * 0.5, temporal_diff1, temporal_diff2);
+
+    // Spatial prediction along whichever of the three directions matches best
+    vec2 px = vec2(1.0 / resolution_in.x, 0.0);
+
+    vec4 spatial_pred = (c + e) * 0.5;
+    float spatial_score = dot(abs(texture2D(cur_tex_in, ove_texcoord - px - vec2(0.0, 1.0 / resolution_in.y)) - texture2D(cur_tex_in, ove_texcoord - px + vec2(0.0, 1.0 / resolution_in.y))), vec4(1.0))
+                        + dot(abs(c - e), vec4(1.0))
+                        + dot(abs(texture2D(cur_tex_in, ove_texcoord + px - vec2(0.0, 1.0 / resolution_in.y)) - texture2D(cur_tex_in, ove_texcoord + px + vec2(0.0, 1.0 / resolution_in.y))), vec4(1.0));
+
+    for (int i=-1; i<=1; i+=2) {
+        vec2 dir = px * float(i);
+        vec4 up = texture2D(cur_tex_in, ove_texcoord + dir + vec2(0.0, -1.0 / resolution_in.y));
+        vec4 down = texture2D(cur_tex_in, ove_texcoord - dir + vec2(0.0, 1.0 / resolution_in.y));
+
+        float score = dot(abs(texture2D(cur_tex_in, ove_texcoord + dir * 2.0 + vec2(0.0, -1.0 / resolution_in.y)) - texture2D(cur_tex_in, ove_texcoord + vec2(0.0, 1.0 / resolution_in.y))), vec4(1.0))
+                    + dot(abs(up - down), vec4(1.0))
+                    + dot(abs(texture2D(cur_tex_in, ove_texcoord + vec2(0.0, -1.0 / resolution_in.y)) - texture2D(cur_tex_in, ove_texcoord - dir * 2.0 + vec2(0.0, 1.0 / resolution_in.y))), vec4(1.0));
+
+        if (score < spatial_score) {
+            spatial_score = score;
+            spatial_pred = (up + down) * 0.5;
+        }
+    }
+
+    // Don't let the spatial prediction stray further from the temporal one than the motion
+    // allows, with the lines two above and below catching vertical detail the motion check misses
+    vec4 b = (prev2_m2 + next2_m2) * 0.5;
+    vec4 f = (prev2_p2 + next2_p2) * 0.5;
+
+    vec4 hi = max3(d - e, d - c, min(b - c, f - e));
+    vec4 lo = min3(d - e, d - c, max(b - c, f - e));
+
+    diff = max3(diff, lo, -hi);
+
+    gl_FragColor = clamp(spatial_pred, d - diff, d + diff);
+}
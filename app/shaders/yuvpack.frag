@@ -0,0 +1,48 @@
+uniform sampler2D ove_maintex;
+
+// Size of the luma plane (and source texture) in pixels
+uniform vec2 resolution_in;
+
+// Size of each chroma plane in pixels
+uniform vec2 chroma_size_in;
+
+// Luma coefficients of red and blue
+uniform float kr_in;
+uniform float kb_in;
+
+// Multiplier from an 8-bit code value to the destination's normalized range
+uniform float code_scale_in;
+
+varying vec2 ove_texcoord;
+
+float luma(vec3 rgb) {
+    return dot(rgb, vec3(kr_in, 1.0 - kr_in - kb_in, kb_in));
+}
+
+void main() {
+    // Destination holds the luma plane, then the Cb and Cr planes side by side underneath
+    vec2 px = ove_texcoord * vec2(resolution_in.x, resolution_in.y + chroma_size_in.y);
+
+    if (px.y < resolution_in.y) {
+        vec3 rgb = texture2D(ove_maintex, px / resolution_in).rgb;
+
+        gl_FragColor = vec4((16.0 + 219.0 * clamp(luma(rgb), 0.0, 1.0)) * code_scale_in);
+    } else {
+        bool cr = (px.x >= chroma_size_in.x);
+        vec2 chroma_px = vec2(cr ? px.x - chroma_size_in.x : px.x, px.y - resolution_in.y);
+
+        // Sampling at the center of the block of pixels each chroma sample covers averages them
+        // through linear filtering
+        vec3 rgb = texture2D(ove_maintex, chroma_px / chroma_size_in).rgb;
+        float y = luma(rgb);
+
+        float c;
+        if (cr) {
+            c = (rgb.r - y) / (2.0 * (1.0 - kr_in));
+        } else {
+            c = (rgb.b - y) / (2.0 * (1.0 - kb_in));
+        }
+
+        gl_FragColor = vec4((128.0 + 224.0 * clamp(c, -0.5, 0.5)) * code_scale_in);
+    }
+}
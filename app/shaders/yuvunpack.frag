@@ -0,0 +1,55 @@
+// Reads planar YUV packed as described by PlanarYUV (luma rows, then Cb and Cr side by side) and
+// converts it to RGB. Prepended to color management shaders, which call ove_unpack_yuv() in place
+// of sampling the main texture.
+
+// Size of the luma plane (and picture) in pixels
+uniform vec2 ove_yuv_resolution;
+
+// Size of each chroma plane in pixels
+uniform vec2 ove_yuv_chroma_size;
+
+// Luma coefficients of red and blue
+uniform float ove_yuv_kr;
+uniform float ove_yuv_kb;
+
+// Normalized sample values of black/neutral chroma, and multipliers from there to 0-1 and +/-0.5
+uniform float ove_yuv_luma_offset;
+uniform float ove_yuv_luma_scale;
+uniform float ove_yuv_chroma_offset;
+uniform float ove_yuv_chroma_scale;
+
+float ove_yuv_fetch(sampler2D tex, vec2 px) {
+    // The packed texture is as wide as luma and as tall as luma and chroma together
+    return texture2D(tex, px / vec2(ove_yuv_resolution.x, ove_yuv_resolution.y + ove_yuv_chroma_size.y)).r;
+}
+
+float ove_yuv_chroma(sampler2D tex, vec2 coord, float x_offset) {
+    // Bilinear interpolation by hand, hardware filtering would bleed across plane edges
+    vec2 pos = coord * ove_yuv_chroma_size - vec2(0.5);
+    vec2 f = fract(pos);
+    vec2 lo = clamp(floor(pos), vec2(0.0), ove_yuv_chroma_size - vec2(1.0));
+    vec2 hi = clamp(floor(pos) + vec2(1.0), vec2(0.0), ove_yuv_chroma_size - vec2(1.0));
+
+    vec2 base = vec2(x_offset, ove_yuv_resolution.y) + vec2(0.5);
+
+    float a = ove_yuv_fetch(tex, base + vec2(lo.x, lo.y));
+    float b = ove_yuv_fetch(tex, base + vec2(hi.x, lo.y));
+    float c = ove_yuv_fetch(tex, base + vec2(lo.x, hi.y));
+    float d = ove_yuv_fetch(tex, base + vec2(hi.x, hi.y));
+
+    return mix(mix(a, b, f.x), mix(c, d, f.x), f.y);
+}
+
+vec4 ove_unpack_yuv(sampler2D tex, vec2 coord) {
+    vec2 luma_px = min(floor(coord * ove_yuv_resolution), ove_yuv_resolution - vec2(1.0)) + vec2(0.5);
+
+    float y = (ove_yuv_fetch(tex, luma_px) - ove_yuv_luma_offset) * ove_yuv_luma_scale;
+    float cb = (ove_yuv_chroma(tex, coord, 0.0) - ove_yuv_chroma_offset) * ove_yuv_chroma_scale;
+    float cr = (ove_yuv_chroma(tex, coord, ove_yuv_chroma_size.x) - ove_yuv_chroma_offset) * ove_yuv_chroma_scale;
+
+    float r = y + 2.0 * (1.0 - ove_yuv_kr) * cr;
+    float b = y + 2.0 * (1.0 - ove_yuv_kb) * cb;
+    float g = (y - ove_yuv_kr * r - ove_yuv_kb * b) / (1.0 - ove_yuv_kr - ove_yuv_kb);
+
+    return vec4(r, g, b, 1.0);
+}
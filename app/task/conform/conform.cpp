@@ -20,15 +20,29 @@
 
 #include "conform.h"
 
+#include "audio/audioanalysis.h"
+#include "audio/audiovisualwaveform.h"
+#include "codec/conformmanager.h"
+#include "codec/planaraudiofile.h"
+
 namespace olive {
 
-ConformTask::ConformTask(const QString &decoder_id, const Decoder::CodecStream &stream, const AudioParams& params, const QString &output_filename) :
+ConformTask::ConformTask(const QString &decoder_id, const Decoder::CodecStream &stream, const AudioParams& params, const QVector<Decoder::ConformOutput> &outputs, const TimeRange &range) :
   decoder_id_(decoder_id),
   stream_(stream),
   params_(params),
-  output_filename_(output_filename)
+  outputs_(outputs),
+  range_(range)
 {
-  SetTitle(tr("Conforming Audio %1:%2").arg(stream.filename(), QString::number(stream.stream())));
+  if (!range_.length().isNull()) {
+    SetTitle(tr("Conforming Audio %1:%2 (%3s - %4s)").arg(stream.filename(), QString::number(stream.stream()),
+                                                          QString::number(range_.in().toDouble()),
+                                                          QString::number(range_.out().toDouble())));
+  } else if (outputs_.size() > 1) {
+    SetTitle(tr("Conforming Audio %1 (%n streams)", nullptr, outputs_.size()).arg(stream.filename()));
+  } else {
+    SetTitle(tr("Conforming Audio %1:%2").arg(stream.filename(), QString::number(stream.stream())));
+  }
 }
 
 bool ConformTask::Run()
@@ -42,11 +56,71 @@ bool ConformTask::Run()
 
   connect(decoder.get(), &Decoder::IndexProgress, this, &ConformTask::ProgressChanged);
 
-  bool ret = decoder->ConformAudio(output_filename_, params_, &IsCancelled());
+  bool ret = decoder->ConformAudio(outputs_, params_, &IsCancelled(), range_);
 
   decoder->Close();
 
+  // Ranges are only used until the full conform is done, which gets its own waveform
+  if (ret && range_.length().isNull()) {
+    // Failing here isn't fatal, waveforms will just be generated from the audio when it's rendered instead
+    foreach (const Decoder::ConformOutput &output, outputs_) {
+      if (IsCancelled()) {
+        break;
+      }
+
+      GenerateSidecars(output.filename);
+    }
+  }
+
   return ret;
 }
 
+void ConformTask::GenerateSidecars(const QString &conform_filename)
+{
+  PlanarAudioInput input(conform_filename);
+
+  if (!input.open()) {
+    return;
+  }
+
+  const AudioParams& input_params = input.params();
+
+  AudioVisualWaveform::FileWriter waveform(ConformManager::GetWaveformFilename(conform_filename),
+                                           input_params,
+                                           input.sample_count());
+
+  AudioAnalysis::FileWriter analysis(ConformManager::GetAnalysisFilename(conform_filename),
+                                     input_params);
+
+  bool waveform_open = waveform.open();
+  bool analysis_open = analysis.open();
+
+  if (waveform_open || analysis_open) {
+    // Feed a second at a time, the writers take care of batching these into properly aligned chunks
+    qint64 chunk_size = input_params.sample_rate();
+
+    for (qint64 i=0; i<input.sample_count() && !IsCancelled(); i+=chunk_size) {
+      int count = qMin(chunk_size, input.sample_count() - i);
+      SampleBufferPtr chunk = SampleBuffer::CreateAllocated(input_params, count);
+
+      for (int j=0; j<input_params.channel_count(); j++) {
+        chunk->set(j, input.data(j) + i, count);
+      }
+
+      waveform.write(chunk);
+      analysis.write(chunk);
+    }
+
+    waveform.close();
+    analysis.close();
+
+    if (IsCancelled()) {
+      // An incomplete analysis would report the wrong loudness, don't leave one behind
+      QFile::remove(ConformManager::GetAnalysisFilename(conform_filename));
+    }
+  }
+
+  input.close();
+}
+
 }
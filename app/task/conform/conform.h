@@ -32,19 +32,43 @@ class ConformTask : public Task
 {
   Q_OBJECT
 public:
-  ConformTask(const QString &decoder_id, const Decoder::CodecStream &stream, const AudioParams& params, const QString &output_filename);
+  /**
+   * @brief Conform `outputs` of a file, or only `range` of them if it has a length
+   */
+  ConformTask(const QString &decoder_id, const Decoder::CodecStream &stream, const AudioParams& params, const QVector<Decoder::ConformOutput> &outputs, const TimeRange &range = TimeRange());
+
+  virtual Priority GetPriority() const override
+  {
+    // Ranges are conformed because something is waiting to play them, while a whole stream
+    // conforms in the background and is only needed once it's done
+    return range_.length().isNull() ? kPriorityNormal : kPriorityInteractive;
+  }
+
+  virtual Resource GetResource() const override
+  {
+    return kResourceIO;
+  }
 
 protected:
   virtual bool Run() override;
 
 private:
+  /**
+   * @brief Write the visual waveform and loudness/spectrum analysis of the conformed audio in one pass
+   *
+   * Neither needs to be computed from the audio again after this.
+   */
+  void GenerateSidecars(const QString &conform_filename);
+
   QString decoder_id_;
 
   Decoder::CodecStream stream_;
 
   AudioParams params_;
 
-  QString output_filename_;
+  QVector<Decoder::ConformOutput> outputs_;
+
+  TimeRange range_;
 
 };
 
@@ -20,17 +20,38 @@
 
 #include "export.h"
 
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "codec/ffmpeg/ffmpegencoder.h"
 #include "common/timecodefunctions.h"
+#include "config/config.h"
 #include "node/color/colormanager/colormanager.h"
+#include "render/framehashcache.h"
+#include "render/hardwareprofile.h"
 
 namespace olive {
 
+const qint64 ExportTask::kSharedCacheClaimTimeout = 15 * 60 * 1000;
+
 ExportTask::ExportTask(ViewerOutput *viewer_node,
                        ColorManager* color_manager,
                        const ExportParams& params) :
   RenderTask(viewer_node, params.video_params(), params.audio_params()),
   color_manager_(color_manager),
-  params_(params)
+  params_(params),
+  shared_cache_role_(kSharedCacheNone),
+  shared_cache_frames_done_(0),
+  chunk_length_(0),
+  frame_count_(0),
+  smart_render_(false),
+  write_unordered_(false),
+  buffered_bytes_(0),
+  buffer_budget_(0)
 {
   SetTitle(tr("Exporting \"%1\"").arg(viewer_node->GetLabel()));
   SetNativeProgressSignallingEnabled(false);
@@ -48,56 +69,154 @@ bool ExportTask::Run()
     params_.SetFilename(FileFunctions::GetSafeTemporaryFilename(real_filename));
   }
 
-  encoder_ = Encoder::CreateFromID(params_.encoder(), params_);
+  if (params_.has_custom_range()) {
+    // Render custom range only
+    range = params_.custom_range();
+  } else {
+    // Render entire sequence
+    range = TimeRange(0, viewer()->GetLength());
+  }
 
-  if (!encoder_) {
-    SetError(tr("Failed to create encoder"));
+  {
+    // Everything that affects the rendered frames besides the render hash, used to tell whether
+    // frames in a shared cache or a checkpoint were made for this export
+    const VideoParams& vp = params_.video_params();
+    const ColorTransform& ct = params_.color_transform();
+
+    shared_cache_settings_ = QStringLiteral("%1:%2:%3:%4:%5:%6:%7:%8").arg(QString::number(vp.width()),
+                                                                           QString::number(vp.height()),
+                                                                           QString::number(params_.video_scaling_method()),
+                                                                           QString::number(ct.is_display()),
+                                                                           ct.display(),
+                                                                           ct.view(),
+                                                                           ct.look(),
+                                                                           color_manager_->GetConfigFilename()).toUtf8();
+  }
+
+  if (!deliverables_.isEmpty() && shared_cache_role_ != kSharedCacheNone) {
+    SetError(tr("Exports with more than one deliverable can't use a shared cache"));
     return false;
   }
 
-  if (!encoder_->Open()) {
-    SetError(tr("Failed to open file: %1").arg(encoder_->GetError()));
-    encoder_->deleteLater();
+  if (shared_cache_role_ == kSharedCacheWorker) {
+    params_.SetFilename(real_filename);
+    return RunSharedCacheWorker(range);
+  }
+
+  RenderManager::FrameOutputList deliverable_outputs;
+
+  if (!OpenDeliverables(&deliverable_outputs)) {
+    CloseDeliverables(true);
     return false;
   }
 
-  if (params_.has_custom_range()) {
-    // Render custom range only
-    range = params_.custom_range();
-  } else {
-    // Render entire sequence
-    range = TimeRange(0, viewer()->GetLength());
+  // Intra-only codecs can be split into segments that are encoded simultaneously and then joined
+  int64_t frame_count = FrameHashCache::GetFrameListFromTimeRange({range}, video_params().frame_rate_as_time_base()).size();
+  frame_count_ = frame_count;
+  //
+  // Image sequences skip this, every frame is written on its own as soon as it's rendered instead
+  bool can_segment = params_.video_enabled()
+      && !params_.video_is_image_sequence()
+      && frame_count > 1
+      && ExportCodec::IsCodecIntraOnly(params_.video_codec());
+
+  // Long exports are also written as a series of chunks that are kept if the export is interrupted,
+  // so running it again only renders what wasn't finished. Smart rendering needs a single encoder,
+  // and deliverables need every frame of the render.
+  chunk_length_ = 0;
+
+  if (can_segment && !params_.video_smart_render() && deliverables_.isEmpty()) {
+    int interval = Config::Current()[QStringLiteral("ExportCheckpointInterval")].toInt();
+
+    if (interval > 0) {
+      int64_t length = Timecode::time_to_timestamp(rational(interval), video_params().frame_rate_as_time_base());
+
+      if (length > 0 && frame_count > length) {
+        chunk_length_ = length;
+      }
+    }
+  }
+
+  bool segmented = can_segment && (params_.video_segments() > 1 || chunk_length_ > 0);
+
+  if (chunk_length_ > 0) {
+    LoadCheckpoint(real_filename, range);
+
+    if (!QDir().mkpath(checkpoint_path_)) {
+      SetError(tr("Failed to create \"%1\"").arg(checkpoint_path_));
+      CloseDeliverables(true);
+      return false;
+    }
+  } else if (segmented && !OpenSegments(frame_count)) {
+    CloseSegments(true);
+    CloseDeliverables(true);
+    return false;
+  }
+
+  // When segmenting, the main encoder only handles the audio and subtitles, which are joined with
+  // the video segments at the end
+  QString extra_streams_filename;
+  encoder_ = nullptr;
+
+  if (!segmented || params_.audio_enabled() || params_.subtitles_enabled()) {
+    EncodingParams encoder_params = params_;
+
+    if (segmented) {
+      extra_streams_filename = FileFunctions::GetSafeTemporaryFilename(params_.filename());
+      encoder_params.SetFilename(extra_streams_filename);
+      encoder_params.DisableVideo();
+    }
+
+    encoder_ = Encoder::CreateFromID(params_.encoder(), encoder_params);
+
+    if (!encoder_) {
+      SetError(tr("Failed to create encoder"));
+      CloseSegments(true);
+      CloseDeliverables(true);
+      return false;
+    }
+
+    if (!encoder_->Open()) {
+      SetError(tr("Failed to open file: %1").arg(encoder_->GetError()));
+      encoder_->deleteLater();
+      CloseSegments(true);
+      CloseDeliverables(true);
+      return false;
+    }
   }
 
+  write_unordered_ = encoder_
+      && params_.video_enabled()
+      && params_.video_is_image_sequence()
+      && encoder_->WritesFramesIndependently();
+
   frame_time_ = 0;
 
+  // Rendering pauses while this much memory is held by frames that can't be encoded yet
+  buffer_budget_ = qint64(Config::Current()[QStringLiteral("ExportBufferSize")].toInt()) * 1024 * 1024;
+
   QSize video_force_size;
   QMatrix4x4 video_force_matrix;
 
   if (params_.video_enabled()) {
+    PrepareVideoRender(&video_force_size, &video_force_matrix);
+  }
 
-    // If a transformation matrix is applied to this video, create it here
-    VideoParams vp = viewer()->GetVideoParams();
-    if (vp.width() != params_.video_params().width()
-        || params_.video_params().height() != params_.video_params().height()) {
-      video_force_size = QSize(params_.video_params().width(), params_.video_params().height());
-
-      if (params_.video_scaling_method() != ExportParams::kStretch) {
-        video_force_matrix = ExportParams::GenerateMatrix(params_.video_scaling_method(),
-                                                          vp.width(),
-                                                          vp.height(),
-                                                          params_.video_params().width(),
-                                                          params_.video_params().height());
-      }
-    } else {
-      // Disables forcing size in the renderer
-      video_force_size = QSize(0, 0);
-    }
+  // Smart rendering copies untouched footage frames into the video stream in order between
+  // rendered ones, which only works for a single encoder given whole frames at the export's size
+  smart_render_ = params_.video_enabled()
+      && params_.video_smart_render()
+      && encoder_
+      && deliverables_.isEmpty()
+      && !segmented
+      && !write_unordered_
+      && video_force_size.isNull()
+      && !params_.color_transform().is_display()
+      && ExportCodec::IsCodecIntraOnly(params_.video_codec());
 
-    // Create color processor
-    color_processor_ = ColorProcessor::Create(color_manager_,
-                                              color_manager_->GetReferenceColorSpace(),
-                                              params_.color_transform());
+  if (smart_render_) {
+    passthrough_traverser_.SetCacheVideoParams(video_params());
+    passthrough_traverser_.SetRenderMode(RenderMode::kOnline);
   }
 
   // Start render process
@@ -116,20 +235,89 @@ bool ExportTask::Run()
     subtitle_range = range;
   }
 
-  Render(color_manager_, video_range, audio_range, subtitle_range, RenderMode::kOnline, nullptr,
-         video_force_size, video_force_matrix, encoder_->GetDesiredPixelFormat(),
-         color_processor_);
+  SetExtraFrameOutputs(deliverable_outputs);
 
   bool success = true;
 
-  encoder_->Close();
+  QStringList segment_filenames;
+
+  if (chunk_length_ > 0) {
+    if (!RenderChunks(range, video_force_size, video_force_matrix, &segment_filenames)) {
+      success = false;
+    }
+
+    // Audio and subtitles are cheap next to video, so they're always rendered again in full
+    if (success && encoder_ && !IsCancelled()) {
+      Render(color_manager_, TimeRangeList(), audio_range, subtitle_range, RenderMode::kOnline, nullptr);
+    }
+  } else {
+    SetVideoSegmentCount(segments_.isEmpty() ? 1 : segments_.size());
+
+    VideoParams::Format desired_format = segments_.isEmpty() ? encoder_->GetDesiredPixelFormat()
+                                                             : segments_.first().encoder->GetDesiredPixelFormat();
 
-  if (!encoder_->GetError().isEmpty()) {
-    SetError(encoder_->GetError());
+    // Shared cache workers save frames for other exports to encode, so those stay RGB(A)
+    if (shared_cache_role_ != kSharedCacheWorker) {
+      SetPlanarYUV(segments_.isEmpty() ? encoder_->GetDesiredPlanarYUV()
+                                       : segments_.first().encoder->GetDesiredPlanarYUV());
+    }
+
+    Render(color_manager_, video_range, audio_range, subtitle_range, RenderMode::kOnline, nullptr,
+           video_force_size, video_force_matrix, desired_format,
+           color_processor_);
+  }
+
+  ReapUnorderedWrites(true);
+
+  foreach (const Segment& s, segments_) {
+    segment_filenames.append(s.encoder->params().filename());
+  }
+
+  if (!CloseSegments(false)) {
     success = false;
   }
 
-  delete encoder_;
+  if (encoder_) {
+    encoder_->Close();
+
+    if (!encoder_->GetError().isEmpty()) {
+      SetError(encoder_->GetError());
+      success = false;
+    }
+
+    delete encoder_;
+    encoder_ = nullptr;
+  }
+
+  if (segmented && !params_.video_is_image_sequence()) {
+    // Join segments (and audio/subtitles if any) into the final file
+    if (success && !IsCancelled()) {
+      QString concat_error;
+      if (!FFmpegEncoder::ConcatenateSegments(segment_filenames, extra_streams_filename, params_.filename(), &concat_error)) {
+        SetError(concat_error);
+        success = false;
+      }
+    }
+
+    if (chunk_length_ > 0) {
+      // Finished chunks are kept until the export succeeds so running it again can use them
+      if (success && !IsCancelled()) {
+        QDir(checkpoint_path_).removeRecursively();
+      }
+    } else {
+      foreach (const QString& f, segment_filenames) {
+        QFile::remove(f);
+      }
+    }
+
+    if (!extra_streams_filename.isEmpty()) {
+      QFile::remove(extra_streams_filename);
+    }
+  }
+
+  if (!CloseDeliverables(IsCancelled())) {
+    success = false;
+  }
 
   // If cancelled, delete the file we made, which is always a file we created since we write to a
   // temp file during the actual encoding process
@@ -147,11 +335,390 @@ bool ExportTask::Run()
   return success;
 }
 
+void ExportTask::PrepareVideoRender(QSize *force_size, QMatrix4x4 *force_matrix)
+{
+  // If a transformation matrix is applied to this video, create it here
+  VideoParams vp = viewer()->GetVideoParams();
+  if (vp.width() != params_.video_params().width()
+      || vp.height() != params_.video_params().height()) {
+    *force_size = QSize(params_.video_params().width(), params_.video_params().height());
+
+    if (params_.video_scaling_method() != ExportParams::kStretch) {
+      *force_matrix = ExportParams::GenerateMatrix(params_.video_scaling_method(),
+                                                   vp.width(),
+                                                   vp.height(),
+                                                   params_.video_params().width(),
+                                                   params_.video_params().height());
+    }
+  } else {
+    // Disables forcing size in the renderer
+    *force_size = QSize(0, 0);
+  }
+
+  // Create color processor
+  color_processor_ = ColorProcessor::Create(color_manager_,
+                                            color_manager_->GetReferenceColorSpace(),
+                                            params_.color_transform());
+}
+
+void ExportTask::AddDeliverable(const ExportParams &params)
+{
+  Deliverable d;
+
+  d.params = params;
+  d.encoder = nullptr;
+  d.frame_time = 0;
+
+  deliverables_.append(d);
+}
+
+bool ExportTask::OpenDeliverables(RenderManager::FrameOutputList *outputs)
+{
+  VideoParams vp = viewer()->GetVideoParams();
+
+  for (int i=0; i<deliverables_.size(); i++) {
+    Deliverable& d = deliverables_[i];
+
+    // Everything is only rendered once, so deliverables can't have anything the export doesn't
+    if ((d.params.video_enabled() && !params_.video_enabled())
+        || (d.params.audio_enabled() && !params_.audio_enabled())
+        || (d.params.subtitles_enabled() && !params_.subtitles_enabled())) {
+      SetError(tr("\"%1\" has streams that the export doesn't").arg(d.params.filename()));
+      return false;
+    }
+
+    if (d.params.video_enabled()
+        && d.params.video_params().frame_rate_as_time_base() != video_params().frame_rate_as_time_base()) {
+      SetError(tr("\"%1\" must have the same frame rate as the export").arg(d.params.filename()));
+      return false;
+    }
+
+    if (d.params.audio_enabled()) {
+      d.params.EnableAudio(audio_params(), d.params.audio_codec());
+    }
+
+    // Written to a temporary file first for the same reason as the export itself
+    d.real_filename = d.params.filename();
+    if (QFileInfo::exists(d.real_filename)) {
+      d.params.SetFilename(FileFunctions::GetSafeTemporaryFilename(d.real_filename));
+    }
+
+    d.encoder = Encoder::CreateFromID(d.params.encoder(), d.params);
+
+    if (!d.encoder) {
+      SetError(tr("Failed to create encoder"));
+      return false;
+    }
+
+    if (!d.encoder->Open()) {
+      SetError(tr("Failed to open file: %1").arg(d.encoder->GetError()));
+      return false;
+    }
+
+    if (d.params.video_enabled()) {
+      const VideoParams& dvp = d.params.video_params();
+
+      RenderManager::FrameOutput output;
+
+      // Frames are rendered at the export's size, so this is always needed
+      output.force_size = QSize(dvp.width(), dvp.height());
+
+      if ((vp.width() != dvp.width() || vp.height() != dvp.height())
+          && d.params.video_scaling_method() != ExportParams::kStretch) {
+        output.force_matrix = ExportParams::GenerateMatrix(d.params.video_scaling_method(),
+                                                           vp.width(),
+                                                           vp.height(),
+                                                           dvp.width(),
+                                                           dvp.height());
+      }
+
+      output.force_format = d.encoder->GetDesiredPixelFormat();
+      output.force_color_output = ColorProcessor::Create(color_manager_,
+                                                         color_manager_->GetReferenceColorSpace(),
+                                                         d.params.color_transform());
+      output.force_yuv = d.encoder->GetDesiredPlanarYUV();
+
+      outputs->append(output);
+      deliverable_outputs_.append(i);
+    }
+  }
+
+  return true;
+}
+
+bool ExportTask::CloseDeliverables(bool remove_files)
+{
+  bool success = true;
+
+  for (int i=0; i<deliverables_.size(); i++) {
+    Deliverable& d = deliverables_[i];
+
+    foreach (const FramePtr& f, d.time_map) {
+      UnbufferFrame(f);
+    }
+    d.time_map.clear();
+
+    if (!d.encoder) {
+      continue;
+    }
+
+    d.encoder->Close();
+
+    if (!d.encoder->GetError().isEmpty()) {
+      SetError(d.encoder->GetError());
+      success = false;
+    }
+
+    delete d.encoder;
+    d.encoder = nullptr;
+
+    if (remove_files) {
+      QFile::remove(d.params.filename());
+    } else if (d.params.filename() != d.real_filename
+               && !FileFunctions::RenameFileAllowOverwrite(d.params.filename(), d.real_filename)) {
+      SetError(tr("Failed to overwrite \"%1\". Export has been saved as \"%2\" instead.")
+               .arg(d.real_filename, d.params.filename()));
+      success = false;
+    }
+  }
+
+  return success;
+}
+
+void ExportTask::WriteDeliverableFrames(Deliverable &d)
+{
+  const rational& timebase = video_params().frame_rate_as_time_base();
+
+  while (!IsCancelled()) {
+    rational real_time = Timecode::timestamp_to_time(d.frame_time, timebase);
+
+    if (!d.time_map.contains(real_time)) {
+      break;
+    }
+
+    FramePtr frame = d.time_map.take(real_time);
+    UnbufferFrame(frame);
+    d.encoder->WriteFrame(frame, real_time);
+
+    d.frame_time++;
+  }
+}
+
+bool ExportTask::RunSharedCacheWorker(const TimeRange &range)
+{
+  if (!params_.video_enabled()) {
+    // Audio and subtitles are cheap enough for the assembler to do itself
+    return true;
+  }
+
+  if (!QDir().mkpath(GetSharedCacheClaimDirectory())) {
+    SetError(tr("Failed to access shared cache \"%1\"").arg(shared_cache_path_));
+    return false;
+  }
+
+  QSize video_force_size;
+  QMatrix4x4 video_force_matrix;
+  PrepareVideoRender(&video_force_size, &video_force_matrix);
+
+  shared_cache_frames_done_ = 0;
+
+  // Frames are stored in the sequence's own format, the assembler's encoder converts them
+  Render(color_manager_, {range}, TimeRangeList(), TimeRange(), RenderMode::kOnline, nullptr,
+         video_force_size, video_force_matrix, VideoParams::kFormatInvalid,
+         color_processor_);
+
+  // Claims are only needed until the frames they cover are on disk
+  FrameHashCache::WaitForPendingWrites();
+  ReleaseSharedCacheClaims();
+
+  return !IsCancelled();
+}
+
+QByteArray ExportTask::GetSharedCacheKey(const QByteArray &hash) const
+{
+  QCryptographicHash key(QCryptographicHash::Sha1);
+  key.addData(hash);
+  key.addData(shared_cache_settings_);
+  return key.result();
+}
+
+QString ExportTask::GetSharedCacheClaimDirectory() const
+{
+  return QDir(shared_cache_path_).filePath(QStringLiteral("claims"));
+}
+
+void ExportTask::ReleaseSharedCacheClaims()
+{
+  QDir claim_dir(GetSharedCacheClaimDirectory());
+
+  foreach (const QString& claim, shared_cache_claims_) {
+    claim_dir.rmdir(claim);
+  }
+
+  shared_cache_claims_.clear();
+}
+
+bool ExportTask::ClaimFrame(const QByteArray &hash)
+{
+  if (shared_cache_role_ != kSharedCacheWorker) {
+    return true;
+  }
+
+  QByteArray key = GetSharedCacheKey(hash);
+  bool claimed = false;
+
+  if (!FrameHashCache::CacheFrameExists(shared_cache_path_, key)) {
+    // Creating a directory is atomic even on most network filesystems, so whoever manages to
+    // create it owns the frame
+    QDir claim_dir(GetSharedCacheClaimDirectory());
+    QString claim = QString::fromLatin1(key.toHex());
+
+    claimed = claim_dir.mkdir(claim);
+
+    if (!claimed) {
+      // Take the frame over if whoever claimed it seems to have died
+      QFileInfo claim_info(claim_dir.filePath(claim));
+
+      if (claim_info.exists()
+          && claim_info.lastModified().msecsTo(QDateTime::currentDateTime()) > kSharedCacheClaimTimeout
+          && claim_dir.rmdir(claim)) {
+        claimed = claim_dir.mkdir(claim);
+      }
+    }
+
+    if (claimed) {
+      shared_cache_claims_.append(claim);
+    }
+  }
+
+  if (!claimed) {
+    // Someone else has or will render this frame, count it as done
+    shared_cache_frames_done_++;
+    emit ProgressChanged(double(shared_cache_frames_done_) / double(GetTotalNumberOfUniqueFrames()));
+  }
+
+  return claimed;
+}
+
+FramePtr ExportTask::GetPrerenderedFrame(const QByteArray &hash)
+{
+  if (shared_cache_role_ != kSharedCacheAssembler) {
+    return nullptr;
+  }
+
+  QByteArray key = GetSharedCacheKey(hash);
+
+  if (!FrameHashCache::CacheFrameExists(shared_cache_path_, key)) {
+    // A worker never got to this frame, render it here instead
+    return nullptr;
+  }
+
+  return FrameHashCache::LoadCacheFrame(shared_cache_path_, key);
+}
+
 void ExportTask::FrameDownloaded(FramePtr f, const QByteArray &hash, const QVector<rational> &times, qint64 job_time)
 {
   Q_UNUSED(job_time)
+
+  if (shared_cache_role_ == kSharedCacheWorker) {
+    if (!FrameHashCache::SaveCacheFrameAsync(shared_cache_path_, GetSharedCacheKey(hash), f)) {
+      qWarning() << "Failed to queue frame for shared cache" << hash.toHex();
+    }
+
+    shared_cache_frames_done_++;
+    emit ProgressChanged(double(shared_cache_frames_done_) / double(GetTotalNumberOfUniqueFrames()));
+    return;
+  }
+
+  if (!segments_.isEmpty()) {
+    const rational& timebase = video_params().frame_rate_as_time_base();
+
+    foreach (const rational& t, times) {
+      rational actual_time = t;
+
+      if (params_.has_custom_range()) {
+        actual_time -= params_.custom_range().in();
+      }
+
+      int64_t index = Timecode::time_to_timestamp(actual_time, timebase);
+
+      for (int i=0; i<segments_.size(); i++) {
+        Segment& s = segments_[i];
+
+        if (index < s.end) {
+          s.pending.insert(index, f);
+          BufferFrame(f);
+
+          if (s.chunk >= 0) {
+            s.hashes[int(index - s.start)] = hash;
+          }
+          break;
+        }
+      }
+    }
+
+    for (int i=0; i<segments_.size() && !IsCancelled(); i++) {
+      WriteSegment(segments_[i], false);
+    }
+
+    return;
+  }
+
+  foreach (const rational& t, times) {
+    rational actual_time = t;
+
+    if (params_.has_custom_range()) {
+      actual_time -= params_.custom_range().in();
+    }
+
+    if (write_unordered_) {
+      WriteFrameUnordered(f, actual_time);
+    } else {
+      time_map_.insert(actual_time, f);
+      BufferFrame(f);
+    }
+  }
+
+  if (write_unordered_) {
+    ReapUnorderedWrites(false);
+    return;
+  }
+
+  WriteOrderedFrames();
+}
+
+bool ExportTask::PassthroughFrame(const rational &time, const QByteArray &hash, const QVector<rational> &times)
+{
   Q_UNUSED(hash)
 
+  if (!smart_render_) {
+    return false;
+  }
+
+  FootageJob job;
+  rational footage_time;
+
+  if (!passthrough_traverser_.FindSourceFrame(viewer()->GetConnectedTextureOutput(),
+                                              TimeRange(time, time + video_params().frame_rate_as_time_base()),
+                                              &job, &footage_time)) {
+    return false;
+  }
+
+  // The frame is copied as-is, so nothing the render would have done to it may differ. The encoder
+  // checks the stream's codec, pixel format and dimensions itself.
+  const VideoParams& footage_params = job.video_params();
+
+  if (job.decoder() != QStringLiteral("ffmpeg")
+      || footage_params.video_type() != VideoParams::kVideoTypeVideo
+      || footage_params.colorspace() != params_.color_transform().output()
+      || footage_params.pixel_aspect_ratio() != video_params().pixel_aspect_ratio()
+      || footage_params.interlacing() != video_params().interlacing()
+      || !encoder_->CanPassthrough(job.filename(), footage_params.stream_index())) {
+    return false;
+  }
+
+  PassthroughSource source = {job.filename(), footage_params.stream_index(), footage_time};
+
   foreach (const rational& t, times) {
     rational actual_time = t;
 
@@ -159,26 +726,61 @@ void ExportTask::FrameDownloaded(FramePtr f, const QByteArray &hash, const QVect
       actual_time -= params_.custom_range().in();
     }
 
-    time_map_.insert(actual_time, f);
+    passthrough_map_.insert(actual_time, source);
   }
 
+  WriteOrderedFrames();
+
+  return true;
+}
+
+void ExportTask::WriteOrderedFrames()
+{
   while (!IsCancelled()) {
     rational real_time = Timecode::timestamp_to_time(frame_time_,
                                                      video_params().frame_rate_as_time_base());
 
-    if (!time_map_.contains(real_time)) {
-      break;
-    }
-
     // Unfortunately this can't be done in another thread since the frames need to be sent
     // one after the other chronologically.
-    encoder_->WriteFrame(time_map_.take(real_time), real_time);
+    if (time_map_.contains(real_time)) {
+      FramePtr frame = time_map_.take(real_time);
+      UnbufferFrame(frame);
+      encoder_->WriteFrame(frame, real_time);
+    } else if (passthrough_map_.contains(real_time)) {
+      PassthroughSource source = passthrough_map_.take(real_time);
+      encoder_->WritePassthroughFrame(source.filename, source.stream, source.time, real_time);
+    } else {
+      break;
+    }
 
     frame_time_++;
     emit ProgressChanged(double(frame_time_) / double(GetTotalNumberOfFrames()));
   }
 }
 
+void ExportTask::ExtraFramesDownloaded(const QVector<FramePtr> &frames, const QByteArray &hash, const QVector<rational> &times)
+{
+  Q_UNUSED(hash)
+
+  for (int i=0; i<frames.size() && i<deliverable_outputs_.size(); i++) {
+    Deliverable& d = deliverables_[deliverable_outputs_.at(i)];
+    const FramePtr& f = frames.at(i);
+
+    foreach (const rational& t, times) {
+      rational actual_time = t;
+
+      if (params_.has_custom_range()) {
+        actual_time -= params_.custom_range().in();
+      }
+
+      d.time_map.insert(actual_time, f);
+      BufferFrame(f);
+    }
+
+    WriteDeliverableFrames(d);
+  }
+}
+
 void ExportTask::AudioDownloaded(const TimeRange &range, SampleBufferPtr samples, qint64 job_time)
 {
   Q_UNUSED(job_time)
@@ -189,38 +791,445 @@ void ExportTask::AudioDownloaded(const TimeRange &range, SampleBufferPtr samples
     adjusted_range -= params_.custom_range().in();
   }
 
-  if (adjusted_range.in() == audio_time_) {
-    WriteAudioLoop(adjusted_range, samples);
-  } else {
-    audio_map_.insert(adjusted_range, samples);
+  pending_audio_.insert(adjusted_range.in(), {adjusted_range.out(), samples});
+  WriteOrderedAudio();
+}
+
+void ExportTask::WriteFrameUnordered(const FramePtr &frame, const rational &time)
+{
+  // Don't let writes pile up further than the pool can keep up with
+  while (unordered_writes_.size() >= writer_pool_.maxThreadCount() * 2) {
+    unordered_writes_.first().future.waitForFinished();
+    ReapUnorderedWrites(false);
   }
+
+  BufferFrame(frame);
+
+  Encoder* encoder = encoder_;
+  unordered_writes_.append({frame, time, QtConcurrent::run(&writer_pool_, [encoder, frame, time]{
+    return encoder->WriteFrame(frame, time);
+  })});
 }
 
-void ExportTask::EncodeSubtitle(const SubtitleBlock *sub)
+void ExportTask::ReapUnorderedWrites(bool wait)
 {
-  encoder_->WriteSubtitle(sub);
+  for (auto it=unordered_writes_.begin(); it!=unordered_writes_.end(); ) {
+    if (wait) {
+      it->future.waitForFinished();
+    } else if (!it->future.isFinished()) {
+      it++;
+      continue;
+    }
+
+    if (!it->future.result()) {
+      SetError(tr("Failed to write %1").arg(encoder_->GetFilenameForFrame(it->time)));
+    }
+
+    UnbufferFrame(it->frame);
+    it = unordered_writes_.erase(it);
+
+    frame_time_++;
+    emit ProgressChanged(double(frame_time_) / double(GetTotalNumberOfFrames()));
+  }
 }
 
-void ExportTask::WriteAudioLoop(const TimeRange& time, SampleBufferPtr samples)
+bool ExportTask::OpenSegments(int64_t frame_count)
 {
-  encoder_->WriteAudio(samples);
-  audio_time_ = time.out();
+  int segment_count = static_cast<int>(qMin(frame_count, int64_t(params_.video_segments())));
 
-  for (auto it=audio_map_.begin(); it!=audio_map_.end(); it++) {
-    TimeRange t = it.key();
-    SampleBufferPtr s = it.value();
+  for (int i=0; i<segment_count; i++) {
+    // Each segment goes to its own file, created as it's opened so the next temporary name is different
+    QString filename = params_.video_is_image_sequence() ? params_.filename()
+                                                         : FileFunctions::GetSafeTemporaryFilename(params_.filename());
 
-    if (t.in() == audio_time_) {
-      // Erase from audio map since we're just about to write it
-      audio_map_.erase(it);
+    if (!OpenSegment(filename,
+                     GetSegmentStart(frame_count, segment_count, i),
+                     GetSegmentStart(frame_count, segment_count, i+1),
+                     -1)) {
+      return false;
+    }
+  }
 
-      // Call recursively to write the next sample buffer
-      WriteAudioLoop(t, s);
+  return true;
+}
 
-      // Break out of loop
-      break;
+bool ExportTask::OpenChunkSegments(const QVector<int> &chunks)
+{
+  foreach (int chunk, chunks) {
+    if (!OpenSegment(GetChunkFilename(chunk), GetChunkStart(chunk), GetChunkStart(chunk + 1), chunk)) {
+      return false;
     }
   }
+
+  return true;
+}
+
+bool ExportTask::OpenSegment(const QString &filename, int64_t start, int64_t end, int chunk)
+{
+  EncodingParams segment_params = params_;
+  segment_params.DisableAudio();
+  segment_params.DisableSubtitles();
+  segment_params.SetFilename(filename);
+
+  Segment s;
+  s.encoder = Encoder::CreateFromID(params_.encoder(), segment_params);
+  s.start = start;
+  s.end = end;
+  s.next = s.start;
+  s.chunk = chunk;
+
+  if (chunk >= 0) {
+    s.hashes.resize(int(end - start));
+  }
+
+  if (!s.encoder) {
+    SetError(tr("Failed to create encoder"));
+    return false;
+  }
+
+  segments_.append(s);
+
+  if (!s.encoder->Open()) {
+    SetError(tr("Failed to open file: %1").arg(s.encoder->GetError()));
+    return false;
+  }
+
+  return true;
+}
+
+void ExportTask::WriteSegment(Segment &segment, bool wait)
+{
+  if (segment.writing.isRunning()) {
+    // Allow a few frames to build up while the encoder is busy, but not indefinitely
+    if (!wait && segment.pending.size() < HardwareProfile::GetFramesInFlight()) {
+      return;
+    }
+
+    segment.writing.waitForFinished();
+  }
+
+  QVector<FramePtr> frames;
+  QVector<rational> frame_times;
+  const rational& timebase = video_params().frame_rate_as_time_base();
+
+  while (segment.pending.contains(segment.next)) {
+    frames.append(segment.pending.take(segment.next));
+    UnbufferFrame(frames.last());
+
+    // Image sequences name files by time, everything else starts each segment at 0
+    int64_t ts = params_.video_is_image_sequence() ? segment.next : segment.next - segment.start;
+    frame_times.append(Timecode::timestamp_to_time(ts, timebase));
+
+    segment.next++;
+  }
+
+  if (frames.isEmpty()) {
+    return;
+  }
+
+  Encoder* encoder = segment.encoder;
+  segment.writing = QtConcurrent::run([encoder, frames, frame_times]{
+    for (int i=0; i<frames.size(); i++) {
+      encoder->WriteFrame(frames.at(i), frame_times.at(i));
+    }
+  });
+
+  frame_time_ += frames.size();
+  emit ProgressChanged(double(frame_time_) / double(frame_count_));
+}
+
+bool ExportTask::CloseSegments(bool remove_files)
+{
+  bool success = true;
+
+  for (int i=0; i<segments_.size(); i++) {
+    Segment& s = segments_[i];
+
+    // Write out whatever is left
+    if (!IsCancelled()) {
+      WriteSegment(s, true);
+    }
+
+    s.writing.waitForFinished();
+
+    s.encoder->Close();
+
+    bool segment_ok = s.encoder->GetError().isEmpty();
+
+    if (!segment_ok) {
+      SetError(s.encoder->GetError());
+      success = false;
+    }
+
+    if (s.chunk >= 0) {
+      // Chunks are kept for the checkpoint only if they were written in full
+      if (segment_ok && !remove_files && !IsCancelled() && s.next == s.end) {
+        finished_chunks_.insert(s.chunk, GetChunkDigest(s.hashes));
+      } else {
+        QFile::remove(s.encoder->params().filename());
+      }
+    } else if (remove_files && !params_.video_is_image_sequence()) {
+      QFile::remove(s.encoder->params().filename());
+    }
+
+    delete s.encoder;
+  }
+
+  segments_.clear();
+
+  return success;
+}
+
+bool ExportTask::RenderChunks(const TimeRange &range, const QSize &force_size, const QMatrix4x4 &force_matrix,
+                              QStringList *chunk_filenames)
+{
+  const rational& timebase = video_params().frame_rate_as_time_base();
+  int chunk_count = int((frame_count_ + chunk_length_ - 1) / chunk_length_);
+
+  QVector<int> remaining;
+
+  for (int i=0; i<chunk_count; i++) {
+    chunk_filenames->append(GetChunkFilename(i));
+
+    if (finished_chunks_.contains(i)) {
+      frame_time_ += GetChunkStart(i + 1) - GetChunkStart(i);
+    } else {
+      remaining.append(i);
+    }
+  }
+
+  if (frame_time_ > 0) {
+    emit ProgressChanged(double(frame_time_) / double(frame_count_));
+  }
+
+  // Encode as many chunks at once as the export would have used segments
+  int group_size = qMax(1, params_.video_segments());
+
+  for (int i=0; i<remaining.size() && !IsCancelled(); i+=group_size) {
+    if (!OpenChunkSegments(remaining.mid(i, group_size))) {
+      CloseSegments(true);
+      return false;
+    }
+
+    TimeRangeList video_range;
+    foreach (const Segment& s, segments_) {
+      video_range.insert(TimeRange(range.in() + Timecode::timestamp_to_time(s.start, timebase),
+                                   range.in() + Timecode::timestamp_to_time(s.end, timebase)));
+    }
+
+    SetVideoSegmentCount(segments_.size());
+    SetPlanarYUV(segments_.first().encoder->GetDesiredPlanarYUV());
+
+    Render(color_manager_, video_range, TimeRangeList(), TimeRange(), RenderMode::kOnline, nullptr,
+           force_size, force_matrix, segments_.first().encoder->GetDesiredPixelFormat(),
+           color_processor_);
+
+    bool closed = CloseSegments(false);
+
+    // Record whatever did get finished, even if something else failed
+    if (!SaveCheckpoint()) {
+      qWarning() << "Failed to save export checkpoint to" << checkpoint_path_;
+    }
+
+    if (!closed) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+QString ExportTask::GetCheckpointPath(const QString &filename)
+{
+  return filename + QStringLiteral(".resume");
+}
+
+QString ExportTask::GetChunkFilename(int chunk) const
+{
+  QString suffix = QFileInfo(params_.filename()).completeSuffix();
+
+  return QDir(checkpoint_path_).filePath(QStringLiteral("%1.%2").arg(QString::number(chunk), suffix));
+}
+
+void ExportTask::LoadCheckpoint(const QString &filename, const TimeRange &range)
+{
+  checkpoint_path_ = GetCheckpointPath(filename);
+  finished_chunks_.clear();
+
+  // Anything that would change the encoded chunks invalidates all of them
+  ExportParams checkpoint_params = params_;
+  checkpoint_params.SetFilename(filename);
+
+  QByteArray params_data;
+
+  {
+    QBuffer buffer(&params_data);
+    buffer.open(QBuffer::WriteOnly);
+
+    XMLWriter writer(&buffer, XMLWriter::kBinary);
+    writer.writeStartDocument();
+    checkpoint_params.Save(&writer);
+    writer.writeEndDocument();
+  }
+
+  QCryptographicHash settings(QCryptographicHash::Sha1);
+  settings.addData(params_data);
+  settings.addData(shared_cache_settings_);
+  settings.addData(QByteArray::number(qlonglong(chunk_length_)));
+  checkpoint_settings_ = settings.result().toHex();
+
+  QFile file(QDir(checkpoint_path_).filePath(QStringLiteral("checkpoint.json")));
+
+  if (!file.open(QFile::ReadOnly)) {
+    return;
+  }
+
+  QJsonObject checkpoint = QJsonDocument::fromJson(file.readAll()).object();
+  file.close();
+
+  if (checkpoint.value(QStringLiteral("settings")).toString().toLatin1() != checkpoint_settings_) {
+    // Left by an export with other settings, none of it can be used
+    QDir(checkpoint_path_).removeRecursively();
+    return;
+  }
+
+  const rational& timebase = video_params().frame_rate_as_time_base();
+  NodeOutput texture_output = GetTextureOutput();
+
+  foreach (const QJsonValue& v, checkpoint.value(QStringLiteral("chunks")).toArray()) {
+    if (IsCancelled()) {
+      return;
+    }
+
+    QJsonObject chunk = v.toObject();
+    int index = chunk.value(QStringLiteral("index")).toInt();
+    int64_t start = GetChunkStart(index);
+    int64_t end = GetChunkStart(index + 1);
+
+    // The sequence may have changed length since
+    if (start >= end
+        || chunk.value(QStringLiteral("start")).toDouble() != double(start)
+        || chunk.value(QStringLiteral("end")).toDouble() != double(end)
+        || !QFileInfo::exists(GetChunkFilename(index))) {
+      continue;
+    }
+
+    QVector<QByteArray> hashes(int(end - start));
+    for (int64_t j=start; j<end; j++) {
+      hashes[int(j - start)] = RenderManager::Hash(texture_output, video_params(),
+                                                   range.in() + Timecode::timestamp_to_time(j, timebase));
+    }
+
+    QByteArray digest = GetChunkDigest(hashes);
+
+    if (digest.toHex() == chunk.value(QStringLiteral("hashes")).toString().toLatin1()) {
+      finished_chunks_.insert(index, digest);
+    }
+  }
+}
+
+bool ExportTask::SaveCheckpoint()
+{
+  QJsonArray chunks;
+
+  for (auto it=finished_chunks_.cbegin(); it!=finished_chunks_.cend(); it++) {
+    QJsonObject chunk;
+    chunk.insert(QStringLiteral("index"), it.key());
+    chunk.insert(QStringLiteral("start"), double(GetChunkStart(it.key())));
+    chunk.insert(QStringLiteral("end"), double(GetChunkStart(it.key() + 1)));
+    chunk.insert(QStringLiteral("hashes"), QString::fromLatin1(it.value().toHex()));
+    chunks.append(chunk);
+  }
+
+  QJsonObject checkpoint;
+  checkpoint.insert(QStringLiteral("settings"), QString::fromLatin1(checkpoint_settings_));
+  checkpoint.insert(QStringLiteral("chunks"), chunks);
+
+  // Written next to the old one and swapped in, so a crash never leaves a half written checkpoint
+  QString filename = QDir(checkpoint_path_).filePath(QStringLiteral("checkpoint.json"));
+  QString working_filename = filename + QStringLiteral(".working");
+
+  QFile file(working_filename);
+
+  if (!file.open(QFile::WriteOnly)) {
+    return false;
+  }
+
+  bool written = file.write(QJsonDocument(checkpoint).toJson()) != -1;
+  file.close();
+
+  return written && FileFunctions::RenameFileAllowOverwrite(working_filename, filename);
+}
+
+QByteArray ExportTask::GetChunkDigest(const QVector<QByteArray> &hashes)
+{
+  QCryptographicHash digest(QCryptographicHash::Sha1);
+
+  foreach (const QByteArray& h, hashes) {
+    digest.addData(h);
+  }
+
+  return digest.result();
+}
+
+void ExportTask::BufferFrame(const FramePtr &f)
+{
+  if (!f) {
+    return;
+  }
+
+  int& refs = buffered_frames_[f.get()];
+
+  if (refs == 0) {
+    buffered_bytes_ += f->allocated_size();
+  }
+
+  refs++;
+}
+
+void ExportTask::UnbufferFrame(const FramePtr &f)
+{
+  auto it = buffered_frames_.find(f.get());
+
+  if (!f || it == buffered_frames_.end()) {
+    return;
+  }
+
+  it.value()--;
+
+  if (it.value() == 0) {
+    buffered_bytes_ -= f->allocated_size();
+    buffered_frames_.erase(it);
+  }
+}
+
+void ExportTask::EncodeSubtitle(const SubtitleCue &cue)
+{
+  encoder_->WriteSubtitle(cue);
+
+  foreach (const Deliverable& d, deliverables_) {
+    if (d.params.subtitles_enabled()) {
+      d.encoder->WriteSubtitle(cue);
+    }
+  }
+}
+
+void ExportTask::WriteOrderedAudio()
+{
+  auto it = pending_audio_.begin();
+
+  while (it != pending_audio_.end() && it.key() == audio_time_) {
+    encoder_->WriteAudio(it->samples);
+
+    foreach (const Deliverable& d, deliverables_) {
+      if (d.params.audio_enabled()) {
+        d.encoder->WriteAudio(it->samples);
+      }
+    }
+
+    audio_time_ = it->out;
+    it = pending_audio_.erase(it);
+  }
 }
 
 }
@@ -23,6 +23,7 @@
 
 #include "exportparams.h"
 #include "node/output/viewer/viewer.h"
+#include "passthroughtraverser.h"
 #include "render/colorprocessor.h"
 #include "task/render/render.h"
 #include "task/task.h"
@@ -35,6 +36,44 @@ class ExportTask : public RenderTask
 public:
   ExportTask(ViewerOutput *viewer_node, ColorManager *color_manager, const ExportParams &params);
 
+  /**
+   * @brief How this export uses a frame cache folder shared between several processes
+   *
+   * Workers render whichever frames no other worker has claimed yet into the folder without
+   * encoding anything. The assembler then encodes from the folder, rendering any frames that are
+   * still missing itself. Frames are stored under their render hash combined with the export's
+   * output settings, so workers need no coordination beyond claiming hashes.
+   */
+  enum SharedCacheRole {
+    kSharedCacheNone,
+    kSharedCacheWorker,
+    kSharedCacheAssembler
+  };
+
+  /**
+   * @brief Split this export across processes using a shared cache folder
+   *
+   * The folder should be marked as shared (see DiskCacheFolder::IsSharedPath()) so that nobody
+   * reads a partially written frame, and should use a lossless codec since the assembler encodes
+   * straight from it.
+   */
+  void SetSharedCache(const QString& path, SharedCacheRole role)
+  {
+    shared_cache_path_ = path;
+    shared_cache_role_ = role;
+  }
+
+  /**
+   * @brief Also encode this export to another set of outputs from the same render
+   *
+   * Each frame is only rendered once and then scaled and color converted on the GPU for each
+   * deliverable, so a master, a web copy and a proxy cost little more than the master alone.
+   * Deliverables use this export's range, frame rate and audio parameters, and can only have
+   * streams this export has too. They can't be combined with a shared cache, and disable smart
+   * rendering.
+   */
+  void AddDeliverable(const ExportParams& params);
+
 protected:
   virtual bool Run() override;
 
@@ -42,19 +81,280 @@ protected:
 
   virtual void AudioDownloaded(const TimeRange& range, SampleBufferPtr samples, qint64 job_time) override;
 
-  virtual void EncodeSubtitle(const SubtitleBlock *sub) override;
+  virtual void ExtraFramesDownloaded(const QVector<FramePtr>& frames, const QByteArray& hash, const QVector<rational>& times) override;
+
+  virtual void EncodeSubtitle(const SubtitleCue &cue) override;
 
   virtual bool TwoStepFrameRendering() const override
   {
     return false;
   }
 
+  virtual bool IsFrameBufferFull() const override
+  {
+    return buffered_bytes_ >= buffer_budget_;
+  }
+
+  virtual bool ClaimFrame(const QByteArray& hash) override;
+
+  virtual FramePtr GetPrerenderedFrame(const QByteArray& hash) override;
+
+  virtual bool PassthroughFrame(const rational& time, const QByteArray& hash, const QVector<rational>& times) override;
+
 private:
-  void WriteAudioLoop(const TimeRange &time, SampleBufferPtr samples);
+  /**
+   * @brief Work out how video must be resized to match the export's dimensions
+   *
+   * Also creates the color processor for the export's color transform.
+   */
+  void PrepareVideoRender(QSize* force_size, QMatrix4x4* force_matrix);
+
+  /**
+   * @brief An extra set of outputs encoded from this export's render
+   */
+  struct Deliverable
+  {
+    ExportParams params;
+
+    // Filename to move the finished file to if `params` had to write somewhere else
+    QString real_filename;
+
+    Encoder* encoder;
+
+    QHash<rational, FramePtr> time_map;
+
+    int64_t frame_time;
+  };
+
+  /**
+   * @brief Check deliverables against this export and open their encoders
+   *
+   * Also works out the frame output each deliverable with video needs from the render.
+   */
+  bool OpenDeliverables(RenderManager::FrameOutputList* outputs);
+
+  /**
+   * @brief Close every deliverable's encoder and move its file into place
+   *
+   * If `remove_files` is true, the files are deleted instead.
+   */
+  bool CloseDeliverables(bool remove_files);
+
+  void WriteDeliverableFrames(Deliverable& d);
+
+  QVector<Deliverable> deliverables_;
+
+  // Index in deliverables_ of each extra frame output given to the render
+  QVector<int> deliverable_outputs_;
+
+  /**
+   * @brief Render unclaimed frames into the shared cache without encoding anything
+   */
+  bool RunSharedCacheWorker(const TimeRange& range);
+
+  /**
+   * @brief Get the name a frame is stored under in the shared cache
+   *
+   * The render hash alone doesn't cover the export's own scaling and color transform, which are
+   * applied to every frame stored there.
+   */
+  QByteArray GetSharedCacheKey(const QByteArray& hash) const;
+
+  QString GetSharedCacheClaimDirectory() const;
+
+  void ReleaseSharedCacheClaims();
+
+  QString shared_cache_path_;
+
+  SharedCacheRole shared_cache_role_;
+
+  QByteArray shared_cache_settings_;
+
+  QStringList shared_cache_claims_;
+
+  int64_t shared_cache_frames_done_;
+
+  /**
+   * @brief How long a claim lasts before other workers assume its owner died
+   */
+  static const qint64 kSharedCacheClaimTimeout;
+
+  /**
+   * @brief Send audio to the encoder for as long as the next block in order is available
+   */
+  void WriteOrderedAudio();
+
+  /**
+   * @brief Send frames to the encoder for as long as the next one in order is available
+   */
+  void WriteOrderedFrames();
+
+  /**
+   * @brief A compressed frame copied from a footage file by smart rendering
+   */
+  struct PassthroughSource
+  {
+    QString filename;
+    int stream;
+    rational time;
+  };
+
+  bool smart_render_;
+
+  PassthroughTraverser passthrough_traverser_;
+
+  QHash<rational, PassthroughSource> passthrough_map_;
+
+  /**
+   * @brief A run of frames written by its own encoder, used when exporting in segments
+   */
+  struct Segment
+  {
+    Encoder* encoder;
+
+    // Export-relative frame range [start, end) this encoder is responsible for
+    int64_t start;
+    int64_t end;
+
+    // Next frame to send to the encoder
+    int64_t next;
+
+    // Checkpoint chunk this segment encodes, or -1 if the export isn't checkpointed
+    int chunk;
+
+    // Render hash of every frame in the segment, used to tell if a chunk is still valid later
+    QVector<QByteArray> hashes;
+
+    QMap<int64_t, FramePtr> pending;
+
+    QFuture<void> writing;
+  };
+
+  bool OpenSegments(int64_t frame_count);
+
+  /**
+   * @brief Open a segment for each of these checkpoint chunks, writing into the checkpoint folder
+   */
+  bool OpenChunkSegments(const QVector<int>& chunks);
+
+  bool OpenSegment(const QString& filename, int64_t start, int64_t end, int chunk);
+
+  /**
+   * @brief Hands any frames that are ready to a segment's encoder on a worker thread
+   *
+   * If `wait` is true, or too many frames are waiting, this blocks until the segment's previous
+   * batch has been written.
+   */
+  void WriteSegment(Segment& segment, bool wait);
+
+  /**
+   * @brief Finishes writing and closes all segment encoders
+   *
+   * If `remove_files` is true, segment files are deleted too (not used for image sequences, where
+   * the segments write the final files directly).
+   */
+  bool CloseSegments(bool remove_files);
+
+  QVector<Segment> segments_;
+
+  /**
+   * @brief Render the video of a checkpointed export a few chunks at a time
+   *
+   * Chunks finished by an earlier run of the same export are skipped, the rest are rendered in
+   * groups of video_segments() and recorded in the checkpoint as soon as each group is closed.
+   * Fills `chunk_filenames` with every chunk's file in order.
+   */
+  bool RenderChunks(const TimeRange& range, const QSize& force_size, const QMatrix4x4& force_matrix,
+                    QStringList* chunk_filenames);
+
+  /**
+   * @brief Get the folder an export to `filename` keeps its finished chunks and checkpoint in
+   */
+  static QString GetCheckpointPath(const QString& filename);
+
+  QString GetChunkFilename(int chunk) const;
+
+  /**
+   * @brief Read which chunks an earlier run of this export to `filename` finished
+   *
+   * Chunks are only kept if their file still exists and the frames they cover hash the same as
+   * when they were encoded, so edits made to the sequence in the meantime are picked up. If the
+   * export's settings changed, the whole checkpoint is discarded.
+   */
+  void LoadCheckpoint(const QString& filename, const TimeRange& range);
+
+  bool SaveCheckpoint();
+
+  static QByteArray GetChunkDigest(const QVector<QByteArray>& hashes);
+
+  // Export-relative frame range [start, end) of a checkpoint chunk
+  int64_t GetChunkStart(int chunk) const
+  {
+    return qMin(frame_count_, chunk * chunk_length_);
+  }
+
+  QString checkpoint_path_;
+
+  // Everything about the export a checkpoint is only valid for
+  QByteArray checkpoint_settings_;
+
+  // Length of each chunk in frames, or 0 if the export isn't checkpointed
+  int64_t chunk_length_;
+
+  // Digest of the frame hashes of each chunk that's been finished, keyed by chunk index
+  QMap<int, QByteArray> finished_chunks_;
+
+  // Frames in the export
+  int64_t frame_count_;
+
+  /**
+   * @brief Writes a frame straight away on writer_pool_, for encoders that don't need frames in order
+   */
+  void WriteFrameUnordered(const FramePtr& frame, const rational& time);
+
+  /**
+   * @brief Collect unordered writes that have finished
+   *
+   * If `wait` is true, this blocks until every write has finished.
+   */
+  void ReapUnorderedWrites(bool wait);
+
+  struct UnorderedWrite
+  {
+    FramePtr frame;
+    rational time;
+    QFuture<bool> future;
+  };
+
+  bool write_unordered_;
+
+  QList<UnorderedWrite> unordered_writes_;
+
+  QThreadPool writer_pool_;
+
+  /**
+   * @brief Track memory used by frames waiting to be encoded
+   *
+   * Frames shared by several timestamps are only counted once.
+   */
+  void BufferFrame(const FramePtr& f);
+  void UnbufferFrame(const FramePtr& f);
 
   QHash<rational, FramePtr> time_map_;
 
-  QHash<TimeRange, SampleBufferPtr> audio_map_;
+  QHash<Frame*, int> buffered_frames_;
+  qint64 buffered_bytes_;
+  qint64 buffer_budget_;
+
+  struct PendingAudio
+  {
+    rational out;
+    SampleBufferPtr samples;
+  };
+
+  // Audio blocks that arrived before the ones preceding them, keyed by in point. RenderTask only
+  // renders a few blocks at a time, so this never holds more than that.
+  QMap<rational, PendingAudio> pending_audio_;
 
   ColorManager* color_manager_;
 
@@ -100,7 +100,7 @@ QMatrix4x4 ExportParams::GenerateMatrix(ExportParams::VideoScalingMethod method,
   return preview_matrix;
 }
 
-void ExportParams::Save(QXmlStreamWriter *writer) const
+void ExportParams::Save(XMLWriter *writer) const
 {
   writer->writeStartElement(QStringLiteral("export"));
 
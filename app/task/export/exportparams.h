@@ -56,7 +56,7 @@ public:
                                    int source_width, int source_height,
                                    int dest_width, int dest_height);
 
-  virtual void Save(QXmlStreamWriter* writer) const override;
+  virtual void Save(XMLWriter* writer) const override;
 
 private:
   Encoder::Type encoder_id_;
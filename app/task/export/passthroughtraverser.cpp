@@ -0,0 +1,79 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "passthroughtraverser.h"
+
+namespace olive {
+
+PassthroughTraverser::PassthroughTraverser() :
+  footage_count_(0),
+  processed_(false)
+{
+}
+
+bool PassthroughTraverser::FindSourceFrame(const NodeOutput &output, const TimeRange &range, FootageJob *job, rational *footage_time)
+{
+  footage_count_ = 0;
+  processed_ = false;
+  footage_texture_ = nullptr;
+
+  NodeValueTable table = GenerateTable(output, range);
+
+  TexturePtr texture = table.Get(NodeValue::kTexture).value<TexturePtr>();
+
+  // Anything that composites, filters or generates frames ran a shader, and anything that picks
+  // between several footage frames can't be copied as one
+  if (processed_ || footage_count_ != 1 || !texture || texture != footage_texture_) {
+    return false;
+  }
+
+  *job = footage_job_;
+  *footage_time = footage_time_;
+
+  return true;
+}
+
+QVariant PassthroughTraverser::ProcessVideoFootage(const FootageJob &stream, const rational &input_time)
+{
+  QVariant value = NodeTraverser::ProcessVideoFootage(stream, input_time);
+
+  footage_count_++;
+  footage_texture_ = value.value<TexturePtr>();
+  footage_job_ = stream;
+  footage_time_ = input_time;
+
+  return value;
+}
+
+QVariant PassthroughTraverser::ProcessShader(const Node *node, const TimeRange &range, const ShaderJob &job)
+{
+  processed_ = true;
+
+  return NodeTraverser::ProcessShader(node, range, job);
+}
+
+QVariant PassthroughTraverser::ProcessFrameGeneration(const Node *node, const GenerateJob &job)
+{
+  processed_ = true;
+
+  return NodeTraverser::ProcessFrameGeneration(node, job);
+}
+
+}
@@ -0,0 +1,70 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PASSTHROUGHTRAVERSER_H
+#define PASSTHROUGHTRAVERSER_H
+
+#include "node/traverser.h"
+
+namespace olive {
+
+/**
+ * @brief Finds frames of a render that are exactly a footage frame with nothing applied to them
+ *
+ * Used by smart rendering to copy such frames from their source file rather than decoding and
+ * re-encoding them. No rendering takes place, the graph is traversed with dummy textures and any
+ * shader or generated frame along the way disqualifies the frame.
+ */
+class PassthroughTraverser : public NodeTraverser
+{
+public:
+  PassthroughTraverser();
+
+  /**
+   * @brief Find the footage frame that `output` is an untouched copy of at `range`
+   *
+   * Returns TRUE and sets `job` and `footage_time` if the texture generated is a single footage
+   * frame, otherwise returns FALSE.
+   */
+  bool FindSourceFrame(const NodeOutput& output, const TimeRange& range, FootageJob* job, rational* footage_time);
+
+protected:
+  virtual QVariant ProcessVideoFootage(const FootageJob &stream, const rational &input_time) override;
+
+  virtual QVariant ProcessShader(const Node *node, const TimeRange &range, const ShaderJob& job) override;
+
+  virtual QVariant ProcessFrameGeneration(const Node *node, const GenerateJob& job) override;
+
+private:
+  int footage_count_;
+
+  bool processed_;
+
+  TexturePtr footage_texture_;
+
+  FootageJob footage_job_;
+
+  rational footage_time_;
+
+};
+
+}
+
+#endif // PASSTHROUGHTRAVERSER_H
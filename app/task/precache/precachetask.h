@@ -35,6 +35,16 @@ public:
 
   virtual ~PreCacheTask() override;
 
+  virtual Priority GetPriority() const override
+  {
+    return kPriorityBackground;
+  }
+
+  virtual Resource GetResource() const override
+  {
+    return kResourceGPU;
+  }
+
 protected:
   virtual bool Run() override;
 
@@ -22,6 +22,7 @@
 
 #include <QDir>
 #include <QFileInfo>
+#include <QtConcurrent/QtConcurrent>
 
 #include "config/config.h"
 #include "core.h"
@@ -55,7 +56,20 @@ bool ProjectImportTask::Run()
 
   int imported = 0;
 
-  Import(folder_, filenames_, imported, command_);
+  // Walk the file list first so every file can be probed concurrently, then create the items in
+  // the original order
+  QVector<ImportEntry> entries;
+  Gather(folder_, filenames_, entries);
+
+  ScheduleProbes(entries);
+
+  Import(entries, imported, command_);
+
+  // Clean up any probes that weren't used, e.g. neighbors checked for image sequences
+  for (auto it=probes_.begin(); it!=probes_.end(); it++) {
+    delete it.value().result();
+  }
+  probes_.clear();
 
   if (IsCancelled()) {
     delete command_;
@@ -66,7 +80,7 @@ bool ProjectImportTask::Run()
   }
 }
 
-void ProjectImportTask::Import(Folder *folder, QFileInfoList import, int &counter, MultiUndoCommand* parent_command)
+void ProjectImportTask::Gather(Folder *folder, const QFileInfoList &import, QVector<ImportEntry> &entries)
 {
   for (int i=0; i<import.size(); i++) {
     if (IsCancelled()) {
@@ -98,41 +112,173 @@ void ProjectImportTask::Import(Folder *folder, QFileInfoList import, int &counte
 
         f->SetLabel(file_info.fileName());
 
-        // Create undoable command that adds the items to the model
-        AddItemToFolder(folder, f, parent_command);
+        entries.append({folder, f, QString()});
+
+        // We have the directory's contents already, cache them for image sequence detection
+        QSet<QString>& listing = directory_listings_[file_info.absoluteFilePath()];
+        foreach (const QFileInfo& entry, entry_list) {
+          if (!entry.isDir()) {
+            listing.insert(entry.fileName());
+          }
+        }
 
         // Recursively follow this path
-        Import(f, entry_list, counter, parent_command);
+        Gather(f, entry_list, entries);
       }
 
     } else {
 
-      Footage* footage = new Footage(file_info.absoluteFilePath());
+      entries.append({folder, nullptr, file_info.absoluteFilePath()});
+      pending_files_.insert(file_info.absoluteFilePath());
+
+    }
+  }
+}
+
+void ProjectImportTask::ScheduleProbes(const QVector<ImportEntry> &entries)
+{
+  // Files that look like frames of an image sequence are only probed on demand after the first
+  // two, since the rest are usually absorbed into the sequence. Numbered video files (e.g. from
+  // camera cards) are always probed.
+  QHash<QString, int64_t> last_index;
+  QHash<QString, int> run_length;
+
+  foreach (const ImportEntry& e, entries) {
+    if (e.folder) {
+      continue;
+    }
 
-      footage->SetLabel(file_info.fileName());
+    if (Decoder::GetImageSequenceDigitCount(e.filename) > 0
+        && !Decoder::IsLikelyMediaContainer(e.filename, false)) {
+      QString pattern = Decoder::TransformImageSequenceFileName(e.filename, 0);
+      int64_t index = Decoder::GetImageSequenceIndex(e.filename);
 
-      if (footage->IsValid()) {
-        // See if this footage is an image sequence
-        ValidateImageSequence(footage, import, i);
+      int length = (last_index.contains(pattern) && last_index.value(pattern) == index - 1) ? run_length.value(pattern) + 1 : 1;
 
-        // Create undoable command that adds the items to the model
-        AddItemToFolder(folder, footage, parent_command);
-      } else {
-        // Add to list so we can tell the user about it later
-        invalid_files_.append(file_info.absoluteFilePath());
+      last_index.insert(pattern, index);
+      run_length.insert(pattern, length);
 
-        delete footage;
+      if (length > 2) {
+        continue;
       }
+    }
+
+    Probe(e.filename);
+  }
+}
+
+QFuture<Footage *> ProjectImportTask::Probe(const QString &filename)
+{
+  auto it = probes_.find(filename);
+
+  if (it == probes_.end()) {
+    const QAtomicInt* cancelled = &IsCancelled();
+    QThread* target_thread = QThread::currentThread();
+
+    it = probes_.insert(filename, QtConcurrent::run(&probe_pool_, [filename, cancelled, target_thread]{
+      return ProbeFile(filename, cancelled, target_thread);
+    }));
+  }
+
+  return it.value();
+}
+
+Footage *ProjectImportTask::TakeProbe(const QString &filename)
+{
+  Footage* footage = Probe(filename).result();
+
+  probes_.remove(filename);
+
+  return footage;
+}
+
+Footage *ProjectImportTask::ProbeFile(const QString &filename, const QAtomicInt *cancelled, QThread *target_thread)
+{
+  if (*cancelled) {
+    return nullptr;
+  }
+
+  Footage* footage = new Footage();
+
+  footage->SetLabel(QFileInfo(filename).fileName());
 
-      counter++;
+  footage->SetCancelPointer(cancelled);
+  footage->set_filename(filename);
+  footage->SetCancelPointer(nullptr);
 
-      emit ProgressChanged(static_cast<double>(counter) / static_cast<double>(file_count_));
+  footage->moveToThread(target_thread);
 
+  return footage;
+}
+
+bool ProjectImportTask::FileExists(const QString &filename)
+{
+  QFileInfo info(filename);
+  QString dir = info.absolutePath();
+
+  auto it = directory_listings_.find(dir);
+
+  if (it == directory_listings_.end()) {
+    QSet<QString> listing;
+    foreach (const QString& f, QDir(dir).entryList(QDir::Files | QDir::NoDotAndDotDot)) {
+      listing.insert(f);
     }
+
+    it = directory_listings_.insert(dir, listing);
   }
+
+  return it.value().contains(info.fileName());
 }
 
-void ProjectImportTask::ValidateImageSequence(Footage *footage, QFileInfoList& info_list, int index)
+void ProjectImportTask::Import(const QVector<ImportEntry> &entries, int &counter, MultiUndoCommand* parent_command)
+{
+  int i;
+
+  for (i=0; i<entries.size(); i++) {
+    if (IsCancelled()) {
+      break;
+    }
+
+    const ImportEntry& e = entries.at(i);
+
+    if (e.folder) {
+      // Create undoable command that adds the folder to the model
+      AddItemToFolder(e.parent, e.folder, parent_command);
+      continue;
+    }
+
+    if (image_sequence_files_.contains(e.filename)) {
+      // Already imported as part of an image sequence
+      continue;
+    }
+
+    Footage* footage = TakeProbe(e.filename);
+
+    if (footage && footage->IsValid()) {
+      // See if this footage is an image sequence
+      ValidateImageSequence(footage);
+
+      // Create undoable command that adds the items to the model
+      AddItemToFolder(e.parent, footage, parent_command);
+    } else {
+      // Add to list so we can tell the user about it later
+      invalid_files_.append(e.filename);
+
+      delete footage;
+    }
+
+    counter++;
+
+    emit ProgressChanged(static_cast<double>(counter) / static_cast<double>(file_count_));
+  }
+
+  // Folders that were cancelled before being added aren't owned by anything
+  for (; i<entries.size(); i++) {
+    delete entries.at(i).folder;
+  }
+}
+
+void ProjectImportTask::ValidateImageSequence(Footage *footage)
 {
   // Heuristically determine whether this file is part of an image sequence or not
   //
@@ -150,15 +296,13 @@ void ProjectImportTask::ValidateImageSequence(Footage *footage, QFileInfoList& i
     QString previous_img_fn = Decoder::TransformImageSequenceFileName(footage->filename(), ind - 1);
     QString next_img_fn = Decoder::TransformImageSequenceFileName(footage->filename(), ind + 1);
 
-    // See if the same decoder can retrieve surrounding files
-    DecoderPtr decoder = Decoder::CreateFromID(footage->decoder());
-
-    Footage* previous_file = new Footage(previous_img_fn);
-    Footage* next_file = new Footage(next_img_fn);
+    // See if the surrounding files can be probed, reusing the probes of files being imported
+    Footage* previous_file = FileExists(previous_img_fn) ? Probe(previous_img_fn).result() : nullptr;
+    Footage* next_file = FileExists(next_img_fn) ? Probe(next_img_fn).result() : nullptr;
 
     // Finally see if these files have the same dimensions
-    if ((previous_file->IsValid() && CompareStillImageSize(previous_file, dim))
-        || (next_file->IsValid() && CompareStillImageSize(next_file, dim))) {
+    if ((previous_file && previous_file->IsValid() && CompareStillImageSize(previous_file, dim))
+        || (next_file && next_file->IsValid() && CompareStillImageSize(next_file, dim))) {
       // By this point, we've established this file is a still image with a number at the end of
       // the filename surrounded by adjacent numbers. It could be a still image! But let's ask the
       // user just in case...
@@ -177,23 +321,20 @@ void ProjectImportTask::ValidateImageSequence(Footage *footage, QFileInfoList& i
       int64_t start_index = GetImageSequenceLimit(footage->filename(), seq_index, false);
       int64_t end_index = GetImageSequenceLimit(footage->filename(), seq_index, true);
 
-      // Depending on the user's choice, either remove them from the list or don't ask for the
-      // remainders
+      // Depending on the user's choice, either skip them when they come up in the import or don't
+      // ask for the remainders
       for (int64_t j=start_index; j<=end_index; j++) {
         QString entry_fn = Decoder::TransformImageSequenceFileName(footage->filename(), j);
 
         if (is_sequence) {
-          // If this is part of the sequence we're importing here, remove it
-          for (int i=index+1; i<info_list.size(); i++) {
-            if (info_list.at(i).absoluteFilePath() == entry_fn) {
-              if (is_sequence) {
-                info_list.removeAt(i);
-              }
-              break;
-            }
-          }
+          image_sequence_files_.insert(entry_fn);
         } else {
-          image_sequence_ignore_files_.append(entry_fn);
+          image_sequence_ignore_files_.insert(entry_fn);
+
+          // These will be imported individually, so start probing any that haven't been
+          if (pending_files_.contains(entry_fn)) {
+            Probe(entry_fn);
+          }
         }
       }
 
@@ -211,9 +352,6 @@ void ProjectImportTask::ValidateImageSequence(Footage *footage, QFileInfoList& i
         footage->SetVideoParams(video_stream, 0);
       }
     }
-
-    delete previous_file;
-    delete next_file;
   }
 }
 
@@ -267,7 +405,7 @@ int64_t ProjectImportTask::GetImageSequenceLimit(const QString& start_fn, int64_
 
     test_filename = Decoder::TransformImageSequenceFileName(start_fn, test_index);
 
-    if (!QFileInfo::exists(test_filename)) {
+    if (!FileExists(test_filename)) {
       // Reached end of index
       break;
     }
@@ -22,6 +22,8 @@
 #define PROJECTIMPORTMANAGER_H
 
 #include <QFileInfoList>
+#include <QFuture>
+#include <QThreadPool>
 #include <QUndoCommand>
 
 #include "codec/decoder.h"
@@ -57,9 +59,29 @@ protected:
   virtual bool Run() override;
 
 private:
-  void Import(Folder* folder, QFileInfoList import, int& counter, MultiUndoCommand *parent_command);
+  struct ImportEntry {
+    Folder* parent;
 
-  void ValidateImageSequence(Footage *footage, QFileInfoList &info_list, int index);
+    // Set if this entry creates a folder, otherwise `filename` is footage to import
+    Folder* folder;
+    QString filename;
+  };
+
+  void Gather(Folder* folder, const QFileInfoList& import, QVector<ImportEntry>& entries);
+
+  void Import(const QVector<ImportEntry>& entries, int& counter, MultiUndoCommand *parent_command);
+
+  void ScheduleProbes(const QVector<ImportEntry>& entries);
+
+  QFuture<Footage*> Probe(const QString& filename);
+
+  Footage* TakeProbe(const QString& filename);
+
+  static Footage* ProbeFile(const QString& filename, const QAtomicInt* cancelled, QThread* target_thread);
+
+  bool FileExists(const QString& filename);
+
+  void ValidateImageSequence(Footage *footage);
 
   void AddItemToFolder(Folder* folder, Node* item, MultiUndoCommand* command);
 
@@ -67,7 +89,7 @@ private:
 
   static bool CompareStillImageSize(Footage *footage, const QSize& sz);
 
-  static int64_t GetImageSequenceLimit(const QString &start_fn, int64_t start, bool up);
+  int64_t GetImageSequenceLimit(const QString &start_fn, int64_t start, bool up);
 
   MultiUndoCommand* command_;
 
@@ -81,7 +103,17 @@ private:
 
   QStringList invalid_files_;
 
-  QList<QString> image_sequence_ignore_files_;
+  QSet<QString> image_sequence_ignore_files_;
+
+  QSet<QString> image_sequence_files_;
+
+  QSet<QString> pending_files_;
+
+  QThreadPool probe_pool_;
+
+  QHash<QString, QFuture<Footage*> > probes_;
+
+  QHash<QString, QSet<QString> > directory_listings_;
 
 };
 
@@ -22,8 +22,8 @@
 
 #include <QApplication>
 #include <QFile>
-#include <QXmlStreamReader>
 
+#include "common/xmlstream.h"
 #include "common/xmlutils.h"
 #include "core.h"
 
@@ -38,8 +38,9 @@ bool ProjectLoadTask::Run()
 {
   QFile project_file(GetFilename());
 
-  if (project_file.open(QFile::ReadOnly | QFile::Text)) {
-    QXmlStreamReader reader(&project_file);
+  // Not opened in text mode, the project may be a binary container
+  if (project_file.open(QFile::ReadOnly)) {
+    XMLReader reader(&project_file);
 
     uint project_version = 0;
 
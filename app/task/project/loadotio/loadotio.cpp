@@ -81,6 +81,13 @@ bool LoadOTIOTask::Run()
   // Keep track of imported footage
   QMap<QString, Footage*> imported_footage;
 
+  // Progress is reported per track since that's the unit we convert in
+  int track_count = 0;
+  int tracks_done = 0;
+  foreach (auto timeline, timelines) {
+    track_count += static_cast<int>(timeline->tracks()->children().size());
+  }
+
   foreach (auto timeline, timelines) {
     // Create sequence
     Sequence* sequence = new Sequence();
@@ -95,6 +102,8 @@ bool LoadOTIOTask::Run()
     for (auto c : timeline->tracks()->children()) {
       auto otio_track = static_cast<OTIO::Track*>(c.value);
 
+      tracks_done++;
+
       // Create a new track
       Track* track = nullptr;
 
@@ -127,6 +136,10 @@ bool LoadOTIOTask::Run()
       Block* previous_block = nullptr;
       bool prev_block_transition = false;
 
+      // Blocks are collected and added to the track in one go once the whole track is converted
+      QVector<Block*> blocks;
+      blocks.reserve(static_cast<int>(clip_map.size()));
+
       for (auto otio_block_retainer : clip_map) {
 
         auto otio_block = otio_block_retainer.value;
@@ -156,7 +169,7 @@ bool LoadOTIOTask::Run()
         block->setParent(project_);
         block->SetLabel(QString::fromStdString(otio_block->name()));
 
-        track->AppendBlock(block);
+        blocks.append(block);
 
         rational start_time;
         rational duration;
@@ -231,6 +244,18 @@ bool LoadOTIOTask::Run()
         }
 
       }
+
+      track->AppendBlocks(blocks);
+
+      // This track now exists in our graph, release the OTIO copy rather than holding both trees in
+      // memory until the whole file has been converted
+      otio_track->clear_children();
+
+      if (IsCancelled()) {
+        return false;
+      }
+
+      emit ProgressChanged(static_cast<double>(tracks_done) / static_cast<double>(track_count));
     }
   }
 
@@ -0,0 +1,244 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "relink.h"
+
+#include <QDirIterator>
+#include <QtConcurrent/QtConcurrent>
+
+#include "node/project/footage/footageprobecache.h"
+
+namespace olive {
+
+namespace {
+
+// Walking network shares is mostly spent waiting on the server, so use more threads than cores
+const int kMinimumSearchThreads = 8;
+
+}
+
+ProjectRelinkTask::ProjectRelinkTask(const QVector<Footage *> &footage, const QStringList &search_paths) :
+  search_paths_(search_paths)
+{
+  wanted_.resize(footage.size());
+
+  for (int i=0; i<footage.size(); i++) {
+    Footage* f = footage.at(i);
+    Wanted& w = wanted_[i];
+
+    w.name = GetIndexName(f->filename());
+    w.timestamp = f->timestamp();
+
+    for (int j=0; j<f->GetVideoStreamCount(); j++) {
+      w.video_durations.append(f->GetVideoParams(j).duration());
+    }
+
+    for (int j=0; j<f->GetAudioStreamCount(); j++) {
+      w.audio_durations.append(f->GetAudioParams(j).duration());
+    }
+  }
+
+  pool_.setMaxThreadCount(qMax(QThread::idealThreadCount(), kMinimumSearchThreads));
+
+  SetTitle(tr("Searching for %n file(s)", nullptr, footage.size()));
+}
+
+bool ProjectRelinkTask::Run()
+{
+  const QAtomicInt* cancelled = &IsCancelled();
+
+  Index index = BuildIndex();
+
+  if (IsCancelled()) {
+    return false;
+  }
+
+  // Verify every footage's candidates concurrently, each may need its candidates probed
+  QVector< QFuture<QString> > futures(wanted_.size());
+  for (int i=0; i<wanted_.size(); i++) {
+    Wanted w = wanted_.at(i);
+    QList<Candidate> candidates = index.values(w.name);
+
+    futures[i] = QtConcurrent::run(&pool_, [w, candidates, cancelled]{
+      return Match(w, candidates, cancelled);
+    });
+  }
+
+  matches_.clear();
+  for (int i=0; i<futures.size(); i++) {
+    matches_.append(futures.at(i).result());
+
+    emit ProgressChanged(double(i + 1) / double(futures.size()));
+  }
+
+  return !IsCancelled();
+}
+
+QString ProjectRelinkTask::GetIndexName(const QString &filename)
+{
+  QString name = QFileInfo(filename).fileName();
+
+#if defined(Q_OS_WINDOWS) || defined(Q_OS_MAC)
+  // These filesystems are usually case-insensitive
+  name = name.toLower();
+#endif
+
+  return name;
+}
+
+ProjectRelinkTask::Index ProjectRelinkTask::BuildIndex()
+{
+  const QAtomicInt* cancelled = &IsCancelled();
+
+  QSet<QString> names;
+  foreach (const Wanted& w, wanted_) {
+    names.insert(w.name);
+  }
+
+  // Each search folder's own files and each of its subfolders are walked on their own thread
+  QVector< QFuture< QVector<Candidate> > > futures;
+
+  foreach (const QString& path, search_paths_) {
+    futures.append(QtConcurrent::run(&pool_, [path, names, cancelled]{
+      return IndexDirectory(path, false, names, cancelled);
+    }));
+
+    QDirIterator it(path, QDir::Dirs | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+      QString subfolder = it.next();
+
+      futures.append(QtConcurrent::run(&pool_, [subfolder, names, cancelled]{
+        return IndexDirectory(subfolder, true, names, cancelled);
+      }));
+    }
+  }
+
+  Index index;
+
+  foreach (const QFuture< QVector<Candidate> >& f, futures) {
+    foreach (const Candidate& c, f.result()) {
+      index.insert(GetIndexName(c.filename), c);
+    }
+  }
+
+  return index;
+}
+
+QVector<ProjectRelinkTask::Candidate> ProjectRelinkTask::IndexDirectory(const QString &path, bool recursive, const QSet<QString> &names, const QAtomicInt *cancelled)
+{
+  QVector<Candidate> found;
+
+  QDirIterator it(path, QDir::Files, recursive ? QDirIterator::Subdirectories : QDirIterator::NoIteratorFlags);
+
+  while (it.hasNext() && !*cancelled) {
+    it.next();
+
+    // Only files we're looking for are stat'd, which is most of the cost on a network share
+    if (names.contains(GetIndexName(it.fileName()))) {
+      QFileInfo info = it.fileInfo();
+
+      Candidate c;
+      c.filename = info.absoluteFilePath();
+      c.size = info.size();
+      c.timestamp = info.lastModified().toMSecsSinceEpoch();
+      found.append(c);
+    }
+  }
+
+  return found;
+}
+
+QString ProjectRelinkTask::Match(const Wanted &wanted, QList<Candidate> candidates, const QAtomicInt *cancelled)
+{
+  // Sort for a stable choice between copies and to drop files found through overlapping folders
+  std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b){
+    return a.filename < b.filename;
+  });
+
+  QList<Candidate> verified;
+  for (int i=0; i<candidates.size(); i++) {
+    const Candidate& c = candidates.at(i);
+
+    if ((i == 0 || c.filename != candidates.at(i-1).filename)
+        && StreamsMatch(wanted, c.filename, cancelled)) {
+      verified.append(c);
+    }
+  }
+
+  if (verified.isEmpty()) {
+    return QString();
+  }
+
+  // Copying usually keeps the modified time, so prefer files that still have the original's
+  if (wanted.timestamp) {
+    QList<Candidate> same_time;
+
+    foreach (const Candidate& c, verified) {
+      if (c.timestamp == wanted.timestamp) {
+        same_time.append(c);
+      }
+    }
+
+    if (!same_time.isEmpty()) {
+      verified = same_time;
+    }
+  }
+
+  // Identical copies are fine to pick between, but files that differ can't be told apart
+  foreach (const Candidate& c, verified) {
+    if (c.size != verified.first().size) {
+      return QString();
+    }
+  }
+
+  return verified.first().filename;
+}
+
+bool ProjectRelinkTask::StreamsMatch(const Wanted &wanted, const QString &filename, const QAtomicInt *cancelled)
+{
+  if (wanted.video_durations.isEmpty() && wanted.audio_durations.isEmpty()) {
+    // Nothing is known about the original's streams, the name is all we can go on
+    return true;
+  }
+
+  FootageDescription desc = FootageProbeCache::Probe(filename, cancelled);
+
+  if (!desc.IsValid()
+      || desc.GetVideoStreams().size() != wanted.video_durations.size()
+      || desc.GetAudioStreams().size() != wanted.audio_durations.size()) {
+    return false;
+  }
+
+  for (int i=0; i<wanted.video_durations.size(); i++) {
+    if (desc.GetVideoStreams().at(i).duration() != wanted.video_durations.at(i)) {
+      return false;
+    }
+  }
+
+  for (int i=0; i<wanted.audio_durations.size(); i++) {
+    if (desc.GetAudioStreams().at(i).duration() != wanted.audio_durations.at(i)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+}
@@ -0,0 +1,100 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROJECTRELINKTASK_H
+#define PROJECTRELINKTASK_H
+
+#include <QMultiHash>
+#include <QSet>
+#include <QThreadPool>
+
+#include "node/project/footage/footage.h"
+#include "task/task.h"
+
+namespace olive {
+
+/**
+ * @brief Finds new locations for offline footage by searching folders for files with the same name
+ *
+ * Every search folder is walked once, with its subfolders walked in parallel, into an index of the
+ * filenames being looked for. All footage is then matched against that index at once rather than
+ * searching again for each file. Files that share a name are told apart by their modified time and
+ * by comparing their streams' durations to the footage's (probing through FootageProbeCache), and
+ * footage that still can't be told apart is left offline rather than guessed.
+ *
+ * The task never touches the Footage objects themselves, everything it needs is copied in the
+ * constructor so it can run on any thread.
+ */
+class ProjectRelinkTask : public Task
+{
+  Q_OBJECT
+public:
+  ProjectRelinkTask(const QVector<Footage*>& footage, const QStringList& search_paths);
+
+  /**
+   * @brief New filename for each footage in the order they were given, empty if none was found
+   */
+  const QStringList& GetMatches() const
+  {
+    return matches_;
+  }
+
+protected:
+  virtual bool Run() override;
+
+private:
+  struct Wanted {
+    QString name;
+    qint64 timestamp;
+    QVector<int64_t> video_durations;
+    QVector<int64_t> audio_durations;
+  };
+
+  struct Candidate {
+    QString filename;
+    qint64 size;
+    qint64 timestamp;
+  };
+
+  typedef QMultiHash<QString, Candidate> Index;
+
+  static QString GetIndexName(const QString& filename);
+
+  Index BuildIndex();
+
+  static QVector<Candidate> IndexDirectory(const QString& path, bool recursive, const QSet<QString>& names, const QAtomicInt* cancelled);
+
+  static QString Match(const Wanted& wanted, QList<Candidate> candidates, const QAtomicInt* cancelled);
+
+  static bool StreamsMatch(const Wanted& wanted, const QString& filename, const QAtomicInt* cancelled);
+
+  QVector<Wanted> wanted_;
+
+  QStringList search_paths_;
+
+  QStringList matches_;
+
+  QThreadPool pool_;
+
+};
+
+}
+
+#endif // PROJECTRELINKTASK_H
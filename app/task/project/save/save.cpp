@@ -22,9 +22,10 @@
 
 #include <QDir>
 #include <QFile>
-#include <QXmlStreamWriter>
 
 #include "common/filefunctions.h"
+#include "common/xmlstream.h"
+#include "config/config.h"
 #include "core.h"
 
 namespace olive {
@@ -44,8 +45,10 @@ bool ProjectSaveTask::Run()
 
   QFile project_file(temp_save);
 
-  if (project_file.open(QFile::WriteOnly | QFile::Text)) {
-    QXmlStreamWriter writer(&project_file);
+  XMLWriter::Format format = Config::Current()[QStringLiteral("BinaryProjectFiles")].toBool() ? XMLWriter::kBinary : XMLWriter::kXML;
+
+  if (project_file.open(format == XMLWriter::kBinary ? QFile::WriteOnly : QFile::WriteOnly | QFile::Text)) {
+    XMLWriter writer(&project_file, format);
     writer.setAutoFormatting(true);
 
     writer.writeStartDocument();
@@ -71,7 +74,7 @@ bool ProjectSaveTask::Run()
     project_file.close();
 
     if (writer.hasError()) {
-      SetError(tr("Failed to write XML data"));
+      SetError(tr("Failed to write project data"));
       return false;
     }
 
@@ -37,7 +37,9 @@
 namespace olive {
 
 SaveOTIOTask::SaveOTIOTask(Project *project) :
-  project_(project)
+  project_(project),
+  track_count_(0),
+  tracks_done_(0)
 {
   SetTitle(tr("Exporting project to OpenTimelineIO"));
 }
@@ -51,6 +53,13 @@ bool SaveOTIOTask::Run()
     return false;
   }
 
+  // Progress is reported per track since that's the unit we convert in
+  track_count_ = 0;
+  tracks_done_ = 0;
+  foreach (Sequence* seq, sequences) {
+    track_count_ += seq->track_list(Track::kVideo)->GetTrackCount() + seq->track_list(Track::kAudio)->GetTrackCount();
+  }
+
   std::vector<OTIO::SerializableObject*> serialized;
 
   foreach (Sequence* seq, sequences) {
@@ -198,6 +207,9 @@ bool SaveOTIOTask::SerializeTrackList(TrackList *list, OTIO::Timeline* otio_time
       otio_track->possibly_delete();
       return false;
     }
+
+    tracks_done_++;
+    emit ProgressChanged(static_cast<double>(tracks_done_) / static_cast<double>(track_count_));
   }
 
   return true;
@@ -50,6 +50,10 @@ private:
 
   Project* project_;
 
+  int track_count_;
+
+  int tracks_done_;
+
 };
 
 }
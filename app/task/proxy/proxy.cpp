@@ -0,0 +1,117 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "proxy.h"
+
+#include "codec/encoder.h"
+
+namespace olive {
+
+ProxyTask::ProxyTask(const QString &decoder_id, const Decoder::CodecStream &stream, const VideoParams &params, int divider, const QString &output_filename) :
+  decoder_id_(decoder_id),
+  stream_(stream),
+  params_(params),
+  divider_(divider),
+  output_filename_(output_filename)
+{
+  SetTitle(tr("Generating Proxy %1:%2").arg(stream.filename(), QString::number(stream.stream())));
+}
+
+bool ProxyTask::Run()
+{
+  DecoderPtr decoder = Decoder::CreateFromID(decoder_id_);
+
+  if (!decoder->Open(stream_)) {
+    SetError(tr("Failed to open decoder for proxy"));
+    return false;
+  }
+
+  // Proxies are stored at the size the decoder would have produced with this divider so they can
+  // be swapped in without anything downstream noticing
+  VideoParams proxy_params = params_;
+  proxy_params.set_width(VideoParams::GetScaledDimension(params_.width(), divider_));
+  proxy_params.set_height(VideoParams::GetScaledDimension(params_.height(), divider_));
+  proxy_params.set_divider(1);
+  proxy_params.set_format(VideoParams::kFormatUnsigned16);
+
+  rational length = rational(params_.duration()) * params_.time_base();
+
+  // ProRes Proxy is intra-only, so seeking around the timeline never decodes more than one frame
+  EncodingParams encoding_params;
+  encoding_params.SetFilename(output_filename_);
+  encoding_params.EnableVideo(proxy_params, ExportCodec::kCodecProRes);
+  encoding_params.set_video_option(QStringLiteral("profile"), QStringLiteral("0"));
+  encoding_params.set_video_pix_fmt(QStringLiteral("yuv422p10le"));
+  encoding_params.SetExportLength(length);
+
+  Encoder* encoder = Encoder::CreateFromID(Encoder::kEncoderTypeFFmpeg, encoding_params);
+
+  if (!encoder->Open()) {
+    SetError(tr("Failed to open proxy file: %1").arg(encoder->GetError()));
+    delete encoder;
+    return false;
+  }
+
+  Decoder::RetrieveVideoParams p;
+  p.divider = divider_;
+  p.src_interlacing = params_.interlacing();
+  p.dst_interlacing = params_.interlacing();
+
+  rational frame_length = params_.frame_rate_as_time_base();
+  bool ret = true;
+
+  for (rational time; time < length; time += frame_length) {
+    WaitWhilePaused();
+
+    if (IsCancelled()) {
+      ret = false;
+      break;
+    }
+
+    FramePtr frame = decoder->RetrieveVideo(time, p);
+
+    if (!frame) {
+      SetError(tr("Failed to retrieve frame at %1").arg(time.toDouble()));
+      ret = false;
+      break;
+    }
+
+    if (frame->format() != proxy_params.format()) {
+      frame = frame->convert(proxy_params.format());
+    }
+
+    if (!encoder->WriteFrame(frame, time)) {
+      SetError(tr("Failed to write proxy frame: %1").arg(encoder->GetError()));
+      ret = false;
+      break;
+    }
+
+    emit ProgressChanged(time.toDouble() / length.toDouble());
+  }
+
+  encoder->Close();
+  delete encoder;
+
+  decoder->Close();
+
+  return ret;
+}
+
+}
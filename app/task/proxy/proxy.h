@@ -0,0 +1,63 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PROXYTASK_H
+#define PROXYTASK_H
+
+#include "codec/decoder.h"
+#include "render/videoparams.h"
+#include "task/task.h"
+
+namespace olive {
+
+/**
+ * @brief Transcodes a video stream to a reduced resolution, intra-only copy for previewing
+ */
+class ProxyTask : public Task
+{
+  Q_OBJECT
+public:
+  ProxyTask(const QString &decoder_id, const Decoder::CodecStream &stream, const VideoParams& params, int divider, const QString &output_filename);
+
+  virtual Priority GetPriority() const override
+  {
+    // The original footage plays in the meantime
+    return kPriorityBackground;
+  }
+
+protected:
+  virtual bool Run() override;
+
+private:
+  QString decoder_id_;
+
+  Decoder::CodecStream stream_;
+
+  VideoParams params_;
+
+  int divider_;
+
+  QString output_filename_;
+
+};
+
+}
+
+#endif // PROXYTASK_H
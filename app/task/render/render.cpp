@@ -20,18 +20,27 @@
 
 #include "render.h"
 
+#include <algorithm>
+
 #include "common/timecodefunctions.h"
 #include "node/project/sequence/sequence.h"
+#include "render/hardwareprofile.h"
 #include "render/rendermanager.h"
 
 namespace olive {
 
+const rational RenderTask::kAudioBlockLength = rational(1);
+const int RenderTask::kMaximumAudioBlocks = 4;
+const rational RenderTask::kAudioLookahead = rational(2);
+
 RenderTask::RenderTask(ViewerOutput *viewer, const VideoParams &vparams, const AudioParams &aparams) :
   viewer_(viewer),
+  render_node_(nullptr),
   video_params_(vparams),
   audio_params_(aparams),
   running_tickets_(0),
-  native_progress_signalling_(true)
+  native_progress_signalling_(true),
+  video_segment_count_(1)
 {
 }
 
@@ -57,7 +66,9 @@ bool RenderTask::Render(ColorManager* manager,
   // Store real time before any rendering takes place
   qint64 job_time = QDateTime::currentMSecsSinceEpoch();
 
-  // Queue audio jobs
+  // Split audio into blocks, which are started in order alongside the video further down
+  QVector<TimeRange> audio_blocks;
+
   foreach (const TimeRange& range, audio_range) {
     // Don't count audio progress, since it's generally a lot faster than video and is weighted at
     // 50%, which makes the progress bar look weird to the uninitiated
@@ -65,15 +76,8 @@ bool RenderTask::Render(ColorManager* manager,
 
     rational r = range.in();
     while (r != range.out()) {
-      rational end = qMin(range.out(), r+1);
-      TimeRange this_range(r, end);
-
-      RenderTicketWatcher* watcher = new RenderTicketWatcher();
-      watcher->setProperty("range", QVariant::fromValue(this_range));
-      PrepareWatcher(watcher, &watcher_thread);
-      IncrementRunningTickets();
-      watcher->SetTicket(RenderManager::instance()->RenderAudio(viewer_, this_range, audio_params_, mode, false));
-
+      rational end = qMin(range.out(), r + kAudioBlockLength);
+      audio_blocks.append(TimeRange(r, end));
       r = end;
     }
   }
@@ -85,15 +89,41 @@ bool RenderTask::Render(ColorManager* manager,
   if (!video_range.isEmpty()) {
     // Get list of discrete frames from range
     QVector<rational> times = FrameHashCache::GetFrameListFromTimeRange(video_range, video_params().frame_rate_as_time_base());
+
+    if (video_segment_count_ > 1) {
+      // Take one frame from each segment in turn
+      QVector<rational> interleaved;
+      interleaved.reserve(times.size());
+
+      int64_t longest_segment = 0;
+      for (int i=0; i<video_segment_count_; i++) {
+        longest_segment = qMax(longest_segment, GetSegmentStart(times.size(), video_segment_count_, i+1)
+                                                - GetSegmentStart(times.size(), video_segment_count_, i));
+      }
+
+      for (int64_t j=0; j<longest_segment; j++) {
+        for (int i=0; i<video_segment_count_; i++) {
+          int64_t index = GetSegmentStart(times.size(), video_segment_count_, i) + j;
+
+          if (index < GetSegmentStart(times.size(), video_segment_count_, i+1)) {
+            interleaved.append(times.at(index));
+          }
+        }
+      }
+
+      times = interleaved;
+    }
     QVector<QByteArray> hashes(times.size());
 
+    NodeOutput texture_output = GetTextureOutput();
+
     // Generate hashes
     for (int i=0; i<times.size(); i++) {
       if (IsCancelled()) {
         return true;
       }
 
-      hashes[i] = RenderManager::instance()->Hash(viewer()->GetConnectedTextureOutput(), video_params_, times.at(i));
+      hashes[i] = RenderManager::instance()->Hash(texture_output, video_params_, times.at(i));
     }
 
     // Filter out duplicates
@@ -118,62 +148,88 @@ bool RenderTask::Render(ColorManager* manager,
     total_length += total_number_of_unique_frames_;
   }
 
+  // Encode all subtitle cues in the range across all tracks in time order. This happens before any
+  // frames since prerendered ones are handed to the encoder as soon as they're reached.
+  if (!subtitle_range.length().isNull()) {
+    Sequence *sequence = dynamic_cast<Sequence*>(viewer_);
+    if (sequence) {
+      foreach (const SubtitleCue &cue, GetSubtitleCues(sequence, subtitle_range)) {
+        EncodeSubtitle(cue);
+      }
+    }
+  }
+
   // Start a render of a limited amount, and then render one frame for each frame that gets
   // finished. This prevents rendered frames from stacking up in memory indefinitely while the
-  // encoder is processing them. The amount is kind of arbitrary, but we use the thread count so
-  // each of the system's threads are utilized as memory allows.
-  const int maximum_rendered_frames = QThread::idealThreadCount();
+  // encoder is processing them. The amount is calibrated so the render threads stay busy while
+  // earlier frames are still being downloaded.
+  const int maximum_rendered_frames = HardwareProfile::GetFramesInFlight();
   auto frame_iterator = frame_render_order.cbegin();
+  int running_frames = 0;
+
+  // Latest time a video frame has been started at, audio stays within kAudioLookahead of it so
+  // that neither the consumer nor the muxer have to hold on to audio waiting for video
+  rational video_position = frame_render_order.isEmpty() ? rational() : frame_render_order.first().first;
+
+  auto audio_iterator = audio_blocks.cbegin();
+  int running_audio = 0;
+
+  // Starts audio blocks in order for as long as there's room for them
+  auto start_next_audio = [&]() {
+    while (running_audio < kMaximumAudioBlocks
+           && audio_iterator != audio_blocks.cend()
+           && !IsCancelled()) {
+      if (frame_iterator != frame_render_order.cend()
+          && audio_iterator->in() > video_position + kAudioLookahead) {
+        // Wait for video to catch up. Once every frame has been started this no longer applies.
+        break;
+      }
 
-  for (int i=0; i<maximum_rendered_frames && frame_iterator!=frame_render_order.cend(); i++, frame_iterator++) {
-    StartTicket(frame_iterator->second, &watcher_thread, manager, frame_iterator->first,
-                mode, cache, force_size, force_matrix, force_format, force_color_output);
-  }
+      StartAudioTicket(*audio_iterator, &watcher_thread, mode);
+      audio_iterator++;
+      running_audio++;
+    }
+  };
 
-  // Subtitle loop, loops over all blocks in sequence on all tracks
-  if (!subtitle_range.length().isNull()) {
-    Sequence *sequence = dynamic_cast<Sequence*>(viewer_);
-    if (sequence) {
-      TrackList *list = sequence->track_list(Track::kSubtitle);
-      QVector<int> block_indexes(list->GetTrackCount(), 0);
-
-      QVector<int> tracks_to_push;
-      do {
-        tracks_to_push.clear();
-
-        for (int i=0; i<block_indexes.size(); i++) {
-          Track *this_track = list->GetTrackAt(i);
-          int &this_block_index = block_indexes[i];
-          if (this_block_index >= this_track->Blocks().size()) {
-            continue;
-          }
-          Block *this_block = this_track->Blocks().at(this_block_index);
-
-          Track *compare_track = tracks_to_push.isEmpty() ? nullptr : list->GetTrackAt(tracks_to_push.first());
-          const int &compare_block_index = tracks_to_push.isEmpty() ? -1 : block_indexes.at(tracks_to_push.first());
-          Block *compare_block = compare_track ? compare_track->Blocks().at(compare_block_index) : nullptr;
-          if (!compare_track || compare_block->in() >= this_block->in()) {
-            if (compare_track && compare_block->in() != this_block->in()) {
-              tracks_to_push.clear();
-            }
-            tracks_to_push.append(i);
-          }
-        }
+  // Starts the next frame that actually needs rendering, returns false if none are left
+  auto start_next_frame = [&]() {
+    while (frame_iterator != frame_render_order.cend()) {
+      // Frames already rendering finish in the meantime, we just don't start any more
+      WaitWhilePaused();
+
+      if (IsCancelled()) {
+        break;
+      }
 
-        for (int i=0; i<tracks_to_push.size(); i++) {
-          Track *this_track = list->GetTrackAt(tracks_to_push.at(i));
-          Block *this_block = this_track->Blocks().at(block_indexes.at(tracks_to_push.at(i)));
+      const QPair<rational, QByteArray>& next = *frame_iterator;
+      frame_iterator++;
 
-          if (const SubtitleBlock *sub = dynamic_cast<const SubtitleBlock*>(this_block)) {
-            EncodeSubtitle(sub);
-          }
+      video_position = qMax(video_position, next.first);
 
-          block_indexes[tracks_to_push.at(i)]++;
-        }
-      } while (!tracks_to_push.isEmpty());
+      if (FramePtr prerendered = GetPrerenderedFrame(next.second)) {
+        FrameDownloaded(prerendered, next.second, time_map.value(next.second), job_time);
+      } else if (!PassthroughFrame(next.first, next.second, time_map.value(next.second))
+                 && ClaimFrame(next.second)) {
+        StartTicket(next.second, &watcher_thread, manager, next.first,
+                    mode, cache, force_size, force_matrix, force_format, force_color_output);
+        return true;
+      }
+
+      if (native_progress_signalling_) {
+        progress_counter += 1.0;
+        emit ProgressChanged(progress_counter / total_length);
+      }
     }
+
+    return false;
+  };
+
+  while (running_frames < maximum_rendered_frames && start_next_frame()) {
+    running_frames++;
   }
 
+  start_next_audio();
+
   finished_watcher_mutex_.lock();
 
   while (!IsCancelled()) {
@@ -199,6 +255,9 @@ bool RenderTask::Render(ColorManager* manager,
         //progress_counter += range.length().toDouble();
         //emit ProgressChanged(progress_counter / total_length);
 
+        running_audio--;
+        start_next_audio();
+
       } else if (ticket_type == RenderManager::kTypeVideo && TwoStepFrameRendering()) {
 
         DownloadFrame(&watcher_thread,
@@ -216,6 +275,11 @@ bool RenderTask::Render(ColorManager* manager,
         QByteArray rendered_hash = watcher->property("hash").toByteArray();
         FrameDownloaded(watcher->Get().value<FramePtr>(), rendered_hash, time_map.value(rendered_hash), job_time);
 
+        if (!extra_outputs_.isEmpty()) {
+          ExtraFramesDownloaded(watcher->GetTicket()->property("extraframes").value<QVector<FramePtr> >(),
+                                rendered_hash, time_map.value(rendered_hash));
+        }
+
         if (native_progress_signalling_) {
           double progress_to_add = 1.0;
           if (TwoStepFrameRendering()) {
@@ -226,13 +290,18 @@ bool RenderTask::Render(ColorManager* manager,
           emit ProgressChanged(progress_counter / total_length);
         }
 
-        if (frame_iterator != frame_render_order.cend()) {
-          StartTicket(frame_iterator->second, &watcher_thread, manager, frame_iterator->first,
-                      mode, cache, force_size, force_matrix, force_format, force_color_output);
+        running_frames--;
 
-          frame_iterator++;
+        // Top up to the maximum unless the consumer is holding too many frames already
+        while (running_frames < maximum_rendered_frames
+               && (running_frames == 0 || !IsFrameBufferFull())
+               && start_next_frame()) {
+          running_frames++;
         }
 
+        // Video has moved on, so audio may be able to as well
+        start_next_audio();
+
       }
 
       delete watcher;
@@ -280,12 +349,36 @@ void RenderTask::DownloadFrame(QThread *thread, FramePtr frame, const QByteArray
 
   watcher->SetTicket(RenderManager::instance()->SaveFrameToCache(viewer_->video_frame_cache(),
                                                                  frame,
-                                                                 hash));
+                                                                 hash,
+                                                                 RenderManager::kPriorityPlayback));
 }
 
-void RenderTask::EncodeSubtitle(const SubtitleBlock *subtitle)
+void RenderTask::EncodeSubtitle(const SubtitleCue &cue)
 {
-  Q_UNUSED(subtitle)
+  Q_UNUSED(cue)
+}
+
+SubtitleCueList RenderTask::GetSubtitleCues(Sequence *sequence, const TimeRange &range)
+{
+  SubtitleCueList cues;
+
+  TrackList *list = sequence->track_list(Track::kSubtitle);
+
+  for (int i=0; i<list->GetTrackCount(); i++) {
+    // Only visit the blocks that actually overlap the range rather than every block on the track
+    foreach (Block *b, list->GetTrackAt(i)->BlocksAtTimeRange(range)) {
+      if (const SubtitleBlock *sub = dynamic_cast<const SubtitleBlock*>(b)) {
+        cues.append(sub->GetCue());
+      }
+    }
+  }
+
+  // Each track is already in order, a stable sort keeps cues that start together in track order
+  std::stable_sort(cues.begin(), cues.end(), [](const SubtitleCue &a, const SubtitleCue &b){
+    return a.time().in() < b.time().in();
+  });
+
+  return cues;
 }
 
 void RenderTask::PrepareWatcher(RenderTicketWatcher *watcher, QThread *thread)
@@ -317,7 +410,21 @@ void RenderTask::StartTicket(const QByteArray& hash, QThread* watcher_thread, Co
                                                             mode, video_params_, audio_params_,
                                                             force_size, force_matrix,
                                                             force_format, force_color_output,
-                                                            cache));
+                                                            cache, RenderManager::kPriorityPlayback,
+                                                            false, QByteArray(), QRectF(), planar_yuv_,
+                                                            false, TwoStepFrameRendering() ? RenderManager::FrameOutputList() : extra_outputs_,
+                                                            render_node_));
+}
+
+void RenderTask::StartAudioTicket(const TimeRange &range, QThread *watcher_thread, RenderMode::Mode mode)
+{
+  RenderTicketWatcher* watcher = new RenderTicketWatcher();
+  watcher->setProperty("range", QVariant::fromValue(range));
+  PrepareWatcher(watcher, watcher_thread);
+
+  IncrementRunningTickets();
+
+  watcher->SetTicket(RenderManager::instance()->RenderAudio(viewer_, range, audio_params_, mode, false, RenderManager::kPriorityPlayback));
 }
 
 void RenderTask::TicketDone(RenderTicketWatcher* watcher)
@@ -26,12 +26,16 @@
 #include "node/block/subtitle/subtitle.h"
 #include "node/color/colormanager/colormanager.h"
 #include "node/output/viewer/viewer.h"
+#include "render/planaryuv.h"
+#include "render/rendermanager.h"
 #include "task/task.h"
 #include "threading/threadticket.h"
 #include "threading/threadticketwatcher.h"
 
 namespace olive {
 
+class Sequence;
+
 class RenderTask : public Task
 {
   Q_OBJECT
@@ -55,7 +59,19 @@ protected:
 
   virtual void AudioDownloaded(const TimeRange& range, SampleBufferPtr samples, qint64 job_time) = 0;
 
-  virtual void EncodeSubtitle(const SubtitleBlock *subtitle);
+  /**
+   * @brief Receives the frames rendered for SetExtraFrameOutputs(), in the same order
+   *
+   * Called right after FrameDownloaded() for the same frame.
+   */
+  virtual void ExtraFramesDownloaded(const QVector<FramePtr>& frames, const QByteArray& hash, const QVector<rational>& times)
+  {
+    Q_UNUSED(frames)
+    Q_UNUSED(hash)
+    Q_UNUSED(times)
+  }
+
+  virtual void EncodeSubtitle(const SubtitleCue &cue);
 
   ViewerOutput* viewer() const
   {
@@ -84,11 +100,122 @@ protected:
     return true;
   }
 
+  /**
+   * @brief Return true to stop Render() from starting more frames until some are consumed
+   *
+   * Checked every time a frame finishes. Render() always keeps at least one frame in flight so
+   * that whatever frame the consumer is waiting for still arrives.
+   */
+  virtual bool IsFrameBufferFull() const
+  {
+    return false;
+  }
+
+  /**
+   * @brief Called right before a unique frame starts rendering, return false to skip it
+   *
+   * Lets several processes split one render between them, e.g. when another process has already
+   * claimed this frame. Skipped frames never reach FrameDownloaded().
+   */
+  virtual bool ClaimFrame(const QByteArray& hash)
+  {
+    Q_UNUSED(hash)
+    return true;
+  }
+
+  /**
+   * @brief Return a frame rendered elsewhere to use instead of rendering this hash
+   *
+   * Called before ClaimFrame(). A non-null frame is handed straight to FrameDownloaded().
+   */
+  virtual FramePtr GetPrerenderedFrame(const QByteArray& hash)
+  {
+    Q_UNUSED(hash)
+    return nullptr;
+  }
+
+  /**
+   * @brief Handle a unique frame without rendering it at all, return true if it was handled
+   *
+   * Called after GetPrerenderedFrame() with the time the frame would be rendered at and every time
+   * sharing its hash. Handled frames never reach FrameDownloaded().
+   */
+  virtual bool PassthroughFrame(const rational& time, const QByteArray& hash, const QVector<rational>& times)
+  {
+    Q_UNUSED(time)
+    Q_UNUSED(hash)
+    Q_UNUSED(times)
+    return false;
+  }
+
   void SetNativeProgressSignallingEnabled(bool e)
   {
     native_progress_signalling_ = e;
   }
 
+  /**
+   * @brief Split video frames into contiguous segments and render from each segment in turn
+   *
+   * Useful when each segment is consumed independently (e.g. by its own encoder) so that all of
+   * them receive frames at the same time. Segment boundaries are given by GetSegmentStart().
+   */
+  void SetVideoSegmentCount(int segments)
+  {
+    video_segment_count_ = segments;
+  }
+
+  /**
+   * @brief Returns the index of the first frame in a segment
+   *
+   * Passing `index == segments` returns `frame_count`, i.e. the end of the last segment.
+   */
+  static int64_t GetSegmentStart(int64_t frame_count, int segments, int index)
+  {
+    return frame_count * index / segments;
+  }
+
+  /**
+   * @brief Have frames packed into this planar YUV layout on the GPU before they're downloaded
+   *
+   * Frames that can't be packed (e.g. odd dimensions) arrive as RGB(A) as usual, so consumers must
+   * check Frame::planar_yuv().
+   */
+  void SetPlanarYUV(const PlanarYUV& yuv)
+  {
+    planar_yuv_ = yuv;
+  }
+
+  /**
+   * @brief Also make each rendered frame with these output settings
+   *
+   * Every output comes from the same render of the frame, only scaled and color converted for each
+   * on the GPU (see RenderManager::RenderFrame()). Only used when TwoStepFrameRendering() is
+   * false, and frames that come from GetPrerenderedFrame() or PassthroughFrame() don't get them.
+   */
+  void SetExtraFrameOutputs(const RenderManager::FrameOutputList& outputs)
+  {
+    extra_outputs_ = outputs;
+  }
+
+  /**
+   * @brief Render this node's output instead of the viewer's texture output
+   *
+   * Times are passed to the node as they are, so they're in the node's own time rather than the
+   * sequence's. The viewer still provides the video and audio parameters.
+   */
+  void SetRenderNode(Node* node)
+  {
+    render_node_ = node;
+  }
+
+  /**
+   * @brief The output video frames are rendered from, used to hash them
+   */
+  NodeOutput GetTextureOutput() const
+  {
+    return render_node_ ? NodeOutput(render_node_) : viewer_->GetConnectedTextureOutput();
+  }
+
   /**
    * @brief Only valid after Render() is called
    */
@@ -106,14 +233,41 @@ protected:
   }
 
 private:
+  /**
+   * @brief Collect the subtitle cues overlapping `range` from all subtitle tracks, sorted by in point
+   */
+  static SubtitleCueList GetSubtitleCues(Sequence* sequence, const TimeRange& range);
+
   void PrepareWatcher(RenderTicketWatcher* watcher, QThread *thread);
 
   void IncrementRunningTickets();
 
   void StartTicket(const QByteArray &hash, QThread *watcher_thread, ColorManager *manager, const rational &time, RenderMode::Mode mode, FrameHashCache *cache, const QSize &force_size, const QMatrix4x4 &force_matrix, VideoParams::Format force_format, ColorProcessorPtr force_color_output);
 
+  void StartAudioTicket(const TimeRange& range, QThread *watcher_thread, RenderMode::Mode mode);
+
+  /**
+   * @brief Length of each block of audio rendered
+   */
+  static const rational kAudioBlockLength;
+
+  /**
+   * @brief Maximum number of audio blocks rendering at once
+   *
+   * Blocks are started in order, so this also bounds how many can arrive out of order and have to
+   * be held by the consumer.
+   */
+  static const int kMaximumAudioBlocks;
+
+  /**
+   * @brief How far audio is allowed to get ahead of the latest video frame started
+   */
+  static const rational kAudioLookahead;
+
   ViewerOutput* viewer_;
 
+  Node* render_node_;
+
   VideoParams video_params_;
 
   AudioParams audio_params_;
@@ -126,6 +280,12 @@ private:
 
   bool native_progress_signalling_;
 
+  int video_segment_count_;
+
+  PlanarYUV planar_yuv_;
+
+  RenderManager::FrameOutputList extra_outputs_;
+
   int64_t total_number_of_frames_;
   int64_t total_number_of_unique_frames_;
 
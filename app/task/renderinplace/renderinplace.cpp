@@ -0,0 +1,208 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "renderinplace.h"
+
+#include <QDir>
+#include <QUuid>
+
+#include "node/output/track/track.h"
+#include "node/project/folder/folder.h"
+#include "node/project/project.h"
+#include "widget/nodeparamview/nodeparamviewundo.h"
+#include "widget/nodeview/nodeviewundo.h"
+#include "widget/timelinewidget/timelineundo.h"
+
+namespace olive {
+
+RenderInPlaceTask::RenderInPlaceTask(Sequence *sequence, ClipBlock *clip, ColorManager *color_manager, const QString &filename) :
+  ExportTask(sequence, color_manager, GenerateParams(sequence, color_manager, GetSourceRange(clip), filename)),
+  clip_(clip),
+  source_(clip->GetConnectedOutput(ClipBlock::kBufferIn)),
+  range_(GetSourceRange(clip)),
+  filename_(filename),
+  colorspace_(color_manager->GetDefaultInputColorSpace()),
+  footage_(nullptr)
+{
+  SetTitle(tr("Rendering \"%1\" In Place").arg(clip->GetLabel().isEmpty() ? clip->Name() : clip->GetLabel()));
+  SetRenderNode(source_.node());
+}
+
+RenderInPlaceTask::~RenderInPlaceTask()
+{
+  // Only still set if CreateCommand() was never called
+  delete footage_;
+}
+
+bool RenderInPlaceTask::CanRenderInPlace(ClipBlock *clip)
+{
+  if (!clip->HasInputWithID(ClipBlock::kBufferIn)
+      || clip->IsFlattened()
+      || !clip->track()
+      || clip->track()->type() != Track::kVideo) {
+    return false;
+  }
+
+  // Only a node's default output can be rendered on its own, which also rules out clips connected
+  // straight to a footage stream where there'd be nothing to render anyway
+  NodeOutput source = clip->GetConnectedOutput(ClipBlock::kBufferIn);
+
+  return source.IsValid() && source.output() == Node::kDefaultOutput;
+}
+
+QString RenderInPlaceTask::GetOutputFilename(ClipBlock *clip)
+{
+  Project* project = clip->project();
+
+  QDir dir;
+  if (project->filename().isEmpty()) {
+    dir = QDir(project->cache_path());
+  } else {
+    dir = QFileInfo(project->filename()).dir().filePath(QStringLiteral("Rendered In Place"));
+  }
+
+  dir.mkpath(QStringLiteral("."));
+
+  QString uuid = QUuid::createUuid().toString();
+  uuid.remove(QChar('{'));
+  uuid.remove(QChar('}'));
+
+  return dir.filePath(QStringLiteral("%1.mov").arg(uuid));
+}
+
+MultiUndoCommand *RenderInPlaceTask::CreateCommand()
+{
+  if (!footage_ || !clip_->parent()
+      || !(clip_->GetConnectedOutput(ClipBlock::kBufferIn) == source_)) {
+    return nullptr;
+  }
+
+  Project* project = clip_->project();
+
+  MultiUndoCommand* command = new MultiUndoCommand();
+
+  command->add_child(new NodeAddCommand(project, footage_));
+  command->add_child(new FolderAddChild(project->root(), footage_));
+
+  NodeInput buffer(clip_, ClipBlock::kBufferIn);
+  NodeOutput rendered(footage_, Track::Reference(Track::kVideo, 0).ToString());
+
+  command->add_child(new NodeEdgeRemoveCommand(source_, buffer));
+  command->add_child(new NodeEdgeAddCommand(rendered, buffer));
+  command->add_child(new NodeEdgeAddCommand(source_, NodeInput(clip_, ClipBlock::kFlattenedSourceIn)));
+
+  // The render starts at the beginning of the clip's media, so shift it back to line up again
+  command->add_child(new BlockSetMediaInCommand(clip_, clip_->media_in() - range_.in()));
+  command->add_child(new NodeParamSetStandardValueCommand(NodeInput(clip_, ClipBlock::kFlattenedOffsetInput),
+                                                          QVariant::fromValue(range_.in())));
+
+  // The command owns it now
+  footage_ = nullptr;
+
+  return command;
+}
+
+MultiUndoCommand *RenderInPlaceTask::CreateRestoreCommand(ClipBlock *clip)
+{
+  MultiUndoCommand* command = new MultiUndoCommand();
+
+  if (!clip->IsFlattened()) {
+    return command;
+  }
+
+  NodeInput buffer(clip, ClipBlock::kBufferIn);
+  NodeInput flattened(clip, ClipBlock::kFlattenedSourceIn);
+  NodeOutput source = clip->GetConnectedOutput(flattened);
+  rational offset = clip->GetStandardValue(ClipBlock::kFlattenedOffsetInput).value<rational>();
+
+  if (clip->IsInputConnected(ClipBlock::kBufferIn)) {
+    command->add_child(new NodeEdgeRemoveCommand(clip->GetConnectedOutput(buffer), buffer));
+  }
+
+  command->add_child(new NodeEdgeRemoveCommand(source, flattened));
+  command->add_child(new NodeEdgeAddCommand(source, buffer));
+  command->add_child(new BlockSetMediaInCommand(clip, clip->media_in() + offset));
+  command->add_child(new NodeParamSetStandardValueCommand(NodeInput(clip, ClipBlock::kFlattenedOffsetInput),
+                                                          QVariant::fromValue(rational(0))));
+
+  return command;
+}
+
+bool RenderInPlaceTask::Run()
+{
+  if (!ExportTask::Run() || IsCancelled()) {
+    return false;
+  }
+
+  // Probe here rather than on the GUI thread when the command is created
+  Footage* footage = new Footage();
+
+  footage->SetLabel(QFileInfo(filename_).fileName());
+  footage->set_filename(filename_);
+
+  if (!footage->IsValid() || footage->InputArraySize(Footage::kVideoParamsInput) == 0) {
+    SetError(tr("Failed to open rendered file \"%1\"").arg(filename_));
+    delete footage;
+    return false;
+  }
+
+  // Frames were written premultiplied in the default input space, which the file doesn't say
+  VideoParams vp = footage->GetVideoParams(0);
+  vp.set_colorspace(colorspace_);
+  vp.set_premultiplied_alpha(true);
+  footage->SetVideoParams(vp, 0);
+
+  footage->moveToThread(clip_->thread());
+
+  footage_ = footage;
+
+  return true;
+}
+
+ExportParams RenderInPlaceTask::GenerateParams(Sequence *sequence, ColorManager *color_manager,
+                                               const TimeRange &range, const QString &filename)
+{
+  // Keep enough precision and the alpha channel that the render looks just like the original
+  VideoParams vp = sequence->GetVideoParams();
+  vp.set_format(VideoParams::kFormatUnsigned16);
+  vp.set_channel_count(VideoParams::kInternalChannelCount);
+
+  ExportParams params;
+  params.set_encoder(Encoder::GetTypeFromFormat(ExportFormat::kFormatQuickTime));
+  params.SetFilename(filename);
+  params.SetExportLength(range.length());
+  params.set_custom_range(range);
+
+  // ProRes 4444 is intra-only, so scrubbing a flattened clip only ever decodes one frame
+  params.EnableVideo(vp, ExportCodec::kCodecProRes);
+  params.set_video_option(QStringLiteral("profile"), QStringLiteral("4"));
+  params.set_video_pix_fmt(QStringLiteral("yuva444p10le"));
+  params.set_color_transform(ColorTransform(color_manager->GetDefaultInputColorSpace()));
+
+  return params;
+}
+
+TimeRange RenderInPlaceTask::GetSourceRange(ClipBlock *clip)
+{
+  // The part of the source the clip shows, in the source's own time
+  return clip->InputTimeAdjustment(ClipBlock::kBufferIn, -1, TimeRange(clip->in(), clip->out()));
+}
+
+}
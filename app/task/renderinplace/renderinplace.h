@@ -0,0 +1,105 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef RENDERINPLACETASK_H
+#define RENDERINPLACETASK_H
+
+#include "node/block/clip/clip.h"
+#include "node/project/footage/footage.h"
+#include "node/project/sequence/sequence.h"
+#include "task/export/export.h"
+#include "undo/undocommand.h"
+
+namespace olive {
+
+/**
+ * @brief Renders a clip's effects to an intra-frame file and swaps the file in as the clip's source
+ *
+ * Only what's connected to the clip's buffer is rendered, so the clip keeps its place, length and
+ * anything the sequence does with it afterwards (e.g. transitions). The original graph stays
+ * connected to the clip (see ClipBlock::IsFlattened()) so the flattening can be undone at any
+ * time with CreateRestoreCommand().
+ */
+class RenderInPlaceTask : public ExportTask
+{
+  Q_OBJECT
+public:
+  RenderInPlaceTask(Sequence* sequence, ClipBlock* clip, ColorManager* color_manager, const QString& filename);
+
+  virtual ~RenderInPlaceTask() override;
+
+  /**
+   * @brief Returns true if `clip` has effects on a video track that can be rendered in place
+   */
+  static bool CanRenderInPlace(ClipBlock* clip);
+
+  /**
+   * @brief Get a new filename for a render of `clip`
+   *
+   * Renders are kept beside the project if it's been saved, otherwise in its cache folder.
+   */
+  static QString GetOutputFilename(ClipBlock* clip);
+
+  /**
+   * @brief Create a command that swaps the rendered file in as the clip's source
+   *
+   * Must be called on the clip's thread once the task has succeeded, and can only be called once.
+   * Returns nullptr if the clip's source has changed since the task was created.
+   */
+  MultiUndoCommand* CreateCommand();
+
+  /**
+   * @brief Create a command that reconnects a flattened clip to its original graph
+   *
+   * The rendered footage is left in the project.
+   */
+  static MultiUndoCommand* CreateRestoreCommand(ClipBlock* clip);
+
+  ClipBlock* clip() const
+  {
+    return clip_;
+  }
+
+protected:
+  virtual bool Run() override;
+
+private:
+  static ExportParams GenerateParams(Sequence* sequence, ColorManager* color_manager,
+                                     const TimeRange& range, const QString& filename);
+
+  static TimeRange GetSourceRange(ClipBlock* clip);
+
+  ClipBlock* clip_;
+
+  NodeOutput source_;
+
+  TimeRange range_;
+
+  QString filename_;
+
+  QString colorspace_;
+
+  Footage* footage_;
+
+};
+
+}
+
+#endif // RENDERINPLACETASK_H
@@ -24,7 +24,9 @@
 #include <memory>
 #include <QDateTime>
 #include <QDebug>
+#include <QMutex>
 #include <QObject>
+#include <QWaitCondition>
 
 #include "common/cancelableobject.h"
 
@@ -57,10 +59,50 @@ public:
   Task() :
     title_(tr("Task")),
     error_(tr("Unknown error")),
-    start_time_(0)
+    start_time_(0),
+    paused_(false)
   {
   }
 
+  /**
+   * @brief Scheduling class of a Task, TaskManager always starts higher classes first
+   */
+  enum Priority {
+    /// Something the user is waiting on right now. Background tasks are paused while these run.
+    kPriorityInteractive,
+
+    kPriorityNormal,
+
+    /// Speculative work that can be paused at any time
+    kPriorityBackground,
+
+    kPriorityCount
+  };
+
+  /**
+   * @brief What a Task mostly spends its time on
+   *
+   * TaskManager limits how many tasks run at once for each resource, so e.g. a batch of disk heavy
+   * tasks doesn't leave the CPU idle or the disk thrashing.
+   */
+  enum Resource {
+    kResourceCPU,
+    kResourceIO,
+    kResourceGPU,
+
+    kResourceCount
+  };
+
+  virtual Priority GetPriority() const
+  {
+    return kPriorityNormal;
+  }
+
+  virtual Resource GetResource() const
+  {
+    return kResourceCPU;
+  }
+
   /**
    * @brief Retrieve the current title of this Task
    */
@@ -121,11 +163,45 @@ public slots:
   void Cancel()
   {
     CancelableObject::Cancel();
+
+    // Let a paused task see that it's been cancelled
+    SetPaused(false);
+  }
+
+  /**
+   * @brief Pause or resume the Task
+   *
+   * Tasks that support pausing stop at their next call to WaitWhilePaused() until resumed. This
+   * function is thread safe.
+   */
+  void SetPaused(bool e)
+  {
+    QMutexLocker locker(&pause_lock_);
+
+    paused_ = e;
+
+    if (!paused_) {
+      pause_wait_.wakeAll();
+    }
   }
 
 protected:
   virtual bool Run() = 0;
 
+  /**
+   * @brief Block while the Task is paused
+   *
+   * Call this regularly from Run() at points where it's safe to stop for a while.
+   */
+  void WaitWhilePaused()
+  {
+    QMutexLocker locker(&pause_lock_);
+
+    while (paused_ && !IsCancelled()) {
+      pause_wait_.wait(&pause_lock_);
+    }
+  }
+
   /**
    * @brief Set the error message
    *
@@ -175,6 +251,12 @@ private:
 
   qint64 start_time_;
 
+  bool paused_;
+
+  QMutex pause_lock_;
+
+  QWaitCondition pause_wait_;
+
 };
 
 }
@@ -27,14 +27,35 @@ namespace olive {
 
 TaskManager* TaskManager::instance_ = nullptr;
 
+const int TaskManager::kMaximumIOTasks = 2;
+const int TaskManager::kMaximumGPUTasks = 1;
+
 TaskManager::TaskManager()
 {
+  for (int i=0; i<Task::kResourceCount; i++) {
+    running_tasks_[i] = 0;
+  }
+
+  // Concurrency is limited per resource in ScheduleTasks(), so the pool must be able to run every
+  // task that's allowed at once
+  int max_threads = 0;
+  for (int i=0; i<Task::kResourceCount; i++) {
+    max_threads += GetResourceLimit(static_cast<Task::Resource>(i));
+  }
+  thread_pool_.setMaxThreadCount(max_threads);
 }
 
 TaskManager::~TaskManager()
 {
   thread_pool_.clear();
 
+  for (int i=0; i<Task::kPriorityCount; i++) {
+    foreach (Task* t, queued_tasks_[i]) {
+      t->deleteLater();
+    }
+    queued_tasks_[i].clear();
+  }
+
   foreach (Task* t, tasks_) {
     t->Cancel();
   }
@@ -64,18 +85,37 @@ TaskManager *TaskManager::instance()
 
 int TaskManager::GetTaskCount() const
 {
-  return tasks_.size();
+  int count = tasks_.size();
+
+  for (int i=0; i<Task::kPriorityCount; i++) {
+    count += queued_tasks_[i].size();
+  }
+
+  return count;
 }
 
 Task *TaskManager::GetFirstTask() const
 {
-  return tasks_.begin().value();
+  if (!tasks_.isEmpty()) {
+    return tasks_.begin().value();
+  }
+
+  for (int i=0; i<Task::kPriorityCount; i++) {
+    if (!queued_tasks_[i].empty()) {
+      return queued_tasks_[i].front();
+    }
+  }
+
+  return nullptr;
 }
 
 void TaskManager::CancelTaskAndWait(Task* t)
 {
   t->Cancel();
 
+  // Cancelled tasks are started regardless of resources, so this gets it running if it's queued
+  ScheduleTasks();
+
   QFutureWatcher<bool>* w = tasks_.key(t);
 
   if (w) {
@@ -85,18 +125,15 @@ void TaskManager::CancelTaskAndWait(Task* t)
 
 void TaskManager::AddTask(Task* t)
 {
-  // Create a watcher for signalling
-  QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>();
-  connect(watcher, &QFutureWatcher<bool>::finished, this, &TaskManager::TaskFinished);
-
   // Add the Task to the queue
-  tasks_.insert(watcher, t);
-
-  // Run task concurrently
-  watcher->setFuture(QtConcurrent::run(t, &Task::Start));
+  queued_tasks_[t->GetPriority()].push_back(t);
 
   // Emit signal that a Task was added
   emit TaskAdded(t);
+
+  // Run it now if there are resources for it
+  ScheduleTasks();
+
   emit TaskListChanged();
 }
 
@@ -108,15 +145,82 @@ void TaskManager::CancelTask(Task *t)
     t->deleteLater();
   } else {
     t->Cancel();
+
+    // Queued tasks still run so anything waiting on them hears they've finished, but it'll be
+    // immediate since they've been cancelled
+    ScheduleTasks();
   }
 }
 
+void TaskManager::ScheduleTasks()
+{
+  for (int i=0; i<Task::kPriorityCount; i++) {
+    std::list<Task*>& queue = queued_tasks_[i];
+
+    for (auto it=queue.begin(); it!=queue.end(); ) {
+      Task* t = *it;
+      Task::Resource resource = t->GetResource();
+
+      if (!t->IsCancelled() && running_tasks_[resource] >= GetResourceLimit(resource)) {
+        it++;
+        continue;
+      }
+
+      it = queue.erase(it);
+
+      // Create a watcher for signalling
+      QFutureWatcher<bool>* watcher = new QFutureWatcher<bool>();
+      connect(watcher, &QFutureWatcher<bool>::finished, this, &TaskManager::TaskFinished);
+
+      tasks_.insert(watcher, t);
+      running_tasks_[resource]++;
+
+      // Run task concurrently
+      watcher->setFuture(QtConcurrent::run(&thread_pool_, t, &Task::Start));
+    }
+  }
+
+  // Background work yields to anything the user is waiting on
+  bool interactive = !queued_tasks_[Task::kPriorityInteractive].empty();
+
+  if (!interactive) {
+    foreach (Task* t, tasks_) {
+      if (t->GetPriority() == Task::kPriorityInteractive) {
+        interactive = true;
+        break;
+      }
+    }
+  }
+
+  foreach (Task* t, tasks_) {
+    if (t->GetPriority() == Task::kPriorityBackground) {
+      t->SetPaused(interactive);
+    }
+  }
+}
+
+int TaskManager::GetResourceLimit(Task::Resource resource) const
+{
+  switch (resource) {
+  case Task::kResourceIO:
+    return kMaximumIOTasks;
+  case Task::kResourceGPU:
+    return kMaximumGPUTasks;
+  case Task::kResourceCPU:
+  case Task::kResourceCount:
+    break;
+  }
+
+  return QThread::idealThreadCount();
+}
+
 void TaskManager::TaskFinished()
 {
   QFutureWatcher<bool>* watcher = static_cast<QFutureWatcher<bool>*>(sender());
   Task* t = tasks_.value(watcher);
 
   tasks_.remove(watcher);
+  running_tasks_[t->GetResource()]--;
 
   if (watcher->result()) {
     // Task completed successfully
@@ -130,6 +234,8 @@ void TaskManager::TaskFinished()
 
   watcher->deleteLater();
 
+  ScheduleTasks();
+
   emit TaskListChanged();
 }
 
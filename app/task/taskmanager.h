@@ -34,8 +34,9 @@ namespace olive {
  *
  * TaskManager handles the life of a Task object. After a new Task is created, it should be sent to TaskManager through
  * AddTask(). TaskManager will take ownership of the task and add it to a queue until it system resources are available
- * for it to run. Currently, TaskManager will run no more Tasks than there are threads on the system (one task per
- * thread). As Tasks finished, TaskManager will start the next in the queue.
+ * for it to run. Queued Tasks are started in order of Task::GetPriority(), with a limit on how many run at once for
+ * each Task::Resource (e.g. no more CPU-bound Tasks than there are threads on the system). While any interactive Task
+ * is queued or running, running background Tasks are paused so they don't hold it up.
  */
 class TaskManager : public QObject
 {
@@ -111,11 +112,28 @@ signals:
   void TaskFailed(Task* t);
 
 private:
+  /**
+   * @brief Start as many queued tasks as resources allow and pause or resume background tasks
+   */
+  void ScheduleTasks();
+
+  int GetResourceLimit(Task::Resource resource) const;
+
+  static const int kMaximumIOTasks;
+  static const int kMaximumGPUTasks;
+
   /**
    * @brief Internal task array
    */
   QHash<QFutureWatcher<bool>*, Task*> tasks_;
 
+  /**
+   * @brief Tasks waiting for a resource, in order of arrival for each priority
+   */
+  std::list<Task*> queued_tasks_[Task::kPriorityCount];
+
+  int running_tasks_[Task::kResourceCount];
+
   /**
    * @brief Internal list of failed tasks
    */
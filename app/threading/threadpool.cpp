@@ -20,12 +20,47 @@
 
 #include "threadpool.h"
 
+#include "common/metrics.h"
+#include "render/hardwareprofile.h"
+
 namespace olive {
 
+namespace {
+
+struct ThreadPoolMetrics {
+  Metric* threads = MetricsRegistry::Gauge(QStringLiteral("olive_threadpool_threads"),
+                                           QStringLiteral("Threads across all render and decode pools"));
+
+  Metric* busy = MetricsRegistry::Gauge(QStringLiteral("olive_threadpool_busy_threads"),
+                                        QStringLiteral("Threads currently running a ticket"));
+
+  Metric* queued = MetricsRegistry::Gauge(QStringLiteral("olive_threadpool_queued_tickets"),
+                                          QStringLiteral("Tickets waiting for a free thread"));
+
+  Metric* dispatched = MetricsRegistry::Counter(QStringLiteral("olive_threadpool_tickets_total"),
+                                                QStringLiteral("Tickets handed to a thread"));
+};
+
+ThreadPoolMetrics* GetMetrics()
+{
+  static ThreadPoolMetrics metrics;
+  return &metrics;
+}
+
+}
+
 ThreadPool::ThreadPool(QThread::Priority priority, int threads, QObject *parent) :
   QObject(parent)
 {
-  all_threads_.resize(threads ? threads : QThread::idealThreadCount());
+  all_threads_.resize(threads ? threads : HardwareProfile::GetRenderThreadCount());
+
+  for (int i=0; i<kPriorityCount; i++) {
+    last_lane_[i] = -1;
+  }
+
+  // Keep a thread free for foreground tickets on larger pools so that interactive frames don't
+  // have to wait for a background ticket to finish before they can start
+  reserved_threads_ = (all_threads_.size() >= 4) ? 1 : 0;
 
   // Create threads
   for (int i=0; i<all_threads_.size(); i++) {
@@ -43,10 +78,20 @@ ThreadPool::ThreadPool(QThread::Priority priority, int threads, QObject *parent)
     // Start the thread at the given priority
     t->start(priority);
   }
+
+  GetMetrics()->threads->Add(all_threads_.size());
 }
 
 ThreadPool::~ThreadPool()
 {
+  GetMetrics()->threads->Add(-all_threads_.size());
+
+  for (int i=0; i<kPriorityCount; i++) {
+    for (const auto& lane : ticket_queue_[i]) {
+      GetMetrics()->queued->Add(-qint64(lane.second.size()));
+    }
+  }
+
   foreach (ThreadPoolThread* thread, all_threads_) {
     thread->Cancel();
     thread->wait();
@@ -56,32 +101,92 @@ ThreadPool::~ThreadPool()
 
 bool ThreadPool::RemoveTicket(RenderTicketPtr ticket)
 {
-  auto it = std::find(ticket_queue_.begin(), ticket_queue_.end(), ticket);
-  if (it == ticket_queue_.end()) {
-    return false;
+  for (int i=0; i<kPriorityCount; i++) {
+    TicketLanes& lanes = ticket_queue_[i];
+
+    for (auto lane=lanes.begin(); lane!=lanes.end(); lane++) {
+      auto it = std::find(lane->second.begin(), lane->second.end(), ticket);
+
+      if (it != lane->second.end()) {
+        lane->second.erase(it);
+
+        if (lane->second.empty()) {
+          lanes.erase(lane);
+        }
+
+        GetMetrics()->queued->Add(-1);
+
+        return true;
+      }
+    }
   }
 
-  ticket_queue_.erase(it);
-  return true;
+  return false;
 }
 
-void ThreadPool::AddTicket(RenderTicketPtr ticket, bool prioritize)
+void ThreadPool::AddTicket(RenderTicketPtr ticket, int priority)
 {
-  if (prioritize) {
-    ticket_queue_.push_front(ticket);
+  priority = qBound(0, priority, kPriorityCount - 1);
+
+  std::list<RenderTicketPtr>& lane = ticket_queue_[priority][GetTicketLane(ticket)];
+
+  if (priority == kPriorityInteractive) {
+    // The most recently requested interactive frame is the one the user is looking at
+    lane.push_front(ticket);
   } else {
-    ticket_queue_.push_back(ticket);
+    lane.push_back(ticket);
   }
 
+  GetMetrics()->queued->Increment();
+
   RunNext();
 }
 
+RenderTicketPtr ThreadPool::TakeNextTicket()
+{
+  for (int i=0; i<kPriorityCount; i++) {
+    TicketLanes& lanes = ticket_queue_[i];
+
+    if (lanes.empty()) {
+      continue;
+    }
+
+    if (i == kPriorityBackground && int(available_threads_.size()) <= reserved_threads_) {
+      // Only foreground work may use the reserved threads
+      break;
+    }
+
+    // Round-robin between lanes so that each ticket type gets its turn
+    auto lane = lanes.upper_bound(last_lane_[i]);
+    if (lane == lanes.end()) {
+      lane = lanes.begin();
+    }
+
+    RenderTicketPtr ticket = lane->second.front();
+    lane->second.pop_front();
+
+    last_lane_[i] = lane->first;
+
+    if (lane->second.empty()) {
+      lanes.erase(lane);
+    }
+
+    GetMetrics()->queued->Add(-1);
+
+    return ticket;
+  }
+
+  return nullptr;
+}
+
 void ThreadPool::RunNext()
 {
-  while (!ticket_queue_.empty() && !available_threads_.empty()) {
+  while (!available_threads_.empty()) {
     // Run function
-    RenderTicketPtr ticket = ticket_queue_.front();
-    ticket_queue_.pop_front();
+    RenderTicketPtr ticket = TakeNextTicket();
+    if (!ticket) {
+      break;
+    }
 
     ThreadPoolThread* thread = available_threads_.front();
     available_threads_.pop_front();
@@ -90,6 +195,9 @@ void ThreadPool::RunNext()
     ticket->Start();
     ticket->moveToThread(thread);
 
+    GetMetrics()->busy->Increment();
+    GetMetrics()->dispatched->Increment();
+
     // Run the ticket in the thread, which actually just calls our virtual function RunTicket
     thread->RunTicket(ticket);
   }
@@ -101,6 +209,8 @@ void ThreadPool::ThreadDone()
 
   available_threads_.push_back(thread);
 
+  GetMetrics()->busy->Add(-1);
+
   RunNext();
 }
 
@@ -21,6 +21,7 @@
 #ifndef THREADPOOL_H
 #define THREADPOOL_H
 
+#include <map>
 #include <QThread>
 
 #include "common/cancelableobject.h"
@@ -38,6 +39,25 @@ public:
 
   virtual ~ThreadPool() override;
 
+  /**
+   * @brief Quality-of-service class of a ticket
+   *
+   * Tickets are always dispatched from the highest class that has work queued. Within a class,
+   * each lane (see GetTicketLane()) is serviced in turn so one kind of ticket can't starve another.
+   */
+  enum Priority {
+    /// Frames the user is actively waiting on (seeking, scrubbing), dispatched newest first
+    kPriorityInteractive,
+
+    /// Sequential work that must keep up (playback, export)
+    kPriorityPlayback,
+
+    /// Speculative work that can wait (background precaching)
+    kPriorityBackground,
+
+    kPriorityCount
+  };
+
   RenderTicketPtr Queue();
 
   virtual void RunTicket(RenderTicketPtr ticket) const = 0;
@@ -45,16 +65,37 @@ public:
   bool RemoveTicket(RenderTicketPtr ticket);
 
 public slots:
-  void AddTicket(olive::RenderTicketPtr ticket, bool prioritize = false);
+  void AddTicket(olive::RenderTicketPtr ticket, int priority = kPriorityBackground);
+
+protected:
+  /**
+   * @brief Determine which lane a ticket is queued in within its priority class
+   *
+   * Derived classes can override this to separate different kinds of work (e.g. video and audio)
+   * so they are interleaved rather than served strictly in order of arrival.
+   */
+  virtual int GetTicketLane(const RenderTicketPtr& ticket) const
+  {
+    Q_UNUSED(ticket)
+    return 0;
+  }
 
 private:
   void RunNext();
 
+  RenderTicketPtr TakeNextTicket();
+
   QVector<ThreadPoolThread*> all_threads_;
 
   std::list<ThreadPoolThread*> available_threads_;
 
-  std::list<RenderTicketPtr> ticket_queue_;
+  using TicketLanes = std::map<int, std::list<RenderTicketPtr> >;
+
+  TicketLanes ticket_queue_[kPriorityCount];
+
+  int last_lane_[kPriorityCount];
+
+  int reserved_threads_;
 
 private slots:
   void ThreadDone();
@@ -20,12 +20,18 @@
 
 #include "threadticket.h"
 
+#include <QPointer>
+#include <QThread>
+
+#include "threadticketwatcher.h"
+
 namespace olive {
 
 RenderTicket::RenderTicket() :
   is_running_(false),
   has_result_(false),
-  finish_count_(0)
+  finish_count_(0),
+  run_time_(-1)
 {
   SetJobTime();
 }
@@ -44,6 +50,8 @@ void RenderTicket::Start()
   is_running_ = true;
   has_result_ = false;
   result_.clear();
+  run_time_ = -1;
+  run_timer_.start();
 }
 
 void RenderTicket::Finish()
@@ -121,11 +129,32 @@ void RenderTicket::FinishInternal(bool has_result, QVariant result)
     result_ = result;
     finish_count_++;
 
+    if (run_timer_.isValid()) {
+      run_time_ = run_timer_.nsecsElapsed();
+    }
+
     wait_.wakeAll();
 
+    // Watchers on this thread are notified straight away like a direct connection would, others
+    // are queued while still locked so they can't be destroyed in between
+    QVector< QPointer<RenderTicketWatcher> > direct_watchers;
+    foreach (RenderTicketWatcher* w, watchers_) {
+      if (w->thread() == QThread::currentThread()) {
+        direct_watchers.append(w);
+      } else {
+        RenderTicketWatcher::QueueFinished(w);
+      }
+    }
+
     locker.unlock();
 
     emit Finished();
+
+    foreach (const QPointer<RenderTicketWatcher>& w, direct_watchers) {
+      if (w) {
+        w->TicketFinished();
+      }
+    }
   }
 }
 
@@ -22,6 +22,7 @@
 #define RENDERTICKET_H
 
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QMutex>
 #include <QWaitCondition>
 
@@ -32,6 +33,8 @@
 
 namespace olive {
 
+class RenderTicketWatcher;
+
 class RenderTicket : public QObject
 {
   Q_OBJECT
@@ -48,6 +51,16 @@ public:
     job_time_ = QDateTime::currentMSecsSinceEpoch();
   }
 
+  /**
+   * @brief How long the ticket took to run in nanoseconds, or -1 if it hasn't finished running
+   *
+   * Time spent queued isn't counted.
+   */
+  qint64 GetRunTime() const
+  {
+    return run_time_;
+  }
+
   /**
    * @brief Get the ticket's current state
    *
@@ -127,6 +140,10 @@ private:
 
   bool is_running_;
 
+  // Watchers are notified directly rather than through the Finished() signal so their
+  // notifications can be batched, guarded by lock_
+  QVector<RenderTicketWatcher*> watchers_;
+
   QVariant result_;
 
   bool has_result_;
@@ -139,6 +156,12 @@ private:
 
   qint64 job_time_;
 
+  QElapsedTimer run_timer_;
+
+  qint64 run_time_;
+
+  friend class RenderTicketWatcher;
+
 };
 
 using RenderTicketPtr = std::shared_ptr<RenderTicket>;
@@ -20,14 +20,119 @@
 
 #include "threadticketwatcher.h"
 
+#include <QCoreApplication>
+#include <QEvent>
+#include <QThread>
+
 namespace olive {
 
+/**
+ * @brief Collects watchers on the main thread whose tickets have finished and notifies them all from
+ * a single posted event
+ */
+class RenderTicketWatcherBatch : public QObject
+{
+public:
+  static RenderTicketWatcherBatch* instance(bool create = true)
+  {
+    static RenderTicketWatcherBatch* batch = nullptr;
+    static QMutex create_lock;
+
+    QMutexLocker locker(&create_lock);
+    if (!batch && create) {
+      batch = new RenderTicketWatcherBatch();
+      batch->moveToThread(QCoreApplication::instance()->thread());
+    }
+    return batch;
+  }
+
+  void Append(RenderTicketWatcher* watcher)
+  {
+    QMutexLocker locker(&lock_);
+
+    pending_.append(watcher);
+
+    if (!posted_) {
+      posted_ = true;
+      QCoreApplication::postEvent(this, new QEvent(QEvent::User));
+    }
+  }
+
+  void Remove(RenderTicketWatcher* watcher)
+  {
+    QMutexLocker locker(&lock_);
+
+    pending_.removeAll(watcher);
+  }
+
+protected:
+  virtual bool event(QEvent* e) override
+  {
+    if (e->type() != QEvent::User) {
+      return QObject::event(e);
+    }
+
+    // Take one at a time since a watcher's receivers may delete other watchers in this batch, which
+    // removes them from pending_
+    forever {
+      QMutexLocker locker(&lock_);
+
+      if (pending_.isEmpty()) {
+        posted_ = false;
+        break;
+      }
+
+      RenderTicketWatcher* w = pending_.takeFirst();
+      locker.unlock();
+
+      w->TicketFinished();
+    }
+
+    return true;
+  }
+
+private:
+  RenderTicketWatcherBatch() :
+    posted_(false)
+  {
+  }
+
+  QMutex lock_;
+
+  QVector<RenderTicketWatcher*> pending_;
+
+  bool posted_;
+
+};
+
 RenderTicketWatcher::RenderTicketWatcher(QObject *parent) :
   QObject(parent),
   ticket_(nullptr)
 {
 }
 
+RenderTicketWatcher::~RenderTicketWatcher()
+{
+  if (ticket_) {
+    QMutexLocker locker(ticket_->lock());
+    ticket_->watchers_.removeOne(this);
+  }
+
+  if (RenderTicketWatcherBatch* batch = RenderTicketWatcherBatch::instance(false)) {
+    batch->Remove(this);
+  }
+}
+
+void RenderTicketWatcher::QueueFinished(RenderTicketWatcher *watcher)
+{
+  if (QCoreApplication::instance() && watcher->thread() == QCoreApplication::instance()->thread()) {
+    RenderTicketWatcherBatch::instance()->Append(watcher);
+  } else {
+    // Queued calls to an object are dropped if it's deleted before they run
+    QMetaObject::invokeMethod(watcher, "TicketFinished", Qt::QueuedConnection);
+  }
+}
+
 void RenderTicketWatcher::SetTicket(RenderTicketPtr ticket)
 {
   if (ticket_) {
@@ -45,7 +150,7 @@ void RenderTicketWatcher::SetTicket(RenderTicketPtr ticket)
   // Lock ticket so we can query if it's already finished by the time this code runs
   QMutexLocker locker(ticket->lock());
 
-  connect(ticket_.get(), &RenderTicket::Finished, this, &RenderTicketWatcher::TicketFinished);
+  ticket_->watchers_.append(this);
 
   if (!ticket_->IsRunning(false) && ticket_->GetFinishCount(false) > 0) {
     // Ticket has already finished before, so we emit a signal
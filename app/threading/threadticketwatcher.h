@@ -31,6 +31,8 @@ class RenderTicketWatcher : public QObject
 public:
   RenderTicketWatcher(QObject* parent = nullptr);
 
+  virtual ~RenderTicketWatcher() override;
+
   RenderTicketPtr GetTicket() const
   {
     return ticket_;
@@ -50,8 +52,19 @@ signals:
   void Finished(RenderTicketWatcher* watcher);
 
 private:
+  /**
+   * @brief Schedule Finished() to be emitted on the watcher's thread
+   *
+   * Watchers on the main thread are delivered in batches, so however many tickets finish between
+   * two passes of the event loop only one event is posted. Must be called with the ticket locked.
+   */
+  static void QueueFinished(RenderTicketWatcher* watcher);
+
   RenderTicketPtr ticket_;
 
+  friend class RenderTicket;
+  friend class RenderTicketWatcherBatch;
+
 private slots:
   void TicketFinished();
 
@@ -53,7 +53,7 @@ void TimelineMarker::set_name(const QString &name)
   emit NameChanged(name_);
 }
 
-void TimelineMarkerList::Save(QXmlStreamWriter *writer) const
+void TimelineMarkerList::Save(XMLWriter *writer) const
 {
   foreach (TimelineMarker* marker, markers_) {
     writer->writeStartElement(QStringLiteral("marker"));
@@ -99,7 +99,7 @@ const QList<TimelineMarker*> &TimelineMarkerList::list() const
   return markers_;
 }
 
-void TimelineMarkerList::Load(QXmlStreamReader *reader)
+void TimelineMarkerList::Load(XMLReader *reader)
 {
   while (XMLReadNextStartElement(reader)) {
     if (reader->name() == QStringLiteral("marker")) {
@@ -22,10 +22,9 @@
 #define TIMELINEMARKER_H
 
 #include <QString>
-#include <QXmlStreamReader>
-#include <QXmlStreamWriter>
 
 #include "common/timerange.h"
+#include "common/xmlstream.h"
 
 namespace olive {
 
@@ -67,8 +66,8 @@ public:
 
   const QList<TimelineMarker *> &list() const;
 
-  void Load(QXmlStreamReader* reader);
-  void Save(QXmlStreamWriter* writer) const;
+  void Load(XMLReader* reader);
+  void Save(XMLWriter* writer) const;
 
 signals:
   void MarkerAdded(TimelineMarker* marker);
@@ -39,7 +39,7 @@ const TimelineWorkArea *TimelinePoints::workarea() const
   return &workarea_;
 }
 
-void TimelinePoints::Load(QXmlStreamReader *reader)
+void TimelinePoints::Load(XMLReader *reader)
 {
   while (XMLReadNextStartElement(reader)) {
     if (reader->name() == QStringLiteral("markers")) {
@@ -52,7 +52,7 @@ void TimelinePoints::Load(QXmlStreamReader *reader)
   }
 }
 
-void TimelinePoints::Save(QXmlStreamWriter *writer) const
+void TimelinePoints::Save(XMLWriter *writer) const
 {
   writer->writeStartElement(QStringLiteral("workarea"));
     workarea_.Save(writer);
@@ -21,9 +21,7 @@
 #ifndef TIMELINEPOINTS_H
 #define TIMELINEPOINTS_H
 
-#include <QXmlStreamReader>
-#include <QXmlStreamWriter>
-
+#include "common/xmlstream.h"
 #include "timelinemarker.h"
 #include "timelineworkarea.h"
 
@@ -40,8 +38,8 @@ public:
   TimelineWorkArea* workarea();
   const TimelineWorkArea* workarea() const;
 
-  void Load(QXmlStreamReader* reader);
-  void Save(QXmlStreamWriter* writer) const;
+  void Load(XMLReader* reader);
+  void Save(XMLWriter* writer) const;
 
 private:
   TimelineMarkerList markers_;
@@ -55,7 +55,7 @@ void TimelineWorkArea::set_range(const TimeRange &range)
   emit RangeChanged(workarea_range_);
 }
 
-void TimelineWorkArea::Load(QXmlStreamReader *reader)
+void TimelineWorkArea::Load(XMLReader *reader)
 {
   rational range_in = workarea_range_.in();
   rational range_out = workarea_range_.out();
@@ -79,7 +79,7 @@ void TimelineWorkArea::Load(QXmlStreamReader *reader)
   reader->skipCurrentElement();
 }
 
-void TimelineWorkArea::Save(QXmlStreamWriter *writer) const
+void TimelineWorkArea::Save(XMLWriter *writer) const
 {
   writer->writeAttribute(QStringLiteral("enabled"), QString::number(workarea_enabled_));
   writer->writeAttribute(QStringLiteral("in"), workarea_range_.in().toString());
@@ -22,10 +22,9 @@
 #define TIMELINEWORKAREA_H
 
 #include <QObject>
-#include <QXmlStreamReader>
-#include <QXmlStreamWriter>
 
 #include "common/timerange.h"
+#include "common/xmlstream.h"
 
 namespace olive {
 
@@ -44,8 +43,8 @@ public:
   const TimeRange& range() const;
   void set_range(const TimeRange& range);
 
-  void Load(QXmlStreamReader* reader);
-  void Save(QXmlStreamWriter* writer) const;
+  void Load(XMLReader* reader);
+  void Save(XMLWriter* writer) const;
 
   static const rational kResetIn;
   static const rational kResetOut;
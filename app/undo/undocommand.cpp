@@ -20,10 +20,22 @@
 
 #include "undocommand.h"
 
+#include <QObject>
+
 #include "core.h"
 
 namespace olive {
 
+// Rough footprint of a node including its inputs and their values
+const qint64 UndoCommand::kEstimatedObjectSize = 4096;
+
+MultiUndoCommand::~MultiUndoCommand()
+{
+  for (auto it=children_.cbegin(); it!=children_.cend(); it++) {
+    delete (*it);
+  }
+}
+
 void MultiUndoCommand::redo()
 {
   for (auto it=children_.cbegin(); it!=children_.cend(); it++) {
@@ -38,6 +50,39 @@ void MultiUndoCommand::undo()
   }
 }
 
+qint64 MultiUndoCommand::EstimatedSize() const
+{
+  qint64 sz = UndoCommand::EstimatedSize();
+
+  for (auto it=children_.cbegin(); it!=children_.cend(); it++) {
+    sz += (*it)->EstimatedSize();
+  }
+
+  return sz;
+}
+
+bool MultiUndoCommand::MergeWith(const UndoCommand *other)
+{
+  // Most single edits (e.g. setting a value) are wrapped in a multi-command with one child
+  const MultiUndoCommand* multi = dynamic_cast<const MultiUndoCommand*>(other);
+
+  if (multi && children_.size() == 1 && multi->children_.size() == 1) {
+    return children_.front()->MergeWith(multi->children_.front());
+  }
+
+  return false;
+}
+
+qint64 UndoCommand::EstimatedSize() const
+{
+  return sizeof(UndoCommand) + name_.size() * sizeof(QChar);
+}
+
+qint64 UndoCommand::EstimateOwnedObjectsSize(const QObject *owner)
+{
+  return owner->findChildren<QObject*>(QString(), Qt::FindDirectChildrenOnly).size() * kEstimatedObjectSize;
+}
+
 void UndoCommand::redo_and_set_modified()
 {
   redo();
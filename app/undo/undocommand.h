@@ -25,6 +25,8 @@
 #include <QString>
 #include <vector>
 
+class QObject;
+
 #include "common/define.h"
 
 namespace olive {
@@ -49,6 +51,26 @@ public:
 
   virtual Project* GetRelevantProject() const = 0;
 
+  /**
+   * @brief Approximate memory held by this command while it's in its done state
+   *
+   * Used by UndoStack to cap the memory its history can use. Commands that keep removed nodes
+   * alive should include them.
+   */
+  virtual qint64 EstimatedSize() const;
+
+  /**
+   * @brief Absorb a command that was pushed directly after this one
+   *
+   * `other` has already been redone. Return true if this command now covers both, in which case
+   * `other` is deleted without being added to the stack.
+   */
+  virtual bool MergeWith(const UndoCommand* other)
+  {
+    Q_UNUSED(other)
+    return false;
+  }
+
   const QString& name() const
   {
     return name_;
@@ -59,7 +81,15 @@ public:
     name_ = name;
   }
 
+protected:
+  /**
+   * @brief Estimate the memory of every object `owner` keeps alive, e.g. a command's memory manager
+   */
+  static qint64 EstimateOwnedObjectsSize(const QObject* owner);
+
 private:
+  static const qint64 kEstimatedObjectSize;
+
   bool modified_;
 
   QString name_;
@@ -73,6 +103,8 @@ class MultiUndoCommand : public UndoCommand
 public:
   MultiUndoCommand() = default;
 
+  virtual ~MultiUndoCommand() override;
+
   virtual void redo() override;
   virtual void undo() override;
 
@@ -81,6 +113,10 @@ public:
     return nullptr;
   }
 
+  virtual qint64 EstimatedSize() const override;
+
+  virtual bool MergeWith(const UndoCommand* other) override;
+
   void add_child(UndoCommand* command)
   {
     children_.push_back(command);
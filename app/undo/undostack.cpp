@@ -22,11 +22,19 @@
 
 #include <QCoreApplication>
 
+#include "config/config.h"
+#include "render/playbackcache.h"
+
 namespace olive {
 
 const int UndoStack::kMaxUndoCommands = 200;
 
-UndoStack::UndoStack()
+// Edits closer together than this (e.g. scrolling over a value) can merge into one undo step
+const qint64 UndoStack::kMergeInterval = 1000;
+
+UndoStack::UndoStack() :
+  estimated_size_(0),
+  last_pushed_(nullptr)
 {
   undo_action_ = new QAction();
   connect(undo_action_, &QAction::triggered, this, &UndoStack::undo);
@@ -56,13 +64,10 @@ void UndoStack::pushIfHasChildren(MultiUndoCommand *command)
 
 void UndoStack::push(UndoCommand *command)
 {
+  // Edits often touch many tracks, let the caches merge what they invalidate
+  PlaybackCache::BeginBatch();
   command->redo_and_set_modified();
-  commands_.push_back(command);
-
-  if (commands_.size() > kMaxUndoCommands) {
-    delete commands_.front();
-    commands_.pop_front();
-  }
+  PlaybackCache::EndBatch();
 
   if (CanRedo()) {
     for (auto it=undone_commands_.cbegin(); it!=undone_commands_.cend(); it++) {
@@ -71,14 +76,43 @@ void UndoStack::push(UndoCommand *command)
     undone_commands_.clear();
   }
 
+  // Only merge with a command that's still on top, any undo or redo since resets this
+  if (last_pushed_ && last_push_timer_.elapsed() < kMergeInterval) {
+    qint64 old_size = last_pushed_->EstimatedSize();
+
+    if (last_pushed_->MergeWith(command)) {
+      delete command;
+
+      estimated_size_ += last_pushed_->EstimatedSize() - old_size;
+      last_push_timer_.start();
+
+      UpdateActions();
+      return;
+    }
+  }
+
+  commands_.push_back(command);
+  estimated_size_ += command->EstimatedSize();
+
+  last_pushed_ = command;
+  last_push_timer_.start();
+
+  TrimHistory();
+
   UpdateActions();
 }
 
 void UndoStack::undo()
 {
   if (CanUndo()) {
+    // Sizes are always measured in the done state so the total stays consistent
+    estimated_size_ -= commands_.back()->EstimatedSize();
+    last_pushed_ = nullptr;
+
     // Undo most recently done command
+    PlaybackCache::BeginBatch();
     commands_.back()->undo_and_set_modified();
+    PlaybackCache::EndBatch();
 
     // Place at the front of the "undone commands" list
     undone_commands_.push_front(commands_.back());
@@ -95,10 +129,14 @@ void UndoStack::redo()
 {
   if (CanRedo()) {
     // Redo most recently undone command
+    PlaybackCache::BeginBatch();
     undone_commands_.front()->redo_and_set_modified();
+    PlaybackCache::EndBatch();
 
     // Place at the back of the done commands list
     commands_.push_back(undone_commands_.front());
+    estimated_size_ += commands_.back()->EstimatedSize();
+    last_pushed_ = nullptr;
 
     // Remove done command from undone list
     undone_commands_.pop_front();
@@ -114,6 +152,27 @@ void UndoStack::clear()
     delete (*it);
   }
   commands_.clear();
+
+  for (auto it=undone_commands_.cbegin(); it!=undone_commands_.cend(); it++) {
+    delete (*it);
+  }
+  undone_commands_.clear();
+
+  estimated_size_ = 0;
+  last_pushed_ = nullptr;
+}
+
+void UndoStack::TrimHistory()
+{
+  qint64 memory_limit = Config::Current()[QStringLiteral("UndoMemoryLimit")].toLongLong() * 1024 * 1024;
+
+  // Always keep the most recent command so the last action can be undone
+  while (commands_.size() > 1
+         && (commands_.size() > size_t(kMaxUndoCommands) || (memory_limit > 0 && estimated_size_ > memory_limit))) {
+    estimated_size_ -= commands_.front()->EstimatedSize();
+    delete commands_.front();
+    commands_.pop_front();
+  }
 }
 
 void UndoStack::UpdateActions()
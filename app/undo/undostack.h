@@ -22,6 +22,7 @@
 #define UNDOSTACK_H
 
 #include <QAction>
+#include <QElapsedTimer>
 
 #include "common/define.h"
 #include "undo/undocommand.h"
@@ -43,6 +44,13 @@ public:
    */
   void pushIfHasChildren(MultiUndoCommand* command);
 
+  /**
+   * @brief Redo `command` and add it to the stack, taking ownership of it
+   *
+   * If the command is pushed shortly after the last one and can be merged into it (e.g. several
+   * changes to the same value), it's absorbed and deleted instead. The oldest commands are deleted
+   * when the history grows beyond kMaxUndoCommands or the "UndoMemoryLimit" config entry.
+   */
   void push(UndoCommand* command);
 
   void clear();
@@ -69,18 +77,36 @@ public:
     return redo_action_;
   }
 
+  /**
+   * @brief Approximate memory used by the commands that can currently be undone
+   */
+  qint64 GetEstimatedSize() const
+  {
+    return estimated_size_;
+  }
+
 public slots:
   void undo();
 
   void redo();
 
 private:
+  void TrimHistory();
+
   static const int kMaxUndoCommands;
 
+  static const qint64 kMergeInterval;
+
   std::list<UndoCommand*> commands_;
 
   std::list<UndoCommand*> undone_commands_;
 
+  qint64 estimated_size_;
+
+  UndoCommand* last_pushed_;
+
+  QElapsedTimer last_push_timer_;
+
   QAction* undo_action_;
 
   QAction* redo_action_;
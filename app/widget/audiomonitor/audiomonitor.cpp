@@ -37,6 +37,7 @@ AudioMonitor::AudioMonitor(QWidget *parent) :
   QOpenGLWidget(parent),
   file_(nullptr),
   waveform_(nullptr),
+  levels_(nullptr),
   cached_channels_(0)
 {
   values_.resize(kMaximumSmoothness);
@@ -60,6 +61,9 @@ void AudioMonitor::SetParams(const AudioParams &params)
     peaked_.resize(params_.channel_count());
     peaked_.fill(false);
 
+    rms_.resize(params_.channel_count());
+    rms_.fill(0);
+
     update();
   }
 }
@@ -95,6 +99,8 @@ void AudioMonitor::Stop()
   delete file_;
   file_ = nullptr;
   waveform_ = nullptr;
+  levels_ = nullptr;
+  rms_.fill(0);
 
   // We don't stop the update loop here so that the monitor can show a smooth fade out. The update
   // loop will stop itself since file_ and waveform_ are null.
@@ -111,7 +117,7 @@ void AudioMonitor::OutputPushed(const QByteArray &d)
   SetUpdateLoop(true);
 }
 
-void AudioMonitor::OutputAudioVisualWaveformSet(const AudioVisualWaveform *waveform, const rational &start, int playback_speed)
+void AudioMonitor::OutputAudioVisualWaveformSet(const AudioVisualWaveform *waveform, const AudioLevels *levels, const rational &start, int playback_speed)
 {
   Stop();
 
@@ -120,6 +126,7 @@ void AudioMonitor::OutputAudioVisualWaveformSet(const AudioVisualWaveform *wavef
   }
 
   waveform_ = waveform;
+  levels_ = levels;
   waveform_time_ = start;
 
   playback_speed_ = playback_speed;
@@ -308,6 +315,18 @@ void AudioMonitor::paintGL()
     if (!peaked_.at(i)) {
       p.drawRect(peaks_rect);
     }
+
+    if (i < rms_.size() && rms_.at(i) > 0) {
+      // Mark the RMS level across the channel's meter
+      QRect full_channel_rect = full_meter_rect;
+      full_channel_rect.setX(channel_x);
+      full_channel_rect.setWidth(channel_width);
+
+      double rms = QAudio::convertVolume(rms_.at(i), QAudio::LinearVolumeScale, QAudio::LogarithmicVolumeScale);
+      int rms_y = full_channel_rect.bottom() - qRound(full_channel_rect.height() * rms);
+
+      p.fillRect(QRect(full_channel_rect.x(), rms_y, full_channel_rect.width(), 2), palette().text().color());
+    }
   }
 
   if (all_zeroes && !IsPlaying()) {
@@ -351,6 +370,19 @@ void AudioMonitor::UpdateValuesFromWaveform(QVector<double> &v, qint64 delta_tim
   // Delta time is provided in milliseconds, so we convert to seconds in rational
   rational length(delta_time, 1000);
 
+  if (levels_ && levels_->channel_count() == v.size() && waveform_time_ < levels_->length()) {
+    // Levels were measured when the audio was rendered, so this is just a lookup
+    AudioLevels::Summary sum = levels_->GetSummaryFromTime(waveform_time_, length);
+
+    for (int i=0; i<v.size(); i++) {
+      v[i] = sum.peak.at(i);
+      rms_[i] = sum.rms.at(i);
+    }
+
+    waveform_time_ += length;
+    return;
+  }
+
   AudioVisualWaveform::Sample sum = waveform_->GetSummaryFromTime(waveform_time_, length);
 
   for (int i=0; i<sum.size(); i++) {
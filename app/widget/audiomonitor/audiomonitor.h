@@ -25,6 +25,7 @@
 #include <QOpenGLWidget>
 #include <QTimer>
 
+#include "audio/audiolevels.h"
 #include "audio/audiovisualwaveform.h"
 #include "common/define.h"
 #include "render/audioparams.h"
@@ -52,7 +53,7 @@ public slots:
 
   void OutputPushed(const QByteArray& d);
 
-  void OutputAudioVisualWaveformSet(const AudioVisualWaveform *waveform, const rational& start, int playback_speed);
+  void OutputAudioVisualWaveformSet(const AudioVisualWaveform *waveform, const AudioLevels* levels, const rational& start, int playback_speed);
 
 protected:
   virtual void paintGL() override;
@@ -78,8 +79,12 @@ private:
   qint64 last_time_;
 
   const AudioVisualWaveform* waveform_;
+  const AudioLevels* levels_;
   rational waveform_time_;
 
+  // RMS of the most recent update, drawn as a marker alongside the peak meter
+  QVector<double> rms_;
+
   int playback_speed_;
 
   QVector< QVector<double> > values_;
@@ -20,6 +20,7 @@
 
 #include "curveview.h"
 
+#include <algorithm>
 #include <QHash>
 #include <QMouseEvent>
 #include <QScrollBar>
@@ -61,6 +62,8 @@ void CurveView::Clear()
     delete line;
   }
   lines_.clear();
+
+  segment_cache_.clear();
 }
 
 void CurveView::ConnectInput(const NodeKeyframeTrackReference& ref)
@@ -192,72 +195,49 @@ void CurveView::drawBackground(QPainter *painter, const QRectF &rect)
         painter->setPen(QPen(keyframe_colors_.value(ref),
                              qMax(1, fontMetrics().height() / 4)));
 
-        // Create a path
-        QPainterPath path;
-
-        // Draw straight line leading to first keyframe
-        QPointF first_key_pos = item_map().value(track.first())->pos();
-        path.moveTo(QPointF(scene_bottom_left.x(), first_key_pos.y()));
-        path.lineTo(first_key_pos);
-
-        // Draw lines between each keyframe
-        for (int i=1;i<track.size();i++) {
-          NodeKeyframe* before = track.at(i-1);
-          NodeKeyframe* after = track.at(i);
-
-          KeyframeViewItem* before_item = item_map().value(before);
-          KeyframeViewItem* after_item = item_map().value(after);
-
-          if (before->type() == NodeKeyframe::kHold) {
-
-            // Draw a hold keyframe (basically a right angle)
-            path.lineTo(after_item->pos().x(), before_item->pos().y());
-            path.lineTo(after_item->pos().x(), after_item->pos().y());
-
-          } else if (before->type() == NodeKeyframe::kBezier && after->type() == NodeKeyframe::kBezier) {
+        // Only segments overlapping the exposed area are drawn. Keyframe x positions increase with
+        // time and handles are clamped between their neighbors, so a binary search is exact.
+        auto key_x = [this](NodeKeyframe* key){
+          return item_map().value(key)->pos().x();
+        };
 
-            // Draw a cubic bezier
+        int first_visible = std::upper_bound(track.cbegin(), track.cend(), rect.left(), [&key_x](qreal x, NodeKeyframe* key){
+          return x < key_x(key);
+        }) - track.cbegin();
+        first_visible = qMax(0, first_visible - 1);
 
-            // Cubic beziers have two control points, so we can just use both
-            QPointF before_control_point = before_item->pos() + ScalePoint(before->valid_bezier_control_out());
-            QPointF after_control_point = after_item->pos() + ScalePoint(after->valid_bezier_control_in());
+        int last_visible = std::lower_bound(track.cbegin(), track.cend(), rect.right(), [&key_x](NodeKeyframe* key, qreal x){
+          return key_x(key) < x;
+        }) - track.cbegin();
+        last_visible = qMin(track.size() - 1, last_visible);
 
-            path.cubicTo(before_control_point, after_control_point, after_item->pos());
+        QPolygonF line;
 
-          } else if (before->type() == NodeKeyframe::kBezier || after->type() == NodeKeyframe::kBezier) {
-            // Draw a quadratic bezier
-
-            // Quadratic beziers have a single control point, we just have to determine which it is
-            QPointF key_anchor;
-            QPointF control_point;
-
-            if (before->type() == NodeKeyframe::kBezier) {
-              key_anchor = before_item->pos();
-              control_point = before->valid_bezier_control_out();
-            } else {
-              key_anchor = after_item->pos();
-              control_point = after->valid_bezier_control_in();
-            }
-
-            // Scale control point
-            control_point = key_anchor + ScalePoint(control_point);
-
-            // Create the path from both keyframes
-            path.quadTo(control_point, after_item->pos());
+        if (first_visible == 0) {
+          // Draw straight line leading to first keyframe
+          QPointF first_key_pos = item_map().value(track.first())->pos();
+          line.append(QPointF(scene_bottom_left.x(), first_key_pos.y()));
+        }
 
-          } else {
+        line.append(item_map().value(track.at(first_visible))->pos());
 
-            // Linear to linear
-            path.lineTo(after_item->pos());
+        // Draw lines between each keyframe
+        for (int i=first_visible+1;i<=last_visible;i++) {
+          const QPolygonF& segment = GetCurveSegment(track.at(i-1), track.at(i));
 
+          // The first point of each segment is the last point of the previous one
+          for (int j=1;j<segment.size();j++) {
+            line.append(segment.at(j));
           }
         }
 
-        // Draw straight line leading from end keyframe
-        QPointF last_key_pos = item_map().value(track.last())->pos();
-        path.lineTo(QPointF(scene_top_right.x(), last_key_pos.y()));
+        if (last_visible == track.size() - 1) {
+          // Draw straight line leading from end keyframe
+          QPointF last_key_pos = item_map().value(track.last())->pos();
+          line.append(QPointF(scene_top_right.x(), last_key_pos.y()));
+        }
 
-        painter->drawPath(path);
+        painter->drawPolyline(line);
       }
     }
   }
@@ -281,6 +261,81 @@ void CurveView::KeyframeAboutToBeRemoved(NodeKeyframe *key)
 {
   disconnect(key, &NodeKeyframe::ValueChanged, this, &CurveView::KeyframeValueChanged);
   disconnect(key, &NodeKeyframe::TypeChanged, this, &CurveView::KeyframeTypeChanged);
+
+  segment_cache_.remove(key);
+}
+
+const QPolygonF &CurveView::GetCurveSegment(NodeKeyframe *before, NodeKeyframe *after)
+{
+  KeyframeViewItem* before_item = item_map().value(before);
+  KeyframeViewItem* after_item = item_map().value(after);
+
+  CurveSegment& seg = segment_cache_[before];
+
+  QPointF before_pos = before_item->pos();
+  QPointF after_pos = after_item->pos();
+  QPointF control_out = ScalePoint(before->valid_bezier_control_out());
+  QPointF control_in = ScalePoint(after->valid_bezier_control_in());
+
+  // Segments only depend on their two keyframes, so they're kept unless one of them changed. Scale
+  // changes move the keyframe items, so they're covered by the position check.
+  if (seg.after == after
+      && seg.before_type == before->type()
+      && seg.after_type == after->type()
+      && seg.before_pos == before_pos
+      && seg.after_pos == after_pos
+      && seg.control_out == control_out
+      && seg.control_in == control_in) {
+    return seg.points;
+  }
+
+  seg.after = after;
+  seg.before_type = before->type();
+  seg.after_type = after->type();
+  seg.before_pos = before_pos;
+  seg.after_pos = after_pos;
+  seg.control_out = control_out;
+  seg.control_in = control_in;
+
+  if (before->type() == NodeKeyframe::kHold) {
+
+    // Draw a hold keyframe (basically a right angle)
+    seg.points.clear();
+    seg.points << before_pos << QPointF(after_pos.x(), before_pos.y()) << after_pos;
+
+  } else if (before->type() == NodeKeyframe::kBezier || after->type() == NodeKeyframe::kBezier) {
+
+    QPainterPath path;
+    path.moveTo(before_pos);
+
+    if (before->type() == NodeKeyframe::kBezier && after->type() == NodeKeyframe::kBezier) {
+      // Cubic beziers have two control points, so we can just use both
+      path.cubicTo(before_pos + control_out, after_pos + control_in, after_pos);
+    } else if (before->type() == NodeKeyframe::kBezier) {
+      // Quadratic beziers have a single control point, we just have to determine which it is
+      path.quadTo(before_pos + control_out, after_pos);
+    } else {
+      path.quadTo(after_pos + control_in, after_pos);
+    }
+
+    // Flatten once here rather than having the painter do it on every repaint
+    QList<QPolygonF> polygons = path.toSubpathPolygons();
+    if (polygons.isEmpty()) {
+      seg.points.clear();
+      seg.points << before_pos << after_pos;
+    } else {
+      seg.points = polygons.first();
+    }
+
+  } else {
+
+    // Linear to linear
+    seg.points.clear();
+    seg.points << before_pos << after_pos;
+
+  }
+
+  return seg.points;
 }
 
 void CurveView::ScaleChangedEvent(const double& scale)
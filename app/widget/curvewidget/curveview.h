@@ -82,6 +82,23 @@ private:
 
   void CreateBezierControlPoints(KeyframeViewItem *item);
 
+  /**
+   * @brief Get the flattened line between two adjacent keyframes, regenerating it only if either changed
+   */
+  const QPolygonF& GetCurveSegment(NodeKeyframe* before, NodeKeyframe* after);
+
+  struct CurveSegment
+  {
+    NodeKeyframe* after = nullptr;
+    NodeKeyframe::Type before_type;
+    NodeKeyframe::Type after_type;
+    QPointF before_pos;
+    QPointF after_pos;
+    QPointF control_out;
+    QPointF control_in;
+    QPolygonF points;
+  };
+
   QHash<NodeKeyframeTrackReference, QColor> keyframe_colors_;
 
   int text_padding_;
@@ -94,6 +111,11 @@ private:
 
   QVector<NodeKeyframeTrackReference> connected_inputs_;
 
+  /**
+   * @brief Cached curve segments keyed by the keyframe they start from
+   */
+  QHash<NodeKeyframe*, CurveSegment> segment_cache_;
+
 private slots:
   void KeyframeValueChanged();
 
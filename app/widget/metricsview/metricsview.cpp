@@ -0,0 +1,197 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "metricsview.h"
+
+#include <QHelpEvent>
+#include <QLocale>
+#include <QPainter>
+#include <QToolTip>
+
+namespace olive {
+
+const int MetricsView::kSampleInterval = 500;
+
+// One minute of history at the sample interval above
+const int MetricsView::kHistoryLength = 120;
+
+MetricsView::MetricsView(QWidget *parent) :
+  QWidget(parent)
+{
+  sample_timer_.setInterval(kSampleInterval);
+  connect(&sample_timer_, &QTimer::timeout, this, &MetricsView::Sample);
+}
+
+void MetricsView::paintEvent(QPaintEvent *event)
+{
+  Q_UNUSED(event)
+
+  QPainter p(this);
+
+  int row_height = GetRowHeight();
+  int name_width = width() * 45 / 100;
+  int value_width = width() * 20 / 100;
+  int spark_x = name_width + value_width;
+  int spark_width = width() - spark_x;
+  int padding = fontMetrics().height() / 4;
+
+  for (int i=0; i<metrics_.size(); i++) {
+    Metric* m = metrics_.at(i);
+    const QVector<double>& samples = history_.value(m).samples;
+    int y = i * row_height;
+
+    if (i % 2) {
+      p.fillRect(0, y, width(), row_height, palette().alternateBase());
+    }
+
+    p.setPen(palette().text().color());
+
+    // Every metric has the same prefix, no need to show it
+    QString name = m->name();
+    if (name.startsWith(QStringLiteral("olive_"))) {
+      name = name.mid(6);
+    }
+
+    p.drawText(QRect(padding, y, name_width - padding, row_height),
+               Qt::AlignLeft | Qt::AlignVCenter,
+               fontMetrics().elidedText(name, Qt::ElideRight, name_width - padding));
+
+    if (!samples.isEmpty()) {
+      p.drawText(QRect(name_width, y, value_width - padding, row_height),
+                 Qt::AlignRight | Qt::AlignVCenter,
+                 FormatValue(m, samples.last()));
+    }
+
+    if (samples.size() < 2) {
+      continue;
+    }
+
+    // Scale from zero so small fluctuations around a large value don't look dramatic
+    double max = 0;
+    foreach (double s, samples) {
+      max = qMax(max, s);
+    }
+
+    QRectF spark_rect(spark_x + padding, y + padding, spark_width - padding * 2, row_height - padding * 2);
+    QPolygonF line;
+
+    for (int j=0; j<samples.size(); j++) {
+      // Right-align so the newest sample is always at the right edge
+      double x = spark_rect.right() - spark_rect.width() * (samples.size() - 1 - j) / (kHistoryLength - 1);
+      double v = (max > 0) ? samples.at(j) / max : 0;
+
+      line.append(QPointF(x, spark_rect.bottom() - v * spark_rect.height()));
+    }
+
+    p.setPen(palette().highlight().color());
+    p.drawPolyline(line);
+  }
+}
+
+void MetricsView::showEvent(QShowEvent *event)
+{
+  QWidget::showEvent(event);
+
+  since_last_sample_.invalidate();
+  Sample();
+  sample_timer_.start();
+}
+
+void MetricsView::hideEvent(QHideEvent *event)
+{
+  QWidget::hideEvent(event);
+
+  sample_timer_.stop();
+}
+
+bool MetricsView::event(QEvent *event)
+{
+  if (event->type() == QEvent::ToolTip) {
+    QHelpEvent* help_event = static_cast<QHelpEvent*>(event);
+    int row = help_event->pos().y() / GetRowHeight();
+
+    if (row >= 0 && row < metrics_.size()) {
+      QToolTip::showText(help_event->globalPos(), metrics_.at(row)->help(), this);
+    } else {
+      QToolTip::hideText();
+      event->ignore();
+    }
+
+    return true;
+  }
+
+  return QWidget::event(event);
+}
+
+QString MetricsView::FormatValue(const Metric *m, double v)
+{
+  QString s;
+
+  if (m->name().endsWith(QStringLiteral("_bytes"))) {
+    s = QLocale().formattedDataSize(qint64(v));
+  } else {
+    s = QLocale().toString(v, 'f', (m->type() == Metric::kCounter) ? 1 : 0);
+  }
+
+  if (m->type() == Metric::kCounter) {
+    s = tr("%1/s").arg(s);
+  }
+
+  return s;
+}
+
+int MetricsView::GetRowHeight() const
+{
+  return fontMetrics().height() * 3 / 2;
+}
+
+void MetricsView::Sample()
+{
+  // Counters are shown as rates, which needs the time since they were last read
+  double elapsed = since_last_sample_.isValid() ? since_last_sample_.restart() / 1000.0 : 0;
+  if (!since_last_sample_.isValid()) {
+    since_last_sample_.start();
+  }
+
+  metrics_ = MetricsRegistry::Collect();
+
+  foreach (Metric* m, metrics_) {
+    History& h = history_[m];
+    qint64 raw = m->value();
+
+    if (m->type() == Metric::kGauge) {
+      h.samples.append(raw);
+    } else if (elapsed > 0) {
+      h.samples.append((raw - h.last_raw_value) / elapsed);
+    }
+
+    h.last_raw_value = raw;
+
+    if (h.samples.size() > kHistoryLength) {
+      h.samples.removeFirst();
+    }
+  }
+
+  setMinimumHeight(metrics_.size() * GetRowHeight());
+
+  update();
+}
+
+}
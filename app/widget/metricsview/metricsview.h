@@ -0,0 +1,84 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef METRICSVIEW_H
+#define METRICSVIEW_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QTimer>
+#include <QWidget>
+
+#include "common/metrics.h"
+
+namespace olive {
+
+/**
+ * @brief Shows every metric in the MetricsRegistry with its current value and a sparkline of its
+ * recent history
+ *
+ * Gauges are shown as-is, counters as their rate per second. Metrics are only sampled while the
+ * widget is visible.
+ */
+class MetricsView : public QWidget
+{
+  Q_OBJECT
+public:
+  MetricsView(QWidget* parent = nullptr);
+
+protected:
+  virtual void paintEvent(QPaintEvent* event) override;
+
+  virtual void showEvent(QShowEvent* event) override;
+
+  virtual void hideEvent(QHideEvent* event) override;
+
+  virtual bool event(QEvent* event) override;
+
+private:
+  struct History {
+    QVector<double> samples;
+    qint64 last_raw_value = 0;
+  };
+
+  static QString FormatValue(const Metric* m, double v);
+
+  int GetRowHeight() const;
+
+  QVector<Metric*> metrics_;
+
+  QHash<Metric*, History> history_;
+
+  QTimer sample_timer_;
+
+  QElapsedTimer since_last_sample_;
+
+  static const int kSampleInterval;
+
+  static const int kHistoryLength;
+
+private slots:
+  void Sample();
+
+};
+
+}
+
+#endif // METRICSVIEW_H
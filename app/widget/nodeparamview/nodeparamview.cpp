@@ -27,14 +27,21 @@
 
 #include "common/timecodefunctions.h"
 #include "node/output/viewer/viewer.h"
+#include "widget/viewer/viewer.h"
 
 namespace olive {
 
+const int NodeParamView::kPlaybackUpdateInterval = 250;
+
 NodeParamView::NodeParamView(QWidget *parent) :
   TimeBasedWidget(true, false, parent),
   last_scroll_val_(0),
   focused_node_(nullptr)
 {
+  playback_update_timer_.setInterval(kPlaybackUpdateInterval);
+  playback_update_timer_.setSingleShot(true);
+  connect(&playback_update_timer_, &QTimer::timeout, this, &NodeParamView::PlaybackUpdateTimeout);
+
   // Create horizontal layout to place scroll area in (and keyframe editing eventually)
   QHBoxLayout* layout = new QHBoxLayout(this);
   layout->setSpacing(0);
@@ -254,11 +261,32 @@ void NodeParamView::UpdateItemTime(const int64_t &timestamp)
 {
   rational time = Timecode::timestamp_to_time(timestamp, timebase());
 
+  if (ViewerWidget::IsAnyViewerPlaying()) {
+    playback_update_time_ = time;
+
+    if (!playback_update_timer_.isActive()) {
+      playback_update_timer_.start();
+    }
+    return;
+  }
+
+  playback_update_timer_.stop();
+
   foreach (NodeParamViewItem* item, items_) {
     item->SetTime(time);
   }
 }
 
+void NodeParamView::PlaybackUpdateTimeout()
+{
+  // If playback has stopped since, this is the last update so every input has to catch up
+  bool animated_only = ViewerWidget::IsAnyViewerPlaying();
+
+  foreach (NodeParamViewItem* item, items_) {
+    item->SetTime(playback_update_time_, animated_only);
+  }
+}
+
 void NodeParamView::QueueKeyframePositionUpdate()
 {
   QMetaObject::invokeMethod(this, &NodeParamView::UpdateElementY, Qt::QueuedConnection);
@@ -21,6 +21,7 @@
 #ifndef NODEPARAMVIEW_H
 #define NODEPARAMVIEW_H
 
+#include <QTimer>
 #include <QVBoxLayout>
 #include <QWidget>
 
@@ -99,6 +100,13 @@ protected:
   virtual void ConnectedNodeChangeEvent(ViewerOutput* n) override;
 
 private:
+  /**
+   * @brief Show the item values at `timestamp`
+   *
+   * While a viewer is playing, items are only updated every kPlaybackUpdateInterval, and then only
+   * their keyframed inputs, so the GUI thread has its time free for presenting frames. Everything is
+   * brought up to date once playback stops.
+   */
   void UpdateItemTime(const int64_t &timestamp);
 
   void QueueKeyframePositionUpdate();
@@ -131,6 +139,12 @@ private:
 
   Node* focused_node_;
 
+  QTimer playback_update_timer_;
+
+  rational playback_update_time_;
+
+  static const int kPlaybackUpdateInterval;
+
 private slots:
   void ItemRequestedTimeChanged(const rational& time);
 
@@ -144,6 +158,8 @@ private slots:
 
   void UpdateElementY();
 
+  void PlaybackUpdateTimeout();
+
 };
 
 }
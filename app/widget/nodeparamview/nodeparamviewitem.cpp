@@ -79,11 +79,11 @@ void NodeParamViewItem::SetTimeTarget(Node *target)
   body_->SetTimeTarget(target);
 }
 
-void NodeParamViewItem::SetTime(const rational &time)
+void NodeParamViewItem::SetTime(const rational &time, bool animated_only)
 {
   time_ = time;
 
-  body_->SetTime(time_);
+  body_->SetTime(time_, animated_only);
 }
 
 void NodeParamViewItem::SetTimebase(const rational& timebase)
@@ -362,9 +362,16 @@ void NodeParamViewItemBody::SetTimeTarget(Node *target)
   }
 }
 
-void NodeParamViewItemBody::SetTime(const rational &time)
+void NodeParamViewItemBody::SetTime(const rational &time, bool animated_only)
 {
-  foreach (const InputUI& ui_obj, input_ui_map_) {
+  for (auto it=input_ui_map_.cbegin(); it!=input_ui_map_.cend(); it++) {
+    const InputUI& ui_obj = it.value();
+
+    if (animated_only && !it.key().IsKeyframing()) {
+      // Shows the same value at any time
+      continue;
+    }
+
     // Only keyframable inputs have a key control widget
     if (ui_obj.key_control) {
       ui_obj.key_control->SetTime(time);
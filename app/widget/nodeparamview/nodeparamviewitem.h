@@ -79,7 +79,10 @@ public:
 
   void SetTimeTarget(Node* target);
 
-  void SetTime(const rational& time);
+  /**
+   * @brief Update every input's widgets for `time`, or if `animated_only` is set, only keyframed ones
+   */
+  void SetTime(const rational& time, bool animated_only = false);
 
   void Retranslate();
 
@@ -168,7 +171,7 @@ public:
 
   void SetTimeTarget(Node* target);
 
-  void SetTime(const rational& time);
+  void SetTime(const rational& time, bool animated_only = false);
 
   // Set the timebase of the NodeParamViewItemBody
   void SetTimebase(const rational& timebase);
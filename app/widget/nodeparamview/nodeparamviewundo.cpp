@@ -77,6 +77,18 @@ void NodeParamSetKeyframeValueCommand::undo()
   key_->set_value(old_value_);
 }
 
+bool NodeParamSetKeyframeValueCommand::MergeWith(const UndoCommand *other)
+{
+  const NodeParamSetKeyframeValueCommand* c = dynamic_cast<const NodeParamSetKeyframeValueCommand*>(other);
+
+  if (c && c->key_ == key_ && c->old_value_ == new_value_) {
+    new_value_ = c->new_value_;
+    return true;
+  }
+
+  return false;
+}
+
 NodeParamInsertKeyframeCommand::NodeParamInsertKeyframeCommand(Node* node, NodeKeyframe* keyframe) :
   input_(node),
   keyframe_(keyframe)
@@ -180,6 +192,18 @@ void NodeParamSetStandardValueCommand::undo()
   ref_.input().node()->SetSplitStandardValueOnTrack(ref_, old_value_);
 }
 
+bool NodeParamSetStandardValueCommand::MergeWith(const UndoCommand *other)
+{
+  const NodeParamSetStandardValueCommand* c = dynamic_cast<const NodeParamSetStandardValueCommand*>(other);
+
+  if (c && c->ref_ == ref_ && c->old_value_ == new_value_) {
+    new_value_ = c->new_value_;
+    return true;
+  }
+
+  return false;
+}
+
 NodeParamArrayAppendCommand::NodeParamArrayAppendCommand(Node *node, const QString &input) :
   node_(node),
   input_(input)
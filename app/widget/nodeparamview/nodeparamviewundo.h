@@ -54,6 +54,11 @@ public:
   virtual void redo() override;
   virtual void undo() override;
 
+  virtual qint64 EstimatedSize() const override
+  {
+    return UndoCommand::EstimatedSize() + EstimateOwnedObjectsSize(&memory_manager_);
+  }
+
 private:
   Node* input_;
 
@@ -73,6 +78,11 @@ public:
   virtual void redo() override;
   virtual void undo() override;
 
+  virtual qint64 EstimatedSize() const override
+  {
+    return UndoCommand::EstimatedSize() + EstimateOwnedObjectsSize(&memory_manager_);
+  }
+
 private:
   Node* input_;
 
@@ -112,6 +122,8 @@ public:
   virtual void redo() override;
   virtual void undo() override;
 
+  virtual bool MergeWith(const UndoCommand* other) override;
+
 private:
   NodeKeyframe* key_;
 
@@ -131,6 +143,8 @@ public:
   virtual void redo() override;
   virtual void undo() override;
 
+  virtual bool MergeWith(const UndoCommand* other) override;
+
 private:
   NodeKeyframeTrackReference ref_;
 
@@ -23,6 +23,8 @@
 #include <QInputDialog>
 #include <QMouseEvent>
 #include <QScrollBar>
+#include <QSet>
+#include <QStyleOptionGraphicsItem>
 
 #include "core.h"
 #include "nodeviewundo.h"
@@ -60,8 +62,10 @@ NodeView::NodeView(QWidget *parent) :
 
   SetFlowDirection(NodeViewCommon::kTopToBottom);
 
-  // Set massive scene rect and hide the scrollbars to create an "infinite space" effect
-  scene_.setSceneRect(-1000000, -1000000, 2000000, 2000000);
+  // Set massive view rect and hide the scrollbars to create an "infinite space" effect. This is set
+  // on the view rather than the scene so the scene's item index stays sized to the graph itself,
+  // otherwise every node ends up in the same cell and hit testing has to check all of them.
+  setSceneRect(-1000000, -1000000, 2000000, 2000000);
   setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
   setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
 }
@@ -83,6 +87,7 @@ void NodeView::SetGraph(NodeGraph *graph)
     disconnect(graph_, &NodeGraph::NodeRemoved, &scene_, &NodeViewScene::RemoveNode);
     disconnect(graph_, &NodeGraph::InputConnected, &scene_, &NodeViewScene::AddEdge);
     disconnect(graph_, &NodeGraph::InputDisconnected, &scene_, &NodeViewScene::RemoveEdge);
+    disconnect(graph_, &NodeGraph::BatchCommitted, &scene_, &NodeViewScene::ApplyChanges);
 
     DeselectAll();
 
@@ -99,6 +104,7 @@ void NodeView::SetGraph(NodeGraph *graph)
     connect(graph_, &NodeGraph::NodeRemoved, &scene_, &NodeViewScene::RemoveNode);
     connect(graph_, &NodeGraph::InputConnected, &scene_, &NodeViewScene::AddEdge);
     connect(graph_, &NodeGraph::InputDisconnected, &scene_, &NodeViewScene::RemoveEdge);
+    connect(graph_, &NodeGraph::BatchCommitted, &scene_, &NodeViewScene::ApplyChanges);
 
     foreach (Node* n, graph_->nodes()) {
       scene_.AddNode(n);
@@ -118,7 +124,8 @@ void NodeView::DeleteSelected()
     return;
   }
 
-  MultiUndoCommand* command = new MultiUndoCommand();
+  // Removing many nodes at once shouldn't have listeners react to each one
+  MultiUndoCommand* command = new NodeGraphBatchCommand(graph_);
 
   {
     QVector<NodeViewEdge *> selected_edges = scene_.GetSelectedEdges();
@@ -168,9 +175,14 @@ void NodeView::SelectAll()
     emit NodesSelected(graph_->nodes());
   } else {
     // We have to determine the difference
+    QSet<Node*> old_selection;
+    foreach (Node* n, selected_nodes_) {
+      old_selection.insert(n);
+    }
+
     QVector<Node*> new_selection;
     foreach (Node* n, graph_->nodes()) {
-      if (!selected_nodes_.contains(n)) {
+      if (!old_selection.contains(n)) {
         new_selection.append(n);
       }
     }
@@ -217,14 +229,14 @@ void NodeView::Select(QVector<Node *> nodes)
   scene_.DeselectAll();
 
   // Remove any duplicates
-  QVector<Node*> processed;
+  QSet<Node*> processed;
 
   foreach (Node* n, nodes) {
     if (processed.contains(n)) {
       continue;
     }
 
-    processed.append(n);
+    processed.insert(n);
 
     NodeViewItem* item = scene_.NodeToUIObject(n);
 
@@ -297,7 +309,16 @@ void NodeView::Paste()
 
   MultiUndoCommand* command = new MultiUndoCommand();
 
-  QVector<Node*> pasted_nodes = PasteNodesFromClipboard(graph_, command);
+  // The scene has to have caught up with the batch before nodes can be attached to the cursor
+  NodeGraphBatchCommand* paste_command = new NodeGraphBatchCommand(graph_);
+
+  QVector<Node*> pasted_nodes = PasteNodesFromClipboard(graph_, paste_command);
+
+  if (paste_command->child_count() > 0) {
+    command->add_child(paste_command);
+  } else {
+    delete paste_command;
+  }
 
   if (!pasted_nodes.isEmpty()) {
     command->add_child(new NodeViewAttachNodesToCursor(this, pasted_nodes));
@@ -320,7 +341,10 @@ void NodeView::Duplicate()
 
   MultiUndoCommand* command = new MultiUndoCommand();
 
-  QVector<Node*> duplicated_nodes = Node::CopyDependencyGraph(selected, command);
+  NodeGraphBatchCommand* duplicate_command = new NodeGraphBatchCommand(graph_);
+  command->add_child(duplicate_command);
+
+  QVector<Node*> duplicated_nodes = Node::CopyDependencyGraph(selected, duplicate_command);
 
   if (!duplicated_nodes.isEmpty()) {
     command->add_child(new NodeViewAttachNodesToCursor(this, duplicated_nodes));
@@ -629,13 +653,25 @@ void NodeView::UpdateSelectionCache()
   QVector<Node*> selected;
   QVector<Node*> deselected;
 
+  // Rubber band selection calls this on every mouse move, so compare through sets rather than
+  // searching one list for every entry in the other
+  QSet<Node*> old_set;
+  foreach (Node* n, selected_nodes_) {
+    old_set.insert(n);
+  }
+
+  QSet<Node*> current_set;
+  foreach (Node* n, current_selection) {
+    current_set.insert(n);
+  }
+
   // Determine which nodes are newly selected
   if (selected_nodes_.isEmpty()) {
     // All nodes in the current selection have just been selected
     selected = current_selection;
   } else {
     foreach (Node* n, current_selection) {
-      if (!selected_nodes_.contains(n)) {
+      if (!old_set.contains(n)) {
         selected.append(n);
       }
     }
@@ -647,7 +683,7 @@ void NodeView::UpdateSelectionCache()
     deselected = selected_nodes_;
   } else {
     foreach (Node* n, selected_nodes_) {
-      if (!current_selection.contains(n)) {
+      if (!current_set.contains(n)) {
         deselected.append(n);
       }
     }
@@ -709,6 +745,11 @@ void NodeView::ShowContextMenu(const QPoint &pos)
     curved_action->setChecked(scene_.GetEdgesAreCurved());
     connect(curved_action, &QAction::triggered, &scene_, &NodeViewScene::SetEdgesAreCurved);
 
+    QAction* gpu_time_action = m.addAction(tr("Show GPU Time"));
+    gpu_time_action->setCheckable(true);
+    gpu_time_action->setChecked(scene_.GetShowGpuTime());
+    connect(gpu_time_action, &QAction::triggered, &scene_, &NodeViewScene::SetShowGpuTime);
+
     m.addSeparator();
 
     AddSetScrollZoomsByDefaultActionToMenu(&m);
@@ -876,6 +917,37 @@ void NodeView::ZoomIntoCursorPosition(QWheelEvent *event, double multiplier, con
   }
 }
 
+void NodeView::drawBackground(QPainter *painter, const QRectF &rect)
+{
+  super::drawBackground(painter, rect);
+
+  if (!NodeViewCommon::IsLowDetail(QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform()))) {
+    return;
+  }
+
+  // Edges skip painting themselves when zoomed out, so draw them all here grouped by color
+  QHash<QRgb, QVector<QLineF> > lines;
+
+  foreach (NodeViewEdge* edge, scene_.edges()) {
+    QLineF line = edge->GetLine();
+
+    if (QRectF(line.p1(), line.p2()).normalized().adjusted(-1, -1, 1, 1).intersects(rect)) {
+      lines[edge->GetEdgeColor(edge->isSelected()).rgba()].append(line);
+    }
+  }
+
+  painter->save();
+
+  painter->setRenderHint(QPainter::Antialiasing, false);
+
+  for (auto it=lines.cbegin(); it!=lines.cend(); it++) {
+    painter->setPen(QPen(QColor::fromRgba(it.key()), 0));
+    painter->drawLines(it.value());
+  }
+
+  painter->restore();
+}
+
 void NodeView::ZoomFromKeyboard(double multiplier)
 {
   QPoint cursor_pos = mapFromGlobal(QCursor::pos());
@@ -92,6 +92,8 @@ protected:
 
   virtual void ZoomIntoCursorPosition(QWheelEvent *event, double multiplier, const QPointF &cursor_pos) override;
 
+  virtual void drawBackground(QPainter *painter, const QRectF &rect) override;
+
 private:
   void AttachNodesToCursor(const QVector<Node *> &nodes);
 
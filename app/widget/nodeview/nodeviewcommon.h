@@ -51,6 +51,16 @@ public:
             || (a == NodeViewCommon::kBottomToTop && b == NodeViewCommon::kTopToBottom));
   }
 
+  /**
+   * @brief Returns whether items at this level of detail should be drawn simplified
+   *
+   * Below this zoom labels are too small to read, so nodes are drawn as plain boxes and edges are
+   * drawn as straight lines all at once by NodeView.
+   */
+  static bool IsLowDetail(qreal level_of_detail) {
+    return level_of_detail < 0.4;
+  }
+
 };
 
 }
@@ -23,6 +23,7 @@
 #include <QApplication>
 #include <QDebug>
 #include <QGraphicsSceneMouseEvent>
+#include <QPainterPathStroker>
 #include <QStyleOptionGraphicsItem>
 
 #include "common/bezier.h"
@@ -154,6 +155,8 @@ void NodeViewEdge::SetPoints(const QPointF &start, const QPointF &end, bool inpu
   arrow_ = QPolygonF(arrow_points);
   arrow_bounding_rect_ = arrow_.boundingRect();
   arrow_bounding_rect_.adjust(-arrow_size_, -arrow_size_, arrow_size_, arrow_size_);
+
+  shape_up_to_date_ = false;
 }
 
 void NodeViewEdge::SetFlowDirection(NodeViewCommon::FlowDirection dir)
@@ -172,7 +175,7 @@ void NodeViewEdge::SetCurved(bool e)
   update();
 }
 
-void NodeViewEdge::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
+QColor NodeViewEdge::GetEdgeColor(bool selected) const
 {
   QPalette::ColorGroup group;
   QPalette::ColorRole role;
@@ -183,14 +186,40 @@ void NodeViewEdge::paint(QPainter *painter, const QStyleOptionGraphicsItem *opti
     group = QPalette::Disabled;
   }
 
-  if (highlighted_ != bool(option->state & QStyle::State_Selected)) {
+  if (highlighted_ != selected) {
     role = QPalette::Highlight;
   } else {
     role = QPalette::Text;
   }
 
+  return qApp->palette().color(group, role);
+}
+
+QPainterPath NodeViewEdge::shape() const
+{
+  // QGraphicsPathItem strokes the whole curve on every call, which rubber band selection and
+  // hit testing do for every edge they touch
+  if (!shape_up_to_date_) {
+    QPainterPathStroker stroker;
+    stroker.setWidth(qMax(1, edge_width_));
+    shape_ = stroker.createStroke(path());
+    shape_.addPolygon(arrow_);
+    shape_up_to_date_ = true;
+  }
+
+  return shape_;
+}
+
+void NodeViewEdge::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *)
+{
+  // Connected edges are drawn in one batch by NodeView when zoomed out
+  if (from_item_ && to_item_
+      && NodeViewCommon::IsLowDetail(option->levelOfDetailFromTransform(painter->worldTransform()))) {
+    return;
+  }
+
   // Draw main path
-  QColor edge_color = qApp->palette().color(group, role);
+  QColor edge_color = GetEdgeColor(bool(option->state & QStyle::State_Selected));
 
   painter->setPen(QPen(edge_color, edge_width_));
   painter->setBrush(Qt::NoBrush);
@@ -208,6 +237,7 @@ void NodeViewEdge::Init()
   highlighted_ = false;
   flow_dir_ = NodeViewCommon::kLeftToRight;
   curved_ = true;
+  shape_up_to_date_ = false;
 
   setFlag(QGraphicsItem::ItemIsSelectable);
 
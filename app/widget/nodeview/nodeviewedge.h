@@ -116,6 +116,21 @@ public:
    */
   void SetCurved(bool e);
 
+  /**
+   * @brief Get the color this edge is drawn in
+   */
+  QColor GetEdgeColor(bool selected) const;
+
+  /**
+   * @brief Get the straight line between the ends of this edge, used when drawn in low detail
+   */
+  QLineF GetLine() const
+  {
+    return QLineF(path().elementAt(0), path().currentPosition());
+  }
+
+  virtual QPainterPath shape() const override;
+
 protected:
   virtual void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget = nullptr) override;
 
@@ -148,6 +163,13 @@ private:
 
   QRectF arrow_bounding_rect_;
 
+  /**
+   * @brief Stroked outline for hit testing, only generated when it's needed
+   */
+  mutable QPainterPath shape_;
+
+  mutable bool shape_up_to_date_;
+
 };
 
 }
@@ -33,6 +33,7 @@
 #include "nodeview.h"
 #include "nodeviewscene.h"
 #include "nodeviewundo.h"
+#include "render/nodegpuprofiler.h"
 #include "ui/colorcoding.h"
 #include "ui/icons/icons.h"
 #include "window/mainwindow/mainwindow.h"
@@ -240,6 +241,14 @@ void NodeViewItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *opti
   // has been slightly modified
   QPalette app_pal = Core::instance()->main_window()->palette();
 
+  // When zoomed too far out to read anything, just draw a box in the node's color
+  if (node_ && NodeViewCommon::IsLowDetail(option->levelOfDetailFromTransform(painter->worldTransform()))) {
+    painter->setPen((option->state & QStyle::State_Selected) ? app_pal.color(QPalette::Highlight) : Qt::black);
+    painter->setBrush(node_->color().toQColor());
+    painter->drawRect(rect());
+    return;
+  }
+
   // Draw background rect if expanded
   if (IsExpanded()) {
     painter->setPen(Qt::NoPen);
@@ -301,6 +310,22 @@ void NodeViewItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *opti
       DrawNodeTitle(painter, node_shortname, safe_label_bounds, Qt::AlignBottom, icon_size, false);
     }
 
+    NodeViewScene* node_scene = qobject_cast<NodeViewScene*>(scene());
+    if (node_scene && node_scene->GetShowGpuTime()) {
+      double gpu_ms = NodeGpuProfiler::GetMilliseconds(node_);
+
+      if (gpu_ms >= 0) {
+        QFont f;
+        f.setPointSizeF(f.pointSizeF() * 0.6);
+        painter->setFont(f);
+
+        int text_pad = DefaultTextPadding()/2;
+        painter->drawText(title_bar_rect_.adjusted(text_pad, text_pad, -text_pad, -text_pad),
+                          Qt::AlignRight | Qt::AlignBottom,
+                          QCoreApplication::translate("NodeViewItem", "GPU %1 ms").arg(gpu_ms, 0, 'f', 2));
+      }
+    }
+
   }
 
   // Draw final border
@@ -102,6 +102,11 @@ public:
   void AddEdge(NodeViewEdge* edge);
   void RemoveEdge(NodeViewEdge* edge);
 
+  const QVector<NodeViewEdge*>& edges() const
+  {
+    return edges_;
+  }
+
   int GetIndexAt(QPointF pt) const;
 
   NodeInput GetInputAtIndex(int index) const
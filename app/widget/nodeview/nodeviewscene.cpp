@@ -24,14 +24,25 @@
 #include "node/project/sequence/sequence.h"
 #include "nodeviewedge.h"
 #include "nodeviewitem.h"
+#include "render/nodegpuprofiler.h"
 
 namespace olive {
 
+const int NodeViewScene::kGpuTimeUpdateInterval = 500;
+
 NodeViewScene::NodeViewScene(QObject *parent) :
   QGraphicsScene(parent),
   direction_(NodeViewCommon::kLeftToRight),
-  curved_edges_(true)
+  curved_edges_(true),
+  show_gpu_time_(false)
+{
+  gpu_time_timer_.setInterval(kGpuTimeUpdateInterval);
+  connect(&gpu_time_timer_, &QTimer::timeout, this, [this]{ update(); });
+}
+
+NodeViewScene::~NodeViewScene()
 {
+  SetShowGpuTime(false);
 }
 
 void NodeViewScene::SetFlowDirection(NodeViewCommon::FlowDirection direction)
@@ -100,9 +111,14 @@ NodeViewItem *NodeViewScene::NodeToUIObject(Node *n)
 
 NodeViewEdge *NodeViewScene::EdgeToUIObject(const NodeOutput& output, const NodeInput& input)
 {
-  foreach (NodeViewEdge* edge, edges_) {
-    if (edge->output() == output && edge->input() == input) {
-      return edge;
+  // Only the destination's own edges need checking
+  NodeViewItem* to = item_map_.value(input.node());
+
+  if (to) {
+    foreach (NodeViewEdge* edge, to->edges()) {
+      if (edge->output() == output && edge->input() == input) {
+        return edge;
+      }
     }
   }
 
@@ -111,12 +127,15 @@ NodeViewEdge *NodeViewScene::EdgeToUIObject(const NodeOutput& output, const Node
 
 QVector<Node *> NodeViewScene::GetSelectedNodes() const
 {
-  QHash<Node*, NodeViewItem*>::const_iterator iterator;
   QVector<Node *> selected;
 
-  for (iterator=item_map_.begin();iterator!=item_map_.end();iterator++) {
-    if (iterator.value()->isSelected()) {
-      selected.append(iterator.key());
+  // QGraphicsScene already tracks its selection, so this is proportional to the selection rather
+  // than the whole graph
+  foreach (QGraphicsItem* item, selectedItems()) {
+    NodeViewItem* node_item = dynamic_cast<NodeViewItem*>(item);
+
+    if (node_item && node_item->GetNode()) {
+      selected.append(node_item->GetNode());
     }
   }
 
@@ -125,12 +144,13 @@ QVector<Node *> NodeViewScene::GetSelectedNodes() const
 
 QVector<NodeViewItem *> NodeViewScene::GetSelectedItems() const
 {
-  QHash<Node*, NodeViewItem*>::const_iterator iterator;
   QVector<NodeViewItem *> selected;
 
-  for (iterator=item_map_.begin();iterator!=item_map_.end();iterator++) {
-    if (iterator.value()->isSelected()) {
-      selected.append(iterator.value());
+  foreach (QGraphicsItem* item, selectedItems()) {
+    NodeViewItem* node_item = dynamic_cast<NodeViewItem*>(item);
+
+    if (node_item) {
+      selected.append(node_item);
     }
   }
 
@@ -141,8 +161,10 @@ QVector<NodeViewEdge *> NodeViewScene::GetSelectedEdges() const
 {
   QVector<NodeViewEdge*> edges;
 
-  foreach (NodeViewEdge* e, edges_) {
-    if (e->isSelected()) {
+  foreach (QGraphicsItem* item, selectedItems()) {
+    NodeViewEdge* e = dynamic_cast<NodeViewEdge*>(item);
+
+    if (e) {
       edges.append(e);
     }
   }
@@ -188,6 +210,42 @@ void NodeViewScene::RemoveEdge(const NodeOutput &output, const NodeInput &input)
   delete edge;
 }
 
+void NodeViewScene::ApplyChanges(const NodeGraphChangeSet &changes)
+{
+  // Remove edges in one pass over the edge list rather than searching it for each one
+  if (!changes.disconnected.isEmpty()) {
+    QSet<NodeViewEdge*> removed_edges;
+
+    foreach (const NodeGraphChangeSet::Edge& e, changes.disconnected) {
+      NodeViewEdge* edge = EdgeToUIObject(e.first, e.second);
+      edge->from_item()->RemoveEdge(edge);
+      edge->to_item()->RemoveEdge(edge);
+      removed_edges.insert(edge);
+    }
+
+    for (int i=0; i<edges_.size(); i++) {
+      if (removed_edges.contains(edges_.at(i))) {
+        edges_.removeAt(i);
+        i--;
+      }
+    }
+
+    qDeleteAll(removed_edges);
+  }
+
+  foreach (Node* node, changes.removed) {
+    RemoveNode(node);
+  }
+
+  foreach (Node* node, changes.added) {
+    AddNode(node);
+  }
+
+  foreach (const NodeGraphChangeSet::Edge& e, changes.connected) {
+    AddEdge(e.first, e.second);
+  }
+}
+
 int NodeViewScene::DetermineWeight(Node *n)
 {
   QVector<Node*> inputs = n->GetImmediateDependencies();
@@ -271,6 +329,23 @@ void NodeViewScene::SetEdgesAreCurved(bool curved)
   }
 }
 
+void NodeViewScene::SetShowGpuTime(bool e)
+{
+  if (show_gpu_time_ != e) {
+    show_gpu_time_ = e;
+
+    if (show_gpu_time_) {
+      NodeGpuProfiler::AddUser();
+      gpu_time_timer_.start();
+    } else {
+      NodeGpuProfiler::RemoveUser();
+      gpu_time_timer_.stop();
+    }
+
+    update();
+  }
+}
+
 void NodeViewScene::NodePositionChanged(const QPointF &pos)
 {
   // Update node's internal position
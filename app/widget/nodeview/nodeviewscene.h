@@ -36,6 +36,8 @@ class NodeViewScene : public QGraphicsScene
 public:
   NodeViewScene(QObject *parent = nullptr);
 
+  virtual ~NodeViewScene() override;
+
   void clear();
 
   void SelectAll();
@@ -79,6 +81,11 @@ public:
     return curved_edges_;
   }
 
+  bool GetShowGpuTime() const
+  {
+    return show_gpu_time_;
+  }
+
   void ReorganizeFrom(Node* n);
 
 public slots:
@@ -101,11 +108,21 @@ public slots:
   void AddEdge(const NodeOutput& output, const NodeInput& input);
   void RemoveEdge(const NodeOutput& output, const NodeInput& input);
 
+  /**
+   * @brief Slot when a NodeGraph commits a batch of changes (SetGraph() connects this)
+   */
+  void ApplyChanges(const NodeGraphChangeSet& changes);
+
   /**
    * @brief Set whether edges in this scene should be curved or not
    */
   void SetEdgesAreCurved(bool curved);
 
+  /**
+   * @brief Set whether nodes show how much GPU time their shaders take (see NodeGpuProfiler)
+   */
+  void SetShowGpuTime(bool e);
+
 private:
   static int DetermineWeight(Node* n);
 
@@ -121,6 +138,12 @@ private:
 
   bool curved_edges_;
 
+  bool show_gpu_time_;
+
+  QTimer gpu_time_timer_;
+
+  static const int kGpuTimeUpdateInterval;
+
 private slots:
   /**
    * @brief Receiver for whenever a node position changes
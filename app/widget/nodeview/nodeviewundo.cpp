@@ -170,4 +170,18 @@ Project *NodeRenameCommand::GetRelevantProject() const
   return nodes_.isEmpty() ? nullptr : nodes_.first()->project();
 }
 
+void NodeGraphBatchCommand::redo()
+{
+  graph_->BeginBatch();
+  MultiUndoCommand::redo();
+  graph_->EndBatch();
+}
+
+void NodeGraphBatchCommand::undo()
+{
+  graph_->BeginBatch();
+  MultiUndoCommand::undo();
+  graph_->EndBatch();
+}
+
 }
@@ -110,6 +110,13 @@ public:
     return dynamic_cast<Project*>(graph_);
   }
 
+  virtual qint64 EstimatedSize() const override
+  {
+    return UndoCommand::EstimatedSize()
+        + EstimateOwnedObjectsSize(&memory_manager_)
+        + (command_ ? command_->EstimatedSize() : 0);
+  }
+
   virtual void redo() override
   {
     if (!prepped_) {
@@ -168,6 +175,11 @@ public:
     }
   }
 
+  virtual qint64 EstimatedSize() const override
+  {
+    return UndoCommand::EstimatedSize() + (command_ ? command_->EstimatedSize() : 0);
+  }
+
   virtual void redo() override
   {
     if (!prepped_) {
@@ -348,6 +360,29 @@ private:
 
 };
 
+/**
+ * @brief Runs its children inside a NodeGraph batch so the graph's listeners update once for all of them
+ *
+ * See NodeGraph::BeginBatch(). Commands that need listeners to have caught up (e.g. anything that
+ * looks up a node's NodeViewItem) must run after this one rather than inside it.
+ */
+class NodeGraphBatchCommand : public MultiUndoCommand
+{
+public:
+  NodeGraphBatchCommand(NodeGraph* graph) :
+    graph_(graph)
+  {
+  }
+
+  virtual void redo() override;
+
+  virtual void undo() override;
+
+private:
+  NodeGraph* graph_;
+
+};
+
 }
 
 #endif // NODEVIEWUNDO_H
@@ -64,6 +64,7 @@ ProjectExplorer::ProjectExplorer(QWidget *parent) :
 
   // Set up sort filter proxy model
   sort_model_.setSourceModel(&model_);
+  sort_model_.setSortRole(ProjectViewModel::kSortRole);
 
   // Add tree view to stacked widget
   tree_view_ = new ProjectExplorerTreeView(stacked_widget_);
@@ -194,6 +195,21 @@ bool ProjectExplorer::DeleteItemsInternal(const QVector<Node*>& selected, bool&
     // Delete sequences first
     Node* node = selected.at(i);
 
+    if (Project* project = node->project()) {
+      // Any deferred sequence contents involved need to exist so they can be removed and restored
+      // along with this item
+      QVector<Node*> affected = node->GetDependencies();
+      affected.prepend(node);
+
+      foreach (Node* n, affected) {
+        if (Sequence* sequence = dynamic_cast<Sequence*>(n)) {
+          project->LoadDeferredSequence(sequence);
+        }
+
+        project->LoadDeferredSequencesUsing(n);
+      }
+    }
+
     bool can_delete_item = true;
 
     if (check_if_item_is_in_use) {
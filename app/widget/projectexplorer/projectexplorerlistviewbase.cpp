@@ -30,6 +30,12 @@ ProjectExplorerListViewBase::ProjectExplorerListViewBase(QWidget *parent) :
   // FIXME Is this necessary?
   setMovement(QListView::Free);
 
+  // Every item is drawn the same size, so the view doesn't need to ask each one for its size
+  setUniformItemSizes(true);
+
+  // Lay out large bins in chunks so the view stays responsive while it fills
+  setLayoutMode(QListView::Batched);
+
   // Set selection mode (allows multiple item selection)
   setSelectionMode(QAbstractItemView::ExtendedSelection);
 
@@ -41,6 +41,9 @@ ProjectExplorerTreeView::ProjectExplorerTreeView(QWidget *parent) :
 
   // Set context menu to emit a signal
   setContextMenuPolicy(Qt::CustomContextMenu);
+
+  // All rows are one line of text, so the view can skip measuring each of them
+  setUniformRowHeights(true);
 }
 
 void ProjectExplorerTreeView::mouseDoubleClickEvent(QMouseEvent *event)
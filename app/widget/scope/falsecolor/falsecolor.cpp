@@ -0,0 +1,74 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "falsecolor.h"
+
+#include <QVector2D>
+
+#include "node/node.h"
+
+namespace olive {
+
+#define super ScopeBase
+
+FalseColorScope::FalseColorScope(QWidget* parent) :
+  super(parent)
+{
+}
+
+void FalseColorScope::OnDestroy()
+{
+  super::OnDestroy();
+
+  texture_luma_ = nullptr;
+}
+
+ShaderCode FalseColorScope::GenerateShaderCode()
+{
+  return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/rgbfalsecolor.frag"),
+                    FileFunctions::ReadFileAsString(":/shaders/default.vert"));
+}
+
+void FalseColorScope::ProcessAnalysis(ScopeAnalysisPtr analysis)
+{
+  VideoParams luma_params(analysis->width(), analysis->height(), VideoParams::kFormatFloat32, 1);
+  texture_luma_ = renderer()->CreateTexture(luma_params, analysis->luma().constData());
+}
+
+void FalseColorScope::DrawScope(QVariant pipeline)
+{
+  if (texture_luma_) {
+    ShaderJob job;
+
+    job.InsertValue(QStringLiteral("viewport"),
+                    NodeValue(NodeValue::kVec2, QVector2D(width(), height())));
+
+    // The sampled frame keeps the aspect ratio of the original
+    job.InsertValue(QStringLiteral("frame_aspect"),
+                    NodeValue(NodeValue::kFloat, float(texture_luma_->width()) / float(texture_luma_->height())));
+
+    job.InsertValue(QStringLiteral("ove_maintex"),
+                    NodeValue(NodeValue::kTexture, QVariant::fromValue(texture_luma_)));
+
+    BlitToScreen(pipeline, job);
+  }
+}
+
+}
@@ -0,0 +1,56 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FALSECOLORSCOPE_H
+#define FALSECOLORSCOPE_H
+
+#include "widget/scope/scopebase/scopebase.h"
+
+namespace olive {
+
+/**
+ * @brief Shows the frame with each exposure zone painted in its own color
+ */
+class FalseColorScope : public ScopeBase
+{
+  Q_OBJECT
+public:
+  FalseColorScope(QWidget* parent = nullptr);
+
+  MANAGEDDISPLAYWIDGET_DEFAULT_DESTRUCTOR(FalseColorScope)
+
+protected slots:
+  virtual void OnDestroy() override;
+
+protected:
+  virtual ShaderCode GenerateShaderCode() override;
+
+  virtual void ProcessAnalysis(ScopeAnalysisPtr analysis) override;
+
+  virtual void DrawScope(QVariant pipeline) override;
+
+private:
+  TexturePtr texture_luma_;
+
+};
+
+}
+
+#endif // FALSECOLORSCOPE_H
@@ -25,6 +25,7 @@
 #include <QVector2D>
 
 #include "common/qtutils.h"
+#include "config/config.h"
 #include "node/node.h"
 
 namespace olive {
@@ -36,30 +37,27 @@ HistogramScope::HistogramScope(QWidget* parent) :
 {
 }
 
-void HistogramScope::OnInit()
-{
-  super::OnInit();
-
-  ShaderCode secondary_code(FileFunctions::ReadFileAsString(":/shaders/rgbhistogram_secondary.frag"),
-                            FileFunctions::ReadFileAsString(":/shaders/rgbhistogram.vert"));
-  pipeline_secondary_ = renderer()->CreateNativeShader(secondary_code);
-}
-
 void HistogramScope::OnDestroy()
 {
   super::OnDestroy();
 
-  pipeline_secondary_.clear();
-  texture_row_sums_ = nullptr;
+  texture_histogram_ = nullptr;
 }
 
 ShaderCode HistogramScope::GenerateShaderCode()
 {
   return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/rgbhistogram.frag"),
-                    FileFunctions::ReadFileAsString(":/shaders/default.vert"));
+                    FileFunctions::ReadFileAsString(":/shaders/rgbhistogram.vert"));
 }
 
-void HistogramScope::DrawScope(TexturePtr managed_tex, QVariant pipeline)
+void HistogramScope::ProcessAnalysis(ScopeAnalysisPtr analysis)
+{
+  // Only the bins are uploaded, which is all the histogram needs to draw itself
+  VideoParams histogram_params(ScopeAnalysis::kBinCount, 1, VideoParams::kFormatFloat32, VideoParams::kRGBChannelCount);
+  texture_histogram_ = renderer()->CreateTexture(histogram_params, analysis->histogram().constData());
+}
+
+void HistogramScope::DrawScope(QVariant pipeline)
 {
   float histogram_scale = 0.80f;
   // This value is eyeballed for usefulness. Until we have a geometry
@@ -70,26 +68,16 @@ void HistogramScope::DrawScope(TexturePtr managed_tex, QVariant pipeline)
 
   ShaderJob shader_job;
 
-  shader_job.InsertValue(QStringLiteral("viewport"), NodeValue(NodeValue::kVec2, QVector2D(width(), height())));
   shader_job.InsertValue(QStringLiteral("histogram_scale"), NodeValue(NodeValue::kFloat, histogram_scale));
   shader_job.InsertValue(QStringLiteral("histogram_power"), NodeValue(NodeValue::kFloat, histogram_power));
+  shader_job.InsertValue(QStringLiteral("bin_count"), NodeValue(NodeValue::kFloat, float(ScopeAnalysis::kBinCount)));
 
-  if (!texture_row_sums_
-      || texture_row_sums_->width() != this->width()
-      || texture_row_sums_->height() != this->height()) {
-    texture_row_sums_ = renderer()->CreateTexture(VideoParams(width(), height(),
-                                                              managed_tex->format(),
-                                                              managed_tex->channel_count()));
+  // Draw the histogram, which only needs one lookup per pixel
+  if (texture_histogram_) {
+    shader_job.InsertValue(QStringLiteral("ove_maintex"), NodeValue(NodeValue::kTexture, QVariant::fromValue(texture_histogram_)));
+    BlitToScreen(pipeline, shader_job);
   }
 
-  // Draw managed texture to a sums texture
-  shader_job.InsertValue(QStringLiteral("ove_maintex"), NodeValue(NodeValue::kTexture, QVariant::fromValue(managed_tex)));
-  renderer()->BlitToTexture(pipeline, shader_job, texture_row_sums_.get());
-
-  // Draw sums into a histogram
-  shader_job.InsertValue(QStringLiteral("ove_maintex"), NodeValue(NodeValue::kTexture, QVariant::fromValue(texture_row_sums_)));
-  renderer()->Blit(pipeline_secondary_, shader_job, texture_row_sums_->params());
-
   // Draw line overlays
   QPainter p(inner_widget());
   QFont font = p.font();
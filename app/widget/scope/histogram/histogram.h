@@ -34,19 +34,17 @@ public:
   MANAGEDDISPLAYWIDGET_DEFAULT_DESTRUCTOR(HistogramScope)
 
 protected slots:
-  virtual void OnInit() override;
-
   virtual void OnDestroy() override;
 
 protected:
   virtual ShaderCode GenerateShaderCode() override;
-  QVariant CreateSecondaryShader();
 
-  virtual void DrawScope(TexturePtr managed_tex, QVariant pipeline) override;
+  virtual void ProcessAnalysis(ScopeAnalysisPtr analysis) override;
+
+  virtual void DrawScope(QVariant pipeline) override;
 
 private:
-  QVariant pipeline_secondary_;
-  TexturePtr texture_row_sums_;
+  TexturePtr texture_histogram_;
 
 };
 
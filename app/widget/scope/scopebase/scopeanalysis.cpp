@@ -0,0 +1,115 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "scopeanalysis.h"
+
+#include <QtGlobal>
+
+namespace olive {
+
+const int ScopeAnalysis::kBinCount = 256;
+
+const int ScopeAnalysis::kVectorscopeSize = 256;
+
+ScopeAnalysis::ScopeAnalysis() :
+  width_(0),
+  height_(0)
+{
+}
+
+inline int ValueToBin(float v, int bins)
+{
+  // Values beyond either limit are counted in the outermost bins
+  return qRound(qBound(0.0f, v, 1.0f) * (bins - 1));
+}
+
+void ScopeAnalysis::Analyze(const float *data, int width, int height, int linesize, const double luma_coeffs[3])
+{
+  width_ = width;
+  height_ = height;
+
+  histogram_.fill(0.0f, kBinCount * 3);
+  levels_.fill(0.0f, width * kBinCount * 4);
+  vectorscope_.fill(0.0f, kVectorscopeSize * kVectorscopeSize);
+  luma_.resize(width * height);
+
+  if (!width || !height) {
+    return;
+  }
+
+  float kr = luma_coeffs[0];
+  float kg = luma_coeffs[1];
+  float kb = luma_coeffs[2];
+
+  float* histogram = histogram_.data();
+  float* levels = levels_.data();
+  float* vectorscope = vectorscope_.data();
+  float* luma = luma_.data();
+
+  for (int y=0; y<height; y++) {
+    const float* row = data + y * linesize * 4;
+
+    for (int x=0; x<width; x++) {
+      const float* px = row + x * 4;
+      float r = px[0];
+      float g = px[1];
+      float b = px[2];
+      float l = r * kr + g * kg + b * kb;
+
+      luma[y * width + x] = l;
+
+      int r_bin = ValueToBin(r, kBinCount);
+      int g_bin = ValueToBin(g, kBinCount);
+      int b_bin = ValueToBin(b, kBinCount);
+
+      histogram[r_bin * 3 + 0]++;
+      histogram[g_bin * 3 + 1]++;
+      histogram[b_bin * 3 + 2]++;
+
+      levels[(r_bin * width + x) * 4 + 0]++;
+      levels[(g_bin * width + x) * 4 + 1]++;
+      levels[(b_bin * width + x) * 4 + 2]++;
+      levels[(ValueToBin(l, kBinCount) * width + x) * 4 + 3]++;
+
+      // Chroma in the -0.5 to 0.5 range
+      float cb = (b - l) / (2.0f * (1.0f - kb));
+      float cr = (r - l) / (2.0f * (1.0f - kr));
+
+      vectorscope[ValueToBin(cr + 0.5f, kVectorscopeSize) * kVectorscopeSize + ValueToBin(cb + 0.5f, kVectorscopeSize)]++;
+    }
+  }
+
+  // Convert counts to fractions
+  float total = width * height;
+
+  for (int i=0; i<histogram_.size(); i++) {
+    histogram[i] /= total;
+  }
+
+  for (int i=0; i<levels_.size(); i++) {
+    levels[i] /= height;
+  }
+
+  for (int i=0; i<vectorscope_.size(); i++) {
+    vectorscope[i] /= total;
+  }
+}
+
+}
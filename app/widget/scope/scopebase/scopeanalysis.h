@@ -0,0 +1,119 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SCOPEANALYSIS_H
+#define SCOPEANALYSIS_H
+
+#include <memory>
+#include <QVector>
+
+namespace olive {
+
+/**
+ * @brief Measurements of one frame shared by every scope
+ *
+ * A frame is analyzed once in a single pass over its samples, however many scopes are showing it.
+ * All counts are stored as fractions of the samples they were taken from, so they don't depend on
+ * the sampling density.
+ */
+class ScopeAnalysis
+{
+public:
+  ScopeAnalysis();
+
+  /**
+   * @brief Measure a frame in display space
+   *
+   * `data` is `width` x `height` RGBA 32-bit float pixels with `linesize` pixels per row, with the
+   * first row at the bottom of the frame.
+   */
+  void Analyze(const float* data, int width, int height, int linesize, const double luma_coeffs[3]);
+
+  int width() const
+  {
+    return width_;
+  }
+
+  int height() const
+  {
+    return height_;
+  }
+
+  /**
+   * @brief Fraction of samples in each bin, kBinCount RGB triplets
+   */
+  const QVector<float>& histogram() const
+  {
+    return histogram_;
+  }
+
+  /**
+   * @brief Fraction of each column's samples at each level
+   *
+   * width() x kBinCount RGBA pixels with one row per level starting from the bottom, luma is stored
+   * in alpha.
+   */
+  const QVector<float>& levels() const
+  {
+    return levels_;
+  }
+
+  /**
+   * @brief Fraction of samples at each chroma, kVectorscopeSize x kVectorscopeSize
+   *
+   * Cb increases to the right and Cr increases upwards.
+   */
+  const QVector<float>& vectorscope() const
+  {
+    return vectorscope_;
+  }
+
+  /**
+   * @brief Luma of each sample, width() x height()
+   */
+  const QVector<float>& luma() const
+  {
+    return luma_;
+  }
+
+  static const int kBinCount;
+
+  static const int kVectorscopeSize;
+
+private:
+  int width_;
+
+  int height_;
+
+  QVector<float> histogram_;
+
+  QVector<float> levels_;
+
+  QVector<float> vectorscope_;
+
+  QVector<float> luma_;
+
+};
+
+using ScopeAnalysisPtr = std::shared_ptr<ScopeAnalysis>;
+
+}
+
+#endif // SCOPEANALYSIS_H
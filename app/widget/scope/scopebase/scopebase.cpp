@@ -26,10 +26,14 @@ namespace olive {
 
 #define super ManagedDisplayWidget
 
+QVector<ScopeBase::SharedAnalysis> ScopeBase::shared_analyses_;
+
+const int ScopeBase::kMaxSharedAnalyses = 4;
+
 ScopeBase::ScopeBase(QWidget* parent) :
   super(parent),
   texture_(nullptr),
-  managed_tex_up_to_date_(false)
+  analysis_up_to_date_(false)
 {
   EnableDefaultContextMenu();
 }
@@ -37,7 +41,7 @@ ScopeBase::ScopeBase(QWidget* parent) :
 void ScopeBase::SetBuffer(TexturePtr frame)
 {
   texture_ = frame;
-  managed_tex_up_to_date_ = false;
+  analysis_up_to_date_ = false;
   update();
 }
 
@@ -46,14 +50,17 @@ void ScopeBase::showEvent(QShowEvent* e)
   super::showEvent(e);
 }
 
-void ScopeBase::DrawScope(TexturePtr managed_tex, QVariant pipeline)
+void ScopeBase::ColorProcessorChangedEvent()
 {
-  ShaderJob job;
+  analysis_up_to_date_ = false;
 
-  job.InsertValue(QStringLiteral("ove_maintex"), NodeValue(NodeValue::kTexture, QVariant::fromValue(managed_tex)));
+  super::ColorProcessorChangedEvent();
+}
 
+void ScopeBase::BlitToScreen(QVariant pipeline, const ShaderJob &job)
+{
   renderer()->Blit(pipeline, job, VideoParams(width(), height(),
-                                              static_cast<VideoParams::Format>(Config::Current()["OfflinePixelFormat"].toInt()),
+                                              static_cast<VideoParams::Format>(Config::kOfflinePixelFormat.Get()),
                                               VideoParams::kInternalChannelCount));
 }
 
@@ -70,24 +77,80 @@ void ScopeBase::OnPaint()
   renderer()->ClearDestination();
 
   if (texture_) {
-    // Convert reference frame to display space
-    if (!managed_tex_ || !managed_tex_up_to_date_
-        || managed_tex_->params() != texture_->params()) {
-      managed_tex_ = renderer()->CreateTexture(texture_->params());
-      renderer()->BlitColorManaged(color_service(), texture_, true, managed_tex_.get());
+    if (!analysis_up_to_date_) {
+      ProcessAnalysis(GetAnalysis());
+      analysis_up_to_date_ = true;
+    }
+
+    DrawScope(pipeline_);
+  }
+}
+
+ScopeAnalysisPtr ScopeBase::GetAnalysis()
+{
+  VideoParams sample_params = GetSampleParams(texture_->params());
+  QString processor_id = color_service()->id();
+
+  // Forget frames that nothing shows anymore
+  for (int i=shared_analyses_.size()-1; i>=0; i--) {
+    if (shared_analyses_.at(i).source.expired()) {
+      shared_analyses_.removeAt(i);
+    }
+  }
+
+  // Another scope may already have measured this frame
+  foreach (const SharedAnalysis& shared, shared_analyses_) {
+    if (shared.source.lock() == texture_
+        && shared.color_processor == processor_id
+        && shared.params == sample_params) {
+      return shared.analysis;
     }
+  }
+
+  // Convert reference frame to display space, scaling it down to the sampling density as we go,
+  // and read it back once for every scope to share
+  TexturePtr managed_tex = renderer()->CreateTexture(sample_params);
+  renderer()->BlitColorManaged(color_service(), texture_, true, managed_tex.get());
+
+  QVector<float> data(sample_params.width() * sample_params.height() * sample_params.channel_count());
+  renderer()->DownloadFromTexture(managed_tex.get(), data.data(), sample_params.width());
 
-    DrawScope(managed_tex_, pipeline_);
+  double luma_coeffs[3] = {0.0, 0.0, 0.0};
+  color_manager()->GetDefaultLumaCoefs(luma_coeffs);
+
+  ScopeAnalysisPtr analysis = std::make_shared<ScopeAnalysis>();
+  analysis->Analyze(data.constData(), sample_params.width(), sample_params.height(), sample_params.width(), luma_coeffs);
+
+  if (shared_analyses_.size() >= kMaxSharedAnalyses) {
+    shared_analyses_.removeFirst();
   }
+  shared_analyses_.append({texture_, processor_id, sample_params, analysis});
+
+  return analysis;
+}
+
+VideoParams ScopeBase::GetSampleParams(const VideoParams &frame_params)
+{
+  int width = frame_params.effective_width();
+  int height = frame_params.effective_height();
+  int max_lines = Config::Current()[QStringLiteral("ScopeSampleLines")].toInt();
+
+  if (max_lines > 0 && height > max_lines) {
+    width = qMax(1, qRound(double(width) * max_lines / height));
+    height = max_lines;
+  }
+
+  // Always read back full floats so display values above 1.0 survive the analysis
+  return VideoParams(width, height, VideoParams::kFormatFloat32, VideoParams::kRGBAChannelCount);
 }
 
 void ScopeBase::OnDestroy()
 {
   super::OnDestroy();
 
-  managed_tex_ = nullptr;
   texture_ = nullptr;
   pipeline_.clear();
+  analysis_up_to_date_ = false;
 }
 
 }
@@ -23,6 +23,7 @@
 
 #include "codec/frame.h"
 #include "render/colorprocessor.h"
+#include "scopeanalysis.h"
 #include "widget/manageddisplay/manageddisplay.h"
 
 namespace olive {
@@ -47,23 +48,56 @@ protected slots:
 protected:
   virtual void showEvent(QShowEvent* e) override;
 
+  virtual void ColorProcessorChangedEvent() override;
+
   virtual ShaderCode GenerateShaderCode() = 0;
 
   /**
-   * @brief Draw function
+   * @brief Take the measurements of a new frame
    *
-   * Override this if your sub-class scope needs extra drawing.
+   * Called whenever the frame or color processor changes, before the frame is drawn. The analysis
+   * is shared with every other scope showing the same frame, so override this to upload only the
+   * parts of it this scope draws.
+   */
+  virtual void ProcessAnalysis(ScopeAnalysisPtr analysis) = 0;
+
+  /**
+   * @brief Draw function
    */
-  virtual void DrawScope(TexturePtr managed_tex, QVariant pipeline);
+  virtual void DrawScope(QVariant pipeline) = 0;
+
+  /**
+   * @brief Blit `pipeline` across the whole widget
+   */
+  void BlitToScreen(QVariant pipeline, const ShaderJob& job);
 
 private:
+  /**
+   * @brief Get the size frames are sampled at, limited to the "ScopeSampleLines" setting
+   */
+  static VideoParams GetSampleParams(const VideoParams& frame_params);
+
+  /**
+   * @brief Get the analysis of the current frame, reusing another scope's if it exists
+   */
+  ScopeAnalysisPtr GetAnalysis();
+
+  struct SharedAnalysis {
+    std::weak_ptr<Texture> source;
+    QString color_processor;
+    VideoParams params;
+    ScopeAnalysisPtr analysis;
+  };
+
+  static QVector<SharedAnalysis> shared_analyses_;
+
+  static const int kMaxSharedAnalyses;
+
   QVariant pipeline_;
 
   TexturePtr texture_;
 
-  TexturePtr managed_tex_;
-
-  bool managed_tex_up_to_date_;
+  bool analysis_up_to_date_;
 
 };
 
@@ -0,0 +1,113 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "vectorscope.h"
+
+#include <QPainter>
+#include <QVector2D>
+
+#include "node/node.h"
+
+namespace olive {
+
+#define super ScopeBase
+
+VectorscopeScope::VectorscopeScope(QWidget* parent) :
+  super(parent)
+{
+}
+
+void VectorscopeScope::OnDestroy()
+{
+  super::OnDestroy();
+
+  texture_vectorscope_ = nullptr;
+}
+
+ShaderCode VectorscopeScope::GenerateShaderCode()
+{
+  return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/rgbvectorscope.frag"),
+                    FileFunctions::ReadFileAsString(":/shaders/default.vert"));
+}
+
+void VectorscopeScope::ProcessAnalysis(ScopeAnalysisPtr analysis)
+{
+  VideoParams vectorscope_params(ScopeAnalysis::kVectorscopeSize, ScopeAnalysis::kVectorscopeSize,
+                                 VideoParams::kFormatFloat32, 1);
+  texture_vectorscope_ = renderer()->CreateTexture(vectorscope_params, analysis->vectorscope().constData());
+}
+
+void VectorscopeScope::DrawScope(QVariant pipeline)
+{
+  float vectorscope_scale = 0.80f;
+
+  if (texture_vectorscope_) {
+    ShaderJob job;
+
+    job.InsertValue(QStringLiteral("viewport"),
+                    NodeValue(NodeValue::kVec2, QVector2D(width(), height())));
+    job.InsertValue(QStringLiteral("vectorscope_scale"),
+                    NodeValue(NodeValue::kFloat, vectorscope_scale));
+
+    // Eyeballed so that a frame spread over a sixteenth of the chroma plane is at full brightness
+    job.InsertValue(QStringLiteral("intensity"),
+                    NodeValue(NodeValue::kFloat, float(ScopeAnalysis::kVectorscopeSize * ScopeAnalysis::kVectorscopeSize) / 16.0f));
+
+    job.InsertValue(QStringLiteral("ove_maintex"),
+                    NodeValue(NodeValue::kTexture, QVariant::fromValue(texture_vectorscope_)));
+
+    BlitToScreen(pipeline, job);
+  }
+
+  // Draw graticule, the circle is the furthest any chroma can reach
+  float diameter = qMin(width() - 1.0, height() - 1.0) * vectorscope_scale;
+  QPointF center((width() - 1.0) / 2.0, (height() - 1.0) / 2.0);
+
+  QPainter p(inner_widget());
+
+  p.setCompositionMode(QPainter::CompositionMode_Plus);
+  p.setRenderHint(QPainter::Antialiasing);
+  p.setPen(QColor(0.0, 0.6 * 255.0, 0.0));
+  p.setBrush(Qt::NoBrush);
+
+  p.drawEllipse(center, diameter / 2.0, diameter / 2.0);
+  p.drawLine(QPointF(center.x() - diameter / 2.0, center.y()), QPointF(center.x() + diameter / 2.0, center.y()));
+  p.drawLine(QPointF(center.x(), center.y() - diameter / 2.0), QPointF(center.x(), center.y() + diameter / 2.0));
+
+  // Mark where fully saturated primaries and secondaries land
+  double luma_coeffs[3] = {0.0, 0.0, 0.0};
+  color_manager()->GetDefaultLumaCoefs(luma_coeffs);
+
+  const QColor targets[] = {Qt::red, Qt::yellow, Qt::green, Qt::cyan, Qt::blue, Qt::magenta};
+  double target_size = diameter / 40.0;
+
+  foreach (const QColor& c, targets) {
+    double y = c.redF() * luma_coeffs[0] + c.greenF() * luma_coeffs[1] + c.blueF() * luma_coeffs[2];
+    double cb = (c.blueF() - y) / (2.0 * (1.0 - luma_coeffs[2]));
+    double cr = (c.redF() - y) / (2.0 * (1.0 - luma_coeffs[0]));
+
+    QPointF target(center.x() + cb * diameter, center.y() - cr * diameter);
+
+    p.setPen(c);
+    p.drawRect(QRectF(target.x() - target_size, target.y() - target_size, target_size * 2, target_size * 2));
+  }
+}
+
+}
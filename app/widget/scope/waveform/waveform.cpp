@@ -40,41 +40,48 @@ WaveformScope::WaveformScope(QWidget* parent) :
 {
 }
 
+void WaveformScope::OnDestroy()
+{
+  super::OnDestroy();
+
+  texture_levels_ = nullptr;
+}
+
 ShaderCode WaveformScope::GenerateShaderCode()
 {
   return ShaderCode(FileFunctions::ReadFileAsString(":/shaders/rgbwaveform.frag"),
                     FileFunctions::ReadFileAsString(":/shaders/rgbwaveform.vert"));
 }
 
-void WaveformScope::DrawScope(TexturePtr managed_tex, QVariant pipeline)
+void WaveformScope::ProcessAnalysis(ScopeAnalysisPtr analysis)
+{
+  // One column per sampled column and one row per level, luma is stored in the alpha channel
+  VideoParams levels_params(analysis->width(), ScopeAnalysis::kBinCount, VideoParams::kFormatFloat32, VideoParams::kRGBAChannelCount);
+  texture_levels_ = renderer()->CreateTexture(levels_params, analysis->levels().constData());
+}
+
+void WaveformScope::DrawScope(QVariant pipeline)
 {
   float waveform_scale = 0.80f;
 
   // Draw waveform through shader
   ShaderJob job;
 
-  // Set viewport size
-  job.InsertValue(QStringLiteral("viewport"),
-                  NodeValue(NodeValue::kVec2, QVector2D(width(), height())));
-
-  // Set luma coefficients
-  double luma_coeffs[3] = {0.0f, 0.0f, 0.0f};
-  color_manager()->GetDefaultLumaCoefs(luma_coeffs);
-  job.InsertValue(QStringLiteral("luma_coeffs"),
-                  NodeValue(NodeValue::kVec3, QVector3D(luma_coeffs[0], luma_coeffs[1], luma_coeffs[2])));
-
-
   // Scale of the waveform relative to the viewport surface.
   job.InsertValue(QStringLiteral("waveform_scale"),
                   NodeValue(NodeValue::kFloat, waveform_scale));
 
-  // Insert source texture
-  job.InsertValue(QStringLiteral("ove_maintex"),
-                  NodeValue(NodeValue::kTexture, QVariant::fromValue(managed_tex)));
+  // Keeps the old look of 10% brightness per sample when a column is spread across every level
+  job.InsertValue(QStringLiteral("intensity"),
+                  NodeValue(NodeValue::kFloat, 0.10f * ScopeAnalysis::kBinCount));
+
+  if (texture_levels_) {
+    // Insert level counts, which only need one lookup per pixel
+    job.InsertValue(QStringLiteral("ove_maintex"),
+                    NodeValue(NodeValue::kTexture, QVariant::fromValue(texture_levels_)));
 
-  renderer()->Blit(pipeline, job, VideoParams(width(), height(),
-                                              static_cast<VideoParams::Format>(Config::Current()["OfflinePixelFormat"].toInt()),
-                                              VideoParams::kInternalChannelCount));
+    BlitToScreen(pipeline, job);
+  }
 
   float waveform_dim_x = ceil((width() - 1.0) * waveform_scale);
   float waveform_dim_y = ceil((height() - 1.0) * waveform_scale);
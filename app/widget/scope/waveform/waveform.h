@@ -33,10 +33,18 @@ public:
 
   MANAGEDDISPLAYWIDGET_DEFAULT_DESTRUCTOR(WaveformScope)
 
+protected slots:
+  virtual void OnDestroy() override;
+
 protected:
   virtual ShaderCode GenerateShaderCode() override;
 
-  virtual void DrawScope(TexturePtr managed_tex, QVariant pipeline) override;
+  virtual void ProcessAnalysis(ScopeAnalysisPtr analysis) override;
+
+  virtual void DrawScope(QVariant pipeline) override;
+
+private:
+  TexturePtr texture_levels_;
 
 };
 
@@ -71,6 +71,11 @@ void TimeBasedView::TimebaseChangedEvent(const rational &)
 
 void TimeBasedView::EnableSnap(const QVector<rational> &points)
 {
+  // Snapping is re-evaluated on every mouse move of a drag, don't repaint unless it changed
+  if (snapped_ && snap_time_ == points) {
+    return;
+  }
+
   snapped_ = true;
   snap_time_ = points;
 
@@ -79,6 +84,10 @@ void TimeBasedView::EnableSnap(const QVector<rational> &points)
 
 void TimeBasedView::DisableSnap()
 {
+  if (!snapped_) {
+    return;
+  }
+
   snapped_ = false;
 
   viewport()->update();
@@ -154,8 +163,27 @@ void TimeBasedView::SetTime(const int64_t time)
 {
   playhead_ = time;
 
-  // Force redraw for playhead
-  viewport()->update();
+  if (timebase().isNull() || playhead_scene_left_ < 0) {
+    viewport()->update();
+    return;
+  }
+
+  // Only repaint where the playhead was last drawn and where it's going, redrawing the whole
+  // viewport on every frame of playback scales with everything else that's visible
+  double width = TimeToScene(timebase());
+  double new_left = GetPlayheadX();
+
+  viewport()->update(PlayheadViewportRect(playhead_scene_left_, playhead_scene_right_));
+  viewport()->update(PlayheadViewportRect(new_left, new_left + width));
+}
+
+QRect TimeBasedView::PlayheadViewportRect(double scene_left, double scene_right) const
+{
+  int left = mapFromScene(QPointF(scene_left, 0)).x();
+  int right = mapFromScene(QPointF(scene_right, 0)).x();
+
+  // Pad by a pixel either side to cover antialiasing and rounding
+  return QRect(left - 1, 0, right - left + 3, viewport()->height());
 }
 
 void TimeBasedView::drawForeground(QPainter *painter, const QRectF &rect)
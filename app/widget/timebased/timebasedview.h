@@ -105,6 +105,8 @@ protected slots:
 private:
   qreal GetPlayheadX();
 
+  QRect PlayheadViewportRect(double scene_left, double scene_right) const;
+
   int64_t playhead_;
 
   double playhead_scene_left_;
@@ -79,6 +79,12 @@ void TimeBasedWidget::ConnectViewerNode(ViewerOutput *node)
     return;
   }
 
+  // Sequences may not have loaded their contents yet if they haven't been opened before
+  Sequence* sequence = dynamic_cast<Sequence*>(node);
+  if (sequence && sequence->project()) {
+    sequence->project()->LoadDeferredSequence(sequence);
+  }
+
   if (viewer_node_) {
     // Call potential derivative functions for disconnecting the viewer node
     DisconnectNodeEvent(viewer_node_);
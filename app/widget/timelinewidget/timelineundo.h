@@ -611,6 +611,17 @@ public:
     return track_->project();
   }
 
+  virtual qint64 EstimatedSize() const override
+  {
+    qint64 sz = UndoCommand::EstimatedSize();
+
+    foreach (UndoCommand* c, remove_block_commands_) {
+      sz += c->EstimatedSize();
+    }
+
+    return sz;
+  }
+
   /**
    * @brief Block to insert after if you want to insert something between this ripple
    */
@@ -655,10 +666,12 @@ public:
 
       // Perform removals
       if (!removals_.isEmpty()) {
+        // Ripple remove them all first, in/outs only need recalculating once at the end
+        track_->BeginBlockBatch();
         foreach (auto op, removals_) {
-          // Ripple remove them all first
           track_->RippleRemoveBlock(op.block);
         }
+        track_->EndBlockBatch();
 
         // Create undo commands for node removals where possible
         if (remove_block_commands_.isEmpty()) {
@@ -701,9 +714,11 @@ public:
         remove_block_commands_.at(i)->undo();
       }
 
+      track_->BeginBlockBatch();
       foreach (auto op, removals_) {
         track_->InsertBlockAfter(op.block, op.before);
       }
+      track_->EndBlockBatch();
     }
 
     // End operations and invalidate
@@ -820,6 +835,17 @@ public:
     return list_->parent()->project();
   }
 
+  virtual qint64 EstimatedSize() const override
+  {
+    qint64 sz = UndoCommand::EstimatedSize();
+
+    foreach (UndoCommand* c, commands_) {
+      sz += c->EstimatedSize();
+    }
+
+    return sz;
+  }
+
   virtual void redo() override
   {
     // Code that's only run on the first redo
@@ -951,6 +977,11 @@ public:
     return track_list_->parent()->project();
   }
 
+  virtual qint64 EstimatedSize() const override
+  {
+    return UndoCommand::EstimatedSize() + EstimateOwnedObjectsSize(&memory_manager_);
+  }
+
   virtual void redo() override
   {
     ripple(true);
@@ -1634,6 +1665,11 @@ public:
     return block_->project();
   }
 
+  virtual qint64 EstimatedSize() const override
+  {
+    return UndoCommand::EstimatedSize() + EstimateOwnedObjectsSize(&memory_manager_);
+  }
+
   virtual void redo() override;
 
   virtual void undo() override;
@@ -1675,6 +1711,17 @@ public:
     return timeline_->project();
   }
 
+  virtual qint64 EstimatedSize() const override
+  {
+    qint64 sz = UndoCommand::EstimatedSize();
+
+    foreach (UndoCommand* c, commands_) {
+      sz += c->EstimatedSize();
+    }
+
+    return sz;
+  }
+
   virtual void redo() override
   {
     if (commands_.isEmpty()) {
@@ -1864,6 +1911,11 @@ public:
     return track_->project();
   }
 
+  virtual qint64 EstimatedSize() const override
+  {
+    return UndoCommand::EstimatedSize() + EstimateOwnedObjectsSize(&memory_manager_);
+  }
+
   virtual void redo() override
   {
     if (!prepped_) {
@@ -20,6 +20,7 @@
 
 #include "timelinewidget.h"
 
+#include <algorithm>
 #include <cfloat>
 #include <QSplitter>
 #include <QVBoxLayout>
@@ -30,6 +31,9 @@
 #include "common/timecodefunctions.h"
 #include "dialog/sequence/sequence.h"
 #include "node/block/transition/transition.h"
+#include "node/project/project.h"
+#include "task/renderinplace/renderinplace.h"
+#include "task/taskmanager.h"
 #include "tool/add.h"
 #include "tool/beam.h"
 #include "tool/edit.h"
@@ -56,6 +60,7 @@ TimelineWidget::TimelineWidget(QWidget *parent) :
   super(true, true, parent),
   rubberband_(QRubberBand::Rectangle, this),
   active_tool_(nullptr),
+  snap_index_dirty_(true),
   use_audio_time_units_(false)
 {
   QVBoxLayout* vert_layout = new QVBoxLayout(this);
@@ -291,7 +296,7 @@ void TimelineWidget::DisconnectNodeEvent(ViewerOutput *n)
   }
 }
 
-void TimelineWidget::CopyNodesToClipboardInternal(QXmlStreamWriter *writer, void* userdata)
+void TimelineWidget::CopyNodesToClipboardInternal(XMLWriter *writer, void* userdata)
 {
   // Cache the earliest in point so all copied clips have a "relative" in point that can be pasted anywhere
   QVector<Block*>& selected = *static_cast<QVector<Block*>*>(userdata);
@@ -315,7 +320,7 @@ void TimelineWidget::CopyNodesToClipboardInternal(QXmlStreamWriter *writer, void
   }
 }
 
-void TimelineWidget::PasteNodesFromClipboardInternal(QXmlStreamReader *reader, XMLNodeData& xml_node_data, void *userdata)
+void TimelineWidget::PasteNodesFromClipboardInternal(XMLReader *reader, XMLNodeData& xml_node_data, void *userdata)
 {
   QVector<BlockPasteData>& paste_data = *static_cast<QVector<BlockPasteData>*>(userdata);
 
@@ -788,7 +793,14 @@ void TimelineWidget::ViewMouseMoved(TimelineViewMouseEvent *event)
     if (active_tool_) {
       active_tool_->MouseMove(event);
 
-      UpdateViewports();
+      if (ghost_items_.isEmpty()) {
+        UpdateViewports();
+      } else {
+        // Only the ghosts move while dragging, so don't repaint every block underneath them
+        foreach (TimelineAndTrackView* tview, views_) {
+          tview->view()->UpdateGhosts();
+        }
+      }
 
       QMetaObject::invokeMethod(this, "CatchUpScrollToPoint", Qt::QueuedConnection,
                                 Q_ARG(int, qRound(event->GetSceneX())));
@@ -875,6 +887,7 @@ void TimelineWidget::AddBlock(Block *block)
     connect(block, &Block::EnabledChanged, this, &TimelineWidget::BlockUpdated);
 
     added_blocks_.append(block);
+    InvalidateSnapIndex();
   }
 }
 
@@ -888,6 +901,7 @@ void TimelineWidget::RemoveBlock(Block *block)
 
   // Take item from map
   added_blocks_.removeOne(block);
+  InvalidateSnapIndex();
 
   // If selected, deselect it
   int select_index = selected_blocks_.indexOf(block);
@@ -909,6 +923,7 @@ void TimelineWidget::AddTrack(Track *track)
   connect(track, &Track::IndexChanged, this, &TimelineWidget::TrackIndexChanged);
   connect(track, &Track::PreviewChanged, this, &TimelineWidget::TrackUpdated);
   connect(track, &Track::BlocksRefreshed, this, &TimelineWidget::TrackUpdated);
+  connect(track, &Track::BlocksRefreshed, this, &TimelineWidget::InvalidateSnapIndex);
   connect(track, &Track::TrackHeightChangedInPixels, this, &TimelineWidget::TrackUpdated);
   connect(track, &Track::BlockAdded, this, &TimelineWidget::AddBlock);
   connect(track, &Track::BlockRemoved, this, &TimelineWidget::RemoveBlock);
@@ -920,6 +935,7 @@ void TimelineWidget::RemoveTrack(Track *track)
   disconnect(track, &Track::IndexChanged, this, &TimelineWidget::TrackIndexChanged);
   disconnect(track, &Track::PreviewChanged, this, &TimelineWidget::TrackUpdated);
   disconnect(track, &Track::BlocksRefreshed, this, &TimelineWidget::TrackUpdated);
+  disconnect(track, &Track::BlocksRefreshed, this, &TimelineWidget::InvalidateSnapIndex);
   disconnect(track, &Track::TrackHeightChangedInPixels, this, &TimelineWidget::TrackUpdated);
   disconnect(track, &Track::BlockAdded, this, &TimelineWidget::AddBlock);
   disconnect(track, &Track::BlockRemoved, this, &TimelineWidget::RemoveBlock);
@@ -941,6 +957,32 @@ void TimelineWidget::BlockUpdated()
   UpdateViewports(static_cast<Block*>(sender())->track()->type());
 }
 
+void TimelineWidget::InvalidateSnapIndex()
+{
+  snap_index_dirty_ = true;
+}
+
+void TimelineWidget::UpdateSnapIndex()
+{
+  if (!snap_index_dirty_) {
+    return;
+  }
+
+  snap_block_times_.clear();
+  snap_block_times_.reserve(added_blocks_.size() * 2);
+
+  foreach (Block* b, added_blocks_) {
+    snap_block_times_.append(b->in());
+    snap_block_times_.append(b->out());
+  }
+
+  // Adjacent blocks share their edges, so most times appear twice
+  std::sort(snap_block_times_.begin(), snap_block_times_.end());
+  snap_block_times_.erase(std::unique(snap_block_times_.begin(), snap_block_times_.end()), snap_block_times_.end());
+
+  snap_index_dirty_ = false;
+}
+
 void TimelineWidget::UpdateHorizontalSplitters()
 {
   QSplitter* sender_splitter = static_cast<QSplitter*>(sender());
@@ -978,6 +1020,39 @@ void TimelineWidget::ShowContextMenu()
 
     menu.addSeparator();
 
+    QVector<ClipBlock*> renderable_clips;
+    QVector<ClipBlock*> flattened_clips;
+
+    foreach (Block* b, selected) {
+      ClipBlock* clip = dynamic_cast<ClipBlock*>(b);
+
+      if (clip) {
+        if (RenderInPlaceTask::CanRenderInPlace(clip)) {
+          renderable_clips.append(clip);
+        } else if (clip->IsFlattened()) {
+          flattened_clips.append(clip);
+        }
+      }
+    }
+
+    if (!renderable_clips.isEmpty()) {
+      QAction* render_action = menu.addAction(tr("Render In Place"));
+      connect(render_action, &QAction::triggered, this, [this, renderable_clips](){
+        RenderClipsInPlace(renderable_clips);
+      });
+    }
+
+    if (!flattened_clips.isEmpty()) {
+      QAction* restore_action = menu.addAction(tr("Restore Original Effects"));
+      connect(restore_action, &QAction::triggered, this, [this, flattened_clips](){
+        RestoreClips(flattened_clips);
+      });
+    }
+
+    if (!renderable_clips.isEmpty() || !flattened_clips.isEmpty()) {
+      menu.addSeparator();
+    }
+
     QAction* properties_action = menu.addAction(tr("Properties"));
     connect(properties_action, &QAction::triggered, this, [this](){
       QVector<Block*> block_items = GetSelectedBlocks();
@@ -1003,6 +1078,11 @@ void TimelineWidget::ShowContextMenu()
     show_waveforms->setChecked(views_.first()->view()->GetShowWaveforms());
     connect(show_waveforms, &QAction::triggered, this, &TimelineWidget::SetViewWaveformsEnabled);
 
+    QAction* show_thumbnails = menu.addAction(tr("Show Thumbnails"));
+    show_thumbnails->setCheckable(true);
+    show_thumbnails->setChecked(views_.first()->view()->GetShowThumbnails());
+    connect(show_thumbnails, &QAction::triggered, this, &TimelineWidget::SetViewThumbnailsEnabled);
+
     QAction* scroll_zoom = views_.first()->view()->AddSetScrollZoomsByDefaultActionToMenu(&menu);
     connect(scroll_zoom, &QAction::triggered, this, &TimelineWidget::SetScrollZoomsByDefaultOnAllViews);
 
@@ -1015,6 +1095,42 @@ void TimelineWidget::ShowContextMenu()
   menu.exec(QCursor::pos());
 }
 
+void TimelineWidget::RenderClipsInPlace(const QVector<ClipBlock *> &clips)
+{
+  ColorManager* color_manager = sequence()->project()->color_manager();
+
+  foreach (ClipBlock* clip, clips) {
+    RenderInPlaceTask* task = new RenderInPlaceTask(sequence(), clip, color_manager,
+                                                    RenderInPlaceTask::GetOutputFilename(clip));
+    connect(task, &Task::Finished, this, &TimelineWidget::RenderInPlaceFinished, Qt::QueuedConnection);
+    TaskManager::instance()->AddTask(task);
+  }
+}
+
+void TimelineWidget::RestoreClips(const QVector<ClipBlock *> &clips)
+{
+  MultiUndoCommand* command = new MultiUndoCommand();
+
+  foreach (ClipBlock* clip, clips) {
+    command->add_child(RenderInPlaceTask::CreateRestoreCommand(clip));
+  }
+
+  Core::instance()->undo_stack()->push(command);
+}
+
+void TimelineWidget::RenderInPlaceFinished(Task *task, bool succeeded)
+{
+  if (!succeeded) {
+    return;
+  }
+
+  MultiUndoCommand* command = static_cast<RenderInPlaceTask*>(task)->CreateCommand();
+
+  if (command) {
+    Core::instance()->undo_stack()->push(command);
+  }
+}
+
 void TimelineWidget::DeferredScrollAction()
 {
   scrollbar()->setValue(deferred_scroll_value_);
@@ -1081,6 +1197,13 @@ void TimelineWidget::SetViewWaveformsEnabled(bool e)
   }
 }
 
+void TimelineWidget::SetViewThumbnailsEnabled(bool e)
+{
+  foreach (TimelineAndTrackView* tview, views_) {
+    tview->view()->SetShowThumbnails(e);
+  }
+}
+
 void TimelineWidget::FrameRateChanged()
 {
   SetTimebase(GetConnectedNode()->GetVideoParams().frame_rate_as_time_base());
@@ -1540,12 +1663,12 @@ struct SnapData {
   rational movement;
 };
 
+const qreal kSnapRange = 10; // FIXME: Hardcoded number
+
 QVector<SnapData> AttemptSnap(const QVector<double>& screen_pt,
                               double compare_pt,
                               const QVector<rational>& start_times,
                               const rational& compare_time) {
-  const qreal kSnapRange = 10; // FIXME: Hardcoded number
-
   QVector<SnapData> snap_data;
 
   for (int i=0;i<screen_pt.size();i++) {
@@ -1579,15 +1702,22 @@ bool TimelineWidget::SnapPoint(QVector<rational> start_times, rational* movement
   }
 
   if (snap_points & kSnapToClips) {
-    foreach (Block* b, added_blocks_) {
-      qreal rect_left = TimeToScene(b->in());
-      qreal rect_right = TimeToScene(b->out());
+    UpdateSnapIndex();
+
+    // Scene position increases with time, so only the clip edges within snapping distance of each
+    // point need to be looked at
+    auto before_scene_pt = [this](const rational& t, double x){
+      return TimeToScene(t) < x;
+    };
 
-      // Attempt snapping to clip in point
-      potential_snaps.append(AttemptSnap(screen_pt, rect_left, start_times, b->in()));
+    for (int i=0; i<screen_pt.size(); i++) {
+      double max_pt = screen_pt.at(i) + kSnapRange;
 
-      // Attempt snapping to clip out point
-      potential_snaps.append(AttemptSnap(screen_pt, rect_right, start_times, b->out()));
+      for (auto it = std::lower_bound(snap_block_times_.cbegin(), snap_block_times_.cend(),
+                                      screen_pt.at(i) - kSnapRange, before_scene_pt);
+           it != snap_block_times_.cend() && TimeToScene(*it) <= max_pt; it++) {
+        potential_snaps.append({*it, *it - start_times.at(i)});
+      }
     }
   }
 
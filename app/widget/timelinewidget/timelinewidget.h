@@ -26,9 +26,11 @@
 #include <QWidget>
 
 #include "core.h"
+#include "node/block/clip/clip.h"
 #include "node/block/transition/transition.h"
 #include "node/nodecopypaste.h"
 #include "node/output/viewer/viewer.h"
+#include "task/task.h"
 #include "timeline/timelinecommon.h"
 #include "timelineandtrackview.h"
 #include "widget/slider/timeslider.h"
@@ -157,6 +159,8 @@ public:
 
   void ClearGhosts();
 
+  void UpdateViewports(const Track::Type& type = Track::kNone);
+
   bool HasGhosts() const
   {
     return !ghost_items_.isEmpty();
@@ -248,8 +252,8 @@ protected:
   virtual void ConnectNodeEvent(ViewerOutput* n) override;
   virtual void DisconnectNodeEvent(ViewerOutput* n) override;
 
-  virtual void CopyNodesToClipboardInternal(QXmlStreamWriter *writer, void* userdata) override;
-  virtual void PasteNodesFromClipboardInternal(QXmlStreamReader *reader, XMLNodeData &xml_node_data, void* userdata) override;
+  virtual void CopyNodesToClipboardInternal(XMLWriter *writer, void* userdata) override;
+  virtual void PasteNodesFromClipboardInternal(XMLReader *reader, XMLNodeData &xml_node_data, void* userdata) override;
 
   struct BlockPasteData {
     Block* block;
@@ -267,8 +271,6 @@ private:
 
   void ShowSnap(const QVector<rational>& times);
 
-  void UpdateViewports(const Track::Type& type = Track::kNone);
-
   QVector<Block*> GetBlocksInGlobalRect(const QPoint &p1, const QPoint &p2);
 
   QPoint drag_origin_;
@@ -297,6 +299,17 @@ private:
 
   QVector<Block*> added_blocks_;
 
+  /**
+   * @brief In and out points of every block in added_blocks_, sorted and without duplicates
+   *
+   * SnapPoint() binary searches this rather than testing every block on every mouse move. It's
+   * rebuilt the next time it's needed after blocks are added, removed or moved.
+   */
+  QVector<rational> snap_block_times_;
+  bool snap_index_dirty_;
+
+  void UpdateSnapIndex();
+
   int deferred_scroll_value_;
 
   bool use_audio_time_units_;
@@ -307,6 +320,13 @@ private:
 
   void UpdateViewTimebases();
 
+  /**
+   * @brief Start a background render of each clip, swapping it in as the clip's source when done
+   */
+  void RenderClipsInPlace(const QVector<ClipBlock*>& clips);
+
+  void RestoreClips(const QVector<ClipBlock*>& clips);
+
 private slots:
   void ViewMousePressed(TimelineViewMouseEvent* event);
   void ViewMouseMoved(TimelineViewMouseEvent* event);
@@ -327,6 +347,8 @@ private slots:
 
   void BlockUpdated();
 
+  void InvalidateSnapIndex();
+
   void UpdateHorizontalSplitters();
 
   void UpdateTimecodeWidthFromSplitters(QSplitter *s);
@@ -347,6 +369,8 @@ private slots:
 
   void SetViewWaveformsEnabled(bool e);
 
+  void SetViewThumbnailsEnabled(bool e);
+
   void FrameRateChanged();
 
   void SampleRateChanged();
@@ -355,6 +379,8 @@ private slots:
 
   void SetScrollZoomsByDefaultOnAllViews(bool e);
 
+  void RenderInPlaceFinished(Task* task, bool succeeded);
+
 };
 
 }
@@ -311,7 +311,7 @@ void ImportTool::DropGhosts(bool insert)
       }
 
       if (behavior != kDWSDisable && dont_ask_again_box->isChecked()) {
-        Config::Current()["DropWithoutSequenceBehavior"] = behavior;
+        Config::Current().Set("DropWithoutSequenceBehavior", behavior);
       }
     }
 
@@ -20,10 +20,10 @@
 
 #include "widget/timelinewidget/timelinewidget.h"
 
+#include <climits>
 #include <QDebug>
 #include <QToolTip>
 
-#include "common/clamp.h"
 #include "common/flipmodifiers.h"
 #include "common/qtutils.h"
 #include "common/range.h"
@@ -169,6 +169,7 @@ void PointerTool::MouseMove(TimelineViewMouseEvent *event)
       // If we're performing an action, we can initiate ghosts
       if (drag_movement_mode_ != Timeline::kNone) {
         InitiateDrag(clicked_item_, drag_movement_mode_);
+        CalculateDragBounds();
       }
 
       // Set dragging to true here so no matter what, the drag isn't re-initiated until it's completed
@@ -449,29 +450,22 @@ void PointerTool::ProcessDrag(const TimelineCoordinate &mouse_pos)
   rational time_movement = mouse_pos.GetFrame() - drag_start_.GetFrame();
 
   // Validate movement (enforce all ghosts moving in legal ways)
-  time_movement = ValidateTimeMovement(time_movement);
-  time_movement = ValidateInTrimming(time_movement);
-  time_movement = ValidateOutTrimming(time_movement);
+  time_movement = ClampTimeMovement(time_movement);
 
   // Perform snapping if enabled (adjusts time_movement if it's close to any potential snap points)
   if (Core::instance()->snapping()) {
     parent()->SnapPoint(snap_points_, &time_movement);
 
-    time_movement = ValidateTimeMovement(time_movement);
-    time_movement = ValidateInTrimming(time_movement);
-    time_movement = ValidateOutTrimming(time_movement);
+    time_movement = ClampTimeMovement(time_movement);
   }
 
   // Validate ghosts that are being moved (clips from other track types do NOT get moved)
   if (track_movement != 0) {
-    QVector<TimelineViewGhostItem*> validate_track_ghosts = parent()->GetGhostItems();
-    for (int i=0;i<validate_track_ghosts.size();i++) {
-      if (validate_track_ghosts.at(i)->GetTrack().type() != drag_track_type_) {
-        validate_track_ghosts.removeAt(i);
-        i--;
-      }
+    if (drag_bounds_.can_move_tracks) {
+      track_movement = qMax(track_movement, drag_bounds_.earliest_track_movement);
+    } else {
+      track_movement = 0;
     }
-    track_movement = ValidateTrackMovement(track_movement, validate_track_ghosts);
   }
 
   // Perform movement
@@ -800,74 +794,92 @@ bool PointerTool::IsClipTrimmable(Block *clip,
   return true;
 }
 
-rational PointerTool::ValidateInTrimming(rational movement)
+void PointerTool::CalculateDragBounds()
 {
-  bool first_ghost = true;
+  drag_bounds_.earliest_move = RATIONAL_MIN;
+  drag_bounds_.latest_trim_in = RATIONAL_MAX;
+  drag_bounds_.earliest_trim_out = RATIONAL_MIN;
+  drag_bounds_.first_move = nullptr;
+  drag_bounds_.first_trim_in = nullptr;
+  drag_bounds_.first_trim_out = nullptr;
+  drag_bounds_.can_move_tracks = true;
+  drag_bounds_.earliest_track_movement = INT_MIN;
 
   foreach (TimelineViewGhostItem* ghost, parent()->GetGhostItems()) {
-    if (ghost->GetMode() != Timeline::kTrimIn) {
-      continue;
-    }
+    rational ghost_timebase = parent()->GetTimebaseForTrackType(ghost->GetTrack().type());
 
-    rational earliest_in = RATIONAL_MIN;
-    rational latest_in = ghost->GetOut();
+    switch (ghost->GetMode()) {
+    case Timeline::kNone:
+      break;
+    case Timeline::kMove:
+      // Prevents any ghosts from going below 0:00:00 time
+      drag_bounds_.earliest_move = qMax(drag_bounds_.earliest_move, -ghost->GetIn());
 
-    rational ghost_timebase = parent()->GetTimebaseForTrackType(ghost->GetTrack().type());
+      if (!drag_bounds_.first_move) {
+        drag_bounds_.first_move = ghost;
+        drag_bounds_.first_move_timebase = ghost_timebase;
+      }
 
-    // If the ghost must be at least one frame in size, limit the latest allowed in point
-    if (!ghost->CanHaveZeroLength()) {
-      latest_in -= ghost_timebase;
-    }
+      if (ghost->GetTrack().type() == drag_track_type_) {
+        if (ghost->GetCanMoveTracks()) {
+          // Prevents any ghosts from going to a non-existent negative track
+          drag_bounds_.earliest_track_movement = qMax(drag_bounds_.earliest_track_movement, -ghost->GetTrack().index());
+        } else {
+          drag_bounds_.can_move_tracks = false;
+        }
+      }
+      break;
+    case Timeline::kTrimIn:
+    {
+      // If the ghost must be at least one frame in size, limit the latest allowed in point
+      rational latest_in = ghost->GetOut();
+      if (!ghost->CanHaveZeroLength()) {
+        latest_in -= ghost_timebase;
+      }
 
-    // Clamp adjusted value between the earliest and latest values
-    rational adjusted = ghost->GetIn() + movement;
-    rational clamped = clamp(adjusted, earliest_in, latest_in);
+      drag_bounds_.latest_trim_in = qMin(drag_bounds_.latest_trim_in, latest_in - ghost->GetIn());
 
-    if (clamped != adjusted) {
-      movement = clamped - ghost->GetIn();
+      if (!drag_bounds_.first_trim_in) {
+        drag_bounds_.first_trim_in = ghost;
+        drag_bounds_.first_trim_in_timebase = ghost_timebase;
+      }
+      break;
     }
+    case Timeline::kTrimOut:
+    {
+      rational earliest_out = ghost->GetIn();
+      if (!ghost->CanHaveZeroLength()) {
+        earliest_out += ghost_timebase;
+      }
+
+      drag_bounds_.earliest_trim_out = qMax(drag_bounds_.earliest_trim_out, earliest_out - ghost->GetOut());
 
-    if (first_ghost) {
-      movement = SnapMovementToTimebase(ghost->GetIn(), movement, ghost_timebase);
-      first_ghost = false;
+      if (!drag_bounds_.first_trim_out) {
+        drag_bounds_.first_trim_out = ghost;
+        drag_bounds_.first_trim_out_timebase = ghost_timebase;
+      }
+      break;
+    }
     }
   }
-
-  return movement;
 }
 
-rational PointerTool::ValidateOutTrimming(rational movement)
+rational PointerTool::ClampTimeMovement(rational movement) const
 {
-  bool first_ghost = true;
-
-  foreach (TimelineViewGhostItem* ghost, parent()->GetGhostItems()) {
-    if (ghost->GetMode() != Timeline::kTrimOut) {
-      continue;
-    }
-
-    // Determine earliest and latest out points
-    rational earliest_out = ghost->GetIn();
-
-    rational ghost_timebase = parent()->GetTimebaseForTrackType(ghost->GetTrack().type());
-
-    if (!ghost->CanHaveZeroLength()) {
-      earliest_out += ghost_timebase;
-    }
-
-    rational latest_out = RATIONAL_MAX;
-
-    // Clamp adjusted value between the earliest and latest values
-    rational adjusted = ghost->GetOut() + movement;
-    rational clamped = clamp(adjusted, earliest_out, latest_out);
+  // Snap to the timebase before clamping so the limits always win
+  if (drag_bounds_.first_move) {
+    movement = SnapMovementToTimebase(drag_bounds_.first_move->GetIn(), movement, drag_bounds_.first_move_timebase);
+    movement = qMax(movement, drag_bounds_.earliest_move);
+  }
 
-    if (clamped != adjusted) {
-      movement = clamped - ghost->GetOut();
-    }
+  if (drag_bounds_.first_trim_in) {
+    movement = SnapMovementToTimebase(drag_bounds_.first_trim_in->GetIn(), movement, drag_bounds_.first_trim_in_timebase);
+    movement = qMin(movement, drag_bounds_.latest_trim_in);
+  }
 
-    if (first_ghost) {
-      movement = SnapMovementToTimebase(ghost->GetOut(), movement, ghost_timebase);
-      first_ghost = false;
-    }
+  if (drag_bounds_.first_trim_out) {
+    movement = SnapMovementToTimebase(drag_bounds_.first_trim_out->GetOut(), movement, drag_bounds_.first_trim_out_timebase);
+    movement = qMax(movement, drag_bounds_.earliest_trim_out);
   }
 
   return movement;
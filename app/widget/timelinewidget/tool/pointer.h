@@ -47,20 +47,20 @@ protected:
   TimelineViewGhostItem* AddGhostFromNull(const rational& in, const rational& out, const Track::Reference& track, Timeline::MovementMode mode);
 
   /**
-   * @brief Validates Ghosts that are getting their in points trimmed
+   * @brief Work out how far the ghosts of this drag are allowed to move
    *
-   * Assumes ghost->data() is a Block. Ensures no Ghost's in point becomes a negative timecode. Also ensures no
-   * Ghost's length becomes 0 or negative.
+   * Ghosts keep their starting in and out points for the whole drag (movement is stored as an
+   * adjustment), so this only needs to run once after the ghosts are created.
    */
-  rational ValidateInTrimming(rational movement);
+  void CalculateDragBounds();
 
   /**
-   * @brief Validates Ghosts that are getting their out points trimmed
+   * @brief Clamp time movement to CalculateDragBounds()
    *
-   * Assumes ghost->data() is a Block. Ensures no Ghost's in point becomes a negative timecode. Also ensures no
-   * Ghost's length becomes 0 or negative.
+   * Ensures no moved ghost's in point becomes a negative timecode and no trimmed ghost's length
+   * becomes 0 or negative, and keeps ghost edges on their timebase.
    */
-  rational ValidateOutTrimming(rational movement);
+  rational ClampTimeMovement(rational movement) const;
 
   virtual void ProcessDrag(const TimelineCoordinate &mouse_pos);
 
@@ -121,6 +121,28 @@ private:
 
   QPoint drag_global_start_;
 
+  struct DragBounds
+  {
+    // Limits on time movement
+    rational earliest_move;
+    rational latest_trim_in;
+    rational earliest_trim_out;
+
+    // First ghost of each mode, whose edge is kept on its track type's timebase
+    TimelineViewGhostItem* first_move;
+    rational first_move_timebase;
+    TimelineViewGhostItem* first_trim_in;
+    rational first_trim_in_timebase;
+    TimelineViewGhostItem* first_trim_out;
+    rational first_trim_out_timebase;
+
+    // Limits on track movement of ghosts on drag_track_type_
+    bool can_move_tracks;
+    int earliest_track_movement;
+  };
+
+  DragBounds drag_bounds_;
+
 };
 
 }
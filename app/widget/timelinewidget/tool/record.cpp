@@ -1,11 +1,131 @@
 #include "record.h"
 
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMessageBox>
+#include <QStandardPaths>
+
+#include "audio/audiomanager.h"
+#include "core.h"
+#include "panel/panelmanager.h"
+#include "panel/project/project.h"
+#include "widget/timelinewidget/timelinewidget.h"
+
 namespace olive {
 
 RecordTool::RecordTool(TimelineWidget *parent) :
-  BeamTool(parent)
+  BeamTool(parent),
+  ghost_(nullptr)
+{
+  // Recording runs on its own threads, this only grows the ghost so the user can see it going
+  update_timer_ = new QTimer(parent);
+  update_timer_->setInterval(100);
+  QObject::connect(update_timer_, &QTimer::timeout, parent, [this]{
+    UpdateGhost();
+  });
+}
+
+RecordTool::~RecordTool()
+{
+  if (ghost_) {
+    StopRecording();
+  }
+
+  delete update_timer_;
+}
+
+void RecordTool::MousePress(TimelineViewMouseEvent *event)
+{
+  if (ghost_) {
+    StopRecording();
+    return;
+  }
+
+  const Track::Reference& track = event->GetTrack();
+
+  // Only unlocked audio tracks can be recorded onto
+  Track* t = parent()->GetTrackFromReference(track);
+  if (track.type() != Track::kAudio || (t && t->IsLocked())) {
+    return;
+  }
+
+  StartRecording(track, ValidatedCoordinate(event->GetCoordinates(true)).GetFrame());
+}
+
+void RecordTool::StartRecording(const Track::Reference &track, const rational &start)
+{
+  QString filename = GetRecordingFilename(sequence()->project());
+
+  if (!AudioManager::instance()->StartRecording(filename)) {
+    QMessageBox::critical(parent(),
+                          QCoreApplication::translate("RecordTool", "Failed to record"),
+                          QCoreApplication::translate("RecordTool", "Failed to start recording from the audio input "
+                                                                    "device. Check the audio input in Preferences."));
+    return;
+  }
+
+  ghost_ = new TimelineViewGhostItem();
+  ghost_->SetIn(start);
+  ghost_->SetOut(start);
+  ghost_->SetTrack(track);
+  parent()->AddGhost(ghost_);
+
+  update_timer_->start();
+}
+
+void RecordTool::StopRecording()
+{
+  update_timer_->stop();
+
+  AudioManager::instance()->StopRecording();
+
+  parent()->ClearGhosts();
+  ghost_ = nullptr;
+
+  QString filename = AudioManager::instance()->recorder()->filename();
+
+  if (AudioManager::instance()->recorder()->GetRecordedLength().isNull()) {
+    QFile::remove(filename);
+    return;
+  }
+
+  // Import into the project panel the user last used, the same as importing any other file
+  ProjectPanel* project_panel = PanelManager::instance()->MostRecentlyFocused<ProjectPanel>();
+  if (project_panel && project_panel->project()) {
+    Core::instance()->ImportFiles({filename}, project_panel->model(), project_panel->GetSelectedFolder());
+  }
+}
+
+void RecordTool::UpdateGhost()
+{
+  if (ghost_) {
+    ghost_->SetOut(ghost_->GetIn() + AudioManager::instance()->recorder()->GetRecordedLength());
+    parent()->UpdateViewports(Track::kAudio);
+  }
+}
+
+QString RecordTool::GetRecordingFilename(Project *project)
 {
+  // Keep recordings next to the project if it's been saved
+  QString dir;
+
+  if (project && !project->filename().isEmpty()) {
+    dir = QFileInfo(project->filename()).absolutePath();
+  } else {
+    dir = QStandardPaths::writableLocation(QStandardPaths::MusicLocation);
+  }
+
+  QDir(dir).mkpath(QStringLiteral("."));
+
+  QString base = QStringLiteral("Recording %1").arg(QDateTime::currentDateTime().toString(QStringLiteral("yyyy-MM-dd hh-mm-ss")));
+  QString filename = QDir(dir).filePath(base + QStringLiteral(".wav"));
+
+  for (int i=2; QFileInfo::exists(filename); i++) {
+    filename = QDir(dir).filePath(QStringLiteral("%1 (%2).wav").arg(base, QString::number(i)));
+  }
 
+  return filename;
 }
 
 }
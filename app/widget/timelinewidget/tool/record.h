@@ -21,6 +21,8 @@
 #ifndef RECORDTIMELINETOOL_H
 #define RECORDTIMELINETOOL_H
 
+#include <QTimer>
+
 #include "beam.h"
 
 namespace olive {
@@ -29,6 +31,27 @@ class RecordTool : public BeamTool
 {
 public:
   RecordTool(TimelineWidget* parent);
+
+  virtual ~RecordTool() override;
+
+  /**
+   * @brief Clicking an audio track starts recording there, clicking again stops and imports it
+   */
+  virtual void MousePress(TimelineViewMouseEvent *event) override;
+
+private:
+  void StartRecording(const Track::Reference& track, const rational& start);
+
+  void StopRecording();
+
+  void UpdateGhost();
+
+  static QString GetRecordingFilename(Project* project);
+
+  TimelineViewGhostItem* ghost_;
+
+  QTimer* update_timer_;
+
 };
 
 }
@@ -44,7 +44,8 @@ TimelineView::TimelineView(Qt::Alignment vertical_alignment, QWidget *parent) :
   ghosts_(nullptr),
   show_beam_cursor_(false),
   connected_track_list_(nullptr),
-  show_waveforms_(true)
+  show_waveforms_(true),
+  show_thumbnails_(true)
 {
   Q_ASSERT(vertical_alignment == Qt::AlignTop || vertical_alignment == Qt::AlignBottom);
   setAlignment(Qt::AlignLeft | vertical_alignment);
@@ -53,6 +54,8 @@ TimelineView::TimelineView(Qt::Alignment vertical_alignment, QWidget *parent) :
   setBackgroundRole(QPalette::Window);
   setContextMenuPolicy(Qt::CustomContextMenu);
   viewport()->setMouseTracking(true);
+
+  connect(&thumbnails_, &TimelineViewThumbnailCache::ThumbnailsChanged, viewport(), static_cast<void(QWidget::*)()>(&QWidget::update));
 }
 
 void TimelineView::mousePressEvent(QMouseEvent *event)
@@ -240,7 +243,7 @@ void TimelineView::drawForeground(QPainter *painter, const QRectF &rect)
   }
 
   // Draw block backgrounds
-  DrawBlocks(painter, false);
+  DrawBlocks(painter, false, rect);
 
   // Draw selections
   if (selections_ && !selections_->isEmpty()) {
@@ -262,9 +265,11 @@ void TimelineView::drawForeground(QPainter *painter, const QRectF &rect)
   }
 
   // Draw block foregrounds
-  DrawBlocks(painter, true);
+  DrawBlocks(painter, true, rect);
 
   // Draw ghosts
+  ghost_scene_rects_.clear();
+
   if (ghosts_ && !ghosts_->isEmpty()) {
     painter->setPen(QPen(Qt::yellow, 2));
     painter->setBrush(Qt::NoBrush);
@@ -272,12 +277,10 @@ void TimelineView::drawForeground(QPainter *painter, const QRectF &rect)
     foreach (TimelineViewGhostItem* ghost, (*ghosts_)) {
       if (ghost->GetTrack().type() == connected_track_list_->type()
           && !ghost->IsInvisible()) {
-        int track_index = ghost->GetAdjustedTrack().index();
+        QRectF ghost_rect = GetGhostSceneRect(ghost);
 
-        painter->drawRect(TimeToScene(ghost->GetAdjustedIn()),
-                          GetTrackY(track_index),
-                          TimeToScene(ghost->GetAdjustedLength()),
-                          GetTrackHeight(track_index));
+        painter->drawRect(ghost_rect);
+        ghost_scene_rects_.append(ghost_rect);
       }
     }
   }
@@ -373,15 +376,25 @@ TimelineViewMouseEvent TimelineView::CreateMouseEvent(const QPoint& pos, Qt::Mou
                                 modifiers);
 }
 
-void TimelineView::DrawBlocks(QPainter *painter, bool foreground)
+void TimelineView::DrawBlocks(QPainter *painter, bool foreground, const QRectF &exposed)
 {
+  // Block geometry is always clamped to the whole viewport so that a partial repaint draws exactly
+  // the same pixels as a full one, only the blocks drawn are limited to the exposed area
   qreal left_bound = horizontalScrollBar()->value();
   qreal right_bound = viewport()->width() + horizontalScrollBar()->value();
 
-  rational start_time = SceneToTime(left_bound);
-  rational end_time = SceneToTime(right_bound);
+  rational start_time = SceneToTime(qMax(left_bound, exposed.left()));
+  rational end_time = SceneToTime(qMin(right_bound, exposed.right()));
 
   foreach (Track* track, connected_track_list_->GetTracks()) {
+    qreal block_top = GetTrackY(track->Index());
+    qreal block_height = GetTrackHeight(track->Index());
+
+    if (block_top > exposed.bottom() || block_top + block_height < exposed.top()) {
+      // This track isn't in the area being repainted
+      continue;
+    }
+
     // Get first visible block in this track
     Block* block = track->NearestBlockBeforeOrAt(start_time);
 
@@ -390,8 +403,6 @@ void TimelineView::DrawBlocks(QPainter *painter, bool foreground)
 
         qreal block_left = qMax(left_bound, TimeToScene(block->in()));
         qreal block_right = qMin(right_bound, TimeToScene(block->out())) - 1;
-        qreal block_top = GetTrackY(track->Index());
-        qreal block_height = GetTrackHeight(track->Index());
 
         QRectF r(block_left,
                  block_top,
@@ -437,6 +448,12 @@ void TimelineView::DrawBlocks(QPainter *painter, bool foreground)
           painter->setBrush(block->is_enabled() ? block->brush(block_top, block_top + block_height) : Qt::gray);
           painter->drawRect(r);
 
+          // Draw thumbnails
+          ClipBlock* clip = dynamic_cast<ClipBlock*>(block);
+          if (show_thumbnails_ && clip && track->type() == Track::kVideo && block->is_enabled()) {
+            DrawThumbnails(painter, clip, r.adjusted(0, text_total_height, 0, 0), exposed);
+          }
+
           // Draw waveform
           if (show_waveforms_) {
             QRect waveform_rect = r.adjusted(0, text_total_height, 0, 0).toRect();
@@ -475,6 +492,46 @@ void TimelineView::DrawBlocks(QPainter *painter, bool foreground)
   }
 }
 
+void TimelineView::DrawThumbnails(QPainter *painter, ClipBlock *clip, const QRectF &rect, const QRectF &exposed)
+{
+  const VideoParams& vp = connected_track_list_->parent()->GetVideoParams();
+
+  int height = qFloor(rect.height());
+  if (height <= 0 || vp.height() <= 0 || timebase().isNull()) {
+    return;
+  }
+
+  qreal width = qreal(height) * vp.square_pixel_width() / vp.height();
+  int stored_height = TimelineViewThumbnailCache::GetStoredHeight(height);
+  rational interval = TimelineViewThumbnailCache::GetInterval(timebase(), GetScale(), qCeil(width));
+
+  // Thumbnails are aligned to the clip rather than the sequence so moving clips doesn't change them
+  qreal clip_left = TimeToScene(clip->in());
+  qreal interval_width = interval.toDouble() * GetScale();
+
+  qreal left = qMax(rect.left(), exposed.left());
+  qreal right = qMin(rect.right(), exposed.right());
+
+  painter->save();
+  painter->setClipRect(rect, Qt::IntersectClip);
+
+  for (int i=qMax(0, qFloor((left - clip_left) / interval_width)); clip_left + i * interval_width < right; i++) {
+    QImage image = thumbnails_.Get(clip, interval * i, stored_height);
+
+    // Until it arrives, show the nearest thumbnail from further out if we have it
+    for (int level=1; image.isNull() && level<=2; level++) {
+      int step = 1 << level;
+      image = thumbnails_.GetCached(clip, interval * step * (i / step), stored_height);
+    }
+
+    if (!image.isNull()) {
+      painter->drawImage(QRectF(clip_left + i * interval_width, rect.top(), width, height), image);
+    }
+  }
+
+  painter->restore();
+}
+
 int TimelineView::GetHeightOfAllTracks() const
 {
   if (connected_track_list_) {
@@ -545,6 +602,8 @@ void TimelineView::ConnectTrackList(TrackList *list)
   if (connected_track_list_) {
     connect(connected_track_list_, &TrackList::TrackListChanged, this, &TimelineView::TrackListChanged);
   }
+
+  thumbnails_.SetViewerNode(connected_track_list_ ? connected_track_list_->parent() : nullptr);
 }
 
 void TimelineView::SetBeamCursor(const TimelineCoordinate &coord)
@@ -560,6 +619,26 @@ void TimelineView::SetBeamCursor(const TimelineCoordinate &coord)
   }
 }
 
+void TimelineView::UpdateGhosts()
+{
+  if (!connected_track_list_) {
+    return;
+  }
+
+  foreach (const QRectF& r, ghost_scene_rects_) {
+    viewport()->update(GhostViewportRect(r));
+  }
+
+  if (ghosts_) {
+    foreach (TimelineViewGhostItem* ghost, (*ghosts_)) {
+      if (ghost->GetTrack().type() == connected_track_list_->type()
+          && !ghost->IsInvisible()) {
+        viewport()->update(GhostViewportRect(GetGhostSceneRect(ghost)));
+      }
+    }
+  }
+}
+
 int TimelineView::SceneToTrack(double y)
 {
   int track = -1;
@@ -583,10 +662,10 @@ Block *TimelineView::GetItemAtScenePos(const rational &time, int track_index) co
     Track* track = connected_track_list_->GetTrackAt(track_index);
 
     if (track) {
-      foreach (Block* b, track->Blocks()) {
-        if (b->in() <= time && b->out() > time) {
-          return b;
-        }
+      Block* b = track->NearestBlockBeforeOrAt(time);
+
+      if (b && b->in() <= time) {
+        return b;
       }
     }
   }
@@ -606,4 +685,20 @@ void TimelineView::TrackListChanged()
   viewport()->update();
 }
 
+QRectF TimelineView::GetGhostSceneRect(TimelineViewGhostItem *ghost)
+{
+  int track_index = ghost->GetAdjustedTrack().index();
+
+  return QRectF(TimeToScene(ghost->GetAdjustedIn()),
+                GetTrackY(track_index),
+                TimeToScene(ghost->GetAdjustedLength()),
+                GetTrackHeight(track_index));
+}
+
+QRect TimelineView::GhostViewportRect(const QRectF &scene_rect) const
+{
+  // Pad to cover the width of the ghost's outline
+  return mapFromScene(scene_rect).boundingRect().adjusted(-2, -2, 2, 2);
+}
+
 }
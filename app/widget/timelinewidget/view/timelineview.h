@@ -30,6 +30,7 @@
 #include "node/block/clip/clip.h"
 #include "timelineviewmouseevent.h"
 #include "timelineviewghostitem.h"
+#include "timelineviewthumbnailcache.h"
 #include "widget/timebased/timebasedview.h"
 
 namespace olive {
@@ -66,6 +67,13 @@ public:
     ghosts_ = ghosts;
   }
 
+  /**
+   * @brief Repaint only where ghosts are now and where they were last drawn
+   *
+   * Used while dragging instead of updating the whole viewport, since nothing else moves.
+   */
+  void UpdateGhosts();
+
   int SceneToTrack(double y);
 
   Block* GetItemAtScenePos(const rational& time, int track_index) const;
@@ -81,6 +89,17 @@ public:
     viewport()->update();
   }
 
+  bool GetShowThumbnails() const
+  {
+    return show_thumbnails_;
+  }
+
+  void SetShowThumbnails(bool e)
+  {
+    show_thumbnails_ = e;
+    viewport()->update();
+  }
+
 signals:
   void MousePressed(TimelineViewMouseEvent* event);
   void MouseMoved(TimelineViewMouseEvent* event);
@@ -121,7 +140,9 @@ private:
   TimelineViewMouseEvent CreateMouseEvent(QMouseEvent* event);
   TimelineViewMouseEvent CreateMouseEvent(const QPoint &pos, Qt::MouseButton button, Qt::KeyboardModifiers modifiers);
 
-  void DrawBlocks(QPainter* painter, bool foreground);
+  void DrawBlocks(QPainter* painter, bool foreground, const QRectF& exposed);
+
+  void DrawThumbnails(QPainter* painter, ClipBlock* clip, const QRectF& rect, const QRectF& exposed);
 
   int GetHeightOfAllTracks() const;
 
@@ -129,10 +150,17 @@ private:
 
   void UpdatePlayheadRect();
 
+  QRectF GetGhostSceneRect(TimelineViewGhostItem* ghost);
+
+  QRect GhostViewportRect(const QRectF& scene_rect) const;
+
   QHash<Track::Reference, TimeRangeList>* selections_;
 
   QVector<TimelineViewGhostItem*>* ghosts_;
 
+  /// Where ghosts were drawn in the last paint, for UpdateGhosts()
+  QVector<QRectF> ghost_scene_rects_;
+
   bool show_beam_cursor_;
 
   TimelineCoordinate cursor_coord_;
@@ -141,6 +169,10 @@ private:
 
   bool show_waveforms_;
 
+  bool show_thumbnails_;
+
+  TimelineViewThumbnailCache thumbnails_;
+
 private slots:
   void TrackListChanged();
 
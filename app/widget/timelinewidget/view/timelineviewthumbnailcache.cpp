@@ -0,0 +1,159 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "timelineviewthumbnailcache.h"
+
+#include <QDir>
+
+#include "render/diskmanager.h"
+#include "render/previewautocacher.h"
+#include "render/rendermanager.h"
+
+namespace olive {
+
+const int TimelineViewThumbnailCache::kStoredHeights[] = {32, 64, 128};
+
+const int TimelineViewThumbnailCache::kMaximumPendingRequests = 4;
+
+// In KiB
+const int TimelineViewThumbnailCache::kMemoryLimit = 32768;
+
+TimelineViewThumbnailCache::TimelineViewThumbnailCache(QObject *parent) :
+  QObject(parent),
+  viewer_(nullptr),
+  images_(kMemoryLimit)
+{
+}
+
+void TimelineViewThumbnailCache::SetViewerNode(ViewerOutput *viewer)
+{
+  if (viewer_ == viewer) {
+    return;
+  }
+
+  // Anything still pending will arrive in the disk cache, we just won't hear about it
+  qDeleteAll(pending_.keys());
+  pending_.clear();
+
+  images_.clear();
+
+  viewer_ = viewer;
+}
+
+QImage TimelineViewThumbnailCache::Get(ClipBlock *clip, const rational &time, int height)
+{
+  if (!viewer_) {
+    return QImage();
+  }
+
+  QByteArray key = GetKey(clip, time, height);
+
+  QImage* image = images_.object(key);
+  if (image) {
+    return *image;
+  }
+
+  if (pending_.size() >= kMaximumPendingRequests || pending_.key(key)) {
+    // Wait for what's already queued, we'll be asked again once it arrives
+    return QImage();
+  }
+
+  PreviewAutoCacher* cacher = PreviewAutoCacher::Get(viewer_);
+  if (!cacher) {
+    return QImage();
+  }
+
+  RenderTicketPtr ticket = cacher->GetThumbnail(clip, time, height, GetCacheFile(key));
+  if (ticket) {
+    RenderTicketWatcher* watcher = new RenderTicketWatcher(this);
+    connect(watcher, &RenderTicketWatcher::Finished, this, &TimelineViewThumbnailCache::ThumbnailFinished);
+    pending_.insert(watcher, key);
+    watcher->SetTicket(ticket);
+  }
+
+  return QImage();
+}
+
+QImage TimelineViewThumbnailCache::GetCached(ClipBlock *clip, const rational &time, int height)
+{
+  if (!viewer_) {
+    return QImage();
+  }
+
+  QImage* image = images_.object(GetKey(clip, time, height));
+  return image ? *image : QImage();
+}
+
+int TimelineViewThumbnailCache::GetStoredHeight(int height)
+{
+  for (int h : kStoredHeights) {
+    if (h >= height) {
+      return h;
+    }
+  }
+
+  return kStoredHeights[sizeof(kStoredHeights) / sizeof(int) - 1];
+}
+
+rational TimelineViewThumbnailCache::GetInterval(const rational &timebase, double scale, int thumbnail_width)
+{
+  rational interval = timebase;
+
+  if (scale > 0 && thumbnail_width > 0) {
+    while (interval.toDouble() * scale < thumbnail_width) {
+      interval *= rational(2);
+    }
+  }
+
+  return interval;
+}
+
+QByteArray TimelineViewThumbnailCache::GetKey(ClipBlock *clip, const rational &time, int height) const
+{
+  QByteArray key = RenderManager::Hash(clip, Node::kDefaultOutput, viewer_->GetVideoParams(), time);
+
+  key.append(reinterpret_cast<const char*>(&height), sizeof(height));
+
+  return key;
+}
+
+QString TimelineViewThumbnailCache::GetCacheFile(const QByteArray &key)
+{
+  QDir dir(QDir(DiskManager::instance()->GetDefaultCachePath()).filePath(QStringLiteral("thumbnails")));
+
+  return dir.filePath(QStringLiteral("%1.jpg").arg(QString::fromLatin1(key.toHex())));
+}
+
+void TimelineViewThumbnailCache::ThumbnailFinished(RenderTicketWatcher *watcher)
+{
+  QByteArray key = pending_.take(watcher);
+
+  if (watcher->HasResult()) {
+    QImage image = watcher->Get().value<QImage>();
+
+    images_.insert(key, new QImage(image), qMax(1, image.bytesPerLine() * image.height() / 1024));
+
+    emit ThumbnailsChanged();
+  }
+
+  watcher->deleteLater();
+}
+
+}
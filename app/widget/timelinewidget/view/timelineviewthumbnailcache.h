@@ -0,0 +1,104 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef TIMELINEVIEWTHUMBNAILCACHE_H
+#define TIMELINEVIEWTHUMBNAILCACHE_H
+
+#include <QCache>
+#include <QImage>
+
+#include "node/block/clip/clip.h"
+#include "node/output/viewer/viewer.h"
+#include "threading/threadticketwatcher.h"
+
+namespace olive {
+
+/**
+ * @brief Memory and disk cache of the filmstrip thumbnails shown on video clips
+ *
+ * Thumbnails are keyed by the hash of what the clip shows at a given time, so they survive clips
+ * being moved or copied. Missing thumbnails are requested as background tickets through the
+ * auto-cacher of whichever viewer is showing the sequence, so they never hold up playback, and are
+ * kept as JPEGs in the disk cache so they don't need to be rendered again.
+ */
+class TimelineViewThumbnailCache : public QObject
+{
+  Q_OBJECT
+public:
+  TimelineViewThumbnailCache(QObject* parent = nullptr);
+
+  void SetViewerNode(ViewerOutput* viewer);
+
+  /**
+   * @brief Get the thumbnail of `clip` at `time` (relative to the clip's in point)
+   *
+   * If the thumbnail isn't in memory, a null image is returned and the thumbnail is loaded or
+   * rendered in the background. ThumbnailsChanged() is emitted when it arrives.
+   */
+  QImage Get(ClipBlock* clip, const rational& time, int height);
+
+  /**
+   * @brief Same as Get() but never requests a missing thumbnail
+   */
+  QImage GetCached(ClipBlock* clip, const rational& time, int height);
+
+  /**
+   * @brief Get the height thumbnails are stored at to be shown at a given height
+   *
+   * Only a few heights are stored so resizing tracks doesn't render everything again.
+   */
+  static int GetStoredHeight(int height);
+
+  /**
+   * @brief Get the time between thumbnails at a given zoom level
+   *
+   * This is always a power of two number of frames, so every thumbnail at one zoom level is also
+   * used at the next one out.
+   */
+  static rational GetInterval(const rational& timebase, double scale, int thumbnail_width);
+
+signals:
+  void ThumbnailsChanged();
+
+private:
+  QByteArray GetKey(ClipBlock* clip, const rational& time, int height) const;
+
+  static QString GetCacheFile(const QByteArray& key);
+
+  ViewerOutput* viewer_;
+
+  QCache<QByteArray, QImage> images_;
+
+  QHash<RenderTicketWatcher*, QByteArray> pending_;
+
+  static const int kStoredHeights[];
+
+  static const int kMaximumPendingRequests;
+
+  static const int kMemoryLimit;
+
+private slots:
+  void ThumbnailFinished(RenderTicketWatcher* watcher);
+
+};
+
+}
+
+#endif // TIMELINEVIEWTHUMBNAILCACHE_H
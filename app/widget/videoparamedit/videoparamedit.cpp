@@ -211,6 +211,16 @@ VideoParamEdit::VideoParamEdit(QWidget* parent) :
   colorspace_combobox_ = new QComboBox();
   connect(colorspace_combobox_, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, &VideoParamEdit::Changed);
   layout->addWidget(colorspace_combobox_, row, 1);
+
+  row++;
+
+  // Hardware decoding
+  hardware_decoding_lbl_ = new QLabel(tr("Hardware Decoding"));
+  layout->addWidget(hardware_decoding_lbl_, row, 0);
+
+  hardware_decoding_box_ = new QCheckBox();
+  connect(hardware_decoding_box_, &QCheckBox::clicked, this, &VideoParamEdit::Changed);
+  layout->addWidget(hardware_decoding_box_, row, 1);
 }
 
 void VideoParamEdit::SetParameterMask(uint64_t mask)
@@ -264,6 +274,9 @@ void VideoParamEdit::SetParameterMask(uint64_t mask)
 
   colorspace_lbl_->setVisible(mask & kColorspace);
   colorspace_combobox_->setVisible(mask & kColorspace);
+
+  hardware_decoding_lbl_->setVisible(mask & kHardwareDecoding);
+  hardware_decoding_box_->setVisible(mask & kHardwareDecoding);
 }
 
 VideoParams VideoParamEdit::GetVideoParams() const
@@ -304,6 +317,7 @@ VideoParams VideoParamEdit::GetVideoParams() const
   p.set_duration(end_time_slider_->GetValue() - start_time_slider_->GetValue() + 1);
   p.set_premultiplied_alpha(premultiplied_alpha_box_->isChecked());
   p.set_colorspace(colorspace_combobox_->currentData().toString());
+  p.set_hardware_decoding(hardware_decoding_box_->isChecked());
 
   return p;
 }
@@ -331,6 +345,7 @@ void VideoParamEdit::SetVideoParams(const VideoParams &p)
   start_time_slider_->SetValue(p.start_time());
   end_time_slider_->SetValue(p.start_time() + p.duration() - 1);
   premultiplied_alpha_box_->setChecked(p.premultiplied_alpha());
+  hardware_decoding_box_->setChecked(p.hardware_decoding());
 
   if (color_manager_) {
     // Assume colorspace box has been populated correctly
@@ -61,7 +61,8 @@ public:
     kPremultipliedAlpha = 0x2000,
     kColorspace = 0x4000,
     kFrameRateIsNotTimebase = 0x8000,
-    kFrameRateIsArbitrary = 0x10000
+    kFrameRateIsArbitrary = 0x10000,
+    kHardwareDecoding = 0x20000
   };
 
   void SetParameterMask(uint64_t mask);
@@ -168,6 +169,8 @@ private:
   QCheckBox* premultiplied_alpha_box_;
   QLabel* colorspace_lbl_;
   QComboBox* colorspace_combobox_;
+  QLabel* hardware_decoding_lbl_;
+  QCheckBox* hardware_decoding_box_;
 
   ColorManager* color_manager_;
 
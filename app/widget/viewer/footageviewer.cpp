@@ -24,15 +24,23 @@
 #include <QMimeData>
 
 #include "config/config.h"
+#include "node/project/footage/footage.h"
 #include "node/project/project.h"
+#include "render/job/footagejob.h"
+#include "render/rendermanager.h"
 
 namespace olive {
 
 #define super ViewerWidget
 
+// In kilobytes, the same unit frames are costed in
+const int FootageViewerWidget::kSkimCacheSize = 131072;
+
 FootageViewerWidget::FootageViewerWidget(QWidget *parent) :
   super(parent)
 {
+  skim_cache_.setMaxCost(kSkimCacheSize);
+
   connect(display_widget(), &ViewerDisplayWidget::DragStarted, this, &FootageViewerWidget::StartFootageDrag);
 
   controls_->SetAudioVideoDragButtonsVisible(true);
@@ -44,11 +52,19 @@ void FootageViewerWidget::ConnectNodeEvent(ViewerOutput *n)
 {
   super::ConnectNodeEvent(n);
 
+  TimelineWorkArea* workarea = n->GetTimelinePoints()->workarea();
+  connect(workarea, &TimelineWorkArea::EnabledChanged, this, &FootageViewerWidget::WorkAreaChanged);
+  connect(workarea, &TimelineWorkArea::RangeChanged, this, &FootageViewerWidget::WorkAreaChanged);
+
   SetTimestamp(cached_timestamps_.value(n, 0));
 }
 
 void FootageViewerWidget::DisconnectNodeEvent(ViewerOutput *n)
 {
+  TimelineWorkArea* workarea = n->GetTimelinePoints()->workarea();
+  disconnect(workarea, &TimelineWorkArea::EnabledChanged, this, &FootageViewerWidget::WorkAreaChanged);
+  disconnect(workarea, &TimelineWorkArea::RangeChanged, this, &FootageViewerWidget::WorkAreaChanged);
+
   // Cache timestamp in case this footage is opened again later
   cached_timestamps_.insert(n, GetTimestamp());
   SetTimestamp(0);
@@ -56,6 +72,85 @@ void FootageViewerWidget::DisconnectNodeEvent(ViewerOutput *n)
   super::DisconnectNodeEvent(n);
 }
 
+void FootageViewerWidget::ConnectedNodeChangeEvent(ViewerOutput *n)
+{
+  // Footage is only skimmed until something needs the full pipeline, which in/out points already do
+  Footage* footage = dynamic_cast<Footage*>(n);
+  SetRenderPipelineDeferred(footage && !footage->GetTimelinePoints()->workarea()->enabled());
+
+  super::ConnectedNodeChangeEvent(n);
+}
+
+RenderTicketPtr FootageViewerWidget::GetPreviewFrame(const rational &time)
+{
+  Footage* footage = dynamic_cast<Footage*>(GetConnectedNode());
+  if (!footage) {
+    return nullptr;
+  }
+
+  FootageJob job = footage->GetVideoJob(0);
+  if (job.type() != Track::kVideo) {
+    return nullptr;
+  }
+
+  const VideoParams& vp = job.video_params();
+  int divider = GetSkimDivider(vp);
+
+  // Stills look the same at any time, so they only need decoding once
+  rational key_time = (vp.video_type() == VideoParams::kVideoTypeStill) ? rational(0) : time;
+
+  QString key = QStringLiteral("%1:%2:%3:%4:%5:%6").arg(job.filename(),
+                                                        QString::number(vp.stream_index()),
+                                                        vp.colorspace(),
+                                                        QString::number(job.loop_mode()),
+                                                        QString::number(divider),
+                                                        key_time.toString());
+
+  if (FramePtr* cached = skim_cache_.object(key)) {
+    RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+    ticket->setProperty("time", QVariant::fromValue(time));
+    ticket->Start();
+    ticket->Finish(QVariant::fromValue(*cached));
+    return ticket;
+  }
+
+  // Only the latest frame matters while skimming, so drop any that haven't started yet
+  foreach (RenderTicketWatcher* watcher, skim_watchers_) {
+    if (RenderManager::instance()->RemoveTicket(watcher->GetTicket())) {
+      watcher->GetTicket()->Finish();
+    }
+  }
+
+  RenderTicketPtr ticket = RenderManager::instance()->RenderFootagePreview(job, footage->project()->color_manager(),
+                                                                          time, divider);
+
+  RenderTicketWatcher* watcher = new RenderTicketWatcher(this);
+  watcher->setProperty("key", key);
+  connect(watcher, &RenderTicketWatcher::Finished, this, &FootageViewerWidget::SkimFrameFinished);
+  skim_watchers_.append(watcher);
+  watcher->SetTicket(ticket);
+
+  return ticket;
+}
+
+int FootageViewerWidget::GetSkimDivider(const VideoParams &params) const
+{
+  // The display letterboxes footage, so only one of its dimensions is ever filled
+  qreal dpr = display_widget()->devicePixelRatioF();
+  double shown_height = qMin(display_widget()->height() * dpr,
+                             display_widget()->width() * dpr * params.height() / params.square_pixel_width());
+
+  // Largest divider that still gives at least as many pixels as will be shown
+  int divider = 1;
+  foreach (int d, VideoParams::kSupportedDividers) {
+    if (VideoParams::GetScaledDimension(params.height(), d) >= shown_height) {
+      divider = d;
+    }
+  }
+
+  return divider;
+}
+
 void FootageViewerWidget::StartFootageDragInternal(bool enable_video, bool enable_audio)
 {
   if (!GetConnectedNode()) {
@@ -108,4 +203,23 @@ void FootageViewerWidget::StartAudioDrag()
   StartFootageDragInternal(false, true);
 }
 
+void FootageViewerWidget::SkimFrameFinished(RenderTicketWatcher *watcher)
+{
+  skim_watchers_.removeOne(watcher);
+
+  if (watcher->HasResult()) {
+    if (FramePtr frame = watcher->Get().value<FramePtr>()) {
+      skim_cache_.insert(watcher->property("key").toString(), new FramePtr(frame), qMax(1, frame->allocated_size() / 1024));
+    }
+  }
+
+  watcher->deleteLater();
+}
+
+void FootageViewerWidget::WorkAreaChanged()
+{
+  // Marking in/out is the start of using the footage rather than just looking through it
+  EnableRenderPipeline();
+}
+
 }
@@ -21,11 +21,21 @@
 #ifndef FOOTAGEVIEWERWIDGET_H
 #define FOOTAGEVIEWERWIDGET_H
 
+#include <QCache>
+
 #include "node/output/viewer/viewer.h"
 #include "viewer.h"
 
 namespace olive {
 
+/**
+ * @brief Viewer for previewing footage before it's used
+ *
+ * Footage is skimmed rather than rendered: frames shown while paused are decoded straight from the
+ * file at a size that fits the display, without the footage's graph being copied for an auto-cacher,
+ * and recently skimmed frames are kept so going back over them is instant. The full render pipeline
+ * only starts once the footage is played or in/out points are set.
+ */
 class FootageViewerWidget : public ViewerWidget
 {
   Q_OBJECT
@@ -37,11 +47,27 @@ protected:
 
   virtual void DisconnectNodeEvent(ViewerOutput *) override;
 
+  virtual void ConnectedNodeChangeEvent(ViewerOutput *) override;
+
+  virtual RenderTicketPtr GetPreviewFrame(const rational& time) override;
+
 private:
   void StartFootageDragInternal(bool enable_video, bool enable_audio);
 
+  /**
+   * @brief Largest divider that still fills the display at its current size
+   */
+  int GetSkimDivider(const VideoParams& params) const;
+
   QHash<ViewerOutput*, int64_t> cached_timestamps_;
 
+  /// Recently skimmed frames, keyed by the file, stream, time and divider they were decoded at
+  QCache<QString, FramePtr> skim_cache_;
+
+  QVector<RenderTicketWatcher*> skim_watchers_;
+
+  static const int kSkimCacheSize;
+
 private slots:
   void StartFootageDrag();
 
@@ -49,6 +75,10 @@ private slots:
 
   void StartAudioDrag();
 
+  void SkimFrameFinished(RenderTicketWatcher* watcher);
+
+  void WorkAreaChanged();
+
 };
 
 }
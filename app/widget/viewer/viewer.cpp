@@ -21,10 +21,13 @@
 #include "viewer.h"
 
 #include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileDialog>
 #include <QGuiApplication>
 #include <QInputDialog>
 #include <QLabel>
 #include <QMessageBox>
+#include <QMetaMethod>
 #include <QResizeEvent>
 #include <QScreen>
 #include <QtMath>
@@ -47,7 +50,20 @@ namespace olive {
 
 QVector<ViewerWidget*> ViewerWidget::instances_;
 
-const int kMaxPreQueueSize = 8;
+const double ViewerWidget::kMaximumRegionOfInterestArea = 0.5;
+const double ViewerWidget::kRegionOfInterestPadding = 0.25;
+const int ViewerWidget::kAdaptiveLateFrameThreshold = 3;
+const int ViewerWidget::kAdaptiveRecoverFrameCount = 60;
+const double ViewerWidget::kFastScrubSpeed = 4.0;
+const int ViewerWidget::kFastScrubInterval = 250;
+
+const rational ViewerWidget::kMinimumScrubSnippet = rational(20, 1000);
+
+const rational ViewerWidget::kMaximumScrubSnippet = rational(80, 1000);
+const int ViewerWidget::kScrubSettleInterval = 150;
+
+const int kMinPreQueueSize = 8;
+const int kMaxPreQueueSize = 32;
 
 ViewerWidget::ViewerWidget(QWidget *parent) :
   super(false, true, parent),
@@ -55,9 +71,24 @@ ViewerWidget::ViewerWidget(QWidget *parent) :
   frame_cache_job_time_(0),
   color_menu_enabled_(true),
   time_changed_from_timer_(false),
+  external_output_(nullptr),
   prequeuing_(false),
+  auto_cacher_(nullptr),
+  auto_cache_enabled_(Config::Current()[QStringLiteral("AutoCacheEnabled")].toBool()),
+  render_pipeline_deferred_(false),
   active_queue_jobs_(0),
-  cache_time_(rational::NaN)
+  cache_time_(rational::NaN),
+  average_decode_time_(0),
+  adaptive_playback_(false),
+  playback_degradation_(0),
+  playback_late_frames_(0),
+  playback_on_time_frames_(0),
+  scrub_interval_(-1),
+  scrubbing_fast_(false),
+  benchmarking_(false),
+  benchmark_start_(0),
+  benchmark_end_(0),
+  benchmark_upload_start_(-1)
 {
   // Set up main layout
   QVBoxLayout* layout = new QVBoxLayout(this);
@@ -84,6 +115,8 @@ ViewerWidget::ViewerWidget(QWidget *parent) :
   connect(display_widget_, &ViewerDisplayWidget::TextureChanged, this, &ViewerWidget::TextureChanged);
   connect(sizer_, &ViewerSizer::RequestScale, display_widget_, &ViewerDisplayWidget::SetMatrixZoom);
   connect(sizer_, &ViewerSizer::RequestTranslate, display_widget_, &ViewerDisplayWidget::SetMatrixTranslate);
+  connect(sizer_, &ViewerSizer::RequestScale, this, &ViewerWidget::ViewportChanged);
+  connect(sizer_, &ViewerSizer::RequestTranslate, this, &ViewerWidget::ViewportChanged);
   connect(display_widget_, &ViewerDisplayWidget::HandDragMoved, sizer_, &ViewerSizer::HandDragMove);
   sizer_->SetWidget(display_widget_);
 
@@ -118,6 +151,11 @@ ViewerWidget::ViewerWidget(QWidget *parent) :
   audio_restart_timer_.setSingleShot(true);
   connect(&audio_restart_timer_, &QTimer::timeout, this, &ViewerWidget::StartAudioOutput);
 
+  // Once fast scrubbing stops, replace the keyframe shown with the exact frame
+  scrub_settle_timer_.setInterval(kScrubSettleInterval);
+  scrub_settle_timer_.setSingleShot(true);
+  connect(&scrub_settle_timer_, &QTimer::timeout, this, &ViewerWidget::ScrubSettled);
+
   // FIXME: Magic number
   SetScale(48.0);
 
@@ -138,11 +176,18 @@ ViewerWidget::~ViewerWidget()
 {
   instances_.removeOne(this);
 
+  if (auto_cacher_) {
+    PreviewAutoCacher::Unsubscribe(auto_cacher_, this);
+    auto_cacher_ = nullptr;
+  }
+
   auto windows = windows_;
 
   foreach (ViewerWindow* window, windows) {
     delete window;
   }
+
+  SetExternalOutput(nullptr);
 }
 
 void ViewerWidget::TimeChangedEvent(const int64_t &i)
@@ -170,6 +215,8 @@ void ViewerWidget::TimeChangedEvent(const int64_t &i)
     rational time_set = Timecode::timestamp_to_time(i, timebase());
 
     if (!IsPlaying()) {
+      UpdateScrubSpeed(Timecode::timestamp_to_time(last_time_, timebase()), time_set);
+
       UpdateTextureFromNode();
 
       PushScrubbedAudio();
@@ -252,6 +299,8 @@ void ViewerWidget::DisconnectNodeEvent(ViewerOutput *n)
 
   ruler()->SetPlaybackCache(nullptr);
 
+  scrub_audio_.Clear();
+
   // Effectively disables the viewer and clears the state
   SetViewerResolution(0, 0);
 
@@ -269,8 +318,24 @@ void ViewerWidget::DisconnectNodeEvent(ViewerOutput *n)
 
 void ViewerWidget::ConnectedNodeChangeEvent(ViewerOutput *n)
 {
-  auto_cacher_.SetViewerNode(n);
+  if (auto_cacher_) {
+    PreviewAutoCacher::Unsubscribe(auto_cacher_, this);
+  }
+
+  auto_cacher_ = (n && !render_pipeline_deferred_) ? PreviewAutoCacher::Subscribe(n, this, !auto_cache_enabled_) : nullptr;
+  cache_time_ = rational::NaN;
+}
+
+void ViewerWidget::EnableRenderPipeline()
+{
+  if (auto_cacher_ || !GetConnectedNode()) {
+    return;
+  }
+
+  auto_cacher_ = PreviewAutoCacher::Subscribe(GetConnectedNode(), this, !auto_cache_enabled_);
   cache_time_ = rational::NaN;
+
+  UpdateAutoCacher();
 }
 
 void ViewerWidget::ScaleChangedEvent(const double &s)
@@ -301,6 +366,17 @@ bool ViewerWidget::IsPlaying() const
   return playback_speed_ != 0;
 }
 
+bool ViewerWidget::IsAnyViewerPlaying()
+{
+  foreach (ViewerWidget* viewer, instances_) {
+    if (viewer->IsPlaying()) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 void ViewerWidget::SetColorMenuEnabled(bool enabled)
 {
   color_menu_enabled_ = enabled;
@@ -355,9 +431,47 @@ void ViewerWidget::SetFullScreen(QScreen *screen)
   windows_.insert(screen, vw);
 }
 
+void ViewerWidget::SetExternalOutput(ExternalVideoSink *sink)
+{
+  if (external_output_) {
+    // The sink may still be blocked on its device, so let the thread clean itself up rather than
+    // waiting for it here
+    disconnect(display_widget_, &ViewerDisplayWidget::ColorProcessorChanged, external_output_, &ViewerExternalOutput::SetColorProcessor);
+    external_output_->setParent(nullptr);
+    connect(external_output_, &ViewerExternalOutput::finished, external_output_, &ViewerExternalOutput::deleteLater);
+    external_output_->Stop();
+    external_output_ = nullptr;
+  }
+
+  if (!sink) {
+    return;
+  }
+
+  external_output_ = new ViewerExternalOutput(sink, this);
+
+  if (color_manager()) {
+    try {
+      external_output_->SetColorProcessor(ColorProcessor::Create(color_manager(),
+                                                                 color_manager()->GetReferenceColorSpace(),
+                                                                 display_widget_->GetColorTransform()));
+    } catch (OCIO::Exception& e) {
+      qWarning() << "Failed to create color processor for external output:" << e.what();
+    }
+  }
+
+  connect(display_widget_, &ViewerDisplayWidget::ColorProcessorChanged, external_output_, &ViewerExternalOutput::SetColorProcessor, Qt::DirectConnection);
+
+  external_output_->start();
+  external_output_->Push(QVariant::fromValue(display_widget_->GetCurrentTexture()));
+}
+
 void ViewerWidget::SetAutoCacheEnabled(bool e)
 {
-  auto_cacher_.SetPaused(!e);
+  auto_cache_enabled_ = e;
+
+  if (auto_cacher_) {
+    auto_cacher_->SetPaused(this, !e);
+  }
 
   if (e) {
     // Enable auto-cache
@@ -370,13 +484,19 @@ void ViewerWidget::SetAutoCacheEnabled(bool e)
 
 void ViewerWidget::CacheEntireSequence()
 {
-  auto_cacher_.ForceCacheRange(TimeRange(0, GetConnectedNode()->GetVideoLength()));
+  EnableRenderPipeline();
+
+  if (auto_cacher_) {
+    auto_cacher_->ForceCacheRange(TimeRange(0, GetConnectedNode()->GetVideoLength()));
+  }
 }
 
 void ViewerWidget::CacheSequenceInOut()
 {
-  if (GetConnectedNode() && GetConnectedNode()->GetTimelinePoints()->workarea()->enabled()) {
-    auto_cacher_.ForceCacheRange(GetConnectedNode()->GetTimelinePoints()->workarea()->range());
+  EnableRenderPipeline();
+
+  if (auto_cacher_ && GetConnectedNode()->GetTimelinePoints()->workarea()->enabled()) {
+    auto_cacher_->ForceCacheRange(GetConnectedNode()->GetTimelinePoints()->workarea()->range());
   } else {
     QMessageBox::warning(this,
                          tr("Error"),
@@ -391,6 +511,45 @@ void ViewerWidget::SetGizmos(Node *node)
   display_widget_->SetGizmos(node);
 }
 
+bool ViewerWidget::StartPlaybackBenchmark(const TimeRange &range)
+{
+  if (!GetConnectedNode() || timebase().isNull()) {
+    return false;
+  }
+
+  rational length = GetConnectedNode()->GetVideoLength();
+  TimeRange play_range = TimeRange(0, length);
+
+  if (range.length() > 0) {
+    if (!play_range.OverlapsWith(range, false, false)) {
+      return false;
+    }
+
+    play_range = play_range.Intersected(range);
+  }
+
+  if (play_range.length() <= 0) {
+    return false;
+  }
+
+  PauseInternal();
+
+  benchmark_start_ = Timecode::time_to_timestamp(play_range.in(), timebase());
+  benchmark_end_ = Timecode::time_to_timestamp(play_range.out(), timebase());
+
+  // Set the time first since that pauses, which would end the benchmark
+  SetTimeAndSignal(benchmark_start_);
+
+  benchmarking_ = true;
+  benchmark_last_shown_ = rational::NaN;
+  benchmark_upload_start_ = -1;
+  benchmark_stats_.Start();
+
+  PlayInternal(1, false);
+
+  return true;
+}
+
 FramePtr ViewerWidget::DecodeCachedImage(const QString &cache_path, const QByteArray& hash, const rational& time)
 {
   FramePtr frame = FrameHashCache::LoadCacheFrame(cache_path, hash);
@@ -407,7 +566,30 @@ FramePtr ViewerWidget::DecodeCachedImage(const QString &cache_path, const QByteA
 void ViewerWidget::DecodeCachedImage(RenderTicketPtr ticket, const QString &cache_path, const QByteArray& hash, const rational& time)
 {
   ticket->Start();
-  ticket->Finish(QVariant::fromValue(DecodeCachedImage(cache_path, hash, time)));
+
+  QElapsedTimer timer;
+  timer.start();
+
+  FramePtr frame = DecodeCachedImage(cache_path, hash, time);
+
+  // Lets playback work out how far ahead it needs to decode
+  ticket->setProperty("decode_time", timer.nsecsElapsed());
+
+  ticket->Finish(QVariant::fromValue(frame));
+}
+
+QThreadPool *ViewerWidget::GetPlaybackDecodeThreadPool()
+{
+  // Cached frames are decoded on their own threads so playback isn't stuck waiting behind
+  // background work on the global pool
+  static QThreadPool pool;
+  static const bool initialized = [](){
+    pool.setMaxThreadCount(QThread::idealThreadCount());
+    return true;
+  }();
+  Q_UNUSED(initialized)
+
+  return &pool;
 }
 
 bool ViewerWidget::ShouldForceWaveform() const
@@ -430,20 +612,22 @@ void ViewerWidget::UpdateAutoCacher()
 {
   rational time = GetTime();
 
-  if (GetConnectedNode()              // Ensure valid node
+  if (auto_cacher_                    // Ensure valid node
       && cache_time_ != time          // Ensure cache hasn't already been to this time
-      && !auto_cacher_.IsPaused()) {  // Follow cache setting
+      && auto_cache_enabled_) {       // Follow cache setting
     if (!IsPlaying()) {
       ClearAutoCacherQueue();
     }
-    auto_cacher_.SetPlayhead(time);
+    auto_cacher_->SetPlayhead(this, time);
     cache_time_ = time;
   }
 }
 
 void ViewerWidget::ClearAutoCacherQueue()
 {
-  auto_cacher_.ClearVideoQueue();
+  if (auto_cacher_) {
+    auto_cacher_->ClearSubscriberQueue(this);
+  }
   cache_time_ = rational::NaN;
 }
 
@@ -456,7 +640,17 @@ void ViewerWidget::StartAudioOutput()
                                           audio_cache->GetParameters().time_to_bytes(GetTime()),
                                           playback_speed_);
     emit AudioManager::instance()->OutputWaveformStarted(&audio_cache->visual(),
+                                                         &audio_cache->levels(),
                                                          GetTime(), playback_speed_);
+
+    if (IsPlaying()) {
+      // Video follows the audio clock from here so the two can't drift apart
+      playback_timer_.FollowAudio(GetTimestamp());
+
+      foreach (ViewerWindow* window, windows_) {
+        window->FollowAudio(GetTimestamp());
+      }
+    }
   }
 }
 
@@ -488,6 +682,12 @@ void ViewerWidget::UpdateTextureFromNode()
 
           // Frame was in queue, no need to decode anything
           SetDisplayImage(pf.frame, true);
+
+          if (benchmarking_ && benchmark_last_shown_ != time) {
+            benchmark_stats_.FrameShown();
+            benchmark_upload_start_ = benchmark_stats_.Now();
+            benchmark_last_shown_ = time;
+          }
           return;
 
         } else {
@@ -497,6 +697,7 @@ void ViewerWidget::UpdateTextureFromNode()
           if (popped) {
             // We've already popped a frame in this loop, meaning a frame has been skipped
             display_widget_->IncrementSkippedFrames();
+            UpdatePlaybackDegradation(true);
           } else {
             // Shown a frame and progressed to the next one
             display_widget_->IncrementFrameCount();
@@ -517,6 +718,9 @@ void ViewerWidget::UpdateTextureFromNode()
     // Only show warning if frame actually exists
     if (frame_exists_at_time && !frame_might_be_still) {
       qWarning() << "Playback queue failed to keep up";
+
+      // Nothing was ready for this vsync, which is as late as a frame can be
+      UpdatePlaybackDegradation(true);
     }
 
   }
@@ -533,7 +737,7 @@ void ViewerWidget::UpdateTextureFromNode()
       watcher->setProperty("time", QVariant::fromValue(time));
       connect(watcher, &RenderTicketWatcher::Finished, this, &ViewerWidget::RendererGeneratedFrame);
       nonqueue_watchers_.append(watcher);
-      watcher->SetTicket(GetFrame(time, true));
+      watcher->SetTicket(GetFrame(time, true, nullptr, GetRegionOfInterest(), scrubbing_fast_));
     }
   } else {
     // There is definitely no frame here, we can immediately flip to showing nothing
@@ -557,6 +761,9 @@ void ViewerWidget::PlayInternal(int speed, bool in_to_out_only)
     return;
   }
 
+  // Playback needs the auto-cacher for frames ahead of the playhead and for audio
+  EnableRenderPipeline();
+
   // Kindly tell all viewers to stop playing and caching so all resources can be used for playback
   foreach (ViewerWidget* viewer, instances_) {
     if (viewer != this) {
@@ -577,6 +784,15 @@ void ViewerWidget::PlayInternal(int speed, bool in_to_out_only)
   playback_speed_ = speed;
   play_in_to_out_only_ = in_to_out_only;
 
+  // Playback frames are always exact
+  scrubbing_fast_ = false;
+  scrub_settle_timer_.stop();
+
+  adaptive_playback_ = Config::Current()[QStringLiteral("AdaptivePlaybackResolution")].toBool();
+  playback_degradation_ = 0;
+  playback_late_frames_ = 0;
+  playback_on_time_frames_ = 0;
+
   playback_queue_next_frame_ = ruler()->GetTime();
 
   controls_->ShowPauseButton();
@@ -610,12 +826,24 @@ void ViewerWidget::PlayInternal(int speed, bool in_to_out_only)
 
 void ViewerWidget::PauseInternal()
 {
+  if (benchmarking_) {
+    benchmarking_ = false;
+
+    int64_t elapsed = 0;
+    if (IsPlaying() && !prequeuing_) {
+      elapsed = qMin(playback_timer_.GetTimestampNow(), benchmark_end_) - benchmark_start_;
+    }
+    benchmark_stats_.Finish(elapsed);
+
+    emit PlaybackBenchmarkFinished(benchmark_stats_.ToJson());
+  }
+
   if (IsPlaying()) {
     AudioManager::instance()->StopOutput();
     playback_speed_ = 0;
     controls_->ShowPlayButton();
 
-    disconnect(display_widget_, &ViewerDisplayWidget::frameSwapped, this, &ViewerWidget::PlaybackTimerUpdate);
+    disconnect(display_widget_, &ViewerDisplayWidget::frameSwapped, this, &ViewerWidget::PlaybackFrameSwapped);
 
     foreach (ViewerWindow* window, windows_) {
       window->Pause();
@@ -625,6 +853,9 @@ void ViewerWidget::PauseInternal()
     playback_backup_timer_.stop();
     audio_restart_timer_.stop();
 
+    // Paused frames are always rendered at full quality
+    playback_degradation_ = 0;
+
     UpdateTextureFromNode();
   }
 
@@ -633,27 +864,20 @@ void ViewerWidget::PauseInternal()
 
 void ViewerWidget::PushScrubbedAudio()
 {
-  if (!IsPlaying() && GetConnectedNode() && Config::Current()["AudioScrubbing"].toBool()) {
-    // Get audio src device from renderer
-    const AudioParams& params = GetConnectedNode()->audio_playback_cache()->GetParameters();
-
-    if (params.is_valid()) {
-      AudioPlaybackCache::PlaybackDevice* audio_src = GetConnectedNode()->audio_playback_cache()->CreatePlaybackDevice();
+  if (!IsPlaying() && GetConnectedNode() && Config::kAudioScrubbing.Get()) {
+    // Slow scrubs play until the next time change is likely to arrive so they sound continuous,
+    // fast ones stay short so what's heard doesn't lag behind the playhead
+    rational length = kMinimumScrubSnippet;
 
-      if (audio_src->open(QIODevice::ReadOnly)) {
-        // FIXME: Hardcoded scrubbing interval (20ms)
-        int size_of_sample = params.time_to_bytes(rational(20, 1000));
-
-        // Push audio
-        audio_src->seek(params.time_to_bytes(GetTime()));
-        QByteArray frame_audio = audio_src->read(size_of_sample);
-        AudioManager::instance()->SetOutputParams(params);
-        AudioManager::instance()->PushToOutput(frame_audio);
+    if (scrub_interval_ > 0 && !scrubbing_fast_) {
+      length = qBound(kMinimumScrubSnippet, rational(scrub_interval_, 1000), kMaximumScrubSnippet);
+    }
 
-        audio_src->close();
-      }
+    QByteArray frame_audio = scrub_audio_.GetSnippet(GetConnectedNode(), GetTime(), length);
 
-      delete audio_src;
+    if (!frame_audio.isEmpty()) {
+      AudioManager::instance()->SetOutputParams(GetConnectedNode()->audio_playback_cache()->GetParameters());
+      AudioManager::instance()->PushToOutput(frame_audio);
     }
   }
 }
@@ -702,12 +926,18 @@ bool ViewerWidget::ViewerMightBeAStill()
 
 void ViewerWidget::SetDisplayImage(QVariant frame, bool main_only)
 {
+  displayed_roi_ = QRectF();
+
   display_widget_->SetImage(frame);
 
   if (!main_only) {
     foreach (ViewerWindow* vw, windows_) {
       vw->display_widget()->SetImage(frame);
     }
+
+    if (external_output_) {
+      external_output_->Push(frame);
+    }
   }
 }
 
@@ -724,44 +954,153 @@ void ViewerWidget::RequestNextFrameForQueue(bool prioritize, bool increment)
     RenderTicketWatcher* watcher = new RenderTicketWatcher();
     watcher->setProperty("time", QVariant::fromValue(next_time));
     connect(watcher, &RenderTicketWatcher::Finished, this, &ViewerWidget::RendererGeneratedFrameForQueue);
-    watcher->SetTicket(GetFrame(next_time, prioritize));
+
+    if (benchmarking_) {
+      ViewerPlaybackStats::FrameSource source;
+      watcher->setProperty("request_time", benchmark_stats_.Now());
+      watcher->SetTicket(GetFrame(next_time, prioritize, &source));
+      watcher->setProperty("source", source);
+      benchmark_stats_.FrameRequested(source);
+    } else {
+      watcher->SetTicket(GetFrame(next_time, prioritize));
+    }
+
     active_queue_jobs_++;
   }
 }
 
-RenderTicketPtr ViewerWidget::GetFrame(const rational &t, bool prioritize)
+RenderTicketPtr ViewerWidget::GetFrame(const rational &t, bool prioritize, ViewerPlaybackStats::FrameSource *source, const QRectF &roi, bool keyframes_only)
 {
   QByteArray cached_hash = GetConnectedNode()->video_frame_cache()->GetHash(t);
 
-  QString cache_fn = GetConnectedNode()->video_frame_cache()->CachePathName(cached_hash);
+  if (!cached_hash.isEmpty()) {
+    // Check if this frame is still resident on the GPU, which saves loading it from disk
+    if (TexturePtr texture = RenderManager::instance()->texture_cache()->Get(cached_hash)) {
+      if (source) {
+        *source = ViewerPlaybackStats::kSourceTextureCache;
+      }
 
-  if (cached_hash.isEmpty() || !QFileInfo::exists(cache_fn)) {
+      RenderTicketPtr ticket = std::make_shared<RenderTicket>();
+      ticket->setProperty("time", QVariant::fromValue(t));
+      ticket->Start();
+      ticket->Finish(QVariant::fromValue(texture));
+      return ticket;
+    }
+  }
+
+  if (cached_hash.isEmpty() || !GetConnectedNode()->video_frame_cache()->CacheFrameExists(cached_hash)) {
     // Frame hasn't been cached, start render job
-    return auto_cacher_.GetSingleFrame(t, prioritize);
+    if (source) {
+      *source = ViewerPlaybackStats::kSourceRender;
+    }
+
+    if (!auto_cacher_) {
+      if (RenderTicketPtr preview = GetPreviewFrame(t)) {
+        return preview;
+      }
+
+      EnableRenderPipeline();
+    }
+
+    return auto_cacher_->GetSingleFrame(this, t, prioritize, roi, IsPlaying() ? GetPlaybackDivider() : 0, keyframes_only);
   } else {
     // Frame has been cached, grab the frame
+    if (source) {
+      *source = ViewerPlaybackStats::kSourceDiskCache;
+    }
+
     RenderTicketPtr ticket = std::make_shared<RenderTicket>();
     ticket->setProperty("time", QVariant::fromValue(t));
-    QtConcurrent::run(ViewerWidget::DecodeCachedImage, ticket, GetConnectedNode()->video_frame_cache()->GetCacheDirectory(), cached_hash, t);
+    QtConcurrent::run(GetPlaybackDecodeThreadPool(), ViewerWidget::DecodeCachedImage, ticket, GetConnectedNode()->video_frame_cache()->GetCacheDirectory(), cached_hash, t);
     return ticket;
   }
 }
 
+int ViewerWidget::GetPlaybackDivider() const
+{
+  if (!playback_degradation_ || !GetConnectedNode()) {
+    return 0;
+  }
+
+  const QVector<int>& dividers = VideoParams::kSupportedDividers;
+  int index = qMax(0, dividers.indexOf(GetConnectedNode()->GetVideoParams().divider()));
+  return dividers.at(qMin(index + playback_degradation_, dividers.size() - 1));
+}
+
+void ViewerWidget::UpdatePlaybackDegradation(bool late)
+{
+  if (!adaptive_playback_) {
+    return;
+  }
+
+  if (late) {
+    playback_on_time_frames_ = 0;
+    playback_late_frames_++;
+
+    if (playback_late_frames_ >= kAdaptiveLateFrameThreshold
+        && GetPlaybackDivider() < VideoParams::kSupportedDividers.last()) {
+      playback_degradation_++;
+      playback_late_frames_ = 0;
+    }
+  } else {
+    playback_late_frames_ = 0;
+
+    // Only try a higher quality once the queue has been comfortably full for a while
+    if (playback_degradation_ > 0 && int(playback_queue_.size()) >= DeterminePlaybackQueueSize()) {
+      playback_on_time_frames_++;
+
+      if (playback_on_time_frames_ >= kAdaptiveRecoverFrameCount) {
+        playback_degradation_--;
+        playback_on_time_frames_ = 0;
+      }
+    }
+  }
+}
+
+void ViewerWidget::SetAdaptivePlaybackEnabled(bool e)
+{
+  Config::Current().Set(QStringLiteral("AdaptivePlaybackResolution"), e);
+}
+
+QRectF ViewerWidget::GetRegionOfInterest()
+{
+  if (!windows_.isEmpty() || isSignalConnected(QMetaMethod::fromSignal(&ViewerWidget::TextureChanged))) {
+    return QRectF();
+  }
+
+  QRectF visible = display_widget_->GetVisibleFrameRect();
+  if (visible.isEmpty() || visible.width() * visible.height() > kMaximumRegionOfInterestArea) {
+    // Not zoomed in enough to be worth a partial frame that can't be cached
+    return QRectF();
+  }
+
+  // Pad the region so small pans don't need a new render
+  qreal pad_x = visible.width() * kRegionOfInterestPadding;
+  qreal pad_y = visible.height() * kRegionOfInterestPadding;
+  return visible.adjusted(-pad_x, -pad_y, pad_x, pad_y) & QRectF(0, 0, 1, 1);
+}
+
 void ViewerWidget::FinishPlayPreprocess()
 {
   int64_t playback_start_time = ruler()->GetTime();
 
-  StartAudioOutput();
-
   playback_timer_.Start(playback_start_time, playback_speed_, timebase_dbl());
+  playback_timer_.SetRefreshRate(display_widget_->GetRefreshRate());
   display_widget_->ResetFPSTimer();
 
+  if (benchmarking_) {
+    benchmark_stats_.PlaybackStarted();
+  }
+
   foreach (ViewerWindow* window, windows_) {
     window->Play(playback_start_time, playback_speed_, timebase());
   }
 
+  // Started after the timers so they can follow it
+  StartAudioOutput();
+
   if (display_widget_->isVisible()) {
-    connect(display_widget_, &ViewerDisplayWidget::frameSwapped, this, &ViewerWidget::PlaybackTimerUpdate);
+    connect(display_widget_, &ViewerDisplayWidget::frameSwapped, this, &ViewerWidget::PlaybackFrameSwapped);
   } else {
     playback_backup_timer_.setInterval(qFloor(timebase_dbl()));
     playback_backup_timer_.start();
@@ -783,7 +1122,17 @@ int ViewerWidget::DeterminePlaybackQueueSize()
 
   int remaining_frames = (end_ts - GetTimestamp()) / playback_speed_;
 
-  return qMin(kMaxPreQueueSize, remaining_frames);
+  int queue_size = kMinPreQueueSize;
+
+  if (average_decode_time_ > 0) {
+    // Frames are decoded in parallel, so to keep up with playback we need as many in flight as it
+    // takes one of them to decode, doubled to ride out the occasional slower frame
+    double frame_duration = timebase_dbl() * 1000000000.0 / qAbs(playback_speed_);
+
+    queue_size = qMax(queue_size, qCeil(average_decode_time_ / frame_duration) * 2);
+  }
+
+  return qMin(qMin(kMaxPreQueueSize, queue_size), remaining_frames);
 }
 
 void ViewerWidget::PopOldestFrameFromPlaybackQueue()
@@ -822,6 +1171,25 @@ void ViewerWidget::ContextMenuSetFullScreen(QAction *action)
   SetFullScreen(QGuiApplication::screens().at(action->data().toInt()));
 }
 
+void ViewerWidget::ContextMenuSetExternalOutput(bool e)
+{
+  if (!e) {
+    SetExternalOutput(nullptr);
+    return;
+  }
+
+  QString filename = QFileDialog::getSaveFileName(this,
+                                                  tr("External Output"),
+                                                  QString(),
+                                                  QString(),
+                                                  nullptr,
+                                                  QFileDialog::DontConfirmOverwrite);
+
+  if (!filename.isEmpty()) {
+    SetExternalOutput(new RawPipeVideoSink(filename));
+  }
+}
+
 void ViewerWidget::ContextMenuDisableSafeMargins()
 {
   context_menu_widget_->SetSafeMargins(ViewerSafeMarginInfo(false));
@@ -868,12 +1236,59 @@ void ViewerWidget::RendererGeneratedFrame()
       }
 
       SetDisplayImage(ticket->Get());
+      displayed_roi_ = ticket->GetTicket()->property("roi").toRectF();
+
+      if (ticket->GetTicket()->property("keyframesonly").toBool()) {
+        scrub_settle_timer_.start();
+      }
     }
   }
 
   delete ticket;
 }
 
+void ViewerWidget::ScrubSettled()
+{
+  scrubbing_fast_ = false;
+
+  if (!IsPlaying()) {
+    UpdateTextureFromNode();
+  }
+}
+
+void ViewerWidget::UpdateScrubSpeed(const rational &from, const rational &to)
+{
+  // Time changes further apart than this are separate seeks rather than one scrub
+  bool continuous = scrub_timer_.isValid() && scrub_timer_.elapsed() < kFastScrubInterval;
+
+  scrub_interval_ = continuous ? scrub_timer_.elapsed() : -1;
+
+  if (continuous) {
+    double elapsed = qMax(qint64(1), scrub_timer_.elapsed()) * 0.001;
+    double distance = qAbs((to - from).toDouble());
+
+    scrubbing_fast_ = (distance / elapsed) > kFastScrubSpeed;
+  } else {
+    scrubbing_fast_ = false;
+  }
+
+  if (scrubbing_fast_) {
+    // Hold the exact frame back until the playhead has stopped
+    scrub_settle_timer_.stop();
+  }
+
+  scrub_timer_.start();
+}
+
+void ViewerWidget::ViewportChanged()
+{
+  // Re-render if the view has moved off the part of the frame that was rendered
+  if (!displayed_roi_.isNull() && !IsPlaying()
+      && !displayed_roi_.contains(display_widget_->GetVisibleFrameRect())) {
+    UpdateTextureFromNode();
+  }
+}
+
 void ViewerWidget::RendererGeneratedFrameForQueue()
 {
   RenderTicketWatcher* watcher = static_cast<RenderTicketWatcher*>(sender());
@@ -881,10 +1296,31 @@ void ViewerWidget::RendererGeneratedFrameForQueue()
   if (watcher->HasResult()) {
     QVariant frame = watcher->Get();
 
+    QVariant decode_time = watcher->GetTicket()->property("decode_time");
+    if (decode_time.isValid()) {
+      // Smooth so a single slow frame doesn't balloon the queue
+      qint64 t = decode_time.toLongLong();
+      average_decode_time_ = (average_decode_time_ > 0) ? average_decode_time_ * 0.8 + t * 0.2 : t;
+    }
+
     // Ignore this signal if we've paused now
     if (IsPlaying() || prequeuing_) {
       rational ts = watcher->property("time").value<rational>();
 
+      // Frames arriving during prequeuing can't be late since nothing is being shown yet
+      bool late = !prequeuing_ && ((playback_speed_ > 0) ? ts < GetTime() : ts > GetTime());
+
+      if (!prequeuing_) {
+        UpdatePlaybackDegradation(late);
+      }
+
+      if (benchmarking_ && watcher->property("request_time").isValid()) {
+        benchmark_stats_.FrameArrived(static_cast<ViewerPlaybackStats::FrameSource>(watcher->property("source").toInt()),
+                                      benchmark_stats_.Now() - watcher->property("request_time").toLongLong(),
+                                      decode_time.isValid() ? decode_time.toLongLong() : -1,
+                                      late);
+      }
+
       playback_queue_.AppendTimewise({ts, frame}, playback_speed_);
 
       foreach (ViewerWindow* window, windows_) {
@@ -967,6 +1403,11 @@ void ViewerWidget::ShowContextMenu(const QPoint &pos)
       }
 
       connect(full_screen_menu, &QMenu::triggered, this, &ViewerWidget::ContextMenuSetFullScreen);
+
+      QAction* external_action = menu.addAction(tr("External Output to Pipe..."));
+      external_action->setCheckable(true);
+      external_action->setChecked(external_output_ != nullptr);
+      connect(external_action, &QAction::triggered, this, &ViewerWidget::ContextMenuSetExternalOutput);
     }
 
     {
@@ -1003,7 +1444,7 @@ void ViewerWidget::ShowContextMenu(const QPoint &pos)
       // Auto-cache
       QAction* autocache_action = cache_menu->addAction(tr("Auto-Cache"));
       autocache_action->setCheckable(true);
-      autocache_action->setChecked(!auto_cacher_.IsPaused());
+      autocache_action->setChecked(auto_cache_enabled_);
       connect(autocache_action, &QAction::triggered, this, &ViewerWidget::SetAutoCacheEnabled);
 
       cache_menu->addSeparator();
@@ -1051,6 +1492,13 @@ void ViewerWidget::ShowContextMenu(const QPoint &pos)
     connect(show_waveform_action, &QAction::triggered, this, &ViewerWidget::ManualSwitchToWaveform);
   }
 
+  {
+    QAction* adaptive_action = menu.addAction(tr("Adaptive Playback Resolution"));
+    adaptive_action->setCheckable(true);
+    adaptive_action->setChecked(Config::Current()[QStringLiteral("AdaptivePlaybackResolution")].toBool());
+    connect(adaptive_action, &QAction::triggered, this, &ViewerWidget::SetAdaptivePlaybackEnabled);
+  }
+
   {
     QAction* show_fps_action = menu.addAction(tr("Show FPS"));
     show_fps_action->setCheckable(true);
@@ -1151,14 +1599,35 @@ void ViewerWidget::TimebaseChangedEvent(const rational &timebase)
   LengthChangedSlot(GetConnectedNode() ? GetConnectedNode()->GetLength() : 0);
 }
 
+void ViewerWidget::PlaybackFrameSwapped()
+{
+  playback_timer_.FramePresented();
+
+  PlaybackTimerUpdate();
+}
+
 void ViewerWidget::PlaybackTimerUpdate()
 {
   int64_t current_time = playback_timer_.GetTimestampNow();
 
+  if (benchmarking_) {
+    // This is connected to frameSwapped, so whatever was given to the display is on screen now
+    if (benchmark_upload_start_ >= 0) {
+      benchmark_stats_.FrameUploaded(benchmark_stats_.Now() - benchmark_upload_start_);
+      benchmark_upload_start_ = -1;
+    }
+
+    if (current_time >= benchmark_end_) {
+      // Pausing reports the results
+      PauseInternal();
+      return;
+    }
+  }
+
   int64_t min_time, max_time;
 
   {
-    if ((play_in_to_out_only_ || Config::Current()["Loop"].toBool())
+    if ((play_in_to_out_only_ || Config::kLoop.Get())
         && GetConnectedNode()->GetTimelinePoints()->workarea()->enabled()) {
 
       // If "play in to out" is enabled or we're looping AND we have a workarea, only play the workarea
@@ -1186,7 +1655,7 @@ void ViewerWidget::PlaybackTimerUpdate()
       tripped_time = max_time;
     }
 
-    if (Config::Current()[QStringLiteral("Loop")].toBool()) {
+    if (Config::kLoop.Get()) {
 
       // If we're looping, jump to the other side of the workarea and continue
       int64_t opposing_time = (tripped_time == min_time) ? max_time : min_time;
@@ -1356,6 +1825,8 @@ void ViewerWidget::Dropped(QDropEvent *event)
 
 void ViewerWidget::AudioCacheInvalidated()
 {
+  scrub_audio_.Clear();
+
   if (IsPlaying()) {
     AudioManager::instance()->StopOutput();
   }
@@ -1363,6 +1834,9 @@ void ViewerWidget::AudioCacheInvalidated()
 
 void ViewerWidget::AudioCacheValidated()
 {
+  // Stored snippets may have been mixed without effects, the cache has the real thing now
+  scrub_audio_.Clear();
+
   if (IsPlaying()) {
     // This timer will restart audio
     AudioManager::instance()->StopOutput();
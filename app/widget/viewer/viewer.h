@@ -21,6 +21,7 @@
 #ifndef VIEWER_WIDGET_H
 #define VIEWER_WIDGET_H
 
+#include <QElapsedTimer>
 #include <QFile>
 #include <QLabel>
 #include <QPushButton>
@@ -35,8 +36,11 @@
 #include "render/previewautocacher.h"
 #include "threading/threadticketwatcher.h"
 #include "viewerdisplay.h"
+#include "viewerexternaloutput.h"
+#include "viewerplaybackstats.h"
 #include "viewerplaybacktimer.h"
 #include "viewerqueue.h"
+#include "viewerscrubaudio.h"
 #include "viewersizer.h"
 #include "viewerwindow.h"
 #include "widget/playbackcontrols/playbackcontrols.h"
@@ -63,6 +67,11 @@ public:
 
   bool IsPlaying() const;
 
+  /**
+   * @brief Whether any viewer is currently playing
+   */
+  static bool IsAnyViewerPlaying();
+
   /**
    * @brief Enable or disable the color management menu
    *
@@ -80,6 +89,13 @@ public:
    */
   void SetFullScreen(QScreen* screen = nullptr);
 
+  /**
+   * @brief Also send every frame this viewer displays to `sink`, taking ownership of it
+   *
+   * Replaces any sink that was already set. Set to nullptr to stop sending frames.
+   */
+  void SetExternalOutput(ExternalVideoSink* sink);
+
   ColorManager* color_manager() const
   {
     return display_widget_->color_manager();
@@ -87,6 +103,14 @@ public:
 
   void SetGizmos(Node* node);
 
+  /**
+   * @brief Play `range` through the regular playback path while measuring how well it keeps up
+   *
+   * PlaybackBenchmarkFinished() is emitted with the results once the range has played or playback
+   * is stopped. An empty range plays the whole sequence. Returns false if nothing can be played.
+   */
+  bool StartPlaybackBenchmark(const TimeRange& range);
+
 public slots:
   void Play(bool in_to_out_only);
 
@@ -147,6 +171,11 @@ signals:
    */
   void ColorManagerChanged(ColorManager* color_manager);
 
+  /**
+   * @brief Emitted with the measurements of a benchmark started with StartPlaybackBenchmark()
+   */
+  void PlaybackBenchmarkFinished(const QJsonObject& results);
+
 protected:
   virtual void TimebaseChangedEvent(const rational &) override;
   virtual void TimeChangedEvent(const int64_t &) override;
@@ -166,6 +195,37 @@ protected:
     return display_widget_;
   }
 
+  /**
+   * @brief Hold off on subscribing to the connected node's auto-cacher until it's needed
+   *
+   * Subscribing copies the node's graph, which is wasted on a node that's only glanced at. While
+   * deferred, frames shown while paused come from GetPreviewFrame() instead. Takes effect from the
+   * next node connected, and lasts until EnableRenderPipeline() is called for it, which playing or
+   * caching do too.
+   */
+  void SetRenderPipelineDeferred(bool e)
+  {
+    render_pipeline_deferred_ = e;
+  }
+
+  void EnableRenderPipeline();
+
+  bool IsRenderPipelineEnabled() const
+  {
+    return auto_cacher_;
+  }
+
+  /**
+   * @brief Frame to show at `time` while the render pipeline is deferred
+   *
+   * Returning nullptr enables the render pipeline and renders the frame through it instead.
+   */
+  virtual RenderTicketPtr GetPreviewFrame(const rational& time)
+  {
+    Q_UNUSED(time)
+    return nullptr;
+  }
+
 private:
   void UpdateTimeInternal(int64_t i);
 
@@ -189,7 +249,57 @@ private:
 
   void RequestNextFrameForQueue(bool prioritize = false, bool increment = true);
 
-  RenderTicketPtr GetFrame(const rational& t, bool prioritize);
+  RenderTicketPtr GetFrame(const rational& t, bool prioritize, ViewerPlaybackStats::FrameSource* source = nullptr, const QRectF& roi = QRectF(), bool keyframes_only = false);
+
+  /**
+   * @brief Track how fast the playhead is being scrubbed while paused
+   *
+   * Above kFastScrubSpeed, still frames are decoded from the nearest keyframe only, since exact
+   * frames from long-GOP footage can't keep up. The exact frame is rendered once scrubbing settles.
+   */
+  void UpdateScrubSpeed(const rational& from, const rational& to);
+
+  /**
+   * @brief Part of the frame worth rendering for the still frame display, or a null rect for all of it
+   *
+   * When zoomed in, there's no point shading pixels that are off-screen. Anything else showing this
+   * viewer's frames (scopes, other windows) needs all of it though.
+   */
+  QRectF GetRegionOfInterest();
+
+  /**
+   * @brief Divider to render playback frames at while degraded, or 0 for the sequence's own
+   */
+  int GetPlaybackDivider() const;
+
+  /**
+   * @brief Feed whether a frame made it in time to the adaptive playback quality controller
+   *
+   * Several late frames in a row step the render divider up, a long run of frames on time with a
+   * full queue steps it back down.
+   */
+  void UpdatePlaybackDegradation(bool late);
+
+  static const int kAdaptiveLateFrameThreshold;
+
+  static const int kAdaptiveRecoverFrameCount;
+
+  static const double kMaximumRegionOfInterestArea;
+
+  static const double kRegionOfInterestPadding;
+
+  static const double kFastScrubSpeed;
+
+  static const int kFastScrubInterval;
+
+  /**
+   * @brief Shortest and longest snippets of audio PushScrubbedAudio() plays
+   */
+  static const rational kMinimumScrubSnippet;
+
+  static const rational kMaximumScrubSnippet;
+
+  static const int kScrubSettleInterval;
 
   void FinishPlayPreprocess();
 
@@ -201,6 +311,8 @@ private:
 
   static void DecodeCachedImage(RenderTicketPtr ticket, const QString &cache_path, const QByteArray &hash, const rational& time);
 
+  static QThreadPool* GetPlaybackDecodeThreadPool();
+
   bool ShouldForceWaveform() const;
 
   void SetEmptyImage();
@@ -229,6 +341,8 @@ private:
 
   QHash<QScreen*, ViewerWindow*> windows_;
 
+  ViewerExternalOutput* external_output_;
+
   ViewerDisplayWidget* display_widget_;
 
   ViewerDisplayWidget* context_menu_widget_;
@@ -243,11 +357,21 @@ private:
 
   QList<RenderTicketWatcher*> nonqueue_watchers_;
 
+  /**
+   * @brief Region the currently displayed frame was rendered for, null if it's a complete frame
+   */
+  QRectF displayed_roi_;
+
   rational last_length_;
 
   int prequeue_length_;
 
-  PreviewAutoCacher auto_cacher_;
+  // Shared with every other viewer showing the same sequence
+  PreviewAutoCacher* auto_cacher_;
+
+  bool auto_cache_enabled_;
+
+  bool render_pipeline_deferred_;
 
   QTimer audio_restart_timer_;
 
@@ -255,9 +379,42 @@ private:
 
   rational cache_time_;
 
+  /// Smoothed time it takes to decode a cached frame for playback, in nanoseconds
+  double average_decode_time_;
+
+  /// Whether playback may lower render quality to hold real time ("AdaptivePlaybackResolution")
+  bool adaptive_playback_;
+
+  /// How many divider steps below the sequence's own playback renders currently are
+  int playback_degradation_;
+  int playback_late_frames_;
+  int playback_on_time_frames_;
+
+  /// Measures the wall time between paused time changes for UpdateScrubSpeed()
+  QElapsedTimer scrub_timer_;
+
+  /// Milliseconds between the last two time changes of a continuous scrub, or -1
+  qint64 scrub_interval_;
+
+  bool scrubbing_fast_;
+  QTimer scrub_settle_timer_;
+
+  ViewerScrubAudio scrub_audio_;
+
+  bool benchmarking_;
+  int64_t benchmark_start_;
+  int64_t benchmark_end_;
+  rational benchmark_last_shown_;
+  ViewerPlaybackStats benchmark_stats_;
+
+  /// Time the last queued frame was given to the display, or -1 if it's been swapped already
+  qint64 benchmark_upload_start_;
+
   static QVector<ViewerWidget*> instances_;
 
 private slots:
+  void PlaybackFrameSwapped();
+
   void PlaybackTimerUpdate();
 
   void LengthChangedSlot(const rational& length);
@@ -278,6 +435,8 @@ private slots:
 
   void ContextMenuSetFullScreen(QAction* action);
 
+  void ContextMenuSetExternalOutput(bool e);
+
   void ContextMenuDisableSafeMargins();
 
   void ContextMenuSetSafeMargins();
@@ -290,6 +449,12 @@ private slots:
 
   void RendererGeneratedFrame();
 
+  void ScrubSettled();
+
+  void ViewportChanged();
+
+  void SetAdaptivePlaybackEnabled(bool e);
+
   void RendererGeneratedFrameForQueue();
 
   void ViewerInvalidatedVideoRange(const olive::TimeRange &range);
@@ -22,12 +22,15 @@
 
 #include <OpenImageIO/imagebuf.h>
 #include <QFileInfo>
+#include <QGuiApplication>
 #include <QMessageBox>
 #include <QMouseEvent>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
 #include <QOpenGLTexture>
 #include <QPainter>
+#include <QScreen>
+#include <QWindow>
 
 #include "common/define.h"
 #include "common/functiontimer.h"
@@ -43,6 +46,7 @@ ViewerDisplayWidget::ViewerDisplayWidget(QWidget *parent) :
   super(parent),
   deinterlace_texture_(nullptr),
   signal_cursor_color_(false),
+  color_read_queued_(false),
   gizmos_(nullptr),
   gizmo_click_(false),
   hand_dragging_(false),
@@ -56,6 +60,10 @@ ViewerDisplayWidget::ViewerDisplayWidget(QWidget *parent) :
 
   connect(this, &ViewerDisplayWidget::InnerWidgetMouseMove, this, &ViewerDisplayWidget::EmitColorAtCursor);
 
+  // Pixel reads usually arrive within a frame, so poll for them often
+  color_read_timer_.setInterval(1);
+  connect(&color_read_timer_, &QTimer::timeout, this, &ViewerDisplayWidget::CheckColorRead);
+
   // Initializes cursor based on tool
   UpdateCursor();
 
@@ -184,6 +192,27 @@ QPoint ViewerDisplayWidget::TransformViewerSpaceToBufferSpace(QPoint pos)
   return pos * GenerateGizmoTransform().inverted();
 }
 
+QRectF ViewerDisplayWidget::GetVisibleFrameRect() const
+{
+  QRectF full(0, 0, 1, 1);
+
+  bool invertible;
+  QMatrix4x4 inverted = combined_matrix_.inverted(&invertible);
+  if (!invertible || !crop_matrix_.isIdentity()) {
+    return full;
+  }
+
+  // The frame is drawn as a quad covering the widget, so mapping the widget's corners back through
+  // the matrix gives the part of the frame on screen. Y is flipped since the frame's top is at 0.
+  QPointF top_left = inverted.map(QPointF(-1, 1));
+  QPointF bottom_right = inverted.map(QPointF(1, -1));
+
+  QRectF visible(QPointF((top_left.x() + 1) * 0.5, (1 - top_left.y()) * 0.5),
+                 QPointF((bottom_right.x() + 1) * 0.5, (1 - bottom_right.y()) * 0.5));
+
+  return visible.normalized() & full;
+}
+
 void ViewerDisplayWidget::ResetFPSTimer()
 {
   fps_timer_start_ = QDateTime::currentMSecsSinceEpoch();
@@ -194,6 +223,14 @@ void ViewerDisplayWidget::ResetFPSTimer()
   Core::instance()->ClearStatusBarMessage();
 }
 
+qreal ViewerDisplayWidget::GetRefreshRate() const
+{
+  QWindow* window = this->window()->windowHandle();
+  QScreen* screen = window ? window->screen() : QGuiApplication::primaryScreen();
+
+  return screen ? screen->refreshRate() : 0;
+}
+
 void ViewerDisplayWidget::IncrementSkippedFrames()
 {
   frames_skipped_++;
@@ -333,7 +370,7 @@ void ViewerDisplayWidget::OnPaint()
     // Draw texture through color transform
     int device_width = width() * devicePixelRatioF();
     int device_height = height() * devicePixelRatioF();
-    VideoParams::Format device_format = static_cast<VideoParams::Format>(Config::Current()["OfflinePixelFormat"].toInt());
+    VideoParams::Format device_format = static_cast<VideoParams::Format>(Config::kOfflinePixelFormat.Get());
     VideoParams device_params(device_width, device_height, device_format, VideoParams::kInternalChannelCount);
 
     if (push_mode_ == kPushBlank) {
@@ -489,6 +526,11 @@ void ViewerDisplayWidget::OnDestroy()
 
   super::OnDestroy();
 
+  // The renderer discards pending reads when it's destroyed
+  color_read_timer_.stop();
+  color_read_.clear();
+  color_read_queued_ = false;
+
   texture_ = nullptr;
   deinterlace_texture_ = nullptr;
   if (load_frame_.isNull()) {
@@ -578,18 +620,61 @@ void ViewerDisplayWidget::EmitColorAtCursor(QMouseEvent *e)
 {
   // Do this no matter what, emits signal to any pixel samplers
   if (signal_cursor_color_) {
-    Color reference, display;
-
     if (texture_) {
       QPointF pixel_pos = GenerateGizmoTransform().inverted().map(e->pos());
       pixel_pos /= texture_->params().divider();
 
-      reference = renderer()->GetPixelFromTexture(texture_.get(), pixel_pos);
-      display = color_service()->ConvertColor(reference);
+      if (color_read_.isNull()) {
+        StartColorRead(pixel_pos);
+      } else {
+        // Still waiting on the last read, sample here once it's done
+        color_read_queued_ = true;
+        color_read_queued_pos_ = pixel_pos;
+      }
+    } else {
+      emit CursorColor(Color(), Color());
     }
+  }
+}
+
+void ViewerDisplayWidget::StartColorRead(const QPointF &pos)
+{
+  makeCurrent();
+  color_read_ = renderer()->StartPixelFromTexture(texture_.get(), pos);
+  doneCurrent();
+
+  color_read_timer_.start();
+}
 
-    emit CursorColor(reference, display);
+void ViewerDisplayWidget::CheckColorRead()
+{
+  if (color_read_.isNull()) {
+    color_read_timer_.stop();
+    return;
   }
+
+  Color reference;
+
+  makeCurrent();
+  bool ready = renderer()->TryFinishPixelFromTexture(color_read_, &reference);
+  doneCurrent();
+
+  if (!ready) {
+    return;
+  }
+
+  color_read_.clear();
+  color_read_timer_.stop();
+
+  if (signal_cursor_color_) {
+    emit CursorColor(reference, color_service()->ConvertColor(reference));
+
+    if (color_read_queued_ && texture_) {
+      StartColorRead(color_read_queued_pos_);
+    }
+  }
+
+  color_read_queued_ = false;
 }
 
 void ViewerDisplayWidget::SetShowFPS(bool e)
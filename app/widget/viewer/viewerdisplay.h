@@ -22,6 +22,7 @@
 #define VIEWERGLWIDGET_H
 
 #include <QOpenGLWidget>
+#include <QTimer>
 #include <QMatrix4x4>
 
 #include "node/color/colormanager/colormanager.h"
@@ -83,6 +84,11 @@ public:
    */
   QPoint TransformViewerSpaceToBufferSpace(QPoint pos);
 
+  /**
+   * @brief Region of the frame currently visible in this widget, normalized to 0-1 from the top-left
+   */
+  QRectF GetVisibleFrameRect() const;
+
   bool IsDeinterlacing() const
   {
     return deinterlace_;
@@ -90,6 +96,11 @@ public:
 
   void ResetFPSTimer();
 
+  /**
+   * @brief Refresh rate of the screen this widget is on, or 0 if unknown
+   */
+  qreal GetRefreshRate() const;
+
   bool GetShowFPS() const
   {
     return show_fps_;
@@ -280,6 +291,15 @@ private:
 
   bool signal_cursor_color_;
 
+  void StartColorRead(const QPointF& pos);
+
+  // Color under the cursor is read back asynchronously so mouse movement never waits on the GPU.
+  // Only one read is in flight at a time, with the latest position waiting behind it.
+  QVariant color_read_;
+  bool color_read_queued_;
+  QPointF color_read_queued_pos_;
+  QTimer color_read_timer_;
+
   ViewerSafeMarginInfo safe_margin_;
 
   Node* gizmos_;
@@ -331,6 +351,8 @@ private:
 private slots:
   void EmitColorAtCursor(QMouseEvent* e);
 
+  void CheckColorRead();
+
 };
 
 }
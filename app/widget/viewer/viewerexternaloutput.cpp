@@ -0,0 +1,197 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "viewerexternaloutput.h"
+
+#include <QDebug>
+
+#include "render/rendererthreadwrapper.h"
+
+namespace olive {
+
+RawPipeVideoSink::RawPipeVideoSink(const QString &filename) :
+  file_(filename)
+{
+}
+
+bool RawPipeVideoSink::Open(const VideoParams &params)
+{
+  Q_UNUSED(params)
+
+  // Frames are written back to back, so a change in size just carries on in the same stream
+  if (file_.isOpen()) {
+    return true;
+  }
+
+  if (!file_.open(QFile::WriteOnly)) {
+    qWarning() << "Failed to open external output" << file_.fileName() << file_.errorString();
+    return false;
+  }
+
+  return true;
+}
+
+bool RawPipeVideoSink::Write(const Frame *frame)
+{
+  int row_size = frame->width() * frame->video_params().GetBytesPerPixel();
+
+  for (int i=0; i<frame->height(); i++) {
+    if (file_.write(frame->const_data() + i * frame->linesize_bytes(), row_size) != row_size) {
+      return false;
+    }
+  }
+
+  return file_.flush();
+}
+
+void RawPipeVideoSink::Close()
+{
+  file_.close();
+}
+
+ViewerExternalOutput::ViewerExternalOutput(ExternalVideoSink *sink, QObject *parent) :
+  QThread(parent),
+  sink_(sink),
+  stop_(false)
+{
+}
+
+ViewerExternalOutput::~ViewerExternalOutput()
+{
+  Stop();
+  wait();
+}
+
+void ViewerExternalOutput::SetColorProcessor(ColorProcessorPtr processor)
+{
+  QMutexLocker locker(&lock_);
+  color_processor_ = processor;
+}
+
+void ViewerExternalOutput::Push(const QVariant &frame)
+{
+  QMutexLocker locker(&lock_);
+
+  // Anything the sink hasn't taken yet is out of date now
+  pending_ = frame;
+
+  wait_.wakeOne();
+}
+
+void ViewerExternalOutput::Stop()
+{
+  QMutexLocker locker(&lock_);
+
+  stop_ = true;
+  wait_.wakeOne();
+}
+
+void ViewerExternalOutput::run()
+{
+  VideoParams open_params;
+  bool is_open = false;
+
+  forever {
+    QVariant next;
+    ColorProcessorPtr processor;
+
+    lock_.lock();
+
+    while (!stop_ && pending_.isNull()) {
+      wait_.wait(&lock_);
+    }
+
+    if (stop_) {
+      lock_.unlock();
+      break;
+    }
+
+    next = pending_;
+    pending_.clear();
+    processor = color_processor_;
+
+    lock_.unlock();
+
+    FramePtr frame = PrepareFrame(next, processor);
+
+    if (!frame) {
+      continue;
+    }
+
+    if (!is_open || frame->video_params() != open_params) {
+      if (is_open) {
+        sink_->Close();
+      }
+
+      open_params = frame->video_params();
+      is_open = sink_->Open(open_params);
+    }
+
+    if (is_open && !sink_->Write(frame.get())) {
+      qWarning() << "External output failed to write frame, closing it";
+      sink_->Close();
+      is_open = false;
+    }
+  }
+
+  if (is_open) {
+    sink_->Close();
+  }
+}
+
+FramePtr ViewerExternalOutput::PrepareFrame(const QVariant &frame, ColorProcessorPtr processor) const
+{
+  FramePtr f;
+
+  if (FramePtr shared = frame.value<FramePtr>()) {
+    // The viewer may still be showing this frame, so convert a copy
+    f = shared->convert(shared->format());
+  } else if (TexturePtr texture = frame.value<TexturePtr>()) {
+    // Only render thread textures can be downloaded from here, the viewer's own belong to the GUI
+    // thread. Starting and finishing the download on the render thread lets it use its transfer
+    // buffers rather than stalling a readback.
+    RendererThreadWrapper* renderer = dynamic_cast<RendererThreadWrapper*>(texture->renderer());
+
+    if (renderer) {
+      f = Frame::Create();
+      f->set_video_params(texture->params());
+      f->allocate();
+
+      QVariant download = renderer->StartDownloadFromTexture(texture.get(), f->linesize_pixels());
+      renderer->FinishDownloadFromTexture(download, f->data());
+    }
+  }
+
+  if (!f) {
+    return nullptr;
+  }
+
+  if (processor) {
+    processor->ConvertFrame(f);
+  }
+
+  if (f->format() != VideoParams::kFormatUnsigned8) {
+    f = f->convert(VideoParams::kFormatUnsigned8);
+  }
+
+  return f;
+}
+
+}
@@ -0,0 +1,151 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef VIEWEREXTERNALOUTPUT_H
+#define VIEWEREXTERNALOUTPUT_H
+
+#include <memory>
+#include <QFile>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "codec/frame.h"
+#include "render/colorprocessor.h"
+
+namespace olive {
+
+/**
+ * @brief Somewhere frames can be sent for monitoring outside of Olive
+ *
+ * Subclasses wrap a device or SDK, such as NDI or an SDI card. Every function is called on
+ * ViewerExternalOutput's thread, so implementations can block without holding up the viewer.
+ */
+class ExternalVideoSink
+{
+public:
+  ExternalVideoSink() = default;
+
+  virtual ~ExternalVideoSink() = default;
+
+  DISABLE_COPY_MOVE(ExternalVideoSink)
+
+  /**
+   * @brief Prepare for frames with these parameters, always 8-bit and in the display color space
+   *
+   * Called again whenever the parameters change. Returns FALSE if the sink can't take them.
+   */
+  virtual bool Open(const VideoParams& params) = 0;
+
+  virtual bool Write(const Frame* frame) = 0;
+
+  virtual void Close() = 0;
+
+};
+
+/**
+ * @brief Writes raw 8-bit frames to a file or named pipe
+ *
+ * Rows are tightly packed with no header, so the other end (e.g. FFmpeg's rawvideo demuxer feeding
+ * a DeckLink or NDI output) needs to be told the frame size and pixel format.
+ */
+class RawPipeVideoSink : public ExternalVideoSink
+{
+public:
+  RawPipeVideoSink(const QString& filename);
+
+  virtual bool Open(const VideoParams& params) override;
+
+  virtual bool Write(const Frame* frame) override;
+
+  virtual void Close() override;
+
+private:
+  QFile file_;
+
+};
+
+/**
+ * @brief Sends whatever a viewer displays to an ExternalVideoSink on a dedicated thread
+ *
+ * The viewer only hands over a reference to each frame, which is never modified, so monitoring
+ * can't hold up or take frames from the viewer itself. Textures are downloaded through their
+ * render thread and everything is converted to the display color space on this thread. If the
+ * sink falls behind, frames it hasn't taken yet are replaced by newer ones.
+ */
+class ViewerExternalOutput : public QThread
+{
+  Q_OBJECT
+public:
+  /**
+   * @brief Construct an output, taking ownership of `sink`
+   */
+  ViewerExternalOutput(ExternalVideoSink* sink, QObject* parent = nullptr);
+
+  virtual ~ViewerExternalOutput() override;
+
+  /**
+   * @brief Set the transform from reference space to the space the sink expects
+   *
+   * This function is thread-safe.
+   */
+  void SetColorProcessor(ColorProcessorPtr processor);
+
+  /**
+   * @brief Queue a FramePtr or TexturePtr to be sent, never blocks
+   *
+   * This function is thread-safe.
+   */
+  void Push(const QVariant& frame);
+
+  /**
+   * @brief Stop sending, the thread finishes once the sink has returned
+   *
+   * This doesn't wait, since a sink may be blocked on its device (e.g. a named pipe nothing has
+   * opened for reading yet).
+   */
+  void Stop();
+
+protected:
+  virtual void run() override;
+
+private:
+  /**
+   * @brief Convert a pushed frame to a private 8-bit frame in the display color space
+   */
+  FramePtr PrepareFrame(const QVariant& frame, ColorProcessorPtr processor) const;
+
+  std::unique_ptr<ExternalVideoSink> sink_;
+
+  QMutex lock_;
+
+  QWaitCondition wait_;
+
+  QVariant pending_;
+
+  ColorProcessorPtr color_processor_;
+
+  bool stop_;
+
+};
+
+}
+
+#endif // VIEWEREXTERNALOUTPUT_H
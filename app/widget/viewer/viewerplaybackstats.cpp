@@ -0,0 +1,153 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#include "viewerplaybackstats.h"
+
+#include <algorithm>
+#include <QtMath>
+
+namespace olive {
+
+ViewerPlaybackStats::ViewerPlaybackStats()
+{
+  Start();
+}
+
+void ViewerPlaybackStats::Start()
+{
+  timer_.start();
+
+  playback_start_ = -1;
+  playback_end_ = -1;
+
+  for (int i=0; i<kSourceCount; i++) {
+    requested_[i] = 0;
+  }
+
+  arrived_ = 0;
+  shown_ = 0;
+  elapsed_frames_ = 0;
+  late_ = 0;
+
+  request_latency_.clear();
+  decode_latency_.clear();
+  render_latency_.clear();
+  upload_latency_.clear();
+}
+
+void ViewerPlaybackStats::PlaybackStarted()
+{
+  playback_start_ = Now();
+}
+
+void ViewerPlaybackStats::Finish(int elapsed_frames)
+{
+  playback_end_ = Now();
+  elapsed_frames_ = elapsed_frames;
+}
+
+void ViewerPlaybackStats::FrameRequested(FrameSource source)
+{
+  requested_[source]++;
+}
+
+void ViewerPlaybackStats::FrameArrived(FrameSource source, qint64 latency, qint64 decode_time, bool late)
+{
+  arrived_++;
+
+  request_latency_.append(latency);
+
+  if (source == kSourceRender) {
+    render_latency_.append(latency);
+  }
+
+  if (decode_time >= 0) {
+    decode_latency_.append(decode_time);
+  }
+
+  if (late) {
+    late_++;
+  }
+}
+
+QJsonObject ViewerPlaybackStats::ToJson() const
+{
+  QJsonObject obj;
+
+  double seconds = 0;
+  if (playback_start_ >= 0 && playback_end_ > playback_start_) {
+    seconds = (playback_end_ - playback_start_) / 1000000000.0;
+  }
+
+  int requested = 0;
+  for (int i=0; i<kSourceCount; i++) {
+    requested += requested_[i];
+  }
+
+  obj.insert(QStringLiteral("duration_seconds"), seconds);
+  obj.insert(QStringLiteral("achieved_fps"), (seconds > 0) ? shown_ / seconds : 0.0);
+  obj.insert(QStringLiteral("frames_requested"), requested);
+  obj.insert(QStringLiteral("frames_arrived"), arrived_);
+  obj.insert(QStringLiteral("frames_shown"), shown_);
+  obj.insert(QStringLiteral("frames_expected"), elapsed_frames_);
+  obj.insert(QStringLiteral("frames_dropped"), qMax(0, elapsed_frames_ - shown_));
+  obj.insert(QStringLiteral("frames_late"), late_);
+
+  QJsonObject cache;
+  cache.insert(QStringLiteral("texture_hits"), requested_[kSourceTextureCache]);
+  cache.insert(QStringLiteral("disk_hits"), requested_[kSourceDiskCache]);
+  cache.insert(QStringLiteral("misses"), requested_[kSourceRender]);
+  cache.insert(QStringLiteral("hit_rate"), requested ? double(requested - requested_[kSourceRender]) / requested : 0.0);
+  obj.insert(QStringLiteral("cache"), cache);
+
+  QJsonObject latency;
+  latency.insert(QStringLiteral("request"), PercentilesToJson(request_latency_));
+  latency.insert(QStringLiteral("decode"), PercentilesToJson(decode_latency_));
+  latency.insert(QStringLiteral("render"), PercentilesToJson(render_latency_));
+  latency.insert(QStringLiteral("upload"), PercentilesToJson(upload_latency_));
+  obj.insert(QStringLiteral("latency_ms"), latency);
+
+  return obj;
+}
+
+QJsonObject ViewerPlaybackStats::PercentilesToJson(QVector<qint64> samples)
+{
+  QJsonObject obj;
+
+  obj.insert(QStringLiteral("count"), samples.size());
+
+  if (samples.isEmpty()) {
+    return obj;
+  }
+
+  std::sort(samples.begin(), samples.end());
+
+  // Nearest-rank percentiles, reported in milliseconds since that's what frame budgets are in
+  const int percentiles[] = {50, 90, 95, 99};
+  for (int p : percentiles) {
+    int index = qMax(0, qCeil(p / 100.0 * samples.size()) - 1);
+    obj.insert(QStringLiteral("p%1").arg(p), samples.at(index) / 1000000.0);
+  }
+
+  obj.insert(QStringLiteral("max"), samples.last() / 1000000.0);
+
+  return obj;
+}
+
+}
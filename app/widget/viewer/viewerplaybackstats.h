@@ -0,0 +1,134 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+#ifndef VIEWERPLAYBACKSTATS_H
+#define VIEWERPLAYBACKSTATS_H
+
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QVector>
+
+namespace olive {
+
+/**
+ * @brief Collects measurements of a ViewerWidget's playback for benchmarking
+ *
+ * All times are in nanoseconds relative to when Start() was called.
+ */
+class ViewerPlaybackStats
+{
+public:
+  enum FrameSource {
+    kSourceTextureCache,
+    kSourceDiskCache,
+    kSourceRender,
+    kSourceCount
+  };
+
+  ViewerPlaybackStats();
+
+  /**
+   * @brief Clear all measurements and restart the clock
+   */
+  void Start();
+
+  /**
+   * @brief Mark the moment frames started being shown, prequeuing happens before this
+   */
+  void PlaybackStarted();
+
+  /**
+   * @brief Stop the clock used for the achieved frame rate
+   *
+   * `elapsed_frames` is how many frames should have been shown in that time, any that weren't
+   * shown on time are reported as dropped.
+   */
+  void Finish(int elapsed_frames);
+
+  qint64 Now() const
+  {
+    return timer_.nsecsElapsed();
+  }
+
+  void FrameRequested(FrameSource source);
+
+  /**
+   * @brief A requested frame arrived in the playback queue
+   *
+   * @param latency
+   *
+   * Time between the frame being requested and it arriving.
+   *
+   * @param decode_time
+   *
+   * Time spent decoding it from the disk cache, or -1 if it wasn't decoded.
+   *
+   * @param late
+   *
+   * Whether the frame's timestamp had already passed by the time it arrived.
+   */
+  void FrameArrived(FrameSource source, qint64 latency, qint64 decode_time, bool late);
+
+  void FrameShown()
+  {
+    shown_++;
+  }
+
+  /**
+   * @brief Time between a frame being given to the display and it being swapped on screen
+   */
+  void FrameUploaded(qint64 latency)
+  {
+    upload_latency_.append(latency);
+  }
+
+  QJsonObject ToJson() const;
+
+private:
+  static QJsonObject PercentilesToJson(QVector<qint64> samples);
+
+  QElapsedTimer timer_;
+
+  qint64 playback_start_;
+
+  qint64 playback_end_;
+
+  int requested_[kSourceCount];
+
+  int arrived_;
+
+  int shown_;
+
+  int elapsed_frames_;
+
+  int late_;
+
+  QVector<qint64> request_latency_;
+
+  QVector<qint64> decode_latency_;
+
+  QVector<qint64> render_latency_;
+
+  QVector<qint64> upload_latency_;
+
+};
+
+}
+
+#endif // VIEWERPLAYBACKSTATS_H
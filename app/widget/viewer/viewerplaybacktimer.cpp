@@ -20,24 +20,87 @@
 
 #include "viewerplaybacktimer.h"
 
-#include <QDateTime>
 #include <QtMath>
 
+#include "audio/audiomanager.h"
+
 namespace olive {
 
+ViewerPlaybackTimer::ViewerPlaybackTimer() :
+  start_timestamp_(0),
+  playback_speed_(0),
+  timebase_(0),
+  anchor_elapsed_(0),
+  anchor_nsecs_(0),
+  last_elapsed_(0),
+  follow_audio_(false),
+  audio_start_timestamp_(0),
+  refresh_interval_(0),
+  last_present_(-1)
+{
+  clock_.start();
+}
+
 void ViewerPlaybackTimer::Start(const int64_t &start_timestamp, const int &playback_speed, const double &timebase)
 {
-  start_msec_ = QDateTime::currentMSecsSinceEpoch();
   start_timestamp_ = start_timestamp;
   playback_speed_ = playback_speed;
-  timebase_ = timebase * 1000;
+  timebase_ = timebase;
+
+  anchor_elapsed_ = 0;
+  anchor_nsecs_ = clock_.nsecsElapsed();
+  last_elapsed_ = 0;
+
+  follow_audio_ = false;
+  last_present_ = -1;
+}
+
+void ViewerPlaybackTimer::FollowAudio(const int64_t &start_timestamp)
+{
+  follow_audio_ = true;
+  audio_start_timestamp_ = start_timestamp;
+}
+
+void ViewerPlaybackTimer::SetRefreshRate(qreal hz)
+{
+  refresh_interval_ = (hz > 0) ? qRound64(1000000000.0 / hz) : 0;
+}
+
+void ViewerPlaybackTimer::FramePresented()
+{
+  last_present_ = clock_.nsecsElapsed();
 }
 
 int64_t ViewerPlaybackTimer::GetTimestampNow() const
 {
-  int64_t real_time = QDateTime::currentMSecsSinceEpoch() - start_msec_;
+  if (!playback_speed_) {
+    return start_timestamp_;
+  }
+
+  qint64 now = clock_.nsecsElapsed();
+
+  // Whatever is chosen now is shown at the next vsync, which is a whole number of refreshes after
+  // the last one
+  qint64 present = now;
+  if (refresh_interval_ > 0 && last_present_ >= 0) {
+    present = last_present_ + ((now - last_present_) / refresh_interval_ + 1) * refresh_interval_;
+  }
+
+  if (follow_audio_) {
+    qint64 played = AudioManager::instance()->GetOutputPlayedUSecs();
+
+    if (played >= 0) {
+      // Re-anchor to the audio so the wall clock carries on from here if it stops
+      anchor_elapsed_ = double(audio_start_timestamp_ - start_timestamp_) / playback_speed_ * timebase_ + played * 0.000001;
+      anchor_nsecs_ = now;
+    }
+  }
+
+  // Audio usually starts a little after video, in which case we wait for it rather than jump back
+  double elapsed = qMax(last_elapsed_, anchor_elapsed_ + (present - anchor_nsecs_) * 0.000000001);
+  last_elapsed_ = elapsed;
 
-  int64_t frames_since_start = qFloor(static_cast<double>(real_time) / (timebase_));
+  int64_t frames_since_start = qFloor(elapsed / timebase_);
 
   return start_timestamp_ + frames_since_start * playback_speed_;
 }
@@ -21,26 +21,74 @@
 #ifndef VIEWERPLAYBACKTIMER_H
 #define VIEWERPLAYBACKTIMER_H
 
+#include <QElapsedTimer>
 #include <QtGlobal>
 
 #include "common/define.h"
 
 namespace olive {
 
+/**
+ * @brief Decides which frame should be on screen during playback
+ *
+ * The wall clock is used by default. Once FollowAudio() is called, the audio output's position
+ * is used instead while audio is playing, so video can't drift from it. If audio stalls or
+ * restarts, the wall clock carries on from where audio left off.
+ *
+ * If the display's refresh rate is known and FramePresented() is called on every buffer swap,
+ * frames are chosen for the vsync they'll be shown at rather than the moment they're chosen, which
+ * keeps cadences like 23.976 on 60 Hz steady.
+ */
 class ViewerPlaybackTimer {
 public:
+  ViewerPlaybackTimer();
+
   void Start(const int64_t& start_timestamp, const int& playback_speed, const double& timebase);
 
+  /**
+   * @brief Slave to the audio output, which was just started from `start_timestamp`
+   */
+  void FollowAudio(const int64_t& start_timestamp);
+
+  /**
+   * @brief Set the refresh rate of the display frames are shown on, or 0 if unknown
+   */
+  void SetRefreshRate(qreal hz);
+
+  /**
+   * @brief Notify that a frame was just swapped onto the display
+   */
+  void FramePresented();
+
+  /**
+   * @brief Timestamp of the frame that should be shown at the next vsync
+   *
+   * Never goes back in time between calls to Start().
+   */
   int64_t GetTimestampNow() const;
 
 private:
-  qint64 start_msec_;
+  QElapsedTimer clock_;
+
   int64_t start_timestamp_;
 
   int playback_speed_;
 
+  // Seconds per frame
   double timebase_;
 
+  // Seconds of playback at `anchor_nsecs_`, which the clock advances from
+  mutable double anchor_elapsed_;
+  mutable qint64 anchor_nsecs_;
+
+  mutable double last_elapsed_;
+
+  bool follow_audio_;
+  int64_t audio_start_timestamp_;
+
+  qint64 refresh_interval_;
+  qint64 last_present_;
+
 };
 
 }
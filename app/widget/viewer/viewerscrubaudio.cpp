@@ -0,0 +1,196 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "viewerscrubaudio.h"
+
+#include "codec/conformmanager.h"
+#include "codec/planaraudiofile.h"
+#include "node/block/clip/clip.h"
+#include "node/project/footage/footage.h"
+#include "node/project/project.h"
+#include "node/project/sequence/sequence.h"
+
+namespace olive {
+
+const int ViewerScrubAudio::kMaximumCacheSize = 4 * 1024 * 1024;
+
+ViewerScrubAudio::ViewerScrubAudio() :
+  snippets_(kMaximumCacheSize)
+{
+}
+
+QByteArray ViewerScrubAudio::GetSnippet(ViewerOutput *viewer, const rational &time, const rational &length)
+{
+  AudioPlaybackCache* cache = viewer->audio_playback_cache();
+  AudioParams params = cache->GetParameters();
+
+  if (!params.is_valid()) {
+    return QByteArray();
+  }
+
+  qint64 start = params.time_to_samples(time);
+  qint64 count = params.time_to_samples(length);
+
+  if (count <= 0) {
+    return QByteArray();
+  }
+
+  QPair<qint64, qint64> key(start, count);
+
+  if (QByteArray* stored = snippets_.object(key)) {
+    return *stored;
+  }
+
+  TimeRange range(params.samples_to_time(start), params.samples_to_time(start + count));
+
+  QByteArray snippet;
+  bool complete = true;
+
+  Sequence* sequence = dynamic_cast<Sequence*>(viewer);
+
+  if (sequence && !cache->GetInvalidatedRanges().Intersects(range).isEmpty()) {
+    // The cache would play stale audio (or silence) here, see what the clips themselves sound like
+    SampleBufferPtr mixed = ReadFromConforms(sequence, params, start, count, &complete);
+
+    if (mixed) {
+      snippet = mixed->toPackedData();
+    } else if (complete) {
+      // There are no clips here at all
+      snippet = QByteArray(int(params.samples_to_bytes(count)), 0);
+    }
+  }
+
+  if (snippet.isEmpty()) {
+    snippet = ReadFromPlaybackCache(cache, start, count);
+  }
+
+  // Anything that couldn't be read may be conformed by the next time we're here
+  if (complete && !snippet.isEmpty()) {
+    snippets_.insert(key, new QByteArray(snippet), snippet.size());
+  }
+
+  return snippet;
+}
+
+QByteArray ViewerScrubAudio::ReadFromPlaybackCache(AudioPlaybackCache *cache, qint64 start, qint64 count)
+{
+  const AudioParams& params = cache->GetParameters();
+
+  QByteArray data;
+
+  AudioPlaybackCache::PlaybackDevice* device = cache->CreatePlaybackDevice();
+
+  if (device->open(QIODevice::ReadOnly)) {
+    device->seek(params.samples_to_bytes(start));
+    data = device->read(params.samples_to_bytes(count));
+    device->close();
+  }
+
+  delete device;
+
+  return data;
+}
+
+SampleBufferPtr ViewerScrubAudio::ReadFromConforms(Sequence *sequence, const AudioParams &params, qint64 start, qint64 count, bool *complete)
+{
+  SampleBufferPtr mixed;
+
+  *complete = true;
+
+  TimeRange range(params.samples_to_time(start), params.samples_to_time(start + count));
+
+  foreach (Track* track, sequence->track_list(Track::kAudio)->GetTracks()) {
+    // Returns nothing for muted tracks
+    QVector<Block*> blocks = track->BlocksAtTimeRange(range);
+
+    foreach (Block* block, blocks) {
+      ClipBlock* clip = dynamic_cast<ClipBlock*>(block);
+
+      // Retimed clips would need resampling, leave them to the cache
+      if (!clip || clip->reverse() || !qFuzzyCompare(clip->speed(), 1.0)) {
+        *complete = false;
+        continue;
+      }
+
+      // Only footage connected straight to the clip sounds the same read raw
+      NodeOutput source = clip->GetConnectedOutput(ClipBlock::kBufferIn);
+      Footage* footage = dynamic_cast<Footage*>(source.node());
+      Track::Reference ref = Track::Reference::FromString(source.output());
+
+      if (!footage || !footage->project() || ref.type() != Track::kAudio) {
+        *complete = false;
+        continue;
+      }
+
+      Decoder::CodecStream stream(footage->filename(), footage->GetAudioParams(ref.index()).stream_index());
+
+      QString conform = ConformManager::GetExistingConform(footage->project()->cache_path(), stream, params);
+
+      if (conform.isEmpty()) {
+        *complete = false;
+        continue;
+      }
+
+      PlanarAudioInput input(conform);
+
+      if (!input.open() || input.params().channel_count() != params.channel_count()) {
+        *complete = false;
+        continue;
+      }
+
+      TimeRange clip_range = range.Intersected(TimeRange(clip->in(), clip->out()));
+
+      qint64 write_index = params.time_to_samples(clip_range.in()) - start;
+      qint64 read_index = params.time_to_samples(clip->SequenceToMediaTime(clip_range.in() - clip->in()));
+      qint64 read_count = qMin(params.time_to_samples(clip_range.out()) - start, count) - write_index;
+
+      // Silence before and after the source's audio
+      if (read_index < 0) {
+        write_index -= read_index;
+        read_count += read_index;
+        read_index = 0;
+      }
+
+      read_count = qMin(read_count, input.sample_count() - read_index);
+
+      if (read_count <= 0) {
+        continue;
+      }
+
+      if (!mixed) {
+        mixed = SampleBuffer::CreateAllocated(params, int(count));
+        mixed->fill(0);
+      }
+
+      for (int i=0; i<params.channel_count(); i++) {
+        float* dst = mixed->data(i) + write_index;
+        const float* src = input.data(i) + read_index;
+
+        for (qint64 j=0; j<read_count; j++) {
+          dst[j] += src[j];
+        }
+      }
+    }
+  }
+
+  return mixed;
+}
+
+}
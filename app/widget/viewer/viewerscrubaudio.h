@@ -0,0 +1,89 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef VIEWERSCRUBAUDIO_H
+#define VIEWERSCRUBAUDIO_H
+
+#include <QByteArray>
+#include <QCache>
+#include <QPair>
+
+#include "codec/samplebuffer.h"
+#include "node/output/viewer/viewer.h"
+
+namespace olive {
+
+class Sequence;
+
+/**
+ * @brief Short snippets of audio to play while scrubbing a ViewerWidget
+ *
+ * Snippets are read from the viewer's AudioPlaybackCache where it's valid. Where it isn't, the
+ * clips under the playhead are mixed straight from their conformed audio, so scrubbing over audio
+ * that hasn't been cached yet never has to render the audio graph or wait on anything. Clips that
+ * can't be read this way (no finished conform, retimed, or not directly connected to footage) are
+ * left silent until the cache catches up.
+ *
+ * Recently read snippets are kept, so scrubbing back and forth over the same frames only reads
+ * each once.
+ */
+class ViewerScrubAudio
+{
+public:
+  ViewerScrubAudio();
+
+  /**
+   * @brief Get `length` of packed audio from `time` in the playback cache's format
+   *
+   * Returns an empty array if there's nothing to play.
+   */
+  QByteArray GetSnippet(ViewerOutput* viewer, const rational& time, const rational& length);
+
+  /**
+   * @brief Forget every stored snippet, for when the audio they came from has changed
+   */
+  void Clear()
+  {
+    snippets_.clear();
+  }
+
+  /**
+   * @brief Maximum bytes of snippets kept at once
+   */
+  static const int kMaximumCacheSize;
+
+private:
+  static QByteArray ReadFromPlaybackCache(AudioPlaybackCache* cache, qint64 start, qint64 count);
+
+  /**
+   * @brief Mix the audio of every clip in `sequence` over `count` samples from `start`
+   *
+   * Returns nullptr if no clip could be read. `complete` is set to FALSE if any clip was skipped.
+   */
+  static SampleBufferPtr ReadFromConforms(Sequence* sequence, const AudioParams& params, qint64 start, qint64 count, bool* complete);
+
+  // Keyed by start sample and sample count
+  QCache<QPair<qint64, qint64>, QByteArray> snippets_;
+
+};
+
+}
+
+#endif // VIEWERSCRUBAUDIO_H
@@ -71,6 +71,7 @@ void ViewerWindow::SetPixelAspectRatio(const rational &pixel_aspect)
 void ViewerWindow::Play(const int64_t& start_timestamp, const int& playback_speed, const rational &timebase)
 {
   timer_.Start(start_timestamp, playback_speed, timebase.toDouble());
+  timer_.SetRefreshRate(display_widget_->GetRefreshRate());
 
   playback_timebase_ = timebase;
 
@@ -104,6 +105,8 @@ void ViewerWindow::closeEvent(QCloseEvent *e)
 
 void ViewerWindow::UpdateFromQueue()
 {
+  timer_.FramePresented();
+
   int64_t t = timer_.GetTimestampNow();
 
   rational time = Timecode::timestamp_to_time(t, playback_timebase_);
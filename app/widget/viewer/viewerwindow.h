@@ -60,6 +60,14 @@ public:
 
   void Play(const int64_t &start_timestamp, const int &playback_speed, const rational &timebase);
 
+  /**
+   * @brief Follow the audio output from here, see ViewerPlaybackTimer::FollowAudio()
+   */
+  void FollowAudio(const int64_t &start_timestamp)
+  {
+    timer_.FollowAudio(start_timestamp);
+  }
+
   void Pause();
 
 protected:
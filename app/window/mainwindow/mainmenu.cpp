@@ -22,9 +22,12 @@
 
 #include <QDesktopServices>
 #include <QEvent>
+#include <QFileDialog>
+#include <QMessageBox>
 #include <QStyleFactory>
 
 #include "common/timecodefunctions.h"
+#include "common/tracing.h"
 #include "config/config.h"
 #include "core.h"
 #include "dialog/actionsearch/actionsearch.h"
@@ -257,6 +260,9 @@ MainMenu::MainMenu(MainWindow *parent) :
   help_action_search_item_ = help_menu_->AddItem("actionsearch", this, &MainMenu::ActionSearchTriggered, "/");
   help_menu_->addSeparator();
   help_feedback_item_ = help_menu_->AddItem("feedback", this, &MainMenu::HelpFeedbackTriggered);
+  help_trace_item_ = help_menu_->AddItem("recordtrace", this, &MainMenu::HelpTraceTriggered);
+  help_trace_item_->setCheckable(true);
+  help_trace_item_->setChecked(Tracer::IsEnabled());
   help_menu_->addSeparator();
   help_about_item_ = help_menu_->AddItem("about", Core::instance(), &Core::DialogAboutShow);
 
@@ -479,7 +485,7 @@ void MainMenu::PlayInToOutTriggered()
 
 void MainMenu::LoopTriggered(bool enabled)
 {
-  Config::Current()["Loop"] = enabled;
+  Config::Current().Set("Loop", enabled);
 }
 
 void MainMenu::NextFrameTriggered()
@@ -619,6 +625,28 @@ void MainMenu::HelpFeedbackTriggered()
   QDesktopServices::openUrl(QStringLiteral("https://github.com/olive-editor/olive/issues"));
 }
 
+void MainMenu::HelpTraceTriggered(bool e)
+{
+  if (e) {
+    Tracer::Clear();
+    Tracer::SetEnabled(true);
+    return;
+  }
+
+  Tracer::SetEnabled(false);
+
+  QString fn = QFileDialog::getSaveFileName(this,
+                                            tr("Save Performance Trace"),
+                                            QString(),
+                                            tr("Chrome Trace (*.json)"));
+
+  if (!fn.isEmpty() && !Tracer::WriteChromeTrace(fn)) {
+    QMessageBox::critical(this,
+                          tr("Failed to save trace"),
+                          tr("Failed to write trace to \"%1\".").arg(fn));
+  }
+}
+
 void MainMenu::Retranslate()
 {
   // MenuShared is not a QWidget and therefore does not receive a LanguageEvent, we use MainMenu's to update it
@@ -712,6 +740,7 @@ void MainMenu::Retranslate()
   help_menu_->setTitle(tr("&Help"));
   help_action_search_item_->setText(tr("A&ction Search"));
   help_feedback_item_->setText(tr("Send &Feedback..."));
+  help_trace_item_->setText(tr("Record Performance Trace"));
   help_about_item_->setText(tr("&About..."));
 }
 
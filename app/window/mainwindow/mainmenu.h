@@ -182,6 +182,8 @@ private slots:
 
   void HelpFeedbackTriggered();
 
+  void HelpTraceTriggered(bool e);
+
 private:
   /**
    * @brief Set strings based on the current application language.
@@ -274,6 +276,7 @@ private:
   Menu* help_menu_;
   QAction* help_action_search_item_;
   QAction* help_feedback_item_;
+  QAction* help_trace_item_;
   QAction* help_about_item_;
 
 };
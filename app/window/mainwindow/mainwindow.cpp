@@ -87,6 +87,7 @@ MainWindow::MainWindow(QWidget *parent) :
   AppendProjectPanel();
   tool_panel_ = PanelManager::instance()->CreatePanel<ToolPanel>(this);
   task_man_panel_ = PanelManager::instance()->CreatePanel<TaskManagerPanel>(this);
+  metrics_panel_ = PanelManager::instance()->CreatePanel<MetricsPanel>(this);
   AppendTimelinePanel();
   audio_monitor_panel_ = PanelManager::instance()->CreatePanel<AudioMonitorPanel>(this);
 
@@ -761,6 +762,10 @@ void MainWindow::SetDefaultLayout()
   task_man_panel_->setFloating(true);
   addDockWidget(Qt::BottomDockWidgetArea, task_man_panel_);
 
+  metrics_panel_->hide();
+  metrics_panel_->setFloating(true);
+  addDockWidget(Qt::BottomDockWidgetArea, metrics_panel_);
+
   audio_monitor_panel_->show();
   addDockWidget(Qt::BottomDockWidgetArea, audio_monitor_panel_);
 
@@ -37,6 +37,7 @@
 #include "panel/timeline/timeline.h"
 #include "panel/tool/tool.h"
 #include "panel/footageviewer/footageviewer.h"
+#include "panel/metrics/metrics.h"
 #include "panel/sequenceviewer/sequenceviewer.h"
 #include "panel/pixelsampler/pixelsamplerpanel.h"
 
@@ -73,6 +74,11 @@ public:
 
   void OpenNodeInViewer(ViewerOutput* node);
 
+  SequenceViewerPanel* sequence_viewer_panel() const
+  {
+    return sequence_viewer_panel_;
+  }
+
   enum ProgressStatus {
     kProgressNone,
     kProgressShow,
@@ -157,6 +163,7 @@ private:
   AudioMonitorPanel* audio_monitor_panel_;
   TaskManagerPanel* task_man_panel_;
   PixelSamplerPanel* pixel_sampler_panel_;
+  MetricsPanel* metrics_panel_;
   QList<ScopePanel*> scope_panels_;
   NodeTablePanel* table_panel_;
   QMap<ViewerOutput*, ViewerPanel*> viewer_panels_;
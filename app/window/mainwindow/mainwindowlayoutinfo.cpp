@@ -2,7 +2,7 @@
 
 namespace olive {
 
-void MainWindowLayoutInfo::toXml(QXmlStreamWriter *writer) const
+void MainWindowLayoutInfo::toXml(XMLWriter *writer) const
 {
   writer->writeStartElement(QStringLiteral("layout"));
 
@@ -32,7 +32,7 @@ void MainWindowLayoutInfo::toXml(QXmlStreamWriter *writer) const
   writer->writeEndElement(); // layout
 }
 
-MainWindowLayoutInfo MainWindowLayoutInfo::fromXml(QXmlStreamReader *reader, XMLNodeData &xml_data)
+MainWindowLayoutInfo MainWindowLayoutInfo::fromXml(XMLReader *reader, XMLNodeData &xml_data)
 {
   MainWindowLayoutInfo info;
 
@@ -11,9 +11,9 @@ class MainWindowLayoutInfo
 public:
   MainWindowLayoutInfo() = default;
 
-  void toXml(QXmlStreamWriter* writer) const;
+  void toXml(XMLWriter* writer) const;
 
-  static MainWindowLayoutInfo fromXml(QXmlStreamReader* reader, XMLNodeData &xml_data);
+  static MainWindowLayoutInfo fromXml(XMLReader* reader, XMLNodeData &xml_data);
 
   void add_folder(Folder* f);
 
@@ -0,0 +1,39 @@
+# Olive - Non-Linear Video Editor
+# Copyright (C) 2021 Olive Team
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# The OpenFX API is header-only, hosts only need its include directory
+
+find_path(OPENFX_INCLUDE_DIR
+        ofxImageEffect.h
+    HINTS
+        "${OPENFX_LOCATION}"
+        "$ENV{OPENFX_LOCATION}"
+        "/opt/openfx"
+    PATH_SUFFIXES
+        include/
+        include/openfx/
+    DOC
+        "OpenFX headers path"
+)
+
+list(APPEND OPENFX_INCLUDE_DIRS ${OPENFX_INCLUDE_DIR})
+
+include(FindPackageHandleStandardArgs)
+
+find_package_handle_standard_args(OpenFX
+    REQUIRED_VARS
+        OPENFX_INCLUDE_DIRS
+)
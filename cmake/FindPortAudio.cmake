@@ -0,0 +1,54 @@
+# Olive - Non-Linear Video Editor
+# Copyright (C) 2021 Olive Team
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+find_path(PORTAUDIO_INCLUDE_DIR
+        portaudio.h
+    HINTS
+        "${PORTAUDIO_LOCATION}"
+        "$ENV{PORTAUDIO_LOCATION}"
+        "/opt/portaudio"
+    PATH_SUFFIXES
+        include/
+    DOC
+        "PortAudio headers path"
+)
+
+list(APPEND PORTAUDIO_INCLUDE_DIRS ${PORTAUDIO_INCLUDE_DIR})
+
+find_library(PORTAUDIO_LIBRARY
+    NAMES
+        portaudio
+        portaudio_x64
+        portaudio_static
+    HINTS
+        "${PORTAUDIO_LOCATION}"
+        "$ENV{PORTAUDIO_LOCATION}"
+        "/opt/portaudio"
+    PATH_SUFFIXES
+        lib/
+    DOC
+        "PortAudio library path"
+)
+
+list(APPEND PORTAUDIO_LIBRARIES ${PORTAUDIO_LIBRARY})
+
+include(FindPackageHandleStandardArgs)
+
+find_package_handle_standard_args(PortAudio
+    REQUIRED_VARS
+        PORTAUDIO_LIBRARIES
+        PORTAUDIO_INCLUDE_DIRS
+)
@@ -0,0 +1,162 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef BENCHMARKRUNNER_H
+#define BENCHMARKRUNNER_H
+
+#include <algorithm>
+#include <iostream>
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <QVector>
+
+#include "version.h"
+
+namespace olive {
+
+class BenchmarkRunner
+{
+public:
+  BenchmarkRunner(const QString& filter) :
+    filter_(filter)
+  {
+  }
+
+  bool IsEnabled(const QString& name) const
+  {
+    return filter_.isEmpty() || name.contains(filter_);
+  }
+
+  /**
+   * @brief Time `iterations` runs of `func`, each of which performs `ops` operations
+   *
+   * `func` runs once first to warm up caches and lazily initialized state. Timings are reported
+   * per operation so that very cheap operations can be batched into measurable runs.
+   *
+   * Returns the median time per operation in nanoseconds, or -1 if the benchmark was filtered out.
+   */
+  template <typename Func>
+  double Run(const QString& name, int iterations, int ops, Func func)
+  {
+    if (!IsEnabled(name)) {
+      return -1;
+    }
+
+    std::cerr << name.toUtf8().constData() << std::flush;
+
+    func();
+
+    QVector<qint64> samples(iterations);
+    QElapsedTimer timer;
+
+    for (int i=0; i<iterations; i++) {
+      timer.start();
+      func();
+      samples[i] = timer.nsecsElapsed();
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    qint64 total = 0;
+    foreach (qint64 s, samples) {
+      total += s;
+    }
+
+    double median = double(samples.at(samples.size() / 2)) / ops;
+
+    QJsonObject result;
+    result.insert(QStringLiteral("name"), name);
+    result.insert(QStringLiteral("iterations"), iterations);
+    result.insert(QStringLiteral("ops_per_iteration"), ops);
+    result.insert(QStringLiteral("min_ns"), double(samples.first()) / ops);
+    result.insert(QStringLiteral("median_ns"), median);
+    result.insert(QStringLiteral("mean_ns"), double(total) / iterations / ops);
+    result.insert(QStringLiteral("max_ns"), double(samples.last()) / ops);
+    results_.append(result);
+
+    std::cerr << " - " << samples.at(samples.size() / 2) / ops << " ns/op" << std::endl;
+
+    return median;
+  }
+
+  void Skip(const QString& name, const QString& reason)
+  {
+    if (!IsEnabled(name)) {
+      return;
+    }
+
+    QJsonObject result;
+    result.insert(QStringLiteral("name"), name);
+    result.insert(QStringLiteral("skipped"), reason);
+    results_.append(result);
+
+    std::cerr << name.toUtf8().constData() << " - SKIPPED: " << reason.toUtf8().constData() << std::endl;
+  }
+
+  const QJsonArray& results() const
+  {
+    return results_;
+  }
+
+  /**
+   * @brief Write every result along with build information as JSON to `output`, or stdout if empty
+   *
+   * `extra` is merged into the top level of the report. Returns false if the file couldn't be written.
+   */
+  bool WriteReport(const QString& output, const QJsonObject& extra = QJsonObject()) const
+  {
+    QJsonObject report = extra;
+    report.insert(QStringLiteral("version"), QStringLiteral(APPVERSION));
+    report.insert(QStringLiteral("git_hash"), olive::kGitHash);
+    report.insert(QStringLiteral("qt_version"), QString::fromLatin1(qVersion()));
+    report.insert(QStringLiteral("threads"), QThread::idealThreadCount());
+    report.insert(QStringLiteral("benchmarks"), results_);
+
+    QByteArray json = QJsonDocument(report).toJson();
+
+    if (output.isEmpty()) {
+      std::cout << json.constData();
+    } else {
+      QFile f(output);
+      if (!f.open(QFile::WriteOnly)) {
+        std::cerr << "Failed to write " << output.toUtf8().constData() << std::endl;
+        return false;
+      }
+      f.write(json);
+    }
+
+    return true;
+  }
+
+private:
+  QString filter_;
+
+  QJsonArray results_;
+
+};
+
+}
+
+#endif // BENCHMARKRUNNER_H
@@ -0,0 +1,384 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+/**
+ * Micro-benchmarks for the hot paths of the render pipeline
+ *
+ * Every benchmark runs on fixed synthetic inputs so results are comparable between builds on the
+ * same hardware. Results are written as JSON, to stdout or to the file given with `--output`.
+ * `--filter <text>` only runs benchmarks whose name contains the text, and `--video <file>` decodes
+ * the given file instead of a generated clip.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QTemporaryDir>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+}
+
+#include "audio/audiovisualwaveform.h"
+#include "codec/encoder.h"
+#include "codec/ffmpeg/ffmpegdecoder.h"
+#include "codec/frame.h"
+#include "codec/samplebuffer.h"
+#include "common/rational.h"
+#include "node/distort/crop/cropdistortnode.h"
+#include "node/distort/transform/transformdistortnode.h"
+#include "node/generator/solid/solid.h"
+#include "node/math/merge/merge.h"
+#include "node/project/project.h"
+#include "node/traverser.h"
+#include "render/framehashcache.h"
+#include "render/rendermanager.h"
+#include "version.h"
+#include "benchmark/benchmarkrunner.h"
+
+namespace olive {
+
+// Results are accumulated here so the compiler can't optimize the measured work away
+static volatile double benchmark_sink = 0;
+
+static FramePtr CreatePatternFrame(int width, int height, VideoParams::Format format)
+{
+  FramePtr frame = Frame::Create();
+  frame->set_video_params(VideoParams(width, height, format, VideoParams::kRGBAChannelCount));
+  frame->allocate();
+
+  // Deterministic noise so compression has real work to do
+  std::mt19937 rng(1);
+  char* data = frame->data();
+  int bytes = frame->linesize_bytes() * height;
+  for (int i=0; i<bytes; i++) {
+    data[i] = static_cast<char>(rng());
+  }
+
+  return frame;
+}
+
+static SampleBufferPtr CreateNoiseSamples(const AudioParams& params, int samples)
+{
+  SampleBufferPtr buffer = SampleBuffer::CreateAllocated(params, samples);
+
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (int i=0; i<params.channel_count(); i++) {
+    for (int j=0; j<samples; j++) {
+      buffer->data(i)[j] = dist(rng);
+    }
+  }
+
+  return buffer;
+}
+
+/**
+ * @brief Build a compositing stack `layers` deep of transformed, cropped solids
+ */
+static Node* BuildCompositeGraph(Project* project, int layers)
+{
+  SolidGenerator* background = new SolidGenerator();
+  background->setParent(project);
+
+  Node* top = background;
+
+  for (int i=0; i<layers; i++) {
+    SolidGenerator* solid = new SolidGenerator();
+    solid->setParent(project);
+    solid->SetStandardValue(SolidGenerator::kColorInput, QVariant::fromValue(Color(i / double(layers), 0.5, 0.25)));
+
+    TransformDistortNode* transform = new TransformDistortNode();
+    transform->setParent(project);
+    transform->SetStandardValue(TransformDistortNode::kPositionInput, QVector2D(i * 10, i * 5));
+    Node::ConnectEdge(solid, NodeInput(transform, TransformDistortNode::kTextureInput));
+
+    CropDistortNode* crop = new CropDistortNode();
+    crop->setParent(project);
+    crop->SetStandardValue(CropDistortNode::kLeftInput, 0.25);
+    Node::ConnectEdge(transform, NodeInput(crop, CropDistortNode::kTextureInput));
+
+    MergeNode* merge = new MergeNode();
+    merge->setParent(project);
+    Node::ConnectEdge(top, NodeInput(merge, MergeNode::kBaseIn));
+    Node::ConnectEdge(crop, NodeInput(merge, MergeNode::kBlendIn));
+
+    top = merge;
+  }
+
+  return top;
+}
+
+static void BenchmarkRational(BenchmarkRunner& runner)
+{
+  const int count = 4096;
+  QVector<rational> values(count);
+
+  std::mt19937 rng(1);
+  for (int i=0; i<count; i++) {
+    values[i] = rational(int(rng() % 100000) + 1, int(rng() % 1000) + 1);
+  }
+
+  runner.Run(QStringLiteral("rational.add"), 200, count, [&](){
+    rational sum;
+    foreach (const rational& r, values) {
+      sum += r;
+    }
+    benchmark_sink = benchmark_sink + sum.toDouble();
+  });
+
+  runner.Run(QStringLiteral("rational.multiply"), 200, count, [&](){
+    rational product(1);
+    for (int i=0; i<count; i++) {
+      product = values.at(i) * values.at(count - 1 - i);
+      benchmark_sink = benchmark_sink + product.toDouble();
+    }
+  });
+
+  runner.Run(QStringLiteral("rational.compare"), 200, count, [&](){
+    int less = 0;
+    for (int i=1; i<count; i++) {
+      if (values.at(i - 1) < values.at(i)) {
+        less++;
+      }
+    }
+    benchmark_sink = benchmark_sink + less;
+  });
+
+  runner.Run(QStringLiteral("rational.to_double"), 200, count, [&](){
+    double sum = 0;
+    foreach (const rational& r, values) {
+      sum += r.toDouble();
+    }
+    benchmark_sink = benchmark_sink + sum;
+  });
+}
+
+static void BenchmarkSampleBuffer(BenchmarkRunner& runner)
+{
+  AudioParams params(48000, AV_CH_LAYOUT_STEREO, AudioParams::kInternalFormat);
+  const int samples = 48000;
+
+  SampleBufferPtr source = CreateNoiseSamples(params, samples);
+  SampleBufferPtr dest = CreateNoiseSamples(params, samples);
+
+  runner.Run(QStringLiteral("samplebuffer.mix"), 100, 1, [&](){
+    dest->mix(source.get(), 0.5f);
+  });
+
+  runner.Run(QStringLiteral("samplebuffer.transform_volume"), 100, 1, [&](){
+    dest->transform_volume(0.999f);
+  });
+
+  // Multiplying by noise over and over would end up in denormals
+  SampleBufferPtr unity = SampleBuffer::CreateAllocated(params, samples);
+  unity->fill(1.0f);
+
+  runner.Run(QStringLiteral("samplebuffer.multiply"), 100, 1, [&](){
+    dest->multiply(unity.get());
+  });
+
+  QVector<float> automation(samples);
+  for (int i=0; i<samples; i++) {
+    automation[i] = 1.0f - 0.001f * float(i) / float(samples);
+  }
+
+  runner.Run(QStringLiteral("samplebuffer.transform_volume_per_sample"), 100, 1, [&](){
+    dest->transform_volume_per_sample(automation.constData());
+  });
+
+  runner.Run(QStringLiteral("samplebuffer.reverse"), 100, 1, [&](){
+    dest->reverse();
+  });
+
+  runner.Run(QStringLiteral("samplebuffer.speed"), 50, 1, [&](){
+    SampleBufferPtr copy = CreateNoiseSamples(params, samples);
+    copy->speed(1.5);
+  });
+}
+
+static void BenchmarkWaveform(BenchmarkRunner& runner)
+{
+  AudioParams params(48000, AV_CH_LAYOUT_STEREO, AudioParams::kInternalFormat);
+
+  // Ten seconds of audio, enough to fill every mipmap level
+  SampleBufferPtr samples = CreateNoiseSamples(params, params.sample_rate() * 10);
+
+  runner.Run(QStringLiteral("waveform.overwrite_samples"), 20, 1, [&](){
+    AudioVisualWaveform waveform;
+    waveform.set_channel_count(params.channel_count());
+    waveform.OverwriteSamples(samples, params.sample_rate());
+  });
+}
+
+static void BenchmarkGraph(BenchmarkRunner& runner)
+{
+  VideoParams params(1920, 1080, rational(1, 30), VideoParams::kFormatFloat16, VideoParams::kRGBAChannelCount);
+
+  foreach (int layers, QVector<int>({4, 32})) {
+    Project project;
+    Node* root = BuildCompositeGraph(&project, layers);
+
+    runner.Run(QStringLiteral("rendermanager.hash.layers%1").arg(layers), 50, 1, [&](){
+      QByteArray hash = RenderManager::Hash(root, Node::kDefaultOutput, params, rational(1, 30));
+      benchmark_sink = benchmark_sink + hash.at(0);
+    });
+
+    runner.Run(QStringLiteral("traverser.generate_table.layers%1").arg(layers), 50, 1, [&](){
+      NodeTraverser traverser;
+      traverser.SetCacheVideoParams(params);
+      NodeValueTable table = traverser.GenerateTable(root, Node::kDefaultOutput, TimeRange(0, rational(1, 30)));
+      benchmark_sink = benchmark_sink + table.Count();
+    });
+  }
+}
+
+static void BenchmarkFrameHashCache(BenchmarkRunner& runner)
+{
+  QTemporaryDir cache_dir;
+  if (!cache_dir.isValid()) {
+    runner.Skip(QStringLiteral("framehashcache.save"), QStringLiteral("no temporary directory"));
+    return;
+  }
+
+  FramePtr frame = CreatePatternFrame(1920, 1080, VideoParams::kFormatFloat16);
+  int index = 0;
+
+  runner.Run(QStringLiteral("framehashcache.save"), 10, 1, [&](){
+    QByteArray hash = QByteArray::number(index++);
+    FrameHashCache::SaveCacheFrame(cache_dir.path(), hash, frame);
+  });
+
+  runner.Run(QStringLiteral("framehashcache.load"), 10, 1, [&](){
+    FramePtr loaded = FrameHashCache::LoadCacheFrame(cache_dir.path(), QByteArray::number(0));
+    benchmark_sink = benchmark_sink + (loaded ? loaded->width() : 0);
+  });
+}
+
+static QString GenerateTestClip(const QString& dir, int frame_count, const rational& timebase)
+{
+  QString filename = QDir(dir).filePath(QStringLiteral("benchmark.mov"));
+
+  VideoParams vparams(1280, 720, timebase, VideoParams::kFormatUnsigned8, VideoParams::kRGBAChannelCount);
+
+  EncodingParams params;
+  params.SetFilename(filename);
+  params.EnableVideo(vparams, ExportCodec::kCodecProRes);
+  params.set_video_pix_fmt(QStringLiteral("yuv422p10le"));
+  params.SetExportLength(timebase * frame_count);
+
+  std::unique_ptr<Encoder> encoder(Encoder::CreateFromID(Encoder::kEncoderTypeFFmpeg, params));
+  if (!encoder || !encoder->Open()) {
+    return QString();
+  }
+
+  FramePtr frame = CreatePatternFrame(vparams.width(), vparams.height(), vparams.format());
+
+  for (int i=0; i<frame_count; i++) {
+    if (!encoder->WriteFrame(frame, timebase * i)) {
+      encoder->Close();
+      return QString();
+    }
+  }
+
+  encoder->Close();
+  return filename;
+}
+
+static void BenchmarkDecoder(BenchmarkRunner& runner, QString filename)
+{
+  const int frame_count = 96;
+  const rational timebase(1, 24);
+
+  if (!runner.IsEnabled(QStringLiteral("decoder."))) {
+    return;
+  }
+
+  QTemporaryDir clip_dir;
+  if (filename.isEmpty()) {
+    filename = GenerateTestClip(clip_dir.path(), frame_count, timebase);
+  }
+
+  FFmpegDecoder decoder;
+  if (filename.isEmpty() || !decoder.Open(Decoder::CodecStream(filename, 0))) {
+    runner.Skip(QStringLiteral("decoder.retrieve_video"), QStringLiteral("no clip to decode"));
+    return;
+  }
+
+  Decoder::RetrieveVideoParams params;
+
+  runner.Run(QStringLiteral("decoder.retrieve_video.sequential"), 3, frame_count, [&](){
+    for (int i=0; i<frame_count; i++) {
+      FramePtr f = decoder.RetrieveVideo(timebase * i, params);
+      benchmark_sink = benchmark_sink + (f ? 1 : 0);
+    }
+  });
+
+  QVector<int> order(frame_count);
+  for (int i=0; i<frame_count; i++) {
+    order[i] = i;
+  }
+  std::shuffle(order.begin(), order.end(), std::mt19937(1));
+
+  runner.Run(QStringLiteral("decoder.retrieve_video.random"), 3, frame_count, [&](){
+    foreach (int i, order) {
+      FramePtr f = decoder.RetrieveVideo(timebase * i, params);
+      benchmark_sink = benchmark_sink + (f ? 1 : 0);
+    }
+  });
+
+  decoder.Close();
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  QCoreApplication app(argc, argv);
+
+  QString filter, output, video;
+  QStringList args = app.arguments();
+  for (int i=1; i<args.size(); i++) {
+    if (args.at(i) == QStringLiteral("--filter") && i+1 < args.size()) {
+      filter = args.at(++i);
+    } else if (args.at(i) == QStringLiteral("--output") && i+1 < args.size()) {
+      output = args.at(++i);
+    } else if (args.at(i) == QStringLiteral("--video") && i+1 < args.size()) {
+      video = args.at(++i);
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--filter text] [--output file.json] [--video file]" << std::endl;
+      return 1;
+    }
+  }
+
+  olive::BenchmarkRunner runner(filter);
+
+  olive::BenchmarkRational(runner);
+  olive::BenchmarkSampleBuffer(runner);
+  olive::BenchmarkWaveform(runner);
+  olive::BenchmarkGraph(runner);
+  olive::BenchmarkFrameHashCache(runner);
+  olive::BenchmarkDecoder(runner, video);
+
+  return runner.WriteReport(output) ? 0 : 1;
+}
@@ -0,0 +1,490 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2021 Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+/**
+ * Scaling benchmarks for editing operations on large projects
+ *
+ * Synthetic projects are generated with N tracks of M clips, each clip fed by an effect chain whose
+ * parameters have K keyframes, plus a long subtitle track. Each dimension is swept on its own while
+ * the others stay at their base values, and every editing scenario is timed at each size.
+ *
+ * Besides the usual results, the JSON report contains a `scaling` array with the fitted exponent of
+ * each scenario's time against each dimension (1.0 is linear). Curves that grow faster than
+ * `kSuperlinearExponent` are flagged as `superlinear` and listed on stderr.
+ *
+ * Accepts the same `--filter` and `--output` arguments as olive-benchmarks.
+ */
+
+#include <cmath>
+#include <iostream>
+
+#include <QApplication>
+#include <QDir>
+#include <QTemporaryDir>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+}
+
+#include "core.h"
+#include "node/block/clip/clip.h"
+#include "node/block/subtitle/subtitle.h"
+#include "node/distort/crop/cropdistortnode.h"
+#include "node/distort/transform/transformdistortnode.h"
+#include "node/factory.h"
+#include "node/generator/solid/solid.h"
+#include "node/nodecopypaste.h"
+#include "node/project/project.h"
+#include "node/project/sequence/sequence.h"
+#include "node/traverser.h"
+#include "render/rendermanager.h"
+#include "task/project/load/load.h"
+#include "task/project/save/save.h"
+#include "widget/timelinewidget/timelineundo.h"
+#include "widget/timelinewidget/timelinewidget.h"
+#include "benchmark/benchmarkrunner.h"
+
+namespace olive {
+
+// Results are accumulated here so the compiler can't optimize the measured work away
+static volatile double benchmark_sink = 0;
+
+// Fitted exponents above this are reported as superlinear
+static const double kSuperlinearExponent = 1.25;
+
+struct SyntheticProjectParams
+{
+  int tracks;
+  int blocks_per_track;
+  int keyframes_per_param;
+  int effect_depth;
+  int subtitles;
+};
+
+static const SyntheticProjectParams kBaseParams = {4, 50, 4, 2, 250};
+
+static const rational kBlockLength(2);
+static const rational kSubtitleLength(1);
+static const rational kTimebase(1, 30);
+
+/**
+ * @brief A generated project and the nodes the scenarios operate on
+ */
+struct SyntheticProject
+{
+  Project project;
+  Sequence* sequence;
+
+  // Clips on the first video track along with every node in their effect chains
+  QVector<Node*> first_track_nodes;
+
+  // Effect in the middle of the timeline whose keyframes are edited to invalidate the graph
+  NodeKeyframe* middle_keyframe;
+};
+
+static void AddKeyframes(Node* node, const QString& input, int count, double from, double to)
+{
+  node->SetInputIsKeyframing(input, true);
+
+  for (int i=0; i<count; i++) {
+    int steps = qMax(1, count - 1);
+    double t = double(i) / steps;
+    new NodeKeyframe(kBlockLength * i / steps,
+                     from + (to - from) * t,
+                     NodeKeyframe::kLinear,
+                     0, -1, input, node);
+  }
+}
+
+/**
+ * @brief Build an effect chain `depth` pairs deep on top of a solid, returning every node created
+ */
+static QVector<Node*> BuildEffectChain(Project* project, const SyntheticProjectParams& p, int seed)
+{
+  QVector<Node*> chain;
+
+  SolidGenerator* solid = new SolidGenerator();
+  solid->setParent(project);
+  solid->SetStandardValue(SolidGenerator::kColorInput, QVariant::fromValue(Color((seed % 16) / 16.0, 0.5, 0.25)));
+  chain.append(solid);
+
+  for (int i=0; i<p.effect_depth; i++) {
+    TransformDistortNode* transform = new TransformDistortNode();
+    transform->setParent(project);
+    AddKeyframes(transform, TransformDistortNode::kRotationInput, p.keyframes_per_param, 0.0, 90.0 + seed % 90);
+    Node::ConnectEdge(chain.last(), NodeInput(transform, TransformDistortNode::kTextureInput));
+    chain.append(transform);
+
+    CropDistortNode* crop = new CropDistortNode();
+    crop->setParent(project);
+    AddKeyframes(crop, CropDistortNode::kLeftInput, p.keyframes_per_param, 0.0, 0.25);
+    Node::ConnectEdge(transform, NodeInput(crop, CropDistortNode::kTextureInput));
+    chain.append(crop);
+  }
+
+  return chain;
+}
+
+static void GenerateSyntheticProject(SyntheticProject* sp, const SyntheticProjectParams& p)
+{
+  Sequence* sequence = new Sequence();
+  sequence->setParent(&sp->project);
+  sequence->SetVideoParams(VideoParams(1920, 1080, kTimebase, VideoParams::kFormatFloat16, VideoParams::kRGBAChannelCount));
+  sequence->SetAudioParams(AudioParams(48000, AV_CH_LAYOUT_STEREO, AudioParams::kInternalFormat));
+  sp->sequence = sequence;
+  sp->middle_keyframe = nullptr;
+
+  for (int i=0; i<p.tracks; i++) {
+    Track* track = TimelineAddTrackCommand::RunImmediately(sequence->track_list(Track::kVideo), true);
+
+    QVector<Block*> blocks(p.blocks_per_track);
+
+    for (int j=0; j<p.blocks_per_track; j++) {
+      QVector<Node*> chain = BuildEffectChain(&sp->project, p, i * p.blocks_per_track + j);
+
+      ClipBlock* clip = new ClipBlock();
+      clip->setParent(&sp->project);
+      clip->set_length_and_media_out(kBlockLength);
+      Node::ConnectEdge(chain.last(), NodeInput(clip, ClipBlock::kBufferIn));
+      blocks[j] = clip;
+
+      if (i == 0) {
+        sp->first_track_nodes.append(chain);
+        sp->first_track_nodes.append(clip);
+      }
+
+      if (i == p.tracks / 2 && j == p.blocks_per_track / 2) {
+        const QVector<NodeKeyframeTrack>& tracks = chain.last()->GetKeyframeTracks(CropDistortNode::kLeftInput, -1);
+        if (!tracks.isEmpty() && !tracks.first().isEmpty()) {
+          sp->middle_keyframe = tracks.first().first();
+        }
+      }
+    }
+
+    track->AppendBlocks(blocks);
+  }
+
+  Track* subtitle_track = TimelineAddTrackCommand::RunImmediately(sequence->track_list(Track::kSubtitle));
+
+  QVector<Block*> subtitles(p.subtitles);
+  for (int i=0; i<p.subtitles; i++) {
+    SubtitleBlock* sub = new SubtitleBlock();
+    sub->setParent(&sp->project);
+    sub->set_length_and_media_out(kSubtitleLength);
+    sub->SetText(QStringLiteral("Subtitle line %1").arg(i));
+    subtitles[i] = sub;
+  }
+  subtitle_track->AppendBlocks(subtitles);
+}
+
+/**
+ * @brief Exposes the copy/paste service the timeline and node editor use
+ */
+class SyntheticCopyPaste : public NodeCopyPasteService
+{
+public:
+  void Copy(const QVector<Node*>& nodes)
+  {
+    CopyNodesToClipboard(nodes);
+  }
+
+  QVector<Node*> Paste(NodeGraph* graph, MultiUndoCommand* command)
+  {
+    return PasteNodesFromClipboard(graph, command);
+  }
+};
+
+struct ScalingPoint
+{
+  int size;
+  double median_ns;
+};
+
+using ScalingCurves = QMap<QString, QVector<ScalingPoint> >;
+
+static void RecordPoint(ScalingCurves& curves, const QString& scenario, const QString& dimension, int size, double median)
+{
+  if (median >= 0) {
+    curves[QStringLiteral("%1/%2").arg(scenario, dimension)].append({size, median});
+  }
+}
+
+static void RunScenarios(BenchmarkRunner& runner, ScalingCurves& curves, const QString& dimension, int size, const SyntheticProjectParams& p)
+{
+  const QString suffix = QStringLiteral(".%1%2").arg(dimension, QString::number(size));
+
+  const QStringList scenarios = {QStringLiteral("save"), QStringLiteral("load"),
+                                 QStringLiteral("rehash"), QStringLiteral("snap_drag"),
+                                 QStringLiteral("ripple"), QStringLiteral("copy_paste"),
+                                 QStringLiteral("render_frame")};
+
+  bool any_enabled = false;
+  foreach (const QString& s, scenarios) {
+    if (runner.IsEnabled(QStringLiteral("scaling.%1%2").arg(s, suffix))) {
+      any_enabled = true;
+      break;
+    }
+  }
+  if (!any_enabled) {
+    return;
+  }
+
+  SyntheticProject sp;
+  GenerateSyntheticProject(&sp, p);
+
+  Sequence* sequence = sp.sequence;
+  VideoParams vparams = sequence->GetVideoParams();
+  rational length = kBlockLength * p.blocks_per_track;
+  double median;
+
+  QTemporaryDir save_dir;
+  QString save_filename = QDir(save_dir.path()).filePath(QStringLiteral("scaling.ove"));
+
+  if (save_dir.isValid()) {
+    median = runner.Run(QStringLiteral("scaling.save") + suffix, 3, 1, [&](){
+      ProjectSaveTask task(&sp.project);
+      task.SetOverrideFilename(save_filename);
+      benchmark_sink = benchmark_sink + task.Start();
+    });
+    RecordPoint(curves, QStringLiteral("save"), dimension, size, median);
+
+    if (QFile::exists(save_filename)) {
+      median = runner.Run(QStringLiteral("scaling.load") + suffix, 3, 1, [&](){
+        ProjectLoadTask task(save_filename);
+        benchmark_sink = benchmark_sink + task.Start();
+        delete task.GetLoadedProject();
+      });
+      RecordPoint(curves, QStringLiteral("load"), dimension, size, median);
+    }
+  } else {
+    runner.Skip(QStringLiteral("scaling.save") + suffix, QStringLiteral("no temporary directory"));
+  }
+
+  if (sp.middle_keyframe) {
+    // Edit one keyframe in the middle of the timeline, then rehash frames spread across it
+    const int hashed_frames = 30;
+    int edit = 0;
+
+    median = runner.Run(QStringLiteral("scaling.rehash") + suffix, 5, 1, [&](){
+      sp.middle_keyframe->set_value(0.1 + 0.01 * (edit++ % 10));
+
+      for (int i=0; i<hashed_frames; i++) {
+        QByteArray hash = RenderManager::Hash(sequence->GetConnectedTextureOutput(), vparams, length * i / hashed_frames);
+        benchmark_sink = benchmark_sink + hash.at(0);
+      }
+    });
+    RecordPoint(curves, QStringLiteral("rehash"), dimension, size, median);
+  }
+
+  if (runner.IsEnabled(QStringLiteral("scaling.snap_drag") + suffix)) {
+    // Drag a clip-length selection across the whole sequence, snapping at every mouse move
+    const int moves = 200;
+    TimelineWidget timeline;
+    timeline.ConnectViewerNode(sequence);
+
+    QVector<rational> start_times = {0, kBlockLength};
+
+    median = runner.Run(QStringLiteral("scaling.snap_drag") + suffix, 5, moves, [&](){
+      for (int i=0; i<moves; i++) {
+        rational movement = length * i / moves;
+        benchmark_sink = benchmark_sink + timeline.SnapPoint(start_times, &movement);
+      }
+      timeline.HideSnaps();
+    });
+    RecordPoint(curves, QStringLiteral("snap_drag"), dimension, size, median);
+
+    timeline.ConnectViewerNode(nullptr);
+  }
+
+  {
+    // Ripple delete a second out of the middle of every track and undo it
+    rational in = length / 2 + kBlockLength / 4;
+    rational out = in + kBlockLength / 2;
+
+    median = runner.Run(QStringLiteral("scaling.ripple") + suffix, 5, 1, [&](){
+      TimelineRippleRemoveAreaCommand command(sequence, in, out);
+      command.redo();
+      command.undo();
+    });
+    RecordPoint(curves, QStringLiteral("ripple"), dimension, size, median);
+  }
+
+  {
+    SyntheticCopyPaste service;
+
+    median = runner.Run(QStringLiteral("scaling.copy_paste") + suffix, 3, 1, [&](){
+      service.Copy(sp.first_track_nodes);
+
+      MultiUndoCommand* command = new MultiUndoCommand();
+      QVector<Node*> pasted = service.Paste(&sp.project, command);
+      command->redo();
+      command->undo();
+      delete command;
+
+      benchmark_sink = benchmark_sink + pasted.size();
+    });
+    RecordPoint(curves, QStringLiteral("copy_paste"), dimension, size, median);
+  }
+
+  median = runner.Run(QStringLiteral("scaling.render_frame") + suffix, 5, 1, [&](){
+    NodeTraverser traverser;
+    traverser.SetCacheVideoParams(vparams);
+    NodeValueTable table = traverser.GenerateTable(sequence->GetConnectedTextureOutput(), TimeRange(length / 2, length / 2 + kTimebase));
+    benchmark_sink = benchmark_sink + table.Count();
+  });
+  RecordPoint(curves, QStringLiteral("render_frame"), dimension, size, median);
+}
+
+/**
+ * @brief Least squares slope of log(time) against log(size)
+ */
+static double FitExponent(const QVector<ScalingPoint>& points)
+{
+  double n = points.size();
+  double sx = 0, sy = 0, sxx = 0, sxy = 0;
+
+  foreach (const ScalingPoint& p, points) {
+    double x = std::log(double(p.size));
+    double y = std::log(qMax(p.median_ns, 1.0));
+    sx += x;
+    sy += y;
+    sxx += x * x;
+    sxy += x * y;
+  }
+
+  double denom = n * sxx - sx * sx;
+  if (qFuzzyIsNull(denom)) {
+    return 0;
+  }
+
+  return (n * sxy - sx * sy) / denom;
+}
+
+static QJsonArray AnalyzeCurves(const ScalingCurves& curves)
+{
+  QJsonArray scaling;
+
+  for (auto it=curves.cbegin(); it!=curves.cend(); it++) {
+    if (it.value().size() < 2) {
+      continue;
+    }
+
+    QStringList key = it.key().split('/');
+    double exponent = FitExponent(it.value());
+    bool superlinear = exponent > kSuperlinearExponent;
+
+    QJsonArray points;
+    foreach (const ScalingPoint& p, it.value()) {
+      QJsonObject point;
+      point.insert(QStringLiteral("size"), p.size);
+      point.insert(QStringLiteral("median_ns"), p.median_ns);
+      points.append(point);
+    }
+
+    QJsonObject curve;
+    curve.insert(QStringLiteral("scenario"), key.at(0));
+    curve.insert(QStringLiteral("dimension"), key.at(1));
+    curve.insert(QStringLiteral("exponent"), exponent);
+    curve.insert(QStringLiteral("superlinear"), superlinear);
+    curve.insert(QStringLiteral("points"), points);
+    scaling.append(curve);
+
+    std::cerr << "scaling " << it.key().toUtf8().constData() << " - exponent " << exponent
+              << (superlinear ? " (SUPERLINEAR)" : "") << std::endl;
+  }
+
+  return scaling;
+}
+
+static QJsonArray BenchmarkScaling(BenchmarkRunner& runner)
+{
+  ScalingCurves curves;
+
+  foreach (int tracks, QVector<int>({2, 4, 8, 16})) {
+    SyntheticProjectParams p = kBaseParams;
+    p.tracks = tracks;
+    RunScenarios(runner, curves, QStringLiteral("tracks"), tracks, p);
+  }
+
+  foreach (int blocks, QVector<int>({25, 50, 100, 200})) {
+    SyntheticProjectParams p = kBaseParams;
+    p.blocks_per_track = blocks;
+    RunScenarios(runner, curves, QStringLiteral("blocks"), blocks, p);
+  }
+
+  foreach (int keyframes, QVector<int>({2, 8, 32, 128})) {
+    SyntheticProjectParams p = kBaseParams;
+    p.keyframes_per_param = keyframes;
+    RunScenarios(runner, curves, QStringLiteral("keyframes"), keyframes, p);
+  }
+
+  foreach (int depth, QVector<int>({1, 2, 4, 8})) {
+    SyntheticProjectParams p = kBaseParams;
+    p.effect_depth = depth;
+    RunScenarios(runner, curves, QStringLiteral("depth"), depth, p);
+  }
+
+  foreach (int subtitles, QVector<int>({250, 500, 1000, 2000})) {
+    SyntheticProjectParams p = kBaseParams;
+    p.subtitles = subtitles;
+    RunScenarios(runner, curves, QStringLiteral("subtitles"), subtitles, p);
+  }
+
+  return AnalyzeCurves(curves);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  // The timeline widget and clipboard need a GUI application, but nothing is ever shown
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+
+  QApplication app(argc, argv);
+
+  QString filter, output;
+  QStringList args = app.arguments();
+  for (int i=1; i<args.size(); i++) {
+    if (args.at(i) == QStringLiteral("--filter") && i+1 < args.size()) {
+      filter = args.at(++i);
+    } else if (args.at(i) == QStringLiteral("--output") && i+1 < args.size()) {
+      output = args.at(++i);
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--filter text] [--output file.json]" << std::endl;
+      return 1;
+    }
+  }
+
+  // Never started, but the timeline widget connects to its signals
+  olive::Core core((olive::Core::CoreParams()));
+
+  olive::NodeFactory::Initialize();
+
+  olive::BenchmarkRunner runner(filter);
+
+  QJsonObject extra;
+  extra.insert(QStringLiteral("scaling"), olive::BenchmarkScaling(runner));
+
+  olive::NodeFactory::Destroy();
+
+  return runner.WriteReport(output, extra) ? 0 : 1;
+}
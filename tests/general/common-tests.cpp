@@ -20,7 +20,13 @@
 
 #include "testutil.h"
 
+#include <QBuffer>
+
 #include "common/digit.h"
+#include "common/hasher.h"
+#include "common/timerange.h"
+#include "common/xmlstream.h"
+#include "render/framehashmap.h"
 
 namespace olive {
 
@@ -46,4 +52,283 @@ OLIVE_ADD_TEST(DigitTest)
   OLIVE_TEST_END;
 }
 
+OLIVE_ADD_TEST(HasherStreaming)
+{
+  QByteArray data;
+  for (int i=0; i<100; i++) {
+    data.append(char(i * 7));
+  }
+
+  Hasher whole;
+  whole.addData(data);
+
+  // Feeding the same bytes in uneven pieces must produce the same hash
+  Hasher pieces;
+  int sizes[] = {1, 15, 3, 16, 33, 32};
+  int offset = 0;
+  for (int sz : sizes) {
+    pieces.addData(data.constData() + offset, sz);
+    offset += sz;
+  }
+
+  OLIVE_ASSERT(offset == data.size());
+  OLIVE_ASSERT(whole.result() == pieces.result());
+  OLIVE_ASSERT(whole.result().size() == Hasher::kResultSize);
+
+  // Hashing more data must change the result
+  QByteArray before = whole.result();
+  whole.addData("x", 1);
+  OLIVE_ASSERT(whole.result() != before);
+
+  OLIVE_TEST_END;
+}
+
+OLIVE_ADD_TEST(HasherTypedValues)
+{
+  Hasher a;
+  a.add(rational(1, 30));
+  a.add(QStringLiteral("ab"));
+  a.add(QStringLiteral("c"));
+
+  Hasher b;
+  b.add(rational(1, 30));
+  b.add(QStringLiteral("a"));
+  b.add(QStringLiteral("bc"));
+
+  // Strings are length-prefixed so these mustn't collide
+  OLIVE_ASSERT(a.result() != b.result());
+
+  // Negative and positive zero are the same value
+  Hasher pos, neg;
+  pos.add(0.0);
+  neg.add(-0.0);
+  OLIVE_ASSERT(pos.result() == neg.result());
+
+  // Empty hashers are deterministic
+  OLIVE_ASSERT(Hasher().result() == Hasher().result());
+
+  OLIVE_TEST_END;
+}
+
+namespace {
+
+void WriteXMLStreamTestTree(XMLWriter* writer)
+{
+  writer->writeStartDocument();
+  writer->writeStartElement(QStringLiteral("olive"));
+  writer->writeTextElement(QStringLiteral("version"), QStringLiteral("210122"));
+  writer->writeStartElement(QStringLiteral("node"));
+  writer->writeAttribute(QStringLiteral("id"), QStringLiteral("transform"));
+  writer->writeAttribute(QStringLiteral("ptr"), QStringLiteral("140737488355328"));
+  writer->writeTextElement(QStringLiteral("label"), QString::fromUtf8("Caf\xc3\xa9 <&>"));
+  writer->writeTextElement(QStringLiteral("empty"), QString());
+  writer->writeStartElement(QStringLiteral("node"));
+  writer->writeEndElement();
+  writer->writeEndElement();
+  writer->writeEndElement();
+  writer->writeEndDocument();
+}
+
+QStringList ReadXMLStreamTestTree(XMLReader* reader)
+{
+  // Flatten everything a loader could observe into a list that can be compared
+  QStringList events;
+
+  while (!reader->atEnd()) {
+    switch (reader->readNext()) {
+    case QXmlStreamReader::StartElement:
+    {
+      QString e = QStringLiteral("start:") + reader->name().toString();
+      foreach (const QXmlStreamAttribute& a, reader->attributes()) {
+        e.append(QStringLiteral(" %1=%2").arg(a.name().toString(), a.value().toString()));
+      }
+      events.append(e);
+
+      if (reader->name() == QStringLiteral("label") || reader->name() == QStringLiteral("empty")) {
+        events.append(QStringLiteral("text:") + reader->readElementText());
+      } else if (reader->name() == QStringLiteral("version")) {
+        reader->skipCurrentElement();
+      }
+      break;
+    }
+    case QXmlStreamReader::EndElement:
+      events.append(QStringLiteral("end:") + reader->name().toString());
+      break;
+    default:
+      break;
+    }
+  }
+
+  if (reader->hasError()) {
+    events.append(QStringLiteral("error"));
+  }
+
+  return events;
+}
+
+}
+
+OLIVE_ADD_TEST(XMLStreamBinaryRoundTrip)
+{
+  QBuffer xml_buffer;
+  xml_buffer.open(QBuffer::WriteOnly);
+  {
+    XMLWriter writer(&xml_buffer, XMLWriter::kXML);
+    WriteXMLStreamTestTree(&writer);
+    OLIVE_ASSERT(!writer.hasError());
+  }
+  xml_buffer.close();
+
+  QBuffer binary_buffer;
+  binary_buffer.open(QBuffer::WriteOnly);
+  {
+    XMLWriter writer(&binary_buffer, XMLWriter::kBinary);
+    WriteXMLStreamTestTree(&writer);
+    OLIVE_ASSERT(!writer.hasError());
+  }
+  binary_buffer.close();
+
+  xml_buffer.open(QBuffer::ReadOnly);
+  binary_buffer.open(QBuffer::ReadOnly);
+
+  OLIVE_ASSERT(!XMLReader::IsBinary(&xml_buffer));
+  OLIVE_ASSERT(XMLReader::IsBinary(&binary_buffer));
+
+  XMLReader xml_reader(&xml_buffer);
+  XMLReader binary_reader(&binary_buffer);
+
+  OLIVE_ASSERT(binary_reader.is_binary());
+
+  QStringList xml_events = ReadXMLStreamTestTree(&xml_reader);
+  QStringList binary_events = ReadXMLStreamTestTree(&binary_reader);
+
+  OLIVE_ASSERT(!xml_events.contains(QStringLiteral("error")));
+  OLIVE_ASSERT(xml_events == binary_events);
+
+  // Truncated binary data must fail rather than produce a partial tree quietly
+  XMLReader truncated(binary_buffer.data().left(binary_buffer.data().size() - 3));
+  OLIVE_ASSERT(ReadXMLStreamTestTree(&truncated).contains(QStringLiteral("error")));
+
+  OLIVE_TEST_END;
+}
+
+OLIVE_ADD_TEST(TimeRangeListCoalesce)
+{
+  TimeRangeList list = {TimeRange(4, 6), TimeRange(0, 2), TimeRange(2, 3)};
+
+  // Touching ranges join and the list stays sorted
+  OLIVE_ASSERT(list.size() == 2);
+  OLIVE_ASSERT(list.first() == TimeRange(0, 3));
+  OLIVE_ASSERT(list.last() == TimeRange(4, 6));
+
+  list.insert(TimeRange(1, 5));
+  OLIVE_ASSERT(list.size() == 1);
+  OLIVE_ASSERT(list.first() == TimeRange(0, 6));
+
+  list.remove(TimeRange(2, 3));
+  OLIVE_ASSERT(list.size() == 2);
+  OLIVE_ASSERT(list.contains(TimeRange(0, 2)));
+  OLIVE_ASSERT(!list.contains(TimeRange(1, 4)));
+  OLIVE_ASSERT(list.contains(TimeRange(3, 6)));
+
+  // Removing an empty range doesn't split anything
+  list.remove(TimeRange(5, 5));
+  OLIVE_ASSERT(list.size() == 2);
+
+  TimeRangeList intersect = list.Intersects(TimeRange(1, 4));
+  OLIVE_ASSERT(intersect.size() == 2);
+  OLIVE_ASSERT(intersect.first() == TimeRange(1, 2));
+  OLIVE_ASSERT(intersect.last() == TimeRange(3, 4));
+
+  OLIVE_TEST_END;
+}
+
+OLIVE_ADD_TEST(TimeRangeListMergeSubtract)
+{
+  TimeRangeList a = {TimeRange(0, 2), TimeRange(5, 7), TimeRange(10, 12)};
+  TimeRangeList b = {TimeRange(1, 5), TimeRange(8, 9)};
+
+  TimeRangeList merged = a;
+  merged.merge(b);
+  OLIVE_ASSERT(merged.size() == 3);
+  OLIVE_ASSERT(merged.first() == TimeRange(0, 7));
+  OLIVE_ASSERT(merged.internal_array().at(1) == TimeRange(8, 9));
+  OLIVE_ASSERT(merged.last() == TimeRange(10, 12));
+
+  // Merging must agree with inserting one at a time
+  TimeRangeList inserted = a;
+  foreach (const TimeRange& r, b) {
+    inserted.insert(r);
+  }
+  OLIVE_ASSERT(inserted.internal_array() == merged.internal_array());
+
+  TimeRangeList subtracted = {TimeRange(0, 20)};
+  subtracted.subtract(a);
+  OLIVE_ASSERT(subtracted.size() == 3);
+  OLIVE_ASSERT(subtracted.first() == TimeRange(2, 5));
+  OLIVE_ASSERT(subtracted.internal_array().at(1) == TimeRange(7, 10));
+  OLIVE_ASSERT(subtracted.last() == TimeRange(12, 20));
+
+  // Subtracting must agree with removing one at a time
+  TimeRangeList removed = a;
+  foreach (const TimeRange& r, b) {
+    removed.remove(r);
+  }
+  TimeRangeList subtracted_b = a;
+  subtracted_b.subtract(b);
+  OLIVE_ASSERT(removed.internal_array() == subtracted_b.internal_array());
+
+  OLIVE_TEST_END;
+}
+
+OLIVE_ADD_TEST(FrameHashMapShift)
+{
+  FrameHashMap map;
+
+  for (int i=0; i<10; i++) {
+    map.insert(i, QByteArray::number(i));
+  }
+
+  // Ripple everything from 3 onward forward by 2
+  map.shift(3, 5);
+  OLIVE_ASSERT(map.size() == 10);
+  OLIVE_ASSERT(map.value(2) == QByteArray::number(2));
+  OLIVE_ASSERT(map.value(3).isEmpty());
+  OLIVE_ASSERT(map.value(5) == QByteArray::number(3));
+  OLIVE_ASSERT(map.value(11) == QByteArray::number(9));
+
+  // Frames inserted after a shift land in the right place
+  map.insert(3, "gap");
+  OLIVE_ASSERT(map.value(3) == "gap");
+
+  // Shifting back removes whatever was in the way
+  map.shift(5, 3);
+  OLIVE_ASSERT(map.size() == 10);
+  OLIVE_ASSERT(map.value(3) == QByteArray::number(3));
+  OLIVE_ASSERT(map.value(9) == QByteArray::number(9));
+  OLIVE_ASSERT(map.value(10).isEmpty());
+
+  map.remove(TimeRange(8, RATIONAL_MAX));
+  OLIVE_ASSERT(map.size() == 8);
+  OLIVE_ASSERT(map.times_with_hash(QByteArray::number(7)) == (QList<rational>() << rational(7)));
+  OLIVE_ASSERT(map.times_with_hashes(QSet<QByteArray>() << QByteArray::number(6) << QByteArray::number(1))
+               == (QList<rational>() << rational(1) << rational(6)));
+
+  // Many small shifts must compact without losing frames
+  for (int i=0; i<FrameHashMap::kMaximumSegments * 2; i++) {
+    map.shift(i % 8, i % 8 + 1);
+  }
+  OLIVE_ASSERT(map.size() == 8);
+
+  QMap<rational, QByteArray> flat = map.ToMap();
+  int index = 0;
+  for (auto it=flat.cbegin(); it!=flat.cend(); it++) {
+    OLIVE_ASSERT(it.value() == QByteArray::number(index));
+    OLIVE_ASSERT(map.value(it.key()) == it.value());
+    index++;
+  }
+
+  OLIVE_TEST_END;
+}
+
 }
@@ -61,4 +61,26 @@ OLIVE_ADD_TEST(RationalNaNConstant)
   OLIVE_TEST_END;
 }
 
+OLIVE_ADD_TEST(RationalArithmetic)
+{
+  // Same denominator still reduces
+  OLIVE_ASSERT(rational(1, 4) + rational(1, 4) == rational(1, 2));
+  OLIVE_ASSERT(rational(1, 30) - rational(1, 24) == rational(-1, 120));
+  OLIVE_ASSERT(rational(-2, 3) * rational(3, -4) == rational(1, 2));
+  OLIVE_ASSERT(rational(1, 3) / rational(-2, 3) == rational(-1, 2));
+  OLIVE_ASSERT((rational(1, 3) / rational(0)).isNaN());
+
+  // Cross products that overflow 64 bits must still reduce to the right answer
+  rational big(INT64_MAX / 2, 3);
+  OLIVE_ASSERT(big * big.flipped() == rational(1));
+  OLIVE_ASSERT(rational(1, INT64_MAX - 1) < rational(1, INT64_MAX - 2));
+
+  OLIVE_ASSERT(RATIONAL_MIN < rational(0));
+  OLIVE_ASSERT(rational(5, 3) < RATIONAL_MAX);
+  OLIVE_ASSERT(!(RATIONAL_MAX < RATIONAL_MAX));
+  OLIVE_ASSERT(!(rational::NaN < rational(1)));
+
+  OLIVE_TEST_END;
+}
+
 }
@@ -596,4 +596,49 @@ OLIVE_ADD_TEST(InsertGaps_SingleTrack)
   OLIVE_TEST_END;
 }
 
+OLIVE_ADD_TEST(BlockBatch)
+{
+  TIMELINE_TEST_START;
+
+  sequence.add_default_nodes();
+  Track* track = sequence.track_list(Track::kVideo)->GetTracks().first();
+
+  QVector<Block*> blocks;
+  for (int i=0; i<4; i++) {
+    ClipBlock* b = new ClipBlock();
+    b->set_length_and_media_out(i+1);
+    b->setParent(&project);
+    blocks.append(b);
+  }
+
+  // Append all blocks at once
+  track->AppendBlocks(blocks);
+
+  OLIVE_ASSERT(track->Blocks() == blocks);
+  OLIVE_ASSERT(blocks.at(0)->in() == 0);
+  OLIVE_ASSERT(blocks.at(1)->in() == 1);
+  OLIVE_ASSERT(blocks.at(2)->in() == 3);
+  OLIVE_ASSERT(blocks.at(3)->in() == 6);
+  OLIVE_ASSERT(track->track_length() == 10);
+
+  // Remove two blocks and resize another in the same batch
+  track->BeginBlockBatch();
+  track->RippleRemoveBlock(blocks.at(0));
+  track->RippleRemoveBlock(blocks.at(2));
+  blocks.at(3)->set_length_and_media_out(1);
+  track->EndBlockBatch();
+
+  OLIVE_ASSERT(track->Blocks().size() == 2);
+  OLIVE_ASSERT(track->Blocks().at(0) == blocks.at(1));
+  OLIVE_ASSERT(track->Blocks().at(1) == blocks.at(3));
+  OLIVE_ASSERT(blocks.at(1)->in() == 0);
+  OLIVE_ASSERT(blocks.at(1)->previous() == nullptr);
+  OLIVE_ASSERT(blocks.at(1)->next() == blocks.at(3));
+  OLIVE_ASSERT(blocks.at(3)->in() == 2);
+  OLIVE_ASSERT(blocks.at(3)->index() == 1);
+  OLIVE_ASSERT(track->track_length() == 3);
+
+  OLIVE_TEST_END;
+}
+
 }